@@ -24,6 +24,136 @@ Release 6.1.0 (UNRELEASED)
  - pvput to NTEnum via. string now supported
  - pvac::* add valid() method and boolean cast shorthand.  Also reset() and operator<<(ostream, ...)
  - Add pvac::ClientProvider::named()
+ - Server option EPICS_PVAS_IO_THREADS=N to service all TCP connections with a pool of N epoll()/kqueue() threads instead of two threads per connection.  These threads never wait for one connection: a message is only processed once all of it, or all segments of it, has been received, and what a socket will not yet accept is kept until it becomes writable.
+ - TCP receive window grows from 16KB, up to EPICS_PVA_MAX_TCP_RECV (default 256KB), while a connection is busy.
+ - Per-connection traffic counters, shown by "pvasr 2" and the "transports" operation of the "server" RPC channel.
+ - Send coalescing with EPICS_PVA_COALESCE_US and EPICS_PVA_COALESCE_BYTES.  Connections with priority above EPICS_PVA_COALESCE_MAX_PRIORITY (default 98) opt out.
+ - Connection send and receive buffers are re-used through a process wide BufferPool.  See "refshow".
+ - Optional LZ4 compression of large messages, when built with WITH_LZ4=YES and EPICS_PVA_COMPRESS_THRESHOLD is set.
+ - Optional TLS encryption of TCP connections, when built with WITH_OPENSSL=YES.  Servers enable with EPICS_PVAS_TLS_CERT, clients with EPICS_PVA_TLS_CA.  Sessions are resumed on reconnect, and kTLS is used where available.  Client certificates are checked by the new "x509" authentication plug-in.  A server does the handshake on the thread(s) of each connection, so that a slow or stalled client does not hold up accepting others.
+ - Connections through loopback move into a shared memory ring of EPICS_PVA_SHM_RING_SIZE bytes (default 0, disabled.  eg. 4194304) once validated, if set on both client and server.  If /dev/shm lacks room for the ring the connection stays on TCP.  Linux only, both processes must run as the same user, and not with EPICS_PVAS_IO_THREADS.
+ - Segmented messages are sent in segments up to the receive buffer size advertised by the peer during connection validation, and at most EPICS_PVA_MAX_SEGMENT_SIZE (default 256KB).
+ - UDP receive with recvmmsg() on Linux.  Search replies to one requester are packed into shared datagrams, and sent together with sendmmsg().  Per-socket datagram and kernel drop counters are shown by "pvasr 1".
+ - Providers implementing the new ChannelNamePublisher interface, including pvas::StaticProvider, answer searches from a server side hash index without channelFind().  Searches for missing names are remembered for EPICS_PVAS_SEARCH_NEGATIVE_TIMEOUT seconds (default 2).
+ - Client search sends at most EPICS_PVA_MAX_SEARCH_FRAMES (default 20) datagrams per period, least searched channels first.  Unicast EPICS_PVA_ADDR_LIST entries which never answer are only sent the first search of each channel, and the later, slower, retries.
+ - Name servers.  A server with EPICS_PVAS_NAME_SERVER_LIST fetches the channel lists of those servers every EPICS_PVAS_NAME_SERVER_POLL seconds (default 30), and answers searches for their names.  Clients with EPICS_PVA_NAME_SERVERS also send search requests over a persistent TCP connection to each name server.
+ - Clients remember the server each channel name was last connected to (up to EPICS_PVA_SERVER_CACHE_SIZE names, default 65536), and reconnect directly before searching.  A server which refuses the connection is searched for again until its next beacon.
+ - Clients with EPICS_PVA_SERVER_CACHE_FILE set share this cache with other processes through that file.  It is read when the context is created and merged back when it is destroyed, so repeated runs of pvget, pvinfo, etc. connect without searching.  Entries expire EPICS_PVA_SERVER_CACHE_TTL seconds (default 300) after they were last connected.  The file is written with mode 0600, as it shows which names the user has used, and is replaced while holding a lock on <file>.lock (flock(), not on Windows or vxWorks), so that processes exiting together do not lose each other's entries.
+ - Beacon periods are randomized by +-10%, and the first beacon delayed by up to 10% of EPICS_PVAS_BEACON_PERIOD.  Clients merge new servers detected within EPICS_PVA_BOOST_HOLDOFF seconds (default 2) of a search boost into one later boost.
+ - Multicast mode.  With EPICS_PVA_MCAST_GROUP (servers also EPICS_PVAS_MCAST_GROUP) searches and beacons are sent once per interface to that group, instead of to each automatic broadcast address.  The group is joined on each interface by a separate socket, which receives only that group.
+ - Servers with EPICS_PVAS_REQUEST_THREADS workers run the operations of providers implementing the new BlockingChannelProvider interface on a pool, instead of on the receive thread of the connection.  In order for each operation.  At most EPICS_PVAS_REQUEST_QUEUE (default 1024) are queued before receiving waits.  See "pvasr 1".
+ - Servers accept create channel requests for more than one channel.  Clients no longer flush after each create channel request, so the requests of many channels are sent together.
+ - Lookups of server channel IDs, and of operation IOIDs in servers and clients, use the new IDTable, an open addressed array, instead of std::map.
+ - Server side monitor rate limit.  With pvRequest option record[rate=N] (Hz) or record[dt=S] (seconds) the server sends each subscriber at most one update per period, the latest value with changed and overrun masks merged as MonitorFIFO::post() does.
+ - Server side monitor filters.  Field options of a monitor pvRequest naming a MonitorFilterPlugin, eg. field(value[deadband=abs:0.5]), hold updates until the filter passes them.  Built in are deadband=abs:X|rel:X, decimate=N, and subrange=start:end.  See MonitorFilterRegistry.
+ - Monitor updates posted by pvas::SharedPV to more than one subscriber carry a SharedUpdate.  Servers serialize such an update once, for each form, and send the same bytes to each subscriber receiving it unchanged.  Large updates are sent from the shared bytes by a gathering write.
+ - Servers limit slow clients.  A client is slow while more than EPICS_PVAS_MAX_SEND_QUEUE requests wait to be sent to it, or more than EPICS_PVAS_MAX_SEND_BYTES sent are not yet acknowledged (Linux and macOS).  Both default to 0, without limit.  EPICS_PVAS_SLOW_CLIENT_POLICY selects what is done: "squash" (default) holds and merges monitor updates until the client catches up, "drop" sends only the latest of the queued updates, marked as overrun, and "disconnect" closes the connection.  Actions are counted in the "transports" statistics.
+ - ChannelArray gets may be streamed.  With "record[chunk=N]" in the pvRequest, servers fetch and send the result of getArray() in parts of at most N elements, each once the previous is sent.  Clients pass each part but the last to the new ChannelArrayRequester::getArrayChunk(), which by default keeps it to be joined into the array passed to getArrayDone().
+ - pvas::SharedPV::post() to more than one subscriber makes one copy of the update, to which the queues of all subscribers refer.  Elements are copied on write, by MonitorElement::unshare(), when squashed in overflow.
+ - pvas::PostBatch collects post()s to many SharedPVs, then notifies their subscribers together on flush(), instead of once per post().
+ - pvas::SharedPV keeps its subscribers in a copy on write list, replaced when a subscription is created or destroyed.  post() notifies them from that list after unlocking, without allocating.
+ - pvas::StaticProvider gains bulk add() of a std::map of PVs, and remove() of a list of names, each with one lock.  createChannel() no longer holds the provider lock while connecting.
+ - pvas::SharedPV::getSubscriberStats() reports the queue state of each subscriber.  The new example pvspam serves many scalar, waveform or NTNDArray PVs updated at a set rate through PostBatch, and reports the post rate and the queues of subscribers.
+ - pv/pvAccessMB.h trace points are implemented: per-thread rings of TSC timestamps by stage, with statistics, CSV and JSON export.  Compiled into the codec, server and client get paths when built with WITH_MB=YES, otherwise the MB_* macros expand to nothing.
+ - USDT trace points of provider "pvaccess" for bpftrace, perf or SystemTap: transport connect and close, message headers received and sent, server request dispatch, MonitorFIFO post and poll, and client search rounds.  Compiled where sys/sdt.h is available, unless built with WITH_SDT=NO.
+ - New benchmark program testApp benchPVA runs get, put, monitor, rpc and connect over sweeps of channel count, array size, monitor queue size, and in-process or loopback transport, and prints one line of JSON per result.  scripts/benchcompare.py compares two result files and fails on regressions.
+ - Servers with EPICS_PVAS_STATS_PREFIX set serve their own metrics as NTTable PVs, updated every EPICS_PVAS_STATS_PERIOD (default 1) seconds: <prefix>:stats:channels, the top EPICS_PVAS_STATS_TOP (default 20) channels by bytes sent per second, with monitor updates and overruns; <prefix>:stats:clients, the traffic, send queue depth and slow consumer actions of each client; and <prefix>:stats:latency, percentiles of the time from request to reply for each kind of operation.
+ - Counters of servers, clients, MonitorFIFO and RPC services may be scraped by Prometheus.  EPICS_PVAS_METRICS_PORT (default -1, none) starts an HTTP endpoint answering GET /metrics in the text exposition format, with transports, channels, bytes sent and received by peer, messages received by command, search names handled and found, beacons, slow consumer actions, MonitorFIFO overflows, and RPC request counts and latency histograms.  See epics::pvAccess::MetricsSource to export others.
+ - Servers account the memory held for each client: the receive and send buffers, introspection registries and monitor queues, with SharedPV values and history.  Shown by pvasr level 2 and exported as pva_server_memory_bytes.  See epics::pvAccess::memoryUsage() for the estimate of a PVField.
+ - Optional tracing of get, put and RPC requests across clients, servers and gateways.  With EPICS_PVA_TRACE=YES at both ends, a W3C trace context is sent ahead of each request and response, and spans are recorded at issue, codec receive, provider dispatch and send.  EPICS_PVA_TRACE_FILE appends them as OpenTelemetry JSON.  Requests issued within a epics::pvAccess::TraceScope continue its trace.  Nothing is sent or recorded when disabled.
+ - stormPVA soak test of many client contexts in one process through mass connect and disconnect, a server restart, search floods and beacon storms.  Reports the time to full reconnect, and peak CPU and resident memory, as one line of JSON per storm.
+ - TCP receive and send threads are named for their peer, eg. "rx 10.1.2.3:5075", so that busy connections stand out in top and perf.  The CPU time of each is shown by the server report (level 2) and as pva_server_cpu_seconds_total.  With EPICS_PVAS_IO_THREADS, EPICS_PVA_CPU_STATS=YES counts the CPU time used by the reactor for each connection.
+ - epics::pvAccess::CachingChannelSecuritySession remembers the decisions of a security plugin for each operation on a channel, so that repeated gets and puts ask it once, until rightsChanged() or rightsChangedAll().  The server wraps the sessions of plugins with EPICS_PVAS_AUTHZ_CACHE=YES.
+ - The server no longer waits in its accept thread for each client to be validated.  A security plugin may complete authentication later, from its own thread, through SecurityPluginControl::authenticationCompleted(), without holding up other clients.  Connections not validated within 5 seconds are closed.
+ - With EPICS_PVAS_PUBLISH_THREADS set, a server starts listening before its providers have published their names, and publishes them in parallel on that many threads.  Until then, searches for these names are answered through channelFind().  pvas::StaticProvider publishes, and adds many PVs, in chunks, so that searches are answered meanwhile.
+ - pvas::PostQueue collects updates to many SharedPVs from any thread, such as the database event callbacks of an IOC, merges those to the same PV, and posts them together once per period.  pvas::PostBatch now wakes the transport of each subscriber once per flush(), instead of once per update.
+ - epics::pvAccess::ChannelBatchFind is an optional interface of a ChannelProvider which tests for many names with one call.  When all providers the server must search implement it, the names of a search request are passed together, and replies are only allocated for names found.  pvas::StaticProvider and pvas::DynamicProvider implement it, so a DynamicProvider::Handler sees all of the names of a request in one hasChannels() call.
+ - With EPICS_PVAS_BEACON_LOAD=YES, a server advertises its load (connections, cpu, queueDepth) in its beacons, through DefaultBeaconServerStatusProvider.  A client with EPICS_PVA_LOAD_BALANCE_WINDOW set to some seconds waits that long after the first server advertising load answers a search, and then connects to the least loaded of those which answered.
+ - With EPICS_PVA_STANDBY=YES, a client channel keeps a connection to a second server which answered its search.  When the connection to its server closes, the channel is created on the standby at once, without a search.
+ - With EPICS_PVA_ECHO_PERIOD set to some seconds, a client sends an echo request on a connection which has received nothing for that long, and tracks the round trip time of the replies.  A connection which does not answer within the larger of the period and the expected round trip time is unresponsive, and its channels become DISCONNECTED, or fail over to their standby connection.  They become CONNECTED again, without being re-created, when the server answers.  Also fixes the heartbeat timer, whose period was 1000 times too long.
+ - EPICS_PVA_MAX_ARRAY_BYTES and EPICS_PVAS_MAX_ARRAY_BYTES no longer enlarge the receive buffer of every connection, and are no longer needed for large arrays.  Messages and arrays larger than the receive buffer stream through it, while TCP flow control holds back the sender.  When set, they are a budget which may make the receive buffer smaller than EPICS_PVA_MAX_TCP_RECV.  Compressed segments larger than the receive buffer are refused before any allocation.  When not set, they now default to 0, no budget, instead of 16384, as that default would hold the receive buffer below EPICS_PVA_MAX_TCP_RECV.  ServerContext::getCurrentConfig() reports them as 0, where it used to report 16384.
+ - The priority of a channel, now an option (-P) of pvget and pvput, sets the thread priority of its connection, from epicsThreadPriorityCAServerLow at 0 to CAServerHigh at 99, on the client and the server.  A client connection above EPICS_PVA_REACTOR_MAX_PRIORITY (default 0) has its own I/O threads instead of those of EPICS_PVA_IO_THREADS.  EPICS_PVA_PRIORITY_DSCP, EPICS_PVA_PRIORITY_SNDBUF and EPICS_PVA_PRIORITY_RCVBUF set the DSCP marking and socket buffer sizes of priority classes, as a list of minPriority:value, eg. EPICS_PVA_PRIORITY_DSCP="0:8 50:46".
+ - The client schedules channel searches on a timer wheel.  A search timer tick only visits the channels due in it, instead of all of those not yet found, and registering or unregistering a channel no longer depends on how many are.  benchSearchSchedule measures these with 1M names.
+ - epics::pvAccess::TimerWheel, a hierarchical timing wheel, replaces the epics::pvData::Timer of client and server contexts for searches, beacons, search replies and connection timers.  Scheduling and cancelling take constant time however many timers are scheduled, and the timers due in a tick are run together.  Context::getTimer() now returns it.
+ - A server reuses the objects which reply to searches, from a pool of up to 1024, and reads the names of a search request into one reused string, instead of allocating for each name searched.
+ - A client finds the beacon handler of a server in a hash table instead of a std::map, and a beacon of a known server with nothing changed, the usual case, no longer takes a lock.  Beacons which were not as expected (server restarts, change count changes, sequence gaps and repeats) are counted, as pva_client_beacon_anomalies_total in the metrics of the client, with pva_client_beacon_servers.
+ - With EPICS_PVAS_UDP_SHARDS=N (default 1, at most 64), a server opens N of each of its UDP receive sockets, each with its own thread and its own search handler.  Unicast searches are spread over those bound to an interface address with SO_REUSEPORT, steered by receiving CPU on Linux.  As each socket bound to a broadcast or multicast address receives every datagram, each of those handles only its share, by a hash of the source and start of the datagram.  Not on Windows.  The SO_REUSEPORT group of an address and port is shared by all processes of the same user, so when several servers on one host are sharded, a unicast search may be received by any of them, which relays it to the others through local multicast, as when not sharded.
+ - A server takes all of the connections waiting in its listen backlog at once, of EPICS_PVAS_LISTEN_BACKLOG (default 128, was 4).  Before creating a transport it applies EPICS_PVAS_MAX_CONNECTIONS and EPICS_PVAS_MAX_CONNECTIONS_PER_HOST (default 0, no limit), closing a connection over either at once.  Counted as pva_server_connections_accepted_total and pva_server_connections_rejected_total.
+ - With EPICS_PVA_IO_URING=YES, a connection with its own receive and send threads (not with EPICS_PVAS_IO_THREADS or EPICS_PVA_IO_THREADS, nor TLS) receives and sends through io_uring instead of recv() and send(), with its buffers registered once.  Sends of at least EPICS_PVA_IO_URING_ZC_MIN bytes (default 64KB, 0 disables) are zero-copy.  Needs Linux >= 6.0, and falls back to recv() and send() where io_uring is not available.  The server report (level 2) marks these connections "io_uring".
+ - With EPICS_PVA_RDMA_RING_SIZE=N on both client and server (default 0, disabled), a connection between hosts with its own receive and send threads (not TLS) moves, once validated, to a pair of rings of N bytes written by RDMA (InfiniBand or RoCE) instead of the socket.  Data is placed in the ring of the receiver without a system call, and buffers are registered once.  EPICS_PVA_RDMA_DEVICE selects the device (default the first), and EPICS_PVA_RDMA_GID_INDEX the GID (default 0).  Needs a build with WITH_RDMA=YES (libibverbs), which is experimental and not the default.  The server report (level 2) marks these connections "rdma".  testRdmaRing moves a connection to rings over soft RoCE (rxe) when given EPICS_PVA_RDMA_TEST_ADDR, and skips that test otherwise.
+ - A class of connection priorities can trade CPU for latency.  With EPICS_PVA_PRIORITY_BUSY_POLL="minPriority:us", a receive thread of those connections polls with non-blocking recv() for up to us microseconds before blocking, with SO_BUSY_POLL set to the same.  With EPICS_PVA_PRIORITY_SEND_SPIN="minPriority:us" a send thread polls its send queue before sleeping.  EPICS_PVA_PRIORITY_RX_CPU and EPICS_PVA_PRIORITY_TX_CPU ("minPriority:cpu") pin these threads to a CPU (Linux only).  Only for connections with their own receive and send threads.
+ - EPICS_PVAS_CPU_AFFINITY pins the receive and send threads of server connections by the interface the client connected to, eg. "10.0.0.5=0-7 10.1.0.5=numa 8-15".  Each entry is [address=]cpus, where cpus is a list of CPUs, or numa for those of the NUMA node of the network interface.  The send and receive buffers of these connections are moved to the NUMA node of those CPUs.  Linux only, and not for connections sharing EPICS_PVAS_IO_THREADS.
+ - A server remembers the introspection a provider returned for each sub-field of a channel, and answers a repeated GET_FIELD for it without asking the provider again.  Up to 16 sub-fields are kept per channel, until it is disconnected, as the type of a channel only changes while disconnected (eg. SharedPV close() and open()).
+ - The client remembers the result of getField() for each sub-field of a connected channel, and answers a repeated request immediately, without a round trip to the server.  Up to 16 sub-fields are kept per channel, and forgotten whenever it disconnects.
+ - A GET of a pvas::SharedPV whose value has not changed since an earlier GET of the same form, on the same channel, sends the bytes serialized for that earlier one.  Providers may implement ChannelRequest::getGeneration() to allow this.
+ - pvas::SharedPV reuses the pvas::Operation of a completed put for the next put through the same channel, so that a client putting at a high rate no longer allocates an operation, and its changed mask, for each.
+ - A ChannelGet or ChannelPut may have several get() and put() outstanding, answered and completed in the order made.  A server accepts up to EPICS_PVA_PIPELINE_WINDOW (default 1, off) requests per operation and tells its clients so.  A client sends up to the lesser of its own and the window of the server, the first one pending and the rest after it, and refuses more.  So both must set it above 1.  With either at 1, or an older peer, one request at a time, and a second refused as "other request pending", as before.
+ - An idle client channel takes less memory.  State used only by some channels (the getField() cache, EPICS_PVA_STANDBY, and the server cache) is allocated when first needed, and channels of the same name share one copy of their name.  With EPICS_PVA_COMPACT_CHANNELS=YES, channels lock one of 256 pairs of mutexes of their context, chosen by channel ID, instead of a pair of their own.  The reftrack counter "InternalChannelImpl (Bytes)" counts the memory of the client channels.
+ - A server channel, and a monitor, takes less memory.  The names of channels (the ServerChannelRequesterImpl, and pvas::SharedPV channels) are kept once for all clients of a PV by the new InternedName.  The getField() cache and GET response cache of a ServerChannel are allocated when first used.  The window of a pipelined monitor is a ring instead of a std::list, and a MonitorFIFO without pipeline no longer reserves its returned queue.  benchServerMemory shows the heap bytes per channel and monitor.
+ - InternedName keeps a hash computed once, and is copied and released (other than the last of a name) with atomic operations instead of a lock.  The ChannelNameIndex of a server keeps its names as InternedName, shared with the channels of those names.  A client keeps the names of a search frame for name servers as InternedName, shared with its channels, instead of copying them.
+ - A monitor requested with record[arrayDelta=true] receives its changed numeric arrays as the ranges which differ from the value sent before, and the client patches its copy.  Arrays are sent whole the first time, and when the ranges would be half the array or more.  The server flags such updates with QOS_DELTA, so older servers, which ignore the option, and older clients, which never ask, exchange whole arrays as before.
+ - Monitor updates, and GET responses, of structures of 64 fields or more are serialized and deserialized by going from one changed field to the next, through a table of where each field of a Structure is kept once per type (FieldOffsets), instead of visiting every field of each structure with a change inside.  The bytes are the same.  For an NTTable of thousands of columns the cost of an update is now that of the columns changed.  benchFieldOffsets compares the two.
+ - The selection of fields of a pvRequest (RequestMask) is computed once for each type and form of request, and shared by the MonitorFIFO and pvas::SharedPV puts of all clients requesting alike, while the type is in use.  Computing one no longer looks up each field by offset.
+ - The replies of a server to CMD_ECHO and to the destruction of a channel are sent by senders reused from a SenderPool, instead of allocating a sender, and its shared_ptr, for each.  benchSenderPool compares the allocations per message of the two.
+ - pvas::ProxyProvider serves the PVs of another provider, eg. as a PVA to PVA gateway.  Each PV is subscribed upstream once, for the whole structure, and all downstream channels of the name share it, whatever their pvRequest.  Get and getField() are answered from the latest value, each downstream subscriber has its own queue (and may ask for record[rate=N]), and Put and RPC are forwarded unless read only.  Unused upstream subscriptions are cancelled after Config::idleHold seconds.
+ - pvac::MonitorGroup subscribes to a set of PVs, keeps the updates of each by timeStamp, and returns them as a Snapshot once every member has an update of that time.  A snapshot lacking members is returned after Options::timeout, or as soon as the members missing have moved on to later times.  The values are those received, not copies.
+ - pvac::MonitorMerge subscribes to many PVs and returns their updates as one stream in timeStamp order, by a k-way merge of the queue of each member.  Each update is held for Options::window seconds, so that those of earlier times arriving later are taken before it.  wait() takes them in batches.
+ - The messages a server or client reads together are all processed before it wakes its sender or calls monitorEvent() (detail::ReceiveBatch).  When a client starts many monitors on one connection, the server answers the INIT requests, and sends the first values, read together in one pass of its sender, serialized back to back and flushed together, and the client deserializes the updates read together in one loop, then calls the monitorEvent() of each monitor once.  The messages are unchanged, so either end may be older.
+ - Traffic capture: with EPICS_PVA_CAPTURE_DIR set, each TCP transport records the bytes it receives, with the time of each read, to a .pvacap file in that directory (TrafficCapture).  pvreplay sends a capture back, to a server, or to a client which connects to it, at the recorded pace, N times faster, or as fast as possible, and reports the replies, for repeatable benchmarks of real traffic.
+ - pvas::LazyProvider creates the SharedPV of a name when a channel to it is first opened, by Handler::materialize(), and answers searches without creating anything.  PVs left without channels for Config::idleHold seconds are evicted, except the Config::warmPool most recently used, and the idle PVs are kept within Config::maxBytes by evicting those idle longest.  So a server of millions of possible names keeps only those in use.  DynamicProvider::Handler::createChannel() may now return NULL, which fails the channel with "No such channel".
+ - MonitorFIFO::saturated() is true while a post() would only be squashed into the last update queued, and MonitorFIFO::Source::unsaturated() is called when the FIFO has room again.  pvas::SharedPV::post() skips each saturated subscriber, remembering the fields changed, and sends it the current value with those fields when it has room, so a slow subscriber no longer costs a copy of each update, and none are copied when all are saturated.  The CA provider keeps the latest update unconverted while the queue of a monitor is full.
+ - With EPICS_PVA_RECONNECT_RATE set to N, the client sends the create requests of channels connecting again, eg. after their server restarted, at most N each second (ReconnectPacer), instead of all as soon as their searches are answered.  Those of the highest priority go first, then those with the most operations to re-establish.  The rate starts at N/4, rises to N while the server answers creates as quickly as before, and is halved while it answers twice as slowly.  The rate and the channels waiting are shown by printInfo() and the pva_client_reconnect_rate and pva_client_reconnects_pending metrics.
+ - Client option EPICS_PVA_DECODE_THREADS=N, which may be given in the Configuration of a pvac::ClientProvider, deserializes the GET and MONITOR updates received by all TCP connections of the context with a pool of N threads, while the receive thread of each connection goes on to the next message.  So updates through one connection, eg. of large waveforms, are deserialized by up to N cores.  The updates of one operation are handled by one thread, in the order received.  INIT responses, which carry type descriptions, are still deserialized by the receive thread, after the updates received before them.  So are all updates of an operation whose type has a union, eg. NTNDArray (attribute[].value), as the values of a variant union carry their type.  As before, callbacks should not wait for replies from the server.
+ - Client option EPICS_PVA_CALLBACK_THREADS=N, which may be given in the Configuration of a pvac::ClientProvider, runs the callbacks of get(), put(), rpc() and monitor() on a pool of N threads, instead of the PVA threads which receive their events, so that a slow callback no longer holds up the other channels of its connection.  The callbacks of one channel are run by one thread, in order, and Operation::cancel() and Monitor::cancel() wait for those already queued.  Monitor Data events are coalesced while one is queued.  Connect callbacks are still called directly.  The queue is shown by the pva_client_callback_queue_depth, pva_client_callback_queue_depth_max, pva_client_callbacks_total and pva_client_callback_threads metrics.
+ - Updates of NTScalar and NTScalarArray with only value, alarm and timeStamp, the most common, are serialized and deserialized by routines specialized for the type of value (FastLayout), chosen once for each Structure, instead of by walking the PVField tree.  The bytes sent are unchanged.  Numeric arrays from a peer of the other byte order are swapped a buffer full at a time, with SSSE3, AVX2 or NEON when enabled by the compiler, instead of element by element.  benchFastLayout compares the two.
+ - Monitors keep the storage of the arrays they receive for reuse (ArrayPool).  A changed array which the queue element shares with the update before, or which the application still holds, is deserialized into storage from the pool, with the capacity of the longest seen in its field, instead of new storage.  It returns to the pool when the last reference is dropped.  Client option EPICS_PVA_ARRAY_POOL_BYTES limits the bytes each monitor keeps, default 16 MiB, and 0 disables the pool.
+ - Client and server option EPICS_PVA_HUGE_PAGES=2M, or 1G, takes the send and receive buffers of TCP connections (BufferPool), and the array storage of monitors (ArrayPool), from huge pages (HugePageAllocator), with a free list for each size class, instead of malloc().  Blocks of less than 512KB still use malloc(), and normal pages, aligned for transparent huge pages, are used when no reserved huge pages are left.  Another allocator may be installed with BufferPool::setAllocator(), before the first connection.  The pages mapped are shown by printInfo().
+ - Requests run on the RequestPool of a ServerContext (EPICS_PVAS_REQUEST_THREADS) no longer allocate for each get, put, process or RPC.  Each requester queues its Work again while it is unchanged, and the pool keeps the queue of each request between its uses.  benchPVA prints the heap allocations of each operation (allocs_per_op), which benchcompare.py shows.
+ - Client and server option EPICS_PVA_RX_TIMESTAMPS=SOFTWARE, or HARDWARE, enables SO_TIMESTAMPING for TCP connections, on Linux.  Each message is stamped with when the kernel (or the interface) received the last bytes read, and the time until it is dispatched to its handler, and for get, put and RPC requests from dispatch until the response is written to the send buffer, are kept as histograms of the connection.  They are shown by the server printInfo() at level 2, and exported as the pva_server_received_dispatch_seconds, pva_server_dispatch_response_seconds and pva_client_received_dispatch_seconds metrics.  The span of a traced request starts when the kernel received it.  HARDWARE needs an interface configured for receive timestamps, with its clock synchronized to the system clock, and uses software timestamps where none is given.  Not with TLS, io_uring or the SHM and RDMA rings.
+ - pvac::PutBuilder::prepare() returns a PreparedPut, for puts repeated with the same fields.  It keeps the ChannelPut open, finds the fields named by set() once for the type of the channel, and keeps the structure sent, so that each exec() only converts the values given by PreparedPut::set() and sends them.  The fields are found again if the server changes the type.
+ - pvac::ClientProvider::processMany() and putGetMany() issue process or putGet on many channels at once, as getMany() and putMany(), with results by callback as each completes, or blocking until all complete.  The requests of getMany(), putMany(), processMany() and putGetMany() to each server are now queued with one wakeup of its connection, and sent together.
+ - Settings of the transport of a running server may be changed with ServerContext::tune(), or the iocsh command pvasTune(name, value), and listed with ServerContext::tunables(), or pvasTune with no arguments.  Coalescing (EPICS_PVA_COALESCE_*), compression (EPICS_PVA_COMPRESS_THRESHOLD), slow client limits (EPICS_PVAS_MAX_SEND_QUEUE, EPICS_PVAS_MAX_SEND_BYTES, EPICS_PVAS_SLOW_CLIENT_POLICY) and the EPICS_PVA_PRIORITY_* socket options are re-applied to open connections.  Buffer, segment and pipeline sizes apply to new connections.  The stats PVs (EPICS_PVAS_STATS_PREFIX) add <prefix>:stats:tunables, and with EPICS_PVAS_STATS_TUNE=YES, a put of "NAME=VALUE" to <prefix>:tune calls tune().
+ - pvas::SharedPV::setHistory(N) keeps the last N updates post()ed.  A new subscriber whose pvRequest includes record[history=S] first receives, in order, those posted in the last S seconds.
+ - Monitors (MonitorFIFO) and pvas::SharedPV Get apply the field selection of the pvRequest to each update with the new RequestMask.  An update marking a structure as changed, eg. a complete value, now copies and sends only the selected fields within it.
+ - MonitorFIFO keeps its elements in RingBuffer queues, with capacity reserved by open(), instead of std::list.  post(), poll() and release() no longer allocate, and elements added by tryPost(force) are kept for re-use.  MonitorElement instances are counted by reftrack.
+ - MonitorFIFO::poll() of an empty queue returns without locking, with EPICS Base >= 3.15.1.
+ - The remote client queues monitor updates in a RingBuffer reserved for the queue size, instead of std::queue, and poll() of an empty queue returns without locking.  testMonitorPerformance reports the client CPU time per update.
+ - Pipelined monitors accept record[pipeline=true,queueSize=N,maxQueueSize=M].  The client starts with a window of N updates, and doubles it, up to M, each time the server uses the whole window while the client has nothing left to process.  MonitorFIFO sizes its queue for M, bounded by Config::maxCount.
+ - pvac::ClientProvider::getMany() and putMany() issue get() or put() on many channels at once, with results by callback as each completes, or blocking until all complete.
+ - pvac::CompletionQueue runs client callbacks in an application thread.  Callbacks wrapped by its adapters are queued without locking, and run by drain(), eg. when fd() (an eventfd on Linux) becomes readable in an epoll, asio or Qt event loop.
+ - pvac::ClientChannel::getAsync() and rpcAsync() return a pvac::GetFuture, which may be wait()ed on, continued with then(), or, with C++20, co_await-ed.
+ - pvac::ClientProvider::shared() returns the process wide instance of a provider.  All ClientProviders so made share one channel cache, and the search managers and transports of ChannelProviderRegistry::getProvider().
+ - pvac::Monitor::pollBatch() takes many updates with one lock, and pvac::MonitorSync::waitBatch() waits for N updates or T seconds.
+ - pvac::MonitorSet queues the events of many subscriptions, so that one thread may wait() for those with data.
+ - Document that arrays of pvac::GetEvent::value and pvac::Monitor::root are frozen, so a shared_vector<const T> taken from them is never over-written.
+ - pvac::ClientChannel::getter() returns a pvac::Getter, for repeated get() with one server side operation.
+ - pvac::ClientChannel::Options::cacheAge serves blocking get() from a local copy kept by a subscription, which is cancelled after cacheIdle seconds unused.  Counted by pvac::ClientProvider::cacheStats().
+ - Clients with EPICS_PVA_CREATE_BATCH set above 1 send the create requests of channels connecting through one server together, up to that many in each CREATE_CHANNEL message.  The default of 1 is for servers before 6.1.0, which accept only one channel per request.
+ - Clients dispatch data responses without taking a reference to the context for each message, and copy no element shared_ptr while receiving a monitor update.
+ - Client option EPICS_PVA_IO_THREADS=N, which may be given in the Configuration of a pvac::ClientProvider, services all TCP connections of the context with a pool of N epoll()/kqueue() threads instead of two threads per connection.  Reactor instances and threads are counted by reftrack as "IOReactor" and "IOReactor (threads)".
+ - The ca provider runs monitor events, and get and put completions, on EPICS_PVA_CA_NOTIFY_THREADS threads each (default 1), chosen by channel so that the notifications of one channel stay in order.  epics::pvAccess::ca::CAClientFactory::show() prints the queue depths of each thread.
+ - ca provider monitors copy each CA update, and convert it to a PVStructure on the notification thread.  While that thread is behind, a newer update replaces one not yet converted, and is marked as overrun.
+ - ca provider gets and monitors find the fields of the PVStructure, and the DBR conversion functions, once for the first update instead of for every update.  Arrays with the same element size in CA and pvData are copied with memcpy().
+ - ca provider option EPICS_PVA_CA_FLUSH_DELAY, in seconds, delays the ca_flush_io() after a get, put or monitor start, so that the requests issued within that time, eg. by pvac::ClientProvider::getMany(), are sent together.  The default of 0 flushes after each request.
+ - ca provider monitors subscribe to the CA events named by the pvRequest option DBE, eg. "record[DBE=value,alarm,property]field()".  Names are value, archive (ADEL deadband), alarm and property.  The default is value, as before.
+ - Channels of the ca provider with the same name and priority share one CA channel, and their monitors of the same DBR type and event mask share one CA subscription.  A monitor joining a subscription starts with a copy of its latest update.
+ - Creating many channels of the ca provider no longer takes time quadratic in their number, and their searches share a flush when EPICS_PVA_CA_FLUSH_DELAY is set.
+ - RPCServer option EPICS_PVA_RPC_THREADS=N runs the request() of synchronous RPCService instances on a pool of N threads, so that a slow request does not delay the other messages of its client connection.  RPCServer::registerService() accepts a limit on the concurrent requests of one RPCService, and RPCServer::printInfo() shows the queue of the pool.
+ - RPCClient::issuePipelined() and waitResponse(id, timeout) allow many requests of one client to be outstanding at once, each on a ChannelRPC of its own.
+ - RPCCacheService wraps an idempotent RPCServiceAsync, answering requests with equal arguments from an LRU cache of replies with a time to live, and coalescing concurrent equal requests into one backend request.  stats() and show() give the hit rate.
+ - RPCServer and PipelineServer test a channel name against all wildcard service names at once, with the new WildcardSet, instead of against each pattern in turn.  Re-registering a wildcard service name now replaces the service found by it.
+ - SharedPipelineService, or PipelineServer::registerService() with a SlowConsumerPolicy, lets all clients of a pipeline service share one PipelineSession.  Each client has its own flow control.  With Block the session is paced by the slowest client, with Drop slow clients miss elements.
+ - PipelineControl::getFreeElements() and putElements() hand over a batch of elements with one lock of the client queue and one notification.  The existing getFreeElement() and putElement() remain, and are the default implementation of the batch methods.
+ - RPCClient::createShared() makes clients which share a connected channel with other clients of the same service, kept for reuse after they are destroyed.  RPCClient::requestMany() pipelines a batch of requests and waits for all of their responses.
+ - StreamingRPCService is a pipeline service answering a request with arguments by a flow controlled stream of elements, instead of a single RPC reply.  Clients pass the arguments with the pvRequest of createStreamRequest().
+ - RPCServer keeps request, error and in progress counts, and histograms of the queueing and execution time, for each registered service.  They are reported by RPCServer::printInfo(), by the new built-in service "rpc.stats" as an NTTable, and by RPCServer::report(), which the new iocsh command rpcsr calls.  LatencyHistogram is the log-linear histogram used.
+ - RPCServiceAsync::getArgumentType() lets a service declare the type of its arguments.  Requests with arguments of another type then fail before reaching the service, and the server decodes the arguments of each client channel into a PVStructure which it re-uses once the previous request no longer holds it.  ChannelRPC::getArgumentType() carries the declaration from the service to the server.
+ - The outgoing introspection registry of each connection finds an already sent type by identity, or by a hash of its structure, instead of comparing it with every type sent before.  Servers with many distinct types, such as an NTTable per device, no longer slow down with each new type.  testApp/utils/benchIntrospectionRegistry compares both with 10000 types.
+ - Structure and union types received by any connection are interned in a process-wide table of weak references, so that equal types served by many peers share one Field instance.  Comparisons of such types, as by SharedPV::post() and MonitorFIFO, then succeed by identity.
+ - The introspection registry size advertised by each peer during connection validation is now applied.  When the ids allowed by the peer are all in use, the id of the least recently sent type is re-assigned, by sending the new type in full with that id, so memory stays bounded while frequently sent types keep their ids.
+ - mpsc_queue is an intrusive queue in which many producers push with a compare and swap, and one consumer takes all pushed entries at once, or with pop_all().  An entry already queued is not added again, and producers signal only a waiting consumer.  testFairQueue compares it with fair_queue under contention.
+ - pvAccessSetLogAsync() moves the writing of pvAccessLog() messages to a background thread, fed by a lock-free ring of formatted messages which drops, and counts, messages while full.  pvAccessSetLogRateLimit() limits the messages of each call site per second, reporting how many were suppressed, and pvAccessSetLogFormat() selects key=value output.  The iocsh command pvaLogConfig sets all three.
+ - LOG() and IS_LOGGABLE() test the level inline, before formatting any argument.  Messages below PVA_LOG_MIN_LEVEL, set in configure/CONFIG_SITE, are removed when compiling.
 
 Release 6.0.0 (Dec 2017)
 ========================
@@ -0,0 +1,478 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+/* A load source.  Serves many PVs, each updated at a fixed rate,
+ * and reports how quickly updates are posted and how well subscribers keep up.
+ *
+ * Unlike spamme, which posts to each subscriber as fast as it returns elements,
+ * this uses pvas::SharedPV as a real server would, so that all subscribers
+ * to a PV share its updates.  Posts to all PVs in one period are collected
+ * by a pvas::PostBatch, which wakes the server once per batch.
+ *
+ *   pvspam -n 1000 -r 10 spam:       # 1000 scalars at 10 Hz, spam:0 ... spam:999
+ *   pvspam -t wave -s 100000 spam:   # one waveform of 100000 doubles, as fast as possible
+ *   pvspam -t image -s 1024 -r 30 -v cam:  # 1024x1024 8 bit NTNDArray at 30 Hz
+ */
+
+#include <vector>
+#include <map>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <exception>
+
+#if !defined(_WIN32)
+#include <signal.h>
+#define USE_SIGNAL
+#endif
+
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsAtomic.h>
+#include <epicsGetopt.h>
+
+#include <pv/pvData.h>
+#include <pv/standardField.h>
+#include <pv/serverContext.h>
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+epicsEvent done;
+
+#ifdef USE_SIGNAL
+void alldone(int num)
+{
+    (void)num;
+    done.signal();
+}
+#endif
+
+enum Kind { Scalar, Wave, Image };
+
+pvd::StructureConstPtr buildType(Kind kind)
+{
+    pvd::FieldCreatePtr create(pvd::getFieldCreate());
+    pvd::StandardFieldPtr standard(pvd::getStandardField());
+
+    switch(kind) {
+    case Scalar:
+        return create->createFieldBuilder()
+                ->setId("epics:nt/NTScalar:1.0")
+                ->add("value", pvd::pvDouble)
+                ->add("alarm", standard->alarm())
+                ->add("timeStamp", standard->timeStamp())
+                ->createStructure();
+    case Wave:
+        return create->createFieldBuilder()
+                ->setId("epics:nt/NTScalarArray:1.0")
+                ->addArray("value", pvd::pvDouble)
+                ->add("alarm", standard->alarm())
+                ->add("timeStamp", standard->timeStamp())
+                ->createStructure();
+    case Image:
+        break;
+    }
+
+    pvd::FieldBuilderPtr fb(create->createFieldBuilder());
+    for(int i=pvd::pvBoolean; i<pvd::pvString; i++) {
+        pvd::ScalarType st = static_cast<pvd::ScalarType>(i);
+        fb->addArray(std::string(pvd::ScalarTypeFunc::name(st)) + "Value", st);
+    }
+    pvd::UnionConstPtr valueType(fb->createUnion());
+
+    return fb->setId("epics:nt/NTNDArray:1.0")
+            ->add("value", valueType)
+            ->addNestedStructure("codec")
+                ->setId("codec_t")
+                ->add("name", pvd::pvString)
+                ->add("parameters", create->createVariantUnion())
+            ->endNested()
+            ->add("compressedSize", pvd::pvLong)
+            ->add("uncompressedSize", pvd::pvLong)
+            ->addNestedStructureArray("dimension")
+                ->setId("dimension_t")
+                ->add("size", pvd::pvInt)
+                ->add("offset", pvd::pvInt)
+                ->add("fullSize", pvd::pvInt)
+                ->add("binning", pvd::pvInt)
+                ->add("reverse", pvd::pvBoolean)
+            ->endNested()
+            ->add("uniqueId", pvd::pvInt)
+            ->add("dataTimeStamp", standard->timeStamp())
+            ->add("alarm", standard->alarm())
+            ->add("timeStamp", standard->timeStamp())
+            ->createStructure();
+}
+
+// A few arrays, prepared once, which updates take turns to post.
+// Posting a frozen array copies a reference, so the cost measured is that of the server.
+struct ArrayPool {
+    std::vector<pvd::PVDoubleArray::const_svector> waves;
+    std::vector<pvd::PVUByteArray::const_svector> images;
+    size_t bytes; // of each
+
+    ArrayPool() :bytes(0u) {}
+
+    void build(Kind kind, size_t size)
+    {
+        if(kind==Wave) {
+            for(size_t n=0; n<4u; n++) {
+                pvd::shared_vector<double> arr(size);
+                for(size_t i=0; i<size; i++)
+                    arr[i] = double(i+n);
+                waves.push_back(pvd::freeze(arr));
+            }
+            bytes = size*sizeof(double);
+
+        } else if(kind==Image) {
+            for(size_t n=0; n<4u; n++) {
+                pvd::shared_vector<pvd::uint8> arr(size*size);
+                for(size_t i=0; i<arr.size(); i++)
+                    arr[i] = pvd::uint8(i/size + i%size + n*64u);
+                images.push_back(pvd::freeze(arr));
+            }
+            bytes = size*size;
+
+        } else {
+            bytes = sizeof(double);
+        }
+    }
+};
+
+struct SpamPV {
+    pvas::SharedPV::shared_pointer pv;
+    pvd::PVStructurePtr value;
+    pvd::BitSet changed;
+    pvd::PVScalarPtr counter; // value, or uniqueId of an image
+    pvd::PVDoubleArrayPtr wave;
+    pvd::PVUByteArrayPtr image; // selected member of the value union
+    pvd::PVScalarPtr secs, nsec;
+
+    SpamPV(Kind kind, const pvd::StructureConstPtr& type, size_t size)
+        :pv(pvas::SharedPV::buildReadOnly())
+        ,value(pvd::getPVDataCreate()->createPVStructure(type))
+        ,secs(value->getSubFieldT<pvd::PVScalar>("timeStamp.secondsPastEpoch"))
+        ,nsec(value->getSubFieldT<pvd::PVScalar>("timeStamp.nanoseconds"))
+    {
+        if(kind==Scalar) {
+            counter = value->getSubFieldT<pvd::PVScalar>("value");
+            changed.set(counter->getFieldOffset());
+
+        } else if(kind==Wave) {
+            wave = value->getSubFieldT<pvd::PVDoubleArray>("value");
+            changed.set(wave->getFieldOffset());
+
+        } else {
+            pvd::PVUnionPtr sel(value->getSubFieldT<pvd::PVUnion>("value"));
+            image = sel->select<pvd::PVUByteArray>("ubyteValue");
+            changed.set(sel->getFieldOffset());
+
+            counter = value->getSubFieldT<pvd::PVScalar>("uniqueId");
+            changed.set(counter->getFieldOffset());
+
+            value->getSubFieldT<pvd::PVScalar>("compressedSize")->putFrom<pvd::int64>(size*size);
+            value->getSubFieldT<pvd::PVScalar>("uncompressedSize")->putFrom<pvd::int64>(size*size);
+
+            pvd::PVStructureArrayPtr dims(value->getSubFieldT<pvd::PVStructureArray>("dimension"));
+            pvd::PVStructureArray::svector D(2u);
+            for(size_t i=0; i<D.size(); i++) {
+                D[i] = pvd::getPVDataCreate()->createPVStructure(dims->getStructureArray()->getStructure());
+                D[i]->getSubFieldT<pvd::PVScalar>("size")->putFrom<pvd::int32>(size);
+                D[i]->getSubFieldT<pvd::PVScalar>("fullSize")->putFrom<pvd::int32>(size);
+                D[i]->getSubFieldT<pvd::PVScalar>("binning")->putFrom<pvd::int32>(1);
+            }
+            dims->replace(pvd::freeze(D));
+        }
+        changed.set(value->getSubFieldT<pvd::PVStructure>("timeStamp")->getFieldOffset());
+    }
+};
+
+struct Spammer : public epicsThreadRunable
+{
+    std::vector<SpamPV*> pvs;
+    const ArrayPool& pool;
+    const double period; // seconds, or 0 for as fast as possible
+    const size_t batchSize; // posts per flush(), or 0 for all PVs
+    size_t nposts, nflushes, nbytes, nlate; // updated with epicsAtomic
+    volatile bool stop;
+    epicsEvent wakeup;
+    epicsThread worker;
+
+    Spammer(const ArrayPool& pool, double rate, size_t batchSize)
+        :pool(pool)
+        ,period(rate>0.0 ? 1.0/rate : 0.0)
+        ,batchSize(batchSize)
+        ,nposts(0u), nflushes(0u), nbytes(0u), nlate(0u)
+        ,stop(false)
+        ,worker(*this, "pvspam",
+                epicsThreadGetStackSize(epicsThreadStackSmall),
+                epicsThreadPriorityMedium)
+    {}
+    virtual ~Spammer()
+    {
+        for(size_t i=0; i<pvs.size(); i++)
+            delete pvs[i];
+    }
+
+    void close()
+    {
+        stop = true;
+        wakeup.signal();
+        worker.exitWait();
+    }
+
+    virtual void run() OVERRIDE FINAL
+    {
+        pvas::PostBatch batch;
+        epicsTime next(epicsTime::getCurrent());
+        pvd::uint32 count = 0u;
+
+        while(!stop) {
+            epicsTimeStamp now;
+            epicsTimeGetCurrent(&now);
+
+            size_t unflushed = 0u;
+
+            for(size_t i=0; i<pvs.size(); i++) {
+                SpamPV& P = *pvs[i];
+
+                if(P.counter)
+                    P.counter->putFrom<pvd::uint32>(count);
+                if(P.wave)
+                    P.wave->replace(pool.waves[count%pool.waves.size()]);
+                if(P.image)
+                    P.image->replace(pool.images[count%pool.images.size()]);
+                P.secs->putFrom<pvd::int64>(pvd::int64(now.secPastEpoch) + POSIX_TIME_AT_EPICS_EPOCH);
+                P.nsec->putFrom<pvd::uint32>(now.nsec);
+
+                batch.post(*P.pv, *P.value, P.changed);
+
+                if(batchSize && ++unflushed>=batchSize) {
+                    batch.flush();
+                    epics::atomic::increment(nflushes);
+                    unflushed = 0u;
+                }
+            }
+            if(unflushed || !batchSize) {
+                batch.flush();
+                epics::atomic::increment(nflushes);
+            }
+
+            epics::atomic::add(nposts, pvs.size());
+            epics::atomic::add(nbytes, pvs.size()*pool.bytes);
+            count++;
+
+            if(period>0.0) {
+                next += period;
+                double delay = next - epicsTime::getCurrent();
+                if(delay>0.0) {
+                    wakeup.wait(delay);
+                } else {
+                    epics::atomic::increment(nlate);
+                    if(delay < -1.0)
+                        next = epicsTime::getCurrent(); // too far behind.  don't try to catch up.
+                }
+            }
+        }
+    }
+};
+
+// Queue state of all subscribers, summed over all PVs
+struct QueueSummary {
+    size_t subscribers, queued, maxQueued, full, minFree;
+    QueueSummary() :subscribers(0u), queued(0u), maxQueued(0u), full(0u), minFree(0u) {}
+
+    void collect(const std::vector<SpamPV*>& pvs)
+    {
+        std::vector<pvas::SharedPV::SubscriberStats> stats;
+        for(size_t i=0; i<pvs.size(); i++) {
+            stats.clear();
+            pvs[i]->pv->getSubscriberStats(stats);
+            for(size_t s=0; s<stats.size(); s++) {
+                const size_t depth = stats[s].nfilled + stats[s].noutstanding;
+                queued += depth;
+                if(maxQueued < depth)
+                    maxQueued = depth;
+                if(stats[s].nempty==0u)
+                    full++;
+                if(subscribers==0u || minFree > stats[s].nempty)
+                    minFree = stats[s].nempty;
+                subscribers++;
+            }
+        }
+    }
+};
+
+void usage(const char *argv0)
+{
+    std::cout<<"Usage: "<<argv0<<" [-n <count>] [-t scalar|wave|image] [-s <size>] [-r <Hz>] [-b <batch>] [-i <sec>] [-v] <prefix>\n"
+               "\n"
+               "Serve <count> PVs named <prefix>0, <prefix>1, ..., each updated <Hz> times a second.\n"
+               "\n"
+               "  -n <count>  Number of PVs.  (default 1)\n"
+               "  -t <type>   scalar (double), wave (<size> doubles) or image (<size>x<size> 8 bit NTNDArray).  (default scalar)\n"
+               "  -s <size>   Array length, or image width and height.  (default 1024)\n"
+               "  -r <Hz>     Update rate of each PV.  0 posts as fast as possible.  (default 1)\n"
+               "  -b <batch>  Flush posts to subscribers after this many.  0 flushes once for all PVs.  (default 0)\n"
+               "  -i <sec>    Report interval.  (default 5)\n"
+               "  -v          Also show the server, with per connection send statistics, each report.\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    try {
+        size_t count = 1u, size = 1024u, batchSize = 0u;
+        double rate = 1.0, interval = 5.0;
+        Kind kind = Scalar;
+        bool verbose = false;
+
+        int opt;
+        while((opt = getopt(argc, argv, "hn:t:s:r:b:i:v")) != -1) {
+            switch(opt) {
+            case 'n':
+                count = pvd::castUnsafe<size_t, std::string>(optarg);
+                break;
+            case 't': {
+                std::string T(optarg);
+                if(T=="scalar")
+                    kind = Scalar;
+                else if(T=="wave")
+                    kind = Wave;
+                else if(T=="image")
+                    kind = Image;
+                else {
+                    std::cerr<<"Unknown type '"<<T<<"'\n";
+                    return 1;
+                }
+            }
+                break;
+            case 's':
+                size = pvd::castUnsafe<size_t, std::string>(optarg);
+                break;
+            case 'r':
+                rate = pvd::castUnsafe<double, std::string>(optarg);
+                break;
+            case 'b':
+                batchSize = pvd::castUnsafe<size_t, std::string>(optarg);
+                break;
+            case 'i':
+                interval = pvd::castUnsafe<double, std::string>(optarg);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 1;
+            }
+        }
+
+        if(optind+1!=argc) {
+            usage(argv[0]);
+            return 1;
+        } else if(count==0u || size==0u || interval<=0.0) {
+            std::cerr<<"-n, -s and -i must be positive\n";
+            return 1;
+        }
+        const std::string prefix(argv[optind]);
+
+        pvd::StructureConstPtr type(buildType(kind));
+        ArrayPool pool;
+        pool.build(kind, size);
+
+        Spammer spam(pool, rate, batchSize);
+
+        pvas::StaticProvider provider("pvspam");
+        {
+            std::map<std::string, pvas::StaticProvider::ChannelBuilder::shared_pointer> builders;
+            for(size_t i=0; i<count; i++) {
+                SpamPV *P = new SpamPV(kind, type, size);
+                spam.pvs.push_back(P);
+                P->pv->open(*P->value);
+
+                std::ostringstream name;
+                name<<prefix<<i;
+                builders[name.str()] = P->pv;
+            }
+            provider.add(builders);
+        }
+
+        pva::ServerContext::shared_pointer server(pva::ServerContext::create(
+                                                      pva::ServerContext::Config()
+                                                      .provider(provider.provider())
+                                                      ));
+
+#ifdef USE_SIGNAL
+        signal(SIGINT, alldone);
+        signal(SIGTERM, alldone);
+        signal(SIGQUIT, alldone);
+#endif
+        server->printInfo();
+
+        std::cout<<"Serving "<<count<<" PVs "<<prefix<<"0 ... "<<prefix<<(count-1u)
+                 <<", "<<pool.bytes<<" bytes each update\n";
+
+        spam.worker.start();
+
+        epicsTime last(epicsTime::getCurrent());
+        size_t lastPosts = 0u, lastFlushes = 0u, lastBytes = 0u, lastLate = 0u;
+
+        while(!done.wait(interval)) {
+            const epicsTime now(epicsTime::getCurrent());
+            const double dT = now - last;
+            last = now;
+
+            const size_t posts = epics::atomic::get(spam.nposts),
+                         flushes = epics::atomic::get(spam.nflushes),
+                         bytes = epics::atomic::get(spam.nbytes),
+                         late = epics::atomic::get(spam.nlate);
+
+            QueueSummary Q;
+            Q.collect(spam.pvs);
+
+            const double postRate = (posts-lastPosts)/dT;
+
+            const double byteRate = (bytes-lastBytes)/dT/1e6;
+
+            // each subscriber is sent every update of its PV, unless its queue overflows
+            std::cout<<std::fixed<<std::setprecision(0)
+                     <<postRate<<" posts/s "<<std::setprecision(1)<<byteRate<<" MB/s in "
+                     <<std::setprecision(0)<<(flushes-lastFlushes)/dT<<" flushes/s, "
+                     <<(late-lastLate)<<" late.  "
+                     <<Q.subscribers<<" subscribers, est. "<<postRate/count*Q.subscribers<<" updates/s "
+                     <<std::setprecision(1)<<byteRate/count*Q.subscribers<<" MB/s sent.  "
+                     <<"queued "<<Q.queued<<" (max "<<Q.maxQueued<<"), "
+                     <<Q.full<<" full, min free "<<Q.minFree<<std::endl;
+
+            if(verbose)
+                server->printInfo(std::cout, 2);
+
+            lastPosts = posts;
+            lastFlushes = flushes;
+            lastBytes = bytes;
+            lastLate = late;
+        }
+
+        spam.close();
+        server->shutdown();
+
+    } catch(std::exception& e){
+        std::cerr<<"Error: "<<e.what()<<"\n";
+        return 1;
+    }
+    return 0;
+}
@@ -183,6 +183,132 @@ size_t getLongestString(PVScalarArrayPtr const & array)
     return max;
 }
 
+// Formats the elements of one table column, without converting the whole column.
+// Integer and floating point columns are formatted from a typed view of the array,
+// others, and streams with unusual flags, through PVScalarArray::dumpValue().
+class TableColumn
+{
+    PVScalarArrayPtr array;
+    ScalarType type;
+    size_t length;
+    shared_vector<const void> raw;
+    bool fast;
+    int precision;
+    std::ostringstream strm;
+    std::string text;
+    char buf[64];
+
+    template<typename T>
+    void take()
+    {
+        shared_vector<const T> typed;
+        array->getAs(typed);
+        raw = static_shared_vector_cast<const void>(typed);
+    }
+
+    template<typename T>
+    T get(size_t r) const { return static_cast<const T*>(raw.data())[r]; }
+
+public:
+    TableColumn(PVScalarArrayPtr const & array, std::ostream& o)
+        :array(array)
+        ,type(array ? array->getScalarArray()->getElementType() : pvString)
+        ,length(array ? array->getLength() : 0)
+        ,fast(false)
+        ,precision(int(o.precision()))
+    {
+        strm.flags(o.flags());
+        strm.precision(o.precision());
+
+        // anything but the defaults is left to dumpValue()
+        const std::ios::fmtflags special = o.flags() & ~std::ios::dec &
+                (std::ios::basefield | std::ios::floatfield | std::ios::showpos |
+                 std::ios::showpoint | std::ios::uppercase);
+        if (!array || special)
+            return;
+
+        fast = true;
+        switch (type)
+        {
+        case pvShort:  take<int16>(); break;
+        case pvUShort: take<uint16>(); break;
+        case pvInt:    take<int32>(); break;
+        case pvUInt:   take<uint32>(); break;
+        case pvLong:   take<int64>(); break;
+        case pvULong:  take<uint64>(); break;
+        case pvFloat:  take<float>(); break;
+        case pvDouble: take<double>(); break;
+        default:       fast = false;
+        }
+    }
+
+    size_t size() const { return length; }
+
+    // text of element r, or empty past the end.  Valid until the next call.
+    const char* at(size_t r, size_t& len)
+    {
+        if (r >= length)
+        {
+            len = 0;
+            return "";
+        }
+
+        if (!fast)
+        {
+            strm.str(std::string());
+            array->dumpValue(strm, r);
+            text = strm.str();
+            len = text.size();
+            return text.c_str();
+        }
+
+        int n;
+        switch (type)
+        {
+        case pvShort:  n = sprintf(buf, "%d", int(get<int16>(r))); break;
+        case pvUShort: n = sprintf(buf, "%u", unsigned(get<uint16>(r))); break;
+        case pvInt:    n = sprintf(buf, "%d", int(get<int32>(r))); break;
+        case pvUInt:   n = sprintf(buf, "%u", unsigned(get<uint32>(r))); break;
+        case pvLong:   n = sprintf(buf, "%lld", (long long)get<int64>(r)); break;
+        case pvULong:  n = sprintf(buf, "%llu", (unsigned long long)get<uint64>(r)); break;
+        case pvFloat:  n = sprintf(buf, "%.*g", precision, double(get<float>(r))); break;
+        default:       n = sprintf(buf, "%.*g", precision, get<double>(r)); break;
+        }
+        len = n > 0 ? size_t(n) : 0;
+        return buf;
+    }
+};
+
+// Collects output lines, and writes them in large blocks, instead of flushing each line
+class TableWriter
+{
+    std::ostream& o;
+    std::string buffer;
+public:
+    explicit TableWriter(std::ostream& o) :o(o) { buffer.reserve(64*1024); }
+    ~TableWriter() { flush(); }
+
+    void put(const char* text, size_t len) { buffer.append(text, len); }
+    void put(const std::string& text) { buffer.append(text); }
+    void put(char c) { buffer.push_back(c); }
+    void pad(size_t width, size_t len)
+    {
+        if (len < width)
+            buffer.append(width - len, ' ');
+    }
+    void endLine()
+    {
+        buffer.push_back('\n');
+        if (buffer.size() >= 60*1024)
+            flush();
+    }
+    void flush()
+    {
+        o.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+};
+
 // labels are optional
 // if provided labels.size() must equals columnData.size()
 void formatTable(std::ostream& o,
@@ -190,26 +316,31 @@ void formatTable(std::ostream& o,
                  vector<PVScalarArrayPtr> const & columnData,
                  bool showHeader, bool transpose)
 {
+    const bool aligned = (fieldSeparator == ' ');
+    size_t numColumns = columnData.size();
+
+    vector<TR1::shared_ptr<TableColumn> > columns(numColumns);
+    for (size_t i = 0; i < numColumns; i++)
+        columns[i].reset(new TableColumn(columnData[i], o));
+
     // array with maximum number of elements
     size_t maxValues = 0;
+    for (size_t i = 0; i < numColumns; i++)
+        maxValues = std::max(maxValues, columns[i]->size());
 
-    // value with longest string form
-    size_t maxLabelColumnLength = (showHeader && labels.size()) ? getLongestString(labels) : 0;
+    // value with longest string form, only needed to align columns
+    size_t maxLabelColumnLength = (aligned && showHeader && labels.size()) ? getLongestString(labels) : 0;
     size_t maxColumnLength = 0;
-    //
-    // get maxValue and maxColumnLength
-    //
-    size_t numColumns = columnData.size();
-    for (size_t i = 0; i < numColumns; i++)
+    if (aligned)
     {
-        PVScalarArrayPtr array = columnData[i];
-        if (array.get())
+        for (size_t i = 0; i < numColumns; i++)
         {
-            size_t arrayLength = array->getLength();
-            if (maxValues < arrayLength) maxValues = arrayLength;
-
-            size_t colLen = getLongestString(array);
-            if (colLen > maxColumnLength) maxColumnLength = colLen;
+            for (size_t r = 0, N = columns[i]->size(); r < N; r++)
+            {
+                size_t len;
+                columns[i]->at(r, len);
+                if (len > maxColumnLength) maxColumnLength = len;
+            }
         }
     }
 
@@ -217,6 +348,8 @@ void formatTable(std::ostream& o,
     size_t padding = 2;
     maxColumnLength += padding;
 
+    TableWriter out(o);
+
     if (!transpose)
     {
         /* non-compact
@@ -232,25 +365,23 @@ void formatTable(std::ostream& o,
         //   values     values   ...
         //
 
+        vector<size_t> widths(numColumns, maxColumnLength);
+        for (size_t i = 0; i < numColumns && i < labels.size(); i++)
+            widths[i] = std::max(labels[i].size()+padding, maxColumnLength);
+
         // first print labels
         if (showHeader && labels.size())
         {
             for (size_t i = 0; i < numColumns; i++)
             {
-                if (fieldSeparator == ' ')
-                {
-                    int width = std::max(labels[i].size()+padding, maxColumnLength);
-                    o << std::setw(width) << std::right;
-                    // non-compact o << std::setw(maxColumnLength) << std::right;
-                }
+                if (aligned)
+                    out.pad(widths[i], labels[i].size());
                 else if (i > 0)
-                {
-                    o << fieldSeparator;
-                }
+                    out.put(fieldSeparator);
 
-                o << labels[i];
+                out.put(labels[i]);
             }
-            o << std::endl;
+            out.endLine();
         }
 
         // then values
@@ -258,24 +389,17 @@ void formatTable(std::ostream& o,
         {
             for (size_t i = 0; i < numColumns; i++)
             {
-                if (fieldSeparator == ' ' && (showHeader || numColumns > 1))
-                {
-                    int width = std::max(labels[i].size()+padding, maxColumnLength);
-                    o << setw(width) << std::right;
-                    // non-compact o << std::setw(maxColumnLength) << std::right;
-                }
+                size_t len;
+                const char* text = columns[i]->at(r, len);
+
+                if (aligned && (showHeader || numColumns > 1))
+                    out.pad(widths[i], len);
                 else if (i > 0)
-                {
-                    o << fieldSeparator;
-                }
+                    out.put(fieldSeparator);
 
-                PVScalarArrayPtr array = columnData[i];
-                if (array.get() && r < array->getLength())
-                    array->dumpValue(o, r);
-                else
-                    o << "";
+                out.put(text, len);
             }
-            o << std::endl;
+            out.endLine();
         }
 
     }
@@ -292,29 +416,24 @@ void formatTable(std::ostream& o,
         {
             if (showHeader && labels.size())
             {
-                if (fieldSeparator == ' ')
-                {
-                    o << std::setw(maxLabelColumnLength) << std::left;
-                }
-                o << labels[i];
+                out.put(labels[i]);
+                if (aligned)
+                    out.pad(maxLabelColumnLength, labels[i].size());
             }
 
             for (size_t r = 0; r < maxValues; r++)
             {
-                if (fieldSeparator == ' ' && (showHeader || numColumns > 1))
-                {
-                    o << std::setw(maxColumnLength) << std::right;
-                }
+                size_t len;
+                const char* text = columns[i]->at(r, len);
+
+                if (aligned && (showHeader || numColumns > 1))
+                    out.pad(maxColumnLength, len);
                 else if (showHeader || r > 0)
-                    o << fieldSeparator;
+                    out.put(fieldSeparator);
 
-                PVScalarArrayPtr array = columnData[i];
-                if (array.get() && r < array->getLength())
-                    array->dumpValue(o, r);
-                else
-                    o << "";
+                out.put(text, len);
             }
-            o << std::endl;
+            out.endLine();
         }
 
     }
@@ -0,0 +1,210 @@
+#include "pvcapture.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <epicsGuard.h>
+#include <epicsEndian.h>
+
+#include <pv/serializeHelper.h>
+
+namespace {
+const char captureMagic[4] = {'P', 'V', 'A', 'C'};
+const epics::pvData::int8 captureVersion = 1;
+const size_t captureBufferSize = 64u*1024u;
+}
+
+CaptureWriter::CaptureWriter(std::ostream& strm)
+    :strm(strm)
+    ,buffer(captureBufferSize)
+{
+    buffer.put(captureMagic, 0, sizeof(captureMagic));
+    buffer.putByte(captureVersion);
+    buffer.putByte(buffer.getByteOrder()==EPICS_ENDIAN_BIG ? 0 : 1);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    flush();
+}
+
+void CaptureWriter::write(const std::string& name,
+                          const epics::pvData::PVStructure& value,
+                          const epics::pvData::BitSet& changed,
+                          const epics::pvData::BitSet& overrun)
+{
+    using namespace epics::pvData;
+    epicsGuard<epicsMutex> G(lock);
+
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+
+    const StructureConstPtr& type = value.getStructure();
+    channels_t::iterator it(channels.find(name));
+    if(it==channels.end()) {
+        Channel chan;
+        chan.id = channels.size();
+        it = channels.insert(std::make_pair(name, chan)).first;
+    }
+
+    if(it->second.type!=type) {
+        it->second.type = type;
+        ensureBuffer(1);
+        buffer.putByte('T');
+        SerializeHelper::writeSize(it->second.id, &buffer, this);
+        SerializeHelper::serializeString(name, &buffer, this);
+        type->serialize(&buffer, this);
+    }
+
+    ensureBuffer(1);
+    buffer.putByte('U');
+    SerializeHelper::writeSize(it->second.id, &buffer, this);
+    ensureBuffer(8);
+    buffer.putInt(int32(now.secPastEpoch));
+    buffer.putInt(int32(now.nsec));
+    changed.serialize(&buffer, this);
+    overrun.serialize(&buffer, this);
+    value.serialize(&buffer, this, &changed);
+}
+
+void CaptureWriter::flush()
+{
+    epicsGuard<epicsMutex> G(lock);
+    flushSerializeBuffer();
+    strm.flush();
+}
+
+void CaptureWriter::flushSerializeBuffer()
+{
+    buffer.flip();
+    strm.write(buffer.getArray(), buffer.getLimit());
+    buffer.clear();
+}
+
+void CaptureWriter::ensureBuffer(std::size_t size)
+{
+    if(buffer.getRemaining()<size)
+        flushSerializeBuffer();
+    if(buffer.getRemaining()<size)
+        throw std::logic_error("CaptureWriter::ensureBuffer() size too large");
+}
+
+void CaptureWriter::alignBuffer(std::size_t) {}
+
+bool CaptureWriter::directSerialize(epics::pvData::ByteBuffer *, const char* toSerialize,
+                                    std::size_t elementCount, std::size_t elementSize)
+{
+    // arrays go straight to the stream, after what is already buffered
+    flushSerializeBuffer();
+    strm.write(toSerialize, elementCount*elementSize);
+    return true;
+}
+
+void CaptureWriter::cachedSerialize(std::tr1::shared_ptr<const epics::pvData::Field> const & field,
+                                    epics::pvData::ByteBuffer* buffer)
+{
+    // no cache, each type is written in full
+    field->serialize(buffer, this);
+}
+
+CaptureReader::CaptureReader(std::istream& strm)
+    :strm(strm)
+    ,storage(captureBufferSize)
+    ,buffer(&storage[0], storage.size())
+{
+    buffer.setLimit(0);
+
+    char header[sizeof(captureMagic)+2];
+    if(!fill(sizeof(header)))
+        throw std::runtime_error("Not a PVA capture (too short)");
+    buffer.get(header, 0, sizeof(header));
+    if(memcmp(header, captureMagic, sizeof(captureMagic))!=0)
+        throw std::runtime_error("Not a PVA capture");
+    if(header[4]!=captureVersion)
+        throw std::runtime_error("Unsupported PVA capture version");
+    buffer.setEndianess(header[5] ? EPICS_ENDIAN_LITTLE : EPICS_ENDIAN_BIG);
+}
+
+CaptureReader::~CaptureReader() {}
+
+bool CaptureReader::fill(std::size_t size)
+{
+    size_t remaining = buffer.getRemaining();
+    if(remaining>=size)
+        return true;
+    if(size>storage.size())
+        throw std::logic_error("CaptureReader::fill() size too large");
+
+    // move what is left to the start, then read after it
+    memmove(&storage[0], &storage[buffer.getPosition()], remaining);
+    strm.read(&storage[remaining], storage.size()-remaining);
+    remaining += size_t(strm.gcount());
+
+    buffer.setPosition(0);
+    buffer.setLimit(remaining);
+    return remaining>=size;
+}
+
+bool CaptureReader::next(std::string& name,
+                         epics::pvData::PVStructure::shared_pointer& value,
+                         epics::pvData::BitSet& changed,
+                         epics::pvData::BitSet& overrun,
+                         epicsTimeStamp& received)
+{
+    using namespace epics::pvData;
+
+    while(fill(1)) {
+        int8 rtype = buffer.getByte();
+
+        size_t id = SerializeHelper::readSize(&buffer, this);
+
+        if(rtype=='T') {
+            std::string cname(SerializeHelper::deserializeString(&buffer, this));
+            FieldConstPtr type(getFieldCreate()->deserialize(&buffer, this));
+            if(!type || type->getType()!=structure)
+                throw std::runtime_error("PVA capture channel type is not a structure");
+
+            if(id>=channels.size())
+                channels.resize(id+1u);
+            channels[id].name = cname;
+            channels[id].value = getPVDataCreate()->createPVStructure(std::tr1::static_pointer_cast<const Structure>(type));
+
+        } else if(rtype=='U') {
+            if(id>=channels.size() || !channels[id].value)
+                throw std::runtime_error("PVA capture update of unknown channel");
+
+            ensureData(8);
+            received.secPastEpoch = epicsUInt32(buffer.getInt());
+            received.nsec = epicsUInt32(buffer.getInt());
+            changed.deserialize(&buffer, this);
+            overrun.deserialize(&buffer, this);
+            channels[id].value->deserialize(&buffer, this, &changed);
+
+            name = channels[id].name;
+            value = channels[id].value;
+            return true;
+
+        } else {
+            throw std::runtime_error("PVA capture corrupt");
+        }
+    }
+    return false;
+}
+
+void CaptureReader::ensureData(std::size_t size)
+{
+    if(!fill(size))
+        throw std::runtime_error("PVA capture truncated");
+}
+
+void CaptureReader::alignData(std::size_t) {}
+
+bool CaptureReader::directDeserialize(epics::pvData::ByteBuffer *, char*, std::size_t, std::size_t)
+{
+    return false;
+}
+
+std::tr1::shared_ptr<const epics::pvData::Field> CaptureReader::cachedDeserialize(epics::pvData::ByteBuffer* buffer)
+{
+    return epics::pvData::getFieldCreate()->deserialize(buffer, this);
+}
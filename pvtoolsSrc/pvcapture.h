@@ -0,0 +1,102 @@
+#ifndef PVCAPTURE_H
+#define PVCAPTURE_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <epicsTime.h>
+#include <epicsMutex.h>
+
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+/* Binary capture of PV updates, as written by 'pvget -O' and read by pvcat.
+ *
+ * The file starts with "PVAC", a version byte, and the byte order of what follows
+ * (0 big, 1 little endian).  Then a sequence of records, each starting with a type byte.
+ *
+ * 'T': channel id (size), channel name (string), introspection data of its value.
+ *      Written before the first update of a channel, and again if its type changes.
+ * 'U': channel id (size), receive time (uint32 seconds past EPICS epoch, uint32 ns),
+ *      changed BitSet, overrun BitSet, then the changed fields as serialized by PVA.
+ *
+ * Values are written in the byte order of the writer, with arrays copied directly
+ * to the stream, so capture costs little more than a copy of the data.
+ */
+
+class CaptureWriter : public epics::pvData::SerializableControl
+{
+public:
+    explicit CaptureWriter(std::ostream& strm);
+    virtual ~CaptureWriter();
+
+    //! Append one update of the named channel.  Thread safe.
+    void write(const std::string& name,
+               const epics::pvData::PVStructure& value,
+               const epics::pvData::BitSet& changed,
+               const epics::pvData::BitSet& overrun);
+    void flush();
+
+    virtual void flushSerializeBuffer();
+    virtual void ensureBuffer(std::size_t size);
+    virtual void alignBuffer(std::size_t alignment);
+    virtual bool directSerialize(epics::pvData::ByteBuffer *existingBuffer, const char* toSerialize,
+                                 std::size_t elementCount, std::size_t elementSize);
+    virtual void cachedSerialize(std::tr1::shared_ptr<const epics::pvData::Field> const & field,
+                                 epics::pvData::ByteBuffer* buffer);
+
+private:
+    struct Channel {
+        size_t id;
+        epics::pvData::StructureConstPtr type;
+    };
+    typedef std::map<std::string, Channel> channels_t;
+
+    std::ostream& strm;
+    epicsMutex lock;
+    epics::pvData::ByteBuffer buffer;
+    channels_t channels;
+};
+
+class CaptureReader : public epics::pvData::DeserializableControl
+{
+public:
+    //! Throws std::runtime_error if strm does not start with a capture header
+    explicit CaptureReader(std::istream& strm);
+    virtual ~CaptureReader();
+
+    /** Read the next update.  value is the complete current value of the channel,
+     *  with the changed fields updated.  Returns false at end of input.
+     */
+    bool next(std::string& name,
+              epics::pvData::PVStructure::shared_pointer& value,
+              epics::pvData::BitSet& changed,
+              epics::pvData::BitSet& overrun,
+              epicsTimeStamp& received);
+
+    virtual void ensureData(std::size_t size);
+    virtual void alignData(std::size_t alignment);
+    virtual bool directDeserialize(epics::pvData::ByteBuffer *existingBuffer, char* deserializeTo,
+                                   std::size_t elementCount, std::size_t elementSize);
+    virtual std::tr1::shared_ptr<const epics::pvData::Field> cachedDeserialize(epics::pvData::ByteBuffer* buffer);
+
+private:
+    bool fill(std::size_t size);
+
+    struct Channel {
+        std::string name;
+        epics::pvData::PVStructure::shared_pointer value;
+    };
+
+    std::istream& strm;
+    std::vector<char> storage;
+    epics::pvData::ByteBuffer buffer;
+    std::vector<Channel> channels;
+};
+
+#endif // PVCAPTURE_H
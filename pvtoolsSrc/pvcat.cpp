@@ -0,0 +1,256 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include <stdio.h>
+
+#include <epicsGetopt.h>
+#include <epicsStdlib.h>
+
+#include <pv/pvAccess.h>
+
+#include "pvutils.cpp"
+#include "pvcapture.cpp"
+#include "pvrecorder.cpp"
+
+using namespace std;
+namespace TR1 = std::tr1;
+using namespace epics::pvData;
+using namespace epics::pvAccess;
+
+namespace {
+
+enum PrintMode { ValueOnlyMode, StructureMode, TerseMode };
+PrintMode mode = ValueOnlyMode;
+
+// of recordings, seconds after the first update
+double startOffset = 0.0, endOffset = -1.0;
+
+void usage (void)
+{
+    fprintf (stderr, "\nUsage: pvcat [options] <capture file>|<recording directory>...\n\n"
+             "Print the updates saved by 'pvget -O <capture file>'.  Use '-' for stdin.\n"
+             "Or those recorded by 'pvrecord -o <recording directory>'.\n"
+             "\noptions:\n"
+             "  -h: Help: Print this message\n"
+             "  -V: Print version and exit\n"
+             "  -t:                Terse mode - print only value, without names\n"
+             "  -i:                Do not format standard types (enum_t, time_t, ...)\n"
+             "  -v:                Show entire structure\n"
+             "  -F <ofs>:          Use <ofs> as an alternate output field separator\n"
+             "  -s <sec>:          Of recordings, start <sec> seconds after the first update\n"
+             "  -e <sec>:          Of recordings, end <sec> seconds after the first update\n"
+             " enum format:\n"
+             "  -n: Force enum interpretation of values as numbers (default is enum string)\n"
+             "\nexample: pvcat double01.pvac\n\n");
+}
+
+void printUpdate(const std::string& name, const PVStructure::shared_pointer& pv)
+{
+    if (mode == ValueOnlyMode)
+    {
+        PVField::shared_pointer value(pv->getSubField("value"));
+        Type valueType = value ? value->getField()->getType() : structure;
+
+        if (value && (valueType == scalar || valueType == scalarArray))
+        {
+            PVStructure::shared_pointer timeStamp(pv->getSubField<PVStructure>("timeStamp"));
+            PVStructure::shared_pointer alarm(pv->getSubField<PVStructure>("alarm"));
+
+            if (fieldSeparator == ' ' && valueType == scalar)
+                std::cout << std::setw(30) << std::left;
+
+            std::cout << name << fieldSeparator;
+
+            if (timeStamp)
+                terseStructure(std::cout, timeStamp) << " ";
+
+            terse(std::cout, value) << " ";
+
+            if (alarm)
+            {
+                PVScalar::shared_pointer pvSeverity(alarm->getSubField<PVScalar>("severity"));
+                if (pvSeverity && pvSeverity->getAs<uint32>()!=0)
+                    terseStructure(std::cout, alarm);
+            }
+
+            std::cout << '\n';
+        }
+        else if (value && valueType == structure && isTType(TR1::static_pointer_cast<PVStructure>(value)))
+        {
+            std::cout << std::setw(30) << std::left << name << fieldSeparator;
+            formatTType(std::cout, TR1::static_pointer_cast<PVStructure>(value));
+            std::cout << '\n';
+        }
+        else
+        {
+            std::cout << name << '\n';
+            pvutil_ostream myos(std::cout);
+            myos << *pv << "\n\n";
+        }
+    }
+    else if (mode == TerseMode)
+    {
+        if (fieldSeparator == ' ')
+            std::cout << std::setw(30) << std::left << name;
+        else
+            std::cout << name;
+
+        std::cout << fieldSeparator;
+
+        terseStructure(std::cout, pv) << '\n';
+    }
+    else
+    {
+        std::cout << name << '\n';
+        pvutil_ostream myos(std::cout);
+        myos << *pv << "\n\n";
+    }
+}
+
+bool catCapture(std::istream& strm, const std::string& fileName)
+{
+    try {
+        CaptureReader reader(strm);
+
+        std::string name;
+        PVStructure::shared_pointer value;
+        BitSet changed, overrun;
+        epicsTimeStamp received;
+
+        while(reader.next(name, value, changed, overrun, received))
+            printUpdate(name, value);
+
+        return true;
+    } catch(std::exception& e) {
+        std::cerr << fileName << " : " << e.what() << '\n';
+        return false;
+    }
+}
+
+bool catRecording(const std::string& dirName)
+{
+    try {
+        RecordingReader reader(dirName);
+
+        const epicsTime start(reader.startTime());
+        if(startOffset>0.0)
+            reader.seek(start + startOffset);
+
+        std::string name;
+        PVStructure::shared_pointer value;
+        BitSet changed, overrun;
+        epicsTimeStamp received;
+
+        while(reader.next(name, value, changed, overrun, received)) {
+            if(endOffset>=0.0 && epicsTime(received) - start > endOffset)
+                break;
+            printUpdate(name, value);
+        }
+
+        return true;
+    } catch(std::exception& e) {
+        std::cerr << dirName << " : " << e.what() << '\n';
+        return false;
+    }
+}
+
+} // namespace
+
+int main (int argc, char *argv[])
+{
+    int opt;                    /* getopt() current option */
+
+    std::cout << std::boolalpha;
+
+    while ((opt = getopt(argc, argv, :hVtivF:ns:e:")) != -1) {
+        switch (opt) {
+        case 'h':               /* Print usage */
+            usage();
+            return 0;
+        case 'V':               /* Print version */
+        {
+            Version version("pvcat", "cpp",
+                    EPICS_PVA_MAJOR_VERSION,
+                    EPICS_PVA_MINOR_VERSION,
+                    EPICS_PVA_MAINTENANCE_VERSION,
+                    EPICS_PVA_DEVELOPMENT_FLAG);
+            fprintf(stdout, "%s\n", version.getVersionString().c_str());
+            return 0;
+        }
+        case 't':               /* Terse mode */
+            mode = TerseMode;
+            break;
+        case 'i':               /* T-types format mode */
+            formatTTypesFlag = false;
+            break;
+        case 'v':
+            mode = StructureMode;
+            break;
+        case 'F':               /* Store this for output formatting */
+            fieldSeparator = (char) *optarg;
+            break;
+        case 'n':
+            enumMode = NumberEnum;
+            break;
+        case 's':               /* Recording start */
+        case 'e':               /* Recording end */
+        {
+            double temp;
+            if((epicsScanDouble(optarg, &temp)) != 1 || temp < 0.0) {
+                fprintf(stderr, "'%s' is not a valid offset for -%c. ('pvcat -h' for help.)\n", optarg, opt);
+                return 1;
+            }
+            (opt=='s' ? startOffset : endOffset) = temp;
+            break;
+        }
+        case '?':
+            fprintf(stderr,
+                    "Unrecognized option: '-%c'. ('pvcat -h' for help.)\n",
+                    optopt);
+            return 1;
+        case ':':
+            fprintf(stderr,
+                    "Option '-%c' requires an argument. ('pvcat -h' for help.)\n",
+                    optopt);
+            return 1;
+        default :
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        fprintf(stderr, "No capture file specified. ('pvcat -h' for help.)\n");
+        return 1;
+    }
+
+    bool allOK = true;
+    for(; optind < argc; optind++)
+    {
+        std::string fileName(argv[optind]);
+        if (fileName == "-")
+        {
+            allOK &= catCapture(std::cin, "<stdin>");
+            continue;
+        }
+
+        if (std::ifstream((fileName + "/index").c_str()))
+        {
+            allOK &= catRecording(fileName);
+            continue;
+        }
+
+        std::ifstream ifs(fileName.c_str(), std::ifstream::in | std::ifstream::binary);
+        if (!ifs)
+        {
+            fprintf(stderr, "Failed to open file '%s'.\n", fileName.c_str());
+            allOK = false;
+            continue;
+        }
+        allOK &= catCapture(ifs, fileName);
+    }
+
+    return allOK ? 0 : 1;
+}
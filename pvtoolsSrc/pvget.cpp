@@ -1,5 +1,7 @@
 #include <iostream>
+#include <algorithm>
 #include <vector>
+#include <deque>
 #include <set>
 #include <string>
 #include <istream>
@@ -17,6 +19,7 @@
 #include <epicsGetopt.h>
 #include <epicsExit.h>
 #include <epicsGuard.h>
+#include <epicsTime.h>
 
 #include <pv/caProvider.h>
 #include <pv/pvAccess.h>
@@ -25,8 +28,10 @@
 #include <pv/lock.h>
 #include <pv/event.h>
 #include <pv/reftrack.h>
+#include <pv/latencyHistogram.h>
 
 #include "pvutils.cpp"
+#include "pvcapture.cpp"
 
 using namespace std;
 namespace TR1 = std::tr1;
@@ -44,10 +49,98 @@ bool debugFlag = false;
 
 string request("field(value)");
 string defaultProvider("pva");
+// channel priority, which selects the connection, its I/O threads and socket options
+short channelPriority = ChannelProvider::PRIORITY_DEFAULT;
 
 enum PrintMode { ValueOnlyMode, StructureMode, TerseMode };
 PrintMode mode = ValueOnlyMode;
 
+// serialize output of results arriving from different server connections
+epicsMutex printLock;
+
+// when set, results are written here instead of printed
+CaptureWriter *capture;
+
+// Monitor statistics (-S), printed periodically instead of values.
+// Latency is from the timeStamp of an update to its arrival here.
+struct MonitorStats {
+    epicsMutex lock;
+    // since last show()
+    LatencyHistogram latency;
+    size_t nUpdates, nOverrun, nSkew, nUntimed;
+    epicsTime lastShow;
+    // whole run
+    LatencyHistogram total;
+    size_t nTotal;
+
+    MonitorStats()
+        :nUpdates(0u), nOverrun(0u), nSkew(0u), nUntimed(0u)
+        ,lastShow(epicsTime::getCurrent())
+        ,nTotal(0u)
+    {}
+
+    void record(const MonitorElement& element, const epicsTime& received)
+    {
+        PVStructure::shared_pointer timeStamp(element.pvStructurePtr->getSubField<PVStructure>("timeStamp"));
+        PVScalar::shared_pointer sec, nsec;
+        if(timeStamp) {
+            sec = timeStamp->getSubField<PVScalar>("secondsPastEpoch");
+            nsec = timeStamp->getSubField<PVScalar>("nanoseconds");
+        }
+
+        epicsTimeStamp recv(received);
+        double delay = 0.0;
+        if(sec && nsec) {
+            delay = double(int64(recv.secPastEpoch) + POSIX_TIME_AT_EPICS_EPOCH - sec->getAs<int64>())
+                    + (double(recv.nsec) - nsec->getAs<int32>())*1e-9;
+        }
+
+        Guard G(lock);
+        nUpdates++;
+        if(!element.overrunBitSet->isEmpty())
+            nOverrun++;
+        if(!sec || !nsec) {
+            nUntimed++;
+        } else {
+            // negative when clocks differ.  counted as 0
+            if(delay<0.0)
+                nSkew++;
+            latency.record(delay);
+        }
+    }
+
+    //! print and reset counts since last call
+    void show(std::ostream& strm)
+    {
+        const epicsTime now(epicsTime::getCurrent());
+        Guard G(lock);
+        const double interval = now - lastShow;
+
+        char timeText[32];
+        now.strftime(timeText, sizeof(timeText), "%Y-%m-%dT%H:%M:%S.%03f");
+
+        strm << timeText << " updates " << nUpdates
+             << " rate " << (interval>0.0 ? nUpdates/interval : 0.0) << "/s"
+             << " overrun " << nOverrun;
+        if(nSkew)
+            strm << " skew " << nSkew;
+        if(nUntimed)
+            strm << " untimed " << nUntimed;
+        strm << " latency ";
+        latency.show(strm);
+        strm << '\n';
+
+        total.merge(latency);
+        nTotal += nUpdates;
+        latency.reset();
+        nUpdates = nOverrun = nSkew = nUntimed = 0u;
+        lastShow = now;
+    }
+};
+
+// when set, monitor updates are counted here instead of printed
+MonitorStats *stats;
+
 void usage (void)
 {
     fprintf (stderr, "\nUsage: pvget [options] <PV name>...\n\n"
@@ -60,11 +153,18 @@ void usage (void)
              "  -i:                Do not format standard types (enum_t, time_t, ...)\n"
              "  -m:                Monitor mode\n"
              "  -p <provider>:     Set default provider name, default is '%s'\n"
+             "  -P <priority>:     Channel priority, 0 (default) to 99.  Gets of another priority use their own connection\n"
              "  -v:                Show entire structure\n"
              "  -q:                Quiet mode, print only error messages\n"
              "  -d:                Enable debug output\n"
              "  -F <ofs>:          Use <ofs> as an alternate output field separator\n"
              "  -f <input file>:   Use <input file> as an input that provides a list PV name(s) to be read, use '-' for stdin\n"
+             "  -O <output file>:  Write results in binary capture format, instead of printing them, use '-' for stdout.\n"
+             "                     Read with pvcat\n"
+             "  -B <window>:       Bulk mode, for many PVs.  At most <window> gets in progress at once,\n"
+             "                     each with its own timeout (-w).  Prints a summary of latencies to stderr.\n"
+             "  -S <sec>:          With -m, print statistics of all updates every <sec> seconds, instead of values:\n"
+             "                     rate, overruns, and latency from timeStamp to arrival.  -w sets how long to run.\n"
              " enum format:\n"
              "  -n: Force enum interpretation of values as numbers (default is enum string)\n"
 //    " time format:\n"
@@ -134,15 +234,27 @@ struct Tracker {
     static inprog_t inprog;
     static bool abort;
 
+    // statistics, guarded by doneLock
+    static LatencyHistogram connectLatency, dataLatency;
+    static size_t nOK, nFail;
+
+    const epicsTime started;
+
     Tracker()
+        :started(epicsTime::getCurrent())
     {
         Guard G(doneLock);
         inprog.insert(this);
     }
-    ~Tracker()
+    virtual ~Tracker()
     {
         done();
     }
+    static void failed()
+    {
+        Guard G(doneLock);
+        nFail++;
+    }
     void done()
     {
         {
@@ -157,6 +269,10 @@ epicsMutex Tracker::doneLock;
 epicsEvent Tracker::doneEvt;
 Tracker::inprog_t Tracker::inprog;
 bool Tracker::abort = false;
+LatencyHistogram Tracker::connectLatency;
+LatencyHistogram Tracker::dataLatency;
+size_t Tracker::nOK;
+size_t Tracker::nFail;
 
 #ifdef USE_SIGNAL
 void alldone(int num)
@@ -187,12 +303,18 @@ struct ChannelGetRequesterImpl : public ChannelGetRequester, public Tracker
                 std::cerr << "[" << m_channelName << "] channel get create: " << status << '\n';
             }
 
+            {
+                Guard G(doneLock);
+                connectLatency.record(epicsTime::getCurrent() - started);
+            }
+
             channelGet->lastRequest();
             channelGet->get();
         }
         else
         {
             std::cerr << "[" << m_channelName << "] failed to create channel get: " << status << '\n';
+            failed();
             done();
         }
     }
@@ -202,6 +324,12 @@ struct ChannelGetRequesterImpl : public ChannelGetRequester, public Tracker
                          epics::pvData::PVStructure::shared_pointer const & pvStructure,
                          epics::pvData::BitSet::shared_pointer const & bitSet)
     {
+        {
+            Guard G(doneLock);
+            if(!inprog.count(this))
+                return; // already reported as timeout
+        }
+
         if (status.isSuccess())
         {
             if (!status.isOK() || debugFlag)
@@ -209,12 +337,24 @@ struct ChannelGetRequesterImpl : public ChannelGetRequester, public Tracker
                 std::cerr << "[" << m_channelName << "] channel get: " << status << '\n';
             }
 
-            printValue(m_channelName, pvStructure);
+            {
+                Guard G(doneLock);
+                dataLatency.record(epicsTime::getCurrent() - started);
+                nOK++;
+            }
+
+            if(capture) {
+                capture->write(m_channelName, *pvStructure, *bitSet, BitSet());
+            } else {
+                Guard G(printLock);
+                printValue(m_channelName, pvStructure);
+            }
 
         }
         else
         {
             std::cerr << "[" << m_channelName << "] failed to get: " << status << '\n';
+            failed();
         }
 
         done();
@@ -267,11 +407,25 @@ struct MonitorRequesterImpl : public MonitorRequester, public Tracker
         if(debugFlag)
             std::cerr << "[" << m_channelName << "] channel monitor event: \n";
 
+        const epicsTime received(epicsTime::getCurrent());
+
         for(MonitorElement::Ref it(monitor); it; ++it)
         {
             MonitorElement* element(it.get());
 
-            if (mode == ValueOnlyMode)
+            if (stats)
+            {
+                stats->record(*element, received);
+                if (capture)
+                    capture->write(m_channelName, *element->pvStructurePtr,
+                                   *element->changedBitSet, *element->overrunBitSet);
+            }
+            else if (capture)
+            {
+                capture->write(m_channelName, *element->pvStructurePtr,
+                               *element->changedBitSet, *element->overrunBitSet);
+            }
+            else if (mode == ValueOnlyMode)
             {
                 PVField::shared_pointer value = element->pvStructurePtr->getSubField("value");
                 if (value.get() == 0)
@@ -366,6 +520,88 @@ private:
     }
 };
 
+// a PV name resolved to its provider, waiting for bulk mode to start its get
+struct Target {
+    std::string name, host;
+    ChannelProvider::shared_pointer provider;
+};
+
+// Start gets of targets, keeping at most window in progress, each for at most timeOut.
+// Returns false if interrupted.
+bool bulkGet(const std::vector<Target>& targets, size_t window, double timeOut,
+             PVStructure::shared_pointer const & pvRequest)
+{
+    typedef std::tr1::shared_ptr<Tracker> op_t;
+    // in order started, so the oldest expire first
+    std::deque<op_t> inflight;
+    std::vector<op_t> finished;
+    size_t next = 0u, nTimeout = 0u;
+
+    Guard G(Tracker::doneLock);
+    while(!Tracker::abort) {
+        const epicsTime now(epicsTime::getCurrent());
+
+        while(!inflight.empty()) {
+            const op_t& op = inflight.front();
+            if(Tracker::inprog.count(op.get())) {
+                if(timeOut<=0 || now - op->started < timeOut)
+                    break;
+                Tracker::inprog.erase(op.get());
+                std::cerr << "[" << static_cast<ChannelGetRequesterImpl*>(op.get())->m_channelName << "] timeout\n";
+                nTimeout++;
+                Tracker::nFail++;
+            }
+            // destroyed later, without doneLock
+            finished.push_back(op);
+            inflight.pop_front();
+        }
+
+        size_t nstart = 0u;
+        if(Tracker::inprog.size() < window)
+            nstart = std::min(window - Tracker::inprog.size(), targets.size() - next);
+
+        if(nstart==0u && Tracker::inprog.empty() && next==targets.size())
+            break;
+
+        UnGuard U(G);
+        finished.clear();
+
+        for(size_t i=0; i<nstart; i++, next++) {
+            const Target& target = targets[next];
+            try {
+                Channel::shared_pointer channel(target.provider->createChannel(target.name, DefaultChannelRequester::build(),
+                                                                               channelPriority, target.host));
+
+                std::tr1::shared_ptr<ChannelGetRequesterImpl> req(new ChannelGetRequesterImpl(target.name));
+                req->op = channel->createChannelGet(req, pvRequest);
+                inflight.push_back(req);
+            } catch(std::exception& e) {
+                std::cerr<<"Can't create channel \""<<target.name<<"\" : "<<e.what()<<"\n";
+                Tracker::failed();
+            }
+        }
+
+        if(nstart==0u)
+            Tracker::doneEvt.wait(timeOut<=0 ? 1.0 : std::min(timeOut, 0.1));
+    }
+
+    {
+        UnGuard U(G);
+        finished.clear();
+        inflight.clear();
+    }
+
+    std::cerr << targets.size() << " PVs: " << Tracker::nOK << " OK, "
+              << Tracker::nFail << " failed (" << nTimeout << " timeout)\n";
+    std::cerr << "connect ";
+    Tracker::connectLatency.show(std::cerr);
+    std::cerr << "\ndata    ";
+    Tracker::dataLatency.show(std::cerr);
+    std::cerr << "\n";
+
+    return !Tracker::abort;
+}
+
 } // namespace
 
 
@@ -382,11 +618,18 @@ int main (int argc, char *argv[])
     double timeOut = -1.0;
     bool explicit_timeout = false;
 
+    size_t window = 0u;
+    double statsPeriod = 0.0;
+    bool explicit_request = false;
+
+    ofstream captureFile;
+    epics::auto_ptr<CaptureWriter> captureWriter;
+
     setvbuf(stdout,NULL,_IOLBF,BUFSIZ);    /* Set stdout to line buffering */
 
     // ================ Parse Arguments
 
-    while ((opt = getopt(argc, argv, ":hvVRr:w:tmp:qdcF:f:ni")) != -1) {
+    while ((opt = getopt(argc, argv, ":hvVRr:w:tmp:P:qdcF:f:niB:O:S:")) != -1) {
         switch (opt) {
         case 'h':               /* Print usage */
             usage();
@@ -418,6 +661,7 @@ int main (int argc, char *argv[])
             break;
         case 'r':               /* Set PVA timeout value */
             request = optarg;
+            explicit_request = true;
             // do not override terse mode
             if (mode == ValueOnlyMode) mode = StructureMode;
             break;
@@ -433,6 +677,18 @@ int main (int argc, char *argv[])
         case 'p':               /* Set default provider */
             defaultProvider = optarg;
             break;
+        case 'P':               /* Set channel priority */
+        {
+            epicsInt32 prio;
+            if(epicsParseInt32(optarg, &prio, 0, NULL) || prio < ChannelProvider::PRIORITY_MIN || prio > ChannelProvider::PRIORITY_MAX)
+            {
+                fprintf(stderr, "'%s' is not a valid priority "
+                        "- ignored. ('pvget -h' for help.)\n", optarg);
+                prio = ChannelProvider::PRIORITY_DEFAULT;
+            }
+            channelPriority = short(prio);
+            break;
+        }
         case 'q':               /* Quiet mode */
             break;
         case 'd':               /* Debug log level */
@@ -468,6 +724,43 @@ int main (int argc, char *argv[])
         case 'n':
             enumMode = NumberEnum;
             break;
+        case 'O':               /* Binary capture output */
+        {
+            string fileName = optarg;
+            if (fileName == "-")
+                captureWriter.reset(new CaptureWriter(cout));
+            else
+            {
+                captureFile.open(fileName.c_str(), ofstream::out | ofstream::binary | ofstream::trunc);
+                if (!captureFile)
+                {
+                    fprintf(stderr,
+                            "Failed to open file '%s'.\n",
+                            fileName.c_str());
+                    return 1;
+                }
+                captureWriter.reset(new CaptureWriter(captureFile));
+            }
+            capture = captureWriter.get();
+            break;
+        }
+        case 'B':               /* Bulk mode */
+        {
+            epicsUInt32 temp;
+            if(epicsParseUInt32(optarg, &temp, 0, NULL) || temp==0u) {
+                fprintf(stderr, "'%s' is not a valid window size. ('pvget -h' for help.)\n", optarg);
+                return 1;
+            }
+            window = temp;
+            break;
+        }
+        case 'S':               /* Monitor statistics */
+            if((epicsScanDouble(optarg, &statsPeriod)) != 1 || statsPeriod <= 0.0)
+            {
+                fprintf(stderr, "'%s' is not a valid statistics period. ('pvget -h' for help.)\n", optarg);
+                return 1;
+            }
+            break;
         case '?':
             fprintf(stderr,
                     "Unrecognized option: '-%c'. ('pvget -h' for help.)\n",
@@ -484,6 +777,23 @@ int main (int argc, char *argv[])
         }
     }
 
+    if(window && monitor) {
+        fprintf(stderr, "Bulk mode (-B) is ignored for monitors.\n");
+        window = 0u;
+    }
+
+    MonitorStats monitorStats;
+    if(statsPeriod>0.0) {
+        if(!monitor) {
+            fprintf(stderr, "Statistics (-S) are only for monitors (-m).\n");
+            return 1;
+        }
+        // latency needs timeStamp
+        if(!explicit_request)
+            request = "field(value,timeStamp)";
+        stats = &monitorStats;
+    }
+
     if(!explicit_timeout) {
         if(monitor)
             timeOut = -1.0; // forever
@@ -550,6 +860,10 @@ int main (int argc, char *argv[])
 
     // keep the operations, and associated channels, alive
     std::vector<std::tr1::shared_ptr<Tracker> > ops;
+    // bulk mode starts these later
+    std::vector<Target> targets;
+    if(window)
+        targets.reserve(pvs.size());
 
     for(size_t n=0; n<pvs.size(); n++)
     {
@@ -574,12 +888,22 @@ int main (int argc, char *argv[])
             return 1;
         }
 
+        if(window) {
+            Target target;
+            target.name = pvs[n];
+            target.host = uri.host;
+            target.provider = provider;
+            targets.push_back(target);
+            providers.insert(provider);
+            continue;
+        }
+
         Channel::shared_pointer channel;
         chan_cache_t::const_iterator it = chan_cache.find(pvs[n]);
         if(it==chan_cache.end()) {
             try {
                 channel = provider->createChannel(pvs[n], DefaultChannelRequester::build(),
-                                                  ChannelProvider::PRIORITY_DEFAULT, uri.host);
+                                                  channelPriority, uri.host);
             } catch(std::exception& e) {
                 std::cerr<<"Provider "<<uri.protocol<<" can't create channel \""<<pvs[n]<<"\"\n";
                 return 1;
@@ -622,7 +946,36 @@ int main (int argc, char *argv[])
     if(debugFlag)
         std::cerr<<"Waiting...\n";
 
-    {
+    if(window) {
+        bulkGet(targets, window, timeOut, pvRequest);
+        allOK = Tracker::nFail==0u && !Tracker::abort;
+
+    } else if(stats) {
+        // -w is the duration of the run, not an error
+        const epicsTime start(epicsTime::getCurrent());
+        Guard G(Tracker::doneLock);
+        while(Tracker::inprog.size() && !Tracker::abort) {
+            UnGuard U(G);
+            const epicsTime now(epicsTime::getCurrent());
+            if(timeOut>0 && now - start >= timeOut)
+                break;
+            // only this thread updates lastShow
+            double remaining = statsPeriod - (now - stats->lastShow);
+            if(remaining <= 0.0) {
+                stats->show(std::cout);
+                remaining = statsPeriod;
+            }
+            if(timeOut>0)
+                remaining = std::min(remaining, timeOut - (now - start));
+            Tracker::doneEvt.wait(remaining);
+        }
+
+        stats->show(std::cout);
+        std::cout << "total updates " << stats->nTotal << " latency ";
+        stats->total.show(std::cout);
+        std::cout << '\n';
+
+    } else {
         Guard G(Tracker::doneLock);
         while(Tracker::inprog.size() && !Tracker::abort) {
             UnGuard U(G);
@@ -646,6 +999,9 @@ int main (int argc, char *argv[])
 
     // ========================== All done now
 
+    if(capture)
+        capture->flush();
+
     if(debugFlag)
         std::cerr<<"Done\n";
     return allOK ? 0 : 1;
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <map>
 #include <iterator>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <istream>
@@ -16,6 +17,9 @@
 #include <pv/logger.h>
 
 #include <epicsExit.h>
+#include <epicsThread.h>
+#include <epicsGuard.h>
+#include <epicsTime.h>
 #include <osiSock.h>
 
 #include <pv/byteBuffer.h>
@@ -374,8 +378,18 @@ bool discoverServers(double timeOut)
 
     int sendCount = 0;
 
+    // stop once no new server has responded for a while, or at the timeout
+    const double quietPeriod = 0.5;
+    const epicsTime start(epicsTime::getCurrent());
+    epicsTime lastNew(start);
+
     while (true)
     {
+        const epicsTime now(epicsTime::getCurrent());
+        if (now - start >= timeOut ||
+                (sendCount >= 2 && now - lastNew >= quietPeriod))
+            break;
+
         receiveBuffer.clear();
 
         // receive packet from socket
@@ -388,7 +402,8 @@ bool discoverServers(double timeOut)
             receiveBuffer.setPosition(bytesRead);
             receiveBuffer.flip();
 
-            processSearchResponse(fromAddress, receiveBuffer);
+            if (processSearchResponse(fromAddress, receiveBuffer))
+                lastNew = epicsTime::getCurrent();
 
         }
         else
@@ -459,7 +474,119 @@ bool discoverServers(double timeOut)
 }
 
 
+// Query the "server" RPC service of servers, at most nthreads at once,
+// printing each result as it arrives.
+struct ServerQueries : public epicsThreadRunable
+{
+    const std::vector<std::string> servers;
+    const bool printInfo, debug;
+    const double timeOut;
+
+    epicsMutex lock;
+    size_t next, nfail;
+
+    ServerQueries(const std::vector<std::string>& servers, bool printInfo, bool debug, double timeOut)
+        :servers(servers), printInfo(printInfo), debug(debug), timeOut(timeOut)
+        ,next(0u), nfail(0u)
+    {}
+    virtual ~ServerQueries() {}
+
+    PVStructure::shared_pointer query(const std::string& serverAddress)
+    {
+        StructureConstPtr argstype(getFieldCreate()->createFieldBuilder()
+                                   ->setId("epics:nt/NTURI:1.0")
+                                   ->add("scheme", pvString)
+                                   ->add("path", pvString)
+                                   ->addNestedStructure("query")
+                                       ->add("op", pvString)
+                                   ->endNested()
+                                   ->createStructure());
+
+        PVStructure::shared_pointer args(getPVDataCreate()->createPVStructure(argstype));
+
+        args->getSubFieldT<PVString>("scheme")->put("pva");
+        args->getSubFieldT<PVString>("path")->put("server");
+        args->getSubFieldT<PVString>("query.op")->put(printInfo ? "info" : "channels");
+
+        if(debug) {
+            epicsGuard<epicsMutex> G(lock);
+            std::cerr<<"Query to "<<serverAddress<<"\n"<<args<<"\n";
+        }
+
+        RPCClient rpc("server",
+                      createRequest("field()"),
+                      ChannelProvider::shared_pointer(),
+                      serverAddress);
+
+        return rpc.request(args, timeOut, true);
+    }
+
+    virtual void run()
+    {
+        while(true) {
+            std::string serverAddress;
+            {
+                epicsGuard<epicsMutex> G(lock);
+                if(next>=servers.size())
+                    return;
+                serverAddress = servers[next++];
+            }
+
+            PVStructure::shared_pointer ret;
+            std::string error;
+            try {
+                ret = query(serverAddress);
+            } catch(std::exception& e) {
+                error = e.what();
+            }
+
+            epicsGuard<epicsMutex> G(lock);
+            if(!ret) {
+                std::cerr<<"Error: "<<serverAddress<<" : "<<error<<"\n";
+                nfail++;
+
+            } else if(!printInfo) {
+                PVStringArray::shared_pointer pvs(ret->getSubField<PVStringArray>("value"));
+                if(!pvs) {
+                    std::cerr<<"Error: "<<serverAddress<<" : no channel list in reply\n";
+                    nfail++;
+                    continue;
+                }
+
+                PVStringArray::const_svector val(pvs->view());
+
+                std::copy(val.begin(),
+                          val.end(),
+                          std::ostream_iterator<std::string>(std::cout, "\n"));
+
+            } else {
+                std::cout<<ret<<"\n";
+            }
+        }
+    }
+
+    // returns number of failures
+    size_t execute(unsigned nthreads)
+    {
+        nthreads = std::max(1u, std::min(nthreads, unsigned(servers.size())));
+
+        std::vector<epicsThread*> workers;
+        for(unsigned i=0; i<nthreads; i++) {
+            workers.push_back(new epicsThread(*this, "pvlist",
+                                              epicsThreadGetStackSize(epicsThreadStackSmall)));
+            workers.back()->start();
+        }
+        for(size_t i=0; i<workers.size(); i++) {
+            workers[i]->exitWait();
+            delete workers[i];
+        }
+        return nfail;
+    }
+};
+
+
 #define DEFAULT_TIMEOUT 3.0
+#define DEFAULT_PARALLEL 16u
 
 void usage (void)
 {
@@ -468,6 +595,8 @@ void usage (void)
              "  -h: Help: Print this message\n"
              "  -V: Print version and exit\n"
              "  -i                 Print server info (when server address list/GUID is given)\n"
+             "  -a                 Query all discovered servers, for their channels (or info with -i)\n"
+             "  -P <count>:        Query at most <count> servers at once, default is %u\n"
              "  -w <sec>:          Wait time, specifies timeout, default is %f second(s)\n"
              "  -q:                Quiet mode, print only error messages\n"
              "  -d:                Enable debug output\n"
@@ -477,8 +606,9 @@ void usage (void)
              "\tpvlist\n"
              "\tpvlist ioc0001\n"
              "\tpvlist 10.5.1.205:10000\n"
-             "\tpvlist 0x83DE3C540000000000BF351F\n\n"
-             , DEFAULT_TIMEOUT);
+             "\tpvlist 0x83DE3C540000000000BF351F\n"
+             "\tpvlist -a\n\n"
+             , DEFAULT_PARALLEL, DEFAULT_TIMEOUT);
 }
 
 }//namespace
@@ -504,6 +634,8 @@ int main (int argc, char *argv[])
     bool debug = false;
     double timeOut = DEFAULT_TIMEOUT;
     bool printInfo = false;
+    bool queryAll = false;
+    unsigned parallel = DEFAULT_PARALLEL;
 
     /*
     istream* inputStream = 0;
@@ -512,7 +644,7 @@ int main (int argc, char *argv[])
     */
     setvbuf(stdout,NULL,_IOLBF,BUFSIZ);    /* Set stdout to line buffering */
 
-    while ((opt = getopt(argc, argv, ":hVw:qdF:f:i")) != -1) {
+    while ((opt = getopt(argc, argv, ":hVw:qdF:f:iaP:")) != -1) {
         switch (opt) {
         case 'h':               /* Print usage */
             usage();
@@ -543,6 +675,20 @@ int main (int argc, char *argv[])
         case 'i':               /* Print server info */
             printInfo = true;
             break;
+        case 'a':               /* Query all servers */
+            queryAll = true;
+            break;
+        case 'P':               /* Parallel queries */
+        {
+            epicsUInt32 temp;
+            if(epicsParseUInt32(optarg, &temp, 0, NULL) || temp==0u) {
+                fprintf(stderr, "'%s' is not a valid count "
+                        "- ignored. ('pvlist -h' for help.)\n", optarg);
+            } else {
+                parallel = temp;
+            }
+            break;
+        }
         case '?':
             fprintf(stderr,
                     "Unrecognized option: '-%c'. ('pvlist -h' for help.)\n",
@@ -583,8 +729,10 @@ int main (int argc, char *argv[])
     if (noArgs || byGUIDSearch)
         discoverServers(timeOut);
 
+    std::vector<std::string> servers;
+
     // just list all the discovered servers
-    if (noArgs)
+    if (noArgs && !queryAll)
     {
         for (ServerMap::const_iterator iter = serverMap.begin();
                 iter != serverMap.end();
@@ -605,6 +753,17 @@ int main (int argc, char *argv[])
             cout << ']' << endl;
         }
     }
+    else if (noArgs)
+    {
+        for (ServerMap::const_iterator iter = serverMap.begin();
+                iter != serverMap.end();
+                iter++)
+        {
+            // TODO for now we take only first server address
+            if (!iter->second.addresses.empty())
+                servers.push_back(inetAddressToString(iter->second.addresses[0]));
+        }
+    }
     else
     {
         for (int i = optind; i < argc; i++)
@@ -642,55 +801,16 @@ int main (int argc, char *argv[])
                 }
             }
 
-            StructureConstPtr argstype(getFieldCreate()->createFieldBuilder()
-                                       ->setId("epics:nt/NTURI:1.0")
-                                       ->add("scheme", pvString)
-                                       ->add("path", pvString)
-                                       ->addNestedStructure("query")
-                                           ->add("op", pvString)
-                                       ->endNested()
-                                       ->createStructure());
-
-            PVStructure::shared_pointer args(getPVDataCreate()->createPVStructure(argstype));
-
-            args->getSubFieldT<PVString>("scheme")->put("pva");
-            args->getSubFieldT<PVString>("path")->put("server");
-            args->getSubFieldT<PVString>("query.op")->put(printInfo ? "info" : "channels");
-
-            if(debug) {
-                std::cerr<<"Query to "<<serverAddress<<"\n"<<args<<"\n";
-            }
-
-            PVStructure::shared_pointer ret;
-            try {
-                RPCClient rpc("server",
-                              createRequest("field()"),
-                              ChannelProvider::shared_pointer(),
-                              serverAddress);
-
-                if(debug)
-                    std::cerr<<"Execute\n";
-                ret = rpc.request(args, timeOut, true);
-            } catch(std::exception& e) {
-                std::cerr<<"Error: "<<e.what()<<"\n";
-                return 1;
-            }
-
-            if(!printInfo) {
-                PVStringArray::shared_pointer pvs(ret->getSubField<PVStringArray>("value"));
-
-                PVStringArray::const_svector val(pvs->view());
-
-                std::copy(val.begin(),
-                          val.end(),
-                          std::ostream_iterator<std::string>(std::cout, "\n"));
-
-                return allOK ? 0 : 1;
-            }
-
-            std::cout<<ret<<"\n";
+            servers.push_back(serverAddress);
         }
     }
 
+    if (!servers.empty())
+    {
+        ServerQueries queries(servers, printInfo, debug, timeOut);
+        if (queries.execute(parallel))
+            allOK = false;
+    }
+
     return allOK ? 0 : 1;
 }
@@ -0,0 +1,664 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <stdio.h>
+
+#if !defined(_WIN32)
+#include <signal.h>
+#define USE_SIGNAL
+#endif
+
+#include <epicsStdlib.h>
+#include <epicsGetopt.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsGuard.h>
+#include <epicsTime.h>
+
+#include <pv/logger.h>
+#include <pv/latencyHistogram.h>
+
+#include <pva/client.h>
+
+#include <pv/caProvider.h>
+
+#include "pvutils.cpp"
+
+using namespace std;
+namespace TR1 = std::tr1;
+using namespace epics::pvData;
+using namespace epics::pvAccess;
+
+namespace {
+
+typedef epicsGuard<epicsMutex> Guard;
+
+#define DEFAULT_PROVIDER "pva"
+#define DEFAULT_REQUEST "field()"
+#define DEFAULT_DURATION 10.0
+#define DEFAULT_TIMEOUT 5.0
+
+string defaultProvider(DEFAULT_PROVIDER);
+double timeOut = DEFAULT_TIMEOUT;
+
+volatile bool interrupted;
+
+#ifdef USE_SIGNAL
+void stopLoad(int)
+{
+    interrupted = true;
+}
+#endif
+
+void usage (void)
+{
+    fprintf (stderr, "\nUsage: pvload [options] <PV name>...\n\n"
+             "Generate client traffic against the servers of the named PVs, and report\n"
+             "the throughput and latency achieved as JSON.\n"
+             "\noptions:\n"
+             "  -h: Help: Print this message\n"
+             "  -V: Print version and exit\n"
+             "  -p <provider>:     Set default provider name, default is '%s'\n"
+             "  -r <pv request>:   Request for gets, puts and monitors, default is '%s'\n"
+             "  -m <count>:        Monitors of each PV, default 0\n"
+             "  -g <rate>:         Gets per second of each PV, default 0\n"
+             "  -P <rate>:         Puts per second of each PV, writing a counter to its 'value', default 0\n"
+             "  -R <rate>:         RPC calls per second of each PV, with an NTURI argument, default 0\n"
+             "  -c <period>:       Disconnect and reconnect each PV every <period> seconds, default never\n"
+             "  -T <threads>:      Threads issuing requests, PVs are divided between them, default 1\n"
+             "  -d <sec>:          Duration of the run, default %.1f seconds\n"
+             "  -w <sec>:          Timeout of each request, default %.1f seconds\n"
+             "  -f <input file>:   Read PV names from <input file>, use '-' for stdin\n"
+             "  -o <output file>:  Write JSON results to <output file>, default stdout\n"
+             "\nAt most one of each kind of request is in progress on a PV at once, so the rates\n"
+             "achieved are lower than asked for when the latency exceeds the period.\n"
+             "Run several pvload processes, eg. on different hosts, for more load than one client.\n"
+             "\nexample: pvload -T 4 -g 10 -m 1 -d 60 double01 double02\n\n"
+             , DEFAULT_PROVIDER, DEFAULT_REQUEST, DEFAULT_DURATION, DEFAULT_TIMEOUT);
+}
+
+// counts of one kind of request, from all threads
+struct RequestStats {
+    epicsMutex lock;
+    LatencyHistogram latency;
+    size_t ok, fail, timeout;
+
+    RequestStats() :ok(0u), fail(0u), timeout(0u) {}
+
+    void done(bool success, double seconds)
+    {
+        Guard G(lock);
+        if(success) {
+            ok++;
+            latency.record(seconds);
+        } else {
+            fail++;
+        }
+    }
+
+    void json(std::ostream& strm, const char *name, double duration)
+    {
+        Guard G(lock);
+        strm << "  \"" << name << "\": {\"ok\": " << ok << ", \"fail\": " << fail
+             << ", \"timeout\": " << timeout
+             << ", \"rate\": " << (duration>0.0 ? ok/duration : 0.0)
+             << ", \"latency_us\": {\"mean\": " << latency.mean()*1e6
+             << ", \"p50\": " << latency.percentile(0.5)*1e6
+             << ", \"p90\": " << latency.percentile(0.9)*1e6
+             << ", \"p99\": " << latency.percentile(0.99)*1e6
+             << ", \"max\": " << latency.max()*1e6 << "}}";
+    }
+};
+
+RequestStats connectStats, getStats, putStats, rpcStats;
+
+struct MonitorStats {
+    epicsMutex lock;
+    size_t updates, overruns, disconnects, fail;
+
+    MonitorStats() :updates(0u), overruns(0u), disconnects(0u), fail(0u) {}
+} monitorStats;
+
+struct Worker;
+
+// One get, put or rpc on one PV, repeated at a rate
+struct Request : public pvac::ClientChannel::GetCallback,
+                 public pvac::ClientChannel::PutCallback
+{
+    Worker& worker;
+    RequestStats& stats;
+    double period;     // 0 if not issued
+    epicsTime next, started;
+    bool busy;         // guarded by Worker::lock
+    pvac::Operation op;
+    double counter;
+
+    Request(Worker& worker, RequestStats& stats, double rate)
+        :worker(worker), stats(stats), period(rate>0.0 ? 1.0/rate : 0.0)
+        ,next(epicsTime::getCurrent()), busy(false), counter(0.0)
+    {}
+    virtual ~Request() {}
+
+    void complete(bool success);
+
+    virtual void getDone(const pvac::GetEvent& evt)
+    {
+        if(evt.event!=pvac::GetEvent::Cancel)
+            complete(evt.event==pvac::GetEvent::Success);
+    }
+
+    virtual void putBuild(const epics::pvData::StructureConstPtr& build, Args& args)
+    {
+        PVStructurePtr root(getPVDataCreate()->createPVStructure(build));
+        PVScalarPtr value(root->getSubField<PVScalar>("value"));
+        if(!value)
+            throw std::runtime_error("No scalar 'value' field to put");
+        value->putFrom<double>(counter++);
+        args.tosend.set(value->getFieldOffset());
+        args.root = root;
+    }
+
+    virtual void putDone(const pvac::PutEvent& evt)
+    {
+        if(evt.event!=pvac::PutEvent::Cancel)
+            complete(evt.event==pvac::PutEvent::Success);
+    }
+};
+
+// One subscription, counting its updates
+struct Subscription : public pvac::ClientChannel::MonitorCallback
+{
+    epicsMutex lock;
+    pvac::Monitor mon;
+
+    virtual ~Subscription() {}
+
+    void start(pvac::ClientChannel& chan, const PVStructure::const_shared_pointer& pvRequest)
+    {
+        pvac::Monitor temp(chan.monitor(this, pvRequest));
+        {
+            Guard G(lock);
+            mon = temp;
+        }
+        // a Data event before mon was set is not repeated until poll()==false
+        drain();
+    }
+
+    void cancel()
+    {
+        pvac::Monitor temp;
+        {
+            Guard G(lock);
+            temp = mon;
+            mon = pvac::Monitor();
+        }
+        // not while locked, waits for a callback in progress
+        temp.cancel();
+    }
+
+    void drain()
+    {
+        pvac::Monitor temp;
+        {
+            Guard G(lock);
+            temp = mon;
+        }
+        size_t updates = 0u, overruns = 0u;
+        while(temp.valid() && temp.poll()) {
+            updates++;
+            if(!temp.overrun.isEmpty())
+                overruns++;
+        }
+        Guard G(monitorStats.lock);
+        monitorStats.updates += updates;
+        monitorStats.overruns += overruns;
+    }
+
+    virtual void monitorEvent(const pvac::MonitorEvent& evt)
+    {
+        if(evt.event==pvac::MonitorEvent::Data) {
+            drain();
+
+        } else if(evt.event==pvac::MonitorEvent::Disconnect) {
+            Guard G(monitorStats.lock);
+            monitorStats.disconnects++;
+
+        } else if(evt.event==pvac::MonitorEvent::Fail) {
+            Guard G(monitorStats.lock);
+            monitorStats.fail++;
+        }
+    }
+};
+
+// One PV, with its requests and monitors
+struct LoadChannel : public pvac::ClientChannel::ConnectCallback
+{
+    const string name;
+    pvac::ClientProvider provider;
+    Worker& worker;
+
+    pvac::ClientChannel chan;
+    epicsTime connectStarted;
+    bool connected; // guarded by Worker::lock
+    epicsTime nextChurn;
+
+    Request get, put, rpc;
+    PVStructure::const_shared_pointer rpcArgs;
+    std::vector<TR1::shared_ptr<Subscription> > monitors;
+
+    LoadChannel(const string& name, const pvac::ClientProvider& provider, Worker& worker);
+    virtual ~LoadChannel() {}
+
+    void open();
+    void close();
+
+    virtual void connectEvent(const pvac::ConnectEvent& evt);
+};
+
+// Issues the requests of some PVs
+struct Worker : public epicsThreadRunable
+{
+    epicsMutex lock;
+    epicsEvent wakeup;
+    std::vector<LoadChannel*> channels;
+    PVStructure::const_shared_pointer pvRequest;
+    size_t nmonitors;
+    double churnPeriod;
+    epicsTime end;
+    epicsThread thread;
+
+    Worker(size_t nmonitors, double churnPeriod)
+        :nmonitors(nmonitors), churnPeriod(churnPeriod)
+        ,thread(*this, "pvload", epicsThreadGetStackSize(epicsThreadStackSmall))
+    {}
+    virtual ~Worker()
+    {
+        for(size_t i=0; i<channels.size(); i++)
+            delete channels[i];
+    }
+
+    // start the request if due.  Returns the time until it is due next.
+    double issue(LoadChannel& ch, Request& req, const epicsTime& now, int kind)
+    {
+        if(req.period<=0.0)
+            return 1.0;
+
+        {
+            Guard G(lock);
+            if(req.busy) {
+                if(now - req.started < timeOut)
+                    return req.period;
+                // give up
+                req.busy = false;
+                Guard S(req.stats.lock);
+                req.stats.timeout++;
+            }
+            if(!ch.connected)
+                return 1.0;
+            if(now < req.next)
+                return req.next - now;
+            req.busy = true;
+        }
+
+        // release the previous operation after its time out, or completion
+        req.op = pvac::Operation();
+        req.started = now;
+        // after falling behind, don't try to catch up
+        req.next += req.period;
+        if(req.next < now)
+            req.next = now;
+
+        try {
+            switch(kind) {
+            case 0: req.op = ch.chan.get(&req, pvRequest); break;
+            case 1: req.op = ch.chan.put(&req, pvRequest); break;
+            default: req.op = ch.chan.rpc(&req, ch.rpcArgs); break;
+            }
+        } catch(std::exception&) {
+            Guard G(lock);
+            req.busy = false;
+            req.stats.done(false, 0.0);
+        }
+        return req.period;
+    }
+
+    virtual void run()
+    {
+        while(!interrupted) {
+            const epicsTime now(epicsTime::getCurrent());
+            if(now >= end)
+                break;
+
+            double wait = end - now;
+            for(size_t i=0; i<channels.size(); i++) {
+                LoadChannel& ch = *channels[i];
+
+                if(churnPeriod>0.0 && now >= ch.nextChurn) {
+                    ch.close();
+                    ch.open();
+                    ch.nextChurn = now + churnPeriod;
+                }
+                if(churnPeriod>0.0)
+                    wait = std::min(wait, ch.nextChurn - now);
+
+                wait = std::min(wait, issue(ch, ch.get, now, 0));
+                wait = std::min(wait, issue(ch, ch.put, now, 1));
+                wait = std::min(wait, issue(ch, ch.rpc, now, 2));
+            }
+
+            if(wait > 0.0)
+                wakeup.wait(std::min(wait, 0.1));
+        }
+
+        for(size_t i=0; i<channels.size(); i++)
+            channels[i]->close();
+    }
+};
+
+void Request::complete(bool success)
+{
+    const double seconds = epicsTime::getCurrent() - started;
+    {
+        Guard G(worker.lock);
+        if(!busy)
+            return; // already counted as a timeout
+        busy = false;
+    }
+    stats.done(success, seconds);
+    worker.wakeup.signal();
+}
+
+LoadChannel::LoadChannel(const string& name, const pvac::ClientProvider& provider, Worker& worker)
+    :name(name), provider(provider), worker(worker)
+    ,connected(false)
+    ,get(worker, getStats, 0.0), put(worker, putStats, 0.0), rpc(worker, rpcStats, 0.0)
+{}
+
+void LoadChannel::open()
+{
+    connectStarted = epicsTime::getCurrent();
+    chan = provider.connect(name);
+    chan.addConnectListener(this);
+
+    monitors.resize(worker.nmonitors);
+    for(size_t i=0; i<monitors.size(); i++) {
+        monitors[i].reset(new Subscription);
+        monitors[i]->start(chan, worker.pvRequest);
+    }
+}
+
+void LoadChannel::close()
+{
+    if(!chan.valid())
+        return;
+
+    for(size_t i=0; i<monitors.size(); i++)
+        monitors[i]->cancel();
+    monitors.clear();
+
+    get.op.cancel();
+    put.op.cancel();
+    rpc.op.cancel();
+    {
+        Guard G(worker.lock);
+        connected = get.busy = put.busy = rpc.busy = false;
+    }
+
+    chan.removeConnectListener(this);
+    chan = pvac::ClientChannel();
+    // close the channel, so that open() connects again
+    provider.disconnect(name);
+}
+
+void LoadChannel::connectEvent(const pvac::ConnectEvent& evt)
+{
+    bool first = false;
+    {
+        Guard G(worker.lock);
+        first = evt.connected && !connected;
+        connected = evt.connected;
+    }
+    if(first)
+        connectStats.done(true, epicsTime::getCurrent() - connectStarted);
+    worker.wakeup.signal();
+}
+
+} // namespace
+
+int main (int argc, char *argv[])
+{
+    int opt;                    /* getopt() current option */
+
+    string request(DEFAULT_REQUEST);
+    epicsUInt32 nmonitors = 0u, nthreads = 1u;
+    double getRate = 0.0, putRate = 0.0, rpcRate = 0.0, churnPeriod = 0.0;
+    double duration = DEFAULT_DURATION;
+    istream* inputStream = 0;
+    ifstream ifs;
+    ofstream ofs;
+    ostream* out = &cout;
+
+    while ((opt = getopt(argc, argv, ":hVp:r:m:g:P:R:c:T:d:w:f:o:")) != -1) {
+        switch (opt) {
+        case 'h':               /* Print usage */
+            usage();
+            return 0;
+        case 'V':               /* Print version */
+        {
+            Version version("pvload", "cpp",
+                    EPICS_PVA_MAJOR_VERSION,
+                    EPICS_PVA_MINOR_VERSION,
+                    EPICS_PVA_MAINTENANCE_VERSION,
+                    EPICS_PVA_DEVELOPMENT_FLAG);
+            fprintf(stdout, "%s\n", version.getVersionString().c_str());
+            return 0;
+        }
+        case 'p':               /* Set default provider */
+            defaultProvider = optarg;
+            break;
+        case 'r':               /* Set pvRequest */
+            request = optarg;
+            break;
+        case 'm':               /* Monitors per PV */
+        case 'T':               /* Threads */
+        {
+            epicsUInt32 temp;
+            if(epicsParseUInt32(optarg, &temp, 0, NULL) || (opt=='T' && temp==0u)) {
+                fprintf(stderr, "'%s' is not a valid count for -%c. ('pvload -h' for help.)\n", optarg, opt);
+                return 1;
+            }
+            (opt=='m' ? nmonitors : nthreads) = temp;
+            break;
+        }
+        case 'g':               /* Get rate */
+        case 'P':               /* Put rate */
+        case 'R':               /* RPC rate */
+        case 'c':               /* Churn period */
+        case 'd':               /* Duration */
+        case 'w':               /* Request timeout */
+        {
+            double temp;
+            if((epicsScanDouble(optarg, &temp)) != 1 || temp < 0.0 ||
+                    ((opt=='d' || opt=='w') && temp==0.0)) {
+                fprintf(stderr, "'%s' is not a valid value for -%c. ('pvload -h' for help.)\n", optarg, opt);
+                return 1;
+            }
+            switch(opt) {
+            case 'g': getRate = temp; break;
+            case 'P': putRate = temp; break;
+            case 'R': rpcRate = temp; break;
+            case 'c': churnPeriod = temp; break;
+            case 'd': duration = temp; break;
+            case 'w': timeOut = temp; break;
+            }
+            break;
+        }
+        case 'f':               /* Use input stream as input */
+        {
+            string fileName = optarg;
+            if (fileName == "-")
+                inputStream = &cin;
+            else
+            {
+                ifs.open(fileName.c_str(), ifstream::in);
+                if (!ifs)
+                {
+                    fprintf(stderr, "Failed to open file '%s'.\n", fileName.c_str());
+                    return 1;
+                }
+                inputStream = &ifs;
+            }
+            break;
+        }
+        case 'o':               /* JSON output */
+        {
+            string fileName = optarg;
+            if (fileName != "-")
+            {
+                ofs.open(fileName.c_str(), ofstream::out | ofstream::trunc);
+                if (!ofs)
+                {
+                    fprintf(stderr, "Failed to open file '%s'.\n", fileName.c_str());
+                    return 1;
+                }
+                out = &ofs;
+            }
+            break;
+        }
+        case '?':
+            fprintf(stderr,
+                    "Unrecognized option: '-%c'. ('pvload -h' for help.)\n",
+                    optopt);
+            return 1;
+        case ':':
+            fprintf(stderr,
+                    "Option '-%c' requires an argument. ('pvload -h' for help.)\n",
+                    optopt);
+            return 1;
+        default :
+            usage();
+            return 1;
+        }
+    }
+
+    vector<string> pvs;
+    for (; optind < argc; optind++)
+        pvs.push_back(argv[optind]);
+    if (inputStream)
+    {
+        string cn;
+        while (*inputStream >> cn)
+            pvs.push_back(cn);
+    }
+    if (pvs.empty())
+    {
+        fprintf(stderr, "No pv name(s) specified. ('pvload -h' for help.)\n");
+        return 1;
+    }
+
+    PVStructure::shared_pointer pvRequest;
+    try {
+        pvRequest = createRequest(request);
+    } catch(std::exception& e){
+        fprintf(stderr, "failed to parse request string: %s\n", e.what());
+        return 1;
+    }
+
+    SET_LOG_LEVEL(logLevelError);
+
+    epics::pvAccess::ca::CAClientFactory::start();
+
+    pvac::ClientProvider provider(defaultProvider);
+
+    StructureConstPtr argstype(getFieldCreate()->createFieldBuilder()
+                               ->setId("epics:nt/NTURI:1.0")
+                               ->add("scheme", pvString)
+                               ->add("path", pvString)
+                               ->createStructure());
+
+    // PVs are dealt to the threads in turn
+    nthreads = std::min(nthreads, epicsUInt32(pvs.size()));
+    vector<Worker*> workers(nthreads);
+    for (size_t t = 0; t < nthreads; t++)
+    {
+        workers[t] = new Worker(nmonitors, churnPeriod);
+        workers[t]->pvRequest = pvRequest;
+    }
+
+    for (size_t n = 0; n < pvs.size(); n++)
+    {
+        Worker& worker = *workers[n % nthreads];
+
+        LoadChannel *ch = new LoadChannel(pvs[n], provider, worker);
+        worker.channels.push_back(ch);
+
+        ch->get.period = getRate>0.0 ? 1.0/getRate : 0.0;
+        ch->put.period = putRate>0.0 ? 1.0/putRate : 0.0;
+        ch->rpc.period = rpcRate>0.0 ? 1.0/rpcRate : 0.0;
+
+        PVStructurePtr args(getPVDataCreate()->createPVStructure(argstype));
+        args->getSubFieldT<PVString>("scheme")->put("pva");
+        args->getSubFieldT<PVString>("path")->put(pvs[n]);
+        ch->rpcArgs = args;
+    }
+
+#ifdef USE_SIGNAL
+    signal(SIGINT, stopLoad);
+    signal(SIGTERM, stopLoad);
+#endif
+
+    const epicsTime start(epicsTime::getCurrent());
+    for (size_t t = 0; t < nthreads; t++)
+    {
+        Worker& worker = *workers[t];
+        worker.end = start + duration;
+        for (size_t i = 0; i < worker.channels.size(); i++)
+        {
+            LoadChannel& ch = *worker.channels[i];
+            ch.open();
+            // spread reconnects over the period
+            ch.nextChurn = start + churnPeriod*(double(i+1)/worker.channels.size());
+        }
+    }
+    for (size_t t = 0; t < nthreads; t++)
+        workers[t]->thread.start();
+    for (size_t t = 0; t < nthreads; t++)
+        workers[t]->thread.exitWait();
+
+    const double elapsed = epicsTime::getCurrent() - start;
+
+    for (size_t t = 0; t < nthreads; t++)
+        delete workers[t];
+
+    ostream& strm = *out;
+    strm << "{\n"
+         << "  \"provider\": \"" << defaultProvider << "\",\n"
+         << "  \"channels\": " << pvs.size() << ",\n"
+         << "  \"threads\": " << nthreads << ",\n"
+         << "  \"duration\": " << elapsed << ",\n"
+         << "  \"interrupted\": " << (interrupted ? "true" : "false") << ",\n";
+    connectStats.json(strm, "connect", elapsed);
+    strm << ",\n";
+    getStats.json(strm, "get", elapsed);
+    strm << ",\n";
+    putStats.json(strm, "put", elapsed);
+    strm << ",\n";
+    rpcStats.json(strm, "rpc", elapsed);
+    strm << ",\n";
+    {
+        Guard G(monitorStats.lock);
+        strm << "  \"monitor\": {\"subscriptions\": " << pvs.size()*nmonitors
+             << ", \"updates\": " << monitorStats.updates
+             << ", \"rate\": " << (elapsed>0.0 ? monitorStats.updates/elapsed : 0.0)
+             << ", \"overruns\": " << monitorStats.overruns
+             << ", \"disconnects\": " << monitorStats.disconnects
+             << ", \"fail\": " << monitorStats.fail << "}\n";
+    }
+    strm << "}\n";
+    strm.flush();
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <list>
 #include <string>
 #include <istream>
 #include <fstream>
@@ -11,6 +12,7 @@
 #include <epicsStdlib.h>
 #include <epicsGetopt.h>
 #include <epicsThread.h>
+#include <epicsTime.h>
 
 #include <pv/logger.h>
 #include <pv/lock.h>
@@ -47,6 +49,8 @@ double timeOut = DEFAULT_TIMEOUT;
 string request(DEFAULT_REQUEST);
 string defaultProvider(DEFAULT_PROVIDER);
 const string noAddress;
+// channel priority, which selects the connection, its I/O threads and socket options
+pvac::ClientChannel::Options channelOptions;
 
 enum PrintMode { ValueOnlyMode, StructureMode, TerseMode };
 PrintMode mode = ValueOnlyMode;
@@ -59,7 +63,8 @@ void usage (bool details=false)
              "Usage: pvput [options] <PV name> <value>\n"
              "       pvput [options] <PV name> <size/ignored> <value> [<value> ...]\n"
              "       pvput [options] <PV name> <field>=<value> ...\n"
-             "       pvput [options] <PV name> <json_array>\n");
+             "       pvput [options] <PV name> <json_array>\n"
+             "       pvput [options] -B <window> [-f <input file>]\n");
 #ifdef USE_JSON
     fprintf (stderr,
              "       pvput [options] <PV name> <json_map>\n");
@@ -73,11 +78,15 @@ void usage (bool details=false)
              "  -w <sec>:          Wait time, specifies timeout, default is %f second(s)\n"
              "  -t:                Terse mode - print only successfully written value, without names\n"
              "  -p <provider>:     Set default provider name, default is '%s'\n"
+             "  -P <priority>:     Channel priority, 0 (default) to 99.  Puts of another priority use their own connection\n"
              "  -v:                Show entire structure\n"
              "  -q:                Quiet mode, print only error messages\n"
              "  -d:                Enable debug output\n"
              "  -F <ofs>:          Use <ofs> as an alternate output field separator\n"
              "  -f <input file>:   Use <input file> as an input that provides a list PV name(s) to be read, use '-' for stdin\n"
+             "  -B <window>:       Bulk mode.  Each line of the input file (default stdin) is '<PV name> <value> ...',\n"
+             "                     with values as on the command line.  At most <window> puts are in progress at once,\n"
+             "                     each with its own timeout (-w).  Failures are listed at the end.\n"
              " enum format:\n"
              "  default: Auto - try value as enum string, then as index number\n"
              "  -n: Force enum interpretation of values as numbers\n"
@@ -100,6 +109,8 @@ void usage (bool details=false)
                  "  pvput arr:pv X 1.0 2.0  # shorthand  (X is arbitrary and ignored)\n"
                  "  pvput arr:pv \"[1.0, 2.0]\"            # shorthand\n"
                  "  pvput arr:pv value=\"[1.0, 2.0]\"\n"
+                 "\n"
+                 "  pvput -B 100 -f saveset.txt     # lines like 'double01 1.234'\n"
                  );
 #ifdef USE_JSON
         fprintf (stderr,
@@ -256,7 +267,7 @@ struct Putter : public pvac::ClientChannel::PutCallback
     pvac::PutEvent::event_t result;
     std::string message;
 
-    Putter() :done(false) {}
+    Putter() :done(false), notify(0) {}
 
     typedef shared_vector<std::string> bare_t;
     bare_t bare;
@@ -314,7 +325,10 @@ struct Putter : public pvac::ClientChannel::PutCallback
                 PVStructure* sfld(static_cast<PVStructure*>(fld.get()));
 
                 PVScalar* idxfld(sfld->getSubFieldT<PVScalar>("index").get());
-                PVStringArray::const_svector choices(current->getSubFieldT<PVStringArray>("value.choices")->view());
+                // bulk mode doesn't fetch the current value, so only accepts an index
+                PVStringArray::const_svector choices;
+                if(current)
+                    choices = current->getSubFieldT<PVStringArray>("value.choices")->view();
 
                 bool found=false;
                 for(size_t i=0; i<choices.size(); i++) {
@@ -391,9 +405,181 @@ struct Putter : public pvac::ClientChannel::PutCallback
         }
 
         wait.signal();
+        if(notify)
+            notify->signal();
+    }
+
+    // also signaled on completion, if set
+    epicsEvent *notify;
+};
+
+// Sort values into bare values or field=value pairs.  Returns false, after printing why, if they are unusable.
+bool parseValues(Putter& thework, const std::vector<std::string>& values)
+{
+    for(size_t i=0, N=values.size(); i<N; i++)
+    {
+        size_t sep = values[i].find_first_of('=');
+        if(sep==std::string::npos) {
+            thework.bare.push_back(values[i]);
+#ifndef USE_JSON
+            if(!thework.bare.back().empty() && thework.bare.back()[0]=='{') {
+                fprintf(stderr, "JSON syntax not supported by this build.\n");
+                return false;
+            }
+#endif
+        } else {
+            thework.pairs.push_back(std::make_pair(values[i].substr(0, sep),
+                                                   values[i].substr(sep+1)));
+#ifndef USE_JSON
+            if(!thework.pairs.back().second.empty() && thework.pairs.back().second[0]=='{') {
+                fprintf(stderr, "JSON syntax not supported by this build.\n");
+                return false;
+            }
+#endif
+        }
+    }
+
+    if(!thework.bare.empty() && !thework.pairs.empty()) {
+        fprintf(stderr, "Can't mix bare values and field=value pairs\n");
+        return false;
+
+    } else if(thework.bare.size()==1 && thework.bare[0][0]=='[') {
+        // treat plain "[...]" as "value=[...]"
+        thework.pairs.push_back(std::make_pair("value", thework.bare[0]));
+        thework.bare.clear();
     }
+    return true;
+}
+
+// Split a line of bulk input into PV name and values.  A value starting with '[' or '{' is the rest of the line.
+// Returns false for blank and comment lines.
+bool splitLine(const std::string& line, std::string& name, std::vector<std::string>& values)
+{
+    std::istringstream strm(line);
+    if(!(strm >> name) || name[0]=='#')
+        return false;
+
+    values.clear();
+    std::string val;
+    while(strm >> std::ws && strm.good()) {
+        int next = strm.peek();
+        if(next=='[' || next=='{') {
+            std::getline(strm, val);
+            // drop trailing whitespace, eg. '\r'
+            val.erase(val.find_last_not_of(" \t\r\n")+1u);
+        } else if(!(strm >> val)) {
+            break;
+        }
+        values.push_back(val);
+    }
+    return true;
+}
+
+struct BulkPutter : public Putter
+{
+    size_t line;
+    std::string name;
+    epicsTime started;
+    pvac::ClientChannel chan;
+    // last, so cancelled before the callback is destroyed
+    pvac::Operation op;
 };
 
+// Put each line of input, keeping at most window puts in progress.  Returns the number of failures.
+size_t bulkPut(std::istream& input, size_t window, pvac::ClientProvider& ctxt,
+               PVStructure::shared_pointer const & pvRequest)
+{
+    typedef std::tr1::shared_ptr<BulkPutter> putter_t;
+    typedef std::list<putter_t> inflight_t;
+    inflight_t inflight;
+    epicsEvent wakeup;
+
+    std::vector<std::string> failures;
+    size_t lineno = 0u, nput = 0u;
+    bool eof = false;
+
+    while(!eof || !inflight.empty()) {
+        bool progress = false;
+
+        while(!eof && inflight.size()<window) {
+            std::string line, name;
+            std::vector<std::string> values;
+            if(!std::getline(input, line)) {
+                eof = true;
+                break;
+            }
+            lineno++;
+            if(!splitLine(line, name, values))
+                continue;
+
+            progress = true;
+            nput++;
+
+            putter_t put(new BulkPutter);
+            put->notify = &wakeup;
+            put->line = lineno;
+            put->name = name;
+
+            std::ostringstream msg;
+            msg<<"line "<<lineno<<" : "<<name<<" : ";
+            if(values.empty()) {
+                msg<<"No value";
+                failures.push_back(msg.str());
+                continue;
+            } else if(!parseValues(*put, values)) {
+                msg<<"Invalid value";
+                failures.push_back(msg.str());
+                continue;
+            }
+
+            try {
+                put->chan = ctxt.connect(name, channelOptions);
+                put->started = epicsTime::getCurrent();
+                put->op = put->chan.put(put.get(), pvRequest);
+                inflight.push_back(put);
+            } catch(std::exception& e) {
+                msg<<e.what();
+                failures.push_back(msg.str());
+            }
+        }
+
+        const epicsTime now(epicsTime::getCurrent());
+
+        for(inflight_t::iterator it(inflight.begin()); it!=inflight.end(); ) {
+            BulkPutter& put = **it;
+            std::ostringstream msg;
+            {
+                epicsGuard<epicsMutex> G(put.lock);
+                if(put.done) {
+                    if(put.result!=pvac::PutEvent::Success)
+                        msg<<"line "<<put.line<<" : "<<put.name<<" : "
+                           <<(put.message.empty() ? "Put failed" : put.message.c_str());
+                } else if(now - put.started >= timeOut) {
+                    msg<<"line "<<put.line<<" : "<<put.name<<" : Put timeout";
+                } else {
+                    ++it;
+                    continue;
+                }
+            }
+            if(!msg.str().empty())
+                failures.push_back(msg.str());
+            if(debug)
+                std::cerr<<"Done "<<put.name<<"\n";
+            it = inflight.erase(it); // cancels if still in progress
+            progress = true;
+        }
+
+        if(!progress)
+            wakeup.wait(std::min(timeOut, 0.1));
+    }
+
+    for(size_t i=0; i<failures.size(); i++)
+        std::cerr<<failures[i]<<"\n";
+    std::cerr<<nput<<" puts, "<<(nput-failures.size())<<" OK, "<<failures.size()<<" failed\n";
+
+    return failures.size();
+}
+
 } // namespace
 
 int main (int argc, char *argv[])
@@ -404,11 +590,12 @@ int main (int argc, char *argv[])
     istream* inputStream = 0;
     ifstream ifs;
     bool fromStream = false;
+    size_t window = 0u;
 
     setvbuf(stdout,NULL,_IOLBF,BUFSIZ);    /* Set stdout to line buffering */
     putenv(const_cast<char*>("POSIXLY_CORRECT="));            /* Behave correct on GNU getopt systems; e.g. handle negative numbers */
 
-    while ((opt = getopt(argc, argv, ":hvVr:w:tp:qdF:f:ns")) != -1) {
+    while ((opt = getopt(argc, argv, ":hvVr:w:tp:P:qdF:f:nsB:")) != -1) {
         switch (opt) {
         case 'h':               /* Print usage */
             usage(true);
@@ -448,6 +635,18 @@ int main (int argc, char *argv[])
         case 'p':               /* Set default provider */
             defaultProvider = optarg;
             break;
+        case 'P':               /* Set channel priority */
+        {
+            epicsInt32 prio;
+            if(epicsParseInt32(optarg, &prio, 0, NULL) || prio < ChannelProvider::PRIORITY_MIN || prio > ChannelProvider::PRIORITY_MAX)
+            {
+                fprintf(stderr, "'%s' is not a valid priority "
+                        "- ignored. ('pvput -h' for help.)\n", optarg);
+                prio = ChannelProvider::PRIORITY_DEFAULT;
+            }
+            channelOptions.priority = short(prio);
+            break;
+        }
         case 'q':               /* Quiet mode */
             quiet = true;
             break;
@@ -482,6 +681,16 @@ int main (int argc, char *argv[])
         case 's':
             enumMode = StringEnum;
             break;
+        case 'B':               /* Bulk mode */
+        {
+            epicsUInt32 temp;
+            if(epicsParseUInt32(optarg, &temp, 0, NULL) || temp==0u) {
+                fprintf(stderr, "'%s' is not a valid window size. ('pvput -h' for help.)\n", optarg);
+                return 1;
+            }
+            window = temp;
+            break;
+        }
         case '?':
             fprintf(stderr,
                     "Unrecognized option: '-%c'. ('pvput -h' for help.)\n",
@@ -498,6 +707,31 @@ int main (int argc, char *argv[])
         }
     }
 
+    if (window)
+    {
+        if (argc > optind)
+        {
+            fprintf(stderr, "Bulk mode takes PV names and values only from its input. ('pvput -h' for help.)\n");
+            return 1;
+        }
+
+        PVStructure::shared_pointer pvRequest;
+        try {
+            pvRequest = createRequest(request);
+        } catch(std::exception& e){
+            fprintf(stderr, "failed to parse request string: %s\n", e.what());
+            return 1;
+        }
+
+        SET_LOG_LEVEL(debug ? logLevelDebug : logLevelError);
+
+        epics::pvAccess::ca::CAClientFactory::start();
+
+        pvac::ClientProvider ctxt(defaultProvider);
+
+        return bulkPut(fromStream ? *inputStream : cin, window, ctxt, pvRequest)==0u ? 0 : 1;
+    }
+
     if (argc <= optind)
     {
         fprintf(stderr, "No pv name specified. ('pvput -h' for help.)\n");
@@ -562,38 +796,9 @@ int main (int argc, char *argv[])
 
     Putter thework;
 
-    for(size_t i=0, N=values.size(); i<N; i++)
-    {
-        size_t sep = values[i].find_first_of('=');
-        if(sep==std::string::npos) {
-            thework.bare.push_back(values[i]);
-#ifndef USE_JSON
-            if(!thework.bare.back().empty() && thework.bare.back()[0]=='{') {
-                fprintf(stderr, "JSON syntax not supported by this build.\n");
-                return 1;
-            }
-#endif
-        } else {
-            thework.pairs.push_back(std::make_pair(values[i].substr(0, sep),
-                                                   values[i].substr(sep+1)));
-#ifndef USE_JSON
-            if(!thework.pairs.back().second.empty() && thework.pairs.back().second[0]=='{') {
-                fprintf(stderr, "JSON syntax not supported by this build.\n");
-                return 1;
-            }
-#endif
-        }
-    }
-
-    if(!thework.bare.empty() && !thework.pairs.empty()) {
+    if(!parseValues(thework, values)) {
         usage();
-        fprintf(stderr, "\nCan't mix bare values and field=value pairs\n");
         return 1;
-
-    } else if(thework.bare.size()==1 && thework.bare[0][0]=='[') {
-        // treat plain "[...]" as "value=[...]"
-        thework.pairs.push_back(std::make_pair("value", thework.bare[0]));
-        thework.bare.clear();
     }
 
     PVStructure::shared_pointer pvRequest;
@@ -612,7 +817,7 @@ int main (int argc, char *argv[])
 
     pvac::ClientProvider ctxt(providerName);
 
-    pvac::ClientChannel chan(ctxt.connect(pvName));
+    pvac::ClientChannel chan(ctxt.connect(pvName, channelOptions));
 
     thework.current = chan.get(timeOut, pvRequest);
 
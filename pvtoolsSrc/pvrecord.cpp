@@ -0,0 +1,366 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <stdio.h>
+
+#if !defined(_WIN32)
+#include <signal.h>
+#define USE_SIGNAL
+#endif
+
+#include <epicsStdlib.h>
+#include <epicsGetopt.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsGuard.h>
+#include <epicsTime.h>
+
+#include <pv/logger.h>
+
+#include <pva/client.h>
+
+#include <pv/caProvider.h>
+
+#include "pvutils.cpp"
+#include "pvrecorder.cpp"
+
+using namespace std;
+namespace TR1 = std::tr1;
+using namespace epics::pvData;
+using namespace epics::pvAccess;
+
+namespace {
+
+typedef epicsGuard<epicsMutex> Guard;
+
+#define DEFAULT_PROVIDER "pva"
+#define DEFAULT_REQUEST "field()"
+#define DEFAULT_SEGMENT_MB 256u
+#define DEFAULT_INTERVAL 10.0
+
+string defaultProvider(DEFAULT_PROVIDER);
+
+epicsEvent done;
+
+#ifdef USE_SIGNAL
+void stopRecording(int)
+{
+    done.signal();
+}
+#endif
+
+void usage (void)
+{
+    fprintf (stderr, "\nUsage: pvrecord [options] -o <directory> <PV name>...\n\n"
+             "Record every update of the named PVs into memory mapped segment files in <directory>,\n"
+             "for replay by 'pvcat <directory>'.  An existing recording is appended to.\n"
+             "\noptions:\n"
+             "  -h: Help: Print this message\n"
+             "  -V: Print version and exit\n"
+             "  -p <provider>:     Set default provider name, default is '%s'\n"
+             "  -r <pv request>:   Monitor request, default is '%s'\n"
+             "  -o <directory>:    Recording directory, created if needed\n"
+             "  -S <MB>:           Segment size, default %u MB\n"
+             "  -w <sec>:          Stop after <sec> seconds, default when interrupted\n"
+             "  -i <sec>:          Print statistics every <sec> seconds, default %.0f, 0 never\n"
+             "  -f <input file>:   Read PV names from <input file>, use '-' for stdin\n"
+             "\nEach update is serialized once, into the page cache, by the thread which received it.\n"
+             "For fast large arrays, increase the client queue, eg. -r 'record[queueSize=16]field()'.\n"
+             "\nexample: pvrecord -o /data/run1 -S 1024 camera:image\n\n"
+             , DEFAULT_PROVIDER, DEFAULT_REQUEST, DEFAULT_SEGMENT_MB, DEFAULT_INTERVAL);
+}
+
+RecordingWriter *writer;
+
+struct MonitorCounts {
+    epicsMutex lock;
+    size_t overruns, disconnects, errors;
+    MonitorCounts() :overruns(0u), disconnects(0u), errors(0u) {}
+} counts;
+
+struct Recorder : public pvac::ClientChannel::MonitorCallback
+{
+    const string name;
+    epicsMutex lock;
+    pvac::Monitor mon;
+
+    explicit Recorder(const string& name) :name(name) {}
+    virtual ~Recorder() {}
+
+    void start(pvac::ClientChannel& chan, const PVStructure::const_shared_pointer& pvRequest)
+    {
+        pvac::Monitor temp(chan.monitor(this, pvRequest));
+        {
+            Guard G(lock);
+            mon = temp;
+        }
+        // a Data event before mon was set is not repeated until poll()==false
+        drain();
+    }
+
+    void cancel()
+    {
+        pvac::Monitor temp;
+        {
+            Guard G(lock);
+            temp = mon;
+            mon = pvac::Monitor();
+        }
+        // not while locked, waits for a callback in progress
+        temp.cancel();
+    }
+
+    void drain()
+    {
+        pvac::Monitor temp;
+        {
+            Guard G(lock);
+            temp = mon;
+        }
+        size_t overruns = 0u, errors = 0u;
+        while(temp.valid() && temp.poll()) {
+            if(!temp.overrun.isEmpty())
+                overruns++;
+            try {
+                writer->write(name, *temp.root, temp.changed, temp.overrun);
+            } catch(std::exception& e) {
+                if(!errors++)
+                    fprintf(stderr, "%s : %s\n", name.c_str(), e.what());
+            }
+        }
+        if(overruns || errors) {
+            Guard G(counts.lock);
+            counts.overruns += overruns;
+            counts.errors += errors;
+        }
+    }
+
+    virtual void monitorEvent(const pvac::MonitorEvent& evt)
+    {
+        if(evt.event==pvac::MonitorEvent::Data) {
+            drain();
+
+        } else if(evt.event==pvac::MonitorEvent::Disconnect) {
+            Guard G(counts.lock);
+            counts.disconnects++;
+
+        } else if(evt.event==pvac::MonitorEvent::Fail) {
+            fprintf(stderr, "%s : %s\n", name.c_str(), evt.message.c_str());
+            Guard G(counts.lock);
+            counts.errors++;
+        }
+    }
+};
+
+void showStats(const RecordingWriter::Stats& stats, const RecordingWriter::Stats& prev, double dT)
+{
+    size_t overruns, disconnects, errors;
+    {
+        Guard G(counts.lock);
+        overruns = counts.overruns;
+        disconnects = counts.disconnects;
+        errors = counts.errors;
+    }
+    fprintf(stderr, "%lu updates (%.0f/s), %.1f MB (%.1f MB/s), %lu segments, %lu overruns, %lu disconnects, %lu errors\n",
+            (unsigned long)stats.updates, (stats.updates-prev.updates)/dT,
+            stats.bytes/1e6, (stats.bytes-prev.bytes)/dT/1e6,
+            (unsigned long)stats.segments, (unsigned long)overruns,
+            (unsigned long)disconnects, (unsigned long)errors);
+}
+
+} // namespace
+
+int main (int argc, char *argv[])
+{
+    int opt;                    /* getopt() current option */
+
+    string request(DEFAULT_REQUEST);
+    string directory;
+    epicsUInt32 segmentMB = DEFAULT_SEGMENT_MB;
+    double duration = 0.0, interval = DEFAULT_INTERVAL;
+    istream* inputStream = 0;
+    ifstream ifs;
+
+    while ((opt = getopt(argc, argv, ":hVp:r:o:S:w:i:f:")) != -1) {
+        switch (opt) {
+        case 'h':               /* Print usage */
+            usage();
+            return 0;
+        case 'V':               /* Print version */
+        {
+            Version version("pvrecord", "cpp",
+                    EPICS_PVA_MAJOR_VERSION,
+                    EPICS_PVA_MINOR_VERSION,
+                    EPICS_PVA_MAINTENANCE_VERSION,
+                    EPICS_PVA_DEVELOPMENT_FLAG);
+            fprintf(stdout, "%s\n", version.getVersionString().c_str());
+            return 0;
+        }
+        case 'p':               /* Set default provider */
+            defaultProvider = optarg;
+            break;
+        case 'r':               /* Set pvRequest */
+            request = optarg;
+            break;
+        case 'o':               /* Recording directory */
+            directory = optarg;
+            break;
+        case 'S':               /* Segment size */
+            if(epicsParseUInt32(optarg, &segmentMB, 0, NULL) || segmentMB==0u || segmentMB>4095u) {
+                fprintf(stderr, "'%s' is not a valid segment size (1-4095 MB). ('pvrecord -h' for help.)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'w':               /* Duration */
+        case 'i':               /* Statistics interval */
+        {
+            double temp;
+            if((epicsScanDouble(optarg, &temp)) != 1 || temp < 0.0) {
+                fprintf(stderr, "'%s' is not a valid value for -%c. ('pvrecord -h' for help.)\n", optarg, opt);
+                return 1;
+            }
+            (opt=='w' ? duration : interval) = temp;
+            break;
+        }
+        case 'f':               /* Use input stream as input */
+        {
+            string fileName = optarg;
+            if (fileName == "-")
+                inputStream = &cin;
+            else
+            {
+                ifs.open(fileName.c_str(), ifstream::in);
+                if (!ifs)
+                {
+                    fprintf(stderr, "Failed to open file '%s'.\n", fileName.c_str());
+                    return 1;
+                }
+                inputStream = &ifs;
+            }
+            break;
+        }
+        case '?':
+            fprintf(stderr,
+                    "Unrecognized option: '-%c'. ('pvrecord -h' for help.)\n",
+                    optopt);
+            return 1;
+        case ':':
+            fprintf(stderr,
+                    "Option '-%c' requires an argument. ('pvrecord -h' for help.)\n",
+                    optopt);
+            return 1;
+        default :
+            usage();
+            return 1;
+        }
+    }
+
+    if (directory.empty())
+    {
+        fprintf(stderr, "No recording directory specified. ('pvrecord -h' for help.)\n");
+        return 1;
+    }
+
+    vector<string> pvs;
+    for (; optind < argc; optind++)
+        pvs.push_back(argv[optind]);
+    if (inputStream)
+    {
+        string cn;
+        while (*inputStream >> cn)
+            pvs.push_back(cn);
+    }
+    if (pvs.empty())
+    {
+        fprintf(stderr, "No pv name(s) specified. ('pvrecord -h' for help.)\n");
+        return 1;
+    }
+
+    PVStructure::shared_pointer pvRequest;
+    try {
+        pvRequest = createRequest(request);
+    } catch(std::exception& e){
+        fprintf(stderr, "failed to parse request string: %s\n", e.what());
+        return 1;
+    }
+
+    epics::auto_ptr<RecordingWriter> recording;
+    try {
+        recording.reset(new RecordingWriter(directory, size_t(segmentMB)<<20u));
+    } catch(std::exception& e){
+        fprintf(stderr, "Failed to open recording: %s\n", e.what());
+        return 1;
+    }
+    writer = recording.get();
+
+    SET_LOG_LEVEL(logLevelError);
+
+    epics::pvAccess::ca::CAClientFactory::start();
+
+    pvac::ClientProvider provider(defaultProvider);
+
+    vector<pvac::ClientChannel> channels;
+    vector<TR1::shared_ptr<Recorder> > recorders;
+    for (size_t n = 0; n < pvs.size(); n++)
+    {
+        TR1::shared_ptr<Recorder> rec(new Recorder(pvs[n]));
+        channels.push_back(provider.connect(pvs[n]));
+        rec->start(channels.back(), pvRequest);
+        recorders.push_back(rec);
+    }
+
+#ifdef USE_SIGNAL
+    signal(SIGINT, stopRecording);
+    signal(SIGTERM, stopRecording);
+#endif
+
+    const epicsTime start(epicsTime::getCurrent());
+    epicsTime last(start);
+    RecordingWriter::Stats prev;
+    writer->getStats(prev);
+
+    for(;;) {
+        double wait = interval;
+        if(duration>0.0) {
+            const double left = duration - (epicsTime::getCurrent() - start);
+            if(left<=0.0)
+                break;
+            if(wait<=0.0 || wait>left)
+                wait = left;
+        }
+        if(wait<=0.0) {
+            done.wait();
+            break;
+        } else if(done.wait(wait)) {
+            break;
+        }
+
+        const epicsTime now(epicsTime::getCurrent());
+        if(interval>0.0 && now - last >= 0.99*interval) {
+            RecordingWriter::Stats stats;
+            writer->getStats(stats);
+            showStats(stats, prev, now - last);
+            prev = stats;
+            last = now;
+        }
+    }
+
+    for (size_t n = 0; n < recorders.size(); n++)
+        recorders[n]->cancel();
+    writer->close();
+
+    RecordingWriter::Stats stats, none;
+    writer->getStats(stats);
+    memset(&none, 0, sizeof(none));
+    showStats(stats, none, epicsTime::getCurrent() - start);
+
+    size_t errors;
+    {
+        Guard G(counts.lock);
+        errors = counts.errors;
+    }
+    return errors ? 1 : 0;
+}
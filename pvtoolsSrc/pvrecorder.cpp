@@ -0,0 +1,533 @@
+#include "pvrecorder.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include <errno.h>
+
+#include <epicsGuard.h>
+#include <epicsEndian.h>
+#include <epicsStdio.h>
+
+#include <pv/serializeHelper.h>
+
+#if !defined(_WIN32)
+#  define PVRECORDER_HAVE_MMAP
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace {
+const char recordingMagic[4] = {'P', 'V', 'A', 'R'};
+const epics::pvData::int8 recordingVersion = 1;
+const size_t recordingHeaderSize = 64u;
+
+// thrown by RecordingWriter when an update does not fit in what is left of the segment
+struct SegmentFull {};
+
+std::string segmentName(const std::string& dir, epics::pvData::uint32 number)
+{
+    char name[32];
+    epicsSnprintf(name, sizeof(name), "/seg-%06u.pvr", unsigned(number));
+    return dir + name;
+}
+
+std::string systemError(const std::string& what)
+{
+    return what + " : " + strerror(errno);
+}
+
+bool fileExists(const std::string& name)
+{
+#ifdef PVRECORDER_HAVE_MMAP
+    struct stat info;
+    return ::stat(name.c_str(), &info)==0;
+#else
+    return false;
+#endif
+}
+
+bool before(const epicsTimeStamp& lhs, const epicsTimeStamp& rhs)
+{
+    return epicsTime(lhs) < epicsTime(rhs);
+}
+}
+
+RecordingWriter::RecordingWriter(const std::string& dir, size_t segmentSize)
+    :dir(dir)
+    // whole records, each 8 byte aligned
+    ,segmentSize((std::max(segmentSize, size_t(4096u))+7u)&~size_t(7u))
+    ,segment(0u)
+    ,fd(-1)
+    ,base(0)
+    ,segmentUpdates(0u)
+    ,index(0)
+{
+    memset(&stats, 0, sizeof(stats));
+    memset(&first, 0, sizeof(first));
+    memset(&last, 0, sizeof(last));
+#ifdef PVRECORDER_HAVE_MMAP
+    if(::mkdir(dir.c_str(), 0777)!=0 && errno!=EEXIST)
+        throw std::runtime_error(systemError(dir));
+
+    // append after any segments already recorded
+    while(fileExists(segmentName(dir, segment)))
+        segment++;
+
+    index = fopen((dir+"/index").c_str(), "a");
+    if(!index)
+        throw std::runtime_error(systemError(dir+"/index"));
+#else
+    throw std::runtime_error("Recording is not supported on this platform");
+#endif
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    close();
+    if(index)
+        fclose(index);
+}
+
+void RecordingWriter::close()
+{
+    epicsGuard<epicsMutex> G(lock);
+    if(base)
+        closeSegment();
+}
+
+void RecordingWriter::getStats(Stats& stats) const
+{
+    epicsGuard<epicsMutex> G(lock);
+    stats = this->stats;
+}
+
+void RecordingWriter::openSegment()
+{
+#ifdef PVRECORDER_HAVE_MMAP
+    const std::string fname(segmentName(dir, segment));
+    fd = ::open(fname.c_str(), O_RDWR|O_CREAT|O_EXCL, 0644);
+    if(fd<0)
+        throw std::runtime_error(systemError(fname));
+
+    // allocate blocks now, not as pages are first written.  Not all file systems can.
+#ifdef __linux__
+    if(posix_fallocate(fd, 0, off_t(segmentSize))!=0)
+#endif
+    if(ftruncate(fd, off_t(segmentSize))!=0) {
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error(systemError(fname));
+    }
+
+    void *mem = mmap(0, segmentSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mem==MAP_FAILED) {
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error(systemError(fname));
+    }
+    madvise(mem, segmentSize, MADV_SEQUENTIAL);
+    base = static_cast<char*>(mem);
+    buffer.reset(new epics::pvData::ByteBuffer(base, segmentSize));
+
+    // new pages are zeroed, as is the remainder of the header
+    buffer->put(recordingMagic, 0, sizeof(recordingMagic));
+    buffer->putByte(recordingVersion);
+    buffer->putByte(buffer->getByteOrder()==EPICS_ENDIAN_BIG ? 0 : 1);
+    buffer->setPosition(8u);
+    buffer->putInt(epics::pvData::int32(segment));
+    buffer->setPosition(recordingHeaderSize);
+
+    segmentUpdates = 0u;
+    stats.segments++;
+#endif
+}
+
+void RecordingWriter::closeSegment()
+{
+#ifdef PVRECORDER_HAVE_MMAP
+    const size_t used = buffer->getPosition();
+    buffer.reset();
+    munmap(base, segmentSize);
+    base = 0;
+    // written pages are left to the page cache
+    if(ftruncate(fd, off_t(used))!=0)
+        fprintf(stderr, "%s\n", systemError(segmentName(dir, segment)).c_str());
+    ::close(fd);
+    fd = -1;
+
+    if(segmentUpdates) {
+        fprintf(index, "%u %u %u %u %u %lu\n", unsigned(segment),
+                unsigned(first.secPastEpoch), unsigned(first.nsec),
+                unsigned(last.secPastEpoch), unsigned(last.nsec),
+                (unsigned long)segmentUpdates);
+        fflush(index);
+    }
+    segment++;
+#endif
+}
+
+size_t RecordingWriter::beginRecord(epics::pvData::int8 rtype)
+{
+    // records end 8 byte aligned
+    ensureBuffer(8u);
+    const size_t start = buffer->getPosition();
+    buffer->putInt(0); // length, set by endRecord()
+    buffer->putByte(rtype);
+    buffer->setPosition(start+8u);
+    return start;
+}
+
+void RecordingWriter::endRecord(size_t start)
+{
+    size_t end = (buffer->getPosition()+7u)&~size_t(7u);
+    ensureBuffer(end-buffer->getPosition());
+    while(buffer->getPosition()<end)
+        buffer->putByte(0);
+
+    buffer->setPosition(start);
+    buffer->putInt(epics::pvData::int32(end-start));
+    buffer->setPosition(end);
+}
+
+void RecordingWriter::write(const std::string& name,
+                            const epics::pvData::PVStructure& value,
+                            const epics::pvData::BitSet& changed,
+                            const epics::pvData::BitSet& overrun)
+{
+    using namespace epics::pvData;
+    epicsGuard<epicsMutex> G(lock);
+
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+
+    const StructureConstPtr& type = value.getStructure();
+    channels_t::iterator it(channels.find(name));
+    if(it==channels.end()) {
+        Channel chan;
+        chan.id = channels.size();
+        chan.segment = uint32(-1);
+        it = channels.insert(std::make_pair(name, chan)).first;
+    }
+
+    for(;;) {
+        if(!base)
+            openSegment();
+
+        const size_t start = buffer->getPosition();
+        // first update in this segment
+        const bool complete = it->second.segment!=segment || it->second.type!=type;
+
+        try {
+            if(complete) {
+                size_t rec = beginRecord('T');
+                SerializeHelper::writeSize(it->second.id, buffer.get(), this);
+                SerializeHelper::serializeString(name, buffer.get(), this);
+                type->serialize(buffer.get(), this);
+                endRecord(rec);
+            }
+
+            size_t rec = beginRecord('U');
+            SerializeHelper::writeSize(it->second.id, buffer.get(), this);
+            ensureBuffer(9u);
+            buffer->putInt(int32(now.secPastEpoch));
+            buffer->putInt(int32(now.nsec));
+            buffer->putByte(complete ? 1 : 0);
+            changed.serialize(buffer.get(), this);
+            overrun.serialize(buffer.get(), this);
+            if(complete)
+                value.serialize(buffer.get(), this);
+            else
+                value.serialize(buffer.get(), this, &changed);
+            endRecord(rec);
+
+        } catch(SegmentFull&) {
+            // zero the length of the first record discarded, which ends the segment
+            buffer->setPosition(start);
+            if(buffer->getRemaining()>=4u)
+                buffer->putInt(0);
+            buffer->setPosition(start);
+
+            if(start==recordingHeaderSize)
+                throw std::runtime_error("Update of "+name+" is larger than a segment");
+            closeSegment();
+            continue;
+        }
+
+        it->second.type = type;
+        it->second.segment = segment;
+
+        if(!segmentUpdates)
+            first = now;
+        last = now;
+        segmentUpdates++;
+        stats.updates++;
+        stats.bytes += buffer->getPosition()-start;
+        break;
+    }
+}
+
+void RecordingWriter::flushSerializeBuffer()
+{
+    // nothing to flush.  The segment is the buffer.
+}
+
+void RecordingWriter::ensureBuffer(std::size_t size)
+{
+    if(buffer->getRemaining()<size)
+        throw SegmentFull();
+}
+
+void RecordingWriter::alignBuffer(std::size_t) {}
+
+bool RecordingWriter::directSerialize(epics::pvData::ByteBuffer *, const char* toSerialize,
+                                      std::size_t elementCount, std::size_t elementSize)
+{
+    // arrays are copied once, into the mapped segment
+    ensureBuffer(elementCount*elementSize);
+    buffer->put(toSerialize, 0, elementCount*elementSize);
+    return true;
+}
+
+void RecordingWriter::cachedSerialize(std::tr1::shared_ptr<const epics::pvData::Field> const & field,
+                                      epics::pvData::ByteBuffer* buffer)
+{
+    // no cache, each type is written in full
+    field->serialize(buffer, this);
+}
+
+RecordingReader::RecordingReader(const std::string& dir)
+    :dir(dir)
+    ,current(0u)
+    ,base(0)
+    ,mapSize(0u)
+    ,recordEnd(0u)
+    ,skipping(false)
+{
+    memset(&skipBefore, 0, sizeof(skipBefore));
+#ifdef PVRECORDER_HAVE_MMAP
+    FILE *index = fopen((dir+"/index").c_str(), "r");
+    if(!index)
+        throw std::runtime_error(systemError(dir+"/index"));
+
+    unsigned number, fsec, fnsec, lsec, lnsec;
+    unsigned long updates;
+    while(fscanf(index, "%u %u %u %u %u %lu", &number, &fsec, &fnsec, &lsec, &lnsec, &updates)==6) {
+        Segment seg;
+        seg.number = number;
+        seg.indexed = true;
+        seg.first.secPastEpoch = fsec;
+        seg.first.nsec = fnsec;
+        seg.last.secPastEpoch = lsec;
+        seg.last.nsec = lnsec;
+        segments.push_back(seg);
+    }
+    fclose(index);
+
+    // the segment being written, or not indexed before a crash
+    Segment seg;
+    seg.number = segments.empty() ? 0u : segments.back().number+1u;
+    seg.indexed = false;
+    memset(&seg.first, 0, sizeof(seg.first));
+    memset(&seg.last, 0, sizeof(seg.last));
+    for(; fileExists(segmentName(dir, seg.number)); seg.number++)
+        segments.push_back(seg);
+#else
+    throw std::runtime_error("Recording is not supported on this platform");
+#endif
+}
+
+RecordingReader::~RecordingReader()
+{
+    closeSegment();
+}
+
+bool RecordingReader::openSegment(size_t idx)
+{
+#ifdef PVRECORDER_HAVE_MMAP
+    const std::string fname(segmentName(dir, segments[idx].number));
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if(fd<0) {
+        fprintf(stderr, "%s\n", systemError(fname).c_str());
+        return false;
+    }
+
+    struct stat info;
+    void *mem = MAP_FAILED;
+    if(fstat(fd, &info)==0 && size_t(info.st_size)>=recordingHeaderSize)
+        mem = mmap(0, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(mem==MAP_FAILED)
+        return false; // empty, just created
+    madvise(mem, size_t(info.st_size), MADV_SEQUENTIAL);
+
+    base = static_cast<char*>(mem);
+    mapSize = size_t(info.st_size);
+    // never written through
+    buffer.reset(new epics::pvData::ByteBuffer(base, mapSize));
+    buffer->setLimit(mapSize);
+
+    if(memcmp(base, recordingMagic, sizeof(recordingMagic))!=0 || base[4]!=recordingVersion) {
+        closeSegment();
+        throw std::runtime_error(fname+" is not a PVA recording segment");
+    }
+    buffer->setEndianess(base[5] ? EPICS_ENDIAN_LITTLE : EPICS_ENDIAN_BIG);
+    buffer->setPosition(recordingHeaderSize);
+    current = idx;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void RecordingReader::closeSegment()
+{
+#ifdef PVRECORDER_HAVE_MMAP
+    if(base) {
+        buffer.reset();
+        munmap(base, mapSize);
+        base = 0;
+        mapSize = 0u;
+    }
+#endif
+}
+
+epicsTimeStamp RecordingReader::startTime()
+{
+    epicsTimeStamp ret;
+    memset(&ret, 0, sizeof(ret));
+    if(segments.empty())
+        return ret;
+    else if(segments[0].indexed)
+        return segments[0].first;
+
+    // read up to the first update, then start again
+    closeSegment();
+    current = 0u;
+    skipping = false;
+
+    std::string name;
+    epics::pvData::PVStructure::shared_pointer value;
+    epics::pvData::BitSet changed, overrun;
+    if(!next(name, value, changed, overrun, ret))
+        memset(&ret, 0, sizeof(ret));
+
+    closeSegment();
+    current = 0u;
+    return ret;
+}
+
+void RecordingReader::seek(const epicsTimeStamp& time)
+{
+    closeSegment();
+
+    // the first segment not ending before time
+    current = 0u;
+    while(current<segments.size() && segments[current].indexed && before(segments[current].last, time))
+        current++;
+
+    skipBefore = time;
+    skipping = true;
+}
+
+bool RecordingReader::next(std::string& name,
+                           epics::pvData::PVStructure::shared_pointer& value,
+                           epics::pvData::BitSet& changed,
+                           epics::pvData::BitSet& overrun,
+                           epicsTimeStamp& received)
+{
+    using namespace epics::pvData;
+
+    for(;;) {
+        if(!base) {
+            if(current>=segments.size())
+                return false;
+            if(!openSegment(current)) {
+                current++;
+                continue;
+            }
+        }
+
+        const size_t start = buffer->getPosition();
+        const uint32 length = start+8u<=mapSize ? uint32(buffer->getInt()) : 0u;
+        if(length==0u) {
+            // end of segment
+            closeSegment();
+            current++;
+            continue;
+        } else if(length<8u || length%8u || length>mapSize-start) {
+            throw std::runtime_error("PVA recording corrupt");
+        }
+        const int8 rtype = buffer->getByte();
+        buffer->setPosition(start+8u);
+        recordEnd = start+length;
+
+        size_t id = SerializeHelper::readSize(buffer.get(), this);
+
+        if(rtype=='T') {
+            std::string cname(SerializeHelper::deserializeString(buffer.get(), this));
+            FieldConstPtr type(getFieldCreate()->deserialize(buffer.get(), this));
+            if(!type || type->getType()!=structure)
+                throw std::runtime_error("PVA recording channel type is not a structure");
+
+            if(id>=channels.size())
+                channels.resize(id+1u);
+            Channel& chan = channels[id];
+            chan.name = cname;
+            if(!chan.value || chan.value->getStructure()!=type)
+                chan.value = getPVDataCreate()->createPVStructure(std::tr1::static_pointer_cast<const Structure>(type));
+            buffer->setPosition(recordEnd);
+
+        } else if(rtype=='U') {
+            if(id>=channels.size() || !channels[id].value)
+                throw std::runtime_error("PVA recording update of unknown channel");
+
+            ensureData(9u);
+            received.secPastEpoch = epicsUInt32(buffer->getInt());
+            received.nsec = epicsUInt32(buffer->getInt());
+            const bool complete = buffer->getByte()!=0;
+            changed.deserialize(buffer.get(), this);
+            overrun.deserialize(buffer.get(), this);
+            // updates before a seek are applied, not returned
+            if(complete)
+                channels[id].value->deserialize(buffer.get(), this);
+            else
+                channels[id].value->deserialize(buffer.get(), this, &changed);
+            buffer->setPosition(recordEnd);
+
+            if(skipping) {
+                if(before(received, skipBefore))
+                    continue;
+                skipping = false;
+            }
+
+            name = channels[id].name;
+            value = channels[id].value;
+            return true;
+
+        } else {
+            throw std::runtime_error("PVA recording corrupt");
+        }
+    }
+}
+
+void RecordingReader::ensureData(std::size_t size)
+{
+    if(buffer->getPosition()+size>recordEnd)
+        throw std::runtime_error("PVA recording record truncated");
+}
+
+void RecordingReader::alignData(std::size_t) {}
+
+bool RecordingReader::directDeserialize(epics::pvData::ByteBuffer *, char*, std::size_t, std::size_t)
+{
+    return false;
+}
+
+std::tr1::shared_ptr<const epics::pvData::Field> RecordingReader::cachedDeserialize(epics::pvData::ByteBuffer* buffer)
+{
+    return epics::pvData::getFieldCreate()->deserialize(buffer, this);
+}
@@ -0,0 +1,171 @@
+#ifndef PVRECORDER_H
+#define PVRECORDER_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <stdio.h>
+
+#include <epicsTime.h>
+#include <epicsMutex.h>
+
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+#include <pv/sharedPtr.h>
+#include <pv/noDefaultMethods.h>
+
+/* Recording of PV updates into memory mapped segment files, as written by pvrecord and read by pvcat.
+ *
+ * A recording is a directory of segments "seg-NNNNNN.pvr", each created at full size
+ * then mapped, so that an update is serialized straight into the page cache.
+ * A segment is truncated to its content when the next is started.
+ *
+ * Each segment starts with a 64 byte header: "PVAR", a version byte, the byte order of
+ * what follows (0 big, 1 little endian), and the segment number (uint32).
+ * Then a sequence of records, each 8 byte aligned, starting with its length (uint32, including
+ * itself, 0 at the end of the segment) and a type byte, then 3 bytes of padding.
+ *
+ * 'T': channel id (size), channel name (string), introspection data of its value.
+ *      Written before the first update of a channel in each segment, and again if its type changes.
+ * 'U': channel id (size), receive time (uint32 seconds past EPICS epoch, uint32 ns),
+ *      flags (int8, 1 for a complete value), changed BitSet, overrun BitSet, then the value,
+ *      either complete or the changed fields only.
+ *
+ * The first update of a channel in each segment is complete, so that segments may be read
+ * independently.  The length of a record is stored after its content, so a reader stops at
+ * a record being written, or left incomplete by a crash.
+ *
+ * The text file "index" has a line for each complete segment:
+ *   <segment> <first sec> <first ns> <last sec> <last ns> <updates>
+ * with the receive times (EPICS epoch) of its first and last updates.
+ * Segments after the last indexed are found by name.
+ */
+
+class RecordingWriter : public epics::pvData::SerializableControl
+{
+public:
+    //! Create, or append to, the recording in dir.  Throws std::runtime_error
+    RecordingWriter(const std::string& dir, size_t segmentSize);
+    virtual ~RecordingWriter();
+
+    //! Append one update of the named channel.  Thread safe.
+    void write(const std::string& name,
+               const epics::pvData::PVStructure& value,
+               const epics::pvData::BitSet& changed,
+               const epics::pvData::BitSet& overrun);
+    //! Finish the current segment
+    void close();
+
+    struct Stats {
+        size_t updates, bytes, segments;
+    };
+    void getStats(Stats& stats) const;
+
+    virtual void flushSerializeBuffer();
+    virtual void ensureBuffer(std::size_t size);
+    virtual void alignBuffer(std::size_t alignment);
+    virtual bool directSerialize(epics::pvData::ByteBuffer *existingBuffer, const char* toSerialize,
+                                 std::size_t elementCount, std::size_t elementSize);
+    virtual void cachedSerialize(std::tr1::shared_ptr<const epics::pvData::Field> const & field,
+                                 epics::pvData::ByteBuffer* buffer);
+
+private:
+    struct Channel {
+        size_t id;
+        epics::pvData::StructureConstPtr type;
+        epics::pvData::uint32 segment; // in which type was last written, or -1
+    };
+    typedef std::map<std::string, Channel> channels_t;
+
+    void openSegment();
+    void closeSegment();
+    size_t beginRecord(epics::pvData::int8 rtype);
+    void endRecord(size_t start);
+
+    const std::string dir;
+    const size_t segmentSize;
+
+    mutable epicsMutex lock;
+    channels_t channels;
+
+    // current segment
+    epics::pvData::uint32 segment; // number of the next, when !base
+    int fd;
+    char *base;
+    std::tr1::shared_ptr<epics::pvData::ByteBuffer> buffer;
+    epicsTimeStamp first, last;
+    size_t segmentUpdates;
+
+    FILE *index;
+    Stats stats;
+
+    EPICS_NOT_COPYABLE(RecordingWriter)
+};
+
+class RecordingReader : public epics::pvData::DeserializableControl
+{
+public:
+    //! Open the recording in dir.  Throws std::runtime_error
+    explicit RecordingReader(const std::string& dir);
+    virtual ~RecordingReader();
+
+    //! Receive time of the first update, or zero for an empty recording
+    epicsTimeStamp startTime();
+
+    /** Continue from the first update received at or after time.
+     *  The segment containing it is read from its start, so that
+     *  the values returned by next() are complete.
+     */
+    void seek(const epicsTimeStamp& time);
+
+    /** Read the next update.  value is the complete current value of the channel,
+     *  with the changed fields updated.  Returns false at end of recording.
+     */
+    bool next(std::string& name,
+              epics::pvData::PVStructure::shared_pointer& value,
+              epics::pvData::BitSet& changed,
+              epics::pvData::BitSet& overrun,
+              epicsTimeStamp& received);
+
+    virtual void ensureData(std::size_t size);
+    virtual void alignData(std::size_t alignment);
+    virtual bool directDeserialize(epics::pvData::ByteBuffer *existingBuffer, char* deserializeTo,
+                                   std::size_t elementCount, std::size_t elementSize);
+    virtual std::tr1::shared_ptr<const epics::pvData::Field> cachedDeserialize(epics::pvData::ByteBuffer* buffer);
+
+private:
+    struct Segment {
+        epics::pvData::uint32 number;
+        bool indexed; // first and last are known
+        epicsTimeStamp first, last;
+    };
+    struct Channel {
+        std::string name;
+        epics::pvData::PVStructure::shared_pointer value;
+    };
+
+    bool openSegment(size_t idx);
+    void closeSegment();
+
+    const std::string dir;
+    std::vector<Segment> segments;
+
+    // current segment
+    size_t current; // index in segments
+    char *base;
+    size_t mapSize;
+    std::tr1::shared_ptr<epics::pvData::ByteBuffer> buffer;
+    size_t recordEnd;
+    std::vector<Channel> channels;
+
+    // skip updates received before
+    epicsTimeStamp skipBefore;
+    bool skipping;
+
+    EPICS_NOT_COPYABLE(RecordingReader)
+};
+
+#endif // PVRECORDER_H
@@ -0,0 +1,238 @@
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <epicsStdlib.h>
+#include <epicsGetopt.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsTime.h>
+#include <osiSock.h>
+
+#include <pv/pvaVersion.h>
+#include <pv/trafficCapture.h>
+
+using namespace std;
+using namespace epics::pvAccess;
+
+namespace {
+
+#define DEFAULT_SPEED 1.0
+#define DEFAULT_WAIT 1.0
+#define DEFAULT_PORT 5075
+
+void usage (void)
+{
+    fprintf (stderr, "\nUsage: pvreplay [options] <capture file> [<address>]\n\n"
+             "Send the bytes of a traffic capture, recorded by a transport with EPICS_PVA_CAPTURE_DIR set,\n"
+             "to a server or client again, at the times they were first received, and report\n"
+             "the replies received.\n"
+             "\n"
+             "A capture made by a server holds what its client sent, so pvreplay connects to\n"
+             "the server at <address>, default localhost:%u.  A capture made by a client holds what\n"
+             "its server sent, so pvreplay listens on <address>, default 0.0.0.0:%u, and replays\n"
+             "to the first client to connect, eg. with EPICS_PVA_NAME_SERVERS set to that address.\n"
+             "\noptions:\n"
+             "  -h: Help: Print this message\n"
+             "  -V: Print version and exit\n"
+             "  -s <speed>:        Replay <speed> times faster than recorded, 0 for as fast as possible,\n"
+             "                     default %.1f\n"
+             "  -w <sec>:          Keep reading replies for <sec> seconds after the last record,\n"
+             "                     default %.1f\n"
+             "\nThe replay is only faithful if the peer answers as it did during the capture, eg. a\n"
+             "server freshly started with the same PVs, since the ids it assigns are not rewritten.\n"
+             "\nexample: pvreplay -s 10 /tmp/cap/server-10.0.0.5_41234-20260101T120000-1.pvacap localhost\n\n"
+             , DEFAULT_PORT, DEFAULT_PORT, DEFAULT_SPEED, DEFAULT_WAIT);
+}
+
+// reads and counts the replies until the socket is closed
+struct Drain {
+    SOCKET sock;
+    size_t bytes, reads;
+    epicsEvent done;
+
+    explicit Drain(SOCKET sock) :sock(sock), bytes(0u), reads(0u) {}
+
+    static void run(void *raw)
+    {
+        Drain *self = static_cast<Drain*>(raw);
+        char buf[16*1024];
+        while(true) {
+            int n = ::recv(self->sock, buf, sizeof(buf), 0);
+            if(n<=0)
+                break;
+            self->bytes += size_t(n);
+            self->reads++;
+        }
+        self->done.signal();
+    }
+};
+
+bool sendAll(SOCKET sock, const char *buf, size_t count)
+{
+    while(count) {
+        int n = ::send(sock, buf, int(count), 0);
+        if(n<=0)
+            return false;
+        buf += n;
+        count -= size_t(n);
+    }
+    return true;
+}
+
+SOCKET connectTo(const sockaddr_in& addr)
+{
+    SOCKET sock = epicsSocketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(sock==INVALID_SOCKET)
+        throw runtime_error("Unable to create socket");
+    if(::connect(sock, (const sockaddr*)&addr, sizeof(addr))!=0) {
+        epicsSocketDestroy(sock);
+        throw runtime_error("Unable to connect");
+    }
+    return sock;
+}
+
+SOCKET acceptFrom(const sockaddr_in& addr)
+{
+    SOCKET listener = epicsSocketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(listener==INVALID_SOCKET)
+        throw runtime_error("Unable to create socket");
+    epicsSocketEnableAddressReuseDuringTimeWaitState(listener);
+    if(::bind(listener, (const sockaddr*)&addr, sizeof(addr))!=0 || ::listen(listener, 1)!=0) {
+        epicsSocketDestroy(listener);
+        throw runtime_error("Unable to listen");
+    }
+    osiSockAddr peer;
+    osiSocklen_t len = sizeof(peer);
+    SOCKET sock = epicsSocketAccept(listener, &peer.sa, &len);
+    epicsSocketDestroy(listener);
+    if(sock==INVALID_SOCKET)
+        throw runtime_error("Unable to accept");
+    return sock;
+}
+
+} // namespace
+
+int main (int argc, char *argv[])
+{
+    int opt;                    /* getopt() current option */
+    double speed = DEFAULT_SPEED, wait = DEFAULT_WAIT;
+
+    while ((opt = getopt(argc, argv, ":hVs:w:")) != -1) {
+        switch (opt) {
+        case 'h':               /* Print usage */
+            usage();
+            return 0;
+        case 'V':               /* Print version */
+        {
+            Version version("pvreplay", "cpp",
+                    EPICS_PVA_MAJOR_VERSION,
+                    EPICS_PVA_MINOR_VERSION,
+                    EPICS_PVA_MAINTENANCE_VERSION,
+                    EPICS_PVA_DEVELOPMENT_FLAG);
+            fprintf(stdout, "%s\n", version.getVersionString().c_str());
+            return 0;
+        }
+        case 's':               /* Speed */
+        case 'w':               /* Wait for replies */
+        {
+            double temp;
+            if((epicsScanDouble(optarg, &temp)) != 1 || temp < 0.0) {
+                fprintf(stderr, "'%s' is not a valid value for -%c. ('pvreplay -h' for help.)\n", optarg, opt);
+                return 1;
+            }
+            (opt=='s' ? speed : wait) = temp;
+            break;
+        }
+        case '?':
+            fprintf(stderr,
+                    "Unrecognized option: '-%c'. ('pvreplay -h' for help.)\n",
+                    optopt);
+            return 1;
+        case ':':
+            fprintf(stderr,
+                    "Option '-%c' requires an argument. ('pvreplay -h' for help.)\n",
+                    optopt);
+            return 1;
+        default :
+            usage();
+            return 1;
+        }
+    }
+
+    if(argc-optind < 1 || argc-optind > 2) {
+        fprintf(stderr, "Expected a capture file, and optionally an address. ('pvreplay -h' for help.)\n");
+        return 1;
+    }
+
+    try {
+        TrafficReplay capture(argv[optind]);
+
+        string address(argc-optind==2 ? argv[optind+1] : (capture.server() ? "localhost" : "0.0.0.0"));
+        sockaddr_in addr;
+        if(aToIPAddr(address.c_str(), DEFAULT_PORT, &addr)) {
+            fprintf(stderr, "'%s' is not a valid address.\n", address.c_str());
+            return 1;
+        }
+
+        osiSockAttach();
+
+        SOCKET sock = capture.server() ? connectTo(addr) : acceptFrom(addr);
+
+        Drain drain(sock);
+        epicsThreadCreate("pvreplay-rx", epicsThreadPriorityMedium,
+                          epicsThreadGetStackSize(epicsThreadStackBig),
+                          &Drain::run, &drain);
+
+        epicsTimeStamp first, received;
+        epicsTime start(epicsTime::getCurrent());
+        vector<char> data;
+        size_t records = 0u, bytes = 0u;
+        bool ok = true;
+
+        while(ok && capture.next(received, data)) {
+            if(records==0u)
+                first = received;
+            else if(speed>0.0) {
+                double delay = epicsTimeDiffInSeconds(&received, &first)/speed
+                               - (epicsTime::getCurrent() - start);
+                if(delay>0.0)
+                    epicsThreadSleep(delay);
+            }
+            if(!data.empty())
+                ok = sendAll(sock, &data[0], data.size());
+            records++;
+            bytes += data.size();
+        }
+        double elapsed = epicsTime::getCurrent() - start;
+
+        if(!ok)
+            fprintf(stderr, "Connection closed by peer after %zu records\n", records);
+        else
+            epicsThreadSleep(wait);
+
+        // wakes the reader
+        epicsSocketSystemCallInterruptMechanismQueryInfo info = epicsSocketSystemCallInterruptMechanismQuery();
+        if(info==esscimqi_socketCloseRequired)
+            epicsSocketDestroy(sock);
+        else
+            ::shutdown(sock, SHUT_RDWR);
+        drain.done.wait();
+        if(info!=esscimqi_socketCloseRequired)
+            epicsSocketDestroy(sock);
+
+        printf("{\"peer\": \"%s\", \"records\": %zu, \"bytes_sent\": %zu, \"elapsed\": %f, \"rate_Bps\": %f,"
+               " \"bytes_received\": %zu, \"reads\": %zu}\n",
+               capture.peer().c_str(), records, bytes, elapsed,
+               elapsed>0.0 ? bytes/elapsed : 0.0, drain.bytes, drain.reads);
+
+        return ok ? 0 : 2;
+
+    } catch(std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+}
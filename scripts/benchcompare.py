@@ -0,0 +1,82 @@
+#!/usr/bin/env python
+"""Compare two sets of results from testApp benchPVA.
+
+  benchPVA -o baseline.json      # with the last release
+  benchPVA -o current.json       # with this tree
+  benchcompare.py baseline.json current.json
+
+Results are matched by benchmark, transport, channels, elements and queue.
+Where a result was measured more than once, the best is used.  Exits with
+status 1 if any rate in current is lower than in baseline by more than
+the threshold (default 10%).  Heap allocations per operation are shown
+where both results have them.
+"""
+
+from __future__ import print_function
+
+import sys
+import json
+import argparse
+
+KEY = ('bench', 'transport', 'channels', 'elements', 'queue')
+
+
+def load(fname):
+    best = {}
+    with open(fname) as F:
+        for lineno, line in enumerate(F, 1):
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                result = json.loads(line)
+            except ValueError as e:
+                raise SystemExit('%s:%d: %s' % (fname, lineno, e))
+            key = tuple(result.get(k) for k in KEY)
+            if key not in best or result['ops_per_sec'] > best[key]['ops_per_sec']:
+                best[key] = result
+    return best
+
+
+def allocs(B, C):
+    if 'allocs_per_op' not in B or 'allocs_per_op' not in C:
+        return '-'
+    return '%.1f->%.1f' % (B['allocs_per_op'], C['allocs_per_op'])
+
+
+def main():
+    P = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    P.add_argument('baseline')
+    P.add_argument('current')
+    P.add_argument('-t', '--threshold', type=float, default=10.0,
+                   help='Percent slower which is a regression.  Default %(default)s')
+    args = P.parse_args()
+
+    base, cur = load(args.baseline), load(args.current)
+
+    regressions = 0
+    print('%-8s %-9s %8s %9s %5s %14s %14s %8s %14s' % (KEY + ('baseline/s', 'current/s', 'change', 'allocs/op')))
+    for key in sorted(set(base) | set(cur), key=lambda k: tuple(str(v) for v in k)):
+        B, C = base.get(key), cur.get(key)
+        cols = tuple(key)
+        if B is None or C is None:
+            print('%-8s %-9s %8s %9s %5s %14s %14s %8s' % (cols + (
+                  B and '%.1f' % B['ops_per_sec'] or '-',
+                  C and '%.1f' % C['ops_per_sec'] or '-', 'missing')))
+            continue
+
+        change = 100.0 * (C['ops_per_sec'] - B['ops_per_sec']) / B['ops_per_sec'] if B['ops_per_sec'] else 0.0
+        flag = ''
+        if change < -args.threshold:
+            regressions += 1
+            flag = ' <-- REGRESSION'
+        print('%-8s %-9s %8s %9s %5s %14.1f %14.1f %+7.1f%% %14s%s' % (cols + (
+              B['ops_per_sec'], C['ops_per_sec'], change, allocs(B, C), flag)))
+
+    if regressions:
+        print('%d regressions of more than %.0f%%' % (regressions, args.threshold))
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -48,15 +48,204 @@ CAChannel::shared_pointer CAChannel::create(CAChannelProvider::shared_pointer co
 
 static void ca_connection_handler(struct connection_handler_args args)
 {
-    CAChannel *channel = static_cast<CAChannel*>(ca_puser(args.chid));
+    CAConnection *connection = static_cast<CAConnection*>(ca_puser(args.chid));
 
     if (args.op == CA_OP_CONN_UP) {
-        channel->connected();
+        connection->connectionEvent(true);
     } else if (args.op == CA_OP_CONN_DOWN) {
-        channel->disconnected();
+        connection->connectionEvent(false);
     }
 }
 
+struct CAConnection::Subscription
+{
+    CAConnection *connection;
+    evid pevid;
+    std::vector<std::pair<CAChannelMonitor*, CAChannelMonitorWPtr> > monitors;
+    // copy of the latest update, for a monitor which joins later
+    std::vector<char> lastDBR;
+    struct event_handler_args lastArgs;
+    bool hasLast;
+    Subscription(CAConnection *connection) :connection(connection), pevid(NULL), hasLast(false) {}
+};
+
+static void ca_subscription_handler(struct event_handler_args args)
+{
+    CAConnection::Subscription *subscription = static_cast<CAConnection::Subscription*>(args.usr);
+    subscription->connection->subscriptionEvent(subscription, args);
+}
+
+CAConnection::CAConnection(CAChannelProviderPtr const & provider, std::string const & name)
+    :provider(provider)
+    ,name(name)
+    ,channelID(0)
+    ,isCreated(false)
+    ,isConnected(false)
+{}
+
+CAConnection::~CAConnection()
+{
+    bool clear;
+    {
+        Lock lock(mutex);
+        clear = isCreated;
+        isCreated = false;
+    }
+    if(!clear) return;
+    CAChannelProviderPtr P(provider.lock());
+    if(P) P->attachContext();
+    ca_clear_channel(channelID);
+}
+
+int CAConnection::create(short priority)
+{
+    int result = ca_create_channel(name.c_str(),
+         ca_connection_handler,
+         this,
+         priority, // TODO mapping
+         &channelID);
+    if (result == ECA_NORMAL) {
+        Lock lock(mutex);
+        isCreated = true;
+    }
+    return result;
+}
+
+bool CAConnection::addChannel(CAChannelPtr const & channel, bool& connected)
+{
+    Lock lock(mutex);
+    if(!isCreated) return false;
+    channels.push_back(std::make_pair(channel.get(), CAChannelWPtr(channel)));
+    // connectionEvent() copies the list with isConnected, so exactly one
+    // of connectionEvent() or the caller calls connected().
+    connected = isConnected;
+    return true;
+}
+
+void CAConnection::removeChannel(CAChannel *channel)
+{
+    {
+        Lock lock(mutex);
+        for(size_t i=0; i<channels.size(); i++) {
+            if(channels[i].first!=channel) continue;
+            channels.erase(channels.begin()+i);
+            break;
+        }
+        if(!channels.empty() || !isCreated) return;
+        isCreated = false;
+    }
+    // not locked, as this waits for a connection callback in progress
+    CAChannelProviderPtr P(provider.lock());
+    if(P) P->attachContext();
+    int result = ca_clear_channel(channelID);
+    if (result != ECA_NORMAL) {
+        string mess("CAConnection::removeChannel() ");
+        mess += ca_message(result);
+        cerr << mess << endl;
+    }
+}
+
+void CAConnection::connectionEvent(bool up)
+{
+    std::vector<CAChannelPtr> notify;
+    {
+        Lock lock(mutex);
+        isConnected = up;
+        notify.reserve(channels.size());
+        for(size_t i=0; i<channels.size(); i++) {
+            CAChannelPtr channel(channels[i].second.lock());
+            if(channel) notify.push_back(channel);
+        }
+    }
+    for(size_t i=0; i<notify.size(); i++) {
+        if(up) notify[i]->connected();
+        else notify[i]->disconnected();
+    }
+}
+
+int CAConnection::subscribe(CAChannelMonitorPtr const & monitor, chtype type, unsigned long mask)
+{
+    std::tr1::shared_ptr<Subscription> subscription;
+    {
+        Lock lock(mutex);
+        subscriptions_t::iterator it(subscriptions.find(std::make_pair(type, mask)));
+        if(it!=subscriptions.end()) {
+            Subscription& S = *it->second;
+            S.monitors.push_back(std::make_pair(monitor.get(), CAChannelMonitorWPtr(monitor)));
+            // CA sends the current value only to a new subscription.
+            // Delivered while locked, so it is not reordered with a later update.
+            if(S.hasLast) {
+                struct event_handler_args args(S.lastArgs);
+                args.dbr = &S.lastDBR[0];
+                monitor->subscriptionEvent(args);
+            }
+            return ECA_NORMAL;
+        }
+        subscription.reset(new Subscription(this));
+        subscription->monitors.push_back(std::make_pair(monitor.get(), CAChannelMonitorWPtr(monitor)));
+        subscriptions[std::make_pair(type, mask)] = subscription;
+    }
+    // not locked, as the first update may be delivered before this returns
+    int result = ca_create_subscription(type,
+         0,
+         channelID, mask,
+         ca_subscription_handler, subscription.get(),
+         &subscription->pevid);
+    if(result!=ECA_NORMAL) {
+        Lock lock(mutex);
+        subscriptions_t::iterator it(subscriptions.find(std::make_pair(type, mask)));
+        if(it!=subscriptions.end() && it->second==subscription)
+            subscriptions.erase(it);
+    }
+    return result;
+}
+
+int CAConnection::unsubscribe(CAChannelMonitor *monitor)
+{
+    std::tr1::shared_ptr<Subscription> last;
+    {
+        Lock lock(mutex);
+        bool found = false;
+        for(subscriptions_t::iterator it(subscriptions.begin()); !found && it!=subscriptions.end(); ++it) {
+            Subscription& S = *it->second;
+            for(size_t i=0; i<S.monitors.size(); i++) {
+                if(S.monitors[i].first!=monitor) continue;
+                S.monitors.erase(S.monitors.begin()+i);
+                found = true;
+                break;
+            }
+            if(found && S.monitors.empty()) {
+                last = it->second;
+                subscriptions.erase(it);
+                break;
+            }
+        }
+    }
+    // not locked, as this waits for a subscription callback in progress
+    if(last && last->pevid) return ca_clear_subscription(last->pevid);
+    return ECA_NORMAL;
+}
+
+void CAConnection::subscriptionEvent(Subscription *subscription, struct event_handler_args &args)
+{
+    // released after unlock, as the last reference to a monitor unsubscribes
+    std::vector<CAChannelMonitorPtr> notify;
+    Lock lock(mutex);
+    if(args.status==ECA_NORMAL && args.dbr) {
+        const char *dbr = static_cast<const char*>(args.dbr);
+        subscription->lastDBR.assign(dbr, dbr + dbr_size_n(args.type, args.count));
+        subscription->lastArgs = args;
+        subscription->hasLast = true;
+    }
+    notify.reserve(subscription->monitors.size());
+    for(size_t i=0; i<subscription->monitors.size(); i++) {
+        CAChannelMonitorPtr monitor(subscription->monitors[i].second.lock());
+        if(monitor) notify.push_back(monitor);
+    }
+    for(size_t i=0; i<notify.size(); i++)
+        EXCEPTION_GUARD(notify[i]->subscriptionEvent(args));
+}
+
 void CAChannel::connected()
 {
     if(DEBUG_LEVEL>0) {
@@ -121,18 +310,21 @@ void CAChannel::activate(short priority)
     }
     ChannelRequester::shared_pointer req(channelRequester.lock());
     if(!req) return;
+    CAChannelProviderPtr provider(channelProvider.lock());
+    if(!provider) return;
     attachContext();
-    int result = ca_create_channel(channelName.c_str(),
-         ca_connection_handler,
-         this,
-         priority, // TODO mapping
-         &channelID);
+    bool isConnected = false;
+    int result = provider->getConnection(shared_from_this(), priority, connection, isConnected);
     if (result == ECA_NORMAL)
     {
+       channelID = connection->getChannelID();
        channelCreated = true;
-       CAChannelProviderPtr provider(channelProvider.lock());
-       if(provider) provider->addChannel(shared_from_this());
+       provider->addChannel(shared_from_this());
+       // searches of channels created together go out with one flush
+       provider->flushIO();
        EXCEPTION_GUARD(req->channelCreated(Status::Ok, shared_from_this()));
+       // shared with a CAChannel already connected
+       if(isConnected) connected();
     } else {
         Status errorStatus(Status::STATUSTYPE_ERROR, string(ca_message(result)));
         EXCEPTION_GUARD(req->channelCreated(errorStatus, shared_from_this()));
@@ -174,16 +366,8 @@ void CAChannel::disconnectChannel()
          mon->stop();
     }
     monitorlist.resize(0);
-    /* Clear CA Channel */
-    CAChannelProviderPtr provider(channelProvider.lock());
-    if(provider) {
-        std::tr1::static_pointer_cast<CAChannelProvider>(provider)->attachContext();
-    }
-    int result = ca_clear_channel(channelID);
-    if (result == ECA_NORMAL) return;
-    string mess("CAChannel::disconnectChannel() ");
-    mess += ca_message(result);
-    cerr << mess << endl;
+    /* Clear CA Channel, if this is the last to use it */
+    connection->removeChannel(this);
 }
 
 chid CAChannel::getChannelID()
@@ -414,6 +598,13 @@ void CAChannel::attachContext()
     throw  std::runtime_error(mess);
 }
 
+int CAChannel::flushIO()
+{
+    CAChannelProviderPtr provider(channelProvider.lock());
+    if(provider) return provider->flushIO();
+    return ca_flush_io();
+}
+
 CAChannelGetPtr CAChannelGet::create(
     CAChannel::shared_pointer const & channel,
     ChannelGetRequester::shared_pointer const & channelGetRequester,
@@ -455,6 +646,7 @@ void CAChannelGet::activate()
     bitSet = BitSetPtr(new BitSet(pvStructure->getStructure()->getNumberFields()));
     notifyGetRequester = NotifyGetRequesterPtr(new NotifyGetRequester());
     notifyGetRequester->setChannelGet(shared_from_this());
+    notifyGetRequester->shardKey = channel.get();
     EXCEPTION_GUARD(getRequester->channelGetConnect(Status::Ok, shared_from_this(),
                     pvStructure->getStructure()));
 }
@@ -507,7 +699,7 @@ void CAChannelGet::get()
          channel->getChannelID(), ca_get_handler, this);
     if (result == ECA_NORMAL)
     {
-        result = ca_flush_io();
+        result = channel->flushIO();
     }
     if (result != ECA_NORMAL)
     {
@@ -581,6 +773,7 @@ void CAChannelPut::activate()
     }
     notifyPutRequester = NotifyPutRequesterPtr(new NotifyPutRequester());
     notifyPutRequester->setChannelPut(shared_from_this());
+    notifyPutRequester->shardKey = channel.get();
     EXCEPTION_GUARD(putRequester->channelPutConnect(Status::Ok, shared_from_this(),
                     pvStructure->getStructure()));
 }
@@ -685,7 +878,7 @@ void CAChannelPut::get()
          channel->getChannelID(), ca_put_get_handler, this);
     if (result == ECA_NORMAL)
     {
-        result = ca_flush_io();
+        result = channel->flushIO();
     }
     if (result != ECA_NORMAL)
     {
@@ -714,12 +907,6 @@ void CAChannelPut::lastRequest()
 /* --------------- Monitor --------------- */
 
 
-static void ca_subscription_handler(struct event_handler_args args)
-{
-    CAChannelMonitor *channelMonitor = static_cast<CAChannelMonitor*>(args.usr);
-    channelMonitor->subscriptionEvent(args);
-}
-
 class CACMonitorQueue :
     public std::tr1::enable_shared_from_this<CACMonitorQueue>
 {
@@ -768,6 +955,12 @@ public:
          monitorElementQueue.push(monitorElement);
          return true;
      }
+     // an event() now would be refused
+     bool full()
+     {
+         Lock guard(mutex);
+         return monitorElementQueue.size()==queueSize;
+     }
      MonitorElementPtr poll()
      {
           Lock guard(mutex);
@@ -776,15 +969,18 @@ public:
           MonitorElementPtr retval = monitorElementQueue.front();
           return retval;
      }
-     void release(MonitorElementPtr const & monitorElement)
+     // returns true if the queue was full
+     bool release(MonitorElementPtr const & monitorElement)
      {
          Lock guard(mutex);
-         if(!isStarted) return;
+         if(!isStarted) return false;
          if(monitorElementQueue.empty()) {
               string mess("CAChannelMonitor::release client error calling release ");
               throw  std::runtime_error(mess);
          }
+         bool wasFull = monitorElementQueue.size()==queueSize;
          monitorElementQueue.pop();
+         return wasFull;
      }
 };
 
@@ -809,7 +1005,9 @@ CAChannelMonitor::CAChannelMonitor(
     pvRequest(pvRequest),
     isStarted(false),
     monitorEventThread(MonitorEventThread::get()),
-    pevid(NULL)
+    eventMask(DBE_VALUE),
+    hasPending(false),
+    pendingOverrun(false)
 {}
 
 CAChannelMonitor::~CAChannelMonitor()
@@ -823,6 +1021,32 @@ CAChannelMonitor::~CAChannelMonitor()
     stop();
 }
 
+/* record[DBE=value,alarm] selects the CA events a monitor subscribes to.
+ * "value" (DBE_VALUE) and "archive" (DBE_LOG) pass the MDEL and ADEL
+ * deadbands of the record, "alarm" is DBE_ALARM, and "property" is DBE_PROPERTY,
+ * a change of limits, units or enum strings.
+ */
+static unsigned long parseEventMask(const string& spec)
+{
+    unsigned long mask = 0;
+    string::size_type pos = 0;
+    while(pos<spec.size()) {
+        string::size_type end = spec.find_first_of(",|+ ", pos);
+        if(end==string::npos) end = spec.size();
+        string name(spec.substr(pos, end-pos));
+        pos = end+1;
+        if(name.empty()) continue;
+        if(name=="value") mask |= DBE_VALUE;
+        else if(name=="archive" || name=="log") mask |= DBE_LOG;
+        else if(name=="alarm") mask |= DBE_ALARM;
+#ifdef DBE_PROPERTY
+        else if(name=="property") mask |= DBE_PROPERTY;
+#endif
+        else LOG(logLevelWarn, "CAChannelMonitor ignores unknown DBE option '%s'", name.c_str());
+    }
+    return mask ? mask : (unsigned long)DBE_VALUE;
+}
+
 void CAChannelMonitor::activate()
 {
     MonitorRequester::shared_pointer requester(monitorRequester.lock());
@@ -844,9 +1068,12 @@ void CAChannelMonitor::activate()
             ss >> size;
             if (size > 1) queueSize = size;
         }
+        pvString = pvOptions->getSubField<PVString>("DBE");
+        if (pvString) eventMask = parseEventMask(pvString->get());
     }
     notifyMonitorRequester = NotifyMonitorRequesterPtr(new NotifyMonitorRequester());
     notifyMonitorRequester->setChannelMonitor(shared_from_this());
+    notifyMonitorRequester->shardKey = channel.get();
     monitorQueue = CACMonitorQueuePtr(new CACMonitorQueue(queueSize));
     EXCEPTION_GUARD(requester->monitorConnect(Status::Ok, shared_from_this(),
                     pvStructure->getStructure()));
@@ -866,35 +1093,70 @@ void CAChannelMonitor::subscriptionEvent(struct event_handler_args &args)
     }
     MonitorRequester::shared_pointer requester(monitorRequester.lock());
     if(!requester) return;
-    Status status = dbdToPv->getFromDBD(pvStructure,activeElement->changedBitSet,args);
-    if(status.isOK())
-    {
-        if(monitorQueue->event(pvStructure,activeElement)) {
-             activeElement->changedBitSet->clear();
-             activeElement->overrunBitSet->clear();
-        } else {
-            *(activeElement->overrunBitSet) |= *(activeElement->changedBitSet);
-        }
-        monitorEventThread->event(notifyMonitorRequester);
-    }
-    else
+    if(args.status!=ECA_NORMAL)
     {
         string mess("CAChannelMonitor::subscriptionEvent ");
         mess += channel->getChannelName();
         mess += ca_message(args.status);
         throw  std::runtime_error(mess);
     }
+    // Keep only the raw DBR.  notifyClient() converts it on the worker thread.
+    // While the worker is behind, a newer update replaces one not yet converted.
+    const char *dbr = static_cast<const char*>(args.dbr);
+    size_t size = dbr_size_n(args.type, args.count);
+    {
+        Lock lock(mutex);
+        if(!isStarted) return;
+        if(hasPending) pendingOverrun = true;
+        pendingDBR.assign(dbr, dbr + size);
+        pendingArgs = args;
+        hasPending = true;
+    }
+    monitorEventThread->event(notifyMonitorRequester);
 }
 
 
 void CAChannelMonitor::notifyClient()
 {
+    bool convert = false;
+    bool overrun = false;
+    struct event_handler_args args;
     {
          Lock lock(mutex);
          if(!isStarted) return;
+         // While the queue is full, the latest update is kept unconverted,
+         // as it would only replace what is queued.  release() calls again.
+         if(hasPending && !monitorQueue->full()) {
+             // the buffers swap, so neither is re-allocated for each update
+             convertDBR.swap(pendingDBR);
+             args = pendingArgs;
+             overrun = pendingOverrun;
+             convert = true;
+             hasPending = pendingOverrun = false;
+         }
     }
     MonitorRequester::shared_pointer requester(monitorRequester.lock());
     if(!requester) return;
+    if(convert) {
+        // only this worker thread touches pvStructure and activeElement
+        args.dbr = &convertDBR[0];
+        Status status = dbdToPv->getFromDBD(pvStructure,activeElement->changedBitSet,args);
+        if(!status.isOK()) {
+            LOG(logLevelError, "CAChannelMonitor::notifyClient %s %s",
+                channel->getChannelName().c_str(), status.getMessage().c_str());
+            return;
+        }
+        if(overrun) {
+            // fields changed by the update replaced are not known
+            *(activeElement->overrunBitSet) |= *(activeElement->changedBitSet);
+        }
+        if(monitorQueue->event(pvStructure,activeElement)) {
+             activeElement->changedBitSet->clear();
+             activeElement->overrunBitSet->clear();
+        } else {
+            *(activeElement->overrunBitSet) |= *(activeElement->changedBitSet);
+        }
+    }
     requester->monitorEvent(shared_from_this());
 }
 
@@ -914,14 +1176,11 @@ Status CAChannelMonitor::start()
         monitorQueue->start();
     }
     channel->attachContext();
-    int result = ca_create_subscription(dbdToPv->getRequestType(),
-         0,
-         channel->getChannelID(), DBE_VALUE,
-         ca_subscription_handler, this,
-         &pevid);
+    int result = channel->getConnection()->subscribe(
+         shared_from_this(), dbdToPv->getRequestType(), eventMask);
     if (result == ECA_NORMAL)
     {
-        result = ca_flush_io();
+        result = channel->flushIO();
     }
     if (result == ECA_NORMAL) return status;
     isStarted = false;
@@ -943,7 +1202,8 @@ Status CAChannelMonitor::stop()
          isStarted = false;     
     }
     monitorQueue->stop();
-    int result = ca_clear_subscription(pevid);
+    channel->attachContext();
+    int result = channel->getConnection()->unsubscribe(this);
     if(result==ECA_NORMAL) return Status::Ok;
     return Status(Status::STATUSTYPE_ERROR,string(ca_message(result)));
 }
@@ -967,7 +1227,15 @@ void CAChannelMonitor::release(MonitorElementPtr const & monitorElement)
     if(DEBUG_LEVEL>1) {
         std::cout << "CAChannelMonitor::release " << channel->getChannelName() << endl;
     }
-    monitorQueue->release(monitorElement);
+    if(monitorQueue->release(monitorElement)) {
+        // room for an update kept while full
+        bool pending;
+        {
+            Lock lock(mutex);
+            pending = isStarted && hasPending;
+        }
+        if(pending) monitorEventThread->event(notifyMonitorRequester);
+    }
 }
 
 /* --------------- ChannelRequest --------------- */
@@ -14,6 +14,7 @@
 
 #include <queue>
 #include <vector>
+#include <map>
 
 #include <pv/pvAccess.h>
 #include <pv/event.h>
@@ -76,6 +77,41 @@ private:
     std::string subField;
 };
 
+/* One CA channel (chid), used by each CAChannel of a provider with the same
+ * name and priority, and the CA subscriptions shared by their monitors.
+ * The chid is cleared when the last CAChannel is removed.
+ */
+class CAConnection
+{
+public:
+    POINTER_DEFINITIONS(CAConnection);
+    CAConnection(CAChannelProviderPtr const & provider, std::string const & name);
+    ~CAConnection();
+    int create(short priority);
+    chid getChannelID() const { return channelID; }
+    // false if the chid is already cleared.  Sets isConnected if already connected,
+    // else CAChannel::connected() is called on connection.
+    bool addChannel(CAChannelPtr const & channel, bool& isConnected);
+    void removeChannel(CAChannel *channel);
+    // ca_create_subscription(), unless one of the same type and mask exists
+    int subscribe(CAChannelMonitorPtr const & monitor, chtype type, unsigned long mask);
+    int unsubscribe(CAChannelMonitor *monitor);
+
+    void connectionEvent(bool up);
+    struct Subscription;
+    void subscriptionEvent(Subscription *subscription, struct event_handler_args &args);
+private:
+    CAChannelProviderWPtr provider;
+    const std::string name;
+    chid channelID;
+    epics::pvData::Mutex mutex;
+    bool isCreated;
+    bool isConnected;
+    std::vector<std::pair<CAChannel*, CAChannelWPtr> > channels;
+    typedef std::map<std::pair<chtype, unsigned long>, std::tr1::shared_ptr<Subscription> > subscriptions_t;
+    subscriptions_t subscriptions;
+};
+
 class CAChannel :
     public Channel,
     public std::tr1::enable_shared_from_this<CAChannel>
@@ -112,6 +148,11 @@ public:
     virtual void printInfo(std::ostream& out);
 
     void attachContext();
+    /* in place of ca_flush_io() after issuing a request,
+     * which the provider may delay to send more requests with one flush.
+     */
+    int flushIO();
+    CAConnectionPtr getConnection() const { return connection; }
     void disconnectChannel();
 private:
     virtual void destroy() {}
@@ -124,6 +165,7 @@ private:
     std::string channelName;
     CAChannelProviderWPtr channelProvider;
     ChannelRequester::weak_pointer channelRequester;
+    CAConnectionPtr connection;
     chid channelID;
     bool channelCreated;
 
@@ -252,8 +294,16 @@ private:
     const epics::pvData::PVStructure::shared_pointer pvRequest;
     bool isStarted;
     MonitorEventThreadPtr monitorEventThread;
-    evid pevid;
+    // DBE_* for ca_create_subscription(), from record._options.DBE
+    unsigned long eventMask;
     NotifyMonitorRequesterPtr notifyMonitorRequester;
+    // guarded by mutex.  The latest update, if not yet converted by notifyClient()
+    std::vector<char> pendingDBR;
+    struct event_handler_args pendingArgs;
+    bool hasPending;
+    bool pendingOverrun;
+    // used only by notifyClient()
+    std::vector<char> convertDBR;
 
     DbdToPvPtr dbdToPv;
     epics::pvData::Mutex mutex;
@@ -4,12 +4,15 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <algorithm>
+
 #include <cadef.h>
 #include <epicsSignal.h>
 #include <epicsThread.h>
 #include <epicsExit.h>
 #include <pv/logger.h>
 #include <pv/pvAccess.h>
+#include <pv/configuration.h>
 
 #include "monitorEventThread.h"
 #include "getDoneThread.h"
@@ -31,17 +34,55 @@ using namespace epics::pvData;
         catch (std::exception &e) { LOG(logLevelError, "Unhandled exception caught from client code at %s:%d: %s", __FILE__, __LINE__, e.what()); } \
                 catch (...) { LOG(logLevelError, "Unhandled exception caught from client code at %s:%d.", __FILE__, __LINE__); }
 
+namespace {
+unsigned notifyThreads(const std::tr1::shared_ptr<Configuration>& conf)
+{
+    int32 nthreads = conf ? conf->getPropertyAsInteger("EPICS_PVA_CA_NOTIFY_THREADS", 1) : 1;
+    return nthreads > 1 ? unsigned(nthreads) : 1u;
+}
+
+double flushDelaySeconds(const std::tr1::shared_ptr<Configuration>& conf)
+{
+    double delay = conf ? conf->getPropertyAsDouble("EPICS_PVA_CA_FLUSH_DELAY", 0.0) : 0.0;
+    return delay > 0.0 ? delay : 0.0;
+}
+} // namespace
+
+struct CAChannelProvider::DelayedFlush : public TimerCallback
+{
+    CAChannelProviderWPtr provider;
+    DelayedFlush(const CAChannelProviderWPtr& provider) :provider(provider) {}
+    virtual ~DelayedFlush() {}
+    virtual void callback()
+    {
+        CAChannelProviderPtr P(provider.lock());
+        if(P) P->delayedFlush();
+    }
+    virtual void timerStopped() {}
+};
+
 CAChannelProvider::CAChannelProvider() 
-    : current_context(0)
+    : current_context(0),
+      channelListPurge(64u),
+      connectionsPurge(64u),
+      monitorEventThread(MonitorEventThread::get()),
+      getDoneThread(GetDoneThread::get()),
+      putDoneThread(PutDoneThread::get()),
+      flushDelay(0.0),
+      flushPending(false)
 {
     initialize();
 }
 
-CAChannelProvider::CAChannelProvider(const std::tr1::shared_ptr<Configuration>&)
+CAChannelProvider::CAChannelProvider(const std::tr1::shared_ptr<Configuration>& conf)
     :  current_context(0),
-       monitorEventThread(MonitorEventThread::get()),
-       getDoneThread(GetDoneThread::get()),
-       putDoneThread(PutDoneThread::get())
+       channelListPurge(64u),
+       connectionsPurge(64u),
+       monitorEventThread(MonitorEventThread::get(notifyThreads(conf))),
+       getDoneThread(GetDoneThread::get(notifyThreads(conf))),
+       putDoneThread(PutDoneThread::get(notifyThreads(conf))),
+       flushDelay(flushDelaySeconds(conf)),
+       flushPending(false)
 {
     if(DEBUG_LEVEL>0) {
           std::cout<< "CAChannelProvider::CAChannelProvider\n";
@@ -75,6 +116,7 @@ CAChannelProvider::~CAChannelProvider()
        channelQ.front()->disconnectChannel();
        channelQ.pop();
     }
+    if(flushTimer) flushTimer->close();
     monitorEventThread->stop();
     getDoneThread->stop();
     putDoneThread->stop();
@@ -149,21 +191,88 @@ void CAChannelProvider::addChannel(const CAChannelPtr & channel)
              << std::endl;
     }
     Lock lock(channelListMutex);
-    for(size_t i=0; i< caChannelList.size(); ++i) {
-         if(!(caChannelList[i].lock())) {
-             caChannelList[i] = channel;
-             return;
-         }
+    // Compact once the list has doubled, rather than search for a free
+    // entry on each add, which is quadratic when connecting many channels.
+    if(caChannelList.size()>=channelListPurge) {
+        size_t live = 0;
+        for(size_t i=0; i< caChannelList.size(); ++i) {
+             if(!caChannelList[i].expired()) caChannelList[live++] = caChannelList[i];
+        }
+        caChannelList.resize(live);
+        channelListPurge = std::max(size_t(64u), 2u*live);
     }
     caChannelList.push_back(channel);
 }
 
+int CAChannelProvider::getConnection(const CAChannelPtr & channel, short priority,
+                                     CAConnectionPtr& connection, bool& isConnected)
+{
+    std::pair<std::string, short> key(channel->getChannelName(), priority);
+    Lock lock(connectionsMutex);
+    connections_t::iterator it(connections.find(key));
+    if(it!=connections.end()) {
+        CAConnectionPtr shared(it->second.lock());
+        if(shared && shared->addChannel(channel, isConnected)) {
+            connection = shared;
+            return ECA_NORMAL;
+        }
+        connections.erase(it);
+    }
+    // forget those no longer in use, once the map has doubled
+    if(connections.size()>=connectionsPurge) {
+        for(connections_t::iterator next(connections.begin()); next!=connections.end();) {
+            connections_t::iterator cur(next++);
+            if(cur->second.expired()) connections.erase(cur);
+        }
+        connectionsPurge = std::max(size_t(64u), 2u*connections.size());
+    }
+    CAConnectionPtr created(new CAConnection(shared_from_this(), key.first));
+    int result = created->create(priority);
+    if(result!=ECA_NORMAL) return result;
+    created->addChannel(channel, isConnected);
+    connections[key] = created;
+    connection = created;
+    return ECA_NORMAL;
+}
+
 void CAChannelProvider::configure(epics::pvData::PVStructure::shared_pointer /*configuration*/)
 {
 }
 
 void CAChannelProvider::flush()
 {
+    attachContext();
+    ca_flush_io();
+}
+
+int CAChannelProvider::flushIO()
+{
+    if(flushDelay<=0.0) return ca_flush_io();
+    {
+        Lock lock(flushMutex);
+        if(flushPending) return ECA_NORMAL;
+        flushPending = true;
+        if(!flushTimer) {
+            flushTimer.reset(new Timer("caFlush", lowPriority));
+            flushCallback.reset(new DelayedFlush(shared_from_this()));
+        }
+    }
+    flushTimer->scheduleAfterDelay(flushCallback, flushDelay);
+    return ECA_NORMAL;
+}
+
+void CAChannelProvider::delayedFlush()
+{
+    {
+        Lock lock(flushMutex);
+        flushPending = false;
+    }
+    try {
+        attachContext();
+        ca_flush_io();
+    } catch(std::exception& e) {
+        LOG(logLevelError, "CAChannelProvider delayed flush error: %s", e.what());
+    }
 }
 
 void CAChannelProvider::poll()
@@ -216,5 +325,12 @@ void CAClientFactory::stop()
     // unregister now done with exit hook
 }
 
+void CAClientFactory::show(std::ostream& strm)
+{
+    MonitorEventThread::get()->show(strm);
+    GetDoneThread::get()->show(strm);
+    PutDoneThread::get()->show(strm);
+}
+
 }}}
 
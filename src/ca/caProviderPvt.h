@@ -12,10 +12,13 @@
 #ifndef CAPROVIDERPVT_H
 #define CAPROVIDERPVT_H
 
+#include <map>
+
 #include <cadef.h>
 
 #include <pv/caProvider.h>
 #include <pv/pvAccess.h>
+#include <pv/timer.h>
 
 
 namespace epics {
@@ -37,6 +40,10 @@ class CAChannel;
 typedef std::tr1::shared_ptr<CAChannel> CAChannelPtr;
 typedef std::tr1::weak_ptr<CAChannel> CAChannelWPtr;
 
+class CAConnection;
+typedef std::tr1::shared_ptr<CAConnection> CAConnectionPtr;
+typedef std::tr1::weak_ptr<CAConnection> CAConnectionWPtr;
+
 class CAChannelProvider;
 typedef std::tr1::shared_ptr<CAChannelProvider> CAChannelProviderPtr;
 typedef std::tr1::weak_ptr<CAChannelProvider> CAChannelProviderWPtr;
@@ -78,17 +85,40 @@ public:
     virtual void poll();
 
     void attachContext();
+    /* ca_flush_io(), or when EPICS_PVA_CA_FLUSH_DELAY is set,
+     * one ca_flush_io() that many delayed seconds after the first request.
+     * flush() sends any delayed requests now.
+     */
+    int flushIO();
     void addChannel(const CAChannelPtr & channel);
+    /* The CA channel of this name and priority, created or shared with other
+     * CAChannel.  Returns the status of ca_create_channel().
+     */
+    int getConnection(const CAChannelPtr & channel, short priority,
+                      CAConnectionPtr& connection, bool& isConnected);
 private:
+    struct DelayedFlush;
+    friend struct DelayedFlush;
+    void delayedFlush();
     
     virtual void destroy() EPICS_DEPRECATED {}
     void initialize();
     ca_client_context* current_context;
     epics::pvData::Mutex channelListMutex;
     std::vector<CAChannelWPtr> caChannelList;
+    size_t channelListPurge;
+    typedef std::map<std::pair<std::string, short>, CAConnectionWPtr> connections_t;
+    epics::pvData::Mutex connectionsMutex;
+    connections_t connections;
+    size_t connectionsPurge;
     MonitorEventThreadPtr monitorEventThread;
     GetDoneThreadPtr getDoneThread;
     PutDoneThreadPtr putDoneThread;
+    double flushDelay;
+    epics::pvData::Mutex flushMutex;
+    bool flushPending;
+    epics::pvData::Timer::shared_pointer flushTimer;
+    epics::pvData::TimerCallbackPtr flushCallback;
 };
 
 }}}
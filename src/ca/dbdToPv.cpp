@@ -7,6 +7,7 @@
 
 #include <epicsVersion.h>
 #include <sstream>
+#include <string.h>
 #include <alarm.h>
 #include <alarmString.h>
 
@@ -310,26 +311,43 @@ PVStructurePtr DbdToPv::createPVStructure()
     return getPVDataCreate()->createPVStructure(structure);
 }
 
+namespace {
+
 template<typename dbrT, typename pvT>
 void copy_DBRScalar(const void * dbr, PVScalar::shared_pointer const & pvScalar)
 {
-    std::tr1::shared_ptr<pvT> value = std::tr1::static_pointer_cast<pvT>(pvScalar);
+    pvT *value = static_cast<pvT*>(pvScalar.get());
     value->put(static_cast<const dbrT*>(dbr)[0]);
 }
 
 template<typename dbrT, typename pvT>
 void copy_DBRScalarArray(const void * dbr, unsigned count, PVScalarArray::shared_pointer const & pvArray)
 {
-    std::tr1::shared_ptr<pvT> value = std::tr1::static_pointer_cast<pvT>(pvArray);
+    pvT *value = static_cast<pvT*>(pvArray.get());
     typename pvT::svector temp(value->reuse());
     temp.resize(count);
-    std::copy(
-        static_cast<const dbrT*>(dbr),
-        static_cast<const dbrT*>(dbr) + count,
-        temp.begin());
+    if(sizeof(dbrT)==sizeof(typename pvT::value_type)) {
+        // same representation, eg. waveform of DBR_CHAR into byte[]
+        if(count) memcpy(temp.data(), dbr, count*sizeof(dbrT));
+    } else {
+        std::copy(
+            static_cast<const dbrT*>(dbr),
+            static_cast<const dbrT*>(dbr) + count,
+            temp.begin());
+    }
     value->replace(freeze(temp));
 }
 
+void copy_DBRStringArray(const void * dbr, unsigned count, PVScalarArray::shared_pointer const & pvArray)
+{
+    const dbr_string_t *dbrval = static_cast<const dbr_string_t *>(dbr);
+    PVStringArray *value = static_cast<PVStringArray*>(pvArray.get());
+    PVStringArray::svector arr(value->reuse());
+    arr.resize(count);
+    std::copy(dbrval, dbrval + count, arr.begin());
+    value->replace(freeze(arr));
+}
+
 template<typename dbrT>
 void get_DBRControl(const void * dbr, double *upper_ctrl_limit,double *lower_ctrl_limit)
 {
@@ -337,13 +355,27 @@ void get_DBRControl(const void * dbr, double *upper_ctrl_limit,double *lower_ctr
     *lower_ctrl_limit =  static_cast<const dbrT*>(dbr)->lower_ctrl_limit;
 }
 
+string displayFormat(const dbr_ctrl_char *) { return "I4"; }
+string displayFormat(const dbr_ctrl_short *) { return "I6"; }
+string displayFormat(const dbr_ctrl_long *) { return "I12"; }
+template<typename dbrT>
+string displayFormat(const dbrT *data)
+{
+    int prec = data->precision;
+    ostringstream s;
+    s << "F" << prec + 6 << "." << prec;
+    return s.str();
+}
+
 template<typename dbrT>
 void get_DBRDisplay(
-    const void * dbr, double *upper_disp_limit,double *lower_disp_limit,string *units)
+    const void * dbr, double *upper_disp_limit,double *lower_disp_limit,string *units,string *format)
 {
-    *upper_disp_limit =  static_cast<const dbrT*>(dbr)->upper_disp_limit;
-    *lower_disp_limit =  static_cast<const dbrT*>(dbr)->lower_disp_limit;
-     *units = static_cast<const dbrT*>(dbr)->units;
+    const dbrT *data = static_cast<const dbrT*>(dbr);
+    *upper_disp_limit =  data->upper_disp_limit;
+    *lower_disp_limit =  data->lower_disp_limit;
+    *units = data->units;
+    *format = displayFormat(data);
 }
 
 template<typename dbrT>
@@ -358,6 +390,107 @@ void get_DBRValueAlarm(
     *lower_alarm_limit =  static_cast<const dbrT*>(dbr)->lower_alarm_limit;
 }
 
+} // namespace
+
+void DbdToPv::compilePlan(PVStructurePtr const & pvStructure)
+{
+    Plan next;
+    next.pvStructure = pvStructure.get();
+    if(fieldRequested)
+    {
+        PVFieldPtr pvValue(pvStructure->getSubFieldT<PVField>("value"));
+        next.valueOffset = pvValue->getFieldOffset();
+        if(isArray) {
+            next.valueArray = std::tr1::static_pointer_cast<PVScalarArray>(pvValue);
+            switch(caValueType) {
+            case DBR_STRING: next.copyArray = &copy_DBRStringArray; break;
+            case DBR_CHAR: next.copyArray = &copy_DBRScalarArray<dbr_char_t,PVByteArray>; break;
+            case DBR_SHORT: next.copyArray = &copy_DBRScalarArray<dbr_short_t,PVShortArray>; break;
+            case DBR_LONG: next.copyArray = &copy_DBRScalarArray<dbr_long_t,PVIntArray>; break;
+            case DBR_FLOAT: next.copyArray = &copy_DBRScalarArray<dbr_float_t,PVFloatArray>; break;
+            case DBR_DOUBLE: next.copyArray = &copy_DBRScalarArray<dbr_double_t,PVDoubleArray>; break;
+            default:
+                throw  std::runtime_error("DbdToPv::getFromDBD logic error");
+            }
+        } else if(caValueType==DBR_ENUM) {
+            next.enumIndex = pvStructure->getSubFieldT<PVInt>("value.index");
+            next.enumChoices = pvStructure->getSubFieldT<PVStringArray>("value.choices");
+        } else {
+            next.value = std::tr1::static_pointer_cast<PVScalar>(pvValue);
+            switch(caValueType) {
+            case DBR_STRING: next.copyScalar = &copy_DBRScalar<dbr_string_t,PVString>; break;
+            case DBR_CHAR: next.copyScalar = &copy_DBRScalar<dbr_char_t,PVByte>; break;
+            case DBR_SHORT: next.copyScalar = &copy_DBRScalar<dbr_short_t,PVShort>; break;
+            case DBR_LONG: next.copyScalar = &copy_DBRScalar<dbr_long_t,PVInt>; break;
+            case DBR_FLOAT: next.copyScalar = &copy_DBRScalar<dbr_float_t,PVFloat>; break;
+            case DBR_DOUBLE: next.copyScalar = &copy_DBRScalar<dbr_double_t,PVDouble>; break;
+            default:
+                throw  std::runtime_error("DbdToPv::getFromDBD logic error");
+            }
+        }
+    }
+    if(alarmRequested) {
+        PVStructurePtr pvAlarm(pvStructure->getSubFieldT<PVStructure>("alarm"));
+        next.alarmOffset = pvAlarm->getFieldOffset();
+        next.alarmSeverity = pvAlarm->getSubFieldT<PVInt>("severity");
+        next.alarmStatus = pvAlarm->getSubFieldT<PVInt>("status");
+        next.alarmMessage = pvAlarm->getSubFieldT<PVString>("message");
+    }
+    if(timeStampRequested) {
+        PVStructurePtr pvTimeStamp(pvStructure->getSubFieldT<PVStructure>("timeStamp"));
+        next.timeSeconds = pvTimeStamp->getSubFieldT<PVLong>("secondsPastEpoch");
+        next.timeNano = pvTimeStamp->getSubFieldT<PVInt>("nanoseconds");
+    }
+    if(controlRequested) {
+        switch(caRequestType) {
+        case DBR_CTRL_CHAR: next.getControl = &get_DBRControl<dbr_ctrl_char>; break;
+        case DBR_CTRL_SHORT: next.getControl = &get_DBRControl<dbr_ctrl_short>; break;
+        case DBR_CTRL_LONG: next.getControl = &get_DBRControl<dbr_ctrl_long>; break;
+        case DBR_CTRL_FLOAT: next.getControl = &get_DBRControl<dbr_ctrl_float>; break;
+        case DBR_CTRL_DOUBLE: next.getControl = &get_DBRControl<dbr_ctrl_double>; break;
+        default :
+            throw  std::runtime_error("DbdToPv::getFromDBD logic error");
+        }
+        PVStructurePtr pvControl(pvStructure->getSubFieldT<PVStructure>("control"));
+        next.controlHigh = pvControl->getSubFieldT<PVDouble>("limitHigh");
+        next.controlLow = pvControl->getSubFieldT<PVDouble>("limitLow");
+    }
+    if(displayRequested) {
+        switch(caRequestType) {
+        case DBR_CTRL_CHAR: next.getDisplay = &get_DBRDisplay<dbr_ctrl_char>; break;
+        case DBR_CTRL_SHORT: next.getDisplay = &get_DBRDisplay<dbr_ctrl_short>; break;
+        case DBR_CTRL_LONG: next.getDisplay = &get_DBRDisplay<dbr_ctrl_long>; break;
+        case DBR_CTRL_FLOAT: next.getDisplay = &get_DBRDisplay<dbr_ctrl_float>; break;
+        case DBR_CTRL_DOUBLE: next.getDisplay = &get_DBRDisplay<dbr_ctrl_double>; break;
+        default :
+            throw  std::runtime_error("DbdToPv::getFromDBD logic error");
+        }
+        PVStructurePtr pvDisplay(pvStructure->getSubFieldT<PVStructure>("display"));
+        next.displayLow = pvDisplay->getSubFieldT<PVDouble>("limitLow");
+        next.displayHigh = pvDisplay->getSubFieldT<PVDouble>("limitHigh");
+        next.displayUnits = pvDisplay->getSubFieldT<PVString>("units");
+        next.displayFormat = pvDisplay->getSubFieldT<PVString>("format");
+        next.displayDescription = pvDisplay->getSubField<PVString>("description");
+    }
+    if(valueAlarmRequested) {
+        switch(caRequestType) {
+        case DBR_CTRL_CHAR: next.getValueAlarm = &get_DBRValueAlarm<dbr_ctrl_char>; break;
+        case DBR_CTRL_SHORT: next.getValueAlarm = &get_DBRValueAlarm<dbr_ctrl_short>; break;
+        case DBR_CTRL_LONG: next.getValueAlarm = &get_DBRValueAlarm<dbr_ctrl_long>; break;
+        case DBR_CTRL_FLOAT: next.getValueAlarm = &get_DBRValueAlarm<dbr_ctrl_float>; break;
+        case DBR_CTRL_DOUBLE: next.getValueAlarm = &get_DBRValueAlarm<dbr_ctrl_double>; break;
+        default :
+            throw  std::runtime_error("DbdToPv::getFromDBD logic error");
+        }
+        PVStructurePtr pvValueAlarm(pvStructure->getSubFieldT<PVStructure>("valueAlarm"));
+        next.highAlarmLimit = pvValueAlarm->getSubFieldT<PVScalar>("highAlarmLimit");
+        next.highWarningLimit = pvValueAlarm->getSubFieldT<PVScalar>("highWarningLimit");
+        next.lowWarningLimit = pvValueAlarm->getSubFieldT<PVScalar>("lowWarningLimit");
+        next.lowAlarmLimit = pvValueAlarm->getSubFieldT<PVScalar>("lowAlarmLimit");
+    }
+    plan = next;
+}
+
 Status DbdToPv::getFromDBD(
      PVStructurePtr const & pvStructure,
      BitSet::shared_pointer const & bitSet,
@@ -368,79 +501,37 @@ Status DbdToPv::getFromDBD(
      Status errorStatus(Status::STATUSTYPE_ERROR, string(ca_message(args.status)));
      return errorStatus;
    }
+   // fields and copy functions are looked up once for each PVStructure
+   if(plan.pvStructure!=pvStructure.get()) {
+       try {
+           compilePlan(pvStructure);
+       } catch(std::exception& e) {
+           plan = Plan();
+           return Status(Status::STATUSTYPE_ERROR, e.what());
+       }
+   }
    if(fieldRequested)
    {
-       void * value = dbr_value_ptr(args.dbr,caRequestType);
+       const void * value = dbr_value_ptr(args.dbr,caRequestType);
        if(isArray) {
-           long count = args.count;
-           PVScalarArrayPtr pvValue = pvStructure->getSubField<PVScalarArray>("value");
-           switch(caValueType) {
-           case DBR_STRING:
+           plan.copyArray(value,args.count,plan.valueArray);
+           bitSet->set(plan.valueOffset);
+       } else if(caValueType==DBR_ENUM) {
+           const dbr_enum_t *dbrval = static_cast<const dbr_enum_t *>(value);
+           plan.enumIndex->put(*dbrval);
+           if(plan.enumChoices->getLength()==0)
            {
-                const dbr_string_t *dbrval = static_cast<const dbr_string_t *>(value);
-                PVStringArrayPtr pvValue = pvStructure->getSubField<PVStringArray>("value");
-                PVStringArray::svector arr(pvValue->reuse());
-                arr.resize(count);
-                std::copy(dbrval, dbrval + count, arr.begin());
-                pvValue->replace(freeze(arr));
-                break;
-           }
-           case DBR_CHAR:
-               copy_DBRScalarArray<dbr_char_t,PVByteArray>(value,count,pvValue);
-               break;
-           case DBR_SHORT:
-               copy_DBRScalarArray<dbr_short_t,PVShortArray>(value,count,pvValue);
-               break;
-           case DBR_LONG:
-               copy_DBRScalarArray<dbr_long_t,PVIntArray>(value,count,pvValue);
-               break;
-           case DBR_FLOAT:
-               copy_DBRScalarArray<dbr_float_t,PVFloatArray>(value,count,pvValue);
-               break;
-           case DBR_DOUBLE:
-               copy_DBRScalarArray<dbr_double_t,PVDoubleArray>(value,count,pvValue);
-               break;
-           default:
-                Status errorStatus(
-                    Status::STATUSTYPE_ERROR, string("DbdToPv::getFromDBD logic error"));
-                return errorStatus;
+                ConvertPtr convert = getConvert();
+                size_t n = choices.size();
+                plan.enumChoices->setLength(n);
+                convert->fromStringArray(plan.enumChoices,0,n,choices,0);       
+                bitSet->set(plan.valueOffset);
+           } else {
+                bitSet->set(plan.enumIndex->getFieldOffset());
            }
        } else {
-           PVScalarPtr pvValue = pvStructure->getSubField<PVScalar>("value");
-           switch(caValueType) {
-           case DBR_ENUM:
-           {
-                const dbr_enum_t *dbrval = static_cast<const dbr_enum_t *>(value);
-                PVIntPtr value = pvStructure->getSubField<PVInt>("value.index");
-                value->put(*dbrval);
-                PVStringArrayPtr pvChoices
-                     = pvStructure->getSubField<PVStringArray>("value.choices");
-                if(pvChoices->getLength()==0)
-                {
-                     ConvertPtr convert = getConvert();
-                     size_t n = choices.size();
-                     pvChoices->setLength(n);
-                     convert->fromStringArray(pvChoices,0,n,choices,0);       
-                     bitSet->set(pvStructure->getSubField("value")->getFieldOffset());
-                } else {
-                     bitSet->set(value->getFieldOffset());
-                }
-                break;
-           }
-           case DBR_STRING: copy_DBRScalar<dbr_string_t,PVString>(value,pvValue); break;
-           case DBR_CHAR: copy_DBRScalar<dbr_char_t,PVByte>(value,pvValue); break;
-           case DBR_SHORT: copy_DBRScalar<dbr_short_t,PVShort>(value,pvValue); break;
-           case DBR_LONG: copy_DBRScalar<dbr_long_t,PVInt>(value,pvValue); break;
-           case DBR_FLOAT: copy_DBRScalar<dbr_float_t,PVFloat>(value,pvValue); break;
-           case DBR_DOUBLE: copy_DBRScalar<dbr_double_t,PVDouble>(value,pvValue); break;
-           default:
-                Status errorStatus(
-                    Status::STATUSTYPE_ERROR, string("DbdToPv::getFromDBD logic error"));
-                return errorStatus;
-           }
-       }
-       if(caValueType!=DBR_ENUM) {
-            bitSet->set(pvStructure->getSubField("value")->getFieldOffset());
+           plan.copyScalar(value,plan.value);
+           bitSet->set(plan.valueOffset);
        }
     }
     if(alarmRequested) {
@@ -450,80 +541,57 @@ Status DbdToPv::getFromDBD(
         dbr_short_t severity = data->severity;
         bool statusChanged = false;
         bool severityChanged = false;
-        PVStructurePtr pvAlarm(pvStructure->getSubField<PVStructure>("alarm"));
-        PVIntPtr pvSeverity(pvAlarm->getSubField<PVInt>("severity"));
         if(caAlarm.severity!=severity) {
             caAlarm.severity = severity;
-            pvSeverity->put(severity);
+            plan.alarmSeverity->put(severity);
             severityChanged = true;
         }
-        PVStringPtr pvMessage(pvAlarm->getSubField<PVString>("message"));
-        PVIntPtr pvStatus(pvAlarm->getSubField<PVInt>("status"));
         if(caAlarm.status!=status) {
             caAlarm.status = status;
-            pvStatus->put(status);
+            plan.alarmStatus->put(status);
             string message("UNKNOWN STATUS");
             if(status<=ALARM_NSTATUS) message = string(epicsAlarmConditionStrings[status]);
-            pvMessage->put(message);
+            plan.alarmMessage->put(message);
             statusChanged = true;
         }
         if(statusChanged&&severityChanged) {
-            bitSet->set(pvAlarm->getFieldOffset());
+            bitSet->set(plan.alarmOffset);
         } else if(severityChanged) {
-            bitSet->set(pvSeverity->getFieldOffset());
+            bitSet->set(plan.alarmSeverity->getFieldOffset());
         } else if(statusChanged) {
-            bitSet->set(pvStatus->getFieldOffset());
-            bitSet->set(pvMessage->getFieldOffset());
+            bitSet->set(plan.alarmStatus->getFieldOffset());
+            bitSet->set(plan.alarmMessage->getFieldOffset());
         }
     }
     if(timeStampRequested) {
         // Note that epicsTimeStamp always follows status and severity
         const dbr_time_string *data = static_cast<const dbr_time_string *>(args.dbr);
         epicsTimeStamp stamp = data->stamp;
-        PVStructurePtr pvTimeStamp(pvStructure->getSubField<PVStructure>("timeStamp"));
         if(caTimeStamp.secPastEpoch!=stamp.secPastEpoch) {
             caTimeStamp.secPastEpoch = stamp.secPastEpoch;
-            PVLongPtr pvSeconds(pvTimeStamp->getSubField<PVLong>("secondsPastEpoch"));
-            pvSeconds->put(stamp.secPastEpoch+posixEpochAtEpicsEpoch);
-            bitSet->set(pvSeconds->getFieldOffset());
+            plan.timeSeconds->put(stamp.secPastEpoch+posixEpochAtEpicsEpoch);
+            bitSet->set(plan.timeSeconds->getFieldOffset());
         }
         if(caTimeStamp.nsec!=stamp.nsec) {
-            caTimeStamp.secPastEpoch = stamp.secPastEpoch;
-            PVIntPtr pvNano(pvTimeStamp->getSubField<PVInt>("nanoseconds"));
-            pvNano->put(stamp.nsec);
-            bitSet->set(pvNano->getFieldOffset());
+            caTimeStamp.nsec = stamp.nsec;
+            plan.timeNano->put(stamp.nsec);
+            bitSet->set(plan.timeNano->getFieldOffset());
         }
     }
     if(controlRequested)
     {
          double upper_ctrl_limit = 0.0;
          double lower_ctrl_limit = 0.0;
-         switch(caRequestType) {
-             case DBR_CTRL_CHAR:
-                 get_DBRControl<dbr_ctrl_char>(args.dbr,&upper_ctrl_limit,&lower_ctrl_limit); break;
-             case DBR_CTRL_SHORT:
-                 get_DBRControl<dbr_ctrl_short>(args.dbr,&upper_ctrl_limit,&lower_ctrl_limit); break;
-             case DBR_CTRL_LONG:
-                 get_DBRControl<dbr_ctrl_long>(args.dbr,&upper_ctrl_limit,&lower_ctrl_limit); break;
-             case DBR_CTRL_FLOAT:
-                 get_DBRControl<dbr_ctrl_float>(args.dbr,&upper_ctrl_limit,&lower_ctrl_limit); break;
-             case DBR_CTRL_DOUBLE:
-                 get_DBRControl<dbr_ctrl_double>(args.dbr,&upper_ctrl_limit,&lower_ctrl_limit); break;
-             default :
-                 throw  std::runtime_error("DbdToPv::getFromDBD logic error");
-         }
-         PVStructurePtr pvControl(pvStructure->getSubField<PVStructure>("control"));
+         plan.getControl(args.dbr,&upper_ctrl_limit,&lower_ctrl_limit);
          if(caControl.upper_ctrl_limit!=upper_ctrl_limit) {
              caControl.upper_ctrl_limit = upper_ctrl_limit;
-             PVDoublePtr pv = pvControl->getSubField<PVDouble>("limitHigh");
-             pv->put(upper_ctrl_limit);
-             bitSet->set(pv->getFieldOffset());
+             plan.controlHigh->put(upper_ctrl_limit);
+             bitSet->set(plan.controlHigh->getFieldOffset());
          }
          if(caControl.lower_ctrl_limit!=lower_ctrl_limit) {
              caControl.lower_ctrl_limit = lower_ctrl_limit;
-             PVDoublePtr pv = pvControl->getSubField<PVDouble>("limitLow");
-             pv->put(lower_ctrl_limit);
-             bitSet->set(pv->getFieldOffset());
+             plan.controlLow->put(lower_ctrl_limit);
+             bitSet->set(plan.controlLow->getFieldOffset());
          }
     }
     if(displayRequested)
@@ -532,132 +600,63 @@ Status DbdToPv::getFromDBD(
         string format;
         double upper_disp_limit = 0.0;
         double lower_disp_limit = 0.0;
-        switch(caRequestType) {
-             case DBR_CTRL_CHAR:
-                 get_DBRDisplay<dbr_ctrl_char>(args.dbr,&upper_disp_limit,&lower_disp_limit,&units);
-                 format = "I4"; break;
-             case DBR_CTRL_SHORT:
-                 get_DBRDisplay<dbr_ctrl_short>(args.dbr,&upper_disp_limit,&lower_disp_limit,&units);
-                 format = "I6"; break;
-             case DBR_CTRL_LONG:
-                 get_DBRDisplay<dbr_ctrl_long>(args.dbr,&upper_disp_limit,&lower_disp_limit,&units);
-                 format = "I12"; break;
-             case DBR_CTRL_FLOAT:
-                 get_DBRDisplay<dbr_ctrl_float>(args.dbr,&upper_disp_limit,&lower_disp_limit,&units);
-                 {
-                 const dbr_ctrl_float *data = static_cast<const dbr_ctrl_float *>(args.dbr);
-                 int prec = data->precision;
-                 ostringstream s;
-                 s << "F" << prec + 6 << "." << prec;
-                 format = s.str();
-                 }
-                 break;
-             case DBR_CTRL_DOUBLE:
-                 get_DBRDisplay<dbr_ctrl_double>(args.dbr,&upper_disp_limit,&lower_disp_limit,&units);
-                 {
-                 const dbr_ctrl_double *data = static_cast<const dbr_ctrl_double *>(args.dbr);
-                 int prec = data->precision;
-                 ostringstream s;
-                 s << "F" << prec + 6 << "." << prec;
-                 format = s.str();
-                 }
-                 break;
-             default :
-                 throw  std::runtime_error("DbdToPv::getFromDBD logic error");
-         }
-         PVStructurePtr pvDisplay(pvStructure->getSubField<PVStructure>("display"));
-         if(caDisplay.lower_disp_limit!=lower_disp_limit) {
-            caDisplay.lower_disp_limit = lower_disp_limit;
-            PVDoublePtr pvDouble = pvDisplay->getSubField<PVDouble>("limitLow");
-            pvDouble->put(lower_disp_limit);
-            bitSet->set(pvDouble->getFieldOffset());
-         }
-         if(caDisplay.upper_disp_limit!=upper_disp_limit) {
-            caDisplay.upper_disp_limit = upper_disp_limit;
-            PVDoublePtr pvDouble = pvDisplay->getSubField<PVDouble>("limitHigh");
-            pvDouble->put(upper_disp_limit);
-            bitSet->set(pvDouble->getFieldOffset());
-         }
-         if(caDisplay.units!=units) {
-            caDisplay.units = units;
-            PVStringPtr pvString = pvDisplay->getSubField<PVString>("units");
-            pvString->put(units);
-            bitSet->set(pvString->getFieldOffset());
-         }
-         if(caDisplay.format!=format) {
-            caDisplay.format = format;
-            PVStringPtr pvString = pvDisplay->getSubField<PVString>("format");
-            pvString->put(format);
-            bitSet->set(pvString->getFieldOffset());
-         }
-         if(!description.empty())
-         {
-             PVStringPtr pvString = pvDisplay->getSubField<PVString>("description");
-             if(description.compare(pvString->get()) !=0) {
-                  pvString->put(description);
-                  bitSet->set(pvString->getFieldOffset());
-             }
-         }
+        plan.getDisplay(args.dbr,&upper_disp_limit,&lower_disp_limit,&units,&format);
+        if(caDisplay.lower_disp_limit!=lower_disp_limit) {
+           caDisplay.lower_disp_limit = lower_disp_limit;
+           plan.displayLow->put(lower_disp_limit);
+           bitSet->set(plan.displayLow->getFieldOffset());
+        }
+        if(caDisplay.upper_disp_limit!=upper_disp_limit) {
+           caDisplay.upper_disp_limit = upper_disp_limit;
+           plan.displayHigh->put(upper_disp_limit);
+           bitSet->set(plan.displayHigh->getFieldOffset());
+        }
+        if(caDisplay.units!=units) {
+           caDisplay.units = units;
+           plan.displayUnits->put(units);
+           bitSet->set(plan.displayUnits->getFieldOffset());
+        }
+        if(caDisplay.format!=format) {
+           caDisplay.format = format;
+           plan.displayFormat->put(format);
+           bitSet->set(plan.displayFormat->getFieldOffset());
+        }
+        if(!description.empty() && plan.displayDescription)
+        {
+            if(description.compare(plan.displayDescription->get()) !=0) {
+                 plan.displayDescription->put(description);
+                 bitSet->set(plan.displayDescription->getFieldOffset());
+            }
+        }
     }
     if(valueAlarmRequested) {
         double upper_alarm_limit = 0.0;
         double upper_warning_limit = 0.0;
         double lower_warning_limit = 0.0;
         double lower_alarm_limit = 0.0;
-        switch(caRequestType) {
-             case DBR_CTRL_CHAR:
-                 get_DBRValueAlarm<dbr_ctrl_char>(args.dbr,
-                     &upper_alarm_limit,&upper_warning_limit,
-                     &lower_warning_limit,&lower_alarm_limit);
-                 break;
-             case DBR_CTRL_SHORT:
-                 get_DBRValueAlarm<dbr_ctrl_short>(args.dbr,
-                     &upper_alarm_limit,&upper_warning_limit,
-                     &lower_warning_limit,&lower_alarm_limit);
-                 break;
-             case DBR_CTRL_LONG:
-                 get_DBRValueAlarm<dbr_ctrl_long>(args.dbr,
-                     &upper_alarm_limit,&upper_warning_limit,
-                     &lower_warning_limit,&lower_alarm_limit);
-                 break;
-             case DBR_CTRL_FLOAT:
-                 get_DBRValueAlarm<dbr_ctrl_float>(args.dbr,
-                     &upper_alarm_limit,&upper_warning_limit,
-                     &lower_warning_limit,&lower_alarm_limit);
-                 break;
-             case DBR_CTRL_DOUBLE:
-                 get_DBRValueAlarm<dbr_ctrl_double>(args.dbr,
-                     &upper_alarm_limit,&upper_warning_limit,
-                     &lower_warning_limit,&lower_alarm_limit);
-                 break;
-             default :
-                 throw  std::runtime_error("DbdToPv::getFromDBD logic error");
-        }
+        plan.getValueAlarm(args.dbr,
+            &upper_alarm_limit,&upper_warning_limit,
+            &lower_warning_limit,&lower_alarm_limit);
         ConvertPtr convert(getConvert());
-        PVStructurePtr pvValueAlarm(pvStructure->getSubField<PVStructure>("valueAlarm"));
         if(caValueAlarm.upper_alarm_limit!=upper_alarm_limit) {
             caValueAlarm.upper_alarm_limit = upper_alarm_limit;
-            PVScalarPtr pv = pvValueAlarm->getSubField<PVScalar>("highAlarmLimit");
-            convert->fromDouble(pv,upper_alarm_limit);
-            bitSet->set(pv->getFieldOffset());
+            convert->fromDouble(plan.highAlarmLimit,upper_alarm_limit);
+            bitSet->set(plan.highAlarmLimit->getFieldOffset());
         }
         if(caValueAlarm.upper_warning_limit!=upper_warning_limit) {
             caValueAlarm.upper_warning_limit = upper_warning_limit;
-            PVScalarPtr pv = pvValueAlarm->getSubField<PVScalar>("highWarningLimit");
-                convert->fromDouble(pv,upper_warning_limit);
-            bitSet->set(pv->getFieldOffset());
+            convert->fromDouble(plan.highWarningLimit,upper_warning_limit);
+            bitSet->set(plan.highWarningLimit->getFieldOffset());
         }
         if(caValueAlarm.lower_warning_limit!=lower_warning_limit) {
             caValueAlarm.lower_warning_limit = lower_warning_limit;
-            PVScalarPtr pv = pvValueAlarm->getSubField<PVScalar>("lowWarningLimit");
-            convert->fromDouble(pv,lower_warning_limit);
-            bitSet->set(pv->getFieldOffset());
+            convert->fromDouble(plan.lowWarningLimit,lower_warning_limit);
+            bitSet->set(plan.lowWarningLimit->getFieldOffset());
         }
         if(caValueAlarm.lower_alarm_limit!=lower_alarm_limit) {
             caValueAlarm.lower_alarm_limit = lower_alarm_limit;
-            PVScalarPtr pv = pvValueAlarm->getSubField<PVScalar>("lowAlarmLimit");
-            convert->fromDouble(pv,lower_alarm_limit);
-            bitSet->set(pv->getFieldOffset());
+            convert->fromDouble(plan.lowAlarmLimit,lower_alarm_limit);
+            bitSet->set(plan.lowAlarmLimit->getFieldOffset());
         }
     }
     if(firstTime) {
@@ -792,7 +791,7 @@ Status DbdToPv::putToDBD(
         result = ca_array_put(caValueType,count,channelID,pValue);
     }
     if(result==ECA_NORMAL) {
-         ca_flush_io();
+         caChannel->flushIO();
     } else {
          status = Status(Status::STATUSTYPE_ERROR, string(ca_message(result)));
     }
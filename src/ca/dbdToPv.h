@@ -112,6 +112,51 @@ private:
         CAChannelPtr const & caChannel,
         epics::pvData::PVStructurePtr const & pvRequest
     );
+    /* The fields of one PVStructure, and the conversions for caRequestType,
+     * found by the first getFromDBD() so later calls need no lookup by name.
+     */
+    struct Plan
+    {
+        const epics::pvData::PVStructure *pvStructure;
+        size_t valueOffset;
+        epics::pvData::PVScalarPtr value;
+        epics::pvData::PVScalarArrayPtr valueArray;
+        epics::pvData::PVIntPtr enumIndex;
+        epics::pvData::PVStringArrayPtr enumChoices;
+        void (*copyScalar)(const void *dbr,
+            epics::pvData::PVScalarPtr const & pvScalar);
+        void (*copyArray)(const void *dbr, unsigned count,
+            epics::pvData::PVScalarArrayPtr const & pvArray);
+        size_t alarmOffset;
+        epics::pvData::PVIntPtr alarmSeverity;
+        epics::pvData::PVIntPtr alarmStatus;
+        epics::pvData::PVStringPtr alarmMessage;
+        epics::pvData::PVLongPtr timeSeconds;
+        epics::pvData::PVIntPtr timeNano;
+        void (*getControl)(const void *dbr, double *upper, double *lower);
+        epics::pvData::PVDoublePtr controlHigh;
+        epics::pvData::PVDoublePtr controlLow;
+        void (*getDisplay)(const void *dbr, double *upper, double *lower,
+            std::string *units, std::string *format);
+        epics::pvData::PVDoublePtr displayLow;
+        epics::pvData::PVDoublePtr displayHigh;
+        epics::pvData::PVStringPtr displayUnits;
+        epics::pvData::PVStringPtr displayFormat;
+        epics::pvData::PVStringPtr displayDescription;
+        void (*getValueAlarm)(const void *dbr,
+            double *upperAlarm, double *upperWarning,
+            double *lowerWarning, double *lowerAlarm);
+        epics::pvData::PVScalarPtr highAlarmLimit;
+        epics::pvData::PVScalarPtr highWarningLimit;
+        epics::pvData::PVScalarPtr lowWarningLimit;
+        epics::pvData::PVScalarPtr lowAlarmLimit;
+        Plan()
+            :pvStructure(0), valueOffset(0), copyScalar(0), copyArray(0)
+            ,alarmOffset(0), getControl(0), getDisplay(0), getValueAlarm(0)
+        {}
+    };
+    void compilePlan(epics::pvData::PVStructurePtr const & pvStructure);
+    Plan plan;
     IOType ioType;
     bool fieldRequested;
     bool alarmRequested;
@@ -20,20 +20,26 @@ namespace epics {
 namespace pvAccess {
 namespace ca {
 
-GetDoneThreadPtr GetDoneThread::get()
+void NotifyGetRequester::notify()
+{
+    CAChannelGetPtr channelGet(this->channelGet.lock());
+    if(channelGet) channelGet->notifyClient();
+}
+
+GetDoneThreadPtr GetDoneThread::get(unsigned nworkers)
 {
     static  GetDoneThreadPtr master;
     static Mutex mutex;
     Lock xx(mutex);
     if(!master) {
-        master = GetDoneThreadPtr(new GetDoneThread());
+        master = GetDoneThreadPtr(new GetDoneThread(nworkers));
         master->start();
     }
     return master;
 }
 
-GetDoneThread::GetDoneThread()
-: isStop(false)
+GetDoneThread::GetDoneThread(unsigned nworkers)
+: pool("getDoneThread", nworkers)
 {
 }
 
@@ -42,73 +48,24 @@ GetDoneThread::~GetDoneThread()
 //std::cout << "GetDoneThread::~GetDoneThread()\n";
 }
 
-
 void GetDoneThread::start()
 {
-    thread =  std::tr1::shared_ptr<epicsThread>(new epicsThread(
-        *this,
-        "getDoneThread",
-        epicsThreadGetStackSize(epicsThreadStackSmall),
-        epicsThreadPriorityLow));
-    thread->start(); 
+    pool.start();
 }
 
-
 void GetDoneThread::stop()
 {
-    {
-        Lock xx(mutex);
-        isStop = true;
-    }
-    waitForCommand.signal();
-    waitForStop.wait();
+    pool.stop();
 }
 
 void GetDoneThread::getDone(NotifyGetRequesterPtr const &notifyGetRequester)
 {
-    {   
-        Lock lock(mutex);
-        if(notifyGetRequester->isOnQueue) return;
-        notifyGetRequester->isOnQueue = true;
-        notifyGetQueue.push(notifyGetRequester);
-    }
-    waitForCommand.signal();
+    pool.push(notifyGetRequester);
 }
 
-void GetDoneThread::run()
+void GetDoneThread::show(std::ostream& strm)
 {
-    while(true)
-    {
-         waitForCommand.wait();
-         while(true) {
-             bool more = false;
-             NotifyGetRequester* notifyGetRequester(NULL);
-             {
-                 Lock lock(mutex);
-                 if(!notifyGetQueue.empty())
-                 {
-                      more = true;
-                      NotifyGetRequesterWPtr req(notifyGetQueue.front());
-                      notifyGetQueue.pop();
-                      NotifyGetRequesterPtr reqPtr(req.lock());
-                      if(reqPtr) {
-                         notifyGetRequester = reqPtr.get();
-                         reqPtr->isOnQueue = false;
-                      }
-                 }
-             }
-             if(!more) break;
-             if(notifyGetRequester!=NULL)
-             {
-                 CAChannelGetPtr channelGet(notifyGetRequester->channelGet.lock());
-                 if(channelGet) channelGet->notifyClient();
-             }
-         }
-         if(isStop) {
-             waitForStop.signal();
-             break;
-         }
-    }
+    pool.show(strm);
 }
 
 }}}
@@ -9,12 +9,13 @@
  */
 #ifndef GetDoneThread_H
 #define GetDoneThread_H
-#include <queue>
+#include <ostream>
 #include <cadef.h>
 #include <shareLib.h>
 #include <epicsThread.h>
 #include <pv/event.h>
 #include <pv/lock.h>
+#include "notifyThreadPool.h"
 
 namespace epics {
 namespace pvAccess {
@@ -38,31 +39,30 @@ public:
     ChannelGetRequester::weak_pointer channelGetRequester;
     CAChannelGetWPtr channelGet;
     bool isOnQueue;
-    NotifyGetRequester() : isOnQueue(false) {}
+    // selects the worker thread, the CAChannel
+    void *shardKey;
+    NotifyGetRequester() : isOnQueue(false), shardKey(0) {}
     void setChannelGet(CAChannelGetPtr const &channelGet)
     { this->channelGet = channelGet;}
+    void notify();
 };
 
 
-class GetDoneThread :
-     public epicsThreadRunable
+class GetDoneThread
 {
 public:
-    static GetDoneThreadPtr get();
+    /* The first call creates, with nworkers threads.  Later calls return the same. */
+    static GetDoneThreadPtr get(unsigned nworkers = 1u);
     ~GetDoneThread();
-    virtual void run();
     void start();
     void stop();
     void getDone(NotifyGetRequesterPtr const &notifyGetRequester);
+    //! Print queue statistics for each worker thread
+    void show(std::ostream& strm);
 private:
-    GetDoneThread();
+    GetDoneThread(unsigned nworkers);
 
-    bool isStop;
-    std::tr1::shared_ptr<epicsThread> thread;
-    epics::pvData::Mutex mutex;
-    epics::pvData::Event waitForCommand;
-    epics::pvData::Event waitForStop;
-    std::queue<NotifyGetRequesterWPtr> notifyGetQueue;
+    NotifyThreadPool<NotifyGetRequester> pool;
 };
 
 
@@ -20,20 +20,26 @@ namespace epics {
 namespace pvAccess {
 namespace ca {
 
-MonitorEventThreadPtr MonitorEventThread::get()
+void NotifyMonitorRequester::notify()
+{
+    CAChannelMonitorPtr channelMonitor(this->channelMonitor.lock());
+    if(channelMonitor) channelMonitor->notifyClient();
+}
+
+MonitorEventThreadPtr MonitorEventThread::get(unsigned nworkers)
 {
     static  MonitorEventThreadPtr master;
     static Mutex mutex;
     Lock xx(mutex);
     if(!master) {
-        master = MonitorEventThreadPtr(new MonitorEventThread());
+        master = MonitorEventThreadPtr(new MonitorEventThread(nworkers));
         master->start();
     }
     return master;
 }
 
-MonitorEventThread::MonitorEventThread()
-: isStop(false)
+MonitorEventThread::MonitorEventThread(unsigned nworkers)
+: pool("monitorEventThread", nworkers)
 {
 }
 
@@ -44,70 +50,22 @@ MonitorEventThread::~MonitorEventThread()
 
 void MonitorEventThread::start()
 {
-    thread =  std::tr1::shared_ptr<epicsThread>(new epicsThread(
-        *this,
-        "monitorEventThread",
-        epicsThreadGetStackSize(epicsThreadStackSmall),
-        epicsThreadPriorityLow));
-    thread->start();  
+    pool.start();
 }
 
 void MonitorEventThread::stop()
 {
-    {
-        Lock xx(mutex);
-        isStop = true;
-    }
-    waitForCommand.signal();
-    waitForStop.wait();
+    pool.stop();
 }
 
-
 void MonitorEventThread::event(NotifyMonitorRequesterPtr const &notifyMonitorRequester)
 {
-    {   
-        Lock lock(mutex);
-        if(notifyMonitorRequester->isOnQueue) return;
-        notifyMonitorRequester->isOnQueue = true;
-        notifyMonitorQueue.push(notifyMonitorRequester);
-    }
-    waitForCommand.signal();
+    pool.push(notifyMonitorRequester);
 }
 
-void MonitorEventThread::run()
+void MonitorEventThread::show(std::ostream& strm)
 {
-    while(true)
-    {
-         waitForCommand.wait();
-         while(true) {
-             bool more = false;
-             NotifyMonitorRequester* notifyMonitorRequester(NULL);
-             {
-                 Lock lock(mutex);
-                 if(!notifyMonitorQueue.empty())
-                 {
-                      more = true;
-                      NotifyMonitorRequesterWPtr req(notifyMonitorQueue.front());
-                      notifyMonitorQueue.pop();
-                      NotifyMonitorRequesterPtr reqPtr(req.lock());
-                      if(reqPtr) {
-                         notifyMonitorRequester = reqPtr.get();
-                         reqPtr->isOnQueue = false;
-                      }
-                 }
-             }
-             if(!more) break;
-             if(notifyMonitorRequester!=NULL)
-             {
-                 CAChannelMonitorPtr channelMonitor(notifyMonitorRequester->channelMonitor.lock());
-                 if(channelMonitor) channelMonitor->notifyClient();
-             }
-         }
-         if(isStop) {
-             waitForStop.signal();
-             break;
-         }
-    }
+    pool.show(strm);
 }
 
 }}}
@@ -9,12 +9,13 @@
  */
 #ifndef MonitorEventThread_H
 #define MonitorEventThread_H
-#include <queue>
+#include <ostream>
 #include <cadef.h>
 #include <shareLib.h>
 #include <epicsThread.h>
 #include <pv/event.h>
 #include <pv/lock.h>
+#include "notifyThreadPool.h"
 
 namespace epics {
 namespace pvAccess {
@@ -38,31 +39,30 @@ public:
     MonitorRequester::weak_pointer monitorRequester;
     CAChannelMonitorWPtr channelMonitor;
     bool isOnQueue;
-    NotifyMonitorRequester() : isOnQueue(false) {}
+    // selects the worker thread, the CAChannel
+    void *shardKey;
+    NotifyMonitorRequester() : isOnQueue(false), shardKey(0) {}
     void setChannelMonitor(CAChannelMonitorPtr const &channelMonitor)
     { this->channelMonitor = channelMonitor;}
+    void notify();
 };
 
 
-class MonitorEventThread :
-     public epicsThreadRunable
+class MonitorEventThread
 {
 public:
-    static MonitorEventThreadPtr get();
+    /* The first call creates, with nworkers threads.  Later calls return the same. */
+    static MonitorEventThreadPtr get(unsigned nworkers = 1u);
     ~MonitorEventThread();
-    virtual void run();
     void start();
     void stop();
     void event(NotifyMonitorRequesterPtr const &notifyMonitorRequester);
+    //! Print queue statistics for each worker thread
+    void show(std::ostream& strm);
 private:
-    MonitorEventThread();
+    MonitorEventThread(unsigned nworkers);
 
-    bool isStop;
-    std::tr1::shared_ptr<epicsThread> thread;
-    epics::pvData::Mutex mutex;
-    epics::pvData::Event waitForCommand;
-    epics::pvData::Event waitForStop;
-    std::queue<NotifyMonitorRequesterWPtr> notifyMonitorQueue;
+    NotifyThreadPool<NotifyMonitorRequester> pool;
 };
 
 
@@ -0,0 +1,172 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+#ifndef NotifyThreadPool_H
+#define NotifyThreadPool_H
+#include <queue>
+#include <vector>
+#include <sstream>
+#include <ostream>
+#include <epicsThread.h>
+#include <pv/sharedPtr.h>
+#include <pv/event.h>
+#include <pv/lock.h>
+
+namespace epics {
+namespace pvAccess {
+namespace ca {
+
+/* Worker threads calling Notify::notify() for queued notifiers.
+ *
+ * Each notifier is always queued to the same worker, chosen from its shardKey
+ * (the CAChannel), so the notifications of one channel stay in order.
+ * Notify must have members "void *shardKey", "bool isOnQueue",
+ * and "void notify()".  isOnQueue is guarded by the worker mutex.
+ */
+template<class Notify>
+class NotifyThreadPool
+{
+    typedef std::tr1::shared_ptr<Notify> NotifyPtr;
+    typedef std::tr1::weak_ptr<Notify> NotifyWPtr;
+
+    struct Worker : public epicsThreadRunable
+    {
+        bool isStop;
+        std::tr1::shared_ptr<epicsThread> thread;
+        std::string name;
+        epics::pvData::Mutex mutex;
+        epics::pvData::Event waitForCommand;
+        epics::pvData::Event waitForStop;
+        std::queue<NotifyWPtr> notifyQueue;
+        // statistics, guarded by mutex
+        size_t maxDepth;
+        size_t notifyCount;
+
+        Worker(const std::string& name)
+            :isStop(false)
+            ,name(name)
+            ,maxDepth(0u)
+            ,notifyCount(0u)
+        {}
+        virtual ~Worker() {}
+
+        void start()
+        {
+            thread = std::tr1::shared_ptr<epicsThread>(new epicsThread(
+                *this,
+                name.c_str(),
+                epicsThreadGetStackSize(epicsThreadStackSmall),
+                epicsThreadPriorityLow));
+            thread->start();
+        }
+
+        void stop()
+        {
+            {
+                epics::pvData::Lock xx(mutex);
+                isStop = true;
+            }
+            waitForCommand.signal();
+            waitForStop.wait();
+        }
+
+        void push(NotifyPtr const &notify)
+        {
+            {
+                epics::pvData::Lock lock(mutex);
+                if(notify->isOnQueue) return;
+                notify->isOnQueue = true;
+                notifyQueue.push(notify);
+                if(notifyQueue.size()>maxDepth)
+                    maxDepth = notifyQueue.size();
+            }
+            waitForCommand.signal();
+        }
+
+        virtual void run()
+        {
+            while(true)
+            {
+                waitForCommand.wait();
+                while(true) {
+                    NotifyPtr notify;
+                    {
+                        epics::pvData::Lock lock(mutex);
+                        if(notifyQueue.empty())
+                            break;
+                        notify = notifyQueue.front().lock();
+                        notifyQueue.pop();
+                        if(notify) {
+                            notify->isOnQueue = false;
+                            notifyCount++;
+                        }
+                    }
+                    if(notify)
+                        notify->notify();
+                }
+                if(isStop) {
+                    waitForStop.signal();
+                    break;
+                }
+            }
+        }
+    };
+
+    std::vector<std::tr1::shared_ptr<Worker> > workers;
+
+    Worker& workerFor(const void *key)
+    {
+        // low bits of a pointer are alignment
+        return *workers[(size_t(key)>>4u) % workers.size()];
+    }
+
+public:
+    NotifyThreadPool(const std::string& name, unsigned nworkers)
+    {
+        if(nworkers==0u)
+            nworkers = 1u;
+        workers.reserve(nworkers);
+        for(unsigned i=0; i<nworkers; i++) {
+            std::ostringstream strm;
+            strm<<name;
+            if(nworkers>1u)
+                strm<<"-"<<i;
+            workers.push_back(std::tr1::shared_ptr<Worker>(new Worker(strm.str())));
+        }
+    }
+
+    void start()
+    {
+        for(size_t i=0; i<workers.size(); i++)
+            workers[i]->start();
+    }
+
+    void stop()
+    {
+        for(size_t i=0; i<workers.size(); i++)
+            workers[i]->stop();
+    }
+
+    void push(NotifyPtr const &notify)
+    {
+        workerFor(notify->shardKey).push(notify);
+    }
+
+    //! One line for each worker: queued now, deepest queue, notifications made
+    void show(std::ostream& strm)
+    {
+        for(size_t i=0; i<workers.size(); i++) {
+            Worker& W = *workers[i];
+            epics::pvData::Lock lock(W.mutex);
+            strm<<W.name<<" queued "<<W.notifyQueue.size()
+                <<" max "<<W.maxDepth
+                <<" notified "<<W.notifyCount<<"\n";
+        }
+    }
+};
+
+}}}
+
+#endif  /* NotifyThreadPool_H */
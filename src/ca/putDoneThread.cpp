@@ -20,20 +20,26 @@ namespace epics {
 namespace pvAccess {
 namespace ca {
 
-PutDoneThreadPtr PutDoneThread::get()
+void NotifyPutRequester::notify()
+{
+    CAChannelPutPtr channelPut(this->channelPut.lock());
+    if(channelPut) channelPut->notifyClient();
+}
+
+PutDoneThreadPtr PutDoneThread::get(unsigned nworkers)
 {
     static  PutDoneThreadPtr master;
     static Mutex mutex;
     Lock xx(mutex);
     if(!master) {
-        master = PutDoneThreadPtr(new PutDoneThread());
+        master = PutDoneThreadPtr(new PutDoneThread(nworkers));
         master->start();
     }
     return master;
 }
 
-PutDoneThread::PutDoneThread()
-: isStop(false)
+PutDoneThread::PutDoneThread(unsigned nworkers)
+: pool("putDoneThread", nworkers)
 {
 }
 
@@ -42,73 +48,24 @@ PutDoneThread::~PutDoneThread()
 //std::cout << "PutDoneThread::~PutDoneThread()\n";
 }
 
-
 void PutDoneThread::start()
 {
-    thread =  std::tr1::shared_ptr<epicsThread>(new epicsThread(
-        *this,
-        "putDoneThread",
-        epicsThreadGetStackSize(epicsThreadStackSmall),
-        epicsThreadPriorityLow));
-    thread->start(); 
+    pool.start();
 }
 
-
 void PutDoneThread::stop()
 {
-    {
-        Lock xx(mutex);
-        isStop = true;
-    }
-    waitForCommand.signal();
-    waitForStop.wait();
+    pool.stop();
 }
 
 void PutDoneThread::putDone(NotifyPutRequesterPtr const &notifyPutRequester)
 {
-    {   
-        Lock lock(mutex);
-        if(notifyPutRequester->isOnQueue) return;
-        notifyPutRequester->isOnQueue = true;
-        notifyPutQueue.push(notifyPutRequester);
-    }
-    waitForCommand.signal();
+    pool.push(notifyPutRequester);
 }
 
-void PutDoneThread::run()
+void PutDoneThread::show(std::ostream& strm)
 {
-    while(true)
-    {
-         waitForCommand.wait();
-         while(true) {
-             bool more = false;
-             NotifyPutRequester* notifyPutRequester(NULL);
-             {
-                 Lock lock(mutex);
-                 if(!notifyPutQueue.empty())
-                 {
-                      more = true;
-                      NotifyPutRequesterWPtr req(notifyPutQueue.front());
-                      notifyPutQueue.pop();
-                      NotifyPutRequesterPtr reqPtr(req.lock());
-                      if(reqPtr) {
-                         notifyPutRequester = reqPtr.get();
-                         reqPtr->isOnQueue = false;
-                      }
-                 }
-             }
-             if(!more) break;
-             if(notifyPutRequester!=NULL)
-             {
-                 CAChannelPutPtr channelPut(notifyPutRequester->channelPut.lock());
-                 if(channelPut) channelPut->notifyClient();
-             }
-         }
-         if(isStop) {
-             waitForStop.signal();
-             break;
-         }
-    }
+    pool.show(strm);
 }
 
 }}}
@@ -9,12 +9,13 @@
  */
 #ifndef PutDoneThread_H
 #define PutDoneThread_H
-#include <queue>
+#include <ostream>
 #include <cadef.h>
 #include <shareLib.h>
 #include <epicsThread.h>
 #include <pv/event.h>
 #include <pv/lock.h>
+#include "notifyThreadPool.h"
 
 namespace epics {
 namespace pvAccess {
@@ -38,30 +39,30 @@ public:
     ChannelPutRequester::weak_pointer channelPutRequester;
     CAChannelPutWPtr channelPut;
     bool isOnQueue;
-    NotifyPutRequester() : isOnQueue(false) {}
+    // selects the worker thread, the CAChannel
+    void *shardKey;
+    NotifyPutRequester() : isOnQueue(false), shardKey(0) {}
     void setChannelPut(CAChannelPutPtr const &channelPut)
     { this->channelPut = channelPut;}
+    void notify();
 };
 
 
-class PutDoneThread :
-     public epicsThreadRunable
+class PutDoneThread
 {
 public:
-    static PutDoneThreadPtr get();
+    /* The first call creates, with nworkers threads.  Later calls return the same. */
+    static PutDoneThreadPtr get(unsigned nworkers = 1u);
     ~PutDoneThread();
-    virtual void run();
     void start();
     void stop();
     void putDone(NotifyPutRequesterPtr const &notifyPutRequester);
+    //! Print queue statistics for each worker thread
+    void show(std::ostream& strm);
 private:
-    PutDoneThread();
-    bool isStop;
-    std::tr1::shared_ptr<epicsThread> thread;
-    epics::pvData::Mutex mutex;
-    epics::pvData::Event waitForCommand;
-    epics::pvData::Event waitForStop;
-    std::queue<NotifyPutRequesterWPtr> notifyPutQueue;
+    PutDoneThread(unsigned nworkers);
+
+    NotifyThreadPool<NotifyPutRequester> pool;
 };
 
 
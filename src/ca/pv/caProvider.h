@@ -10,6 +10,8 @@
 #ifndef CAPROVIDER_H
 #define CAPROVIDER_H
 
+#include <ostream>
+
 #include <shareLib.h>
 #include <pv/pvAccess.h>
 
@@ -50,6 +52,13 @@ public:
      * This does nothing since epicsAtExit is used to destroy the instance.
      */
     static void stop();
+    /** @brief Print the queue statistics of the notification threads
+     *
+     * One line for each monitor event, get done, and put done thread.
+     * The number of each is set by EPICS_PVA_CA_NOTIFY_THREADS (default 1)
+     * in the Configuration of the first provider created.
+     */
+    static void show(std::ostream& strm);
 };
 
 }}}
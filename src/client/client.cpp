@@ -8,6 +8,8 @@
 #include <epicsMutex.h>
 #include <epicsGuard.h>
 #include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
 
 #include <pv/pvData.h>
 #include <pv/bitSet.h>
@@ -32,6 +34,100 @@ Timeout::Timeout()
     :std::runtime_error("Timeout")
 {}
 
+namespace {
+
+struct CacheCounters
+{
+    epicsMutex mutex;
+    ClientProvider::CacheStats stats;
+};
+
+void count(const std::tr1::shared_ptr<CacheCounters>& C, size_t ClientProvider::CacheStats::*which)
+{
+    if(!C) return;
+    Guard G(C->mutex);
+    (C->stats.*which)++;
+}
+
+// latest value of a channel, kept by a subscription for blocking get()
+struct ValueCache : public ClientChannel::MonitorCallback,
+                    public detail::Direct
+{
+    epicsMutex mutex;
+    const double maxAge, idle;
+    const std::tr1::shared_ptr<CacheCounters> counters;
+
+    Monitor mon;
+    bool subscribed, connected, valid;
+    // when the value was last known to be current, and when get() last used it
+    epicsTime validAt, usedAt;
+
+    ValueCache(double maxAge, double idle, const std::tr1::shared_ptr<CacheCounters>& counters)
+        :maxAge(maxAge), idle(idle), counters(counters)
+        ,subscribed(false), connected(false), valid(false)
+    {}
+    virtual ~ValueCache() { cancel(); }
+
+    // keeps mon.root current.  call with mutex locked
+    void drain()
+    {
+        bool any = false;
+        while(mon.poll())
+            any = true;
+        if(any) {
+            valid = connected = true;
+            validAt = epicsTime::getCurrent();
+        }
+    }
+
+    virtual void monitorEvent(const MonitorEvent& evt) OVERRIDE FINAL
+    {
+        Monitor evict;
+        {
+            Guard G(mutex);
+            switch(evt.event) {
+            case MonitorEvent::Data:
+                drain();
+                if(subscribed && validAt - usedAt > idle) {
+                    // unused.  Stop the traffic until the next get()
+                    evict = mon;
+                    mon = Monitor();
+                    subscribed = connected = valid = false;
+                }
+                break;
+            case MonitorEvent::Disconnect:
+                if(connected)
+                    validAt = epicsTime::getCurrent();
+                connected = false;
+                break;
+            default: // Fail or Cancel
+                if(connected)
+                    validAt = epicsTime::getCurrent();
+                subscribed = connected = false;
+                break;
+            }
+        }
+        if(evict.valid()) {
+            count(counters, &ClientProvider::CacheStats::evictions);
+            evict.cancel();
+        }
+    }
+
+    void cancel()
+    {
+        Monitor temp;
+        {
+            Guard G(mutex);
+            temp = mon;
+            mon = Monitor();
+            subscribed = connected = valid = false;
+        }
+        temp.cancel();
+    }
+};
+
+} // namespace
+
 struct ClientChannel::Impl : public pva::ChannelRequester,
                              public pvac::detail::wrapped_shared_from_this<ClientChannel::Impl>
 {
@@ -43,22 +139,37 @@ struct ClientChannel::Impl : public pva::ChannelRequester,
     bool listeners_inprogress;
     epicsEvent listeners_done;
 
+    // from Options
+    double cacheAge, cacheIdle;
+    std::tr1::shared_ptr<CacheCounters> counters;
+    // created by the first get() if cacheAge>0
+    std::tr1::shared_ptr<ValueCache> cache;
+    // from ClientProvider, if EPICS_PVA_CALLBACK_THREADS
+    detail::CallbackDispatcher::shared_pointer dispatcher;
+
     static size_t num_instances;
 
-    Impl() :listeners_inprogress(false) {REFTRACE_INCREMENT(num_instances);}
+    Impl() :listeners_inprogress(false), cacheAge(0.0), cacheIdle(0.0) {REFTRACE_INCREMENT(num_instances);}
     virtual ~Impl() {REFTRACE_DECREMENT(num_instances);}
 
     // called automatically via wrapped_shared_from_this
     void cancel()
     {
-        // ClientChannel destroy implicitly removes all callbacks,
-        // but doesn't destroy the Channel or cancel Operations
-        Guard G(mutex);
-        while(listeners_inprogress) {
-            UnGuard U(G);
-            listeners_done.wait();
+        std::tr1::shared_ptr<ValueCache> temp;
+        {
+            // ClientChannel destroy implicitly removes all callbacks,
+            // but doesn't destroy the Channel or cancel Operations
+            Guard G(mutex);
+            while(listeners_inprogress) {
+                UnGuard U(G);
+                listeners_done.wait();
+            }
+            listeners.clear();
+            temp = cache;
         }
-        listeners.clear();
+        // except for that of our cache
+        if(temp)
+            temp->cancel();
     }
 
     virtual std::string getRequesterName() OVERRIDE FINAL { return "ClientChannel::Impl"; }
@@ -112,11 +223,19 @@ size_t ClientChannel::Impl::num_instances;
 ClientChannel::Options::Options()
     :priority(0)
     ,address()
+    ,cacheAge(0.0)
+    ,cacheIdle(60.0)
 {}
 
 bool ClientChannel::Options::operator<(const Options& O) const
 {
-    return priority<O.priority || (priority==O.priority && address<O.address);
+    if(priority!=O.priority)
+        return priority<O.priority;
+    if(address!=O.address)
+        return address<O.address;
+    if(cacheAge!=O.cacheAge)
+        return cacheAge<O.cacheAge;
+    return cacheIdle<O.cacheIdle;
 }
 
 Operation::Operation(const std::tr1::shared_ptr<Impl>& i)
@@ -148,10 +267,64 @@ ClientChannel::ClientChannel(const std::tr1::shared_ptr<pva::ChannelProvider>& p
                                             opt.priority, opt.address);
     if(!impl->channel)
         throw std::runtime_error("ChannelProvider failed to create Channel");
+    impl->cacheAge = opt.cacheAge;
+    impl->cacheIdle = opt.cacheIdle;
+}
+
+bool ClientChannel::getCached(pvd::PVStructure::const_shared_pointer& value)
+{
+    if(!impl) throw std::logic_error("Dead Channel");
+    if(impl->cacheAge<=0.0)
+        return false;
+
+    std::tr1::shared_ptr<ValueCache> C;
+    {
+        Guard G(impl->mutex);
+        if(!impl->cache)
+            impl->cache.reset(new ValueCache(impl->cacheAge, impl->cacheIdle, impl->counters));
+        C = impl->cache;
+    }
+
+    bool subscribe = false;
+    {
+        Guard G(C->mutex);
+        const epicsTime now(epicsTime::getCurrent());
+        C->usedAt = now;
+
+        if(C->valid && (C->connected || now - C->validAt <= C->maxAge)) {
+            // copy, as mon.root is updated in place
+            pvd::PVStructurePtr copy(pvd::getPVDataCreate()->createPVStructure(C->mon.root->getStructure()));
+            copy->copyUnchecked(*C->mon.root);
+            value = copy;
+        } else if(!C->subscribed) {
+            C->subscribed = subscribe = true;
+        }
+    }
+
+    if(value) {
+        count(impl->counters, &ClientProvider::CacheStats::hits);
+        return true;
+    }
+    count(impl->counters, &ClientProvider::CacheStats::misses);
+
+    if(subscribe) {
+        // serves later calls.  This one is done by the caller
+        Monitor mon(monitor(C.get()));
+        Guard G(C->mutex);
+        C->mon = mon;
+        // a Data event may have come before mon was assigned
+        C->drain();
+    }
+    return false;
 }
 
 ClientChannel::~ClientChannel() {}
 
+detail::CallbackDispatcher::shared_pointer ClientChannel::getDispatcher() const
+{
+    return impl->dispatcher;
+}
+
 std::string ClientChannel::name() const
 {
     return impl ? impl->channel->getChannelName() : std::string();
@@ -221,6 +394,8 @@ void register_reftrack()
     pvac::detail::registerRefTrackGet();
     pvac::detail::registerRefTrackMonitor();
     pvac::detail::registerRefTrackRPC();
+    pvac::detail::registerRefTrackPut();
+    pvac::detail::registerRefTrackMany();
 }
 
 std::tr1::shared_ptr<epics::pvAccess::Channel>
@@ -230,7 +405,7 @@ ClientChannel::getChannel()
 struct ClientProvider::Impl
 {
     static size_t num_instances;
-    Impl() {register_reftrack(); REFTRACE_INCREMENT(num_instances);}
+    Impl() :cacheCounters(new CacheCounters) {register_reftrack(); REFTRACE_INCREMENT(num_instances);}
     ~Impl() {REFTRACE_DECREMENT(num_instances);}
 
     pva::ChannelProvider::shared_pointer provider;
@@ -238,34 +413,67 @@ struct ClientProvider::Impl
     epicsMutex mutex;
     typedef std::map<std::pair<std::string, ClientChannel::Options>, std::tr1::weak_ptr<ClientChannel::Impl> > channels_t;
     channels_t channels;
+
+    const std::tr1::shared_ptr<CacheCounters> cacheCounters;
+    // runs the callbacks of our channels, if EPICS_PVA_CALLBACK_THREADS
+    detail::CallbackDispatcher::shared_pointer dispatcher;
+
+    void configure(const pva::Configuration::const_shared_pointer& conf)
+    {
+        const pvd::int32 nthreads = conf->getPropertyAsInteger("EPICS_PVA_CALLBACK_THREADS", 0);
+        if(nthreads<=0)
+            return;
+        dispatcher.reset(new detail::CallbackDispatcher(unsigned(nthreads)));
+        pva::MetricsSource::add(dispatcher);
+    }
+
+    // for ClientProvider::shared(), by provider name
+    struct shared_t {
+        epicsMutex mutex;
+        typedef std::map<std::string, std::tr1::weak_ptr<Impl> > providers_t;
+        providers_t providers;
+    };
+    static shared_t *shared;
+    static void sharedInit(void*) { shared = new shared_t; }
 };
 
 size_t ClientProvider::Impl::num_instances;
+ClientProvider::Impl::shared_t *ClientProvider::Impl::shared;
 
-ClientProvider::ClientProvider(const std::string& providerName,
-                                       const std::tr1::shared_ptr<epics::pvAccess::Configuration>& conf)
-    :impl(new Impl)
+namespace {
+pva::ChannelProviderRegistry::shared_pointer lookupRegistry(const std::string& providerName, std::string& name)
 {
-    std::string name;
-    pva::ChannelProviderRegistry::shared_pointer reg;
-
     if(strncmp("server:", providerName.c_str(), 7)==0) {
         name = providerName.substr(7);
-        reg = pva::ChannelProviderRegistry::servers();
+        return pva::ChannelProviderRegistry::servers();
     } else if(strncmp("client:", providerName.c_str(), 7)==0) {
         name = providerName.substr(7);
-        reg = pva::ChannelProviderRegistry::clients();
+        return pva::ChannelProviderRegistry::clients();
     } else {
         name = providerName;
-        reg = pva::ChannelProviderRegistry::clients();
+        return pva::ChannelProviderRegistry::clients();
     }
-    impl->provider = reg->createProvider(name,
-                                         conf ? conf : pva::ConfigurationBuilder()
-                                                .push_env()
-                                                .build());
+}
+
+epicsThreadOnceId sharedOnce = EPICS_THREAD_ONCE_INIT;
+} // namespace
+
+ClientProvider::ClientProvider(const std::string& providerName,
+                                       const std::tr1::shared_ptr<epics::pvAccess::Configuration>& conf)
+    :impl(new Impl)
+{
+    std::string name;
+    pva::ChannelProviderRegistry::shared_pointer reg(lookupRegistry(providerName, name));
+
+    pva::Configuration::shared_pointer effective(conf ? conf : pva::ConfigurationBuilder()
+                                                               .push_env()
+                                                               .build());
+    impl->provider = reg->createProvider(name, effective);
 
     if(!impl->provider)
         THROW_EXCEPTION2(std::invalid_argument, providerName);
+
+    impl->configure(effective);
 }
 
 ClientProvider::ClientProvider(const std::tr1::shared_ptr<epics::pvAccess::ChannelProvider>& provider)
@@ -275,10 +483,39 @@ ClientProvider::ClientProvider(const std::tr1::shared_ptr<epics::pvAccess::Chann
 
     if(!impl->provider)
         THROW_EXCEPTION2(std::invalid_argument, "null ChannelProvider");
+
+    impl->configure(pva::ConfigurationBuilder().push_env().build());
 }
 
 ClientProvider::~ClientProvider() {}
 
+ClientProvider ClientProvider::shared(const std::string& providerName)
+{
+    epicsThreadOnce(&sharedOnce, &Impl::sharedInit, 0);
+
+    Guard G(Impl::shared->mutex);
+
+    ClientProvider ret;
+    Impl::shared_t::providers_t::iterator it(Impl::shared->providers.find(providerName));
+    if(it!=Impl::shared->providers.end())
+        ret.impl = it->second.lock();
+
+    if(!ret.impl) {
+        std::string name;
+        pva::ChannelProviderRegistry::shared_pointer reg(lookupRegistry(providerName, name));
+
+        ret.impl.reset(new Impl);
+        // the instance also returned by ChannelProviderRegistry::getProvider()
+        ret.impl->provider = reg->getProvider(name);
+        if(!ret.impl->provider)
+            THROW_EXCEPTION2(std::invalid_argument, providerName);
+        ret.impl->configure(pva::ConfigurationBuilder().push_env().build());
+
+        Impl::shared->providers[providerName] = ret.impl;
+    }
+    return ret;
+}
+
 std::string
 ClientProvider::name() const
 {
@@ -304,6 +541,8 @@ ClientProvider::connect(const std::string& name,
     }
     // cache miss
     ClientChannel ret(impl->provider, name, conf);
+    ret.impl->counters = impl->cacheCounters;
+    ret.impl->dispatcher = impl->dispatcher;
     impl->channels[K] = ret.impl;
     return ret;
 }
@@ -321,6 +560,13 @@ bool ClientProvider::disconnect(const std::string& name,
     return found;
 }
 
+void ClientProvider::cacheStats(CacheStats& stats) const
+{
+    if(!impl) throw std::logic_error("Dead Provider");
+    Guard G(impl->cacheCounters->mutex);
+    stats = impl->cacheCounters->stats;
+}
+
 void ClientProvider::disconnect()
 {
     if(!impl) throw std::logic_error("Dead Provider");
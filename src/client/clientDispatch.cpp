@@ -0,0 +1,385 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <sstream>
+#include <algorithm>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVAC_DISPATCH_USE_ATOMIC
+#endif
+#endif
+
+#include <pv/current_function.h>
+
+#define epicsExportSharedSymbols
+#include "pv/logger.h"
+#include "clientpvt.h"
+
+namespace pva = epics::pvAccess;
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+namespace pvac {
+namespace detail {
+
+namespace {
+
+#ifdef PVAC_DISPATCH_USE_ATOMIC
+void clearQueued(int& flag) { epicsAtomicSetIntT(&flag, 0); }
+// true if it was clear
+bool setQueued(int& flag) { return epicsAtomicCmpAndSwapIntT(&flag, 0, 1)==0; }
+#else
+// shared by all adapters
+epicsThreadOnceId queuedOnce = EPICS_THREAD_ONCE_INIT;
+epicsMutex *queuedMutex;
+
+void queuedInit(void*)
+{
+    queuedMutex = new epicsMutex;
+}
+
+void clearQueued(int& flag)
+{
+    epicsThreadOnce(&queuedOnce, &queuedInit, 0);
+    Guard G(*queuedMutex);
+    flag = 0;
+}
+
+bool setQueued(int& flag)
+{
+    epicsThreadOnce(&queuedOnce, &queuedInit, 0);
+    Guard G(*queuedMutex);
+    const bool wasClear = !flag;
+    flag = 1;
+    return wasClear;
+}
+#endif
+
+template<typename CB, typename EVT, void (CB::*method)(const EVT&)>
+struct EventWork : public CallbackDispatcher::Work {
+    CB * const target;
+    const EVT event;
+    EventWork(CB *target, const EVT& event) :target(target), event(event) {}
+    virtual ~EventWork() {}
+    virtual void run() OVERRIDE FINAL { (target->*method)(event); }
+};
+
+// MonitorEvent::Data, which allows the next to be queued once run
+struct DataWork : public CallbackDispatcher::Work {
+    const std::tr1::shared_ptr<DispatchAdapter> adapter;
+    const MonitorEvent event;
+    DataWork(const std::tr1::shared_ptr<DispatchAdapter>& adapter, const MonitorEvent& event)
+        :adapter(adapter), event(event) {}
+    virtual ~DataWork() {}
+    virtual void run() OVERRIDE FINAL {
+        // before, so that an update arriving meanwhile is not missed
+        clearQueued(adapter->dataQueued);
+        adapter->moncb->monitorEvent(event);
+    }
+};
+
+// cancel() also waits for the callbacks already queued, after which the application may free them
+struct DispatchedOperation : public Operation::Impl
+{
+    const std::tr1::shared_ptr<DispatchAdapter> adapter;
+    // after adapter, so cancelled before it is freed
+    Operation op;
+
+    DispatchedOperation(const Operation& op, const std::tr1::shared_ptr<DispatchAdapter>& adapter)
+        :adapter(adapter), op(op)
+    {}
+    virtual ~DispatchedOperation()
+    {
+        cancel();
+    }
+
+    virtual std::string name() const OVERRIDE FINAL { return op.name(); }
+
+    virtual void cancel() OVERRIDE FINAL
+    {
+        op.cancel();
+        adapter->dispatcher->sync(adapter->key);
+    }
+
+    virtual void show(std::ostream& strm) const OVERRIDE FINAL
+    {
+        strm << op;
+    }
+};
+
+} // namespace
+
+struct CallbackDispatcher::Worker : public epicsThreadRunable
+{
+    mutable epicsMutex mutex;
+    std::deque<Work*> queue;
+    // running work taken from queue
+    bool busy;
+    bool stopping;
+    // set by a CallbackDispatcher destroyed from this thread, which then deletes itself
+    bool orphan;
+    unsigned syncWaiters;
+    size_t maxDepth;
+    epicsEvent wakeup, idle;
+
+    epicsThread thread;
+
+    Worker(const std::string& name)
+        :busy(false)
+        ,stopping(false)
+        ,orphan(false)
+        ,syncWaiters(0u)
+        ,maxDepth(0u)
+        ,thread(*this, name.c_str(),
+                epicsThreadGetStackSize(epicsThreadStackBig),
+                epicsThreadPriorityMedium)
+    {}
+
+    virtual ~Worker()
+    {
+        for(size_t i=0; i<queue.size(); i++)
+            delete queue[i];
+    }
+
+    virtual void run() OVERRIDE FINAL
+    {
+        bool last;
+        {
+            Guard G(mutex);
+            loop(G);
+            last = orphan;
+        }
+        if(last) {
+            // the epicsThread allows this from its own thread
+            delete this;
+        }
+    }
+
+    void loop(Guard& G)
+    {
+        while(!stopping) {
+            if(queue.empty()) {
+                UnGuard U(G);
+                wakeup.wait();
+                continue;
+            }
+
+            Work *work = queue.front();
+            queue.pop_front();
+            busy = true;
+            {
+                UnGuard U(G);
+                try {
+                    work->run();
+                } catch(std::exception& e) {
+                    LOG(pva::logLevelError, "Unhandled exception from client callback: %s", e.what());
+                }
+                delete work;
+            }
+            busy = false;
+            if(syncWaiters)
+                idle.signal();
+        }
+        if(syncWaiters)
+            idle.signal();
+    }
+};
+
+CallbackDispatcher::CallbackDispatcher(unsigned nthreads)
+{
+    if(nthreads==0u)
+        nthreads = 1u;
+
+    workers.reserve(nthreads);
+    for(unsigned i=0; i<nthreads; i++) {
+        std::ostringstream strm;
+        strm<<"pvac-cb "<<i;
+        workers.push_back(new Worker(strm.str()));
+        workers.back()->thread.start();
+    }
+}
+
+CallbackDispatcher::~CallbackDispatcher()
+{
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        Worker& W = *workers[i];
+        {
+            Guard G(W.mutex);
+            W.stopping = true;
+            // eg. the last Operation dropped by a callback
+            W.orphan = W.thread.isCurrentThread();
+        }
+        W.wakeup.signal();
+    }
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        if(workers[i]->orphan)
+            continue;
+        workers[i]->thread.exitWait();
+        delete workers[i];
+    }
+}
+
+CallbackDispatcher::Worker& CallbackDispatcher::workerOf(const void *key) const
+{
+    // objects are at least 16 byte aligned
+    return *workers[(size_t(key)>>4u) % workers.size()];
+}
+
+void CallbackDispatcher::dispatch(const void *key, Work *work)
+{
+    Worker& W = workerOf(key);
+    bool wake;
+    {
+        Guard G(W.mutex);
+        if(W.stopping) {
+            delete work;
+            return;
+        }
+        wake = W.queue.empty() && !W.busy;
+        W.queue.push_back(work);
+        if(W.queue.size() > W.maxDepth)
+            W.maxDepth = W.queue.size();
+    }
+    dispatched.increment();
+    if(wake)
+        W.wakeup.signal();
+}
+
+void CallbackDispatcher::sync(const void *key)
+{
+    // one worker waiting for another could wait for itself
+    if(isWorker())
+        return;
+
+    Worker& W = workerOf(key);
+    Guard G(W.mutex);
+    W.syncWaiters++;
+    while(!W.stopping && (!W.queue.empty() || W.busy)) {
+        UnGuard U(G);
+        W.idle.wait();
+    }
+    W.syncWaiters--;
+    // pass on to the next waiting
+    if(W.syncWaiters)
+        W.idle.signal();
+}
+
+bool CallbackDispatcher::isWorker() const
+{
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        if(workers[i]->thread.isCurrentThread())
+            return true;
+    }
+    return false;
+}
+
+std::tr1::shared_ptr<DispatchAdapter> CallbackDispatcher::adapt(const shared_pointer& self, const void *key,
+                                                                ClientChannel::GetCallback *cb)
+{
+    std::tr1::shared_ptr<DispatchAdapter> ret;
+    if(self && !dynamic_cast<Direct*>(cb))
+        ret.reset(new DispatchAdapter(self, key, cb, 0, 0));
+    return ret;
+}
+
+std::tr1::shared_ptr<DispatchAdapter> CallbackDispatcher::adapt(const shared_pointer& self, const void *key,
+                                                                ClientChannel::PutCallback *cb)
+{
+    std::tr1::shared_ptr<DispatchAdapter> ret;
+    if(self && !dynamic_cast<Direct*>(cb))
+        ret.reset(new DispatchAdapter(self, key, 0, cb, 0));
+    return ret;
+}
+
+std::tr1::shared_ptr<DispatchAdapter> CallbackDispatcher::adapt(const shared_pointer& self, const void *key,
+                                                                ClientChannel::MonitorCallback *cb)
+{
+    std::tr1::shared_ptr<DispatchAdapter> ret;
+    if(self && !dynamic_cast<Direct*>(cb))
+        ret.reset(new DispatchAdapter(self, key, 0, 0, cb));
+    return ret;
+}
+
+Operation CallbackDispatcher::wrap(const Operation& op, const std::tr1::shared_ptr<DispatchAdapter>& adapter)
+{
+    if(!adapter)
+        return op;
+    std::tr1::shared_ptr<Operation::Impl> ret(new DispatchedOperation(op, adapter));
+    return Operation(ret);
+}
+
+size_t CallbackDispatcher::depth() const
+{
+    size_t ret = 0u;
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        Guard G(workers[i]->mutex);
+        ret += workers[i]->queue.size();
+    }
+    return ret;
+}
+
+void CallbackDispatcher::collectMetrics(pva::Metrics& M)
+{
+    size_t depth = 0u, maxDepth = 0u;
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        Guard G(workers[i]->mutex);
+        depth += workers[i]->queue.size();
+        maxDepth = std::max(maxDepth, workers[i]->maxDepth);
+    }
+
+    M.family("pva_client_callback_threads", pva::Metrics::Gauge,
+             "Threads running client callbacks (EPICS_PVA_CALLBACK_THREADS)");
+    M.add("pva_client_callback_threads", double(workers.size()));
+    M.family("pva_client_callback_queue_depth", pva::Metrics::Gauge,
+             "Client callbacks queued, not yet run");
+    M.add("pva_client_callback_queue_depth", double(depth));
+    M.family("pva_client_callback_queue_depth_max", pva::Metrics::Gauge,
+             "Most client callbacks queued to one thread at once");
+    M.add("pva_client_callback_queue_depth_max", double(maxDepth));
+    M.family("pva_client_callbacks_total", pva::Metrics::Counter,
+             "Client callbacks queued");
+    M.add("pva_client_callbacks_total", double(dispatched.get()));
+}
+
+void DispatchAdapter::getDone(const GetEvent& evt)
+{
+    dispatcher->dispatch(key, new EventWork<ClientChannel::GetCallback, GetEvent,
+                                            &ClientChannel::GetCallback::getDone>(getcb, evt));
+}
+
+void DispatchAdapter::putBuild(const epics::pvData::StructureConstPtr& build, Args& args)
+{
+    putcb->putBuild(build, args);
+}
+
+void DispatchAdapter::putDone(const PutEvent& evt)
+{
+    dispatcher->dispatch(key, new EventWork<ClientChannel::PutCallback, PutEvent,
+                                            &ClientChannel::PutCallback::putDone>(putcb, evt));
+}
+
+void DispatchAdapter::monitorEvent(const MonitorEvent& evt)
+{
+    if(evt.event==MonitorEvent::Data) {
+        // the callback polls all which have arrived
+        if(!setQueued(dataQueued))
+            return;
+        std::tr1::shared_ptr<DispatchAdapter> self(shared_from_this());
+        dispatcher->dispatch(key, new DataWork(self, evt));
+        return;
+    }
+    dispatcher->dispatch(key, new EventWork<ClientChannel::MonitorCallback, MonitorEvent,
+                                            &ClientChannel::MonitorCallback::monitorEvent>(moncb, evt));
+}
+
+}} // namespace pvac::detail
@@ -0,0 +1,145 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+
+#include <pv/pvData.h>
+
+#define epicsExportSharedSymbols
+#include "pv/logger.h"
+#include "clientpvt.h"
+
+namespace pva = epics::pvAccess;
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+namespace pvac {
+
+struct GetFuture::Impl : public ClientChannel::GetCallback,
+                         public pvac::detail::Direct
+{
+    mutable epicsMutex mutex;
+    epicsEvent event;
+    bool done;
+    GetEvent evt;
+    Next *next;
+    Operation op;
+
+    Impl() :done(false), next(0) {}
+    virtual ~Impl()
+    {
+        {
+            Guard G(mutex);
+            delete next;
+            next = 0;
+        }
+        // before our members go away.  No continuation to call.
+        op.cancel();
+    }
+
+    static void call(Next *N, const GetEvent& evt)
+    {
+        try {
+            N->done(evt);
+        } catch(std::exception& e) {
+            LOG(pva::logLevelError, "Unhandled exception from GetFuture continuation: %s", e.what());
+        }
+        delete N;
+    }
+
+    virtual void getDone(const GetEvent& result) OVERRIDE FINAL
+    {
+        Next *N;
+        {
+            Guard G(mutex);
+            if(done) {
+                LOG(pva::logLevelWarn, "oops, double event to GetFuture");
+                return;
+            }
+            evt = result;
+            done = true;
+            N = next;
+            next = 0;
+        }
+        event.signal();
+        // evt is not changed once done.
+        // N may release the last reference to us, so touch nothing after.
+        if(N)
+            call(N, result);
+    }
+};
+
+GetFuture::~GetFuture() {}
+
+void GetFuture::then(Next* N)
+{
+    if(!impl) {
+        delete N;
+        throw std::logic_error("No request");
+    }
+    {
+        Guard G(impl->mutex);
+        if(!impl->done) {
+            delete impl->next;
+            impl->next = N;
+            return;
+        }
+    }
+    Impl::call(N, impl->evt);
+}
+
+bool GetFuture::ready() const
+{
+    if(!impl) throw std::logic_error("No request");
+    Guard G(impl->mutex);
+    return impl->done;
+}
+
+GetEvent GetFuture::wait(double timeout) const
+{
+    if(!impl) throw std::logic_error("No request");
+    Guard G(impl->mutex);
+    while(!impl->done) {
+        UnGuard U(G);
+        if(!impl->event.wait(timeout))
+            throw Timeout();
+    }
+    return impl->evt;
+}
+
+GetEvent GetFuture::result() const
+{
+    if(!impl) throw std::logic_error("No request");
+    Guard G(impl->mutex);
+    if(!impl->done)
+        throw std::logic_error("GetFuture not ready");
+    return impl->evt;
+}
+
+void GetFuture::cancel()
+{
+    if(impl) impl->op.cancel();
+}
+
+GetFuture
+ClientChannel::getAsync(const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    std::tr1::shared_ptr<GetFuture::Impl> ret(new GetFuture::Impl);
+    ret->op = get(ret.get(), pvRequest);
+    return GetFuture(ret);
+}
+
+GetFuture
+ClientChannel::rpcAsync(const epics::pvData::PVStructure::const_shared_pointer& arguments,
+                        const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    std::tr1::shared_ptr<GetFuture::Impl> ret(new GetFuture::Impl);
+    ret->op = rpc(ret.get(), arguments, pvRequest);
+    return GetFuture(ret);
+}
+
+} // namespace pvac
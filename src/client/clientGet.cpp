@@ -6,6 +6,7 @@
 #include <epicsMutex.h>
 #include <epicsGuard.h>
 #include <epicsEvent.h>
+#include <epicsTime.h>
 
 #include <pv/current_function.h>
 #include <pv/pvData.h>
@@ -16,6 +17,7 @@
 #include "pv/logger.h"
 #include "clientpvt.h"
 #include "pv/pvAccess.h"
+#include "pv/tracing.h"
 
 namespace pvd = epics::pvData;
 namespace pva = epics::pvAccess;
@@ -37,14 +39,23 @@ struct GetPutter : public pva::ChannelPutRequester,
     pvac::ClientChannel::PutCallback *putcb;
     pvac::GetEvent event;
 
+    // trace context of the thread which started this operation, if any
+    pva::TraceContext trace;
+
     static size_t num_instances;
 
     explicit GetPutter(pvac::ClientChannel::GetCallback* cb) :started(false), getcb(cb), putcb(0)
-    {REFTRACE_INCREMENT(num_instances);}
+    {REFTRACE_INCREMENT(num_instances); captureTrace();}
     explicit GetPutter(pvac::ClientChannel::PutCallback* cb) :started(false), getcb(0), putcb(cb)
-    {REFTRACE_INCREMENT(num_instances);}
+    {REFTRACE_INCREMENT(num_instances); captureTrace();}
     virtual ~GetPutter() {REFTRACE_DECREMENT(num_instances);}
 
+    void captureTrace()
+    {
+        if(const pva::TraceContext *cur = pva::TraceScope::current())
+            trace = *cur;
+    }
+
     void callEvent(Guard& G, pvac::GetEvent::event_t evt = pvac::GetEvent::Fail)
     {
         if(!putcb && !getcb) return;
@@ -105,6 +116,7 @@ struct GetPutter : public pva::ChannelPutRequester,
             callEvent(G);
 
         } else if(getcb){
+            pva::TraceScope scope(trace.valid() ? &trace : 0);
             channelPut->get();
             started = true;
 
@@ -129,6 +141,7 @@ struct GetPutter : public pva::ChannelPutRequester,
             }
             // check putcb again after UnGuard
             if(putcb) {
+                pva::TraceScope scope(trace.valid() ? &trace : 0);
                 channelPut->put(std::tr1::const_pointer_cast<pvd::PVStructure>(args.root), tosend);
                 started = true;
             }
@@ -203,6 +216,10 @@ ClientChannel::get(ClientChannel::GetCallback* cb,
     if(!pvRequest)
         pvRequest = pvd::createRequest("field()");
 
+    std::tr1::shared_ptr<detail::DispatchAdapter> adapter(detail::CallbackDispatcher::adapt(getDispatcher(), impl.get(), cb));
+    if(adapter)
+        cb = adapter.get();
+
     std::tr1::shared_ptr<GetPutter> ret(GetPutter::build(cb));
 
     {
@@ -211,7 +228,7 @@ ClientChannel::get(ClientChannel::GetCallback* cb,
                                                  std::tr1::const_pointer_cast<pvd::PVStructure>(pvRequest));
     }
 
-    return Operation(ret);
+    return detail::CallbackDispatcher::wrap(Operation(ret), adapter);
 }
 
 Operation
@@ -222,6 +239,10 @@ ClientChannel::put(PutCallback* cb,
     if(!pvRequest)
         pvRequest = pvd::createRequest("field()");
 
+    std::tr1::shared_ptr<detail::DispatchAdapter> adapter(detail::CallbackDispatcher::adapt(getDispatcher(), impl.get(), cb));
+    if(adapter)
+        cb = adapter.get();
+
     std::tr1::shared_ptr<GetPutter> ret(GetPutter::build(cb));
 
     {
@@ -230,8 +251,178 @@ ClientChannel::put(PutCallback* cb,
                                                  std::tr1::const_pointer_cast<pvd::PVStructure>(pvRequest));
     }
 
-    return Operation(ret);
+    return detail::CallbackDispatcher::wrap(Operation(ret), adapter);
+
+}
+
+struct Getter::Impl : public pva::ChannelPutRequester,
+                      public pvac::detail::wrapped_shared_from_this<Getter::Impl>
+{
+    mutable epicsMutex mutex;
+    // each get() in turn
+    epicsMutex serialize;
+    epicsEvent event;
+
+    operation_type::shared_pointer op;
+    bool connected, busy, done;
+    pvd::Status status;
+    pvd::PVStructure::shared_pointer value;
+
+    static size_t num_instances;
+
+    Impl() :connected(false), busy(false), done(false)
+    {REFTRACE_INCREMENT(num_instances);}
+    virtual ~Impl() {REFTRACE_DECREMENT(num_instances);}
+
+    // called automatically via wrapped_shared_from_this
+    void cancel()
+    {
+        operation_type::shared_pointer temp;
+        {
+            Guard G(mutex);
+            temp.swap(op);
+            connected = false;
+            if(busy) {
+                done = true;
+                status = pvd::Status::error("Cancelled");
+            }
+        }
+        event.signal();
+        if(temp)
+            temp->destroy();
+    }
+
+    virtual std::string getRequesterName() OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        return op ? op->getChannel()->getRequesterName() : "<dead>";
+    }
+
+    virtual void channelPutConnect(
+        const epics::pvData::Status& status,
+        pva::ChannelPut::shared_pointer const & channelPut,
+        epics::pvData::Structure::const_shared_pointer const & structure) OVERRIDE FINAL
+    {
+        {
+            Guard G(mutex);
+            connected = status.isSuccess();
+            this->status = status;
+        }
+        event.signal();
+    }
+
+    virtual void channelDisconnect(bool destroy) OVERRIDE FINAL
+    {
+        {
+            Guard G(mutex);
+            connected = false;
+            if(busy) {
+                done = true;
+                status = pvd::Status::error("Disconnect");
+            }
+        }
+        event.signal();
+    }
+
+    virtual void putDone(
+        const epics::pvData::Status& status,
+        pva::ChannelPut::shared_pointer const & channelPut) OVERRIDE FINAL
+    {}
+
+    virtual void getDone(
+        const epics::pvData::Status& status,
+        pva::ChannelPut::shared_pointer const & channelPut,
+        epics::pvData::PVStructure::shared_pointer const & pvStructure,
+        epics::pvData::BitSet::shared_pointer const & bitSet) OVERRIDE FINAL
+    {
+        {
+            Guard G(mutex);
+            if(!busy || done) return;
+            done = true;
+            this->status = status;
+            value = pvStructure;
+        }
+        event.signal();
+    }
+};
+
+size_t Getter::Impl::num_instances;
+
+Getter::~Getter() {}
+
+pvd::PVStructure::const_shared_pointer
+Getter::get(double timeout)
+{
+    if(!impl) throw std::logic_error("No Getter");
+
+    Guard S(impl->serialize);
+
+    const epicsTime deadline(epicsTime::getCurrent() + timeout);
+
+    Guard G(impl->mutex);
+
+    while(!impl->connected) {
+        if(!impl->op)
+            throw std::logic_error("Getter cancelled");
+        const double remaining = deadline - epicsTime::getCurrent();
+        UnGuard U(G);
+        if(remaining<=0.0 || !impl->event.wait(remaining))
+            throw Timeout();
+    }
+
+    operation_type::shared_pointer op(impl->op);
+    impl->busy = true;
+    impl->done = false;
+    impl->value.reset();
+    {
+        UnGuard U(G);
+        op->get();
+    }
+
+    while(!impl->done) {
+        const double remaining = deadline - epicsTime::getCurrent();
+        bool ok;
+        {
+            UnGuard U(G);
+            ok = remaining>0.0 && impl->event.wait(remaining);
+        }
+        if(!ok && !impl->done) {
+            impl->busy = false;
+            UnGuard U(G);
+            op->cancel();
+            throw Timeout();
+        }
+    }
+    impl->busy = false;
+
+    if(!impl->status.isSuccess())
+        throw std::runtime_error(impl->status.getMessage());
+
+    // the operation re-uses its structure for the next get()
+    return pvd::getPVDataCreate()->createPVStructure(impl->value);
+}
+
+void Getter::cancel()
+{
+    if(impl) impl->cancel();
+}
+
+Getter
+ClientChannel::getter(const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    if(!impl) throw std::logic_error("Dead Channel");
+
+    pvd::PVStructure::const_shared_pointer req(pvRequest ? pvRequest : pvd::createRequest("field()"));
+
+    std::tr1::shared_ptr<Getter::Impl> ret(Getter::Impl::build());
+
+    {
+        Guard G(ret->mutex);
+        ret->op = getChannel()->createChannelPut(ret->internal_shared_from_this(),
+                                                 std::tr1::const_pointer_cast<pvd::PVStructure>(req));
+    }
 
+    return Getter(ret);
 }
 
 namespace detail {
@@ -239,6 +430,7 @@ namespace detail {
 void registerRefTrackGet()
 {
     epics::registerRefCounter("pvac::GetPutter", &GetPutter::num_instances);
+    epics::registerRefCounter("pvac::Getter", &Getter::Impl::num_instances);
 }
 
 }
@@ -0,0 +1,551 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <deque>
+#include <vector>
+#include <set>
+#include <string.h>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+#include <epicsTime.h>
+
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+
+#define epicsExportSharedSymbols
+#include "clientpvt.h"
+#include "pv/pvAccess.h"
+
+namespace pvd = epics::pvData;
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+namespace pvac {
+namespace {
+
+struct Time {
+    pvd::int64 sec;
+    pvd::int32 nsec;
+    Time() :sec(0), nsec(0) {}
+    bool operator<(const Time& o) const { return sec<o.sec || (sec==o.sec && nsec<o.nsec); }
+    bool operator==(const Time& o) const { return sec==o.sec && nsec==o.nsec; }
+};
+
+bool timeOf(const pvd::PVStructure& value, const std::string& timeField, Time& T)
+{
+    pvd::PVStructure::const_shared_pointer ts(value.getSubField<pvd::PVStructure>(timeField));
+    if(!ts)
+        return false;
+    pvd::PVScalar::const_shared_pointer sec(ts->getSubField<pvd::PVScalar>("secondsPastEpoch")),
+                                        nsec(ts->getSubField<pvd::PVScalar>("nanoseconds"));
+    if(!sec || !nsec)
+        return false;
+    T.sec = sec->getAs<pvd::int64>();
+    T.nsec = nsec->getAs<pvd::int32>();
+    return true;
+}
+
+// Subscriptions, whose updates are taken by one waiting thread
+struct Members
+{
+    struct Member : public ClientChannel::MonitorCallback,
+                    public pvac::detail::Direct
+    {
+        Members * const owner;
+        const size_t index;
+        Monitor mon;
+        // set once mon is assigned.  Until then events are only noted.
+        bool attached;
+        bool ready;
+        // scratch for pollBatch()
+        std::vector<MonitorUpdate> batch;
+
+        Member(Members *owner, size_t index) :owner(owner), index(index), attached(false), ready(false) {}
+        virtual ~Member() {}
+
+        // only flag, updates are taken by the waiting thread
+        virtual void monitorEvent(const MonitorEvent& evt) OVERRIDE FINAL
+        {
+            if(evt.event!=MonitorEvent::Data)
+                return;
+            {
+                Guard G(owner->mutex);
+                if(ready)
+                    return;
+                ready = true;
+                if(!attached)
+                    return;
+            }
+            owner->event.signal();
+        }
+    };
+    typedef std::vector<std::tr1::shared_ptr<Member> > members_t;
+
+    mutable epicsMutex mutex;
+    epicsEvent event;
+    members_t members;
+    bool woken;
+
+    Members() :woken(false) {}
+    virtual ~Members() {}
+
+    void cancel()
+    {
+        members_t temp;
+        {
+            Guard G(mutex);
+            temp.swap(members);
+        }
+        // Cancel callbacks come back, before the members go away
+        for(size_t i=0; i<temp.size(); i++)
+            temp[i]->mon.cancel();
+    }
+
+    size_t add(ClientChannel& chan,
+               const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+    {
+        size_t index;
+        {
+            Guard G(mutex);
+            index = members.size();
+            members.push_back(std::tr1::shared_ptr<Member>());
+        }
+        std::tr1::shared_ptr<Member> M(new Member(this, index));
+        // not under our lock, as callbacks may come from within
+        Monitor mon(chan.monitor(M.get(), pvRequest));
+
+        bool wakeup;
+        {
+            Guard G(mutex);
+            M->mon = mon;
+            M->attached = true;
+            members[index] = M;
+            // an event came before mon was known
+            wakeup = M->ready;
+        }
+        if(wakeup)
+            event.signal();
+        return index;
+    }
+
+    // call with mutex held.  Pass each update of members with an event to take()
+    void collect(const epicsTime& now)
+    {
+        for(size_t m=0; m<members.size(); m++) {
+            Member *M = members[m].get();
+            if(!M || !M->attached || !M->ready)
+                continue;
+            M->ready = false;
+
+            const size_t n = M->mon.pollBatch(M->batch);
+            for(size_t i=0; i<n; i++)
+                take(*M, M->batch[i], now);
+        }
+    }
+    // call with mutex held.  May swap() from update, which is then re-allocated by pollBatch()
+    virtual void take(Member& M, MonitorUpdate& update, const epicsTime& now) =0;
+
+    /* call with mutex held.  Wait until ready() is true, or timeout, or wake()
+     * ready() sets delay to the seconds after which it may become true, or <0.
+     */
+    template<typename Ready>
+    bool wait(Guard& G, double timeout, Ready& ready)
+    {
+        const epicsTime deadline(epicsTime::getCurrent() + timeout);
+        while(true) {
+            const epicsTime now(epicsTime::getCurrent());
+            double delay;
+            collect(now);
+            if(ready(now, delay))
+                return true;
+            if(woken) {
+                woken = false;
+                return false;
+            }
+            double remaining = deadline - now;
+            if(remaining<=0.0)
+                return false;
+            if(delay>=0.0 && delay<remaining)
+                remaining = delay;
+
+            UnGuard U(G);
+            event.wait(remaining);
+        }
+    }
+
+    void wake()
+    {
+        {
+            Guard G(mutex);
+            woken = true;
+        }
+        event.signal();
+    }
+};
+
+} // namespace
+
+struct MonitorGroup::Impl : public Members
+{
+    struct Entry {
+        Time time;
+        // when received, from which Options::timeout is counted
+        epicsTime arrived;
+        pvd::PVStructure::const_shared_pointer value;
+    };
+    // of each member, in time order, oldest first
+    std::vector<std::deque<Entry> > rings;
+
+    const Options opts;
+
+    // time of the last snapshot
+    bool emitted;
+    Time last;
+    Stats stats;
+
+    // passes assemble() to Members::wait()
+    struct Assemble {
+        Impl& impl;
+        Snapshot& snap;
+        Assemble(Impl& impl, Snapshot& snap) :impl(impl), snap(snap) {}
+        bool operator()(const epicsTime& now, double& delay) { return impl.assemble(snap, now, delay); }
+    };
+
+    explicit Impl(const Options& opts)
+        :opts(opts)
+        ,emitted(false)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+    virtual ~Impl()
+    {
+        cancel();
+    }
+
+    virtual void take(Member& M, MonitorUpdate& update, const epicsTime& now) OVERRIDE FINAL
+    {
+        Entry E;
+        if(!timeOf(*update.root, opts.timeField, E.time) || (emitted && !(last<E.time))) {
+            stats.dropped++;
+            return;
+        }
+        E.arrived = now;
+        // kept, not copied
+        E.value.swap(update.root);
+
+        if(rings.size()<=M.index)
+            rings.resize(M.index+1u);
+        std::deque<Entry>& ring = rings[M.index];
+
+        std::deque<Entry>::iterator pos(ring.end());
+        while(pos!=ring.begin() && E.time<(pos-1)->time)
+            --pos;
+        ring.insert(pos, E);
+
+        if(ring.size()>opts.depth) {
+            ring.pop_front();
+            stats.dropped++;
+        }
+    }
+
+    /* call with mutex held.  Take the oldest snapshot which is ready.
+     * Otherwise, delay is set to the seconds until one may time out, or <0.
+     */
+    bool assemble(Snapshot& snap, const epicsTime& now, double& delay)
+    {
+        delay = -1.0;
+        const size_t nmembers = members.size();
+        rings.resize(nmembers);
+        while(true) {
+            // the oldest time kept
+            bool any = false;
+            Time T;
+            for(size_t m=0; m<nmembers; m++) {
+                const std::deque<Entry>& ring = rings[m];
+                if(!ring.empty() && (!any || ring.front().time<T)) {
+                    T = ring.front().time;
+                    any = true;
+                }
+            }
+            if(!any)
+                return false;
+
+            size_t count = 0u;
+            // may a member without this time yet send it
+            bool possible = true;
+            epicsTime first(now);
+            for(size_t m=0; m<nmembers; m++) {
+                const std::deque<Entry>& ring = rings[m];
+                if(!ring.empty() && ring.front().time==T) {
+                    count++;
+                    if(ring.front().arrived < first)
+                        first = ring.front().arrived;
+                } else if(!ring.empty()) {
+                    // already later
+                    possible = false;
+                }
+            }
+
+            bool take = count==nmembers;
+            if(!take && opts.timeout>0.0) {
+                const double waited = now - first;
+                if(!possible || waited>=opts.timeout) {
+                    take = true;
+                } else {
+                    delay = opts.timeout - waited;
+                    return false;
+                }
+            } else if(!take && possible) {
+                return false;
+            }
+
+            if(take) {
+                snap.secondsPastEpoch = T.sec;
+                snap.nanoseconds = T.nsec;
+                snap.count = count;
+                snap.values.clear();
+                snap.values.resize(nmembers);
+            }
+            for(size_t m=0; m<nmembers; m++) {
+                std::deque<Entry>& ring = rings[m];
+                if(!ring.empty() && ring.front().time==T) {
+                    if(take)
+                        snap.values[m].swap(ring.front().value);
+                    ring.pop_front();
+                }
+            }
+            emitted = true;
+            last = T;
+
+            if(take) {
+                if(count==nmembers)
+                    stats.complete++;
+                else
+                    stats.partial++;
+                return true;
+            }
+            // can not complete, and not wanted incomplete
+            stats.dropped += count;
+        }
+    }
+};
+
+MonitorGroup::Options::Options()
+    :depth(8u)
+    ,timeout(1.0)
+    ,timeField("timeStamp")
+{}
+
+MonitorGroup::MonitorGroup(const Options& opts) :impl(new Impl(opts)) {}
+
+MonitorGroup::~MonitorGroup() {}
+
+size_t MonitorGroup::add(ClientChannel& chan,
+                         const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    return impl->add(chan, pvRequest);
+}
+
+size_t MonitorGroup::size() const
+{
+    Guard G(impl->mutex);
+    return impl->members.size();
+}
+
+bool MonitorGroup::wait(Snapshot& snap, double timeout)
+{
+    Guard G(impl->mutex);
+    Impl::Assemble ready(*impl, snap);
+    return impl->wait(G, timeout, ready);
+}
+
+bool MonitorGroup::test(Snapshot& snap)
+{
+    const epicsTime now(epicsTime::getCurrent());
+    double delay;
+    Guard G(impl->mutex);
+    impl->collect(now);
+    return impl->assemble(snap, now, delay);
+}
+
+void MonitorGroup::wake()
+{
+    impl->wake();
+}
+
+void MonitorGroup::getStats(Stats& out) const
+{
+    Guard G(impl->mutex);
+    out = impl->stats;
+}
+
+struct MonitorMerge::Impl : public Members
+{
+    struct Entry {
+        Time time;
+        // when received, from which Options::window is counted
+        epicsTime arrived;
+        MonitorUpdate update;
+    };
+    // of each member, in time order, oldest first
+    std::vector<std::deque<Entry> > queues;
+    // the time of the first of each queue not empty, and its member.  The oldest first.
+    typedef std::set<std::pair<Time, size_t> > fronts_t;
+    fronts_t fronts;
+
+    const Options opts;
+
+    // time of the last update taken, not late
+    bool taken;
+    Time last;
+    Stats stats;
+
+    // passes merge() to Members::wait()
+    struct Merge {
+        Impl& impl;
+        std::vector<Event>& out;
+        const size_t maxCount;
+        Merge(Impl& impl, std::vector<Event>& out, size_t maxCount) :impl(impl), out(out), maxCount(maxCount) {}
+        bool operator()(const epicsTime& now, double& delay) { return impl.merge(out, maxCount, now, delay); }
+    };
+
+    explicit Impl(const Options& opts)
+        :opts(opts)
+        ,taken(false)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+    virtual ~Impl()
+    {
+        cancel();
+    }
+
+    virtual void take(Member& M, MonitorUpdate& update, const epicsTime& now) OVERRIDE FINAL
+    {
+        Entry E;
+        if(!timeOf(*update.root, opts.timeField, E.time)) {
+            stats.dropped++;
+            return;
+        }
+        E.arrived = now;
+        // kept, not copied
+        E.update.root.swap(update.root);
+        E.update.changed.swap(update.changed);
+        E.update.overrun.swap(update.overrun);
+
+        if(queues.size()<=M.index)
+            queues.resize(M.index+1u);
+        std::deque<Entry>& queue = queues[M.index];
+
+        // usually appended
+        std::deque<Entry>::iterator pos(queue.end());
+        while(pos!=queue.begin() && E.time<(pos-1)->time)
+            --pos;
+        if(pos==queue.begin()) {
+            if(!queue.empty())
+                fronts.erase(std::make_pair(queue.front().time, M.index));
+            fronts.insert(std::make_pair(E.time, M.index));
+        }
+        queue.insert(pos, E);
+        stats.held++;
+    }
+
+    /* call with mutex held.  Take, in time order, the updates whose window has passed.
+     * Stops at the first which has not, and sets delay to the seconds until it has.
+     */
+    bool merge(std::vector<Event>& out, size_t maxCount, const epicsTime& now, double& delay)
+    {
+        delay = -1.0;
+        out.clear();
+        while(out.size()<maxCount && !fronts.empty()) {
+            const size_t index = fronts.begin()->second;
+            std::deque<Entry>& queue = queues[index];
+            Entry& E = queue.front();
+
+            const double age = now - E.arrived;
+            if(age<opts.window && stats.held<=opts.capacity) {
+                delay = opts.window - age;
+                break;
+            }
+
+            out.resize(out.size()+1u);
+            Event& evt = out.back();
+            evt.index = index;
+            evt.secondsPastEpoch = E.time.sec;
+            evt.nanoseconds = E.time.nsec;
+            evt.late = taken && E.time<last;
+            evt.update.root.swap(E.update.root);
+            evt.update.changed.swap(E.update.changed);
+            evt.update.overrun.swap(E.update.overrun);
+            if(evt.late) {
+                stats.late++;
+            } else {
+                taken = true;
+                last = E.time;
+            }
+            stats.taken++;
+
+            fronts.erase(fronts.begin());
+            queue.pop_front();
+            stats.held--;
+            if(!queue.empty())
+                fronts.insert(std::make_pair(queue.front().time, index));
+        }
+        return !out.empty();
+    }
+};
+
+MonitorMerge::Options::Options()
+    :window(0.1)
+    ,capacity(100000u)
+    ,timeField("timeStamp")
+{}
+
+MonitorMerge::MonitorMerge(const Options& opts) :impl(new Impl(opts)) {}
+
+MonitorMerge::~MonitorMerge() {}
+
+size_t MonitorMerge::add(ClientChannel& chan,
+                         const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    return impl->add(chan, pvRequest);
+}
+
+size_t MonitorMerge::size() const
+{
+    Guard G(impl->mutex);
+    return impl->members.size();
+}
+
+bool MonitorMerge::wait(std::vector<Event>& out, double timeout, size_t maxCount)
+{
+    Guard G(impl->mutex);
+    Impl::Merge ready(*impl, out, maxCount);
+    return impl->wait(G, timeout, ready);
+}
+
+bool MonitorMerge::test(std::vector<Event>& out, size_t maxCount)
+{
+    const epicsTime now(epicsTime::getCurrent());
+    double delay;
+    Guard G(impl->mutex);
+    impl->collect(now);
+    return impl->merge(out, maxCount, now, delay);
+}
+
+void MonitorMerge::wake()
+{
+    impl->wake();
+}
+
+void MonitorMerge::getStats(Stats& out) const
+{
+    Guard G(impl->mutex);
+    out = impl->stats;
+}
+
+}//namespace pvac
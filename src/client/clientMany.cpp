@@ -0,0 +1,527 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <sstream>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+
+#include <pv/current_function.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/createRequest.h>
+#include <pv/reftrack.h>
+
+#define epicsExportSharedSymbols
+#include "pv/logger.h"
+#include "pv/codec.h"
+#include "clientpvt.h"
+#include "pva/client.h"
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+namespace {
+
+// one Operation for many get() or put()
+struct ManyOp : public pvac::Operation::Impl
+{
+    // forwards to cb with the index of one channel
+    struct Slot : public pvac::ClientChannel::GetCallback,
+                  public pvac::ClientChannel::PutCallback
+    {
+        pvac::ClientProvider::ManyCallback *cb;
+        size_t index;
+
+        Slot() :cb(0), index(0u) {}
+        virtual ~Slot() {}
+
+        virtual void getDone(const pvac::GetEvent& evt) OVERRIDE FINAL
+        {
+            cb->manyDone(index, evt);
+        }
+        virtual void putBuild(const epics::pvData::StructureConstPtr& build, Args& args) OVERRIDE FINAL
+        {
+            cb->putBuild(index, build, args);
+        }
+        virtual void putDone(const pvac::PutEvent& evt) OVERRIDE FINAL
+        {
+            pvac::GetEvent done;
+            done.event = evt.event;
+            done.message = evt.message;
+            cb->manyDone(index, done);
+        }
+    };
+
+    // sized before any request is issued, so Slot addresses are stable
+    std::vector<Slot> slots;
+    std::vector<pvac::ClientChannel> channels;
+    std::vector<pvac::Operation> ops;
+
+    ManyOp(pvac::ClientProvider::ManyCallback *cb, size_t count)
+        :slots(count)
+        ,channels(count)
+        ,ops(count)
+    {
+        for(size_t i=0; i<count; i++) {
+            slots[i].cb = cb;
+            slots[i].index = i;
+        }
+    }
+    virtual ~ManyOp()
+    {
+        // callbacks of those not complete, before the slots go away
+        cancel();
+    }
+
+    virtual std::string name() const OVERRIDE FINAL
+    {
+        std::ostringstream strm;
+        strm<<"<"<<ops.size()<<" channels>";
+        return strm.str();
+    }
+
+    virtual void cancel() OVERRIDE FINAL
+    {
+        for(size_t i=0; i<ops.size(); i++)
+            ops[i].cancel();
+    }
+
+    virtual void show(std::ostream& strm) const OVERRIDE FINAL
+    {
+        strm<<"Operation(Many "<<ops.size()<<")\n";
+        for(size_t i=0; i<ops.size(); i++)
+            strm<<"  "<<ops[i]<<"\n";
+    }
+};
+
+// process() or putGet() of one channel, for processMany() and putGetMany()
+struct ManyRequest : public pva::ChannelProcessRequester,
+                     public pva::ChannelPutGetRequester,
+                     public pvac::Operation::Impl,
+                     public pvac::detail::wrapped_shared_from_this<ManyRequest>
+{
+    mutable epicsMutex mutex;
+
+    // NULL once complete
+    pvac::ClientProvider::ManyCallback *cb;
+    const size_t index;
+
+    bool started;
+    // one of
+    pva::ChannelProcess::shared_pointer process;
+    pva::ChannelPutGet::shared_pointer putget;
+
+    pvac::GetEvent event;
+
+    static size_t num_instances;
+
+    ManyRequest(pvac::ClientProvider::ManyCallback *cb, size_t index)
+        :cb(cb), index(index), started(false)
+    {REFTRACE_INCREMENT(num_instances);}
+    virtual ~ManyRequest() {REFTRACE_DECREMENT(num_instances);}
+
+    void complete(Guard& G, pvac::GetEvent::event_t evt = pvac::GetEvent::Fail)
+    {
+        if(!cb) return;
+
+        pvac::ClientProvider::ManyCallback *temp = cb;
+        cb = 0;
+        event.event = evt;
+        UnGuard U(G);
+        temp->manyDone(index, event);
+    }
+
+    void setMessage(const pvd::Status& status)
+    {
+        if(!status.isOK()) {
+            event.message = status.getMessage();
+        } else {
+            event.message.clear();
+        }
+    }
+
+    pva::ChannelRequest* request() const
+    {
+        if(process)
+            return process.get();
+        return putget.get();
+    }
+
+    virtual std::string name() const OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        pva::ChannelRequest *op = request();
+        return op ? op->getChannel()->getChannelName() : "<dead>";
+    }
+
+    // called automatically via wrapped_shared_from_this
+    virtual void cancel() OVERRIDE FINAL
+    {
+        std::tr1::shared_ptr<ManyRequest> keepalive(internal_shared_from_this());
+        Guard G(mutex);
+        pva::ChannelRequest *op = request();
+        if(started && op) op->cancel();
+        complete(G, pvac::GetEvent::Cancel);
+    }
+
+    virtual void show(std::ostream &strm) const OVERRIDE FINAL
+    {
+        strm << "Operation(" << (putget ? "PutGet" : "Process")
+             << " \"" << name() << "\")";
+    }
+
+    virtual std::string getRequesterName() OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        pva::ChannelRequest *op = request();
+        return op ? op->getChannel()->getRequesterName() : "<dead>";
+    }
+
+    virtual void channelDisconnect(bool destroy) OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        event.message = "Disconnect";
+
+        complete(G);
+    }
+
+    virtual void channelProcessConnect(
+        const epics::pvData::Status& status,
+        pva::ChannelProcess::shared_pointer const & channelProcess) OVERRIDE FINAL
+    {
+        std::tr1::shared_ptr<ManyRequest> keepalive(internal_shared_from_this());
+        Guard G(mutex);
+        if(started || !cb) return;
+
+        setMessage(status);
+        if(!status.isSuccess()) {
+            complete(G);
+        } else {
+            channelProcess->process();
+            started = true;
+        }
+    }
+
+    virtual void processDone(
+        const epics::pvData::Status& status,
+        pva::ChannelProcess::shared_pointer const & channelProcess) OVERRIDE FINAL
+    {
+        std::tr1::shared_ptr<ManyRequest> keepalive(internal_shared_from_this());
+        Guard G(mutex);
+        setMessage(status);
+        complete(G, status.isSuccess() ? pvac::GetEvent::Success : pvac::GetEvent::Fail);
+    }
+
+    virtual void channelPutGetConnect(
+        const epics::pvData::Status& status,
+        pva::ChannelPutGet::shared_pointer const & channelPutGet,
+        epics::pvData::Structure::const_shared_pointer const & putStructure,
+        epics::pvData::Structure::const_shared_pointer const & getStructure) OVERRIDE FINAL
+    {
+        std::tr1::shared_ptr<ManyRequest> keepalive(internal_shared_from_this());
+        Guard G(mutex);
+        if(started || !cb) return;
+
+        setMessage(status);
+        if(!status.isSuccess()) {
+            complete(G);
+            return;
+        }
+
+        pvac::ClientProvider::ManyCallback *temp(cb);
+        pvd::BitSet::shared_pointer tosend(new pvd::BitSet);
+        pvac::ClientChannel::PutCallback::Args args(*tosend);
+        try {
+            UnGuard U(G);
+            temp->putBuild(index, putStructure, args);
+            if(!args.root)
+                throw std::logic_error("No put value provided");
+            else if(*args.root->getStructure()!=*putStructure)
+                throw std::logic_error("Provided put value with wrong type");
+        }catch(std::exception& e){
+            if(cb) {
+                event.message = e.what();
+                complete(G);
+            } else {
+                LOG(pva::logLevelInfo, "Lost exception in %s: %s", CURRENT_FUNCTION, e.what());
+            }
+        }
+        // check cb again after UnGuard
+        if(cb) {
+            channelPutGet->putGet(std::tr1::const_pointer_cast<pvd::PVStructure>(args.root), tosend);
+            started = true;
+        }
+    }
+
+    virtual void putGetDone(
+        const epics::pvData::Status& status,
+        pva::ChannelPutGet::shared_pointer const & channelPutGet,
+        epics::pvData::PVStructure::shared_pointer const & pvGetStructure,
+        epics::pvData::BitSet::shared_pointer const & getBitSet) OVERRIDE FINAL
+    {
+        std::tr1::shared_ptr<ManyRequest> keepalive(internal_shared_from_this());
+        Guard G(mutex);
+        if(!cb) return;
+
+        setMessage(status);
+        event.value = pvGetStructure;
+        event.valid = getBitSet;
+        complete(G, status.isSuccess() ? pvac::GetEvent::Success : pvac::GetEvent::Fail);
+    }
+
+    virtual void getPutDone(
+        const epics::pvData::Status& status,
+        pva::ChannelPutGet::shared_pointer const & channelPutGet,
+        epics::pvData::PVStructure::shared_pointer const & pvPutStructure,
+        epics::pvData::BitSet::shared_pointer const & putBitSet) OVERRIDE FINAL
+    { /* never called */ }
+
+    virtual void getGetDone(
+        const epics::pvData::Status& status,
+        pva::ChannelPutGet::shared_pointer const & channelPutGet,
+        epics::pvData::PVStructure::shared_pointer const & pvGetStructure,
+        epics::pvData::BitSet::shared_pointer const & getBitSet) OVERRIDE FINAL
+    { /* never called */ }
+};
+
+size_t ManyRequest::num_instances;
+
+// collects the results of blocking getMany() and putMany()
+struct ManyWait : public pvac::ClientProvider::ManyCallback
+{
+    epicsMutex mutex;
+    epicsEvent event;
+    size_t remaining;
+    std::vector<pvac::GetEvent> results;
+    const std::vector<pvd::AnyScalar> *values;
+
+    ManyWait(size_t count, const std::vector<pvd::AnyScalar> *values =0)
+        :remaining(count)
+        ,results(count)
+        ,values(values)
+    {
+        // those never completed
+        for(size_t i=0; i<count; i++)
+            results[i].event = pvac::GetEvent::Cancel;
+    }
+    virtual ~ManyWait() {}
+
+    virtual void putBuild(size_t index, const epics::pvData::StructureConstPtr& build,
+                          pvac::ClientChannel::PutCallback::Args& args) OVERRIDE FINAL
+    {
+        pvd::PVStructurePtr root(pvd::getPVDataCreate()->createPVStructure(build));
+        pvd::PVScalarPtr value(root->getSubField<pvd::PVScalar>("value"));
+        if(!value)
+            throw std::runtime_error("Server does not have scalar field value");
+        value->putFrom((*values)[index]);
+        args.tosend.set(value->getFieldOffset());
+        args.root = root;
+    }
+
+    virtual void manyDone(size_t index, const pvac::GetEvent& evt) OVERRIDE FINAL
+    {
+        bool last;
+        {
+            Guard G(mutex);
+            results[index] = evt;
+            last = --remaining==0u;
+        }
+        if(last)
+            event.signal();
+    }
+
+    void wait(double timeout)
+    {
+        {
+            Guard G(mutex);
+            if(remaining==0u)
+                return;
+        }
+        // signaled once, by the last to complete
+        event.wait(timeout);
+    }
+};
+
+} // namespace
+
+namespace pvac {
+
+Operation
+ClientProvider::getMany(ManyCallback* cb,
+                        const std::vector<std::string>& names,
+                        const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    if(!impl) throw std::logic_error("Dead Provider");
+
+    std::tr1::shared_ptr<ManyOp> ret(new ManyOp(cb, names.size()));
+
+    // connect() does not block, so all searches are in flight before the first reply
+    for(size_t i=0; i<names.size(); i++)
+        ret->channels[i] = connect(names[i]);
+
+    {
+        // wake the sender of each connection once, after all are queued
+        pva::detail::SendBatch hold;
+        for(size_t i=0; i<names.size(); i++)
+            ret->ops[i] = ret->channels[i].get(&ret->slots[i], pvRequest);
+    }
+
+    return Operation(ret);
+}
+
+Operation
+ClientProvider::putMany(ManyCallback* cb,
+                        const std::vector<std::string>& names,
+                        const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    if(!impl) throw std::logic_error("Dead Provider");
+
+    std::tr1::shared_ptr<ManyOp> ret(new ManyOp(cb, names.size()));
+
+    for(size_t i=0; i<names.size(); i++)
+        ret->channels[i] = connect(names[i]);
+
+    {
+        pva::detail::SendBatch hold;
+        for(size_t i=0; i<names.size(); i++)
+            ret->ops[i] = ret->channels[i].put(&ret->slots[i], pvRequest);
+    }
+
+    return Operation(ret);
+}
+
+Operation
+ClientProvider::processMany(ManyCallback* cb,
+                            const std::vector<std::string>& names,
+                            const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    if(!impl) throw std::logic_error("Dead Provider");
+
+    std::tr1::shared_ptr<ManyOp> ret(new ManyOp(cb, names.size()));
+
+    for(size_t i=0; i<names.size(); i++)
+        ret->channels[i] = connect(names[i]);
+
+    pvd::PVStructure::shared_pointer req(std::tr1::const_pointer_cast<pvd::PVStructure>(
+                                             pvRequest ? pvRequest : pvd::createRequest("field()")));
+    {
+        pva::detail::SendBatch hold;
+        for(size_t i=0; i<names.size(); i++) {
+            std::tr1::shared_ptr<ManyRequest> op(ManyRequest::build(cb, i));
+            {
+                Guard G(op->mutex);
+                op->process = ret->channels[i].getChannel()->createChannelProcess(op->internal_shared_from_this(), req);
+            }
+            ret->ops[i] = Operation(op);
+        }
+    }
+
+    return Operation(ret);
+}
+
+Operation
+ClientProvider::putGetMany(ManyCallback* cb,
+                           const std::vector<std::string>& names,
+                           const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    if(!impl) throw std::logic_error("Dead Provider");
+
+    std::tr1::shared_ptr<ManyOp> ret(new ManyOp(cb, names.size()));
+
+    for(size_t i=0; i<names.size(); i++)
+        ret->channels[i] = connect(names[i]);
+
+    pvd::PVStructure::shared_pointer req(std::tr1::const_pointer_cast<pvd::PVStructure>(
+                                             pvRequest ? pvRequest : pvd::createRequest("putField(value)getField()")));
+    {
+        pva::detail::SendBatch hold;
+        for(size_t i=0; i<names.size(); i++) {
+            std::tr1::shared_ptr<ManyRequest> op(ManyRequest::build(cb, i));
+            {
+                Guard G(op->mutex);
+                op->putget = ret->channels[i].getChannel()->createChannelPutGet(op->internal_shared_from_this(), req);
+            }
+            ret->ops[i] = Operation(op);
+        }
+    }
+
+    return Operation(ret);
+}
+
+std::vector<GetEvent>
+ClientProvider::getMany(const std::vector<std::string>& names,
+                        double timeout,
+                        const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    ManyWait waiter(names.size());
+    {
+        Operation op(getMany(&waiter, names, pvRequest));
+        waiter.wait(timeout);
+    }
+    // op cancelled, so no more callbacks
+    return waiter.results;
+}
+
+std::vector<PutEvent>
+ClientProvider::putMany(const std::vector<std::string>& names,
+                        const std::vector<epics::pvData::AnyScalar>& values,
+                        double timeout,
+                        const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    if(names.size()!=values.size())
+        throw std::logic_error("putMany() needs one value for each name");
+
+    ManyWait waiter(names.size(), &values);
+    {
+        Operation op(putMany(&waiter, names, pvRequest));
+        waiter.wait(timeout);
+    }
+    return std::vector<PutEvent>(waiter.results.begin(), waiter.results.end());
+}
+
+std::vector<PutEvent>
+ClientProvider::processMany(const std::vector<std::string>& names,
+                            double timeout,
+                            const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    ManyWait waiter(names.size());
+    {
+        Operation op(processMany(&waiter, names, pvRequest));
+        waiter.wait(timeout);
+    }
+    return std::vector<PutEvent>(waiter.results.begin(), waiter.results.end());
+}
+
+std::vector<GetEvent>
+ClientProvider::putGetMany(const std::vector<std::string>& names,
+                           const std::vector<epics::pvData::AnyScalar>& values,
+                           double timeout,
+                           const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    if(names.size()!=values.size())
+        throw std::logic_error("putGetMany() needs one value for each name");
+
+    ManyWait waiter(names.size(), &values);
+    {
+        Operation op(putGetMany(&waiter, names, pvRequest));
+        waiter.wait(timeout);
+    }
+    return waiter.results;
+}
+
+namespace detail {
+
+void registerRefTrackMany()
+{
+    epics::registerRefCounter("pvac::ManyRequest", &ManyRequest::num_instances);
+}
+
+}
+
+} // namespace pvac
@@ -34,6 +34,9 @@ struct Monitor::Impl : public pva::MonitorRequester,
     ClientChannel::MonitorCallback *cb;
     MonitorEvent event;
 
+    // set when cb queues to EPICS_PVA_CALLBACK_THREADS
+    std::tr1::shared_ptr<detail::DispatchAdapter> adapter;
+
     pva::MonitorElement::Ref last;
 
     static size_t num_instances;
@@ -101,6 +104,9 @@ struct Monitor::Impl : public pva::MonitorRequester,
         }
         if(temp)
             temp->destroy();
+        // the application may free cb once we return
+        if(adapter)
+            adapter->dispatcher->sync(adapter->key);
     }
 
     virtual std::string getRequesterName() OVERRIDE FINAL
@@ -228,6 +234,42 @@ bool Monitor::poll()
     return !impl->seenEmpty;
 }
 
+size_t Monitor::pollBatch(std::vector<MonitorUpdate>& out, size_t maxCount)
+{
+    return pollInto(out, 0u, maxCount);
+}
+
+size_t Monitor::pollInto(std::vector<MonitorUpdate>& out, size_t start, size_t maxCount)
+{
+    if(!impl) {
+        out.resize(start);
+        return 0u;
+    }
+    Guard G(impl->mutex);
+
+    size_t n = 0u;
+    while(n<maxCount && !impl->done && impl->op && impl->last.next()) {
+        if(start+n>=out.size())
+            out.resize(start+n+1u);
+        MonitorUpdate& U = out[start+n];
+
+        const epics::pvData::PVStructurePtr& ptr = impl->last->pvStructurePtr;
+        U.changed = *impl->last->changedBitSet;
+        U.overrun = *impl->last->overrunBitSet;
+
+        // entries are not successive updates, so copy all fields
+        if(U.root && U.root.unique() && (void*)U.root->getField().get()==(void*)ptr->getField().get()) {
+            const_cast<pvd::PVStructure&>(*U.root).copyUnchecked(*ptr);
+        } else {
+            U.root = pvd::getPVDataCreate()->createPVStructure(ptr);
+        }
+        n++;
+    }
+    impl->seenEmpty = n<maxCount;
+    out.resize(start+n);
+    return n;
+}
+
 bool Monitor::complete() const
 {
     if(!impl) return true;
@@ -243,8 +285,13 @@ ClientChannel::monitor(MonitorCallback *cb,
     if(!pvRequest)
         pvRequest = pvd::createRequest("field()");
 
+    std::tr1::shared_ptr<detail::DispatchAdapter> adapter(detail::CallbackDispatcher::adapt(getDispatcher(), impl.get(), cb));
+    if(adapter)
+        cb = adapter.get();
+
     std::tr1::shared_ptr<Monitor::Impl> ret(Monitor::Impl::build(cb));
     ret->chan = getChannel();
+    ret->adapter = adapter;
 
     {
         Guard G(ret->mutex);
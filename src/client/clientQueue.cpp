@@ -0,0 +1,226 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <errno.h>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVAC_QUEUE_USE_ATOMIC
+#endif
+#endif
+
+#ifdef __linux__
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#define PVAC_QUEUE_USE_EVENTFD
+#endif
+
+#include <pv/current_function.h>
+
+#define epicsExportSharedSymbols
+#include "pv/logger.h"
+#include "pva/client.h"
+
+namespace pva = epics::pvAccess;
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+struct Node {
+    Node *next;
+    Node() :next(0) {}
+    virtual ~Node() {}
+    virtual void run() =0;
+};
+
+template<typename CB, typename EVT, void (CB::*method)(const EVT&)>
+struct EventNode : public Node {
+    CB * const target;
+    const EVT event;
+    EventNode(CB *target, const EVT& event) :target(target), event(event) {}
+    virtual ~EventNode() {}
+    virtual void run() OVERRIDE FINAL { (target->*method)(event); }
+};
+
+} // namespace
+
+namespace pvac {
+
+/* Producers (PVA threads) push onto a singly linked stack with compare and swap.
+ * The consumer (drain()) takes the whole stack at once, and reverses it.
+ * As only the consumer removes, and removes all, there is no ABA problem.
+ */
+struct CompletionQueue::Impl
+{
+#ifdef PVAC_QUEUE_USE_ATOMIC
+    EpicsAtomicPtrT head;
+#else
+    epicsMutex mutex;
+    Node *head;
+#endif
+    // signaled on empty -> not empty
+    epicsEvent event;
+    int efd;
+
+    Impl()
+        :head(0)
+        ,efd(-1)
+    {
+#ifdef PVAC_QUEUE_USE_EVENTFD
+        efd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+        if(efd<0)
+            LOG(pva::logLevelError, "%s : eventfd() error %d", CURRENT_FUNCTION, errno);
+#endif
+    }
+    ~Impl()
+    {
+        // events never run
+        Node *n = take();
+        while(n) {
+            Node *next = n->next;
+            delete n;
+            n = next;
+        }
+#ifdef PVAC_QUEUE_USE_EVENTFD
+        if(efd>=0)
+            close(efd);
+#endif
+    }
+
+    void push(Node *n)
+    {
+        bool first;
+#ifdef PVAC_QUEUE_USE_ATOMIC
+        EpicsAtomicPtrT prev;
+        do {
+            prev = epics::atomic::get(head);
+            n->next = static_cast<Node*>(prev);
+        } while(epics::atomic::compareAndSwap(head, prev, n)!=prev);
+        first = !prev;
+#else
+        {
+            Guard G(mutex);
+            n->next = head;
+            head = n;
+        }
+        first = !n->next;
+#endif
+        if(!first)
+            return; // the consumer is already notified
+#ifdef PVAC_QUEUE_USE_EVENTFD
+        if(efd>=0) {
+            uint64_t one = 1u;
+            if(write(efd, &one, sizeof(one))!=sizeof(one) && errno!=EAGAIN)
+                LOG(pva::logLevelError, "%s : eventfd write error %d", CURRENT_FUNCTION, errno);
+        }
+#endif
+        event.signal();
+    }
+
+    // newest first
+    Node* take()
+    {
+#ifdef PVAC_QUEUE_USE_ATOMIC
+        EpicsAtomicPtrT all;
+        do {
+            all = epics::atomic::get(head);
+        } while(all && epics::atomic::compareAndSwap(head, all, 0)!=all);
+        return static_cast<Node*>(all);
+#else
+        Guard G(mutex);
+        Node *all = head;
+        head = 0;
+        return all;
+#endif
+    }
+};
+
+CompletionQueue::CompletionQueue()
+    :impl(new Impl)
+{}
+
+CompletionQueue::~CompletionQueue() {}
+
+int CompletionQueue::fd() const
+{
+    return impl->efd;
+}
+
+size_t CompletionQueue::drain()
+{
+#ifdef PVAC_QUEUE_USE_EVENTFD
+    // clear before take(), so a push() after take() makes fd readable again
+    if(impl->efd>=0) {
+        uint64_t count;
+        if(read(impl->efd, &count, sizeof(count))<0 && errno!=EAGAIN)
+            LOG(pva::logLevelError, "%s : eventfd read error %d", CURRENT_FUNCTION, errno);
+    }
+#endif
+
+    Node *rev = impl->take(), *fifo = 0;
+    while(rev) {
+        Node *next = rev->next;
+        rev->next = fifo;
+        fifo = rev;
+        rev = next;
+    }
+
+    size_t count = 0u;
+    while(fifo) {
+        Node *next = fifo->next;
+        try {
+            fifo->run();
+        } catch(std::exception& e) {
+            LOG(pva::logLevelError, "Unhandled exception from client callback: %s", e.what());
+        }
+        delete fifo;
+        fifo = next;
+        count++;
+    }
+    return count;
+}
+
+bool CompletionQueue::wait(double timeout)
+{
+    return impl->event.wait(timeout);
+}
+
+void CompletionQueue::GetCallback::getDone(const GetEvent& evt)
+{
+    queue.impl->push(new EventNode<ClientChannel::GetCallback, GetEvent,
+                                   &ClientChannel::GetCallback::getDone>(target, evt));
+}
+
+void CompletionQueue::PutCallback::putBuild(const epics::pvData::StructureConstPtr& build, Args& args)
+{
+    target->putBuild(build, args);
+}
+
+void CompletionQueue::PutCallback::putDone(const PutEvent& evt)
+{
+    queue.impl->push(new EventNode<ClientChannel::PutCallback, PutEvent,
+                                   &ClientChannel::PutCallback::putDone>(target, evt));
+}
+
+void CompletionQueue::MonitorCallback::monitorEvent(const MonitorEvent& evt)
+{
+    queue.impl->push(new EventNode<ClientChannel::MonitorCallback, MonitorEvent,
+                                   &ClientChannel::MonitorCallback::monitorEvent>(target, evt));
+}
+
+void CompletionQueue::ConnectCallback::connectEvent(const ConnectEvent& evt)
+{
+    queue.impl->push(new EventNode<ClientChannel::ConnectCallback, ConnectEvent,
+                                   &ClientChannel::ConnectCallback::connectEvent>(target, evt));
+}
+
+} // namespace pvac
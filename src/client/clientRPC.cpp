@@ -14,6 +14,7 @@
 #include "pv/logger.h"
 #include "clientpvt.h"
 #include "pv/pvAccess.h"
+#include "pv/tracing.h"
 
 namespace pvd = epics::pvData;
 namespace pva = epics::pvAccess;
@@ -36,11 +37,18 @@ struct RPCer : public pva::ChannelRPCRequester,
 
     pvd::PVStructure::const_shared_pointer args;
 
+    // trace context of the thread which started this operation, if any
+    pva::TraceContext trace;
+
     static size_t num_instances;
 
     RPCer(pvac::ClientChannel::GetCallback* cb,
           const pvd::PVStructure::const_shared_pointer& args) :started(false), cb(cb), args(args)
-      {REFTRACE_INCREMENT(num_instances);}
+    {
+        REFTRACE_INCREMENT(num_instances);
+        if(const pva::TraceContext *cur = pva::TraceScope::current())
+            trace = *cur;
+    }
     virtual ~RPCer() {REFTRACE_DECREMENT(num_instances);}
 
     void callEvent(Guard& G, pvac::GetEvent::event_t evt = pvac::GetEvent::Fail)
@@ -112,6 +120,7 @@ struct RPCer : public pva::ChannelRPCRequester,
             callEvent(G);
 
         } else {
+            pva::TraceScope scope(trace.valid() ? &trace : 0);
             operation->request(std::tr1::const_pointer_cast<pvd::PVStructure>(args));
             started = true;
         }
@@ -171,6 +180,10 @@ ClientChannel::rpc(GetCallback* cb,
     if(!pvRequest)
         pvRequest = pvd::createRequest("field()");
 
+    std::tr1::shared_ptr<detail::DispatchAdapter> adapter(detail::CallbackDispatcher::adapt(getDispatcher(), impl.get(), cb));
+    if(adapter)
+        cb = adapter.get();
+
     std::tr1::shared_ptr<RPCer> ret(RPCer::build(cb, arguments));
 
     {
@@ -179,7 +192,7 @@ ClientChannel::rpc(GetCallback* cb,
                                                  std::tr1::const_pointer_cast<pvd::PVStructure>(pvRequest));
     }
 
-    return Operation(ret);
+    return detail::CallbackDispatcher::wrap(Operation(ret), adapter);
 }
 
 namespace detail {
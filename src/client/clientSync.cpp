@@ -3,18 +3,23 @@
  * found in the file LICENSE that is included with the distribution
  */
 
+#include <map>
+#include <vector>
+
 #include <epicsMutex.h>
 #include <epicsGuard.h>
 #include <epicsEvent.h>
+#include <epicsTime.h>
 
 #include <pv/current_function.h>
 #include <pv/pvData.h>
 #include <pv/bitSet.h>
 #include <pv/epicsException.h>
+#include <pv/reftrack.h>
 
 #define epicsExportSharedSymbols
 #include "pv/logger.h"
-#include "pva/client.h"
+#include "clientpvt.h"
 #include "pv/pvAccess.h"
 
 namespace pvd = epics::pvData;
@@ -43,6 +48,7 @@ struct WaitCommon
 };
 
 struct GetWait : public pvac::ClientChannel::GetCallback,
+                 public pvac::detail::Direct,
                  public WaitCommon
 {
     pvac::GetEvent result;
@@ -71,6 +77,10 @@ pvd::PVStructure::const_shared_pointer
 pvac::ClientChannel::get(double timeout,
                        pvd::PVStructure::const_shared_pointer pvRequest)
 {
+    pvd::PVStructure::const_shared_pointer cached;
+    if(!pvRequest && getCached(cached))
+        return cached;
+
     GetWait waiter;
     {
         Operation op(get(&waiter, pvRequest));
@@ -112,6 +122,7 @@ pvac::ClientChannel::rpc(double timeout,
 
 namespace {
 struct PutValCommon : public pvac::ClientChannel::PutCallback,
+                      public pvac::detail::Direct,
                       public WaitCommon
 {
     pvac::PutEvent result;
@@ -134,11 +145,58 @@ struct PutValCommon : public pvac::ClientChannel::PutCallback,
     }
 };
 
+/* The field of root to which a value named, of kind scalar or scalarArray, is assigned.
+ * Within a union, selects, or sets, a member of type.
+ * @returns NULL if root has no such field, or the field, with the offset of the field named
+ */
+pvd::PVField* assignTarget(pvd::PVStructure& root, const std::string& name,
+                           pvd::Type kind, pvd::ScalarType type, size_t& offset)
+{
+    pvd::PVFieldPtr fld(root.getSubField(name));
+    if(!fld)
+        return 0;
+    offset = fld->getFieldOffset();
+
+    const pvd::FieldConstPtr& ftype(fld->getField());
+    if(ftype->getType()==pvd::union_) {
+        const pvd::Union *utype = static_cast<const pvd::Union*>(ftype.get());
+        pvd::PVUnion *ufld = static_cast<pvd::PVUnion*>(fld.get());
+
+        if(utype->isVariant()) {
+            pvd::PVDataCreatePtr create(pvd::getPVDataCreate());
+            pvd::PVFieldPtr member;
+            if(kind==pvd::scalar)
+                member = create->createPVScalar(type);
+            else
+                member = create->createPVScalarArray(type);
+            // kept by the union
+            ufld->set(member);
+            return member.get();
+
+        } else {
+            // attempt automagic assignment to descriminating union
+            pvd::int32 idx = utype->guess(kind, type);
+
+            if(idx==-1)
+                throw std::runtime_error(std::string("Unable to descriminate union field ")+name);
+
+            return ufld->select(idx).get();
+        }
+
+    } else if(ftype->getType()==kind) {
+        return fld.get();
+
+    } else {
+        throw std::runtime_error(std::string("Type mis-match assigning scalar to field ")+name);
+    }
+}
+
 } //namespace
 
 namespace detail {
 
 struct PutBuilder::Exec : public pvac::ClientChannel::PutCallback,
+                          public pvac::detail::Direct,
                           public WaitCommon
 {
     detail::PutBuilder& builder;
@@ -151,8 +209,7 @@ struct PutBuilder::Exec : public pvac::ClientChannel::PutCallback,
 
     virtual void putBuild(const epics::pvData::StructureConstPtr& build, Args& args) OVERRIDE FINAL
     {
-        pvd::PVDataCreatePtr create(pvd::getPVDataCreate());
-        pvd::PVStructurePtr root(create->createPVStructure(build));
+        pvd::PVStructurePtr root(pvd::getPVDataCreate()->createPVStructure(build));
 
         for(PutBuilder::scalars_t::const_iterator it = builder.scalars.begin(), end = builder.scalars.end();
             it!=end; ++it)
@@ -160,42 +217,15 @@ struct PutBuilder::Exec : public pvac::ClientChannel::PutCallback,
             if(it->value.empty())
                 continue;
 
-            pvd::PVFieldPtr fld(root->getSubField(it->name));
+            size_t offset = 0u;
+            pvd::PVField *fld = assignTarget(*root, it->name, pvd::scalar, it->value.type(), offset);
             if(!fld && it->required)
                 throw std::runtime_error(std::string("Server does not have required field ")+it->name);
             else if(!fld)
                 continue; // !it->required
 
-            const pvd::FieldConstPtr& ftype(fld->getField());
-            if(ftype->getType()==pvd::union_) {
-                const pvd::Union *utype = static_cast<const pvd::Union*>(ftype.get());
-                pvd::PVUnion *ufld = static_cast<pvd::PVUnion*>(fld.get());
-
-                if(utype->isVariant()) {
-                    pvd::PVScalarPtr scalar(create->createPVScalar(it->value.type()));
-
-                    scalar->putFrom(it->value);
-                    ufld->set(scalar);
-
-                } else {
-                    // attempt automagic assignment to descriminating union
-                    pvd::int32 idx = utype->guess(pvd::scalar, it->value.type());
-
-                    if(idx==-1)
-                        throw std::runtime_error(std::string("Unable to descriminate union field ")+it->name);
-
-                    ufld->select<pvd::PVScalar>(idx)->putFrom(it->value);
-                }
-
-            } else if(ftype->getType()==pvd::scalar) {
-                static_cast<pvd::PVScalar*>(fld.get())->putFrom(it->value);
-
-            } else {
-                throw std::runtime_error(std::string("Type mis-match assigning scalar to field ")+it->name);
-
-            }
-
-            args.tosend.set(fld->getFieldOffset());
+            static_cast<pvd::PVScalar*>(fld)->putFrom(it->value);
+            args.tosend.set(offset);
         }
 
         for(PutBuilder::arrays_t::const_iterator it = builder.arrays.begin(), end = builder.arrays.end();
@@ -204,43 +234,15 @@ struct PutBuilder::Exec : public pvac::ClientChannel::PutCallback,
             if(it->value.empty())
                 continue;
 
-            pvd::PVFieldPtr fld(root->getSubField(it->name));
+            size_t offset = 0u;
+            pvd::PVField *fld = assignTarget(*root, it->name, pvd::scalarArray, it->value.original_type(), offset);
             if(!fld && it->required)
                 throw std::runtime_error(std::string("Server does not have required field ")+it->name);
             else if(!fld)
                 continue; // !it->required
 
-            const pvd::FieldConstPtr& ftype(fld->getField());
-            if(ftype->getType()==pvd::union_) {
-                const pvd::Union *utype = static_cast<const pvd::Union*>(ftype.get());
-                pvd::PVUnion *ufld = static_cast<pvd::PVUnion*>(fld.get());
-
-                if(utype->isVariant()) {
-                    pvd::PVScalarArrayPtr scalar(create->createPVScalarArray(it->value.original_type()));
-
-                    scalar->putFrom(it->value);
-                    ufld->set(scalar);
-
-                } else {
-                    // attempt automagic assignment to descriminating union
-                    pvd::int32 idx = utype->guess(pvd::scalarArray, it->value.original_type());
-
-                    if(idx==-1)
-                        throw std::runtime_error(std::string("Unable to descriminate union field ")+it->name);
-
-                    ufld->select<pvd::PVScalarArray>(idx)->putFrom(it->value);
-                }
-
-            } else if(ftype->getType()==pvd::scalarArray) {
-                static_cast<pvd::PVScalarArray*>(fld.get())->putFrom(it->value);
-
-                // TODO
-            } else {
-                throw std::runtime_error(std::string("Type mis-match assigning scalar to field ")+it->name);
-
-            }
-
-            args.tosend.set(fld->getFieldOffset());
+            static_cast<pvd::PVScalarArray*>(fld)->putFrom(it->value);
+            args.tosend.set(offset);
         }
 
         args.root = root;
@@ -279,7 +281,298 @@ void PutBuilder::exec(double timeout)
 
 } // namespace detail
 
-struct MonitorSync::SImpl : public ClientChannel::MonitorCallback
+struct PreparedPut::Impl : public pva::ChannelPutRequester,
+                           public pvac::detail::wrapped_shared_from_this<PreparedPut::Impl>
+{
+    // a value set, and where it goes in root
+    struct Slot {
+        std::string name;
+        bool required, array;
+        pvd::AnyScalar scalar;
+        pvd::shared_vector<const void> vector;
+        // in root.  NULL if not found, or not yet assigned
+        pvd::PVField *target;
+        size_t offset;
+        Slot(const std::string& name, bool required, bool array)
+            :name(name), required(required), array(array), target(0), offset(0u)
+        {}
+    };
+
+    mutable epicsMutex mutex;
+    // each exec() in turn
+    epicsMutex serialize;
+    epicsEvent event;
+
+    operation_type::shared_pointer op;
+    bool connected, busy, done;
+    pvd::Status status;
+
+    std::vector<Slot> slots;
+    typedef std::map<std::string, size_t> index_t;
+    index_t index;
+
+    // of the operation, from channelPutConnect()
+    pvd::StructureConstPtr structure;
+    // built for structure by plan(), reused by each exec().  NULL to plan again
+    pvd::PVStructurePtr root;
+    pvd::BitSet::shared_pointer tosend;
+
+    static size_t num_instances;
+
+    Impl() :connected(false), busy(false), done(false)
+    {REFTRACE_INCREMENT(num_instances);}
+    virtual ~Impl() {REFTRACE_DECREMENT(num_instances);}
+
+    Slot& slot(const std::string& name, bool array)
+    {
+        index_t::const_iterator it(index.find(name));
+        if(it==index.end() || slots[it->second].array!=array)
+            throw std::logic_error(std::string("Field not given to PutBuilder: ")+name);
+        return slots[it->second];
+    }
+
+    void add(const std::string& name, bool required, bool array)
+    {
+        // a later set() of the same name replaces the value
+        index_t::const_iterator it(index.find(name));
+        if(it==index.end()) {
+            index[name] = slots.size();
+            slots.push_back(Slot(name, required, array));
+        }
+    }
+
+    // find the fields of each slot in a new root.  Called with mutex locked
+    void plan()
+    {
+        pvd::PVStructurePtr next(pvd::getPVDataCreate()->createPVStructure(structure));
+        pvd::BitSet::shared_pointer bits(new pvd::BitSet(next->getNumberFields()));
+
+        for(size_t i=0; i<slots.size(); i++) {
+            Slot& S = slots[i];
+            S.target = 0;
+            if(S.array ? S.vector.empty() : S.scalar.empty())
+                continue; // assigned once set()
+
+            S.target = S.array
+                    ? assignTarget(*next, S.name, pvd::scalarArray, S.vector.original_type(), S.offset)
+                    : assignTarget(*next, S.name, pvd::scalar, S.scalar.type(), S.offset);
+            if(!S.target && S.required)
+                throw std::runtime_error(std::string("Server does not have required field ")+S.name);
+            else if(S.target)
+                bits->set(S.offset);
+        }
+
+        root = next;
+        tosend = bits;
+    }
+
+    // called automatically via wrapped_shared_from_this
+    void cancel()
+    {
+        operation_type::shared_pointer temp;
+        {
+            Guard G(mutex);
+            temp.swap(op);
+            connected = false;
+            if(busy) {
+                done = true;
+                status = pvd::Status::error("Cancelled");
+            }
+        }
+        event.signal();
+        if(temp)
+            temp->destroy();
+    }
+
+    virtual std::string getRequesterName() OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        return op ? op->getChannel()->getRequesterName() : "<dead>";
+    }
+
+    virtual void channelPutConnect(
+        const epics::pvData::Status& status,
+        pva::ChannelPut::shared_pointer const & channelPut,
+        epics::pvData::Structure::const_shared_pointer const & structure) OVERRIDE FINAL
+    {
+        {
+            Guard G(mutex);
+            connected = status.isSuccess();
+            this->status = status;
+            if(connected && (!this->structure || *this->structure!=*structure)) {
+                // eg. after the server restarted with a different type
+                this->structure = structure;
+                root.reset();
+            }
+        }
+        event.signal();
+    }
+
+    virtual void channelDisconnect(bool destroy) OVERRIDE FINAL
+    {
+        {
+            Guard G(mutex);
+            connected = false;
+            if(busy) {
+                done = true;
+                status = pvd::Status::error("Disconnect");
+            }
+        }
+        event.signal();
+    }
+
+    virtual void putDone(
+        const epics::pvData::Status& status,
+        pva::ChannelPut::shared_pointer const & channelPut) OVERRIDE FINAL
+    {
+        {
+            Guard G(mutex);
+            if(!busy || done) return;
+            done = true;
+            this->status = status;
+        }
+        event.signal();
+    }
+
+    virtual void getDone(
+        const epics::pvData::Status& status,
+        pva::ChannelPut::shared_pointer const & channelPut,
+        epics::pvData::PVStructure::shared_pointer const & pvStructure,
+        epics::pvData::BitSet::shared_pointer const & bitSet) OVERRIDE FINAL
+    {}
+};
+
+size_t PreparedPut::Impl::num_instances;
+
+PreparedPut::~PreparedPut() {}
+
+PreparedPut& PreparedPut::set(const std::string& name, const pvd::AnyScalar& value)
+{
+    if(!impl) throw std::logic_error("No PreparedPut");
+    Guard G(impl->mutex);
+    Impl::Slot& S = impl->slot(name, false);
+    // a field is assigned once it has a value, and a variant union member keeps its type
+    if(!S.target || value.empty())
+        impl->root.reset();
+    S.scalar = value;
+    return *this;
+}
+
+PreparedPut& PreparedPut::set(const std::string& name, const pvd::shared_vector<const void>& value)
+{
+    if(!impl) throw std::logic_error("No PreparedPut");
+    Guard G(impl->mutex);
+    Impl::Slot& S = impl->slot(name, true);
+    if(!S.target || value.empty())
+        impl->root.reset();
+    S.vector = value;
+    return *this;
+}
+
+void PreparedPut::exec(double timeout)
+{
+    if(!impl) throw std::logic_error("No PreparedPut");
+
+    Guard S(impl->serialize);
+
+    const epicsTime deadline(epicsTime::getCurrent() + timeout);
+
+    Guard G(impl->mutex);
+
+    while(!impl->connected) {
+        if(!impl->op)
+            throw std::logic_error("PreparedPut cancelled");
+        const double remaining = deadline - epicsTime::getCurrent();
+        UnGuard U(G);
+        if(remaining<=0.0 || !impl->event.wait(remaining))
+            throw Timeout();
+    }
+
+    if(!impl->root)
+        impl->plan();
+
+    // only conversion of the values
+    for(size_t i=0; i<impl->slots.size(); i++) {
+        const Impl::Slot& slot = impl->slots[i];
+        if(!slot.target)
+            continue;
+        if(slot.array)
+            static_cast<pvd::PVScalarArray*>(slot.target)->putFrom(slot.vector);
+        else
+            static_cast<pvd::PVScalar*>(slot.target)->putFrom(slot.scalar);
+    }
+
+    pva::ChannelPut::shared_pointer op(impl->op);
+    pvd::PVStructurePtr root(impl->root);
+    pvd::BitSet::shared_pointer tosend(impl->tosend);
+    impl->busy = true;
+    impl->done = false;
+    {
+        UnGuard U(G);
+        // copied, or sent, before putDone()
+        op->put(root, tosend);
+    }
+
+    while(!impl->done) {
+        const double remaining = deadline - epicsTime::getCurrent();
+        bool ok;
+        {
+            UnGuard U(G);
+            ok = remaining>0.0 && impl->event.wait(remaining);
+        }
+        if(!ok && !impl->done) {
+            impl->busy = false;
+            UnGuard U(G);
+            op->cancel();
+            throw Timeout();
+        }
+    }
+    impl->busy = false;
+
+    if(!impl->status.isSuccess())
+        throw std::runtime_error(impl->status.getMessage());
+}
+
+void PreparedPut::cancel()
+{
+    if(impl) impl->cancel();
+}
+
+namespace detail {
+
+PreparedPut PutBuilder::prepare()
+{
+    std::tr1::shared_ptr<PreparedPut::Impl> ret(PreparedPut::Impl::build());
+
+    for(scalars_t::const_iterator it = scalars.begin(), end = scalars.end(); it!=end; ++it) {
+        ret->add(it->name, it->required, false);
+        ret->slot(it->name, false).scalar = it->value;
+    }
+    for(arrays_t::const_iterator it = arrays.begin(), end = arrays.end(); it!=end; ++it) {
+        ret->add(it->name, it->required, true);
+        ret->slot(it->name, true).vector = it->value;
+    }
+
+    pvd::PVStructure::const_shared_pointer req(request ? request : pvd::createRequest("field()"));
+    std::tr1::shared_ptr<pva::Channel> chan(channel.getChannel());
+    {
+        Guard G(ret->mutex);
+        ret->op = chan->createChannelPut(ret->internal_shared_from_this(),
+                                         std::tr1::const_pointer_cast<pvd::PVStructure>(req));
+    }
+
+    return PreparedPut(ret);
+}
+
+void registerRefTrackPut()
+{
+    epics::registerRefCounter("pvac::PreparedPut", &PreparedPut::Impl::num_instances);
+}
+
+} // namespace detail
+
+struct MonitorSync::SImpl : public ClientChannel::MonitorCallback,
+                           public pvac::detail::Direct
 {
     const bool ourevent;
     epicsEvent * const event;
@@ -363,6 +656,31 @@ bool MonitorSync::wait(double timeout)
     return ret;
 }
 
+size_t MonitorSync::waitBatch(std::vector<MonitorUpdate>& out, size_t count, double timeout)
+{
+    if(!simpl) throw std::logic_error("No subscription");
+
+    const epicsTime deadline(epicsTime::getCurrent() + timeout);
+
+    size_t n = pollInto(out, 0u, count);
+    while(n<count) {
+        const double remaining = deadline - epicsTime::getCurrent();
+        if(remaining<=0.0 || !simpl->event->wait(remaining))
+            break; // timeout
+        {
+            Guard G(simpl->mutex);
+            event = simpl->last;
+            simpl->last.event = MonitorEvent::Fail;
+            const bool had = simpl->hadevent;
+            simpl->hadevent = false;
+            if(!had || event.event!=MonitorEvent::Data)
+                break; // wake(), or end of subscription
+        }
+        n += pollInto(out, n, count-n);
+    }
+    return n;
+}
+
 void MonitorSync::wake() {
     if(simpl) simpl->event->signal();
 }
@@ -376,5 +694,145 @@ ClientChannel::monitor(const epics::pvData::PVStructure::const_shared_pointer &p
     return MonitorSync(mon, simpl);
 }
 
+struct MonitorSet::Impl
+{
+    struct Member : public ClientChannel::MonitorCallback,
+                    public pvac::detail::Direct
+    {
+        Impl * const set;
+        Monitor mon;
+        // set once mon is assigned.  Until then events are only noted.
+        bool attached;
+        bool queued;
+        MonitorEvent pending;
+
+        explicit Member(Impl *set) :set(set), attached(false), queued(false) {}
+        virtual ~Member() {}
+
+        virtual void monitorEvent(const MonitorEvent& evt) OVERRIDE FINAL
+        {
+            bool wakeup = false;
+            {
+                Guard G(set->mutex);
+                if(!queued || evt.event==MonitorEvent::Fail || evt.event==MonitorEvent::Cancel
+                        || (pending.event!=MonitorEvent::Fail && pending.event!=MonitorEvent::Cancel))
+                    pending = evt;
+                if(!queued) {
+                    queued = true;
+                    if(attached) {
+                        wakeup = set->queue.empty();
+                        set->queue.push_back(this);
+                    }
+                }
+            }
+            if(wakeup)
+                set->event.signal();
+        }
+    };
+    typedef std::map<Member*, std::tr1::shared_ptr<Member> > members_t;
+
+    mutable epicsMutex mutex;
+    epicsEvent event;
+    members_t members;
+    // members with an event, in order
+    std::vector<Member*> queue;
+    bool woken;
+
+    Impl() :woken(false) {}
+    ~Impl()
+    {
+        members_t temp;
+        {
+            Guard G(mutex);
+            temp.swap(members);
+            queue.clear();
+        }
+        // Cancel callbacks come back, before the members go away
+        for(members_t::iterator it(temp.begin()), end(temp.end()); it!=end; ++it)
+            it->second->mon.cancel();
+    }
+
+    // call with mutex held
+    void take(std::vector<Ready>& ready)
+    {
+        ready.resize(queue.size());
+        for(size_t i=0; i<queue.size(); i++) {
+            Member *M = queue[i];
+            M->queued = false;
+            ready[i].mon = M->mon;
+            ready[i].event = M->pending;
+            if(M->pending.event==MonitorEvent::Fail || M->pending.event==MonitorEvent::Cancel)
+                members.erase(M); // no more events
+        }
+        queue.clear();
+    }
+};
+
+MonitorSet::MonitorSet() :impl(new Impl) {}
+
+MonitorSet::~MonitorSet() {}
+
+Monitor MonitorSet::add(ClientChannel& chan,
+                        const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
+{
+    std::tr1::shared_ptr<Impl::Member> M(new Impl::Member(impl.get()));
+    // not under our lock, as callbacks may come from within
+    Monitor mon(chan.monitor(M.get(), pvRequest));
+
+    bool wakeup = false;
+    {
+        Guard G(impl->mutex);
+        M->mon = mon;
+        M->attached = true;
+        impl->members[M.get()] = M;
+        if(M->queued) {
+            // an event came before mon was known
+            wakeup = impl->queue.empty();
+            impl->queue.push_back(M.get());
+        }
+    }
+    if(wakeup)
+        impl->event.signal();
+    return mon;
+}
+
+size_t MonitorSet::size() const
+{
+    Guard G(impl->mutex);
+    return impl->members.size();
+}
+
+bool MonitorSet::wait(std::vector<Ready>& ready, double timeout)
+{
+    Guard G(impl->mutex);
+    while(impl->queue.empty() && !impl->woken) {
+        UnGuard U(G);
+        if(!impl->event.wait(timeout)) {
+            ready.clear();
+            return false;
+        }
+    }
+    const bool woken = impl->woken;
+    impl->woken = false;
+    impl->take(ready);
+    return !woken || !ready.empty();
+}
+
+bool MonitorSet::test(std::vector<Ready>& ready)
+{
+    Guard G(impl->mutex);
+    impl->take(ready);
+    return !ready.empty();
+}
+
+void MonitorSet::wake()
+{
+    {
+        Guard G(impl->mutex);
+        impl->woken = true;
+    }
+    impl->event.signal();
+}
+
 
 }//namespace pvac
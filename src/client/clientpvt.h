@@ -1,7 +1,11 @@
 #ifndef CLIENTPVT_H
 #define CLIENTPVT_H
 
+#include <deque>
+#include <vector>
+
 #include <pv/sharedPtr.h>
+#include <pv/metrics.h>
 
 #include <pva/client.h>
 
@@ -65,10 +69,102 @@ public:
     }
 };
 
+/* Marks the callbacks of this library itself, eg. that of blocking get(), which
+ * only signal a waiting thread.  These are always called directly, so may be waited
+ * for from a callback run by a CallbackDispatcher.
+ */
+struct Direct {
+    virtual ~Direct() {}
+};
+
+struct DispatchAdapter;
+
+/* Runs application callbacks on a pool of threads (EPICS_PVA_CALLBACK_THREADS), instead of
+ * the PVA threads which receive their events, so that slow callbacks do not hold up the
+ * reading of a connection shared by other channels.  The callbacks of the operations of one
+ * channel are run by one thread, in the order queued.
+ */
+struct CallbackDispatcher : public epics::pvAccess::MetricsSource
+{
+    POINTER_DEFINITIONS(CallbackDispatcher);
+
+    struct Work {
+        virtual ~Work() {}
+        virtual void run() =0;
+    };
+
+    explicit CallbackDispatcher(unsigned nthreads);
+    virtual ~CallbackDispatcher();
+
+    //! Queue work, which is then owned, to run after that already queued for key
+    void dispatch(const void *key, Work *work);
+    //! Wait for the work already queued for key to have run.  Does not wait when called by a worker.
+    void sync(const void *key);
+    //! Is the calling thread a worker
+    bool isWorker() const;
+
+    //! Adapters to queue the events of cb, of the channel key, or NULL if cb is Direct
+    static std::tr1::shared_ptr<DispatchAdapter> adapt(const shared_pointer& self, const void *key,
+                                                       ClientChannel::GetCallback *cb);
+    static std::tr1::shared_ptr<DispatchAdapter> adapt(const shared_pointer& self, const void *key,
+                                                       ClientChannel::PutCallback *cb);
+    static std::tr1::shared_ptr<DispatchAdapter> adapt(const shared_pointer& self, const void *key,
+                                                       ClientChannel::MonitorCallback *cb);
+    //! An Operation whose cancel() also waits for the events of adapter already queued
+    static Operation wrap(const Operation& op, const std::tr1::shared_ptr<DispatchAdapter>& adapter);
+
+    //! Callbacks queued, not yet run
+    size_t depth() const;
+
+    virtual void collectMetrics(epics::pvAccess::Metrics& M) OVERRIDE FINAL;
+
+private:
+    struct Worker;
+    std::vector<Worker*> workers;
+    epics::pvAccess::MetricCounter dispatched;
+
+    Worker& workerOf(const void *key) const;
+
+    CallbackDispatcher(const CallbackDispatcher&);
+    CallbackDispatcher& operator=(const CallbackDispatcher&);
+};
+
+// Base of the adapters which queue the events of an application callback
+struct DispatchAdapter : public Direct,
+                         public std::tr1::enable_shared_from_this<DispatchAdapter>,
+                         public ClientChannel::GetCallback,
+                         public ClientChannel::PutCallback,
+                         public ClientChannel::MonitorCallback
+{
+    const CallbackDispatcher::shared_pointer dispatcher;
+    const void * const key;
+    ClientChannel::GetCallback * const getcb;
+    ClientChannel::PutCallback * const putcb;
+    ClientChannel::MonitorCallback * const moncb;
+    // a MonitorEvent::Data is queued, and not yet run.  Others are not queued meanwhile
+    int dataQueued;
+
+    DispatchAdapter(const CallbackDispatcher::shared_pointer& dispatcher, const void *key,
+                    ClientChannel::GetCallback *getcb,
+                    ClientChannel::PutCallback *putcb,
+                    ClientChannel::MonitorCallback *moncb)
+        :dispatcher(dispatcher), key(key), getcb(getcb), putcb(putcb), moncb(moncb), dataQueued(0)
+    {}
+    virtual ~DispatchAdapter() {}
+
+    virtual void getDone(const GetEvent& evt) OVERRIDE FINAL;
+    //! called directly, as it returns what is put
+    virtual void putBuild(const epics::pvData::StructureConstPtr& build, Args& args) OVERRIDE FINAL;
+    virtual void putDone(const PutEvent& evt) OVERRIDE FINAL;
+    virtual void monitorEvent(const MonitorEvent& evt) OVERRIDE FINAL;
+};
+
 void registerRefTrack();
 void registerRefTrackGet();
 void registerRefTrackMonitor();
 void registerRefTrackRPC();
+void registerRefTrackPut();
+void registerRefTrackMany();
 
 }} // namespace pvac::detail
 
@@ -7,19 +7,65 @@
 #include <stdexcept>
 
 #include <epicsGuard.h>
+#include <epicsThread.h>
 #include <epicsMath.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_MONITOR_USE_ATOMIC
+#endif
+#endif
 
 #define epicsExportSharedSymbols
 #include <pv/monitor.h>
 #include <pv/pvAccess.h>
 #include <pv/reftrack.h>
 #include <pv/createRequest.h>
+#include <pv/pvaProbes.h>
+#include <pv/metrics.h>
+#include <pv/memoryUsage.h>
 
 namespace pvd = epics::pvData;
 
 typedef epicsGuard<epicsMutex> Guard;
 typedef epicsGuardRelease<epicsMutex> UnGuard;
 
+namespace {
+// written with the mutex held, and read without it by poll()
+inline void setFilled(size_t& nfilled, size_t n)
+{
+#ifdef PVA_MONITOR_USE_ATOMIC
+    epics::atomic::set(nfilled, n);
+#else
+    nfilled = n;
+#endif
+}
+
+// updates squashed into a full queue, by all MonitorFIFO of the process
+epics::pvAccess::MetricCounter fifoOverflows;
+
+struct FIFOMetrics : public epics::pvAccess::MetricsSource
+{
+    virtual void collectMetrics(epics::pvAccess::Metrics& M) OVERRIDE FINAL
+    {
+        M.family("pva_monitor_fifo_overflows_total", epics::pvAccess::Metrics::Counter,
+                 "Monitor updates squashed into a full queue");
+        M.add("pva_monitor_fifo_overflows_total", double(fifoOverflows.get()));
+    }
+};
+
+epicsThreadOnceId fifoMetricsOnce = EPICS_THREAD_ONCE_INIT;
+
+void fifoMetricsInit(void*)
+{
+    // kept for the life of the process
+    static epics::pvAccess::MetricsSource::shared_pointer source(new FIFOMetrics);
+    epics::pvAccess::MetricsSource::add(source);
+}
+} // namespace
+
 namespace epics {namespace pvAccess {
 
 MonitorFIFO::Config::Config()
@@ -50,8 +96,10 @@ MonitorFIFO::MonitorFIFO(const std::tr1::shared_ptr<MonitorRequester> &requester
     ,needClosed(false)
     ,freeHighLevel(0u)
     ,flowCount(0)
+    ,nfilled(0u)
 {
     REFTRACE_INCREMENT(num_instances);
+    epicsThreadOnce(&fifoMetricsOnce, &fifoMetricsInit, 0);
 
     if(conf.maxCount==0)
         conf.maxCount = 1;
@@ -73,6 +121,18 @@ MonitorFIFO::MonitorFIFO(const std::tr1::shared_ptr<MonitorRequester> &requester
     if(conf.actualCount==0)
         conf.actualCount = conf.defCount;
 
+    // room for a pipeline window which the client may grow from queueSize
+    O = pvRequest->getSubField<pvd::PVScalar>("record._options.maxQueueSize");
+    if(O) {
+        try {
+            conf.actualCount = std::max(conf.actualCount, size_t(O->getAs<pvd::uint32>()));
+        } catch(std::exception& e) {
+            std::ostringstream strm;
+            strm<<"invalid maxQueueSize : "<<e.what();
+            requester->message(strm.str());
+        }
+    }
+
     if(conf.actualCount > conf.maxCount)
         conf.actualCount = conf.maxCount;
 
@@ -145,6 +205,14 @@ void MonitorFIFO::open(const pvd::StructureConstPtr& type)
         empty.clear();
         inuse.clear();
         returned.clear();
+        spare.clear();
+        setFilled(nfilled, 0u);
+
+        empty.reserve(conf.actualCount+1);
+        inuse.reserve(conf.actualCount+1);
+        // only used with pipeline, which most monitors aren't
+        if(pipeline)
+            returned.reserve(conf.actualCount+1);
 
         // fill up empty.
         pvd::PVDataCreatePtr create(pvd::getPVDataCreate());
@@ -158,14 +226,16 @@ void MonitorFIFO::open(const pvd::StructureConstPtr& type)
         this->type = type;
 
         if(conf.ignoreRequestMask) {
-            selectMask.clear();
+            pvd::BitSet selected;
             for(size_t i=0, N=empty.back()->pvStructurePtr->getNextFieldOffset(); i<N; i++)
-                selectMask.set(i);
+                selected.set(i);
+            selectMask.reset(selected, *empty.back()->pvStructurePtr);
         } else {
-            selectMask = pvData::extractRequestMask(empty.back()->pvStructurePtr,
-                                                    pvRequest->getSubField<pvData::PVStructure>("field"));
+            // shared with other subscriptions alike
+            selectMask.reset(empty.back()->pvStructurePtr,
+                             pvRequest->getSubField<pvData::PVStructure>("field"));
         }
-        emptyselect = selectMask.isEmpty();
+        emptyselect = selectMask.empty();
 
         assert(inuse.empty());
         assert(empty.size()>=2);
@@ -215,8 +285,7 @@ bool MonitorFIFO::tryPost(const pvData::PVStructure& value,
     assert(!empty.empty() || !inuse.empty());
 
     // compute effective changed mask for this subscription
-    scratch = changed;
-    scratch &= selectMask;
+    selectMask.select(scratch, changed);
 
     const bool havefree = _freeCount()>0u;
 
@@ -227,6 +296,10 @@ bool MonitorFIFO::tryPost(const pvData::PVStructure& value,
         // take an empty element
         elem = empty.front();
         empty.pop_front();
+    } else if(force && !spare.empty()) {
+        // re-use an extra element
+        elem = spare.front();
+        spare.pop_front();
     } else if(force) {
         // allocate an extra element
         elem.reset(new MonitorElement(pvd::getPVDataCreate()->createPVStructure(type)));
@@ -235,14 +308,16 @@ bool MonitorFIFO::tryPost(const pvData::PVStructure& value,
     if(elem) {
         try {
             assert(value.getStructure() == elem->pvStructurePtr->getStructure());
+            elem->unshare();
             elem->pvStructurePtr->copyUnchecked(value, scratch);
             *elem->changedBitSet = scratch;
             *elem->overrunBitSet = overrun;
-            *elem->overrunBitSet &= selectMask;
+            *elem->overrunBitSet &= selectMask.mask();
 
             if(inuse.empty() && running)
                 needEvent = true;
             inuse.push_back(elem);
+            setFilled(nfilled, inuse.size());
         }catch(...){
             if(havefree) {
                 empty.push_front(elem);
@@ -259,7 +334,8 @@ bool MonitorFIFO::tryPost(const pvData::PVStructure& value,
 
 void MonitorFIFO::post(const pvData::PVStructure& value,
                        const pvd::BitSet& changed,
-                       const pvd::BitSet& overrun)
+                       const pvd::BitSet& overrun,
+                       const SharedUpdate::shared_pointer& shared)
 {
     Guard G(mutex);
 
@@ -284,24 +360,32 @@ void MonitorFIFO::post(const pvData::PVStructure& value,
         elem = inuse.back();
     }
 
-    scratch = changed;
-    scratch &= selectMask;
+    selectMask.select(scratch, changed);
 
     if(!conf.ignoreRequestMask && scratch.isEmpty())
         return; // drop empty update
 
     assert(value.getStructure() == elem->pvStructurePtr->getStructure());
-    elem->pvStructurePtr->copyUnchecked(value, scratch);
+    if(use_empty && shared && shared->getSnapshot()
+            && shared->getSnapshot()->getStructure()==elem->pvStructurePtr->getStructure()) {
+        // refer to the copy shared by all subscribers
+        elem->pvStructurePtr = shared->getSnapshot();
+    } else {
+        elem->unshare();
+        elem->pvStructurePtr->copyUnchecked(value, scratch);
+    }
 
     if(use_empty) {
         *elem->changedBitSet = scratch;
         *elem->overrunBitSet = overrun;
-        *elem->overrunBitSet &= selectMask;
+        *elem->overrunBitSet &= selectMask.mask();
+        elem->shared = shared;
 
         if(inuse.empty() && running)
             needEvent = true;
 
         inuse.push_back(elem);
+        setFilled(nfilled, inuse.size());
         empty.pop_front();
         if(pipeline)
             flowCount--;
@@ -309,12 +393,16 @@ void MonitorFIFO::post(const pvData::PVStructure& value,
     } else {
         // in overflow
         // squash
+        fifoOverflows.increment();
         elem->overrunBitSet->or_and(*elem->changedBitSet, scratch);
         *elem->changedBitSet |= scratch;
-        elem->overrunBitSet->or_and(overrun, selectMask);
+        elem->overrunBitSet->or_and(overrun, selectMask.mask());
+        // no longer the same as other subscribers.  unshare()d above
 
         // leave as inuse.back()
     }
+
+    PVA_PROBE3(monitor_post, this, inuse.size(), int(!use_empty));
 }
 
 void MonitorFIFO::notify()
@@ -398,12 +486,20 @@ MonitorElementPtr MonitorFIFO::poll()
     Monitor::shared_pointer self;
     MonitorRequester::shared_pointer req;
 
+#ifdef PVA_MONITOR_USE_ATOMIC
+    // A consumer polls until the queue is empty, so the last poll() usually finds nothing.
+    // Skip the lock for it.  A post() racing with this check, into an empty queue,
+    // is followed by monitorEvent().
+    if(epics::atomic::get(nfilled)==0u)
+        return ret;
+#endif
+
     {
         Guard G(mutex);
 
         if(!inuse.empty() && inuse.size() + empty.size() > 1) {
-            ret = inuse.front();
-            inuse.pop_front();
+            inuse.pop_front(ret);
+            setFilled(nfilled, inuse.size());
             if(inuse.empty() && finished) {
                 self = shared_from_this();
                 req = requester.lock();
@@ -411,6 +507,8 @@ MonitorElementPtr MonitorFIFO::poll()
         }
 
         assert(!inuse.empty() || !empty.empty());
+
+        PVA_PROBE3(monitor_poll, this, ret.get(), inuse.size());
     }
 
     if(req) {
@@ -423,36 +521,51 @@ MonitorElementPtr MonitorFIFO::poll()
 void MonitorFIFO::release(MonitorElementPtr const & elem)
 {
     size_t nempty;
+    bool high, resumed;
     {
         Guard G(mutex);
 
         assert(!inuse.empty() || !empty.empty());
 
+        // don't hold the serialized forms while idle
+        elem->shared.reset();
+
         const pvd::StructureConstPtr& type((!inuse.empty() ? inuse.front() : empty.back())->pvStructurePtr->getStructure());
 
-        if(elem->pvStructurePtr->getStructure() != type // return of old type
-                || empty.size()+returned.size()>=conf.actualCount+1) // return of force'd
+        if(elem->pvStructurePtr->getStructure() != type) // return of old type
             return; // ignore it
 
+        if(empty.size()+returned.size()>=conf.actualCount+1) { // return of force'd
+            // keep a few for the next tryPost(force)
+            if(spare.size()<conf.actualCount)
+                spare.push_back(elem);
+            return;
+        }
+
         if(pipeline) {
             // work done during reportRemoteQueueStatus()
             returned.push_back(elem);
             return;
         }
 
+        resumed = empty.empty();
         bool below = _freeCount() <= freeHighLevel;
 
         empty.push_front(elem);
 
         bool above = _freeCount() > freeHighLevel;
 
-        if(!below || !above || !upstream)
+        high = below && above;
+        if(!(high || resumed) || !upstream)
             return;
 
         nempty = _freeCount();
     }
 
-    upstream->freeHighMark(this, nempty);
+    if(resumed)
+        upstream->unsaturated(this);
+    if(high)
+        upstream->freeHighMark(this, nempty);
     notify();
 }
 
@@ -464,35 +577,74 @@ void MonitorFIFO::getStats(Stats& s) const
     s.noutstanding = conf.actualCount - s.nempty - s.nfilled;
 }
 
+namespace {
+// bytes of the elements of buf not referring to a shared snapshot.  Sets last to the size of one
+size_t elementBytes(const RingBuffer<MonitorElementPtr>& buf, size_t& last)
+{
+    size_t ret = 0u;
+    for(size_t i=0; i<buf.size(); i++) {
+        const MonitorElement& elem = *buf[i];
+        if(!elem.pvStructurePtr)
+            continue;
+        last = memoryUsage(*elem.pvStructurePtr);
+        if(!elem.shared || elem.shared->getSnapshot()!=elem.pvStructurePtr)
+            ret += last;
+    }
+    return ret;
+}
+} // namespace
+
+size_t MonitorFIFO::memoryUsage() const
+{
+    // walk the values with the mutex held, as post() copies into them
+    Guard G(mutex);
+    size_t each = 0u;
+    size_t ret = elementBytes(inuse, each)
+               + elementBytes(empty, each)
+               + elementBytes(returned, each)
+               + elementBytes(spare, each);
+    const size_t tracked = inuse.size() + empty.size() + returned.size();
+    if(conf.actualCount > tracked)
+        ret += (conf.actualCount - tracked)*each;
+    return ret;
+}
+
 void MonitorFIFO::reportRemoteQueueStatus(pvd::int32 nfree)
 {
     if(nfree<=0 || !pipeline)
         return; // paranoia
 
     size_t nempty;
+    bool high, resumed;
     {
         Guard G(mutex);
 
+        resumed = empty.empty();
         bool below = _freeCount() <= freeHighLevel;
 
         size_t nack = std::min(size_t(nfree), returned.size());
         flowCount += nfree;
 
-        buffer_t::iterator end(returned.begin());
-        std::advance(end, nack);
-
         // remove[0, nack) from returned and append to empty
-        empty.splice(empty.end(), returned, returned.begin(), end);
+        for(size_t i=0; i<nack; i++) {
+            empty.push_back(returned.front());
+            returned.pop_front();
+        }
 
         bool above = _freeCount() > freeHighLevel;
 
-        if(!below || !above || empty.size()<=1 || !upstream)
+        high = below && above && empty.size()>1;
+        resumed = resumed && !empty.empty();
+        if(!(high || resumed) || !upstream)
             return;
 
         nempty = _freeCount();
     }
 
-    upstream->freeHighMark(this, nempty);
+    if(resumed)
+        upstream->unsaturated(this);
+    if(high)
+        upstream->freeHighMark(this, nempty);
     notify();
 }
 
@@ -502,6 +654,13 @@ size_t MonitorFIFO::freeCount() const
     return _freeCount();
 }
 
+bool MonitorFIFO::saturated() const
+{
+    Guard G(mutex);
+    // post() would squash
+    return opened && empty.empty();
+}
+
 // caller must hold lock
 size_t MonitorFIFO::_freeCount() const
 {
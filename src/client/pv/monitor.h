@@ -10,6 +10,7 @@
 #define MONITOR_H
 
 #include <list>
+#include <vector>
 #include <ostream>
 
 #ifdef epicsExportSharedSymbols
@@ -30,6 +31,8 @@
 
 #include <pv/requester.h>
 #include <pv/destroyable.h>
+#include <pv/requestMask.h>
+#include <pv/ringBuffer.h>
 
 #include <shareLib.h>
 
@@ -44,6 +47,54 @@ class Monitor;
 typedef std::tr1::shared_ptr<Monitor> MonitorPtr;
 
 
+/**
+ * @brief Serialized forms of one update, shared by the elements of each subscriber which receives it.
+ *
+ * Created by a provider which post()s one update to many MonitorFIFO, eg. pvas::SharedPV.
+ * A server then serializes each form once (type, masks, and byte order) and sends the same bytes
+ * to every subscriber.
+ */
+class epicsShareClass SharedUpdate {
+public:
+    POINTER_DEFINITIONS(SharedUpdate);
+    typedef std::vector<char> bytes_t;
+
+    SharedUpdate();
+    /** @param snapshot A copy of the value posted, which is not modified afterwards.
+     *         MonitorFIFO::post() then refers elements to it, instead of copying into each.
+     */
+    explicit SharedUpdate(const epics::pvData::PVStructurePtr& snapshot);
+    ~SharedUpdate();
+
+    //! NULL unless constructed with a snapshot
+    const epics::pvData::PVStructurePtr& getSnapshot() const { return snapshot; }
+
+    //! Bytes stored for this form, or NULL
+    std::tr1::shared_ptr<const bytes_t> find(const epics::pvData::StructureConstPtr& type,
+                                             int byteOrder,
+                                             const epics::pvData::BitSet& changed,
+                                             const epics::pvData::BitSet& overrun) const;
+    //! Keeps the first bytes stored for a form
+    void store(const epics::pvData::StructureConstPtr& type,
+               int byteOrder,
+               const epics::pvData::BitSet& changed,
+               const epics::pvData::BitSet& overrun,
+               const std::tr1::shared_ptr<const bytes_t>& bytes);
+private:
+    struct entry {
+        epics::pvData::StructureConstPtr type;
+        int byteOrder;
+        epics::pvData::BitSet changed, overrun;
+        std::tr1::shared_ptr<const bytes_t> bytes;
+    };
+    const epics::pvData::PVStructurePtr snapshot;
+    mutable epicsMutex mutex;
+    std::vector<entry> entries;
+
+    SharedUpdate(const SharedUpdate&);
+    SharedUpdate& operator=(const SharedUpdate&);
+};
+
 /**
  * @brief An element for a monitorQueue.
  *
@@ -54,9 +105,23 @@ class epicsShareClass MonitorElement {
 public:
     POINTER_DEFINITIONS(MonitorElement);
     MonitorElement(epics::pvData::PVStructurePtr const & pvStructurePtr);
-    const epics::pvData::PVStructurePtr pvStructurePtr;
+    /** While shared is set, may be the SharedUpdate::getSnapshot() of other elements.
+     *  Call unshare() before modifying it.
+     */
+    epics::pvData::PVStructurePtr pvStructurePtr;
     const epics::pvData::BitSet::shared_pointer changedBitSet;
     const epics::pvData::BitSet::shared_pointer overrunBitSet;
+    /** Optional.  Set when the changed fields of pvStructurePtr, and both masks, are those of
+     *  an update posted to other subscribers with the same SharedUpdate.  NULL otherwise.
+     */
+    SharedUpdate::shared_pointer shared;
+
+    static size_t num_instances;
+
+    ~MonitorElement();
+
+    //! Clear shared, and give this element its own copy of pvStructurePtr if another refers to it.
+    void unshare();
 
     class Ref;
 };
@@ -269,6 +334,11 @@ public:
         //! from MonitorFIFO::setFreeHighMark().
         //! @param numEmpty The number of empty slots in the FIFO.
         virtual void freeHighMark(MonitorFIFO *mon, size_t numEmpty) {}
+        /** Called when the FIFO is no longer saturated().
+         *  A Source which skipped post()s while saturated should now post() the latest value,
+         *  with the fields changed since, to this FIFO.
+         */
+        virtual void unsaturated(MonitorFIFO *mon) {}
     };
     struct epicsShareClass Config {
         size_t maxCount,    //!< upper limit on requested FIFO size
@@ -317,12 +387,14 @@ public:
                  const epics::pvData::BitSet& overrun = epics::pvData::BitSet(),
                  bool force =false);
     //! Consume a free slot if available, otherwise squash with most recent
+    //! @param shared Passed with the same update to other MonitorFIFO.  See SharedUpdate.
     void post(const pvData::PVStructure& value,
               const epics::pvData::BitSet& changed,
-              const epics::pvData::BitSet& overrun = epics::pvData::BitSet());
+              const epics::pvData::BitSet& overrun = epics::pvData::BitSet(),
+              const SharedUpdate::shared_pointer& shared = SharedUpdate::shared_pointer());
     //! Call after calling any other upstream interface methods (open()/close()/finish()/post()/...)
     //! when no upstream mutexes are locked.
-    //! Do not call from Source::freeHighMark().  This is done automatically.
+    //! Do not call from Source::freeHighMark() or Source::unsaturated().  This is done automatically.
     //! Call any MonitorRequester methods.
     void notify();
 
@@ -336,6 +408,18 @@ public:
 
     //! Number of unused FIFO slots at this moment, which may changed in the next.
     size_t freeCount() const;
+
+    /** True when the FIFO is full, so that a post() would only be squashed into the most recent update.
+     *  An upstream may skip producing the value for such a subscriber, remembering what changed, until
+     *  Source::unsaturated() is called.
+     */
+    bool saturated() const;
+
+    /** Approximate heap bytes of the values of the elements, see epics::pvAccess::memoryUsage().
+     *  Values which are the snapshot of a SharedUpdate are not counted.
+     *  Elements poll()d are assumed to be the size of those queued.
+     */
+    size_t memoryUsage() const;
 private:
     size_t _freeCount() const;
 
@@ -351,9 +435,11 @@ private:
     //            -> MonitorRequester::monitorEvent()
     //            -> MonitorRequester::unlisten()
     //            -> ChannelBaseRequester::channelDisconnect()
-    //   release()                 -> Source::freeHighMark()
+    //   release()                 -> Source::unsaturated()
+    //                             -> Source::freeHighMark()
     //                             -> notify() -> ...
-    //   reportRemoteQueueStatus() -> Source::freeHighMark()
+    //   reportRemoteQueueStatus() -> Source::unsaturated()
+    //                             -> Source::freeHighMark()
     //                             -> notify() -> ...
     mutable epicsMutex mutex;
 
@@ -377,8 +463,8 @@ private:
     bool opened; // open() vs. close()
     bool running; // start() vs. stop()
     bool finished; // finish() called
-    epics::pvData::BitSet selectMask, // set during open()
-                          scratch; // using during post to avoid re-alloc
+    RequestMask selectMask; // set during open()
+    epics::pvData::BitSet scratch; // using during post to avoid re-alloc
 
     bool needConnected;
     bool needEvent;
@@ -387,14 +473,17 @@ private:
 
     size_t freeHighLevel;
     epicsInt32 flowCount;
+    size_t nfilled; // inuse.size(), which poll() may read without mutex
 
     epics::pvData::StructureConstPtr type; // NULL if not opened
 
-    typedef std::list<MonitorElementPtr> buffer_t;
+    // each with capacity for all elements, reserved by open().  returned only with pipeline
+    typedef RingBuffer<MonitorElementPtr> buffer_t;
     // we allocate one extra buffer element to hold data when post()
     // while all elements poll()'d.  So there will always be one
     // element on either the empty or inuse lists
-    buffer_t inuse, empty, returned;
+    buffer_t inuse, empty, returned,
+             spare; // force'd elements, after return, for re-use by tryPost(force)
     /* our elements are in one of 4 states
      * Empty - on empty list
      * In Use - on inuse list
@@ -210,6 +210,15 @@ public:
      */
     virtual void lastRequest() = 0;
 
+    /**
+     * The change generation of the data most recently passed to getDone().  Called from within getDone().
+     * A provider which can tell that its value did not change between two get()s returns the same
+     * non-zero generation for both, and a different one once it has changed.
+     * The default, 0, means unknown.  A server may then reuse the serialization of an earlier get().
+     * @since 6.1.0
+     */
+    virtual epics::pvData::uint64 getGeneration() { return 0u; }
+
 private:
     ChannelRequest(const ChannelRequest&);
     ChannelRequest& operator=(const ChannelRequest&);
@@ -351,6 +360,24 @@ public:
         ChannelArray::shared_pointer const & channelArray,
         epics::pvData::PVArray::shared_pointer const & pvArray) = 0;
 
+    /**
+     * Part of the result of ChannelArray::getArray().
+     *
+     * When the pvRequest includes "record[chunk=N]", a server may send the result
+     * in parts of at most N elements.  Called, with no locks held, for each part except
+     * the last, in order.  The last is passed to getArrayDone().
+     *
+     * @param channelArray The channelArray interface.
+     * @param chunk Elements [offset, offset+chunk->getLength()) of the result.
+     * @param offset Index in the result of the first element of chunk.
+     * @return true if the chunk is consumed.  Otherwise, by default, it is kept,
+     *         and getArrayDone() is passed the parts kept joined to the last.
+     */
+    virtual bool getArrayChunk(
+        ChannelArray::shared_pointer const & channelArray,
+        epics::pvData::PVArray::shared_pointer const & chunk,
+        size_t offset) { return false; }
+
     /**
      * The request is done. This is always called with no locks held.
      * @param status Completion status.
@@ -749,6 +776,20 @@ public:
      * @param pvArgument The argument structure for an RPC request.
      */
     virtual void request(epics::pvData::PVStructure::shared_pointer const & pvArgument) = 0;
+
+    /**
+     * The type of every pvArgument which request() accepts, if it is fixed.
+     *
+     * When not null, a server may decode successive arguments of this type into the same
+     * PVStructure, once no reference to it is left from the previous request().
+     * So no reference to a sub-field of pvArgument may be kept after requestDone().
+     *
+     * @return The argument type, or null (the default) for any type.
+     * @since 6.1.0
+     */
+    virtual epics::pvData::Structure::const_shared_pointer getArgumentType() {
+        return epics::pvData::Structure::const_shared_pointer();
+    }
 };
 
 
@@ -1243,6 +1284,53 @@ public:
             short priority, std::string const & address) = 0;
 };
 
+/**
+ * Receives the result of ChannelBatchFind::channelBatchFind()
+ */
+class epicsShareClass ChannelBatchFindRequester {
+public:
+    POINTER_DEFINITIONS(ChannelBatchFindRequester);
+
+    virtual ~ChannelBatchFindRequester();
+
+    /**
+     * @param status Completion status.
+     * @param channelFind Identifies the provider, as for ChannelFindRequester::channelFindResult()
+     * @param found For each name passed to channelBatchFind(), in order, true if the provider has it.
+     */
+    virtual void channelBatchFindResult(
+        const epics::pvData::Status& status,
+        ChannelFind::shared_pointer const & channelFind,
+        const std::vector<bool>& found) = 0;
+};
+
+/** @brief Optional interface of a ChannelProvider which can test for many names with one call.
+ *
+ * A ServerContext checks each of its providers for this interface with dynamic_cast.
+ * When all of those it must search have it, the names of one search request
+ * are passed together, instead of calling ChannelProvider::channelFind() for each.
+ *
+ * pvas::StaticProvider and pvas::DynamicProvider implement this.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass ChannelBatchFind {
+public:
+    virtual ~ChannelBatchFind();
+
+    /**
+     * Test to see if this provider has each of several channels.
+     *
+     * Must call ChannelBatchFindRequester::channelBatchFindResult() once, before returning, or at some time later.
+     * If an exception is thrown, then channelBatchFindResult() will never be called.
+     *
+     * @param names The channel names.
+     * @param requester The Requester.
+     */
+    virtual void channelBatchFind(const std::vector<std::string>& names,
+                                  ChannelBatchFindRequester::shared_pointer const & requester) = 0;
+};
+
 /**
  * <code>ChanneProvider</code> factory interface.
  */
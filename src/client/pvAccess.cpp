@@ -300,6 +300,11 @@ struct Get2PutProxy : public ChannelGet
         ChannelPut::shared_pointer O(OP());
         if(O) O->get();
     }
+    virtual epics::pvData::uint64 getGeneration() OVERRIDE FINAL
+    {
+        ChannelPut::shared_pointer O(OP());
+        return O ? O->getGeneration() : 0u;
+    }
 };
 }// namespace
 
@@ -382,6 +387,10 @@ ChannelProvider::~ChannelProvider()
     REFTRACE_DECREMENT(num_instances);
 }
 
+ChannelBatchFindRequester::~ChannelBatchFindRequester() {}
+
+ChannelBatchFind::~ChannelBatchFind() {}
+
 size_t ChannelBaseRequester::num_instances;
 
 ChannelBaseRequester::ChannelBaseRequester()
@@ -438,11 +447,71 @@ ChannelRequester::shared_pointer DefaultChannelRequester::build()
     return ret;
 }
 
+size_t MonitorElement::num_instances;
+
 MonitorElement::MonitorElement(epics::pvData::PVStructurePtr const & pvStructurePtr)
     : pvStructurePtr(pvStructurePtr)
     ,changedBitSet(epics::pvData::BitSet::create(static_cast<epics::pvData::uint32>(pvStructurePtr->getNumberFields())))
     ,overrunBitSet(epics::pvData::BitSet::create(static_cast<epics::pvData::uint32>(pvStructurePtr->getNumberFields())))
-{}
+{
+    REFTRACE_INCREMENT(num_instances);
+}
+
+MonitorElement::~MonitorElement()
+{
+    REFTRACE_DECREMENT(num_instances);
+}
+
+void MonitorElement::unshare()
+{
+    shared.reset();
+    if(pvStructurePtr.use_count()>1) {
+        // copy on write.  Only the changed fields are meaningful
+        epics::pvData::PVStructurePtr copy(epics::pvData::getPVDataCreate()->createPVStructure(pvStructurePtr->getStructure()));
+        copy->copyUnchecked(*pvStructurePtr, *changedBitSet);
+        pvStructurePtr = copy;
+    }
+}
+
+SharedUpdate::SharedUpdate() {}
+SharedUpdate::SharedUpdate(const epics::pvData::PVStructurePtr& snapshot) :snapshot(snapshot) {}
+SharedUpdate::~SharedUpdate() {}
+
+std::tr1::shared_ptr<const SharedUpdate::bytes_t>
+SharedUpdate::find(const epics::pvData::StructureConstPtr& type,
+                   int byteOrder,
+                   const epics::pvData::BitSet& changed,
+                   const epics::pvData::BitSet& overrun) const
+{
+    epicsGuard<epicsMutex> G(mutex);
+    for(size_t i=0; i<entries.size(); i++) {
+        const entry& E = entries[i];
+        if(E.type==type && E.byteOrder==byteOrder && E.changed==changed && E.overrun==overrun)
+            return E.bytes;
+    }
+    return std::tr1::shared_ptr<const bytes_t>();
+}
+
+void SharedUpdate::store(const epics::pvData::StructureConstPtr& type,
+                         int byteOrder,
+                         const epics::pvData::BitSet& changed,
+                         const epics::pvData::BitSet& overrun,
+                         const std::tr1::shared_ptr<const bytes_t>& bytes)
+{
+    epicsGuard<epicsMutex> G(mutex);
+    for(size_t i=0; i<entries.size(); i++) {
+        const entry& E = entries[i];
+        if(E.type==type && E.byteOrder==byteOrder && E.changed==changed && E.overrun==overrun)
+            return; // raced with another subscriber
+    }
+    entries.push_back(entry());
+    entry& E = entries.back();
+    E.type = type;
+    E.byteOrder = byteOrder;
+    E.changed = changed;
+    E.overrun = overrun;
+    E.bytes = bytes;
+}
 
 }} // namespace epics::pvAccess
 
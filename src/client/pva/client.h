@@ -8,6 +8,17 @@
 #include <ostream>
 #include <stdexcept>
 #include <list>
+#include <vector>
+
+#if __cplusplus>=201103L
+#  include <functional>
+#endif
+#if __cplusplus>=202002L && defined(__has_include)
+#  if __has_include(<coroutine>)
+#    include <coroutine>
+#    define PVAC_HAS_COROUTINE
+#  endif
+#endif
 
 #include <epicsMutex.h>
 
@@ -98,7 +109,12 @@ struct PutEvent
 //! Information on get/rpc completion
 struct epicsShareClass GetEvent : public PutEvent
 {
-    //! New data. NULL unless event==Success
+    /** New data. NULL unless event==Success
+     *
+     * Array fields are frozen.  A shared_vector<const T> taken from one,
+     * eg. with PVScalarArray::getAs() of the stored element type, refers to the
+     * received data without a copy, and is never over-written by the library.
+     */
     epics::pvData::PVStructure::const_shared_pointer value;
     //! Mask of fields in value which have been initialized by the server
     //! @since 6.1.0
@@ -107,6 +123,16 @@ struct epicsShareClass GetEvent : public PutEvent
 
 struct MonitorSync;
 
+//! One update taken by Monitor::pollBatch()
+//! @since 6.1.0
+struct MonitorUpdate
+{
+    //! A complete copy of the subscribed structure as of this update
+    epics::pvData::PVStructure::const_shared_pointer root;
+    epics::pvData::BitSet changed,
+                          overrun;
+};
+
 //! Handle for monitor subscription
 struct epicsShareClass Monitor
 {
@@ -129,6 +155,17 @@ struct epicsShareClass Monitor
      * @post root!=NULL iff poll()==true  (In version 6.0.0)
      */
     bool poll();
+    /** Take up to maxCount updates, with one lock.
+     *
+     * out is resized to the number taken.  The root of an entry of out is re-used,
+     * if not referenced elsewhere and of the same type, otherwise a new one is allocated.
+     * Does not change root, changed, or overrun.
+     *
+     * @return the number taken.  Less than maxCount, like poll()==false, if the queue is emptied.
+     * @note This method does not block.
+     * @since 6.1.0
+     */
+    size_t pollBatch(std::vector<MonitorUpdate>& out, size_t maxCount = (size_t)-1);
     //! true if all events received.
     //! Check after poll()==false
     bool complete() const;
@@ -146,6 +183,10 @@ struct epicsShareClass Monitor
      *
      * NULL except after poll()==true.  poll()==false sets root=NULL.
      * references to root should not be stored between calls to poll().
+     *
+     * Array fields are frozen, as with GetEvent::value.  A shared_vector<const T>
+     * taken from root after poll() holds the array of that update, without a copy,
+     * and remains valid and unchanged after later calls to poll().
      */
     epics::pvData::PVStructure::const_shared_pointer root;
     epics::pvData::BitSet changed,
@@ -168,6 +209,8 @@ private:
     std::tr1::shared_ptr<Impl> impl;
     friend epicsShareFunc ::std::ostream& operator<<(::std::ostream& strm, const Monitor& op);
     friend struct MonitorSync;
+    // fill out[start...]
+    size_t pollInto(std::vector<MonitorUpdate>& out, size_t start, size_t maxCount);
 };
 
 //! Information on monitor subscription/queue change
@@ -211,6 +254,17 @@ struct epicsShareClass MonitorSync : public Monitor
     //! Does not block.
     bool test();
 
+    /** Wait for count updates, or timeout, and take them as pollBatch().
+     *
+     * Also returns early if any event other than MonitorEvent::Data is received,
+     * or wake() is called.  'event' is then updated.
+     *
+     * @param timeout in seconds, for all
+     * @return the number taken, which is out.size()
+     * @since 6.1.0
+     */
+    size_t waitBatch(std::vector<MonitorUpdate>& out, size_t count, double timeout);
+
     //! Abort one call to wait(), either concurrent or future.
     //! Calls are queued.
     //! wait() will return with MonitorEvent::Fail.
@@ -237,9 +291,14 @@ struct Timeout : public std::runtime_error
 
 namespace detail {
 class PutBuilder;
+struct CallbackDispatcher;
 void registerRefTrack();
 }
 
+class GetFuture;
+class Getter;
+class PreparedPut;
+
 /** Represents a single channel
  *
  * This class has two sets of methods, those which block for completion, and
@@ -259,15 +318,34 @@ public:
 private:
     std::tr1::shared_ptr<Impl> impl;
     friend class ClientProvider;
+    friend class detail::PutBuilder;
     friend void detail::registerRefTrack();
     friend epicsShareFunc ::std::ostream& operator<<(::std::ostream& strm, const ClientChannel& op);
 
     ClientChannel(const std::tr1::shared_ptr<Impl>& i) :impl(i) {}
+    // NULL unless callbacks are run by EPICS_PVA_CALLBACK_THREADS
+    std::tr1::shared_ptr<detail::CallbackDispatcher> getDispatcher() const;
 public:
     //! Channel creation options
     struct epicsShareClass Options {
+        /** Channel priority, ChannelProvider::PRIORITY_MIN (default) to PRIORITY_MAX.
+         *  Channels of each priority share connections only with those of the same priority.
+         *  With "pva", the priority of a connection selects the priority of its I/O threads,
+         *  whether it shares the threads of EPICS_PVA_IO_THREADS (see EPICS_PVA_REACTOR_MAX_PRIORITY),
+         *  and its DSCP marking and socket buffer sizes (see EPICS_PVA_PRIORITY_DSCP,
+         *  EPICS_PVA_PRIORITY_SNDBUF and EPICS_PVA_PRIORITY_RCVBUF).
+         */
         short priority;
         std::string address;
+        /** If >0, blocking get() with the default pvRequest is served from a local copy,
+         *  kept current by a subscription which the first such get() starts.  While the
+         *  subscription is disconnected, the copy is used until it is older than cacheAge seconds.
+         *  @since 6.1.0
+         */
+        double cacheAge;
+        //! The subscription of the cache is cancelled when unused by get() for this many seconds.
+        //! Default 60.  @since 6.1.0
+        double cacheIdle;
         Options();
         bool operator<(const Options&) const;
     };
@@ -340,6 +418,29 @@ public:
         const epics::pvData::PVStructure::const_shared_pointer& arguments,
         epics::pvData::PVStructure::const_shared_pointer pvRequest = epics::pvData::PVStructure::const_shared_pointer());
 
+    /** Prepare for repeated get() of this channel.
+     *
+     * The server side operation is created once, and each Getter::get() then sends
+     * only a GET request, without the pvRequest.  Prefer this to repeated get(timeout)
+     * for polling.  Also, a pvRequest built once with createRequest() may be re-used.
+     *
+     * @param pvRequest if NULL defaults to "field()".
+     * @since 6.1.0
+     */
+    Getter getter(const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    //! Issue request to retrieve current PV value, without a callback
+    //! @param pvRequest if NULL defaults to "field()".
+    //! @since 6.1.0
+    GetFuture getAsync(const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    //! Start an RPC call, without a callback
+    //! @param arguments encoded call arguments
+    //! @param pvRequest if NULL defaults to "field()".
+    //! @since 6.1.0
+    GetFuture rpcAsync(const epics::pvData::PVStructure::const_shared_pointer& arguments,
+                       const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
     //! callbacks for put()
     struct PutCallback {
         virtual ~PutCallback() {}
@@ -414,6 +515,440 @@ public:
     void show(std::ostream& strm) const;
 private:
     std::tr1::shared_ptr<epics::pvAccess::Channel> getChannel();
+    // true on a cache hit
+    bool getCached(epics::pvData::PVStructure::const_shared_pointer& value);
+};
+
+/** @brief Result of ClientChannel::getAsync() or rpcAsync(), when it arrives.
+ *
+ * Copies refer to the same request, which is cancelled when the last copy is destroyed.
+ * No thread waits for it, so one thread may keep many requests in flight.
+ *
+ * Either block with wait(), or continue with then().  With C++20, co_await gives the GetEvent.
+ *
+ * @code
+ *   pvac::GetFuture F(chan.getAsync());
+ *   F.then([](const pvac::GetEvent& evt) { ... }); // C++11
+ *   pvac::GetEvent evt(co_await chan.getAsync()); // C++20
+ * @endcode
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass GetFuture
+{
+public:
+    //! Continuation, see then()
+    struct Next {
+        virtual ~Next() {}
+        virtual void done(const GetEvent& evt) =0;
+    };
+    struct Impl;
+private:
+    std::tr1::shared_ptr<Impl> impl;
+    // takes ownership.  Calls at once if ready()
+    void then(Next* next);
+
+    struct CallbackNext : public Next {
+        ClientChannel::GetCallback * const cb;
+        explicit CallbackNext(ClientChannel::GetCallback *cb) :cb(cb) {}
+        virtual ~CallbackNext() {}
+        virtual void done(const GetEvent& evt) { cb->getDone(evt); }
+    };
+#if __cplusplus>=201103L
+    struct FunctionNext : public Next {
+        const std::function<void(const GetEvent&)> fn;
+        explicit FunctionNext(const std::function<void(const GetEvent&)>& fn) :fn(fn) {}
+        virtual ~FunctionNext() {}
+        virtual void done(const GetEvent& evt) { fn(evt); }
+    };
+#endif
+#ifdef PVAC_HAS_COROUTINE
+    struct ResumeNext : public Next {
+        const std::coroutine_handle<> handle;
+        explicit ResumeNext(std::coroutine_handle<> handle) :handle(handle) {}
+        virtual ~ResumeNext() {}
+        virtual void done(const GetEvent&) { handle.resume(); }
+    };
+#endif
+public:
+    GetFuture() {}
+    explicit GetFuture(const std::tr1::shared_ptr<Impl>& impl) :impl(impl) {}
+    ~GetFuture();
+
+    bool valid() const { return !!impl; }
+    //! Has completed
+    bool ready() const;
+    //! Block until complete
+    //! @throws Timeout
+    GetEvent wait(double timeout = 3.0) const;
+    //! @pre ready()
+    GetEvent result() const;
+    //! Immediate cancellation.  event==GetEvent::Cancel
+    void cancel();
+
+    /** Call cb->getDone() on completion.  From a PVA thread, or at once from this thread if ready().
+     *  Only one continuation.  Replaces any previous.
+     *  @param cb Must outlive this GetFuture and its copies.
+     */
+    void then(ClientChannel::GetCallback* cb) { then(new CallbackNext(cb)); }
+#if __cplusplus>=201103L
+    //! As then(GetCallback*)
+    void then(const std::function<void(const GetEvent&)>& fn) { then(new FunctionNext(fn)); }
+#endif
+#ifdef PVAC_HAS_COROUTINE
+    bool await_ready() const { return ready(); }
+    //! resumed from a PVA thread
+    void await_suspend(std::coroutine_handle<> handle) { then(new ResumeNext(handle)); }
+    GetEvent await_resume() const { return result(); }
+#endif
+};
+
+/** @brief Repeated get() of one channel, from ClientChannel::getter()
+ *
+ * Copies refer to the same operation, which is destroyed when the last copy is.
+ * Calls to get() from several threads are done one at a time.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass Getter
+{
+public:
+    struct Impl;
+private:
+    std::tr1::shared_ptr<Impl> impl;
+    friend class ClientChannel;
+    explicit Getter(const std::tr1::shared_ptr<Impl>& impl) :impl(impl) {}
+public:
+    Getter() {}
+    ~Getter();
+
+    /** Block and retrieve current PV value.
+     *
+     * Waits for the operation to (re)connect.
+     *
+     * @param timeout in seconds
+     * @returns A copy, not changed by later calls.
+     * @throws Timeout or std::runtime_error
+     */
+    epics::pvData::PVStructure::const_shared_pointer get(double timeout = 3.0);
+
+    //! Destroy the operation.  Later calls to get() throw.
+    void cancel();
+
+    bool valid() const { return !!impl; }
+    void reset() { impl.reset(); }
+};
+
+/** @brief Repeated put() of the same fields of one channel, from detail::PutBuilder::prepare()
+ *
+ @code
+   pvac::PreparedPut P(chan.put().set("value", 0.0).set("alarm.severity", 0).prepare());
+   for(...) {
+       P.set("value", x);
+       P.exec();
+   }
+ @endcode
+ *
+ * The server side operation is created once.  The fields named are found in its structure
+ * once it (re)connects, so each exec() only converts the values and sends a PUT request.
+ * A value for a variant union field keeps the type of the value first given.
+ *
+ * Copies refer to the same operation, which is destroyed when the last copy is.
+ * Calls to exec() from several threads are done one at a time.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass PreparedPut
+{
+public:
+    struct Impl;
+private:
+    std::tr1::shared_ptr<Impl> impl;
+    friend class detail::PutBuilder;
+    explicit PreparedPut(const std::tr1::shared_ptr<Impl>& impl) :impl(impl) {}
+public:
+    PreparedPut() {}
+    ~PreparedPut();
+
+    /** Change the value of a field named to the PutBuilder, for the following exec()s.
+     * @throws std::logic_error if name was not given to the PutBuilder
+     */
+    PreparedPut& set(const std::string& name, const epics::pvData::AnyScalar& value);
+    template<typename T>
+    PreparedPut& set(const std::string& name, T value) {
+        return set(name, epics::pvData::AnyScalar(value));
+    }
+    PreparedPut& set(const std::string& name, const epics::pvData::shared_vector<const void>& value);
+    template<typename T>
+    PreparedPut& set(const std::string& name, const epics::pvData::shared_vector<const T>& value) {
+        return set(name, epics::pvData::static_shared_vector_cast<const void>(value));
+    }
+
+    /** Block and put the current values.
+     *
+     * Waits for the operation to (re)connect.
+     *
+     * @param timeout in seconds
+     * @throws Timeout or std::runtime_error
+     */
+    void exec(double timeout = 3.0);
+
+    //! Destroy the operation.  Later calls to exec() throw.
+    void cancel();
+
+    bool valid() const { return !!impl; }
+    void reset() { impl.reset(); }
+};
+
+/** @brief Many subscriptions, waited on by one thread.
+ *
+ * Events of all subscriptions added are queued to the set.  wait() returns those
+ * subscriptions which have had an event, each once, in the order of their first event.
+ *
+ * @code
+ *   pvac::MonitorSet set;
+ *   for(...)
+ *       set.add(chan);
+ *   std::vector<pvac::MonitorSet::Ready> ready;
+ *   while(set.wait(ready, 5.0)) {
+ *       for(size_t i=0; i<ready.size(); i++)
+ *           while(ready[i].mon.poll()) { ... }
+ *   }
+ * @endcode
+ *
+ * A subscription is removed from the set after its MonitorEvent::Fail or Cancel is returned.
+ * Destroying the set cancels all of its subscriptions.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass MonitorSet
+{
+public:
+    struct Impl;
+private:
+    std::tr1::shared_ptr<Impl> impl;
+public:
+    //! A subscription with an event
+    struct Ready {
+        Monitor mon;
+        //! The most recent event.  Fail or Cancel take precedence over Data or Disconnect
+        MonitorEvent event;
+    };
+
+    MonitorSet();
+    ~MonitorSet();
+
+    //! Begin subscription, with events queued to this set
+    //! @param pvRequest if NULL defaults to "field()".
+    Monitor add(ClientChannel& chan,
+                const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    //! Number of subscriptions in the set
+    size_t size() const;
+
+    /** Wait for at least one subscription to have an event.
+     *
+     * @param ready Replaced with those subscriptions which have had events since the last call.
+     * @return false on timeout (ready is empty), or if wake() was called.
+     */
+    bool wait(std::vector<Ready>& ready, double timeout);
+    //! As wait(), without blocking
+    bool test(std::vector<Ready>& ready);
+
+    //! Abort one call to wait(), either concurrent or future.
+    void wake();
+
+private:
+    MonitorSet(const MonitorSet&);
+    MonitorSet& operator=(const MonitorSet&);
+};
+
+/** @brief Subscriptions to a set of PVs, taken as snapshots of their updates of the same time.
+ *
+ * The updates of each member are kept, by their "timeStamp", until all members have
+ * one of that time, which are then returned together by wait() as a Snapshot.
+ * A snapshot lacking some members is returned once Options::timeout has passed since
+ * the first of its updates arrived, or sooner if every member missing has since sent a
+ * later time, so that it can not be completed.  Snapshots are returned in time order.
+ * An update older than the last snapshot returned is dropped.
+ *
+ * The values of a snapshot are those received, not copies.  Their arrays are frozen,
+ * and shared with the subscription (see Monitor::root).
+ *
+ * @code
+ *   pvac::MonitorGroup group;
+ *   for(...)
+ *       group.add(chan);
+ *   pvac::MonitorGroup::Snapshot snap;
+ *   while(group.wait(snap, 5.0)) {
+ *       for(size_t i=0; i<snap.values.size(); i++)
+ *           if(snap.values[i]) { ... }
+ *   }
+ * @endcode
+ *
+ * Events other than MonitorEvent::Data are not returned.  A member disconnected is
+ * missing from snapshots until it reconnects.  Waited on by one thread.
+ * Destroying the group cancels all of its subscriptions.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass MonitorGroup
+{
+public:
+    struct Impl;
+private:
+    std::tr1::shared_ptr<Impl> impl;
+public:
+    struct epicsShareClass Options {
+        //! Updates of each member kept while waiting for the others.  The oldest is dropped.  Default 8
+        size_t depth;
+        //! Seconds to wait for the other members after the first update of a time.
+        //! Default 1.0.  If <=0, snapshots lacking a member are dropped instead.
+        double timeout;
+        //! Field holding the time_t structure of each member.  Default "timeStamp"
+        std::string timeField;
+        Options();
+    };
+
+    struct Snapshot {
+        //! The time of its values, as in the time_t structure
+        epics::pvData::int64 secondsPastEpoch;
+        epics::pvData::int32 nanoseconds;
+        //! The update of each member, in the order add()'d.  NULL if none of this time.
+        std::vector<epics::pvData::PVStructure::const_shared_pointer> values;
+        //! Number of values not NULL
+        size_t count;
+        bool complete() const { return count==values.size(); }
+    };
+
+    explicit MonitorGroup(const Options& opts = Options());
+    ~MonitorGroup();
+
+    /** Begin subscription of a member.
+     * @param pvRequest if NULL defaults to "field()".  Must include Options::timeField
+     * @return The index of this member in Snapshot::values
+     */
+    size_t add(ClientChannel& chan,
+               const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    //! Number of members
+    size_t size() const;
+
+    /** Wait for the next snapshot.
+     * @return false on timeout, or if wake() was called.
+     */
+    bool wait(Snapshot& snap, double timeout);
+    //! As wait(), without blocking
+    bool test(Snapshot& snap);
+
+    //! Abort one call to wait(), either concurrent or future.
+    void wake();
+
+    struct Stats {
+        //! Snapshots returned, complete or not
+        size_t complete, partial;
+        //! Updates dropped as older than the last snapshot, beyond Options::depth, without a time,
+        //! or in a snapshot which was incomplete with Options::timeout<=0
+        size_t dropped;
+    };
+    void getStats(Stats& out) const;
+
+private:
+    MonitorGroup(const MonitorGroup&);
+    MonitorGroup& operator=(const MonitorGroup&);
+};
+
+/** @brief Subscriptions to many PVs, taken as one stream of updates in time order.
+ *
+ * The updates of each member are queued by their "timeStamp".  wait() takes, from
+ * all members, the update of the oldest time, then the next, as a k-way merge of their
+ * queues.  An update is held for Options::window seconds after it arrives, so that
+ * updates of earlier times from other members, arriving later, are taken before it.
+ * Once more than Options::capacity updates are held, the oldest is taken without waiting.
+ *
+ * An update arriving after one of a later time has been taken is still returned,
+ * as soon as its window passes, and marked Event::late.
+ *
+ * @code
+ *   pvac::MonitorMerge merge;
+ *   for(...)
+ *       merge.add(chan);
+ *   std::vector<pvac::MonitorMerge::Event> events;
+ *   while(merge.wait(events, 5.0)) {
+ *       for(size_t i=0; i<events.size(); i++)
+ *           process(events[i].index, *events[i].update.root);
+ *   }
+ * @endcode
+ *
+ * As MonitorGroup, events other than MonitorEvent::Data are not returned, values are
+ * not copied, and the merge is waited on by one thread.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass MonitorMerge
+{
+public:
+    struct Impl;
+private:
+    std::tr1::shared_ptr<Impl> impl;
+public:
+    struct epicsShareClass Options {
+        //! Seconds an update is held for those of earlier times.  Default 0.1
+        double window;
+        //! Updates held, of all members, before the oldest is taken regardless of window.  Default 100000
+        size_t capacity;
+        //! Field holding the time_t structure of each member.  Default "timeStamp"
+        std::string timeField;
+        Options();
+    };
+
+    struct Event {
+        //! Of the member, as returned by add()
+        size_t index;
+        epics::pvData::int64 secondsPastEpoch;
+        epics::pvData::int32 nanoseconds;
+        //! Older than an update already taken
+        bool late;
+        MonitorUpdate update;
+    };
+
+    explicit MonitorMerge(const Options& opts = Options());
+    ~MonitorMerge();
+
+    /** Begin subscription of a member.
+     * @param pvRequest if NULL defaults to "field()".  Must include Options::timeField
+     * @return The index of this member, see Event::index
+     */
+    size_t add(ClientChannel& chan,
+               const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    //! Number of members
+    size_t size() const;
+
+    /** Wait for updates whose window has passed, and take up to maxCount, in time order.
+     * @param out Replaced with the updates taken
+     * @return false on timeout (out is empty), or if wake() was called.
+     */
+    bool wait(std::vector<Event>& out, double timeout, size_t maxCount = (size_t)-1);
+    //! As wait(), without blocking
+    bool test(std::vector<Event>& out, size_t maxCount = (size_t)-1);
+
+    //! Abort one call to wait(), either concurrent or future.
+    void wake();
+
+    struct Stats {
+        //! Updates taken, and those of them late
+        size_t taken, late;
+        //! Updates dropped for lack of a time
+        size_t dropped;
+        //! Updates held now
+        size_t held;
+    };
+    void getStats(Stats& out) const;
+
+private:
+    MonitorMerge(const MonitorMerge&);
+    MonitorMerge& operator=(const MonitorMerge&);
 };
 
 namespace detail {
@@ -464,6 +999,11 @@ public:
         return set(name, epics::pvData::static_shared_vector_cast<const void>(value), required);
     }
     void exec(double timeout=3.0);
+    /** Create the put operation, for repeated exec() of the fields set so far.
+     * Prefer this to repeated exec() when writing the same fields many times.
+     * @since 6.1.0
+     */
+    PreparedPut prepare();
 };
 
 
@@ -492,6 +1032,18 @@ public:
     explicit ClientProvider(const std::tr1::shared_ptr<epics::pvAccess::ChannelProvider>& provider);
     ~ClientProvider();
 
+    /** Use the process wide instance of a named provider.
+     *
+     * All calls with the same providerName, while any result is in use, return copies
+     * sharing one channel cache.  So their channels, and those of other users of
+     * epics::pvAccess::ChannelProviderRegistry::getProvider(), share one set of
+     * search managers and transports.  Uses the default Configuration (environment).
+     *
+     * @param providerName As ClientProvider(const std::string&, ...)
+     * @since 6.1.0
+     */
+    static ClientProvider shared(const std::string& providerName = "pva");
+
     std::string name() const;
 
     /** Get a new Channel
@@ -510,6 +1062,105 @@ public:
     //! Clear channel cache
     void disconnect();
 
+    //! Counts of get() served by the value cache of ClientChannel::Options::cacheAge
+    struct CacheStats {
+        size_t hits,      //!< served from the cache
+               misses,    //!< sent to the server
+               evictions; //!< subscriptions cancelled when unused
+        CacheStats() :hits(0u), misses(0u), evictions(0u) {}
+    };
+    //! Statistics of the channels from connect() of this provider
+    //! @since 6.1.0
+    void cacheStats(CacheStats& stats) const;
+
+    //! callbacks for getMany(), putMany(), processMany() and putGetMany()
+    struct ManyCallback {
+        virtual ~ManyCallback() {}
+        //! putMany() and putGetMany() only.  As ClientChannel::PutCallback::putBuild() for names[index]
+        virtual void putBuild(size_t index, const epics::pvData::StructureConstPtr& build,
+                              ClientChannel::PutCallback::Args& args)
+        { throw std::logic_error("putMany() requires ManyCallback::putBuild()"); }
+        //! Operation on names[index] is complete.  evt.value is NULL for putMany() and processMany()
+        virtual void manyDone(size_t index, const GetEvent& evt) =0;
+    };
+
+    /** Issue get() on each of many channels at once.
+     *
+     * Channels connect concurrently, and requests to channels of the same server
+     * are queued together to its connection, which sends them together.
+     * So one round trip completes many.
+     *
+     * @param cb Called as each completes, in any order.  Must outlive Operation.
+     * @param names Channel names.  Connected through the channel cache.
+     * @param pvRequest if NULL defaults to "field()".
+     * @returns One Operation.  cancel() cancels all which are not complete.
+     */
+    Operation getMany(ManyCallback* cb,
+                      const std::vector<std::string>& names,
+                      const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    //! Issue put() on each of many channels at once.  As getMany()
+    Operation putMany(ManyCallback* cb,
+                      const std::vector<std::string>& names,
+                      const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    /** Block and retrieve the current values of many channels.
+     *
+     * @param timeout in seconds, for all
+     * @returns results in the order of names.  event==GetEvent::Cancel for those
+     *          not complete within timeout.
+     */
+    std::vector<GetEvent> getMany(const std::vector<std::string>& names,
+                                  double timeout = 3.0,
+                                  const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    /** Block and change the value field of many channels.  values[i] is put to names[i]
+     *
+     * @returns results in the order of names, as getMany()
+     */
+    std::vector<PutEvent> putMany(const std::vector<std::string>& names,
+                                  const std::vector<epics::pvData::AnyScalar>& values,
+                                  double timeout = 3.0,
+                                  const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    /** Issue process on each of many channels at once.  As getMany()
+     *
+     * Callbacks are called from PVA threads, even with EPICS_PVA_CALLBACK_THREADS.
+     * @since 6.1.0
+     */
+    Operation processMany(ManyCallback* cb,
+                          const std::vector<std::string>& names,
+                          const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    /** Issue putGet on each of many channels at once.  As putMany(), with the result of each
+     *  get in GetEvent::value.
+     *
+     * Callbacks are called from PVA threads, even with EPICS_PVA_CALLBACK_THREADS.
+     * @since 6.1.0
+     */
+    Operation putGetMany(ManyCallback* cb,
+                         const std::vector<std::string>& names,
+                         const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    /** Block and process many channels.
+     *
+     * @returns results in the order of names, as getMany()
+     * @since 6.1.0
+     */
+    std::vector<PutEvent> processMany(const std::vector<std::string>& names,
+                                      double timeout = 3.0,
+                                      const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
+    /** Block, change the value field of many channels, and retrieve the result.  values[i] is put to names[i]
+     *
+     * @returns results in the order of names, as getMany()
+     * @since 6.1.0
+     */
+    std::vector<GetEvent> putGetMany(const std::vector<std::string>& names,
+                                     const std::vector<epics::pvData::AnyScalar>& values,
+                                     double timeout = 3.0,
+                                     const epics::pvData::PVStructure::const_shared_pointer& pvRequest = epics::pvData::PVStructure::const_shared_pointer());
+
     bool valid() const { return !!impl; }
 
 #if __cplusplus>=201103L
@@ -526,6 +1177,87 @@ public:
 
 
 
+/** @brief Runs callbacks in an application thread, instead of PVA internal threads.
+ *
+ * Wrap a callback with one of the adapters, and pass the adapter to ClientChannel.
+ * Events are queued without locking.  The application calls drain() to run the
+ * wrapped callbacks, eg. when fd() becomes readable in its epoll, asio, or Qt loop.
+ *
+ * @code
+ *   pvac::CompletionQueue Q;
+ *   MyGet cb;
+ *   pvac::CompletionQueue::GetCallback adapt(Q, &cb);
+ *   pvac::Operation op(chan.get(&adapt));
+ *   // when Q.fd() is readable
+ *   Q.drain();
+ * @endcode
+ *
+ * An adapter, and the callback it wraps, must outlive the Operation, Monitor, or
+ * connect listener, and any events queued (call drain() after cancel()).
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass CompletionQueue
+{
+public:
+    struct Impl;
+private:
+    std::tr1::shared_ptr<Impl> impl;
+public:
+    struct epicsShareClass GetCallback : public ClientChannel::GetCallback {
+        CompletionQueue& queue;
+        ClientChannel::GetCallback * const target;
+        GetCallback(CompletionQueue& queue, ClientChannel::GetCallback* target) :queue(queue), target(target) {}
+        virtual ~GetCallback() {}
+        virtual void getDone(const GetEvent& evt) OVERRIDE FINAL;
+    };
+    //! putBuild() is called directly, only putDone() is queued
+    struct epicsShareClass PutCallback : public ClientChannel::PutCallback {
+        CompletionQueue& queue;
+        ClientChannel::PutCallback * const target;
+        PutCallback(CompletionQueue& queue, ClientChannel::PutCallback* target) :queue(queue), target(target) {}
+        virtual ~PutCallback() {}
+        virtual void putBuild(const epics::pvData::StructureConstPtr& build, Args& args) OVERRIDE FINAL;
+        virtual void putDone(const PutEvent& evt) OVERRIDE FINAL;
+    };
+    struct epicsShareClass MonitorCallback : public ClientChannel::MonitorCallback {
+        CompletionQueue& queue;
+        ClientChannel::MonitorCallback * const target;
+        MonitorCallback(CompletionQueue& queue, ClientChannel::MonitorCallback* target) :queue(queue), target(target) {}
+        virtual ~MonitorCallback() {}
+        virtual void monitorEvent(const MonitorEvent& evt) OVERRIDE FINAL;
+    };
+    struct epicsShareClass ConnectCallback : public ClientChannel::ConnectCallback {
+        CompletionQueue& queue;
+        ClientChannel::ConnectCallback * const target;
+        ConnectCallback(CompletionQueue& queue, ClientChannel::ConnectCallback* target) :queue(queue), target(target) {}
+        virtual ~ConnectCallback() {}
+        virtual void connectEvent(const ConnectEvent& evt) OVERRIDE FINAL;
+    };
+
+    CompletionQueue();
+    ~CompletionQueue();
+
+    /** Readable while events are queued (an eventfd).  For use with poll()/select().
+     *  May be readable with nothing queued, but never unreadable with events queued.
+     *  @returns -1 where not supported (other than Linux).  Use wait() instead.
+     */
+    int fd() const;
+
+    /** Run the callbacks of queued events, in the order queued, in the calling thread.
+     *  Call from one thread at a time.
+     *  @returns the number run.
+     */
+    size_t drain();
+
+    //! Block until an event is queued.  @returns false on timeout
+    bool wait(double timeout);
+
+private:
+    CompletionQueue(const CompletionQueue&);
+    CompletionQueue& operator=(const CompletionQueue&);
+};
+
 detail::PutBuilder
 ClientChannel::put(const epics::pvData::PVStructure::const_shared_pointer& pvRequest)
 {
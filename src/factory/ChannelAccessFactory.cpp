@@ -25,6 +25,8 @@
 #include <pv/serverContextImpl.h>
 #include <pv/serverChannelImpl.h>
 #include <pv/blockingUDP.h>
+#include <pv/bufferPool.h>
+#include <pv/internedName.h>
 #include <sharedstateimpl.h>
 
 using namespace epics::pvData;
@@ -218,6 +220,16 @@ void providerRegInit(void*)
     registerRefCounter("Transport (ABC)", &Transport::num_instances);
     registerRefCounter("BlockingTCPTransportCodec", &detail::BlockingTCPTransportCodec::num_instances);
     registerRefCounter("BlockingUDPTransport", &BlockingUDPTransport::num_instances);
+    registerRefCounter("IOReactor", &IOReactor::num_instances);
+    registerRefCounter("IOReactor (threads)", &IOReactor::num_workers);
+    registerRefCounter("DecodePool", &DecodePool::num_instances);
+    registerRefCounter("BufferPool (in use)", &BufferPool::num_used);
+    registerRefCounter("BufferPool (free)", &BufferPool::num_free);
+    registerRefCounter("BufferPool hits", &BufferPool::num_hits);
+    registerRefCounter("BufferPool misses", &BufferPool::num_misses);
+    registerRefCounter("HugePageAllocator (reserved)", &HugePageAllocator::num_reserved);
+    registerRefCounter("HugePageAllocator (transparent)", &HugePageAllocator::num_transparent);
+    registerRefCounter("InternedName", &InternedName::num_names);
     registerRefCounter("ChannelProvider (ABC)", &ChannelProvider::num_instances);
     registerRefCounter("Channel (ABC)", &Channel::num_instances);
     registerRefCounter("ChannelRequester (ABC)", &ChannelRequester::num_instances);
@@ -225,6 +237,7 @@ void providerRegInit(void*)
     registerRefCounter("ChannelRequest (ABC)", &ChannelRequest::num_instances);
     registerRefCounter("ResponseHandler (ABC)", &ResponseHandler::num_instances);
     registerRefCounter("MonitorFIFO", &MonitorFIFO::num_instances);
+    registerRefCounter("MonitorElement", &MonitorElement::num_instances);
     pvas::registerRefTrackServer();
     registerRefCounter("pvas::SharedChannel", &pvas::SharedChannel::num_instances);
     registerRefCounter("pvas::SharedPut", &pvas::SharedPut::num_instances);
@@ -15,6 +15,7 @@
 #include <cstdlib>
 #include <cstddef>
 #include <string>
+#include <vector>
 #include <cstdio>
 #include <memory>
 #include <iostream>
@@ -30,7 +31,9 @@
 
 #include <pv/pvAccess.h>
 #include <pv/serverContext.h>
+#include <pv/rpcServer.h>
 #include <pv/iocshelper.h>
+#include <pv/logger.h>
 
 #include <epicsExport.h>
 
@@ -103,6 +106,45 @@ void pvasr(int lvl)
     }
 }
 
+void pvasTune(const char *name, const char *value)
+{
+    try {
+        pvd::Lock G(the_server_lock);
+        if(!the_server) {
+            std::cout<<"PVA server not running\n";
+
+        } else if(!name || name[0]=='\0') {
+            std::vector<pva::ServerContext::Tunable> tunables;
+            the_server->tunables(tunables);
+            for(size_t i=0; i<tunables.size(); i++) {
+                std::cout<<tunables[i].name<<"=\""<<tunables[i].value<<"\""
+                         <<(tunables[i].live ? "" : "  (new connections)")<<"\n";
+            }
+
+        } else if(!the_server->tune(name, value ? value : "")) {
+            std::cout<<"Error: "<<name<<" can not be set to \""<<(value ? value : "")<<"\"\n";
+        }
+    }catch(std::exception& e){
+        std::cout<<"Error: "<<e.what()<<"\n";
+    }
+}
+
+void rpcsr()
+{
+    try {
+        pva::RPCServer::report(std::cout);
+    }catch(std::exception& e){
+        std::cout<<"Error: "<<e.what()<<"\n";
+    }
+}
+
+void pvaLogConfig(int queueSize, int perSecond, int keyValue)
+{
+    pva::pvAccessSetLogFormat(keyValue ? pva::logFormatKeyValue : pva::logFormatText);
+    pva::pvAccessSetLogRateLimit(perSecond < 0 ? 0u : unsigned(perSecond));
+    pva::pvAccessSetLogAsync(queueSize < 0 ? 0u : size_t(queueSize));
+}
+
 void pva_server_cleanup(void *)
 {
     stopPVAServer();
@@ -125,6 +167,9 @@ void registerStartPVAServer(void)
     epics::iocshRegister<const char*, &startPVAServer>("startPVAServer", "provider names");
     epics::iocshRegister<&stopPVAServer>("stopPVAServer");
     epics::iocshRegister<int, &pvasr>("pvasr", "detail");
+    epics::iocshRegister<const char*, const char*, &pvasTune>("pvasTune", "name", "value");
+    epics::iocshRegister<&rpcsr>("rpcsr");
+    epics::iocshRegister<int, int, int, &pvaLogConfig>("pvaLogConfig", "async queue size", "messages per second", "key=value");
     initHookRegister(&initStartPVAServer);
 }
 
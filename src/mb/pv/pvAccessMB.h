@@ -7,7 +7,217 @@
 #ifndef _PVACCESSMB_H_
 #define _PVACCESSMB_H_
 
-/* this header is deprecated */
+#include <ostream>
+#include <istream>
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define pvAccessMBEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsTypes.h>
+#include <epicsMutex.h>
+#include <epicsThread.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_MB_USE_ATOMIC
+#endif
+#endif
+
+#ifdef pvAccessMBEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef pvAccessMBEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+#endif
+
+/** @file pvAccessMB.h
+ *
+ * Micro-benchmark trace points.  Timestamps the stages of a request, eg. receive,
+ * decode, provider call, serialize and send, at a cost of a few ns each.
+ *
+ * The MB_* macros expand to nothing unless PV_MB is defined when compiling
+ * (WITH_MB=YES in CONFIG_SITE for pvAccess itself).
+ *
+ @code
+   MB_DECLARE(getTrace, 65536);       // at file scope, in one source file
+   MB_DECLARE_EXTERN(getTrace);       // in others
+
+   MB_INC_AUTO_ID(getTrace);          // start a new sample on this thread
+   MB_POINT(getTrace, 0, "start");
+   ...
+   MB_POINT(getTrace, 1, "done");
+   // or, where one sample crosses threads, with an ID known to all
+   MB_POINT_ID(getTrace, 2, "sent", ioid);
+
+   MB_STATS(getTrace, std::cout);     // time between consecutive stages of each ID
+   MB_CSV_EXPORT(getTrace, file);
+ @endcode
+ */
+
+namespace epics {
+namespace pvAccess {
+namespace MB {
+
+epicsShareFunc epicsUInt64 clockTicks();
+
+/** A fast, monotonic, counter.  The TSC where available.
+ *  Assumes an invariant TSC, synchronized between cores, as on current x86.
+ */
+static inline epicsUInt64 ticks()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#else
+    return clockTicks();
+#endif
+}
+
+//! Rate of ticks(), measured by the first call
+epicsShareFunc double ticksPerSecond();
+
+/** Trace points of many threads.
+ *
+ * Each thread records into its own ring buffer of the last size points,
+ * without locking.  Export while the threads traced are idle, otherwise
+ * points being overwritten may be seen.
+ */
+class epicsShareClass Trace
+{
+public:
+    enum { maxStages = 256 };
+
+    struct Point {
+        epicsUInt64 ticks;
+        epicsUInt64 id;
+        epicsUInt32 stage;
+        epicsUInt32 thread; //!< index of the ring, in order of first use
+    };
+
+    //! @param size Points kept by each thread, rounded up to a power of 2
+    Trace(const char *name, size_t size);
+    ~Trace();
+
+    const char *name() const { return traceName; }
+
+    void point(unsigned stage, const char *desc, epicsUInt64 id)
+    {
+        Ring *R = static_cast<Ring*>(epicsThreadPrivateGet(key));
+        if(!R)
+            R = attach();
+        Point& P = R->points[R->count & R->mask];
+        P.ticks = ticks();
+        P.id = id;
+        P.stage = stage;
+        P.thread = R->index;
+        if(stage<maxStages && !descs[stage])
+            descs[stage] = desc;
+        // publish
+#ifdef PVA_MB_USE_ATOMIC
+        epics::atomic::increment(R->count);
+#else
+        // without a barrier, points are only reliable once the thread is idle
+        R->count++;
+#endif
+    }
+
+    //! with the ID of this thread
+    void point(unsigned stage, const char *desc)
+    {
+        Ring *R = static_cast<Ring*>(epicsThreadPrivateGet(key));
+        point(stage, desc, R ? R->autoId : 0u);
+    }
+
+    //! Start a new sample on this thread, with an ID unique in this Trace
+    void incAutoId();
+
+    //! Export times since the first point of each ID, instead of since the Trace was created
+    void normalize() { normalized = true; }
+
+    //! Copy points, in time order.  Without the first skip of each stage, and only stageOnly if >=0.
+    void snapshot(std::vector<Point>& points, int stageOnly=-1, size_t skip=0u) const;
+
+    //! For each pair of consecutive stages of an ID, the count, min, mean and max time between them.
+    void stats(std::ostream& strm, int stageOnly=-1, size_t skip=0u) const;
+    //! Each point, one per line
+    void print(std::ostream& strm, int stageOnly=-1, size_t skip=0u) const;
+    //! "thread,id,stage,ns" lines, after a header line
+    void csvExport(std::ostream& strm, int stageOnly=-1, size_t skip=0u) const;
+    //! Add points exported by csvExport(), eg. to compute stats() of another process
+    void csvImport(std::istream& strm);
+    //! {"name":..., "stages":{...}, "points":[[thread,id,stage,ns], ...]}
+    void jsonExport(std::ostream& strm, int stageOnly=-1, size_t skip=0u) const;
+
+private:
+    struct Ring {
+        std::vector<Point> points;
+        size_t mask;
+        size_t count; // points recorded.  written only by its thread
+        epicsUInt64 autoId;
+        epicsUInt32 index;
+    };
+
+    Ring *attach();
+    double exportTime(const Point& P, epicsUInt64 first) const;
+
+    const char * const traceName;
+    const size_t size;
+    const epicsUInt64 created;
+    const epicsThreadPrivateId key;
+    size_t nextId;
+    bool normalized;
+    const char *descs[maxStages];
+
+    mutable epicsMutex lock;
+    std::vector<Ring*> rings;
+
+    Trace(const Trace&);
+    Trace& operator=(const Trace&);
+};
+
+}}} // namespace epics::pvAccess::MB
+
+#ifdef PV_MB
+
+#define MB_DECLARE(NAME, SIZE) ::epics::pvAccess::MB::Trace NAME##_mb(#NAME, SIZE)
+#define MB_DECLARE_EXTERN(NAME) extern ::epics::pvAccess::MB::Trace NAME##_mb
+
+#define MB_POINT_ID(NAME, STAGE, STAGE_DESC, ID) NAME##_mb.point(STAGE, STAGE_DESC, ID)
+
+#define MB_INC_AUTO_ID(NAME) NAME##_mb.incAutoId()
+#define MB_POINT(NAME, STAGE, STAGE_DESC) NAME##_mb.point(STAGE, STAGE_DESC)
+
+#define MB_POINT_CONDITIONAL(NAME, STAGE, STAGE_DESC, COND) \
+    do { if(COND) NAME##_mb.point(STAGE, STAGE_DESC); } while(0)
+
+#define MB_NORMALIZE(NAME) NAME##_mb.normalize()
+
+#define MB_STATS(NAME, STREAM) NAME##_mb.stats(STREAM)
+#define MB_STATS_OPT(NAME, STAGE_ONLY, SKIP_FIRST_N_SAMPLES, STREAM) NAME##_mb.stats(STREAM, STAGE_ONLY, SKIP_FIRST_N_SAMPLES)
+
+#define MB_CSV_EXPORT(NAME, STREAM) NAME##_mb.csvExport(STREAM)
+#define MB_CSV_EXPORT_OPT(NAME, STAGE_ONLY, SKIP_FIRST_N_SAMPLES, STREAM) NAME##_mb.csvExport(STREAM, STAGE_ONLY, SKIP_FIRST_N_SAMPLES)
+#define MB_CSV_IMPORT(NAME, STREAM) NAME##_mb.csvImport(STREAM)
+
+#define MB_JSON_EXPORT(NAME, STREAM) NAME##_mb.jsonExport(STREAM)
+
+#define MB_PRINT(NAME, STREAM) NAME##_mb.print(STREAM)
+#define MB_PRINT_OPT(NAME, STAGE_ONLY, SKIP_FIRST_N_SAMPLES, STREAM) NAME##_mb.print(STREAM, STAGE_ONLY, SKIP_FIRST_N_SAMPLES)
+
+//! Measure ticksPerSecond() now, instead of at the first export
+#define MB_INIT ((void)::epics::pvAccess::MB::ticksPerSecond())
+
+#else // PV_MB
 
 #define MB_DECLARE(NAME, SIZE)
 #define MB_DECLARE_EXTERN(NAME)
@@ -28,9 +238,13 @@
 #define MB_CSV_EXPORT_OPT(NAME, STAGE_ONLY, SKIP_FIRST_N_SAMPLES, STREAM)
 #define MB_CSV_IMPORT(NAME, STREAM)
 
+#define MB_JSON_EXPORT(NAME, STREAM)
+
 #define MB_PRINT(NAME, STREAM)
 #define MB_PRINT_OPT(NAME, STAGE_ONLY, SKIP_FIRST_N_SAMPLES, STREAM)
 
 #define MB_INIT
 
+#endif // PV_MB
+
 #endif
@@ -0,0 +1,317 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <map>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <epicsTime.h>
+#include <epicsGuard.h>
+#include <epicsStdio.h>
+
+#define epicsExportSharedSymbols
+#include <pv/pvAccessMB.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+namespace MB {
+
+namespace {
+
+size_t roundUp(size_t size)
+{
+    size_t ret = 16u;
+    while(ret < size && ret < (size_t(1u)<<28))
+        ret <<= 1;
+    return ret;
+}
+
+epicsThreadOnceId calibrateOnce = EPICS_THREAD_ONCE_INIT;
+double tickRate;
+
+void calibrate(void*)
+{
+    epicsTimeStamp start, end;
+    epicsTimeGetCurrent(&start);
+    const epicsUInt64 t0 = ticks();
+    epicsThreadSleep(0.02);
+    const epicsUInt64 t1 = ticks();
+    epicsTimeGetCurrent(&end);
+
+    const double elapsed = epicsTimeDiffInSeconds(&end, &start);
+    tickRate = elapsed>0.0 ? double(t1-t0)/elapsed : 1e9;
+}
+
+bool byTicks(const Trace::Point& lhs, const Trace::Point& rhs)
+{
+    return lhs.ticks < rhs.ticks;
+}
+
+struct Accumulator {
+    size_t count;
+    double sum, min, max;
+    Accumulator() :count(0u), sum(0.0), min(std::numeric_limits<double>::max()), max(0.0) {}
+    void add(double v) {
+        count++;
+        sum += v;
+        min = std::min(min, v);
+        max = std::max(max, v);
+    }
+};
+
+} // namespace
+
+epicsUInt64 clockTicks()
+{
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    return epicsUInt64(now.secPastEpoch)*1000000000u + now.nsec;
+}
+
+double ticksPerSecond()
+{
+    epicsThreadOnce(&calibrateOnce, &calibrate, 0);
+    return tickRate;
+}
+
+Trace::Trace(const char *name, size_t size)
+    :traceName(name)
+    ,size(roundUp(size))
+    ,created(ticks())
+    ,key(epicsThreadPrivateCreate())
+    ,nextId(0u)
+    ,normalized(false)
+{
+    memset(descs, 0, sizeof(descs));
+}
+
+Trace::~Trace()
+{
+    // threads which recorded may still hold their Ring in key
+    for(size_t i=0; i<rings.size(); i++)
+        delete rings[i];
+}
+
+Trace::Ring* Trace::attach()
+{
+    Ring *R = new Ring;
+    R->points.resize(size);
+    R->mask = size-1u;
+    R->count = 0u;
+    R->autoId = 0u;
+    {
+        Guard G(lock);
+        R->index = epicsUInt32(rings.size());
+        rings.push_back(R);
+    }
+    epicsThreadPrivateSet(key, R);
+    return R;
+}
+
+void Trace::incAutoId()
+{
+    Ring *R = static_cast<Ring*>(epicsThreadPrivateGet(key));
+    if(!R)
+        R = attach();
+#ifdef PVA_MB_USE_ATOMIC
+    R->autoId = epics::atomic::increment(nextId);
+#else
+    Guard G(lock);
+    R->autoId = ++nextId;
+#endif
+}
+
+void Trace::snapshot(std::vector<Point>& points, int stageOnly, size_t skip) const
+{
+    points.clear();
+    {
+        Guard G(lock);
+        for(size_t i=0; i<rings.size(); i++) {
+            const Ring& R = *rings[i];
+#ifdef PVA_MB_USE_ATOMIC
+            const size_t count = epics::atomic::get(const_cast<Ring&>(R).count);
+#else
+            const size_t count = R.count;
+#endif
+            const size_t n = std::min(count, R.points.size());
+            for(size_t p=count-n; p<count; p++)
+                points.push_back(R.points[p & R.mask]);
+        }
+    }
+    std::stable_sort(points.begin(), points.end(), byTicks);
+
+    if(stageOnly<0 && !skip)
+        return;
+
+    std::vector<size_t> seen(maxStages, 0u);
+    size_t out = 0u;
+    for(size_t i=0; i<points.size(); i++) {
+        const Point& P = points[i];
+        if(stageOnly>=0 && P.stage!=unsigned(stageOnly))
+            continue;
+        if(P.stage<maxStages && seen[P.stage]++ < skip)
+            continue;
+        points[out++] = P;
+    }
+    points.resize(out);
+}
+
+double Trace::exportTime(const Point& P, epicsUInt64 first) const
+{
+    const epicsUInt64 origin = normalized ? first : created;
+    return P.ticks>=origin ? double(P.ticks-origin)/ticksPerSecond() : -double(origin-P.ticks)/ticksPerSecond();
+}
+
+void Trace::stats(std::ostream& strm, int stageOnly, size_t skip) const
+{
+    std::vector<Point> points;
+    snapshot(points, -1, skip);
+
+    // previous point of each ID
+    std::map<epicsUInt64, const Point*> last;
+    // by (from, to) stage
+    typedef std::map<std::pair<epicsUInt32, epicsUInt32>, Accumulator> accs_t;
+    accs_t accs;
+
+    const double scale = 1e6/ticksPerSecond();
+
+    for(size_t i=0; i<points.size(); i++) {
+        const Point& P = points[i];
+        const Point*& prev = last[P.id];
+        if(prev && (stageOnly<0 || P.stage==unsigned(stageOnly)))
+            accs[std::make_pair(prev->stage, P.stage)].add(double(P.ticks-prev->ticks)*scale);
+        prev = &P;
+    }
+
+    strm<<"Trace "<<traceName<<", "<<points.size()<<" points.  us between stages of an ID\n";
+    for(accs_t::const_iterator it(accs.begin()), end(accs.end()); it!=end; ++it) {
+        const Accumulator& A = it->second;
+        const char *from = it->first.first<maxStages ? descs[it->first.first] : 0,
+                   *to = it->first.second<maxStages ? descs[it->first.second] : 0;
+        char line[128];
+        epicsSnprintf(line, sizeof(line), "%3u -> %3u  count %8lu  min %10.3f  mean %10.3f  max %10.3f",
+                      unsigned(it->first.first), unsigned(it->first.second), (unsigned long)A.count,
+                      A.min, A.sum/A.count, A.max);
+        strm<<line<<"  "<<(from ? from : "?")<<" -> "<<(to ? to : "?")<<"\n";
+    }
+}
+
+void Trace::print(std::ostream& strm, int stageOnly, size_t skip) const
+{
+    std::vector<Point> points;
+    snapshot(points, stageOnly, skip);
+
+    std::map<epicsUInt64, epicsUInt64> first;
+    for(size_t i=0; i<points.size(); i++)
+        first.insert(std::make_pair(points[i].id, points[i].ticks));
+
+    for(size_t i=0; i<points.size(); i++) {
+        const Point& P = points[i];
+        const char *desc = P.stage<maxStages ? descs[P.stage] : 0;
+        char line[96];
+        epicsSnprintf(line, sizeof(line), "%s thread %u id %llu stage %u %.9f ",
+                      traceName, unsigned(P.thread), (unsigned long long)P.id, unsigned(P.stage),
+                      exportTime(P, first[P.id]));
+        strm<<line<<(desc ? desc : "")<<"\n";
+    }
+}
+
+void Trace::csvExport(std::ostream& strm, int stageOnly, size_t skip) const
+{
+    std::vector<Point> points;
+    snapshot(points, stageOnly, skip);
+
+    std::map<epicsUInt64, epicsUInt64> first;
+    for(size_t i=0; i<points.size(); i++)
+        first.insert(std::make_pair(points[i].id, points[i].ticks));
+
+    strm<<"thread,id,stage,ns\n";
+    for(size_t i=0; i<points.size(); i++) {
+        const Point& P = points[i];
+        char line[96];
+        epicsSnprintf(line, sizeof(line), "%u,%llu,%u,%.0f\n",
+                      unsigned(P.thread), (unsigned long long)P.id, unsigned(P.stage),
+                      exportTime(P, first[P.id])*1e9);
+        strm<<line;
+    }
+}
+
+void Trace::csvImport(std::istream& strm)
+{
+    Ring *R = new Ring;
+    R->mask = 0u;
+    R->autoId = 0u;
+
+    const double rate = ticksPerSecond();
+    std::string line;
+    while(std::getline(strm, line)) {
+        unsigned thread, stage;
+        unsigned long long id;
+        double ns;
+        if(sscanf(line.c_str(), "%u,%llu,%u,%lf", &thread, &id, &stage, &ns)!=4)
+            continue; // header
+        Point P;
+        P.ticks = created + epicsUInt64(ns*1e-9*rate);
+        P.id = id;
+        P.stage = stage;
+        P.thread = thread;
+        R->points.push_back(P);
+    }
+
+    // a ring which has not wrapped, so snapshot() copies exactly the points imported
+    R->count = R->points.size();
+    R->points.resize(roundUp(R->count));
+    R->mask = R->points.size()-1u;
+
+    Guard G(lock);
+    R->index = epicsUInt32(rings.size());
+    rings.push_back(R);
+}
+
+void Trace::jsonExport(std::ostream& strm, int stageOnly, size_t skip) const
+{
+    std::vector<Point> points;
+    snapshot(points, stageOnly, skip);
+
+    std::map<epicsUInt64, epicsUInt64> first;
+    for(size_t i=0; i<points.size(); i++)
+        first.insert(std::make_pair(points[i].id, points[i].ticks));
+
+    strm<<"{\"name\":\""<<traceName<<"\",\"stages\":{";
+    bool comma = false;
+    for(unsigned s=0; s<maxStages; s++) {
+        if(!descs[s])
+            continue;
+        strm<<(comma ? "," : "")<<"\""<<s<<"\":\"";
+        // descriptions are literals in the source, escape only what JSON requires
+        for(const char *c=descs[s]; *c; c++) {
+            if(*c=='"' || *c=='\\')
+                strm<<'\\';
+            strm<<*c;
+        }
+        strm<<"\"";
+        comma = true;
+    }
+    strm<<"},\"points\":[";
+    for(size_t i=0; i<points.size(); i++) {
+        const Point& P = points[i];
+        char line[96];
+        epicsSnprintf(line, sizeof(line), "%s[%u,%llu,%u,%.0f]", i ? "," : "",
+                      unsigned(P.thread), (unsigned long long)P.id, unsigned(P.stage),
+                      exportTime(P, first[P.id])*1e9);
+        strm<<line;
+    }
+    strm<<"]}\n";
+}
+
+}}} // namespace epics::pvAccess::MB
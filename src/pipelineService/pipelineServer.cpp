@@ -5,6 +5,7 @@
  */
 
 #include <stdexcept>
+#include <algorithm>
 #include <vector>
 #include <queue>
 #include <utility>
@@ -273,6 +274,35 @@ public:
         }
     }
 
+    virtual size_t getFreeElements(size_t count, std::vector<MonitorElement::shared_pointer>& elements) {
+        Lock guard(m_freeQueueLock);
+        size_t n = std::min(count, m_freeQueue.size());
+        elements.insert(elements.end(), m_freeQueue.end() - n, m_freeQueue.end());
+        m_freeQueue.resize(m_freeQueue.size() - n);
+        return n;
+    }
+
+    virtual void putElements(std::vector<MonitorElement::shared_pointer> const & elements) {
+
+        bool notify = false;
+        {
+            Lock guard(m_monitorQueueLock);
+            if (m_done || elements.empty())
+                return;
+
+            for (size_t i = 0; i < elements.size(); i++)
+                m_monitorQueue.push(elements[i]);
+            notify = (m_requestedCount != 0);
+        }
+
+        // one notification for all
+        if (notify)
+        {
+            Monitor::shared_pointer thisPtr = shared_from_this();
+            m_monitorRequester->monitorEvent(thisPtr);
+        }
+    }
+
     virtual void done() {
         Lock guard(m_monitorQueueLock);
         m_done = true;
@@ -519,17 +549,16 @@ public:
     {
         PipelineService::shared_pointer service;
 
-        PipelineServiceMap::const_iterator iter;
         {
             Lock guard(m_mutex);
-            iter = m_services.find(channelName);
-        }
-        if (iter != m_services.end())
-            service = iter->second;
+            PipelineServiceMap::const_iterator iter = m_services.find(channelName);
+            if (iter != m_services.end())
+                service = iter->second;
 
-        // check for wild services
-        if (!service)
-            service = findWildService(channelName);
+            // check for wild services
+            if (!service)
+                service = findWildService(channelName);
+        }
 
         if (!service)
         {
@@ -566,7 +595,7 @@ public:
         m_services[serviceName] = service;
 
         if (isWildcardPattern(serviceName))
-            m_wildServices.push_back(std::make_pair(serviceName, service));
+            m_wildServices.add(serviceName);
     }
 
     void unregisterService(std::string const & serviceName)
@@ -575,28 +604,19 @@ public:
         m_services.erase(serviceName);
 
         if (isWildcardPattern(serviceName))
-        {
-            for (PipelineWildServiceList::iterator iter = m_wildServices.begin();
-                    iter != m_wildServices.end();
-                    iter++)
-                if (iter->first == serviceName)
-                {
-                    m_wildServices.erase(iter);
-                    break;
-                }
-        }
+            m_wildServices.remove(serviceName);
     }
 
 private:
     // assumes sync on services
     PipelineService::shared_pointer findWildService(string const & wildcard)
     {
-        if (!m_wildServices.empty())
-            for (PipelineWildServiceList::iterator iter = m_wildServices.begin();
-                    iter != m_wildServices.end();
-                    iter++)
-                if (Wildcard::wildcardfit(iter->first.c_str(), wildcard.c_str()))
-                    return iter->second;
+        string pattern;
+        if (m_wildServices.match(wildcard, &pattern)) {
+            PipelineServiceMap::const_iterator iter = m_services.find(pattern);
+            if (iter != m_services.end())
+                return iter->second;
+        }
 
         return PipelineService::shared_pointer();
     }
@@ -613,8 +633,8 @@ private:
     typedef std::map<string, PipelineService::shared_pointer> PipelineServiceMap;
     PipelineServiceMap m_services;
 
-    typedef std::vector<std::pair<string, PipelineService::shared_pointer> > PipelineWildServiceList;
-    PipelineWildServiceList m_wildServices;
+    // patterns of the wildcard names in m_services
+    WildcardSet m_wildServices;
 
     epics::pvData::Mutex m_mutex;
 };
@@ -664,6 +684,13 @@ void PipelineServer::registerService(std::string const & serviceName, PipelineSe
     m_channelProviderImpl->registerService(serviceName, service);
 }
 
+void PipelineServer::registerService(std::string const & serviceName, PipelineService::shared_pointer const & service,
+                                     SharedPipelineService::SlowConsumerPolicy policy)
+{
+    m_channelProviderImpl->registerService(serviceName,
+        PipelineService::shared_pointer(new SharedPipelineService(service, policy)));
+}
+
 void PipelineServer::unregisterService(std::string const & serviceName)
 {
     m_channelProviderImpl->unregisterService(serviceName);
@@ -4,5 +4,71 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <sstream>
+
+#include <pv/pvData.h>
+
 #define epicsExportSharedSymbols
 #include <pv/pipelineService.h>
+
+namespace pvd = epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+size_t PipelineControl::getFreeElements(size_t count, std::vector<MonitorElement::shared_pointer>& elements)
+{
+    size_t n = 0;
+    for (; n < count; n++) {
+        MonitorElement::shared_pointer element(getFreeElement());
+        if (!element)
+            break;
+        elements.push_back(element);
+    }
+    return n;
+}
+
+void PipelineControl::putElements(std::vector<MonitorElement::shared_pointer> const & elements)
+{
+    for (size_t i = 0; i < elements.size(); i++)
+        putElement(elements[i]);
+}
+
+PipelineSession::shared_pointer StreamingRPCService::createPipeline(
+        pvd::PVStructure::shared_pointer const & pvRequest)
+{
+    pvd::PVStructure::shared_pointer args(pvRequest->getSubField<pvd::PVStructure>("args"));
+    if (!args)
+        args = pvd::getPVDataCreate()->createPVStructure(pvd::getFieldCreate()->createStructure());
+    return createStream(args, pvRequest);
+}
+
+pvd::PVStructure::shared_pointer createStreamRequest(
+        pvd::PVStructure::const_shared_pointer const & args,
+        size_t queueSize)
+{
+    pvd::FieldBuilderPtr builder(pvd::getFieldCreate()->createFieldBuilder());
+    builder = builder->addNestedStructure("record")
+                         ->addNestedStructure("_options")
+                             ->add("queueSize", pvd::pvString)
+                             ->add("pipeline", pvd::pvString)
+                         ->endNested()
+                     ->endNested()
+                     ->addNestedStructure("field")
+                     ->endNested();
+    if (args)
+        builder = builder->add("args", args->getStructure());
+
+    pvd::PVStructure::shared_pointer ret(pvd::getPVDataCreate()->createPVStructure(builder->createStructure()));
+
+    std::ostringstream strm;
+    strm << queueSize;
+    ret->getSubFieldT<pvd::PVString>("record._options.queueSize")->put(strm.str());
+    ret->getSubFieldT<pvd::PVString>("record._options.pipeline")->put("true");
+    if (args)
+        ret->getSubFieldT<pvd::PVStructure>("args")->copyUnchecked(*args);
+    return ret;
+}
+
+}
+}
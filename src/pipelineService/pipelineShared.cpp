@@ -0,0 +1,423 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <map>
+
+#include <pv/pvData.h>
+
+#define epicsExportSharedSymbols
+#include <pv/pipelineShared.h>
+
+using namespace epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+/* The session of the wrapped service, and the clients of it.
+ * Is the PipelineControl of the wrapped session, and copies each element
+ * it is given into an element of the PipelineControl of each client.
+ */
+struct SharedPipelineService::Hub :
+    public PipelineControl,
+    public std::tr1::enable_shared_from_this<SharedPipelineService::Hub>
+{
+    POINTER_DEFINITIONS(Hub);
+
+    struct Consumer {
+        POINTER_DEFINITIONS(Consumer);
+        // the ChannelPipelineMonitorImpl of the client, known after its first request()
+        std::tr1::weak_ptr<PipelineControl> control;
+        // with Block, elements not yet copied to this client, oldest first
+        std::deque<MonitorElement::shared_pointer> owed;
+        size_t delivered, dropped;
+        bool doneReported;
+        Consumer() :delivered(0u), dropped(0u), doneReported(false) {}
+    };
+    typedef std::vector<Consumer::shared_pointer> consumers_t;
+    // for each element in the owed queues, the number of clients owed a copy
+    typedef std::map<const MonitorElement*, size_t> pending_t;
+
+    const SlowConsumerPolicy policy;
+    const Structure::const_shared_pointer structure;
+    const size_t minQueueSize;
+
+    // guards all below
+    Mutex mutex;
+    // released after the last client cancels
+    PipelineSession::shared_pointer session;
+    consumers_t consumers;
+    std::vector<MonitorElement::shared_pointer> pool;
+    pending_t pending;
+    bool isDone;
+
+    // serializes calls of session->request()
+    Mutex requestMutex;
+
+    Hub(const PipelineSession::shared_pointer& session, SlowConsumerPolicy policy)
+        :policy(policy)
+        ,structure(session->getStructure())
+        ,minQueueSize(session->getMinQueueSize())
+        ,session(session)
+        ,isDone(false)
+    {
+        size_t queueSize = std::max(minQueueSize, size_t(2u));
+        pool.reserve(queueSize);
+        for (size_t i = 0; i < queueSize; i++)
+        {
+            MonitorElement::shared_pointer element(new MonitorElement(getPVDataCreate()->createPVStructure(structure)));
+            // we always send all
+            element->changedBitSet->set(0);
+            pool.push_back(element);
+        }
+    }
+    virtual ~Hub() {}
+
+    bool finished()
+    {
+        Lock guard(mutex);
+        return isDone || !session;
+    }
+
+    Consumer::shared_pointer addConsumer()
+    {
+        Consumer::shared_pointer C(new Consumer);
+        Lock guard(mutex);
+        consumers.push_back(C);
+        return C;
+    }
+
+    void removeConsumer(const Consumer::shared_pointer& C)
+    {
+        PipelineSession::shared_pointer cancel;
+        bool wasDone;
+        {
+            Lock guard(mutex);
+            consumers_t::iterator it(std::find(consumers.begin(), consumers.end(), C));
+            if (it == consumers.end())
+                return;
+            consumers.erase(it);
+
+            for (size_t i = 0; i < C->owed.size(); i++)
+                releaseOwed(C->owed[i]);
+            C->owed.clear();
+
+            if (consumers.empty()) {
+                // also breaks the reference cycle if the session keeps its PipelineControl
+                cancel.swap(session);
+            }
+            wasDone = isDone;
+        }
+        if (cancel && !wasDone)
+            cancel->cancel();
+    }
+
+    // call with mutex locked
+    static bool deliver(const PipelineControl::shared_pointer& control, const MonitorElement::shared_pointer& element)
+    {
+        MonitorElement::shared_pointer copy(control->getFreeElement());
+        if (!copy)
+            return false;
+        copy->pvStructurePtr->copyUnchecked(*element->pvStructurePtr);
+        control->putElement(copy);
+        return true;
+    }
+
+    // call with mutex locked
+    void releaseOwed(const MonitorElement::shared_pointer& element)
+    {
+        pending_t::iterator it(pending.find(element.get()));
+        if (it == pending.end())
+            return;
+        if (--it->second == 0u) {
+            pending.erase(it);
+            pool.push_back(element);
+        }
+    }
+
+    void request(const Consumer::shared_pointer& C, const PipelineControl::shared_pointer& control, size_t elementCount)
+    {
+        bool reportDone = false;
+        PipelineSession::shared_pointer S;
+        {
+            Lock guard(mutex);
+            C->control = control;
+
+            while (!C->owed.empty() && deliver(control, C->owed.front())) {
+                C->delivered++;
+                releaseOwed(C->owed.front());
+                C->owed.pop_front();
+            }
+
+            if (isDone)
+                reportDone = C->owed.empty() && !C->doneReported;
+            else
+                S = session;
+            if (reportDone)
+                C->doneReported = true;
+        }
+
+        if (reportDone)
+            control->done();
+
+        if (S) {
+            Lock guard(requestMutex);
+            S->request(shared_from_this(), elementCount);
+        }
+    }
+
+    // free or requested count of the slowest (Block) or fastest (Drop) client.  Call with mutex locked
+    size_t limit(bool freeCount)
+    {
+        bool first = true;
+        size_t ret = 0u;
+        for (size_t i = 0; i < consumers.size(); i++) {
+            Consumer& C = *consumers[i];
+            PipelineControl::shared_pointer control(C.control.lock());
+            size_t n = 0u;
+            if (control) {
+                n = freeCount ? control->getFreeElementCount() : control->getRequestedCount();
+                n = n > C.owed.size() ? n - C.owed.size() : 0u;
+            }
+            if (first)
+                ret = n;
+            else if (policy == Block)
+                ret = std::min(ret, n);
+            else
+                ret = std::max(ret, n);
+            first = false;
+        }
+        return ret;
+    }
+
+    virtual size_t getFreeElementCount() OVERRIDE FINAL
+    {
+        Lock guard(mutex);
+        return std::min(limit(true), pool.size());
+    }
+
+    virtual size_t getRequestedCount() OVERRIDE FINAL
+    {
+        Lock guard(mutex);
+        return limit(false);
+    }
+
+    virtual MonitorElement::shared_pointer getFreeElement() OVERRIDE FINAL
+    {
+        Lock guard(mutex);
+        MonitorElement::shared_pointer element;
+        if (!pool.empty()) {
+            element = pool.back();
+            pool.pop_back();
+        }
+        return element;
+    }
+
+    virtual void putElement(MonitorElement::shared_pointer const & element) OVERRIDE FINAL
+    {
+        // client queues only lock themselves, so their PipelineControl is called with our mutex locked
+        Lock guard(mutex);
+        size_t owed = 0u;
+        if (!isDone) {
+            for (size_t i = 0; i < consumers.size(); i++) {
+                Consumer& C = *consumers[i];
+                PipelineControl::shared_pointer control(C.control.lock());
+                if (C.owed.empty() && control && deliver(control, element)) {
+                    C.delivered++;
+                } else if (policy == Drop) {
+                    C.dropped++;
+                } else {
+                    C.owed.push_back(element);
+                    owed++;
+                }
+            }
+        }
+        if (owed)
+            pending[element.get()] = owed;
+        else
+            pool.push_back(element);
+    }
+
+    virtual size_t getFreeElements(size_t count, std::vector<MonitorElement::shared_pointer>& elements) OVERRIDE FINAL
+    {
+        Lock guard(mutex);
+        size_t n = std::min(count, pool.size());
+        elements.insert(elements.end(), pool.end() - n, pool.end());
+        pool.resize(pool.size() - n);
+        return n;
+    }
+
+    virtual void putElements(std::vector<MonitorElement::shared_pointer> const & elements) OVERRIDE FINAL
+    {
+        Lock guard(mutex);
+        std::vector<size_t> owed(elements.size(), 0u);
+        if (!isDone) {
+            std::vector<MonitorElement::shared_pointer> copies;
+            for (size_t i = 0; i < consumers.size(); i++) {
+                Consumer& C = *consumers[i];
+                PipelineControl::shared_pointer control(C.control.lock());
+
+                // copies are taken only while nothing is owed, and all are used
+                copies.clear();
+                if (control && C.owed.empty())
+                    control->getFreeElements(elements.size(), copies);
+
+                size_t used = 0u;
+                for (size_t e = 0; e < elements.size(); e++) {
+                    if (used < copies.size()) {
+                        copies[used++]->pvStructurePtr->copyUnchecked(*elements[e]->pvStructurePtr);
+                        C.delivered++;
+                    } else if (policy == Drop) {
+                        C.dropped++;
+                    } else {
+                        C.owed.push_back(elements[e]);
+                        owed[e]++;
+                    }
+                }
+                if (used)
+                    control->putElements(copies);
+            }
+        }
+        for (size_t e = 0; e < elements.size(); e++) {
+            if (owed[e])
+                pending[elements[e].get()] = owed[e];
+            else
+                pool.push_back(elements[e]);
+        }
+    }
+
+    virtual void done() OVERRIDE FINAL
+    {
+        std::vector<PipelineControl::shared_pointer> notify;
+        {
+            Lock guard(mutex);
+            isDone = true;
+            for (size_t i = 0; i < consumers.size(); i++) {
+                Consumer& C = *consumers[i];
+                PipelineControl::shared_pointer control(C.control.lock());
+                // the others are told once they have all elements
+                if (control && C.owed.empty() && !C.doneReported) {
+                    C.doneReported = true;
+                    notify.push_back(control);
+                }
+            }
+        }
+        for (size_t i = 0; i < notify.size(); i++)
+            notify[i]->done();
+    }
+
+    void show(std::ostream& strm)
+    {
+        Lock guard(mutex);
+        strm << (isDone ? "done" : "active") << ", " << consumers.size() << " clients, "
+             << pool.size() << " free elements\n";
+        for (size_t i = 0; i < consumers.size(); i++) {
+            const Consumer& C = *consumers[i];
+            strm << "  client " << i << " delivered " << C.delivered
+                 << " dropped " << C.dropped
+                 << " waiting " << C.owed.size() << "\n";
+        }
+    }
+};
+
+namespace {
+
+// the session of one client
+struct SharedSession : public PipelineSession
+{
+    const SharedPipelineService::Hub::shared_pointer hub;
+    const SharedPipelineService::Hub::Consumer::shared_pointer consumer;
+
+    SharedSession(const SharedPipelineService::Hub::shared_pointer& hub)
+        :hub(hub)
+        ,consumer(hub->addConsumer())
+    {}
+    virtual ~SharedSession()
+    {
+        // the client does not cancel after done()
+        hub->removeConsumer(consumer);
+    }
+
+    virtual size_t getMinQueueSize() const OVERRIDE FINAL
+    {
+        return hub->minQueueSize;
+    }
+
+    virtual Structure::const_shared_pointer getStructure() const OVERRIDE FINAL
+    {
+        return hub->structure;
+    }
+
+    virtual void request(PipelineControl::shared_pointer const & control, size_t elementCount) OVERRIDE FINAL
+    {
+        hub->request(consumer, control, elementCount);
+    }
+
+    virtual void cancel() OVERRIDE FINAL
+    {
+        hub->removeConsumer(consumer);
+    }
+};
+
+} // namespace
+
+SharedPipelineService::SharedPipelineService(PipelineService::shared_pointer const & backend,
+                                             SlowConsumerPolicy policy)
+    :m_backend(backend)
+    ,m_policy(policy)
+{
+    if (!backend)
+        throw std::invalid_argument("SharedPipelineService requires a backend service");
+}
+
+SharedPipelineService::~SharedPipelineService() {}
+
+PipelineSession::shared_pointer SharedPipelineService::createPipeline(
+        PVStructure::shared_pointer const & pvRequest)
+{
+    Lock guard(m_mutex);
+    Hub::shared_pointer hub(m_hub.lock());
+    if (!hub || hub->finished()) {
+        PipelineSession::shared_pointer session(m_backend->createPipeline(pvRequest));
+        if (!session)
+            throw std::logic_error("PipelineService::createPipeline() returned null");
+        hub.reset(new Hub(session, m_policy));
+        m_hub = hub;
+    }
+    return PipelineSession::shared_pointer(new SharedSession(hub));
+}
+
+size_t SharedPipelineService::getConsumerCount()
+{
+    Hub::shared_pointer hub;
+    {
+        Lock guard(m_mutex);
+        hub = m_hub.lock();
+    }
+    if (!hub)
+        return 0u;
+    Lock guard(hub->mutex);
+    return hub->consumers.size();
+}
+
+void SharedPipelineService::show(std::ostream& strm)
+{
+    Hub::shared_pointer hub;
+    {
+        Lock guard(m_mutex);
+        hub = m_hub.lock();
+    }
+    if (hub)
+        hub->show(strm);
+    else
+        strm << "no session\n";
+}
+
+}
+}
@@ -21,6 +21,7 @@
 
 #include <pv/pvAccess.h>
 #include <pv/pipelineService.h>
+#include <pv/pipelineShared.h>
 #include <pv/serverContext.h>
 
 #include <shareLib.h>
@@ -49,6 +50,14 @@ public:
 
     void registerService(std::string const & serviceName, PipelineService::shared_pointer const & service);
 
+    /** Register a service of which all clients share one session.
+     *
+     * Equivalent to registering a SharedPipelineService wrapping service.
+     * @since 6.1.0
+     */
+    void registerService(std::string const & serviceName, PipelineService::shared_pointer const & service,
+                         SharedPipelineService::SlowConsumerPolicy policy);
+
     void unregisterService(std::string const & serviceName);
 
     void run(int seconds = 0);
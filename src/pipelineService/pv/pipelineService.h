@@ -8,6 +8,7 @@
 #define PIPELINESERVICE_H
 
 #include <stdexcept>
+#include <vector>
 
 #ifdef epicsExportSharedSymbols
 #   define pipelineServiceEpicsExportSharedSymbols
@@ -52,6 +53,17 @@ public:
     /// Put element on the local queue (an element to be sent to a client).
     virtual void putElement(MonitorElement::shared_pointer const & element) = 0;
 
+    /// Grab up to count free elements at once, appended to elements.
+    /// Returns the number of elements grabbed.
+    /// The default calls getFreeElement() for each.
+    /// @since 6.1.0
+    virtual size_t getFreeElements(size_t count, std::vector<MonitorElement::shared_pointer>& elements);
+
+    /// Put elements on the local queue at once, in order, with one notification of the client.
+    /// The default calls putElement() for each.
+    /// @since 6.1.0
+    virtual void putElements(std::vector<MonitorElement::shared_pointer> const & elements);
+
     /// Call to notify that there is no more data to pipelined.
     /// This call destroyes corresponding pipeline session.
     virtual void done() = 0;
@@ -97,6 +109,61 @@ public:
 };
 
 
+/** A pipeline service answering a request with arguments by a stream of elements.
+ *
+ * Like an RPCService, but the result is delivered as it is produced,
+ * in elements put to the PipelineControl of the session, at the pace of the client.
+ * The session calls PipelineControl::done() after the last element.
+ *
+ * The client sends the arguments in the pvRequest of a pipeline monitor,
+ * as made by createStreamRequest().
+ * @since 6.1.0
+ */
+class epicsShareClass StreamingRPCService :
+    public PipelineService
+{
+public:
+    POINTER_DEFINITIONS(StreamingRPCService);
+
+    virtual ~StreamingRPCService() {};
+
+    /** Start a stream.
+     * @param args The arguments of the client, an empty structure if there are none.
+     * @param pvRequest The complete pvRequest.
+     * @throws RPCRequestException, or any std::exception, to fail the request.
+     */
+    virtual PipelineSession::shared_pointer createStream(
+        epics::pvData::PVStructure::shared_pointer const & args,
+        epics::pvData::PVStructure::shared_pointer const & pvRequest
+    ) = 0;
+
+    virtual PipelineSession::shared_pointer createPipeline(
+        epics::pvData::PVStructure::shared_pointer const & pvRequest
+    ) OVERRIDE FINAL;
+};
+
+/** The pvRequest for a pipeline monitor of a StreamingRPCService.
+ *
+ * @code
+ *   pvac::ClientChannel chan(provider.connect("archive"));
+ *   pvac::MonitorSync stream(chan.monitor(createStreamRequest(args)));
+ *   while(stream.wait(5.0)) {
+ *       if(stream.event.event!=pvac::MonitorEvent::Data) break; // Disconnect, Fail, or Cancel at the end
+ *       while(stream.poll())
+ *           process(stream.root);
+ *   }
+ * @endcode
+ *
+ * @param args Arguments passed to StreamingRPCService::createStream().  May be NULL.
+ * @param queueSize Number of elements of the client and server queues.
+ * @since 6.1.0
+ */
+epicsShareFunc
+epics::pvData::PVStructure::shared_pointer createStreamRequest(
+    epics::pvData::PVStructure::const_shared_pointer const & args,
+    size_t queueSize = 16u);
+
+
 }
 }
 
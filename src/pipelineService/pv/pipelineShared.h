@@ -0,0 +1,87 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef PIPELINESHARED_H
+#define PIPELINESHARED_H
+
+#include <ostream>
+
+#ifdef epicsExportSharedSymbols
+#   define pipelineSharedEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/sharedPtr.h>
+#include <pv/lock.h>
+
+#ifdef pipelineSharedEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#	undef pipelineSharedEpicsExportSharedSymbols
+#endif
+
+#include <pv/pipelineService.h>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** Shares one PipelineSession of a service among all of its clients.
+ *
+ * The first client creates the session of the wrapped service, with its pvRequest.
+ * Later clients receive copies of the same elements, until the session is done()
+ * or the last client cancels.  The next client after that starts a new session.
+ *
+ * The PipelineControl given to the wrapped session reports the free and requested
+ * element counts of the slowest client (Block) or of the fastest client (Drop).
+ * With Block, an element which a client has no room for is kept until that
+ * client requests more, and the pool of elements of the session shrinks
+ * until then, so a service which respects getFreeElementCount() waits
+ * for the slowest client.
+ * With Drop, a client with no room misses the element.
+ *
+ * PipelineSession::request() of the wrapped session is called by the thread of
+ * each client which requests more elements, but never concurrently.
+ * @since 6.1.0
+ */
+class epicsShareClass SharedPipelineService :
+    public PipelineService
+{
+public:
+    POINTER_DEFINITIONS(SharedPipelineService);
+
+    enum SlowConsumerPolicy {
+        Block, //!< Wait for the slowest client
+        Drop,  //!< Clients with a full queue miss elements
+    };
+
+    SharedPipelineService(PipelineService::shared_pointer const & backend,
+                          SlowConsumerPolicy policy = Block);
+    virtual ~SharedPipelineService();
+
+    virtual PipelineSession::shared_pointer createPipeline(
+        epics::pvData::PVStructure::shared_pointer const & pvRequest
+    ) OVERRIDE FINAL;
+
+    //! Number of clients of the current session
+    size_t getConsumerCount();
+
+    //! One line for each client: elements delivered, dropped and waiting
+    void show(std::ostream& strm);
+
+    struct Hub;
+private:
+    const PipelineService::shared_pointer m_backend;
+    const SlowConsumerPolicy m_policy;
+
+    epics::pvData::Mutex m_mutex;
+    std::tr1::weak_ptr<Hub> m_hub;
+};
+
+}
+}
+
+#endif  /* PIPELINESHARED_H */
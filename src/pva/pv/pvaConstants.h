@@ -57,6 +57,9 @@ const epics::pvData::int32 MAX_UDP_RECV = 65487;
 /** TCP maximum receive message size. */
 const epics::pvData::int32 MAX_TCP_RECV = 1024*16;
 
+/** Default ceiling to which a TCP receive window may grow.  See EPICS_PVA_MAX_TCP_RECV */
+const epics::pvData::int32 MAX_TCP_RECV_WINDOW = 1024*256;
+
 /** Maximum number of search requests in one search message. */
 const epics::pvData::int32 MAX_SEARCH_BATCH_COUNT = 0x7FFF;  // 32767
 
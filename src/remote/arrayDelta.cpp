@@ -0,0 +1,271 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <stdexcept>
+#include <algorithm>
+
+#include <string.h>
+
+#include <pv/serializeHelper.h>
+
+#define epicsExportSharedSymbols
+#include <pv/arrayDelta.h>
+#include <pv/fieldOffsets.h>
+
+namespace pvd = epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+
+// the overhead of a range: its offset and the size of its elements
+const size_t rangeBytes = 10u;
+
+// a numeric array, which can be compared and patched as bytes
+const pvd::PVScalarArray* deltaArray(const pvd::PVField& field)
+{
+    if(field.getField()->getType()!=pvd::scalarArray)
+        return 0;
+    const pvd::PVScalarArray* arr(static_cast<const pvd::PVScalarArray*>(&field));
+    return arr->getScalarArray()->getElementType()==pvd::pvString ? 0 : arr;
+}
+
+size_t elementSize(const pvd::PVScalarArray& arr)
+{
+    return pvd::ScalarTypeFunc::elementSize(arr.getScalarArray()->getElementType());
+}
+
+} // namespace
+
+ArrayDeltaEncoder::ArrayDeltaEncoder() {}
+ArrayDeltaEncoder::~ArrayDeltaEncoder() {}
+
+void ArrayDeltaEncoder::clear()
+{
+    last.clear();
+    ranges.clear();
+    deltas.clear();
+}
+
+bool ArrayDeltaEncoder::prepare(const pvd::PVStructure& value, const pvd::BitSet& changed)
+{
+    deltas.clear();
+    ranges.clear();
+    if(!last.empty())
+        find(value, changed, false);
+    return !deltas.isEmpty();
+}
+
+void ArrayDeltaEncoder::find(const pvd::PVField& field, const pvd::BitSet& changed, bool parentChanged)
+{
+    const size_t offset = field.getFieldOffset();
+    const bool isChanged = parentChanged || changed.get(offset);
+
+    if(field.getField()->getType()==pvd::structure) {
+        // skip structures with nothing changed inside
+        if(!isChanged) {
+            pvd::int32 next = changed.nextSetBit(offset);
+            if(next<0 || size_t(next)>=field.getNextFieldOffset())
+                return;
+        }
+        const pvd::PVFieldPtrArray& subs(static_cast<const pvd::PVStructure&>(field).getPVFields());
+        for(size_t i=0; i<subs.size(); i++)
+            find(*subs[i], changed, isChanged);
+        return;
+    }
+
+    const pvd::PVScalarArray* arr;
+    if(!isChanged || !(arr = deltaArray(field)))
+        return;
+
+    last_t::const_iterator it(last.find(offset));
+    if(it==last.end())
+        return;
+
+    pvd::shared_vector<const void> cur;
+    arr->getAs(cur);
+    const pvd::shared_vector<const void>& prev(it->second);
+    if(cur.size()<minBytes)
+        return;
+
+    const size_t esize = elementSize(*arr),
+                 curLen = cur.size()/esize,
+                 common = std::min(cur.size(), prev.size())/esize;
+    const char *A = static_cast<const char*>(cur.data()),
+               *B = static_cast<const char*>(prev.data());
+
+    // runs of differing elements, joined when separated by less than a range costs
+    const size_t joinGap = rangeBytes/esize + 1u;
+    ranges_t found;
+    size_t cost = 0u;
+    if(A!=B) {
+        for(size_t i=0; i<common; ) {
+            if(memcmp(A+i*esize, B+i*esize, esize)==0) {
+                i++;
+                continue;
+            }
+            size_t end = i+1u;
+            while(end<common && memcmp(A+end*esize, B+end*esize, esize)!=0)
+                end++;
+
+            if(!found.empty() && i - (found.back().first+found.back().second) < joinGap) {
+                found.back().second = end - found.back().first;
+            } else {
+                found.push_back(std::make_pair(i, end-i));
+            }
+            i = end;
+        }
+    }
+    // grown
+    if(curLen>common) {
+        if(!found.empty() && common - (found.back().first+found.back().second) < joinGap) {
+            found.back().second = curLen - found.back().first;
+        } else {
+            found.push_back(std::make_pair(common, curLen-common));
+        }
+    }
+
+    for(size_t i=0; i<found.size(); i++)
+        cost += rangeBytes + found[i].second*esize;
+    if(2u*cost >= cur.size())
+        return;
+
+    deltas.set(offset);
+    ranges[offset].swap(found);
+}
+
+void ArrayDeltaEncoder::remember(const pvd::PVField& field, const pvd::BitSet& changed, bool parentChanged)
+{
+    const size_t offset = field.getFieldOffset();
+    const bool isChanged = parentChanged || changed.get(offset);
+
+    if(field.getField()->getType()==pvd::structure) {
+        if(!isChanged) {
+            pvd::int32 next = changed.nextSetBit(offset);
+            if(next<0 || size_t(next)>=field.getNextFieldOffset())
+                return;
+        }
+        const pvd::PVFieldPtrArray& subs(static_cast<const pvd::PVStructure&>(field).getPVFields());
+        for(size_t i=0; i<subs.size(); i++)
+            remember(*subs[i], changed, isChanged);
+
+    } else if(const pvd::PVScalarArray* arr = isChanged ? deltaArray(field) : 0) {
+        arr->getAs(last[offset]);
+    }
+}
+
+void ArrayDeltaEncoder::serialize(pvd::ByteBuffer *buffer,
+                                  pvd::SerializableControl *control,
+                                  const pvd::PVStructure& value,
+                                  const pvd::BitSet& changed,
+                                  const pvd::BitSet& overrun)
+{
+    changed.serialize(buffer, control);
+    if(deltas.isEmpty()) {
+        serializeChanged(buffer, control, value, changed);
+
+    } else {
+        deltas.serialize(buffer, control);
+        deltaDataBits(value, changed, deltas, data);
+        serializeChanged(buffer, control, value, data);
+
+        for(pvd::int32 offset = deltas.nextSetBit(0); offset>=0; offset = deltas.nextSetBit(offset+1)) {
+            const pvd::PVScalarArray& arr(static_cast<const pvd::PVScalarArray&>(*value.getSubField(offset)));
+            const ranges_t& R(ranges[offset]);
+
+            pvd::SerializeHelper::writeSize(arr.getLength(), buffer, control);
+            pvd::SerializeHelper::writeSize(R.size(), buffer, control);
+            for(size_t i=0; i<R.size(); i++) {
+                pvd::SerializeHelper::writeSize(R[i].first, buffer, control);
+                arr.serialize(buffer, control, R[i].first, R[i].second);
+            }
+        }
+    }
+    overrun.serialize(buffer, control);
+
+    remember(value, changed, false);
+    deltas.clear();
+    ranges.clear();
+}
+
+void deltaDataBits(const pvd::PVStructure& value,
+                   const pvd::BitSet& changed,
+                   const pvd::BitSet& deltas,
+                   pvd::BitSet& data)
+{
+    data = changed;
+
+    std::vector<const pvd::PVField*> path;
+    for(pvd::int32 offset = deltas.nextSetBit(0); offset>=0; offset = deltas.nextSetBit(offset+1)) {
+        pvd::PVFieldPtr field(value.getSubField(offset));
+        if(!field)
+            throw std::runtime_error("array delta of a field which does not exist");
+
+        // the field, and the structures containing it
+        path.clear();
+        for(const pvd::PVField* F = field.get(); F; F = F->getParent())
+            path.push_back(F);
+
+        // replace each set bit of a containing structure by those of its fields
+        bool expand = false;
+        for(size_t i=path.size()-1u; i>0u; i--) {
+            const size_t off = path[i]->getFieldOffset();
+            expand |= data.get(off);
+            if(!expand)
+                continue;
+            data.clear(off);
+            const pvd::PVFieldPtrArray& subs(static_cast<const pvd::PVStructure*>(path[i])->getPVFields());
+            for(size_t j=0; j<subs.size(); j++)
+                data.set(subs[j]->getFieldOffset());
+        }
+        data.clear(offset);
+    }
+}
+
+void deserializeDeltas(pvd::ByteBuffer *buffer,
+                       pvd::DeserializableControl *control,
+                       const pvd::BitSet& deltas,
+                       pvd::PVStructure& value,
+                       const pvd::PVStructure& previous)
+{
+    for(pvd::int32 offset = deltas.nextSetBit(0); offset>=0; offset = deltas.nextSetBit(offset+1)) {
+        pvd::PVFieldPtr field(value.getSubField(offset)),
+                        prevField(previous.getSubField(offset));
+        if(!field || !prevField || !deltaArray(*field) || field->getField()!=prevField->getField())
+            throw std::runtime_error("array delta of a field which is not a numeric array");
+
+        pvd::PVScalarArray& arr(static_cast<pvd::PVScalarArray&>(*field));
+        const pvd::ScalarType type(arr.getScalarArray()->getElementType());
+        const size_t esize = pvd::ScalarTypeFunc::elementSize(type);
+
+        const size_t length = pvd::SerializeHelper::readSize(buffer, control),
+                     nranges = pvd::SerializeHelper::readSize(buffer, control);
+
+        // untyped, so sizes are in bytes
+        pvd::shared_vector<const void> prev;
+        static_cast<const pvd::PVScalarArray&>(*prevField).getAs(prev);
+        pvd::shared_vector<void> out(pvd::ScalarTypeFunc::allocArray(type, length));
+        char *dest = static_cast<char*>(out.data());
+        memcpy(dest, prev.data(), std::min(prev.size(), out.size()));
+
+        pvd::PVScalarArrayPtr temp(pvd::getPVDataCreate()->createPVScalarArray(type));
+        pvd::shared_vector<const void> part;
+        for(size_t i=0; i<nranges; i++) {
+            const size_t start = pvd::SerializeHelper::readSize(buffer, control);
+            temp->deserialize(buffer, control);
+            temp->getAs(part);
+            if(start>length || part.size()/esize > length-start)
+                throw std::runtime_error("array delta range out of bounds");
+            memcpy(dest+start*esize, part.data(), part.size());
+        }
+
+        arr.putFrom(pvd::freeze(out));
+    }
+}
+
+}
+}
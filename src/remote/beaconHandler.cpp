@@ -4,6 +4,17 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <string.h>
+
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_BEACON_USE_ATOMIC
+#endif
+#endif
+
 #define epicsExportSharedSymbols
 #include <pv/beaconHandler.h>
 #include <pv/transportRegistry.h>
@@ -16,15 +27,20 @@ namespace epics {
 namespace pvAccess {
 
 BeaconHandler::BeaconHandler(Context::shared_pointer const & context,
-                             const osiSockAddr* responseFrom) :
+                             const osiSockAddr* responseFrom,
+                             BeaconStats* stats) :
     _context(Context::weak_pointer(context)),
     _responseFrom(*responseFrom),
     _mutex(),
     _serverGUID(),
     _serverChangeCount(-1),
-    _first(true)
+    _first(true),
+    _version(0),
+    _sequence(-1),
+    _stats(stats)
 {
-
+    // without STATE_KNOWN, so the first beacon is not unchanged()
+    memset(_state, 0, sizeof(_state));
 }
 
 BeaconHandler::~BeaconHandler()
@@ -36,11 +52,115 @@ void BeaconHandler::beaconNotify(osiSockAddr* /*from*/, int8 remoteTransportRevi
                                  int16 changeCount,
                                  PVFieldPtr /*data*/)
 {
+    checkSequence(sequentalID);
+
+    // the usual case, of a known server with nothing changed, without locking
+    if (unchanged(guid, changeCount))
+    {
+        if (_stats)
+            _stats->unchanged.increment();
+        return;
+    }
+
     bool networkChanged = updateBeacon(remoteTransportRevision, timestamp, guid, sequentalID, changeCount);
     if (networkChanged)
         changedTransport();
 }
 
+namespace {
+void pack(ServerGUID const & guid, int16 changeCount, int *words)
+{
+    // 12 bytes of GUID in the first three
+    memcpy(words, guid.value, sizeof(guid.value));
+    words[3] = 0x10000 | (changeCount & 0xffff);
+}
+}
+
+bool BeaconHandler::unchanged(ServerGUID const & guid, int16 changeCount) const
+{
+    int expect[STATE_WORDS];
+    pack(guid, changeCount, expect);
+
+#ifdef PVA_BEACON_USE_ATOMIC
+    const int version = epics::atomic::get(_version);
+    if (version & 1)
+        return false; // being written
+    for (int i = 0; i < STATE_WORDS; i++)
+    {
+        if (epics::atomic::get(_state[i]) != expect[i])
+            return false;
+    }
+    return epics::atomic::get(_version) == version;
+#else
+    Lock guard(_mutex);
+    return memcmp(_state, expect, sizeof(expect)) == 0;
+#endif
+}
+
+void BeaconHandler::publish()
+{
+    int words[STATE_WORDS];
+    pack(_serverGUID, _serverChangeCount, words);
+
+#ifdef PVA_BEACON_USE_ATOMIC
+    epics::atomic::increment(_version);
+    for (int i = 0; i < STATE_WORDS; i++)
+        epics::atomic::set(_state[i], words[i]);
+    epics::atomic::increment(_version);
+#else
+    // read under _mutex
+    memcpy(_state, words, sizeof(words));
+#endif
+}
+
+void BeaconHandler::checkSequence(int16 sequentalID)
+{
+    // sent as one byte, which wraps around
+    const int sequence = sequentalID & 0xff;
+    // beacons of one server may arrive on more than one socket, which only miscounts
+#ifdef PVA_BEACON_USE_ATOMIC
+    const int last = epics::atomic::get(_sequence);
+    epics::atomic::set(_sequence, sequence);
+#else
+    int last;
+    {
+        Lock guard(_mutex);
+        last = _sequence;
+        _sequence = sequence;
+    }
+#endif
+    if (last < 0 || !_stats)
+        return;
+
+    const int step = (sequence - last) & 0xff;
+    if (step == 0 || step > 0x80)
+        _stats->repeats.increment();
+    else if (step > 1)
+        _stats->gaps.increment();
+}
+
+bool BeaconHandler::decodeLoad(const PVFieldPtr& data, ServerLoad& load)
+{
+    PVStructure::shared_pointer status(std::tr1::dynamic_pointer_cast<PVStructure>(data));
+    if (!status)
+        return false;
+
+    PVScalar::shared_pointer connections(status->getSubField<PVScalar>("connections")),
+                             cpu(status->getSubField<PVScalar>("cpu")),
+                             queueDepth(status->getSubField<PVScalar>("queueDepth"));
+    if (!connections && !cpu && !queueDepth)
+        return false;
+
+    load = ServerLoad();
+    if (connections)
+        load.connections = connections->getAs<int32>();
+    if (cpu)
+        load.cpu = cpu->getAs<double>();
+    if (queueDepth)
+        load.queueDepth = queueDepth->getAs<int32>();
+    return true;
+}
+
 bool BeaconHandler::updateBeacon(int8 /*remoteTransportRevision*/, TimeStamp* /*timestamp*/,
                                  ServerGUID const & guid, int16 /*sequentalID*/, int16 changeCount)
 {
@@ -51,8 +171,12 @@ bool BeaconHandler::updateBeacon(int8 /*remoteTransportRevision*/, TimeStamp* /*
         _first = false;
         _serverGUID = guid;
         _serverChangeCount = changeCount;
+        publish();
+        if (_stats)
+            _stats->restarts.increment();
 
         // new server up..
+        _context.lock()->serverRestarted(_responseFrom);
         _context.lock()->newServerDetected();
 
         return false;
@@ -64,7 +188,11 @@ bool BeaconHandler::updateBeacon(int8 /*remoteTransportRevision*/, TimeStamp* /*
         // update startup time and change count
         _serverGUID = guid;
         _serverChangeCount = changeCount;
+        publish();
+        if (_stats)
+            _stats->restarts.increment();
 
+        _context.lock()->serverRestarted(_responseFrom);
         _context.lock()->newServerDetected();
 
         return true;
@@ -73,6 +201,9 @@ bool BeaconHandler::updateBeacon(int8 /*remoteTransportRevision*/, TimeStamp* /*
     {
         // update change count
         _serverChangeCount = changeCount;
+        publish();
+        if (_stats)
+            _stats->changes.increment();
 
         // TODO be more specific (possible optimizations)
         _context.lock()->newServerDetected();
@@ -96,6 +227,73 @@ void BeaconHandler::changedTransport()
     }
 }
 
+BeaconHandlerTable::BeaconHandlerTable()
+    :_buckets(64u)
+    ,_count(0u)
+{}
+
+BeaconHandlerTable::~BeaconHandlerTable() {}
+
+size_t BeaconHandlerTable::hash(const osiSockAddr& address)
+{
+    size_t h = address.ia.sin_addr.s_addr;
+    h ^= size_t(address.ia.sin_port)<<16;
+    h ^= h>>16;
+    h ^= h>>8;
+    return h;
+}
+
+BeaconHandler::shared_pointer BeaconHandlerTable::get(Context::shared_pointer const & context,
+                                                      const osiSockAddr& responseFrom)
+{
+    Lock guard(_mutex);
+
+    std::vector<BeaconHandler::shared_pointer>& bucket = _buckets[hash(responseFrom) & (_buckets.size()-1u)];
+    for (size_t i = 0; i < bucket.size(); i++)
+    {
+        const osiSockAddr& addr = bucket[i]->getAddress();
+        if (addr.sa.sa_family == responseFrom.sa.sa_family
+                && addr.ia.sin_addr.s_addr == responseFrom.ia.sin_addr.s_addr
+                && addr.ia.sin_port == responseFrom.ia.sin_port)
+            return bucket[i];
+    }
+
+    // stores weak_ptr
+    BeaconHandler::shared_pointer handler(new BeaconHandler(context, &responseFrom, &_stats));
+
+    if (_count >= _buckets.size())
+    {
+        std::vector<std::vector<BeaconHandler::shared_pointer> > old(_buckets.size()*2u);
+        old.swap(_buckets);
+        for (size_t b = 0; b < old.size(); b++)
+        {
+            for (size_t i = 0; i < old[b].size(); i++)
+                _buckets[hash(old[b][i]->getAddress()) & (_buckets.size()-1u)].push_back(old[b][i]);
+        }
+        _buckets[hash(responseFrom) & (_buckets.size()-1u)].push_back(handler);
+    }
+    else
+    {
+        bucket.push_back(handler);
+    }
+    _count++;
+    return handler;
+}
+
+void BeaconHandlerTable::clear()
+{
+    Lock guard(_mutex);
+    for (size_t b = 0; b < _buckets.size(); b++)
+        _buckets[b].clear();
+    _count = 0u;
+}
+
+size_t BeaconHandlerTable::size() const
+{
+    Lock guard(_mutex);
+    return _count;
+}
+
 }
 }
 
@@ -5,6 +5,8 @@
  */
 
 #include <sstream>
+#include <vector>
+#include <map>
 
 #include <epicsThread.h>
 #include <osiSock.h>
@@ -23,6 +25,11 @@ using namespace epics::pvData;
 namespace epics {
 namespace pvAccess {
 
+namespace {
+// connections taken from the listen backlog at once
+const size_t ACCEPT_BATCH = 64u;
+}
+
 BlockingTCPAcceptor::BlockingTCPAcceptor(
     Context::shared_pointer const & context,
     ResponseHandler::shared_pointer const & responseHandler,
@@ -33,7 +40,11 @@ BlockingTCPAcceptor::BlockingTCPAcceptor(
     _bindAddress(),
     _serverSocketChannel(INVALID_SOCKET),
     _receiveBufferSize(receiveBufferSize),
+    _tls(TLSContext::create(context->getConfiguration(), true)),
     _destroyed(false),
+    _backlog(128),
+    _maxConnections(0u),
+    _maxPerHost(0u),
     _thread(*this, "TCP-acceptor",
             epicsThreadGetStackSize(
                 epicsThreadStackMedium),
@@ -43,6 +54,7 @@ BlockingTCPAcceptor::BlockingTCPAcceptor(
     _bindAddress.ia.sin_family = AF_INET;
     _bindAddress.ia.sin_port = htons(port);
     _bindAddress.ia.sin_addr.s_addr = htonl(INADDR_ANY);
+    configure();
     initialize();
 }
 
@@ -54,13 +66,18 @@ BlockingTCPAcceptor::BlockingTCPAcceptor(Context::shared_pointer const & context
     _bindAddress(),
     _serverSocketChannel(INVALID_SOCKET),
     _receiveBufferSize(receiveBufferSize),
+    _tls(TLSContext::create(context->getConfiguration(), true)),
     _destroyed(false),
+    _backlog(128),
+    _maxConnections(0u),
+    _maxPerHost(0u),
     _thread(*this, "TCP-acceptor",
             epicsThreadGetStackSize(
                 epicsThreadStackMedium),
             epicsThreadPriorityMedium)
 {
     _bindAddress = addr;
+    configure();
     initialize();
 }
 
@@ -68,6 +85,21 @@ BlockingTCPAcceptor::~BlockingTCPAcceptor() {
     destroy();
 }
 
+void BlockingTCPAcceptor::configure() {
+    Configuration::const_shared_pointer config(_context->getConfiguration());
+    if(!config)
+        return;
+
+    _backlog = config->getPropertyAsInteger("EPICS_PVAS_LISTEN_BACKLOG", _backlog);
+    if(_backlog<1)
+        _backlog = 1;
+
+    int32 limit = config->getPropertyAsInteger("EPICS_PVAS_MAX_CONNECTIONS", 0);
+    _maxConnections = limit>0 ? size_t(limit) : 0u;
+    limit = config->getPropertyAsInteger("EPICS_PVAS_MAX_CONNECTIONS_PER_HOST", 0);
+    _maxPerHost = limit>0 ? size_t(limit) : 0u;
+}
+
 int BlockingTCPAcceptor::initialize() {
 
     char ipAddrStr[48];
@@ -131,7 +163,7 @@ int BlockingTCPAcceptor::initialize() {
                     }
                 }
 
-                retval = ::listen(_serverSocketChannel, 4);
+                retval = ::listen(_serverSocketChannel, _backlog);
                 if(retval<0) {
                     epicsSocketConvertErrnoToString(strBuffer, sizeof(strBuffer));
                     ostringstream temp;
@@ -160,10 +192,10 @@ void BlockingTCPAcceptor::run() {
     ipAddrToDottedIP(&_bindAddress.ia, ipAddrStr, sizeof(ipAddrStr));
     LOG(logLevelDebug, "Accepting connections at %s.", ipAddrStr);
 
-    bool socketOpen = true;
-    char strBuffer[64];
+    std::vector<Accepted> batch;
+    batch.reserve(ACCEPT_BATCH);
 
-    while(socketOpen) {
+    while(true) {
 
         SOCKET sock;
         {
@@ -173,81 +205,143 @@ void BlockingTCPAcceptor::run() {
             sock = _serverSocketChannel;
         }
 
-        osiSockAddr address;
+        Accepted next;
         osiSocklen_t len = sizeof(sockaddr);
 
-        SOCKET newClient = epicsSocketAccept(sock, &address.sa, &len);
-        if(newClient!=INVALID_SOCKET) {
-            // accept succeeded
-            ipAddrToDottedIP(&address.ia, ipAddrStr, sizeof(ipAddrStr));
-            LOG(logLevelDebug, "Accepted connection from PVA client: %s.", ipAddrStr);
-
-            // enable TCP_NODELAY (disable Nagle's algorithm)
-            int optval = 1; // true
-            int retval = ::setsockopt(newClient, IPPROTO_TCP, TCP_NODELAY, (char *)&optval, sizeof(int));
-            if(retval<0) {
-                epicsSocketConvertErrnoToString(strBuffer, sizeof(strBuffer));
-                LOG(logLevelDebug, "Error setting TCP_NODELAY: %s.", strBuffer);
+        // wait for one
+        next.sock = epicsSocketAccept(sock, &next.address.sa, &len);
+        if(next.sock==INVALID_SOCKET)
+            break;
+        batch.push_back(next);
+
+        // then take any others already waiting, so that a burst of clients
+        // does not overflow the backlog while transports are created
+        osiSockIoctl_t yes = true, no = false;
+        if(socket_ioctl(sock, FIONBIO, &yes)==0) {
+            while(batch.size()<ACCEPT_BATCH) {
+                len = sizeof(sockaddr);
+                next.sock = epicsSocketAccept(sock, &next.address.sa, &len);
+                if(next.sock==INVALID_SOCKET)
+                    break;
+                // which some targets inherit from the listening socket
+                socket_ioctl(next.sock, FIONBIO, &no);
+                batch.push_back(next);
             }
+            socket_ioctl(sock, FIONBIO, &no);
+        }
 
-            // enable TCP_KEEPALIVE
-            retval = ::setsockopt(newClient, SOL_SOCKET, SO_KEEPALIVE, (char *)&optval, sizeof(int));
-            if(retval<0) {
-                epicsSocketConvertErrnoToString(strBuffer, sizeof(strBuffer));
-                LOG(logLevelDebug, "Error setting SO_KEEPALIVE: %s.", strBuffer);
-            }
+        _stats.batches.increment();
+        admit(batch);
+        batch.clear();
+    } // while
+}
 
-            // do NOT tune socket buffer sizes, this will disable auto-tunning
+void BlockingTCPAcceptor::admit(std::vector<Accepted>& batch) {
+    TransportRegistry* registry = _context->getTransportRegistry();
 
-            // get TCP send buffer size
-            osiSocklen_t intLen = sizeof(int);
-            int _socketSendBufferSize;
-            retval = getsockopt(newClient, SOL_SOCKET, SO_SNDBUF, (char *)&_socketSendBufferSize, &intLen);
-            if(retval<0) {
-                epicsSocketConvertErrnoToString(strBuffer, sizeof(strBuffer));
-                LOG(logLevelDebug, "Error getting SO_SNDBUF: %s.", strBuffer);
-            }
+    size_t open = 0u;
+    if(_maxConnections)
+        open = registry->size();
+
+    // connections from each host, counted once for the batch
+    std::map<unsigned long, size_t> perHost;
+    if(_maxPerHost) {
+        TransportRegistry::transportVector_t transports;
+        registry->toArray(transports);
+        for(size_t i=0; i<transports.size(); i++)
+            perHost[transports[i]->getRemoteAddress().ia.sin_addr.s_addr]++;
+    }
 
-            /**
-             * Create transport, it registers itself to the registry.
-             */
-            detail::BlockingServerTCPTransportCodec::shared_pointer transport =
-                detail::BlockingServerTCPTransportCodec::create(
-                    _context,
-                    newClient,
-                    _responseHandler,
-                    _socketSendBufferSize,
-                    _receiveBufferSize);
-
-            // validate connection
-            if(!validateConnection(transport, ipAddrStr)) {
-                // TODO
-                // wait for negative response to be sent back and
-                // hold off the client for retrying at very high rate
-                epicsThreadSleep(1.0);
-
-                transport->close();
-                LOG(
-                    logLevelDebug,
-                    "Connection to PVA client %s failed to be validated, closing it.",
-                    ipAddrStr);
+    for(size_t i=0; i<batch.size(); i++) {
+        const Accepted& conn = batch[i];
+
+        char ipAddrStr[48];
+        ipAddrToDottedIP(&conn.address.ia, ipAddrStr, sizeof(ipAddrStr));
+
+        if(_maxConnections && open>=_maxConnections) {
+            LOG(logLevelDebug, "Rejecting connection from %s, %u connections open.", ipAddrStr, unsigned(open));
+            _stats.rejectedLimit.increment();
+            epicsSocketDestroy(conn.sock);
+            continue;
+        }
+        if(_maxPerHost) {
+            size_t& fromHost = perHost[conn.address.ia.sin_addr.s_addr];
+            if(fromHost>=_maxPerHost) {
+                LOG(logLevelDebug, "Rejecting connection from %s, %u connections open from it.", ipAddrStr, unsigned(fromHost));
+                _stats.rejectedHost.increment();
+                epicsSocketDestroy(conn.sock);
                 continue;
             }
+            fromHost++;
+        }
+        open++;
 
-            LOG(logLevelDebug, "Serving to PVA client: %s.", ipAddrStr);
-
-        }// accept succeeded
-        else
-            socketOpen = false;
-    } // while
+        LOG(logLevelDebug, "Accepted connection from PVA client: %s.", ipAddrStr);
+        _stats.accepted.increment();
+        createTransport(conn.sock, conn.address);
+    }
 }
 
-bool BlockingTCPAcceptor::validateConnection(Transport::shared_pointer const & transport, const char* address) {
+void BlockingTCPAcceptor::createTransport(SOCKET newClient, const osiSockAddr& address) {
+    char ipAddrStr[48];
+    ipAddrToDottedIP(&address.ia, ipAddrStr, sizeof(ipAddrStr));
+    char strBuffer[64];
+
+    // enable TCP_NODELAY (disable Nagle's algorithm)
+    int optval = 1; // true
+    int retval = ::setsockopt(newClient, IPPROTO_TCP, TCP_NODELAY, (char *)&optval, sizeof(int));
+    if(retval<0) {
+        epicsSocketConvertErrnoToString(strBuffer, sizeof(strBuffer));
+        LOG(logLevelDebug, "Error setting TCP_NODELAY: %s.", strBuffer);
+    }
+
+    // enable TCP_KEEPALIVE
+    retval = ::setsockopt(newClient, SOL_SOCKET, SO_KEEPALIVE, (char *)&optval, sizeof(int));
+    if(retval<0) {
+        epicsSocketConvertErrnoToString(strBuffer, sizeof(strBuffer));
+        LOG(logLevelDebug, "Error setting SO_KEEPALIVE: %s.", strBuffer);
+    }
+
+    // do NOT tune socket buffer sizes, this will disable auto-tunning
+
+    // get TCP send buffer size
+    osiSocklen_t intLen = sizeof(int);
+    int _socketSendBufferSize;
+    retval = getsockopt(newClient, SOL_SOCKET, SO_SNDBUF, (char *)&_socketSendBufferSize, &intLen);
+    if(retval<0) {
+        epicsSocketConvertErrnoToString(strBuffer, sizeof(strBuffer));
+        LOG(logLevelDebug, "Error getting SO_SNDBUF: %s.", strBuffer);
+    }
+
+    // the handshake is done by the thread(s) of the transport, not while other clients wait here
+    TLSSession::shared_pointer tls;
+    if(_tls) {
+        tls = _tls->startSession(newClient, address);
+        if(!tls) {
+            epicsSocketDestroy(newClient);
+            return;
+        }
+    }
+
+    /**
+     * Create transport, it registers itself to the registry.
+     */
+    detail::BlockingServerTCPTransportCodec::shared_pointer transport =
+        detail::BlockingServerTCPTransportCodec::create(
+            _context,
+            newClient,
+            _responseHandler,
+            _socketSendBufferSize,
+            _receiveBufferSize,
+            tls);
+
+    // validate connection.  Not waiting, so that a slow authentication
+    // doesn't hold up accepting other clients.
     try {
-        return transport->verify(5000);
-    } catch(...) {
-        LOG(logLevelDebug, "Validation of %s failed.", address);
-        return false;
+        transport->startVerification(5.0);
+    } catch(std::exception& e) {
+        LOG(logLevelDebug, "Validation of %s failed: %s", ipAddrStr, e.what());
+        transport->close();
     }
 }
 
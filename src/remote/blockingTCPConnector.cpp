@@ -27,7 +27,8 @@ BlockingTCPConnector::BlockingTCPConnector(
     float heartbeatInterval) :
     _context(context),
     _receiveBufferSize(receiveBufferSize),
-    _heartbeatInterval(heartbeatInterval)
+    _heartbeatInterval(heartbeatInterval),
+    _tls(TLSContext::create(context->getConfiguration(), false))
 {
 }
 
@@ -95,6 +96,15 @@ Transport::shared_pointer BlockingTCPConnector::connect(std::tr1::shared_ptr<Cli
             return transport;
     }
 
+    {
+        // share the result of the connect() we waited for, rather than each retrying
+        std::string msg;
+        if(rsvp.sharedFailure(msg)) {
+            LOG(logLevelDebug, "Concurrent connect to PVA server %s failed: %s", ipAddrStr, msg.c_str());
+            throw std::runtime_error(msg);
+        }
+    }
+
     try {
         LOG(logLevelDebug, "Connecting to PVA server: %s.", ipAddrStr);
 
@@ -136,10 +146,20 @@ Transport::shared_pointer BlockingTCPConnector::connect(std::tr1::shared_ptr<Cli
             LOG(logLevelDebug, "Error getting SO_SNDBUF: %s.", strBuffer);
         }
 
+        TLSSession::shared_pointer tls;
+        if(_tls) {
+            tls = _tls->handshake(socket, address, 5.0);
+            if(!tls) {
+                std::ostringstream temp;
+                temp<<"TLS handshake with '"<<ipAddrStr<<"' failed.";
+                THROW_BASE_EXCEPTION(temp.str().c_str());
+            }
+        }
+
         // create() also adds to context connection pool _context->getTransportRegistry()
         transport = detail::BlockingClientTCPTransportCodec::create(
                     context, socket, responseHandler, _receiveBufferSize, _socketSendBufferSize,
-                    client, transportRevision, _heartbeatInterval, priority);
+                    client, transportRevision, _heartbeatInterval, priority, tls);
 
         // verify
         if(!transport->verify(5000)) {
@@ -155,12 +175,16 @@ Transport::shared_pointer BlockingTCPConnector::connect(std::tr1::shared_ptr<Cli
 
         LOG(logLevelDebug, "Connected to PVA server: %s.", ipAddrStr);
 
+        static_cast<detail::BlockingClientTCPTransportCodec*>(transport.get())->offerSharedMemory();
+        static_cast<detail::BlockingClientTCPTransportCodec*>(transport.get())->offerRDMA();
+
         return transport;
-    } catch(std::exception&) {
+    } catch(std::exception& e) {
         if(transport.get())
             transport->close();
         else if(socket!=INVALID_SOCKET)
             epicsSocketDestroy(socket);
+        rsvp.failed(e.what());
         throw;
     }
 }
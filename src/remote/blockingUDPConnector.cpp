@@ -75,6 +75,25 @@ BlockingUDPTransport::shared_pointer BlockingUDPConnector::connect(std::tr1::sha
     if (_reuseSocket)
         epicsSocketEnableAddressUseForDatagramFanout(socket);
 
+#ifdef SO_REUSEPORT
+    // for sharded receivers, in case the above set only SO_REUSEADDR.
+    // The group is per address, port and user, not per process.  So other servers
+    // of the same user on this host, bound to the same port, join it as well, and a
+    // unicast datagram may be given to a socket of any of them.  As without sharding,
+    // where the last bound gets it, the server receiving a unicast search relays it
+    // to the others through the local multicast group.
+    if (_reusePort)
+    {
+        optval = 1;
+        if (::setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, (char *)&optval, sizeof(optval)))
+        {
+            char errStr[64];
+            epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+            LOG(logLevelDebug, "Error setting SO_REUSEPORT: %s.", errStr);
+        }
+    }
+#endif
+
     retval = ::bind(socket, (sockaddr*)&(bindAddress.sa), sizeof(sockaddr));
     if(retval<0) {
         char ip[20];
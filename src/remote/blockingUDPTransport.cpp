@@ -11,6 +11,15 @@
 
 #include <sys/types.h>
 #include <cstdio>
+#include <cstring>
+
+#if defined(__linux__)
+#  include <sys/socket.h>
+#  include <linux/filter.h>
+#  if defined(MSG_WAITFORONE)
+#    define PVA_HAVE_MMSG
+#  endif
+#endif
 
 #include <epicsThread.h>
 #include <osiSock.h>
@@ -40,9 +49,42 @@ inline int sendto(int s, const char *buf, size_t len, int flags, const struct so
 }
 #endif
 
+namespace {
+/* FNV-1a of the source, and of the start of a datagram, which includes the
+ * sequence ID and reply address of a search.  So searches relayed through the
+ * local multicast group by one server are spread as well.
+ */
+unsigned shardOf(const osiSockAddr& from, const char *data, size_t length)
+{
+    unsigned h = 2166136261u;
+    const unsigned char *addr = (const unsigned char*)&from.ia.sin_addr;
+    for(size_t i=0; i<sizeof(from.ia.sin_addr); i++)
+        h = (h ^ addr[i]) * 16777619u;
+    h = (h ^ (from.ia.sin_port&0xff)) * 16777619u;
+    h = (h ^ (from.ia.sin_port>>8)) * 16777619u;
+    for(size_t i=0; i<length && i<64u; i++)
+        h = (h ^ (unsigned char)data[i]) * 16777619u;
+    return h;
+}
+}
+
 // reserve some space for CMD_ORIGIN_TAG message
 #define RECEIVE_BUFFER_PRE_RESERVE (PVA_MESSAGE_HEADER_SIZE + 16)
 
+// datagrams received by one recvmmsg()
+#define RECEIVE_BATCH 8
+// datagrams held for one sendmmsg()
+#define SEND_BATCH 32
+
+BlockingUDPTransport::Statistics::Statistics()
+    :recvCalls(0)
+    ,datagramsReceived(0)
+    ,datagramsDropped(0)
+    ,sendCalls(0)
+    ,datagramsSent(0)
+    ,repliesCoalesced(0)
+{}
+
 size_t BlockingUDPTransport::num_instances;
 
 BlockingUDPTransport::BlockingUDPTransport(bool serverFlag,
@@ -61,11 +103,27 @@ BlockingUDPTransport::BlockingUDPTransport(bool serverFlag,
     _receiveBuffer(MAX_UDP_RECV+RECEIVE_BUFFER_PRE_RESERVE),
     _sendBuffer(MAX_UDP_RECV),
     _lastMessageStartPosition(0),
+    _sendHeld(0),
+    _pendingData(MAX_UDP_RECV),
+    _pendingUsed(0),
     _clientServerWithEndianFlag(
-        (serverFlag ? 0x40 : 0x00) | ((EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG) ? 0x80 : 0x00))
+        (serverFlag ? 0x40 : 0x00) | ((EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG) ? 0x80 : 0x00)),
+    _shardIndex(0u),
+    _shardCount(1u)
 {
     assert(_responseHandler.get());
 
+    _pending.reserve(SEND_BATCH);
+
+#ifdef SO_RXQ_OVFL
+    {
+        // have the kernel report its count of dropped datagrams with each one received
+        int enable = 1;
+        if(::setsockopt(_channel, SOL_SOCKET, SO_RXQ_OVFL, (char*)&enable, sizeof(enable)))
+            LOG(logLevelDebug, "Unable to set SO_RXQ_OVFL");
+    }
+#endif
+
     osiSocklen_t sockLen = sizeof(sockaddr);
     // read the actual socket info
     int retval = ::getsockname(_channel, &_remoteAddress.sa, &sockLen);
@@ -179,10 +237,113 @@ void BlockingUDPTransport::enqueueSendRequest(TransportSender::shared_pointer co
     endMessage();
     if(!_sendToEnabled)
         send(&_sendBuffer);
+    else if(_sendHeld)
+        deferSend();
     else
         send(&_sendBuffer, _sendTo);
 }
 
+void BlockingUDPTransport::holdSend()
+{
+    Lock lock(_sendMutex);
+    _sendHeld++;
+}
+
+void BlockingUDPTransport::releaseSend()
+{
+    Lock lock(_sendMutex);
+    assert(_sendHeld>0);
+    if(--_sendHeld==0)
+        sendPending();
+}
+
+void BlockingUDPTransport::deferSend()
+{
+    const size_t length = _sendBuffer.getPosition();
+
+    if(!_pending.empty()) {
+        PendingDatagram& last = _pending.back();
+        // messages are sent back to back, so the last datagram can be extended
+        if(last.length+length <= size_t(MAX_UDP_UNFRAGMENTED_SEND)
+                && _pendingUsed+length <= _pendingData.size()
+                && sockAddrAreIdentical(&last.to, &_sendTo)) {
+            memcpy(&_pendingData[_pendingUsed], _sendBuffer.getArray(), length);
+            _pendingUsed += length;
+            last.length += length;
+            _stats.repliesCoalesced++;
+            return;
+        }
+    }
+
+    if(_pending.size()==SEND_BATCH || _pendingUsed+length > _pendingData.size())
+        sendPending();
+
+    PendingDatagram next;
+    next.to = _sendTo;
+    next.offset = _pendingUsed;
+    next.length = length;
+    memcpy(&_pendingData[_pendingUsed], _sendBuffer.getArray(), length);
+    _pendingUsed += length;
+    _pending.push_back(next);
+}
+
+void BlockingUDPTransport::sendPending()
+{
+    if(_pending.empty())
+        return;
+
+#ifdef PVA_HAVE_MMSG
+    struct mmsghdr msgs[SEND_BATCH];
+    struct iovec iovs[SEND_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+
+    for(size_t i=0; i<_pending.size(); i++) {
+        iovs[i].iov_base = &_pendingData[_pending[i].offset];
+        iovs[i].iov_len = _pending[i].length;
+        msgs[i].msg_hdr.msg_name = &_pending[i].to.sa;
+        msgs[i].msg_hdr.msg_namelen = sizeof(_pending[i].to.ia);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t done = 0;
+    while(done < _pending.size()) {
+        int retval = sendmmsg(_channel, msgs+done, unsigned(_pending.size()-done), 0);
+        _stats.sendCalls++;
+        if(likely(retval>0)) {
+            _stats.datagramsSent += retval;
+            done += retval;
+        } else if(SOCKERRNO!=SOCK_EINTR) {
+            // the first datagram has failed, skip it
+            char errStr[64];
+            epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+            LOG(logLevelDebug, "Socket sendmmsg to %s error: %s.",
+                inetAddressToString(_pending[done].to).c_str(), errStr);
+            done++;
+        }
+    }
+#else
+    for(size_t i=0; i<_pending.size(); i++)
+        send(&_pendingData[_pending[i].offset], _pending[i].length, _pending[i].to);
+#endif
+
+    _pending.clear();
+    _pendingUsed = 0;
+}
+
+void BlockingUDPTransport::countSend(size_t datagrams)
+{
+    Lock lock(_sendMutex);
+    _stats.sendCalls++;
+    _stats.datagramsSent += datagrams;
+}
+
+void BlockingUDPTransport::getStatistics(Statistics& out) const
+{
+    Lock lock(_sendMutex);
+    out = _stats;
+}
+
 
 void BlockingUDPTransport::flushSendQueue()
 {
@@ -208,51 +369,98 @@ void BlockingUDPTransport::run() {
     // This function is always called from only one thread - this
     // object's own thread.
 
-    osiSockAddr fromAddress;
-    osiSocklen_t addrStructSize = sizeof(sockaddr);
     Transport::shared_pointer thisTransport(internal_this);
 
     try {
 
         char* recvfrom_buffer_start = (char*)(_receiveBuffer.getArray()+RECEIVE_BUFFER_PRE_RESERVE);
         size_t recvfrom_buffer_len =_receiveBuffer.getSize()-RECEIVE_BUFFER_PRE_RESERVE;
+
+#ifdef PVA_HAVE_MMSG
+        // The first datagram of a batch is received directly into _receiveBuffer.
+        // Others are copied there in turn.
+        std::vector<char> batchBuffer((RECEIVE_BATCH-1)*recvfrom_buffer_len);
+        struct mmsghdr msgs[RECEIVE_BATCH];
+        struct iovec iovs[RECEIVE_BATCH];
+        osiSockAddr fromAddresses[RECEIVE_BATCH];
+        union {
+            char buf[CMSG_SPACE(sizeof(uint32))];
+            struct cmsghdr align;
+        } controls[RECEIVE_BATCH];
+
+        for(size_t i=0; i<RECEIVE_BATCH; i++) {
+            iovs[i].iov_base = i==0 ? recvfrom_buffer_start : &batchBuffer[(i-1)*recvfrom_buffer_len];
+            iovs[i].iov_len = recvfrom_buffer_len;
+        }
+#else
+        osiSockAddr fromAddress;
+        osiSocklen_t addrStructSize = sizeof(sockaddr);
+#endif
+
         while(!_closed.get())
         {
-            int bytesRead = recvfrom(_channel,
-                                     recvfrom_buffer_start, recvfrom_buffer_len,
-                                     0, (sockaddr*)&fromAddress,
-                                     &addrStructSize);
-
-            if(likely(bytesRead>0)) {
-                // successfully got datagram
-                bool ignore = false;
-                for(size_t i = 0; i <_ignoredAddresses.size(); i++)
+#ifdef PVA_HAVE_MMSG
+            memset(msgs, 0, sizeof(msgs));
+            for(size_t i=0; i<RECEIVE_BATCH; i++) {
+                msgs[i].msg_hdr.msg_name = &fromAddresses[i].sa;
+                msgs[i].msg_hdr.msg_namelen = sizeof(fromAddresses[i]);
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                msgs[i].msg_hdr.msg_control = controls[i].buf;
+                msgs[i].msg_hdr.msg_controllen = sizeof(controls[i].buf);
+            }
+
+            // wait for the first datagram, then take any others already queued
+            int retval = recvmmsg(_channel, msgs, RECEIVE_BATCH, MSG_WAITFORONE, 0);
+
+            if(likely(retval>0)) {
                 {
-                    if(_ignoredAddresses[i].ia.sin_addr.s_addr==fromAddress.ia.sin_addr.s_addr)
+                    Lock lock(_sendMutex);
+                    _stats.recvCalls++;
+                    _stats.datagramsReceived += retval;
+                }
+
+                // replies to this batch go out together
+                SendHold hold(this);
+
+                for(int i=0; i<retval; i++) {
+#ifdef SO_RXQ_OVFL
+                    for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg;
+                        cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
                     {
-                        ignore = true;
-                        break;
+                        if(cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_RXQ_OVFL) {
+                            uint32 dropped;
+                            memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+                            // a running count for the socket
+                            Lock lock(_sendMutex);
+                            _stats.datagramsDropped = dropped;
+                        }
                     }
+#endif
+                    if(i>0)
+                        memcpy(recvfrom_buffer_start, iovs[i].iov_base, msgs[i].msg_len);
+
+                    processDatagram(thisTransport, fromAddresses[i], msgs[i].msg_len);
                 }
+                continue;
+            }
+#else
+            int retval = recvfrom(_channel,
+                                  recvfrom_buffer_start, recvfrom_buffer_len,
+                                  0, (sockaddr*)&fromAddress,
+                                  &addrStructSize);
 
-                if(likely(!ignore)) {
-                    _receiveBuffer.setPosition(RECEIVE_BUFFER_PRE_RESERVE);
-                    _receiveBuffer.setLimit(RECEIVE_BUFFER_PRE_RESERVE+bytesRead);
-
-                    try {
-                        processBuffer(thisTransport, fromAddress, &_receiveBuffer);
-                    } catch(std::exception& e) {
-                        LOG(logLevelError,
-                            "an exception caught while in UDP receiveThread at %s:%d: %s",
-                            __FILE__, __LINE__, e.what());
-                    } catch (...) {
-                        LOG(logLevelError,
-                            "unknown exception caught while in UDP receiveThread at %s:%d.",
-                            __FILE__, __LINE__);
-                    }
+            if(likely(retval>0)) {
+                {
+                    Lock lock(_sendMutex);
+                    _stats.recvCalls++;
+                    _stats.datagramsReceived++;
                 }
+                processDatagram(thisTransport, fromAddress, retval);
+                continue;
             }
-            else if (unlikely(bytesRead == -1)) {
+#endif
+            else if (unlikely(retval == -1)) {
 
                 int socketError = SOCKERRNO;
 
@@ -293,6 +501,34 @@ void BlockingUDPTransport::run() {
     }
 }
 
+void BlockingUDPTransport::processDatagram(Transport::shared_pointer const & transport,
+        osiSockAddr& fromAddress, size_t bytesRead)
+{
+    for(size_t i = 0; i <_ignoredAddresses.size(); i++)
+    {
+        if(_ignoredAddresses[i].ia.sin_addr.s_addr==fromAddress.ia.sin_addr.s_addr)
+            return;
+    }
+
+    if(_shardCount>1u && shardOf(fromAddress, _receiveBuffer.getArray()+RECEIVE_BUFFER_PRE_RESERVE, bytesRead)%_shardCount!=_shardIndex)
+        return;
+
+    _receiveBuffer.setPosition(RECEIVE_BUFFER_PRE_RESERVE);
+    _receiveBuffer.setLimit(RECEIVE_BUFFER_PRE_RESERVE+bytesRead);
+
+    try {
+        processBuffer(transport, fromAddress, &_receiveBuffer);
+    } catch(std::exception& e) {
+        LOG(logLevelError,
+            "an exception caught while in UDP receiveThread at %s:%d: %s",
+            __FILE__, __LINE__, e.what());
+    } catch (...) {
+        LOG(logLevelError,
+            "unknown exception caught while in UDP receiveThread at %s:%d.",
+            __FILE__, __LINE__);
+    }
+}
+
 bool BlockingUDPTransport::processBuffer(Transport::shared_pointer const & transport,
         osiSockAddr& fromAddress, ByteBuffer* receiveBuffer) {
 
@@ -404,6 +640,7 @@ bool BlockingUDPTransport::send(const char* buffer, size_t length, const osiSock
 
     int retval = sendto(_channel, buffer,
                         length, 0, &(address.sa), sizeof(sockaddr));
+    countSend(retval>=0 ? 1 : 0);
     if(unlikely(retval<0))
     {
         char errStr[64];
@@ -428,6 +665,7 @@ bool BlockingUDPTransport::send(ByteBuffer* buffer, const osiSockAddr& address)
 
     int retval = sendto(_channel, buffer->getArray(),
                         buffer->getLimit(), 0, &(address.sa), sizeof(sockaddr));
+    countSend(retval>=0 ? 1 : 0);
     if(unlikely(retval<0))
     {
         char errStr[64];
@@ -463,9 +701,39 @@ bool BlockingUDPTransport::send(ByteBuffer* buffer, InetAddressType target) {
                 buffer->getRemaining(), inetAddressToString(_sendAddresses[i]).c_str());
         }
 
+        if (!_multicastNIF.empty() && !_isSendAddressUnicast[i] && isMulticastAddress(&_sendAddresses[i]))
+        {
+            // one copy through each interface
+            Lock guard(_multicastMutex);
+            for (size_t n = 0; n < _multicastNIF.size(); n++)
+            {
+                if (::setsockopt(_channel, IPPROTO_IP, IP_MULTICAST_IF,
+                                 (char*)&_multicastNIF[n].ia.sin_addr, sizeof(struct in_addr)))
+                {
+                    allOK = false;
+                    continue;
+                }
+                int retval = sendto(_channel, buffer->getArray(),
+                                    buffer->getLimit(), 0, &(_sendAddresses[i].sa),
+                                    sizeof(sockaddr));
+                countSend(retval>=0 ? 1 : 0);
+                if(unlikely(retval<0))
+                {
+                    char errStr[64];
+                    epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+                    LOG(logLevelDebug, "Socket sendto to %s through %s error: %s.",
+                        inetAddressToString(_sendAddresses[i]).c_str(),
+                        inetAddressToString(_multicastNIF[n], false).c_str(), errStr);
+                    allOK = false;
+                }
+            }
+            continue;
+        }
+
         int retval = sendto(_channel, buffer->getArray(),
                             buffer->getLimit(), 0, &(_sendAddresses[i].sa),
                             sizeof(sockaddr));
+        countSend(retval>=0 ? 1 : 0);
         if(unlikely(retval<0))
         {
             char errStr[64];
@@ -553,6 +821,45 @@ void BlockingUDPTransport::setMutlicastNIF(const osiSockAddr & nifAddr, bool loo
 
 }
 
+void BlockingUDPTransport::setMulticastAll(bool all)
+{
+#ifdef IP_MULTICAST_ALL
+    int value = all ? 1 : 0;
+    if (::setsockopt(_channel, IPPROTO_IP, IP_MULTICAST_ALL, (char*)&value, sizeof(value)))
+    {
+        char errStr[64];
+        epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+        LOG(logLevelDebug, "Unable to set IP_MULTICAST_ALL: %s", errStr);
+    }
+#else
+    (void)all;
+#endif
+}
+
+void BlockingUDPTransport::steerToShards(unsigned count)
+{
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+    // index = cpu % count.  Indices beyond the group fall back to the hash of the source
+    struct sock_filter code[] = {
+        { BPF_LD  | BPF_W | BPF_ABS, 0, 0, (__u32)(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, count },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof(code)/sizeof(code[0]);
+    prog.filter = code;
+
+    if (count>1u && ::setsockopt(_channel, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, (char*)&prog, sizeof(prog)))
+    {
+        char errStr[64];
+        epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+        LOG(logLevelDebug, "Unable to set SO_ATTACH_REUSEPORT_CBPF: %s", errStr);
+    }
+#else
+    (void)count;
+#endif
+}
+
 void initializeUDPTransports(bool serverFlag,
                              BlockingUDPTransportVector& udpTransports,
                              const IfaceNodeVector& ifaceList,
@@ -561,10 +868,19 @@ void initializeUDPTransports(bool serverFlag,
                              int32& listenPort,
                              bool autoAddressList,
                              const std::string& addressList,
-                             const std::string& ignoreAddressList)
+                             const std::string& ignoreAddressList,
+                             const std::string& multicastGroup,
+                             const std::vector<ResponseHandler::shared_pointer>& shardHandlers)
 {
+#if !defined(_WIN32)
+    const size_t nshards = 1u + shardHandlers.size();
+#else
+    // winsock does not spread unicast datagrams over the sockets bound to one address
+    const size_t nshards = 1u;
+#endif
+
     std::tr1::shared_ptr<ClientChannelImpl> nullTransportClient;
-    epics::auto_ptr<BlockingUDPConnector> connector(new BlockingUDPConnector(serverFlag, true, true));
+    epics::auto_ptr<BlockingUDPConnector> connector(new BlockingUDPConnector(serverFlag, true, true, nshards > 1));
 
     //
     // Create UDP transport for sending (to all network interfaces)
@@ -595,6 +911,28 @@ void initializeUDPTransports(bool serverFlag,
     // TODO current implementation shares the port (aka beacon and search port)
     int32 sendPort = listenPort;
 
+    //
+    // multicast mode, one group for search and beacons instead of per subnet broadcasts
+    //
+
+    osiSockAddr mcastGroup;
+    memset(&mcastGroup, 0, sizeof(mcastGroup));
+    bool mcastEnabled = false;
+    if (!multicastGroup.empty())
+    {
+        InetAddrVector groups;
+        getSocketAddressList(groups, multicastGroup, sendPort);
+        if (groups.size() == 1 && isMulticastAddress(&groups[0]))
+        {
+            mcastGroup = groups[0];
+            mcastEnabled = true;
+        }
+        else
+        {
+            LOG(logLevelError, "Ignoring multicast group '%s', which is not one multicast address.", multicastGroup.c_str());
+        }
+    }
+
     //
     // compile auto address list - where to send packets
     //
@@ -618,6 +956,17 @@ void initializeUDPTransports(bool serverFlag,
         }
     }
 
+    if (mcastEnabled)
+    {
+        // the group replaces the broadcast addresses, sent through each interface
+        autoBCastAddr.assign(1, mcastGroup);
+
+        InetAddrVector nifs;
+        for (IfaceNodeVector::const_iterator iter = ifaceList.begin(); iter != ifaceList.end(); iter++)
+            nifs.push_back(iter->addr);
+        sendTransport->setMulticastInterfaces(nifs);
+    }
+
     //
     // set send address list
     //
@@ -708,80 +1057,143 @@ void initializeUDPTransports(bool serverFlag,
             node.validP2P ? inetAddressToString(node.peer, false).c_str() : "<none>");
         try
         {
-            // where to bind (listen) address
-            osiSockAddr listenLocalAddress;
-            memset(&listenLocalAddress, 0, sizeof(listenLocalAddress));
-            listenLocalAddress.ia.sin_family = AF_INET;
-            listenLocalAddress.ia.sin_port = htons(listenPort);
-            listenLocalAddress.ia.sin_addr.s_addr = node.addr.ia.sin_addr.s_addr;
-
-            BlockingUDPTransport::shared_pointer transport = connector->connect(
-                        nullTransportClient, responseHandler,
-                        listenLocalAddress, PVA_PROTOCOL_REVISION,
-                        PVA_DEFAULT_PRIORITY);
-            if (!transport)
-                continue;
-            listenLocalAddress = transport->getRemoteAddress();
-
-            transport->setIgnoredAddresses(ignoreAddressVector);
+            // one set of receive sockets for each shard, which are bound to the same addresses
+            for (size_t shard = 0; shard < nshards; shard++)
+            {
+                const ResponseHandler::shared_pointer& handler(shard ? shardHandlers[shard-1] : responseHandler);
+
+                // where to bind (listen) address
+                osiSockAddr listenLocalAddress;
+                memset(&listenLocalAddress, 0, sizeof(listenLocalAddress));
+                listenLocalAddress.ia.sin_family = AF_INET;
+                listenLocalAddress.ia.sin_port = htons(listenPort);
+                listenLocalAddress.ia.sin_addr.s_addr = node.addr.ia.sin_addr.s_addr;
+
+                BlockingUDPTransport::shared_pointer transport = connector->connect(
+                            nullTransportClient, handler,
+                            listenLocalAddress, PVA_PROTOCOL_REVISION,
+                            PVA_DEFAULT_PRIORITY);
+                if (!transport)
+                    continue;
+                listenLocalAddress = transport->getRemoteAddress();
 
-            tappedNIF.push_back(listenLocalAddress);
+                transport->setIgnoredAddresses(ignoreAddressVector);
 
+                if (shard == 0)
+                {
+                    tappedNIF.push_back(listenLocalAddress);
+                    // the kernel picks one of the group for each unicast datagram
+                    if (nshards > 1)
+                        transport->steerToShards(unsigned(nshards));
+                }
 
-            BlockingUDPTransport::shared_pointer transport2;
+                BlockingUDPTransport::shared_pointer transport2;
 
-            if(!node.validBcast || node.bcast.sa.sa_family != AF_INET ||
-                    node.bcast.ia.sin_addr.s_addr == listenLocalAddress.ia.sin_addr.s_addr) {
-                // warning if not point-to-point
-                LOG(node.bcast.sa.sa_family != AF_INET ? logLevelDebug : logLevelWarn,
-                    "Unable to find broadcast address of interface %s.", inetAddressToString(node.addr, false).c_str());
-            }
+                if(!node.validBcast || node.bcast.sa.sa_family != AF_INET ||
+                        node.bcast.ia.sin_addr.s_addr == listenLocalAddress.ia.sin_addr.s_addr) {
+                    // warning if not point-to-point
+                    LOG(node.bcast.sa.sa_family != AF_INET ? logLevelDebug : logLevelWarn,
+                        "Unable to find broadcast address of interface %s.", inetAddressToString(node.addr, false).c_str());
+                }
 #if !defined(_WIN32)
-            else
-            {
-                /* An oddness of BSD sockets (not winsock) is that binding to
-                 * INADDR_ANY will receive unicast and broadcast, but binding to
-                 * a specific interface address receives only unicast.  The trick
-                 * is to bind a second socket to the interface broadcast address,
-                 * which will then receive only broadcasts.
-                 */
-
-                osiSockAddr bcastAddress;
-                memset(&bcastAddress, 0, sizeof(bcastAddress));
-                bcastAddress.ia.sin_family = AF_INET;
-                bcastAddress.ia.sin_port = htons(listenPort);
-                bcastAddress.ia.sin_addr.s_addr = node.bcast.ia.sin_addr.s_addr;
-
-                transport2 = connector->connect(
-                                 nullTransportClient, responseHandler,
-                                 bcastAddress, PVA_PROTOCOL_REVISION,
-                                 PVA_DEFAULT_PRIORITY);
-                if (transport2)
+                else
                 {
-                    /* The other wrinkle is that nothing should be sent from this second
-                     * socket. So replies are made through the unicast socket.
-                     *
-                    transport2->setReplyTransport(transport);
-                    */
-                    // NOTE: search responses all always send from sendTransport
+                    /* An oddness of BSD sockets (not winsock) is that binding to
+                     * INADDR_ANY will receive unicast and broadcast, but binding to
+                     * a specific interface address receives only unicast.  The trick
+                     * is to bind a second socket to the interface broadcast address,
+                     * which will then receive only broadcasts.
+                     */
+
+                    osiSockAddr bcastAddress;
+                    memset(&bcastAddress, 0, sizeof(bcastAddress));
+                    bcastAddress.ia.sin_family = AF_INET;
+                    bcastAddress.ia.sin_port = htons(listenPort);
+                    bcastAddress.ia.sin_addr.s_addr = node.bcast.ia.sin_addr.s_addr;
+
+                    transport2 = connector->connect(
+                                     nullTransportClient, handler,
+                                     bcastAddress, PVA_PROTOCOL_REVISION,
+                                     PVA_DEFAULT_PRIORITY);
+                    if (transport2)
+                    {
+                        /* The other wrinkle is that nothing should be sent from this second
+                         * socket. So replies are made through the unicast socket.
+                         *
+                        transport2->setReplyTransport(transport);
+                        */
+                        // NOTE: search responses all always send from sendTransport
+
+                        transport2->setIgnoredAddresses(ignoreAddressVector);
+                        // but each broadcast to all of the group
+                        transport2->setShard(unsigned(shard), unsigned(nshards));
+
+                        if (shard == 0)
+                            tappedNIF.push_back(bcastAddress);
+                    }
+                }
+#endif
 
-                    transport2->setIgnoredAddresses(ignoreAddressVector);
+                transport->setMutlicastNIF(loAddr, true);
+                transport->setLocalMulticastAddress(group);
 
-                    tappedNIF.push_back(bcastAddress);
-                }
-            }
+                BlockingUDPTransport::shared_pointer transport3;
+
+                if (mcastEnabled)
+                {
+                    try
+                    {
+#if !defined(_WIN32)
+                        /* Like broadcasts, a socket bound to the group receives only the group,
+                         * and with IP_MULTICAST_ALL cleared only from the interface it joined on.
+                         * So nothing received needs to be filtered.
+                         */
+                        osiSockAddr groupAddress(mcastGroup);
+                        groupAddress.ia.sin_port = htons(listenPort);
+
+                        transport3 = connector->connect(
+                                         nullTransportClient, handler,
+                                         groupAddress, PVA_PROTOCOL_REVISION,
+                                         PVA_DEFAULT_PRIORITY);
+                        if (transport3)
+                        {
+                            transport3->setMulticastAll(false);
+                            transport3->join(mcastGroup, node.addr);
+                            transport3->setIgnoredAddresses(ignoreAddressVector);
+                            transport3->setShard(unsigned(shard), unsigned(nshards));
+                        }
+#else
+                        // winsock delivers the group to a socket bound to the interface address
+                        transport->join(mcastGroup, node.addr);
 #endif
+                        LOG(logLevelDebug, "Joined multicast group %s on interface %s.",
+                            inetAddressToString(mcastGroup, false).c_str(),
+                            inetAddressToString(node.addr, false).c_str());
+                    }
+                    catch (std::exception& ex)
+                    {
+                        LOG(logLevelWarn, "Not receiving multicast on interface %s: %s",
+                            inetAddressToString(node.addr, false).c_str(), ex.what());
+                        if (transport3)
+                            transport3->close();
+                        transport3.reset();
+                    }
+                }
 
-            transport->setMutlicastNIF(loAddr, true);
-            transport->setLocalMulticastAddress(group);
+                transport->start();
+                udpTransports.push_back(transport);
 
-            transport->start();
-            udpTransports.push_back(transport);
+                if (transport2)
+                {
+                    transport2->start();
+                    udpTransports.push_back(transport2);
+                }
 
-            if (transport2)
-            {
-                transport2->start();
-                udpTransports.push_back(transport2);
+                if (transport3)
+                {
+                    transport3->start();
+                    udpTransports.push_back(transport3);
+                }
             }
         }
         catch (std::exception& e)
@@ -804,26 +1216,29 @@ void initializeUDPTransports(bool serverFlag,
     anyAddress.ia.sin_port = htons(listenPort);
 #endif
 
-    BlockingUDPTransport::shared_pointer localMulticastTransport;
     try
     {
-        // NOTE: multicast receiver socket must be "bound" to INADDR_ANY or multicast address
-        localMulticastTransport = connector->connect(
-                                      nullTransportClient, responseHandler,
+        for (size_t shard = 0; shard < nshards; shard++)
+        {
+            // NOTE: multicast receiver socket must be "bound" to INADDR_ANY or multicast address
+            BlockingUDPTransport::shared_pointer localMulticastTransport = connector->connect(
+                                          nullTransportClient, shard ? shardHandlers[shard-1] : responseHandler,
 #if !defined(_WIN32)
-                                      group,
+                                          group,
 #else
-                                      anyAddress,
+                                          anyAddress,
 #endif
-                                      PVA_PROTOCOL_REVISION,
-                                      PVA_DEFAULT_PRIORITY);
-        if (!localMulticastTransport)
-            throw std::runtime_error("Failed to bind UDP socket.");
-
-        localMulticastTransport->setTappedNIF(tappedNIF);
-        localMulticastTransport->join(group, loAddr);
-        localMulticastTransport->start();
-        udpTransports.push_back(localMulticastTransport);
+                                          PVA_PROTOCOL_REVISION,
+                                          PVA_DEFAULT_PRIORITY);
+            if (!localMulticastTransport)
+                throw std::runtime_error("Failed to bind UDP socket.");
+
+            localMulticastTransport->setTappedNIF(tappedNIF);
+            localMulticastTransport->setShard(unsigned(shard), unsigned(nshards));
+            localMulticastTransport->join(group, loAddr);
+            localMulticastTransport->start();
+            udpTransports.push_back(localMulticastTransport);
+        }
 
         LOG(logLevelDebug, "Local multicast enabled on %s/%s.",
             inetAddressToString(loAddr, false).c_str(),
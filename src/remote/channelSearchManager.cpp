@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <vector>
+#include <algorithm>
 
 #include <pv/timeStamp.h>
 
@@ -16,6 +17,7 @@
 #include <pv/blockingUDP.h>
 #include <pv/serializeHelper.h>
 #include <pv/logger.h>
+#include <pv/pvaProbes.h>
 
 using namespace std;
 using namespace epics::pvData;
@@ -45,11 +47,66 @@ public:
     }
 };
 
+typedef std::vector<std::pair<pva::pvAccessID, pva::InternedName> > frameChannels_t;
+
+// the channels of one search request frame, sent to a name server over TCP
+// in the byte order of that connection
+class SearchFrameSender: public pva::TransportSender
+{
+    const int32 sequenceNumber;
+    const osiSockAddr responseAddress;
+    frameChannels_t channels;
+public:
+    SearchFrameSender(int32 sequenceNumber, const osiSockAddr& responseAddress, frameChannels_t& channels)
+        :sequenceNumber(sequenceNumber)
+        ,responseAddress(responseAddress)
+    {
+        this->channels.swap(channels);
+    }
+    virtual ~SearchFrameSender() {}
+
+    virtual void send(epics::pvData::ByteBuffer* buffer, pva::TransportSendControl* control) OVERRIDE FINAL
+    {
+        control->startMessage(pva::CMD_SEARCH, 4+1+3+16+2+1+1+3+2);
+
+        buffer->putInt(sequenceNumber);
+        buffer->putByte((int8_t)0x00);  // no reply required
+        // reserved part
+        buffer->putByte((int8_t)0);
+        buffer->putShort((int16_t)0);
+
+        pva::encodeAsIPv6Address(buffer, &responseAddress);
+        buffer->putShort((int16_t)ntohs(responseAddress.ia.sin_port));
+
+        buffer->putByte((int8_t)1);
+        pva::SerializeHelper::serializeString("tcp", buffer, control);
+        buffer->putShort((int16_t)channels.size());
+
+        for (size_t i = 0; i < channels.size(); i++)
+        {
+            const std::string& name(channels[i].second.str());
+            control->ensureBuffer(4 + 5 + name.size());
+            buffer->putInt(channels[i].first);
+            pva::SerializeHelper::serializeString(name, buffer, control);
+        }
+    }
+};
+
 }// namespace
 
 namespace epics {
 namespace pvAccess {
 
+namespace {
+// a channel due to be searched for, and log2 of the number of times it has been
+typedef std::pair<int, SearchInstance::shared_pointer> due_t;
+
+bool lowerLevel(const due_t& lhs, const due_t& rhs)
+{
+    return lhs.first < rhs.first;
+}
+}
+
 // these are byte offset in a CMD_SEARCH request message
 // used to mangle a buffer to support incremental construction.  (ick!!!)
 const int ChannelSearchManager::DATA_COUNT_POSITION = PVA_MESSAGE_HEADER_SIZE + 4+1+3+16+2+1+4;
@@ -66,7 +123,19 @@ const int ChannelSearchManager::BOOST_VALUE = 1;
 const int ChannelSearchManager::MAX_COUNT_VALUE = 1 << 8;
 const int ChannelSearchManager::MAX_FALLBACK_COUNT_VALUE = (1 << 7) + 1;
 
+// unicast destinations which don't answer are sent a channel's first, and 16th and later, searches
+const int ChannelSearchManager::MAX_DESTINATION_LEVEL = 4;
+
+// more than the most callbacks between two searches of a channel
+const size_t ChannelSearchManager::WHEEL_SIZE = MAX_COUNT_VALUE;
+const size_t ChannelSearchManager::NOT_SCHEDULED = size_t(-1);
+
+// default for EPICS_PVA_BOOST_HOLDOFF, seconds
+const double ChannelSearchManager::BOOST_HOLDOFF = 2.0;
+
 const int ChannelSearchManager::MAX_FRAMES_AT_ONCE = 10;
+// default for EPICS_PVA_MAX_SEARCH_FRAMES
+const int ChannelSearchManager::MAX_FRAMES_PER_CALLBACK = 20;
 const int ChannelSearchManager::DELAY_BETWEEN_FRAMES_MS = 50;
 
 
@@ -76,10 +145,18 @@ ChannelSearchManager::ChannelSearchManager(Context::shared_pointer const & conte
     m_canceled(),
     m_sequenceNumber(0),
     m_sendBuffer(MAX_UDP_UNFRAGMENTED_SEND),
+    m_frameLevel(0),
+    m_maxFrames(MAX_FRAMES_PER_CALLBACK),
     m_channels(),
+    m_wheel(WHEEL_SIZE),
+    m_tick(0u),
+    m_balanceWindow(0.0),
     m_lastTimeSent(),
+    m_lastBoostTime(0),
+    m_boostHoldoff(int64_t(BOOST_HOLDOFF*1000)),
+    m_boostPending(false),
+    m_boostsMerged(0),
     m_channelMutex(),
-    m_userValueMutex(),
     m_mutex()
 {
     // initialize random seed with some random value
@@ -88,17 +165,42 @@ ChannelSearchManager::ChannelSearchManager(Context::shared_pointer const & conte
 
 void ChannelSearchManager::activate()
 {
-    m_responseAddress = Context::shared_pointer(m_context)->getSearchTransport()->getRemoteAddress();
+    Context::shared_pointer context(m_context);
+    Transport::shared_pointer tt = context->getSearchTransport();
+    m_responseAddress = tt->getRemoteAddress();
 
-    // initialize send buffer
-    initializeSendBuffer();
+    {
+        Lock guard(m_mutex);
+
+        BlockingUDPTransport::shared_pointer ut = std::tr1::static_pointer_cast<BlockingUDPTransport>(tt);
+        const InetAddrVector& addresses = ut->getSendAddresses();
+        const std::vector<bool>& unicast = ut->getSendAddressUnicast();
+        for (size_t i = 0; i < addresses.size() && i < unicast.size(); i++)
+        {
+            if (!unicast[i])
+                continue;
+            Destination dest;
+            dest.address = addresses[i];
+            dest.level = 0;
+            dest.sent = dest.answered = false;
+            dest.framesSent = dest.responses = 0;
+            m_destinations.push_back(dest);
+        }
+
+        m_maxFrames = context->getConfiguration()->getPropertyAsInteger("EPICS_PVA_MAX_SEARCH_FRAMES", m_maxFrames);
+        double holdoff = context->getConfiguration()->getPropertyAsDouble("EPICS_PVA_BOOST_HOLDOFF", BOOST_HOLDOFF);
+        m_boostHoldoff = holdoff > 0.0 ? int64_t(holdoff*1000) : 0;
+        double window = context->getConfiguration()->getPropertyAsDouble("EPICS_PVA_LOAD_BALANCE_WINDOW", m_balanceWindow);
+        m_balanceWindow = window > 0.0 ? window : 0.0;
+
+        // initialize send buffer
+        initializeSendBuffer();
+    }
 
     // add some jitter so that all the clients do not send at the same time
     double period = ATOMIC_PERIOD + (rand() % (2*PERIOD_JITTER_MS+1) - PERIOD_JITTER_MS)/(double)1000;
 
-    Context::shared_pointer context(m_context.lock());
-    if (context)
-        context->getTimer()->schedulePeriodic(shared_from_this(), period, period);
+    context->getTimer()->schedulePeriodic(shared_from_this(), period, period);
 }
 
 ChannelSearchManager::~ChannelSearchManager()
@@ -136,14 +238,20 @@ void ChannelSearchManager::registerSearchInstance(SearchInstance::shared_pointer
     bool immediateTrigger;
     {
         Lock guard(m_channelMutex);
+        pvAccessID id = channel->getSearchInstanceID();
 
         // overrides if already registered
-        m_channels[channel->getSearchInstanceID()] = channel;
-        immediateTrigger = (m_channels.size() == 1);
+        Entry& entry = m_channels[id];
+        unschedule(id, entry);
+        entry.instance = channel;
+
+        // searched when the count reaches a power of two
+        int32_t initial = penalize ? MAX_FALLBACK_COUNT_VALUE : DEFAULT_USER_VALUE;
+        entry.count = nextPowerOfTwo(initial);
+        schedule(id, entry, entry.count - initial);
 
-        Lock guard2(m_userValueMutex);
-        int32_t& userValue = channel->getUserValue();
-        userValue = (penalize ? MAX_FALLBACK_COUNT_VALUE : DEFAULT_USER_VALUE);
+        m_balancing.erase(id);
+        immediateTrigger = (m_channels.size() == 1);
     }
 
     if (immediateTrigger)
@@ -154,19 +262,100 @@ void ChannelSearchManager::unregisterSearchInstance(SearchInstance::shared_point
 {
     Lock guard(m_channelMutex);
     pvAccessID id = channel->getSearchInstanceID();
-    m_channels.erase(id);
+    m_channels_t::iterator it(m_channels.find(id));
+    if (it != m_channels.end())
+    {
+        unschedule(id, it->second);
+        m_channels.erase(it);
+    }
+    m_balancing.erase(id);
+}
+
+void ChannelSearchManager::schedule(pvAccessID id, Entry& entry, int32_t delay)
+{
+    std::vector<pvAccessID>& slot = m_wheel[(m_tick + size_t(delay)) % WHEEL_SIZE];
+    entry.slot = (m_tick + size_t(delay)) % WHEEL_SIZE;
+    entry.pos = slot.size();
+    slot.push_back(id);
 }
 
+void ChannelSearchManager::unschedule(pvAccessID id, Entry& entry)
+{
+    if (entry.slot == NOT_SCHEDULED)
+        return;
+
+    // move the last of the slot into this place
+    std::vector<pvAccessID>& slot = m_wheel[entry.slot];
+    pvAccessID last = slot.back();
+    slot[entry.pos] = last;
+    slot.pop_back();
+    if (last != id)
+        m_channels.find(last)->second.pos = entry.pos;
+
+    entry.slot = NOT_SCHEDULED;
+}
+
+struct BalanceTimer : public TimerCallback
+{
+    const ChannelSearchManager::weak_pointer manager;
+    const pvAccessID cid;
+    BalanceTimer(const ChannelSearchManager::shared_pointer& manager, pvAccessID cid)
+        :manager(manager), cid(cid) {}
+    virtual ~BalanceTimer() {}
+    virtual void callback() OVERRIDE FINAL {
+        ChannelSearchManager::shared_pointer M(manager.lock());
+        if (M)
+            M->balanceComplete(cid);
+    }
+    virtual void timerStopped() OVERRIDE FINAL {}
+};
+
 void ChannelSearchManager::searchResponse(const ServerGUID & guid, pvAccessID cid, int32_t /*seqNo*/, int8_t minorRevision, osiSockAddr* serverAddress)
 {
+    if (serverAddress)
+    {
+        Lock guard(m_mutex);
+        for (size_t i = 0; i < m_destinations.size(); i++)
+        {
+            Destination& dest = m_destinations[i];
+            if (dest.address.ia.sin_addr.s_addr != serverAddress->ia.sin_addr.s_addr)
+                continue;
+            dest.answered = true;
+            dest.responses++;
+            dest.level = 0;
+        }
+    }
+
+    Context::shared_pointer ctxt(m_context.lock());
+    // TODO: proper action if !ctxt???
+    if(!ctxt) return;
+
+    Candidate candidate;
+    candidate.known = false;
+    if (m_balanceWindow > 0.0 && serverAddress)
+    {
+        candidate.guid = guid;
+        candidate.minorRevision = minorRevision;
+        candidate.address = *serverAddress;
+        candidate.known = ctxt->getServerLoad(*serverAddress, candidate.load);
+    }
+
     Lock guard(m_channelMutex);
     m_channels_t::iterator channelsIter = m_channels.find(cid);
     if(channelsIter == m_channels.end())
     {
+        if (m_balanceWindow > 0.0 && serverAddress)
+        {
+            m_balancing_t::iterator it(m_balancing.find(cid));
+            if (it != m_balancing.end())
+            {
+                // another server answers within the window
+                it->second.candidates.push_back(candidate);
+                return;
+            }
+        }
+
         guard.unlock();
-        Context::shared_pointer ctxt(m_context.lock());
-        // TODO: proper action if !ctxt???
-        if(!ctxt) return;
 
         // enable duplicate reports
         SearchInstance::shared_pointer si = std::tr1::dynamic_pointer_cast<SearchInstance>(ctxt->getChannel(cid));
@@ -175,10 +364,25 @@ void ChannelSearchManager::searchResponse(const ServerGUID & guid, pvAccessID ci
     }
     else
     {
-        SearchInstance::shared_pointer si(channelsIter->second.lock());
+        SearchInstance::shared_pointer si(channelsIter->second.instance.lock());
 
         // remove from search list
-        m_channels.erase(cid);
+        unschedule(cid, channelsIter->second);
+        m_channels.erase(channelsIter);
+
+        if (si && candidate.known)
+        {
+            // wait briefly for other servers with this channel
+            Balancing& balancing = m_balancing[cid];
+            balancing.instance = si;
+            balancing.candidates.push_back(candidate);
+
+            guard.unlock();
+
+            TimerCallback::shared_pointer timer(new BalanceTimer(shared_from_this(), cid));
+            ctxt->getTimer()->scheduleAfterDelay(timer, m_balanceWindow);
+            return;
+        }
 
         guard.unlock();
 
@@ -188,12 +392,97 @@ void ChannelSearchManager::searchResponse(const ServerGUID & guid, pvAccessID ci
     }
 }
 
+void ChannelSearchManager::balanceComplete(pvAccessID cid)
+{
+    SearchInstance::shared_pointer si;
+    std::vector<Candidate> candidates;
+    {
+        Lock guard(m_channelMutex);
+        m_balancing_t::iterator it(m_balancing.find(cid));
+        if (it == m_balancing.end())
+            return;
+        si = it->second.instance.lock();
+        candidates.swap(it->second.candidates);
+        m_balancing.erase(it);
+    }
+    if (!si || candidates.empty())
+        return;
+
+    // least loaded of those advertising load, otherwise the first to answer
+    std::stable_sort(candidates.begin(), candidates.end(), lessLoaded);
+
+    Candidate& chosen = candidates[0];
+    LOG(logLevelDebug, "Channel '%s' on %s, least loaded of %u servers",
+        si->getSearchInstanceName().c_str(), inetAddressToString(chosen.address).c_str(), unsigned(candidates.size()));
+
+    si->searchResponse(chosen.guid, chosen.minorRevision, &chosen.address);
+
+    // then the others, as duplicates, next least loaded first.  eg. as a standby
+    for (size_t i = 1; i < candidates.size(); i++)
+        si->searchResponse(candidates[i].guid, candidates[i].minorRevision, &candidates[i].address);
+}
+
+bool ChannelSearchManager::lessLoaded(const Candidate& a, const Candidate& b)
+{
+    if (a.known != b.known)
+        return a.known;
+    return a.known && a.load < b.load;
+}
+
 void ChannelSearchManager::newServerDetected()
 {
-    boost();
+    {
+        // many servers starting together (eg. a power cycled rack) cause one boost
+        Lock guard(m_mutex);
+
+        epics::pvData::TimeStamp now;
+        now.getCurrent();
+        int64_t nowMS = now.getMilliseconds();
+
+        if (nowMS - m_lastBoostTime < m_boostHoldoff)
+        {
+            m_boostPending = true;
+            m_boostsMerged++;
+            return;
+        }
+        m_lastBoostTime = nowMS;
+        m_boostPending = false;
+        m_boostsMerged = 0;
+    }
+
+    boostAll();
     callback();
 }
 
+void ChannelSearchManager::addNameServer(Transport::shared_pointer const & transport)
+{
+    {
+        Lock guard(m_mutex);
+        for (size_t i = 0; i < m_nameServers.size(); i++)
+        {
+            if (m_nameServers[i].lock() == transport)
+                return;
+        }
+        m_nameServers.push_back(transport);
+    }
+
+    // search for everything through the new connection, from the next timer callback
+    boost();
+}
+
+void ChannelSearchManager::removeNameServer(Transport::shared_pointer const & transport)
+{
+    Lock guard(m_mutex);
+    for (size_t i = 0; i < m_nameServers.size(); )
+    {
+        Transport::shared_pointer other(m_nameServers[i].lock());
+        if (!other || other == transport)
+            m_nameServers.erase(m_nameServers.begin() + i);
+        else
+            i++;
+    }
+}
+
 void ChannelSearchManager::initializeSendBuffer()
 {
     // for now OK, since it is only set here
@@ -227,6 +516,9 @@ void ChannelSearchManager::initializeSendBuffer()
     MockTransportSendControl control;
     SerializeHelper::serializeString("tcp", &m_sendBuffer, &control);
     m_sendBuffer.putShort((int16_t)0);	// count
+
+    m_frameLevel = 0;
+    m_frameChannels.clear();
 }
 
 void ChannelSearchManager::flushSendBuffer()
@@ -237,9 +529,31 @@ void ChannelSearchManager::flushSendBuffer()
     BlockingUDPTransport::shared_pointer ut = std::tr1::static_pointer_cast<BlockingUDPTransport>(tt);
 
     m_sendBuffer.putByte(CAST_POSITION, (int8_t)0x80);  // unicast, no reply required
-    ut->send(&m_sendBuffer, inetAddressType_unicast);
+    for (size_t i = 0; i < m_destinations.size(); i++)
+    {
+        Destination& dest = m_destinations[i];
+        // backing off, and nothing in this frame is due for it
+        if (dest.level > m_frameLevel)
+            continue;
+
+        ut->send(m_sendBuffer.getArray(), m_sendBuffer.getPosition(), dest.address);
+        dest.sent = true;
+        dest.framesSent++;
+    }
 
     m_sendBuffer.putByte(CAST_POSITION, (int8_t)0x00);  // b/m-cast, no reply required
+
+    if (!m_nameServers.empty() && !m_frameChannels.empty())
+    {
+        TransportSender::shared_pointer frame(new SearchFrameSender(m_sequenceNumber, m_responseAddress, m_frameChannels));
+        for (size_t i = 0; i < m_nameServers.size(); i++)
+        {
+            Transport::shared_pointer transport(m_nameServers[i].lock());
+            if (transport)
+                transport->enqueueSendRequest(frame);
+        }
+    }
+
     ut->send(&m_sendBuffer, inetAddressType_broadcast_multicast);
 
     initializeSendBuffer();
@@ -273,7 +587,7 @@ bool ChannelSearchManager::generateSearchRequestMessage(SearchInstance::shared_p
 }
 
 bool ChannelSearchManager::generateSearchRequestMessage(SearchInstance::shared_pointer const & channel,
-        bool allowNewFrame, bool flush)
+        int level, bool allowNewFrame, bool flush)
 {
     MockTransportSendControl control;
 
@@ -283,13 +597,21 @@ bool ChannelSearchManager::generateSearchRequestMessage(SearchInstance::shared_p
     if(!success)
     {
         flushSendBuffer();
-        if(allowNewFrame)
-            generateSearchRequestMessage(channel, &m_sendBuffer, &control);
+        if(allowNewFrame && generateSearchRequestMessage(channel, &m_sendBuffer, &control))
+        {
+            m_frameLevel = level;
+            if (!m_nameServers.empty())
+                m_frameChannels.push_back(std::make_pair(channel->getSearchInstanceID(), channel->getSearchInstanceInternedName()));
+        }
         if (flush)
             flushSendBuffer();
         return true;
     }
 
+    m_frameLevel = std::max(m_frameLevel, level);
+    if (!m_nameServers.empty())
+        m_frameChannels.push_back(std::make_pair(channel->getSearchInstanceID(), channel->getSearchInstanceInternedName()));
+
     if (flush)
         flushSendBuffer();
 
@@ -298,20 +620,57 @@ bool ChannelSearchManager::generateSearchRequestMessage(SearchInstance::shared_p
 
 void ChannelSearchManager::boost()
 {
+    // everything is due in the next callback, except those being searched now
     Lock guard(m_channelMutex);
-    Lock guard2(m_userValueMutex);
+    for (size_t i = 0; i < m_wheel.size(); i++)
+        m_wheel[i].clear();
+
     m_channels_t::iterator channelsIter = m_channels.begin();
     for(; channelsIter != m_channels.end(); channelsIter++)
     {
-        SearchInstance::shared_pointer inst(channelsIter->second.lock());
-        if(!inst) continue;
-        int32_t& userValue = inst->getUserValue();
-        userValue = BOOST_VALUE;
+        Entry& entry = channelsIter->second;
+        entry.count = BOOST_VALUE;
+        if (entry.slot != NOT_SCHEDULED)
+        {
+            entry.slot = NOT_SCHEDULED;
+            schedule(channelsIter->first, entry, 0);
+        }
+    }
+}
+
+void ChannelSearchManager::boostAll()
+{
+    boost();
+    {
+        // might be one of the destinations which has not answered
+        Lock guard(m_mutex);
+        for (size_t i = 0; i < m_destinations.size(); i++)
+            m_destinations[i].level = 0;
+    }
+}
+
+void ChannelSearchManager::updateDestinations()
+{
+    Lock guard(m_mutex);
+    for (size_t i = 0; i < m_destinations.size(); i++)
+    {
+        Destination& dest = m_destinations[i];
+        if (dest.sent && !dest.answered && dest.level < MAX_DESTINATION_LEVEL)
+        {
+            dest.level++;
+            if (dest.level == MAX_DESTINATION_LEVEL && IS_LOGGABLE(logLevelDebug))
+            {
+                LOG(logLevelDebug, "Backing off searches to %s, which has not answered %zu frames.",
+                    inetAddressToString(dest.address).c_str(), dest.framesSent);
+            }
+        }
+        dest.sent = dest.answered = false;
     }
 }
 
 void ChannelSearchManager::callback()
 {
+    bool boostPending = false;
     // high-frequency beacon anomaly trigger guard
     {
         Lock guard(m_mutex);
@@ -323,47 +682,74 @@ void ChannelSearchManager::callback()
         if (nowMS - m_lastTimeSent < 100)
             return;
         m_lastTimeSent = nowMS;
+
+        // new servers detected while holding off
+        if (m_boostPending && nowMS - m_lastBoostTime >= m_boostHoldoff)
+        {
+            boostPending = true;
+            m_boostPending = false;
+            m_lastBoostTime = nowMS;
+            LOG(logLevelDebug, "Boosting search once for %zu new server detections.", m_boostsMerged);
+            m_boostsMerged = 0;
+        }
     }
 
+    if (boostPending)
+        boostAll();
+
+
+    // responses to the last callback have arrived by now
+    updateDestinations();
 
     int count = 0;
     int frameSent = 0;
+    int framesTotal = 0;
 
-    vector<SearchInstance::shared_pointer> toSend;
+    // only the channels due now
+    vector<due_t> due;
     {
         Lock guard(m_channelMutex);
-        toSend.reserve(m_channels.size());
+        std::vector<pvAccessID> ids;
+        ids.swap(m_wheel[m_tick % WHEEL_SIZE]);
+        m_tick++;
 
-        for(m_channels_t::iterator channelsIter = m_channels.begin();
-            channelsIter != m_channels.end(); channelsIter++)
+        due.reserve(ids.size());
+        for (size_t i = 0; i < ids.size(); i++)
         {
-            SearchInstance::shared_pointer inst(channelsIter->second.lock());
-            if(!inst) continue;
-            toSend.push_back(inst);
+            m_channels_t::iterator it(m_channels.find(ids[i]));
+            if (it == m_channels.end())
+                continue;
+            Entry& entry = it->second;
+            entry.slot = NOT_SCHEDULED;
+
+            SearchInstance::shared_pointer inst(entry.instance.lock());
+            if (!inst)
+                m_channels.erase(it);
+            else
+                due.push_back(due_t(levelOf(entry.count), inst));
         }
     }
 
-    vector<SearchInstance::shared_pointer>::iterator siter = toSend.begin();
-    for (; siter != toSend.end(); siter++)
-    {
-        m_userValueMutex.lock();
-        int32_t& countValue = (*siter)->getUserValue();
-        bool skip = !isPowerOfTwo(countValue);
+    // least searched first, so new channels are not delayed behind a long list of missing ones
+    std::stable_sort(due.begin(), due.end(), lowerLevel);
 
-        if (countValue >= MAX_COUNT_VALUE)
-            countValue = MAX_FALLBACK_COUNT_VALUE;
-        else
-            countValue++;
-        m_userValueMutex.unlock();
-
-        // back-off
-        if (skip)
-            continue;
+    size_t nsent = 0u;
+    for (; nsent < due.size(); nsent++)
+    {
+        // the rest remain due, and are sent by the next callback
+        if (m_maxFrames > 0 && framesTotal >= m_maxFrames)
+            break;
 
         count++;
 
-        if (generateSearchRequestMessage(*siter, true, false))
+        // a channel's first search goes to every destination, so that a server which
+        // hosts none of the names searched for until now is not backed off for a new one
+        const int level = due[nsent].first == 0 ? MAX_DESTINATION_LEVEL : due[nsent].first;
+        if (generateSearchRequestMessage(due[nsent].second, level, true, false))
+        {
             frameSent++;
+            framesTotal++;
+        }
         if (frameSent == MAX_FRAMES_AT_ONCE)
         {
             epicsThreadSleep(DELAY_BETWEEN_FRAMES_MS/(double)1000.0);
@@ -371,13 +757,56 @@ void ChannelSearchManager::callback()
         }
     }
 
+    {
+        Lock guard(m_channelMutex);
+        for (size_t i = 0; i < due.size(); i++)
+        {
+            pvAccessID id = due[i].second->getSearchInstanceID();
+            m_channels_t::iterator it(m_channels.find(id));
+            // found, or registered again (eg. by a boost), meanwhile
+            if (it == m_channels.end() || it->second.slot != NOT_SCHEDULED)
+                continue;
+            Entry& entry = it->second;
+
+            if (i >= nsent)
+            {
+                schedule(id, entry, 0);
+            }
+            else if (entry.count >= MAX_COUNT_VALUE)
+            {
+                // then every MAX_COUNT_VALUE - MAX_FALLBACK_COUNT_VALUE + 1 callbacks
+                schedule(id, entry, MAX_COUNT_VALUE - MAX_FALLBACK_COUNT_VALUE);
+            }
+            else
+            {
+                // searched after twice as many callbacks as the last time
+                schedule(id, entry, entry.count - 1);
+                entry.count *= 2;
+            }
+        }
+    }
+
     if (count > 0)
         flushSendBuffer();
+    m_namesSearched.increment(size_t(count));
+
+    PVA_PROBE3(search_round, due.size(), count, framesTotal);
+}
+
+int32_t ChannelSearchManager::nextPowerOfTwo(int32_t x)
+{
+    int32_t ret = 1;
+    while (ret < x)
+        ret <<= 1;
+    return ret;
 }
 
-bool ChannelSearchManager::isPowerOfTwo(int32_t x)
+int ChannelSearchManager::levelOf(int32_t x)
 {
-    return ((x > 0) && (x & (x - 1)) == 0);
+    int ret = 0;
+    while (x >>= 1)
+        ret++;
+    return ret;
 }
 
 void ChannelSearchManager::timerStopped()
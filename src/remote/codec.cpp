@@ -8,14 +8,38 @@
 #include <string>
 #include <vector>
 #include <limits>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
+#include <string.h>
+#include <math.h>
 #include <sys/types.h>
 
+#ifdef PVA_HAVE_LZ4
+#  include <lz4.h>
+#endif
+
+#if !defined(_WIN32) && !defined(vxWorks)
+#  define PVA_CODEC_USE_SENDMSG
+#  include <sys/socket.h>
+#  include <sys/uio.h>
+#endif
+
+#ifdef __linux__
+#  include <sys/ioctl.h>
+#  include <linux/sockios.h>
+#  include <linux/net_tstamp.h>
+#endif
+
+#if defined(__linux__) && defined(SO_TIMESTAMPING) && defined(SCM_TIMESTAMPING)
+#  define PVA_CODEC_RX_STAMPS
+#endif
+
 #include <osiSock.h>
 #include <epicsTime.h>
 #include <epicsThread.h>
 #include <epicsVersion.h>
+#include <epicsString.h>
 
 #include <pv/byteBuffer.h>
 #include <pv/pvType.h>
@@ -35,11 +59,18 @@
 #include <pv/serializationHelper.h>
 #include <pv/serverChannelImpl.h>
 #include <pv/clientContextImpl.h>
+#include <pv/pvAccessMB.h>
+#include <pv/pvaProbes.h>
 
 using namespace std;
 using namespace epics::pvData;
 using namespace epics::pvAccess;
 
+// stages of each message received and sent, by the receive and send threads
+MB_DECLARE(pvaCodec, 65536);
+// stages of each get operation, by ioid, see responseHandlers.cpp and clientContextImpl.cpp
+MB_DECLARE(pvaRequest, 65536);
+
 namespace {
 struct BreakTransport : TransportSender
 {
@@ -75,6 +106,172 @@ const std::size_t AbstractCodec::MAX_ENSURE_DATA_SIZE = MAX_ENSURE_SIZE/2;
 const std::size_t AbstractCodec::MAX_ENSURE_BUFFER_SIZE = MAX_ENSURE_SIZE;
 const std::size_t AbstractCodec::MAX_ENSURE_DATA_BUFFER_SIZE = 1024;
 
+namespace {
+// adds the CPU time used by the calling thread, while in scope, to a counter
+struct CPUAccount {
+    size_t * const counter;
+    const double start;
+    explicit CPUAccount(size_t *counter)
+        :counter(counter)
+        ,start(counter ? ThreadCPUClock::self() : 0.0)
+    {}
+    ~CPUAccount() {
+        if(counter)
+            TransportStatistics::add(*counter, size_t((ThreadCPUClock::self() - start)*1e6));
+    }
+};
+
+/* eg. "rx 10.1.2.3:5075".  Linux keeps only the first 15 characters of a thread name,
+ * so leading octets are dropped as needed to keep the port, eg. "rx .1.2.3:46120"
+ */
+std::string threadName(const char *prefix, const std::string& peer)
+{
+    const size_t maxLen = 15u;
+    std::string ret(prefix);
+    ret += ' ';
+    size_t start = 0u;
+    while(ret.size() + peer.size() - start > maxLen) {
+        size_t dot = peer.find('.', start+1u);
+        if(dot==std::string::npos)
+            break;
+        start = dot;
+    }
+    ret += peer.substr(start);
+    return ret;
+}
+
+/* Pin the calling thread to CPU want-1, of a low latency priority class, or if want is 0 to otherwise,
+ * if want changed from current.
+ */
+void followAffinity(int want, int& current, const CPUAffinity& otherwise)
+{
+    if(want==current)
+        return;
+    current = want;
+    CPUAffinity single;
+    if(want>0)
+        single.add(unsigned(want-1));
+    const CPUAffinity& cpus = want>0 ? single : otherwise;
+    if(!cpus.pin())
+        LOG(logLevelWarn, "Unable to pin thread to CPUs %s", cpus.toString().c_str());
+}
+
+/* The entry of EPICS_PVAS_CPU_AFFINITY for a connection to local address, eg. "10.0.0.5=0-7 numa".
+ * Each entry is [address=]cpus, where cpus is a list, or "numa" for those of the NUMA node
+ * of the interface.  One with an address which matches is preferred to one without.
+ * @returns false if none applies
+ */
+bool affinityFor(const std::string& spec, const osiSockAddr& local, CPUAffinity& cpus, int& node)
+{
+    std::istringstream strm(spec);
+    std::string entry, chosen;
+    bool matched = false;
+    while(strm>>entry) {
+        size_t sep = entry.find('=');
+        if(sep==std::string::npos) {
+            if(chosen.empty())
+                chosen = entry;
+            continue;
+        }
+        osiSockAddr addr;
+        if(aToIPAddr(entry.substr(0, sep).c_str(), 0, &addr.ia)) {
+            LOG(logLevelWarn, "Ignoring '%s' in EPICS_PVAS_CPU_AFFINITY, expected [address=]cpus", entry.c_str());
+        } else if(!matched && addr.ia.sin_addr.s_addr==local.ia.sin_addr.s_addr) {
+            chosen = entry.substr(sep+1u);
+            matched = true;
+        }
+    }
+    if(chosen.empty())
+        return false;
+
+    if(chosen=="numa") {
+        node = CPUAffinity::nodeOfAddress(local);
+        cpus = CPUAffinity::ofNode(node);
+    } else if(cpus.parse(chosen)) {
+        node = cpus.node();
+    } else {
+        LOG(logLevelWarn, "Ignoring '%s' in EPICS_PVAS_CPU_AFFINITY, expected a list of CPUs or 'numa'", chosen.c_str());
+        return false;
+    }
+    return true;
+}
+
+// the outermost SendBatch, and ReceiveBatch, of each thread
+epicsThreadOnceId sendBatchOnce = EPICS_THREAD_ONCE_INIT;
+epicsThreadPrivateId sendBatchCurrent;
+epicsThreadPrivateId receiveBatchCurrent;
+
+void sendBatchInit(void*)
+{
+    sendBatchCurrent = epicsThreadPrivateCreate();
+    receiveBatchCurrent = epicsThreadPrivateCreate();
+}
+} // namespace
+
+TransportStatistics::TransportStatistics()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+void TransportStatistics::snapshot(TransportStatistics& out) const
+{
+#ifdef PVA_CODEC_STATS_ATOMIC
+#  define GETSTAT(NAME) out.NAME = epics::atomic::get(NAME)
+#else
+#  define GETSTAT(NAME) out.NAME = NAME
+#endif
+    GETSTAT(bytesSent);
+    GETSTAT(bytesReceived);
+    GETSTAT(sendCalls);
+    GETSTAT(recvCalls);
+    GETSTAT(partialWrites);
+    GETSTAT(sendStallUS);
+    GETSTAT(compressedSegments);
+    GETSTAT(compressIn);
+    GETSTAT(compressOut);
+    GETSTAT(compressUS);
+    GETSTAT(inflatedSegments);
+    GETSTAT(inflateUS);
+    GETSTAT(slowSquashed);
+    GETSTAT(slowDropped);
+    GETSTAT(slowDisconnects);
+    GETSTAT(rxCPUUS);
+    GETSTAT(txCPUUS);
+    for(size_t i=0; i<=maxCommand; i++) {
+        GETSTAT(messagesSent[i]);
+        GETSTAT(messagesReceived[i]);
+    }
+#undef GETSTAT
+}
+
+const char* TransportStatistics::commandName(int8 command)
+{
+    static const char* names[] = {
+        "beacon", "validation", "echo", "search", "search_response", "authnz", "acl_change",
+        "create_channel", "destroy_channel", "validated", "get", "put", "putget", "monitor",
+        "array", "destroy_request", "process", "get_field", "message", "multiple_data", "rpc",
+        "cancel_request", "origin_tag", "trace_context"
+    };
+    const uint8 cmd = command;
+    return cmd < sizeof(names)/sizeof(names[0]) ? names[cmd] : "other";
+}
+
+size_t TransportStatistics::totalMessagesSent() const
+{
+    size_t ret = 0;
+    for(size_t i=0; i<=maxCommand; i++)
+        ret += messagesSent[i];
+    return ret;
+}
+
+size_t TransportStatistics::totalMessagesReceived() const
+{
+    size_t ret = 0;
+    for(size_t i=0; i<=maxCommand; i++)
+        ret += messagesReceived[i];
+    return ret;
+}
+
 static
 size_t bufSizeSelect(size_t request)
 {
@@ -92,17 +289,28 @@ AbstractCodec::AbstractCodec(
     _remoteTransportSocketReceiveBufferSize(MAX_TCP_RECV), _totalBytesSent(0),
     _senderThread(0),
     _writeMode(PROCESS_SEND_QUEUE),
-    _writeOpReady(false),_lowLatency(false),
-    _socketBuffer(bufSizeSelect(receiveBufferSize)),
-    _sendBuffer(bufSizeSelect(sendBufferSize)),
+    _writeOpReady(false),_lowLatency(false),_setAsideUnsent(false),
+    _socketBlock(bufSizeSelect(receiveBufferSize)),
+    _sendBlock(bufSizeSelect(sendBufferSize)),
+    _socketBuffer(_socketBlock.data(), _socketBlock.size()),
+    _sendBuffer(_sendBlock.data(), _sendBlock.size()),
     //PRIVATE
     _storedPayloadSize(0), _storedPosition(0), _startPosition(0),
     _maxSendPayloadSize(_sendBuffer.getSize() - 2*PVA_MESSAGE_HEADER_SIZE),    // start msg + control
+    _segmentSize(_sendBuffer.getSize()),
     _lastMessageStartPosition(std::numeric_limits<size_t>::max()),_lastSegmentedMessageType(0),
     _lastSegmentedMessageCommand(0), _nextMessagePayloadOffset(0),
     _byteOrderFlag(EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG ? 0x80 : 0x00),
     _clientServerFlag(serverFlag ? 0x40 : 0x00),
-    _socketSendBufferSize(socketSendBufferSize)
+    _socketSendBufferSize(socketSendBufferSize),
+    _blockingProcessQueue(blockingProcessQueue),
+    _receiveWindow(0), _receiveWindowMin(0), _receiveWindowMax(0),
+    _receiveWindowFilled(0), _receiveWindowShort(0),
+    _coalesceWindow(0.0), _coalesceBytes(0), _coalescing(false),
+    _compressThreshold(0), _inflateRemainderPos(0),
+    _slowMaxQueued(0), _slowMaxBytes(0), _slowPolicy(SLOW_CONSUMER_SQUASH),
+    _congested(false), _txPendingPos(0),
+    _rxInit(false), _rxInitIOID(0)
 {
     if (_socketBuffer.getSize() < 2*MAX_ENSURE_SIZE)
         throw std::invalid_argument(
@@ -115,10 +323,92 @@ AbstractCodec::AbstractCodec(
     _socketBuffer.setPosition(_socketBuffer.getLimit());
     _startPosition = _socketBuffer.getPosition();
 
+    // by default, read() may fill the whole buffer
+    _receiveWindow = _receiveWindowMin = _receiveWindowMax = _socketBuffer.getSize() - MAX_ENSURE_SIZE;
+
     // clear send
     _sendBuffer.clear();
 }
 
+void AbstractCodec::setAdaptiveReceive(std::size_t minWindow)
+{
+    _receiveWindowMin = std::min(std::max(minWindow, MAX_ENSURE_SIZE), _receiveWindowMax);
+    _receiveWindow = _receiveWindowMin;
+    _receiveWindowFilled = _receiveWindowShort = 0;
+}
+
+void AbstractCodec::setCoalescing(double window, std::size_t bytes)
+{
+    _coalesceWindow = window > 0.0 ? window : 0.0;
+    // zero for a full segment
+    _coalesceBytes = bytes > 0 ? bytes : std::numeric_limits<size_t>::max();
+}
+
+void AbstractCodec::setSlowConsumerLimits(std::size_t maxQueued, std::size_t maxBytes,
+                                          SlowConsumerPolicy policy)
+{
+    _slowMaxQueued = maxQueued;
+    _slowMaxBytes = maxBytes;
+    _slowPolicy = policy;
+}
+
+void AbstractCodec::countSlowConsumer(SlowConsumerPolicy action, std::size_t n)
+{
+    switch(action) {
+    case SLOW_CONSUMER_SQUASH: TransportStatistics::add(_stats.slowSquashed, n); break;
+    case SLOW_CONSUMER_DROP: TransportStatistics::add(_stats.slowDropped, n); break;
+    case SLOW_CONSUMER_DISCONNECT: TransportStatistics::add(_stats.slowDisconnects, n); break;
+    }
+}
+
+void AbstractCodec::checkCongestion()
+{
+    if(!_slowMaxQueued && !_slowMaxBytes)
+        return;
+
+    _congested = (_slowMaxQueued && _sendQueue.size() > _slowMaxQueued)
+            || (_slowMaxBytes && unackedBytes() + (_txPending.size() - _txPendingPos) > _slowMaxBytes);
+
+    if(!_congested || _slowPolicy!=SLOW_CONSUMER_DISCONNECT || !isOpen())
+        return;
+
+    countSlowConsumer(SLOW_CONSUMER_DISCONNECT);
+    LOG(logLevelWarn, "Disconnecting slow client %s with %zu queued",
+        getRemoteName().c_str(), _sendQueue.size());
+    close();
+    throw connection_closed_exception("slow consumer");
+}
+
+void AbstractCodec::setSegmentSize(std::size_t size)
+{
+    size = std::min(std::max(size, 2*MAX_ENSURE_SIZE), _sendBuffer.getSize());
+    // _sendBuffer belongs to the sender, so only apply in flushSendBuffer()
+    _requestedSegmentSize.getAndSet(static_cast<int32>(size));
+}
+
+void AbstractCodec::adaptReceiveWindow(bool filled)
+{
+    // Double after a few reads in a row have filled the window (the peer is
+    // sending faster than we read), halve after many which have not.
+    // Pages of _socketBuffer beyond the window are not touched by this connection.
+    // So a large capacity costs little for an idle connection with a block fresh
+    // from malloc(), but not one re-used from BufferPool, whose pages an earlier
+    // connection may have made resident.  Then the window only bounds each read.
+    if(filled) {
+        _receiveWindowShort = 0;
+        if(++_receiveWindowFilled >= 4u) {
+            _receiveWindowFilled = 0;
+            _receiveWindow = std::min(_receiveWindow*2, _receiveWindowMax);
+        }
+    } else {
+        _receiveWindowFilled = 0;
+        if(++_receiveWindowShort >= 64u) {
+            _receiveWindowShort = 0;
+            _receiveWindow = std::max(_receiveWindow/2, _receiveWindowMin);
+        }
+    }
+}
+
 
 // thows io_exception, connection_closed_exception, invalid_stream_exception
 void AbstractCodec::processRead() {
@@ -165,16 +455,25 @@ void AbstractCodec::processHeader() {
         throw invalid_data_stream_exception("invalid header received");
     }
 
+    PVA_PROBE5(rx_header, this, int(_command), size_t(_payloadSize), int(_flags),
+               getLastReadBufferSocketAddress());
 }
 
 
 void AbstractCodec::processReadNormal()  {
 
+    // messages already received are processed before waking senders or notifying
+    ReceiveBatch batch;
+
     try
     {
         std::size_t messageProcessCount = 0;
         while (messageProcessCount++ < MAX_MESSAGE_PROCESS)
         {
+            // the deferred work is done before waiting on the socket
+            if (_socketBuffer.getRemaining() < PVA_MESSAGE_HEADER_SIZE)
+                ReceiveBatch::flushCurrent();
+
             // read as much as available, but at least for a header
             // readFromSocket checks if reading from socket is really necessary
             if (!readToBuffer(PVA_MESSAGE_HEADER_SIZE, false)) {
@@ -195,6 +494,13 @@ void AbstractCodec::processReadNormal()  {
             }
             else
             {
+                // nor while a message is only partly received, or segmented
+                if ((_flags & 0x30) || _socketBuffer.getRemaining() < std::size_t(_payloadSize))
+                    ReceiveBatch::flushCurrent();
+
+                if (_flags & 0x08)
+                    inflateSegment();
+
                 // segmented sanity check
                 bool notFirstSegment = (_flags & 0x20) != 0;
                 if (notFirstSegment)
@@ -213,6 +519,8 @@ void AbstractCodec::processReadNormal()  {
                         "not-a-first segmented message received in normal mode");
                 }
 
+                TransportStatistics::add(_stats.messagesReceived[TransportStatistics::commandIndex(_command)]);
+
                 _storedPayloadSize = _payloadSize;
                 _storedPosition = _socketBuffer.getPosition();
                 _storedLimit = _socketBuffer.getLimit();
@@ -220,9 +528,14 @@ void AbstractCodec::processReadNormal()  {
                 bool postProcess = true;
                 try
                 {
+                    MB_INC_AUTO_ID(pvaCodec);
+                    MB_POINT(pvaCodec, 0, "message received");
+
                     // handle response
                     processApplicationMessage();
 
+                    MB_POINT(pvaCodec, 1, "message handled");
+
                     if (!isOpen())
                         return;
 
@@ -336,6 +649,9 @@ void AbstractCodec::processReadSegmented() {
                     "not-a-first segmented message expected");
             }
 
+            if (_flags & 0x08)
+                inflateSegment();
+
             _storedPayloadSize = _payloadSize;
 
             // return control to caller code
@@ -373,15 +689,23 @@ bool AbstractCodec::readToBuffer(
     for (std::size_t i = _startPosition; i < endPosition; i++)
         _socketBuffer.putByte(i, _socketBuffer.getByte());
 
-    // update buffer to the new position
-    _socketBuffer.setLimit(_socketBuffer.getSize());
-    _socketBuffer.setPosition(endPosition);
-
     // read at least requiredBytes bytes
     std::size_t requiredPosition = _startPosition + requiredBytes;
+
+    // update buffer to the new position, reading no further than the window allows
+    _socketBuffer.setLimit(std::min(_socketBuffer.getSize(),
+                                    std::max(requiredPosition, _startPosition + _receiveWindow)));
+    _socketBuffer.setPosition(endPosition);
+
+    const bool adaptive = _receiveWindowMin < _receiveWindowMax;
+
     while (_socketBuffer.getPosition() < requiredPosition)
     {
-        int bytesRead = read(&_socketBuffer);
+        std::size_t requested = _socketBuffer.getRemaining();
+        int bytesRead = readSocket(&_socketBuffer);
+
+        if (adaptive && bytesRead > 0)
+            adaptReceiveWindow(std::size_t(bytesRead) >= requested);
 
         if (bytesRead < 0)
         {
@@ -412,8 +736,200 @@ bool AbstractCodec::readToBuffer(
 }
 
 
+int AbstractCodec::readSocket(ByteBuffer* dst)
+{
+    if (_inflateRemainderPos < _inflateRemainder.size())
+    {
+        std::size_t n = std::min(dst->getRemaining(), _inflateRemainder.size() - _inflateRemainderPos);
+        dst->put(&_inflateRemainder[_inflateRemainderPos], 0, n);
+        _inflateRemainderPos += n;
+        if (_inflateRemainderPos == _inflateRemainder.size()) {
+            _inflateRemainder.clear();
+            _inflateRemainderPos = 0;
+        }
+        return int(n);
+    }
+
+    const std::size_t start = dst->getPosition();
+    int bytesRead = read(dst);
+    TransportStatistics::add(_stats.recvCalls);
+    if (bytesRead > 0) {
+        TransportStatistics::add(_stats.bytesReceived, bytesRead);
+        if (_capture)
+            _capture->write(dst->getArray() + start, std::size_t(bytesRead));
+    }
+    return bytesRead;
+}
+
+
+bool AbstractCodec::compressionSupported()
+{
+#ifdef PVA_HAVE_LZ4
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void AbstractCodec::putCompressionControl()
+{
+#ifdef PVA_HAVE_LZ4
+    putControlMessage((int8)CMD_SET_COMPRESSION, static_cast<int32>(inflateLimit()));
+#endif
+}
+
+
+std::size_t AbstractCodec::inflateLimit() const
+{
+    return _socketBuffer.getSize() - 2*MAX_ENSURE_SIZE;
+}
+
+
+void AbstractCodec::inflateSegment()
+{
+#ifdef PVA_HAVE_LZ4
+    epicsTimeStamp start, end;
+    epicsTimeGetCurrent(&start);
+
+    // payload is: int32 uncompressed size, LZ4 block
+    const std::size_t compressed = std::size_t(_payloadSize);
+    if (_payloadSize < 4)
+    {
+        invalidDataStreamHandler();
+        throw invalid_data_stream_exception("compressed segment too short");
+    }
+
+    // the peer compresses no segment larger than we announced.
+    // Don't let it make us allocate more before we see what it claims.
+    if (compressed > std::size_t(LZ4_compressBound(int(inflateLimit()))) + 4)
+    {
+        invalidDataStreamHandler();
+        throw invalid_data_stream_exception("compressed segment too large");
+    }
+
+    // gather the compressed payload, first what is already buffered
+    _inflateScratch.resize(compressed);
+    std::size_t have = std::min(compressed, _socketBuffer.getRemaining());
+    _socketBuffer.get(&_inflateScratch[0], 0, have);
+
+    if (_socketBuffer.getRemaining() > 0)
+    {
+        // set aside what follows, to be returned by readSocket() before anything else
+        std::vector<char> rest(_socketBuffer.getRemaining() + _inflateRemainder.size() - _inflateRemainderPos);
+        std::size_t trailing = _socketBuffer.getRemaining();
+        _socketBuffer.get(&rest[0], 0, trailing);
+        if (_inflateRemainderPos < _inflateRemainder.size())
+            memcpy(&rest[trailing], &_inflateRemainder[_inflateRemainderPos],
+                   _inflateRemainder.size() - _inflateRemainderPos);
+        _inflateRemainder.swap(rest);
+        _inflateRemainderPos = 0;
+    }
+
+    while (have < compressed)
+    {
+        ByteBuffer wrappedBuffer(&_inflateScratch[have], compressed - have);
+        int bytesRead = readSocket(&wrappedBuffer);
+        if (bytesRead < 0)
+        {
+            close();
+            throw connection_closed_exception("bytesRead < 0");
+        }
+        else if (bytesRead == 0)
+            readPollOne();
+        have += std::size_t(bytesRead);
+    }
+
+    epicsUInt32 inflated;
+    memcpy(&inflated, &_inflateScratch[0], 4);
+    if (_socketBuffer.reverse<int32>())
+        inflated = (inflated >> 24) | ((inflated >> 8) & 0xff00u)
+                | ((inflated << 8) & 0xff0000u) | (inflated << 24);
+
+    if (inflated > inflateLimit())
+    {
+        invalidDataStreamHandler();
+        throw invalid_data_stream_exception("compressed segment too large");
+    }
+
+    // decompress in place of the compressed payload
+    _startPosition = MAX_ENSURE_SIZE;
+    _socketBuffer.setLimit(_socketBuffer.getSize());
+    int ret = LZ4_decompress_safe(&_inflateScratch[4],
+                                  const_cast<char*>(_socketBuffer.getArray()) + _startPosition,
+                                  int(compressed - 4), int(inflated));
+    if (ret < 0 || epicsUInt32(ret) != inflated)
+    {
+        invalidDataStreamHandler();
+        throw invalid_data_stream_exception("corrupt compressed segment");
+    }
+    _socketBuffer.setPosition(_startPosition);
+    _socketBuffer.setLimit(_startPosition + inflated);
+    _payloadSize = int32(inflated);
+
+    epicsTimeGetCurrent(&end);
+    TransportStatistics::add(_stats.inflatedSegments);
+    TransportStatistics::add(_stats.inflateUS, size_t(epicsTimeDiffInSeconds(&end, &start)*1e6));
+#else
+    LOG(logLevelError,
+        "Compressed message received from %s, but compression is not supported, disconnecting...",
+        inetAddressToString(*getLastReadBufferSocketAddress()).c_str());
+    invalidDataStreamHandler();
+    throw invalid_data_stream_exception("compression not supported");
+#endif
+}
+
+
+void AbstractCodec::compressSegment(std::size_t payloadSize)
+{
+#ifdef PVA_HAVE_LZ4
+    if (payloadSize > std::size_t(_peerInflateLimit.get()))
+        return; // includes peer which doesn't support compression
+
+    epicsTimeStamp start, end;
+    epicsTimeGetCurrent(&start);
+
+    const std::size_t payloadStart = _lastMessageStartPosition + PVA_MESSAGE_HEADER_SIZE;
+
+    int bound = LZ4_compressBound(int(payloadSize));
+    _compressScratch.resize(std::size_t(bound));
+    int n = LZ4_compress_default(_sendBuffer.getArray() + payloadStart, &_compressScratch[0],
+                                 int(payloadSize), bound);
+
+    // only when worthwhile
+    if (n <= 0 || std::size_t(n) + 4 >= payloadSize)
+        return;
+
+    _sendBuffer.setPosition(payloadStart);
+    _sendBuffer.putInt(static_cast<int32>(payloadSize));
+    _sendBuffer.put(&_compressScratch[0], 0, std::size_t(n));
+
+    _sendBuffer.putInt(_lastMessageStartPosition + 4, 4 + n);
+    std::size_t flagsPosition = _lastMessageStartPosition + 2;
+    _sendBuffer.putByte(flagsPosition, _sendBuffer.getByte(flagsPosition) | 0x08);
+
+    epicsTimeGetCurrent(&end);
+    TransportStatistics::add(_stats.compressedSegments);
+    TransportStatistics::add(_stats.compressIn, payloadSize);
+    TransportStatistics::add(_stats.compressOut, 4 + n);
+    TransportStatistics::add(_stats.compressUS, size_t(epicsTimeDiffInSeconds(&end, &start)*1e6));
+#else
+    (void)payloadSize;
+#endif
+}
+
+
 void AbstractCodec::ensureData(std::size_t size) {
 
+    // a worker of _decodePool reads the copy of the payload, which is whole
+    if (_decodePool) {
+        if (ByteBuffer *payload = DecodePool::current(this)) {
+            if (payload->getRemaining() < size)
+                throw invalid_data_stream_exception("offloaded message shorter than its content");
+            return;
+        }
+    }
+
     // enough of data?
     if (_socketBuffer.getRemaining() >= size)
         return;
@@ -526,6 +1042,56 @@ void AbstractCodec::ensureData(std::size_t size) {
 }
 
 
+bool AbstractCodec::offloadApplicationMessage(bool local)
+{
+    _rxInit = false;
+    // ioid and qos
+    if ((_command != CMD_GET && _command != CMD_MONITOR) || _payloadSize < 5)
+        return false;
+
+    const std::size_t pos = _socketBuffer.getPosition();
+    const pvAccessID ioid = _socketBuffer.getInt(pos);
+    const int8 qos = _socketBuffer.getByte(pos + 4);
+
+    if (qos & 0x08) {
+        // the type, and so whether it has unions, is given again
+        _unionIOIDs.erase(ioid);
+        _rxInit = true;
+        _rxInitIOID = ioid;
+    } else if (_unionIOIDs.find(ioid) != _unionIOIDs.end()) {
+        // none were posted since the INIT, which drained them
+        return false;
+    }
+
+    // INIT carries introspection, which must be decoded through the registry in order.
+    // Segmented, or partly received, messages are decoded as the rest arrives.
+    if (local || _rxInit || (_flags & 0x30) || _socketBuffer.getRemaining() < std::size_t(_payloadSize)) {
+        _decodePool->drain(ioid);
+        return false;
+    }
+
+    std::tr1::shared_ptr<AbstractCodec> self(sharedCodec());
+    if (!self)
+        return false;
+
+    // copied, as _socketBuffer is reused for the messages which follow
+    std::tr1::shared_ptr<ByteBuffer> payload(new ByteBuffer(_payloadSize,
+                                                            _byteOrderFlag ? EPICS_ENDIAN_BIG : EPICS_ENDIAN_LITTLE));
+    payload->put(_socketBuffer.getArray(), pos, _payloadSize);
+    payload->flip();
+
+    _decodePool->post(self, ioid, _version, _command, payload);
+    return true;
+}
+
+
+void AbstractCodec::receivedIntrospection(const std::tr1::shared_ptr<const epics::pvData::Field>& field)
+{
+    if (_rxInit && field && SerializationHelper::hasUnion(*field))
+        _unionIOIDs.insert(_rxInitIOID);
+}
+
+
 std::size_t AbstractCodec::alignedValue(
     std::size_t value,
     std::size_t alignment) {
@@ -538,6 +1104,12 @@ std::size_t AbstractCodec::alignedValue(
 void AbstractCodec::alignData(std::size_t alignment) {
 
     std::size_t k = (alignment - 1);
+    if (_decodePool) {
+        if (ByteBuffer *payload = DecodePool::current(this)) {
+            payload->setPosition(std::min((payload->getPosition() + k) & (~k), payload->getLimit()));
+            return;
+        }
+    }
     std::size_t pos = _socketBuffer.getPosition();
     std::size_t newpos = (pos + k) & (~k);
     if (pos == newpos)
@@ -599,6 +1171,10 @@ void AbstractCodec::startMessage(
     _sendBuffer.putByte(command);	// command
     _sendBuffer.putInt(payloadSize);
 
+    PVA_PROBE3(tx_message, this, int(command), ensureCapacity);
+
+    TransportStatistics::add(_stats.messagesSent[TransportStatistics::commandIndex(command)]);
+
     // apply offset
     if (_nextMessagePayloadOffset > 0)
         _sendBuffer.setPosition(
@@ -669,6 +1245,10 @@ void AbstractCodec::endMessage(bool hasMoreSegments) {
             _nextMessagePayloadOffset = 0;
         }
 
+        // each segment is compressed separately
+        if (_compressThreshold && payloadSize >= _compressThreshold)
+            compressSegment(payloadSize);
+
         // TODO
         /*
         // manage markers
@@ -715,12 +1295,19 @@ void AbstractCodec::flushSerializeBuffer() {
     flush(false);
 }
 
-void AbstractCodec::flushSendBuffer() {
+void AbstractCodec::flushSendBuffer(ByteBuffer *tail) {
+
+    _coalescing = false;
 
     _sendBuffer.flip();
 
     try {
-        send(&_sendBuffer);
+        if(tail) {
+            ByteBuffer* buffers[2] = {&_sendBuffer, tail};
+            sendGather(buffers, 2);
+        } else {
+            send(&_sendBuffer);
+        }
     } catch (io_exception &) {
         try {
             if (isOpen())
@@ -733,7 +1320,17 @@ void AbstractCodec::flushSendBuffer() {
 
     _sendBuffer.clear();
 
+    int32 requested = _requestedSegmentSize.getAndSet(0);
+    if(requested > 0) {
+        _segmentSize = size_t(requested);
+        _maxSendPayloadSize = _segmentSize - 2*PVA_MESSAGE_HEADER_SIZE;
+    }
+    if(_segmentSize < _sendBuffer.getSize())
+        _sendBuffer.setLimit(_segmentSize);
+
     _lastMessageStartPosition = std::numeric_limits<size_t>::max();
+
+    checkCongestion();
 }
 
 void AbstractCodec::flush(bool lastMessageCompleted) {
@@ -776,6 +1373,12 @@ void AbstractCodec::send(ByteBuffer *buffer)
     //  std::min<int32_t>(
     //  _socketSendBufferSize, _remoteTransportSocketReceiveBufferSize) / 2;
 
+    // keep the order of what is sent
+    if (sendBlocked()) {
+        setAside(buffer);
+        return;
+    }
+
     std::size_t limit = buffer->getLimit();
     std::size_t bytesToSend = limit - buffer->getPosition();
 
@@ -791,7 +1394,9 @@ void AbstractCodec::send(ByteBuffer *buffer)
     {
 
         //int p = buffer.position();
+        std::size_t offered = buffer->getRemaining();
         int bytesSent = write(buffer);
+        TransportStatistics::add(_stats.sendCalls);
 
         /*
         if (IS_LOGGABLE(logLevelTrace)) {
@@ -809,11 +1414,18 @@ void AbstractCodec::send(ByteBuffer *buffer)
         }
         else if (bytesSent == 0)
         {
-            sendBufferFull(tries++);
+            if (_setAsideUnsent) {
+                setAside(buffer);
+                break;
+            }
+            stallSend(tries++);
             continue;
         }
 
         _totalBytesSent += bytesSent;
+        TransportStatistics::add(_stats.bytesSent, bytesSent);
+        if (std::size_t(bytesSent) < offered)
+            TransportStatistics::add(_stats.partialWrites);
 
         // readjust limit
         if (bytesToSend == maxBytesToSend)
@@ -827,63 +1439,370 @@ void AbstractCodec::send(ByteBuffer *buffer)
         }
         tries = 0;
     }
+
+    // of the last message serialized into this buffer
+    MB_POINT(pvaCodec, 4, "buffer written");
 }
 
 
-void AbstractCodec::processSendQueue()
+void AbstractCodec::stallSend(int tries)
 {
-
-    {
-        std::size_t senderProcessed = 0;
-        while (senderProcessed++ < MAX_MESSAGE_SEND)
-        {
-            TransportSender::shared_pointer sender;
-            _sendQueue.pop_front_try(sender);
-            if (sender.get() == 0)
-            {
-                // flush
-                if (_sendBuffer.getPosition() > 0)
-                    flush(true);
-
-                sendCompleted();	// do not schedule sending
-
-                if (terminated())			// termination
-                    break;
-                // termination (we want to process even if shutdown)
-                _sendQueue.pop_front(sender);
-            }
-
-            try {
-                processSender(sender);
-            } catch(...) {
-                if (_sendBuffer.getPosition() > 0)
-                    flush(true);
-                sendCompleted();
-                throw;
-            }
-        }
-    }
-
-    // flush
-    if (_sendBuffer.getPosition() > 0)
-        flush(true);
+    epicsTimeStamp start, end;
+    epicsTimeGetCurrent(&start);
+    sendBufferFull(tries);
+    epicsTimeGetCurrent(&end);
+    double waited = epicsTimeDiffInSeconds(&end, &start);
+    if(waited > 0.0)
+        TransportStatistics::add(_stats.sendStallUS, size_t(waited*1e6));
+    // a peer which stops reading must not hold the sender forever
+    checkCongestion();
 }
 
 
-void AbstractCodec::enqueueSendRequest(
-    TransportSender::shared_pointer const & sender) {
-    _sendQueue.push_back(sender);
-    scheduleSend();
+void AbstractCodec::setAside(ByteBuffer *buffer)
+{
+    const char *begin = buffer->getArray() + buffer->getPosition();
+    if (!sendBlocked()) {
+        _txPending.clear();
+        _txPendingPos = 0;
+    }
+    _txPending.insert(_txPending.end(), begin, begin + buffer->getRemaining());
+    // as if sent
+    buffer->setPosition(buffer->getLimit());
 }
 
 
-void AbstractCodec::setSenderThread()
+bool AbstractCodec::sendPending()
 {
-    _senderThread = epicsThreadGetIdSelf();
-}
+    while (sendBlocked())
+    {
+        ByteBuffer pending(&_txPending[0], _txPending.size());
+        pending.setPosition(_txPendingPos);
 
+        std::size_t offered = pending.getRemaining();
+        int bytesSent = write(&pending);
+        TransportStatistics::add(_stats.sendCalls);
 
-void AbstractCodec::processSender(
+        if (bytesSent < 0)
+        {
+            // connection lost
+            close();
+            throw connection_closed_exception("bytesSent < 0");
+        }
+        else if (bytesSent == 0)
+        {
+            return false;
+        }
+
+        _totalBytesSent += bytesSent;
+        TransportStatistics::add(_stats.bytesSent, bytesSent);
+        if (std::size_t(bytesSent) < offered)
+            TransportStatistics::add(_stats.partialWrites);
+
+        _txPendingPos = pending.getPosition();
+    }
+    _txPending.clear();
+    _txPendingPos = 0;
+    return true;
+}
+
+
+int AbstractCodec::writeGather(ByteBuffer** srcs, std::size_t count)
+{
+    int total = 0;
+    for(std::size_t i=0; i<count; i++) {
+        const std::size_t remaining = srcs[i]->getRemaining();
+        if(remaining==0)
+            continue;
+        int bytesSent = write(srcs[i]);
+        if(bytesSent<0)
+            return total ? total : bytesSent; // a loss after some is seen by the next call
+        total += bytesSent;
+        if(std::size_t(bytesSent)<remaining)
+            break;
+    }
+    return total;
+}
+
+
+void AbstractCodec::sendGather(ByteBuffer** buffers, std::size_t count)
+{
+    // skip leading empty buffers
+    while(count>0 && buffers[0]->getRemaining()==0) {
+        buffers++;
+        count--;
+    }
+
+    if (sendBlocked()) {
+        for(std::size_t i=0; i<count; i++)
+            setAside(buffers[i]);
+        return;
+    }
+
+    int tries = 0;
+    while (count>0)
+    {
+        std::size_t offered = 0;
+        for(std::size_t i=0; i<count; i++)
+            offered += buffers[i]->getRemaining();
+
+        int bytesSent = writeGather(buffers, count);
+        TransportStatistics::add(_stats.sendCalls);
+
+        if (bytesSent < 0)
+        {
+            // connection lost
+            close();
+            throw connection_closed_exception("bytesSent < 0");
+        }
+        else if (bytesSent == 0)
+        {
+            if (_setAsideUnsent) {
+                for(std::size_t i=0; i<count; i++)
+                    setAside(buffers[i]);
+                break;
+            }
+            stallSend(tries++);
+            continue;
+        }
+
+        _totalBytesSent += bytesSent;
+        TransportStatistics::add(_stats.bytesSent, bytesSent);
+        if (std::size_t(bytesSent) < offered)
+            TransportStatistics::add(_stats.partialWrites);
+
+        while(count>0 && buffers[0]->getRemaining()==0) {
+            buffers++;
+            count--;
+        }
+        tries = 0;
+    }
+}
+
+
+void AbstractCodec::processSendQueue()
+{
+    checkCongestion();
+
+    // what the socket would not accept goes first.  Until it has, wait for the socket to be writable
+    if (!sendPending()) {
+        writePollOne();
+        return;
+    }
+
+    {
+        std::size_t senderProcessed = 0;
+        while (senderProcessed++ < MAX_MESSAGE_SEND)
+        {
+            TransportSender::shared_pointer sender;
+            _sendQueue.pop_front_try(sender);
+            if (sender.get() == 0)
+                waitToCoalesce(sender);
+            if (sender.get() == 0)
+            {
+                // flush
+                if (_sendBuffer.getPosition() > 0)
+                    flush(true);
+
+                sendCompleted();	// do not schedule sending
+
+                if (terminated() || !_blockingProcessQueue)  // termination, or non-blocking
+                    break;
+                // termination (we want to process even if shutdown)
+                if (!spinForSender(sender))
+                    _sendQueue.pop_front(sender);
+            }
+
+            try {
+                processSender(sender);
+            } catch(...) {
+                if (_sendBuffer.getPosition() > 0)
+                    flush(true);
+                sendCompleted();
+                throw;
+            }
+
+            // the socket accepts no more for now
+            if (sendBlocked())
+                break;
+        }
+    }
+
+    // flush
+    if (_sendBuffer.getPosition() > 0)
+        flush(true);
+
+    if (sendBlocked())
+        writePollOne();
+}
+
+
+bool AbstractCodec::spinForSender(TransportSender::shared_pointer& sender)
+{
+    const int spinUS = _sendSpinUS.get();
+    if (spinUS <= 0)
+        return false;
+
+    epicsTimeStamp start, now;
+    epicsTimeGetCurrent(&start);
+    do {
+        if (_sendQueue.pop_front_try(sender))
+            return true;
+        epicsTimeGetCurrent(&now);
+    } while (epicsTimeDiffInSeconds(&now, &start)*1e6 < spinUS && !terminated());
+    return false;
+}
+
+
+void AbstractCodec::waitToCoalesce(TransportSender::shared_pointer& sender)
+{
+    if (_coalesceWindow <= 0.0 || !_blockingProcessQueue
+            || _sendBuffer.getPosition() == 0
+            || _sendBuffer.getPosition() >= std::min(_coalesceBytes, _maxSendPayloadSize)
+            || _coalesceDisabled.get() || terminated())
+        return;
+
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    if (!_coalescing) {
+        _coalescing = true;
+        _coalesceStart = now;
+    }
+
+    double remaining = _coalesceWindow - epicsTimeDiffInSeconds(&now, &_coalesceStart);
+    if (remaining > 0.0)
+        _sendQueue.pop_front(sender, remaining);
+}
+
+
+void AbstractCodec::enqueueSendRequest(
+    TransportSender::shared_pointer const & sender) {
+    if (SendBatch::defer(this)) {
+        _sendQueue.push_back(sender, false);
+        return;
+    }
+    _sendQueue.push_back(sender);
+    scheduleSend();
+}
+
+
+void AbstractCodec::wakeSender()
+{
+    _sendQueue.wake();
+    scheduleSend();
+}
+
+
+SendBatch::SendBatch()
+{
+    epicsThreadOnce(&sendBatchOnce, &sendBatchInit, 0);
+    outermost = !epicsThreadPrivateGet(sendBatchCurrent);
+    if(outermost)
+        epicsThreadPrivateSet(sendBatchCurrent, this);
+}
+
+SendBatch::~SendBatch()
+{
+    if(!outermost)
+        return;
+    epicsThreadPrivateSet(sendBatchCurrent, 0);
+    flush();
+}
+
+void SendBatch::flush()
+{
+    if(!outermost)
+        return;
+    std::vector<std::tr1::shared_ptr<AbstractCodec> > woken;
+    woken.swap(codecs);
+    for(size_t i=0; i<woken.size(); i++)
+        woken[i]->wakeSender();
+}
+
+bool SendBatch::defer(AbstractCodec *codec)
+{
+    epicsThreadOnce(&sendBatchOnce, &sendBatchInit, 0);
+    SendBatch *batch = static_cast<SendBatch*>(epicsThreadPrivateGet(sendBatchCurrent));
+    if(!batch)
+        return false;
+
+    // only a few transports are expected, so search linearly
+    for(size_t i=0; i<batch->codecs.size(); i++) {
+        if(batch->codecs[i].get()==codec)
+            return true;
+    }
+    std::tr1::shared_ptr<AbstractCodec> ref(codec->sharedCodec());
+    if(!ref)
+        return false;
+    batch->codecs.push_back(ref);
+    return true;
+}
+
+
+ReceiveBatch::ReceiveBatch()
+{
+    epicsThreadOnce(&sendBatchOnce, &sendBatchInit, 0);
+    outermost = !epicsThreadPrivateGet(receiveBatchCurrent);
+    if(outermost)
+        epicsThreadPrivateSet(receiveBatchCurrent, this);
+}
+
+ReceiveBatch::~ReceiveBatch()
+{
+    if(!outermost)
+        return;
+    try {
+        flush();
+    } catch(std::exception& e) {
+        LOG(logLevelError, "Unhandled exception from deferred notification: %s", e.what());
+    }
+    epicsThreadPrivateSet(receiveBatchCurrent, 0);
+}
+
+bool ReceiveBatch::defer(const std::tr1::shared_ptr<Deferred>& work)
+{
+    epicsThreadOnce(&sendBatchOnce, &sendBatchInit, 0);
+    ReceiveBatch *batch = static_cast<ReceiveBatch*>(epicsThreadPrivateGet(receiveBatchCurrent));
+    if(!batch)
+        return false;
+    batch->deferred.push_back(work);
+    return true;
+}
+
+void ReceiveBatch::flushCurrent()
+{
+    epicsThreadOnce(&sendBatchOnce, &sendBatchInit, 0);
+    ReceiveBatch *batch = static_cast<ReceiveBatch*>(epicsThreadPrivateGet(receiveBatchCurrent));
+    if(batch)
+        batch->flush();
+}
+
+void ReceiveBatch::flush()
+{
+    // work may defer more, which is run in turn
+    while(!deferred.empty()) {
+        std::vector<std::tr1::shared_ptr<Deferred> > work;
+        work.swap(deferred);
+        for(size_t i=0; i<work.size(); i++) {
+            try {
+                work[i]->runDeferred();
+            } catch(std::exception& e) {
+                LOG(logLevelError, "Unhandled exception from deferred notification: %s", e.what());
+            }
+        }
+    }
+    // replies queued by the work are included
+    sends.flush();
+}
+
+
+void AbstractCodec::setSenderThread()
+{
+    _senderThread = epicsThreadGetIdSelf();
+}
+
+
+void AbstractCodec::processSender(
     TransportSender::shared_pointer const & sender)
 {
 
@@ -892,10 +1811,22 @@ void AbstractCodec::processSender(
     try {
         _lastMessageStartPosition = _sendBuffer.getPosition();
 
+        MB_INC_AUTO_ID(pvaCodec);
+        MB_POINT(pvaCodec, 2, "send start");
+
+        // including any part flushed while serializing
+        const int64_t before = _totalBytesSent + int64_t(_sendBuffer.getPosition());
+
         sender->send(&_sendBuffer, this);
 
         // automatic end (to set payload size)
         endMessage(false);
+
+        MB_POINT(pvaCodec, 3, "message serialized");
+        const int64_t bytes = _totalBytesSent + int64_t(_sendBuffer.getPosition()) - before;
+        PVA_PROBE3(tx_sender, this, sender.get(), bytes);
+        if(sender->bytesCounter)
+            TransportStatistics::add(*sender->bytesCounter, size_t(bytes));
     }
     catch (connection_closed_exception & ) {
         throw;
@@ -967,6 +1898,10 @@ bool AbstractCodec::directSerialize(ByteBuffer* /*existingBuffer*/, const char*
     if (count < 64*1024)
         return false;
 
+    // compression needs the data to pass through _sendBuffer
+    if (_compressThreshold && _peerInflateLimit.get() > 0)
+        return false;
+
     //
     // first end current message, and write a header of next "directly serialized" message
     //
@@ -978,16 +1913,16 @@ bool AbstractCodec::directSerialize(ByteBuffer* /*existingBuffer*/, const char*
     // TODO size_t to int32
     startMessage(_lastSegmentedMessageCommand, 0, static_cast<int32>(count));
 
-    // flush
-    flushSendBuffer();
-
     // TODO think if alignment is preserved after...
 
     //
-    // send toSerialize buffer
+    // flush, and send toSerialize buffer w/o copying through _sendBuffer.
+    // Where supported, both go out in a single sendmsg().
+    // With _setAsideUnsent, what the socket does not take is copied by setAside(),
+    // as toSerialize belongs to the caller once this returns.
     //
     ByteBuffer wrappedBuffer(const_cast<char*>(toSerialize), count);
-    send(&wrappedBuffer);
+    flushSendBuffer(&wrappedBuffer);
 
     //
     // continue where we left before calling directSerialize
@@ -1000,7 +1935,65 @@ bool AbstractCodec::directSerialize(ByteBuffer* /*existingBuffer*/, const char*
 bool AbstractCodec::directDeserialize(ByteBuffer *existingBuffer, char* deserializeTo,
                                       std::size_t elementCount, std::size_t elementSize)
 {
-    return false;
+    std::size_t count = elementCount * elementSize;
+
+    // TODO find smart limit
+    // check if direct mode actually pays off
+    if (count < 64*1024 || existingBuffer != &_socketBuffer)
+        return false;
+
+    while (count > 0)
+    {
+        // first use what is already buffered
+        std::size_t n = std::min(count, _socketBuffer.getRemaining());
+        if (n > 0)
+        {
+            std::size_t pos = _socketBuffer.getPosition();
+            memcpy(deserializeTo, _socketBuffer.getArray() + pos, n);
+            _socketBuffer.setPosition(pos + n);
+            deserializeTo += n;
+            count -= n;
+            continue;
+        }
+
+        std::size_t pos = _socketBuffer.getPosition();
+        std::size_t payloadEnd = _storedPosition + _storedPayloadSize;
+
+        if (pos == _storedLimit && payloadEnd > _storedLimit)
+        {
+            // remainder of this payload has not been received yet.
+            // read it straight into the destination.
+            std::size_t toRead = std::min(count, payloadEnd - _storedLimit);
+
+            ByteBuffer wrappedBuffer(deserializeTo, toRead);
+            while (wrappedBuffer.getRemaining() > 0)
+            {
+                int bytesRead = readSocket(&wrappedBuffer);
+                if (bytesRead < 0)
+                {
+                    close();
+                    throw connection_closed_exception("bytesRead < 0");
+                }
+                // non-blocking IO support
+                else if (bytesRead == 0)
+                    readPollOne();
+            }
+
+            // account as if read through _socketBuffer
+            _storedPayloadSize -= (pos - _storedPosition) + toRead;
+            _storedPosition = pos;
+
+            deserializeTo += toRead;
+            count -= toRead;
+        }
+        else
+        {
+            // end of this (segmented) payload.  let ensureData() find the next segment.
+            ensureData(1);
+        }
+    }
+
+    return true;
 }
 
 //
@@ -1018,12 +2011,30 @@ BlockingTCPTransportCodec::~BlockingTCPTransportCodec()
 }
 
 void BlockingTCPTransportCodec::readPollOne() {
-    throw std::logic_error("should not be called for blocking IO");
+    if(!_ioReactor)
+        throw std::logic_error("should not be called for blocking IO");
+
+    // readFramed() only passes on whole messages, so this one claims more than it holds
+    LOG(logLevelError, "Message from %s is longer than its frames, disconnecting...",
+        _socketName.c_str());
+    invalidDataStreamHandler();
+    throw invalid_data_stream_exception("message longer than its frames");
 }
 
 
 void BlockingTCPTransportCodec::writePollOne() {
-    throw std::logic_error("should not be called for blocking IO");
+    if(!_ioReactor)
+        throw std::logic_error("should not be called for blocking IO");
+
+    // processSendQueue() continues once the socket accepts what was set aside
+    _ioReactor->waitWritable(_ioKey);
+}
+
+
+void BlockingTCPTransportCodec::scheduleSend()
+{
+    if(_ioReactor)
+        _ioReactor->scheduleWrite(_ioKey);
 }
 
 
@@ -1031,27 +2042,58 @@ void BlockingTCPTransportCodec::close() {
 
     if (_isOpen.getAndSet(false))
     {
+        PVA_PROBE4(transport_close, this, int(isServer()), &_socketAddress, _socketName.c_str());
+
         // always close in the same thread, same way, etc.
         // wakeup processSendQueue
 
         // clean resources (close socket)
         internalClose();
 
-        // Break sender from queue wait
-        BreakTransport::shared_pointer B(new BreakTransport);
-        enqueueSendRequest(B);
+        {
+            Lock guard(_shmMutex);
+            if(_shm)
+                _shm->close();
+            if(_rdma)
+                _rdma->close();
+        }
+
+        if(_ioReactor) {
+            // no sender thread to wake up
+            _sendQueue.clear();
+        } else {
+            // Break sender from queue wait
+            BreakTransport::shared_pointer B(new BreakTransport);
+            enqueueSendRequest(B);
+        }
     }
 }
 
 void BlockingTCPTransportCodec::waitJoin()
 {
     assert(!_isOpen.get());
-    _sendThread.exitWait();
-    _readThread.exitWait();
+    if(_ioReactor) {
+        _ioReactor->sync(_ioKey);
+    } else {
+        _sendThread->exitWait();
+        _readThread->exitWait();
+    }
 }
 
 void BlockingTCPTransportCodec::internalClose()
 {
+    if(_ioReactor)
+        _ioReactor->remove(_ioKey);
+
+    // A zero-copy send returns once the kernel releases its pages, only after the peer
+    // acknowledges them.  Reset instead of waiting for a peer which may never do so.
+    if(_txRing && _txRing->zeroCopyPending()) {
+        struct linger reset;
+        reset.l_onoff = 1;
+        reset.l_linger = 0;
+        (void)::setsockopt(_channel, SOL_SOCKET, SO_LINGER, (char*)&reset, sizeof(reset));
+    }
+
     {
 
         epicsSocketSystemCallInterruptMechanismQueryInfo info  =
@@ -1112,10 +2154,125 @@ bool BlockingTCPTransportCodec::isOpen() {
 // NOTE: must not be called from constructor (e.g. needs shared_from_this())
 void BlockingTCPTransportCodec::start() {
 
-    _readThread.start();
+    if(_ioReactor) {
+        _ioReactor->add(_channel, shared_from_this(), &_ioKey);
+
+        // anything queued before registration
+        if(!sendQueueEmpty())
+            scheduleSend();
+
+    } else {
+        // TLS does its own socket I/O
+        if(_tls) {
+            _rxRing.reset();
+            _txRing.reset();
+        }
+
+        _readThread->start();
+
+        _sendThread->start();
+    }
+
+    PVA_PROBE4(transport_connect, this, int(isServer()), &_socketAddress, _socketName.c_str());
+}
+
+
+void BlockingTCPTransportCodec::readReady()
+{
+    if(!isOpen())
+        return;
+
+    CPUAccount cpu(_cpuStats ? &_stats.rxCPUUS : 0);
+
+    try {
+        if(_tls && !_tls->established() && !continueHandshake())
+            return;
+
+        processRead();
+        // processRead() returns after MAX_MESSAGE_PROCESS messages.  Anything already
+        // buffered won't make the socket readable again, so continue after the other sockets.
+        if(isOpen() && (inputPending() || _rxStageBegin < _rxStageReady || (_tls && _tls->pending())))
+            _ioReactor->scheduleRead(_ioKey);
+        return;
+    } catch (std::exception &e) {
+        PRINT_EXCEPTION(e);
+        LOG(logLevelError,
+            "an exception caught while in readReady at %s:%d: %s",
+            __FILE__, __LINE__, e.what());
+    } catch (...) {
+        LOG(logLevelError,
+            "unknown exception caught while in readReady at %s:%d.",
+            __FILE__, __LINE__);
+    }
+    // exception
+    close();
+}
+
+
+void BlockingTCPTransportCodec::writeReady()
+{
+    if(!isOpen())
+        return;
+
+    CPUAccount cpu(_cpuStats ? &_stats.txCPUUS : 0);
+
+    try {
+        if(_tls && !_tls->established() && !continueHandshake())
+            return;
+
+        processWrite();
+        // MAX_MESSAGE_SEND reached, come back later.  Or once writable, see writePollOne()
+        if(!sendQueueEmpty() && !sendBlocked())
+            scheduleSend();
+        return;
+    } catch (connection_closed_exception &cce) {
+        // noop
+    } catch (std::exception &e) {
+        PRINT_EXCEPTION(e);
+        LOG(logLevelWarn,
+            "an exception caught while in writeReady at %s:%d: %s",
+            __FILE__, __LINE__, e.what());
+    } catch (...) {
+        LOG(logLevelWarn,
+            "unknown exception caught while in writeReady at %s:%d.",
+            __FILE__, __LINE__);
+    }
+    // exception
+    close();
+}
+
+
+bool BlockingTCPTransportCodec::continueHandshake()
+{
+    int ret = _tls->continueHandshake();
+    if(ret<0) {
+        close();
+        return false;
+    } else if(ret==0) {
+        // otherwise, readReady() once the socket is readable.
+        // One which never completes is closed when verification times out.
+        if(_tls->wantWrite())
+            _ioReactor->waitWritable(_ioKey);
+        return false;
+    }
+    // anything queued meanwhile
+    if(!sendQueueEmpty())
+        scheduleSend();
+    return true;
+}
 
-    _sendThread.start();
 
+void BlockingTCPTransportCodec::getCPUTime(double& rx, double& tx) const
+{
+    if(_ioReactor) {
+        TransportStatistics stats;
+        _stats.snapshot(stats);
+        rx = stats.rxCPUUS*1e-6;
+        tx = stats.txCPUUS*1e-6;
+    } else {
+        rx = _rxClock.seconds();
+        tx = _txClock.seconds();
+    }
 }
 
 
@@ -1132,8 +2289,21 @@ void BlockingTCPTransportCodec::receiveThread()
      */
     Transport::shared_pointer ptr(this->shared_from_this());
 
+    // a server connection begins with the TLS handshake.  See BlockingTCPAcceptor::createTransport()
+    if(_tls && !_tls->established()) {
+        bool ok = _tls->handshake(5.0);
+        _tlsEvent.signal();
+        if(!ok)
+            close();
+    }
+
+    _rxClock.attach();
+    const CPUAffinity inherited(CPUAffinity::current());
+    int pinned = -1;
+
     while (this->isOpen())
     {
+        followAffinity(_rxCPU.get(), pinned, _affinity.empty() ? inherited : _affinity);
         try {
             this->processRead();
             continue;
@@ -1150,6 +2320,8 @@ void BlockingTCPTransportCodec::receiveThread()
         // exception
         close();
     }
+
+    _rxClock.detach();
 }
 
 
@@ -1158,10 +2330,18 @@ void BlockingTCPTransportCodec::sendThread()
     // cf. the comment in receiveThread()
     Transport::shared_pointer ptr(this->shared_from_this());
 
+    // nothing may be sent until the receive thread has completed the TLS handshake
+    if(_tls && !_tls->established())
+        _tlsEvent.wait();
+
     this->setSenderThread();
+    _txClock.attach();
+    const CPUAffinity inherited(CPUAffinity::current());
+    int pinned = -1;
 
     while (this->isOpen())
     {
+        followAffinity(_txCPU.get(), pinned, _affinity.empty() ? inherited : _affinity);
         try {
             this->processWrite();
             continue;
@@ -1181,12 +2361,35 @@ void BlockingTCPTransportCodec::sendThread()
         close();
     }
     _sendQueue.clear();
+
+    _txClock.detach();
 }
 
 
 void BlockingTCPTransportCodec::sendBufferFull(int tries) {
-    // TODO constants
-    epicsThreadSleep(std::max<double>(tries * 0.1, 1));
+    // resume as soon as the socket is writable.
+    // the timeout bounds how long until a close() is noticed.
+    if(IOReactor::waitFor(_channel, true, 1.0) > 0 && tries > 0) {
+        // writable, but the previous attempt still sent nothing (eg. ENOBUFS)
+        epicsThreadSleep(std::min(tries * 0.01, 0.1));
+    }
+}
+
+
+std::size_t BlockingTCPTransportCodec::unackedBytes()
+{
+    int pending = 0;
+    if(_shmWrite || _rdmaWrite)
+        return 0u;
+#if defined(__linux__) && defined(SIOCOUTQ)
+    if(::ioctl(_channel, SIOCOUTQ, &pending))
+        pending = 0;
+#elif defined(SO_NWRITE)
+    osiSocklen_t len = sizeof(pending);
+    if(::getsockopt(_channel, SOL_SOCKET, SO_NWRITE, (char*)&pending, &len))
+        pending = 0;
+#endif
+    return pending > 0 ? std::size_t(pending) : 0u;
 }
 
 
@@ -1199,35 +2402,201 @@ void BlockingTCPTransportCodec::sendBufferFull(int tries) {
 
 size_t BlockingTCPTransportCodec::num_instances;
 
+namespace {
+// capacity of the receive buffer, to which the receive window may grow.
+// receiveBufferSize (EPICS_PVA_MAX_ARRAY_BYTES), when set, is a budget which may lower this, but not raise it.
+// Larger messages, and arrays, stream through the buffer in parts,
+// while TCP flow control holds back the peer.
+size_t receiveWindowCeiling(const Context::shared_pointer &context, size_t receiveBufferSize)
+{
+    Configuration::const_shared_pointer config(context->getConfiguration());
+    int32 ceiling = MAX_TCP_RECV_WINDOW;
+    if(config)
+        ceiling = config->getPropertyAsInteger("EPICS_PVA_MAX_TCP_RECV", ceiling);
+    if(ceiling < MAX_TCP_RECV)
+        ceiling = MAX_TCP_RECV;
+    size_t window = size_t(ceiling);
+    if(receiveBufferSize > 0u && receiveBufferSize < window)
+        window = receiveBufferSize;
+    return std::max(window, size_t(MAX_TCP_RECV)) + AbstractCodec::MAX_ENSURE_SIZE;
+}
+
+// capacity of the send buffer, the largest segment which may be negotiated
+size_t segmentCeiling(const Context::shared_pointer &context, size_t sendBufferSize)
+{
+    Configuration::const_shared_pointer config(context->getConfiguration());
+    int32 ceiling = MAX_TCP_RECV_WINDOW;
+    if(config)
+        ceiling = config->getPropertyAsInteger("EPICS_PVA_MAX_SEGMENT_SIZE", ceiling);
+    if(ceiling < MAX_TCP_RECV)
+        ceiling = MAX_TCP_RECV;
+    return std::max(sendBufferSize, size_t(ceiling) + AbstractCodec::MAX_ENSURE_SIZE);
+}
+
+// The reactor of the context, unless called from one of its workers.
+// A client connecting from a reactor callback (eg. a search response
+// through a name server) waits for the new connection to be validated,
+// which the calling worker might be the one to receive.
+// Such a connection has its own threads instead.
+// So does a connection with a priority above EPICS_PVA_REACTOR_MAX_PRIORITY,
+// so that it never waits behind the bulk traffic sharing the reactor.
+IOReactor::shared_pointer reactorFor(const Context::shared_pointer &context, int16 priority)
+{
+    IOReactor::shared_pointer ret(context->getIOReactor());
+    if(ret && ret->isWorkerThread())
+        ret.reset();
+    if(ret) {
+        Configuration::const_shared_pointer config(context->getConfiguration());
+        int32 maxPriority = ChannelProvider::PRIORITY_DEFAULT;
+        if(config)
+            maxPriority = config->getPropertyAsInteger("EPICS_PVA_REACTOR_MAX_PRIORITY", maxPriority);
+        if(priority > maxPriority)
+            ret.reset();
+    }
+    return ret;
+}
+
+// As CA servers do, channel priorities span the thread priorities from CAServerLow to CAServerHigh
+unsigned transportThreadPriority(int16 priority)
+{
+    const int lo = ChannelProvider::PRIORITY_MIN, hi = ChannelProvider::PRIORITY_MAX;
+    int prio = std::max(lo, std::min(hi, int(priority)));
+    return epicsThreadPriorityCAServerLow
+            + unsigned(prio - lo) * (epicsThreadPriorityCAServerHigh - epicsThreadPriorityCAServerLow) / unsigned(hi - lo);
+}
+
+// The value for a priority from a list of "minPriority:value", eg. EPICS_PVA_PRIORITY_DSCP="0:8 50:46".
+// The entry with the highest minPriority which is not above priority applies, if any.
+bool priorityClassValue(const Configuration::const_shared_pointer& config, const char *name,
+                        int16 priority, int& value)
+{
+    if(!config)
+        return false;
+    std::istringstream strm(config->getPropertyAsString(name, ""));
+    std::string entry;
+    int best = -1;
+    while(strm>>entry) {
+        std::istringstream parse(entry);
+        int minPriority, val;
+        char sep = 0;
+        if(!(parse>>minPriority>>sep>>val) || sep!=':' || !parse.eof()) {
+            LOG(logLevelWarn, "Ignoring '%s' in %s, expected minPriority:value", entry.c_str(), name);
+            continue;
+        }
+        if(minPriority<=priority && minPriority>best) {
+            best = minPriority;
+            value = val;
+        }
+    }
+    return best>=0;
+}
+}
+
 BlockingTCPTransportCodec::BlockingTCPTransportCodec(bool serverFlag, const Context::shared_pointer &context,
     SOCKET channel, const ResponseHandler::shared_pointer &responseHandler,
     size_t sendBufferSize,
     size_t receiveBufferSize, int16 priority)
     :AbstractCodec(
          serverFlag,
+         segmentCeiling(context, sendBufferSize),
+         receiveWindowCeiling(context, receiveBufferSize),
          sendBufferSize,
-         receiveBufferSize,
-         sendBufferSize,
-         true)
-    ,_readThread(epics::pvData::Thread::Config(this, &BlockingTCPTransportCodec::receiveThread)
-                 .prio(epicsThreadPriorityCAServerLow)
-                 .name("TCP-rx")
-                 .stack(epicsThreadStackBig)
-                 .autostart(false))
-    ,_sendThread(epics::pvData::Thread::Config(this, &BlockingTCPTransportCodec::sendThread)
-                 .prio(epicsThreadPriorityCAServerLow)
-                 .name("TCP-tx")
-                 .stack(epicsThreadStackBig)
-                 .autostart(false))
+         !reactorFor(context, priority))
     ,_channel(channel)
+    ,_ioReactor(reactorFor(context, priority))
+    ,_ioKey(0)
+    ,_rxStageBegin(0), _rxStageReady(0), _rxStageScan(0), _rxStageEnd(0)
+    ,_rxStageSegmented(false)
     ,_context(context), _responseHandler(responseHandler)
     ,_remoteTransportReceiveBufferSize(MAX_TCP_RECV)
-    ,_remoteTransportRevision(0), _priority(priority)
+    ,_remoteTransportRevision(0), _priority(priority), _appliedPriority(priority)
+    ,_coalesceMaxPriority(ChannelProvider::PRIORITY_MAX-1)
     ,_verified(false)
+    ,_shmRingSize(0)
+    ,_shmRead(false)
+    ,_shmWrite(false)
+    ,_rdmaRingSize(0)
+    ,_rdmaGidIndex(0)
+    ,_rdmaRead(false)
+    ,_rdmaWrite(false)
+    ,_tracing(false)
+    ,_rxTraced(false)
+    ,_rxTraceTime()
+    ,_rxStampMode(RX_STAMP_NONE)
+    ,_rxKernelValid(false)
+    ,_rxKernelTime()
+    ,_rxStamped(false)
+    ,_rxDispatchTime()
+    ,_pipelineWindow(1)
+    ,_cpuStats(false)
 {
     REFTRACE_INCREMENT(num_instances);
 
     _isOpen.getAndSet(true);
+    _peerPipelineWindow.getAndSet(1);
+
+    // a reactor worker is shared, so must never wait for this socket
+    _setAsideUnsent = !!_ioReactor;
+
+    setAdaptiveReceive(MAX_TCP_RECV);
+    _decodePool = context->getDecodePool();
+    // until validation tells us what the peer can receive
+    setSegmentSize(std::max(sendBufferSize, size_t(MAX_TCP_RECV + MAX_ENSURE_DATA_BUFFER_SIZE)));
+
+    std::string captureDir;
+    {
+        Configuration::const_shared_pointer config(context->getConfiguration());
+        if(config)
+            configureSending(*config);
+        // the ring replaces blocking socket I/O, so the IOReactor can't wait for it
+        if(config && ShmRing::isSupported() && !_ioReactor) {
+            int32 ringSize = config->getPropertyAsInteger("EPICS_PVA_SHM_RING_SIZE", 0);
+            _shmRingSize = ringSize > 0 ? size_t(ringSize) : 0u;
+        }
+        // likewise
+        if(config && RdmaRing::isSupported() && !_ioReactor) {
+            int32 ringSize = config->getPropertyAsInteger("EPICS_PVA_RDMA_RING_SIZE", 0);
+            _rdmaRingSize = ringSize > 0 ? size_t(ringSize) : 0u;
+            _rdmaDevice = config->getPropertyAsString("EPICS_PVA_RDMA_DEVICE", "");
+            _rdmaGidIndex = config->getPropertyAsInteger("EPICS_PVA_RDMA_GID_INDEX", 0);
+        }
+        // in place of recv() and send() by _readThread and _sendThread
+        if(config && !_ioReactor && config->getPropertyAsBoolean("EPICS_PVA_IO_URING", false)) {
+            _rxRing = IOUring::create(_channel);
+            _txRing = IOUring::create(_channel);
+            if(_rxRing && _txRing) {
+                // pinned once, instead of by each operation
+                _rxRing->registerBuffer(_socketBlock.data(), _socketBlock.size());
+                _txRing->registerBuffer(_sendBlock.data(), _sendBlock.size());
+                int32 zeroCopyMin = config->getPropertyAsInteger("EPICS_PVA_IO_URING_ZC_MIN", 64*1024);
+                _txRing->setZeroCopyMin(zeroCopyMin > 0 ? size_t(zeroCopyMin) : 0u);
+            } else {
+                LOG(logLevelDebug, "io_uring not available, using recv() and send()");
+                _rxRing.reset();
+                _txRing.reset();
+            }
+        }
+        if(config)
+            _tracing = TraceSink::configure(*config);
+        if(config)
+            _pipelineWindow = std::max(1, int(config->getPropertyAsInteger("EPICS_PVA_PIPELINE_WINDOW", 1)));
+        if(config && _ioReactor)
+            _cpuStats = config->getPropertyAsBoolean("EPICS_PVA_CPU_STATS", false);
+        if(config) {
+            const std::string stamps(config->getPropertyAsString("EPICS_PVA_RX_TIMESTAMPS", "NO"));
+            if(epicsStrCaseCmp(stamps.c_str(), "SOFTWARE")==0 || epicsStrCaseCmp(stamps.c_str(), "YES")==0)
+                _rxStampMode = RX_STAMP_SOFTWARE;
+            else if(epicsStrCaseCmp(stamps.c_str(), "HARDWARE")==0)
+                _rxStampMode = RX_STAMP_HARDWARE;
+            else if(!stamps.empty() && epicsStrCaseCmp(stamps.c_str(), "NO")!=0)
+                LOG(logLevelWarn, "Ignoring EPICS_PVA_RX_TIMESTAMPS='%s', expected NO, SOFTWARE or HARDWARE", stamps.c_str());
+        }
+        if(config)
+            captureDir = config->getPropertyAsString("EPICS_PVA_CAPTURE_DIR", "");
+        // latency critical priorities are never held back
+        if(_priority > _coalesceMaxPriority)
+            disableCoalescing();
+    }
 
     // get remote address
     osiSocklen_t saSize = sizeof(sockaddr);
@@ -1245,27 +2614,289 @@ BlockingTCPTransportCodec::BlockingTCPTransportCodec(bool serverFlag, const Cont
         _socketName = ipAddrStr;
     }
 
-}
+    if(!captureDir.empty())
+        setCapture(TrafficCapture::create(captureDir, serverFlag, _socketName));
+
+    if(_rxStampMode != RX_STAMP_NONE) {
+#ifdef PVA_CODEC_RX_STAMPS
+        // software timestamps as well, for when the interface gives no hardware timestamp
+        int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if(_rxStampMode == RX_STAMP_HARDWARE)
+            flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+        if(::setsockopt(_channel, SOL_SOCKET, SO_TIMESTAMPING, (char *)&flags, sizeof(flags))) {
+            char errStr[64];
+            epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+            LOG(logLevelWarn, "Error setting SO_TIMESTAMPING for %s: %s", _socketName.c_str(), errStr);
+            _rxStampMode = RX_STAMP_NONE;
+        }
+#else
+        LOG(logLevelWarn, "EPICS_PVA_RX_TIMESTAMPS not supported on this target");
+        _rxStampMode = RX_STAMP_NONE;
+#endif
+    }
+
+    if(_ioReactor) {
+        // the reactor waits for readiness, so never block in recv()/send()
+        osiSockIoctl_t yes = true;
+        if(socket_ioctl(_channel, FIONBIO, &yes)) {
+            char errStr[64];
+            epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+            LOG(logLevelError, "Unable to set non-blocking mode: %s", errStr);
+        }
+    } else {
+        _readThread.reset(new epics::pvData::Thread(epics::pvData::Thread::Config(this, &BlockingTCPTransportCodec::receiveThread)
+                                                    .prio(epicsThreadPriorityCAServerLow)
+                                                    .name(threadName("rx", _socketName))
+                                                    .stack(epicsThreadStackBig)
+                                                    .autostart(false)));
+        _sendThread.reset(new epics::pvData::Thread(epics::pvData::Thread::Config(this, &BlockingTCPTransportCodec::sendThread)
+                                                    .prio(epicsThreadPriorityCAServerLow)
+                                                    .name(threadName("tx", _socketName))
+                                                    .stack(epicsThreadStackBig)
+                                                    .autostart(false)));
+    }
+
+    applyPriority(_priority);
+}
+
+void BlockingTCPTransportCodec::configureSending(const Configuration& config)
+{
+    int32 windowUS = config.getPropertyAsInteger("EPICS_PVA_COALESCE_US", 0);
+    int32 bytes = config.getPropertyAsInteger("EPICS_PVA_COALESCE_BYTES", 0);
+    setCoalescing(windowUS*1e-6, bytes > 0 ? size_t(bytes) : 0u);
+    _coalesceMaxPriority = int16(config.getPropertyAsInteger("EPICS_PVA_COALESCE_MAX_PRIORITY",
+                                                             ChannelProvider::PRIORITY_MAX-1));
+    if(compressionSupported()) {
+        int32 threshold = config.getPropertyAsInteger("EPICS_PVA_COMPRESS_THRESHOLD", 0);
+        setCompression(threshold > 0 ? size_t(threshold) : 0u);
+    }
+}
+
+struct BlockingTCPTransportCodec::ReconfigureSender : public TransportSender
+{
+    // the send queue holding us belongs to the codec
+    BlockingTCPTransportCodec * const codec;
+
+    explicit ReconfigureSender(BlockingTCPTransportCodec *codec)
+        :codec(codec)
+    {
+        setQueueLevel(LEVEL_URGENT);
+    }
+    virtual ~ReconfigureSender() {}
+
+    virtual void send(ByteBuffer* /*buffer*/, TransportSendControl* /*control*/) OVERRIDE FINAL
+    {
+        codec->applyConfiguration();
+    }
+};
+
+void BlockingTCPTransportCodec::reconfigure()
+{
+    // the sender reads these settings without a lock
+    if(isOpen()) {
+        TransportSender::shared_pointer sender(new ReconfigureSender(this));
+        enqueueSendRequest(sender);
+    }
+}
+
+void BlockingTCPTransportCodec::applyConfiguration()
+{
+    Configuration::const_shared_pointer config(_context->getConfiguration());
+    if(!config || !isOpen())
+        return;
+
+    Lock G(_priorityMutex);
+    configureSending(*config);
+    // may now be coalesced, or not
+    if(_appliedPriority > _coalesceMaxPriority)
+        disableCoalescing();
+    else
+        enableCoalescing();
+    applyPriority(_appliedPriority);
+}
+
+void BlockingTCPTransportCodec::setPeerPriority(int16 priority)
+{
+    Lock G(_priorityMutex);
+    if(priority > _coalesceMaxPriority)
+        disableCoalescing();
+    // a server connection is created at the default priority, until the client tells it
+    if(priority != _priority)
+        applyPriority(priority);
+}
+
+void BlockingTCPTransportCodec::setAffinity(const CPUAffinity& cpus, int node)
+{
+    // only our own threads, which pin themselves when started
+    if(_readThread.get())
+        _affinity = cpus;
+
+    if(node>=0) {
+        bool ok = CPUAffinity::placeMemory(_socketBlock.data(), _socketBlock.size(), node);
+        ok &= CPUAffinity::placeMemory(_sendBlock.data(), _sendBlock.size(), node);
+        if(!ok)
+            LOG(logLevelDebug, "Unable to move buffers of %s to NUMA node %d", _socketName.c_str(), node);
+    }
+}
+
+void BlockingTCPTransportCodec::applyPriority(int16 priority)
+{
+    _appliedPriority = priority;
+
+    if(_readThread.get()) {
+        unsigned prio = transportThreadPriority(priority);
+        _readThread->setPriority(prio);
+        _sendThread->setPriority(prio);
+    }
+
+    Configuration::const_shared_pointer config(_context->getConfiguration());
+    int value;
+
+#ifdef IP_TOS
+    if(priorityClassValue(config, "EPICS_PVA_PRIORITY_DSCP", priority, value)) {
+        // DSCP is the upper 6 bits of the TOS byte
+        int tos = (value & 0x3f) << 2;
+        if(::setsockopt(_channel, IPPROTO_IP, IP_TOS, (char *)&tos, sizeof(tos))) {
+            char errStr[64];
+            epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+            LOG(logLevelWarn, "Error setting IP_TOS for %s: %s", _socketName.c_str(), errStr);
+        }
+    }
+#endif
+    if(priorityClassValue(config, "EPICS_PVA_PRIORITY_SNDBUF", priority, value) && value>0) {
+        if(::setsockopt(_channel, SOL_SOCKET, SO_SNDBUF, (char *)&value, sizeof(value))) {
+            char errStr[64];
+            epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+            LOG(logLevelWarn, "Error setting SO_SNDBUF for %s: %s", _socketName.c_str(), errStr);
+        }
+    }
+    if(priorityClassValue(config, "EPICS_PVA_PRIORITY_RCVBUF", priority, value) && value>0) {
+        if(::setsockopt(_channel, SOL_SOCKET, SO_RCVBUF, (char *)&value, sizeof(value))) {
+            char errStr[64];
+            epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+            LOG(logLevelWarn, "Error setting SO_RCVBUF for %s: %s", _socketName.c_str(), errStr);
+        }
+    }
+
+    // low latency classes spin instead of sleeping, each for a budget in microseconds
+    int busyPoll = 0;
+    if(!priorityClassValue(config, "EPICS_PVA_PRIORITY_BUSY_POLL", priority, busyPoll) || busyPoll<0)
+        busyPoll = 0;
+    if(_rxSpinUS.getAndSet(busyPoll)!=busyPoll) {
+#ifdef SO_BUSY_POLL
+        // more than net.core.busy_read needs CAP_NET_ADMIN
+        if(::setsockopt(_channel, SOL_SOCKET, SO_BUSY_POLL, (char *)&busyPoll, sizeof(busyPoll))) {
+            char errStr[64];
+            epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+            LOG(logLevelWarn, "Error setting SO_BUSY_POLL for %s: %s", _socketName.c_str(), errStr);
+        }
+#endif
+    }
+    if(!priorityClassValue(config, "EPICS_PVA_PRIORITY_SEND_SPIN", priority, value))
+        value = 0;
+    setSendSpin(value);
+
+    // 1+CPU, or 0, applied by each thread itself
+    _rxCPU.getAndSet(priorityClassValue(config, "EPICS_PVA_PRIORITY_RX_CPU", priority, value) && value>=0 ? value+1 : 0);
+    _txCPU.getAndSet(priorityClassValue(config, "EPICS_PVA_PRIORITY_TX_CPU", priority, value) && value>=0 ? value+1 : 0);
+}
+
+
+void BlockingTCPTransportCodec::invalidDataStreamHandler() {
+    close();
+}
+
+
+int BlockingTCPTransportCodec::write(
+    epics::pvData::ByteBuffer *src) {
+
+    if(_shmWrite || _rdmaWrite) {
+        while(isOpen()) {
+            const char *buf = &src->getArray()[src->getPosition()];
+            int bytesSent = _shmWrite ? _shm->write(buf, src->getRemaining(), 1.0)
+                                      : _rdma->write(buf, src->getRemaining(), 1.0);
+            if (bytesSent > 0)
+                src->setPosition(src->getPosition() + bytesSent);
+            if (bytesSent != 0)
+                return bytesSent;
+        }
+        return -1;
+    }
+
+    if(_tls) {
+        // socket is non-blocking, 0 leads to sendBufferFull()
+        int bytesSent = _tls->write(&src->getArray()[src->getPosition()], src->getRemaining());
+        if (bytesSent > 0)
+            src->setPosition(src->getPosition() + bytesSent);
+        return bytesSent;
+    }
+
+    std::size_t remaining;
+    while((remaining=src->getRemaining()) > 0) {
+
+        int bytesSent = _txRing ? _txRing->send(&src->getArray()[src->getPosition()], remaining)
+                                : ::send(_channel,
+                                         &src->getArray()[src->getPosition()],
+                                         remaining, 0);
+
+        // NOTE: do not log here, you might override SOCKERRNO relevant to recv() operation above
+
+        // TODO winsock return 0 on disconnect (blocking socket) ?
+
+        if(unlikely(bytesSent<0)) {
+
+            int socketError = SOCKERRNO;
+
+            // spurious EINTR check
+            if (socketError==SOCK_EINTR)
+                continue;
+            else if (socketError==SOCK_ENOBUFS)
+                return 0;
+            else if (_ioReactor && (socketError==SOCK_EWOULDBLOCK || socketError==EAGAIN))
+                return 0;
+        }
+
+        if (bytesSent > 0) {
+            src->setPosition(src->getPosition() + bytesSent);
+        }
+
+        return bytesSent;
 
+    }
 
-void BlockingTCPTransportCodec::invalidDataStreamHandler() {
-    close();
+    return 0;
 }
 
 
-int BlockingTCPTransportCodec::write(
-    epics::pvData::ByteBuffer *src) {
+int BlockingTCPTransportCodec::writeGather(
+    epics::pvData::ByteBuffer **srcs, std::size_t count) {
+    if(_tls || _shmWrite || _rdmaWrite)
+        return AbstractCodec::writeGather(srcs, count);
+#ifdef PVA_CODEC_USE_SENDMSG
+    enum {MAX_IOV = 8};
+    struct iovec iov[MAX_IOV];
+    std::size_t niov = 0;
 
-    std::size_t remaining;
-    while((remaining=src->getRemaining()) > 0) {
+    for(std::size_t i=0; i<count && niov<MAX_IOV; i++) {
+        std::size_t remaining = srcs[i]->getRemaining();
+        if(remaining==0)
+            continue;
+        iov[niov].iov_base = (void*)&srcs[i]->getArray()[srcs[i]->getPosition()];
+        iov[niov].iov_len = remaining;
+        niov++;
+    }
+    if(niov==0)
+        return 0;
 
-        int bytesSent = ::send(_channel,
-                               &src->getArray()[src->getPosition()],
-                               remaining, 0);
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = niov;
 
-        // NOTE: do not log here, you might override SOCKERRNO relevant to recv() operation above
+    while(true) {
+        ssize_t bytesSent = _txRing ? _txRing->sendv(iov, niov) : ::sendmsg(_channel, &msg, 0);
 
-        // TODO winsock return 0 on disconnect (blocking socket) ?
+        // NOTE: do not log here, you might override SOCKERRNO relevant to recv() operation above
 
         if(unlikely(bytesSent<0)) {
 
@@ -1276,17 +2907,24 @@ int BlockingTCPTransportCodec::write(
                 continue;
             else if (socketError==SOCK_ENOBUFS)
                 return 0;
+            else if (_ioReactor && (socketError==SOCK_EWOULDBLOCK || socketError==EAGAIN))
+                return 0;
+            return -1;
         }
 
-        if (bytesSent > 0) {
-            src->setPosition(src->getPosition() + bytesSent);
+        // advance positions of (partially) written buffers
+        std::size_t remaining = bytesSent;
+        for(std::size_t i=0; i<count && remaining>0; i++) {
+            std::size_t n = std::min(remaining, srcs[i]->getRemaining());
+            srcs[i]->setPosition(srcs[i]->getPosition() + n);
+            remaining -= n;
         }
 
-        return bytesSent;
-
+        return int(bytesSent);
     }
-
-    return 0;
+#else
+    return AbstractCodec::writeGather(srcs, count);
+#endif
 }
 
 
@@ -1312,6 +2950,117 @@ const  {
 
 
 int BlockingTCPTransportCodec::read(epics::pvData::ByteBuffer* dst) {
+    return _ioReactor ? readFramed(dst) : readStream(dst);
+}
+
+
+int BlockingTCPTransportCodec::readFramed(epics::pvData::ByteBuffer* dst)
+{
+    if(_rxStageBegin==_rxStageReady) {
+        // make room at the end of _rxStage
+        if(_rxStageBegin>0) {
+            std::copy(_rxStage.begin()+_rxStageBegin, _rxStage.begin()+_rxStageEnd, _rxStage.begin());
+            _rxStageReady -= _rxStageBegin;
+            _rxStageScan -= _rxStageBegin;
+            _rxStageEnd -= _rxStageBegin;
+            _rxStageBegin = 0;
+        }
+        const std::size_t chunk = std::max(dst->getRemaining(), _socketBuffer.getSize());
+        if(_rxStage.size() < _rxStageEnd + chunk)
+            _rxStage.resize(_rxStageEnd + chunk);
+
+        // one read at a time, so that one busy connection can't keep the worker to itself
+        epics::pvData::ByteBuffer stage(&_rxStage[0], _rxStage.size());
+        stage.setPosition(_rxStageEnd);
+        int bytesRead = readStream(&stage);
+        if(bytesRead<=0)
+            return bytesRead;
+        _rxStageEnd += bytesRead;
+
+        scanFrames();
+
+        // the rest of a message, or segmented message, is still to come
+        if(_rxStageBegin==_rxStageReady)
+            return 0;
+    }
+
+    std::size_t n = std::min(dst->getRemaining(), _rxStageReady - _rxStageBegin);
+    dst->put(&_rxStage[_rxStageBegin], 0, n);
+    _rxStageBegin += n;
+    return int(n);
+}
+
+
+void BlockingTCPTransportCodec::scanFrames()
+{
+    while(_rxStageEnd - _rxStageScan >= PVA_MESSAGE_HEADER_SIZE) {
+        const uint8 *header = (const uint8*)&_rxStage[_rxStageScan];
+
+        if(int8(header[0])!=PVA_MAGIC) {
+            // let processHeader() complain
+            _rxStageReady = _rxStageScan = _rxStageEnd;
+            return;
+        }
+
+        const int8 flags = int8(header[2]);
+        std::size_t frame = PVA_MESSAGE_HEADER_SIZE;
+        // a control message has no payload
+        if(!(flags&0x01)) {
+            if(flags&0x80)
+                frame += (std::size_t(header[4])<<24) | (std::size_t(header[5])<<16)
+                        | (std::size_t(header[6])<<8) | header[7];
+            else
+                frame += (std::size_t(header[7])<<24) | (std::size_t(header[6])<<16)
+                        | (std::size_t(header[5])<<8) | header[4];
+        }
+        if(_rxStageEnd - _rxStageScan < frame)
+            break;
+        _rxStageScan += frame;
+
+        if(!(flags&0x01))
+            _rxStageSegmented = (flags&0x10)!=0; // first or middle segment
+        if(!_rxStageSegmented)
+            _rxStageReady = _rxStageScan;
+    }
+}
+
+
+int BlockingTCPTransportCodec::readStream(epics::pvData::ByteBuffer* dst) {
+
+    if(_shmRead || _rdmaRead) {
+        while(isOpen() && dst->getRemaining() > 0) {
+            char *buf = (char*)(dst->getArray()+dst->getPosition());
+            int bytesRead = _shmRead ? _shm->read(buf, dst->getRemaining(), 1.0)
+                                     : _rdma->read(buf, dst->getRemaining(), 1.0);
+            if (bytesRead > 0) {
+                dst->setPosition(dst->getPosition() + bytesRead);
+                return bytesRead;
+            } else if (bytesRead < 0) {
+                return -1;
+            }
+            // nothing more is sent through the socket, so readable means closed by the peer
+            if (IOReactor::waitFor(_channel, false, 0.0) != 0)
+                return -1;
+        }
+        return isOpen() ? 0 : -1;
+    }
+
+    if(_tls) {
+        // socket is non-blocking, so without a reactor wait here for more
+        while(dst->getRemaining() > 0) {
+            int bytesRead = _tls->read((char*)(dst->getArray()+dst->getPosition()), dst->getRemaining());
+            if (bytesRead > 0) {
+                dst->setPosition(dst->getPosition() + bytesRead);
+                return bytesRead;
+            } else if (bytesRead < 0 || !isOpen()) {
+                return -1;
+            } else if (_ioReactor) {
+                return 0;
+            }
+            IOReactor::waitFor(_channel, false, 1.0);
+        }
+        return 0;
+    }
 
     std::size_t remaining;
     while((remaining=dst->getRemaining()) > 0) {
@@ -1319,8 +3068,8 @@ int BlockingTCPTransportCodec::read(epics::pvData::ByteBuffer* dst) {
         // read
         std::size_t pos = dst->getPosition();
 
-        int bytesRead = recv(_channel,
-                             (char*)(dst->getArray()+pos), remaining, 0);
+        int bytesRead = _rxRing ? _rxRing->recv((char*)(dst->getArray()+pos), remaining)
+                                : spinRecv((char*)(dst->getArray()+pos), remaining);
 
         // NOTE: do not log here, you might override SOCKERRNO relevant to recv() operation above
 
@@ -1339,10 +3088,15 @@ int BlockingTCPTransportCodec::read(epics::pvData::ByteBuffer* dst) {
 
                 // TODO SOCK_ENOBUFS, for read?
                 // interrupted or timeout
-                if (socketError == SOCK_EINTR ||
-                        socketError == EAGAIN ||
+                if (socketError == SOCK_EINTR)
+                    continue;
+                else if (socketError == EAGAIN ||
                         socketError == SOCK_EWOULDBLOCK)
+                {
+                    if (_ioReactor)
+                        return 0; // non-blocking, nothing more to read now
                     continue;
+                }
             }
 
             return -1;    // 0 means connection loss for blocking transport, notify codec by returning -1
@@ -1356,6 +3110,344 @@ int BlockingTCPTransportCodec::read(epics::pvData::ByteBuffer* dst) {
 }
 
 
+int BlockingTCPTransportCodec::spinRecv(char *buf, std::size_t count)
+{
+#ifdef MSG_DONTWAIT
+    const int spinUS = _ioReactor ? 0 : _rxSpinUS.get();
+    if(spinUS > 0) {
+        // poll for up to spinUS before blocking, to avoid the latency of being woken
+        epicsTimeStamp start, now;
+        epicsTimeGetCurrent(&start);
+        do {
+            int ret = recvStamped(buf, count, MSG_DONTWAIT);
+            if(ret>=0 || (SOCKERRNO!=SOCK_EWOULDBLOCK && SOCKERRNO!=EAGAIN))
+                return ret;
+            epicsTimeGetCurrent(&now);
+        } while(epicsTimeDiffInSeconds(&now, &start)*1e6 < spinUS && isOpen());
+    }
+#endif
+    return recvStamped(buf, count, 0);
+}
+
+int BlockingTCPTransportCodec::recvStamped(char *buf, std::size_t count, int flags)
+{
+#ifdef PVA_CODEC_RX_STAMPS
+    if(_rxStampMode != RX_STAMP_NONE) {
+        struct iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = count;
+        // as struct scm_timestamping, software, deprecated, and raw hardware
+        union {
+            char buf[CMSG_SPACE(3u*sizeof(struct timespec))];
+            struct cmsghdr align;
+        } control;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        int ret = ::recvmsg(_channel, &msg, flags);
+        if(ret > 0) {
+            _rxKernelValid = false;
+            for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING)
+                    continue;
+                struct timespec ts[3];
+                memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+                // the hardware clock of the interface, which must be synchronized with the system clock
+                const struct timespec& chosen = _rxStampMode == RX_STAMP_HARDWARE && (ts[2].tv_sec || ts[2].tv_nsec)
+                        ? ts[2] : ts[0];
+                if(chosen.tv_sec || chosen.tv_nsec)
+                    _rxKernelValid = epicsTimeFromTimespec(&_rxKernelTime, &chosen)==epicsTimeOK;
+            }
+        }
+        return ret;
+    }
+#endif
+    return ::recv(_channel, buf, count, flags);
+}
+
+void BlockingTCPTransportCodec::stampDispatch()
+{
+    // the stamp of the last read, so when several messages arrive together, that of the last
+    if(!_rxKernelValid)
+        return;
+    epicsTimeGetCurrent(&_rxDispatchTime);
+    _rxStamped = true;
+    const double waited = epicsTimeDiffInSeconds(&_rxDispatchTime, &_rxKernelTime);
+    Lock guard(_rxLatencyMutex);
+    _rxToDispatch.record(waited);
+}
+
+void BlockingTCPTransportCodec::responseSent(const epicsTimeStamp& dispatch)
+{
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    const double elapsed = epicsTimeDiffInSeconds(&now, &dispatch);
+    Lock guard(_rxLatencyMutex);
+    _rxToResponse.record(elapsed);
+}
+
+void BlockingTCPTransportCodec::getReceiveLatency(LatencyHistogram& toDispatch, LatencyHistogram& toResponse) const
+{
+    Lock guard(_rxLatencyMutex);
+    toDispatch = _rxToDispatch;
+    toResponse = _rxToResponse;
+}
+
+
+struct BlockingTCPTransportCodec::ShmControlSender : public TransportSender
+{
+    // the send queue holding us belongs to the codec
+    BlockingTCPTransportCodec * const codec;
+    const int8 command;
+    const int32 data;
+    // afterwards, send only through the ring.  &_shmWrite, &_rdmaWrite, or NULL
+    bool * const switchWrite;
+
+    ShmControlSender(BlockingTCPTransportCodec *codec, int8 command, int32 data, bool *switchWrite)
+        :codec(codec), command(command), data(data), switchWrite(switchWrite)
+    {
+        setQueueLevel(LEVEL_URGENT);
+    }
+    virtual ~ShmControlSender() {}
+
+    virtual void send(ByteBuffer* /*buffer*/, TransportSendControl* control) OVERRIDE FINAL
+    {
+        codec->putControlMessage(command, data);
+        // everything already queued, and this message, go through the socket
+        control->flush(true);
+        if(switchWrite)
+            *switchWrite = true;
+    }
+};
+
+struct BlockingTCPTransportCodec::RdmaEndpointSender : public TransportSender
+{
+    const RdmaRing::Endpoint endpoint;
+
+    explicit RdmaEndpointSender(const RdmaRing::Endpoint& endpoint)
+        :endpoint(endpoint)
+    {
+        setQueueLevel(LEVEL_URGENT);
+    }
+    virtual ~RdmaEndpointSender() {}
+
+    virtual void send(ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL
+    {
+        control->startMessage((int8)CMD_RDMA_ENDPOINT, RdmaRing::Endpoint::wireSize);
+        endpoint.serialize(buffer);
+        control->endMessage();
+    }
+};
+
+void BlockingTCPTransportCodec::offerSharedMemory()
+{
+    // only when both ends are certainly on this host
+    if(!_shmRingSize || _tls || _socketAddress.ia.sin_family!=AF_INET
+            || (ntohl(_socketAddress.ia.sin_addr.s_addr)>>24)!=127u)
+        return;
+
+    epics::pvData::uint32 token = 0;
+    ShmRing::shared_pointer ring(ShmRing::create(_shmRingSize, &token));
+    if(!ring)
+        return;
+    {
+        Lock guard(_shmMutex);
+        if(_shm || !isOpen())
+            return;
+        _shm = ring;
+    }
+
+    TransportSender::shared_pointer sender(new ShmControlSender(this, CMD_SHM_OFFER, int32(token), 0));
+    enqueueSendRequest(sender);
+}
+
+void BlockingTCPTransportCodec::offerRDMA()
+{
+    // a ring on this host is cheaper, and loopback is not through an RDMA device
+    if(!_rdmaRingSize || _tls || _socketAddress.ia.sin_family!=AF_INET
+            || (ntohl(_socketAddress.ia.sin_addr.s_addr)>>24)==127u)
+        return;
+    {
+        Lock guard(_shmMutex);
+        if(_shm || _rdma || !isOpen())
+            return;
+    }
+
+    TransportSender::shared_pointer sender(new ShmControlSender(this, CMD_RDMA_OFFER, 0, 0));
+    enqueueSendRequest(sender);
+}
+
+void BlockingTCPTransportCodec::processTraceContext()
+{
+    // only expected after we sent CMD_SET_TRACE
+    if(!_tracing || _payloadSize < int32(TraceContext::wireSize))
+        return;
+    ensureData(TraceContext::wireSize);
+    _rxTrace.deserialize(&_socketBuffer);
+    epicsTimeGetCurrent(&_rxTraceTime);
+    _rxTraced = true;
+}
+
+void BlockingTCPTransportCodec::processShmControl(int8 command, int32 data)
+{
+    switch(command) {
+    case CMD_SHM_OFFER: // on server
+    {
+        ShmRing::shared_pointer ring;
+        if(_shmRingSize && !_tls && data)
+            ring = ShmRing::open(epics::pvData::uint32(data));
+        {
+            Lock guard(_shmMutex);
+            if(ring && !_shm && isOpen())
+                _shm = ring;
+            else
+                ring.reset();
+        }
+        if(ring)
+            LOG(logLevelDebug, "Sending to PVA client %s through shared memory.", _socketName.c_str());
+
+        TransportSender::shared_pointer sender(new ShmControlSender(this, CMD_SHM_ACCEPT, ring ? data : 0, ring ? &_shmWrite : 0));
+        enqueueSendRequest(sender);
+        break;
+    }
+    case CMD_SHM_ACCEPT: // on client
+    {
+        ShmRing::shared_pointer ring;
+        {
+            Lock guard(_shmMutex);
+            ring = _shm;
+            if(!data)
+                _shm.reset();
+        }
+        if(!ring)
+            break;
+        ring->unlink();
+        if(!data)
+            break;
+
+        // the server sends nothing more through the socket
+        _shmRead = true;
+
+        TransportSender::shared_pointer sender(new ShmControlSender(this, CMD_SHM_SWITCH, data, &_shmWrite));
+        enqueueSendRequest(sender);
+
+        LOG(logLevelDebug, "Connection to PVA server %s moved to shared memory.", _socketName.c_str());
+        break;
+    }
+    case CMD_SHM_SWITCH: // on server
+        // the client sends nothing more through the socket
+        if(_shm)
+            _shmRead = true;
+        break;
+    }
+}
+
+void BlockingTCPTransportCodec::processRdmaControl(int8 command, int32 data)
+{
+    switch(command) {
+    case CMD_RDMA_OFFER: // on server
+    {
+        RdmaRing::shared_pointer ring;
+        if(_rdmaRingSize && !_tls)
+            ring = RdmaRing::create(_rdmaDevice, _rdmaGidIndex, _rdmaRingSize);
+        {
+            Lock guard(_shmMutex);
+            if(ring && !_shm && !_rdma && isOpen())
+                _rdma = ring;
+            else
+                ring.reset();
+        }
+        if(ring)
+            ring->registerSendBuffer(_sendBlock.data(), _sendBlock.size());
+
+        // an empty endpoint refuses
+        TransportSender::shared_pointer sender(new RdmaEndpointSender(ring ? ring->local() : RdmaRing::Endpoint()));
+        enqueueSendRequest(sender);
+        break;
+    }
+    case CMD_RDMA_SWITCH:
+        if(isServer()) { // on server
+            // the client sends nothing more through the socket
+            if(_rdma && _rdmaWrite)
+                _rdmaRead = true;
+
+        } else { // on client
+            RdmaRing::shared_pointer ring;
+            {
+                Lock guard(_shmMutex);
+                ring = _rdma;
+                if(!data)
+                    _rdma.reset();
+            }
+            if(!ring || !data)
+                break;
+
+            // the server sends nothing more through the socket
+            _rdmaRead = true;
+
+            TransportSender::shared_pointer sender(new ShmControlSender(this, CMD_RDMA_SWITCH, data, &_rdmaWrite));
+            enqueueSendRequest(sender);
+
+            LOG(logLevelDebug, "Connection to PVA server %s moved to RDMA.", _socketName.c_str());
+        }
+        break;
+    }
+}
+
+void BlockingTCPTransportCodec::processRdmaEndpoint()
+{
+    if(_payloadSize < int32(RdmaRing::Endpoint::wireSize))
+        return;
+    ensureData(RdmaRing::Endpoint::wireSize);
+    RdmaRing::Endpoint remote;
+    remote.deserialize(&_socketBuffer);
+
+    if(isServer()) { // on server, the client's ring, in reply to ours
+        RdmaRing::shared_pointer ring;
+        {
+            Lock guard(_shmMutex);
+            ring = _rdma;
+        }
+        if(!ring)
+            return;
+        bool ok = !remote.empty() && ring->connect(remote);
+        if(!ok) {
+            Lock guard(_shmMutex);
+            _rdma.reset();
+        } else {
+            LOG(logLevelDebug, "Sending to PVA client %s through RDMA.", _socketName.c_str());
+        }
+
+        TransportSender::shared_pointer sender(new ShmControlSender(this, CMD_RDMA_SWITCH, ok ? 1 : 0, ok ? &_rdmaWrite : 0));
+        enqueueSendRequest(sender);
+
+    } else { // on client, the server's ring, in reply to CMD_RDMA_OFFER
+        RdmaRing::shared_pointer ring;
+        if(!remote.empty() && _rdmaRingSize && !_tls)
+            ring = RdmaRing::create(_rdmaDevice, _rdmaGidIndex, _rdmaRingSize);
+        if(ring && !ring->connect(remote))
+            ring.reset();
+        {
+            Lock guard(_shmMutex);
+            if(ring && !_shm && !_rdma && isOpen())
+                _rdma = ring;
+            else
+                ring.reset();
+        }
+        if(ring)
+            ring->registerSendBuffer(_sendBlock.data(), _sendBlock.size());
+        else if(remote.empty())
+            return;
+
+        TransportSender::shared_pointer sender(new RdmaEndpointSender(ring ? ring->local() : RdmaRing::Endpoint()));
+        enqueueSendRequest(sender);
+    }
+}
+
 bool BlockingTCPTransportCodec::verify(epics::pvData::int32 timeoutMs) {
     return _verifiedEvent.wait(timeoutMs/1000.0) && _verified;
 }
@@ -1426,8 +3518,23 @@ BlockingServerTCPTransportCodec::BlockingServerTCPTransportCodec(
     int32_t receiveBufferSize) :
     BlockingTCPTransportCodec(true, context, channel, responseHandler,
                               sendBufferSize, receiveBufferSize, PVA_DEFAULT_PRIORITY),
-    _lastChannelSID(0), _verifyOrVerified(false), _securityRequired(false)
+    _lastChannelSID(0), _verifyDone(false), _verifyOrVerified(false), _securityRequired(false)
 {
+    Configuration::const_shared_pointer config(context->getConfiguration());
+    if(config) {
+        configureSlowConsumer(*config);
+
+        // by the interface the client connected to
+        std::string affinity(config->getPropertyAsString("EPICS_PVAS_CPU_AFFINITY", ""));
+        osiSockAddr local;
+        osiSocklen_t len = sizeof(local);
+        CPUAffinity cpus;
+        int node = -1;
+        if(!affinity.empty() && ::getsockname(channel, &local.sa, &len)==0
+                && affinityFor(affinity, local, cpus, node))
+            setAffinity(cpus, node);
+    }
+
     // NOTE: priority not yet known, default priority is used to
     //register/unregister
     // TODO implement priorities in Reactor... not that user will
@@ -1438,6 +3545,31 @@ BlockingServerTCPTransportCodec::BlockingServerTCPTransportCodec(
 BlockingServerTCPTransportCodec::~BlockingServerTCPTransportCodec() {
 }
 
+void BlockingServerTCPTransportCodec::configureSlowConsumer(const Configuration& config)
+{
+    int32 maxQueued = config.getPropertyAsInteger("EPICS_PVAS_MAX_SEND_QUEUE", 0);
+    int32 maxBytes = config.getPropertyAsInteger("EPICS_PVAS_MAX_SEND_BYTES", 0);
+    std::string policy(config.getPropertyAsString("EPICS_PVAS_SLOW_CLIENT_POLICY", "squash"));
+    SlowConsumerPolicy slow = SLOW_CONSUMER_SQUASH;
+    if(policy=="drop")
+        slow = SLOW_CONSUMER_DROP;
+    else if(policy=="disconnect")
+        slow = SLOW_CONSUMER_DISCONNECT;
+    else if(policy!="squash")
+        LOG(logLevelWarn, "Unknown EPICS_PVAS_SLOW_CLIENT_POLICY='%s', using 'squash'", policy.c_str());
+    setSlowConsumerLimits(maxQueued > 0 ? size_t(maxQueued) : 0u,
+                          maxBytes > 0 ? size_t(maxBytes) : 0u, slow);
+}
+
+void BlockingServerTCPTransportCodec::applyConfiguration()
+{
+    BlockingTCPTransportCodec::applyConfiguration();
+
+    Configuration::const_shared_pointer config(_context->getConfiguration());
+    if(config && isOpen())
+        configureSlowConsumer(*config);
+}
+
 
 pvAccessID BlockingServerTCPTransportCodec::preallocateChannelSID() {
 
@@ -1472,8 +3604,7 @@ BlockingServerTCPTransportCodec::getChannel(pvAccessID sid) {
 
     Lock lock(_channelsMutex);
 
-    std::map<pvAccessID, ServerChannel::shared_pointer>::iterator it =
-        _channels.find(sid);
+    _channels_t::iterator it = _channels.find(sid);
 
     if(it!=_channels.end()) return it->second;
 
@@ -1517,6 +3648,10 @@ void BlockingServerTCPTransportCodec::send(ByteBuffer* buffer,
         buffer->putByte(2);		// set byte order
         buffer->putInt(0);
 
+        putCompressionControl();
+        putTraceControl();
+        putPipelineControl();
+
 
         //
         // send verification message
@@ -1600,6 +3735,68 @@ void BlockingServerTCPTransportCodec::internalClose() {
     destroyAllChannels();
 }
 
+// fails validation if not completed in time, or closes after validation failed
+struct BlockingServerTCPTransportCodec::VerifyTimer : public epics::pvData::TimerCallback
+{
+    const std::tr1::weak_ptr<BlockingServerTCPTransportCodec> transport;
+    const bool closing;
+    VerifyTimer(const BlockingServerTCPTransportCodec::shared_pointer& transport, bool closing)
+        :transport(transport), closing(closing)
+    {}
+    virtual ~VerifyTimer() {}
+    virtual void callback() OVERRIDE FINAL
+    {
+        BlockingServerTCPTransportCodec::shared_pointer T(transport.lock());
+        if(!T)
+            return;
+        if(closing)
+            T->close();
+        else
+            T->verified(Status(Status::STATUSTYPE_ERROR, "Connection validation timeout"));
+    }
+    virtual void timerStopped() OVERRIDE FINAL {}
+};
+
+void BlockingServerTCPTransportCodec::startVerification(double timeout)
+{
+    BlockingServerTCPTransportCodec::shared_pointer self(std::tr1::dynamic_pointer_cast<BlockingServerTCPTransportCodec>(shared_from_this()));
+
+    // the validation request
+    enqueueSendRequest(self);
+
+    std::tr1::shared_ptr<VerifyTimer> expire(new VerifyTimer(self, false));
+    _context->getTimer()->scheduleAfterDelay(expire, timeout);
+}
+
+void BlockingServerTCPTransportCodec::verified(epics::pvData::Status const & status)
+{
+    {
+        Lock lock(_verificationStatusMutex);
+        if (_verifyDone)
+            return;
+        _verifyDone = true;
+        _verificationStatus = status;
+    }
+    BlockingTCPTransportCodec::verified(status);
+
+    BlockingServerTCPTransportCodec::shared_pointer self(std::tr1::dynamic_pointer_cast<BlockingServerTCPTransportCodec>(shared_from_this()));
+
+    // the validated message, with status
+    enqueueSendRequest(self);
+
+    if (status.isSuccess())
+    {
+        LOG(logLevelDebug, "Serving to PVA client: %s.", _socketName.c_str());
+    }
+    else
+    {
+        LOG(logLevelDebug, "Connection to PVA client %s failed to be validated, closing it.", _socketName.c_str());
+        // after the negative response is sent
+        std::tr1::shared_ptr<VerifyTimer> closer(new VerifyTimer(self, true));
+        _context->getTimer()->scheduleAfterDelay(closer, 1.0);
+    }
+}
+
 void BlockingServerTCPTransportCodec::authenticationCompleted(epics::pvData::Status const & status)
 {
     if (IS_LOGGABLE(logLevelDebug))
@@ -1607,7 +3804,13 @@ void BlockingServerTCPTransportCodec::authenticationCompleted(epics::pvData::Sta
         LOG(logLevelDebug, "Authentication completed with status '%s' for PVA client: %s.", Status::StatusTypeName[status.getType()], _socketName.c_str());
     }
 
-    if (!isVerified()) // TODO sync
+    bool done;
+    {
+        Lock lock(_verificationStatusMutex);
+        done = _verifyDone;
+    }
+
+    if (!done)
         verified(status);
     else if (!status.isSuccess())
     {
@@ -1650,7 +3853,10 @@ void BlockingServerTCPTransportCodec::authNZInitialize(const std::string& securi
     }
 
     if (!securityPlugin->isValidFor(_socketAddress))
+    {
         verified(invalidSecurityPluginNameStatus);
+        return;
+    }
 
     if (IS_LOGGABLE(logLevelDebug))
     {
@@ -1691,10 +3897,20 @@ BlockingClientTCPTransportCodec::BlockingClientTCPTransportCodec(
     int16_t priority ) :
     BlockingTCPTransportCodec(false, context, channel, responseHandler,
                               sendBufferSize, receiveBufferSize, priority),
-    _connectionTimeout(heartbeatInterval*1000),
+    _connectionTimeout(heartbeatInterval),
+    _echoPeriod(0.0),
     _unresponsiveTransport(false),
-    _verifyOrEcho(true)
+    _verifyOrEcho(true),
+    _echoPending(false),
+    _rtt(0.0),
+    _rttVar(0.0),
+    _rttSamples(0u),
+    _lastBytesReceived(0u)
 {
+    _echoPeriod = context->getConfiguration()->getPropertyAsDouble("EPICS_PVA_ECHO_PERIOD", _echoPeriod);
+    if(_echoPeriod<0.0)
+        _echoPeriod = 0.0;
+
     // initialize owners list, send queue
     acquire(client);
 
@@ -1703,12 +3919,15 @@ BlockingClientTCPTransportCodec::BlockingClientTCPTransportCodec(
 
     // setup connection timeout timer (watchdog) - moved to start() method
     epicsTimeGetCurrent(&_aliveTimestamp);
+    _echoSent = _aliveTimestamp;
 }
 
 void BlockingClientTCPTransportCodec::start()
 {
     TimerCallbackPtr tcb = std::tr1::dynamic_pointer_cast<TimerCallback>(shared_from_this());
-    _context->getTimer()->schedulePeriodic(tcb, _connectionTimeout, _connectionTimeout);
+    // probe twice per echo period, so that a missing reply is noticed soon after it is due
+    double period = _echoPeriod>0.0 ? _echoPeriod/2.0 : _connectionTimeout;
+    _context->getTimer()->schedulePeriodic(tcb, period, period);
     BlockingTCPTransportCodec::start();
 }
 
@@ -1727,16 +3946,49 @@ void BlockingClientTCPTransportCodec::callback() {
     epicsTimeStamp currentTime;
     epicsTimeGetCurrent(&currentTime);
 
-    _mutex.lock();
-    // no exception expected here
-    double diff = epicsTimeDiffInSeconds(&currentTime, &_aliveTimestamp);
-    _mutex.unlock();
+    // anything received since the last check shows the server is alive.
+    // counted by the receive path anyway, so nothing is added there
+    TransportStatistics stats;
+    _stats.snapshot(stats);
 
-    if(diff>((3*_connectionTimeout)/2)) {
+    bool received, unresponsive = false, echo = false;
+    {
+        Lock guard(_mutex);
+        received = stats.bytesReceived != _lastBytesReceived;
+        if(received) {
+            _lastBytesReceived = stats.bytesReceived;
+            _aliveTimestamp = currentTime;
+            _echoPending = false;
+        }
+        double idle = epicsTimeDiffInSeconds(&currentTime, &_aliveTimestamp);
+
+        if(_echoPeriod>0.0) {
+            if(_echoPending) {
+                // a reply is due within a few round trips, but not sooner than one period
+                double waited = epicsTimeDiffInSeconds(&currentTime, &_echoSent);
+                unresponsive = waited > std::max(_echoPeriod, _rtt + 4.0*_rttVar);
+            } else if(idle>=_echoPeriod) {
+                // probe only an idle connection, and one at a time
+                echo = true;
+                _echoPending = true;
+                _echoSent = currentTime;
+            }
+        } else if(idle>((3*_connectionTimeout)/2)) {
+            unresponsive = true;
+        }
+        // use some k (3/4) to handle "jitter"
+        else if(idle>=((3*_connectionTimeout)/4)) {
+            echo = true;
+        }
+    }
+
+    if(received) {
+        responsiveTransport();
+    } else if(unresponsive) {
         unresponsiveTransport();
     }
-    // use some k (3/4) to handle "jitter"
-    else if(diff>=((3*_connectionTimeout)/4)) {
+
+    if(echo) {
         // send echo
         TransportSender::shared_pointer transportSender = std::tr1::dynamic_pointer_cast<TransportSender>(shared_from_this());
         enqueueSendRequest(transportSender);
@@ -1748,19 +4000,28 @@ void BlockingClientTCPTransportCodec::callback() {
                 catch (...) { LOG(logLevelError, "Unhandled exception caught from code at %s:%d.", __FILE__, __LINE__); }
 
 void BlockingClientTCPTransportCodec::unresponsiveTransport() {
-    Lock lock(_mutex);
-    if(!_unresponsiveTransport) {
+    // notified without _mutex, as channels may release() this transport
+    std::vector<ClientChannelImpl::shared_pointer> clients;
+    {
+        Lock lock(_mutex);
+        if(_unresponsiveTransport)
+            return;
         _unresponsiveTransport = true;
 
+        LOG(logLevelDebug, "Transport to %s unresponsive.", _socketName.c_str());
+
+        clients.reserve(_owners.size());
         TransportClientMap_t::iterator it = _owners.begin();
         for(; it!=_owners.end(); it++) {
             ClientChannelImpl::shared_pointer client = it->second.lock();
             if (client)
-            {
-                EXCEPTION_GUARD(client->transportUnresponsive());
-            }
+                clients.push_back(client);
         }
     }
+
+    for(size_t i=0; i<clients.size(); i++) {
+        EXCEPTION_GUARD(clients[i]->transportUnresponsive());
+    }
 }
 
 bool BlockingClientTCPTransportCodec::acquire(ClientChannelImpl::shared_pointer const & client) {
@@ -1837,26 +4098,57 @@ void BlockingClientTCPTransportCodec::release(pvAccessID clientID) {
 }
 
 void BlockingClientTCPTransportCodec::aliveNotification() {
+    {
+        Lock guard(_mutex);
+        epicsTimeGetCurrent(&_aliveTimestamp);
+
+        // an echo reply.  Smoothed round trip time, and its variation, as RFC 6298
+        if(_echoPending) {
+            _echoPending = false;
+            double rtt = epicsTimeDiffInSeconds(&_aliveTimestamp, &_echoSent);
+            if(_rttSamples++==0u) {
+                _rtt = rtt;
+                _rttVar = rtt/2.0;
+            } else {
+                _rttVar = 0.75*_rttVar + 0.25*fabs(_rtt - rtt);
+                _rtt = 0.875*_rtt + 0.125*rtt;
+            }
+        }
+    }
+    responsiveTransport();
+}
+
+void BlockingClientTCPTransportCodec::getRoundTripTime(double& rtt, double& rttVar, size_t& samples) const {
     Lock guard(_mutex);
-    epicsTimeGetCurrent(&_aliveTimestamp);
-    if(_unresponsiveTransport) responsiveTransport();
+    rtt = _rtt;
+    rttVar = _rttVar;
+    samples = _rttSamples;
 }
 
 void BlockingClientTCPTransportCodec::responsiveTransport() {
-    Lock lock(_mutex);
-    if(_unresponsiveTransport) {
+    std::vector<ClientChannelImpl::shared_pointer> clients;
+    Transport::shared_pointer thisSharedPtr;
+    {
+        Lock lock(_mutex);
+        if(!_unresponsiveTransport)
+            return;
         _unresponsiveTransport = false;
 
-        Transport::shared_pointer thisSharedPtr = shared_from_this();
+        LOG(logLevelDebug, "Transport to %s responsive again.", _socketName.c_str());
+
+        thisSharedPtr = shared_from_this();
+        clients.reserve(_owners.size());
         TransportClientMap_t::iterator it = _owners.begin();
         for(; it!=_owners.end(); it++) {
             ClientChannelImpl::shared_pointer client = it->second.lock();
             if (client)
-            {
-                EXCEPTION_GUARD(client->transportResponsive(thisSharedPtr));
-            }
+                clients.push_back(client);
         }
     }
+
+    for(size_t i=0; i<clients.size(); i++) {
+        EXCEPTION_GUARD(clients[i]->transportResponsive(thisSharedPtr));
+    }
 }
 
 void BlockingClientTCPTransportCodec::changedTransport() {
@@ -1878,6 +4170,9 @@ void BlockingClientTCPTransportCodec::send(ByteBuffer* buffer,
     if(_verifyOrEcho) {
         _verifyOrEcho = false;
 
+        putCompressionControl();
+        putTraceControl();
+
         /*
          * send verification response message
          */
@@ -0,0 +1,230 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <deque>
+#include <sstream>
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+
+#include <pv/reftrack.h>
+
+#define epicsExportSharedSymbols
+#include <pv/decodePool.h>
+#include <pv/codec.h>
+#include <pv/logger.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+struct Job {
+    std::tr1::shared_ptr<detail::AbstractCodec> codec;
+    std::tr1::shared_ptr<epics::pvData::ByteBuffer> payload;
+    epics::pvData::int8 version, command;
+};
+
+// the Job each worker is processing
+epicsThreadOnceId decodeOnce = EPICS_THREAD_ONCE_INIT;
+epicsThreadPrivateId decodeCurrent;
+
+void decodeInit(void*)
+{
+    decodeCurrent = epicsThreadPrivateCreate();
+}
+}
+
+struct DecodePool::Worker : public epicsThreadRunable
+{
+    epicsMutex mutex;
+    std::deque<Job> queue;
+    // processing jobs taken from queue
+    bool busy;
+    bool stopping;
+    unsigned drainWaiters;
+    size_t processed;
+    epicsEvent wakeup, drained;
+
+    epicsThread thread;
+
+    Worker(const std::string& name)
+        :busy(false)
+        ,stopping(false)
+        ,drainWaiters(0u)
+        ,processed(0u)
+        ,thread(*this, name.c_str(),
+                epicsThreadGetStackSize(epicsThreadStackBig),
+                epicsThreadPriorityCAServerLow)
+    {}
+
+    virtual ~Worker() {}
+
+    void process(Job& job)
+    {
+        if(!job.codec->isOpen())
+            return;
+        epicsThreadPrivateSet(decodeCurrent, &job);
+        try {
+            job.codec->processOffloaded(job.version, job.command, job.payload.get());
+        } catch(std::exception& e) {
+            LOG(logLevelError, "Unhandled exception processing command %d: %s, disconnecting...",
+                int(job.command), e.what());
+            job.codec->close();
+        }
+        epicsThreadPrivateSet(decodeCurrent, 0);
+    }
+
+    virtual void run() OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        while(true) {
+            while(queue.empty() && !stopping) {
+                UnGuard U(G);
+                wakeup.wait();
+            }
+            if(stopping)
+                break;
+
+            std::deque<Job> jobs;
+            jobs.swap(queue);
+            busy = true;
+            const size_t njobs = jobs.size();
+            {
+                UnGuard U(G);
+                {
+                    // as the receive thread does for the messages read together
+                    detail::ReceiveBatch batch;
+                    for(size_t i=0; i<njobs; i++)
+                        process(jobs[i]);
+                }
+                // release the codecs without the lock
+                jobs.clear();
+            }
+            busy = false;
+            processed += njobs;
+            if(drainWaiters)
+                drained.signal();
+        }
+        busy = false;
+        queue.clear();
+        if(drainWaiters)
+            drained.signal();
+    }
+};
+
+size_t DecodePool::num_instances;
+
+DecodePool::DecodePool(const std::string& name, unsigned nthreads)
+{
+    epicsThreadOnce(&decodeOnce, &decodeInit, 0);
+
+    if(nthreads==0u)
+        nthreads = 1u;
+
+    workers.reserve(nthreads);
+    try {
+        for(unsigned i=0; i<nthreads; i++) {
+            std::ostringstream strm;
+            strm<<name<<" "<<i;
+            workers.push_back(new Worker(strm.str()));
+            workers.back()->thread.start();
+        }
+    } catch(...) {
+        close();
+        throw;
+    }
+    REFTRACE_INCREMENT(num_instances);
+}
+
+DecodePool::~DecodePool()
+{
+    close();
+    REFTRACE_DECREMENT(num_instances);
+}
+
+void DecodePool::close()
+{
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        Worker& W = *workers[i];
+        {
+            Guard G(W.mutex);
+            W.stopping = true;
+        }
+        W.wakeup.signal();
+    }
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        workers[i]->thread.exitWait();
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+void DecodePool::post(const std::tr1::shared_ptr<detail::AbstractCodec>& codec,
+                      pvAccessID ioid,
+                      epics::pvData::int8 version,
+                      epics::pvData::int8 command,
+                      const std::tr1::shared_ptr<epics::pvData::ByteBuffer>& payload)
+{
+    Job job;
+    job.codec = codec;
+    job.payload = payload;
+    job.version = version;
+    job.command = command;
+
+    Worker& W = *workers[ioid % workers.size()];
+    bool wake;
+    {
+        Guard G(W.mutex);
+        if(W.stopping)
+            return;
+        wake = W.queue.empty() && !W.busy;
+        W.queue.push_back(job);
+    }
+    if(wake)
+        W.wakeup.signal();
+}
+
+void DecodePool::drain(pvAccessID ioid)
+{
+    Worker& W = *workers[ioid % workers.size()];
+    Guard G(W.mutex);
+    if(W.queue.empty() && !W.busy)
+        return;
+    W.drainWaiters++;
+    while(!W.stopping && (!W.queue.empty() || W.busy)) {
+        UnGuard U(G);
+        W.drained.wait();
+    }
+    W.drainWaiters--;
+    // pass on to the next waiting
+    if(W.drainWaiters)
+        W.drained.signal();
+}
+
+epics::pvData::ByteBuffer* DecodePool::current(const detail::AbstractCodec* codec)
+{
+    epicsThreadOnce(&decodeOnce, &decodeInit, 0);
+    Job *job = static_cast<Job*>(epicsThreadPrivateGet(decodeCurrent));
+    return job && job->codec.get()==codec ? job->payload.get() : 0;
+}
+
+size_t DecodePool::processed() const
+{
+    size_t ret = 0u;
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        Guard G(workers[i]->mutex);
+        ret += workers[i]->processed;
+    }
+    return ret;
+}
+
+}
+}
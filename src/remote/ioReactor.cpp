@@ -0,0 +1,612 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <errno.h>
+
+#if defined(__linux__)
+#  define PVA_REACTOR_EPOLL
+#  include <sys/epoll.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#  define PVA_REACTOR_KQUEUE
+#  include <sys/types.h>
+#  include <sys/event.h>
+#  include <sys/time.h>
+#endif
+
+#if defined(PVA_REACTOR_EPOLL) || defined(PVA_REACTOR_KQUEUE)
+#  define PVA_REACTOR_POSIX
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <poll.h>
+#endif
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <osiSock.h>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+
+#include <pv/reftrack.h>
+
+#define epicsExportSharedSymbols
+#include <pv/ioReactor.h>
+#include <pv/logger.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+// max. events fetched by one wait
+const int MAX_EVENTS = 64;
+// key of the wakeup pipe
+const IOReactor::key_type WAKEUP_KEY = 0;
+}
+
+struct IOReactor::Worker : public epicsThreadRunable
+{
+    struct Entry {
+        SOCKET sock;
+        std::tr1::shared_ptr<Handler> handler;
+        bool writePending;
+        bool readPending;
+        // waiting for writability, see waitWritable()
+        bool writeArmed;
+    };
+    typedef std::map<key_type, Entry> entries_t;
+
+    epicsMutex mutex;
+    entries_t entries;
+    std::vector<key_type> pendingWrite;
+    std::vector<key_type> pendingRead;
+    // key of callback now in progress, or WAKEUP_KEY
+    key_type dispatching;
+    unsigned syncWaiters;
+    bool stopping;
+    epicsEvent dispatchDone;
+
+    int evfd;
+    int wakeup[2];
+
+    epicsThread thread;
+
+    Worker(const std::string& name)
+        :dispatching(WAKEUP_KEY)
+        ,syncWaiters(0u)
+        ,stopping(false)
+        ,evfd(-1)
+        ,thread(*this, name.c_str(),
+                epicsThreadGetStackSize(epicsThreadStackBig),
+                epicsThreadPriorityCAServerLow)
+    {
+        wakeup[0] = wakeup[1] = -1;
+#ifdef PVA_REACTOR_POSIX
+        if(::pipe(wakeup)!=0)
+            throw std::runtime_error("IOReactor unable to create wakeup pipe");
+        for(unsigned i=0; i<2; i++) {
+            int flags = ::fcntl(wakeup[i], F_GETFL, 0);
+            ::fcntl(wakeup[i], F_SETFL, flags|O_NONBLOCK);
+            ::fcntl(wakeup[i], F_SETFD, FD_CLOEXEC);
+        }
+#endif
+#if defined(PVA_REACTOR_EPOLL)
+        evfd = ::epoll_create(MAX_EVENTS);
+#elif defined(PVA_REACTOR_KQUEUE)
+        evfd = ::kqueue();
+#endif
+        if(evfd<0) {
+            cleanup();
+            throw std::runtime_error("IOReactor unable to create poll descriptor");
+        }
+#ifdef PVA_REACTOR_POSIX
+        ::fcntl(evfd, F_SETFD, FD_CLOEXEC);
+#endif
+        if(!watch(wakeup[0], WAKEUP_KEY)) {
+            cleanup();
+            throw std::runtime_error("IOReactor unable to watch wakeup pipe");
+        }
+        REFTRACE_INCREMENT(IOReactor::num_workers);
+    }
+
+    virtual ~Worker()
+    {
+        cleanup();
+        REFTRACE_DECREMENT(IOReactor::num_workers);
+    }
+
+    void cleanup()
+    {
+#ifdef PVA_REACTOR_POSIX
+        if(evfd>=0)
+            ::close(evfd);
+        for(unsigned i=0; i<2; i++)
+            if(wakeup[i]>=0)
+                ::close(wakeup[i]);
+#endif
+        evfd = wakeup[0] = wakeup[1] = -1;
+    }
+
+    void wake()
+    {
+#ifdef PVA_REACTOR_POSIX
+        char b = 0;
+        // pipe is non-blocking.  If it is full, then a wakeup is already pending.
+        (void)::write(wakeup[1], &b, 1);
+#endif
+    }
+
+    void drainWakeup()
+    {
+#ifdef PVA_REACTOR_POSIX
+        char buf[64];
+        while(::read(wakeup[0], buf, sizeof(buf))>0) {}
+#endif
+    }
+
+    bool watch(int fd, key_type key)
+    {
+#if defined(PVA_REACTOR_EPOLL)
+        epoll_event evt;
+        evt.events = EPOLLIN;
+        evt.data.u64 = key;
+        return ::epoll_ctl(evfd, EPOLL_CTL_ADD, fd, &evt)==0;
+#elif defined(PVA_REACTOR_KQUEUE)
+        struct kevent evt;
+        EV_SET(&evt, fd, EVFILT_READ, EV_ADD, 0, 0, (void*)(uintptr_t)key);
+        return ::kevent(evfd, &evt, 1, NULL, 0, NULL)==0;
+#else
+        return false;
+#endif
+    }
+
+    // also watch for writability, until reported once.  call with mutex locked
+    bool armWrite(int fd, key_type key)
+    {
+#if defined(PVA_REACTOR_EPOLL)
+        epoll_event evt;
+        evt.events = EPOLLIN|EPOLLOUT;
+        evt.data.u64 = key;
+        return ::epoll_ctl(evfd, EPOLL_CTL_MOD, fd, &evt)==0;
+#elif defined(PVA_REACTOR_KQUEUE)
+        struct kevent evt;
+        EV_SET(&evt, fd, EVFILT_WRITE, EV_ADD|EV_ONESHOT, 0, 0, (void*)(uintptr_t)key);
+        return ::kevent(evfd, &evt, 1, NULL, 0, NULL)==0;
+#else
+        return false;
+#endif
+    }
+
+    // undo armWrite().  call with mutex locked
+    void disarmWrite(int fd, key_type key)
+    {
+#if defined(PVA_REACTOR_EPOLL)
+        epoll_event evt;
+        evt.events = EPOLLIN;
+        evt.data.u64 = key;
+        (void)::epoll_ctl(evfd, EPOLL_CTL_MOD, fd, &evt);
+#elif defined(PVA_REACTOR_KQUEUE)
+        // EV_ONESHOT, already removed when reported
+        (void)fd;
+        (void)key;
+#endif
+    }
+
+    void unwatch(int fd, bool armed)
+    {
+#if defined(PVA_REACTOR_EPOLL)
+        (void)armed;
+        epoll_event evt; // ignored, but must be non-NULL for old kernels
+        (void)::epoll_ctl(evfd, EPOLL_CTL_DEL, fd, &evt);
+#elif defined(PVA_REACTOR_KQUEUE)
+        struct kevent evt;
+        EV_SET(&evt, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+        (void)::kevent(evfd, &evt, 1, NULL, 0, NULL);
+        if(armed) {
+            EV_SET(&evt, fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+            (void)::kevent(evfd, &evt, 1, NULL, 0, NULL);
+        }
+#else
+        (void)fd;
+        (void)armed;
+#endif
+    }
+
+    struct Ready {
+        key_type key;
+        // readable, or error or hangup
+        bool read;
+        // writable, after armWrite()
+        bool write;
+    };
+
+    // fills ready[] with the keys of ready sockets
+    int waitReady(Ready *ready, int max)
+    {
+#if defined(PVA_REACTOR_EPOLL)
+        epoll_event evts[MAX_EVENTS];
+        int n = ::epoll_wait(evfd, evts, std::min(max, MAX_EVENTS), -1);
+        for(int i=0; i<n; i++) {
+            ready[i].key = evts[i].data.u64;
+            ready[i].read = evts[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP);
+            ready[i].write = evts[i].events & EPOLLOUT;
+        }
+        return n;
+#elif defined(PVA_REACTOR_KQUEUE)
+        struct kevent evts[MAX_EVENTS];
+        int n = ::kevent(evfd, NULL, 0, evts, std::min(max, MAX_EVENTS), NULL);
+        for(int i=0; i<n; i++) {
+            ready[i].key = (key_type)(uintptr_t)evts[i].udata;
+            ready[i].read = evts[i].filter==EVFILT_READ;
+            ready[i].write = evts[i].filter==EVFILT_WRITE;
+        }
+        return n;
+#else
+        return -1;
+#endif
+    }
+
+    // call with mutex locked
+    void dispatchComplete()
+    {
+        dispatching = WAKEUP_KEY;
+        if(syncWaiters)
+            dispatchDone.signal();
+    }
+
+    // writable is true when write readiness was reported, rather than scheduleWrite()
+    void dispatch(key_type key, bool read, bool writable = false)
+    {
+        std::tr1::shared_ptr<Handler> handler;
+        {
+            Guard G(mutex);
+            entries_t::iterator it(entries.find(key));
+            if(it==entries.end())
+                return; // remove()'d since readiness reported
+            if(read) {
+                it->second.readPending = false;
+            } else if(writable) {
+                if(!it->second.writeArmed)
+                    return; // already reported
+                it->second.writeArmed = false;
+                disarmWrite(it->second.sock, key);
+            } else {
+                it->second.writePending = false;
+            }
+            handler = it->second.handler;
+            dispatching = key;
+        }
+
+        try {
+            if(read)
+                handler->readReady();
+            else
+                handler->writeReady();
+        } catch(std::exception& e) {
+            LOG(logLevelError, "Unhandled exception from IOReactor callback: %s", e.what());
+        } catch(...) {
+            LOG(logLevelError, "Unhandled exception from IOReactor callback.");
+        }
+
+        // may be the last reference
+        handler.reset();
+
+        Guard G(mutex);
+        dispatchComplete();
+    }
+
+    virtual void run()
+    {
+        Ready ready[MAX_EVENTS];
+        std::vector<key_type> writes, reads;
+
+        while(true) {
+            int n = waitReady(ready, MAX_EVENTS);
+            if(n<0) {
+                if(errno==EINTR)
+                    continue;
+                LOG(logLevelError, "IOReactor wait error %d, worker exits", errno);
+                break;
+            }
+
+            for(int i=0; i<n; i++) {
+                if(ready[i].key==WAKEUP_KEY) {
+                    drainWakeup();
+                    continue;
+                }
+                if(ready[i].write)
+                    dispatch(ready[i].key, false, true);
+                if(ready[i].read)
+                    dispatch(ready[i].key, true);
+            }
+
+            {
+                Guard G(mutex);
+                if(stopping)
+                    break;
+                writes.swap(pendingWrite);
+                reads.swap(pendingRead);
+            }
+
+            for(size_t i=0, N=writes.size(); i<N; i++)
+                dispatch(writes[i], false);
+            writes.clear();
+            // after all sockets found ready have had a turn
+            for(size_t i=0, N=reads.size(); i<N; i++)
+                dispatch(reads[i], true);
+            reads.clear();
+        }
+    }
+};
+
+size_t IOReactor::num_instances;
+size_t IOReactor::num_workers;
+
+IOReactor::IOReactor()
+    :nextKey(WAKEUP_KEY)
+    ,closed(false)
+{
+    REFTRACE_INCREMENT(num_instances);
+}
+
+IOReactor::~IOReactor()
+{
+    close();
+    REFTRACE_DECREMENT(num_instances);
+}
+
+bool IOReactor::isSupported()
+{
+#if defined(PVA_REACTOR_EPOLL) || defined(PVA_REACTOR_KQUEUE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+IOReactor::shared_pointer IOReactor::create(const std::string& name, unsigned nthreads)
+{
+    shared_pointer ret;
+    if(!isSupported()) {
+        LOG(logLevelWarn, "IOReactor not supported on this target, using blocking I/O");
+        return ret;
+    }
+
+    if(nthreads==0u)
+        nthreads = 1u;
+
+    ret.reset(new IOReactor);
+    ret->workers.reserve(nthreads);
+    for(unsigned i=0; i<nthreads; i++) {
+        std::ostringstream strm;
+        strm<<name<<"-"<<i;
+        std::tr1::shared_ptr<Worker> W(new Worker(strm.str()));
+        ret->workers.push_back(W);
+    }
+    for(unsigned i=0; i<nthreads; i++)
+        ret->workers[i]->thread.start();
+
+    return ret;
+}
+
+IOReactor::Worker& IOReactor::workerFor(key_type key) const
+{
+    return *workers[key%workers.size()];
+}
+
+void IOReactor::add(SOCKET sock, const std::tr1::shared_ptr<Handler>& handler, key_type *key)
+{
+    {
+        Guard G(mutex);
+        if(closed)
+            throw std::logic_error("IOReactor closed");
+        if(++nextKey==WAKEUP_KEY)
+            ++nextKey;
+        *key = nextKey;
+    }
+
+    Worker& W = workerFor(*key);
+
+    Guard G(W.mutex);
+    Worker::Entry& ent = W.entries[*key];
+    ent.sock = sock;
+    ent.handler = handler;
+    ent.writePending = false;
+    ent.readPending = false;
+    ent.writeArmed = false;
+
+    if(!W.watch(sock, *key)) {
+        W.entries.erase(*key);
+        throw std::runtime_error("IOReactor unable to watch socket");
+    }
+}
+
+void IOReactor::remove(key_type key)
+{
+    if(key==WAKEUP_KEY)
+        return;
+
+    Worker& W = workerFor(key);
+
+    std::tr1::shared_ptr<Handler> handler;
+    {
+        Guard G(W.mutex);
+        Worker::entries_t::iterator it(W.entries.find(key));
+        if(it==W.entries.end())
+            return;
+        W.unwatch(it->second.sock, it->second.writeArmed);
+        handler.swap(it->second.handler);
+        W.entries.erase(it);
+    }
+    // handler released w/o lock
+}
+
+void IOReactor::scheduleWrite(key_type key)
+{
+    if(key==WAKEUP_KEY)
+        return;
+
+    Worker& W = workerFor(key);
+    bool wake;
+    {
+        Guard G(W.mutex);
+        Worker::entries_t::iterator it(W.entries.find(key));
+        if(it==W.entries.end() || it->second.writePending)
+            return;
+        it->second.writePending = true;
+        wake = W.pendingWrite.empty();
+        W.pendingWrite.push_back(key);
+    }
+    if(wake)
+        W.wake();
+}
+
+void IOReactor::scheduleRead(key_type key)
+{
+    if(key==WAKEUP_KEY)
+        return;
+
+    Worker& W = workerFor(key);
+    bool wake;
+    {
+        Guard G(W.mutex);
+        Worker::entries_t::iterator it(W.entries.find(key));
+        if(it==W.entries.end() || it->second.readPending)
+            return;
+        it->second.readPending = true;
+        wake = W.pendingRead.empty() && W.pendingWrite.empty();
+        W.pendingRead.push_back(key);
+    }
+    if(wake)
+        W.wake();
+}
+
+void IOReactor::waitWritable(key_type key)
+{
+    if(key==WAKEUP_KEY)
+        return;
+
+    Worker& W = workerFor(key);
+    Guard G(W.mutex);
+    Worker::entries_t::iterator it(W.entries.find(key));
+    if(it==W.entries.end() || it->second.writeArmed)
+        return;
+    if(!W.armWrite(it->second.sock, key))
+        throw std::runtime_error("IOReactor unable to watch socket for writability");
+    it->second.writeArmed = true;
+}
+
+void IOReactor::sync(key_type key)
+{
+    if(key==WAKEUP_KEY)
+        return;
+
+    Worker& W = workerFor(key);
+    if(W.thread.isCurrentThread())
+        return;
+
+    Guard G(W.mutex);
+    while(W.dispatching==key) {
+        W.syncWaiters++;
+        {
+            UnGuard U(G);
+            W.dispatchDone.wait();
+        }
+        W.syncWaiters--;
+    }
+    if(W.syncWaiters)
+        W.dispatchDone.signal(); // pass along to another waiter
+}
+
+void IOReactor::close()
+{
+    {
+        Guard G(mutex);
+        if(closed)
+            return;
+        closed = true;
+    }
+
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        Worker& W = *workers[i];
+        {
+            Guard G(W.mutex);
+            W.stopping = true;
+        }
+        W.wake();
+    }
+
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        Worker& W = *workers[i];
+        W.thread.exitWait();
+
+        Worker::entries_t temp;
+        {
+            Guard G(W.mutex);
+            temp.swap(W.entries);
+        }
+        if(!temp.empty())
+            LOG(logLevelWarn, "IOReactor closed with %zu socket(s) still watched", temp.size());
+        // handlers released w/o lock
+    }
+}
+
+bool IOReactor::isWorkerThread() const
+{
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        if(workers[i]->thread.isCurrentThread())
+            return true;
+    }
+    return false;
+}
+
+size_t IOReactor::size() const
+{
+    size_t ret = 0u;
+    for(size_t i=0, N=workers.size(); i<N; i++) {
+        Worker& W = *workers[i];
+        Guard G(W.mutex);
+        ret += W.entries.size();
+    }
+    return ret;
+}
+
+int IOReactor::waitFor(SOCKET sock, bool forWrite, double timeout)
+{
+    int tmo = timeout<0.0 ? -1 : int(timeout*1000.0);
+#ifdef PVA_REACTOR_POSIX
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = forWrite ? POLLOUT : POLLIN;
+    pfd.revents = 0;
+    int ret;
+    do {
+        ret = ::poll(&pfd, 1, tmo);
+    } while(ret<0 && errno==EINTR);
+    if(ret>0)
+        return 1;
+    return ret;
+#else
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    struct timeval tv;
+    tv.tv_sec = tmo/1000;
+    tv.tv_usec = (tmo%1000)*1000;
+    int ret = ::select(int(sock)+1, forWrite ? NULL : &fds, forWrite ? &fds : NULL, NULL, tmo<0 ? NULL : &tv);
+    if(ret>0)
+        return 1;
+    return ret;
+#endif
+}
+
+}
+}
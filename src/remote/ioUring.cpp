@@ -0,0 +1,397 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <string.h>
+#include <errno.h>
+
+#include <epicsThread.h>
+
+#if defined(__linux__)
+#  include <sys/syscall.h>
+#  if defined(__has_include)
+#    if __has_include(<linux/io_uring.h>)
+#      include <linux/io_uring.h>
+#    endif
+#  endif
+#endif
+
+// IORING_RECVSEND_FIXED_BUF came with IORING_OP_SEND_ZC, in 6.0
+#if defined(IORING_RECVSEND_FIXED_BUF) && defined(__NR_io_uring_setup)
+#  define PVA_HAVE_IO_URING
+#  include <sys/mman.h>
+#  include <sys/socket.h>
+#  include <sys/uio.h>
+#  include <unistd.h>
+#endif
+
+#define epicsExportSharedSymbols
+#include <pv/ioUring.h>
+#include <pv/logger.h>
+
+namespace epics {
+namespace pvAccess {
+
+#ifdef PVA_HAVE_IO_URING
+
+namespace {
+
+int uringSetup(unsigned entries, io_uring_params *params)
+{
+    return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return int(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0));
+}
+
+int uringRegister(int fd, unsigned opcode, void *arg, unsigned nargs)
+{
+    return int(syscall(__NR_io_uring_register, fd, opcode, arg, nargs));
+}
+
+// only one operation, and its notification, are ever in flight
+const unsigned ENTRIES = 4u;
+
+epicsThreadOnceId probeOnce = EPICS_THREAD_ONCE_INIT;
+// operations supported by the running kernel, from IORING_REGISTER_PROBE
+bool opSupported[IORING_OP_LAST];
+bool supported;
+
+void probeKernel(void *)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = uringSetup(2u, &params);
+    if(fd<0) {
+        LOG(logLevelDebug, "io_uring not available: %d", errno);
+        return;
+    }
+
+    const size_t nops = IORING_OP_LAST;
+    std::vector<char> mem(sizeof(io_uring_probe) + nops*sizeof(io_uring_probe_op), 0);
+    io_uring_probe *probe = (io_uring_probe*)&mem[0];
+    if(uringRegister(fd, IORING_REGISTER_PROBE, probe, unsigned(nops))==0) {
+        for(size_t i=0; i<nops && i<=probe->last_op; i++)
+            opSupported[i] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED)!=0;
+    }
+    ::close(fd);
+
+    supported = (params.features & IORING_FEAT_NODROP)
+            && opSupported[IORING_OP_RECV] && opSupported[IORING_OP_SEND]
+            && opSupported[IORING_OP_SENDMSG];
+}
+
+} // namespace
+
+struct IOUring::Queue {
+    int fd;
+    void *sqMap, *cqMap;
+    size_t sqMapSize, cqMapSize;
+    io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqTail, *sqMask;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_cqe *cqes;
+
+    Queue()
+        :fd(-1)
+        ,sqMap(MAP_FAILED), cqMap(MAP_FAILED)
+        ,sqMapSize(0u), cqMapSize(0u)
+        ,sqes((io_uring_sqe*)MAP_FAILED)
+        ,sqesSize(0u)
+    {}
+    ~Queue()
+    {
+        if(sqes!=MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if(cqMap!=MAP_FAILED && cqMap!=sqMap)
+            munmap(cqMap, cqMapSize);
+        if(sqMap!=MAP_FAILED)
+            munmap(sqMap, sqMapSize);
+        if(fd>=0)
+            ::close(fd);
+    }
+
+    bool setup()
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = uringSetup(ENTRIES, &params);
+        if(fd<0)
+            return false;
+
+        sqMapSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+        cqMapSize = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+        if(params.features & IORING_FEAT_SINGLE_MMAP)
+            sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+
+        sqMap = mmap(0, sqMapSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if(sqMap==MAP_FAILED)
+            return false;
+        if(params.features & IORING_FEAT_SINGLE_MMAP) {
+            cqMap = sqMap;
+        } else {
+            cqMap = mmap(0, cqMapSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if(cqMap==MAP_FAILED)
+                return false;
+        }
+        sqesSize = params.sq_entries*sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mmap(0, sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+        if(sqes==MAP_FAILED)
+            return false;
+
+        char *sq = (char*)sqMap, *cq = (char*)cqMap;
+        sqTail = (unsigned*)(sq + params.sq_off.tail);
+        sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+        cqHead = (unsigned*)(cq + params.cq_off.head);
+        cqTail = (unsigned*)(cq + params.cq_off.tail);
+        cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+        // entry i of the ring is always sqes[i]
+        unsigned *sqArray = (unsigned*)(sq + params.sq_off.array);
+        for(unsigned i=0; i<params.sq_entries; i++)
+            sqArray[i] = i;
+        return true;
+    }
+
+    // the entry which submit() will pass to the kernel
+    io_uring_sqe* next()
+    {
+        io_uring_sqe *sqe = &sqes[*sqTail & *sqMask];
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    void submit()
+    {
+        // only this thread writes the tail
+        __atomic_store_n(sqTail, *sqTail + 1u, __ATOMIC_RELEASE);
+    }
+
+    bool reap(io_uring_cqe& cqe)
+    {
+        unsigned head = *cqHead;
+        if(head==__atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+            return false;
+        cqe = cqes[head & *cqMask];
+        __atomic_store_n(cqHead, head + 1u, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+bool IOUring::isSupported()
+{
+    epicsThreadOnce(&probeOnce, &probeKernel, 0);
+    return supported;
+}
+
+bool IOUring::zeroCopySupported()
+{
+    return isSupported() && opSupported[IORING_OP_SEND_ZC];
+}
+
+IOUring::IOUring()
+    :queue(new Queue)
+    ,sock(INVALID_SOCKET)
+    ,fixedBuf(0)
+    ,fixedLen(0u)
+    ,zeroCopyMin(0u)
+    ,numZeroCopy(0u)
+    ,pending(0)
+{}
+
+IOUring::~IOUring()
+{
+    delete queue;
+}
+
+IOUring::shared_pointer IOUring::create(SOCKET sock)
+{
+    shared_pointer ret;
+    if(!isSupported())
+        return ret;
+
+    ret.reset(new IOUring);
+    if(!ret->queue->setup()) {
+        LOG(logLevelDebug, "Unable to create io_uring: %d", errno);
+        ret.reset();
+        return ret;
+    }
+    ret->sock = sock;
+    return ret;
+}
+
+bool IOUring::registerBuffer(char *buf, std::size_t len)
+{
+    if(fixedBuf) {
+        (void)uringRegister(queue->fd, IORING_UNREGISTER_BUFFERS, NULL, 0u);
+        fixedBuf = 0;
+        fixedLen = 0u;
+    }
+    iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    // pinned pages count against RLIMIT_MEMLOCK
+    if(uringRegister(queue->fd, IORING_REGISTER_BUFFERS, &iov, 1u)!=0) {
+        LOG(logLevelDebug, "Unable to register io_uring buffer of %zu bytes: %d", len, errno);
+        return false;
+    }
+    fixedBuf = buf;
+    fixedLen = len;
+    return true;
+}
+
+int IOUring::submitAndWait(bool zeroCopy)
+{
+    Queue& Q = *queue;
+    Q.submit();
+
+    if(zeroCopy)
+        __atomic_store_n(&pending, 1, __ATOMIC_RELEASE);
+
+    unsigned toSubmit = 1u;
+    bool done = false, more = false;
+    int res = 0;
+    while(!done || more) {
+        io_uring_cqe cqe;
+        if(!Q.reap(cqe)) {
+            // returns the number submitted, if any, even when the wait is interrupted
+            int ret = uringEnter(Q.fd, toSubmit, 1u, IORING_ENTER_GETEVENTS);
+            if(ret<0) {
+                if(errno==EINTR)
+                    continue;
+                if(toSubmit) {
+                    // never submitted, so nothing will complete
+                    __atomic_store_n(&pending, 0, __ATOMIC_RELEASE);
+                    return -1;
+                }
+                // the operation still references the buffer, so wait again
+                LOG(logLevelError, "io_uring wait error %d", errno);
+                epicsThreadSleep(0.1);
+                continue;
+            }
+            toSubmit = 0u;
+            continue;
+        }
+
+        if(cqe.flags & IORING_CQE_F_NOTIF) {
+            // the kernel no longer references the pages sent
+            more = false;
+        } else {
+            res = cqe.res;
+            done = true;
+            // a notification follows
+            more = (cqe.flags & IORING_CQE_F_MORE)!=0;
+        }
+    }
+
+    if(zeroCopy)
+        __atomic_store_n(&pending, 0, __ATOMIC_RELEASE);
+
+    if(res<0) {
+        errno = -res;
+        return -1;
+    }
+    return res;
+}
+
+int IOUring::recv(char *buf, std::size_t count)
+{
+    count = std::min(count, std::size_t(std::numeric_limits<int>::max()));
+
+    io_uring_sqe *sqe = queue->next();
+    sqe->fd = sock;
+    sqe->addr = (__u64)(uintptr_t)buf;
+    sqe->len = unsigned(count);
+    if(fixedBuf && buf>=fixedBuf && buf+count<=fixedBuf+fixedLen && opSupported[IORING_OP_READ_FIXED]) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->buf_index = 0u;
+    } else {
+        sqe->opcode = IORING_OP_RECV;
+    }
+    return submitAndWait(false);
+}
+
+int IOUring::send(const char *buf, std::size_t count)
+{
+    count = std::min(count, std::size_t(std::numeric_limits<int>::max()));
+    const bool zeroCopy = zeroCopyMin && count>=zeroCopyMin && opSupported[IORING_OP_SEND_ZC];
+
+    io_uring_sqe *sqe = queue->next();
+    sqe->opcode = zeroCopy ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+    sqe->fd = sock;
+    sqe->addr = (__u64)(uintptr_t)buf;
+    sqe->len = unsigned(count);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    if(zeroCopy && fixedBuf && buf>=fixedBuf && buf+count<=fixedBuf+fixedLen) {
+        sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = 0u;
+    }
+
+    int ret = submitAndWait(zeroCopy);
+    if(zeroCopy && ret>0)
+        numZeroCopy++;
+    return ret;
+}
+
+int IOUring::sendv(const struct iovec *iov, std::size_t count)
+{
+    std::size_t total = 0u;
+    for(std::size_t i=0; i<count; i++)
+        total += iov[i].iov_len;
+    const bool zeroCopy = zeroCopyMin && total>=zeroCopyMin && opSupported[IORING_OP_SENDMSG_ZC];
+
+    // referenced until submitted
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = const_cast<iovec*>(iov);
+    msg.msg_iovlen = count;
+
+    io_uring_sqe *sqe = queue->next();
+    sqe->opcode = zeroCopy ? IORING_OP_SENDMSG_ZC : IORING_OP_SENDMSG;
+    sqe->fd = sock;
+    sqe->addr = (__u64)(uintptr_t)&msg;
+    sqe->len = 1u;
+    sqe->msg_flags = MSG_NOSIGNAL;
+
+    int ret = submitAndWait(zeroCopy);
+    if(zeroCopy && ret>0)
+        numZeroCopy++;
+    return ret;
+}
+
+bool IOUring::zeroCopyPending() const
+{
+    return __atomic_load_n(&pending, __ATOMIC_ACQUIRE)!=0;
+}
+
+#else // !PVA_HAVE_IO_URING
+
+struct IOUring::Queue {};
+
+bool IOUring::isSupported() { return false; }
+bool IOUring::zeroCopySupported() { return false; }
+IOUring::shared_pointer IOUring::create(SOCKET) { return shared_pointer(); }
+
+IOUring::IOUring() :queue(0), sock(INVALID_SOCKET), fixedBuf(0), fixedLen(0u), zeroCopyMin(0u), numZeroCopy(0u), pending(0) {}
+IOUring::~IOUring() {}
+bool IOUring::registerBuffer(char *, std::size_t) { return false; }
+int IOUring::submitAndWait(bool) { return -1; }
+int IOUring::recv(char *, std::size_t) { return -1; }
+int IOUring::send(const char *, std::size_t) { return -1; }
+int IOUring::sendv(const struct iovec *, std::size_t) { return -1; }
+bool IOUring::zeroCopyPending() const { return false; }
+
+#endif // PVA_HAVE_IO_URING
+
+}
+}
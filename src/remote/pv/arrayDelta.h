@@ -0,0 +1,127 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef ARRAYDELTA_H
+#define ARRAYDELTA_H
+
+#include <map>
+#include <vector>
+#include <utility>
+
+#ifdef epicsExportSharedSymbols
+#   define arrayDeltaEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+#ifdef arrayDeltaEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef arrayDeltaEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Sends the changed numeric arrays of monitor updates as the ranges which differ.
+ *
+ * Requested with record[arrayDelta=true].  A server which does not know this option
+ * ignores it, and an update encoded so is flagged with QOS_DELTA, so a client which
+ * didn't ask never sees one.
+ *
+ * An update with QOS_DELTA is
+ *
+ * - the changed BitSet
+ * - the BitSet of fields sent as deltas
+ * - the data of the changed fields other than the deltas, see deltaDataBits()
+ * - for each delta, its new length, the number of ranges, and each range as an offset
+ *   followed by the elements as a serialized array
+ * - the overrun BitSet
+ *
+ * The ranges are relative to the value previously sent, which the client holds as
+ * the latest update of the subscription.  An array is sent whole when the ranges would
+ * not be less than half its size, or the first time.
+ *
+ * One encoder per subscription.  The values kept are references to the arrays sent,
+ * which are not modified in place by pvData, so cost no copy.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass ArrayDeltaEncoder
+{
+public:
+    ArrayDeltaEncoder();
+    ~ArrayDeltaEncoder();
+
+    /** Find which of the changed arrays of value to send as deltas.
+     * @returns true if the update is to be sent with QOS_DELTA
+     */
+    bool prepare(const epics::pvData::PVStructure& value, const epics::pvData::BitSet& changed);
+
+    /** Serialize an update, after prepare().  As a delta if prepare() returned true,
+     * otherwise as changed, data, and overrun.  Either way keeps the arrays sent.
+     */
+    void serialize(epics::pvData::ByteBuffer *buffer,
+                   epics::pvData::SerializableControl *control,
+                   const epics::pvData::PVStructure& value,
+                   const epics::pvData::BitSet& changed,
+                   const epics::pvData::BitSet& overrun);
+
+    //! Forget the values sent, eg. when the subscription restarts
+    void clear();
+
+    //! arrays of fewer bytes than this are always sent whole
+    static const size_t minBytes = 64u;
+
+private:
+    ArrayDeltaEncoder(const ArrayDeltaEncoder&);
+    ArrayDeltaEncoder& operator=(const ArrayDeltaEncoder&);
+
+    void find(const epics::pvData::PVField& field, const epics::pvData::BitSet& changed, bool parentChanged);
+    void remember(const epics::pvData::PVField& field, const epics::pvData::BitSet& changed, bool parentChanged);
+
+    // element offset and count
+    typedef std::vector<std::pair<size_t, size_t> > ranges_t;
+
+    // by field offset, the arrays last sent
+    typedef std::map<size_t, epics::pvData::shared_vector<const void> > last_t;
+    last_t last;
+
+    // of the update being sent
+    epics::pvData::BitSet deltas, data;
+    std::map<size_t, ranges_t> ranges;
+};
+
+/** The fields of an update with QOS_DELTA which are serialized as data.
+ * changed, less the fields of deltas.  A set bit of a structure containing a delta
+ * is replaced by those of its other fields.
+ */
+epicsShareFunc
+void deltaDataBits(const epics::pvData::PVStructure& value,
+                   const epics::pvData::BitSet& changed,
+                   const epics::pvData::BitSet& deltas,
+                   epics::pvData::BitSet& data);
+
+/** Read the ranges of the deltas of an update, and replace each array of value
+ * with that of previous patched by them.  previous may be value itself.
+ * @throws std::runtime_error if a delta is not of a numeric array, or a range out of bounds
+ */
+epicsShareFunc
+void deserializeDeltas(epics::pvData::ByteBuffer *buffer,
+                       epics::pvData::DeserializableControl *control,
+                       const epics::pvData::BitSet& deltas,
+                       epics::pvData::PVStructure& value,
+                       const epics::pvData::PVStructure& previous);
+
+}
+}
+
+#endif // ARRAYDELTA_H
@@ -12,6 +12,8 @@
 #   undef epicsExportSharedSymbols
 #endif
 
+#include <vector>
+
 #include <osiSock.h>
 
 #include <pv/timeStamp.h>
@@ -25,14 +27,35 @@
 #include <pv/pvaDefs.h>
 #include <pv/remote.h>
 #include <pv/pvAccess.h>
+#include <pv/metrics.h>
+
+#include <shareLib.h>
 
 namespace epics {
 namespace pvAccess {
 
+/**
+ * Beacons received from all servers which were not as expected.
+ * Counted without locking.
+ */
+struct BeaconStats
+{
+    //! Beacons of a known server with nothing changed
+    MetricCounter unchanged;
+    //! First beacon of a server, or of a new GUID from the same address
+    MetricCounter restarts;
+    //! Change count changed, as when a server adds channels
+    MetricCounter changes;
+    //! Sequence skipped ahead, as when beacons are lost
+    MetricCounter gaps;
+    //! Sequence not advanced, as when one beacon arrives on more than one interface
+    MetricCounter repeats;
+};
+
 /**
  * BeaconHandler
  */
-class BeaconHandler
+class epicsShareClass BeaconHandler
 {
 public:
     POINTER_DEFINITIONS(BeaconHandler);
@@ -41,7 +64,8 @@ public:
      * Constructor.
      */
     BeaconHandler(Context::shared_pointer const & context,
-                  const osiSockAddr* responseFrom);
+                  const osiSockAddr* responseFrom,
+                  BeaconStats* stats = 0);
 
     virtual ~BeaconHandler();
 
@@ -61,7 +85,31 @@ public:
                       epics::pvData::int16 sequentalID,
                       epics::pvData::int16 changeCount,
                       epics::pvData::PVFieldPtr data);
+
+    /**
+     * Load advertised in beacon status data.
+     * @param data server status data, can be <code>NULL</code>.
+     * @return false if data has no connections, cpu, or queueDepth field.
+     */
+    static bool decodeLoad(const epics::pvData::PVFieldPtr& data, ServerLoad& load);
+
+    const osiSockAddr& getAddress() const { return _responseFrom; }
 private:
+    enum { STATE_WORDS = 4, STATE_KNOWN = 0x10000 };
+
+    /**
+     * True if guid and changeCount are those of the last beacon.  Does not lock, where Base has epicsAtomic.
+     */
+    bool unchanged(ServerGUID const &guid, epics::pvData::int16 changeCount) const;
+    /**
+     * Copy _serverGUID and _serverChangeCount to _state.  Call with _mutex held.
+     */
+    void publish();
+    /**
+     * Count a gap or a repeat of the sequence.
+     */
+    void checkSequence(epics::pvData::int16 sequentalID);
+
     /**
      * Context instance.
      */
@@ -73,7 +121,7 @@ private:
     /**
      * Mutex
      */
-    epics::pvData::Mutex _mutex;
+    mutable epics::pvData::Mutex _mutex;
     /**
      * Server GUID.
      */
@@ -86,6 +134,17 @@ private:
      * First beacon flag.
      */
     bool _first;
+    /**
+     * GUID and change count (with STATE_KNOWN), as read by unchanged() without locking.
+     * Written by publish() while _version is odd.
+     */
+    int _state[STATE_WORDS];
+    int _version;
+    /**
+     * Sequential ID of the last beacon, or -1.
+     */
+    int _sequence;
+    BeaconStats * const _stats;
 
     /**
      * Update beacon.
@@ -107,6 +166,39 @@ private:
     void changedTransport();
 };
 
+/**
+ * BeaconHandler of each server address, hashed by address and port.
+ */
+class epicsShareClass BeaconHandlerTable
+{
+public:
+    BeaconHandlerTable();
+    ~BeaconHandlerTable();
+
+    /**
+     * Get (and if necessary create) the handler of responseFrom.
+     */
+    BeaconHandler::shared_pointer get(Context::shared_pointer const & context,
+                                      const osiSockAddr& responseFrom);
+    void clear();
+    size_t size() const;
+
+    //! Of all handlers in this table
+    const BeaconStats& getStats() const { return _stats; }
+
+private:
+    static size_t hash(const osiSockAddr& address);
+
+    mutable epics::pvData::Mutex _mutex;
+    // size is a power of two
+    std::vector<std::vector<BeaconHandler::shared_pointer> > _buckets;
+    size_t _count;
+    BeaconStats _stats;
+
+    BeaconHandlerTable(const BeaconHandlerTable&);
+    BeaconHandlerTable& operator=(const BeaconHandlerTable&);
+};
+
 }
 }
 
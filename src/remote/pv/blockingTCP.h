@@ -10,6 +10,7 @@
 #include <set>
 #include <map>
 #include <deque>
+#include <vector>
 
 #ifdef epicsExportSharedSymbols
 #   define blockingTCPEpicsExportSharedSymbols
@@ -37,6 +38,8 @@
 #include <pv/transportRegistry.h>
 #include <pv/introspectionRegistry.h>
 #include <pv/inetAddressUtil.h>
+#include <pv/tls.h>
+#include <pv/metrics.h>
 
 namespace epics {
 namespace pvAccess {
@@ -79,6 +82,11 @@ private:
      */
     float _heartbeatInterval;
 
+    /**
+     * NULL unless connections are encrypted.
+     */
+    TLSContext::shared_pointer _tls;
+
     /**
      * Tries to connect to the given address.
      * @param[in] address
@@ -127,9 +135,35 @@ public:
      */
     void destroy();
 
+    //! Counters of connections accepted
+    struct Statistics {
+        //! connections admitted, for which a transport was created
+        MetricCounter accepted;
+        //! closed at once, as EPICS_PVAS_MAX_CONNECTIONS were open
+        MetricCounter rejectedLimit;
+        //! closed at once, as EPICS_PVAS_MAX_CONNECTIONS_PER_HOST were open from the same host
+        MetricCounter rejectedHost;
+        //! wakeups of the acceptor thread, each taking all connections waiting
+        MetricCounter batches;
+    };
+    const Statistics& getStatistics() const { return _stats; }
+
+    //! From EPICS_PVAS_LISTEN_BACKLOG, EPICS_PVAS_MAX_CONNECTIONS and EPICS_PVAS_MAX_CONNECTIONS_PER_HOST.  0 for no limit
+    int getListenBacklog() const { return _backlog; }
+    size_t getMaxConnections() const { return _maxConnections; }
+    size_t getMaxConnectionsPerHost() const { return _maxPerHost; }
+
 private:
     virtual void run();
 
+    struct Accepted {
+        SOCKET sock;
+        osiSockAddr address;
+    };
+    // apply the limits to a batch, and create transports for those admitted
+    void admit(std::vector<Accepted>& batch);
+    void createTransport(SOCKET newClient, const osiSockAddr& address);
+
     /**
      * Context instance.
      */
@@ -155,26 +189,33 @@ private:
      */
     int _receiveBufferSize;
 
+    /**
+     * NULL unless connections are encrypted.
+     */
+    TLSContext::shared_pointer _tls;
+
     /**
      * Destroyed flag.
      */
     bool _destroyed;
 
+    // limits, from the configuration
+    int _backlog;
+    size_t _maxConnections, _maxPerHost;
+    Statistics _stats;
+
     epics::pvData::Mutex _mutex;
 
     epicsThread _thread;
 
+    // read limits from the configuration of the context
+    void configure();
+
     /**
      * Initialize connection acception.
      * @return port where server is listening
      */
     int initialize();
-
-    /**
-     * Validate connection by sending a validation message request.
-     * @return <code>true</code> on success.
-     */
-    bool validateConnection(Transport::shared_pointer const & transport, const char* address);
 };
 
 }
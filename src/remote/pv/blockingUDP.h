@@ -274,6 +274,14 @@ public:
         return _sendAddresses;
     }
 
+    /**
+     * Get which of the send addresses are unicast.
+     * @return one flag for each of getSendAddresses().
+     */
+    const std::vector<bool>& getSendAddressUnicast() const {
+        return _isSendAddressUnicast;
+    }
+
     /**
      * Get bind address.
      * @return bind address.
@@ -300,6 +308,82 @@ public:
 
     void setMutlicastNIF(const osiSockAddr & nifAddr, bool loopback);
 
+    /**
+     * Only receive the traffic of groups joined through this socket (Linux IP_MULTICAST_ALL),
+     * not that of any group joined by any socket bound to the same port.
+     */
+    void setMulticastAll(bool all);
+
+    /**
+     * Only process one in count of the datagrams received, picked by a hash of their source and start.
+     * For each of count sockets receiving a copy of every datagram, as those bound to
+     * a broadcast or multicast address, so that each handles a different share.
+     * @param index of this one, less than count.
+     */
+    void setShard(unsigned index, unsigned count) {
+        _shardIndex = index;
+        _shardCount = count ? count : 1u;
+    }
+
+    /**
+     * Deliver unicast datagrams to the socket of the SO_REUSEPORT group of this one
+     * whose index is the receiving CPU modulo count (Linux SO_ATTACH_REUSEPORT_CBPF),
+     * instead of by a hash of their source.
+     * The program applies to the whole group, which includes the sockets of other
+     * processes of the same user bound to the same address and port, in the order bound.
+     * It replaces any program they attached.
+     */
+    void steerToShards(unsigned count);
+
+    /**
+     * Send to multicast send addresses once through each of these network interfaces,
+     * instead of once through the default route.
+     * @param nifAddresses interface addresses.
+     */
+    void setMulticastInterfaces(const InetAddrVector& nifAddresses) {
+        _multicastNIF = nifAddresses;
+    }
+
+    /** Defer unicast replies queued with enqueueSendRequest() until the matching releaseSend().
+     *
+     * Replies to the same recipient are packed into one datagram, up to MAX_UDP_UNFRAGMENTED_SEND,
+     * and all are sent with as few system calls as possible (sendmmsg() on Linux).
+     * Calls may nest, and may be made from any thread.
+     */
+    void holdSend();
+    void releaseSend();
+
+    //! holdSend() for the lifetime of this object
+    class SendHold {
+        BlockingUDPTransport * const transport;
+        SendHold(const SendHold&);
+        SendHold& operator=(const SendHold&);
+    public:
+        explicit SendHold(BlockingUDPTransport *transport) :transport(transport) {
+            if(transport) transport->holdSend();
+        }
+        ~SendHold() {
+            if(transport) transport->releaseSend();
+        }
+    };
+
+    //! Counters of one UDP socket
+    struct Statistics {
+        //! receive system calls made, and datagrams returned.  Several per call with recvmmsg() on Linux.
+        size_t recvCalls, datagramsReceived;
+        //! datagrams dropped by the kernel as the socket receive buffer was full.  Linux only.
+        size_t datagramsDropped;
+        //! send system calls made, and datagrams sent
+        size_t sendCalls, datagramsSent;
+        //! replies appended to a datagram already waiting for the same recipient
+        size_t repliesCoalesced;
+
+        Statistics();
+    };
+
+    //! Copy current values into out
+    void getStatistics(Statistics& out) const;
+
 protected:
     AtomicBoolean _closed;
 
@@ -315,6 +399,13 @@ private:
 
     void close(bool waitForThreadToComplete);
 
+    void processDatagram(Transport::shared_pointer const & transport, osiSockAddr& fromAddress, size_t bytesRead);
+
+    // called with _sendMutex held
+    void deferSend();
+    void sendPending();
+    void countSend(size_t datagrams);
+
     // Context only used for logging in this class
 
     /**
@@ -358,6 +449,12 @@ private:
      */
     InetAddrVector _tappedNIF;
 
+    /**
+     * Interfaces to send multicast through, each selected with IP_MULTICAST_IF.
+     */
+    InetAddrVector _multicastNIF;
+    epics::pvData::Mutex _multicastMutex;
+
     /**
      * Send address.
      */
@@ -389,7 +486,20 @@ private:
      * Used for process sync.
      */
     epics::pvData::Mutex _mutex;
-    epics::pvData::Mutex _sendMutex;
+    mutable epics::pvData::Mutex _sendMutex;
+
+    // replies waiting for releaseSend(), guarded by _sendMutex
+    struct PendingDatagram {
+        osiSockAddr to;
+        size_t offset, length;
+    };
+    unsigned _sendHeld;
+    std::vector<char> _pendingData;
+    size_t _pendingUsed;
+    std::vector<PendingDatagram> _pending;
+
+    // guarded by _sendMutex
+    Statistics _stats;
 
     /**
      * Thread ID
@@ -398,6 +508,9 @@ private:
 
     epics::pvData::int8 _clientServerWithEndianFlag;
 
+    // from setShard()
+    unsigned _shardIndex, _shardCount;
+
 };
 
 class BlockingUDPConnector :
@@ -408,10 +521,12 @@ public:
     BlockingUDPConnector(
         bool serverFlag,
         bool reuseSocket,
-        bool broadcast) :
+        bool broadcast,
+        bool reusePort = false) :
         _serverFlag(serverFlag),
         _reuseSocket(reuseSocket),
-        _broadcast(broadcast) {
+        _broadcast(broadcast),
+        _reusePort(reusePort) {
     }
 
     /**
@@ -438,6 +553,11 @@ private:
      */
     bool _broadcast;
 
+    /**
+     * Set SO_REUSEPORT, so that unicast datagrams are spread over the sockets bound to one address.
+     */
+    bool _reusePort;
+
 };
 
 typedef std::vector<BlockingUDPTransport::shared_pointer> BlockingUDPTransportVector;
@@ -451,7 +571,9 @@ void initializeUDPTransports(
     epics::pvData::int32& listenPort,
     bool autoAddressList,
     const std::string& addressList,
-    const std::string& ignoreAddressList);
+    const std::string& ignoreAddressList,
+    const std::string& multicastGroup,
+    const std::vector<ResponseHandler::shared_pointer>& shardHandlers = std::vector<ResponseHandler::shared_pointer>());
 
 
 }
@@ -13,6 +13,7 @@
 #endif
 
 #include <osiSock.h>
+#include <shareLib.h>
 
 #ifdef channelSearchManagerEpicsExportSharedSymbols
 #   define epicsExportSharedSymbols
@@ -21,6 +22,9 @@
 
 #include <pv/pvaDefs.h>
 #include <pv/remote.h>
+#include <pv/metrics.h>
+#include <pv/idTable.h>
+#include <pv/internedName.h>
 
 namespace epics {
 namespace pvAccess {
@@ -38,7 +42,8 @@ public:
 
     virtual const std::string& getSearchInstanceName() = 0;
 
-    virtual int32_t& getUserValue() = 0;
+    //! getSearchInstanceName(), to be kept after searching without a copy of the string
+    virtual InternedName getSearchInstanceInternedName() { return InternedName(getSearchInstanceName()); }
 
     /**
      * Search response from server (channel found).
@@ -51,7 +56,7 @@ public:
 };
 
 
-class ChannelSearchManager :
+class epicsShareClass ChannelSearchManager :
         public epics::pvData::TimerCallback,
         public std::tr1::enable_shared_from_this<ChannelSearchManager>
 {
@@ -90,8 +95,20 @@ public:
     /**
      * New server detected.
      * Boost searching of all channels.
+     * Detections within EPICS_PVA_BOOST_HOLDOFF seconds of the last boost are merged into one,
+     * sent by a later timer callback.
      */
     void newServerDetected();
+    /**
+     * Also send search requests through this TCP connection to a name server.
+     * @param transport connection to a name server.
+     */
+    void addNameServer(Transport::shared_pointer const & transport);
+    /**
+     * Stop sending search requests through this connection.
+     * @param transport connection to a name server.
+     */
+    void removeNameServer(Transport::shared_pointer const & transport);
 
     /// Timer callback.
     virtual void callback() OVERRIDE FINAL;
@@ -106,19 +123,33 @@ public:
     ChannelSearchManager(Context::shared_pointer const & context);
     void activate();
 
+    //! Names sent in search requests, counting each time a name is searched again
+    size_t getNamesSearched() const { return m_namesSearched.get(); }
+
 private:
 
-    bool generateSearchRequestMessage(SearchInstance::shared_pointer const & channel, bool allowNewFrame, bool flush);
+    /**
+     * Connect to the least loaded of the servers which answered during the balancing window.
+     * @param cid client channel ID.
+     */
+    void balanceComplete(pvAccessID cid);
+    friend struct BalanceTimer;
+
+    bool generateSearchRequestMessage(SearchInstance::shared_pointer const & channel, int level, bool allowNewFrame, bool flush);
 
     static bool generateSearchRequestMessage(SearchInstance::shared_pointer const & channel,
             epics::pvData::ByteBuffer* byteBuffer, TransportSendControl* control);
 
     void boost();
+    void boostAll();
+
+    void updateDestinations();
 
     void initializeSendBuffer();
     void flushSendBuffer();
 
-    static bool isPowerOfTwo(int32_t x);
+    static int32_t nextPowerOfTwo(int32_t x);
+    static int levelOf(int32_t x);
 
     /**
      * Context.
@@ -140,31 +171,125 @@ private:
      */
     int32_t m_sequenceNumber;
 
+    MetricCounter m_namesSearched;
+
     /**
      * Send byte buffer (frame)
      */
     epics::pvData::ByteBuffer m_sendBuffer;
 
     /**
-     * Set of registered channels.
+     * Highest level of any channel in the send buffer.
      */
-    typedef std::map<pvAccessID,SearchInstance::weak_pointer> m_channels_t;
+    int m_frameLevel;
+
+    /**
+     * A unicast send address.
+     * While it does not answer, it is only sent the requests for channels
+     * which are searched for the first time, or have already been searched
+     * for at least 2^level times.
+     */
+    struct Destination {
+        osiSockAddr address;
+        int level;
+        // frames sent since the level was last updated
+        bool sent;
+        // any response since the level was last updated
+        bool answered;
+        size_t framesSent, responses;
+    };
+    std::vector<Destination> m_destinations;
+
+    /**
+     * Connections to name servers (EPICS_PVA_NAME_SERVERS).
+     */
+    std::vector<Transport::weak_pointer> m_nameServers;
+
+    /**
+     * Channels in the send buffer, while there are name servers.
+     */
+    std::vector<std::pair<pvAccessID, InternedName> > m_frameChannels;
+
+    /**
+     * Bound on frames sent per timer callback.
+     */
+    int m_maxFrames;
+
+    /**
+     * A registered channel, and when it is next searched.
+     */
+    struct Entry {
+        SearchInstance::weak_pointer instance;
+        // the number of times searched is counted up to this power of two, whose log2 is the level
+        int32_t count;
+        // m_wheel slot, and index in it, or NOT_SCHEDULED while being searched
+        size_t slot, pos;
+        Entry() :count(0), slot(NOT_SCHEDULED), pos(0u) {}
+    };
+
+    /**
+     * Set of registered channels.  Guarded by m_channelMutex.
+     */
+    typedef IDTable<Entry> m_channels_t;
     m_channels_t m_channels;
 
+    /**
+     * Timer wheel.  Slot m_tick % WHEEL_SIZE lists the channels to search in the next timer callback.
+     * Searches of a channel are less than WHEEL_SIZE callbacks apart, so a slot holds those due in one callback.
+     * Guarded by m_channelMutex.
+     */
+    std::vector<std::vector<pvAccessID> > m_wheel;
+    size_t m_tick;
+
+    // search in the timer callback delay callbacks after the next, at entry.count
+    void schedule(pvAccessID id, Entry& entry, int32_t delay);
+    void unschedule(pvAccessID id, Entry& entry);
+
+    /**
+     * Seconds to wait for more servers after the first answers,
+     * when the first advertises its load (EPICS_PVA_LOAD_BALANCE_WINDOW).  0 to connect to the first.
+     */
+    double m_balanceWindow;
+
+    /**
+     * Channels found, waiting for the balancing window to end, and the servers which answered.
+     * Guarded by m_channelMutex.
+     */
+    struct Candidate {
+        ServerGUID guid;
+        int8_t minorRevision;
+        osiSockAddr address;
+        bool known;
+        ServerLoad load;
+    };
+    struct Balancing {
+        SearchInstance::weak_pointer instance;
+        std::vector<Candidate> candidates;
+    };
+    typedef std::map<pvAccessID, Balancing> m_balancing_t;
+    m_balancing_t m_balancing;
+
+    //! Known load first, then the least
+    static bool lessLoaded(const Candidate& a, const Candidate& b);
+
     /**
      * Time of last frame send.
      */
     int64_t m_lastTimeSent;
 
     /**
-     * This instance mutex.
+     * Time of last new server boost, minimum time between two (in ms),
+     * and whether more new servers were detected since.
      */
-    epics::pvData::Mutex m_channelMutex;
+    int64_t m_lastBoostTime;
+    int64_t m_boostHoldoff;
+    bool m_boostPending;
+    size_t m_boostsMerged;
 
     /**
-     * User value lock.
+     * This instance mutex.
      */
-    epics::pvData::Mutex m_userValueMutex;
+    epics::pvData::Mutex m_channelMutex;
 
     /**
      * m_channels mutex.
@@ -183,7 +308,15 @@ private:
     static const int MAX_COUNT_VALUE;
     static const int MAX_FALLBACK_COUNT_VALUE;
 
+    static const int MAX_DESTINATION_LEVEL;
+
+    static const size_t WHEEL_SIZE;
+    static const size_t NOT_SCHEDULED;
+
+    static const double BOOST_HOLDOFF;
+
     static const int MAX_FRAMES_AT_ONCE;
+    static const int MAX_FRAMES_PER_CALLBACK;
     static const int DELAY_BETWEEN_FRAMES_MS;
 };
 
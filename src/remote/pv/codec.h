@@ -10,6 +10,8 @@
 #include <set>
 #include <map>
 #include <deque>
+#include <vector>
+#include <stdexcept>
 
 #include <shareLib.h>
 #include <osiSock.h>
@@ -21,6 +23,7 @@
 #if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
 #include <epicsAtomic.h>
 #define PVA_CODEC_USE_ATOMIC
+#define PVA_CODEC_STATS_ATOMIC
 #endif
 #endif
 
@@ -37,6 +40,18 @@
 #include <pv/transportRegistry.h>
 #include <pv/introspectionRegistry.h>
 #include <pv/inetAddressUtil.h>
+#include <pv/ioReactor.h>
+#include <pv/decodePool.h>
+#include <pv/bufferPool.h>
+#include <pv/idTable.h>
+#include <pv/tls.h>
+#include <pv/shmRing.h>
+#include <pv/ioUring.h>
+#include <pv/rdmaRing.h>
+#include <pv/trafficCapture.h>
+#include <pv/cpuAffinity.h>
+#include <pv/threadCPU.h>
+#include <pv/latencyHistogram.h>
 
 /* C++11 keywords
  @code
@@ -157,8 +172,70 @@ public:
 };
 
 
+/** Counters kept by the send and receive paths of one codec.
+ *
+ * Each counter is only updated by one thread (sender or receiver),
+ * so no locking is needed.  Use snapshot() to read from another thread.
+ */
+struct epicsShareClass TransportStatistics {
+    //! The last entry of messagesSent and messagesReceived counts any command >= maxCommand
+    enum { maxCommand = 31 };
+
+    size_t bytesSent, bytesReceived;
+    //! write()/read() calls made, each a system call for TCP
+    size_t sendCalls, recvCalls;
+    //! write() calls which sent less than offered
+    size_t partialWrites;
+    //! time spent waiting in sendBufferFull(), in microseconds
+    size_t sendStallUS;
+    //! segments sent compressed, their size before and after, and time spent compressing
+    size_t compressedSegments, compressIn, compressOut, compressUS;
+    //! compressed segments received, and time spent in decompression
+    size_t inflatedSegments, inflateUS;
+    //! slow consumer actions.  monitor updates held and merged, or discarded, and disconnects
+    size_t slowSquashed, slowDropped, slowDisconnects;
+    //! CPU time of the receive and send paths, in microseconds.  Only counted here with an IOReactor
+    size_t rxCPUUS, txCPUUS;
+    //! messages, or segments of messages, by command
+    size_t messagesSent[maxCommand+1];
+    size_t messagesReceived[maxCommand+1];
+
+    TransportStatistics();
+
+    static inline size_t commandIndex(epics::pvData::int8 command) {
+        epics::pvData::uint8 cmd = command;
+        return cmd < maxCommand ? cmd : size_t(maxCommand);
+    }
+
+    static inline void add(size_t& counter, size_t n = 1) {
+#ifdef PVA_CODEC_STATS_ATOMIC
+        epics::atomic::add(counter, n);
+#else
+        counter += n;
+#endif
+    }
+
+    //! Copy current values into out
+    void snapshot(TransportStatistics& out) const;
+    size_t totalMessagesSent() const;
+    size_t totalMessagesReceived() const;
+
+    //! Lower case name of an application command, eg. "get".  "other" if unknown.
+    static const char* commandName(epics::pvData::int8 command);
+};
+
 enum ReadMode { NORMAL, SPLIT, SEGMENTED };
 
+//! What a server does for a peer over the limits of AbstractCodec::setSlowConsumerLimits()
+enum SlowConsumerPolicy {
+    //! hold monitor updates, merged, until the peer catches up
+    SLOW_CONSUMER_SQUASH,
+    //! send only the latest of the monitor updates queued, marked as overrun
+    SLOW_CONSUMER_DROP,
+    //! close the connection
+    SLOW_CONSUMER_DISCONNECT
+};
+
 enum WriteMode { PROCESS_SEND_QUEUE, WAIT_FOR_READY_SIGNAL };
 
 
@@ -194,6 +271,11 @@ public:
     virtual int write(epics::pvData::ByteBuffer* src) = 0;
     virtual int read(epics::pvData::ByteBuffer* dst) = 0;
     virtual bool isOpen() = 0;
+    //! Reference to this codec, by which a SendBatch keeps it.  NULL if it can't be deferred.
+    virtual std::tr1::shared_ptr<AbstractCodec> sharedCodec() { return std::tr1::shared_ptr<AbstractCodec>(); }
+    //! Handle a message given to the DecodePool by offloadApplicationMessage(), from one of its workers
+    virtual void processOffloaded(epics::pvData::int8 /*version*/, epics::pvData::int8 /*command*/,
+                                  epics::pvData::ByteBuffer* /*payload*/) {}
 
 
     virtual ~AbstractCodec()
@@ -221,6 +303,8 @@ public:
     void enqueueSendRequest(TransportSender::shared_pointer const & sender,
                             std::size_t requiredBufferSize);
     void setSenderThread();
+    //! Wake the sender for requests queued during a SendBatch
+    void wakeSender();
     virtual void setRecipient(osiSockAddr const & sendTo) OVERRIDE FINAL;
     virtual void setByteOrder(int byteOrder) OVERRIDE FINAL;
 
@@ -240,11 +324,140 @@ public:
         return _sendQueue.empty();
     }
 
+    const TransportStatistics& getStatistics() const {
+        return _stats;
+    }
+
+    std::size_t getSendQueueDepth() const {
+        return _sendQueue.size();
+    }
+
+    //! Bytes allocated for the receive and send buffers
+    std::size_t getBufferBytes() const {
+        return _socketBuffer.getSize() + _sendBuffer.getSize();
+    }
+
+    /** Limit the size of each sent segment, including headers.
+     *
+     * Clipped to the capacity of the send buffer.  May be called from any thread.
+     * Takes effect once the send buffer is next flushed.
+     */
+    void setSegmentSize(std::size_t size);
+
+    //! Current limit on the size of sent segments
+    std::size_t getSegmentSize() const {
+        return _segmentSize;
+    }
+
+    /** Hold back flushing a partly filled send buffer, for up to window seconds
+     * after the first message was added, or until it holds at least bytes,
+     * so that more messages can be sent together.
+     *
+     * A window of zero disables.  Bytes of zero waits until the buffer is full.
+     * Has no effect with a non-blocking send queue.
+     */
+    void setCoalescing(double window, std::size_t bytes);
+    /** Compress sent segments with payloads of at least threshold bytes,
+     * once the peer has announced that it can decompress.  Zero disables.
+     * Has no effect unless built with LZ4.
+     */
+    void setCompression(std::size_t threshold) {
+        _compressThreshold = threshold;
+    }
+    //! true if built with support for compression
+    static bool compressionSupported();
+
+    /** Before waiting for the send queue, poll it for up to us microseconds,
+     * instead of sleeping at once.  Zero disables.  Has no effect with a non-blocking send queue.
+     */
+    void setSendSpin(int us) {
+        _sendSpinUS.getAndSet(us > 0 ? us : 0);
+    }
+
+    //! Record the bytes received from now on.  Before the receiver is started.  NULL stops.
+    void setCapture(const TrafficCapture::shared_pointer& capture) {
+        _capture = capture;
+    }
+
+    //! Flush as soon as the send queue is empty, regardless of setCoalescing()
+    void disableCoalescing() {
+        _coalesceDisabled.getAndSet(true);
+    }
+    //! Undo disableCoalescing()
+    void enableCoalescing() {
+        _coalesceDisabled.getAndSet(false);
+    }
+
+    //! Current upper limit on the number of bytes requested by one read()
+    std::size_t getReceiveWindow() const {
+        return _receiveWindow;
+    }
+
+    /** The peer is a slow consumer while more than maxQueued senders wait in
+     * the send queue, or more than maxBytes sent are not yet acknowledged by it.
+     * Zero disables either limit.  The byte limit is only applied where the OS
+     * reports unacknowledged bytes.  May be changed while running, which takes
+     * effect when the send buffer is next flushed.
+     */
+    void setSlowConsumerLimits(std::size_t maxQueued, std::size_t maxBytes,
+                               SlowConsumerPolicy policy);
+
+    SlowConsumerPolicy getSlowConsumerPolicy() const {
+        return _slowPolicy;
+    }
+
+    /** true while over the limits of setSlowConsumerLimits().
+     * Updated as the send buffer is flushed.  Only call from the sender.
+     */
+    bool sendCongested() const {
+        return _congested;
+    }
+
+    //! Count updates held, or dropped, for a slow consumer.  Only call from the sender.
+    void countSlowConsumer(SlowConsumerPolicy action, std::size_t n = 1u);
+
 protected:
 
+    //! true for the server end of a connection
+    bool isServer() const { return _clientServerFlag!=0; }
+
     virtual void sendBufferFull(int tries) = 0;
+    /**
+     * Write from several buffers, in order, advancing their positions.
+     * May write less than all, stopping within any buffer, as sendmsg() may.
+     * The caller calls again for the rest, see sendGather().
+     * Default implementation calls write() for each non-empty buffer in turn,
+     * until one is not written whole.
+     * @return bytes written, 0 if none could be, or <0 on connection loss
+     *         before any were written.
+     */
+    virtual int writeGather(epics::pvData::ByteBuffer** srcs, std::size_t count);
+    /** Begin each read() with a window of minWindow bytes.  Grow the window,
+     * up to the capacity of _socketBuffer, while reads fill it, and shrink
+     * it again when they don't.
+     */
+    void setAdaptiveReceive(std::size_t minWindow);
+    //! true if a complete header has been received but not yet processed
+    bool inputPending() const {
+        return _socketBuffer.getRemaining() >= PVA_MESSAGE_HEADER_SIZE
+                || _inflateRemainderPos < _inflateRemainder.size();
+    }
+    //! Tell the peer that we can decompress, when supported.
+    void putCompressionControl();
+    //! Largest segment payload which we announce that we will decompress
+    std::size_t inflateLimit() const;
+    //! Handle CMD_SET_COMPRESSION from the peer
+    void setPeerCompression(epics::pvData::int32 inflateLimit) {
+        _peerInflateLimit.getAndSet(inflateLimit > 0 ? inflateLimit : 0);
+    }
     void send(epics::pvData::ByteBuffer *buffer);
-    void flushSendBuffer();
+    void sendGather(epics::pvData::ByteBuffer** buffers, std::size_t count);
+    //! @param tail Optional, sent after the content of _sendBuffer.
+    void flushSendBuffer(epics::pvData::ByteBuffer *tail = 0);
+    //! Bytes sent but not yet acknowledged by the peer, or zero if not known
+    virtual std::size_t unackedBytes() { return 0u; }
+    //! true while bytes which the socket would not accept are set aside.  See processSendQueue()
+    bool sendBlocked() const { return _txPendingPos < _txPending.size(); }
 
 
     ReadMode _readMode;
@@ -260,12 +473,38 @@ protected:
     WriteMode _writeMode;
     bool _writeOpReady;
     bool _lowLatency;
+    // when set, send() keeps what the socket would not accept for sendPending(), rather than
+    // wait in sendBufferFull().  For a sender without a thread of its own
+    bool _setAsideUnsent;
+
+    // storage for, so must precede, _socketBuffer and _sendBuffer
+    PooledBlock _socketBlock, _sendBlock;
 
     epics::pvData::ByteBuffer _socketBuffer;
     epics::pvData::ByteBuffer _sendBuffer;
 
     fair_queue<TransportSender> _sendQueue;
 
+    TransportStatistics _stats;
+
+    // set by the derived codec to deserialize updates on other threads.  See offloadApplicationMessage()
+    DecodePool::shared_pointer _decodePool;
+
+    /** Called by processApplicationMessage() with _decodePool set.  Posts a copy of the payload
+     * of a GET or MONITOR update, which need not be decoded here, to _decodePool.
+     * Otherwise first waits for the updates of its IOID already posted to be processed.
+     * @param local true if the message must be processed here, eg. when traced
+     * @returns true if posted, when the message should not be processed here.
+     */
+    bool offloadApplicationMessage(bool local = false);
+
+    /** Called by cachedDeserialize() with each type received.  While the INIT of a GET or MONITOR
+     * is processed, marks its IOID as carrying unions if field has one.  The values of a variant
+     * union carry their type, which only the receive thread may decode, so the updates of such an
+     * IOID are not offloaded.
+     */
+    void receivedIntrospection(const std::tr1::shared_ptr<const epics::pvData::Field>& field);
+
 private:
 
     void processHeader();
@@ -273,6 +512,25 @@ private:
     void postProcessApplicationMessage();
     void processReadSegmented();
     bool readToBuffer(std::size_t requiredBytes, bool persistent);
+    //! sendBufferFull(), accounting the time spent
+    void stallSend(int tries);
+    //! Keep the remainder of buffer for sendPending()
+    void setAside(epics::pvData::ByteBuffer *buffer);
+    //! Send what setAside() kept.  @returns true once all of it is sent
+    bool sendPending();
+    //! Update _congested.  Closes the connection if so, and the policy is to disconnect.
+    void checkCongestion();
+    //! Wait for another sender if the send buffer should not yet be flushed
+    void waitToCoalesce(TransportSender::shared_pointer& sender);
+    //! Poll the send queue for up to setSendSpin().  @returns true if sender was set
+    bool spinForSender(TransportSender::shared_pointer& sender);
+    //! read(), after any bytes set aside by inflateSegment()
+    int readSocket(epics::pvData::ByteBuffer* dst);
+    //! Replace the compressed payload following the current header with its content
+    void inflateSegment();
+    //! Compress the payload of the message, or segment, which starts at _lastMessageStartPosition
+    void compressSegment(std::size_t payloadSize);
+    void adaptReceiveWindow(bool filled);
     void endMessage(bool hasMoreSegments);
     void processSender(
         epics::pvAccess::TransportSender::shared_pointer const & sender);
@@ -282,7 +540,12 @@ private:
     std::size_t _storedLimit;
     std::size_t _startPosition;
 
-    const std::size_t _maxSendPayloadSize;
+    // _segmentSize less space for start and control headers
+    std::size_t _maxSendPayloadSize;
+    // _sendBuffer limit, applied after each flush
+    std::size_t _segmentSize;
+    // non-zero when setSegmentSize() has been called since the last flush
+    AtomicValue<epics::pvData::int32> _requestedSegmentSize;
     std::size_t _lastMessageStartPosition;
     std::size_t _lastSegmentedMessageType;
     int8_t _lastSegmentedMessageCommand;
@@ -291,12 +554,127 @@ private:
     epics::pvData::int8 _byteOrderFlag;
     epics::pvData::int8 _clientServerFlag;
     const size_t _socketSendBufferSize;
+    // when false, processSendQueue() returns once the queue is empty
+    const bool _blockingProcessQueue;
+
+    std::size_t _receiveWindow, _receiveWindowMin, _receiveWindowMax;
+    // consecutive reads which did, or did not, fill the window
+    unsigned _receiveWindowFilled, _receiveWindowShort;
+
+    double _coalesceWindow;
+    std::size_t _coalesceBytes;
+    AtomicValue<bool> _coalesceDisabled;
+    // see setSendSpin()
+    AtomicValue<int> _sendSpinUS;
+    // true while _sendBuffer holds messages not yet flushed, since _coalesceStart
+    bool _coalescing;
+    epicsTimeStamp _coalesceStart;
+
+    std::size_t _compressThreshold;
+    // largest segment the peer will decompress, zero until CMD_SET_COMPRESSION is received
+    AtomicValue<epics::pvData::int32> _peerInflateLimit;
+    std::vector<char> _compressScratch, _inflateScratch;
+    // received bytes which followed a compressed segment, not yet processed
+    std::vector<char> _inflateRemainder;
+    std::size_t _inflateRemainderPos;
+    // records what readSocket() returns, when EPICS_PVA_CAPTURE_DIR is set.  Only used by the receiver
+    TrafficCapture::shared_pointer _capture;
+
+    std::size_t _slowMaxQueued, _slowMaxBytes;
+    SlowConsumerPolicy _slowPolicy;
+    // only accessed by the sender
+    bool _congested;
+    // with _setAsideUnsent, the bytes which the socket would not yet accept, from
+    // _txPendingPos.  They are sent before anything else.  Only accessed by the sender
+    std::vector<char> _txPending;
+    std::size_t _txPendingPos;
+
+    // only accessed by the receiver.  Set while the INIT of _rxInitIOID is processed
+    bool _rxInit;
+    pvAccessID _rxInitIOID;
+    // GET and MONITOR whose type has a union, so are not offloaded
+    std::set<pvAccessID> _unionIOIDs;
+};
+
+
+/** Defers waking the senders of codecs to which requests are queued in one thread.
+ *
+ * While one exists, AbstractCodec::enqueueSendRequest() in the constructing thread queues without
+ * waking the sender of the codec.  Each codec queued to is woken once by the destructor,
+ * and then serializes and flushes all of its requests together.
+ * eg. when monitor updates to many subscriptions are posted together.
+ *
+ * May be nested, in which case only the outermost has effect.
+ */
+class epicsShareClass SendBatch
+{
+public:
+    SendBatch();
+    ~SendBatch();
+
+    //! Called by enqueueSendRequest().  @returns false unless a SendBatch exists in this thread
+    static bool defer(AbstractCodec *codec);
+
+    //! Wake the codecs queued to so far, instead of waiting for the destructor.  No-op unless outermost.
+    void flush();
+
+private:
+    bool outermost;
+    std::vector<std::tr1::shared_ptr<AbstractCodec> > codecs;
+
+    SendBatch(const SendBatch&);
+    SendBatch& operator=(const SendBatch&);
 };
 
+/** Defers work arising from the messages of one received buffer until all have been processed.
+ *
+ * Exists while AbstractCodec::processRead() works through messages already received.
+ * Replies queued meanwhile are held as by a SendBatch, and notifications passed to defer()
+ * are run together, before the codec next waits for data, or returns.
+ * eg. when a client starts many monitors at once, the server answers the INIT requests
+ * read together with one wakeup of its sender, which then serializes and flushes
+ * the replies together.  Likewise the client deserializes the updates read together
+ * before calling any monitorEvent().
+ *
+ * May be nested, in which case only the outermost has effect.
+ */
+class epicsShareClass ReceiveBatch
+{
+public:
+    //! Work deferred by defer()
+    class epicsShareClass Deferred
+    {
+    public:
+        virtual ~Deferred() {}
+        virtual void runDeferred() = 0;
+    };
+
+    ReceiveBatch();
+    ~ReceiveBatch();
+
+    /** Run work->runDeferred() once the messages already received have been processed.
+     * @returns false unless a ReceiveBatch exists in this thread, when the caller should do the work itself.
+     */
+    static bool defer(const std::tr1::shared_ptr<Deferred>& work);
+
+    //! Run the deferred work, and wake the senders, of the ReceiveBatch of this thread, if any.
+    static void flushCurrent();
+
+private:
+    void flush();
+
+    bool outermost;
+    SendBatch sends;
+    std::vector<std::tr1::shared_ptr<Deferred> > deferred;
+
+    ReceiveBatch(const ReceiveBatch&);
+    ReceiveBatch& operator=(const ReceiveBatch&);
+};
 
 class BlockingTCPTransportCodec:
     public AbstractCodec,
     public SecurityPluginControl,
+    public IOReactor::Handler,
     public std::tr1::enable_shared_from_this<BlockingTCPTransportCodec>
 {
 
@@ -318,16 +696,18 @@ public:
 
     virtual void readPollOne() OVERRIDE FINAL;
     virtual void writePollOne() OVERRIDE FINAL;
-    virtual void scheduleSend() OVERRIDE FINAL {}
+    virtual void scheduleSend() OVERRIDE FINAL;
     virtual void sendCompleted() OVERRIDE FINAL {}
     virtual void close() OVERRIDE FINAL;
     virtual void waitJoin() OVERRIDE FINAL;
     virtual bool terminated() OVERRIDE FINAL;
     virtual bool isOpen() OVERRIDE FINAL;
+    virtual std::tr1::shared_ptr<AbstractCodec> sharedCodec() OVERRIDE FINAL { return shared_from_this(); }
     void start();
 
     virtual int read(epics::pvData::ByteBuffer* dst) OVERRIDE FINAL;
     virtual int write(epics::pvData::ByteBuffer* src) OVERRIDE FINAL;
+    virtual int writeGather(epics::pvData::ByteBuffer** srcs, std::size_t count) OVERRIDE FINAL;
     virtual const osiSockAddr* getLastReadBufferSocketAddress() OVERRIDE FINAL  {
         return &_socketAddress;
     }
@@ -339,17 +719,69 @@ public:
     }
 
     virtual void processControlMessage() OVERRIDE FINAL {
-        if (_command == 2)
+        if (_command == CMD_SET_ENDIANESS)
         {
             // check 7-th bit
             setByteOrder(_flags < 0 ? EPICS_ENDIAN_BIG : EPICS_ENDIAN_LITTLE);
         }
+        else if (_command == CMD_SET_COMPRESSION)
+        {
+            setPeerCompression(_payloadSize);
+        }
+        else if (_command >= CMD_SHM_OFFER && _command <= CMD_SHM_SWITCH)
+        {
+            processShmControl(_command, _payloadSize);
+        }
+        else if (_command == CMD_RDMA_OFFER || _command == CMD_RDMA_SWITCH)
+        {
+            processRdmaControl(_command, _payloadSize);
+        }
+        else if (_command == CMD_SET_TRACE)
+        {
+            if (_tracing)
+                _peerTracing.getAndSet(true);
+        }
+        else if (_command == CMD_SET_PIPELINE)
+        {
+            if (!isServer())
+                _peerPipelineWindow.getAndSet(_payloadSize > 1 ? int(_payloadSize) : 1);
+        }
     }
 
 
     virtual void processApplicationMessage() OVERRIDE FINAL {
+        if (_command == CMD_TRACE_CONTEXT)
+        {
+            processTraceContext();
+            return;
+        }
+        else if (_command == CMD_RDMA_ENDPOINT)
+        {
+            processRdmaEndpoint();
+            return;
+        }
+        if (_rxStampMode != RX_STAMP_NONE)
+            stampDispatch();
+        // a traced message is handled here, while its trace context is valid
+        if (_decodePool && offloadApplicationMessage(_rxTraced)) {
+            _rxStamped = false;
+            return;
+        }
+        try {
+            _responseHandler->handleResponse(&_socketAddress, shared_from_this(),
+                                             _version, _command, _payloadSize, &_socketBuffer);
+        } catch(...) {
+            _rxTraced = _rxStamped = false;
+            throw;
+        }
+        // a trace context only applies to the message which follows it
+        _rxTraced = _rxStamped = false;
+    }
+
+    virtual void processOffloaded(epics::pvData::int8 version, epics::pvData::int8 command,
+                                  epics::pvData::ByteBuffer* payload) OVERRIDE FINAL {
         _responseHandler->handleResponse(&_socketAddress, shared_from_this(),
-                                         _version, _command, _payloadSize, &_socketBuffer);
+                                         version, command, payload->getLimit(), payload);
     }
 
 
@@ -376,6 +808,56 @@ public:
         return _priority;
     }
 
+    /** Priority (QoS) requested by the peer, which may opt out of send coalescing,
+     *  and selects the thread priority and socket options of a server connection.
+     */
+    void setPeerPriority(epics::pvData::int16 priority);
+
+
+    //! Introspection registry size of the peer, from connection validation, before any type is sent
+    void setRemoteIntrospectionRegistryMaxSize(epics::pvData::int16 maxSize) {
+        _outgoingIR.setMaxSize(maxSize < 0 ? 0u : std::size_t(maxSize));
+    }
+
+    virtual bool isTracing() const OVERRIDE FINAL {
+        return _tracing;
+    }
+
+    virtual bool isPeerTracing() const OVERRIDE FINAL {
+        return _peerTracing.get();
+    }
+
+    virtual int getPipelineWindow() const OVERRIDE FINAL {
+        if (isServer())
+            return _pipelineWindow;
+        return std::min(_pipelineWindow, _peerPipelineWindow.get());
+    }
+
+    virtual bool receivedTrace(TraceContext& context, epicsTimeStamp& received) const OVERRIDE FINAL {
+        // _rxTraced belongs to the message the receive thread is processing
+        if (!_rxTraced || (_decodePool && DecodePool::current(this)))
+            return false;
+        context = _rxTrace;
+        received = _rxTraceTime;
+        return true;
+    }
+
+    virtual bool receivedAt(epicsTimeStamp& kernel, epicsTimeStamp& dispatch) const OVERRIDE FINAL {
+        // as _rxTraced
+        if (!_rxStamped || (_decodePool && DecodePool::current(this)))
+            return false;
+        kernel = _rxKernelTime;
+        dispatch = _rxDispatchTime;
+        return true;
+    }
+
+    virtual void responseSent(const epicsTimeStamp& dispatch) OVERRIDE FINAL;
+
+    //! Approximate bytes of the incoming and outgoing introspection registries
+    std::size_t getIntrospectionBytes() const {
+        return _incomingIR.memoryUsage() + _outgoingIR.memoryUsage();
+    }
+
 
     virtual void setRemoteRevision(epics::pvData::int8 revision) OVERRIDE FINAL {
         _remoteTransportRevision = revision;
@@ -385,6 +867,8 @@ public:
     virtual void setRemoteTransportReceiveBufferSize(
         std::size_t remoteTransportReceiveBufferSize) OVERRIDE FINAL {
         _remoteTransportReceiveBufferSize = remoteTransportReceiveBufferSize;
+        // send segments which the peer can receive without splitting
+        setSegmentSize(remoteTransportReceiveBufferSize);
     }
 
 
@@ -397,7 +881,13 @@ public:
     std::tr1::shared_ptr<const epics::pvData::Field>
     virtual cachedDeserialize(epics::pvData::ByteBuffer* buffer) OVERRIDE FINAL
     {
-        return _incomingIR.deserialize(buffer, this);
+        // only the receive thread may use _incomingIR, so messages with introspection are not offloaded
+        if (_decodePool && DecodePool::current(this))
+            throw std::logic_error("introspection in an offloaded message");
+        std::tr1::shared_ptr<const epics::pvData::Field> field(_incomingIR.deserialize(buffer, this));
+        if (_decodePool)
+            receivedIntrospection(field);
+        return field;
     }
 
 
@@ -441,12 +931,107 @@ public:
 
     virtual void sendSecurityPluginMessage(epics::pvData::PVField::shared_pointer const & data) OVERRIDE FINAL;
 
+    virtual void readReady() OVERRIDE FINAL;
+    virtual void writeReady() OVERRIDE FINAL;
+
+    //! NULL unless this connection is encrypted
+    const TLSSession::shared_pointer& getTLSSession() const {
+        return _tls;
+    }
+
+    /** Client side.  Offer to move a connection to a server on this host into shared memory.
+     *
+     * A no-op unless connected through loopback with per-connection threads,
+     * and EPICS_PVA_SHM_RING_SIZE is non-zero.
+     */
+    void offerSharedMemory();
+
+    //! true once messages are sent through shared memory
+    bool isSharedMemory() const {
+        return _shmWrite;
+    }
+
+    /** Client side.  Offer to move a connection to a server on another host into RDMA rings.
+     *
+     * A no-op unless connected with per-connection threads, not through loopback,
+     * and EPICS_PVA_RDMA_RING_SIZE is non-zero.
+     */
+    void offerRDMA();
+
+    //! true once messages are sent through RDMA
+    bool isRDMA() const {
+        return _rdmaWrite;
+    }
+
+    //! true if socket I/O goes through io_uring.  See EPICS_PVA_IO_URING
+    bool isIOUring() const {
+        return !!_txRing;
+    }
+
+    /** CPU time, in seconds, used to receive and to send.
+     *
+     * With per-connection threads, that of each thread.  With an IOReactor,
+     * zero unless EPICS_PVA_CPU_STATS is set.  Zero where threads have no CPU clock.
+     */
+    void getCPUTime(double& rx, double& tx) const;
+
+    //! Source of receive timestamps.  See EPICS_PVA_RX_TIMESTAMPS
+    enum RxStampMode { RX_STAMP_NONE, RX_STAMP_SOFTWARE, RX_STAMP_HARDWARE };
+    RxStampMode getRxStampMode() const { return _rxStampMode; }
+
+    /** With EPICS_PVA_RX_TIMESTAMPS, copy the durations of the messages received from when the kernel
+     * received them until they were dispatched to their handler (toDispatch), and of requests from dispatch
+     * until their response was written to the send buffer (toResponse).  Empty otherwise.
+     */
+    void getReceiveLatency(LatencyHistogram& toDispatch, LatencyHistogram& toResponse) const;
+
+    /** Apply again those settings of the Configuration of the context which may change while
+     *  connected: coalescing, compression, and the socket options of the priority class
+     *  (EPICS_PVA_PRIORITY_*).  Called after ServerContext::tune().  May be called from any thread.
+     *  They are applied by the sender, before it sends anything queued later.
+     */
+    void reconfigure();
+
+protected:
+    //! reconfigure(), by the sender
+    virtual void applyConfiguration();
+
+    /** Before start(), pin our own threads to cpus (if not empty),
+     * and move our buffers to NUMA node (if not -1).
+     */
+    void setAffinity(const CPUAffinity& cpus, int node);
+
+    //! Tell the peer that we accept trace contexts, when tracing is enabled.
+    void putTraceControl() {
+        if (_tracing)
+            putControlMessage((epics::pvData::int8)CMD_SET_TRACE, 0);
+    }
+
+    //! Tell a client how many requests of one operation we accept outstanding.
+    void putPipelineControl() {
+        if (_pipelineWindow > 1)
+            putControlMessage((epics::pvData::int8)CMD_SET_PIPELINE, _pipelineWindow);
+    }
+
 private:
     void receiveThread();
+    int spinRecv(char *buf, std::size_t count);
+    // recv(), with the timestamp of _rxStampMode kept in _rxKernelTime
+    int recvStamped(char *buf, std::size_t count, int flags);
+    void stampDispatch();
+    void processShmControl(epics::pvData::int8 command, epics::pvData::int32 data);
+    void processTraceContext();
+    void processRdmaControl(epics::pvData::int8 command, epics::pvData::int32 data);
+    void processRdmaEndpoint();
+
+    struct ShmControlSender;
+    struct RdmaEndpointSender;
+    struct ReconfigureSender;
     void sendThread();
 
 protected:
     virtual void sendBufferFull(int tries) OVERRIDE FINAL;
+    virtual std::size_t unackedBytes() OVERRIDE FINAL;
 
     /**
      * Called from close(). after start of shutdown (isOpen()==false)
@@ -455,9 +1040,35 @@ protected:
     virtual void internalClose();
 
 private:
+    // thread priority, and the socket options of the class of this priority.  See EPICS_PVA_PRIORITY_*
+    void applyPriority(epics::pvData::int16 priority);
+    // with _ioReactor, progress the TLS handshake of a server connection.  @returns true once established
+    bool continueHandshake();
+    // read() from the socket, TLS session or ring
+    int readStream(epics::pvData::ByteBuffer* dst);
+    // read() with _ioReactor.  Only passes on whole messages, see _rxStage
+    int readFramed(epics::pvData::ByteBuffer* dst);
+    // advance _rxStageScan over the complete frames of _rxStage
+    void scanFrames();
+    // EPICS_PVA_COALESCE_* and EPICS_PVA_COMPRESS_THRESHOLD
+    void configureSending(const Configuration& config);
+
     AtomicValue<bool> _isOpen;
-    epics::pvData::Thread _readThread, _sendThread;
+    // only when !_ioReactor
+    epics::auto_ptr<epics::pvData::Thread> _readThread, _sendThread;
     const SOCKET _channel;
+    // when set, replaces _readThread and _sendThread
+    const IOReactor::shared_pointer _ioReactor;
+    IOReactor::key_type _ioKey;
+    // With _ioReactor, what is read from the socket is held here until it completes a message,
+    // or a segmented message, so that processing never waits for the rest of one.
+    // [_rxStageBegin, _rxStageReady) may be read(), [_rxStageReady, _rxStageScan) are frames of
+    // a segmented message not yet complete, and [_rxStageScan, _rxStageEnd) an incomplete frame.
+    // Only accessed by the receiver
+    std::vector<char> _rxStage;
+    std::size_t _rxStageBegin, _rxStageReady, _rxStageScan, _rxStageEnd;
+    // true while [_rxStageReady, _rxStageScan) ends with a first or middle segment
+    bool _rxStageSegmented;
 protected:
     osiSockAddr _socketAddress;
     std::string _socketName;
@@ -469,16 +1080,88 @@ protected:
 
     SecuritySession::shared_pointer _securitySession;
 
+    // set by create(), before activate()
+    TLSSession::shared_pointer _tls;
+
 private:
 
     ResponseHandler::shared_pointer _responseHandler;
     size_t _remoteTransportReceiveBufferSize;
     epics::pvData::int8 _remoteTransportRevision;
     epics::pvData::int16 _priority;
+    // last given to applyPriority(), which is that of the peer once known
+    epics::pvData::int16 _appliedPriority;
+    // connections of higher priority are not coalesced
+    epics::pvData::int16 _coalesceMaxPriority;
+    // guards the two above, changed by the receiver (setPeerPriority()) and the sender (applyConfiguration())
+    epics::pvData::Mutex _priorityMutex;
 
     bool _verified;
     epics::pvData::Mutex _verifiedMutex;
     epics::pvData::Event _verifiedEvent;
+    // signalled by the receive thread once a TLS handshake has completed, or failed
+    epics::pvData::Event _tlsEvent;
+
+    // ring size offered (client) or accepted (server), zero to disable
+    size_t _shmRingSize;
+    // assigned before _shmRead or _shmWrite are set.  _shmMutex serializes with close()
+    ShmRing::shared_pointer _shm;
+    epics::pvData::Mutex _shmMutex;
+    // read() from _shm, only accessed by the receiver
+    bool _shmRead;
+    // write() to _shm, only changed by the sender
+    bool _shmWrite;
+
+    // ring size offered (client) or accepted (server), zero to disable.  See EPICS_PVA_RDMA_*
+    size_t _rdmaRingSize;
+    std::string _rdmaDevice;
+    int _rdmaGidIndex;
+    // as _shm, _shmRead and _shmWrite.  Only one of _shm or _rdma is set
+    RdmaRing::shared_pointer _rdma;
+    bool _rdmaRead;
+    bool _rdmaWrite;
+
+    // EPICS_PVA_PRIORITY_BUSY_POLL of the current priority, microseconds of non-blocking recv()
+    AtomicValue<int> _rxSpinUS;
+    // EPICS_PVA_PRIORITY_RX_CPU and _TX_CPU, 1+CPU the threads pin themselves to, or 0
+    AtomicValue<int> _rxCPU, _txCPU;
+    // otherwise, see setAffinity()
+    CPUAffinity _affinity;
+
+    // EPICS_PVA_IO_URING, only without _ioReactor or _tls.
+    // Used by _readThread and _sendThread in place of recv() and send()
+    IOUring::shared_pointer _rxRing, _txRing;
+
+    // EPICS_PVA_TRACE
+    bool _tracing;
+    // set when CMD_SET_TRACE is received, if _tracing
+    mutable AtomicValue<bool> _peerTracing;
+    // the last CMD_TRACE_CONTEXT received, valid while the message which follows is processed
+    bool _rxTraced;
+    TraceContext _rxTrace;
+    epicsTimeStamp _rxTraceTime;
+
+    // EPICS_PVA_RX_TIMESTAMPS, SO_TIMESTAMPING is enabled for the socket unless RX_STAMP_NONE
+    RxStampMode _rxStampMode;
+    // when the kernel received the bytes of the last recvStamped(), if _rxKernelValid
+    bool _rxKernelValid;
+    epicsTimeStamp _rxKernelTime;
+    // of the message the receive thread is processing, valid while _rxStamped
+    bool _rxStamped;
+    epicsTimeStamp _rxDispatchTime;
+    // see getReceiveLatency()
+    mutable epics::pvData::Mutex _rxLatencyMutex;
+    LatencyHistogram _rxToDispatch, _rxToResponse;
+
+    // EPICS_PVA_PIPELINE_WINDOW
+    int _pipelineWindow;
+    // client, set when CMD_SET_PIPELINE is received
+    mutable AtomicValue<int> _peerPipelineWindow;
+
+    // CPU time of _readThread and _sendThread
+    ThreadCPUClock _rxClock, _txClock;
+    // EPICS_PVA_CPU_STATS, count CPU time used by the IOReactor on behalf of this transport
+    bool _cpuStats;
 };
 
 class BlockingServerTCPTransportCodec :
@@ -502,13 +1185,15 @@ public:
         SOCKET channel,
         ResponseHandler::shared_pointer const & responseHandler,
         int sendBufferSize,
-        int receiveBufferSize)
+        int receiveBufferSize,
+        TLSSession::shared_pointer const & tls = TLSSession::shared_pointer())
     {
         shared_pointer thisPointer(
             new BlockingServerTCPTransportCodec(
                 context, channel, responseHandler,
                 sendBufferSize, receiveBufferSize)
         );
+        thisPointer->_tls = tls;
         thisPointer->activate();
         return thisPointer;
     }
@@ -540,25 +1225,22 @@ public:
 
     size_t getChannelCount() const;
 
-    virtual bool verify(epics::pvData::int32 timeoutMs) OVERRIDE FINAL {
-
-        TransportSender::shared_pointer transportSender =
-            std::tr1::dynamic_pointer_cast<TransportSender>(shared_from_this());
-        enqueueSendRequest(transportSender);
-
-        bool verifiedStatus = BlockingTCPTransportCodec::verify(timeoutMs);
-
-        enqueueSendRequest(transportSender);
+    /** Send the validation request, without waiting for the client to be validated.
+     *
+     * Validation completes when the security plugin calls authenticationCompleted(),
+     * from the receive thread or one of its own.  The connection is closed if not
+     * validated within timeout seconds, or one second after validation fails,
+     * which holds off a client retrying at a high rate.
+     */
+    void startVerification(double timeout);
 
-        return verifiedStatus;
+    virtual bool verify(epics::pvData::int32 timeoutMs) OVERRIDE FINAL {
+        startVerification(timeoutMs/1000.0);
+        return BlockingTCPTransportCodec::verify(timeoutMs);
     }
 
-    virtual void verified(epics::pvData::Status const & status) OVERRIDE FINAL {
-        _verificationStatusMutex.lock();
-        _verificationStatus = status;
-        _verificationStatusMutex.unlock();
-        BlockingTCPTransportCodec::verified(status);
-    }
+    //! Sends the outcome to the client.  Only the first call has effect.
+    virtual void verified(epics::pvData::Status const & status) OVERRIDE FINAL;
 
     virtual void aliveNotification() OVERRIDE FINAL {
         // noop on server-side
@@ -574,19 +1256,24 @@ public:
 
     virtual ~BlockingServerTCPTransportCodec() OVERRIDE FINAL;
 
+    //! As BlockingTCPTransportCodec::applyConfiguration(), and the slow consumer limits (EPICS_PVAS_MAX_SEND_*)
+    virtual void applyConfiguration() OVERRIDE FINAL;
+
 protected:
 
     void destroyAllChannels();
     virtual void internalClose() OVERRIDE FINAL;
 
 private:
+    // EPICS_PVAS_MAX_SEND_QUEUE, EPICS_PVAS_MAX_SEND_BYTES and EPICS_PVAS_SLOW_CLIENT_POLICY
+    void configureSlowConsumer(const Configuration& config);
 
     /**
     * Last SID cache.
     */
     pvAccessID _lastChannelSID;
 
-    typedef std::map<pvAccessID, std::tr1::shared_ptr<ServerChannel> > _channels_t;
+    typedef IDTable<std::tr1::shared_ptr<ServerChannel> > _channels_t;
     /**
     * Channel table (SID -> channel mapping).
     */
@@ -596,6 +1283,10 @@ private:
 
     epics::pvData::Status _verificationStatus;
     epics::pvData::Mutex _verificationStatusMutex;
+    // set by the first verified(), guarded by _verificationStatusMutex
+    bool _verifyDone;
+
+    struct VerifyTimer;
 
     bool _verifyOrVerified;
 
@@ -635,7 +1326,8 @@ public:
         std::tr1::shared_ptr<ClientChannelImpl> const & client,
         int8_t remoteTransportRevision,
         float heartbeatInterval,
-        int16_t priority )
+        int16_t priority,
+        TLSSession::shared_pointer const & tls = TLSSession::shared_pointer())
     {
         shared_pointer thisPointer(
             new BlockingClientTCPTransportCodec(
@@ -644,6 +1336,7 @@ public:
                 client, remoteTransportRevision,
                 heartbeatInterval, priority)
         );
+        thisPointer->_tls = tls;
         thisPointer->activate();
         return thisPointer;
     }
@@ -666,8 +1359,15 @@ public:
 
     virtual void changedTransport() OVERRIDE FINAL;
 
+    //! An echo reply, or other sign of life
     virtual void aliveNotification() OVERRIDE FINAL;
 
+    /**
+     * Round trip time of echo probes (EPICS_PVA_ECHO_PERIOD), smoothed, in seconds.
+     * @param samples number of replies measured.  0 if none.
+     */
+    void getRoundTripTime(double& rtt, double& rttVar, size_t& samples) const;
+
     virtual void send(epics::pvData::ByteBuffer* buffer,
                       TransportSendControl* control) OVERRIDE FINAL;
 
@@ -693,6 +1393,12 @@ private:
      */
     double _connectionTimeout;
 
+    /**
+     * Probe an idle connection after this many seconds (EPICS_PVA_ECHO_PERIOD).
+     * 0 to probe after 3/4 of _connectionTimeout.
+     */
+    double _echoPeriod;
+
     /**
      * Unresponsive transport flag.
      */
@@ -705,6 +1411,21 @@ private:
 
     bool _verifyOrEcho;
 
+    /**
+     * Echo probe sent, and not yet answered.
+     */
+    bool _echoPending;
+    epicsTimeStamp _echoSent;
+    /**
+     * Smoothed round trip time of echo replies, and its variation.
+     */
+    double _rtt, _rttVar;
+    size_t _rttSamples;
+    /**
+     * TransportStatistics::bytesReceived at the last timer callback.
+     */
+    size_t _lastBytesReceived;
+
     /**
      * Unresponsive transport notify.
      */
@@ -720,7 +1441,7 @@ private:
      */
     void responsiveTransport();
 
-    epics::pvData::Mutex _mutex;
+    mutable epics::pvData::Mutex _mutex;
 };
 
 }
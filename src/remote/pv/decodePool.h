@@ -0,0 +1,91 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef DECODEPOOL_H
+#define DECODEPOOL_H
+
+#include <vector>
+#include <string>
+
+#ifdef epicsExportSharedSymbols
+#   define decodePoolEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/sharedPtr.h>
+#include <pv/pvType.h>
+#include <pv/byteBuffer.h>
+
+#ifdef decodePoolEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef decodePoolEpicsExportSharedSymbols
+#endif
+
+#include <pv/pvaDefs.h>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+namespace detail {
+class AbstractCodec;
+}
+
+/** @brief Threads which deserialize, and handle, the updates received by TCP transports.
+ *
+ * With EPICS_PVA_DECODE_THREADS set, the receive thread of a client transport only frames
+ * each GET or MONITOR update, and post()s a copy of its payload here.  A worker then passes it
+ * to detail::AbstractCodec::processOffloaded(), while the receive thread goes on to the next message.
+ * So the updates received by one transport are deserialized by as many cores as there are workers.
+ *
+ * The updates of one IOID are always given to the same worker, so are handled in the order received.
+ * The callbacks arising from the updates a worker takes together are run together after them,
+ * as by a ReceiveBatch.
+ */
+class epicsShareClass DecodePool
+{
+public:
+    POINTER_DEFINITIONS(DecodePool);
+
+    static size_t num_instances;
+
+    DecodePool(const std::string& name, unsigned nthreads);
+    ~DecodePool();
+
+    //! Stop and join the workers.  Payloads not yet processed are dropped.
+    void close();
+
+    //! Queue the payload of a message received by codec, to be processed after those of ioid already queued.
+    void post(const std::tr1::shared_ptr<detail::AbstractCodec>& codec,
+              pvAccessID ioid,
+              epics::pvData::int8 version,
+              epics::pvData::int8 command,
+              const std::tr1::shared_ptr<epics::pvData::ByteBuffer>& payload);
+
+    //! Wait until the payloads of ioid queued so far have been processed.  Not from a worker.
+    void drain(pvAccessID ioid);
+
+    //! The payload this thread is processing for codec, if a worker, otherwise NULL.
+    static epics::pvData::ByteBuffer* current(const detail::AbstractCodec* codec);
+
+    //! Number of workers
+    size_t size() const { return workers.size(); }
+    //! Payloads processed by all workers
+    size_t processed() const;
+
+private:
+    struct Worker;
+    std::vector<Worker*> workers;
+
+    DecodePool(const DecodePool&);
+    DecodePool& operator=(const DecodePool&);
+};
+
+}
+}
+
+#endif // DECODEPOOL_H
@@ -0,0 +1,126 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef IOREACTOR_H_
+#define IOREACTOR_H_
+
+#include <map>
+#include <vector>
+#include <string>
+
+#ifdef epicsExportSharedSymbols
+#   define ioReactorEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <osiSock.h>
+#include <epicsThread.h>
+
+#include <pv/sharedPtr.h>
+#include <epicsMutex.h>
+
+#ifdef ioReactorEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef ioReactorEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief A small, fixed, pool of threads multiplexing many sockets.
+ *
+ * Used in place of a dedicated receive and send thread for each TCP transport.
+ * Each registered socket is bound to one worker thread, which delivers all
+ * readReady() and writeReady() callbacks for it.  So callbacks for one socket
+ * are never concurrent.
+ *
+ * Readiness is detected with epoll() on Linux, and kqueue() on BSD and OSX.
+ * create() returns NULL on targets with neither.
+ */
+class epicsShareClass IOReactor
+{
+public:
+    POINTER_DEFINITIONS(IOReactor);
+
+    static size_t num_instances;
+    //! worker threads of all instances
+    static size_t num_workers;
+
+    typedef size_t key_type;
+
+    struct Handler {
+        virtual ~Handler() {}
+        //! Socket is readable, has been closed by the peer, or has an error pending.
+        virtual void readReady() =0;
+        //! In response to scheduleWrite(), or once writable after waitWritable()
+        virtual void writeReady() =0;
+    };
+
+    //! @returns true if create() can succeed on this target
+    static bool isSupported();
+
+    //! @returns NULL if not supported
+    static shared_pointer create(const std::string& name, unsigned nthreads);
+
+    ~IOReactor();
+
+    /** Begin watching a socket, which should already be in non-blocking mode.
+     *
+     * @param key Set to the registration key before any callback can be made.
+     * @param handler Stored as a strong reference until remove() or close().
+     */
+    void add(SOCKET sock, const std::tr1::shared_ptr<Handler>& handler, key_type *key);
+    //! Stop watching.  Must be called before the socket is closed.
+    //! Callbacks may still be in progress when this returns.  See sync().
+    void remove(key_type key);
+    //! Request a call to Handler::writeReady().  Repeated calls before the callback are combined.
+    void scheduleWrite(key_type key);
+    /** Request a call to Handler::readReady(), after those of the sockets now ready.
+     * For input already buffered, which won't make the socket readable again.
+     * Repeated calls before the callback are combined.
+     */
+    void scheduleRead(key_type key);
+    /** Request one call to Handler::writeReady() once the socket is writable.
+     * For a non-blocking send() which could not complete.  Repeated calls before the callback are combined.
+     */
+    void waitWritable(key_type key);
+
+    //! Wait until no callback for this key is in progress.  A no-op when called from a callback.
+    void sync(key_type key);
+
+    //! @returns true when called from one of the worker threads
+    bool isWorkerThread() const;
+
+    //! Stop and join all worker threads.  Releases any remaining Handlers.
+    void close();
+
+    size_t size() const;
+    unsigned workerCount() const { return (unsigned)workers.size(); }
+
+    /** Wait for a single socket to become readable or writable.
+     * @returns 1 if ready, 0 on timeout, -1 on error
+     */
+    static int waitFor(SOCKET sock, bool forWrite, double timeout);
+
+    struct Worker;
+private:
+    IOReactor();
+
+    std::vector<std::tr1::shared_ptr<Worker> > workers;
+
+    mutable epicsMutex mutex;
+    key_type nextKey;
+    bool closed;
+
+    Worker& workerFor(key_type key) const;
+};
+
+}
+}
+
+#endif // IOREACTOR_H_
@@ -0,0 +1,111 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <cstddef>
+
+#ifdef epicsExportSharedSymbols
+#   define ioUringEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <osiSock.h>
+
+#include <pv/sharedPtr.h>
+
+#ifdef ioUringEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef ioUringEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+struct iovec;
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief An io_uring submission and completion queue pair for one direction of one socket.
+ *
+ * Replaces the recv() and send() calls of a TCP connection with its own receive and send threads.
+ * Each is used by only one of those threads, which submits one operation and waits for it,
+ * so calls on one IOUring must not be concurrent.
+ *
+ * A buffer given to registerBuffer(), the receive or send buffer of the connection,
+ * is pinned once, instead of for each operation.  A send of at least zeroCopyMin bytes
+ * is zero-copy (IORING_OP_SEND_ZC or IORING_OP_SENDMSG_ZC) where the kernel supports it.
+ * The pages sent are then referenced until the data has been acknowledged,
+ * so send() and sendv() also wait for the kernel to release them before returning.
+ *
+ * Only on Linux, with kernel and headers >= 6.0.  create() returns NULL elsewhere,
+ * or where io_uring is disabled (eg. by seccomp or kernel.io_uring_disabled).
+ */
+class epicsShareClass IOUring
+{
+public:
+    POINTER_DEFINITIONS(IOUring);
+
+    //! @returns true if create() can succeed.  The kernel is probed once.
+    static bool isSupported();
+    //! @returns true if sends can be zero-copy
+    static bool zeroCopySupported();
+
+    //! @returns NULL on failure
+    static shared_pointer create(SOCKET sock);
+
+    ~IOUring();
+
+    //! Register [buf, buf+len), which is afterwards used without pinning it again.  @returns false on failure.
+    bool registerBuffer(char *buf, std::size_t len);
+
+    //! Sends of at least this many bytes are zero-copy.  0 for never.
+    void setZeroCopyMin(std::size_t bytes) { zeroCopyMin = bytes; }
+
+    /** Receive up to count bytes, waiting until some arrive.
+     * @returns as recv(), >0 bytes, 0 when closed by the peer, or -1 with errno set
+     */
+    int recv(char *buf, std::size_t count);
+    /** Send up to count bytes, waiting for socket buffer space.
+     * @returns as send(), bytes sent, or -1 with errno set
+     */
+    int send(const char *buf, std::size_t count);
+    //! As send(), gathering from several buffers
+    int sendv(const struct iovec *iov, std::size_t count);
+
+    /** true while a zero-copy send waits for the kernel to release its pages,
+     * which only happens once the peer acknowledges them, or the connection is reset.
+     * May be called from any thread.
+     */
+    bool zeroCopyPending() const;
+
+    //! Sends which were zero-copy
+    std::size_t zeroCopySends() const { return numZeroCopy; }
+
+    struct Queue;
+private:
+    IOUring();
+
+    int submitAndWait(bool zeroCopy);
+
+    Queue *queue;
+    SOCKET sock;
+    // registered buffer, index 0
+    char *fixedBuf;
+    std::size_t fixedLen;
+    std::size_t zeroCopyMin;
+    std::size_t numZeroCopy;
+    int pending;
+
+    IOUring(const IOUring&);
+    IOUring& operator=(const IOUring&);
+};
+
+}
+}
+
+#endif // IOURING_H
@@ -0,0 +1,126 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef RDMARING_H
+#define RDMARING_H
+
+#include <string>
+
+#ifdef epicsExportSharedSymbols
+#   define rdmaRingEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/sharedPtr.h>
+#include <pv/pvType.h>
+#include <pv/byteBuffer.h>
+
+#ifdef rdmaRingEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef rdmaRingEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief A pair of byte rings between two hosts, written by RDMA (InfiniBand or RoCE).
+ *
+ * Carries the byte stream of one TCP connection in place of the socket, as ShmRing does between
+ * processes on one host.  Each end registers a ring of ringSize bytes, into which the peer
+ * writes with RDMA WRITE, so received data is placed by the adapter without a system call.
+ * Each write carries the count of bytes as immediate data, and the reader returns the count
+ * of those consumed as the immediate data of a SEND, which is the writer's credit.
+ *
+ * Each end create()s a ring, they exchange local() Endpoint s through the TCP connection,
+ * and each connect()s to the other.  One thread waits for completions, so that read() and write()
+ * may wait with a timeout.  A write() of a buffer within the one given to registerSendBuffer()
+ * is sent from it, others are copied to a registered staging buffer first.
+ *
+ * Only when built with WITH_RDMA=YES (libibverbs).  create() returns NULL otherwise,
+ * or without an RDMA device.
+ */
+class epicsShareClass RdmaRing
+{
+public:
+    POINTER_DEFINITIONS(RdmaRing);
+
+    //! What the peer needs to connect to, and write into, one end
+    struct epicsShareClass Endpoint {
+        epics::pvData::uint8 gid[16];
+        epics::pvData::uint16 lid;
+        epics::pvData::uint32 qpn, psn, rkey, size;
+        epics::pvData::uint64 addr;
+
+        //! bytes of serialize()
+        static const std::size_t wireSize = 16u + 2u + 4u*4u + 8u;
+
+        Endpoint();
+        //! No ring.  Sent to refuse
+        bool empty() const { return qpn==0u; }
+        void serialize(epics::pvData::ByteBuffer *buffer) const;
+        void deserialize(epics::pvData::ByteBuffer *buffer);
+    };
+
+    //! @returns true if built with RDMA support, and an RDMA device is present
+    static bool isSupported();
+
+    /** Open a device, and register a ring of ringSize bytes, rounded up to a power of two.
+     * @param device Name of the device, eg. "mlx5_0", or empty for the first one
+     * @param gidIndex GID table index of the address to use, eg. that of RoCE v2
+     * @returns NULL on failure
+     */
+    static shared_pointer create(const std::string& device, int gidIndex, std::size_t ringSize);
+
+    ~RdmaRing();
+
+    const Endpoint& local() const { return localEnd; }
+    //! Connect to the ring of the peer.  @returns false on failure
+    bool connect(const Endpoint& remote);
+
+    //! Register [buf, buf+len), which write() then sends from without a copy.  @returns false on failure.
+    bool registerSendBuffer(char *buf, std::size_t len);
+
+    /** Copy out up to count bytes.  Waits up to timeout seconds if the ring is empty.
+     * @returns >0 bytes read, 0 on timeout, -1 if close()d, or on error.
+     */
+    int read(char* buf, std::size_t count, double timeout);
+    /** Write up to count bytes to the ring of the peer.  Waits up to timeout seconds if it is full.
+     * @returns >0 bytes written, 0 on timeout, -1 if close()d, or on error.
+     */
+    int write(const char* buf, std::size_t count, double timeout);
+
+    //! Mark closed, and wake any reader or writer.  Outstanding operations are flushed.
+    void close();
+    bool isClosed() const;
+
+    std::size_t ringSize() const { return localEnd.size; }
+
+    /** Whether the peer may report count more bytes, written into our ring or consumed from its own,
+     * which moves the free running index from index toward limit.  A peer which reports more than
+     * the ring could hold is misbehaving, and the ring is closed.
+     */
+    static bool validReport(epics::pvData::uint64 index, epics::pvData::uint64 limit, epics::pvData::uint32 count)
+    {
+        return limit >= index && count <= limit - index;
+    }
+
+    struct Verbs;
+private:
+    RdmaRing();
+
+    Verbs *verbs;
+    Endpoint localEnd;
+
+    RdmaRing(const RdmaRing&);
+    RdmaRing& operator=(const RdmaRing&);
+};
+
+}
+}
+
+#endif // RDMARING_H
@@ -0,0 +1,112 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef RECONNECTPACER_H
+#define RECONNECTPACER_H
+
+#include <map>
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define reconnectPacerEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+#include <epicsTime.h>
+
+#include <pv/sharedPtr.h>
+#include <pv/pvType.h>
+
+#ifdef reconnectPacerEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef reconnectPacerEpicsExportSharedSymbols
+#endif
+
+#include <pv/pvaDefs.h>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Orders and spaces the create requests of channels connecting again.
+ *
+ * When a transport closes, each of its channels searches, and would send its create request
+ * as soon as the server answers.  With many channels, the servers are sent all of these at once,
+ * then all of the requests which re-establish their operations.
+ * The client context, with EPICS_PVA_RECONNECT_RATE set, add()s these channels here instead,
+ * and sends the creates take()n periodically.
+ *
+ * Those of the highest priority are taken first, then those with the most operations to re-establish,
+ * then in the order added.  Up to rate() are taken each second.  The rate starts at a quarter of
+ * the maximum, and increases towards it while the server answers creates as quickly as the quickest
+ * answers seen, and is halved, at most once each response time, while it answers twice as slowly.
+ *
+ * Times are passed in, rather than read, so that the pacing can be tested.
+ */
+class epicsShareClass ReconnectPacer
+{
+public:
+    POINTER_DEFINITIONS(ReconnectPacer);
+
+    //! @param maxRate Creates per second at most
+    explicit ReconnectPacer(double maxRate);
+    ~ReconnectPacer();
+
+    //! Queue the create of channel cid.  weight is the number of its operations
+    void add(pvAccessID cid, short priority, size_t weight);
+    //! Append to out the channels whose creates are due by now, which are then waiting for their answer.
+    void take(const epicsTime& now, std::vector<pvAccessID>& out);
+    //! The server answered the create of cid
+    void completed(pvAccessID cid, const epicsTime& now);
+    //! Stop waiting for the answer for cid, eg. having failed or been destroyed
+    void forget(pvAccessID cid);
+
+    //! Creates per second now
+    double rate() const;
+    //! Smoothed response time in seconds, or zero before the first
+    double responseTime() const;
+    //! Channels queued
+    size_t pending() const;
+    //! Creates taken, not yet answered
+    size_t outstanding() const;
+
+private:
+    struct Entry {
+        short priority;
+        size_t weight;
+        epics::pvData::uint64 seq;
+        pvAccessID cid;
+        // heap order, the best at front
+        bool operator<(const Entry& o) const;
+    };
+
+    void adapt(const epicsTime& now, double elapsed);
+
+    const double m_maxRate, m_minRate;
+
+    mutable epicsMutex m_mutex;
+
+    std::vector<Entry> m_heap;
+    epics::pvData::uint64 m_seq;
+
+    typedef std::map<pvAccessID, epicsTime> outstanding_t;
+    outstanding_t m_outstanding;
+
+    double m_rate, m_credit;
+    bool m_idle;
+    epicsTime m_last, m_lastDecrease;
+    double m_srtt, m_baseline;
+
+    ReconnectPacer(const ReconnectPacer&);
+    ReconnectPacer& operator=(const ReconnectPacer&);
+};
+
+}
+}
+
+#endif // RECONNECTPACER_H
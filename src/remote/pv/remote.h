@@ -33,6 +33,8 @@
 #include <pv/configuration.h>
 #include <pv/fairQueue.h>
 #include <pv/pvaDefs.h>
+#include <pv/tracing.h>
+#include <pv/timerWheel.h>
 
 /// TODO only here because of the Lockable
 #include <pv/pvAccess.h>
@@ -79,7 +81,17 @@ enum QoS {
     /**
      * Get-put.
      */
-    QOS_GET_PUT = 0x80
+    QOS_GET_PUT = 0x80,
+    /**
+     * In a CMD_ARRAY get response, more parts of the result follow.
+     * Shares the bit of QOS_BESY_EFFORT, which is not used in responses.
+     */
+    QOS_MORE = 0x02,
+    /**
+     * In a CMD_MONITOR update, arrays are sent as changed ranges.  See ArrayDeltaEncoder.
+     * Shares the bit of QOS_SHARE, which is not used in responses.
+     */
+    QOS_DELTA = 0x20
 };
 
 enum ApplicationCommands {
@@ -105,13 +117,49 @@ enum ApplicationCommands {
     CMD_MULTIPLE_DATA = 19,
     CMD_RPC = 20,
     CMD_CANCEL_REQUEST = 21,
-    CMD_ORIGIN_TAG = 22
+    CMD_ORIGIN_TAG = 22,
+    /* pvAccessCPP extension, only sent to peers which sent CMD_SET_TRACE.
+     * The TraceContext of the get, put or RPC request or response which follows.
+     */
+    CMD_TRACE_CONTEXT = 23,
+    /* pvAccessCPP extension, only sent in reply to CMD_RDMA_OFFER, or to a CMD_RDMA_ENDPOINT.
+     * An RdmaRing::Endpoint, with qpn 0 to refuse.
+     */
+    CMD_RDMA_ENDPOINT = 24
 };
 
 enum ControlCommands {
     CMD_SET_MARKER = 0,
     CMD_ACK_MARKER = 1,
-    CMD_SET_ENDIANESS = 2
+    CMD_SET_ENDIANESS = 2,
+    /* pvAccessCPP extension, ignored by other implementations.
+     * Data is the largest uncompressed segment the sender will accept, or 0.
+     */
+    CMD_SET_COMPRESSION = 0x10,
+    /* pvAccessCPP extension.  Switch a same host connection to a ShmRing.
+     * Client sends OFFER with the ring token.  Server replies ACCEPT with the token (or 0 to refuse),
+     * then sends only through the ring.  Client then sends SWITCH, and thereafter only uses the ring.
+     */
+    CMD_SHM_OFFER = 0x11,
+    CMD_SHM_ACCEPT = 0x12,
+    CMD_SHM_SWITCH = 0x13,
+    /* pvAccessCPP extension, ignored by other implementations.
+     * The sender accepts CMD_TRACE_CONTEXT messages.  Data is 0.
+     */
+    CMD_SET_TRACE = 0x14,
+    /* pvAccessCPP extension.  Switch a connection between hosts to a pair of RdmaRing.
+     * Client sends OFFER, data 0.  Server replies CMD_RDMA_ENDPOINT with its ring.  Client connects,
+     * and replies CMD_RDMA_ENDPOINT with its own.  Server connects, sends SWITCH with data 1
+     * (or 0 to refuse), then sends only through RDMA.  Client then sends SWITCH, and thereafter
+     * only uses RDMA.
+     */
+    CMD_RDMA_OFFER = 0x15,
+    CMD_RDMA_SWITCH = 0x16,
+    /* pvAccessCPP extension, ignored by other implementations.  Sent by a server.
+     * Data is how many get or put requests of one operation the sender accepts outstanding,
+     * which it answers in the order received.  Without it, one at a time.
+     */
+    CMD_SET_PIPELINE = 0x17
 };
 
 /**
@@ -138,8 +186,21 @@ class TransportSender : public Lockable, public fair_queue<TransportSender>::ent
 public:
     POINTER_DEFINITIONS(TransportSender);
 
+    //! Send queue levels, see setQueueLevel().  Lower levels are sent first.
+    enum {
+        LEVEL_URGENT = 0,
+        LEVEL_NORMAL = fair_queue<TransportSender>::defaultLevel,
+        LEVEL_BULK = 2
+    };
+
+    TransportSender() :bytesCounter(NULL) {}
     virtual ~TransportSender() {}
 
+    /** When not NULL, the transport adds here the bytes serialized by each send().
+     * Must stay valid while this sender is queued.
+     */
+    size_t *bytesCounter;
+
     /**
      * Called by transport.
      * By this call transport gives callee ownership over the buffer.
@@ -294,10 +355,64 @@ public:
     virtual void authNZMessage(epics::pvData::PVField::shared_pointer const & data) = 0;
 
     virtual std::tr1::shared_ptr<SecuritySession> getSecuritySession() const = 0;
+
+    //! Tracing is enabled for this connection by EPICS_PVA_TRACE
+    virtual bool isTracing() const { return false; }
+
+    //! The peer accepts CMD_TRACE_CONTEXT ahead of requests or responses
+    virtual bool isPeerTracing() const { return false; }
+
+    /** From the receive thread, while an application message is processed.
+     * @returns true if the message was preceded by a CMD_TRACE_CONTEXT, with its content
+     *          and when it was received.
+     */
+    virtual bool receivedTrace(TraceContext& context, epicsTimeStamp& received) const {
+        (void)context; (void)received;
+        return false;
+    }
+
+    /** From the receive thread, while an application message is processed.
+     * @returns true if receive timestamps are enabled for this connection (EPICS_PVA_RX_TIMESTAMPS),
+     *          and the kernel gave one for the message, with it and when the message was dispatched.
+     */
+    virtual bool receivedAt(epicsTimeStamp& kernel, epicsTimeStamp& dispatch) const {
+        (void)kernel; (void)dispatch;
+        return false;
+    }
+
+    //! Count the time since dispatch, from receivedAt(), until the response to a request is sent
+    virtual void responseSent(const epicsTimeStamp& dispatch) { (void)dispatch; }
+
+    /** How many get or put requests of one operation may be outstanding on this connection.
+     * Server, the number it accepts.  Client, the lesser of its own and that of the server.
+     */
+    virtual int getPipelineWindow() const { return 1; }
 };
 
 class Channel;
 class SecurityPlugin;
+class IOReactor;
+class DecodePool;
+
+/**
+ * Load advertised in the beacons of a server, see DefaultBeaconServerStatusProvider.
+ */
+struct ServerLoad {
+    epics::pvData::int32 connections;
+    double cpu;
+    epics::pvData::int32 queueDepth;
+
+    ServerLoad() :connections(0), cpu(0.0), queueDepth(0) {}
+
+    //! Less loaded.  Compares queue depth, then CPU, then connections.
+    bool operator<(const ServerLoad& o) const {
+        if(queueDepth!=o.queueDepth)
+            return queueDepth < o.queueDepth;
+        if(cpu!=o.cpu)
+            return cpu < o.cpu;
+        return connections < o.connections;
+    }
+};
 
 /**
  * Not public IF, used by Transports, etc.
@@ -308,7 +423,7 @@ public:
 
     virtual ~Context() {}
 
-    virtual epics::pvData::Timer::shared_pointer getTimer() = 0;
+    virtual TimerWheel::shared_pointer getTimer() = 0;
 
     virtual TransportRegistry* getTransportRegistry() = 0;
 
@@ -330,9 +445,32 @@ public:
     ///
 
     virtual void newServerDetected() = 0;
+    /**
+     * A beacon shows a server started, or restarted with a new GUID.
+     * @param responseFrom remote source address of received beacon.
+     */
+    virtual void serverRestarted(const osiSockAddr& /*responseFrom*/) {}
+    /**
+     * Load recently advertised by a server.
+     * @param serverAddress TCP address of the server.
+     * @return false if unknown.
+     */
+    virtual bool getServerLoad(const osiSockAddr& /*serverAddress*/, ServerLoad& /*load*/) { return false; }
 
     virtual std::tr1::shared_ptr<Channel> getChannel(pvAccessID id) = 0;
     virtual Transport::shared_pointer getSearchTransport() = 0;
+
+    /**
+     * Shared I/O threads for TCP transports.
+     * @return NULL if each transport should start its own receive and send threads.
+     */
+    virtual std::tr1::shared_ptr<IOReactor> getIOReactor() { return std::tr1::shared_ptr<IOReactor>(); }
+
+    /**
+     * Threads which deserialize the updates received by TCP transports.
+     * @return NULL if each transport deserializes what it receives.
+     */
+    virtual std::tr1::shared_ptr<DecodePool> getDecodePool() { return std::tr1::shared_ptr<DecodePool>(); }
 };
 
 /**
@@ -14,6 +14,7 @@
 
 #include <string>
 #include <osiSock.h>
+#include <epicsMutex.h>
 
 #include <pv/status.h>
 #include <pv/pvData.h>
@@ -111,6 +112,95 @@ public:
     virtual epics::pvData::Status authorizeGetField(pvAccessID ioid, std::string const & subField) = 0;
 };
 
+/** @brief Remembers the decisions of another ChannelSecuritySession for each operation.
+ *
+ * The decision to allow, or deny, each execution of a process, get, put, putGet, rpc or monitor,
+ * and of an array put or set length, is asked of the wrapped session once, then reused by
+ * all requests of the channel until rightsChanged() or rightsChangedAll().
+ * Decisions to create requests, and get field, are always passed through.
+ *
+ * Decisions are reused without regard to the ioid, or to the data put or RPC arguments,
+ * so only sessions which decide by client and channel should be wrapped.
+ * The server wraps the sessions of all plugins other than "none" when EPICS_PVAS_AUTHZ_CACHE=YES.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass CachingChannelSecuritySession : public ChannelSecuritySession {
+public:
+    POINTER_DEFINITIONS(CachingChannelSecuritySession);
+
+    enum operation_t {
+        opProcess, opGet, opPut, opPutGet, opRPC, opMonitor, opArrayPut, opSetLength,
+        numOperations
+    };
+
+    explicit CachingChannelSecuritySession(ChannelSecuritySession::shared_pointer const & session);
+    virtual ~CachingChannelSecuritySession();
+
+    //! Forget the decisions of this session, eg. when the rights of its client change.  Any thread.
+    void rightsChanged();
+    //! Forget the decisions of all sessions, eg. after the access rules are reloaded.  Any thread.
+    static void rightsChangedAll();
+
+    const ChannelSecuritySession::shared_pointer& getSession() const { return session; }
+
+    //! Decisions asked of the wrapped session, and those reused
+    void getCounts(size_t& lookups, size_t& hits) const;
+
+    virtual void close();
+    virtual void release(pvAccessID ioid);
+
+    virtual epics::pvData::Status authorizeCreateChannelProcess(
+        pvAccessID ioid, epics::pvData::PVStructure::shared_pointer const & pvRequest);
+    virtual epics::pvData::Status authorizeProcess(pvAccessID ioid);
+    virtual epics::pvData::Status authorizeCreateChannelGet(
+        pvAccessID ioid, epics::pvData::PVStructure::shared_pointer const & pvRequest);
+    virtual epics::pvData::Status authorizeGet(pvAccessID ioid);
+    virtual epics::pvData::Status authorizeCreateChannelPut(
+        pvAccessID ioid, epics::pvData::PVStructure::shared_pointer const & pvRequest);
+    virtual epics::pvData::Status authorizePut(
+        pvAccessID ioid,
+        epics::pvData::PVStructure::shared_pointer const & dataToPut,
+        epics::pvData::BitSet::shared_pointer const & fieldsToPut);
+    virtual epics::pvData::Status authorizeCreateChannelPutGet(
+        pvAccessID ioid, epics::pvData::PVStructure::shared_pointer const & pvRequest);
+    virtual epics::pvData::Status authorizePutGet(
+        pvAccessID ioid,
+        epics::pvData::PVStructure::shared_pointer const & dataToPut,
+        epics::pvData::BitSet::shared_pointer const & fieldsToPut);
+    virtual epics::pvData::Status authorizeCreateChannelRPC(
+        pvAccessID ioid, epics::pvData::PVStructure::shared_pointer const & pvRequest);
+    virtual epics::pvData::Status authorizeRPC(
+        pvAccessID ioid, epics::pvData::PVStructure::shared_pointer const & arguments);
+    virtual epics::pvData::Status authorizeCreateMonitor(
+        pvAccessID ioid, epics::pvData::PVStructure::shared_pointer const & pvRequest);
+    virtual epics::pvData::Status authorizeMonitor(pvAccessID ioid);
+    virtual epics::pvData::Status authorizeCreateChannelArray(
+        pvAccessID ioid, epics::pvData::PVStructure::shared_pointer const & pvRequest);
+    virtual epics::pvData::Status authorizePut(pvAccessID ioid, epics::pvData::PVArray::shared_pointer const & dataToPut);
+    virtual epics::pvData::Status authorizeSetLength(pvAccessID ioid);
+    virtual epics::pvData::Status authorizeGetField(pvAccessID ioid, std::string const & subField);
+
+private:
+    // true, and the decision, if known.  Otherwise the generation to pass to store()
+    bool lookup(operation_t op, epics::pvData::Status& status, unsigned& generation);
+    void store(operation_t op, const epics::pvData::Status& status, unsigned generation);
+
+    const ChannelSecuritySession::shared_pointer session;
+
+    mutable epicsMutex mutex;
+    // incremented whenever decisions are forgotten
+    unsigned generation;
+    // value of the process wide generation when decisions were last forgotten
+    int seenAll;
+    bool known[numOperations];
+    epics::pvData::Status decisions[numOperations];
+    size_t lookups, hits;
+
+    CachingChannelSecuritySession(const CachingChannelSecuritySession&);
+    CachingChannelSecuritySession& operator=(const CachingChannelSecuritySession&);
+};
+
 class SecurityPlugin;
 
 class SecurityException: public std::runtime_error {
@@ -132,6 +222,9 @@ public:
     virtual std::tr1::shared_ptr<SecurityPlugin> getSecurityPlugin() = 0;
 
     // can be called any time, for any reason
+    // called by the receive thread of the connection, so must not block.
+    // Slow checks (eg. a token validated by a remote server) should be done by a thread
+    // of the plugin, which calls SecurityPluginControl::authenticationCompleted() when done.
     virtual void messageReceived(epics::pvData::PVField::shared_pointer const & data) = 0;
 
     /// closes this session
@@ -153,6 +246,8 @@ public:
     // if Status.isSuccess() == false,
     // pvAccess will send status to the client and close the connection
     // can be called more then once (in case of re-authentication process)
+    // may be called from any thread.  On the server, the connection waits for the first call,
+    // up to a timeout, without holding up other connections.
     virtual void authenticationCompleted(epics::pvData::Status const & status) = 0;
 };
 
@@ -195,6 +290,8 @@ public:
     // later on authentication process can be repeated
     // the server and the client can exchange (arbitrary number) of messages using SecurityPluginControl.sendMessage()
     // the process completion must be notified by calling AuthenticationControl.completed()
+    // called by the receive thread of the connection, so must not block.  Completion may be
+    // notified later, by another thread.
     virtual SecuritySession::shared_pointer createSession(
         osiSockAddr const & remoteAddress,
         SecurityPluginControl::shared_pointer const & control,
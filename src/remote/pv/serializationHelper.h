@@ -83,6 +83,19 @@ public:
      */
     static void serializeFull(epics::pvData::ByteBuffer* buffer, epics::pvData::SerializableControl* control, epics::pvData::PVField::shared_pointer const & pvField);
 
+    /**
+     * Whether field is, or contains, a union, or an array of unions.
+     * The values of a variant union carry their own type.
+     */
+    static bool hasUnion(const epics::pvData::Field& field);
+
+    /**
+     * Copy count elements of elementSize (1, 2, 4, or 8) bytes, reversing the byte order of each.
+     * Uses SSSE3, AVX2, or NEON when enabled by the compiler.  dst may equal src.
+     * Receives NTScalarArray values sent in the other byte order, see FastLayout.
+     */
+    static void copySwapped(char* dst, const char* src, std::size_t count, std::size_t elementSize);
+
 };
 
 }
@@ -0,0 +1,104 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <string>
+
+#ifdef epicsExportSharedSymbols
+#   define shmRingEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/sharedPtr.h>
+#include <pv/pvType.h>
+
+#ifdef shmRingEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef shmRingEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief A pair of single producer, single consumer, byte rings in memory shared by two processes.
+ *
+ * Carries the byte stream of one TCP connection between a client and server on the same host,
+ * in place of the socket.  The client create()s the segment and passes the token to the server,
+ * which open()s it.  One ring carries data from client to server, the other from server to client.
+ *
+ * A blocked reader or writer waits on a futex in the shared segment.
+ *
+ * Only available on Linux.  create() and open() return NULL elsewhere.
+ */
+class epicsShareClass ShmRing
+{
+public:
+    POINTER_DEFINITIONS(ShmRing);
+
+    //! @returns true if create() can succeed on this target
+    static bool isSupported();
+
+    /** Create a new segment with two rings of ringSize bytes, rounded up to a power of two.
+     * Its pages are allocated, so fails if /dev/shm is too full.
+     * @param token Set to the value which the peer should pass to open()
+     * @returns NULL on failure, when the connection stays on its socket
+     */
+    static shared_pointer create(std::size_t ringSize, epics::pvData::uint32 *token);
+    /** Map a segment created by the peer, and remove its name.
+     * @returns NULL on failure
+     */
+    static shared_pointer open(epics::pvData::uint32 token);
+
+    ~ShmRing();
+
+    /** Copy out up to count bytes.  Waits up to timeout seconds if the ring is empty.
+     * @returns >0 bytes read, 0 on timeout, -1 if close()d by either side.
+     *          Also closes, and returns -1, if the peer has moved the indices of the ring
+     *          further apart than its size.
+     */
+    int read(char* buf, std::size_t count, double timeout);
+    /** Copy in up to count bytes.  Waits up to timeout seconds if the ring is full.
+     * @returns >0 bytes written, 0 on timeout, -1 if close()d by either side,
+     *          or the indices are invalid, as for read().
+     */
+    int write(const char* buf, std::size_t count, double timeout);
+
+    //! Mark closed, and wake any reader or writer blocked on either side.
+    void close();
+    bool isClosed() const;
+
+    std::size_t ringSize() const { return size; }
+
+    //! Remove the name of the segment, once the peer has answered.  Also done by open() and the destructor.
+    void unlink();
+
+    struct Ring;
+private:
+    ShmRing(bool creator, epics::pvData::uint32 token);
+
+    const bool creator;
+    const epics::pvData::uint32 token;
+    // name is removed once the peer has mapped the segment
+    bool unlinked;
+    void *base;
+    std::size_t mapSize, size;
+    // creator writes rings[0] and reads rings[1]
+    Ring *tx, *rx;
+    char *txData, *rxData;
+    epics::pvData::int32 *closed;
+
+    ShmRing(const ShmRing&);
+    ShmRing& operator=(const ShmRing&);
+};
+
+}
+}
+
+#endif // SHMRING_H
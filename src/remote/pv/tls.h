@@ -0,0 +1,191 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef TLS_H
+#define TLS_H
+
+#include <string>
+
+#ifdef epicsExportSharedSymbols
+#   define tlsEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <osiSock.h>
+#include <epicsMutex.h>
+
+#include <pv/sharedPtr.h>
+
+#ifdef tlsEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef tlsEpicsExportSharedSymbols
+#endif
+
+#include <pv/pvAccess.h>
+#include <pv/security.h>
+#include <pv/configuration.h>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+class TLSSession;
+
+/** @brief Certificates and session cache shared by all TLS connections of a client or server context.
+ *
+ * Only available when built with WITH_OPENSSL=YES.  See CONFIG_SITE.
+ *
+ * A server uses TLS for every accepted connection when EPICS_PVAS_TLS_CERT names a PEM file
+ * holding its certificate chain.  The private key is read from EPICS_PVAS_TLS_KEY, or the same file.
+ * When EPICS_PVAS_TLS_CA is also set, clients are asked for a certificate signed by one of these CAs.
+ * Session tickets are encrypted with the (48 or 80 byte) key read from EPICS_PVAS_TLS_TICKET_KEY,
+ * or a random one.  A fixed key allows clients to resume their sessions after a server restart.
+ *
+ * A client uses TLS for every connection when EPICS_PVA_TLS_CA names the CAs to trust.
+ * A client certificate may be given with EPICS_PVA_TLS_CERT and EPICS_PVA_TLS_KEY.
+ * Sessions are cached by server address, and resumed on reconnect.
+ *
+ * Where OpenSSL and the kernel support it, record encryption is handed to the kernel (kTLS)
+ * unless EPICS_PVA_TLS_KTLS=NO.
+ */
+class epicsShareClass TLSContext
+{
+public:
+    POINTER_DEFINITIONS(TLSContext);
+
+    //! @returns true if create() can succeed on this target
+    static bool isSupported();
+
+    /** @returns NULL if TLS is not configured or not supported
+     * @throws std::runtime_error if configured, but certificates or keys can not be loaded.
+     */
+    static shared_pointer create(const Configuration::const_shared_pointer& conf, bool server);
+
+    ~TLSContext();
+
+    /** Perform the TLS handshake on a newly connected socket, and place it in non-blocking mode.
+     *
+     * @returns NULL if the handshake fails or does not complete within timeout seconds.
+     */
+    std::tr1::shared_ptr<TLSSession> handshake(SOCKET sock, const osiSockAddr& peer, double timeout);
+
+    /** Begin a session on a newly connected socket, and place it in non-blocking mode.
+     * The handshake is left to TLSSession::handshake() or TLSSession::continueHandshake(),
+     * so that it may be done by the thread which will service the connection.
+     *
+     * @returns NULL on failure
+     */
+    std::tr1::shared_ptr<TLSSession> startSession(SOCKET sock, const osiSockAddr& peer);
+
+    bool isServer() const { return server; }
+    //! true if a certificate is presented to the peer
+    bool hasCertificate() const { return haveCert; }
+
+    //! Handshakes which resumed a previous session
+    size_t numResumed() const;
+    //! Handshakes which did not
+    size_t numFull() const;
+
+    struct Pvt;
+private:
+    TLSContext(bool server);
+
+    const bool server;
+    bool haveCert;
+    epics::auto_ptr<Pvt> pvt;
+};
+
+/** @brief One TLS connection.
+ *
+ * read() and write() may only be called once established(),
+ * and then may be called concurrently from different threads.
+ * Both return immediately, as with a non-blocking socket.
+ */
+class epicsShareClass TLSSession
+{
+public:
+    POINTER_DEFINITIONS(TLSSession);
+
+    ~TLSSession();
+
+    /** Progress the handshake as far as possible without waiting.
+     * @returns 1 once established, 0 to call again when the socket is readable,
+     *          or writable if wantWrite(), -1 on failure.
+     */
+    int continueHandshake();
+    //! After continueHandshake() returns 0, true to wait for the socket to be writable
+    bool wantWrite() const;
+    /** Wait for the handshake to complete.
+     * @returns false if it fails or does not complete within timeout seconds.
+     */
+    bool handshake(double timeout);
+    //! true once the handshake has completed.  Until then, the accessors below are not valid
+    bool established() const;
+
+    //! @returns >0 bytes read, 0 if no data is available yet, -1 on error or close by peer
+    int read(char* buf, std::size_t count);
+    //! @returns >0 bytes written, 0 if the socket is not writable, -1 on error.
+    //! After 0, the next call must offer the same bytes again.
+    int write(const char* buf, std::size_t count);
+
+    //! true if decrypted data is buffered, which read() will return without the socket being readable
+    bool pending() const;
+
+    //! true if this session was resumed, without a full handshake
+    bool resumed() const { return isResumed; }
+    //! true if records are encrypted (send) or decrypted (recv) by the kernel
+    bool kernelSend() const { return ktlsSend; }
+    bool kernelRecv() const { return ktlsRecv; }
+    //! Common name of the verified peer certificate.  Empty if the peer presented none.
+    const std::string& peerName() const { return peer; }
+    const std::string& cipherName() const { return cipher; }
+
+    struct Pvt;
+private:
+    friend class TLSContext;
+    TLSSession();
+
+    mutable epicsMutex mutex;
+    bool isEstablished, isResumed, ktlsSend, ktlsRecv;
+    std::string peer, cipher;
+    epics::auto_ptr<Pvt> pvt;
+};
+
+/** @brief The "x509" authentication plug-in.
+ *
+ * Installed when a TLS client or server context has a certificate.
+ * The server accepts a client using it only on a TLS connection
+ * where the client presented a verified certificate.  See TLSSession::peerName().
+ */
+class epicsShareClass X509SecurityPlugin : public NoSecurityPlugin
+{
+protected:
+    explicit X509SecurityPlugin(bool server) :server(server) {}
+    const bool server;
+public:
+    POINTER_DEFINITIONS(X509SecurityPlugin);
+
+    static shared_pointer CLIENT, SERVER;
+
+    virtual std::string getId() const OVERRIDE {
+        return "x509";
+    }
+
+    virtual std::string getDescription() const OVERRIDE {
+        return "TLS client certificate";
+    }
+
+    virtual SecuritySession::shared_pointer createSession(
+        osiSockAddr const & remoteAddress,
+        SecurityPluginControl::shared_pointer const & control,
+        epics::pvData::PVField::shared_pointer const & data) OVERRIDE;
+};
+
+}
+}
+
+#endif // TLS_H
@@ -0,0 +1,107 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef TRAFFICCAPTURE_H
+#define TRAFFICCAPTURE_H
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define trafficCaptureEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsTime.h>
+
+#include <pv/sharedPtr.h>
+#include <pv/pvType.h>
+
+#ifdef trafficCaptureEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef trafficCaptureEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Records the bytes received by one TCP transport, with the time each read returned.
+ *
+ * Enabled for all transports of a context by setting EPICS_PVA_CAPTURE_DIR to a directory,
+ * in which each transport creates "<server|client>-<peer address>-<n>.pvacap".
+ * Bytes are recorded as read(), after TLS, and before decompression,
+ * so a capture replays the stream the peer sent.  See TrafficReplay and pvreplay.
+ *
+ * The file starts with "PVAR", a version byte (1), a byte which is 1 if the bytes were
+ * received by a server (ie. sent by a client), and the peer address as a uint16 length and characters.
+ * Then one record for each read: uint32 seconds past the EPICS epoch, uint32 nanoseconds,
+ * uint32 count, and count bytes.  All integers are big endian.
+ *
+ * Only the receiving thread of the transport write()s.
+ */
+class epicsShareClass TrafficCapture
+{
+public:
+    POINTER_DEFINITIONS(TrafficCapture);
+
+    /** Create a new capture file in dir.
+     * @returns NULL, having logged why, if it can't be created
+     */
+    static shared_pointer create(const std::string& dir, bool server, const std::string& peer);
+    ~TrafficCapture();
+
+    //! Append count bytes, received now
+    void write(const char* buf, std::size_t count);
+
+    const std::string& path() const { return fname; }
+
+private:
+    TrafficCapture(FILE *fp, const std::string& fname);
+
+    FILE *fp;
+    const std::string fname;
+    bool failed;
+
+    TrafficCapture(const TrafficCapture&);
+    TrafficCapture& operator=(const TrafficCapture&);
+};
+
+/** @brief Reads back the records of a TrafficCapture.
+ */
+class epicsShareClass TrafficReplay
+{
+public:
+    //! Throws std::runtime_error if path can't be opened, or is not a capture
+    explicit TrafficReplay(const std::string& path);
+    ~TrafficReplay();
+
+    //! true if the bytes were received by a server, so are to be sent to one
+    bool server() const { return isServer; }
+    //! Address of the peer which sent the bytes
+    const std::string& peer() const { return peerName; }
+
+    /** Read the next record.
+     * @returns false at end of input.  Throws std::runtime_error if the last record is truncated.
+     */
+    bool next(epicsTimeStamp& received, std::vector<char>& data);
+
+private:
+    FILE *fp;
+    bool isServer;
+    std::string peerName;
+
+    TrafficReplay(const TrafficReplay&);
+    TrafficReplay& operator=(const TrafficReplay&);
+};
+
+}
+}
+
+#endif // TRAFFICCAPTURE_H
@@ -10,6 +10,7 @@
 #include <map>
 #include <vector>
 #include <list>
+#include <string>
 #include <iostream>
 
 #ifdef epicsExportSharedSymbols
@@ -31,6 +32,7 @@
 
 #include <pv/remote.h>
 #include <pv/inetAddressUtil.h>
+#include <pv/stripedLock.h>
 
 namespace epics {
 namespace pvAccess {
@@ -44,10 +46,20 @@ private:
         epics::pvData::int16 prio;
         Key(const osiSockAddr& a, epics::pvData::int16 p) :addr(a), prio(p) {}
         bool operator<(const Key& o) const;
+        bool operator==(const Key& o) const;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const;
     };
 
     typedef std::map<Key, Transport::shared_pointer> transports_t;
-    typedef std::map<Key, std::tr1::shared_ptr<epics::pvData::Mutex> > locks_t;
+    typedef StripedLock<Key, KeyHash> locks_t;
+
+    struct Failure {
+        std::string message;
+        size_t seq;
+    };
+    typedef std::map<Key, Failure> failures_t;
 
 public:
     POINTER_DEFINITIONS(TransportRegistry);
@@ -57,15 +69,22 @@ public:
     class Reservation {
         TransportRegistry* const owner;
         const Key key;
-        std::tr1::shared_ptr<epics::pvData::Mutex> mutex;
+        size_t startSeq;
     public:
 
         // ctor blocks until no concurrent connect() in progress (success or failure)
         Reservation(TransportRegistry *owner, const osiSockAddr& address, epics::pvData::int16 prio);
         ~Reservation();
+
+        /** True if a connect() to this destination failed while we waited for it,
+         *  in which case its error is stored in msg.  The caller should not retry.
+         */
+        bool sharedFailure(std::string& msg) const;
+        //! Record that our connect() failed, so that all those waiting now fail as well.
+        void failed(const std::string& msg);
     };
 
-    TransportRegistry() {}
+    TransportRegistry() :failSeq(0u), inflight(0u) {}
     ~TransportRegistry();
 
     Transport::shared_pointer get(const osiSockAddr& address, epics::pvData::int16 prio);
@@ -79,8 +98,11 @@ public:
 
 private:
     transports_t transports;
-    // per destination mutex to serialize concurrent connect() attempts
+    // per destination lock to serialize concurrent connect() attempts
     locks_t locks;
+    // failed connect() attempts, remembered while any Reservation is in progress
+    failures_t failures;
+    size_t failSeq, inflight;
 
     epics::pvData::Mutex _mutex;
 };
@@ -0,0 +1,636 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <algorithm>
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsTime.h>
+
+#ifdef PVA_HAVE_RDMA
+#  include <infiniband/verbs.h>
+#  include <arpa/inet.h>
+#  include <fcntl.h>
+#  include <poll.h>
+#endif
+
+#define epicsExportSharedSymbols
+#include <pv/rdmaRing.h>
+#include <pv/logger.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+using epics::pvData::uint8;
+using epics::pvData::uint32;
+using epics::pvData::uint64;
+
+namespace epics {
+namespace pvAccess {
+
+RdmaRing::Endpoint::Endpoint()
+    :lid(0u), qpn(0u), psn(0u), rkey(0u), size(0u), addr(0u)
+{
+    memset(gid, 0, sizeof(gid));
+}
+
+void RdmaRing::Endpoint::serialize(epics::pvData::ByteBuffer *buffer) const
+{
+    buffer->put((const char*)gid, 0, sizeof(gid));
+    buffer->putShort(epics::pvData::int16(lid));
+    buffer->putInt(epics::pvData::int32(qpn));
+    buffer->putInt(epics::pvData::int32(psn));
+    buffer->putInt(epics::pvData::int32(rkey));
+    buffer->putInt(epics::pvData::int32(size));
+    buffer->putLong(epics::pvData::int64(addr));
+}
+
+void RdmaRing::Endpoint::deserialize(epics::pvData::ByteBuffer *buffer)
+{
+    buffer->get((char*)gid, 0, sizeof(gid));
+    lid = epics::pvData::uint16(buffer->getShort());
+    qpn = uint32(buffer->getInt());
+    psn = uint32(buffer->getInt());
+    rkey = uint32(buffer->getInt());
+    size = uint32(buffer->getInt());
+    addr = uint64(buffer->getLong());
+}
+
+#ifdef PVA_HAVE_RDMA
+
+namespace {
+// receives posted for the immediate data of the peer's writes and credits
+const int RECV_DEPTH = 64;
+const int SEND_DEPTH = 16;
+const int CQ_DEPTH = RECV_DEPTH + SEND_DEPTH;
+// copied into before sending, when not from the registered send buffer
+const std::size_t STAGE_SIZE = 256u*1024u;
+const uint8 PORT = 1u;
+
+enum { WR_DATA = 1, WR_CREDIT = 2 };
+
+epicsThreadOnceId probeOnce = EPICS_THREAD_ONCE_INIT;
+bool haveDevice;
+
+void probeDevices(void *)
+{
+    int count = 0;
+    ibv_device **list = ibv_get_device_list(&count);
+    haveDevice = list && count>0;
+    if(list)
+        ibv_free_device_list(list);
+}
+}
+
+struct RdmaRing::Verbs : public epicsThreadRunable
+{
+    ibv_context *ctx;
+    ibv_pd *pd;
+    ibv_comp_channel *channel;
+    ibv_cq *cq;
+    ibv_qp *qp;
+    ibv_mr *ringMr, *stageMr, *sendMr;
+    char *ring, *stage;
+    std::size_t size;
+    int gidIndex;
+    ibv_mtu mtu;
+
+    // the ring of the peer
+    uint64 remoteAddr;
+    uint32 remoteKey;
+    std::size_t remoteSize;
+
+    epicsMutex mutex;
+    epicsEvent rxWakeup, txWakeup;
+    bool closed, connected;
+    // free running byte counts.  Written by the peer into ring, and consumed by read()
+    uint64 rxHead, rxTail;
+    // consumed and not yet credited to the peer
+    std::size_t unreported;
+    // written to the ring of the peer, and consumed there
+    uint64 txHead, txAcked;
+    // signalled writes posted, and completed
+    uint64 txPosted, txDone;
+
+    epicsThread thread;
+    bool started;
+
+    Verbs()
+        :ctx(0), pd(0), channel(0), cq(0), qp(0)
+        ,ringMr(0), stageMr(0), sendMr(0)
+        ,ring(0), stage(0)
+        ,size(0u), gidIndex(0), mtu(IBV_MTU_1024)
+        ,remoteAddr(0u), remoteKey(0u), remoteSize(0u)
+        ,closed(false), connected(false)
+        ,rxHead(0u), rxTail(0u), unreported(0u)
+        ,txHead(0u), txAcked(0u)
+        ,txPosted(0u), txDone(0u)
+        ,thread(*this, "rdma-cq", epicsThreadGetStackSize(epicsThreadStackSmall), epicsThreadPriorityCAServerLow)
+        ,started(false)
+    {}
+
+    virtual ~Verbs()
+    {
+        if(started)
+            thread.exitWait();
+        if(qp)
+            ibv_destroy_qp(qp);
+        if(sendMr)
+            ibv_dereg_mr(sendMr);
+        if(stageMr)
+            ibv_dereg_mr(stageMr);
+        if(ringMr)
+            ibv_dereg_mr(ringMr);
+        if(cq)
+            ibv_destroy_cq(cq);
+        if(channel)
+            ibv_destroy_comp_channel(channel);
+        if(pd)
+            ibv_dealloc_pd(pd);
+        if(ctx)
+            ibv_close_device(ctx);
+        free(ring);
+        free(stage);
+    }
+
+    bool postRecv()
+    {
+        ibv_recv_wr wr, *bad = 0;
+        memset(&wr, 0, sizeof(wr));
+        // only the immediate data is received
+        wr.num_sge = 0;
+        return ibv_post_recv(qp, &wr, &bad)==0;
+    }
+
+    // call with mutex locked
+    void postCredit()
+    {
+        ibv_send_wr wr, *bad = 0;
+        memset(&wr, 0, sizeof(wr));
+        wr.wr_id = WR_CREDIT;
+        wr.opcode = IBV_WR_SEND_WITH_IMM;
+        wr.send_flags = IBV_SEND_SIGNALED;
+        wr.imm_data = htonl(uint32(unreported));
+        wr.num_sge = 0;
+        // on failure, retried by the next read()
+        if(ibv_post_send(qp, &wr, &bad)==0)
+            unreported = 0u;
+    }
+
+    void stop()
+    {
+        {
+            Guard G(mutex);
+            closed = true;
+        }
+        rxWakeup.signal();
+        txWakeup.signal();
+    }
+
+    // waits for completions
+    virtual void run()
+    {
+        while(true) {
+            {
+                Guard G(mutex);
+                if(closed)
+                    break;
+            }
+
+            // non-blocking, so that close() is noticed even if the QP could not be flushed
+            pollfd pfd;
+            pfd.fd = channel->fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if(::poll(&pfd, 1, 1000)<=0)
+                continue;
+
+            ibv_cq *evcq = 0;
+            void *evctx = 0;
+            if(ibv_get_cq_event(channel, &evcq, &evctx))
+                continue;
+            ibv_ack_cq_events(evcq, 1u);
+            if(ibv_req_notify_cq(cq, 0)) {
+                LOG(logLevelError, "RDMA unable to request completion notification");
+                stop();
+                break;
+            }
+
+            bool rx = false, tx = false, failed = false;
+            ibv_wc wc[16];
+            int n;
+            while((n = ibv_poll_cq(cq, 16, wc))>0) {
+                Guard G(mutex);
+                for(int i=0; i<n; i++) {
+                    if(wc[i].status!=IBV_WC_SUCCESS) {
+                        if(wc[i].status!=IBV_WC_WR_FLUSH_ERR)
+                            LOG(logLevelDebug, "RDMA completion error: %s", ibv_wc_status_str(wc[i].status));
+                        failed = true;
+                        continue;
+                    }
+                    switch(wc[i].opcode) {
+                    case IBV_WC_RECV_RDMA_WITH_IMM: // data written into ring
+                        if(!validReport(rxHead, rxTail+size, ntohl(wc[i].imm_data))) {
+                            LOG(logLevelError, "RDMA peer wrote %u bytes, more than the ring has space for",
+                                unsigned(ntohl(wc[i].imm_data)));
+                            failed = true;
+                            continue;
+                        }
+                        rxHead += ntohl(wc[i].imm_data);
+                        rx = true;
+                        failed |= !postRecv();
+                        break;
+                    case IBV_WC_RECV: // credit
+                        if(!validReport(txAcked, txHead, ntohl(wc[i].imm_data))) {
+                            LOG(logLevelError, "RDMA peer credited %u bytes, more than were written",
+                                unsigned(ntohl(wc[i].imm_data)));
+                            failed = true;
+                            continue;
+                        }
+                        txAcked += ntohl(wc[i].imm_data);
+                        tx = true;
+                        failed |= !postRecv();
+                        break;
+                    case IBV_WC_RDMA_WRITE:
+                        txDone++;
+                        tx = true;
+                        break;
+                    default:
+                        break;
+                    }
+                }
+            }
+
+            if(failed) {
+                stop();
+                break;
+            }
+            if(rx)
+                rxWakeup.signal();
+            if(tx)
+                txWakeup.signal();
+        }
+    }
+};
+
+bool RdmaRing::isSupported()
+{
+    epicsThreadOnce(&probeOnce, &probeDevices, 0);
+    return haveDevice;
+}
+
+RdmaRing::RdmaRing()
+    :verbs(new Verbs)
+{}
+
+RdmaRing::~RdmaRing()
+{
+    close();
+    delete verbs;
+}
+
+RdmaRing::shared_pointer RdmaRing::create(const std::string& device, int gidIndex, std::size_t ringSize)
+{
+    shared_pointer ret;
+    if(!isSupported())
+        return ret;
+
+    size_t size = 4096u;
+    while(size < ringSize && size < (1u<<30))
+        size <<= 1;
+
+    ret.reset(new RdmaRing);
+    Verbs& V = *ret->verbs;
+    V.size = size;
+    V.gidIndex = gidIndex;
+
+    {
+        int count = 0;
+        ibv_device **list = ibv_get_device_list(&count);
+        for(int i=0; list && i<count && !V.ctx; i++) {
+            if(device.empty() || device==ibv_get_device_name(list[i]))
+                V.ctx = ibv_open_device(list[i]);
+        }
+        if(list)
+            ibv_free_device_list(list);
+    }
+    if(!V.ctx) {
+        LOG(logLevelDebug, "RDMA device '%s' not found", device.c_str());
+        ret.reset();
+        return ret;
+    }
+
+    ibv_port_attr port;
+    union ibv_gid gid;
+    memset(&gid, 0, sizeof(gid));
+    if(ibv_query_port(V.ctx, PORT, &port)
+            || ibv_query_gid(V.ctx, PORT, gidIndex, &gid)
+            || !(V.pd = ibv_alloc_pd(V.ctx))
+            || !(V.channel = ibv_create_comp_channel(V.ctx))
+            || !(V.cq = ibv_create_cq(V.ctx, CQ_DEPTH, NULL, V.channel, 0))
+            || ibv_req_notify_cq(V.cq, 0)
+            || posix_memalign((void**)&V.ring, 4096u, size)
+            || posix_memalign((void**)&V.stage, 4096u, STAGE_SIZE)
+            || !(V.ringMr = ibv_reg_mr(V.pd, V.ring, size, IBV_ACCESS_LOCAL_WRITE|IBV_ACCESS_REMOTE_WRITE))
+            || !(V.stageMr = ibv_reg_mr(V.pd, V.stage, STAGE_SIZE, IBV_ACCESS_LOCAL_WRITE)))
+    {
+        LOG(logLevelDebug, "Unable to set up RDMA device: %d", errno);
+        ret.reset();
+        return ret;
+    }
+    V.mtu = port.active_mtu;
+    {
+        int flags = fcntl(V.channel->fd, F_GETFL);
+        fcntl(V.channel->fd, F_SETFL, flags|O_NONBLOCK);
+    }
+
+    ibv_qp_init_attr init;
+    memset(&init, 0, sizeof(init));
+    init.send_cq = V.cq;
+    init.recv_cq = V.cq;
+    init.qp_type = IBV_QPT_RC;
+    init.cap.max_send_wr = SEND_DEPTH;
+    init.cap.max_recv_wr = RECV_DEPTH;
+    init.cap.max_send_sge = 1;
+    init.cap.max_recv_sge = 1;
+    if(!(V.qp = ibv_create_qp(V.pd, &init))) {
+        LOG(logLevelDebug, "Unable to create RDMA queue pair: %d", errno);
+        ret.reset();
+        return ret;
+    }
+
+    ibv_qp_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.qp_state = IBV_QPS_INIT;
+    attr.pkey_index = 0;
+    attr.port_num = PORT;
+    attr.qp_access_flags = IBV_ACCESS_REMOTE_WRITE;
+    if(ibv_modify_qp(V.qp, &attr, IBV_QP_STATE|IBV_QP_PKEY_INDEX|IBV_QP_PORT|IBV_QP_ACCESS_FLAGS)) {
+        LOG(logLevelDebug, "Unable to initialize RDMA queue pair: %d", errno);
+        ret.reset();
+        return ret;
+    }
+    for(int i=0; i<RECV_DEPTH; i++) {
+        if(!V.postRecv()) {
+            ret.reset();
+            return ret;
+        }
+    }
+
+    Endpoint& L = ret->localEnd;
+    memcpy(L.gid, gid.raw, sizeof(L.gid));
+    L.lid = port.lid;
+    L.qpn = V.qp->qp_num;
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    L.psn = uint32(now.nsecPastEpoch) & 0xffffffu;
+    L.rkey = V.ringMr->rkey;
+    L.size = uint32(size);
+    L.addr = uint64((size_t)V.ring);
+
+    V.thread.start();
+    V.started = true;
+    return ret;
+}
+
+bool RdmaRing::connect(const Endpoint& remote)
+{
+    Verbs& V = *verbs;
+    if(remote.empty() || remote.size==0u || (remote.size & (remote.size-1u)))
+        return false;
+
+    bool global = false;
+    for(size_t i=0; i<sizeof(remote.gid); i++)
+        global |= remote.gid[i]!=0u;
+
+    ibv_qp_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.qp_state = IBV_QPS_RTR;
+    attr.path_mtu = V.mtu;
+    attr.dest_qp_num = remote.qpn;
+    attr.rq_psn = remote.psn;
+    attr.max_dest_rd_atomic = 1;
+    attr.min_rnr_timer = 12;
+    attr.ah_attr.dlid = remote.lid;
+    attr.ah_attr.port_num = PORT;
+    if(global) {
+        // RoCE, or routed InfiniBand
+        attr.ah_attr.is_global = 1;
+        memcpy(attr.ah_attr.grh.dgid.raw, remote.gid, sizeof(remote.gid));
+        attr.ah_attr.grh.sgid_index = uint8(V.gidIndex);
+        attr.ah_attr.grh.hop_limit = 64;
+    }
+    if(ibv_modify_qp(V.qp, &attr, IBV_QP_STATE|IBV_QP_AV|IBV_QP_PATH_MTU|IBV_QP_DEST_QPN
+                     |IBV_QP_RQ_PSN|IBV_QP_MAX_DEST_RD_ATOMIC|IBV_QP_MIN_RNR_TIMER)) {
+        LOG(logLevelDebug, "Unable to connect RDMA queue pair: %d", errno);
+        return false;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.qp_state = IBV_QPS_RTS;
+    attr.timeout = 14;
+    attr.retry_cnt = 7;
+    attr.rnr_retry = 7; // retry forever while the peer has no receive posted
+    attr.sq_psn = localEnd.psn;
+    attr.max_rd_atomic = 1;
+    if(ibv_modify_qp(V.qp, &attr, IBV_QP_STATE|IBV_QP_TIMEOUT|IBV_QP_RETRY_CNT
+                     |IBV_QP_RNR_RETRY|IBV_QP_SQ_PSN|IBV_QP_MAX_QP_RD_ATOMIC)) {
+        LOG(logLevelDebug, "Unable to ready RDMA queue pair: %d", errno);
+        return false;
+    }
+
+    Guard G(V.mutex);
+    V.remoteAddr = remote.addr;
+    V.remoteKey = remote.rkey;
+    V.remoteSize = remote.size;
+    V.connected = true;
+    return true;
+}
+
+bool RdmaRing::registerSendBuffer(char *buf, std::size_t len)
+{
+    Verbs& V = *verbs;
+    if(V.sendMr)
+        return false;
+    V.sendMr = ibv_reg_mr(V.pd, buf, len, IBV_ACCESS_LOCAL_WRITE);
+    return !!V.sendMr;
+}
+
+int RdmaRing::read(char* buf, std::size_t count, double timeout)
+{
+    Verbs& V = *verbs;
+    Guard G(V.mutex);
+    while(!V.closed && V.rxHead==V.rxTail) {
+        bool woken;
+        {
+            UnGuard U(G);
+            woken = V.rxWakeup.wait(timeout);
+        }
+        if(!woken)
+            break;
+    }
+    if(V.closed)
+        return -1;
+    const std::size_t avail = std::size_t(V.rxHead - V.rxTail);
+    if(!avail || !count)
+        return 0;
+
+    const std::size_t n = std::min(count, avail);
+    const std::size_t pos = std::size_t(V.rxTail & (V.size-1u));
+    const std::size_t first = std::min(n, V.size-pos);
+    {
+        // not written again by the peer until credited
+        UnGuard U(G);
+        memcpy(buf, V.ring+pos, first);
+        memcpy(buf+first, V.ring, n-first);
+    }
+    V.rxTail += n;
+    V.unreported += n;
+    if(V.unreported >= V.size/4u)
+        V.postCredit();
+    return int(n);
+}
+
+int RdmaRing::write(const char* buf, std::size_t count, double timeout)
+{
+    Verbs& V = *verbs;
+    Guard G(V.mutex);
+    if(!V.connected)
+        return -1;
+    while(!V.closed && V.txHead - V.txAcked >= V.remoteSize) {
+        bool woken;
+        {
+            UnGuard U(G);
+            woken = V.txWakeup.wait(timeout);
+        }
+        if(!woken)
+            break;
+    }
+    if(V.closed)
+        return -1;
+    const std::size_t space = V.remoteSize - std::size_t(V.txHead - V.txAcked);
+    if(!space || !count)
+        return 0;
+
+    std::size_t n = std::min(count, space);
+    ibv_mr *mr = V.sendMr;
+    if(!mr || buf < (const char*)mr->addr || buf+n > (const char*)mr->addr + mr->length) {
+        mr = V.stageMr;
+        n = std::min(n, STAGE_SIZE);
+    }
+    const uint64 head = V.txHead;
+
+    {
+        // only one thread write()s
+        UnGuard U(G);
+        if(mr==V.stageMr) {
+            memcpy(V.stage, buf, n);
+            buf = V.stage;
+        }
+    }
+
+    // in two parts when wrapping around the end of the peer's ring
+    const std::size_t pos = std::size_t(head & (V.remoteSize-1u));
+    const std::size_t first = std::min(n, V.remoteSize-pos);
+
+    ibv_sge sge[2];
+    ibv_send_wr wr[2], *bad = 0;
+    memset(sge, 0, sizeof(sge));
+    memset(wr, 0, sizeof(wr));
+    sge[0].addr = uint64((size_t)buf);
+    sge[0].length = uint32(first);
+    sge[0].lkey = mr->lkey;
+    sge[1].addr = uint64((size_t)(buf+first));
+    sge[1].length = uint32(n-first);
+    sge[1].lkey = mr->lkey;
+    for(int i=0; i<2; i++) {
+        wr[i].sg_list = &sge[i];
+        wr[i].num_sge = 1;
+        wr[i].opcode = IBV_WR_RDMA_WRITE;
+        wr[i].wr.rdma.rkey = V.remoteKey;
+    }
+    wr[0].wr.rdma.remote_addr = V.remoteAddr + pos;
+    wr[1].wr.rdma.remote_addr = V.remoteAddr;
+
+    // the last carries the count, so completes at the peer after all of the data is placed
+    ibv_send_wr& last = wr[first<n ? 1 : 0];
+    if(first<n)
+        wr[0].next = &wr[1];
+    last.wr_id = WR_DATA;
+    last.opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+    last.imm_data = htonl(uint32(n));
+    last.send_flags = IBV_SEND_SIGNALED;
+
+    if(ibv_post_send(V.qp, &wr[0], &bad)) {
+        LOG(logLevelDebug, "RDMA post error %d", errno);
+        return -1;
+    }
+    const uint64 target = ++V.txPosted;
+    // counted as written once posted, as the peer may credit it before our completion
+    V.txHead += n;
+
+    // the source may be re-used once the write completes
+    while(!V.closed && V.txDone < target) {
+        UnGuard U(G);
+        V.txWakeup.wait();
+    }
+    if(V.closed)
+        return -1;
+    return int(n);
+}
+
+void RdmaRing::close()
+{
+    Verbs& V = *verbs;
+    {
+        Guard G(V.mutex);
+        if(V.closed)
+            return;
+        V.closed = true;
+    }
+    // flush outstanding work requests, which wakes the completion thread
+    if(V.qp) {
+        ibv_qp_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.qp_state = IBV_QPS_ERR;
+        (void)ibv_modify_qp(V.qp, &attr, IBV_QP_STATE);
+    }
+    V.rxWakeup.signal();
+    V.txWakeup.signal();
+}
+
+bool RdmaRing::isClosed() const
+{
+    Guard G(verbs->mutex);
+    return verbs->closed;
+}
+
+#else // !PVA_HAVE_RDMA
+
+struct RdmaRing::Verbs {};
+
+bool RdmaRing::isSupported() { return false; }
+RdmaRing::shared_pointer RdmaRing::create(const std::string&, int, std::size_t) { return shared_pointer(); }
+
+RdmaRing::RdmaRing() :verbs(0) {}
+RdmaRing::~RdmaRing() {}
+bool RdmaRing::connect(const Endpoint&) { return false; }
+bool RdmaRing::registerSendBuffer(char *, std::size_t) { return false; }
+int RdmaRing::read(char*, std::size_t, double) { return -1; }
+int RdmaRing::write(const char*, std::size_t, double) { return -1; }
+void RdmaRing::close() {}
+bool RdmaRing::isClosed() const { return true; }
+
+#endif // PVA_HAVE_RDMA
+
+}
+}
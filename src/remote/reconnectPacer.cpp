@@ -0,0 +1,166 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <algorithm>
+
+#include <epicsGuard.h>
+
+#define epicsExportSharedSymbols
+#include <pv/reconnectPacer.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+// Seconds of creates which may be taken together, after the timer was late
+const double burstSeconds = 0.1;
+// Answers slower than twice the quickest, plus this, are taken as the server being loaded.
+// So that the jitter of a server answering in microseconds is not.
+const double slackSeconds = 0.01;
+// Seconds to increase the rate from the minimum to the maximum
+const double rampSeconds = 2.0;
+}
+
+bool ReconnectPacer::Entry::operator<(const Entry& o) const
+{
+    if(priority!=o.priority)
+        return priority < o.priority;
+    if(weight!=o.weight)
+        return weight < o.weight;
+    return seq > o.seq;
+}
+
+ReconnectPacer::ReconnectPacer(double maxRate)
+    :m_maxRate(maxRate)
+    ,m_minRate(std::min(maxRate, std::max(1.0, maxRate/64.0)))
+    ,m_seq(0u)
+    ,m_rate(std::max(m_minRate, maxRate/4.0))
+    ,m_credit(0.0)
+    ,m_idle(true)
+    ,m_srtt(-1.0)
+    ,m_baseline(-1.0)
+{}
+
+ReconnectPacer::~ReconnectPacer() {}
+
+void ReconnectPacer::add(pvAccessID cid, short priority, size_t weight)
+{
+    Entry ent;
+    ent.priority = priority;
+    ent.weight = weight;
+    ent.cid = cid;
+
+    Guard G(m_mutex);
+    ent.seq = m_seq++;
+    m_heap.push_back(ent);
+    std::push_heap(m_heap.begin(), m_heap.end());
+}
+
+// call with m_mutex held
+void ReconnectPacer::adapt(const epicsTime& now, double elapsed)
+{
+    const bool slow = m_srtt >= 0.0 && m_srtt > 2.0*m_baseline + slackSeconds;
+    if(slow) {
+        // once for each response time, as the answers to the creates already sent are slow too
+        if(now - m_lastDecrease >= m_srtt) {
+            m_rate = std::max(m_minRate, m_rate/2.0);
+            m_lastDecrease = now;
+        }
+    } else {
+        m_rate = std::min(m_maxRate, m_rate + (m_maxRate - m_minRate)*elapsed/rampSeconds);
+    }
+}
+
+void ReconnectPacer::take(const epicsTime& now, std::vector<pvAccessID>& out)
+{
+    Guard G(m_mutex);
+
+    if(m_heap.empty()) {
+        m_idle = true;
+        m_credit = 0.0;
+        return;
+    }
+
+    double elapsed = 0.0;
+    if(m_idle) {
+        // the first at once
+        m_idle = false;
+        m_credit = 1.0;
+    } else {
+        elapsed = std::max(0.0, now - m_last);
+    }
+    m_last = now;
+
+    adapt(now, elapsed);
+
+    m_credit = std::min(m_credit + m_rate*elapsed, std::max(1.0, m_rate*burstSeconds));
+
+    const size_t n = std::min(m_heap.size(), size_t(m_credit));
+    m_credit -= double(n);
+
+    out.reserve(out.size()+n);
+    for(size_t i=0; i<n; i++) {
+        std::pop_heap(m_heap.begin(), m_heap.end());
+        const pvAccessID cid = m_heap.back().cid;
+        m_heap.pop_back();
+        out.push_back(cid);
+        m_outstanding[cid] = now;
+    }
+}
+
+void ReconnectPacer::completed(pvAccessID cid, const epicsTime& now)
+{
+    Guard G(m_mutex);
+
+    outstanding_t::iterator it(m_outstanding.find(cid));
+    if(it==m_outstanding.end())
+        return; // not paced
+    const double sample = std::max(0.0, now - it->second);
+    m_outstanding.erase(it);
+
+    if(m_srtt < 0.0) {
+        m_srtt = m_baseline = sample;
+    } else {
+        m_srtt += (sample - m_srtt)/8.0;
+        // rises slowly, to follow a server which has become slower for good
+        m_baseline = std::min(sample, m_baseline*1.01);
+    }
+}
+
+void ReconnectPacer::forget(pvAccessID cid)
+{
+    Guard G(m_mutex);
+    m_outstanding.erase(cid);
+}
+
+double ReconnectPacer::rate() const
+{
+    Guard G(m_mutex);
+    return m_rate;
+}
+
+double ReconnectPacer::responseTime() const
+{
+    Guard G(m_mutex);
+    return std::max(0.0, m_srtt);
+}
+
+size_t ReconnectPacer::pending() const
+{
+    Guard G(m_mutex);
+    return m_heap.size();
+}
+
+size_t ReconnectPacer::outstanding() const
+{
+    Guard G(m_mutex);
+    return m_outstanding.size();
+}
+
+}
+}
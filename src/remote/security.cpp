@@ -4,7 +4,19 @@
 * in file LICENSE that is included with this distribution.
 */
 
+#include <stdexcept>
+
 #include <osiProcess.h>
+#include <epicsGuard.h>
+#include <epicsThread.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_SECURITY_USE_ATOMIC
+#endif
+#endif
 
 #define epicsExportSharedSymbols
 #include <pv/securityImpl.h>
@@ -73,3 +85,217 @@ SecurityPluginRegistry::SecurityPluginRegistry() {
 }
 
 
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+// incremented by rightsChangedAll()
+int allGeneration;
+
+#ifdef PVA_SECURITY_USE_ATOMIC
+int getAllGeneration() { return epics::atomic::get(allGeneration); }
+void incrementAllGeneration() { epics::atomic::increment(allGeneration); }
+#else
+epicsThreadOnceId allOnce = EPICS_THREAD_ONCE_INIT;
+epicsMutex *allMutex;
+
+void allInit(void*)
+{
+    allMutex = new epicsMutex;
+}
+
+int getAllGeneration()
+{
+    epicsThreadOnce(&allOnce, &allInit, 0);
+    Guard G(*allMutex);
+    return allGeneration;
+}
+
+void incrementAllGeneration()
+{
+    epicsThreadOnce(&allOnce, &allInit, 0);
+    Guard G(*allMutex);
+    allGeneration++;
+}
+#endif
+}
+
+CachingChannelSecuritySession::CachingChannelSecuritySession(ChannelSecuritySession::shared_pointer const & session)
+    :session(session)
+    ,generation(0u)
+    ,seenAll(getAllGeneration())
+    ,lookups(0u)
+    ,hits(0u)
+{
+    if(!session)
+        throw std::invalid_argument("CachingChannelSecuritySession requires a session");
+    for(size_t i=0; i<numOperations; i++)
+        known[i] = false;
+}
+
+CachingChannelSecuritySession::~CachingChannelSecuritySession() {}
+
+void CachingChannelSecuritySession::rightsChanged()
+{
+    Guard G(mutex);
+    generation++;
+    for(size_t i=0; i<numOperations; i++)
+        known[i] = false;
+}
+
+void CachingChannelSecuritySession::rightsChangedAll()
+{
+    incrementAllGeneration();
+}
+
+void CachingChannelSecuritySession::getCounts(size_t& lookups, size_t& hits) const
+{
+    Guard G(mutex);
+    lookups = this->lookups;
+    hits = this->hits;
+}
+
+bool CachingChannelSecuritySession::lookup(operation_t op, Status& status, unsigned& generation)
+{
+    const int all = getAllGeneration();
+    Guard G(mutex);
+    if(all!=seenAll) {
+        seenAll = all;
+        this->generation++;
+        for(size_t i=0; i<numOperations; i++)
+            known[i] = false;
+    }
+    if(known[op]) {
+        hits++;
+        status = decisions[op];
+        return true;
+    }
+    lookups++;
+    generation = this->generation;
+    return false;
+}
+
+void CachingChannelSecuritySession::store(operation_t op, const Status& status, unsigned generation)
+{
+    Guard G(mutex);
+    // not if forgotten while the wrapped session decided
+    if(generation!=this->generation || seenAll!=getAllGeneration())
+        return;
+    decisions[op] = status;
+    known[op] = true;
+}
+
+void CachingChannelSecuritySession::close()
+{
+    session->close();
+}
+
+void CachingChannelSecuritySession::release(pvAccessID ioid)
+{
+    session->release(ioid);
+}
+
+#define CACHED(OP, CALL) \
+    Status ret; \
+    unsigned gen; \
+    if(!lookup(OP, ret, gen)) { \
+        ret = session->CALL; \
+        store(OP, ret, gen); \
+    } \
+    return ret
+
+Status CachingChannelSecuritySession::authorizeCreateChannelProcess(
+        pvAccessID ioid, PVStructure::shared_pointer const & pvRequest)
+{
+    return session->authorizeCreateChannelProcess(ioid, pvRequest);
+}
+
+Status CachingChannelSecuritySession::authorizeProcess(pvAccessID ioid)
+{
+    CACHED(opProcess, authorizeProcess(ioid));
+}
+
+Status CachingChannelSecuritySession::authorizeCreateChannelGet(
+        pvAccessID ioid, PVStructure::shared_pointer const & pvRequest)
+{
+    return session->authorizeCreateChannelGet(ioid, pvRequest);
+}
+
+Status CachingChannelSecuritySession::authorizeGet(pvAccessID ioid)
+{
+    CACHED(opGet, authorizeGet(ioid));
+}
+
+Status CachingChannelSecuritySession::authorizeCreateChannelPut(
+        pvAccessID ioid, PVStructure::shared_pointer const & pvRequest)
+{
+    return session->authorizeCreateChannelPut(ioid, pvRequest);
+}
+
+Status CachingChannelSecuritySession::authorizePut(
+        pvAccessID ioid,
+        PVStructure::shared_pointer const & dataToPut,
+        BitSet::shared_pointer const & fieldsToPut)
+{
+    CACHED(opPut, authorizePut(ioid, dataToPut, fieldsToPut));
+}
+
+Status CachingChannelSecuritySession::authorizeCreateChannelPutGet(
+        pvAccessID ioid, PVStructure::shared_pointer const & pvRequest)
+{
+    return session->authorizeCreateChannelPutGet(ioid, pvRequest);
+}
+
+Status CachingChannelSecuritySession::authorizePutGet(
+        pvAccessID ioid,
+        PVStructure::shared_pointer const & dataToPut,
+        BitSet::shared_pointer const & fieldsToPut)
+{
+    CACHED(opPutGet, authorizePutGet(ioid, dataToPut, fieldsToPut));
+}
+
+Status CachingChannelSecuritySession::authorizeCreateChannelRPC(
+        pvAccessID ioid, PVStructure::shared_pointer const & pvRequest)
+{
+    return session->authorizeCreateChannelRPC(ioid, pvRequest);
+}
+
+Status CachingChannelSecuritySession::authorizeRPC(
+        pvAccessID ioid, PVStructure::shared_pointer const & arguments)
+{
+    CACHED(opRPC, authorizeRPC(ioid, arguments));
+}
+
+Status CachingChannelSecuritySession::authorizeCreateMonitor(
+        pvAccessID ioid, PVStructure::shared_pointer const & pvRequest)
+{
+    return session->authorizeCreateMonitor(ioid, pvRequest);
+}
+
+Status CachingChannelSecuritySession::authorizeMonitor(pvAccessID ioid)
+{
+    CACHED(opMonitor, authorizeMonitor(ioid));
+}
+
+Status CachingChannelSecuritySession::authorizeCreateChannelArray(
+        pvAccessID ioid, PVStructure::shared_pointer const & pvRequest)
+{
+    return session->authorizeCreateChannelArray(ioid, pvRequest);
+}
+
+Status CachingChannelSecuritySession::authorizePut(pvAccessID ioid, PVArray::shared_pointer const & dataToPut)
+{
+    CACHED(opArrayPut, authorizePut(ioid, dataToPut));
+}
+
+Status CachingChannelSecuritySession::authorizeSetLength(pvAccessID ioid)
+{
+    CACHED(opSetLength, authorizeSetLength(ioid));
+}
+
+Status CachingChannelSecuritySession::authorizeGetField(pvAccessID ioid, std::string const & subField)
+{
+    return session->authorizeGetField(ioid, subField);
+}
+
+#undef CACHED
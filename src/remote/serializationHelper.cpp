@@ -4,6 +4,22 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <string.h>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#  define PVA_SWAP_SSSE3
+#  define PVA_SWAP_AVX2
+#elif defined(__SSSE3__)
+#  include <tmmintrin.h>
+#  define PVA_SWAP_SSSE3
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define PVA_SWAP_NEON
+#endif
+
+#include <epicsTypes.h>
 #include <pv/serialize.h>
 #include <pv/pvData.h>
 #include <pv/noDefaultMethods.h>
@@ -16,9 +32,109 @@
 
 using namespace epics::pvData;
 
+namespace {
+
+// portable fall back, also used for the tail of the SIMD loops
+template<typename T>
+void swapTail(char* dst, const char* src, size_t count)
+{
+    for(size_t i=0; i<count; i++, dst+=sizeof(T), src+=sizeof(T)) {
+        char tmp[sizeof(T)];
+        for(size_t b=0; b<sizeof(T); b++)
+            tmp[b] = src[sizeof(T)-1-b];
+        memcpy(dst, tmp, sizeof(T));
+    }
+}
+
+template<>
+void swapTail<epicsUInt16>(char* dst, const char* src, size_t count)
+{
+    for(size_t i=0; i<count; i++, dst+=2, src+=2) {
+        epicsUInt16 v;
+        memcpy(&v, src, 2);
+        v = epicsUInt16((v>>8) | (v<<8));
+        memcpy(dst, &v, 2);
+    }
+}
+
+template<>
+void swapTail<epicsUInt32>(char* dst, const char* src, size_t count)
+{
+    for(size_t i=0; i<count; i++, dst+=4, src+=4) {
+        epicsUInt32 v;
+        memcpy(&v, src, 4);
+        v = (v>>24) | ((v>>8)&0x0000ff00u) | ((v<<8)&0x00ff0000u) | (v<<24);
+        memcpy(dst, &v, 4);
+    }
+}
+
+// byte order reversal of 16 byte blocks, @returns number of elements done
+template<typename T>
+size_t swapBlocks(char* dst, const char* src, size_t count)
+{
+    size_t done = 0;
+#if defined(PVA_SWAP_SSSE3)
+    // shuffle mask reversing each sizeof(T) group of bytes
+    epicsUInt8 m[16];
+    for(size_t i=0; i<16; i++)
+        m[i] = epicsUInt8((i/sizeof(T))*sizeof(T) + sizeof(T)-1-(i%sizeof(T)));
+    const __m128i mask = _mm_loadu_si128((const __m128i*)m);
+#  if defined(PVA_SWAP_AVX2)
+    const __m256i mask2 = _mm256_broadcastsi128_si256(mask);
+    for(; count-done >= 32/sizeof(T); done += 32/sizeof(T)) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + done*sizeof(T)));
+        _mm256_storeu_si256((__m256i*)(dst + done*sizeof(T)), _mm256_shuffle_epi8(v, mask2));
+    }
+#  endif
+    for(; count-done >= 16/sizeof(T); done += 16/sizeof(T)) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + done*sizeof(T)));
+        _mm_storeu_si128((__m128i*)(dst + done*sizeof(T)), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(PVA_SWAP_NEON)
+    for(; count-done >= 16/sizeof(T); done += 16/sizeof(T)) {
+        uint8x16_t v = vld1q_u8((const uint8_t*)(src + done*sizeof(T)));
+        switch(sizeof(T)) {
+        case 2: v = vrev16q_u8(v); break;
+        case 4: v = vrev32q_u8(v); break;
+        default: v = vrev64q_u8(v); break;
+        }
+        vst1q_u8((uint8_t*)(dst + done*sizeof(T)), v);
+    }
+#else
+    (void)dst;
+    (void)src;
+    (void)count;
+#endif
+    return done;
+}
+
+template<typename T>
+void swapArray(char* dst, const char* src, size_t count)
+{
+    size_t done = swapBlocks<T>(dst, src, count);
+    swapTail<T>(dst + done*sizeof(T), src + done*sizeof(T), count - done);
+}
+
+} // namespace
+
 namespace epics {
 namespace pvAccess {
 
+void SerializationHelper::copySwapped(char* dst, const char* src, std::size_t count, std::size_t elementSize)
+{
+    switch(elementSize) {
+    case 1:
+        if(dst!=src)
+            memmove(dst, src, count);
+        break;
+    case 2: swapArray<epicsUInt16>(dst, src, count); break;
+    case 4: swapArray<epicsUInt32>(dst, src, count); break;
+    case 8: swapArray<epicsUInt64>(dst, src, count); break;
+    default:
+        throw std::logic_error("copySwapped() unsupported element size");
+    }
+}
+
 PVDataCreatePtr SerializationHelper::_pvDataCreate(getPVDataCreate());
 
 PVStructure::shared_pointer SerializationHelper::deserializePVRequest(ByteBuffer* buffer, DeserializableControl* control)
@@ -62,6 +178,27 @@ PVField::shared_pointer SerializationHelper::deserializeFull(ByteBuffer* buffer,
     return pvField;
 }
 
+bool SerializationHelper::hasUnion(const Field& field)
+{
+    switch(field.getType()) {
+    case union_:
+    case unionArray:
+        return true;
+    case structure: {
+        const FieldConstPtrArray& fields(static_cast<const Structure&>(field).getFields());
+        for(size_t i=0; i<fields.size(); i++) {
+            if(hasUnion(*fields[i]))
+                return true;
+        }
+        return false;
+    }
+    case structureArray:
+        return hasUnion(*static_cast<const StructureArray&>(field).getStructure());
+    default:
+        return false;
+    }
+}
+
 void SerializationHelper::serializeNullField(ByteBuffer* buffer, SerializableControl* control)
 {
     control->ensureBuffer(1);
@@ -0,0 +1,362 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <algorithm>
+
+#include <string.h>
+#include <errno.h>
+
+#include <epicsThread.h>
+#include <epicsStdio.h>
+#include <epicsTime.h>
+#include <osiProcess.h>
+
+#if defined(__linux__)
+#  define PVA_HAVE_SHM_RING
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/syscall.h>
+#  include <linux/futex.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#define epicsExportSharedSymbols
+#include <pv/shmRing.h>
+#include <pv/logger.h>
+
+using epics::pvData::int32;
+using epics::pvData::uint32;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+const uint32 shmMagic = 0x50564131; // "PVA1"
+
+// at the start of the shared segment
+struct Header {
+    uint32 magic;
+    uint32 size;
+    int32 closed;
+    char pad[64 - 3*sizeof(uint32)];
+};
+
+void makeName(char *buf, size_t len, uint32 token)
+{
+    epicsSnprintf(buf, len, "/epics-pva-%08x", unsigned(token));
+}
+}
+
+// head and tail are free running byte counts, on separate cache lines
+struct ShmRing::Ring {
+    uint32 head;
+    int32 readerWaiting;
+    char pad0[64 - 2*sizeof(uint32)];
+    uint32 tail;
+    int32 writerWaiting;
+    char pad1[64 - 2*sizeof(uint32)];
+};
+
+#ifdef PVA_HAVE_SHM_RING
+
+namespace {
+
+// wait while *addr==val, for up to timeout seconds
+void futexWait(uint32 *addr, uint32 val, double timeout)
+{
+    struct timespec ts;
+    ts.tv_sec = time_t(timeout);
+    ts.tv_nsec = long((timeout - double(ts.tv_sec))*1e9);
+    // not FUTEX_PRIVATE, the word is shared with another process
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+void futexWake(uint32 *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+size_t segmentSize(size_t size)
+{
+    return sizeof(Header) + 2*sizeof(ShmRing::Ring) + 2*size;
+}
+
+} // namespace
+
+bool ShmRing::isSupported() { return true; }
+
+ShmRing::shared_pointer ShmRing::create(std::size_t ringSize, uint32 *token)
+{
+    size_t size = 4096u;
+    while(size < ringSize && size < (1u<<30))
+        size <<= 1;
+
+    static uint32 counter;
+    const uint32 pid = uint32(getpid());
+
+    char name[32];
+    int fd = -1;
+    uint32 tok = 0;
+    for(unsigned attempt=0; fd<0 && attempt<8; attempt++) {
+        epicsTimeStamp now;
+        epicsTimeGetCurrent(&now);
+        tok = (pid<<16) ^ now.nsec ^ (__sync_add_and_fetch(&counter, 1u)*0x9E3779B9u);
+        if(tok==0)
+            continue;
+        makeName(name, sizeof(name), tok);
+        // only the same user may attach
+        fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600);
+        if(fd<0 && errno!=EEXIST)
+            break;
+    }
+    if(fd<0) {
+        LOG(logLevelDebug, "Unable to create shared memory ring: %s", strerror(errno));
+        return shared_pointer();
+    }
+
+    ShmRing::shared_pointer ret(new ShmRing(true, tok));
+    ret->size = size;
+    ret->mapSize = segmentSize(size);
+
+    // reserve the pages now.  After only ftruncate(), a full /dev/shm would be found
+    // as SIGBUS on first touch of the mapping.
+    const int err = posix_fallocate(fd, 0, off_t(ret->mapSize));
+    if(err) {
+        LOG(logLevelDebug, "Unable to allocate shared memory ring: %s", strerror(err));
+        ::close(fd);
+        return shared_pointer(); // dtor unlinks
+    }
+
+    void *base = mmap(0, ret->mapSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(base==MAP_FAILED) {
+        LOG(logLevelDebug, "Unable to map shared memory ring: %s", strerror(errno));
+        return shared_pointer();
+    }
+    ret->base = base;
+
+    // new pages are zeroed, so both rings start empty
+    Header *H = static_cast<Header*>(base);
+    H->size = uint32(size);
+    __atomic_store_n(&H->magic, shmMagic, __ATOMIC_RELEASE);
+
+    Ring *rings = reinterpret_cast<Ring*>(H+1);
+    char *data = reinterpret_cast<char*>(rings+2);
+    ret->tx = &rings[0];
+    ret->rx = &rings[1];
+    ret->txData = data;
+    ret->rxData = data + size;
+    ret->closed = &H->closed;
+
+    *token = tok;
+    return ret;
+}
+
+ShmRing::shared_pointer ShmRing::open(uint32 token)
+{
+    char name[32];
+    makeName(name, sizeof(name), token);
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if(fd<0) {
+        LOG(logLevelDebug, "Unable to open shared memory ring %s: %s", name, strerror(errno));
+        return shared_pointer();
+    }
+
+    ShmRing::shared_pointer ret(new ShmRing(false, token));
+    // we were the only ones meant to find it
+    ret->unlink();
+
+    struct stat info;
+    void *base = MAP_FAILED;
+    if(fstat(fd, &info)==0 && size_t(info.st_size) > sizeof(Header))
+        base = mmap(0, size_t(info.st_size), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(base==MAP_FAILED) {
+        LOG(logLevelDebug, "Unable to map shared memory ring %s: %s", name, strerror(errno));
+        return shared_pointer();
+    }
+    ret->base = base;
+    ret->mapSize = size_t(info.st_size);
+
+    Header *H = static_cast<Header*>(base);
+    const size_t size = H->size;
+    if(__atomic_load_n(&H->magic, __ATOMIC_ACQUIRE)!=shmMagic
+            || size==0 || (size&(size-1))!=0 || segmentSize(size)!=ret->mapSize) {
+        LOG(logLevelDebug, "Invalid shared memory ring %s", name);
+        return shared_pointer();
+    }
+    ret->size = size;
+
+    Ring *rings = reinterpret_cast<Ring*>(H+1);
+    char *data = reinterpret_cast<char*>(rings+2);
+    ret->tx = &rings[1];
+    ret->rx = &rings[0];
+    ret->txData = data + size;
+    ret->rxData = data;
+    ret->closed = &H->closed;
+
+    return ret;
+}
+
+ShmRing::~ShmRing()
+{
+    unlink();
+    if(base)
+        munmap(base, mapSize);
+}
+
+void ShmRing::unlink()
+{
+    if(unlinked)
+        return;
+    unlinked = true;
+    char name[32];
+    makeName(name, sizeof(name), token);
+    shm_unlink(name);
+}
+
+int ShmRing::read(char* buf, std::size_t count, double timeout)
+{
+    if(count==0)
+        return 0;
+
+    while(true) {
+        if(__atomic_load_n(closed, __ATOMIC_ACQUIRE))
+            return -1;
+
+        const uint32 tail = rx->tail;
+        uint32 head = __atomic_load_n(&rx->head, __ATOMIC_ACQUIRE);
+
+        if(head==tail) {
+            if(timeout<=0.0)
+                return 0;
+            __atomic_store_n(&rx->readerWaiting, 1, __ATOMIC_SEQ_CST);
+            head = __atomic_load_n(&rx->head, __ATOMIC_SEQ_CST);
+            if(head==tail && !__atomic_load_n(closed, __ATOMIC_SEQ_CST))
+                futexWait(&rx->head, tail, timeout);
+            __atomic_store_n(&rx->readerWaiting, 0, __ATOMIC_RELAXED);
+            timeout = 0.0; // one wait only
+            continue;
+        }
+
+        const size_t avail = uint32(head - tail);
+        if(avail > size) {
+            // the peer moved head past the end of what it could have written
+            LOG(logLevelError, "Shared memory ring %08x: invalid head %u, tail %u",
+                unsigned(token), unsigned(head), unsigned(tail));
+            close();
+            return -1;
+        }
+        const size_t n = std::min(count, std::min(avail, size_t(0x7fffffff)));
+        const size_t pos = tail & (size-1);
+        const size_t first = std::min(n, size - pos);
+        memcpy(buf, rxData + pos, first);
+        if(first < n)
+            memcpy(buf + first, rxData, n - first);
+
+        __atomic_store_n(&rx->tail, uint32(tail + n), __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&rx->writerWaiting, __ATOMIC_SEQ_CST))
+            futexWake(&rx->tail);
+        return int(n);
+    }
+}
+
+int ShmRing::write(const char* buf, std::size_t count, double timeout)
+{
+    if(count==0)
+        return 0;
+
+    while(true) {
+        if(__atomic_load_n(closed, __ATOMIC_ACQUIRE))
+            return -1;
+
+        const uint32 head = tx->head;
+        uint32 tail = __atomic_load_n(&tx->tail, __ATOMIC_ACQUIRE);
+
+        if(uint32(head - tail) > size) {
+            // the peer moved tail past the end of what we wrote
+            LOG(logLevelError, "Shared memory ring %08x: invalid head %u, tail %u",
+                unsigned(token), unsigned(head), unsigned(tail));
+            close();
+            return -1;
+
+        } else if(uint32(head - tail)==size) {
+            if(timeout<=0.0)
+                return 0;
+            __atomic_store_n(&tx->writerWaiting, 1, __ATOMIC_SEQ_CST);
+            tail = __atomic_load_n(&tx->tail, __ATOMIC_SEQ_CST);
+            if(uint32(head - tail)==size && !__atomic_load_n(closed, __ATOMIC_SEQ_CST))
+                futexWait(&tx->tail, tail, timeout);
+            __atomic_store_n(&tx->writerWaiting, 0, __ATOMIC_RELAXED);
+            timeout = 0.0;
+            continue;
+        }
+
+        const size_t space = size - uint32(head - tail);
+        const size_t n = std::min(count, std::min(space, size_t(0x7fffffff)));
+        const size_t pos = head & (size-1);
+        const size_t first = std::min(n, size - pos);
+        memcpy(txData + pos, buf, first);
+        if(first < n)
+            memcpy(txData, buf + first, n - first);
+
+        __atomic_store_n(&tx->head, uint32(head + n), __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&tx->readerWaiting, __ATOMIC_SEQ_CST))
+            futexWake(&tx->head);
+        return int(n);
+    }
+}
+
+void ShmRing::close()
+{
+    if(!closed)
+        return;
+    __atomic_store_n(closed, 1, __ATOMIC_SEQ_CST);
+    // wake anyone waiting, on either side.  Changing the futex words
+    // isn't possible without racing, so wake unconditionally.
+    futexWake(&tx->head);
+    futexWake(&tx->tail);
+    futexWake(&rx->head);
+    futexWake(&rx->tail);
+}
+
+bool ShmRing::isClosed() const
+{
+    return !closed || __atomic_load_n(closed, __ATOMIC_ACQUIRE);
+}
+
+#else // PVA_HAVE_SHM_RING
+
+bool ShmRing::isSupported() { return false; }
+
+ShmRing::shared_pointer ShmRing::create(std::size_t, uint32 *) { return shared_pointer(); }
+ShmRing::shared_pointer ShmRing::open(uint32) { return shared_pointer(); }
+
+ShmRing::~ShmRing() {}
+void ShmRing::unlink() {}
+int ShmRing::read(char*, std::size_t, double) { return -1; }
+int ShmRing::write(const char*, std::size_t, double) { return -1; }
+void ShmRing::close() {}
+bool ShmRing::isClosed() const { return true; }
+
+#endif // PVA_HAVE_SHM_RING
+
+ShmRing::ShmRing(bool creator, uint32 token)
+    :creator(creator)
+    ,token(token)
+    ,unlinked(false)
+    ,base(0)
+    ,mapSize(0)
+    ,size(0)
+    ,tx(0), rx(0)
+    ,txData(0), rxData(0)
+    ,closed(0)
+{}
+
+}
+}
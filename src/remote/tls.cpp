@@ -0,0 +1,496 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <climits>
+
+#include <osiSock.h>
+#include <epicsTime.h>
+#include <epicsThread.h>
+#include <epicsGuard.h>
+
+#ifdef PVA_HAVE_OPENSSL
+#  include <openssl/ssl.h>
+#  include <openssl/err.h>
+#  include <openssl/x509.h>
+#endif
+
+#define epicsExportSharedSymbols
+#include <pv/tls.h>
+#include <pv/codec.h>
+#include <pv/ioReactor.h>
+#include <pv/logger.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+
+#ifdef PVA_HAVE_OPENSSL
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#  define TLS_server_method SSLv23_server_method
+#  define TLS_client_method SSLv23_client_method
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#  define PVA_SSL_GET_PEER_CERT SSL_get1_peer_certificate
+#else
+#  define PVA_SSL_GET_PEER_CERT SSL_get_peer_certificate
+#endif
+
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#  define PVA_HAVE_KTLS
+#endif
+
+struct TLSContext::Pvt {
+    SSL_CTX *ctx;
+
+    mutable epicsMutex mutex;
+    // client only.  Latest resumable session for each server address
+    typedef std::map<std::string, SSL_SESSION*> sessions_t;
+    sessions_t sessions;
+    size_t nresumed, nfull;
+
+    Pvt() :ctx(0), nresumed(0), nfull(0) {}
+    ~Pvt() {
+        for(sessions_t::iterator it(sessions.begin()), end(sessions.end()); it!=end; ++it)
+            SSL_SESSION_free(it->second);
+        if(ctx)
+            SSL_CTX_free(ctx);
+    }
+};
+
+struct TLSSession::Pvt {
+    SSL *ssl;
+    SOCKET sock;
+    bool server;
+    // the last step of the handshake needs the socket to be writable
+    bool wantWrite;
+    // server address, key of TLSContext::Pvt::sessions
+    std::string key;
+
+    Pvt() :ssl(0), sock(INVALID_SOCKET), server(false), wantWrite(false) {}
+    ~Pvt() {
+        if(ssl)
+            SSL_free(ssl);
+    }
+};
+
+namespace {
+
+epicsThreadOnceId sslOnce = EPICS_THREAD_ONCE_INIT;
+
+void sslInit(void *)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    SSL_library_init();
+    SSL_load_error_strings();
+#else
+    OPENSSL_init_ssl(0, NULL);
+#endif
+}
+
+std::string sslError()
+{
+    std::string ret;
+    unsigned long err;
+    while((err = ERR_get_error())!=0) {
+        char buf[256];
+        ERR_error_string_n(err, buf, sizeof(buf));
+        if(!ret.empty())
+            ret += ", ";
+        ret += buf;
+    }
+    return ret.empty() ? std::string("unknown error") : ret;
+}
+
+// called by OpenSSL when a client receives a session (ticket) which may be resumed
+int newClientSession(SSL *ssl, SSL_SESSION *sess)
+{
+    TLSContext::Pvt *pvt = static_cast<TLSContext::Pvt*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    const std::string *key = static_cast<const std::string*>(SSL_get_app_data(ssl));
+    if(!pvt || !key)
+        return 0;
+
+    Guard G(pvt->mutex);
+    SSL_SESSION*& slot = pvt->sessions[*key];
+    if(slot)
+        SSL_SESSION_free(slot);
+    slot = sess;
+    return 1; // we keep the reference
+}
+
+} // namespace
+
+bool TLSContext::isSupported() { return true; }
+
+#else // PVA_HAVE_OPENSSL
+
+struct TLSContext::Pvt {};
+struct TLSSession::Pvt {};
+
+bool TLSContext::isSupported() { return false; }
+
+#endif // PVA_HAVE_OPENSSL
+
+TLSContext::TLSContext(bool server)
+    :server(server)
+    ,haveCert(false)
+    ,pvt(new Pvt)
+{}
+
+TLSContext::~TLSContext() {}
+
+TLSContext::shared_pointer TLSContext::create(const Configuration::const_shared_pointer& conf, bool server)
+{
+    TLSContext::shared_pointer ret;
+    if(!conf)
+        return ret;
+
+    const std::string prefix(server ? "EPICS_PVAS_TLS_" : "EPICS_PVA_TLS_");
+    const std::string cert(conf->getPropertyAsString(prefix+"CERT", "")),
+                      key(conf->getPropertyAsString(prefix+"KEY", cert)),
+                      ca(conf->getPropertyAsString(prefix+"CA", ""));
+
+    if(server ? cert.empty() : ca.empty())
+        return ret;
+
+#ifndef PVA_HAVE_OPENSSL
+    // never fall back to plain text when encryption was asked for
+    throw std::runtime_error(prefix+"* is set, but pvAccess was built without TLS support (WITH_OPENSSL)");
+#else
+    epicsThreadOnce(&sslOnce, &sslInit, 0);
+
+    ret.reset(new TLSContext(server));
+    Pvt& P = *ret->pvt;
+
+    P.ctx = SSL_CTX_new(server ? TLS_server_method() : TLS_client_method());
+    if(!P.ctx)
+        throw std::runtime_error("Unable to create TLS context: "+sslError());
+
+    SSL_CTX_set_app_data(P.ctx, &P);
+    SSL_CTX_set_options(P.ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_NO_TLSv1 | SSL_OP_NO_TLSv1_1);
+    // codec write()s are partial, and retried from a moving buffer position
+    SSL_CTX_set_mode(P.ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef PVA_HAVE_KTLS
+    if(conf->getPropertyAsBoolean("EPICS_PVA_TLS_KTLS", true))
+        SSL_CTX_set_options(P.ctx, SSL_OP_ENABLE_KTLS);
+#endif
+
+    if(!cert.empty()) {
+        if(SSL_CTX_use_certificate_chain_file(P.ctx, cert.c_str())!=1
+                || SSL_CTX_use_PrivateKey_file(P.ctx, key.c_str(), SSL_FILETYPE_PEM)!=1
+                || SSL_CTX_check_private_key(P.ctx)!=1)
+            throw std::runtime_error("Unable to load TLS certificate "+cert+" : "+sslError());
+        ret->haveCert = true;
+    }
+
+    if(!ca.empty()) {
+        if(SSL_CTX_load_verify_locations(P.ctx, ca.c_str(), NULL)!=1)
+            throw std::runtime_error("Unable to load TLS CA "+ca+" : "+sslError());
+        if(server) {
+            // request, but don't require, a client certificate
+            STACK_OF(X509_NAME) *names = SSL_load_client_CA_file(ca.c_str());
+            if(names)
+                SSL_CTX_set_client_CA_list(P.ctx, names);
+        }
+        SSL_CTX_set_verify(P.ctx, SSL_VERIFY_PEER, NULL);
+    }
+
+    if(server) {
+        static const unsigned char sid[] = "pva";
+        SSL_CTX_set_session_id_context(P.ctx, sid, sizeof(sid)-1);
+        SSL_CTX_set_session_cache_mode(P.ctx, SSL_SESS_CACHE_SERVER);
+
+        const std::string ticketKey(conf->getPropertyAsString("EPICS_PVAS_TLS_TICKET_KEY", ""));
+        if(!ticketKey.empty()) {
+            std::ifstream strm(ticketKey.c_str(), std::ios::in | std::ios::binary);
+            std::vector<char> buf((std::istreambuf_iterator<char>(strm)), std::istreambuf_iterator<char>());
+            if(!strm.eof() || buf.empty()
+                    || SSL_CTX_set_tlsext_ticket_keys(P.ctx, &buf[0], long(buf.size()))!=1)
+                throw std::runtime_error("Unable to load TLS session ticket key from "+ticketKey);
+        }
+
+        // clients can only be authenticated by certificate if we can verify them
+        if(!ca.empty())
+            SecurityPluginRegistry::instance().installServerSecurityPlugin(X509SecurityPlugin::SERVER);
+
+    } else {
+        SSL_CTX_set_session_cache_mode(P.ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(P.ctx, &newClientSession);
+
+        if(ret->haveCert)
+            SecurityPluginRegistry::instance().installClientSecurityPlugin(X509SecurityPlugin::CLIENT);
+    }
+
+    LOG(logLevelDebug, "TLS enabled for %s connections with certificate '%s' and CA '%s'",
+        server ? "server" : "client", cert.c_str(), ca.c_str());
+
+    return ret;
+#endif // PVA_HAVE_OPENSSL
+}
+
+TLSSession::shared_pointer TLSContext::handshake(SOCKET sock, const osiSockAddr& peer, double timeout)
+{
+    TLSSession::shared_pointer ret(startSession(sock, peer));
+    if(ret && !ret->handshake(timeout))
+        ret.reset();
+    return ret;
+}
+
+TLSSession::shared_pointer TLSContext::startSession(SOCKET sock, const osiSockAddr& peer)
+{
+    TLSSession::shared_pointer ret;
+#ifdef PVA_HAVE_OPENSSL
+    char name[64];
+    sockAddrToDottedIP(&peer.sa, name, sizeof(name));
+
+    osiSockIoctl_t yes = true;
+    if(socket_ioctl(sock, FIONBIO, &yes)) {
+        char errStr[64];
+        epicsSocketConvertErrnoToString(errStr, sizeof(errStr));
+        LOG(logLevelError, "Unable to set non-blocking mode for TLS with %s: %s", name, errStr);
+        return ret;
+    }
+
+    ret.reset(new TLSSession);
+    TLSSession::Pvt& S = *ret->pvt;
+    S.key = name;
+    S.sock = sock;
+    S.server = server;
+
+    ERR_clear_error();
+    S.ssl = SSL_new(pvt->ctx);
+    if(!S.ssl || SSL_set_fd(S.ssl, int(sock))!=1) {
+        LOG(logLevelError, "Unable to create TLS session with %s: %s", name, sslError().c_str());
+        return TLSSession::shared_pointer();
+    }
+    SSL_set_app_data(S.ssl, &S.key);
+
+    if(!server) {
+        Guard G(pvt->mutex);
+        Pvt::sessions_t::const_iterator it(pvt->sessions.find(S.key));
+        if(it!=pvt->sessions.end())
+            SSL_set_session(S.ssl, it->second);
+    }
+#else
+    (void)sock;
+    (void)peer;
+#endif
+    return ret;
+}
+
+size_t TLSContext::numResumed() const
+{
+#ifdef PVA_HAVE_OPENSSL
+    Guard G(pvt->mutex);
+    return pvt->nresumed;
+#else
+    return 0;
+#endif
+}
+
+size_t TLSContext::numFull() const
+{
+#ifdef PVA_HAVE_OPENSSL
+    Guard G(pvt->mutex);
+    return pvt->nfull;
+#else
+    return 0;
+#endif
+}
+
+TLSSession::TLSSession()
+    :isEstablished(false)
+    ,isResumed(false)
+    ,ktlsSend(false)
+    ,ktlsRecv(false)
+    ,pvt(new Pvt)
+{}
+
+TLSSession::~TLSSession() {}
+
+int TLSSession::continueHandshake()
+{
+#ifdef PVA_HAVE_OPENSSL
+    Guard G(mutex);
+    if(isEstablished)
+        return 1;
+
+    Pvt& S = *pvt;
+    ERR_clear_error();
+    int err = S.server ? SSL_accept(S.ssl) : SSL_connect(S.ssl);
+    if(err!=1) {
+        switch(SSL_get_error(S.ssl, err)) {
+        case SSL_ERROR_WANT_READ:  S.wantWrite = false; return 0;
+        case SSL_ERROR_WANT_WRITE: S.wantWrite = true; return 0;
+        default:
+            LOG(logLevelWarn, "TLS handshake with %s failed: %s", S.key.c_str(), sslError().c_str());
+            return -1;
+        }
+    }
+
+    isResumed = SSL_session_reused(S.ssl)==1;
+    cipher = SSL_get_cipher_name(S.ssl);
+#ifdef PVA_HAVE_KTLS
+    ktlsSend = BIO_get_ktls_send(SSL_get_wbio(S.ssl));
+    ktlsRecv = BIO_get_ktls_recv(SSL_get_rbio(S.ssl));
+#endif
+
+    // with SSL_VERIFY_PEER, any certificate presented has been verified
+    if(X509 *cert = PVA_SSL_GET_PEER_CERT(S.ssl)) {
+        char cn[256];
+        if(SSL_get_verify_result(S.ssl)==X509_V_OK
+                && X509_NAME_get_text_by_NID(X509_get_subject_name(cert), NID_commonName, cn, sizeof(cn))>0)
+            peer = cn;
+        X509_free(cert);
+    }
+
+    if(TLSContext::Pvt *ctx = static_cast<TLSContext::Pvt*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(S.ssl)))) {
+        Guard G(ctx->mutex);
+        if(isResumed)
+            ctx->nresumed++;
+        else
+            ctx->nfull++;
+    }
+
+    LOG(logLevelDebug, "TLS %s with %s using %s%s%s%s",
+        isResumed ? "resumed" : "established", S.key.c_str(), cipher.c_str(),
+        ktlsSend ? ", kTLS send" : "", ktlsRecv ? ", kTLS recv" : "",
+        peer.empty() ? "" : (", peer "+peer).c_str());
+
+    isEstablished = true;
+    return 1;
+#else
+    return -1;
+#endif
+}
+
+bool TLSSession::wantWrite() const
+{
+#ifdef PVA_HAVE_OPENSSL
+    Guard G(mutex);
+    return pvt->wantWrite;
+#else
+    return false;
+#endif
+}
+
+bool TLSSession::handshake(double timeout)
+{
+#ifdef PVA_HAVE_OPENSSL
+    epicsTimeStamp start;
+    epicsTimeGetCurrent(&start);
+
+    int ret;
+    while((ret = continueHandshake())==0) {
+        epicsTimeStamp now;
+        epicsTimeGetCurrent(&now);
+        double remaining = timeout - epicsTimeDiffInSeconds(&now, &start);
+        if(remaining<=0.0 || IOReactor::waitFor(pvt->sock, wantWrite(), remaining)<=0) {
+            LOG(logLevelWarn, "TLS handshake with %s timed out", pvt->key.c_str());
+            return false;
+        }
+    }
+    return ret>0;
+#else
+    (void)timeout;
+    return false;
+#endif
+}
+
+bool TLSSession::established() const
+{
+    Guard G(mutex);
+    return isEstablished;
+}
+
+int TLSSession::read(char* buf, std::size_t count)
+{
+#ifdef PVA_HAVE_OPENSSL
+    Guard G(mutex);
+    ERR_clear_error();
+    int n = SSL_read(pvt->ssl, buf, int(std::min(count, std::size_t(INT_MAX))));
+    if(n>0)
+        return n;
+    switch(SSL_get_error(pvt->ssl, n)) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        return 0;
+    default:
+        return -1; // includes close_notify from peer
+    }
+#else
+    (void)buf;
+    (void)count;
+    return -1;
+#endif
+}
+
+int TLSSession::write(const char* buf, std::size_t count)
+{
+#ifdef PVA_HAVE_OPENSSL
+    Guard G(mutex);
+    ERR_clear_error();
+    int n = SSL_write(pvt->ssl, buf, int(std::min(count, std::size_t(INT_MAX))));
+    if(n>0)
+        return n;
+    switch(SSL_get_error(pvt->ssl, n)) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        return 0;
+    default:
+        return -1;
+    }
+#else
+    (void)buf;
+    (void)count;
+    return -1;
+#endif
+}
+
+bool TLSSession::pending() const
+{
+#ifdef PVA_HAVE_OPENSSL
+    Guard G(mutex);
+    return SSL_pending(pvt->ssl)>0;
+#else
+    return false;
+#endif
+}
+
+X509SecurityPlugin::shared_pointer X509SecurityPlugin::CLIENT(new X509SecurityPlugin(false));
+X509SecurityPlugin::shared_pointer X509SecurityPlugin::SERVER(new X509SecurityPlugin(true));
+
+SecuritySession::shared_pointer X509SecurityPlugin::createSession(
+    osiSockAddr const & remoteAddress,
+    SecurityPluginControl::shared_pointer const & control,
+    epics::pvData::PVField::shared_pointer const & data)
+{
+    if(server) {
+        // the control is the transport being authenticated
+        detail::BlockingTCPTransportCodec *transport = dynamic_cast<detail::BlockingTCPTransportCodec*>(control.get());
+        TLSSession::shared_pointer tls;
+        if(transport)
+            tls = transport->getTLSSession();
+        if(!tls || tls->peerName().empty())
+            throw SecurityException("x509 authentication requires a TLS client certificate");
+
+        char ipAddrStr[48];
+        ipAddrToDottedIP(&remoteAddress.ia, ipAddrStr, sizeof(ipAddrStr));
+        LOG(logLevelDebug, "PVA client %s authenticated as '%s'", ipAddrStr, tls->peerName().c_str());
+    }
+    return NoSecurityPlugin::createSession(remoteAddress, control, data);
+}
+
+}
+}
@@ -0,0 +1,197 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include <string.h>
+#include <errno.h>
+
+#include <epicsTime.h>
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsThread.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_CAPTURE_USE_ATOMIC
+#endif
+#endif
+
+#define epicsExportSharedSymbols
+#include <pv/trafficCapture.h>
+#include <pv/logger.h>
+
+using epics::pvData::uint8;
+using epics::pvData::uint16;
+using epics::pvData::uint32;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+const char captureMagic[4] = {'P', 'V', 'A', 'R'};
+const uint8 captureVersion = 1u;
+
+// files created by this process
+size_t captureCount;
+
+#ifdef PVA_CAPTURE_USE_ATOMIC
+size_t nextCapture() { return epics::atomic::increment(captureCount); }
+#else
+epicsThreadOnceId countOnce = EPICS_THREAD_ONCE_INIT;
+epicsMutex *countMutex;
+
+void countInit(void*)
+{
+    countMutex = new epicsMutex;
+}
+
+size_t nextCapture()
+{
+    epicsThreadOnce(&countOnce, &countInit, 0);
+    epicsGuard<epicsMutex> G(*countMutex);
+    return ++captureCount;
+}
+#endif
+
+void putU32(char *buf, uint32 val)
+{
+    buf[0] = char(val>>24);
+    buf[1] = char(val>>16);
+    buf[2] = char(val>>8);
+    buf[3] = char(val);
+}
+
+uint32 getU32(const char *buf)
+{
+    const unsigned char *b = (const unsigned char*)buf;
+    return (uint32(b[0])<<24) | (uint32(b[1])<<16) | (uint32(b[2])<<8) | uint32(b[3]);
+}
+} // namespace
+
+TrafficCapture::shared_pointer TrafficCapture::create(const std::string& dir, bool server, const std::string& peer)
+{
+    std::string name(peer);
+    // ':' is not allowed in the file names of some targets
+    std::replace(name.begin(), name.end(), ':', '_');
+
+    char started[32];
+    epicsTime::getCurrent().strftime(started, sizeof(started), "%Y%m%dT%H%M%S");
+
+    std::ostringstream strm;
+    strm<<dir<<"/"<<(server ? "server-" : "client-")<<name<<"-"<<started
+        <<"-"<<nextCapture()<<".pvacap";
+    const std::string fname(strm.str());
+
+    FILE *fp = fopen(fname.c_str(), "wb");
+    if(!fp) {
+        LOG(logLevelError, "Unable to create capture file '%s' : %s", fname.c_str(), strerror(errno));
+        return shared_pointer();
+    }
+
+    const uint16 len = uint16(std::min(peer.size(), size_t(0xffff)));
+    char header[4+1+1+2];
+    memcpy(header, captureMagic, 4);
+    header[4] = char(captureVersion);
+    header[5] = server ? 1 : 0;
+    header[6] = char(len>>8);
+    header[7] = char(len);
+    if(fwrite(header, sizeof(header), 1, fp)!=1 || fwrite(peer.c_str(), 1, len, fp)!=len) {
+        LOG(logLevelError, "Unable to write capture file '%s' : %s", fname.c_str(), strerror(errno));
+        fclose(fp);
+        return shared_pointer();
+    }
+
+    LOG(logLevelInfo, "Capturing traffic from %s to '%s'", peer.c_str(), fname.c_str());
+    return shared_pointer(new TrafficCapture(fp, fname));
+}
+
+TrafficCapture::TrafficCapture(FILE *fp, const std::string& fname)
+    :fp(fp)
+    ,fname(fname)
+    ,failed(false)
+{}
+
+TrafficCapture::~TrafficCapture()
+{
+    fclose(fp);
+}
+
+void TrafficCapture::write(const char* buf, std::size_t count)
+{
+    if(failed || count==0u)
+        return;
+
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+
+    char header[12];
+    putU32(header, now.secPastEpoch);
+    putU32(header+4, now.nsec);
+    putU32(header+8, uint32(count));
+    if(fwrite(header, sizeof(header), 1, fp)!=1 || fwrite(buf, 1, count, fp)!=count) {
+        // a partial capture is still useful up to here, so stop, but don't disturb the transport
+        LOG(logLevelError, "Capture to '%s' stopped : %s", fname.c_str(), strerror(errno));
+        failed = true;
+    }
+}
+
+TrafficReplay::TrafficReplay(const std::string& path)
+    :fp(fopen(path.c_str(), "rb"))
+    ,isServer(false)
+{
+    if(!fp)
+        throw std::runtime_error(std::string("Unable to open ")+path+" : "+strerror(errno));
+
+    char header[4+1+1+2];
+    if(fread(header, sizeof(header), 1, fp)!=1 || memcmp(header, captureMagic, 4)!=0) {
+        fclose(fp);
+        throw std::runtime_error(path+" is not a traffic capture");
+    }
+    if(uint8(header[4])!=captureVersion) {
+        fclose(fp);
+        throw std::runtime_error(path+" is a capture of an unknown version");
+    }
+    isServer = header[5]!=0;
+
+    const size_t len = (size_t(uint8(header[6]))<<8) | uint8(header[7]);
+    peerName.resize(len);
+    if(len && fread(&peerName[0], 1, len, fp)!=len) {
+        fclose(fp);
+        throw std::runtime_error(path+" is truncated");
+    }
+}
+
+TrafficReplay::~TrafficReplay()
+{
+    fclose(fp);
+}
+
+bool TrafficReplay::next(epicsTimeStamp& received, std::vector<char>& data)
+{
+    char header[12];
+    size_t n = fread(header, 1, sizeof(header), fp);
+    if(n==0u)
+        return false;
+    else if(n!=sizeof(header))
+        throw std::runtime_error("Truncated capture record");
+
+    received.secPastEpoch = getU32(header);
+    received.nsec = getU32(header+4);
+    const uint32 count = getU32(header+8);
+
+    data.resize(count);
+    if(count && fread(&data[0], 1, count, fp)!=count)
+        throw std::runtime_error("Truncated capture record");
+    return true;
+}
+
+}
+}
@@ -33,6 +33,25 @@ bool TransportRegistry::Key::operator<(const Key& o) const
     return false;
 }
 
+bool TransportRegistry::Key::operator==(const Key& o) const
+{
+    return addr.sa.sa_family==o.addr.sa.sa_family
+            && addr.ia.sin_addr.s_addr==o.addr.ia.sin_addr.s_addr
+            && addr.ia.sin_port==o.addr.ia.sin_port
+            && prio==o.prio;
+}
+
+size_t TransportRegistry::KeyHash::operator()(const Key& k) const
+{
+    // fold so that hosts differing only in the low bits of the address land in different shards
+    pvd::uint32 h = pvd::uint32(k.addr.ia.sin_addr.s_addr);
+    h ^= pvd::uint32(k.addr.ia.sin_port)<<16;
+    h ^= pvd::uint32(pvd::uint16(k.prio));
+    h ^= h>>16;
+    h ^= h>>8;
+    return h;
+}
+
 TransportRegistry::Reservation::Reservation(TransportRegistry *owner,
                                             const osiSockAddr& address,
                                             pvd::int16 prio)
@@ -41,31 +60,40 @@ TransportRegistry::Reservation::Reservation(TransportRegistry *owner,
 {
     {
         pvd::Lock G(owner->_mutex);
-
-        std::tr1::shared_ptr<pvd::Mutex>& lock = owner->locks[key]; // fetch or alloc
-        if(!lock)
-            lock.reset(new pvd::Mutex());
-
-        mutex = lock;
+        startSeq = owner->failSeq;
+        owner->inflight++;
     }
-
-    mutex->lock();
+    owner->locks.lock(key);
 }
 
 TransportRegistry::Reservation::~Reservation()
 {
-    mutex->unlock();
+    owner->locks.unlock(key);
 
     pvd::Lock G(owner->_mutex);
-
-    assert(mutex.use_count()>=2);
-
-    if(mutex.use_count()==2) {
-        // no other concurrent connect(), so can drop this lock
-        owner->locks.erase(key);
+    assert(owner->inflight>0u);
+    if(--owner->inflight==0u) {
+        // no one remains who could be waiting on these
+        owner->failures.clear();
     }
+}
 
-    assert(mutex.use_count()==1);
+bool TransportRegistry::Reservation::sharedFailure(std::string& msg) const
+{
+    pvd::Lock G(owner->_mutex);
+    failures_t::const_iterator it(owner->failures.find(key));
+    if(it==owner->failures.end() || it->second.seq<=startSeq)
+        return false;
+    msg = it->second.message;
+    return true;
+}
+
+void TransportRegistry::Reservation::failed(const std::string& msg)
+{
+    pvd::Lock G(owner->_mutex);
+    Failure& fail = owner->failures[key];
+    fail.message = msg;
+    fail.seq = ++owner->failSeq;
 }
 
 TransportRegistry::~TransportRegistry()
@@ -97,6 +125,7 @@ void TransportRegistry::install(const Transport::shared_pointer& ptr)
     std::pair<transports_t::iterator, bool> itpair(transports.insert(std::make_pair(key, ptr)));
     if(!itpair.second)
         THROW_EXCEPTION2(std::logic_error, "Refuse to insert dup");
+    failures.erase(key);
 }
 
 Transport::shared_pointer TransportRegistry::remove(Transport::shared_pointer const & transport)
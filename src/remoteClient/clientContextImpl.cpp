@@ -5,14 +5,45 @@
  */
 
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <memory>
 #include <queue>
+#include <deque>
+#include <set>
+#include <vector>
 #include <stdexcept>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
 
 #include <osiSock.h>
 #include <epicsGuard.h>
+#include <epicsTime.h>
 #include <epicsAssert.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_CLIENT_USE_ATOMIC
+#endif
+#endif
+
+// for EPICS_PVA_SERVER_CACHE_FILE
+#if defined(_WIN32)
+#  include <process.h>
+#  define SERVER_CACHE_PID() _getpid()
+#elif defined(vxWorks)
+#  include <taskLib.h>
+#  define SERVER_CACHE_PID() taskIdSelf()
+#else
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/file.h>
+#  define PVA_SERVER_CACHE_POSIX
+#endif
 
 #include <pv/lock.h>
 #include <pv/timer.h>
@@ -37,6 +68,14 @@
 #include <pv/beaconHandler.h>
 #include <pv/logger.h>
 #include <pv/securityImpl.h>
+#include <pv/idTable.h>
+#include <pv/ringBuffer.h>
+#include <pv/metrics.h>
+#include <pv/internedName.h>
+#include <pv/arrayDelta.h>
+#include <pv/fieldOffsets.h>
+#include <pv/arrayPool.h>
+#include <pv/reconnectPacer.h>
 
 #include <pv/pvAccessMB.h>
 
@@ -48,6 +87,8 @@ using std::tr1::static_pointer_cast;
 using namespace std;
 using namespace epics::pvData;
 
+MB_DECLARE_EXTERN(pvaRequest);
+
 namespace epics {
 namespace pvAccess {
 
@@ -63,9 +104,75 @@ using namespace epics::pvAccess;
 class ChannelGetFieldRequestImpl;
 
 // TODO consider std::unordered_map
-//typedef std::tr1::unordered_map<pvAccessID, ResponseRequest::weak_pointer> IOIDResponseRequestMap;
-typedef std::map<pvAccessID, ResponseRequest::weak_pointer> IOIDResponseRequestMap;
+typedef IDTable<ResponseRequest::weak_pointer> IOIDResponseRequestMap;
+
+
+/* Held by one process at a time while EPICS_PVA_SERVER_CACHE_FILE is read, merged and replaced,
+ * so that the entries of one are not lost when another saves at the same time.
+ * Only where flock() is available.
+ */
+struct ServerCacheFileLock {
+#ifdef PVA_SERVER_CACHE_POSIX
+    int fd;
+    explicit ServerCacheFileLock(const string& file)
+        :fd(::open((file+".lock").c_str(), O_RDWR|O_CREAT, 0600))
+    {
+        if(fd>=0) {
+            while(::flock(fd, LOCK_EX)!=0 && errno==EINTR) {}
+        }
+    }
+    ~ServerCacheFileLock() {
+        if(fd>=0)
+            ::close(fd); // releases
+    }
+#else
+    explicit ServerCacheFileLock(const string&) {}
+#endif
+};
 
+/* Write text to a new file named after file, readable only by this user.
+ * @returns its name, or empty on error.
+ */
+string writeServerCacheTemp(const string& file, const string& text)
+{
+#ifdef PVA_SERVER_CACHE_POSIX
+    // mkstemp() creates with mode 0600, whatever the umask
+    std::vector<char> name(file.begin(), file.end());
+    const char suffix[] = ".XXXXXX";
+    name.insert(name.end(), suffix, suffix+sizeof(suffix));
+    int fd = mkstemp(&name[0]);
+    if(fd<0)
+        return string();
+
+    size_t done = 0;
+    while(done < text.size()) {
+        ssize_t n = ::write(fd, text.data()+done, text.size()-done);
+        if(n<0 && errno==EINTR)
+            continue;
+        else if(n<=0)
+            break;
+        done += size_t(n);
+    }
+    const bool ok = ::close(fd)==0 && done==text.size();
+    if(!ok) {
+        remove(&name[0]);
+        return string();
+    }
+    return string(&name[0]);
+#else
+    std::ostringstream name;
+    name << file << '.' << SERVER_CACHE_PID() << '.' << epicsTime::getCurrent().nsec;
+    const string temp(name.str());
+
+    std::ofstream strm(temp.c_str(), std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    if(!(strm << text) || !(strm.flush())) {
+        strm.close();
+        remove(temp.c_str());
+        return string();
+    }
+    return temp;
+#endif
+}
 
 #define EXCEPTION_GUARD(code) do { code; } while(0)
 
@@ -141,6 +248,19 @@ private:
     // holds: NULL_REQUEST, PURE_DESTROY_REQUEST, PURE_CANCEL_REQUEST, or
     // a mask of QOS_*
     int32 m_pendingRequest;
+
+    struct Queued {
+        int32 qos;
+        // of a put(), else NULL
+        PVStructure::shared_pointer value;
+        BitSet::shared_pointer changed;
+    };
+    // of m_pendingRequest, if passed to startPipelined()
+    Queued m_pendingValue;
+    // pipelined requests made while another was pending, sent after it
+    std::deque<Queued> m_queued;
+    // requests sent and not yet answered
+    size_t m_inflight;
 protected:
 
     Mutex m_mutex;
@@ -202,13 +322,21 @@ protected:
 
     AtomicBoolean m_subscribed;
 
+    // non-zero while a traced request is in progress.  m_span is guarded by m_mutex
+    int m_traced;
+    bool m_traceSend;
+    Span m_span;
+
     BaseRequestImpl(ClientChannelImpl::shared_pointer const & channel) :
         m_channel(channel),
         m_ioid(INVALID_IOID),
         m_pendingRequest(NULL_REQUEST),
+        m_inflight(0u),
         m_destroyed(false),
         m_initialized(false),
-        m_subscribed()
+        m_subscribed(),
+        m_traced(0),
+        m_traceSend(false)
     {
         REFTRACE_INCREMENT(num_instances);
     }
@@ -237,20 +365,171 @@ protected:
         else
         {return false; /* others not allowed */}
 
+        if(qos==PURE_DESTROY_REQUEST)
+            m_queued.clear();
+        m_pendingValue = Queued();
         m_pendingRequest = qos;
         return true;
     }
 
+    //! How many get or put requests may be outstanding, 1 unless the server pipelines
+    size_t pipelineWindow() {
+        Transport::shared_pointer transport(m_channel->getTransport());
+        return transport ? size_t(transport->getPipelineWindow()) : 1u;
+    }
+
+    enum {
+        REQUEST_REJECTED,
+        //! As startRequest(), the caller queues us to send
+        REQUEST_STARTED,
+        //! Will be sent after the pending request
+        REQUEST_QUEUED
+    };
+
+    /* As startRequest(), or with a window of more than one, queue behind a pending request
+     * until window requests are outstanding, or waiting to be sent.
+     * value and changed of a put() are held until sent.
+     */
+    int startPipelined(int32 qos, size_t window,
+                       PVStructure::shared_pointer const & value = PVStructure::shared_pointer(),
+                       BitSet::shared_pointer const & changed = BitSet::shared_pointer()) {
+        Lock guard(m_mutex);
+        if(window<=1u)
+            return startRequest(qos) ? REQUEST_STARTED : REQUEST_REJECTED;
+
+        const size_t outstanding = m_inflight + m_queued.size() + (m_pendingRequest==NULL_REQUEST ? 0u : 1u);
+        if(m_pendingRequest==PURE_DESTROY_REQUEST || outstanding>=window)
+            return REQUEST_REJECTED;
+
+        Queued entry;
+        entry.qos = qos;
+        entry.value = value;
+        entry.changed = changed;
+        if(m_pendingRequest!=NULL_REQUEST) {
+            m_queued.push_back(entry);
+            return REQUEST_QUEUED;
+        }
+        m_pendingValue = entry;
+        m_pendingRequest = qos;
+        return REQUEST_STARTED;
+    }
+
     int32 beginRequest() {
+        PVStructure::shared_pointer value;
+        BitSet::shared_pointer changed;
+        return beginRequest(value, changed);
+    }
+
+    //! value and changed are those passed to startPipelined(), if any
+    int32 beginRequest(PVStructure::shared_pointer& value, BitSet::shared_pointer& changed) {
         Lock guard(m_mutex);
         int32 ret = m_pendingRequest;
         m_pendingRequest = NULL_REQUEST;
+        value.swap(m_pendingValue.value);
+        changed.swap(m_pendingValue.changed);
+        m_pendingValue = Queued();
+        if(ret>=0 && !(ret & QOS_INIT))
+            m_inflight++;
         return ret;
     }
 
+    //! From send(), after beginRequest().  The next request queued by startPipelined()
+    bool nextQueued(int32& qos, PVStructure::shared_pointer& value, BitSet::shared_pointer& changed) {
+        Lock guard(m_mutex);
+        if(m_queued.empty())
+            return false;
+        qos = m_queued.front().qos;
+        value.swap(m_queued.front().value);
+        changed.swap(m_queued.front().changed);
+        m_queued.pop_front();
+        m_inflight++;
+        return true;
+    }
+
     void abortRequest() {
         Lock guard(m_mutex);
         m_pendingRequest = NULL_REQUEST;
+        m_pendingValue = Queued();
+        m_queued.clear();
+        m_inflight = 0u;
+        setTraced(0);
+    }
+
+    // with m_mutex held
+    void setTraced(int traced) {
+#ifdef PVA_CLIENT_USE_ATOMIC
+        epics::atomic::set(m_traced, traced);
+#else
+        m_traced = traced;
+#endif
+    }
+
+    // a hint, as most requests are not traced
+    bool isTraced() {
+#ifdef PVA_CLIENT_USE_ATOMIC
+        return epics::atomic::get(m_traced)!=0;
+#else
+        Lock guard(m_mutex);
+        return m_traced!=0;
+#endif
+    }
+
+    // from the thread issuing a request, before it is queued.
+    // A child of the current TraceScope of this thread, or a new trace.
+    void traceStart(Transport::shared_pointer const & transport, const char *name) {
+        if (!transport->isTracing())
+            return;
+        const TraceContext *parent = TraceScope::current();
+
+        Lock guard(m_mutex);
+        m_span = Span();
+        if (parent) {
+            m_span.context = parent->child();
+            memcpy(m_span.parentId, parent->spanId, sizeof(m_span.parentId));
+        } else {
+            m_span.context = TraceContext::root();
+        }
+        m_span.name = name;
+        m_span.channel = m_channel->getChannelName();
+        m_span.peer = transport->getRemoteName();
+        epicsTimeGetCurrent(&m_span.start);
+        m_traceSend = transport->isPeerTracing();
+        setTraced(1);
+    }
+
+    // from send(), ahead of the request message
+    void traceSend(ByteBuffer* buffer, TransportSendControl* control) {
+        if (!isTraced())
+            return;
+        TraceContext context;
+        {
+            Lock guard(m_mutex);
+            epicsTimeGetCurrent(&m_span.dispatch);
+            if (!m_traceSend)
+                return;
+            context = m_span.context;
+        }
+        control->startMessage((int8)CMD_TRACE_CONTEXT, TraceContext::wireSize);
+        context.serialize(buffer);
+        control->endMessage();
+    }
+
+    // on response.  Ends when the server's trace context, or else the response, was received
+    void traceEnd(Transport::shared_pointer const & transport) {
+        if (!isTraced())
+            return;
+        Span span;
+        {
+            Lock guard(m_mutex);
+            if (!m_traced)
+                return;
+            setTraced(0);
+            span = m_span;
+        }
+        TraceContext reply;
+        if (!transport->receivedTrace(reply, span.end))
+            epicsTimeGetCurrent(&span.end);
+        TraceSink::recordAll(span);
     }
 
 public:
@@ -284,13 +563,19 @@ public:
         {
             bool destroyReq = false;
 
-            if (qos & QOS_DESTROY)
             {
                 Lock G(m_mutex);
-                m_initialized = false;
-                destroyReq = true;
+                if (m_inflight)
+                    m_inflight--;
+                if (qos & QOS_DESTROY)
+                {
+                    m_initialized = false;
+                    destroyReq = true;
+                }
             }
 
+            traceEnd(transport);
+
             normalResponse(transport, version, payloadBuffer, qos, status);
 
             if (destroyReq)
@@ -603,18 +888,34 @@ public:
         if (pendingRequest < 0)
         {
             base_send(buffer, control, pendingRequest);
-            return;
         }
+        else
+        {
+            traceSend(buffer, control);
 
-        control->startMessage((int8)CMD_GET, 9);
-        buffer->putInt(m_channel->getServerChannelID());
-        buffer->putInt(m_ioid);
-        buffer->putByte((int8)pendingRequest);
+            control->startMessage((int8)CMD_GET, 9);
+            buffer->putInt(m_channel->getServerChannelID());
+            buffer->putInt(m_ioid);
+            buffer->putByte((int8)pendingRequest);
+
+            if (initStage)
+            {
+                // pvRequest
+                SerializationHelper::serializePVRequest(buffer, control, m_pvRequest);
+            }
+        }
 
-        if (initStage)
+        // pipelined, answered in this order
+        int32 qos;
+        PVStructure::shared_pointer value;
+        BitSet::shared_pointer changed;
+        while (nextQueued(qos, value, changed))
         {
-            // pvRequest
-            SerializationHelper::serializePVRequest(buffer, control, m_pvRequest);
+            control->endMessage();
+            control->startMessage((int8)CMD_GET, 9);
+            buffer->putInt(m_channel->getServerChannelID());
+            buffer->putInt(m_ioid);
+            buffer->putByte((int8)qos);
         }
     }
 
@@ -648,10 +949,14 @@ public:
         {
             Lock lock(m_structureMutex);
             m_bitSet->deserialize(payloadBuffer, transport.get());
-            m_structure->deserialize(payloadBuffer, transport.get(), m_bitSet.get());
+            deserializeChanged(payloadBuffer, transport.get(), *m_structure, *m_bitSet);
         }
 
+        MB_POINT_ID(pvaRequest, 21, "client get deserialized", m_ioid);
+
         EXCEPTION_GUARD3(m_callback, cb, cb->getDone(status, external_from_this<ChannelGetImpl>(), m_structure, m_bitSet));
+
+        MB_POINT_ID(pvaRequest, 22, "client getDone() returned", m_ioid);
     }
 
     virtual void get() OVERRIDE FINAL {
@@ -682,13 +987,20 @@ public:
                         return;
                     }
           */
-        if (!startRequest(m_lastRequest.get() ? QOS_DESTROY | QOS_GET : QOS_DEFAULT)) {
+        const int started = startPipelined(m_lastRequest.get() ? QOS_DESTROY | QOS_GET : QOS_DEFAULT, pipelineWindow());
+        if (started==REQUEST_REJECTED) {
             EXCEPTION_GUARD3(m_callback, cb, cb->getDone(otherRequestPendingStatus, thisPtr, PVStructurePtr(), BitSetPtr()));
             return;
+        } else if (started==REQUEST_QUEUED) {
+            return;
         }
 
+        MB_POINT_ID(pvaRequest, 20, "client get issued", m_ioid);
+
         try {
-            m_channel->checkAndGetTransport()->enqueueSendRequest(internal_from_this<ChannelGetImpl>());
+            Transport::shared_pointer transport(m_channel->checkAndGetTransport());
+            traceStart(transport, "pva.get");
+            transport->enqueueSendRequest(internal_from_this<ChannelGetImpl>());
             //TODO bulk hack m_channel->checkAndGetTransport()->enqueueOnlySendRequest(thisSender);
         } catch (std::runtime_error &rte) {
             abortRequest();
@@ -748,6 +1060,9 @@ public:
 
     Mutex m_structureMutex;
 
+    // copies of pipelined put()s, recycled once sent.  Guarded by m_mutex
+    std::vector<std::pair<PVStructure::shared_pointer, BitSet::shared_pointer> > m_spareValues;
+
     ChannelPutImpl(ClientChannelImpl::shared_pointer const & channel,
                    ChannelPutRequester::shared_pointer const & requester,
                    PVStructure::shared_pointer const & pvRequest) :
@@ -785,34 +1100,69 @@ public:
     ChannelBaseRequester::shared_pointer getRequester() OVERRIDE FINAL { return m_callback.lock(); }
 
     virtual void send(ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL {
-        int32 pendingRequest = beginRequest();
+        PVStructure::shared_pointer value;
+        BitSet::shared_pointer changed;
+        int32 pendingRequest = beginRequest(value, changed);
         if (pendingRequest < 0)
         {
             base_send(buffer, control, pendingRequest);
-            return;
         }
+        else
+        {
+            traceSend(buffer, control);
 
-        control->startMessage((int8)CMD_PUT, 9);
-        buffer->putInt(m_channel->getServerChannelID());
-        buffer->putInt(m_ioid);
-        buffer->putByte((int8)pendingRequest);
+            control->startMessage((int8)CMD_PUT, 9);
+            buffer->putInt(m_channel->getServerChannelID());
+            buffer->putInt(m_ioid);
+            buffer->putByte((int8)pendingRequest);
 
-        if (pendingRequest & QOS_INIT)
-        {
-            // pvRequest
-            SerializationHelper::serializePVRequest(buffer, control, m_pvRequest);
-        }
-        else if (!(pendingRequest & QOS_GET))
-        {
-            // put
-            // serialize only what has been changed
+            if (pendingRequest & QOS_INIT)
             {
-                // no need to lock here, since it is already locked via TransportSender IF
-                //Lock lock(m_structureMutex);
-                m_bitSet->serialize(buffer, control);
-                m_structure->serialize(buffer, control, m_bitSet.get());
+                // pvRequest
+                SerializationHelper::serializePVRequest(buffer, control, m_pvRequest);
+            }
+            else if (value)
+            {
+                // pipelined put
+                sendValue(buffer, control, value, changed);
+            }
+            else if (!(pendingRequest & QOS_GET))
+            {
+                // put
+                // serialize only what has been changed
+                {
+                    // no need to lock here, since it is already locked via TransportSender IF
+                    //Lock lock(m_structureMutex);
+                    m_bitSet->serialize(buffer, control);
+                    m_structure->serialize(buffer, control, m_bitSet.get());
+                }
             }
         }
+
+        // pipelined, answered in this order
+        int32 qos;
+        while (nextQueued(qos, value, changed))
+        {
+            control->endMessage();
+            control->startMessage((int8)CMD_PUT, 9);
+            buffer->putInt(m_channel->getServerChannelID());
+            buffer->putInt(m_ioid);
+            buffer->putByte((int8)qos);
+
+            if (value)
+                sendValue(buffer, control, value, changed);
+        }
+    }
+
+    void sendValue(ByteBuffer* buffer, TransportSendControl* control,
+                   PVStructure::shared_pointer& value, BitSet::shared_pointer& changed) {
+        changed->serialize(buffer, control);
+        value->serialize(buffer, control, changed.get());
+
+        Lock guard(m_mutex);
+        m_spareValues.push_back(std::make_pair(value, changed));
+        value.reset();
+        changed.reset();
     }
 
     virtual void initResponse(Transport::shared_pointer const & transport, int8 /*version*/, ByteBuffer* payloadBuffer, int8 /*qos*/, const Status& status) OVERRIDE FINAL {
@@ -848,7 +1198,7 @@ public:
             {
                 Lock lock(m_structureMutex);
                 m_bitSet->deserialize(payloadBuffer, transport.get());
-                m_structure->deserialize(payloadBuffer, transport.get(), m_bitSet.get());
+                deserializeChanged(payloadBuffer, transport.get(), *m_structure, *m_bitSet);
             }
 
             EXCEPTION_GUARD3(m_callback, cb, cb->getDone(status, thisPtr, m_structure, m_bitSet));
@@ -875,14 +1225,19 @@ public:
             }
         }
 
-        if (!startRequest(m_lastRequest.get() ? QOS_GET | QOS_DESTROY : QOS_GET)) {
+        const int started = startPipelined(m_lastRequest.get() ? QOS_GET | QOS_DESTROY : QOS_GET, pipelineWindow());
+        if (started==REQUEST_REJECTED) {
             EXCEPTION_GUARD3(m_callback, cb, cb->getDone(otherRequestPendingStatus, thisPtr, PVStructurePtr(), BitSetPtr()));
             return;
+        } else if (started==REQUEST_QUEUED) {
+            return;
         }
 
 
         try {
-            m_channel->checkAndGetTransport()->enqueueSendRequest(internal_from_this<ChannelPutImpl>());
+            Transport::shared_pointer transport(m_channel->checkAndGetTransport());
+            traceStart(transport, "pva.get");
+            transport->enqueueSendRequest(internal_from_this<ChannelPutImpl>());
         } catch (std::runtime_error &rte) {
             abortRequest();
             EXCEPTION_GUARD3(m_callback, cb, cb->getDone(channelNotConnected, thisPtr, PVStructurePtr(), BitSetPtr()));
@@ -918,18 +1273,48 @@ public:
             return;
         }
 
-        if (!startRequest(m_lastRequest.get() ? QOS_DESTROY : QOS_DEFAULT)) {
+        // when pipelined, a copy, since m_structure may yet be sent for a pending request
+        const size_t window = pipelineWindow();
+        PVStructure::shared_pointer value;
+        BitSet::shared_pointer changed;
+        if (window > 1u)
+        {
+            {
+                Lock guard(m_mutex);
+                if (!m_spareValues.empty())
+                {
+                    value = m_spareValues.back().first;
+                    changed = m_spareValues.back().second;
+                    m_spareValues.pop_back();
+                }
+            }
+            if (!value)
+            {
+                value = pvDataCreate->createPVStructure(m_structure->getStructure());
+                changed = createBitSetFor(value, changed);
+            }
+            *changed = *pvPutBitSet;
+            value->copyUnchecked(*pvPutStructure, *changed);
+        }
+
+        const int started = startPipelined(m_lastRequest.get() ? QOS_DESTROY : QOS_DEFAULT, window, value, changed);
+        if (started==REQUEST_REJECTED) {
             EXCEPTION_GUARD3(m_callback, cb, cb->putDone(otherRequestPendingStatus, thisPtr));
             return;
+        } else if (started==REQUEST_QUEUED) {
+            return;
         }
 
         try {
+            if (!value)
             {
                 epicsGuard<ChannelPutImpl> G(*this);
                 *m_bitSet = *pvPutBitSet;
                 m_structure->copyUnchecked(*pvPutStructure, *m_bitSet);
             }
-            m_channel->checkAndGetTransport()->enqueueSendRequest(internal_from_this<ChannelPutImpl>());
+            Transport::shared_pointer transport(m_channel->checkAndGetTransport());
+            traceStart(transport, "pva.put");
+            transport->enqueueSendRequest(internal_from_this<ChannelPutImpl>());
         } catch (std::runtime_error &rte) {
             abortRequest();
             EXCEPTION_GUARD3(m_callback, cb, cb->putDone(channelNotConnected, thisPtr));
@@ -1340,6 +1725,8 @@ public:
             return;
         }
 
+        traceSend(buffer, control);
+
         control->startMessage((int8)CMD_RPC, 9);
         buffer->putInt(m_channel->getServerChannelID());
         buffer->putInt(m_ioid);
@@ -1418,7 +1805,9 @@ public:
                 m_structure = pvArgument;
             }
 
-            m_channel->checkAndGetTransport()->enqueueSendRequest(internal_from_this<ChannelRPCImpl>());
+            Transport::shared_pointer transport(m_channel->checkAndGetTransport());
+            traceStart(transport, "pva.rpc");
+            transport->enqueueSendRequest(internal_from_this<ChannelRPCImpl>());
         } catch (std::runtime_error &rte) {
             abortRequest();
             EXCEPTION_GUARD3(m_callback, cb, cb->requestDone(channelNotConnected, thisPtr, PVStructurePtr()));
@@ -1464,6 +1853,68 @@ public:
 
 
 
+// replace the content of last with the elements of parts, followed by its own
+template<typename A>
+void joinParts(A& last, const std::vector<PVArray::shared_pointer>& parts)
+{
+    typename A::const_svector tail(last.view());
+    size_t total = tail.size();
+    for(size_t i=0; i<parts.size(); i++)
+        total += static_cast<const A&>(*parts[i]).view().size();
+
+    typename A::svector out(total);
+    typename A::svector::iterator it(out.begin());
+    for(size_t i=0; i<parts.size(); i++) {
+        typename A::const_svector part(static_cast<const A&>(*parts[i]).view());
+        it = std::copy(part.begin(), part.end(), it);
+    }
+    std::copy(tail.begin(), tail.end(), it);
+    last.replace(freeze(out));
+}
+
+void joinParts(PVArray& last, const std::vector<PVArray::shared_pointer>& parts)
+{
+    if(parts.empty())
+        return;
+
+    switch(last.getField()->getType()) {
+    case structureArray:
+        joinParts(static_cast<PVStructureArray&>(last), parts);
+        return;
+    case unionArray:
+        joinParts(static_cast<PVUnionArray&>(last), parts);
+        return;
+    default:
+        break;
+    }
+
+    PVScalarArray& dst(static_cast<PVScalarArray&>(last));
+    const ScalarType type(dst.getScalarArray()->getElementType());
+    if(type==pvString) {
+        joinParts(static_cast<PVStringArray&>(last), parts);
+        return;
+    }
+
+    // untyped, so sizes are in bytes
+    shared_vector<const void> tail;
+    dst.getAs(tail);
+    size_t total = tail.size();
+    std::vector<shared_vector<const void> > bytes(parts.size());
+    for(size_t i=0; i<parts.size(); i++) {
+        static_cast<const PVScalarArray&>(*parts[i]).getAs(bytes[i]);
+        total += bytes[i].size();
+    }
+
+    shared_vector<void> out(ScalarTypeFunc::allocArray(type, total/ScalarTypeFunc::elementSize(type)));
+    char *pos = static_cast<char*>(out.data());
+    for(size_t i=0; i<bytes.size(); i++) {
+        memcpy(pos, bytes[i].data(), bytes[i].size());
+        pos += bytes[i].size();
+    }
+    memcpy(pos, tail.data(), tail.size());
+    dst.putFrom(freeze(out));
+}
+
 class ChannelArrayImpl :
     public BaseRequestImpl,
     public ChannelArray
@@ -1482,6 +1933,10 @@ public:
 
     size_t m_length;
 
+    // of a get received in parts.  Those kept for getArrayDone(), and the offset of the next
+    std::vector<PVArray::shared_pointer> m_parts;
+    size_t m_partOffset;
+
     Mutex m_structureMutex;
 
     ChannelArrayImpl(ClientChannelImpl::shared_pointer const & channel,
@@ -1491,7 +1946,8 @@ public:
         m_callback(requester),
         m_pvRequest(pvRequest),
         m_offset(0), m_count(0),
-        m_length(0)
+        m_length(0),
+        m_partOffset(0)
     {
     }
 
@@ -1594,13 +2050,43 @@ public:
         {
             if (!status.isSuccess())
             {
+                {
+                    Lock lock(m_structureMutex);
+                    m_parts.clear();
+                    m_partOffset = 0;
+                }
                 EXCEPTION_GUARD3(m_callback, cb, cb->getArrayDone(status, thisPtr, PVArray::shared_pointer()));
                 return;
             }
 
+            if (qos & QOS_MORE)
+            {
+                // a part, asked for by record[chunk=N]
+                PVArray::shared_pointer part(static_pointer_cast<PVArray>(getPVDataCreate()->createPVField(m_arrayData->getArray())));
+                size_t offset;
+                {
+                    Lock lock(m_structureMutex);
+                    part->deserialize(payloadBuffer, transport.get());
+                    offset = m_partOffset;
+                    m_partOffset += part->getLength();
+                }
+
+                bool consumed = false;
+                EXCEPTION_GUARD3(m_callback, cb, consumed = cb->getArrayChunk(thisPtr, part, offset));
+                if (!consumed)
+                {
+                    Lock lock(m_structureMutex);
+                    m_parts.push_back(part);
+                }
+                return;
+            }
+
             {
                 Lock lock(m_structureMutex);
                 m_arrayData->deserialize(payloadBuffer, transport.get());
+                joinParts(*m_arrayData, m_parts);
+                m_parts.clear();
+                m_partOffset = 0;
             }
 
             EXCEPTION_GUARD3(m_callback, cb, cb->getArrayDone(status, thisPtr, m_arrayData));
@@ -1651,6 +2137,8 @@ public:
                 m_offset = offset;
                 m_count = count;
                 m_stride = stride;
+                m_parts.clear();
+                m_partOffset = 0;
             }
             m_channel->checkAndGetTransport()->enqueueSendRequest(internal_from_this<ChannelArrayImpl>());
         } catch (std::runtime_error &rte) {
@@ -1807,23 +2295,28 @@ class MonitorStrategy : public Monitor {
 public:
     virtual ~MonitorStrategy() {};
     virtual void init(StructureConstPtr const & structure) = 0;
-    virtual void response(Transport::shared_pointer const & transport, ByteBuffer* payloadBuffer) = 0;
+    virtual void response(Transport::shared_pointer const & transport, ByteBuffer* payloadBuffer, int8 qos) = 0;
     virtual void unlisten() = 0;
 };
 
 typedef vector<MonitorElement::shared_pointer> FreeElementQueue;
-typedef queue<MonitorElement::shared_pointer> MonitorElementQueue;
+typedef RingBuffer<MonitorElement::shared_pointer> MonitorElementQueue;
 
 
 class MonitorStrategyQueue :
     public MonitorStrategy,
     public TransportSender,
+    public detail::ReceiveBatch::Deferred,
     public std::tr1::enable_shared_from_this<MonitorStrategyQueue>
 {
 private:
 
     const int32 m_queueSize;
 
+    // storage of changed arrays, or NULL when the type has none or pooling is disabled
+    const size_t m_arrayPoolBytes;
+    ArrayPool::shared_pointer m_arrayPool;
+
     StructureConstPtr m_lastStructure;
     FreeElementQueue m_freeQueue;
     MonitorElementQueue m_monitorQueue;
@@ -1835,6 +2328,8 @@ private:
 
     BitSet m_bitSet1;
     BitSet m_bitSet2;
+    // of an update with QOS_DELTA
+    BitSet m_deltas;
     MonitorElement::shared_pointer m_overrunElement;
     bool m_overrunInProgress;
 
@@ -1850,15 +2345,36 @@ private:
     const bool m_pipeline;
     const int32 m_ackAny;
 
+    // adaptive window.  Elements allocated, from m_queueSize up to m_maxQueueSize
+    const int32 m_maxQueueSize;
+    int32 m_window;
+    // updates the server may still send before our next ack
+    int32 m_credit;
+
     bool m_unlisten;
+    // monitorEvent() deferred until the updates read with this one are deserialized
+    bool m_eventDeferred;
+
+    // m_monitorQueue.size(), plus one while m_unlisten.  Read by poll() without m_mutex
+    size_t m_ready;
+    void updateReady() {
+        const size_t n = m_monitorQueue.size() + (m_unlisten ? 1u : 0u);
+#ifdef PVA_CLIENT_USE_ATOMIC
+        epics::atomic::set(m_ready, n);
+#else
+        m_ready = n;
+#endif
+    }
 
 public:
 
     MonitorStrategyQueue(ClientChannelImpl::shared_pointer channel, pvAccessID ioid,
                          MonitorRequester::weak_pointer const & callback,
                          int32 queueSize,
-                         bool pipeline, int32 ackAny) :
-        m_queueSize(queueSize), m_lastStructure(),
+                         bool pipeline, int32 ackAny,
+                         int32 maxQueueSize,
+                         size_t arrayPoolBytes) :
+        m_queueSize(queueSize), m_arrayPoolBytes(arrayPoolBytes), m_lastStructure(),
         m_freeQueue(),
         m_monitorQueue(),
         m_callback(callback), m_mutex(),
@@ -1867,14 +2383,19 @@ public:
         m_reportQueueStateInProgress(false),
         m_channel(channel), m_ioid(ioid),
         m_pipeline(pipeline), m_ackAny(ackAny),
-        m_unlisten(false)
+        m_maxQueueSize(std::max(queueSize, maxQueueSize)),
+        m_window(queueSize),
+        m_credit(0),
+        m_unlisten(false),
+        m_eventDeferred(false),
+        m_ready(0u)
     {
         if (queueSize <= 1)
             throw std::invalid_argument("queueSize <= 1");
 
         m_freeQueue.reserve(m_queueSize);
-        // TODO array based deque
-        //m_monitorQueue.reserve(m_queueSize);
+        // every element may be queued, including the overrun element
+        m_monitorQueue.reserve(m_queueSize);
     }
 
     virtual ~MonitorStrategyQueue() {}
@@ -1884,15 +2405,24 @@ public:
 
         m_releasedCount = 0;
         m_reportQueueStateInProgress = false;
+        // (re)subscribe always sends the initial window
+        m_window = m_queueSize;
+        m_credit = m_queueSize;
 
         {
-            while (!m_monitorQueue.empty())
-                m_monitorQueue.pop();
+            m_monitorQueue.clear();
+            updateReady();
 
             m_freeQueue.clear();
 
             m_up2datePVStructure.reset();
 
+            // blocks of the previous type are freed as their arrays are released
+            if (m_arrayPoolBytes > 0 && ArrayPool::applies(*structure))
+                m_arrayPool.reset(new ArrayPool(m_arrayPoolBytes));
+            else
+                m_arrayPool.reset();
+
             for (int32 i = 0; i < m_queueSize; i++)
             {
                 PVStructure::shared_pointer pvStructure = getPVDataCreate()->createPVStructure(structure);
@@ -1905,20 +2435,41 @@ public:
     }
 
 
-    virtual void response(Transport::shared_pointer const & transport, ByteBuffer* payloadBuffer) OVERRIDE FINAL {
+    virtual void response(Transport::shared_pointer const & transport, ByteBuffer* payloadBuffer, int8 qos) OVERRIDE FINAL {
 
         {
             // TODO do not lock deserialization
             Lock guard(m_mutex);
 
+            // the ranges of arrays are relative to the previous update
+            if ((qos & QOS_DELTA) && !m_up2datePVStructure)
+                throw std::runtime_error("Array delta without a previous monitor update");
+
+            if (m_pipeline)
+                m_credit--;
+
+            // references, not copies, to not count each update in and out of the elements
+
             if (m_overrunInProgress)
             {
-                PVStructurePtr pvStructure = m_overrunElement->pvStructurePtr;
-                BitSet::shared_pointer changedBitSet = m_overrunElement->changedBitSet;
-                BitSet::shared_pointer overrunBitSet = m_overrunElement->overrunBitSet;
+                const PVStructurePtr& pvStructure = m_overrunElement->pvStructurePtr;
+                const BitSet::shared_pointer& changedBitSet = m_overrunElement->changedBitSet;
+                const BitSet::shared_pointer& overrunBitSet = m_overrunElement->overrunBitSet;
 
                 m_bitSet1.deserialize(payloadBuffer, transport.get());
-                pvStructure->deserialize(payloadBuffer, transport.get(), &m_bitSet1);
+                if (qos & QOS_DELTA) {
+                    // patches the arrays of the same element
+                    m_deltas.deserialize(payloadBuffer, transport.get());
+                    deltaDataBits(*pvStructure, m_bitSet1, m_deltas, m_bitSet2);
+                    if (m_arrayPool)
+                        m_arrayPool->prepare(*pvStructure, m_bitSet2);
+                    deserializeChanged(payloadBuffer, transport.get(), *pvStructure, m_bitSet2);
+                    deserializeDeltas(payloadBuffer, transport.get(), m_deltas, *pvStructure, *pvStructure);
+                } else {
+                    if (m_arrayPool)
+                        m_arrayPool->prepare(*pvStructure, m_bitSet1);
+                    deserializeChanged(payloadBuffer, transport.get(), *pvStructure, m_bitSet1);
+                }
                 m_bitSet2.deserialize(payloadBuffer, transport.get());
 
                 // OR local overrun
@@ -1937,7 +2488,8 @@ public:
                 return;
             }
 
-            MonitorElementPtr newElement = m_freeQueue.back();
+            MonitorElementPtr newElement;
+            newElement.swap(m_freeQueue.back());
             m_freeQueue.pop_back();
 
             if (m_freeQueue.empty())
@@ -1947,31 +2499,65 @@ public:
             }
 
             // setup current fields
-            PVStructurePtr pvStructure = newElement->pvStructurePtr;
-            BitSet::shared_pointer changedBitSet = newElement->changedBitSet;
-            BitSet::shared_pointer overrunBitSet = newElement->overrunBitSet;
+            const PVStructurePtr& pvStructure = newElement->pvStructurePtr;
+            const BitSet::shared_pointer& changedBitSet = newElement->changedBitSet;
+            const BitSet::shared_pointer& overrunBitSet = newElement->overrunBitSet;
 
             // deserialize changedBitSet and data, and overrun bit set
             changedBitSet->deserialize(payloadBuffer, transport.get());
+            if (qos & QOS_DELTA)
+                m_deltas.deserialize(payloadBuffer, transport.get());
             if (m_up2datePVStructure && m_up2datePVStructure.get() != pvStructure.get()) {
                 assert(pvStructure->getStructure().get()==m_up2datePVStructure->getStructure().get());
                 pvStructure->copyUnchecked(*m_up2datePVStructure, *changedBitSet, true);
             }
-            pvStructure->deserialize(payloadBuffer, transport.get(), changedBitSet.get());
+            if (qos & QOS_DELTA) {
+                deltaDataBits(*pvStructure, *changedBitSet, m_deltas, m_bitSet1);
+                if (m_arrayPool)
+                    m_arrayPool->prepare(*pvStructure, m_bitSet1);
+                deserializeChanged(payloadBuffer, transport.get(), *pvStructure, m_bitSet1);
+                deserializeDeltas(payloadBuffer, transport.get(), m_deltas, *pvStructure, *m_up2datePVStructure);
+            } else {
+                // arrays shared with the element before, or still held by the application
+                if (m_arrayPool)
+                    m_arrayPool->prepare(*pvStructure, *changedBitSet);
+                deserializeChanged(payloadBuffer, transport.get(), *pvStructure, *changedBitSet);
+            }
             overrunBitSet->deserialize(payloadBuffer, transport.get());
 
             m_up2datePVStructure = pvStructure;
 
-            if (!m_overrunInProgress)
-                m_monitorQueue.push(newElement);
+            if (!m_overrunInProgress) {
+                m_monitorQueue.push_back(MonitorElementPtr());
+                m_monitorQueue.back().swap(newElement);
+                updateReady();
+            }
         }
 
         if (!m_overrunInProgress)
         {
+            {
+                Lock guard(m_mutex);
+                // once for all of the updates read together
+                if (m_eventDeferred)
+                    return;
+                m_eventDeferred = detail::ReceiveBatch::defer(shared_from_this());
+                if (m_eventDeferred)
+                    return;
+            }
             EXCEPTION_GUARD3(m_callback, cb, cb->monitorEvent(shared_from_this()));
         }
     }
 
+    virtual void runDeferred() OVERRIDE FINAL
+    {
+        {
+            Lock guard(m_mutex);
+            m_eventDeferred = false;
+        }
+        EXCEPTION_GUARD3(m_callback, cb, cb->monitorEvent(shared_from_this()));
+    }
+
     virtual void unlisten() OVERRIDE FINAL
     {
         bool notifyUnlisten = false;
@@ -1979,6 +2565,7 @@ public:
             Lock guard(m_mutex);
             notifyUnlisten = m_monitorQueue.empty();
             m_unlisten = !notifyUnlisten;
+            updateReady();
         }
 
         if (notifyUnlisten)
@@ -1988,20 +2575,30 @@ public:
     }
 
     virtual MonitorElement::shared_pointer poll() OVERRIDE FINAL {
+        MonitorElement::shared_pointer retVal;
+
+#ifdef PVA_CLIENT_USE_ATOMIC
+        // the last poll() of each monitorEvent() usually finds nothing.  Skip the lock.
+        // A response() racing with this check is followed by another monitorEvent().
+        if (epics::atomic::get(m_ready) == 0u)
+            return retVal;
+#endif
+
         Lock guard(m_mutex);
 
         if (m_monitorQueue.empty()) {
 
             if (m_unlisten) {
                 m_unlisten = false;
+                updateReady();
                 guard.unlock();
                 EXCEPTION_GUARD3(m_callback, cb, cb->unlisten(shared_from_this()));
             }
-            return MonitorElement::shared_pointer();
+            return retVal;
         }
 
-        MonitorElement::shared_pointer retVal(m_monitorQueue.front());
-        m_monitorQueue.pop();
+        m_monitorQueue.pop_front(retVal);
+        updateReady();
         return retVal;
     }
 
@@ -2027,7 +2624,8 @@ public:
                 BitSetUtil::compress(m_overrunElement->changedBitSet, pvStructure);
                 BitSetUtil::compress(m_overrunElement->overrunBitSet, pvStructure);
 
-                m_monitorQueue.push(m_overrunElement);
+                m_monitorQueue.push_back(m_overrunElement);
+                updateReady();
 
                 m_overrunElement.reset();
                 m_overrunInProgress = false;
@@ -2036,7 +2634,25 @@ public:
             if (m_pipeline)
             {
                 m_releasedCount++;
-                if (!m_reportQueueStateInProgress && m_releasedCount >= m_ackAny)
+
+                bool grown = false;
+                if (m_window < m_maxQueueSize && m_credit <= 0 && m_monitorQueue.empty())
+                {
+                    // The server has used its window, and we have nothing left to process.
+                    // So the ack round trip, not our consumer, limits the rate.
+                    // Double the window (slow start), and ack the extra at once.
+                    const int32 extra = std::min(m_window, m_maxQueueSize - m_window);
+                    for (int32 i = 0; i < extra; i++)
+                    {
+                        PVStructure::shared_pointer pvStructure = getPVDataCreate()->createPVStructure(m_lastStructure);
+                        m_freeQueue.push_back(MonitorElement::shared_pointer(new MonitorElement(pvStructure)));
+                    }
+                    m_window += extra;
+                    m_releasedCount += extra;
+                    grown = true;
+                }
+
+                if (!m_reportQueueStateInProgress && (grown || m_releasedCount >= m_ackAny))
                 {
                     sendAck = true;
                     m_reportQueueStateInProgress = true;
@@ -2072,6 +2688,7 @@ public:
         {
             Lock guard(m_mutex);
             buffer->putInt(m_releasedCount);
+            m_credit += m_releasedCount;
             m_releasedCount = 0;
             m_reportQueueStateInProgress = false;
         }
@@ -2085,8 +2702,9 @@ public:
         while (!m_monitorQueue.empty())
         {
             m_freeQueue.push_back(m_monitorQueue.front());
-            m_monitorQueue.pop();
+            m_monitorQueue.pop_front();
         }
+        updateReady();
         if (m_overrunElement)
         {
             m_freeQueue.push_back(m_overrunElement);
@@ -2123,6 +2741,7 @@ public:
     int32 m_queueSize;
     bool m_pipeline;
     int32 m_ackAny;
+    int32 m_maxQueueSize;
 
     ChannelMonitorImpl(
         ClientChannelImpl::shared_pointer const & channel,
@@ -2135,7 +2754,8 @@ public:
         m_pvRequest(pvRequest),
         m_queueSize(2),
         m_pipeline(false),
-        m_ackAny(0)
+        m_ackAny(0),
+        m_maxQueueSize(0)
     {
     }
 
@@ -2210,6 +2830,16 @@ public:
                         m_ackAny = (m_ackAny <= m_queueSize) ? size : m_queueSize;
                     }
                 }
+
+                // grow the window from queueSize, as needed, up to maxQueueSize
+                option = pvOptions->getSubField<PVScalar>("maxQueueSize");
+                if (option) {
+                    try {
+                        m_maxQueueSize = option->getAs<int32>();
+                    }catch(std::runtime_error& e){
+                        SEND_MESSAGE(m_callback, cb, "Invalid maxQueueSize=", warningMessage);
+                    }
+                }
             }
         }
 
@@ -2217,7 +2847,8 @@ public:
 
         std::tr1::shared_ptr<MonitorStrategyQueue> tp(
             new MonitorStrategyQueue(m_channel, m_ioid, m_callback, m_queueSize,
-                                     m_pipeline, m_ackAny)
+                                     m_pipeline, m_ackAny, m_maxQueueSize,
+                                     m_channel->getContext()->getArrayPoolBytes())
         );
         m_monitorStrategy = tp;
 
@@ -2317,14 +2948,14 @@ public:
             // TODO for now status is ignored
 
             if (payloadBuffer->getRemaining())
-                m_monitorStrategy->response(transport, payloadBuffer);
+                m_monitorStrategy->response(transport, payloadBuffer, qos);
 
             // unlisten will be called when all the elements in the queue gets processed
             m_monitorStrategy->unlisten();
         }
         else
         {
-            m_monitorStrategy->response(transport, payloadBuffer);
+            m_monitorStrategy->response(transport, payloadBuffer, qos);
         }
     }
 
@@ -2475,11 +3106,39 @@ public:
     }
 };
 
+/* Reply to an echo probe, see BlockingClientTCPTransportCodec::callback()
+ */
+class EchoResponseHandler : public AbstractClientResponseHandler, private epics::pvData::NoDefaultMethods {
+public:
+    EchoResponseHandler(ClientContextImpl::shared_pointer const & context) :
+        AbstractClientResponseHandler(context, "Echo")
+    {
+    }
+
+    virtual ~EchoResponseHandler() {
+    }
+
+    virtual void handleResponse(osiSockAddr* responseFrom,
+                                Transport::shared_pointer const & transport, int8 version, int8 command,
+                                size_t payloadSize, epics::pvData::ByteBuffer* payloadBuffer) OVERRIDE FINAL
+    {
+        AbstractClientResponseHandler::handleResponse(responseFrom, transport, version, command, payloadSize, payloadBuffer);
+
+        transport->aliveNotification();
+    }
+};
+
 
+/* Data responses arrive only through TCP transports, each of which holds
+ * a reference to the context.  So the responses of an IOID are dispatched
+ * through a plain pointer, without promoting _context for each message.
+ */
 class ResponseRequestHandler : public AbstractClientResponseHandler, private epics::pvData::NoDefaultMethods {
+    ClientContextImpl * const m_context;
 public:
     ResponseRequestHandler(ClientContextImpl::shared_pointer const & context) :
-        AbstractClientResponseHandler(context, "Data response")
+        AbstractClientResponseHandler(context, "Data response"),
+        m_context(context.get())
     {
     }
 
@@ -2493,8 +3152,7 @@ public:
         AbstractClientResponseHandler::handleResponse(responseFrom, transport, version, command, payloadSize, payloadBuffer);
 
         transport->ensureData(4);
-        // TODO check and optimize?
-        ResponseRequest::shared_pointer rr = _context.lock()->getResponseRequest(payloadBuffer->getInt());
+        ResponseRequest::shared_pointer rr = m_context->getResponseRequest(payloadBuffer->getInt());
         if (rr)
         {
             rr->response(transport, version, payloadBuffer);
@@ -2508,9 +3166,12 @@ public:
 
 
 class MultipleResponseRequestHandler : public AbstractClientResponseHandler, private epics::pvData::NoDefaultMethods {
+    // as for ResponseRequestHandler
+    ClientContextImpl * const m_context;
 public:
     MultipleResponseRequestHandler(ClientContextImpl::shared_pointer const & context) :
-        AbstractClientResponseHandler(context, "Multiple data response")
+        AbstractClientResponseHandler(context, "Multiple data response"),
+        m_context(context.get())
     {
     }
 
@@ -2526,7 +3187,6 @@ public:
         // TODO add submessage payload size, so that non-existant IOID can be skipped
         // and others not lost
 
-        ClientContextImpl::shared_pointer context = _context.lock();
         while (true)
         {
             transport->ensureData(4);
@@ -2534,7 +3194,7 @@ public:
             if (ioid == INVALID_IOID)
                 return;
 
-            ResponseRequest::shared_pointer rr = context->getResponseRequest(ioid);
+            ResponseRequest::shared_pointer rr = m_context->getResponseRequest(ioid);
             if (rr)
             {
                 rr->response(transport, version, payloadBuffer);
@@ -2764,6 +3424,10 @@ public:
 
         // notify beacon handler
         beaconHandler->beaconNotify(responseFrom, version, &timestamp, guid, sequentalID, changeCount, data);
+
+        ServerLoad load;
+        if (BeaconHandler::decodeLoad(data, load))
+            context->serverLoadNotify(serverAddress, load);
     }
 };
 
@@ -2786,9 +3450,7 @@ public:
         transport->ensureData(4+2);
 
         transport->setRemoteTransportReceiveBufferSize(payloadBuffer->getInt());
-        // TODO
-        // TODO serverIntrospectionRegistryMaxSize
-        /*int serverIntrospectionRegistryMaxSize = */ payloadBuffer->getShort();
+        const int16 serverIntrospectionRegistryMaxSize = payloadBuffer->getShort();
 
         // authNZ
         size_t size = SerializeHelper::readSize(payloadBuffer, transport.get());
@@ -2803,6 +3465,7 @@ public:
         //TODO: simplify byzantine class heirarchy...
         assert(cliTransport);
 
+        cliTransport->setRemoteIntrospectionRegistryMaxSize(serverIntrospectionRegistryMaxSize);
         cliTransport->authNZInitialize(offeredSecurityPlugins);
     }
 };
@@ -2952,6 +3615,10 @@ private:
     vector<ResponseHandler::shared_pointer> m_handlerTable;
 
 public:
+    /**
+     * Messages received, by TransportStatistics::commandIndex()
+     */
+    MetricCounter received[detail::TransportStatistics::maxCommand+1];
 
     virtual ~ClientResponseHandler() {}
 
@@ -2968,7 +3635,7 @@ public:
 
         m_handlerTable[CMD_BEACON].reset(new BeaconResponseHandler(context)); /*  0 */
         m_handlerTable[CMD_CONNECTION_VALIDATION].reset(new ClientConnectionValidationHandler(context)); /*  1 */
-        m_handlerTable[CMD_ECHO] = ignoreResponse; /*  2 */
+        m_handlerTable[CMD_ECHO].reset(new EchoResponseHandler(context)); /*  2 */
         m_handlerTable[CMD_SEARCH].reset(new SearchHandler(context)); /*  3 */
         m_handlerTable[CMD_SEARCH_RESPONSE].reset(new SearchResponseHandler(context)); /*  4 */
         m_handlerTable[CMD_AUTHNZ].reset(new AuthNZHandler(context.get())); /*  5 */
@@ -2994,6 +3661,8 @@ public:
                                 Transport::shared_pointer const & transport, int8 version, int8 command,
                                 size_t payloadSize, ByteBuffer* payloadBuffer) OVERRIDE FINAL
     {
+        received[detail::TransportStatistics::commandIndex(command)].increment();
+
         if (command < 0 || command >= (int8)m_handlerTable.size())
         {
             // TODO remove debug output
@@ -3033,11 +3702,61 @@ enum ContextState {
 };
 
 
+/**
+ * Connection to a name server (EPICS_PVA_NAME_SERVERS), held open by its "server" channel.
+ * While connected, search requests are also sent through it.
+ */
+class NameServerRequester : public ChannelRequester
+{
+    const ChannelSearchManager::weak_pointer m_searchManager;
+    Transport::weak_pointer m_transport;
+    Mutex m_mutex;
+public:
+    POINTER_DEFINITIONS(NameServerRequester);
+
+    explicit NameServerRequester(ChannelSearchManager::shared_pointer const & searchManager)
+        :m_searchManager(searchManager)
+    {}
+    virtual ~NameServerRequester() {}
+
+    virtual std::string getRequesterName() OVERRIDE FINAL
+    {
+        return "NameServerRequester";
+    }
+
+    virtual void channelCreated(const Status& /*status*/, Channel::shared_pointer const & /*channel*/) OVERRIDE FINAL {}
+
+    virtual void channelStateChange(Channel::shared_pointer const & channel, Channel::ConnectionState connectionState) OVERRIDE FINAL
+    {
+        ChannelSearchManager::shared_pointer searchManager(m_searchManager.lock());
+        ClientChannelImpl::shared_pointer impl(std::tr1::dynamic_pointer_cast<ClientChannelImpl>(channel));
+        if (!searchManager || !impl)
+            return;
+
+        Transport::shared_pointer previous, current;
+        {
+            Lock guard(m_mutex);
+            previous = m_transport.lock();
+            if (connectionState == Channel::CONNECTED)
+                current = impl->getTransport();
+            m_transport = current;
+        }
+
+        if (previous != current)
+            searchManager->removeNameServer(previous);
+        if (current)
+        {
+            LOG(logLevelDebug, "Searching through name server %s", inetAddressToString(current->getRemoteAddress()).c_str());
+            searchManager->addNameServer(current);
+        }
+    }
+};
 
 
 class InternalClientContextImpl :
     public ClientContextImpl,
-    public ChannelProvider
+    public ChannelProvider,
+    public MetricsSource
 {
 public:
     POINTER_DEFINITIONS(InternalClientContextImpl);
@@ -3136,9 +3855,9 @@ public:
         const pvAccessID m_channelID;
 
         /**
-         * Channel name.
+         * Channel name, shared with the other channels of this name.
          */
-        const string m_name;
+        const InternedName m_name;
 
         /**
          * Channel requester.
@@ -3151,6 +3870,51 @@ public:
         std::tr1::shared_ptr<ChannelGetFieldRequestImpl> m_getfield;
     private:
 
+        typedef std::map<std::string, FieldConstPtr> fields_t;
+        static const size_t MAX_CACHED_FIELDS = 16u;
+
+        /**
+         * State most channels never use, allocated on first use so that idle channels stay small.
+         * Guarded by m_channelMutex.
+         */
+        struct Cold {
+            /**
+             * Successful getField() results of the present connection, keyed by sub-field.
+             * Cleared whenever the channel leaves CONNECTED.
+             */
+            fields_t fields;
+
+            /**
+             * Server of the direct create pending while m_cachedAttempt.
+             */
+            ServerGUID cachedGUID;
+            osiSockAddr cachedAddress;
+
+            /**
+             * Acquired connection to a second server which answered the search (EPICS_PVA_STANDBY).
+             * When m_transport closes, the channel is created here without a search.
+             */
+            Transport::shared_pointer standby;
+            ServerGUID standbyGUID;
+            osiSockAddr standbyAddress;
+        };
+        epics::auto_ptr<Cold> m_cold;
+
+        Cold& cold() {
+            if (!m_cold.get())
+            {
+                m_cold.reset(new Cold);
+#ifdef PVA_CLIENT_USE_ATOMIC
+                epics::atomic::add(num_bytes, sizeof(Cold));
+#endif
+            }
+            return *m_cold;
+        }
+
+        bool hasStandby() const {
+            return m_cold.get() && m_cold->standby;
+        }
+
         /**
          * Process priority.
          */
@@ -3177,9 +3941,9 @@ public:
         IOIDResponseRequestMap m_responseRequests;
 
         /**
-         * Mutex for response requests.
+         * Mutex for response requests.  Owned, or one of the context's stripes (EPICS_PVA_COMPACT_CHANNELS).
          */
-        Mutex m_responseRequestsMutex;
+        Mutex& m_responseRequestsMutex;
 
         bool m_needSubscriptionUpdate;
 
@@ -3188,6 +3952,11 @@ public:
          */
         bool m_allowCreation;
 
+        /**
+         * DISCONNECTED while m_transport is unresponsive, and kept in case it recovers.
+         */
+        bool m_unresponsive;
+
         /* ****************** */
         /* PVA protocol fields */
         /* ****************** */
@@ -3203,26 +3972,36 @@ public:
         pvAccessID m_serverChannelID;
 public:
         /**
-         * Context sync. mutex.
+         * Context sync. mutex.  Owned, or one of the context's stripes (EPICS_PVA_COMPACT_CHANNELS).
          */
-        Mutex m_channelMutex;
+        Mutex& m_channelMutex;
 private:
         /**
          * Flag indicting what message to send.
          */
         bool m_issueCreateMessage;
 
-        /// Used by SearchInstance.
-        int32_t m_userValue;
-
         /**
          * @brief Server GUID.
          */
         ServerGUID m_guid;
 
+        /**
+         * Direct create at the server this channel was last connected to is pending,
+         * instead of a search.  See Cold::cachedGUID
+         */
+        bool m_cachedAttempt;
+
+        /**
+         * Create request queued in the context's ReconnectPacer, see releaseCreate()
+         */
+        bool m_createPaced;
+
     public:
         static size_t num_instances;
         static size_t num_active;
+        //! sizeof() of all channels, and of their out-of-line state.  Not counted without epicsAtomic, like REFTRACE
+        static size_t num_bytes;
     private:
 
         /**
@@ -3247,12 +4026,20 @@ private:
             m_addresses(addresses),
             m_addressIndex(0),
             m_connectionState(NEVER_CONNECTED),
+            m_responseRequestsMutex(context->channelMutex(channelID, true)),
             m_needSubscriptionUpdate(false),
             m_allowCreation(true),
+            m_unresponsive(false),
             m_serverChannelID(0xFFFFFFFF),
-            m_issueCreateMessage(true)
+            m_channelMutex(context->channelMutex(channelID, false)),
+            m_issueCreateMessage(true),
+            m_cachedAttempt(false),
+            m_createPaced(false)
         {
             REFTRACE_INCREMENT(num_instances);
+#ifdef PVA_CLIENT_USE_ATOMIC
+            epics::atomic::add(num_bytes, sizeof(*this));
+#endif
         }
 
         void activate()
@@ -3287,12 +4074,17 @@ private:
         virtual ~InternalChannelImpl()
         {
             REFTRACE_DECREMENT(num_instances);
+#ifdef PVA_CLIENT_USE_ATOMIC
+            epics::atomic::subtract(num_bytes, sizeof(*this) + (m_cold.get() ? sizeof(Cold) : 0u));
+#endif
+            m_context->releaseMutex(m_responseRequestsMutex);
+            m_context->releaseMutex(m_channelMutex);
         }
 
         virtual void destroy() OVERRIDE FINAL
         {
             // Hack.  Prevent Transport from being dtor'd while m_channelMutex is held
-            Transport::shared_pointer old_transport;
+            Transport::shared_pointer old_transport, old_standby;
             {
                 Lock guard(m_channelMutex);
                 if (m_connectionState == DESTROYED)
@@ -3320,9 +4112,12 @@ private:
                     m_transport.reset();
                 }
 
+                releaseStandby(old_standby);
 
                 setConnectionState(DESTROYED);
 
+                m_context->reconnectForget(m_channelID);
+
                 // unregister
                 m_context->unregisterChannel(thisChannelPointer);
             }
@@ -3338,11 +4133,6 @@ private:
 
     private:
 
-        // intentionally returning non-const reference
-        int32_t& getUserValue() OVERRIDE FINAL {
-            return m_userValue;
-        }
-
         virtual ChannelProvider::shared_pointer getProvider() OVERRIDE FINAL
         {
             return m_context->external_from_this();
@@ -3363,7 +4153,7 @@ private:
 
         virtual std::string getChannelName() OVERRIDE FINAL
         {
-            return m_name;
+            return m_name.str();
         }
 
         virtual ChannelRequester::shared_pointer getChannelRequester() OVERRIDE FINAL
@@ -3399,6 +4189,10 @@ public:
         }
 
         virtual const string& getSearchInstanceName() OVERRIDE FINAL {
+            return m_name.str();
+        }
+
+        virtual InternedName getSearchInstanceInternedName() OVERRIDE FINAL {
             return m_name;
         }
 
@@ -3457,8 +4251,10 @@ public:
         virtual void createChannelFailed() OVERRIDE FINAL
         {
             // Hack.  Prevent Transport from being dtor'd while m_channelMutex is held
-            Transport::shared_pointer old_transport;
+            Transport::shared_pointer old_transport, old_standby;
             Lock guard(m_channelMutex);
+            m_context->reconnectForget(m_channelID);
+            bool refused = !!m_transport;
             // release transport if active
             if (m_transport)
             {
@@ -3466,6 +4262,22 @@ public:
                 old_transport.swap(m_transport);
             }
 
+            if (m_cachedAttempt)
+            {
+                m_cachedAttempt = false;
+                // the last known server doesn't have this channel anymore, or is down
+                if (refused)
+                    m_context->forgetCachedServer(m_name.str());
+                else
+                    m_context->cachedServerUnreachable(m_cold->cachedAddress);
+                // not again, if this was the standby
+                releaseStandby(old_standby);
+
+                // ... and search, this wasn't one
+                initiateSearch();
+                return;
+            }
+
             // ... and search again, with penalty
             initiateSearch(true);
         }
@@ -3495,6 +4307,12 @@ public:
 
                     m_addressIndex = 0; // reset
 
+                    m_context->reconnectCompleted(m_channelID);
+
+                    m_cachedAttempt = false;
+                    if (m_addresses.empty() && m_transport)
+                        m_context->cacheServer(m_name.str(), m_guid, m_transport->getRemoteAddress());
+
                     // user might create monitors in listeners, so this has to be done before this can happen
                     // however, it would not be nice if events would come before connection event is fired
                     // but this cannot happen since transport (TCP) is serving in this thread
@@ -3519,15 +4337,17 @@ public:
         void disconnect(bool initiateSearch, bool remoteDestroy) {
             // order of oldchan and guard is important to ensure
             // oldchan is destoryed after unlock
-            Transport::shared_pointer oldchan;
+            Transport::shared_pointer oldchan, oldstandby;
             Lock guard(m_channelMutex);
 
-            if (m_connectionState != CONNECTED)
+            if (m_connectionState != CONNECTED && !m_unresponsive)
                 return;
+            m_unresponsive = false;
 
             if (!initiateSearch) {
                 // stop searching...
                 m_context->getChannelSearchManager()->unregisterSearchInstance(internal_from_this());
+                releaseStandby(oldstandby);
             }
             setConnectionState(DISCONNECTED);
 
@@ -3550,6 +4370,20 @@ public:
 
         }
 
+        /**
+         * Stop holding the standby connection.  Called with m_channelMutex held.
+         * @param old set to the standby transport, to be destroyed after unlocking.
+         */
+        void releaseStandby(Transport::shared_pointer& old)
+        {
+            if (!hasStandby())
+                return;
+            // the same owner as m_transport, if the standby has become that
+            if (m_cold->standby != m_transport)
+                m_cold->standby->release(getID());
+            old.swap(m_cold->standby);
+        }
+
         void channelDestroyedOnServer() OVERRIDE FINAL {
             if (isConnected())
             {
@@ -3574,6 +4408,31 @@ public:
 
             if (m_addresses.empty())
             {
+                if (hasStandby() && m_cold->standby->isClosed())
+                    m_cold->standby.reset();
+
+                if (!penalize && !m_cachedAttempt && hasStandby())
+                {
+                    // fail over to the standby server, whose connection is open, without a search.
+                    // the standby stays acquired until searchResponse() adopts it
+                    m_cachedAttempt = true;
+                    m_cold->cachedGUID = m_cold->standbyGUID;
+                    m_cold->cachedAddress = m_cold->standbyAddress;
+                    m_context->getTimer()->scheduleAfterDelay(internal_from_this(), 0.0);
+                    return;
+                }
+                ServerGUID guid;
+                osiSockAddr address;
+                if (!penalize && !m_cachedAttempt &&
+                        m_context->findCachedServer(m_name.str(), guid, address))
+                {
+                    // try the last known server before searching, see callback()
+                    m_cachedAttempt = true;
+                    cold().cachedGUID = guid;
+                    m_cold->cachedAddress = address;
+                    m_context->getTimer()->scheduleAfterDelay(internal_from_this(), 0.0);
+                    return;
+                }
                 m_context->getChannelSearchManager()->registerSearchInstance(internal_from_this(), penalize);
             }
             else
@@ -3584,6 +4443,20 @@ public:
         }
 
         virtual void callback() OVERRIDE FINAL {
+            if (m_addresses.empty())
+            {
+                // direct create at the last known server
+                Lock guard(m_channelMutex);
+                if (m_connectionState == DESTROYED || !m_cachedAttempt)
+                    return;
+
+                // NOTE: calls createChannelFailed() on failure
+                osiSockAddr address(m_cold->cachedAddress);
+                const ServerGUID guid(m_cold->cachedGUID);
+                searchResponse(guid, PVA_PROTOCOL_REVISION, &address);
+                return;
+            }
+
             // TODO cancellaction?!
             // TODO not in this timer thread !!!
             // TODO boost when a server (from address list) is started!!! IP vs address !!!
@@ -3615,7 +4488,26 @@ public:
                 if (!sockAddrAreIdentical(&transport->getRemoteAddress(), serverAddress) &&
                         !std::equal(guid.value, guid.value + 12, m_guid.value))
                 {
-                    EXCEPTION_GUARD3(m_requester, req, req->message("More than one channel with name '" + m_name +
+                    if (m_context->isStandbyEnabled() && m_addresses.empty())
+                    {
+                        // keep a connection to this one, to fail over to
+                        if (!hasStandby() || m_cold->standby->isClosed())
+                        {
+                            // NOTE: acquires, as for m_transport
+                            Transport::shared_pointer standby(m_context->getTransport(internal_from_this(), serverAddress, minorRevision, m_priority));
+                            if (standby && standby != transport)
+                            {
+                                Cold& c = cold();
+                                old_transport.swap(c.standby);
+                                c.standby.swap(standby);
+                                std::copy(guid.value, guid.value + 12, c.standbyGUID.value);
+                                c.standbyAddress = *serverAddress;
+                            }
+                        }
+                        return;
+                    }
+
+                    EXCEPTION_GUARD3(m_requester, req, req->message("More than one channel with name '" + m_name.str() +
                                                          "' detected, connected to: " + inetAddressToString(transport->getRemoteAddress()) + ", ignored: " + inetAddressToString(*serverAddress), warningMessage));
                 }
 
@@ -3635,6 +4527,10 @@ public:
             // remember GUID
             std::copy(guid.value, guid.value + 12, m_guid.value);
 
+            // failing over, the standby is now our server
+            if (hasStandby() && m_cold->standby == transport)
+                m_cold->standby.reset();
+
             // create channel
             {
                 Lock guard(m_channelMutex);
@@ -3662,11 +4558,52 @@ public:
                 old_transport.swap(m_transport);
                 m_transport.swap(transport);
 
-                m_transport->enqueueSendRequest(internal_from_this());
+                // connected before, so maybe one of many channels of a closed transport
+                m_createPaced = m_connectionState == DISCONNECTED
+                        && m_context->paceReconnect(m_channelID, m_priority, operationCount());
+                if (m_createPaced)
+                    return;
+                m_context->enqueueCreate(m_transport, internal_from_this());
             }
         }
 
+        /**
+         * Send the create request delayed by the ReconnectPacer, if still needed.
+         */
+        void releaseCreate()
+        {
+            Lock guard(m_channelMutex);
+            if (!m_createPaced)
+                return; // released already, if queued again
+            m_createPaced = false;
+            if (m_connectionState == DESTROYED || !m_transport || !m_issueCreateMessage) {
+                m_context->reconnectForget(m_channelID);
+                return;
+            }
+            m_context->enqueueCreate(m_transport, internal_from_this());
+        }
+
+        /**
+         * Operations to re-establish after connecting, which ReconnectPacer weighs.
+         */
+        size_t operationCount()
+        {
+            Lock guard(m_responseRequestsMutex);
+            return m_responseRequests.size();
+        }
+
         virtual void transportClosed() OVERRIDE FINAL {
+            {
+                Transport::shared_pointer old_standby;
+                Lock guard(m_channelMutex);
+                if (hasStandby() && m_cold->standby->isClosed() && m_transport && !m_transport->isClosed())
+                {
+                    // lost the standby server, not ours
+                    old_standby.swap(m_cold->standby);
+                    return;
+                }
+            }
+
             disconnect(true, false);
 
             // should be called without any lock hold
@@ -3709,33 +4646,43 @@ public:
             return m_transport;
         }
 
-        virtual void transportResponsive(Transport::shared_pointer const & /*transport*/) OVERRIDE FINAL {
-            Lock guard(m_channelMutex);
-            if (m_connectionState == DISCONNECTED)
+        virtual void transportResponsive(Transport::shared_pointer const & transport) OVERRIDE FINAL {
             {
-                updateSubscriptions();
+                Lock guard(m_channelMutex);
+                if (!m_unresponsive || transport != m_transport)
+                    return;
+                m_unresponsive = false;
 
-                // reconnect using existing IDs, data
-                connectionCompleted(m_serverChannelID/*, accessRights*/);
+                // the server kept the channel and its operations, so nothing is created again
+                setConnectionState(CONNECTED);
             }
+
+            // should be called without any lock hold
+            reportChannelStateChange();
         }
 
         virtual void transportUnresponsive() OVERRIDE FINAL {
-            /*
+            bool failover;
             {
                 Lock guard(m_channelMutex);
-                if (m_connectionState == CONNECTED)
+                if (m_connectionState != CONNECTED)
+                    return;
+
+                failover = hasStandby() && !m_cold->standby->isClosed();
+                if (!failover)
                 {
-            		// TODO 2 types of disconnected state - distinguish them otherwise disconnect will handle connection loss right
+                    // keep the transport, in case it recovers, see transportResponsive()
+                    m_unresponsive = true;
                     setConnectionState(DISCONNECTED);
-
-                    // ... PVA notifies also w/ no access rights callback, although access right are not changed
                 }
             }
 
+            // don't wait for this one, when the standby server can be used at once
+            if (failover)
+                disconnect(true, false);
+
             // should be called without any lock hold
             reportChannelStateChange();
-            */
         }
 
         /**
@@ -3749,6 +4696,10 @@ public:
             {
                 m_connectionState = connectionState;
 
+                // the server, or the type of the PV, may have changed while away
+                if (connectionState != CONNECTED && m_cold.get())
+                    m_cold->fields.clear();
+
                 //bool connectionStatusToReport = (connectionState == CONNECTED);
                 //if (connectionStatusToReport != lastReportedConnectionState)
                 {
@@ -3815,6 +4766,14 @@ public:
         }
 
 
+        /**
+         * Whether the create request to transport is still to be sent, by CreateChannelBatch.
+         */
+        bool createPending(const Transport* transport) {
+            Lock guard(m_channelMutex);
+            return m_issueCreateMessage && m_connectionState != DESTROYED && m_transport.get() == transport;
+        }
+
         virtual void send(ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL {
             m_channelMutex.lock();
             bool issueCreateMessage = m_issueCreateMessage;
@@ -3828,10 +4787,9 @@ public:
                 buffer->putShort((int16)1);
                 // array of CIDs and names
                 buffer->putInt(m_channelID);
-                SerializeHelper::serializeString(m_name, buffer, control);
-                // send immediately
-                // TODO
-                control->flush(true);
+                SerializeHelper::serializeString(m_name.str(), buffer, control);
+                // no flush.  the creates of many channels connecting at once share a send,
+                // which is made when the send queue is empty
             }
             else
             {
@@ -3919,6 +4877,22 @@ public:
 
         virtual void getField(GetFieldRequester::shared_pointer const & requester,std::string const & subField) OVERRIDE FINAL;
 
+        /**
+         * Remember a getField() result received through transport, if that is still
+         * the connection of this channel.
+         */
+        void cacheField(const Transport::shared_pointer& transport, const std::string& subField,
+                        const FieldConstPtr& field)
+        {
+            Lock guard(m_channelMutex);
+            if (!field || m_connectionState != CONNECTED || m_transport != transport)
+                return;
+            fields_t& fields(cold().fields);
+            if (fields.size() >= MAX_CACHED_FIELDS && !fields.count(subField))
+                return;
+            fields[subField] = field;
+        }
+
         virtual ChannelProcess::shared_pointer createChannelProcess(
             ChannelProcessRequester::shared_pointer const & requester,
             epics::pvData::PVStructure::shared_pointer const & pvRequest) OVERRIDE FINAL
@@ -3971,7 +4945,7 @@ public:
         virtual void printInfo(std::ostream& out) OVERRIDE FINAL {
             //Lock lock(m_channelMutex);
 
-            out << "CHANNEL  : " << m_name << std::endl;
+            out << "CHANNEL  : " << m_name.str() << std::endl;
             out << "STATE    : " << ConnectionStateNames[m_connectionState] << std::endl;
             if (m_connectionState == CONNECTED)
             {
@@ -3981,6 +4955,183 @@ public:
         }
     };
 
+    /**
+     * Create requests of the channels connecting through one transport,
+     * sent as one CREATE_CHANNEL message of up to m_maxCount channels.
+     * Channels added until the send queue reaches this share its message.
+     */
+    class CreateChannelBatch : public TransportSender
+    {
+    public:
+        POINTER_DEFINITIONS(CreateChannelBatch);
+
+        const Transport::weak_pointer m_transport;
+        const size_t m_maxCount;
+
+        CreateChannelBatch(const Transport::shared_pointer& transport, size_t maxCount)
+            :m_transport(transport)
+            ,m_maxCount(maxCount)
+        {}
+        virtual ~CreateChannelBatch() {}
+
+        /**
+         * @returns true if this batch was empty, and so must be queued for sending.
+         */
+        bool add(const InternalChannelImpl::shared_pointer& channel) {
+            Lock guard(m_mutex);
+            m_pending.push_back(channel);
+            return m_pending.size() == 1u;
+        }
+
+        virtual void send(ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL {
+            std::vector<InternalChannelImpl::weak_pointer> pending;
+            {
+                Lock guard(m_mutex);
+                pending.swap(m_pending);
+            }
+
+            Transport::shared_pointer transport(m_transport.lock());
+            if (!transport)
+                return;
+
+            // skip those destroyed, or moved to another transport, since being added
+            std::vector<InternalChannelImpl::shared_pointer> channels;
+            channels.reserve(pending.size());
+            for (size_t i = 0; i < pending.size(); i++) {
+                InternalChannelImpl::shared_pointer channel(pending[i].lock());
+                if (channel && channel->createPending(transport.get()))
+                    channels.push_back(channel);
+            }
+
+            for (size_t first = 0; first < channels.size(); first += m_maxCount)
+            {
+                const size_t count = std::min(m_maxCount, channels.size() - first);
+
+                if (first)
+                    control->endMessage();
+                control->startMessage((int8)CMD_CREATE_CHANNEL, 2+4);
+
+                // count
+                buffer->putShort((int16)count);
+                // array of CIDs and names
+                for (size_t i = first; i < first + count; i++) {
+                    control->ensureBuffer(4);
+                    buffer->putInt(channels[i]->getChannelID());
+                    SerializeHelper::serializeString(channels[i]->getChannelName(), buffer, control);
+                }
+            }
+        }
+
+    private:
+        Mutex m_mutex;
+        std::vector<InternalChannelImpl::weak_pointer> m_pending;
+    };
+
+    /**
+     * Send the create request of channel through transport,
+     * batched with others through the same transport when EPICS_PVA_CREATE_BATCH > 1.
+     * Called with the channel mutex held.
+     */
+    void enqueueCreate(const Transport::shared_pointer& transport,
+                       const InternalChannelImpl::shared_pointer& channel)
+    {
+        if (m_createBatchSize <= 1u) {
+            transport->enqueueSendRequest(channel);
+            return;
+        }
+
+        CreateChannelBatch::shared_pointer batch;
+        {
+            Lock guard(m_createBatchMutex);
+            CreateChannelBatch::shared_pointer& slot = m_createBatches[transport.get()];
+            if (!slot || slot->m_transport.lock() != transport) {
+                // forget batches of closed transports, which may have had the same address
+                for (createBatches_t::iterator it = m_createBatches.begin(); it != m_createBatches.end(); ) {
+                    if (it->second && it->second->m_transport.expired())
+                        m_createBatches.erase(it++);
+                    else
+                        ++it;
+                }
+                slot.reset(new CreateChannelBatch(transport, m_createBatchSize));
+            }
+            batch = slot;
+        }
+
+        if (batch->add(channel))
+            transport->enqueueSendRequest(batch);
+    }
+
+#define RECONNECT_TICK 0.05
+
+    /**
+     * Sends the creates which m_reconnectPacer releases, every RECONNECT_TICK seconds.
+     */
+    class ReconnectTicker : public TimerCallback
+    {
+    public:
+        POINTER_DEFINITIONS(ReconnectTicker);
+
+        const std::tr1::weak_ptr<InternalClientContextImpl> m_context;
+
+        ReconnectTicker(const std::tr1::shared_ptr<InternalClientContextImpl>& context)
+            :m_context(context)
+        {}
+        virtual ~ReconnectTicker() {}
+
+        virtual void callback() OVERRIDE FINAL {
+            std::tr1::shared_ptr<InternalClientContextImpl> context(m_context.lock());
+            if (context)
+                context->releaseReconnects();
+        }
+        virtual void timerStopped() OVERRIDE FINAL {}
+    };
+
+    /**
+     * Queue the create request of channel cid, connected before, in m_reconnectPacer (EPICS_PVA_RECONNECT_RATE).
+     * Called with the channel mutex held.
+     * @returns false if creates are not paced, so must be sent now.
+     */
+    bool paceReconnect(pvAccessID cid, short priority, size_t operations)
+    {
+        if (!m_reconnectPacer)
+            return false;
+        m_reconnectPacer->add(cid, priority, operations);
+        return true;
+    }
+
+    void reconnectCompleted(pvAccessID cid)
+    {
+        if (m_reconnectPacer)
+            m_reconnectPacer->completed(cid, epicsTime::getCurrent());
+    }
+
+    void reconnectForget(pvAccessID cid)
+    {
+        if (m_reconnectPacer)
+            m_reconnectPacer->forget(cid);
+    }
+
+    void releaseReconnects()
+    {
+        std::vector<pvAccessID> due;
+        m_reconnectPacer->take(epicsTime::getCurrent(), due);
+
+        for (size_t i = 0; i < due.size(); i++)
+        {
+            ClientChannelImpl::shared_pointer channel;
+            {
+                Lock guard(m_cidMapMutex);
+                CIDChannelMap::iterator it = m_channelsByCID.find(due[i]);
+                if (it != m_channelsByCID.end())
+                    channel = it->second.lock();
+            }
+            if (channel)
+                static_pointer_cast<InternalChannelImpl>(channel)->releaseCreate();
+            else
+                m_reconnectPacer->forget(due[i]);
+        }
+    }
+
 
 
 
@@ -3989,8 +5140,16 @@ public:
 
     InternalClientContextImpl(const Configuration::shared_pointer& conf) :
         m_addressList(""), m_autoAddressList(true), m_connectionTimeout(30.0f), m_beaconPeriod(15.0f),
-        m_broadcastPort(PVA_BROADCAST_PORT), m_receiveBufferSize(MAX_TCP_RECV),
+        m_broadcastPort(PVA_BROADCAST_PORT), m_receiveBufferSize(0),
         m_lastCID(0), m_lastIOID(0),
+        m_serverCacheSize(65536),
+        m_serverCacheTTL(300.0),
+        m_createBatchSize(1),
+        m_reconnectRate(0.0),
+        m_ioThreads(0),
+        m_decodeThreads(0),
+        m_arrayPoolBytes(16u*1024u*1024u),
+        m_standbyEnabled(false),
         m_version("pvAccess Client", "cpp",
                   EPICS_PVA_MAJOR_VERSION,
                   EPICS_PVA_MINOR_VERSION,
@@ -4002,6 +5161,8 @@ public:
         REFTRACE_INCREMENT(num_instances);
 
         if(!m_configuration) m_configuration = ConfigurationFactory::getConfiguration("pvAccess-client");
+        // read by each transport
+        m_configuration = ConfigurationCache::wrap(m_configuration);
         m_flushTransports.reserve(64);
         loadConfiguration();
     }
@@ -4014,7 +5175,11 @@ public:
         return m_version;
     }
 
-    virtual Timer::shared_pointer getTimer() OVERRIDE FINAL
+    virtual size_t getArrayPoolBytes() OVERRIDE FINAL {
+        return m_arrayPoolBytes;
+    }
+
+    virtual TimerWheel::shared_pointer getTimer() OVERRIDE FINAL
     {
         return m_timer;
     }
@@ -4029,6 +5194,80 @@ public:
         return m_searchTransport;
     }
 
+    virtual void collectMetrics(Metrics& M) OVERRIDE FINAL
+    {
+        {
+            Lock lock(m_contextMutex);
+            if (m_contextState != CONTEXT_INITIALIZED)
+                return;
+        }
+
+        M.family("pva_client_transports", Metrics::Gauge, "Server connections open");
+        M.family("pva_client_channels", Metrics::Gauge, "Channels created");
+        M.family("pva_client_bytes_sent_total", Metrics::Counter, "Bytes sent, by server");
+        M.family("pva_client_bytes_received_total", Metrics::Counter, "Bytes received, by server");
+        M.family("pva_client_received_dispatch_seconds", Metrics::Histogram, "Time from kernel receipt of a message until dispatch, by server.  See EPICS_PVA_RX_TIMESTAMPS");
+        M.family("pva_client_messages_received_total", Metrics::Counter, "Messages received, by command");
+        M.family("pva_client_search_names_total", Metrics::Counter, "Names sent in search requests");
+        M.family("pva_client_beacons_received_total", Metrics::Counter, "Beacons received");
+        M.family("pva_client_beacon_servers", Metrics::Gauge, "Servers beaconing");
+        M.family("pva_client_beacon_anomalies_total", Metrics::Counter, "Beacons not as expected, by kind");
+
+        TransportRegistry::transportVector_t transports;
+        m_transportRegistry.toArray(transports);
+        for (size_t i = 0; i < transports.size(); i++)
+        {
+            const detail::BlockingTCPTransportCodec *codec =
+                    dynamic_cast<const detail::BlockingTCPTransportCodec*>(transports[i].get());
+            if (!codec)
+                continue;
+
+            detail::TransportStatistics stats;
+            codec->getStatistics().snapshot(stats);
+
+            const std::string remote(Metrics::label("remote", codec->getRemoteName()));
+            M.add("pva_client_bytes_sent_total", double(stats.bytesSent), remote);
+            M.add("pva_client_bytes_received_total", double(stats.bytesReceived), remote);
+
+            if (codec->getRxStampMode() != detail::BlockingTCPTransportCodec::RX_STAMP_NONE)
+            {
+                LatencyHistogram toDispatch, toResponse;
+                codec->getReceiveLatency(toDispatch, toResponse);
+                M.add("pva_client_received_dispatch_seconds", toDispatch, Metrics::shortBounds(), remote);
+            }
+        }
+        M.add("pva_client_transports", double(transports.size()));
+
+        size_t nchannels;
+        {
+            Lock guard(m_cidMapMutex);
+            nchannels = m_channelsByCID.size();
+        }
+        M.add("pva_client_channels", double(nchannels));
+        if (m_reconnectPacer)
+        {
+            M.add("pva_client_reconnects_pending", double(m_reconnectPacer->pending()));
+            M.add("pva_client_reconnect_rate", m_reconnectPacer->rate());
+        }
+
+        for (size_t i = 0; i <= detail::TransportStatistics::maxCommand; i++)
+        {
+            const size_t count = m_responseHandler->received[i].get();
+            if (count)
+                M.add("pva_client_messages_received_total", double(count),
+                      Metrics::label("command", detail::TransportStatistics::commandName(int8(i))));
+        }
+        M.add("pva_client_beacons_received_total", double(m_responseHandler->received[CMD_BEACON].get()));
+        M.add("pva_client_search_names_total", double(m_channelSearchManager->getNamesSearched()));
+
+        const BeaconStats& beacons = m_beaconHandlers.getStats();
+        M.add("pva_client_beacon_servers", double(m_beaconHandlers.size()));
+        M.add("pva_client_beacon_anomalies_total", double(beacons.restarts.get()), Metrics::label("kind", "restart"));
+        M.add("pva_client_beacon_anomalies_total", double(beacons.changes.get()), Metrics::label("kind", "change"));
+        M.add("pva_client_beacon_anomalies_total", double(beacons.gaps.get()), Metrics::label("kind", "gap"));
+        M.add("pva_client_beacon_anomalies_total", double(beacons.repeats.get()), Metrics::label("kind", "repeat"));
+    }
+
     virtual void initialize() OVERRIDE FINAL {
         Lock lock(m_contextMutex);
 
@@ -4040,6 +5279,10 @@ public:
         internalInitialize();
 
         m_contextState = CONTEXT_INITIALIZED;
+
+        connectNameServers();
+
+        loadServerCache();
     }
 
     virtual void printInfo(std::ostream& out) OVERRIDE FINAL {
@@ -4049,10 +5292,28 @@ public:
         out << "VERSION            : " << m_version.getVersionString() << std::endl;
         out << "ADDR_LIST          : " << m_addressList << std::endl;
         out << "AUTO_ADDR_LIST     : " << (m_autoAddressList ? "true" : "false") << std::endl;
+        out << "MCAST_GROUP        : " << m_multicastGroup << std::endl;
         out << "CONNECTION_TIMEOUT : " << m_connectionTimeout << std::endl;
         out << "BEACON_PERIOD      : " << m_beaconPeriod << std::endl;
         out << "BROADCAST_PORT     : " << m_broadcastPort << std::endl;;
         out << "RCV_BUFFER_SIZE    : " << m_receiveBufferSize << std::endl;
+        out << "IO_THREADS         : " << (m_ioReactor ? m_ioThreads : 0) << std::endl;
+        out << "DECODE_THREADS     : " << (m_decodePool ? m_decodeThreads : 0) << std::endl;
+        out << "ARRAY_POOL_BYTES   : " << m_arrayPoolBytes << std::endl;
+        if (BlockAllocator *alloc = BufferPool::allocator())
+            out << "HUGE_PAGES         : " << alloc->name() << ", " << alloc->bytes() << " bytes mapped" << std::endl;
+        else
+            out << "HUGE_PAGES         : NO" << std::endl;
+        out << "STANDBY            : " << (m_standbyEnabled ? "true" : "false") << std::endl;
+        out << "COMPACT_CHANNELS   : " << (m_stripes.get() ? "true" : "false") << std::endl;
+        if (m_reconnectPacer)
+            out << "RECONNECT_RATE     : " << m_reconnectPacer->rate() << " of " << m_reconnectRate
+                << ", " << m_reconnectPacer->pending() << " pending" << std::endl;
+        {
+            Lock guard(m_serverCacheMutex);
+            out << "SERVER_CACHE       : " << m_serverCache.size() << " of " << m_serverCacheSize
+                << ", " << m_unreachableServers.size() << " unreachable" << std::endl;
+        }
         out << "STATE              : ";
         switch (m_contextState)
         {
@@ -4092,6 +5353,10 @@ public:
 
         // this will also close all PVA transports
         destroyAllChannels();
+        m_nameServerChannels.clear();
+
+        saveServerCache();
+        m_nameServerRequesters.clear();
 
         // stop UDPs
         for (BlockingUDPTransportVector::const_iterator iter = m_udpTransports.begin();
@@ -4110,12 +5375,29 @@ public:
             epicsThreadSleep(0.025);
 
         {
-            Lock guard(m_beaconMapMutex);
             m_beaconHandlers.clear();
+            Lock guard(m_beaconMapMutex);
+            m_serverLoads.clear();
         }
 
         if (transportCount)
             LOG(logLevelDebug, "PVA client context destroyed with %u transport(s) active.", (unsigned)transportCount);
+
+        // join shared I/O threads
+        if (m_ioReactor)
+            m_ioReactor->close();
+        if (m_decodePool)
+            m_decodePool->close();
+    }
+
+    virtual IOReactor::shared_pointer getIOReactor() OVERRIDE FINAL
+    {
+        return m_ioReactor;
+    }
+
+    virtual DecodePool::shared_pointer getDecodePool() OVERRIDE FINAL
+    {
+        return m_decodePool;
     }
 
     virtual ~InternalClientContextImpl()
@@ -4141,17 +5423,80 @@ private:
 
         m_addressList = m_configuration->getPropertyAsString("EPICS_PVA_ADDR_LIST", m_addressList);
         m_autoAddressList = m_configuration->getPropertyAsBoolean("EPICS_PVA_AUTO_ADDR_LIST", m_autoAddressList);
+        m_multicastGroup = m_configuration->getPropertyAsString("EPICS_PVA_MCAST_GROUP", m_multicastGroup);
         m_connectionTimeout = m_configuration->getPropertyAsFloat("EPICS_PVA_CONN_TMO", m_connectionTimeout);
         m_beaconPeriod = m_configuration->getPropertyAsFloat("EPICS_PVA_BEACON_PERIOD", m_beaconPeriod);
         m_broadcastPort = m_configuration->getPropertyAsInteger("EPICS_PVA_BROADCAST_PORT", m_broadcastPort);
+        m_nameServers = m_configuration->getPropertyAsString("EPICS_PVA_NAME_SERVERS", m_nameServers);
         m_receiveBufferSize = m_configuration->getPropertyAsInteger("EPICS_PVA_MAX_ARRAY_BYTES", m_receiveBufferSize);
+        int32 cacheSize = m_configuration->getPropertyAsInteger("EPICS_PVA_SERVER_CACHE_SIZE", int32(m_serverCacheSize));
+        m_serverCacheSize = cacheSize > 0 ? cacheSize : 0;
+        m_serverCacheFile = m_configuration->getPropertyAsString("EPICS_PVA_SERVER_CACHE_FILE", m_serverCacheFile);
+        m_serverCacheTTL = m_configuration->getPropertyAsDouble("EPICS_PVA_SERVER_CACHE_TTL", m_serverCacheTTL);
+        // at most 0x7fff in a message, and older servers accept only 1
+        int32 createBatch = m_configuration->getPropertyAsInteger("EPICS_PVA_CREATE_BATCH", int32(m_createBatchSize));
+        m_createBatchSize = createBatch < 1 ? 1 : createBatch > 0x7fff ? 0x7fff : createBatch;
+        m_reconnectRate = m_configuration->getPropertyAsDouble("EPICS_PVA_RECONNECT_RATE", m_reconnectRate);
+        m_ioThreads = m_configuration->getPropertyAsInteger("EPICS_PVA_IO_THREADS", m_ioThreads);
+        if (m_ioThreads < 0)
+            m_ioThreads = 0;
+        m_decodeThreads = m_configuration->getPropertyAsInteger("EPICS_PVA_DECODE_THREADS", m_decodeThreads);
+        if (m_decodeThreads < 0)
+            m_decodeThreads = 0;
+        int32 poolBytes = m_configuration->getPropertyAsInteger("EPICS_PVA_ARRAY_POOL_BYTES", int32(m_arrayPoolBytes));
+        m_arrayPoolBytes = poolBytes > 0 ? size_t(poolBytes) : 0u;
+        {
+            // process wide, so only applied before the first connection
+            std::string hugePages(m_configuration->getPropertyAsString("EPICS_PVA_HUGE_PAGES", ""));
+            if (!HugePageAllocator::install(hugePages))
+                LOG(logLevelWarn, "EPICS_PVA_HUGE_PAGES='%s' not applied", hugePages.c_str());
+        }
+        m_standbyEnabled = m_configuration->getPropertyAsBoolean("EPICS_PVA_STANDBY", m_standbyEnabled);
+        if (m_configuration->getPropertyAsBoolean("EPICS_PVA_COMPACT_CHANNELS", false))
+            m_stripes.reset(new ChannelStripes);
+    }
+
+    /**
+     * Keep connections to name servers, through the channel every server has.
+     */
+    void connectNameServers()
+    {
+        if (m_nameServers.empty())
+            return;
+
+        InetAddrVector addresses;
+        getSocketAddressList(addresses, m_nameServers, PVA_SERVER_PORT);
+
+        for (size_t i = 0; i < addresses.size(); i++)
+        {
+            NameServerRequester::shared_pointer requester(new NameServerRequester(m_channelSearchManager));
+            InetAddrVector one(1, addresses[i]);
+            ClientChannelImpl::shared_pointer channel(createChannelInternal("server", requester,
+                                                                            ChannelProvider::PRIORITY_DEFAULT, one));
+            if (!channel)
+                continue;
+            m_nameServerRequesters.push_back(requester);
+            m_nameServerChannels.push_back(channel);
+        }
     }
 
     void internalInitialize() {
 
         osiSockAttach();
-        m_timer.reset(new Timer("pvAccess-client timer", lowPriority));
+        m_timer.reset(new TimerWheel("pvAccess-client timer", lowPriority));
+        // TCP transports share these threads, instead of two each
+        if (m_ioThreads > 0)
+            m_ioReactor = IOReactor::create("PVA-IO", m_ioThreads);
+        // TCP transports hand updates to these to deserialize
+        if (m_decodeThreads > 0)
+            m_decodePool.reset(new DecodePool("PVA-decode", m_decodeThreads));
         InternalClientContextImpl::shared_pointer thisPointer(internal_from_this());
+        if (m_reconnectRate > 0.0) {
+            m_reconnectPacer.reset(new ReconnectPacer(m_reconnectRate));
+            m_reconnectTicker.reset(new ReconnectTicker(thisPointer));
+            m_timer->schedulePeriodic(m_reconnectTicker, RECONNECT_TICK, RECONNECT_TICK);
+        }
+        MetricsSource::add(std::tr1::weak_ptr<MetricsSource>(thisPointer));
         // stores weak_ptr
         m_connector.reset(new BlockingTCPConnector(thisPointer, m_receiveBufferSize, m_connectionTimeout));
 
@@ -4176,14 +5521,15 @@ private:
             }
 
             IfaceNodeVector ifaceList;
-            if (discoverInterfaces(ifaceList, socket, 0) || ifaceList.size() == 0)
+            if (discoverInterfacesCached(ifaceList, socket, 0) || ifaceList.size() == 0)
             {
                 LOG(logLevelError, "Failed to introspect interfaces or no network interfaces available.");
             }
             epicsSocketDestroy (socket);
 
             initializeUDPTransports(false, m_udpTransports, ifaceList, m_responseHandler, m_searchTransport,
-                                    m_broadcastPort, m_autoAddressList, m_addressList, std::string());
+                                    m_broadcastPort, m_autoAddressList, m_addressList, std::string(),
+                                    m_multicastGroup);
 
         }
 
@@ -4378,19 +5724,114 @@ private:
      * @return beacon handler for particular server.
      */
     BeaconHandler::shared_pointer getBeaconHandler(osiSockAddr* responseFrom) OVERRIDE FINAL
+    {
+        return m_beaconHandlers.get(internal_from_this(), *responseFrom);
+    }
+
+    virtual void serverLoadNotify(const osiSockAddr& serverAddress, const ServerLoad& load) OVERRIDE FINAL
     {
         Lock guard(m_beaconMapMutex);
-        AddressBeaconHandlerMap::iterator it = m_beaconHandlers.find(*responseFrom);
-        BeaconHandler::shared_pointer handler;
-        if (it == m_beaconHandlers.end())
+        KnownLoad& known = m_serverLoads[serverAddress];
+        known.load = load;
+        known.seen = epicsTime::getCurrent();
+    }
+
+    /**
+     * Load advertised by a server in a recent beacon.
+     * Forgotten after four beacon periods without one.
+     */
+    virtual bool getServerLoad(const osiSockAddr& serverAddress, ServerLoad& load) OVERRIDE FINAL
+    {
+        Lock guard(m_beaconMapMutex);
+        ServerLoadMap::const_iterator it(m_serverLoads.find(serverAddress));
+        if (it == m_serverLoads.end() || epicsTime::getCurrent() - it->second.seen > 4.0*m_beaconPeriod)
+            return false;
+        load = it->second.load;
+        return true;
+    }
+
+    /**
+     * A beacon shows a server (re)started, so try its cached channels directly again.
+     * @param responseFrom remote source address of received beacon.
+     */
+    virtual void serverRestarted(const osiSockAddr& responseFrom) OVERRIDE FINAL
+    {
+        Lock guard(m_serverCacheMutex);
+        m_unreachableServers.erase(responseFrom.ia.sin_addr.s_addr);
+    }
+
+    /**
+     * Remember the server a channel is connected to.
+     */
+    void cacheServer(const string& name, const ServerGUID& guid, const osiSockAddr& address)
+    {
+        Lock guard(m_serverCacheMutex);
+        serverCache_t::iterator it(m_serverCache.find(name));
+        if (it == m_serverCache.end())
         {
-            // stores weak_ptr
-            handler.reset(new BeaconHandler(internal_from_this(), responseFrom));
-            m_beaconHandlers[*responseFrom] = handler;
+            if (m_serverCache.size() >= m_serverCacheSize)
+                return;
+            it = m_serverCache.insert(std::make_pair(name, CachedServer())).first;
         }
-        else
-            handler = it->second;
-        return handler;
+        it->second.guid = guid;
+        it->second.address = address;
+        it->second.seen = epicsTime::getCurrent();
+
+        m_unreachableServers.erase(address.ia.sin_addr.s_addr);
+        m_forgottenServers.erase(name);
+    }
+
+    //! EPICS_PVA_STANDBY
+    bool isStandbyEnabled() const { return m_standbyEnabled; }
+
+    /**
+     * A mutex for a new channel, to be released by releaseMutex().
+     * With EPICS_PVA_COMPACT_CHANNELS, one of a fixed set, shared by the channels of the same stripe.
+     * @param requests the mutex of its pending requests, else of the channel itself.
+     */
+    Mutex& channelMutex(pvAccessID channelID, bool requests)
+    {
+        if (!m_stripes.get())
+            return *new Mutex;
+        const size_t stripe = channelID % ChannelStripes::count;
+        return requests ? m_stripes->requests[stripe] : m_stripes->channel[stripe];
+    }
+
+    void releaseMutex(Mutex& mutex)
+    {
+        if (!m_stripes.get())
+            delete &mutex;
+    }
+
+    /**
+     * Find the server a channel was last connected to.
+     * @return false if unknown, or the server didn't accept a connection since its last beacon.
+     */
+    bool findCachedServer(const string& name, ServerGUID& guid, osiSockAddr& address)
+    {
+        Lock guard(m_serverCacheMutex);
+        serverCache_t::const_iterator it(m_serverCache.find(name));
+        if (it == m_serverCache.end() ||
+                m_unreachableServers.find(it->second.address.ia.sin_addr.s_addr) != m_unreachableServers.end())
+            return false;
+
+        guid = it->second.guid;
+        address = it->second.address;
+        return true;
+    }
+
+    void forgetCachedServer(const string& name)
+    {
+        Lock guard(m_serverCacheMutex);
+        m_serverCache.erase(name);
+        if (!m_serverCacheFile.empty())
+            m_forgottenServers.insert(name);
+    }
+
+    void cachedServerUnreachable(const osiSockAddr& address)
+    {
+        Lock guard(m_serverCacheMutex);
+        m_unreachableServers.insert(address.ia.sin_addr.s_addr);
     }
 
     /**
@@ -4468,6 +5909,23 @@ private:
      */
     bool m_autoAddressList;
 
+    /**
+     * Multicast group which replaces the automatic broadcast addresses for searches, joined on each interface.
+     */
+    string m_multicastGroup;
+
+    /**
+     * A space-separated list of name servers, which are also sent search requests over TCP.
+     * Each address must be of the form: ip.number:port or host.name:port
+     */
+    string m_nameServers;
+
+    /**
+     * The "server" channels which hold open connections to name servers.
+     */
+    std::vector<ClientChannelImpl::shared_pointer> m_nameServerChannels;
+    std::vector<NameServerRequester::shared_pointer> m_nameServerRequesters;
+
     /**
      * If the context doesn't see a beacon from a server that it is connected to for
      * connectionTimeout seconds then a state-of-health message is sent to the server over TCP/IP.
@@ -4487,14 +5945,14 @@ private:
     int32 m_broadcastPort;
 
     /**
-     * Receive buffer size (max size of payload).
+     * Receive buffer budget of each connection (EPICS_PVA_MAX_ARRAY_BYTES), or 0 if not set.
      */
     int m_receiveBufferSize;
 
     /**
      * Timer.
      */
-    Timer::shared_pointer m_timer;
+    TimerWheel::shared_pointer m_timer;
 
     /**
      * UDP transports needed to receive channel searches.
@@ -4561,17 +6019,243 @@ private:
     ChannelSearchManager::shared_pointer m_channelSearchManager;
 
     /**
-     * Beacon handler map.
+     * Beacon handler of each server.
      */
-    // TODO consider std::unordered_map
-    typedef std::map<osiSockAddr, BeaconHandler::shared_pointer, comp_osiSock_lt> AddressBeaconHandlerMap;
-    AddressBeaconHandlerMap m_beaconHandlers;
+    BeaconHandlerTable m_beaconHandlers;
+
+    /**
+     * Load advertised in beacons, by server TCP address.  Guarded by m_beaconMapMutex.
+     */
+    struct KnownLoad {
+        ServerLoad load;
+        epicsTime seen;
+    };
+    typedef std::map<osiSockAddr, KnownLoad, comp_osiSock_lt> ServerLoadMap;
+    ServerLoadMap m_serverLoads;
 
     /**
      *  IOIDResponseRequestMap mutex.
      */
     Mutex m_beaconMapMutex;
 
+    /**
+     * Server each channel name was last connected to, for reconnecting without a search.
+     */
+    struct CachedServer {
+        ServerGUID guid;
+        osiSockAddr address;
+        // last connected
+        epicsTime seen;
+    };
+    typedef std::map<string, CachedServer> serverCache_t;
+    serverCache_t m_serverCache;
+    size_t m_serverCacheSize;
+
+    /**
+     * Server cache shared with other processes through this file, when set.
+     * Entries expire m_serverCacheTTL seconds after they were last connected.
+     */
+    string m_serverCacheFile;
+    double m_serverCacheTTL;
+
+    /**
+     * Names which were no longer found at their cached server, to be removed from m_serverCacheFile.
+     */
+    std::set<string> m_forgottenServers;
+
+    /**
+     * Read EPICS_PVA_SERVER_CACHE_FILE, skipping entries last connected
+     * more than EPICS_PVA_SERVER_CACHE_TTL seconds ago.
+     * Each line is: <name> <GUID as 24 hex digits> <IPv4:port> <POSIX time connected>
+     */
+    void readServerCacheFile(serverCache_t& cache)
+    {
+        std::ifstream strm(m_serverCacheFile.c_str());
+        if (!strm)
+            return;
+
+        const epicsTime now(epicsTime::getCurrent());
+        string line;
+        while (cache.size() < m_serverCacheSize && std::getline(strm, line))
+        {
+            std::istringstream fields(line);
+            string name, guidText, addressText;
+            unsigned long seenPOSIX;
+            if (!(fields >> name >> guidText >> addressText >> seenPOSIX) ||
+                    guidText.size() != 2*sizeof(ServerGUID) ||
+                    seenPOSIX < POSIX_TIME_AT_EPICS_EPOCH)
+                continue;
+
+            CachedServer entry;
+            epicsTimeStamp seen;
+            seen.secPastEpoch = epicsUInt32(seenPOSIX - POSIX_TIME_AT_EPICS_EPOCH);
+            seen.nsec = 0;
+            entry.seen = seen;
+            if (now - entry.seen > m_serverCacheTTL)
+                continue;
+
+            bool valid = true;
+            for (size_t i = 0; valid && i < sizeof(ServerGUID); i++)
+            {
+                unsigned byte;
+                valid = sscanf(guidText.c_str() + 2*i, "%2x", &byte) == 1;
+                entry.guid.value[i] = char(byte);
+            }
+
+            memset(&entry.address, 0, sizeof(entry.address));
+            if (!valid || aToIPAddr(addressText.c_str(), PVA_SERVER_PORT, &entry.address.ia))
+                continue;
+
+            cache[name] = entry;
+        }
+    }
+
+    /**
+     * Start with the servers other processes found, so that short lived clients
+     * (eg. pvget run by scripts) need not search for each name they have used before.
+     */
+    void loadServerCache()
+    {
+        if (m_serverCacheFile.empty() || m_serverCacheSize == 0)
+            return;
+
+        serverCache_t loaded;
+        readServerCacheFile(loaded);
+
+        Lock guard(m_serverCacheMutex);
+        // entries of this process are newer
+        for (serverCache_t::const_iterator it(loaded.begin()); it != loaded.end(); ++it)
+            m_serverCache.insert(*it);
+        LOG(logLevelDebug, "Loaded %u cached server(s) from %s",
+            unsigned(loaded.size()), m_serverCacheFile.c_str());
+    }
+
+    /**
+     * Merge this process's server cache into EPICS_PVA_SERVER_CACHE_FILE.
+     * Names which were found elsewhere, and servers which refused a connection, are dropped.
+     * The file is replaced by rename(), so that readers see either the old or the new one.
+     * Other processes saving wait on <file>.lock (POSIX flock()), and each writes a temporary
+     * file of its own, with mode 0600 as the names and servers used are of this user only.
+     */
+    void saveServerCache()
+    {
+        if (m_serverCacheFile.empty() || m_serverCacheSize == 0)
+            return;
+
+        ServerCacheFileLock lock(m_serverCacheFile);
+
+        // may have been updated by other processes since loaded
+        serverCache_t merged;
+        readServerCacheFile(merged);
+
+        {
+            Lock guard(m_serverCacheMutex);
+            for (std::set<string>::const_iterator it(m_forgottenServers.begin()); it != m_forgottenServers.end(); ++it)
+                merged.erase(*it);
+            for (serverCache_t::const_iterator it(m_serverCache.begin()); it != m_serverCache.end(); ++it)
+                merged[it->first] = it->second;
+            for (serverCache_t::iterator it(merged.begin()); it != merged.end(); )
+            {
+                if (m_unreachableServers.find(it->second.address.ia.sin_addr.s_addr) != m_unreachableServers.end())
+                    merged.erase(it++);
+                else
+                    ++it;
+            }
+        }
+
+        std::ostringstream strm;
+        size_t count = 0;
+        for (serverCache_t::const_iterator it(merged.begin());
+                it != merged.end() && count < m_serverCacheSize; ++it)
+        {
+            if (it->first.find_first_of(" \t\r\n") != string::npos)
+                continue;
+
+            char guidText[2*sizeof(ServerGUID)+1];
+            for (size_t i = 0; i < sizeof(ServerGUID); i++)
+                sprintf(guidText + 2*i, "%02x", unsigned(epicsUInt8(it->second.guid.value[i])));
+
+            epicsTimeStamp seen(it->second.seen);
+            strm << it->first << ' ' << guidText << ' '
+                 << inetAddressToString(it->second.address) << ' '
+                 << (unsigned long)seen.secPastEpoch + POSIX_TIME_AT_EPICS_EPOCH << '\n';
+            count++;
+        }
+
+        const string temp(writeServerCacheTemp(m_serverCacheFile, strm.str()));
+        if (temp.empty())
+        {
+            LOG(logLevelDebug, "Can't write server cache %s", m_serverCacheFile.c_str());
+            return;
+        }
+
+        if (rename(temp.c_str(), m_serverCacheFile.c_str()) != 0)
+        {
+            // Windows won't replace an existing file
+            remove(m_serverCacheFile.c_str());
+            if (rename(temp.c_str(), m_serverCacheFile.c_str()) != 0)
+                remove(temp.c_str());
+        }
+    }
+
+    /**
+     * Servers (IPv4, network byte order) which refused a direct connection, until their next beacon.
+     */
+    std::set<epicsUInt32> m_unreachableServers;
+
+    Mutex m_serverCacheMutex;
+
+    /**
+     * Pending create requests of each transport, when batching (EPICS_PVA_CREATE_BATCH).
+     */
+    typedef std::map<const Transport*, CreateChannelBatch::shared_pointer> createBatches_t;
+    createBatches_t m_createBatches;
+    size_t m_createBatchSize;
+
+    Mutex m_createBatchMutex;
+
+    /**
+     * Creates per second at most of the channels connecting again (EPICS_PVA_RECONNECT_RATE),
+     * or zero to send each at once.
+     */
+    double m_reconnectRate;
+    ReconnectPacer::shared_pointer m_reconnectPacer;
+    ReconnectTicker::shared_pointer m_reconnectTicker;
+
+    /**
+     * Shared I/O threads of TCP transports (EPICS_PVA_IO_THREADS), or NULL for two threads each.
+     */
+    int32 m_ioThreads;
+    IOReactor::shared_pointer m_ioReactor;
+
+    /**
+     * Threads deserializing the updates received by TCP transports (EPICS_PVA_DECODE_THREADS),
+     * or NULL for each receive thread to do so.
+     */
+    int32 m_decodeThreads;
+    DecodePool::shared_pointer m_decodePool;
+
+    /**
+     * Bytes of array storage each monitor keeps for reuse (EPICS_PVA_ARRAY_POOL_BYTES), or 0 for none.
+     */
+    size_t m_arrayPoolBytes;
+
+    /**
+     * Channels keep a connection to a second server which answered their search (EPICS_PVA_STANDBY).
+     */
+    bool m_standbyEnabled;
+
+    /**
+     * Mutexes of channels, when they don't have their own (EPICS_PVA_COMPACT_CHANNELS).
+     * Each is shared by the channels whose IDs are equal modulo count.
+     */
+    struct ChannelStripes {
+        static const size_t count = 256u;
+        Mutex channel[count];
+        Mutex requests[count];
+    };
+    epics::auto_ptr<ChannelStripes> m_stripes;
+
     /**
      * Version.
      */
@@ -4599,6 +6283,8 @@ private:
 size_t InternalClientContextImpl::num_instances;
 size_t InternalClientContextImpl::InternalChannelImpl::num_instances;
 size_t InternalClientContextImpl::InternalChannelImpl::num_active;
+size_t InternalClientContextImpl::InternalChannelImpl::num_bytes;
+const size_t InternalClientContextImpl::InternalChannelImpl::MAX_CACHED_FIELDS;
 
 class ChannelGetFieldRequestImpl :
     public ResponseRequest,
@@ -4739,6 +6425,7 @@ public:
         {
             // deserialize Field...
             field = transport->cachedDeserialize(payloadBuffer);
+            m_channel->cacheField(transport, m_subField, field);
         }
         notify(status, field);
 
@@ -4751,6 +6438,21 @@ public:
 
 void InternalClientContextImpl::InternalChannelImpl::getField(GetFieldRequester::shared_pointer const & requester,std::string const & subField)
 {
+    FieldConstPtr cached;
+    {
+        Lock guard(m_channelMutex);
+        if (m_connectionState == CONNECTED && m_cold.get()) {
+            fields_t::const_iterator it(m_cold->fields.find(subField));
+            if (it != m_cold->fields.end())
+                cached = it->second;
+        }
+    }
+    if (cached) {
+        // answer without a round trip, as for a local provider
+        EXCEPTION_GUARD(requester->getDone(Status::Ok, cached));
+        return;
+    }
+
     ChannelGetFieldRequestImpl::shared_pointer self(new ChannelGetFieldRequestImpl(internal_from_this(), requester, subField));
     self->activate();
     // activate() stores self in channel
@@ -4790,6 +6492,7 @@ ChannelProvider::shared_pointer createClientProvider(const Configuration::shared
     registerRefCounter("InternalClientContextImpl", &InternalClientContextImpl::num_instances);
     registerRefCounter("InternalChannelImpl", &InternalClientContextImpl::InternalChannelImpl::num_instances);
     registerRefCounter("InternalChannelImpl (Active)", &InternalClientContextImpl::InternalChannelImpl::num_active);
+    registerRefCounter("InternalChannelImpl (Bytes)", &InternalClientContextImpl::InternalChannelImpl::num_bytes);
     registerRefCounter("BaseRequestImpl", &BaseRequestImpl::num_instances);
     registerRefCounter("BaseRequestImpl (Active)", &BaseRequestImpl::num_active);
     InternalClientContextImpl::shared_pointer internal(new InternalClientContextImpl(conf)),
@@ -74,6 +74,11 @@ public:
      */
     virtual const Version& getVersion() = 0;
 
+    /**
+     * Bytes of array storage each monitor keeps for reuse, or 0 for none.
+     */
+    virtual size_t getArrayPoolBytes() = 0;
+
     /**
      * Initialize client context. This method is called immediately after instance construction (call of constructor).
      */
@@ -113,6 +118,12 @@ public:
 
     virtual std::tr1::shared_ptr<BeaconHandler> getBeaconHandler(osiSockAddr* responseFrom) = 0;
 
+    /**
+     * Remember the load advertised in a beacon.
+     * @param serverAddress TCP address of the server.
+     */
+    virtual void serverLoadNotify(const osiSockAddr& serverAddress, const ServerLoad& load) = 0;
+
     virtual void destroy() = 0;
 };
 
@@ -8,6 +8,7 @@
 #define RPCCLIENT_H
 
 #include <string>
+#include <vector>
 
 #ifdef epicsExportSharedSymbols
 #   define rpcClientEpicsExportSharedSymbols
@@ -56,6 +57,31 @@ public:
               const ChannelProvider::shared_pointer& provider = ChannelProvider::shared_pointer(),
               const std::string& address = std::string());
 
+    /**
+     * Create a RPCClient which shares its channel with the other RPCClients made by createShared()
+     * for the same service name, provider and address.
+     *
+     * The channel stays connected after the last RPCClient using it is destroyed,
+     * so that the next is ready at once.  Channels not used for 60 seconds are
+     * closed by a later createShared(), or all unused channels by clearChannelCache().
+     *
+     * @param  serviceName  the service name
+     * @param  pvRequest    the pvRequest for the ChannelRPC
+     * @param  provider     the client provider, "pva" if NULL
+     * @param  address      the server address, any if empty
+     * @since 6.1.0
+     */
+    static shared_pointer createShared(const std::string & serviceName,
+                                       epics::pvData::PVStructure::shared_pointer const & pvRequest = epics::pvData::PVStructure::shared_pointer(),
+                                       const ChannelProvider::shared_pointer& provider = ChannelProvider::shared_pointer(),
+                                       const std::string& address = std::string());
+
+    /**
+     * Close the shared channels of createShared() which are not used by any RPCClient.
+     * @since 6.1.0
+     */
+    static void clearChannelCache();
+
     ~RPCClient() {destroy();}
 
 
@@ -123,6 +149,46 @@ public:
      */
     epics::pvData::PVStructure::shared_pointer waitResponse(double timeout = RPCCLIENT_DEFAULT_TIMEOUT);
 
+    /**
+     * Issue a request without waiting for those issued before.
+     *
+     * Each outstanding request uses a ChannelRPC of its own on the one channel,
+     * so many may be in flight at once, and the server may complete them out of order.
+     * Does not affect issueRequest()/waitResponse().
+     * @param pvArgument The argument to pass to the server.
+     * @return an id to pass to waitResponse(size_t, double).
+     * @since 6.1.0
+     */
+    size_t issuePipelined(epics::pvData::PVStructure::shared_pointer const & pvArgument);
+
+    /**
+     * Wait for the request of issuePipelined() which returned id.
+     * The id may be returned again by a later issuePipelined(),
+     * once this has returned or thrown other than on timeout.
+     * @param id           as returned by issuePipelined()
+     * @param timeout      the time in seconds to wait for the reponse.
+     * @return             request response.
+     * @throws RPCRequestException exception thrown on error or timeout.
+     * @since 6.1.0
+     */
+    epics::pvData::PVStructure::shared_pointer waitResponse(size_t id, double timeout);
+
+    /**
+     * Send many requests at once, as with issuePipelined(), and wait for all responses.
+     *
+     * @param  pvArguments the arguments of the requests
+     * @param  timeout     the time in seconds to wait for all responses.
+     * @param  status      If not NULL, set to the status of each request, and
+     *                     a failed request gives a NULL response instead of an exception.
+     * @return             the response to each request, in the order of pvArguments.
+     * @throws RPCRequestException for the first request to fail, after waiting for all, if status is NULL.
+     * @since 6.1.0
+     */
+    std::vector<epics::pvData::PVStructure::shared_pointer> requestMany(
+        std::vector<epics::pvData::PVStructure::shared_pointer> const & pvArguments,
+        double timeout = RPCCLIENT_DEFAULT_TIMEOUT,
+        std::vector<epics::pvData::Status> *status = 0);
+
 private:
 
     const std::string m_serviceName;
@@ -134,6 +200,26 @@ private:
     struct RPCRequester;
     std::tr1::shared_ptr<RPCRequester> m_rpc_requester;
 
+    struct Pipeline;
+    std::tr1::shared_ptr<Pipeline> m_pipeline;
+
+    // channel is from the cache of createShared()
+    const bool m_shared;
+    const std::string m_address;
+
+    RPCClient(const std::string & serviceName,
+              epics::pvData::PVStructure::shared_pointer const & pvRequest,
+              const ChannelProvider::shared_pointer& provider,
+              const std::string& address,
+              bool shared);
+    void init();
+
+    static void issue(RPCRequester& requester,
+                      ChannelRPC::shared_pointer const & rpc,
+                      epics::pvData::PVStructure::shared_pointer const & pvArgument,
+                      bool lastRequest);
+    static epics::pvData::PVStructure::shared_pointer wait(RPCRequester& requester, double timeout);
+
     RPCClient(const RPCClient&);
     RPCClient& operator=(const RPCClient&);
 };
@@ -6,8 +6,14 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+
+#include <map>
+#include <utility>
 
 #include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
 #include <pv/pvData.h>
 #include <pv/event.h>
 #include <pv/current_function.h>
@@ -115,6 +121,107 @@ struct RPCClient::RPCRequester : public pva::ChannelRPCRequester
 };
 
 
+namespace {
+
+// Channels of RPCClient::createShared(), by provider, service name and address
+struct ChannelCache
+{
+    struct Entry {
+        ChannelProvider::shared_pointer provider; // keeps the key valid
+        Channel::shared_pointer channel;
+        size_t users;
+        epicsTime lastUsed;
+    };
+    typedef std::pair<const ChannelProvider*, std::pair<std::string, std::string> > key_t;
+    typedef std::map<key_t, Entry> entries_t;
+
+    pvd::Mutex mutex;
+    entries_t entries;
+
+    // seconds an unused channel is kept
+    static const double idleTimeout;
+
+    // remove unused (all) or idle channels, and those destroyed.  Call with mutex locked
+    void expire(bool all, std::vector<Channel::shared_pointer>& expired)
+    {
+        epicsTime now(epicsTime::getCurrent());
+        for(entries_t::iterator it(entries.begin()); it!=entries.end();) {
+            entries_t::iterator cur(it++);
+            Entry& ent = cur->second;
+            if(ent.channel->getConnectionState()==Channel::DESTROYED
+                    || (ent.users==0u && (all || now - ent.lastUsed > idleTimeout))) {
+                expired.push_back(ent.channel);
+                entries.erase(cur);
+            }
+        }
+    }
+
+    static void destroy(std::vector<Channel::shared_pointer>& expired)
+    {
+        for(size_t i=0; i<expired.size(); i++)
+            expired[i]->destroy();
+    }
+
+    Channel::shared_pointer acquire(const ChannelProvider::shared_pointer& provider,
+                                    const std::string& name,
+                                    const std::string& address)
+    {
+        std::vector<Channel::shared_pointer> expired;
+        Channel::shared_pointer ret;
+        {
+            pvd::Lock L(mutex);
+            expire(false, expired);
+
+            Entry& ent = entries[key_t(provider.get(), std::make_pair(name, address))];
+            if(!ent.channel) {
+                ent.channel = provider->createChannel(name, DefaultChannelRequester::build(),
+                                                      ChannelProvider::PRIORITY_DEFAULT,
+                                                      address);
+                if(!ent.channel) {
+                    entries.erase(key_t(provider.get(), std::make_pair(name, address)));
+                    throw std::logic_error("provider createChannel() succeeds w/ NULL Channel");
+                }
+                ent.provider = provider;
+                ent.users = 0u;
+            }
+            ent.users++;
+            ret = ent.channel;
+        }
+        destroy(expired);
+        return ret;
+    }
+
+    void release(const ChannelProvider::shared_pointer& provider,
+                 const std::string& name,
+                 const std::string& address)
+    {
+        pvd::Lock L(mutex);
+        entries_t::iterator it(entries.find(key_t(provider.get(), std::make_pair(name, address))));
+        if(it!=entries.end() && it->second.users>0u) {
+            it->second.users--;
+            it->second.lastUsed = epicsTime::getCurrent();
+        }
+    }
+};
+
+const double ChannelCache::idleTimeout = 60.0;
+
+ChannelCache *channelCache;
+epicsThreadOnceId channelCacheOnce = EPICS_THREAD_ONCE_INIT;
+
+void channelCacheInit(void *)
+{
+    channelCache = new ChannelCache;
+}
+
+ChannelCache& getChannelCache()
+{
+    epicsThreadOnce(&channelCacheOnce, &channelCacheInit, 0);
+    return *channelCache;
+}
+
+} // namespace
+
 RPCClient::RPCClient(const std::string & serviceName,
                      pvd::PVStructure::shared_pointer const & pvRequest,
                      const ChannelProvider::shared_pointer &provider,
@@ -122,6 +229,29 @@ RPCClient::RPCClient(const std::string & serviceName,
     : m_serviceName(serviceName)
     , m_provider(provider)
     , m_pvRequest(pvRequest ? pvRequest : pvd::createRequest(""))
+    , m_pipeline(new Pipeline)
+    , m_shared(false)
+    , m_address(address)
+{
+    init();
+}
+
+RPCClient::RPCClient(const std::string & serviceName,
+                     pvd::PVStructure::shared_pointer const & pvRequest,
+                     const ChannelProvider::shared_pointer &provider,
+                     const std::string &address,
+                     bool shared)
+    : m_serviceName(serviceName)
+    , m_provider(provider)
+    , m_pvRequest(pvRequest ? pvRequest : pvd::createRequest(""))
+    , m_pipeline(new Pipeline)
+    , m_shared(shared)
+    , m_address(address)
+{
+    init();
+}
+
+void RPCClient::init()
 {
     ClientFactory::start();
     if(!m_provider)
@@ -129,9 +259,12 @@ RPCClient::RPCClient(const std::string & serviceName,
     if(!m_provider)
         throw std::logic_error("Unknown Provider");
 
-    m_channel = m_provider->createChannel(serviceName, DefaultChannelRequester::build(),
-                                        ChannelProvider::PRIORITY_DEFAULT,
-                                        address);
+    if(m_shared)
+        m_channel = getChannelCache().acquire(m_provider, m_serviceName, m_address);
+    else
+        m_channel = m_provider->createChannel(m_serviceName, DefaultChannelRequester::build(),
+                                              ChannelProvider::PRIORITY_DEFAULT,
+                                              m_address);
 
     if(!m_channel)
         throw std::logic_error("provider createChannel() succeeds w/ NULL Channel");
@@ -146,7 +279,10 @@ void RPCClient::destroy()
 {
     if (m_channel)
     {
-        m_channel->destroy();
+        if (m_shared)
+            getChannelCache().release(m_provider, m_serviceName, m_address);
+        else
+            m_channel->destroy();
         m_channel.reset();
     }
     if (m_rpc)
@@ -154,6 +290,12 @@ void RPCClient::destroy()
         m_rpc->destroy();
         m_rpc.reset();
     }
+    if (m_pipeline)
+    {
+        pvd::Lock L(m_pipeline->mutex);
+        for (size_t i=0; i<m_pipeline->slots.size(); i++)
+            m_pipeline->slots[i].rpc->destroy();
+    }
 }
 
 bool RPCClient::connect(double timeout)
@@ -201,56 +343,69 @@ pvd::PVStructure::shared_pointer RPCClient::request(
 void RPCClient::issueRequest(
     pvd::PVStructure::shared_pointer const & pvArgument,
     bool lastRequest)
+{
+    issue(*m_rpc_requester, m_rpc, pvArgument, lastRequest);
+}
+
+void RPCClient::issue(RPCRequester& requester,
+                      ChannelRPC::shared_pointer const & rpc,
+                      pvd::PVStructure::shared_pointer const & pvArgument,
+                      bool lastRequest)
 {
     {
-        pvd::Lock L(m_rpc_requester->mutex);
-        TRACE("conn_status="<<m_rpc_requester->conn_status
-            <<" resp_status="<<m_rpc_requester->resp_status
+        pvd::Lock L(requester.mutex);
+        TRACE("conn_status="<<requester.conn_status
+            <<" resp_status="<<requester.resp_status
             <<" args:\n"<<pvArgument);
-        if(m_rpc_requester->inprogress)
+        if(requester.inprogress)
             throw std::logic_error("Request already in progress");
-        m_rpc_requester->inprogress = true;
-        m_rpc_requester->resp_status = pvd::Status::error("No Data");
-        if(!m_rpc_requester->conn_status.isSuccess()) {
+        requester.inprogress = true;
+        requester.resp_status = pvd::Status::error("No Data");
+        if(!requester.conn_status.isSuccess()) {
             TRACE("defer");
-            m_rpc_requester->last = lastRequest;
-            m_rpc_requester->next_args = pvArgument;
+            requester.last = lastRequest;
+            requester.next_args = pvArgument;
             return;
         }
         TRACE("request args: "<<pvArgument);
     }
     if(lastRequest)
-        m_rpc->lastRequest();
-    m_rpc->request(pvArgument);
+        rpc->lastRequest();
+    rpc->request(pvArgument);
 }
 
 pvd::PVStructure::shared_pointer RPCClient::waitResponse(double timeout)
 {
-    pvd::Lock L(m_rpc_requester->mutex);
+    return wait(*m_rpc_requester, timeout);
+}
+
+pvd::PVStructure::shared_pointer RPCClient::wait(RPCRequester& requester, double timeout)
+{
+    pvd::Lock L(requester.mutex);
     TRACE("timeout="<<timeout);
 
-    while(m_rpc_requester->inprogress)
+    while(requester.inprogress)
     {
         L.unlock();
-        if(!m_rpc_requester->event.wait(timeout)) {
+        if(!requester.event.wait(timeout)) {
             TRACE("TIMEOUT");
             throw RPCRequestException(pvd::Status::STATUSTYPE_ERROR, "RPC timeout");
         }
         L.lock();
     }
-    TRACE("Complete: conn_status="<<m_rpc_requester->conn_status
-                 <<" resp_status="<<m_rpc_requester->resp_status
-                 <<" data:\n"<<m_rpc_requester->last_data);
+    TRACE("Complete: conn_status="<<requester.conn_status
+                 <<" resp_status="<<requester.resp_status
+                 <<" data:\n"<<requester.last_data);
 
-    if(!m_rpc_requester->conn_status.isSuccess())
-        throw RPCRequestException(pvd::Status::STATUSTYPE_ERROR, m_rpc_requester->conn_status.getMessage());
+    if(!requester.conn_status.isSuccess())
+        throw RPCRequestException(pvd::Status::STATUSTYPE_ERROR, requester.conn_status.getMessage());
 
-    if(!m_rpc_requester->resp_status.isSuccess())
-        throw RPCRequestException(pvd::Status::STATUSTYPE_ERROR, m_rpc_requester->resp_status.getMessage());
+    if(!requester.resp_status.isSuccess())
+        throw RPCRequestException(pvd::Status::STATUSTYPE_ERROR, requester.resp_status.getMessage());
 
     // consume last_data so that we can't possibly return it twice
     pvd::PVStructure::shared_pointer data;
-    data.swap(m_rpc_requester->last_data);
+    data.swap(requester.last_data);
 
     if(!data)
         throw std::logic_error("No request in progress");
@@ -263,11 +418,153 @@ pvd::PVStructure::shared_pointer RPCClient::waitResponse(double timeout)
     return ret;
 }
 
+// ChannelRPC operations for issuePipelined(), created as needed and kept for reuse
+struct RPCClient::Pipeline
+{
+    struct Slot {
+        ChannelRPC::shared_pointer rpc;
+        std::tr1::shared_ptr<RPCRequester> requester;
+        bool busy; // between issuePipelined() and waitResponse()
+    };
+    pvd::Mutex mutex;
+    std::vector<Slot> slots;
+};
+
+size_t RPCClient::issuePipelined(pvd::PVStructure::shared_pointer const & pvArgument)
+{
+    if(!m_channel)
+        throw std::logic_error("RPCClient destroyed");
+
+    size_t id;
+    ChannelRPC::shared_pointer rpc;
+    std::tr1::shared_ptr<RPCRequester> requester;
+    {
+        pvd::Lock L(m_pipeline->mutex);
+        for(id=0; id<m_pipeline->slots.size(); id++) {
+            if(!m_pipeline->slots[id].busy)
+                break;
+        }
+        if(id==m_pipeline->slots.size()) {
+            Pipeline::Slot slot;
+            slot.requester.reset(new RPCRequester);
+            slot.rpc = m_channel->createChannelRPC(slot.requester, m_pvRequest);
+            if(!slot.rpc)
+                throw std::logic_error("channel createChannelRPC() NULL");
+            slot.busy = false;
+            m_pipeline->slots.push_back(slot);
+        }
+        Pipeline::Slot& slot = m_pipeline->slots[id];
+        slot.busy = true;
+        rpc = slot.rpc;
+        requester = slot.requester;
+    }
+    try {
+        issue(*requester, rpc, pvArgument, false);
+    } catch(...) {
+        pvd::Lock L(m_pipeline->mutex);
+        m_pipeline->slots[id].busy = false;
+        throw;
+    }
+    return id;
+}
+
+pvd::PVStructure::shared_pointer RPCClient::waitResponse(size_t id, double timeout)
+{
+    std::tr1::shared_ptr<RPCRequester> requester;
+    {
+        pvd::Lock L(m_pipeline->mutex);
+        if(id>=m_pipeline->slots.size() || !m_pipeline->slots[id].busy)
+            throw std::logic_error("No pipelined request with this id");
+        requester = m_pipeline->slots[id].requester;
+    }
+    try {
+        pvd::PVStructure::shared_pointer ret(wait(*requester, timeout));
+        pvd::Lock L(m_pipeline->mutex);
+        m_pipeline->slots[id].busy = false;
+        return ret;
+    } catch(RPCRequestException&) {
+        // still in progress after a timeout, so not yet free
+        bool done;
+        {
+            pvd::Lock R(requester->mutex);
+            done = !requester->inprogress;
+        }
+        if(done) {
+            pvd::Lock L(m_pipeline->mutex);
+            m_pipeline->slots[id].busy = false;
+        }
+        throw;
+    }
+}
+
 RPCClient::shared_pointer RPCClient::create(const std::string & serviceName,
         pvd::PVStructure::shared_pointer const & pvRequest)
 {
     return RPCClient::shared_pointer(new RPCClient(serviceName, pvRequest));
 }
 
+RPCClient::shared_pointer RPCClient::createShared(const std::string & serviceName,
+        pvd::PVStructure::shared_pointer const & pvRequest,
+        const ChannelProvider::shared_pointer& provider,
+        const std::string& address)
+{
+    return RPCClient::shared_pointer(new RPCClient(serviceName, pvRequest, provider, address, true));
+}
+
+void RPCClient::clearChannelCache()
+{
+    ChannelCache& cache = getChannelCache();
+    std::vector<Channel::shared_pointer> expired;
+    {
+        pvd::Lock L(cache.mutex);
+        cache.expire(true, expired);
+    }
+    ChannelCache::destroy(expired);
+}
+
+std::vector<pvd::PVStructure::shared_pointer> RPCClient::requestMany(
+        std::vector<pvd::PVStructure::shared_pointer> const & pvArguments,
+        double timeout,
+        std::vector<pvd::Status> *status)
+{
+    const size_t count = pvArguments.size();
+    std::vector<pvd::PVStructure::shared_pointer> ret(count);
+    std::vector<pvd::Status> sts(count);
+    std::vector<size_t> ids(count);
+    std::vector<bool> issued(count, false);
+
+    epicsTime deadline(epicsTime::getCurrent() + timeout);
+
+    for(size_t i=0; i<count; i++) {
+        try {
+            ids[i] = issuePipelined(pvArguments[i]);
+            issued[i] = true;
+        } catch(std::exception& e) {
+            sts[i] = pvd::Status::error(e.what());
+        }
+    }
+
+    for(size_t i=0; i<count; i++) {
+        if(!issued[i])
+            continue;
+        double remaining = deadline - epicsTime::getCurrent();
+        try {
+            ret[i] = waitResponse(ids[i], remaining > 0.0 ? remaining : 0.0);
+        } catch(RPCRequestException& e) {
+            sts[i] = e.asStatus();
+        }
+    }
+
+    if(status) {
+        status->swap(sts);
+    } else {
+        for(size_t i=0; i<count; i++) {
+            if(!sts[i].isSuccess())
+                throw RPCRequestException(sts[i].getType(), sts[i].getMessage());
+        }
+    }
+    return ret;
+}
+
 
 }}// namespace epics::pvAccess
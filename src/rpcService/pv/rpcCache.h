@@ -0,0 +1,100 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef RPCCACHE_H
+#define RPCCACHE_H
+
+#include <ostream>
+
+#ifdef epicsExportSharedSymbols
+#   define rpcCacheEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/sharedPtr.h>
+
+#ifdef rpcCacheEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#	undef rpcCacheEpicsExportSharedSymbols
+#endif
+
+#include <pv/rpcService.h>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** Caches the replies of an idempotent service.
+ *
+ * Requests with equal arguments (same type and same values) are answered from
+ * the cache for ttl seconds after the backend replied successfully.
+ * Concurrent requests with equal arguments which miss the cache are coalesced
+ * into a single backend request, whose reply is given to all of them.
+ * Errors are passed on, but not cached.
+ *
+ * A cached reply PVStructure is given to every requester, so neither the backend
+ * nor a requester may change it afterwards.
+ *
+ * @code
+ *   RPCServiceAsync::shared_pointer lookup(new LookupService);
+ *   server.registerService("lookup", RPCServiceAsync::shared_pointer(new RPCCacheService(lookup, 256, 60.0)));
+ * @endcode
+ *
+ * A synchronous RPCService backend is called by the thread which calls request(),
+ * and not by the RPCServer thread pool.
+ * @since 6.1.0
+ */
+class epicsShareClass RPCCacheService :
+    public RPCServiceAsync
+{
+public:
+    POINTER_DEFINITIONS(RPCCacheService);
+
+    struct Stats {
+        size_t hits;      //!< replies from the cache
+        size_t misses;    //!< backend requests made
+        size_t coalesced; //!< requests joined to a backend request in progress
+        size_t evictions; //!< entries removed to stay within maxEntries
+        size_t entries;   //!< entries in the cache now
+    };
+
+    /**
+     * @param backend The service to cache
+     * @param maxEntries The least recently used entry is removed to stay within this many.  0 is treated as 1.
+     * @param ttl Seconds a reply is kept.  <= 0 keeps entries until they are removed by maxEntries.
+     */
+    RPCCacheService(RPCServiceAsync::shared_pointer const & backend,
+                    size_t maxEntries = 1024u,
+                    double ttl = 10.0);
+    virtual ~RPCCacheService();
+
+    virtual void request(
+        epics::pvData::PVStructure::shared_pointer const & args,
+        RPCResponseCallback::shared_pointer const & callback
+    ) OVERRIDE FINAL;
+
+    //! Counters since construction or resetStats()
+    Stats stats() const;
+    void resetStats();
+
+    //! Remove all cached replies.  Backend requests in progress are not affected.
+    void clear();
+
+    //! Print counters and hit rate
+    void show(std::ostream& strm) const;
+
+    struct Impl;
+private:
+    std::tr1::shared_ptr<Impl> impl;
+};
+
+epicsShareFunc std::ostream& operator<<(std::ostream& strm, const RPCCacheService::Stats& stats);
+
+}
+}
+
+#endif  /* RPCCACHE_H */
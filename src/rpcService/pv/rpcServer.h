@@ -7,6 +7,8 @@
 #ifndef RPCSERVER_H
 #define RPCSERVER_H
 
+#include <ostream>
+
 #ifdef epicsExportSharedSymbols
 #   define rpcServerEpicsExportSharedSymbols
 #   undef epicsExportSharedSymbols
@@ -49,6 +51,16 @@ public:
 
     void registerService(std::string const & serviceName, RPCServiceAsync::shared_pointer const & service);
 
+    /** Register a synchronous service, of which at most maxConcurrency requests are run at once.
+     *
+     * When EPICS_PVA_RPC_THREADS is set above 0, the request() methods of RPCService
+     * are called by a pool of that many threads, instead of the server
+     * thread receiving from the client.  maxConcurrency 0 is no limit below the pool size.
+     * @since 6.1.0
+     */
+    void registerService(std::string const & serviceName, RPCService::shared_pointer const & service,
+                         size_t maxConcurrency);
+
     void unregisterService(std::string const & serviceName);
 
     void run(int seconds = 0);
@@ -60,10 +72,19 @@ public:
     void destroy();
 
     /**
-     * Display basic information about the context.
+     * Display basic information about the context,
+     * the queue of the RPC thread pool, and the statistics of each service.
      */
     void printInfo();
 
+    /**
+     * Print the request counters and latencies of the services of every RPCServer of this process.
+     *
+     * The same is available from each RPCServer as the built-in service "rpc.stats", an NTTable.
+     * @since 6.1.0
+     */
+    static void report(std::ostream& strm);
+
     const std::tr1::shared_ptr<ServerContext>& getServer() const { return m_serverContext; }
 };
 
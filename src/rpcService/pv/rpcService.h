@@ -75,6 +75,18 @@ public:
         epics::pvData::PVStructure::shared_pointer const & args,
         RPCResponseCallback::shared_pointer const & callback
     ) = 0;
+
+    /** Declare the type of the arguments of every request().
+     *
+     * Read by RPCServer as each client channel is created.  When not null, requests
+     * with arguments of another type fail without calling request(), and the server
+     * decodes the arguments of one client into a PVStructure which it re-uses.
+     * So request() must not keep a reference to any sub-field of args after replying.
+     * @since 6.1.0
+     */
+    virtual epics::pvData::Structure::const_shared_pointer getArgumentType() {
+        return epics::pvData::Structure::const_shared_pointer();
+    }
 };
 
 class epicsShareClass RPCService :
@@ -0,0 +1,290 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+#include <stdexcept>
+
+#include <epicsTime.h>
+#include <pv/lock.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+#include <pv/pvData.h>
+
+#define epicsExportSharedSymbols
+#include <pv/logger.h>
+#include <pv/rpcCache.h>
+
+namespace pvd = epics::pvData;
+
+namespace {
+
+// serialize type and value into a string, which is the cache key
+struct KeyControl : public pvd::SerializableControl
+{
+    pvd::ByteBuffer buffer;
+    std::string out;
+
+    KeyControl() :buffer(1024) {}
+    virtual ~KeyControl() {}
+
+    virtual void flushSerializeBuffer() OVERRIDE FINAL {
+        buffer.flip();
+        out.append(buffer.getArray(), buffer.getLimit());
+        buffer.clear();
+    }
+    virtual void ensureBuffer(std::size_t size) OVERRIDE FINAL {
+        if(buffer.getRemaining()<size)
+            flushSerializeBuffer();
+        if(buffer.getRemaining()<size)
+            throw std::logic_error("KeyControl::ensureBuffer() size too large");
+    }
+    virtual void alignBuffer(std::size_t) OVERRIDE FINAL {}
+    virtual bool directSerialize(pvd::ByteBuffer*, const char*, std::size_t, std::size_t) OVERRIDE FINAL {
+        return false;
+    }
+    // union members are keyed by their full type
+    virtual void cachedSerialize(std::tr1::shared_ptr<const pvd::Field> const & field, pvd::ByteBuffer* buf) OVERRIDE FINAL {
+        field->serialize(buf, this);
+    }
+};
+
+std::string makeKey(const pvd::PVStructure& args)
+{
+    KeyControl ctl;
+    args.getStructure()->serialize(&ctl.buffer, &ctl);
+    args.serialize(&ctl.buffer, &ctl);
+    ctl.flushSerializeBuffer();
+    return ctl.out;
+}
+
+} // namespace
+
+namespace epics {
+namespace pvAccess {
+
+struct RPCCacheService::Impl
+{
+    POINTER_DEFINITIONS(Impl);
+
+    // one backend request for a key
+    struct BackendCallback : public RPCResponseCallback
+    {
+        const Impl::shared_pointer impl;
+        const std::string key;
+        bool finished; // guarded by impl->mutex
+
+        BackendCallback(const Impl::shared_pointer& impl, const std::string& key)
+            :impl(impl), key(key), finished(false)
+        {}
+        virtual ~BackendCallback() {}
+
+        virtual void requestDone(pvd::Status const & status,
+                                 pvd::PVStructure::shared_pointer const & result) OVERRIDE FINAL
+        {
+            impl->done(*this, status, result);
+        }
+    };
+
+    // most recently used at front
+    typedef std::list<std::string> lru_t;
+    struct Entry {
+        pvd::Status status;
+        pvd::PVStructure::shared_pointer result;
+        epicsTime expires;
+        lru_t::iterator pos;
+    };
+    typedef std::map<std::string, Entry> entries_t;
+    typedef std::vector<RPCResponseCallback::shared_pointer> waiters_t;
+    typedef std::map<std::string, waiters_t> pending_t;
+
+    const RPCServiceAsync::shared_pointer backend;
+    const size_t maxEntries;
+    const double ttl;
+
+    mutable pvd::Mutex mutex;
+    lru_t lru;
+    entries_t entries;
+    pending_t pending;
+    Stats counters;
+
+    Impl(const RPCServiceAsync::shared_pointer& backend, size_t maxEntries, double ttl)
+        :backend(backend)
+        ,maxEntries(maxEntries ? maxEntries : 1u)
+        ,ttl(ttl)
+    {
+        resetStats();
+    }
+
+    void resetStats()
+    {
+        counters.hits = counters.misses = counters.coalesced = counters.evictions = counters.entries = 0u;
+    }
+
+    void erase(entries_t::iterator it)
+    {
+        lru.erase(it->second.pos);
+        entries.erase(it);
+    }
+
+    // call with mutex locked
+    void insert(const std::string& key, const pvd::Status& status, const pvd::PVStructure::shared_pointer& result)
+    {
+        entries_t::iterator it(entries.find(key));
+        if(it!=entries.end())
+            erase(it);
+
+        lru.push_front(key);
+        Entry& ent = entries[key];
+        ent.status = status;
+        ent.result = result;
+        ent.expires = epicsTime::getCurrent() + ttl;
+        ent.pos = lru.begin();
+
+        while(entries.size()>maxEntries) {
+            erase(entries.find(lru.back()));
+            counters.evictions++;
+        }
+    }
+
+    void done(BackendCallback& cb, const pvd::Status& status, const pvd::PVStructure::shared_pointer& result)
+    {
+        waiters_t waiters;
+        {
+            pvd::Lock G(mutex);
+            if(cb.finished)
+                return;
+            cb.finished = true;
+
+            pending_t::iterator it(pending.find(cb.key));
+            if(it!=pending.end()) {
+                waiters.swap(it->second);
+                pending.erase(it);
+            }
+            if(status.isSuccess() && result)
+                insert(cb.key, status, result);
+        }
+
+        for(size_t i=0; i<waiters.size(); i++) {
+            try {
+                waiters[i]->requestDone(status, result);
+            } catch(std::exception& e) {
+                LOG(logLevelError, "Unhandled exception from RPCResponseCallback::requestDone(): %s", e.what());
+            }
+        }
+    }
+};
+
+RPCCacheService::RPCCacheService(RPCServiceAsync::shared_pointer const & backend,
+                                 size_t maxEntries,
+                                 double ttl)
+    :impl(new Impl(backend, maxEntries, ttl))
+{
+    if(!backend)
+        throw std::invalid_argument("RPCCacheService requires a backend service");
+}
+
+RPCCacheService::~RPCCacheService() {}
+
+void RPCCacheService::request(
+        pvd::PVStructure::shared_pointer const & args,
+        RPCResponseCallback::shared_pointer const & callback)
+{
+    assert(callback && args);
+
+    std::string key;
+    try {
+        key = makeKey(*args);
+    } catch(std::exception& e) {
+        callback->requestDone(pvd::Status::error(e.what()), pvd::PVStructure::shared_pointer());
+        return;
+    }
+
+    pvd::Status status;
+    pvd::PVStructure::shared_pointer result;
+    {
+        pvd::Lock G(impl->mutex);
+
+        Impl::entries_t::iterator it(impl->entries.find(key));
+        if(it!=impl->entries.end()) {
+            if(impl->ttl<=0.0 || epicsTime::getCurrent() < it->second.expires) {
+                impl->lru.splice(impl->lru.begin(), impl->lru, it->second.pos);
+                status = it->second.status;
+                result = it->second.result;
+                impl->counters.hits++;
+            } else {
+                impl->erase(it);
+            }
+        }
+
+        if(!result) {
+            Impl::pending_t::iterator P(impl->pending.find(key));
+            if(P!=impl->pending.end()) {
+                P->second.push_back(callback);
+                impl->counters.coalesced++;
+                return;
+            }
+            impl->pending[key].push_back(callback);
+            impl->counters.misses++;
+        }
+    }
+
+    if(result) {
+        callback->requestDone(status, result);
+        return;
+    }
+
+    std::tr1::shared_ptr<Impl::BackendCallback> cb(new Impl::BackendCallback(impl, key));
+    try {
+        impl->backend->request(args, cb);
+    } catch(RPCRequestException& e) {
+        cb->requestDone(e.asStatus(), pvd::PVStructure::shared_pointer());
+    } catch(std::exception& e) {
+        cb->requestDone(pvd::Status::error(e.what()), pvd::PVStructure::shared_pointer());
+    }
+}
+
+RPCCacheService::Stats RPCCacheService::stats() const
+{
+    pvd::Lock G(impl->mutex);
+    Stats ret(impl->counters);
+    ret.entries = impl->entries.size();
+    return ret;
+}
+
+void RPCCacheService::resetStats()
+{
+    pvd::Lock G(impl->mutex);
+    impl->resetStats();
+}
+
+void RPCCacheService::clear()
+{
+    pvd::Lock G(impl->mutex);
+    impl->entries.clear();
+    impl->lru.clear();
+}
+
+void RPCCacheService::show(std::ostream& strm) const
+{
+    strm<<stats()<<"\n";
+}
+
+std::ostream& operator<<(std::ostream& strm, const RPCCacheService::Stats& stats)
+{
+    size_t total = stats.hits + stats.coalesced + stats.misses;
+    strm<<"hits "<<stats.hits
+        <<" misses "<<stats.misses
+        <<" coalesced "<<stats.coalesced
+        <<" evictions "<<stats.evictions
+        <<" entries "<<stats.entries
+        <<" hit rate "<<(total ? 100.0*(stats.hits+stats.coalesced)/total : 0.0)<<"%";
+    return strm;
+}
+
+}} // namespace epics::pvAccess
@@ -6,12 +6,21 @@
 
 #include <stdexcept>
 #include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
 #include <utility>
 
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <pv/event.h>
+
 #define epicsExportSharedSymbols
 #include <pv/rpcServer.h>
 #include <pv/serverContextImpl.h>
 #include <pv/wildcard.h>
+#include <pv/latencyHistogram.h>
+#include <pv/metrics.h>
 
 using namespace epics::pvData;
 using std::string;
@@ -19,6 +28,66 @@ using std::string;
 namespace epics {
 namespace pvAccess {
 
+class ChannelRPCServiceImpl;
+
+/* Runs synchronous RPCService::request() calls on worker threads instead of
+ * the server receive thread, so that a slow service does not hold up the
+ * other messages of a client connection.
+ */
+class RPCThreadPool : public epicsThreadRunable
+{
+public:
+    POINTER_DEFINITIONS(RPCThreadPool);
+
+    // concurrency limit of one service.  Guarded by m_mutex of the pool
+    struct Limit {
+        size_t maxActive, active;
+        typedef std::deque<std::pair<std::tr1::shared_ptr<ChannelRPCServiceImpl>, PVStructure::shared_pointer> > waiting_t;
+        waiting_t waiting;
+        Limit(size_t maxActive) :maxActive(maxActive), active(0u) {}
+    };
+
+    RPCThreadPool(unsigned nthreads);
+    virtual ~RPCThreadPool();
+
+    void submit(std::tr1::shared_ptr<ChannelRPCServiceImpl> op,
+                PVStructure::shared_pointer const & args,
+                std::tr1::shared_ptr<Limit> const & limit);
+    void stop();
+    void show(std::ostream& strm);
+
+    virtual void run();
+
+private:
+    struct Job {
+        std::tr1::shared_ptr<ChannelRPCServiceImpl> op;
+        PVStructure::shared_pointer args;
+        std::tr1::shared_ptr<Limit> limit;
+    };
+
+    epics::pvData::Mutex m_mutex;
+    epics::pvData::Event m_wakeup;
+    std::deque<Job> m_queue;
+    bool m_stopping;
+    std::vector<std::tr1::shared_ptr<epicsThread> > m_threads;
+    // statistics
+    size_t m_maxDepth, m_active, m_completed;
+};
+
+
+// request counters and latencies of one registered service name
+struct RPCServiceStats
+{
+    POINTER_DEFINITIONS(RPCServiceStats);
+
+    // guards all below
+    epics::pvData::Mutex mutex;
+    size_t requests, errors, active;
+    // time waiting for a thread of the pool, and in the service until it answered
+    LatencyHistogram queued, executing;
+
+    RPCServiceStats() :requests(0u), errors(0u), active(0u) {}
+};
 
 class ChannelRPCServiceImpl :
     public ChannelRPC,
@@ -30,16 +99,50 @@ private:
     ChannelRPCRequester::shared_pointer m_channelRPCRequester;
     RPCServiceAsync::shared_pointer m_rpcService;
     AtomicBoolean m_lastRequest;
+    // set for a synchronous RPCService
+    RPCThreadPool::shared_pointer m_pool;
+    std::tr1::shared_ptr<RPCThreadPool::Limit> m_limit;
+    // times of the request in progress.  There is at most one per ChannelRPC
+    RPCServiceStats::shared_pointer m_stats;
+    epicsTime m_submitted, m_started;
+    bool m_invoked;
+    // declared by the service, or null
+    const Structure::const_shared_pointer m_argumentType;
+
+    void recordDone(epics::pvData::Status const & status)
+    {
+        if (!m_stats)
+            return;
+        epicsTime now(epicsTime::getCurrent());
+        Lock guard(m_stats->mutex);
+        if (m_stats->active)
+            m_stats->active--;
+        if (!status.isSuccess())
+            m_stats->errors++;
+        if (m_invoked) {
+            m_stats->queued.record(m_started - m_submitted);
+            m_stats->executing.record(now - m_started);
+            m_invoked = false;
+        }
+    }
 
 public:
     ChannelRPCServiceImpl(
         Channel::shared_pointer const & channel,
         ChannelRPCRequester::shared_pointer const & channelRPCRequester,
-        RPCServiceAsync::shared_pointer const & rpcService) :
+        RPCServiceAsync::shared_pointer const & rpcService,
+        RPCThreadPool::shared_pointer const & pool,
+        std::tr1::shared_ptr<RPCThreadPool::Limit> const & limit,
+        RPCServiceStats::shared_pointer const & stats) :
         m_channel(channel),
         m_channelRPCRequester(channelRPCRequester),
         m_rpcService(rpcService),
-        m_lastRequest()
+        m_lastRequest(),
+        m_pool(pool),
+        m_limit(limit),
+        m_stats(stats),
+        m_invoked(false),
+        m_argumentType(rpcService->getArgumentType())
     {
     }
 
@@ -53,6 +156,7 @@ public:
         epics::pvData::PVStructure::shared_pointer const & result
     )
     {
+        recordDone(status);
         m_channelRPCRequester->requestDone(status, shared_from_this(), result);
 
         if (m_lastRequest.get())
@@ -61,6 +165,33 @@ public:
 
     virtual void request(epics::pvData::PVStructure::shared_pointer const & pvArgument)
     {
+        if (m_argumentType && !(pvArgument && (pvArgument->getStructure() == m_argumentType ||
+                                               *pvArgument->getStructure() == *m_argumentType)))
+        {
+            Status errorStatus(Status::STATUSTYPE_ERROR, "RPC argument does not have the type declared by the service");
+            m_channelRPCRequester->requestDone(errorStatus, shared_from_this(), PVStructure::shared_pointer());
+
+            if (m_lastRequest.get())
+                destroy();
+            return;
+        }
+
+        if (m_stats) {
+            m_submitted = epicsTime::getCurrent();
+            Lock guard(m_stats->mutex);
+            m_stats->requests++;
+            m_stats->active++;
+        }
+        if (m_pool)
+            m_pool->submit(shared_from_this(), pvArgument, m_limit);
+        else
+            invoke(pvArgument);
+    }
+
+    void invoke(epics::pvData::PVStructure::shared_pointer const & pvArgument)
+    {
+        m_started = epicsTime::getCurrent();
+        m_invoked = true;
         try
         {
             m_rpcService->request(pvArgument, shared_from_this());
@@ -70,6 +201,7 @@ public:
             // handle user unexpected errors
             Status errorStatus(Status::STATUSTYPE_FATAL, ex.what());
 
+            recordDone(errorStatus);
             m_channelRPCRequester->requestDone(errorStatus, shared_from_this(), PVStructure::shared_pointer());
 
             if (m_lastRequest.get())
@@ -81,6 +213,7 @@ public:
             Status errorStatus(Status::STATUSTYPE_FATAL,
                                "Unexpected exception caught while calling RPCServiceAsync.request(PVStructure, RPCResponseCallback).");
 
+            recordDone(errorStatus);
             m_channelRPCRequester->requestDone(errorStatus, shared_from_this(), PVStructure::shared_pointer());
 
             if (m_lastRequest.get())
@@ -95,6 +228,11 @@ public:
         m_lastRequest.set();
     }
 
+    virtual Structure::const_shared_pointer getArgumentType()
+    {
+        return m_argumentType;
+    }
+
     virtual Channel::shared_pointer getChannel()
     {
         return m_channel;
@@ -114,6 +252,152 @@ public:
 
 
 
+RPCThreadPool::RPCThreadPool(unsigned nthreads)
+    :m_stopping(false)
+    ,m_maxDepth(0u)
+    ,m_active(0u)
+    ,m_completed(0u)
+{
+    m_threads.reserve(nthreads);
+    for (unsigned i=0; i<nthreads; i++) {
+        std::tr1::shared_ptr<epicsThread> thread(new epicsThread(*this, "RPCWorker",
+                                                                 epicsThreadGetStackSize(epicsThreadStackBig),
+                                                                 epicsThreadPriorityMedium));
+        thread->start();
+        m_threads.push_back(thread);
+    }
+}
+
+RPCThreadPool::~RPCThreadPool()
+{
+    stop();
+}
+
+void RPCThreadPool::submit(std::tr1::shared_ptr<ChannelRPCServiceImpl> op,
+                           PVStructure::shared_pointer const & args,
+                           std::tr1::shared_ptr<Limit> const & limit)
+{
+    {
+        Lock guard(m_mutex);
+        if (!m_stopping && limit && limit->active >= limit->maxActive) {
+            // queued to m_queue as another request of this service completes
+            limit->waiting.push_back(std::make_pair(op, args));
+            return;
+        } else if (!m_stopping) {
+            if (limit)
+                limit->active++;
+            Job job;
+            job.op = op;
+            job.args = args;
+            job.limit = limit;
+            m_queue.push_back(job);
+            if (m_queue.size() > m_maxDepth)
+                m_maxDepth = m_queue.size();
+            op.reset();
+        }
+    }
+    if (op) {
+        op->requestDone(Status(Status::STATUSTYPE_ERROR, "RPC server stopped"), PVStructure::shared_pointer());
+        return;
+    }
+    m_wakeup.signal();
+}
+
+void RPCThreadPool::run()
+{
+    Lock guard(m_mutex);
+    while (true) {
+        if (m_queue.empty()) {
+            if (m_stopping)
+                break;
+            guard.unlock();
+            m_wakeup.wait();
+            guard.lock();
+            continue;
+        }
+
+        Job job(m_queue.front());
+        m_queue.pop_front();
+        m_active++;
+        // another worker for the rest
+        if (!m_queue.empty())
+            m_wakeup.signal();
+
+        guard.unlock();
+        job.op->invoke(job.args);
+        job.op.reset();
+        guard.lock();
+
+        m_active--;
+        m_completed++;
+
+        if (job.limit && m_stopping) {
+            Limit::waiting_t dropped;
+            dropped.swap(job.limit->waiting);
+            job.limit->active--;
+            guard.unlock();
+            Status error(Status::STATUSTYPE_ERROR, "RPC server stopped");
+            for (size_t i=0; i<dropped.size(); i++)
+                dropped[i].first->requestDone(error, PVStructure::shared_pointer());
+            guard.lock();
+        } else if (job.limit && !job.limit->waiting.empty()) {
+            Job next;
+            next.op = job.limit->waiting.front().first;
+            next.args = job.limit->waiting.front().second;
+            next.limit = job.limit;
+            job.limit->waiting.pop_front();
+            m_queue.push_back(next);
+        } else if (job.limit) {
+            job.limit->active--;
+        }
+    }
+    // wake the next worker to exit
+    m_wakeup.signal();
+}
+
+void RPCThreadPool::stop()
+{
+    std::deque<Job> dropped;
+    {
+        Lock guard(m_mutex);
+        if (m_stopping)
+            return;
+        m_stopping = true;
+        // requests not yet started are answered with an error
+        dropped.swap(m_queue);
+        for (size_t i=0, n=dropped.size(); i<n; i++) {
+            if (!dropped[i].limit)
+                continue;
+            Limit::waiting_t& waiting = dropped[i].limit->waiting;
+            for (size_t j=0; j<waiting.size(); j++) {
+                Job job;
+                job.op = waiting[j].first;
+                dropped.push_back(job);
+            }
+            waiting.clear();
+        }
+    }
+    m_wakeup.signal();
+    for (size_t i=0; i<m_threads.size(); i++)
+        m_threads[i]->exitWait();
+
+    Status error(Status::STATUSTYPE_ERROR, "RPC server stopped");
+    for (size_t i=0; i<dropped.size(); i++) {
+        dropped[i].op->requestDone(error, PVStructure::shared_pointer());
+    }
+}
+
+void RPCThreadPool::show(std::ostream& strm)
+{
+    Lock guard(m_mutex);
+    strm << "RPC threads " << m_threads.size()
+         << " queued " << m_queue.size()
+         << " max " << m_maxDepth
+         << " active " << m_active
+         << " completed " << m_completed << std::endl;
+}
+
+
 class RPCChannel :
     public Channel,
     public std::tr1::enable_shared_from_this<RPCChannel>
@@ -128,6 +412,10 @@ private:
 
     RPCServiceAsync::shared_pointer m_rpcService;
 
+    RPCThreadPool::shared_pointer m_pool;
+    std::tr1::shared_ptr<RPCThreadPool::Limit> m_limit;
+    RPCServiceStats::shared_pointer m_stats;
+
 public:
     POINTER_DEFINITIONS(RPCChannel);
 
@@ -135,12 +423,20 @@ public:
         ChannelProvider::shared_pointer const & provider,
         string const & channelName,
         ChannelRequester::shared_pointer const & channelRequester,
-        RPCServiceAsync::shared_pointer const & rpcService) :
+        RPCServiceAsync::shared_pointer const & rpcService,
+        RPCThreadPool::shared_pointer const & pool = RPCThreadPool::shared_pointer(),
+        std::tr1::shared_ptr<RPCThreadPool::Limit> const & limit = std::tr1::shared_ptr<RPCThreadPool::Limit>(),
+        RPCServiceStats::shared_pointer const & stats = RPCServiceStats::shared_pointer()) :
         m_provider(provider),
         m_channelName(channelName),
         m_channelRequester(channelRequester),
-        m_rpcService(rpcService)
+        m_rpcService(rpcService),
+        m_limit(limit),
+        m_stats(stats)
     {
+        // only a synchronous service blocks the calling thread
+        if (dynamic_cast<RPCService*>(rpcService.get()))
+            m_pool = pool;
     }
 
     virtual ~RPCChannel()
@@ -199,7 +495,7 @@ public:
 
         // TODO use std::make_shared
         std::tr1::shared_ptr<ChannelRPCServiceImpl> tp(
-            new ChannelRPCServiceImpl(shared_from_this(), channelRPCRequester, m_rpcService)
+            new ChannelRPCServiceImpl(shared_from_this(), channelRPCRequester, m_rpcService, m_pool, m_limit, m_stats)
         );
         ChannelRPC::shared_pointer channelRPCImpl = tp;
         channelRPCRequester->channelRPCConnect(Status::Ok, channelRPCImpl);
@@ -240,6 +536,51 @@ Channel::shared_pointer createRPCChannel(ChannelProvider::shared_pointer const &
 }
 
 
+class RPCChannelProvider;
+
+namespace {
+// all RPCChannelProvider instances, for RPCServer::report()
+struct ProviderList {
+    epics::pvData::Mutex mutex;
+    std::vector<RPCChannelProvider*> providers;
+};
+ProviderList *providerList;
+epicsThreadOnceId providerListOnce = EPICS_THREAD_ONCE_INIT;
+
+void providerListInit(void *)
+{
+    providerList = new ProviderList;
+}
+
+ProviderList& getProviderList()
+{
+    epicsThreadOnce(&providerListOnce, &providerListInit, 0);
+    return *providerList;
+}
+
+// the metrics of all providers are exported by one source, added with the first provider
+epicsThreadOnceId rpcMetricsOnce = EPICS_THREAD_ONCE_INIT;
+void rpcMetricsInit(void *);
+
+Structure::const_shared_pointer statsStructure(
+    getFieldCreate()->createFieldBuilder()->
+    setId("epics:nt/NTTable:1.0")->
+    addArray("labels", pvString)->
+    addNestedStructure("value")->
+        addArray("service", pvString)->
+        addArray("requests", pvULong)->
+        addArray("errors", pvULong)->
+        addArray("active", pvULong)->
+        addArray("queuedP50US", pvDouble)->
+        addArray("queuedP99US", pvDouble)->
+        addArray("executingP50US", pvDouble)->
+        addArray("executingP90US", pvDouble)->
+        addArray("executingP99US", pvDouble)->
+        addArray("executingMaxUS", pvDouble)->
+    endNested()->
+    createStructure());
+} // namespace
+
 class RPCChannelProvider :
     public virtual ChannelProvider,
     public virtual ChannelFind,
@@ -252,9 +593,172 @@ public:
 
     static const Status noSuchChannelStatus;
 
-    // TODO thread pool support
-
     RPCChannelProvider() {
+        epicsThreadOnce(&rpcMetricsOnce, &rpcMetricsInit, 0);
+        ProviderList& list = getProviderList();
+        Lock guard(list.mutex);
+        list.providers.push_back(this);
+    }
+
+    virtual ~RPCChannelProvider() {
+        {
+            ProviderList& list = getProviderList();
+            Lock guard(list.mutex);
+            list.providers.erase(std::find(list.providers.begin(), list.providers.end(), this));
+        }
+        stopThreads();
+    }
+
+    // with 0 threads, RPCService::request() is called by the server receive thread
+    void startThreads(unsigned nthreads)
+    {
+        if (nthreads == 0u)
+            return;
+        Lock guard(m_mutex);
+        if (!m_pool)
+            m_pool.reset(new RPCThreadPool(nthreads));
+    }
+
+    void stopThreads()
+    {
+        RPCThreadPool::shared_pointer pool;
+        {
+            Lock guard(m_mutex);
+            pool.swap(m_pool);
+        }
+        if (pool)
+            pool->stop();
+    }
+
+    void show(std::ostream& strm)
+    {
+        RPCThreadPool::shared_pointer pool;
+        {
+            Lock guard(m_mutex);
+            pool = m_pool;
+        }
+        if (pool)
+            pool->show(strm);
+        showStats(strm);
+    }
+
+    // copy of the statistics of each service name
+    struct StatsRow {
+        string name;
+        size_t requests, errors, active;
+        LatencyHistogram queued, executing;
+    };
+
+    void snapshot(std::vector<StatsRow>& rows)
+    {
+        std::vector<std::pair<string, RPCServiceStats::shared_pointer> > stats;
+        {
+            Lock guard(m_mutex);
+            stats.assign(m_stats.begin(), m_stats.end());
+        }
+        rows.resize(stats.size());
+        for (size_t i=0; i<stats.size(); i++) {
+            RPCServiceStats& S = *stats[i].second;
+            Lock guard(S.mutex);
+            rows[i].name = stats[i].first;
+            rows[i].requests = S.requests;
+            rows[i].errors = S.errors;
+            rows[i].active = S.active;
+            rows[i].queued = S.queued;
+            rows[i].executing = S.executing;
+        }
+    }
+
+    void showStats(std::ostream& strm)
+    {
+        std::vector<StatsRow> rows;
+        snapshot(rows);
+        for (size_t i=0; i<rows.size(); i++) {
+            const StatsRow& R = rows[i];
+            strm << "Service " << R.name
+                 << " requests " << R.requests
+                 << " errors " << R.errors
+                 << " active " << R.active << "\n"
+                 << "  queued    ";
+            R.queued.show(strm);
+            strm << "\n  executing ";
+            R.executing.show(strm);
+            strm << std::endl;
+        }
+    }
+
+    PVStructure::shared_pointer statsTable()
+    {
+        std::vector<StatsRow> rows;
+        snapshot(rows);
+
+        PVStructure::shared_pointer result(getPVDataCreate()->createPVStructure(statsStructure));
+        PVStructure::shared_pointer value(result->getSubFieldT<PVStructure>("value"));
+
+        PVStringArray::svector names, labels;
+        PVULongArray::svector requests, errors, active;
+        PVDoubleArray::svector qp50, qp99, ep50, ep90, ep99, emax;
+        for (size_t i=0; i<rows.size(); i++) {
+            const StatsRow& R = rows[i];
+            names.push_back(R.name);
+            requests.push_back(R.requests);
+            errors.push_back(R.errors);
+            active.push_back(R.active);
+            qp50.push_back(R.queued.percentile(0.5)*1e6);
+            qp99.push_back(R.queued.percentile(0.99)*1e6);
+            ep50.push_back(R.executing.percentile(0.5)*1e6);
+            ep90.push_back(R.executing.percentile(0.9)*1e6);
+            ep99.push_back(R.executing.percentile(0.99)*1e6);
+            emax.push_back(R.executing.max()*1e6);
+        }
+
+        const StringArray& columns = value->getStructure()->getFieldNames();
+        labels.assign(columns.begin(), columns.end());
+        result->getSubFieldT<PVStringArray>("labels")->replace(freeze(labels));
+        value->getSubFieldT<PVStringArray>("service")->replace(freeze(names));
+        value->getSubFieldT<PVULongArray>("requests")->replace(freeze(requests));
+        value->getSubFieldT<PVULongArray>("errors")->replace(freeze(errors));
+        value->getSubFieldT<PVULongArray>("active")->replace(freeze(active));
+        value->getSubFieldT<PVDoubleArray>("queuedP50US")->replace(freeze(qp50));
+        value->getSubFieldT<PVDoubleArray>("queuedP99US")->replace(freeze(qp99));
+        value->getSubFieldT<PVDoubleArray>("executingP50US")->replace(freeze(ep50));
+        value->getSubFieldT<PVDoubleArray>("executingP90US")->replace(freeze(ep90));
+        value->getSubFieldT<PVDoubleArray>("executingP99US")->replace(freeze(ep99));
+        value->getSubFieldT<PVDoubleArray>("executingMaxUS")->replace(freeze(emax));
+        return result;
+    }
+
+    static void collectAll(Metrics& M)
+    {
+        M.family("pva_rpc_requests_total", Metrics::Counter, "RPC requests, by service");
+        M.family("pva_rpc_errors_total", Metrics::Counter, "RPC requests which failed, by service");
+        M.family("pva_rpc_active", Metrics::Gauge, "RPC requests being executed, by service");
+        M.family("pva_rpc_queued_seconds", Metrics::Histogram, "RPC time waiting for a thread, by service");
+        M.family("pva_rpc_executing_seconds", Metrics::Histogram, "RPC time in the service, by service");
+
+        ProviderList& list = getProviderList();
+        Lock guard(list.mutex);
+        std::vector<StatsRow> rows;
+        for (size_t i=0; i<list.providers.size(); i++) {
+            list.providers[i]->snapshot(rows);
+            for (size_t r=0; r<rows.size(); r++) {
+                const StatsRow& R = rows[r];
+                const string service(Metrics::label("service", R.name));
+                M.add("pva_rpc_requests_total", double(R.requests), service);
+                M.add("pva_rpc_errors_total", double(R.errors), service);
+                M.add("pva_rpc_active", double(R.active), service);
+                M.add("pva_rpc_queued_seconds", R.queued, Metrics::defaultBounds(), service);
+                M.add("pva_rpc_executing_seconds", R.executing, Metrics::defaultBounds(), service);
+            }
+        }
+    }
+
+    static void report(std::ostream& strm)
+    {
+        ProviderList& list = getProviderList();
+        Lock guard(list.mutex);
+        for (size_t i=0; i<list.providers.size(); i++)
+            list.providers[i]->show(strm);
     }
 
     virtual string getProviderName() {
@@ -312,18 +816,31 @@ public:
         short /*priority*/)
     {
         RPCServiceAsync::shared_pointer service;
-
-        RPCServiceMap::const_iterator iter;
+        RPCThreadPool::shared_pointer pool;
+        std::tr1::shared_ptr<RPCThreadPool::Limit> limit;
+        RPCServiceStats::shared_pointer stats;
         {
             Lock guard(m_mutex);
-            iter = m_services.find(channelName);
+            // the name a service is registered with
+            string name(channelName);
+            RPCServiceMap::const_iterator iter = m_services.find(channelName);
+            if (iter != m_services.end())
+                service = iter->second;
+
+            // check for wild services
+            if (!service)
+                service = findWildService(channelName, &name);
+
+            if (service) {
+                pool = m_pool;
+                RPCLimitMap::const_iterator it = m_limits.find(service.get());
+                if (it != m_limits.end())
+                    limit = it->second;
+                RPCStatsMap::const_iterator S = m_stats.find(name);
+                if (S != m_stats.end())
+                    stats = S->second;
+            }
         }
-        if (iter != m_services.end())
-            service = iter->second;
-
-        // check for wild services
-        if (!service)
-            service = findWildService(channelName);
 
         if (!service)
         {
@@ -338,7 +855,10 @@ public:
                 shared_from_this(),
                 channelName,
                 channelRequester,
-                service));
+                service,
+                pool,
+                limit,
+                stats));
         Channel::shared_pointer rpcChannel = tp;
         channelRequester->channelCreated(Status::Ok, rpcChannel);
         return rpcChannel;
@@ -354,43 +874,45 @@ public:
         throw std::runtime_error("not supported");
     }
 
-    void registerService(std::string const & serviceName, RPCServiceAsync::shared_pointer const & service)
+    void registerService(std::string const & serviceName, RPCServiceAsync::shared_pointer const & service,
+                         size_t maxConcurrency = 0u)
     {
         Lock guard(m_mutex);
         m_services[serviceName] = service;
+        m_stats[serviceName].reset(new RPCServiceStats);
+        if (maxConcurrency)
+            m_limits[service.get()].reset(new RPCThreadPool::Limit(maxConcurrency));
 
         if (isWildcardPattern(serviceName))
-            m_wildServices.push_back(std::make_pair(serviceName, service));
+            m_wildServices.add(serviceName);
     }
 
     void unregisterService(std::string const & serviceName)
     {
         Lock guard(m_mutex);
-        m_services.erase(serviceName);
+        RPCServiceMap::iterator iter = m_services.find(serviceName);
+        if (iter != m_services.end()) {
+            m_limits.erase(iter->second.get());
+            m_services.erase(iter);
+        }
+        m_stats.erase(serviceName);
 
         if (isWildcardPattern(serviceName))
-        {
-            for (RPCWildServiceList::iterator iter = m_wildServices.begin();
-                    iter != m_wildServices.end();
-                    iter++)
-                if (iter->first == serviceName)
-                {
-                    m_wildServices.erase(iter);
-                    break;
-                }
-        }
+            m_wildServices.remove(serviceName);
     }
 
 private:
     // assumes sync on services
-    RPCServiceAsync::shared_pointer findWildService(string const & wildcard)
+    RPCServiceAsync::shared_pointer findWildService(string const & wildcard, string *matched = 0)
     {
-        if (!m_wildServices.empty())
-            for (RPCWildServiceList::iterator iter = m_wildServices.begin();
-                    iter != m_wildServices.end();
-                    iter++)
-                if (Wildcard::wildcardfit(iter->first.c_str(), wildcard.c_str()))
-                    return iter->second;
+        string pattern;
+        if (m_wildServices.match(wildcard, &pattern)) {
+            if (matched)
+                *matched = pattern;
+            RPCServiceMap::const_iterator iter = m_services.find(pattern);
+            if (iter != m_services.end())
+                return iter->second;
+        }
 
         return RPCServiceAsync::shared_pointer();
     }
@@ -407,12 +929,56 @@ private:
     typedef std::map<string, RPCServiceAsync::shared_pointer> RPCServiceMap;
     RPCServiceMap m_services;
 
-    typedef std::vector<std::pair<string, RPCServiceAsync::shared_pointer> > RPCWildServiceList;
-    RPCWildServiceList m_wildServices;
+    // patterns of the wildcard names in m_services
+    WildcardSet m_wildServices;
+
+    typedef std::map<const RPCServiceAsync*, std::tr1::shared_ptr<RPCThreadPool::Limit> > RPCLimitMap;
+    RPCLimitMap m_limits;
+
+    typedef std::map<string, RPCServiceStats::shared_pointer> RPCStatsMap;
+    RPCStatsMap m_stats;
+
+    RPCThreadPool::shared_pointer m_pool;
 
     epics::pvData::Mutex m_mutex;
 };
 
+// answers with the statistics table of the services of a provider
+class RPCStatsService : public RPCService
+{
+    std::tr1::weak_ptr<RPCChannelProvider> m_provider;
+public:
+    explicit RPCStatsService(const std::tr1::shared_ptr<RPCChannelProvider>& provider)
+        :m_provider(provider)
+    {}
+    virtual ~RPCStatsService() {}
+
+    virtual PVStructure::shared_pointer request(PVStructure::shared_pointer const & /*args*/)
+    {
+        std::tr1::shared_ptr<RPCChannelProvider> provider(m_provider.lock());
+        if (!provider)
+            throw RPCRequestException("RPC server stopped");
+        return provider->statsTable();
+    }
+};
+
+namespace {
+struct RPCMetrics : public MetricsSource
+{
+    virtual void collectMetrics(Metrics& metrics) OVERRIDE FINAL
+    {
+        RPCChannelProvider::collectAll(metrics);
+    }
+};
+
+void rpcMetricsInit(void *)
+{
+    // kept for the life of the process
+    static MetricsSource::shared_pointer source(new RPCMetrics);
+    MetricsSource::add(source);
+}
+} // namespace
+
 const string RPCChannelProvider::PROVIDER_NAME("rpcService");
 const Status RPCChannelProvider::noSuchChannelStatus(Status::STATUSTYPE_ERROR, "no such channel");
 
@@ -420,6 +986,16 @@ const Status RPCChannelProvider::noSuchChannelStatus(Status::STATUSTYPE_ERROR, "
 RPCServer::RPCServer(const Configuration::const_shared_pointer &conf)
     :m_channelProviderImpl(new RPCChannelProvider)
 {
+    Configuration::const_shared_pointer C(conf);
+    if (!C)
+        C = ConfigurationBuilder().push_env().build();
+    epics::pvData::int32 nthreads = C->getPropertyAsInteger("EPICS_PVA_RPC_THREADS", 0);
+    if (nthreads > 0)
+        m_channelProviderImpl->startThreads(unsigned(nthreads));
+
+    m_channelProviderImpl->registerService("rpc.stats",
+        RPCServiceAsync::shared_pointer(new RPCStatsService(m_channelProviderImpl)));
+
     m_serverContext = ServerContext::create(ServerContext::Config()
                                             .config(conf)
                                             .provider(m_channelProviderImpl));
@@ -435,6 +1011,12 @@ void RPCServer::printInfo()
 {
     std::cout << m_serverContext->getVersion().getVersionString() << std::endl;
     m_serverContext->printInfo();
+    m_channelProviderImpl->show(std::cout);
+}
+
+void RPCServer::report(std::ostream& strm)
+{
+    RPCChannelProvider::report(strm);
 }
 
 void RPCServer::run(int seconds)
@@ -476,6 +1058,7 @@ void RPCServer::runInNewThread(int seconds)
 void RPCServer::destroy()
 {
     m_serverContext->shutdown();
+    m_channelProviderImpl->stopThreads();
 }
 
 void RPCServer::registerService(std::string const & serviceName, RPCServiceAsync::shared_pointer const & service)
@@ -483,6 +1066,12 @@ void RPCServer::registerService(std::string const & serviceName, RPCServiceAsync
     m_channelProviderImpl->registerService(serviceName, service);
 }
 
+void RPCServer::registerService(std::string const & serviceName, RPCService::shared_pointer const & service,
+                                size_t maxConcurrency)
+{
+    m_channelProviderImpl->registerService(serviceName, service, maxConcurrency);
+}
+
 void RPCServer::unregisterService(std::string const & serviceName)
 {
     m_channelProviderImpl->unregisterService(serviceName);
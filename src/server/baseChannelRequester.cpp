@@ -4,6 +4,17 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <string.h>
+
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_REQUESTER_USE_ATOMIC
+#endif
+#endif
+
 #define epicsExportSharedSymbols
 #include <pv/baseChannelRequester.h>
 
@@ -33,7 +44,11 @@ BaseChannelRequester::BaseChannelRequester(
     _transport(transport),
     _channel(channel),
     _context(context),
-    _pendingRequest(BaseChannelRequester::NULL_REQUEST)
+    _pendingRequest(BaseChannelRequester::NULL_REQUEST),
+    _requestStart(),
+    _stamped(false),
+    _dispatchTime(),
+    _traced(0)
 {
 
 }
@@ -41,18 +56,144 @@ BaseChannelRequester::BaseChannelRequester(
 bool BaseChannelRequester::startRequest(int32 qos)
 {
     Lock guard(_mutex);
-    if (_pendingRequest != NULL_REQUEST)
+    if (_pendingRequest != NULL_REQUEST || !_queued.empty())
     {
         return false;
     }
     _pendingRequest = qos;
+    if (_context->getServerStats())
+        epicsTimeGetCurrent(&_requestStart);
     return true;
 }
 
-void BaseChannelRequester::stopRequest()
+bool BaseChannelRequester::canQueueRequest()
+{
+    Lock guard(_mutex);
+    // counting the pending request
+    return _queued.size() + 1u < size_t(_transport->getPipelineWindow());
+}
+
+void BaseChannelRequester::queueRequest(int32 qos)
+{
+    Lock guard(_mutex);
+    _queued.push_back(qos);
+}
+
+bool BaseChannelRequester::startQueued(int32& qos)
+{
+    Lock guard(_mutex);
+    if (_pendingRequest != NULL_REQUEST || _queued.empty())
+        return false;
+    qos = _pendingRequest = _queued.front();
+    _queued.pop_front();
+    if (_context->getServerStats())
+        epicsTimeGetCurrent(&_requestStart);
+    return true;
+}
+
+void BaseChannelRequester::clearQueued()
+{
+    Lock guard(_mutex);
+    _queued.clear();
+}
+
+void BaseChannelRequester::stopRequest(int8 command)
 {
+    int32 request;
+    epicsTimeStamp start, dispatch;
+    Span span;
+    bool traced = false, stamped;
+    {
+        Lock guard(_mutex);
+        request = _pendingRequest;
+        start = _requestStart;
+        _pendingRequest = NULL_REQUEST;
+        stamped = _stamped;
+        dispatch = _dispatchTime;
+        _stamped = false;
+        if (_traced) {
+            traced = true;
+            _traced = 0;
+            span = _span;
+        }
+    }
+
+    // creation is not counted
+    const ServerStats::shared_pointer& stats(_context->getServerStats());
+    if (stats && command>=0 && request!=NULL_REQUEST && !(request & QOS_INIT))
+        stats->recordLatency(command, start);
+
+    if (stamped && command>=0)
+        _transport->responseSent(dispatch);
+
+    if (traced && command>=0) {
+        // a get through ChannelPut is a get
+        const bool get = command==CMD_PUT && request!=NULL_REQUEST && (request & QOS_GET);
+        span.name = std::string("pva.") + (get ? "get" : detail::TransportStatistics::commandName(command));
+        epicsTimeGetCurrent(&span.end);
+        TraceSink::recordAll(span);
+    }
+}
+
+bool BaseChannelRequester::traceDispatch(TraceContext& context)
+{
+    epicsTimeStamp kernel, dispatch;
+    const bool stamped = _transport->receivedAt(kernel, dispatch);
+    if (stamped) {
+        Lock guard(_mutex);
+        _stamped = true;
+        _dispatchTime = dispatch;
+    }
+
+    if (!_transport->isTracing())
+        return false;
+    TraceContext parent;
+    epicsTimeStamp received;
+    if (!_transport->receivedTrace(parent, received))
+        return false;
+
+    const Channel::shared_pointer& channel(_channel->getChannel());
+
     Lock guard(_mutex);
-    _pendingRequest = NULL_REQUEST;
+    _span = Span();
+    _span.server = true;
+    _span.context = parent.child();
+    memcpy(_span.parentId, parent.spanId, sizeof(_span.parentId));
+    if (channel)
+        _span.channel = channel->getChannelName();
+    _span.peer = _transport->getRemoteName();
+    // when the kernel received the request, rather than its trace context
+    _span.start = stamped ? kernel : received;
+    epicsTimeGetCurrent(&_span.dispatch);
+#ifdef PVA_REQUESTER_USE_ATOMIC
+    epics::atomic::set(_traced, 1);
+#else
+    _traced = 1;
+#endif
+    context = _span.context;
+    return true;
+}
+
+void BaseChannelRequester::traceSend(ByteBuffer* buffer, TransportSendControl* control)
+{
+#ifdef PVA_REQUESTER_USE_ATOMIC
+    // without the lock, as most requests are not traced
+    if (!epics::atomic::get(_traced) || !_transport->isPeerTracing())
+        return;
+#else
+    if (!_transport->isPeerTracing())
+        return;
+#endif
+    TraceContext context;
+    {
+        Lock guard(_mutex);
+        if (!_traced)
+            return;
+        context = _span.context;
+    }
+    control->startMessage((int8)CMD_TRACE_CONTEXT, TraceContext::wireSize);
+    context.serialize(buffer);
+    control->endMessage();
 }
 
 int32 BaseChannelRequester::getPendingRequest()
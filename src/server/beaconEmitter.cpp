@@ -20,6 +20,7 @@ namespace pvAccess {
 
 const float BeaconEmitter::EPICS_PVA_MIN_BEACON_PERIOD = 1.0;
 const float BeaconEmitter::EPICS_PVA_MIN_BEACON_COUNT_LIMIT = 3.0;
+const double BeaconEmitter::BEACON_PERIOD_JITTER = 0.1;
 
 //BeaconEmitter::BeaconEmitter(Transport::shared_pointer const & transport, ServerContextImpl::shared_pointer const & context) :
 BeaconEmitter::BeaconEmitter(std::string const & protocol,
@@ -34,8 +35,16 @@ BeaconEmitter::BeaconEmitter(std::string const & protocol,
     _serverAddress(*(context->getServerInetAddress())),
     _serverPort(context->getServerPort()),
     _serverStatusProvider(context->getBeaconServerStatusProvider()),
-    _timer(context->getTimer())
+    _timer(context->getTimer()),
+    _randomState(2166136261u),
+    _beaconsSent(context->getCounters().beaconsSent)
 {
+    // not rand(), which would give identical sequences to identical IOCs booted together
+    for (size_t i = 0; i < sizeof(_guid.value); i++)
+        _randomState = (_randomState ^ (uint8)_guid.value[i]) * 16777619u;
+    _randomState ^= (uint32)_serverPort;
+    if (_randomState == 0)
+        _randomState = 1;
 }
 
 BeaconEmitter::~BeaconEmitter()
@@ -91,6 +100,7 @@ void BeaconEmitter::send(ByteBuffer* buffer, TransportSendControl* control)
         SerializationHelper::serializeNullField(buffer, control);
     }
     control->flush(true);
+    _beaconsSent.increment();
 
     // increment beacon sequence ID
     _beaconSequenceID++;
@@ -105,16 +115,25 @@ void BeaconEmitter::timerStopped()
 
 void BeaconEmitter::destroy()
 {
-    Timer::shared_pointer timer(_timer.lock());
+    TimerWheel::shared_pointer timer(_timer.lock());
     if(timer)
         timer->cancel(shared_from_this());
 }
 
+double BeaconEmitter::random()
+{
+    // xorshift32
+    _randomState ^= _randomState << 13;
+    _randomState ^= _randomState >> 17;
+    _randomState ^= _randomState << 5;
+    return _randomState / 2147483647.5 - 1.0;
+}
+
 void BeaconEmitter::start()
 {
-    Timer::shared_pointer timer(_timer.lock());
+    TimerWheel::shared_pointer timer(_timer.lock());
     if(timer)
-        timer->scheduleAfterDelay(shared_from_this(), 0.0);
+        timer->scheduleAfterDelay(shared_from_this(), _fastBeaconPeriod * BEACON_PERIOD_JITTER * (random() + 1.0) / 2.0);
 }
 
 void BeaconEmitter::reschedule()
@@ -122,9 +141,9 @@ void BeaconEmitter::reschedule()
     const double period = (_beaconSequenceID >= _beaconCountLimit) ? _slowBeaconPeriod : _fastBeaconPeriod;
     if (period > 0)
     {
-        Timer::shared_pointer timer(_timer.lock());
+        TimerWheel::shared_pointer timer(_timer.lock());
         if(timer)
-            timer->scheduleAfterDelay(shared_from_this(), period);
+            timer->scheduleAfterDelay(shared_from_this(), period * (1.0 + BEACON_PERIOD_JITTER * random()));
     }
 }
 
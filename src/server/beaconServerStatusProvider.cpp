@@ -4,8 +4,12 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <time.h>
+
+#include <epicsTime.h>
+
 #define epicsExportSharedSymbols
-#include <pv/serverContext.h>
+#include <pv/serverContextImpl.h>
 #include <pv/beaconServerStatusProvider.h>
 
 using namespace epics::pvData;
@@ -13,26 +17,59 @@ using namespace epics::pvData;
 namespace epics {
 namespace pvAccess {
 
+namespace {
+double processCPU()
+{
+    clock_t used = clock();
+    return used==clock_t(-1) ? 0.0 : double(used)/CLOCKS_PER_SEC;
+}
+
+double wallClock()
+{
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    return now.secPastEpoch + now.nsec*1e-9;
+}
+} // namespace
+
 DefaultBeaconServerStatusProvider::DefaultBeaconServerStatusProvider(ServerContext::shared_pointer const & context)
-    :_status(getPVDataCreate()->createPVStructure(getFieldCreate()->createFieldBuilder()
-             ->add("connections", pvInt)
+    :_context(context)
+    ,_status(getPVDataCreate()->createPVStructure(getFieldCreate()->createFieldBuilder()
              ->add("connections", pvInt)
-             ->add("allocatedMemory", pvLong)
-             ->add("freeMemory", pvLong)
-             ->add("threads", pvInt)
-             ->add("deadlocks", pvInt)
-             ->add("averageSystemLoad", pvDouble)
+             ->add("cpu", pvDouble)
+             ->add("queueDepth", pvInt)
          ->createStructure()))
+    ,_connections(_status->getSubFieldT<PVInt>("connections"))
+    ,_queueDepth(_status->getSubFieldT<PVInt>("queueDepth"))
+    ,_cpu(_status->getSubFieldT<PVDouble>("cpu"))
+    ,_lastCPU(processCPU())
+    ,_lastTime(wallClock())
 {}
 
 DefaultBeaconServerStatusProvider::~DefaultBeaconServerStatusProvider() {}
 
 PVField::shared_pointer DefaultBeaconServerStatusProvider::getServerStatusData()
 {
-    //TODO implement (fill data)
+    const double cpu = processCPU(), now = wallClock();
+    if(now > _lastTime)
+        _cpu->put(cpu > _lastCPU ? (cpu - _lastCPU)/(now - _lastTime) : 0.0);
+    _lastCPU = cpu;
+    _lastTime = now;
+
+    ServerContextImpl::shared_pointer context(std::tr1::dynamic_pointer_cast<ServerContextImpl>(_context.lock()));
+    if(context) {
+        _connections->put(int32(context->getTransportRegistry()->size()));
+
+        int32 queued = 0;
+        if(context->getRequestPool()) {
+            RequestPool::Stats stats;
+            context->getRequestPool()->getStats(stats);
+            queued = int32(stats.queued);
+        }
+        _queueDepth->put(queued);
+    }
     return _status;
 }
 
 }
 }
-
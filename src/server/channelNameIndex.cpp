@@ -0,0 +1,296 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string.h>
+
+#include <epicsGuard.h>
+#include <epicsString.h>
+
+#define epicsExportSharedSymbols
+#include <pv/channelNameIndex.h>
+#include <pv/internedName.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+// bound on remembered missing names.  All are forgotten when reached.
+const size_t maxNegative = 100000u;
+
+// as InternedName::hash()
+unsigned hashName(const std::string& name)
+{
+    return epicsMemHash(name.c_str(), name.size(), 0);
+}
+}
+
+struct ChannelNameIndex::Entry {
+    enum kind_t { Published, Learned, Negative };
+
+    // shared with the channels, and other indexes, of this name
+    InternedName name;
+    unsigned hash;
+    kind_t kind;
+    std::tr1::weak_ptr<ChannelProvider> provider;
+    // for comparison, remains valid after provider has expired
+    const ChannelProvider* key;
+    // for Negative
+    epicsTime expires;
+
+    explicit Entry(const std::string& name)
+        :name(name)
+        ,hash(this->name.hash())
+        ,kind(Negative)
+        ,key(0)
+    {}
+};
+
+ChannelNameIndex::ChannelNameIndex(double negativeTimeout)
+    :negativeTimeout(negativeTimeout)
+    ,buckets(256u)
+    ,count(0u)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+ChannelNameIndex::~ChannelNameIndex() {}
+
+ChannelNameIndex::Entry* ChannelNameIndex::lookup(const std::string& name, unsigned hash)
+{
+    std::vector<Entry>& bucket = buckets[hash & (buckets.size()-1u)];
+    for(size_t i=0; i<bucket.size(); i++) {
+        if(bucket[i].hash==hash && bucket[i].name.str()==name)
+            return &bucket[i];
+    }
+    return 0;
+}
+
+ChannelNameIndex::Entry& ChannelNameIndex::insert(const std::string& name, unsigned hash)
+{
+    if(count >= 2u*buckets.size()) {
+        // grow, keeping an average of at most two entries per bucket
+        std::vector<std::vector<Entry> > larger(2u*buckets.size());
+        for(size_t b=0; b<buckets.size(); b++) {
+            for(size_t i=0; i<buckets[b].size(); i++) {
+                const Entry& ent = buckets[b][i];
+                larger[ent.hash & (larger.size()-1u)].push_back(ent);
+            }
+        }
+        buckets.swap(larger);
+    }
+
+    std::vector<Entry>& bucket = buckets[hash & (buckets.size()-1u)];
+    bucket.push_back(Entry(name));
+    count++;
+    return bucket.back();
+}
+
+void ChannelNameIndex::erase(Entry* ent)
+{
+    switch(ent->kind) {
+    case Entry::Published: stats.published--; break;
+    case Entry::Learned: stats.learned--; break;
+    case Entry::Negative: stats.negative--; break;
+    }
+
+    std::vector<Entry>& bucket = buckets[ent->hash & (buckets.size()-1u)];
+    Entry& last = bucket.back();
+    if(ent!=&last)
+        std::swap(*ent, last);
+    bucket.pop_back();
+    count--;
+}
+
+void ChannelNameIndex::purgeNegative()
+{
+    for(size_t b=0; b<buckets.size(); b++) {
+        std::vector<Entry>& bucket = buckets[b];
+        for(size_t i=0; i<bucket.size(); ) {
+            if(bucket[i].kind==Entry::Negative)
+                erase(&bucket[i]);
+            else
+                i++;
+        }
+    }
+}
+
+bool ChannelNameIndex::add(const std::string& name, const std::tr1::shared_ptr<ChannelProvider>& provider)
+{
+    const unsigned hash = hashName(name);
+    Guard G(mutex);
+    return addLocked(name, hash, provider);
+}
+
+size_t ChannelNameIndex::add(const std::vector<std::string>& names, const std::tr1::shared_ptr<ChannelProvider>& provider)
+{
+    // hash without the lock
+    std::vector<unsigned> hashes(names.size());
+    for(size_t i=0; i<names.size(); i++)
+        hashes[i] = hashName(names[i]);
+
+    size_t added = 0u;
+    Guard G(mutex);
+    for(size_t i=0; i<names.size(); i++) {
+        if(addLocked(names[i], hashes[i], provider))
+            added++;
+    }
+    return added;
+}
+
+bool ChannelNameIndex::addLocked(const std::string& name, unsigned hash, const std::tr1::shared_ptr<ChannelProvider>& provider)
+{
+    Entry *ent = lookup(name, hash);
+    if(ent && ent->kind==Entry::Published && ent->key!=provider.get() && !ent->provider.expired())
+        return false;
+
+    if(ent)
+        erase(ent);
+
+    Entry& added = insert(name, hash);
+    added.kind = Entry::Published;
+    added.provider = provider;
+    added.key = provider.get();
+    stats.published++;
+    return true;
+}
+
+void ChannelNameIndex::remove(const std::string& name, const ChannelProvider* provider)
+{
+    const unsigned hash = hashName(name);
+    Guard G(mutex);
+
+    Entry *ent = lookup(name, hash);
+    if(ent && ent->kind==Entry::Published && ent->key==provider)
+        erase(ent);
+}
+
+void ChannelNameIndex::removeAll(const ChannelProvider* provider)
+{
+    Guard G(mutex);
+
+    for(size_t b=0; b<buckets.size(); b++) {
+        std::vector<Entry>& bucket = buckets[b];
+        for(size_t i=0; i<bucket.size(); ) {
+            if(bucket[i].kind!=Entry::Negative && bucket[i].key==provider)
+                erase(&bucket[i]);
+            else
+                i++;
+        }
+    }
+}
+
+std::tr1::shared_ptr<ChannelProvider> ChannelNameIndex::find(const std::string& name, bool publishedOnly)
+{
+    std::tr1::shared_ptr<ChannelProvider> ret;
+    const unsigned hash = hashName(name);
+    Guard G(mutex);
+
+    Entry *ent = lookup(name, hash);
+    if(ent && (ent->kind==Entry::Published || (!publishedOnly && ent->kind==Entry::Learned))) {
+        ret = ent->provider.lock();
+        if(!ret)
+            erase(ent); // provider has gone away
+    }
+
+    return ret;
+}
+
+void ChannelNameIndex::learn(const std::string& name, const std::tr1::shared_ptr<ChannelProvider>& provider)
+{
+    const unsigned hash = hashName(name);
+    Guard G(mutex);
+
+    Entry *ent = lookup(name, hash);
+    if(ent && ent->kind==Entry::Published)
+        return;
+
+    if(!ent) {
+        ent = &insert(name, hash);
+    } else if(ent->kind==Entry::Negative) {
+        stats.negative--;
+    } else {
+        stats.learned--;
+    }
+
+    ent->kind = Entry::Learned;
+    ent->provider = provider;
+    ent->key = provider.get();
+    stats.learned++;
+}
+
+void ChannelNameIndex::addNegative(const std::string& name)
+{
+    if(negativeTimeout<=0.0)
+        return;
+
+    const unsigned hash = hashName(name);
+    Guard G(mutex);
+
+    Entry *ent = lookup(name, hash);
+    if(ent && ent->kind==Entry::Published)
+        return; // published while the search was in progress
+
+    if(!ent && stats.negative>=maxNegative)
+        purgeNegative();
+
+    if(!ent) {
+        ent = &insert(name, hash);
+        stats.negative++;
+    } else if(ent->kind==Entry::Learned) {
+        // a provider which had this name no longer does
+        stats.learned--;
+        stats.negative++;
+    }
+
+    ent->kind = Entry::Negative;
+    ent->provider.reset();
+    ent->key = 0;
+    ent->expires = epicsTime::getCurrent() + negativeTimeout;
+}
+
+ChannelNameIndex::SearchResult ChannelNameIndex::search(const std::string& name)
+{
+    const unsigned hash = hashName(name);
+    Guard G(mutex);
+
+    Entry *ent = lookup(name, hash);
+    if(ent) {
+        switch(ent->kind) {
+        case Entry::Published:
+            if(!ent->provider.expired()) {
+                stats.hits++;
+                return Published;
+            }
+            erase(ent); // provider has gone away
+            break;
+        case Entry::Negative:
+            if(epicsTime::getCurrent() < ent->expires) {
+                stats.negativeHits++;
+                return Missing;
+            }
+            erase(ent);
+            break;
+        case Entry::Learned:
+            break;
+        }
+    }
+
+    stats.misses++;
+    return Unknown;
+}
+
+void ChannelNameIndex::getStats(Stats& out) const
+{
+    Guard G(mutex);
+    out = stats;
+}
+
+ChannelNamePublisher::~ChannelNamePublisher() {}
+
+}
+}
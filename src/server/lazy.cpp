@@ -0,0 +1,300 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <map>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsTime.h>
+
+#include <shareLib.h>
+#include <pv/sharedPtr.h>
+#include <pv/pvData.h>
+#include <pv/status.h>
+#include <pv/timer.h>
+
+#define epicsExportSharedSymbols
+#include "sharedstateimpl.h"
+#include "pva/lazy.h"
+
+namespace pvas {
+
+struct LazyProvider::Impl : public DynamicProvider::Handler,
+                            public std::tr1::enable_shared_from_this<LazyProvider::Impl>
+{
+    struct Sweeper : public pvd::TimerCallback {
+        std::tr1::weak_ptr<Impl> impl;
+        virtual ~Sweeper() {}
+        virtual void callback() OVERRIDE FINAL {
+            if(std::tr1::shared_ptr<Impl> I = impl.lock())
+                I->sweep();
+        }
+        virtual void timerStopped() OVERRIDE FINAL {}
+    };
+
+    // names, oldest first
+    typedef std::list<std::string> idle_t;
+
+    struct Entry {
+        SharedPV::shared_pointer pv;
+        // channels connected, or since when none
+        bool inuse;
+        epicsTime idleSince;
+        // SharedPV::memoryUsage() when last disconnected
+        size_t bytes;
+        // in idle when !inuse
+        idle_t::iterator pos;
+    };
+    typedef std::map<std::string, Entry> entries_t;
+
+    /* Replaces the Handler of each PV materialized, to see its first and last channels,
+     * and passes on all calls.  Refers back without a cycle, as the SharedPV keeps its Handler.
+     */
+    struct Tracker : public SharedPV::Handler {
+        const std::tr1::weak_ptr<Impl> impl;
+        const std::string name;
+        const SharedPV::Handler::shared_pointer inner;
+        Tracker(const std::tr1::shared_ptr<Impl>& impl,
+                const std::string& name,
+                const SharedPV::Handler::shared_pointer& inner)
+            :impl(impl), name(name), inner(inner)
+        {}
+        virtual ~Tracker() {}
+        virtual void onFirstConnect(const SharedPV::shared_pointer& pv) OVERRIDE FINAL {
+            if(std::tr1::shared_ptr<Impl> I = impl.lock())
+                I->used(name, pv.get(), true);
+            if(inner)
+                inner->onFirstConnect(pv);
+        }
+        virtual void onLastDisconnect(const SharedPV::shared_pointer& pv) OVERRIDE FINAL {
+            if(inner)
+                inner->onLastDisconnect(pv);
+            if(std::tr1::shared_ptr<Impl> I = impl.lock())
+                I->used(name, pv.get(), false);
+        }
+        virtual void onPut(const SharedPV::shared_pointer& pv, Operation& op) OVERRIDE FINAL {
+            if(inner)
+                inner->onPut(pv, op);
+        }
+        virtual void onRPC(const SharedPV::shared_pointer& pv, Operation& op) OVERRIDE FINAL {
+            if(inner)
+                inner->onRPC(pv, op);
+        }
+    };
+
+    const LazyProvider::Handler::shared_pointer handler;
+    const Config conf;
+
+    mutable epicsMutex mutex;
+    entries_t entries;
+    idle_t idle;
+    size_t idleBytes, inuse, created, evicted;
+
+    pvd::Timer timer;
+    std::tr1::shared_ptr<Sweeper> sweeper;
+
+    Impl(const LazyProvider::Handler::shared_pointer& handler, const Config& conf)
+        :handler(handler)
+        ,conf(conf)
+        ,idleBytes(0u)
+        ,inuse(0u)
+        ,created(0u)
+        ,evicted(0u)
+        ,timer("pvas lazy", pvd::lowPriority)
+        ,sweeper(new Sweeper)
+    {}
+    virtual ~Impl() {}
+
+    // find, or materialize, with the mutex not held.  NULL if refused
+    SharedPV::shared_pointer lookup(const std::string& name)
+    {
+        {
+            Guard G(mutex);
+            entries_t::const_iterator it(entries.find(name));
+            if(it!=entries.end())
+                return it->second.pv;
+        }
+
+        // the handler may take a while, eg. to open() the PV
+        SharedPV::shared_pointer pv(handler->materialize(name));
+        if(!pv)
+            return pv;
+        pv->setHandler(SharedPV::Handler::shared_pointer(new Tracker(shared_from_this(), name, pv->getHandler())));
+
+        Guard G(mutex);
+        std::pair<entries_t::iterator, bool> ins(entries.insert(std::make_pair(name, Entry())));
+        if(!ins.second)
+            return ins.first->second.pv; // materialized concurrently.  ours is unused
+
+        Entry& ent = ins.first->second;
+        ent.pv = pv;
+        // idle until connected
+        ent.inuse = false;
+        ent.idleSince = epicsTime::getCurrent();
+        ent.bytes = 0u;
+        ent.pos = idle.insert(idle.end(), name);
+        created++;
+        return pv;
+    }
+
+    void used(const std::string& name, SharedPV* pv, bool u)
+    {
+        // measured before locking, as it locks the PV
+        const size_t bytes = u ? 0u : pv->memoryUsage();
+
+        Guard G(mutex);
+        entries_t::iterator it(entries.find(name));
+        if(it==entries.end() || it->second.pv.get()!=pv || it->second.inuse==u)
+            return; // evicted, and perhaps replaced
+
+        Entry& ent = it->second;
+        ent.inuse = u;
+        if(u) {
+            idle.erase(ent.pos);
+            idleBytes -= ent.bytes;
+            ent.bytes = 0u;
+            inuse++;
+        } else {
+            ent.idleSince = epicsTime::getCurrent();
+            ent.bytes = bytes;
+            idleBytes += bytes;
+            ent.pos = idle.insert(idle.end(), name);
+            inuse--;
+        }
+    }
+
+    virtual void hasChannels(search_type& names) OVERRIDE FINAL
+    {
+        for(search_type::iterator it(names.begin()), end(names.end()); it!=end; ++it) {
+            if(it->claimed())
+                continue;
+            bool have;
+            {
+                Guard G(mutex);
+                have = entries.find(it->name())!=entries.end();
+            }
+            if(have || handler->hasChannel(it->name()))
+                it->claim();
+        }
+    }
+
+    virtual void listChannels(names_type& names, bool& dynamic) OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        names.reserve(entries.size());
+        for(entries_t::const_iterator it(entries.begin()), end(entries.end()); it!=end; ++it)
+            names.push_back(it->first);
+        dynamic = true;
+    }
+
+    virtual std::tr1::shared_ptr<pva::Channel> createChannel(const std::tr1::shared_ptr<pva::ChannelProvider>& provider,
+                                                             const std::string& name,
+                                                             const std::tr1::shared_ptr<pva::ChannelRequester>& requester) OVERRIDE FINAL
+    {
+        SharedPV::shared_pointer pv(lookup(name));
+        if(!pv)
+            return std::tr1::shared_ptr<pva::Channel>(); // not ours
+        return pv->connect(provider, name, requester);
+    }
+
+    virtual void destroy() OVERRIDE FINAL
+    {
+        entries_t temp;
+        {
+            Guard G(mutex);
+            idle.clear();
+            temp.swap(entries);
+            idleBytes = inuse = 0u;
+        }
+        for(entries_t::const_iterator it(temp.begin()), end(temp.end()); it!=end; ++it)
+            it->second.pv->close(true);
+    }
+
+    // with the mutex held
+    const Entry& oldest() const
+    {
+        return entries.find(idle.front())->second;
+    }
+
+    // with the mutex held
+    void evictOldest(std::vector<std::pair<std::string, SharedPV::shared_pointer> >& out)
+    {
+        entries_t::iterator it(entries.find(idle.front()));
+        idle.pop_front();
+        idleBytes -= it->second.bytes;
+        out.push_back(std::make_pair(it->first, it->second.pv));
+        entries.erase(it);
+        evicted++;
+    }
+
+    void sweep()
+    {
+        const epicsTime now(epicsTime::getCurrent());
+        std::vector<std::pair<std::string, SharedPV::shared_pointer> > out;
+        {
+            Guard G(mutex);
+            // held too long, sparing the warm pool
+            while(idle.size() > conf.warmPool && now - oldest().idleSince >= conf.idleHold)
+                evictOldest(out);
+            // over budget, however recent
+            while(conf.maxBytes && idleBytes > conf.maxBytes && !idle.empty())
+                evictOldest(out);
+        }
+        // released after, without the mutex
+        for(size_t i=0; i<out.size(); i++)
+            handler->evict(out[i].first, out[i].second);
+    }
+};
+
+LazyProvider::Config::Config()
+    :idleHold(30.0)
+    ,warmPool(0u)
+    ,maxBytes(0u)
+{}
+
+LazyProvider::LazyProvider(const std::string& name,
+                           const Handler::shared_pointer& handler,
+                           const Config& conf)
+    :impl(new Impl(handler, conf))
+    ,dynamic(name, impl)
+{
+    if(!handler)
+        throw std::invalid_argument("LazyProvider needs a Handler");
+    impl->sweeper->impl = impl;
+    const double period = std::max(1.0, conf.idleHold/2.0);
+    impl->timer.schedulePeriodic(impl->sweeper, period, period);
+}
+
+// then dynamic calls Impl::destroy()
+LazyProvider::~LazyProvider()
+{
+    impl->timer.cancel(impl->sweeper);
+}
+
+std::tr1::shared_ptr<epics::pvAccess::ChannelProvider> LazyProvider::provider() const
+{
+    return dynamic.provider();
+}
+
+void LazyProvider::sweep()
+{
+    impl->sweep();
+}
+
+void LazyProvider::getStats(Stats& out) const
+{
+    Guard G(impl->mutex);
+    out.materialized = impl->entries.size();
+    out.inuse = impl->inuse;
+    out.idleBytes = impl->idleBytes;
+    out.created = impl->created;
+    out.evicted = impl->evicted;
+}
+
+} // namespace pvas
@@ -0,0 +1,236 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <stdexcept>
+#include <sstream>
+#include <math.h>
+
+#include <epicsGuard.h>
+#include <epicsStdlib.h>
+
+#define epicsExportSharedSymbols
+#include <pv/monitorFilter.h>
+#include <pv/logger.h>
+
+namespace pvd = epics::pvData;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+
+MonitorFilter::~MonitorFilter() {}
+
+MonitorFilterPlugin::~MonitorFilterPlugin() {}
+
+namespace {
+
+double parseDouble(const std::string& s)
+{
+    double ret;
+    if(s.empty() || epicsParseDouble(s.c_str(), &ret, 0))
+        throw std::runtime_error("Not a number: "+s);
+    return ret;
+}
+
+long parseLong(const std::string& s)
+{
+    long ret;
+    if(s.empty() || epicsParseLong(s.c_str(), &ret, 0, 0))
+        throw std::runtime_error("Not an integer: "+s);
+    return ret;
+}
+
+// the field, or a structure containing it, changed
+bool isChanged(const pvd::BitSet& changed, const pvd::PVField* field)
+{
+    for(; field; field = field->getParent()) {
+        if(changed.get(field->getFieldOffset()))
+            return true;
+    }
+    return false;
+}
+
+struct DeadbandFilter : public MonitorFilter
+{
+    const pvd::PVScalarPtr field;
+    const bool relative;
+    const double delta;
+    double last;
+    bool first;
+
+    DeadbandFilter(const pvd::PVScalarPtr& field, bool relative, double delta)
+        :field(field), relative(relative), delta(delta)
+        ,last(0.0), first(true)
+    {}
+    virtual ~DeadbandFilter() {}
+
+    virtual bool filter(const pvd::BitSet& changed) OVERRIDE FINAL
+    {
+        if(first || !isChanged(changed, field.get()))
+            return true;
+        const double threshold = relative ? fabs(last)*delta/100.0 : delta;
+        return fabs(field->getAs<double>() - last) > threshold;
+    }
+
+    virtual void sending() OVERRIDE FINAL
+    {
+        last = field->getAs<double>();
+        first = false;
+    }
+};
+
+struct DeadbandPlugin : public MonitorFilterPlugin
+{
+    virtual ~DeadbandPlugin() {}
+    virtual std::string getId() const OVERRIDE FINAL { return "deadband"; }
+    virtual MonitorFilter::shared_pointer create(const std::string& arg,
+                                                 const pvd::PVFieldPtr& field) OVERRIDE FINAL
+    {
+        pvd::PVScalarPtr scalar(std::tr1::dynamic_pointer_cast<pvd::PVScalar>(field));
+        if(!scalar || !pvd::ScalarTypeFunc::isNumeric(scalar->getScalar()->getScalarType()))
+            throw std::runtime_error("deadband applies to numeric scalar fields");
+
+        size_t sep = arg.find(':');
+        std::string mode(sep==std::string::npos ? std::string("abs") : arg.substr(0, sep));
+        double delta = parseDouble(sep==std::string::npos ? arg : arg.substr(sep+1));
+        if(mode!="abs" && mode!="rel")
+            throw std::runtime_error("deadband expects abs:X or rel:X, not "+arg);
+        if(delta<0.0)
+            throw std::runtime_error("deadband must not be negative");
+
+        return MonitorFilter::shared_pointer(new DeadbandFilter(scalar, mode=="rel", delta));
+    }
+};
+
+struct DecimateFilter : public MonitorFilter
+{
+    const size_t every;
+    size_t count;
+
+    explicit DecimateFilter(size_t every) :every(every), count(0u) {}
+    virtual ~DecimateFilter() {}
+
+    virtual bool filter(const pvd::BitSet&) OVERRIDE FINAL
+    {
+        // the first update passes
+        return count++ % every == 0u;
+    }
+};
+
+struct DecimatePlugin : public MonitorFilterPlugin
+{
+    virtual ~DecimatePlugin() {}
+    virtual std::string getId() const OVERRIDE FINAL { return "decimate"; }
+    virtual MonitorFilter::shared_pointer create(const std::string& arg,
+                                                 const pvd::PVFieldPtr&) OVERRIDE FINAL
+    {
+        long every = parseLong(arg);
+        if(every<1)
+            throw std::runtime_error("decimate must be at least 1");
+        return MonitorFilter::shared_pointer(new DecimateFilter(size_t(every)));
+    }
+};
+
+struct SubrangeFilter : public MonitorFilter
+{
+    const pvd::PVScalarArrayPtr field;
+    const long start, end;
+    bool dirty;
+
+    SubrangeFilter(const pvd::PVScalarArrayPtr& field, long start, long end)
+        :field(field), start(start), end(end), dirty(false)
+    {}
+    virtual ~SubrangeFilter() {}
+
+    virtual bool filter(const pvd::BitSet& changed) OVERRIDE FINAL
+    {
+        // the whole array was copied in
+        dirty |= isChanged(changed, field.get());
+        return true;
+    }
+
+    virtual void sending() OVERRIDE FINAL
+    {
+        if(!dirty)
+            return;
+        dirty = false;
+
+        pvd::shared_vector<const void> arr;
+        field->getAs(arr);
+
+        // untyped, so in bytes
+        const size_t esize = pvd::ScalarTypeFunc::elementSize(field->getScalarArray()->getElementType());
+        const long len = long(arr.size()/esize);
+        long first = start, last = end<0 ? len+end : end;
+        if(last>=len)
+            last = len-1;
+        if(first>last) {
+            first = 0;
+            last = -1; // empty
+        }
+        arr.slice(size_t(first)*esize, size_t(last-first+1)*esize);
+        field->putFrom(arr);
+    }
+};
+
+struct SubrangePlugin : public MonitorFilterPlugin
+{
+    virtual ~SubrangePlugin() {}
+    virtual std::string getId() const OVERRIDE FINAL { return "subrange"; }
+    virtual MonitorFilter::shared_pointer create(const std::string& arg,
+                                                 const pvd::PVFieldPtr& field) OVERRIDE FINAL
+    {
+        pvd::PVScalarArrayPtr array(std::tr1::dynamic_pointer_cast<pvd::PVScalarArray>(field));
+        if(!array)
+            throw std::runtime_error("subrange applies to scalar array fields");
+
+        size_t sep = arg.find(':');
+        if(sep==std::string::npos)
+            throw std::runtime_error("subrange expects start:end, not "+arg);
+        long start = parseLong(arg.substr(0, sep)),
+             end = parseLong(arg.substr(sep+1));
+        if(start<0)
+            throw std::runtime_error("subrange start must not be negative");
+
+        return MonitorFilter::shared_pointer(new SubrangeFilter(array, start, end));
+    }
+};
+
+} // namespace
+
+MonitorFilterRegistry::MonitorFilterRegistry()
+{
+    install(MonitorFilterPlugin::shared_pointer(new DeadbandPlugin));
+    install(MonitorFilterPlugin::shared_pointer(new DecimatePlugin));
+    install(MonitorFilterPlugin::shared_pointer(new SubrangePlugin));
+}
+
+MonitorFilterRegistry& MonitorFilterRegistry::instance()
+{
+    static MonitorFilterRegistry thisInstance;
+    return thisInstance;
+}
+
+void MonitorFilterRegistry::install(const MonitorFilterPlugin::shared_pointer& plugin)
+{
+    const std::string name(plugin->getId());
+    {
+        Guard G(mutex);
+        plugins[name] = plugin;
+    }
+    LOG(logLevelDebug, "Monitor filter plug-in '%s' installed.", name.c_str());
+}
+
+MonitorFilterPlugin::shared_pointer MonitorFilterRegistry::find(const std::string& name) const
+{
+    Guard G(mutex);
+    plugins_t::const_iterator it(plugins.find(name));
+    return it==plugins.end() ? MonitorFilterPlugin::shared_pointer() : it->second;
+}
+
+}
+}
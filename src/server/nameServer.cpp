@@ -0,0 +1,269 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string.h>
+
+#include <epicsGuard.h>
+
+#include <pv/pvData.h>
+
+#define epicsExportSharedSymbols
+#include <pv/nameServer.h>
+#include <pv/pvaConstants.h>
+#include <pv/inetAddressUtil.h>
+#include <pv/clientFactory.h>
+#include <pv/configuration.h>
+#include <pv/logger.h>
+#include <pva/client.h>
+
+namespace pvd = epics::pvData;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+// seconds to wait for a channel list
+const double listTimeout = 5.0;
+}
+
+struct NameServer::Server {
+    // as registered
+    std::string name;
+    osiSockAddr address;
+    // from the last poll
+    std::vector<std::string> names;
+    bool reachable;
+};
+
+struct NameServer::Client {
+    pvac::ClientProvider provider;
+    // by the name of the Server
+    typedef std::map<std::string, pvac::ClientChannel> channels_t;
+    channels_t channels;
+    pvd::PVStructure::shared_pointer args;
+
+    Client()
+    {
+        ClientFactory::start();
+        // only connect to the registered servers, which are never searched for,
+        // and don't send our own searches to any other name server
+        provider = pvac::ClientProvider("pva", ConfigurationBuilder()
+                                        .push_env()
+                                        .add("EPICS_PVA_AUTO_ADDR_LIST", "NO")
+                                        .add("EPICS_PVA_ADDR_LIST", "")
+                                        .add("EPICS_PVA_NAME_SERVERS", "")
+                                        .push_map()
+                                        .build());
+
+        args = pvd::getPVDataCreate()->createPVStructure(pvd::getFieldCreate()->createFieldBuilder()
+                                                         ->add("op", pvd::pvString)
+                                                         ->createStructure());
+        args->getSubFieldT<pvd::PVString>("op")->put("channels");
+    }
+};
+
+NameServer::NameServer(double pollPeriod)
+    :pollPeriod(pollPeriod)
+    ,running(false)
+    ,worker(*this, "PVAS-names",
+            epicsThreadGetStackSize(epicsThreadStackSmall),
+            epicsThreadPriorityLow)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+NameServer::~NameServer()
+{
+    stop();
+}
+
+bool NameServer::addServer(const std::string& address)
+{
+    InetAddrVector addrs;
+    getSocketAddressList(addrs, address, PVA_SERVER_PORT);
+    if(addrs.empty())
+        return false;
+
+    std::tr1::shared_ptr<Server> srv(new Server);
+    srv->name = address;
+    srv->address = addrs[0];
+    srv->reachable = false;
+
+    {
+        Guard G(mutex);
+        for(size_t i=0; i<servers.size(); i++) {
+            if(sockAddrAreIdentical(&servers[i]->address, &srv->address))
+                return false;
+        }
+        servers.push_back(srv);
+        stats.servers = servers.size();
+    }
+
+    // fetch the new list now
+    wakeup.signal();
+    return true;
+}
+
+void NameServer::removeServer(const std::string& address)
+{
+    Guard G(mutex);
+
+    for(size_t i=0; i<servers.size(); i++) {
+        if(servers[i]->name!=address)
+            continue;
+
+        for(names_t::iterator it(names.begin()); it!=names.end(); ) {
+            if(it->second==servers[i])
+                names.erase(it++);
+            else
+                ++it;
+        }
+        servers.erase(servers.begin()+i);
+        stats.servers = servers.size();
+        stats.names = names.size();
+        break;
+    }
+}
+
+bool NameServer::find(const std::string& name, ServerGUID& guid, osiSockAddr& address)
+{
+    Guard G(mutex);
+
+    stats.lookups++;
+    names_t::const_iterator it(names.find(name));
+    if(it==names.end())
+        return false;
+
+    stats.hits++;
+    // the GUID of the hosting server isn't known here
+    memset(guid.value, 0, sizeof(guid.value));
+    address = it->second->address;
+    return true;
+}
+
+void NameServer::start()
+{
+    {
+        Guard G(mutex);
+        if(running)
+            return;
+        running = true;
+    }
+    worker.start();
+}
+
+void NameServer::stop()
+{
+    {
+        Guard G(mutex);
+        if(!running)
+            return;
+        running = false;
+    }
+    wakeup.signal();
+    worker.exitWait();
+}
+
+void NameServer::poll()
+{
+    wakeup.signal();
+}
+
+void NameServer::getStats(Stats& out) const
+{
+    Guard G(mutex);
+    out = stats;
+}
+
+void NameServer::run()
+{
+    Client client;
+
+    while(true) {
+        {
+            Guard G(mutex);
+            if(!running)
+                break;
+        }
+
+        update(client);
+
+        wakeup.wait(pollPeriod);
+    }
+}
+
+void NameServer::update(Client& client)
+{
+    std::vector<std::tr1::shared_ptr<Server> > todo;
+    {
+        Guard G(mutex);
+        todo = servers;
+    }
+
+    for(size_t i=0; i<todo.size(); i++) {
+        Server& srv = *todo[i];
+
+        std::vector<std::string> list;
+        bool ok = false;
+
+        try {
+            Client::channels_t::iterator it(client.channels.find(srv.name));
+            if(it==client.channels.end()) {
+                // the "server" channel of any pvAccess server, over one persistent connection
+                pvac::ClientChannel::Options opts;
+                opts.address = inetAddressToString(srv.address);
+                it = client.channels.insert(std::make_pair(srv.name, client.provider.connect("server", opts))).first;
+            }
+
+            pvd::PVStructure::const_shared_pointer ret(it->second.rpc(listTimeout, client.args));
+            pvd::PVStringArray::const_shared_pointer value(ret->getSubField<pvd::PVStringArray>("value"));
+            if(value) {
+                pvd::PVStringArray::const_svector listed(value->view());
+                list.assign(listed.begin(), listed.end());
+                ok = true;
+            }
+        } catch(std::exception& e) {
+            LOG(logLevelDebug, "Name server can't list the channels of %s: %s", srv.name.c_str(), e.what());
+        }
+
+        Guard G(mutex);
+        // clients are not sent to a server which doesn't answer
+        srv.names.swap(list);
+        srv.reachable = ok;
+    }
+
+    Guard G(mutex);
+
+    // channels of servers removed since
+    for(Client::channels_t::iterator it(client.channels.begin()); it!=client.channels.end(); ) {
+        bool found = false;
+        for(size_t i=0; i<servers.size() && !found; i++)
+            found = servers[i]->name==it->first;
+        if(found)
+            ++it;
+        else
+            client.channels.erase(it++);
+    }
+
+    names_t fresh;
+    size_t reachable = 0;
+    for(size_t i=0; i<servers.size(); i++) {
+        const std::tr1::shared_ptr<Server>& srv = servers[i];
+        if(srv->reachable)
+            reachable++;
+        for(size_t n=0; n<srv->names.size(); n++)
+            fresh.insert(std::make_pair(srv->names[n], srv));
+    }
+    names.swap(fresh);
+
+    stats.reachable = reachable;
+    stats.names = names.size();
+}
+
+}
+}
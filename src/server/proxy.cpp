@@ -0,0 +1,503 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsTime.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_PROXY_USE_ATOMIC
+#endif
+#endif
+
+#include <shareLib.h>
+#include <pv/sharedPtr.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/status.h>
+#include <pv/timer.h>
+
+#define epicsExportSharedSymbols
+#include "sharedstateimpl.h"
+#include "pva/proxy.h"
+
+namespace {
+
+struct Counters {
+    size_t updates, forwarded;
+    Counters() :updates(0u), forwarded(0u) {}
+
+#ifdef PVA_PROXY_USE_ATOMIC
+    void increment(size_t& counter) { epicsAtomicIncrSizeT(&counter); }
+    size_t get(size_t& counter) { return epicsAtomicGetSizeT(&counter); }
+#else
+    epicsMutex mutex;
+    void increment(size_t& counter) { epicsGuard<epicsMutex> G(mutex); counter++; }
+    size_t get(size_t& counter) { epicsGuard<epicsMutex> G(mutex); return counter; }
+#endif
+};
+
+// Put of a downstream client, made upstream.  Owns itself until putDone()
+struct PutForward : public pvac::ClientChannel::PutCallback
+{
+    pvas::Operation op;
+    pvac::Operation upstream;
+    std::tr1::shared_ptr<PutForward> self;
+
+    explicit PutForward(const pvas::Operation& op) :op(op) {}
+    virtual ~PutForward() {}
+
+    virtual void putBuild(const pvd::StructureConstPtr& build, Args& args) OVERRIDE FINAL
+    {
+        const pvd::PVStructure& value = op.value();
+        if(*build != *value.getStructure())
+            throw std::runtime_error("Upstream type has changed");
+        pvd::PVStructurePtr root(pvd::getPVDataCreate()->createPVStructure(build));
+        root->copyUnchecked(value, op.changed());
+        args.root = root;
+        args.tosend = op.changed();
+    }
+
+    virtual void putDone(const pvac::PutEvent& evt) OVERRIDE FINAL
+    {
+        // released on return
+        std::tr1::shared_ptr<PutForward> keep;
+        keep.swap(self);
+        switch(evt.event) {
+        case pvac::PutEvent::Success: op.complete(); break;
+        case pvac::PutEvent::Fail:    op.complete(pvd::Status::error(evt.message)); break;
+        case pvac::PutEvent::Cancel:  op.complete(pvd::Status::error("Cancelled upstream")); break;
+        }
+    }
+};
+
+// RPC of a downstream client, made upstream.  Owns itself until getDone()
+struct RPCForward : public pvac::ClientChannel::GetCallback
+{
+    pvas::Operation op;
+    pvac::Operation upstream;
+    std::tr1::shared_ptr<RPCForward> self;
+
+    explicit RPCForward(const pvas::Operation& op) :op(op) {}
+    virtual ~RPCForward() {}
+
+    virtual void getDone(const pvac::GetEvent& evt) OVERRIDE FINAL
+    {
+        std::tr1::shared_ptr<RPCForward> keep;
+        keep.swap(self);
+        switch(evt.event) {
+        case pvac::GetEvent::Success:
+            if(evt.value)
+                op.complete(*evt.value, pvd::BitSet().set(0));
+            else
+                op.complete();
+            break;
+        case pvac::GetEvent::Fail:   op.complete(pvd::Status::error(evt.message)); break;
+        case pvac::GetEvent::Cancel: op.complete(pvd::Status::error("Cancelled upstream")); break;
+        }
+    }
+};
+
+} // namespace
+
+namespace pvas {
+
+/* One upstream subscription, feeding the SharedPV to which downstream channels
+ * of its name connect.
+ */
+struct Upstream : public pvac::ClientChannel::MonitorCallback,
+                  public std::tr1::enable_shared_from_this<Upstream>
+{
+    // refers back without a cycle, as the SharedPV keeps its Handler
+    struct PVHandler : public SharedPV::Handler {
+        std::tr1::weak_ptr<Upstream> upstream;
+        virtual ~PVHandler() {}
+        virtual void onFirstConnect(const SharedPV::shared_pointer&) OVERRIDE FINAL {
+            if(std::tr1::shared_ptr<Upstream> up = upstream.lock())
+                up->used(true);
+        }
+        virtual void onLastDisconnect(const SharedPV::shared_pointer&) OVERRIDE FINAL {
+            if(std::tr1::shared_ptr<Upstream> up = upstream.lock())
+                up->used(false);
+        }
+        virtual void onPut(const SharedPV::shared_pointer&, Operation& op) OVERRIDE FINAL {
+            if(std::tr1::shared_ptr<Upstream> up = upstream.lock())
+                up->put(op);
+            else
+                op.complete(pvd::Status::error("Proxy closed"));
+        }
+        virtual void onRPC(const SharedPV::shared_pointer&, Operation& op) OVERRIDE FINAL {
+            if(std::tr1::shared_ptr<Upstream> up = upstream.lock())
+                up->rpc(op);
+            else
+                op.complete(pvd::Status::error("Proxy closed"));
+        }
+    };
+
+    const std::string name;
+    const bool readOnly;
+    const std::tr1::shared_ptr<Counters> counters;
+    const SharedPV::shared_pointer pv; // const after build()
+
+    mutable epicsMutex mutex;
+    pvac::ClientChannel chan;
+    pvac::Monitor mon;
+    // downstream channels connected, or since when none
+    bool inuse;
+    // subscription ended with an error, and will not resume
+    bool failed;
+    epicsTime idleSince;
+
+    // held while posting, so that updates, and close(), are made in order
+    epicsMutex drainLock;
+    // Guarded by drainLock.  A copy of mon, whose root is kept from one update to the next
+    pvac::Monitor polled;
+    // of the value open()'d
+    pvd::StructureConstPtr type;
+
+    static std::tr1::shared_ptr<Upstream> build(const std::string& name,
+                                                bool readOnly,
+                                                const std::tr1::shared_ptr<Counters>& counters)
+    {
+        std::tr1::shared_ptr<PVHandler> handler(new PVHandler);
+        std::tr1::shared_ptr<Upstream> ret(new Upstream(name, readOnly, counters, SharedPV::build(handler)));
+        handler->upstream = ret;
+        return ret;
+    }
+
+    Upstream(const std::string& name,
+             bool readOnly,
+             const std::tr1::shared_ptr<Counters>& counters,
+             const SharedPV::shared_pointer& pv)
+        :name(name)
+        ,readOnly(readOnly)
+        ,counters(counters)
+        ,pv(pv)
+        ,inuse(false)
+        ,failed(false)
+        ,idleSince(epicsTime::getCurrent())
+    {}
+    virtual ~Upstream() {
+        mon.cancel();
+    }
+
+    // subscribe to the whole structure, which all downstream pvRequests select from
+    void start(pvac::ClientProvider upstream)
+    {
+        pvac::ClientChannel C(upstream.connect(name));
+        pvac::Monitor M(C.monitor(this));
+        {
+            Guard G(mutex);
+            chan = C;
+            mon = M;
+        }
+        // an update before mon was set is found now
+        drain();
+    }
+
+    void close()
+    {
+        pvac::Monitor M;
+        {
+            Guard G(mutex);
+            M = mon;
+        }
+        M.cancel();
+        Guard D(drainLock);
+        pv->close(true);
+    }
+
+    void used(bool u)
+    {
+        Guard G(mutex);
+        inuse = u;
+        if(!u)
+            idleSince = epicsTime::getCurrent();
+    }
+
+    // an unused subscription may go after idleHold, a failed one at once
+    bool expired(const epicsTime& now, double idleHold) const
+    {
+        Guard G(mutex);
+        return failed || (!inuse && now - idleSince >= idleHold);
+    }
+
+    void drain()
+    {
+        Guard D(drainLock);
+        if(!polled) {
+            Guard G(mutex);
+            polled = mon;
+        }
+        while(polled.poll()) {
+            counters->increment(counters->updates);
+            const pvd::PVStructure& root = *polled.root;
+            if(!pv->isOpen() || type!=root.getStructure()) {
+                // first update, or first after reconnecting with a different type
+                pv->close();
+                pv->open(root, polled.changed);
+                type = root.getStructure();
+            } else {
+                pv->post(root, polled.changed);
+            }
+        }
+    }
+
+    virtual void monitorEvent(const pvac::MonitorEvent& evt) OVERRIDE FINAL
+    {
+        switch(evt.event) {
+        case pvac::MonitorEvent::Data:
+            drain();
+            break;
+        case pvac::MonitorEvent::Fail:
+            {
+                Guard G(mutex);
+                failed = true;
+            }
+            // fall through
+        case pvac::MonitorEvent::Disconnect:
+            {
+                // downstream channels disconnect, then see the next open()
+                Guard D(drainLock);
+                pv->close();
+            }
+            break;
+        case pvac::MonitorEvent::Cancel:
+            break;
+        }
+    }
+
+    void put(Operation& op)
+    {
+        if(readOnly) {
+            op.complete(pvd::Status::error("Read only"));
+            return;
+        }
+        pvac::ClientChannel C;
+        {
+            Guard G(mutex);
+            C = chan;
+        }
+        std::tr1::shared_ptr<PutForward> fwd(new PutForward(op));
+        fwd->self = fwd;
+        try {
+            fwd->upstream = C.put(fwd.get());
+            counters->increment(counters->forwarded);
+        }catch(std::exception& e){
+            fwd->self.reset();
+            op.complete(pvd::Status::error(e.what()));
+        }
+    }
+
+    void rpc(Operation& op)
+    {
+        if(readOnly) {
+            op.complete(pvd::Status::error("Read only"));
+            return;
+        }
+        pvac::ClientChannel C;
+        {
+            Guard G(mutex);
+            C = chan;
+        }
+        // the arguments, and pvRequest, are only valid until complete(), so copied
+        pvd::PVStructurePtr args(pvd::getPVDataCreate()->createPVStructure(op.value().getStructure())),
+                            request(pvd::getPVDataCreate()->createPVStructure(op.pvRequest().getStructure()));
+        args->copyUnchecked(op.value());
+        request->copyUnchecked(op.pvRequest());
+
+        std::tr1::shared_ptr<RPCForward> fwd(new RPCForward(op));
+        fwd->self = fwd;
+        try {
+            fwd->upstream = C.rpc(fwd.get(), args, request);
+            counters->increment(counters->forwarded);
+        }catch(std::exception& e){
+            fwd->self.reset();
+            op.complete(pvd::Status::error(e.what()));
+        }
+    }
+};
+
+struct ProxyProvider::Impl : public DynamicProvider::Handler
+{
+    struct Sweeper : public pvd::TimerCallback {
+        std::tr1::weak_ptr<Impl> impl;
+        virtual ~Sweeper() {}
+        virtual void callback() OVERRIDE FINAL {
+            if(std::tr1::shared_ptr<Impl> I = impl.lock())
+                I->sweep();
+        }
+        virtual void timerStopped() OVERRIDE FINAL {}
+    };
+
+    typedef std::map<std::string, std::tr1::shared_ptr<Upstream> > upstreams_t;
+
+    pvac::ClientProvider upstream;
+    const Config conf;
+    const std::tr1::shared_ptr<Counters> counters;
+
+    mutable epicsMutex mutex;
+    upstreams_t upstreams;
+
+    pvd::Timer timer;
+    std::tr1::shared_ptr<Sweeper> sweeper;
+
+    Impl(const pvac::ClientProvider& upstream, const Config& conf)
+        :upstream(upstream)
+        ,conf(conf)
+        ,counters(new Counters)
+        ,timer("pvas proxy", pvd::lowPriority)
+        ,sweeper(new Sweeper)
+    {}
+    virtual ~Impl() {}
+
+    // find, or subscribe, with the mutex not held
+    std::tr1::shared_ptr<Upstream> lookup(const std::string& name)
+    {
+        std::tr1::shared_ptr<Upstream> ret;
+        {
+            Guard G(mutex);
+            upstreams_t::const_iterator it(upstreams.find(name));
+            if(it!=upstreams.end())
+                return it->second;
+
+            ret = Upstream::build(name, conf.readOnly, counters);
+            upstreams[name] = ret;
+        }
+        try {
+            ret->start(upstream);
+        }catch(...){
+            Guard G(mutex);
+            upstreams.erase(name);
+            throw;
+        }
+        return ret;
+    }
+
+    virtual void hasChannels(search_type& names) OVERRIDE FINAL
+    {
+        for(search_type::iterator it(names.begin()), end(names.end()); it!=end; ++it) {
+            if(it->claimed())
+                continue;
+            try {
+                if(lookup(it->name())->pv->isOpen())
+                    it->claim();
+            }catch(std::exception&){
+                // refused upstream, eg. an invalid name.  not ours
+            }
+        }
+    }
+
+    virtual void listChannels(names_type& names, bool& dynamic) OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        names.reserve(upstreams.size());
+        for(upstreams_t::const_iterator it(upstreams.begin()), end(upstreams.end()); it!=end; ++it) {
+            if(it->second->pv->isOpen())
+                names.push_back(it->first);
+        }
+        dynamic = true;
+    }
+
+    virtual std::tr1::shared_ptr<pva::Channel> createChannel(const std::tr1::shared_ptr<pva::ChannelProvider>& provider,
+                                                             const std::string& name,
+                                                             const std::tr1::shared_ptr<pva::ChannelRequester>& requester) OVERRIDE FINAL
+    {
+        // waits for the upstream value, if not yet received
+        return lookup(name)->pv->connect(provider, name, requester);
+    }
+
+    virtual void destroy() OVERRIDE FINAL
+    {
+        upstreams_t temp;
+        {
+            Guard G(mutex);
+            temp.swap(upstreams);
+        }
+        for(upstreams_t::const_iterator it(temp.begin()), end(temp.end()); it!=end; ++it)
+            it->second->close();
+    }
+
+    void sweep()
+    {
+        const epicsTime now(epicsTime::getCurrent());
+        std::vector<std::tr1::shared_ptr<Upstream> > expired;
+        {
+            Guard G(mutex);
+            for(upstreams_t::iterator it(upstreams.begin()), end(upstreams.end()); it!=end; ) {
+                if(it->second->expired(now, conf.idleHold)) {
+                    expired.push_back(it->second);
+                    upstreams.erase(it++);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        // closes any downstream channels of a failed subscription, which search again
+        for(size_t i=0; i<expired.size(); i++)
+            expired[i]->close();
+    }
+};
+
+ProxyProvider::Config::Config()
+    :idleHold(30.0)
+    ,readOnly(false)
+{}
+
+ProxyProvider::ProxyProvider(const std::string& name,
+                             const pvac::ClientProvider& upstream,
+                             const Config& conf)
+    :impl(new Impl(upstream, conf))
+    ,dynamic(name, impl)
+{
+    impl->sweeper->impl = impl;
+    const double period = std::max(1.0, conf.idleHold/2.0);
+    impl->timer.schedulePeriodic(impl->sweeper, period, period);
+}
+
+// then dynamic calls Impl::destroy()
+ProxyProvider::~ProxyProvider()
+{
+    impl->timer.cancel(impl->sweeper);
+}
+
+std::tr1::shared_ptr<epics::pvAccess::ChannelProvider> ProxyProvider::provider() const
+{
+    return dynamic.provider();
+}
+
+void ProxyProvider::sweep()
+{
+    impl->sweep();
+}
+
+void ProxyProvider::getStats(Stats& out) const
+{
+    out.upstream = out.connected = out.inuse = 0u;
+    {
+        Guard G(impl->mutex);
+        out.upstream = impl->upstreams.size();
+        for(Impl::upstreams_t::const_iterator it(impl->upstreams.begin()), end(impl->upstreams.end()); it!=end; ++it) {
+            const Upstream& up = *it->second;
+            if(up.pv->isOpen())
+                out.connected++;
+            Guard U(up.mutex);
+            if(up.inuse)
+                out.inuse++;
+        }
+    }
+    out.updates = impl->counters->get(impl->counters->updates);
+    out.forwarded = impl->counters->get(impl->counters->forwarded);
+}
+
+} // namespace pvas
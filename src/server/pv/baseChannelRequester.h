@@ -7,6 +7,8 @@
 #ifndef BASECHANNELREQUESTER_H_
 #define BASECHANNELREQUESTER_H_
 
+#include <deque>
+
 #include <pv/requester.h>
 #include <pv/destroyable.h>
 #include <pv/serverContextImpl.h>
@@ -26,11 +28,48 @@ public:
                          const pvAccessID ioid, Transport::shared_pointer const & transport);
     virtual ~BaseChannelRequester() {};
 
+    //! Fails while a request is pending, or queued
     bool startRequest(epics::pvData::int32 qos);
-    void stopRequest();
+    //! A pipelined request may be queued behind the pending one, within the window of the connection
+    bool canQueueRequest();
+    //! From the receive thread, after canQueueRequest().  Started by startQueued(), in the order received.
+    void queueRequest(epics::pvData::int32 qos);
+    //! Start the oldest queued request, unless one is pending.  @returns false if none was started
+    bool startQueued(epics::pvData::int32& qos);
+    void clearQueued();
+    //! With the CMD_* of the reply, counts the time since startRequest() in the ServerStats of the context,
+    //! and records the span of a traced request
+    void stopRequest(epics::pvData::int8 command = -1);
+    /** From the receive thread, before the request is passed to the provider.
+     * Starts a span if the request was preceded by a trace context.
+     * With receive timestamps, notes when the request was dispatched, for stopRequest().
+     * @returns true with the context of the span, which the caller makes current while calling the provider.
+     */
+    bool traceDispatch(TraceContext& context);
+    //! From send(), ahead of the response.  Tells the peer the span of a traced request.
+    void traceSend(epics::pvData::ByteBuffer* buffer, TransportSendControl* control);
     epics::pvData::int32 getPendingRequest();
+    /** Queue the provider call of a request on pool.  The Work queued for the request before is
+     * queued again while it equals work, instead of allocating a copy for each request.
+     * W is immutable, and comparable with operator==, as it may be queued again while still queued or running.
+     */
+    template<typename W>
+    void queueWork(RequestPool& pool, const W& work)
+    {
+        RequestPool::Work::shared_pointer queued;
+        {
+            epics::pvData::Lock guard(_mutex);
+            const W *last = dynamic_cast<const W*>(_work.get());
+            if (!last || !(*last==work))
+                _work.reset(new W(work));
+            queued = _work;
+        }
+        pool.queue(_channel.get(), _ioid, queued);
+    }
     //! The Operation associated with this Requester, except for GetField and Monitor (which are special snowflakes...)
     virtual std::tr1::shared_ptr<ChannelRequest> getOperation() =0;
+    //! Approximate heap bytes held for this request, eg. queued updates.  see epics::pvAccess::memoryUsage()
+    virtual size_t memoryUsage() { return 0u; }
     virtual std::string getRequesterName() OVERRIDE FINAL;
     virtual void message(std::string const & message, epics::pvData::MessageType messageType) OVERRIDE FINAL;
     static void message(Transport::shared_pointer const & transport, const pvAccessID ioid, const std::string message, const epics::pvData::MessageType messageType);
@@ -49,10 +88,21 @@ protected:
     const Transport::shared_pointer _transport;
     const std::tr1::shared_ptr<ServerChannel> _channel;
     epics::pvData::Mutex _mutex;
+    const ServerContextImpl::shared_pointer _context;
+    //! Work last queued by queueWork().  Reset by destroy(), as it refers to the operation.
+    RequestPool::Work::shared_pointer _work;
 private:
-    ServerContextImpl::shared_pointer _context;
     static const epics::pvData::int32 NULL_REQUEST;
     epics::pvData::int32 _pendingRequest;
+    // QOS of requests received while another was pending
+    std::deque<epics::pvData::int32> _queued;
+    epicsTimeStamp _requestStart;
+    // set by traceDispatch() with Transport::receivedAt(), until stopRequest()
+    bool _stamped;
+    epicsTimeStamp _dispatchTime;
+    // non-zero while a traced request is in progress.  _span is guarded by _mutex
+    int _traced;
+    Span _span;
 };
 
 class BaseChannelRequesterMessageTransportSender : public TransportSender
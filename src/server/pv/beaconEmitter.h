@@ -25,6 +25,7 @@
 
 #include <pv/remote.h>
 #include <pv/beaconServerStatusProvider.h>
+#include <pv/metrics.h>
 //#include <pv/serverContext.h>
 
 namespace epics {
@@ -92,6 +93,17 @@ private:
      */
     static const float EPICS_PVA_MIN_BEACON_COUNT_LIMIT;
 
+    /**
+     * Beacon periods are randomized by up to this fraction, so that servers
+     * started together do not send their beacons together.
+     */
+    static const double BEACON_PERIOD_JITTER;
+
+    /**
+     * @return a random number in [-1, 1], from a sequence seeded by the GUID and port of this server.
+     */
+    double random();
+
     /**
      * Protocol.
      */
@@ -146,7 +158,17 @@ private:
      *  We will also be queuing ourselves, and be referenced by Timer.
      *  So keep only a weak ref to Timer to avoid possible ref. loop.
      */
-    epics::pvData::Timer::weak_pointer _timer;
+    TimerWheel::weak_pointer _timer;
+
+    /**
+     * State of random().
+     */
+    epics::pvData::uint32 _randomState;
+
+    /**
+     * Beacons sent, a counter of the server context, which outlives the transport sending.
+     */
+    MetricCounter& _beaconsSent;
 };
 
 }
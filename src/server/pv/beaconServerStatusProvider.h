@@ -46,25 +46,39 @@ public:
 
 /**
  * DefaultBeaconServerStatusProvider
+ *
+ * Advertises the load of a server, so that clients may prefer the least loaded
+ * of several servers which have the same channels.  Installed by EPICS_PVAS_BEACON_LOAD=YES.
+ * @code
+ * structure
+ *     int connections     # TCP connections from clients
+ *     double cpu          # process CPU seconds per second, since the last beacon
+ *     int queueDepth      # operations waiting for the request pool
+ * @endcode
  */
 class epicsShareClass DefaultBeaconServerStatusProvider : public BeaconServerStatusProvider
 {
 public:
     /**
      * Constructor.
-     * @param context PVA context.
+     * @param context PVA context.  Not kept alive by this provider.
      */
-//		DefaultBeaconServerStatusProvider(ServerContext::shared_pointer const & context);
     DefaultBeaconServerStatusProvider(std::tr1::shared_ptr<ServerContext> const & context);
     /**
      * Destructor.
      */
     virtual ~DefaultBeaconServerStatusProvider();
 
+    //! Called by the beacon timer
     virtual epics::pvData::PVField::shared_pointer getServerStatusData();
 
 private:
+    const std::tr1::weak_ptr<ServerContext> _context;
     epics::pvData::PVStructure::shared_pointer _status;
+    epics::pvData::PVIntPtr _connections, _queueDepth;
+    epics::pvData::PVDoublePtr _cpu;
+    // previous process CPU and wall clock times, for cpu
+    double _lastCPU, _lastTime;
 };
 
 }
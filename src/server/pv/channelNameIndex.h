@@ -0,0 +1,141 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef CHANNELNAMEINDEX_H
+#define CHANNELNAMEINDEX_H
+
+#include <string>
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define channelNameIndexEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+#include <epicsTime.h>
+
+#include <pv/sharedPtr.h>
+
+#ifdef channelNameIndexEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef channelNameIndexEpicsExportSharedSymbols
+#endif
+
+#include <pv/pvAccess.h>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Hash table of the channel names hosted by the ChannelProviders of one server.
+ *
+ * Names are add()ed by providers implementing ChannelNamePublisher.
+ * A search for one of these is answered from the index, without calling ChannelProvider::channelFind().
+ *
+ * Providers which do not publish are still asked about any other name.
+ * The provider which found a name is then remembered for createChannel.
+ * When none found it, this is remembered for a short time, so repeated searches
+ * for a missing name are answered without asking them again.
+ */
+class epicsShareClass ChannelNameIndex
+{
+public:
+    POINTER_DEFINITIONS(ChannelNameIndex);
+
+    /** @param negativeTimeout Seconds for which addNegative() is remembered.  0 disables.
+     */
+    explicit ChannelNameIndex(double negativeTimeout = 0.0);
+    ~ChannelNameIndex();
+
+    /** Publish a name.  Called by a ChannelNamePublisher.
+     * @returns false if another provider has already published this name.
+     */
+    bool add(const std::string& name, const std::tr1::shared_ptr<ChannelProvider>& provider);
+    /** Publish several names, locking once.
+     * @returns the number added, not counting those already published by another provider.
+     */
+    size_t add(const std::vector<std::string>& names, const std::tr1::shared_ptr<ChannelProvider>& provider);
+    //! Withdraw a name, if it was published by this provider
+    void remove(const std::string& name, const ChannelProvider* provider);
+    //! Withdraw all names published by, or learned from, this provider
+    void removeAll(const ChannelProvider* provider);
+
+    /** Look up the provider of a name.
+     * @param publishedOnly If false, also consider names learn()ed.
+     * @returns NULL if not known.
+     */
+    std::tr1::shared_ptr<ChannelProvider> find(const std::string& name, bool publishedOnly = true);
+
+    //! Remember that a provider which doesn't publish has found this name.
+    void learn(const std::string& name, const std::tr1::shared_ptr<ChannelProvider>& provider);
+    //! Remember that no provider has this name.  Until it is published, or negativeTimeout has passed.
+    void addNegative(const std::string& name);
+
+    enum SearchResult {
+        Unknown,   //!< Not published, and not recently missing
+        Published, //!< Published by a live provider
+        Missing    //!< addNegative() called recently
+    };
+    /** Classify the name of a search request, with a single lookup.  Counted in Stats.
+     */
+    SearchResult search(const std::string& name);
+
+    struct Stats {
+        //! current number of names of each kind
+        size_t published, learned, negative;
+        //! search() results: Published, Missing, and Unknown
+        size_t hits, negativeHits, misses;
+    };
+    void getStats(Stats& out) const;
+
+    struct Entry;
+private:
+    Entry* lookup(const std::string& name, unsigned hash);
+    bool addLocked(const std::string& name, unsigned hash, const std::tr1::shared_ptr<ChannelProvider>& provider);
+    Entry& insert(const std::string& name, unsigned hash);
+    void erase(Entry* ent);
+    void purgeNegative();
+
+    const double negativeTimeout;
+
+    mutable epicsMutex mutex;
+    // number of buckets is a power of two
+    std::vector<std::vector<Entry> > buckets;
+    size_t count;
+    Stats stats;
+
+    ChannelNameIndex(const ChannelNameIndex&);
+    ChannelNameIndex& operator=(const ChannelNameIndex&);
+};
+
+/** @brief Optional interface of a ChannelProvider which knows the complete set of names it hosts.
+ *
+ * A ServerContext checks each of its providers for this interface with dynamic_cast.
+ * When publishNames() returns true, channelFind() is no longer called during searches,
+ * so the provider must keep the index up to date until unpublishNames().
+ *
+ * pvas::StaticProvider implements this.
+ */
+class epicsShareClass ChannelNamePublisher
+{
+public:
+    virtual ~ChannelNamePublisher();
+
+    /** Add all current names to the index, and any later ones, and remove them as they are removed.
+     * An index may be shared by several providers.  A provider may publish to several indexes.
+     * @returns false to be searched with channelFind() instead.
+     */
+    virtual bool publishNames(const ChannelNameIndex::shared_pointer& index) =0;
+    //! Stop updating this index
+    virtual void unpublishNames(const ChannelNameIndex::shared_pointer& index) =0;
+};
+
+}
+}
+
+#endif // CHANNELNAMEINDEX_H
@@ -0,0 +1,122 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef MONITORFILTER_H
+#define MONITORFILTER_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define monitorFilterEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+
+#include <pv/sharedPtr.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+
+#ifdef monitorFilterEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef monitorFilterEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Decides which monitor updates a server sends to one subscriber.
+ *
+ * Created by a MonitorFilterPlugin for one field of a subscription.
+ * Each update from the provider is merged into a copy held by the subscription,
+ * then passed to the filters of that subscription.  An update is sent when all
+ * filters pass it.  Otherwise it is held, and sent merged with the next update
+ * which passes.
+ */
+class epicsShareClass MonitorFilter
+{
+public:
+    POINTER_DEFINITIONS(MonitorFilter);
+    virtual ~MonitorFilter();
+
+    /** Called once for each update from the provider.
+     *
+     * @param changed The fields changed by this update.
+     *                The field of this filter holds the merged, latest, value.
+     * @return false to hold the update.
+     */
+    virtual bool filter(const epics::pvData::BitSet& changed) =0;
+
+    /** Called before a held or passed update is sent.  May modify the field,
+     *  which is not seen by the provider.
+     */
+    virtual void sending() {}
+};
+
+/** @brief Creates MonitorFilter for pvRequest field options.
+ *
+ * eg. the request "field(value[deadband=abs:0.5])" applies the "deadband" plugin
+ * to the "value" field with the argument "abs:0.5".
+ */
+class epicsShareClass MonitorFilterPlugin
+{
+public:
+    POINTER_DEFINITIONS(MonitorFilterPlugin);
+    virtual ~MonitorFilterPlugin();
+
+    //! name of the pvRequest option
+    virtual std::string getId() const =0;
+
+    /** Create a filter for one subscription.
+     *
+     * @param arg Value of the pvRequest option
+     * @param field The field to filter, in the copy held by the subscription
+     * @throws std::exception if arg or field are not suitable.  The message is shown to the client.
+     */
+    virtual MonitorFilter::shared_pointer create(const std::string& arg,
+                                                 const epics::pvData::PVFieldPtr& field) =0;
+};
+
+/** @brief Plugins used by servers.
+ *
+ * Includes "deadband", "decimate", and "subrange" by default.
+ *
+ * @li deadband=abs:X or deadband=rel:X  Scalar numeric fields.  Hold updates unless the
+ *     field has moved by more than X from the value last passed, or by X percent of it.
+ * @li decimate=N  Pass one update in N.
+ * @li subrange=start:end  Array fields.  Send only elements [start, end], inclusive.
+ *     A negative end counts from the last element.
+ */
+class epicsShareClass MonitorFilterRegistry
+{
+public:
+    static MonitorFilterRegistry& instance();
+
+    //! Replaces any plugin with the same getId()
+    void install(const MonitorFilterPlugin::shared_pointer& plugin);
+
+    //! @returns NULL if no plugin is installed with this name
+    MonitorFilterPlugin::shared_pointer find(const std::string& name) const;
+
+private:
+    MonitorFilterRegistry();
+
+    mutable epicsMutex mutex;
+    typedef std::map<std::string, MonitorFilterPlugin::shared_pointer> plugins_t;
+    plugins_t plugins;
+
+    MonitorFilterRegistry(const MonitorFilterRegistry&);
+    MonitorFilterRegistry& operator=(const MonitorFilterRegistry&);
+};
+
+}
+}
+
+#endif // MONITORFILTER_H
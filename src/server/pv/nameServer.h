@@ -0,0 +1,113 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef NAMESERVER_H
+#define NAMESERVER_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#ifdef epicsExportSharedSymbols
+#   define nameServerEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <osiSock.h>
+
+#include <pv/sharedPtr.h>
+
+#ifdef nameServerEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef nameServerEpicsExportSharedSymbols
+#endif
+
+#include <pv/pvaDefs.h>
+#include <pv/pvAccess.h>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Directory of the channels hosted by other servers.
+ *
+ * A ServerContext with a NameServer answers searches, over UDP or TCP, for the names of
+ * the registered servers with the address of the server hosting each name.
+ * Clients then connect to that server directly.
+ *
+ * The channel list of each registered server is fetched with the "channels" operation of
+ * its "server" RPC channel, over one persistent connection, every pollPeriod seconds.
+ *
+ * Configured in a ServerContext by EPICS_PVAS_NAME_SERVER_LIST and EPICS_PVAS_NAME_SERVER_POLL.
+ */
+class epicsShareClass NameServer : public epicsThreadRunable
+{
+public:
+    POINTER_DEFINITIONS(NameServer);
+
+    explicit NameServer(double pollPeriod = 30.0);
+    virtual ~NameServer();
+
+    /** Register a server by the TCP address of its clients, "host[:port]".
+     * @returns false if the address can't be resolved, or is already registered.
+     */
+    bool addServer(const std::string& address);
+    //! Forget a server, and its names
+    void removeServer(const std::string& address);
+
+    /** Look up the server hosting a name.
+     * @returns false if no registered server has this name.
+     */
+    bool find(const std::string& name, ServerGUID& guid, osiSockAddr& address);
+
+    //! Start polling registered servers
+    void start();
+    //! Stop polling.  Joins the worker thread.
+    void stop();
+    //! Fetch channel lists now, instead of after pollPeriod
+    void poll();
+
+    struct Stats {
+        //! number of registered servers, and those which answered the last poll
+        size_t servers, reachable;
+        //! number of names known
+        size_t names;
+        //! find() calls, and those answered
+        size_t lookups, hits;
+    };
+    void getStats(Stats& out) const;
+
+    struct Server;
+    struct Client;
+private:
+    virtual void run() OVERRIDE FINAL;
+    void update(Client& client);
+
+    const double pollPeriod;
+
+    mutable epicsMutex mutex;
+    std::vector<std::tr1::shared_ptr<Server> > servers;
+    // names of all servers.  first added server wins when several have a name
+    typedef std::map<std::string, std::tr1::shared_ptr<Server> > names_t;
+    names_t names;
+    Stats stats;
+    bool running;
+
+    epicsEvent wakeup;
+    epicsThread worker;
+
+    NameServer(const NameServer&);
+    NameServer& operator=(const NameServer&);
+};
+
+}
+}
+
+#endif // NAMESERVER_H
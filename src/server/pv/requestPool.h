@@ -0,0 +1,132 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef REQUESTPOOL_H
+#define REQUESTPOOL_H
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define requestPoolEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include <pv/sharedPtr.h>
+
+#ifdef requestPoolEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef requestPoolEpicsExportSharedSymbols
+#endif
+
+#include <pv/pvaDefs.h>
+#include <pv/pvAccess.h>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Bounded pool of worker threads for server requests.
+ *
+ * Work queued with the same owner and ID runs in the order queued, one at a time.
+ * Otherwise work runs in parallel on up to the number of workers.
+ *
+ * Configured in a ServerContext by EPICS_PVAS_REQUEST_THREADS and EPICS_PVAS_REQUEST_QUEUE,
+ * and used for the channels of providers which implement BlockingChannelProvider.
+ */
+class epicsShareClass RequestPool : public epicsThreadRunable
+{
+public:
+    POINTER_DEFINITIONS(RequestPool);
+
+    struct Work {
+        POINTER_DEFINITIONS(Work);
+        virtual ~Work() {}
+        virtual void run() =0;
+    };
+
+    /**
+     * @param workers number of worker threads
+     * @param maxQueued queue() blocks while this much work is waiting or running
+     */
+    RequestPool(size_t workers, size_t maxQueued);
+    virtual ~RequestPool();
+
+    /** Run work on a worker, after any work queued earlier with the same owner and ID.
+     * Blocks while the queue is full.  After stop(), runs work in the calling thread.
+     */
+    void queue(const void* owner, pvAccessID id, const Work::shared_pointer& work);
+
+    //! Stop workers, dropping queued work.  Joins the worker threads.
+    void stop();
+
+    struct Stats {
+        //! number of workers, and of those running work
+        size_t workers, busy;
+        //! work waiting or running now, and the most ever
+        size_t queued, maxQueued;
+        //! work which has run
+        size_t completed;
+        //! times queue() has blocked
+        size_t blocked;
+        //! seconds work has waited from queue() until run, in total and at most
+        double waitTotal, waitMax;
+    };
+    void getStats(Stats& out) const;
+
+private:
+    virtual void run() OVERRIDE FINAL;
+    // erase the idle entries of pending
+    void sweep();
+
+    const size_t limit;
+
+    typedef std::pair<const void*, pvAccessID> key_t;
+    struct Item {
+        Work::shared_pointer work;
+        epicsTimeStamp queued;
+    };
+    // queued work by key.  The front of each is running, or its key is in ready.
+    // Entries left empty are kept for the next request of their key, up to idle.
+    typedef std::map<key_t, std::deque<Item> > pending_t;
+
+    mutable epicsMutex mutex;
+    pending_t pending;
+    size_t idle;
+    std::deque<key_t> ready;
+    Stats stats;
+    bool running;
+
+    epicsEvent wakeup, space;
+    std::vector<std::tr1::shared_ptr<epicsThread> > workers;
+
+    RequestPool(const RequestPool&);
+    RequestPool& operator=(const RequestPool&);
+};
+
+/** @brief Optional interface of a ChannelProvider whose operations may block.
+ *
+ * A ServerContext checks each provider for this interface with dynamic_cast.
+ * When a request pool is configured, creating and executing the operations of its channels,
+ * and destroying them, is done on the pool instead of the receive thread of the connection.
+ */
+class epicsShareClass BlockingChannelProvider
+{
+public:
+    virtual ~BlockingChannelProvider();
+};
+
+}
+}
+
+#endif // REQUESTPOOL_H
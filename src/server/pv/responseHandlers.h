@@ -9,6 +9,8 @@
 
 #include <list>
 
+#include <epicsTime.h>
+
 #include <pv/timer.h>
 
 #include <pv/serverContext.h>
@@ -16,6 +18,11 @@
 #include <pv/serverChannelImpl.h>
 #include <pv/baseChannelRequester.h>
 #include <pv/securityImpl.h>
+#include <pv/monitorFilter.h>
+#include <pv/internedName.h>
+#include <pv/ringBuffer.h>
+#include <pv/arrayDelta.h>
+#include <pv/senderPool.h>
 
 namespace epics {
 namespace pvAccess {
@@ -93,12 +100,21 @@ public:
 
 class EchoTransportSender : public TransportSender {
 public:
+    EchoTransportSender() {
+        memset(&_echoFrom, 0, sizeof(osiSockAddr));
+        // don't let a backlog of data make the connection appear dead
+        setQueueLevel(LEVEL_URGENT);
+    }
     EchoTransportSender(osiSockAddr* echoFrom) {
         memcpy(&_echoFrom, echoFrom, sizeof(osiSockAddr));
+        setQueueLevel(LEVEL_URGENT);
     }
 
     virtual ~EchoTransportSender() {}
 
+    //! One already sent, from a pool shared by all servers, or a new one
+    static TransportSender::shared_pointer create(osiSockAddr* echoFrom);
+
     virtual void send(epics::pvData::ByteBuffer* /*buffer*/, TransportSendControl* control) OVERRIDE FINAL {
         control->startMessage(CMD_ECHO, 0);
         control->setRecipient(_echoFrom);
@@ -107,27 +123,13 @@ public:
 
 private:
     osiSockAddr _echoFrom;
+    static SenderPool<EchoTransportSender> _pool;
 };
 
 /****************************************************************************************/
 /**
  * Search channel request handler.
  */
-// TODO object pool!!!
-class ServerSearchHandler : public AbstractServerResponseHandler
-{
-public:
-    static const std::string SUPPORTED_PROTOCOL;
-
-    ServerSearchHandler(ServerContextImpl::shared_pointer const & context);
-    virtual ~ServerSearchHandler() {}
-
-    virtual void handleResponse(osiSockAddr* responseFrom,
-                                Transport::shared_pointer const & transport, epics::pvData::int8 version, epics::pvData::int8 command,
-                                std::size_t payloadSize, epics::pvData::ByteBuffer* payloadBuffer) OVERRIDE FINAL;
-};
-
-
 class ServerChannelFindRequesterImpl:
     public ChannelFindRequester,
     public TransportSender,
@@ -135,11 +137,27 @@ class ServerChannelFindRequesterImpl:
     public std::tr1::enable_shared_from_this<ServerChannelFindRequesterImpl>
 {
 public:
-    ServerChannelFindRequesterImpl(ServerContextImpl::shared_pointer const & context, epics::pvData::int32 expectedResponseCount);
+    POINTER_DEFINITIONS(ServerChannelFindRequesterImpl);
+
+    /** One no longer referenced, from a pool shared by all servers, or a new one.
+     * Returned to the pool when the last reference is released.
+     */
+    static shared_pointer create(ServerContextImpl::shared_pointer const & context, epics::pvData::int32 expectedResponseCount);
+
+    //! Idle requesters, for a handler which should not share them
+    struct Pool;
+    static std::tr1::shared_ptr<Pool> createPool();
+    //! From pool instead of the shared one
+    static shared_pointer create(ServerContextImpl::shared_pointer const & context, epics::pvData::int32 expectedResponseCount,
+                                 std::tr1::shared_ptr<Pool> const & pool);
     virtual ~ServerChannelFindRequesterImpl() {}
-    void clear();
-    ServerChannelFindRequesterImpl* set(std::string _name, epics::pvData::int32 searchSequenceId,
-                                        epics::pvData::int32 cid, osiSockAddr const & sendTo, bool responseRequired, bool serverSearch);
+    ServerChannelFindRequesterImpl* set(const std::string& name, epics::pvData::int32 searchSequenceId,
+                                        epics::pvData::int32 cid, osiSockAddr const & sendTo, bool responseRequired, bool serverSearch,
+                                        bool cacheResult = false);
+    //! Reply through this TCP connection, instead of the UDP broadcast transport
+    void setReplyTransport(Transport::shared_pointer const & transport);
+    //! Reply on behalf of another server, as a NameServer
+    void setServer(const ServerGUID& guid, osiSockAddr const & address);
     virtual void channelFindResult(const epics::pvData::Status& status, ChannelFind::shared_pointer const & channelFind, bool wasFound) OVERRIDE FINAL;
 
     virtual void send(epics::pvData::ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL;
@@ -148,6 +166,13 @@ public:
     virtual void timerStopped() OVERRIDE FINAL;
 
 private:
+    ServerChannelFindRequesterImpl();
+    // as constructed, and referencing no context or transport while pooled
+    void clear();
+
+    struct Recycle;
+    static const std::tr1::shared_ptr<Pool> _pool;
+
     ServerGUID _guid;
     std::string _name;
     epics::pvData::int32 _searchSequenceId;
@@ -160,6 +185,69 @@ private:
     epics::pvData::int32 _expectedResponseCount;
     epics::pvData::int32 _responseCount;
     bool _serverSearch;
+    // record the outcome in the ChannelNameIndex
+    bool _cacheResult;
+    Transport::weak_pointer _replyTransport;
+    // from setServer()
+    bool _otherServer;
+    osiSockAddr _serverAddress;
+};
+
+class ServerSearchHandler : public AbstractServerResponseHandler
+{
+public:
+    static const std::string SUPPORTED_PROTOCOL;
+
+    ServerSearchHandler(ServerContextImpl::shared_pointer const & context);
+    virtual ~ServerSearchHandler() {}
+
+    virtual void handleResponse(osiSockAddr* responseFrom,
+                                Transport::shared_pointer const & transport, epics::pvData::int8 version, epics::pvData::int8 command,
+                                std::size_t payloadSize, epics::pvData::ByteBuffer* payloadBuffer) OVERRIDE FINAL;
+private:
+    // of this handler, so that those of several UDP shards do not contend
+    const std::tr1::shared_ptr<ServerChannelFindRequesterImpl::Pool> _pool;
+};
+
+/**
+ * The names of one search request not answered from the ChannelNameIndex,
+ * asked of all searched providers together through ChannelBatchFind.
+ * Replies once all have answered.
+ */
+class ServerBatchFindRequester:
+    public ChannelBatchFindRequester
+{
+public:
+    POINTER_DEFINITIONS(ServerBatchFindRequester);
+
+    ServerBatchFindRequester(ServerContextImpl::shared_pointer const & context,
+                             epics::pvData::int32 searchSequenceId, osiSockAddr const & responseAddress,
+                             bool responseRequired, Transport::shared_pointer const & replyTransport,
+                             size_t providerCount);
+    virtual ~ServerBatchFindRequester() {}
+
+    //! Before passing getNames() to providers
+    void add(const std::string& name, epics::pvData::int32 cid);
+    const std::vector<std::string>& getNames() const { return _names; }
+
+    virtual void channelBatchFindResult(const epics::pvData::Status& status,
+                                        ChannelFind::shared_pointer const & channelFind,
+                                        const std::vector<bool>& found) OVERRIDE FINAL;
+
+private:
+    const ServerContextImpl::shared_pointer _context;
+    const epics::pvData::int32 _searchSequenceId;
+    const osiSockAddr _responseAddress;
+    const bool _responseRequired;
+    const Transport::weak_pointer _replyTransport;
+    std::vector<std::string> _names;
+    std::vector<epics::pvData::int32> _cids;
+
+    epics::pvData::Mutex _mutex;
+    // providers yet to answer
+    size_t _pending;
+    // for each name, the provider which found it, and whether any did
+    std::vector<std::pair<ChannelProvider::shared_pointer, bool> > _foundBy;
 };
 
 /****************************************************************************************/
@@ -182,6 +270,8 @@ private:
     // Name of the magic "server" PV used to implement channelList() and server info
     static const std::string SERVER_CHANNEL_NAME;
 
+    void createChannel(Transport::shared_pointer const & transport, pvAccessID cid, std::string const & channelName);
+
     void disconnect(Transport::shared_pointer const & transport);
 };
 
@@ -215,7 +305,8 @@ public:
 private:
     ServerChannel::weak_pointer _serverChannel;
     std::tr1::weak_ptr<detail::BlockingServerTCPTransportCodec> _transport;
-    const std::string _channelName;
+    // shared with the channels of other clients to the same PV
+    const InternedName _channelName;
     const pvAccessID _cid;
     ChannelSecuritySession::shared_pointer const & _css;
     epics::pvData::Status _status;
@@ -243,10 +334,14 @@ public:
 class ServerDestroyChannelHandlerTransportSender : public TransportSender
 {
 public:
+    ServerDestroyChannelHandlerTransportSender(): _cid(0), _sid(0) {}
     ServerDestroyChannelHandlerTransportSender(pvAccessID cid, pvAccessID sid): _cid(cid), _sid(sid) {
     }
 
     virtual ~ServerDestroyChannelHandlerTransportSender() {}
+
+    //! One already sent, from a pool shared by all servers, or a new one
+    static TransportSender::shared_pointer create(pvAccessID cid, pvAccessID sid);
     virtual void send(epics::pvData::ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL {
         control->startMessage((epics::pvData::int8)CMD_DESTROY_CHANNEL, 2*sizeof(epics::pvData::int32)/sizeof(epics::pvData::int8));
         buffer->putInt(_sid);
@@ -256,6 +351,7 @@ public:
 private:
     pvAccessID _cid;
     pvAccessID _sid;
+    static SenderPool<ServerDestroyChannelHandlerTransportSender> _pool;
 };
 
 /****************************************************************************************/
@@ -305,6 +401,9 @@ public:
     ChannelGet::shared_pointer getChannelGet();
     virtual std::tr1::shared_ptr<ChannelRequest> getOperation() OVERRIDE FINAL { return getChannelGet(); }
 
+    //! Pass the oldest queued get() to the provider, unless one is pending
+    void dispatchQueued();
+
     virtual void send(epics::pvData::ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL;
 private:
     // Note: this forms a reference loop, which is broken in destroy()
@@ -312,6 +411,10 @@ private:
     epics::pvData::PVStructure::shared_pointer _pvStructure;
     epics::pvData::BitSet::shared_pointer _bitSet;
     epics::pvData::Status _status;
+    //! May serialize to SharedUpdate (no unions)
+    bool _cacheable;
+    //! Serialized responses of the generation of the last getDone(), or NULL
+    SharedUpdate::shared_pointer _responses;
 };
 
 
@@ -365,6 +468,15 @@ public:
 
     epics::pvData::BitSet::shared_pointer getPutBitSet();
     epics::pvData::PVStructure::shared_pointer getPutPVStructure();
+
+    //! Where to deserialize a put() which will be queued
+    void spareValue(epics::pvData::PVStructure::shared_pointer& value, epics::pvData::BitSet::shared_pointer& changed);
+    //! After canQueueRequest().  value is NULL for a get()
+    void queuePut(epics::pvData::int32 qos, epics::pvData::PVStructure::shared_pointer const & value,
+                  epics::pvData::BitSet::shared_pointer const & changed);
+    //! Pass the oldest queued get() or put() to the provider, unless one is pending
+    void dispatchQueued();
+
     void send(epics::pvData::ByteBuffer* buffer, TransportSendControl* control);
 private:
     // Note: this forms a reference loop, which is broken in destroy()
@@ -372,6 +484,14 @@ private:
     epics::pvData::BitSet::shared_pointer _bitSet;
     epics::pvData::PVStructure::shared_pointer _pvStructure;
     epics::pvData::Status _status;
+
+    typedef std::pair<epics::pvData::PVStructure::shared_pointer, epics::pvData::BitSet::shared_pointer> value_t;
+    // one for each queued request, in order.  Guarded by _mutex
+    std::deque<value_t> _queuedValues;
+    // the value of the pending request, if it was queued
+    value_t _activeValue;
+    // recycled after a queued put() is answered
+    std::vector<value_t> _spareValues;
 };
 
 /****************************************************************************************/
@@ -465,6 +585,7 @@ class ServerMonitorRequesterImpl :
     public BaseChannelRequester,
     public MonitorRequester,
     public TransportSender,
+    public epics::pvData::TimerCallback,
     public std::tr1::enable_shared_from_this<ServerMonitorRequesterImpl>
 {
 public:
@@ -490,10 +611,21 @@ public:
 
     Monitor::shared_pointer getChannelMonitor();
     virtual std::tr1::shared_ptr<ChannelRequest> getOperation() OVERRIDE FINAL { return std::tr1::shared_ptr<ChannelRequest>(); }
+    //! The queue of a MonitorFIFO
+    virtual size_t memoryUsage() OVERRIDE FINAL;
 
     virtual void send(epics::pvData::ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL;
     void ack(size_t cnt);
+
+    // end of the rate limit holdoff
+    virtual void callback() OVERRIDE FINAL;
+    virtual void timerStopped() OVERRIDE FINAL;
 private:
+    // collect field options naming a MonitorFilterPlugin
+    void findFilters(const epics::pvData::PVStructure& request, const std::string& path);
+    // merge element into _squashed.  Returns false if held by a filter
+    bool squash(const epics::pvData::MonitorElementPtr& element);
+
     // Note: this forms a reference loop, which is broken in destroy()
     Monitor::shared_pointer _channelMonitor;
     epics::pvData::StructureConstPtr _structure;
@@ -502,11 +634,39 @@ private:
     // _window_open + _window_closed.size() are together the congestion control window.
     // _window_open are the number of elements which we can send w/o further ack's
     size_t _window_open;
-    // The elements we have sent, but have not been acknowledged
-    typedef std::list<epics::pvData::MonitorElementPtr> window_t;
+    // The elements we have sent, but have not been acknowledged.
+    // A ring, so that once grown to the window, sending allocates no list nodes.
+    typedef RingBuffer<epics::pvData::MonitorElementPtr> window_t;
     window_t _window_closed;
     bool _unlisten;
     bool _pipeline; // const after activate()
+
+    // from record._options.rate or .dt.  Seconds between updates sent, zero if not limited.
+    double _minPeriod; // const after activate()
+
+    struct FilterRequest {
+        std::string path, arg;
+        MonitorFilterPlugin::shared_pointer plugin;
+    };
+    std::vector<FilterRequest> _filterRequests; // const after activate()
+    // created by monitorConnect() on fields of _squashed.  Only used by send()
+    std::vector<MonitorFilter::shared_pointer> _filters;
+
+    // rate limited or filtered.  const after activate()
+    bool _conflate;
+    // when _conflate, updates polled but not yet sent are merged here.  Only used by send()
+    epics::pvData::MonitorElementPtr _squashed;
+    // some update merged into _squashed was passed by all filters
+    bool _squashReady;
+    // number of elements merged into _squashed
+    size_t _squashCount;
+    epicsTimeStamp _lastSend;
+    bool _holdoff; // timer scheduled
+    TimerWheel::shared_pointer _timer;
+    // type has no unions, so updates with a SharedUpdate may be serialized once for all subscribers
+    bool _cacheable;
+    // record[arrayDelta=true].  Created by activate().  Only used by send()
+    epics::auto_ptr<ArrayDeltaEncoder> _arrayDelta;
 };
 
 
@@ -565,6 +725,9 @@ public:
     ChannelArray::shared_pointer getChannelArray();
     virtual std::tr1::shared_ptr<ChannelRequest> getOperation() OVERRIDE FINAL { return getChannelArray(); }
 
+    //! ChannelArray::getArray(), in parts if the pvRequest asked for chunks
+    void startGet(std::size_t offset, std::size_t count, std::size_t stride);
+
     epics::pvData::PVArray::shared_pointer getPVArray();
     virtual void send(epics::pvData::ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL;
 
@@ -575,6 +738,13 @@ private:
 
     std::size_t _length;
     epics::pvData::Status _status;
+
+    // from record._options.chunk.  Most elements sent in one response, zero if not limited.
+    std::size_t _chunk; // const after activate()
+    // of a get sent in parts.  offset of the next part, elements remaining, unless to the end,
+    // and the count asked of the provider for the current part
+    std::size_t _chunkOffset, _chunkRemaining, _chunkStride, _chunkCount;
+    bool _chunkToEnd;
 };
 
 /****************************************************************************************/
@@ -702,7 +872,7 @@ public:
 
     ServerGetFieldRequesterImpl(ServerContextImpl::shared_pointer const & context,
                                 std::tr1::shared_ptr<ServerChannel> const & channel, const pvAccessID ioid,
-                                Transport::shared_pointer const & transport);
+                                Transport::shared_pointer const & transport, const std::string& subField);
 
     virtual std::tr1::shared_ptr<ChannelRequest> getOperation() OVERRIDE FINAL { return std::tr1::shared_ptr<ChannelRequest>(); }
 
@@ -712,6 +882,7 @@ public:
     virtual void send(epics::pvData::ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL;
 private:
     bool done;
+    const std::string _subField;
     epics::pvData::Status _status;
     epics::pvData::FieldConstPtr _field;
 };
@@ -786,12 +957,30 @@ public:
     ChannelRPC::shared_pointer getChannelRPC();
     virtual std::tr1::shared_ptr<ChannelRequest> getOperation() OVERRIDE FINAL { return getChannelRPC(); }
 
+    /**
+     * Deserialize the argument of a request.
+     * If the ChannelRPC declared an argument type, the previous argument is re-used
+     * when it has the same type and is no longer referenced elsewhere.
+     */
+    epics::pvData::PVStructure::shared_pointer deserializeArgument(epics::pvData::ByteBuffer* payloadBuffer,
+                                                                   epics::pvData::DeserializableControl* control);
+
+    //! Call request() with argument from pool.  The argument is passed through takeArgument(), so the Work is reused.
+    void queueRequest(RequestPool& pool, epics::pvData::PVStructure::shared_pointer const & argument);
+    //! The argument of queueRequest(), once
+    epics::pvData::PVStructure::shared_pointer takeArgument();
+
     virtual void send(epics::pvData::ByteBuffer* buffer, TransportSendControl* control) OVERRIDE FINAL;
 private:
     // Note: this forms a reference loop, which is broken in destroy()
     ChannelRPC::shared_pointer _channelRPC;
     epics::pvData::PVStructure::shared_pointer _pvResponse;
     epics::pvData::Status _status;
+    // set when the ChannelRPC declares its argument type
+    epics::pvData::Structure::const_shared_pointer _argumentType;
+    epics::pvData::PVStructure::shared_pointer _pvArgument;
+    // of queueRequest()
+    epics::pvData::PVStructure::shared_pointer _queuedArgument;
 };
 
 
@@ -832,6 +1021,7 @@ private:
      */
     std::vector<ResponseHandler*> m_handlerTable;
 
+    ServerContextImpl::Counters& counters;
 };
 
 }
@@ -7,17 +7,23 @@
 #ifndef SERVERCHANNEL_H_
 #define SERVERCHANNEL_H_
 
+#include <map>
+#include <string>
+
 #include <pv/destroyable.h>
 #include <pv/remote.h>
 #include <pv/security.h>
 #include <pv/baseChannelRequester.h>
+#include <pv/idTable.h>
+
+#include <shareLib.h>
 
 namespace epics {
 namespace pvAccess {
 
 class BaseChannelRequester;
 
-class ServerChannel
+class epicsShareClass ServerChannel
 {
 public:
     POINTER_DEFINITIONS(ServerChannel);
@@ -43,6 +49,9 @@ public:
 
     pvAccessID getSID() const { return _sid; }
 
+    //! The provider of this channel implements BlockingChannelProvider
+    bool isBlocking() const { return _blocking; }
+
     ChannelSecuritySession::shared_pointer getChannelSecuritySession() const
     { return _channelSecuritySession; }
 
@@ -53,6 +62,21 @@ public:
     void installGetField(const GetFieldRequester::shared_pointer& gf);
     void completeGetField(GetFieldRequester *req);
 
+    /** The introspection of subField which the provider last gave, or NULL.
+     * The type of a channel only changes while disconnected, after which this is destroy()ed.
+     */
+    epics::pvData::FieldConstPtr cachedField(const std::string& subField) const;
+    //! Remember the result of a successful getField(), for up to MAX_CACHED_FIELDS sub-fields
+    void cacheField(const std::string& subField, const epics::pvData::FieldConstPtr& field);
+
+    static const size_t MAX_CACHED_FIELDS = 16u;
+
+    /** Where GET responses of this provider generation (see ChannelRequest::getGeneration())
+     * are kept, serialized, for later requests of the same form.  Replaced by a newer generation.
+     * NULL for generation 0, or an older generation.
+     */
+    SharedUpdate::shared_pointer getResponses(epics::pvData::uint64 generation);
+
     //! may return NULL
     std::tr1::shared_ptr<BaseChannelRequester> getRequest(pvAccessID id);
 
@@ -61,6 +85,22 @@ public:
     void printInfo() const;
 
     void printInfo(FILE *fd) const;
+
+    //! Sum of BaseChannelRequester::memoryUsage() of the requests of this channel
+    size_t memoryUsage() const;
+
+    //! What was sent for this channel.  Written by the send thread of its transport.
+    struct Stats {
+        size_t bytesSent;
+        size_t monitorUpdates;
+        //! monitor updates sent with overrun bits set
+        size_t monitorOverruns;
+        Stats() :bytesSent(0u), monitorUpdates(0u), monitorOverruns(0u) {}
+    };
+
+    Stats& stats() { return _stats; }
+    //! A copy of the counters
+    Stats getStats() const { return _stats; }
 private:
     const Channel::shared_pointer _channel;
 
@@ -68,10 +108,33 @@ private:
 
     const pvAccessID _cid, _sid;
 
-    //! keep alive in-progress GetField()
-    GetFieldRequester::shared_pointer _active_requester;
+    bool _blocking;
+
+    typedef std::map<std::string, epics::pvData::FieldConstPtr> _fields_t;
+
+    //! State which many channels never use, allocated on first use.  Guarded by _mutex
+    struct Cold {
+        //! keep alive in-progress GetField()
+        GetFieldRequester::shared_pointer active_requester;
+
+        //! by sub-field, see cachedField()
+        _fields_t fields;
 
-    typedef std::map<pvAccessID, std::tr1::shared_ptr<BaseChannelRequester> > _requests_t;
+        //! see getResponses()
+        epics::pvData::uint64 getGeneration;
+        SharedUpdate::shared_pointer getResponses;
+
+        Cold() :getGeneration(0u) {}
+    };
+    epics::auto_ptr<Cold> _cold;
+
+    Cold& cold() {
+        if(!_cold.get())
+            _cold.reset(new Cold);
+        return *_cold;
+    }
+
+    typedef IDTable<std::tr1::shared_ptr<BaseChannelRequester> > _requests_t;
     _requests_t _requests;
 
     bool _destroyed;
@@ -79,6 +142,8 @@ private:
     mutable epics::pvData::Mutex _mutex;
 
     const ChannelSecuritySession::shared_pointer _channelSecuritySession;
+
+    Stats _stats;
 };
 
 }
@@ -89,6 +89,26 @@ public:
 
     virtual const std::vector<ChannelProvider::shared_pointer>& getChannelProviders() =0;
 
+    /** Change a setting of the running server, as if its Configuration gave value for name.
+     *
+     * Only the settings listed by tunables() may be changed.  Those marked live are applied
+     * to the connections already open, the others to connections accepted afterwards.
+     * Changes are lost when the server is stopped.
+     * @returns false if name can't be changed, or value is not valid for it.
+     * @since 6.1.0
+     */
+    virtual bool tune(const std::string& name, const std::string& value) =0;
+
+    //! A setting which tune() may change
+    struct Tunable {
+        std::string name,
+                    value; //!< current value, empty if not set
+        bool live;         //!< applied to open connections, not only to those accepted later
+    };
+    //! The settings which tune() may change, with their current values
+    //! @since 6.1.0
+    virtual void tunables(std::vector<Tunable>& out) =0;
+
     // ************************************************************************** //
     // **************************** [ Plugins ] ********************************* //
     // ************************************************************************** //
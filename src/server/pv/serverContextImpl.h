@@ -15,7 +15,14 @@
 
 #include <pv/blockingUDP.h>
 #include <pv/blockingTCP.h>
+#include <pv/codec.h>
 #include <pv/beaconEmitter.h>
+#include <pv/ioReactor.h>
+#include <pv/channelNameIndex.h>
+#include <pv/nameServer.h>
+#include <pv/requestPool.h>
+#include <pv/serverStats.h>
+#include <pv/metrics.h>
 
 #include "serverContext.h"
 
@@ -25,6 +32,7 @@ namespace pvAccess {
 class ServerContextImpl :
     public ServerContext,
     public Context,
+    public MetricsSource,
     public std::tr1::enable_shared_from_this<ServerContextImpl>
 {
     friend class ServerContext;
@@ -46,7 +54,7 @@ public:
     void printInfo(std::ostream& str, int lvl) OVERRIDE FINAL;
     void setBeaconServerStatusProvider(BeaconServerStatusProvider::shared_pointer const & beaconServerStatusProvider) OVERRIDE FINAL;
     //**************** derived from Context ****************//
-    epics::pvData::Timer::shared_pointer getTimer() OVERRIDE FINAL;
+    TimerWheel::shared_pointer getTimer() OVERRIDE FINAL;
     Channel::shared_pointer getChannel(pvAccessID id) OVERRIDE FINAL;
     Transport::shared_pointer getSearchTransport() OVERRIDE FINAL;
     Configuration::const_shared_pointer getConfiguration() OVERRIDE FINAL;
@@ -55,11 +63,16 @@ public:
 
     virtual void newServerDetected() OVERRIDE FINAL;
 
+    virtual IOReactor::shared_pointer getIOReactor() OVERRIDE FINAL;
+
 
     epicsTimeStamp& getStartTime() OVERRIDE FINAL;
 
     virtual Configuration::shared_pointer getCurrentConfig() OVERRIDE FINAL;
 
+    virtual bool tune(const std::string& name, const std::string& value) OVERRIDE FINAL;
+    virtual void tunables(std::vector<Tunable>& out) OVERRIDE FINAL;
+
     /**
      * Version.
      */
@@ -84,8 +97,8 @@ public:
     float getBeaconPeriod();
 
     /**
-     * Get receiver buffer (payload) size.
-     * @return max payload size.
+     * Get receive buffer budget of each connection (EPICS_PVAS_MAX_ARRAY_BYTES).
+     * @return bytes, or 0 if not set.
      */
     epics::pvData::int32 getReceiveBufferSize();
 
@@ -137,9 +150,56 @@ public:
      */
     bool isChannelProviderNamePreconfigured();
 
-    // used by ServerChannelFindRequesterImpl
-    typedef std::map<std::string, std::tr1::weak_ptr<ChannelProvider> > s_channelNameToProvider_t;
-    s_channelNameToProvider_t s_channelNameToProvider;
+    /**
+     * Names published by providers, and search results from the others.
+     * constant after ServerContextImpl::initialize()
+     */
+    const ChannelNameIndex::shared_pointer& getChannelNameIndex() const { return _channelNameIndex; }
+
+    typedef std::tr1::shared_ptr<const std::vector<ChannelProvider::shared_pointer> > searched_providers_t;
+
+    /**
+     * Providers which must be asked with channelFind() about names not in getChannelNameIndex().
+     * Includes publishing providers until their names are published.  Never NULL after initialize().
+     */
+    searched_providers_t getSearchedProviders() const;
+
+    //! Called when a provider has published all of its names in the background
+    void providerPublished(const ChannelProvider::shared_pointer& provider);
+
+    /**
+     * Directory of the names of other servers, or NULL unless EPICS_PVAS_NAME_SERVER_LIST is set.
+     * constant after ServerContextImpl::initialize()
+     */
+    const NameServer::shared_pointer& getNameServer() const { return _nameServer; }
+
+    /**
+     * Workers for the requests of channels of a BlockingChannelProvider,
+     * or NULL unless EPICS_PVAS_REQUEST_THREADS is set.
+     * constant after ServerContextImpl::initialize()
+     */
+    const RequestPool::shared_pointer& getRequestPool() const { return _requestPool; }
+
+    //! EPICS_PVAS_AUTHZ_CACHE
+    bool isAuthorizationCached() const { return _authzCache; }
+
+    /**
+     * Metrics served as PVs, or NULL unless EPICS_PVAS_STATS_PREFIX is set.
+     * constant after ServerContextImpl::loadConfiguration()
+     */
+    const ServerStats::shared_pointer& getServerStats() const { return _stats; }
+
+    //! Counted by the receive and beacon paths, and exported by collectMetrics()
+    struct Counters {
+        //! messages received, by TransportStatistics::commandIndex()
+        MetricCounter received[detail::TransportStatistics::maxCommand+1];
+        //! names in search requests, and those which a provider has
+        MetricCounter searchNames, searchFound;
+        MetricCounter beaconsSent;
+    };
+    Counters& getCounters() { return _counters; }
+
+    virtual void collectMetrics(Metrics& metrics) OVERRIDE FINAL;
 private:
 
     /**
@@ -153,6 +213,12 @@ private:
      */
     std::string _beaconAddressList;
 
+    /**
+     * Multicast group which replaces the automatic broadcast addresses, for beacons and searches.
+     * Joined on each interface.  Empty to use broadcasts.
+     */
+    std::string _multicastGroup;
+
     /**
      * List of used NIF.
      */
@@ -187,11 +253,23 @@ private:
     epics::pvData::int32 _serverPort;
 
     /**
-     * Length in bytes of the maximum buffer (payload) size that may pass through PVA.
+     * Bytes each connection may buffer on receive, or 0 for EPICS_PVA_MAX_TCP_RECV.
+     * Larger payloads stream through this buffer.
      */
     epics::pvData::int32 _receiveBufferSize;
 
-    epics::pvData::Timer::shared_pointer _timer;
+    /**
+     * Number of shared I/O threads for TCP transports.  Zero for per-transport threads.
+     */
+    epics::pvData::int32 _ioThreads;
+
+    /**
+     * Shared I/O threads (optional).
+     * constant after ServerContextImpl::initialize()
+     */
+    IOReactor::shared_pointer _ioReactor;
+
+    TimerWheel::shared_pointer _timer;
 
     /**
      * UDP transports needed to receive channel searches.
@@ -218,9 +296,76 @@ private:
 
     ResponseHandler::shared_pointer _responseHandler;
 
+    /**
+     * Receive sockets for each interface and group (EPICS_PVAS_UDP_SHARDS), each with its own thread,
+     * and the response handlers of all but the first, which uses _responseHandler.
+     */
+    epics::pvData::int32 _udpShards;
+    std::vector<ResponseHandler::shared_pointer> _shardHandlers;
+
     // const after loadConfiguration()
     std::vector<ChannelProvider::shared_pointer> _channelProviders;
 
+    /**
+     * Seconds for which a name no provider has is remembered.  Zero to always ask.
+     */
+    double _searchNegativeTimeout;
+
+    /**
+     * Servers whose names are handed out, and seconds between fetching their channel lists.
+     */
+    std::string _nameServerList;
+    double _nameServerPoll;
+
+    /**
+     * Workers, and bound on queued requests, of the request pool.
+     */
+    epics::pvData::int32 _requestThreads;
+    epics::pvData::int32 _requestQueue;
+
+    /**
+     * Name prefix of the metrics PVs, seconds between their updates, and channels listed.
+     */
+    std::string _statsPrefix;
+    double _statsPeriod;
+    epics::pvData::int32 _statsTop;
+    //! Whether <prefix>:tune accepts puts
+    bool _statsTune;
+
+    /**
+     * TCP port of the HTTP metrics endpoint.  0 for any, <0 for none.
+     */
+    epics::pvData::int32 _metricsPort;
+
+    /**
+     * Wrap channel security sessions in a CachingChannelSecuritySession.
+     */
+    bool _authzCache;
+
+    /**
+     * Threads publishing provider names after the server is listening.  0 to publish before.
+     */
+    epics::pvData::int32 _publishThreads;
+
+    /**
+     * Install a DefaultBeaconServerStatusProvider, unless one was set.
+     */
+    bool _beaconLoad;
+
+    Counters _counters;
+
+    // const after initialize()
+    ChannelNameIndex::shared_pointer _channelNameIndex;
+    NameServer::shared_pointer _nameServer;
+    RequestPool::shared_pointer _requestPool;
+    RequestPool::shared_pointer _publishPool;
+    ServerStats::shared_pointer _stats;
+    MetricsServer::shared_pointer _metricsServer;
+
+    // replaced, not modified, as background publishing completes
+    mutable epics::pvData::Mutex _searchedMutex;
+    searched_providers_t _searchedProviders;
+
 public:
     epics::pvData::Mutex _mutex;
 private:
@@ -240,6 +385,12 @@ private:
 
     Configuration::const_shared_pointer configuration;
 
+    // values given to tune(), looked up before the Configuration given to create()
+    struct Tuning;
+    std::tr1::shared_ptr<Tuning> _tuning;
+    // is configuration, once create()d
+    ConfigurationCache::shared_pointer _configCache;
+
     epicsTimeStamp _startTime;
 };
 
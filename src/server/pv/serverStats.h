@@ -0,0 +1,132 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef SERVERSTATS_H
+#define SERVERSTATS_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#ifdef epicsExportSharedSymbols
+#   define serverStatsEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include <pv/sharedPtr.h>
+#include <pv/pvData.h>
+
+#ifdef serverStatsEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef serverStatsEpicsExportSharedSymbols
+#endif
+
+#include <pv/pvAccess.h>
+#include <pv/latencyHistogram.h>
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+
+namespace epics {
+namespace pvAccess {
+
+class ServerContextImpl;
+class ServerChannel;
+
+/** @brief Metrics of a ServerContext, served as PVs by the server itself.
+ *
+ * Every period seconds, the counters of the transports and channels of the server are
+ * read, and posted as NTTables to
+ *
+ * @li <prefix>:stats:channels  the top channels by bytes sent per second, with their
+ *                              monitor updates and overruns
+ * @li <prefix>:stats:clients   each client, with its send queue depth, traffic and
+ *                              slow consumer actions
+ * @li <prefix>:stats:latency   for each operation, from the request arriving to the
+ *                              reply being sent, over the last period
+ * @li <prefix>:stats:tunables  the settings which ServerContext::tune() may change,
+ *                              with their current values
+ *
+ * With EPICS_PVAS_STATS_TUNE=YES, a put of "NAME=VALUE" to the NTScalar string
+ * @li <prefix>:tune            calls ServerContext::tune()
+ *
+ * Configured in a ServerContext by EPICS_PVAS_STATS_PREFIX (not set, no metrics),
+ * EPICS_PVAS_STATS_PERIOD, EPICS_PVAS_STATS_TOP and EPICS_PVAS_STATS_TUNE.
+ */
+class ServerStats : public epicsThreadRunable
+{
+public:
+    POINTER_DEFINITIONS(ServerStats);
+
+    ServerStats(const std::string& prefix, double period, size_t top, bool tune = false);
+    virtual ~ServerStats();
+
+    //! Serves the metrics PVs.  Added to the providers of the ServerContext.
+    ChannelProvider::shared_pointer getProvider() const { return provider.provider(); }
+
+    //! Start posting the metrics of a context, to which only a weak reference is kept
+    void start(const std::tr1::shared_ptr<ServerContextImpl>& context);
+    //! Stop posting.  Joins the worker thread, and closes the PVs.
+    void stop();
+
+    /** Count the duration of one request, from start to now.
+     * @param command The CMD_* of the request.  Others than get, put, put-get, array,
+     *                process and RPC are ignored.
+     */
+    void recordLatency(epics::pvData::int8 command, const epicsTimeStamp& start);
+
+private:
+    virtual void run() OVERRIDE FINAL;
+    // read the counters and post the PVs
+    void update();
+
+    const double period;
+    const size_t top;
+
+    pvas::StaticProvider provider;
+    const pvas::SharedPV::shared_pointer channelsPV, clientsPV, latencyPV, tunablesPV;
+    epics::pvData::PVStructure::shared_pointer channelsValue, clientsValue, latencyValue, tunablesValue;
+
+    struct TuneHandler;
+    // NULL unless tune
+    std::tr1::shared_ptr<TuneHandler> tuneHandler;
+    pvas::SharedPV::shared_pointer tunePV;
+
+    enum { numOps = 6 };
+    mutable epicsMutex mutex;
+    // latency of each kind of operation, since the last update()
+    LatencyHistogram latency[numOps];
+    size_t requests[numOps];
+    std::tr1::weak_ptr<ServerContextImpl> context;
+    bool running;
+
+    // counters read by the last update(), by address, to compute rates.
+    // The weak reference tells a new object at a re-used address from the one read.
+    template<typename T>
+    struct Last {
+        typedef T element_type;
+        std::tr1::weak_ptr<T> ref;
+        size_t bytesSent, bytesReceived;
+    };
+    std::map<const void*, Last<ServerChannel> > lastChannels;
+    std::map<const void*, Last<Transport> > lastClients;
+    epicsTimeStamp lastUpdate;
+
+    epicsEvent wakeup;
+    epicsThread worker;
+
+    ServerStats(const ServerStats&);
+    ServerStats& operator=(const ServerStats&);
+};
+
+}
+}
+
+#endif // SERVERSTATS_H
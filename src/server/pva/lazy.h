@@ -0,0 +1,119 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+#ifndef PVA_LAZY_H
+#define PVA_LAZY_H
+
+#include <string>
+
+#include <shareLib.h>
+#include <pv/sharedPtr.h>
+#include <pv/noDefaultMethods.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+
+namespace pvas {
+
+/** @addtogroup pvas
+ * @{
+ */
+
+/** @brief A Provider which creates each SharedPV when first opened, and forgets those left unused.
+ *
+ * For servers of more names than could be kept at once, eg. one PV for each of millions of possible names.
+ * A search is answered by Handler::hasChannel(), without creating anything.
+ * The first channel opened to a name calls Handler::materialize(), and later channels
+ * connect to the same SharedPV until it is evicted.
+ *
+ * A PV is idle from the disconnection of its last channel (see SharedPV::Handler::onLastDisconnect()).
+ * sweep(), also called periodically, evicts the PVs idle for longer than Config::idleHold,
+ * except the Config::warmPool most recently used, which are kept for names asked for again.
+ * While the PVs idle together use more than Config::maxBytes (see SharedPV::memoryUsage()),
+ * those idle longest are evicted first, however recently.  PVs with channels are never evicted.
+ *
+ * An evicted PV is passed to Handler::evict(), and then released.  It is not close()d,
+ * so a channel opened as it was evicted keeps working until it disconnects.
+ *
+ @code
+   struct Counters : public pvas::LazyProvider::Handler {
+       virtual bool hasChannel(const std::string& name) { return name.compare(0, 4, "cnt:")==0; }
+       virtual pvas::SharedPV::shared_pointer materialize(const std::string& name) {
+           pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+           pv->open(type);
+           return pv;
+       }
+   };
+   pvas::LazyProvider lazy("counters", std::tr1::shared_ptr<Counters>(new Counters));
+ @endcode
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass LazyProvider {
+public:
+    POINTER_DEFINITIONS(LazyProvider);
+    struct Impl;
+
+    struct epicsShareClass Handler {
+        POINTER_DEFINITIONS(Handler);
+        virtual ~Handler() {}
+        //! Whether name may be materialize()d.  Called for searches of names not materialized.  Default true
+        virtual bool hasChannel(const std::string& name) { return true; }
+        /** Create the PV of name, or return NULL to refuse.
+         * It may be open()d now, or later, eg. by the onFirstConnect() of its SharedPV::Handler,
+         * which is called as before.
+         */
+        virtual SharedPV::shared_pointer materialize(const std::string& name) =0;
+        //! The PV of name is being evicted, and will not be used again by the provider
+        virtual void evict(const std::string& name, const SharedPV::shared_pointer& pv) {}
+    };
+
+    struct epicsShareClass Config {
+        //! Seconds a PV is kept after its last channel disconnects.  Default 30
+        double idleHold;
+        //! Idle PVs kept beyond idleHold, the most recently used first.  Default 0
+        size_t warmPool;
+        //! Bytes which the idle PVs may use together.  Zero for no limit.  Default 0
+        size_t maxBytes;
+        Config();
+    };
+
+    /** Build a new provider.
+     * @param name Provider Name.  Only relevant if registerAsServer() is called, then must be unique in this process.
+     * @param handler Creates the PVs
+     */
+    LazyProvider(const std::string& name,
+                 const Handler::shared_pointer& handler,
+                 const Config& conf = Config());
+    //! Forgets all PVs, and closes their channels
+    ~LazyProvider();
+
+    //! Fetch the underlying ChannelProvider.  Usually to build a ServerContext around.
+    std::tr1::shared_ptr<epics::pvAccess::ChannelProvider> provider() const;
+
+    //! Evict the PVs idle beyond the limits of Config.  Also done periodically.
+    void sweep();
+
+    struct Stats {
+        //! PVs kept, and those with channels
+        size_t materialized, inuse;
+        //! Bytes used by the idle PVs, when last measured
+        size_t idleBytes;
+        //! PVs created and evicted since construction
+        size_t created, evicted;
+    };
+    void getStats(Stats& out) const;
+
+private:
+    std::tr1::shared_ptr<Impl> impl;
+    DynamicProvider dynamic;
+
+    EPICS_NOT_COPYABLE(LazyProvider)
+};
+
+//! @}
+
+} // namespace pvas
+
+#endif // PVA_LAZY_H
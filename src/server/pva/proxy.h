@@ -0,0 +1,105 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+#ifndef PVA_PROXY_H
+#define PVA_PROXY_H
+
+#include <string>
+
+#include <shareLib.h>
+#include <pv/sharedPtr.h>
+#include <pv/noDefaultMethods.h>
+
+#include <pva/server.h>
+#include <pva/client.h>
+
+namespace pvas {
+
+/** @addtogroup pvas
+ * @{
+ */
+
+/** @brief A Provider which serves the PVs of another, eg. as a gateway.
+ *
+ * Each PV searched for, or opened, through provider() is subscribed upstream,
+ * through a pvac::ClientProvider, once.  The subscription feeds a SharedPV,
+ * to which all downstream channels of that name connect.  So:
+ *
+ * - However many downstream clients, and whatever their pvRequests, there is one
+ *   upstream subscription per PV, for the whole structure.  The fields selected
+ *   by each downstream pvRequest are taken from it (see epics::pvAccess::RequestMask).
+ * - Get and getField() are answered from the latest value, without going upstream.
+ * - Each downstream subscriber has its own queue, so a slow client does not hold
+ *   up the others.  A client may limit its own rate with record[rate=N].
+ * - Put and RPC are forwarded upstream, unless Config::readOnly.
+ *
+ * A name is claimed by a search only once its upstream subscription has received a value.
+ * The first search for a name starts the subscription, so the client finds it
+ * on a later search.
+ *
+ * Upstream subscriptions without downstream channels are kept for Config::idleHold
+ * seconds, then cancelled.
+ *
+ @code
+   pvas::ProxyProvider proxy("gateway", pvac::ClientProvider("pva"));
+   pva::ServerContext::shared_pointer server(pva::ServerContext::create(
+           pva::ServerContext::Config().provider(proxy.provider())));
+ @endcode
+ *
+ * @note Downstream and upstream should not be the same network, or the proxy will find
+ *       itself.  eg. set EPICS_PVAS_INTF_ADDR_LIST and EPICS_PVA_ADDR_LIST apart.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass ProxyProvider {
+public:
+    POINTER_DEFINITIONS(ProxyProvider);
+    struct Impl;
+
+    struct epicsShareClass Config {
+        //! Seconds an upstream subscription is kept without downstream channels.  Default 30
+        double idleHold;
+        //! Fail downstream Put and RPC, instead of forwarding them.  Default false
+        bool readOnly;
+        Config();
+    };
+
+    /** Build a new provider.
+     * @param name Provider Name.  Only relevant if registerAsServer() is called, then must be unique in this process.
+     * @param upstream Where PVs are found
+     */
+    ProxyProvider(const std::string& name,
+                  const pvac::ClientProvider& upstream,
+                  const Config& conf = Config());
+    //! Cancels all upstream subscriptions, and closes downstream channels
+    ~ProxyProvider();
+
+    //! Fetch the underlying ChannelProvider.  Usually to build a ServerContext around.
+    std::tr1::shared_ptr<epics::pvAccess::ChannelProvider> provider() const;
+
+    //! Cancel the upstream subscriptions idle for longer than Config::idleHold.  Also done periodically.
+    void sweep();
+
+    struct Stats {
+        //! Upstream subscriptions, and those with a value
+        size_t upstream, connected;
+        //! Upstream subscriptions with downstream channels
+        size_t inuse;
+        //! Upstream updates received, and Put and RPC forwarded
+        size_t updates, forwarded;
+    };
+    void getStats(Stats& out) const;
+
+private:
+    std::tr1::shared_ptr<Impl> impl;
+    DynamicProvider dynamic;
+
+    EPICS_NOT_COPYABLE(ProxyProvider)
+};
+
+//! @}
+
+} // namespace pvas
+
+#endif // PVA_PROXY_H
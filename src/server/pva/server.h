@@ -141,6 +141,16 @@ public:
     //! @note Provider locking rules apply (@see provider_roles_requester_locking).
     std::tr1::shared_ptr<ChannelBuilder> remove(const std::string& name);
 
+    //! Add many PVs, with one lock.  Linear in the number of PVs, as names are sorted.
+    //! Names are then published to a running server in chunks, so searches are answered meanwhile.
+    //! May be called while a ServerContext is starting, or running.
+    //! @throws std::logic_error on a duplicate name, in which case none are added.
+    void add(const std::map<std::string, std::tr1::shared_ptr<ChannelBuilder> >& pvs);
+    //! Remove many PVs, with one lock.  Closes any open Channels to them.
+    //! Names not add()'d are ignored.
+    //! @note Provider locking rules apply (@see provider_roles_requester_locking).
+    void remove(const std::vector<std::string>& names);
+
     //! Fetch the underlying ChannelProvider.  Usually to build a ServerContext around.
     std::tr1::shared_ptr<epics::pvAccess::ChannelProvider> provider() const;
 
@@ -193,7 +203,7 @@ public:
         virtual void hasChannels(search_type& name) =0;
         //! Called when a client is requesting a list of channel names we provide.  Callee should set dynamic=false if this list is exhaustive.
         virtual void listChannels(names_type& names, bool& dynamic) {}
-        //! Called when a client is attempting to open a new channel to this SharedPV
+        //! Called when a client is attempting to open a new channel to this SharedPV.  NULL fails it with "No such channel"
         virtual std::tr1::shared_ptr<epics::pvAccess::Channel> createChannel(const std::tr1::shared_ptr<epics::pvAccess::ChannelProvider>& provider,
                                                                              const std::string& name,
                                                                              const std::tr1::shared_ptr<epics::pvAccess::ChannelRequester>& requester) =0;
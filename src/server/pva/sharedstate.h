@@ -7,7 +7,9 @@
 
 #include <string>
 #include <list>
+#include <vector>
 
+#include <epicsTime.h>
 #include <shareLib.h>
 #include <pv/sharedPtr.h>
 #include <pv/noDefaultMethods.h>
@@ -27,6 +29,7 @@ class Channel;
 class ChannelRequester;
 struct ChannelBaseRequester;
 class GetFieldRequester;
+class MonitorFIFO;
 void providerRegInit(void*);
 }} // epics::pvAccess
 
@@ -38,6 +41,7 @@ struct SharedPut;
 struct SharedRPC;
 
 struct Operation;
+class PostBatch;
 
 /** @addtogroup pvas
  * @{
@@ -76,6 +80,7 @@ class epicsShareClass SharedPV
     friend struct SharedMonitorFIFO;
     friend struct SharedPut;
     friend struct SharedRPC;
+    friend class PostBatch;
 public:
     POINTER_DEFINITIONS(SharedPV);
     /** Callbacks associated with a SharedPV.
@@ -144,6 +149,7 @@ public:
     //! Update the cached PVStructure in this SharedPV.
     //! Only those fields marked as changed will be copied in.
     //! Makes a light-weight copy.
+    //! With more than one subscriber, makes one more, to which all of their queues refer.
     //! @pre isOpen()==true
     //! @throws std::logic_error if !isOpen()
     //! @note Provider locking rules apply (@see provider_roles_requester_locking).
@@ -163,10 +169,63 @@ public:
     void setDebug(int lvl);
     int isDebug() const;
 
+    /** Keep the last depth updates post()ed.  A new subscriber whose pvRequest
+     *  includes "record[history=S]" first receives those posted in the last S seconds,
+     *  in order, instead of only the current value.
+     *  Storage for depth copies is allocated by open(), or now if already open,
+     *  discarding any history kept.  0, the default, keeps none.
+     */
+    void setHistory(size_t depth);
+
+    //! Queue state of one subscriber.  cf. epics::pvAccess::Monitor::Stats
+    struct SubscriberStats {
+        size_t nfilled;      //!< updates queued and not yet sent
+        size_t noutstanding; //!< updates being sent
+        size_t nempty;       //!< free queue elements
+        size_t nbytes;       //!< approximate bytes held by the queue, see MonitorFIFO::memoryUsage()
+    };
+    //! Append the queue state of each current subscriber to stats.
+    void getSubscriberStats(std::vector<SubscriberStats>& stats) const;
+
+    /** Approximate heap bytes of the current value and the history kept,
+     *  see epics::pvAccess::memoryUsage().  Subscriber queues are counted by getSubscriberStats().
+     */
+    size_t memoryUsage() const;
+
 private:
     friend void epics::pvAccess::providerRegInit(void*);
     static size_t num_instances;
 
+    struct MonitorRef {
+        SharedMonitorFIFO* fifo; // use only with mutex held
+        std::tr1::weak_ptr<epics::pvAccess::MonitorFIFO> ref;
+    };
+    typedef std::vector<MonitorRef> monitors_t;
+    typedef std::tr1::shared_ptr<const monitors_t> monitors_ptr;
+    typedef std::vector<std::tr1::shared_ptr<epics::pvAccess::MonitorFIFO> > notify_t;
+
+    // post() without notify(), which is left to the caller.
+    // Sets subscribers to those posted to.
+    void post(const epics::pvData::PVStructure& value,
+              const epics::pvData::BitSet& changed,
+              monitors_ptr& subscribers);
+    // call with mutex held
+    void addMonitor(SharedMonitorFIFO* fifo, const std::tr1::shared_ptr<epics::pvAccess::MonitorFIFO>& ref);
+    void removeMonitor(SharedMonitorFIFO* fifo);
+    // call without mutex
+    static void notify(const monitors_t& subscribers);
+
+    struct HistoryEntry {
+        std::tr1::shared_ptr<epics::pvData::PVStructure> value;
+        epics::pvData::BitSet changed, valid;
+        epicsTimeStamp time;
+    };
+    // call with mutex held
+    void allocHistory();
+    // post() those from the last window seconds to a new subscriber.
+    // @returns false if there were none
+    bool replayHistory(epics::pvAccess::MonitorFIFO& fifo, double window) const;
+
     weak_pointer internal_self; // const after build()
 
     mutable epicsMutex mutex;
@@ -175,7 +234,6 @@ private:
 
     typedef std::list<SharedPut*> puts_t;
     typedef std::list<SharedRPC*> rpcs_t;
-    typedef std::list<SharedMonitorFIFO*> monitors_t;
     typedef std::list<std::tr1::weak_ptr<epics::pvAccess::GetFieldRequester> > getfields_t;
     typedef std::list<SharedChannel*> channels_t;
 
@@ -183,7 +241,9 @@ private:
 
     puts_t puts;
     rpcs_t rpcs;
-    monitors_t monitors;
+    // replaced, never modified, with mutex held.  So a copy of the pointer
+    // may be iterated without the mutex.
+    monitors_ptr monitors;
     getfields_t getfields;
     channels_t channels;
 
@@ -191,12 +251,114 @@ private:
     //! mask of fields which are considered to have non-default values.
     //! Used for initial Monitor update and Get operations.
     epics::pvData::BitSet valid;
+    //! incremented by each open() and post().  See ChannelRequest::getGeneration()
+    epics::pvData::uint64 generation;
+
+    // ring buffer of recent post()s, each with the complete value
+    std::vector<HistoryEntry> history;
+    size_t historyDepth, historyNext, historyCount;
 
     int debugLvl;
 
     EPICS_NOT_COPYABLE(SharedPV)
 };
 
+/** Collects post()s to many SharedPVs, then notifies their subscribers together.
+ *
+ * Each post() updates the SharedPV and queues to its subscribers immediately,
+ * as SharedPV::post() does.  The wake up of the server, which sends the queued updates,
+ * is deferred until flush().  So subscribers see all of the updates in a batch
+ * in one pass, instead of one pass per PV.
+ *
+ @code
+   pvas::PostBatch batch;
+   for(size_t i=0; i<pvs.size(); i++)
+       batch.post(*pvs[i], *values[i], changed[i]);
+   batch.flush(); // or when batch goes out of scope
+ @endcode
+ *
+ * @note Provider locking rules apply to post() and flush() (@see provider_roles_requester_locking).
+ *       Not thread safe.  Use one PostBatch per thread.
+ */
+class epicsShareClass PostBatch
+{
+public:
+    PostBatch();
+    //! Calls flush()
+    ~PostBatch();
+
+    //! As SharedPV::post(), except that subscribers are notified by the next flush().
+    //! @throws std::logic_error if !pv.isOpen()
+    void post(SharedPV& pv,
+              const epics::pvData::PVStructure& value,
+              const epics::pvData::BitSet& changed);
+
+    //! Notify the subscribers of all post()s since the last flush().
+    void flush();
+
+    //! Number of subscriptions waiting for flush()
+    size_t size() const { return pending.size(); }
+
+private:
+    SharedPV::notify_t pending;
+
+    EPICS_NOT_COPYABLE(PostBatch)
+};
+
+/** Collects updates to many SharedPVs from any thread, eg. database event callbacks,
+ *  and posts them together, through one PostBatch, once per period.
+ *
+ * Updates to one PV queued between flushes are merged, so at most one is posted per PV,
+ * with the union of their changed fields.  The transport of each subscriber is then
+ * woken once per flush, instead of once per update.
+ *
+ @code
+   pvas::PostQueue queue(0.1); // flush every 100ms, eg. once per scan period
+   // from an event callback
+   queue.post(pv, *value, changed);
+ @endcode
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass PostQueue
+{
+public:
+    POINTER_DEFINITIONS(PostQueue);
+    struct Impl;
+
+    /** @param period Seconds between flushes by a worker thread.
+     *                When <=0, there is no worker, and the caller must flush().
+     */
+    explicit PostQueue(double period = 0.0);
+    //! Stops any worker, then posts updates still queued
+    ~PostQueue();
+
+    //! Copy the changed fields of value, to be posted to pv by the next flush().
+    //! Thread safe.  Does not call into the server.
+    void post(const SharedPV::shared_pointer& pv,
+              const epics::pvData::PVStructure& value,
+              const epics::pvData::BitSet& changed);
+
+    //! Post all queued updates.  Updates to PVs which are not open are discarded.
+    //! @note Provider locking rules apply (@see provider_roles_requester_locking).
+    void flush();
+
+    struct Stats {
+        //! post() calls, and those merged with an update already queued
+        size_t posted, merged;
+        //! flush() calls, and the updates they posted
+        size_t flushes, flushed;
+        //! PVs with an update queued now
+        size_t queued;
+    };
+    void getStats(Stats& out) const;
+
+private:
+    std::tr1::shared_ptr<Impl> impl;
+
+    EPICS_NOT_COPYABLE(PostQueue)
+};
+
 //! An in-progress network operation (Put or RPC).
 //! Use value(), changed() to see input data, and
 //! call complete() when done handling.
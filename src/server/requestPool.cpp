@@ -0,0 +1,206 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <epicsGuard.h>
+
+#define epicsExportSharedSymbols
+#include <pv/requestPool.h>
+#include <pv/logger.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+namespace epics {
+namespace pvAccess {
+
+BlockingChannelProvider::~BlockingChannelProvider() {}
+
+RequestPool::RequestPool(size_t nworkers, size_t maxQueued)
+    :limit(maxQueued>0 ? maxQueued : 1)
+    ,idle(0u)
+    ,running(true)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    if(nworkers<1)
+        nworkers = 1;
+
+    workers.reserve(nworkers);
+    for(size_t i=0; i<nworkers; i++) {
+        char name[16];
+        sprintf(name, "PVAS-req%u", (unsigned)i);
+        std::tr1::shared_ptr<epicsThread> worker(new epicsThread(*this, name,
+                                                                 epicsThreadGetStackSize(epicsThreadStackBig),
+                                                                 epicsThreadPriorityMedium));
+        worker->start();
+        workers.push_back(worker);
+    }
+    stats.workers = workers.size();
+}
+
+RequestPool::~RequestPool()
+{
+    stop();
+}
+
+void RequestPool::queue(const void* owner, pvAccessID id, const Work::shared_pointer& work)
+{
+    Item item;
+    item.work = work;
+
+    {
+        Guard G(mutex);
+
+        bool counted = false;
+        while(running && stats.queued>=limit) {
+            if(!counted) {
+                stats.blocked++;
+                counted = true;
+            }
+            UnGuard U(G);
+            space.wait();
+        }
+
+        if(running) {
+            epicsTimeGetCurrent(&item.queued);
+
+            const key_t key(owner, id);
+            std::pair<pending_t::iterator, bool> ins(pending.insert(std::make_pair(key, std::deque<Item>())));
+            std::deque<Item>& waiting = ins.first->second;
+            if(waiting.empty()) {
+                if(!ins.second)
+                    idle--; // reused
+                ready.push_back(key);
+            }
+            waiting.push_back(item);
+
+            stats.queued++;
+            if(stats.maxQueued<stats.queued)
+                stats.maxQueued = stats.queued;
+
+            UnGuard U(G);
+            wakeup.signal();
+            return;
+        }
+    }
+
+    // stopped.  wake any other blocked queue()
+    space.signal();
+    work->run();
+}
+
+void RequestPool::stop()
+{
+    std::vector<std::tr1::shared_ptr<epicsThread> > joinable;
+    {
+        Guard G(mutex);
+        if(!running)
+            return;
+        running = false;
+        joinable.swap(workers);
+    }
+
+    for(size_t i=0; i<joinable.size(); i++)
+        wakeup.signal();
+    space.signal();
+
+    for(size_t i=0; i<joinable.size(); i++)
+        joinable[i]->exitWait();
+
+    Guard G(mutex);
+    // dropped
+    stats.queued = 0;
+    pending.clear();
+    ready.clear();
+    idle = 0u;
+}
+
+void RequestPool::getStats(Stats& out) const
+{
+    Guard G(mutex);
+    out = stats;
+}
+
+void RequestPool::run()
+{
+    Guard G(mutex);
+
+    while(running) {
+        if(ready.empty()) {
+            UnGuard U(G);
+            wakeup.wait();
+            continue;
+        }
+
+        const key_t key(ready.front());
+        ready.pop_front();
+
+        if(!ready.empty()) {
+            // more for other workers
+            UnGuard U(G);
+            wakeup.signal();
+        }
+
+        pending_t::iterator it(pending.find(key));
+        if(it==pending.end() || it->second.empty())
+            continue; // dropped by stop()?
+
+        Item item(it->second.front());
+
+        epicsTimeStamp now;
+        epicsTimeGetCurrent(&now);
+        double waited = epicsTimeDiffInSeconds(&now, &item.queued);
+        stats.waitTotal += waited;
+        if(stats.waitMax<waited)
+            stats.waitMax = waited;
+        stats.busy++;
+
+        {
+            UnGuard U(G);
+            try {
+                item.work->run();
+            } catch(std::exception& e) {
+                LOG(logLevelError, "Unhandled exception from server request: %s", e.what());
+            }
+            item.work.reset();
+        }
+
+        stats.busy--;
+        stats.completed++;
+        if(stats.queued>0)
+            stats.queued--;
+
+        // pending may have been cleared by stop()
+        it = pending.find(key);
+        if(it!=pending.end()) {
+            it->second.pop_front();
+            if(!it->second.empty())
+                ready.push_back(key);
+            else if(++idle > 64u && idle > pending.size()/2u)
+                sweep();
+        }
+
+        UnGuard U(G);
+        space.signal();
+    }
+}
+
+void RequestPool::sweep()
+{
+    for(pending_t::iterator it(pending.begin()), end(pending.end()); it!=end; ) {
+        if(it->second.empty())
+            pending.erase(it++);
+        else
+            ++it;
+    }
+    idle = 0u;
+}
+
+}
+}
@@ -35,9 +35,11 @@
 #include <pv/serializationHelper.h>
 #include <pv/logger.h>
 #include <pv/pvAccessMB.h>
+#include <pv/pvaProbes.h>
 #include <pv/codec.h>
 #include <pv/rpcServer.h>
 #include <pv/securityImpl.h>
+#include <pv/fieldOffsets.h>
 
 using std::string;
 using std::ostringstream;
@@ -48,6 +50,8 @@ using std::tr1::static_pointer_cast;
 
 using namespace epics::pvData;
 
+MB_DECLARE_EXTERN(pvaRequest);
+
 namespace epics {
 namespace pvAccess {
 
@@ -82,6 +86,146 @@ static PVField::shared_pointer reuseOrCreatePVField(
         return pvDataCreate->createPVField(field);
 }
 
+// the request pool, if operations of this channel may block
+static RequestPool* blockingPool(ServerContextImpl::shared_pointer const & context,
+                                 ServerChannel::shared_pointer const & channel)
+{
+    if (!channel->isBlocking())
+        return NULL;
+    return context->getRequestPool().get();
+}
+
+namespace {
+// provider calls made by the request pool, instead of the receive thread
+
+struct CreateWork : public RequestPool::Work
+{
+    const ServerContextImpl::shared_pointer context;
+    const ServerChannel::shared_pointer channel;
+    const pvAccessID ioid;
+    const Transport::shared_pointer transport;
+    const PVStructure::shared_pointer pvRequest;
+    const int8 command;
+    // CMD_MONITOR with flow control
+    bool ack;
+    int32 nfree;
+
+    CreateWork(ServerContextImpl::shared_pointer const & context, ServerChannel::shared_pointer const & channel,
+               pvAccessID ioid, Transport::shared_pointer const & transport,
+               PVStructure::shared_pointer const & pvRequest, int8 command)
+        :context(context), channel(channel), ioid(ioid), transport(transport)
+        ,pvRequest(pvRequest), command(command), ack(false), nfree(0)
+    {}
+
+    virtual void run() OVERRIDE FINAL
+    {
+        switch (command)
+        {
+        case CMD_GET:
+            ServerChannelGetRequesterImpl::create(context, channel, ioid, transport, pvRequest);
+            break;
+        case CMD_PUT:
+            ServerChannelPutRequesterImpl::create(context, channel, ioid, transport, pvRequest);
+            break;
+        case CMD_PROCESS:
+            ServerChannelProcessRequesterImpl::create(context, channel, ioid, transport, pvRequest);
+            break;
+        case CMD_RPC:
+            ServerChannelRPCRequesterImpl::create(context, channel, ioid, transport, pvRequest);
+            break;
+        case CMD_MONITOR:
+        {
+            ServerMonitorRequesterImpl::shared_pointer request(ServerMonitorRequesterImpl::create(context, channel, ioid, transport, pvRequest));
+            if (ack)
+                request->ack(nfree);
+        }
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+// Work queued by BaseChannelRequester::queueWork() is reused by the requests after while equal
+
+struct GetWork : public RequestPool::Work
+{
+    const ChannelGet::shared_pointer op;
+    explicit GetWork(ChannelGet::shared_pointer const & op) :op(op) {}
+    virtual void run() OVERRIDE FINAL { op->get(); }
+    bool operator==(const GetWork& o) const { return op==o.op; }
+};
+
+struct PutWork : public RequestPool::Work
+{
+    const ChannelPut::shared_pointer op;
+    // NULL for a get
+    const PVStructure::shared_pointer value;
+    const BitSet::shared_pointer changed;
+    PutWork(ChannelPut::shared_pointer const & op,
+            PVStructure::shared_pointer const & value = PVStructure::shared_pointer(),
+            BitSet::shared_pointer const & changed = BitSet::shared_pointer())
+        :op(op), value(value), changed(changed) {}
+    virtual void run() OVERRIDE FINAL
+    {
+        if (value)
+            op->put(value, changed);
+        else
+            op->get();
+    }
+    bool operator==(const PutWork& o) const { return op==o.op && value==o.value && changed==o.changed; }
+};
+
+struct ProcessWork : public RequestPool::Work
+{
+    const ChannelProcess::shared_pointer op;
+    explicit ProcessWork(ChannelProcess::shared_pointer const & op) :op(op) {}
+    virtual void run() OVERRIDE FINAL { op->process(); }
+    bool operator==(const ProcessWork& o) const { return op==o.op; }
+};
+
+// the argument is taken from the requester, so that the Work does not hold the argument
+// which the next request may deserialize into
+struct RPCWork : public RequestPool::Work
+{
+    const ChannelRPC::shared_pointer op;
+    const std::tr1::weak_ptr<ServerChannelRPCRequesterImpl> requester;
+    RPCWork(ChannelRPC::shared_pointer const & op, std::tr1::weak_ptr<ServerChannelRPCRequesterImpl> const & requester)
+        :op(op), requester(requester) {}
+    virtual void run() OVERRIDE FINAL
+    {
+        ServerChannelRPCRequesterImpl::shared_pointer req(requester.lock());
+        if (req)
+            op->request(req->takeArgument());
+    }
+    // only compared with the Work of the same requester
+    bool operator==(const RPCWork& o) const { return op==o.op; }
+};
+
+struct DestroyWork : public RequestPool::Work
+{
+    const ServerChannel::shared_pointer channel;
+    const pvAccessID ioid;
+    const Transport::shared_pointer transport;
+    DestroyWork(ServerChannel::shared_pointer const & channel, pvAccessID ioid,
+                Transport::shared_pointer const & transport)
+        :channel(channel), ioid(ioid), transport(transport) {}
+    virtual void run() OVERRIDE FINAL
+    {
+        // after any create queued earlier
+        Destroyable::shared_pointer request = channel->getRequest(ioid);
+        if (!request.get())
+        {
+            BaseChannelRequester::message(transport, ioid, BaseChannelRequester::badIOIDStatus.getMessage(), warningMessage);
+            return;
+        }
+        request->destroy();
+        channel->unregisterRequest(ioid);
+    }
+};
+
+} // namespace
+
 
 
 void ServerBadResponse::handleResponse(osiSockAddr* responseFrom,
@@ -121,6 +265,7 @@ ServerResponseHandler::ServerResponseHandler(ServerContextImpl::shared_pointer c
     ,handle_rpc(context)
     ,handle_cancel(context)
     ,m_handlerTable(CMD_CANCEL_REQUEST+1, &handle_bad)
+    ,counters(context->getCounters())
 {
 
     m_handlerTable[CMD_BEACON] = &handle_beacon; /*  0 */
@@ -153,6 +298,8 @@ void ServerResponseHandler::handleResponse(osiSockAddr* responseFrom,
         Transport::shared_pointer const & transport, int8 version, int8 command,
         size_t payloadSize, ByteBuffer* payloadBuffer)
 {
+    counters.received[detail::TransportStatistics::commandIndex(command)].increment();
+
     if(command<0||command>=(int8)m_handlerTable.size())
     {
         LOG(logLevelDebug,
@@ -168,6 +315,10 @@ void ServerResponseHandler::handleResponse(osiSockAddr* responseFrom,
         return;
     }
 
+    PVA_PROBE5(server_dispatch, transport.get(), int(command), payloadSize,
+               int(payloadBuffer->getRemaining()>=4u ? payloadBuffer->getInt(payloadBuffer->getPosition()) : -1),
+               int(payloadBuffer->getRemaining()>=8u ? payloadBuffer->getInt(payloadBuffer->getPosition()+4u) : -1));
+
     // delegate
     m_handlerTable[command]->handleResponse(responseFrom, transport,
                                             version, command, payloadSize, payloadBuffer);
@@ -185,10 +336,8 @@ void ServerConnectionValidationHandler::handleResponse(
 
     transport->ensureData(4+2+2);
     transport->setRemoteTransportReceiveBufferSize(payloadBuffer->getInt());
-    // TODO clientIntrospectionRegistryMaxSize
-    /* int clientIntrospectionRegistryMaxSize = */ payloadBuffer->getShort();
-    // TODO connectionQoS
-    /* int16 connectionQoS = */ payloadBuffer->getShort();
+    const int16 clientIntrospectionRegistryMaxSize = payloadBuffer->getShort();
+    const int16 connectionQoS = payloadBuffer->getShort();
 
     // authNZ
     std::string securityPluginName = SerializeHelper::deserializeString(payloadBuffer, transport.get());
@@ -202,6 +351,9 @@ void ServerConnectionValidationHandler::handleResponse(
     //TODO: simplify byzantine class heirarchy...
     assert(casTransport);
 
+    casTransport->setPeerPriority(connectionQoS);
+    casTransport->setRemoteIntrospectionRegistryMaxSize(clientIntrospectionRegistryMaxSize);
+
     casTransport->authNZInitialize(securityPluginName, data);
 }
 
@@ -218,16 +370,47 @@ void ServerEchoHandler::handleResponse(osiSockAddr* responseFrom,
             transport, version, command, payloadSize, payloadBuffer);
 
     // send back
-    TransportSender::shared_pointer echoReply(new EchoTransportSender(responseFrom));
-    transport->enqueueSendRequest(echoReply);
+    transport->enqueueSendRequest(EchoTransportSender::create(responseFrom));
+}
+
+SenderPool<EchoTransportSender> EchoTransportSender::_pool;
+
+TransportSender::shared_pointer EchoTransportSender::create(osiSockAddr* echoFrom)
+{
+    SenderPool<EchoTransportSender>::value_type ret(_pool.get());
+    // not queued, so not shared
+    memcpy(&ret->_echoFrom, echoFrom, sizeof(osiSockAddr));
+    return ret;
 }
 
 /****************************************************************************************/
 
 const std::string ServerSearchHandler::SUPPORTED_PROTOCOL = "tcp";
 
+/* A string of a search request, in name, whose storage is reused by the names of a request.
+ * Read from the receive buffer as one copy, instead of being deserialized as a new string.
+ */
+static void readName(ByteBuffer* buffer, Transport* transport, std::string& name)
+{
+    size_t len = SerializeHelper::readSize(buffer, transport);
+    if (len == size_t(-1))
+        len = 0u; // null
+
+    name.clear();
+    while (name.size() < len)
+    {
+        // from each segment, when split over several
+        if (!buffer->getRemaining())
+            transport->ensureData(1);
+        size_t n = std::min(len - name.size(), buffer->getRemaining());
+        name.append(buffer->getArray() + buffer->getPosition(), n);
+        buffer->setPosition(buffer->getPosition() + n);
+    }
+}
+
 ServerSearchHandler::ServerSearchHandler(ServerContextImpl::shared_pointer const & context) :
-    AbstractServerResponseHandler(context, "Search request")
+    AbstractServerResponseHandler(context, "Search request"),
+    _pool(ServerChannelFindRequesterImpl::createPool())
 {
     // initialize random seed with some random value
     srand ( time(NULL) );
@@ -266,12 +449,15 @@ void ServerSearchHandler::handleResponse(osiSockAddr* responseFrom,
     int16 port = payloadBuffer->getShort();
     responseAddress.ia.sin_port = htons(port);
 
+    // reused by each protocol and channel name
+    string name;
+
     size_t protocolsCount = SerializeHelper::readSize(payloadBuffer, transport.get());
     bool allowed = (protocolsCount == 0);
     for (size_t i = 0; i < protocolsCount; i++)
     {
-        string protocol = SerializeHelper::deserializeString(payloadBuffer, transport.get());
-        if (SUPPORTED_PROTOCOL == protocol)
+        readName(payloadBuffer, transport.get(), name);
+        if (SUPPORTED_PROTOCOL == name)
             allowed = true;
     }
 
@@ -284,6 +470,11 @@ void ServerSearchHandler::handleResponse(osiSockAddr* responseFrom,
     //   You bet!  With a reply address encoded in the request we don't even need a forged UDP header.
     const bool responseRequired = (QOS_REPLY_REQUIRED & qosCode) != 0;
 
+    // searches from a client of a name server arrive over its TCP connection, and are answered through it
+    Transport::shared_pointer replyTransport;
+    if (!dynamic_cast<BlockingUDPTransport*>(transport.get()))
+        replyTransport = transport;
+
     //
     // locally broadcast if unicast (qosCode & 0x80 == 0x80) via UDP
     //
@@ -322,25 +513,86 @@ void ServerSearchHandler::handleResponse(osiSockAddr* responseFrom,
 
     if (count > 0)
     {
+        // gather replies to this request into as few datagrams as possible
+        BlockingUDPTransport::shared_pointer bt(_context->getBroadcastTransport());
+        BlockingUDPTransport::SendHold hold(bt.get());
+
+        const ChannelNameIndex::shared_pointer& index = _context->getChannelNameIndex();
+        const ServerContextImpl::searched_providers_t searched(_context->getSearchedProviders());
+        const std::vector<ChannelProvider::shared_pointer>& _providers = *searched;
+
+        // names not answered from the index are asked of all providers together, when all can be
+        bool batchFind = !_providers.empty();
+        for (size_t i = 0; batchFind && i < _providers.size(); i++)
+            batchFind = !!dynamic_cast<ChannelBatchFind*>(_providers[i].get());
+        std::tr1::shared_ptr<ServerBatchFindRequester> batch;
+
         for (int32 i = 0; i < count; i++)
         {
             transport->ensureData(4);
             const int32 cid = payloadBuffer->getInt();
-            const string name = SerializeHelper::deserializeString(payloadBuffer, transport.get());
+            readName(payloadBuffer, transport.get(), name);
             // no name check here...
 
             if (allowed)
             {
-                const std::vector<ChannelProvider::shared_pointer>& _providers = _context->getChannelProviders();
+                _context->getCounters().searchNames.increment();
+
+                const NameServer::shared_pointer& nameServer = _context->getNameServer();
+                ServerGUID guid;
+                osiSockAddr hostedBy;
+                if (nameServer && nameServer->find(name, guid, hostedBy))
+                {
+                    // hosted by another server
+                    ServerChannelFindRequesterImpl::shared_pointer tp(ServerChannelFindRequesterImpl::create(_context, 1, _pool));
+                    tp->set(name, searchSequenceId, cid, responseAddress, responseRequired, false);
+                    tp->setReplyTransport(replyTransport);
+                    tp->setServer(guid, hostedBy);
+                    tp->channelFindResult(Status::Ok, ChannelFind::shared_pointer(), true);
+                    continue;
+                }
+
+                const ChannelNameIndex::SearchResult known = index->search(name);
+                const bool published = known==ChannelNameIndex::Published;
+                const bool answered = published || known==ChannelNameIndex::Missing || _providers.empty();
+
+                // most searches are for names hosted elsewhere, and need no reply
+                if (answered && !published && !responseRequired)
+                    continue;
 
-                int providerCount = _providers.size();
-                std::tr1::shared_ptr<ServerChannelFindRequesterImpl> tp(new ServerChannelFindRequesterImpl(_context, providerCount));
-                tp->set(name, searchSequenceId, cid, responseAddress, responseRequired, false);
+                if (answered)
+                {
+                    // answered from the index
+                    ServerChannelFindRequesterImpl::shared_pointer tp(ServerChannelFindRequesterImpl::create(_context, 1, _pool));
+                    tp->set(name, searchSequenceId, cid, responseAddress, responseRequired, false);
+                    tp->setReplyTransport(replyTransport);
+                    tp->channelFindResult(Status::Ok, ChannelFind::shared_pointer(), published);
+                }
+                else if (batchFind)
+                {
+                    if (!batch)
+                        batch.reset(new ServerBatchFindRequester(_context, searchSequenceId, responseAddress,
+                                                                 responseRequired, replyTransport, _providers.size()));
+                    batch->add(name, cid);
+                }
+                else
+                {
+                    int providerCount = _providers.size();
+                    ServerChannelFindRequesterImpl::shared_pointer tp(ServerChannelFindRequesterImpl::create(_context, providerCount, _pool));
+                    tp->set(name, searchSequenceId, cid, responseAddress, responseRequired, false, true);
+                    tp->setReplyTransport(replyTransport);
 
-                for (int i = 0; i < providerCount; i++)
-                    _providers[i]->channelFind(name, tp);
+                    for (int i = 0; i < providerCount; i++)
+                        _providers[i]->channelFind(name, tp);
+                }
             }
         }
+
+        if (batch)
+        {
+            for (size_t i = 0; i < _providers.size(); i++)
+                dynamic_cast<ChannelBatchFind*>(_providers[i].get())->channelBatchFind(batch->getNames(), batch);
+        }
     }
     else
     {
@@ -350,8 +602,9 @@ void ServerSearchHandler::handleResponse(osiSockAddr* responseFrom,
 #define MAX_SERVER_SEARCH_RESPONSE_DELAY_MS 100
             double period = (rand() % MAX_SERVER_SEARCH_RESPONSE_DELAY_MS)/(double)1000;
 
-            std::tr1::shared_ptr<ServerChannelFindRequesterImpl> tp(new ServerChannelFindRequesterImpl(_context, 1));
+            ServerChannelFindRequesterImpl::shared_pointer tp(ServerChannelFindRequesterImpl::create(_context, 1, _pool));
             tp->set("", searchSequenceId, 0, responseAddress, true, true);
+            tp->setReplyTransport(replyTransport);
 
             // TODO use std::make_shared
             TimerCallback::shared_pointer tc = tp;
@@ -360,23 +613,183 @@ void ServerSearchHandler::handleResponse(osiSockAddr* responseFrom,
     }
 }
 
-ServerChannelFindRequesterImpl::ServerChannelFindRequesterImpl(ServerContextImpl::shared_pointer const & context,
-        int32 expectedResponseCount) :
-    _guid(context->getGUID()),
+ServerBatchFindRequester::ServerBatchFindRequester(ServerContextImpl::shared_pointer const & context,
+                                                   int32 searchSequenceId, osiSockAddr const & responseAddress,
+                                                   bool responseRequired, Transport::shared_pointer const & replyTransport,
+                                                   size_t providerCount)
+    :_context(context)
+    ,_searchSequenceId(searchSequenceId)
+    ,_responseAddress(responseAddress)
+    ,_responseRequired(responseRequired)
+    ,_replyTransport(replyTransport)
+    ,_pending(providerCount)
+{}
+
+void ServerBatchFindRequester::add(const std::string& name, int32 cid)
+{
+    _names.push_back(name);
+    _cids.push_back(cid);
+}
+
+void ServerBatchFindRequester::channelBatchFindResult(const Status& status, ChannelFind::shared_pointer const & channelFind,
+                                                      const std::vector<bool>& found)
+{
+    {
+        Lock guard(_mutex);
+        if (_pending == 0)
+            return; // more responses than providers
+
+        if (_foundBy.empty())
+            _foundBy.resize(_names.size());
+
+        if (status.isSuccess())
+        {
+            ChannelProvider::shared_pointer provider;
+            if (channelFind)
+                provider = channelFind->getChannelProvider();
+            for (size_t i = 0; i < _names.size() && i < found.size(); i++)
+            {
+                if (!found[i])
+                    continue;
+                if (_foundBy[i].second)
+                    LOG(logLevelDebug, "[ServerBatchFindRequester] Channel '%s' is hosted by different channel providers!", _names[i].c_str());
+                else
+                    _foundBy[i] = std::make_pair(provider, true);
+            }
+        }
+
+        if (--_pending > 0)
+            return;
+    }
+
+    // all providers have answered.  Now only accessed by this thread.
+    const ChannelNameIndex::shared_pointer& index = _context->getChannelNameIndex();
+    const bool several = _context->getChannelProviders().size() > 1;
+
+    BlockingUDPTransport::shared_pointer bt(_context->getBroadcastTransport());
+    BlockingUDPTransport::SendHold hold(bt.get());
+
+    for (size_t i = 0; i < _names.size(); i++)
+    {
+        const bool wasFound = _foundBy[i].second;
+
+        // as ServerChannelFindRequesterImpl with cacheResult
+        if (!wasFound)
+            index->addNegative(_names[i]);
+        else if (several && _foundBy[i].first)
+            index->learn(_names[i], _foundBy[i].first);
+
+        // only those found, or to which a reply is required, are allocated a reply
+        if (wasFound || _responseRequired)
+        {
+            ServerChannelFindRequesterImpl::shared_pointer tp(ServerChannelFindRequesterImpl::create(_context, 1));
+            tp->set(_names[i], _searchSequenceId, _cids[i], _responseAddress, _responseRequired, false);
+            tp->setReplyTransport(_replyTransport.lock());
+            tp->channelFindResult(Status::Ok, ChannelFind::shared_pointer(), wasFound);
+        }
+    }
+}
+
+// idle requesters, reused by later searches instead of allocating each
+struct ServerChannelFindRequesterImpl::Pool
+{
+    POINTER_DEFINITIONS(Pool);
+    static const size_t MAX_IDLE = 1024u;
+
+    epics::pvData::Mutex mutex;
+    std::vector<ServerChannelFindRequesterImpl*> idle;
+
+    ~Pool()
+    {
+        for (size_t i = 0; i < idle.size(); i++)
+            delete idle[i];
+    }
+};
+
+// deleter, which returns a requester to the pool.  Keeps the pool until the last requester is released
+struct ServerChannelFindRequesterImpl::Recycle
+{
+    Pool::shared_pointer pool;
+    explicit Recycle(const Pool::shared_pointer& pool) :pool(pool) {}
+
+    void operator()(ServerChannelFindRequesterImpl* self)
+    {
+        self->clear();
+        {
+            Lock guard(pool->mutex);
+            if (pool->idle.size() < Pool::MAX_IDLE)
+            {
+                pool->idle.push_back(self);
+                return;
+            }
+        }
+        delete self;
+    }
+};
+
+const ServerChannelFindRequesterImpl::Pool::shared_pointer ServerChannelFindRequesterImpl::_pool(new ServerChannelFindRequesterImpl::Pool);
+
+ServerChannelFindRequesterImpl::ServerChannelFindRequesterImpl() :
+    _searchSequenceId(0),
+    _cid(0),
     _sendTo(),
+    _responseRequired(false),
     _wasFound(false),
-    _context(context),
-    _expectedResponseCount(expectedResponseCount),
+    _expectedResponseCount(0),
     _responseCount(0),
-    _serverSearch(false)
+    _serverSearch(false),
+    _cacheResult(false),
+    _otherServer(false)
 {}
 
+ServerChannelFindRequesterImpl::Pool::shared_pointer ServerChannelFindRequesterImpl::createPool()
+{
+    return Pool::shared_pointer(new Pool);
+}
+
+ServerChannelFindRequesterImpl::shared_pointer
+ServerChannelFindRequesterImpl::create(ServerContextImpl::shared_pointer const & context, int32 expectedResponseCount)
+{
+    return create(context, expectedResponseCount, _pool);
+}
+
+ServerChannelFindRequesterImpl::shared_pointer
+ServerChannelFindRequesterImpl::create(ServerContextImpl::shared_pointer const & context, int32 expectedResponseCount,
+                                       Pool::shared_pointer const & pool)
+{
+    ServerChannelFindRequesterImpl* self = 0;
+    {
+        Lock guard(pool->mutex);
+        if (!pool->idle.empty())
+        {
+            self = pool->idle.back();
+            pool->idle.pop_back();
+        }
+    }
+    if (!self)
+        self = new ServerChannelFindRequesterImpl();
+
+    // not yet shared
+    self->_guid = context->getGUID();
+    self->_context = context;
+    self->_expectedResponseCount = expectedResponseCount;
+
+    return shared_pointer(self, Recycle(pool));
+}
+
 void ServerChannelFindRequesterImpl::clear()
 {
     Lock guard(_mutex);
+    // keeps its capacity for the next name
+    _name.clear();
     _wasFound = false;
+    _context.reset();
+    _expectedResponseCount = 0;
     _responseCount = 0;
     _serverSearch = false;
+    _cacheResult = false;
+    _replyTransport.reset();
+    _otherServer = false;
 }
 
 void ServerChannelFindRequesterImpl::callback()
@@ -389,8 +802,8 @@ void ServerChannelFindRequesterImpl::timerStopped()
     // noop
 }
 
-ServerChannelFindRequesterImpl* ServerChannelFindRequesterImpl::set(std::string name, int32 searchSequenceId, int32 cid, osiSockAddr const & sendTo,
-        bool responseRequired, bool serverSearch)
+ServerChannelFindRequesterImpl* ServerChannelFindRequesterImpl::set(const std::string& name, int32 searchSequenceId, int32 cid, osiSockAddr const & sendTo,
+        bool responseRequired, bool serverSearch, bool cacheResult)
 {
     Lock guard(_mutex);
     _name = name;
@@ -399,9 +812,24 @@ ServerChannelFindRequesterImpl* ServerChannelFindRequesterImpl::set(std::string
     _sendTo = sendTo;
     _responseRequired = responseRequired;
     _serverSearch = serverSearch;
+    _cacheResult = cacheResult;
     return this;
 }
 
+void ServerChannelFindRequesterImpl::setReplyTransport(Transport::shared_pointer const & transport)
+{
+    Lock guard(_mutex);
+    _replyTransport = transport;
+}
+
+void ServerChannelFindRequesterImpl::setServer(const ServerGUID& guid, osiSockAddr const & address)
+{
+    Lock guard(_mutex);
+    _guid = guid;
+    _serverAddress = address;
+    _otherServer = true;
+}
+
 void ServerChannelFindRequesterImpl::channelFindResult(const Status& /*status*/, ChannelFind::shared_pointer const & channelFind, bool wasFound)
 {
     // TODO status
@@ -423,20 +851,32 @@ void ServerChannelFindRequesterImpl::channelFindResult(const Status& /*status*/,
         return;
     }
 
+    if (_cacheResult && !wasFound && !_wasFound && _responseCount == _expectedResponseCount)
+    {
+        // no provider has this name
+        _context->getChannelNameIndex()->addNegative(_name);
+    }
+
     if (wasFound || (_responseRequired && (_responseCount == _expectedResponseCount)))
     {
-        if (wasFound && _expectedResponseCount > 1)
+        if (wasFound && _cacheResult && channelFind && _context->getChannelProviders().size() > 1)
         {
-            Lock L(_context->_mutex);
-            _context->s_channelNameToProvider[_name] = channelFind->getChannelProvider();
+            // remember for createChannel
+            ChannelProvider::shared_pointer provider(channelFind->getChannelProvider());
+            if (provider)
+                _context->getChannelNameIndex()->learn(_name, provider);
         }
+        if (wasFound)
+            _context->getCounters().searchFound.increment();
         _wasFound = wasFound;
-        
-        BlockingUDPTransport::shared_pointer bt = _context->getBroadcastTransport();
-        if (bt)
+
+        Transport::shared_pointer replyTransport(_replyTransport.lock());
+        if (!replyTransport)
+            replyTransport = _context->getBroadcastTransport();
+        if (replyTransport)
         {
             TransportSender::shared_pointer thisSender = shared_from_this();
-            bt->enqueueSendRequest(thisSender);
+            replyTransport->enqueueSendRequest(thisSender);
         }
     }
 }
@@ -449,9 +889,18 @@ void ServerChannelFindRequesterImpl::send(ByteBuffer* buffer, TransportSendContr
     buffer->put(_guid.value, 0, sizeof(_guid.value));
     buffer->putInt(_searchSequenceId);
 
-    // NOTE: is it possible (very likely) that address is any local address ::ffff:0.0.0.0
-    encodeAsIPv6Address(buffer, _context->getServerInetAddress());
-    buffer->putShort((int16)_context->getServerPort());
+    if (_otherServer)
+    {
+        // answered by a name server
+        encodeAsIPv6Address(buffer, &_serverAddress);
+        buffer->putShort((int16)ntohs(_serverAddress.ia.sin_port));
+    }
+    else
+    {
+        // NOTE: is it possible (very likely) that address is any local address ::ffff:0.0.0.0
+        encodeAsIPv6Address(buffer, _context->getServerInetAddress());
+        buffer->putShort((int16)_context->getServerPort());
+    }
 
     SerializeHelper::serializeString(ServerSearchHandler::SUPPORTED_PROTOCOL, buffer, control);
 
@@ -524,6 +973,7 @@ private:
     static Structure::const_shared_pointer helpStructure;
     static Structure::const_shared_pointer channelListStructure;
     static Structure::const_shared_pointer infoStructure;
+    static Structure::const_shared_pointer transportsStructure;
 
     static const std::string helpString;
 
@@ -645,6 +1095,69 @@ public:
             result->getSubFieldT<PVString>("startTime")->put(timeText);
 
 
+            return result;
+        }
+        else if (op == "transports")
+        {
+            PVStructure::shared_pointer result =
+                getPVDataCreate()->createPVStructure(transportsStructure);
+
+            TransportRegistry::transportVector_t transports;
+            m_serverContext->getTransportRegistry()->toArray(transports);
+
+            enum {
+                bytesSent, bytesReceived, messagesSent, messagesReceived,
+                sendCalls, recvCalls, partialWrites, sendStallUS, queueDepth, channels,
+                slowSquashed, slowDropped, slowDisconnects,
+                numColumns
+            };
+            static const char* columnNames[numColumns] = {
+                "bytesSent", "bytesReceived", "messagesSent", "messagesReceived",
+                "sendCalls", "recvCalls", "partialWrites", "sendStallUS", "queueDepth", "channels",
+                "slowSquashed", "slowDropped", "slowDisconnects"
+            };
+
+            PVStringArray::svector remote;
+            PVULongArray::svector columns[numColumns];
+
+            for(TransportRegistry::transportVector_t::const_iterator it(transports.begin()), end(transports.end());
+                it!=end; ++it)
+            {
+                const detail::BlockingServerTCPTransportCodec *casTransport =
+                        dynamic_cast<const detail::BlockingServerTCPTransportCodec*>(it->get());
+                if(!casTransport)
+                    continue;
+
+                detail::TransportStatistics stats;
+                casTransport->getStatistics().snapshot(stats);
+
+                remote.push_back(casTransport->getRemoteName());
+                columns[bytesSent].push_back(stats.bytesSent);
+                columns[bytesReceived].push_back(stats.bytesReceived);
+                columns[messagesSent].push_back(stats.totalMessagesSent());
+                columns[messagesReceived].push_back(stats.totalMessagesReceived());
+                columns[sendCalls].push_back(stats.sendCalls);
+                columns[recvCalls].push_back(stats.recvCalls);
+                columns[partialWrites].push_back(stats.partialWrites);
+                columns[sendStallUS].push_back(stats.sendStallUS);
+                columns[queueDepth].push_back(casTransport->getSendQueueDepth());
+                columns[channels].push_back(casTransport->getChannelCount());
+                columns[slowSquashed].push_back(stats.slowSquashed);
+                columns[slowDropped].push_back(stats.slowDropped);
+                columns[slowDisconnects].push_back(stats.slowDisconnects);
+            }
+
+            PVStringArray::svector labels;
+            labels.push_back("remote");
+            for(size_t i=0; i<numColumns; i++)
+                labels.push_back(columnNames[i]);
+            result->getSubFieldT<PVStringArray>("labels")->replace(freeze(labels));
+
+            PVStructure::shared_pointer value(result->getSubFieldT<PVStructure>("value"));
+            value->getSubFieldT<PVStringArray>("remote")->replace(freeze(remote));
+            for(size_t i=0; i<numColumns; i++)
+                value->getSubFieldT<PVULongArray>(columnNames[i])->replace(freeze(columns[i]));
+
             return result;
         }
         else
@@ -678,6 +1191,29 @@ Structure::const_shared_pointer ServerRPCService::infoStructure =
     createStructure();
 
 
+Structure::const_shared_pointer ServerRPCService::transportsStructure =
+    getFieldCreate()->createFieldBuilder()->
+    setId("epics:nt/NTTable:1.0")->
+    addArray("labels", pvString)->
+    addNestedStructure("value")->
+        addArray("remote", pvString)->
+        addArray("bytesSent", pvULong)->
+        addArray("bytesReceived", pvULong)->
+        addArray("messagesSent", pvULong)->
+        addArray("messagesReceived", pvULong)->
+        addArray("sendCalls", pvULong)->
+        addArray("recvCalls", pvULong)->
+        addArray("partialWrites", pvULong)->
+        addArray("sendStallUS", pvULong)->
+        addArray("queueDepth", pvULong)->
+        addArray("channels", pvULong)->
+        addArray("slowSquashed", pvULong)->
+        addArray("slowDropped", pvULong)->
+        addArray("slowDisconnects", pvULong)->
+    endNested()->
+    createStructure();
+
+
 const std::string ServerRPCService::helpString =
     "pvAccess server RPC service.\n"
     "arguments:\n"
@@ -686,6 +1222,7 @@ const std::string ServerRPCService::helpString =
     "\toperations:\n"
     "\t\tinfo\t\treturns some information about the server\n"
     "\t\tchannels\treturns a list of 'static' channels the server can provide\n"
+    "\t\ttransports\treturns traffic counters for each connected client\n"
 //        "\t\t\t (no arguments)\n"
     "\n";
 
@@ -702,40 +1239,50 @@ void ServerCreateChannelHandler::handleResponse(osiSockAddr* responseFrom,
     AbstractServerResponseHandler::handleResponse(responseFrom,
             transport, version, command, payloadSize, payloadBuffer);
 
-    // TODO for not only one request at the time is supported, i.e. dataCount == 1
-    transport->ensureData((sizeof(int32)+sizeof(int16))/sizeof(int8));
+    // any number of channels in one request, each replied to separately
+    transport->ensureData(sizeof(int16)/sizeof(int8));
     const int16 count = payloadBuffer->getShort();
-    if (count != 1)
-    {
-        THROW_BASE_EXCEPTION("only 1 supported for now");
-    }
-    const pvAccessID cid = payloadBuffer->getInt();
 
-    string channelName = SerializeHelper::deserializeString(payloadBuffer, transport.get());
-    if (channelName.size() == 0)
+    for (int16 i = 0; i < count; i++)
     {
+        transport->ensureData(sizeof(int32)/sizeof(int8));
+        const pvAccessID cid = payloadBuffer->getInt();
 
-        char host[100];
-        sockAddrToDottedIP(&transport->getRemoteAddress().sa,host,100);
-        LOG(logLevelDebug,"Zero length channel name, disconnecting client: %s", host);
-        disconnect(transport);
-        return;
-    }
-    else if (channelName.size() > MAX_CHANNEL_NAME_LENGTH)
-    {
-        char host[100];
-        sockAddrToDottedIP(&transport->getRemoteAddress().sa,host,100);
-        LOG(logLevelDebug,"Unreasonable channel name length, disconnecting client: %s", host);
-        disconnect(transport);
-        return;
+        string channelName = SerializeHelper::deserializeString(payloadBuffer, transport.get());
+        if (channelName.size() == 0)
+        {
+
+            char host[100];
+            sockAddrToDottedIP(&transport->getRemoteAddress().sa,host,100);
+            LOG(logLevelDebug,"Zero length channel name, disconnecting client: %s", host);
+            disconnect(transport);
+            return;
+        }
+        else if (channelName.size() > MAX_CHANNEL_NAME_LENGTH)
+        {
+            char host[100];
+            sockAddrToDottedIP(&transport->getRemoteAddress().sa,host,100);
+            LOG(logLevelDebug,"Unreasonable channel name length, disconnecting client: %s", host);
+            disconnect(transport);
+            return;
+        }
+
+        createChannel(transport, cid, channelName);
     }
+}
 
+void ServerCreateChannelHandler::createChannel(Transport::shared_pointer const & transport,
+                                               pvAccessID cid, string const & channelName)
+{
     SecuritySession::shared_pointer securitySession = transport->getSecuritySession();
     ChannelSecuritySession::shared_pointer css;
     try {
         css = securitySession->createChannelSession(channelName);
         if (!css)
             throw SecurityException("null channelSecuritySession");
+        // "none" allows everything, so there is nothing to remember
+        if (_context->isAuthorizationCached() && !dynamic_cast<NoSecurityPlugin*>(css.get()))
+            css.reset(new CachingChannelSecuritySession(css));
     } catch (SecurityException& se) {
         // TODO use std::make_shared
         std::tr1::shared_ptr<ServerChannelRequesterImpl> tp(new ServerChannelRequesterImpl(transport, channelName, cid, css));
@@ -761,17 +1308,11 @@ void ServerCreateChannelHandler::handleResponse(osiSockAddr* responseFrom,
     else
     {
         const std::vector<ChannelProvider::shared_pointer>& _providers(_context->getChannelProviders());
-        ServerContextImpl::s_channelNameToProvider_t::const_iterator it;
 
         if (_providers.size() == 1)
             ServerChannelRequesterImpl::create(_providers[0], transport, channelName, cid, css);
         else {
-            ChannelProvider::shared_pointer prov;
-            {
-                Lock L(_context->_mutex);
-                if((it = _context->s_channelNameToProvider.find(channelName)) != _context->s_channelNameToProvider.end())
-                    prov = it->second.lock();
-            }
+            ChannelProvider::shared_pointer prov(_context->getChannelNameIndex()->find(channelName, false));
             if(prov)
                 ServerChannelRequesterImpl::create(prov, transport, channelName, cid, css);
         }
@@ -902,8 +1443,7 @@ void ServerChannelRequesterImpl::channelStateChange(Channel::shared_pointer cons
         transport->unregisterChannel(channel->getSID());
 
         // send response back
-        TransportSender::shared_pointer sr(new ServerDestroyChannelHandlerTransportSender(channel->getCID(), channel->getSID()));
-        transport->enqueueSendRequest(sr);
+        transport->enqueueSendRequest(ServerDestroyChannelHandlerTransportSender::create(channel->getCID(), channel->getSID()));
     }
 }
 
@@ -993,8 +1533,18 @@ void ServerDestroyChannelHandler::handleResponse(osiSockAddr* responseFrom,
     casTransport->unregisterChannel(sid);
 
     // send response back
-    TransportSender::shared_pointer sr(new ServerDestroyChannelHandlerTransportSender(cid, sid));
-    transport->enqueueSendRequest(sr);
+    transport->enqueueSendRequest(ServerDestroyChannelHandlerTransportSender::create(cid, sid));
+}
+
+SenderPool<ServerDestroyChannelHandlerTransportSender> ServerDestroyChannelHandlerTransportSender::_pool;
+
+TransportSender::shared_pointer ServerDestroyChannelHandlerTransportSender::create(pvAccessID cid, pvAccessID sid)
+{
+    SenderPool<ServerDestroyChannelHandlerTransportSender>::value_type ret(_pool.get());
+    // not queued, so not shared
+    ret->_cid = cid;
+    ret->_sid = sid;
+    return ret;
 }
 
 /****************************************************************************************/
@@ -1013,6 +1563,8 @@ void ServerGetHandler::handleResponse(osiSockAddr* responseFrom,
     const pvAccessID sid = payloadBuffer->getInt();
     const pvAccessID ioid = payloadBuffer->getInt();
 
+    MB_POINT_ID(pvaRequest, 10, "server get received", ioid);
+
     // mode
     const int8 qosCode = payloadBuffer->getByte();
 
@@ -1038,7 +1590,10 @@ void ServerGetHandler::handleResponse(osiSockAddr* responseFrom,
         }
 
         // create...
-        ServerChannelGetRequesterImpl::create(_context, channel, ioid, transport, pvRequest);
+        if (RequestPool* pool = blockingPool(_context, channel))
+            pool->queue(channel.get(), ioid, RequestPool::Work::shared_pointer(new CreateWork(_context, channel, ioid, transport, pvRequest, CMD_GET)));
+        else
+            ServerChannelGetRequesterImpl::create(_context, channel, ioid, transport, pvRequest);
     }
     else
     {
@@ -1053,7 +1608,11 @@ void ServerGetHandler::handleResponse(osiSockAddr* responseFrom,
 
         if (!request->startRequest(qosCode))
         {
-            BaseChannelRequester::sendFailureMessage((int8)CMD_GET, transport, ioid, qosCode, BaseChannelRequester::otherRequestPendingStatus);
+            // pipelined.  Dispatched by send() of the response before it
+            if (request->canQueueRequest())
+                request->queueRequest(qosCode);
+            else
+                BaseChannelRequester::sendFailureMessage((int8)CMD_GET, transport, ioid, qosCode, BaseChannelRequester::otherRequestPendingStatus);
             return;
         }
 
@@ -1070,7 +1629,16 @@ void ServerGetHandler::handleResponse(osiSockAddr* responseFrom,
         ChannelGet::shared_pointer channelGet = request->getChannelGet();
         if (lastRequest)
             channelGet->lastRequest();
-        channelGet->get();
+        TraceContext trace;
+        const bool traced = request->traceDispatch(trace);
+        if (RequestPool* pool = blockingPool(_context, channel))
+            request->queueWork(*pool, GetWork(channelGet));
+        else {
+            TraceScope scope(traced ? &trace : 0);
+            channelGet->get();
+        }
+
+        MB_POINT_ID(pvaRequest, 11, "provider get() returned", ioid);
     }
 }
 
@@ -1106,10 +1674,62 @@ void ServerGetHandler::handleResponse(osiSockAddr* responseFrom,
 	    throw; \
     }
 
-ServerChannelGetRequesterImpl::ServerChannelGetRequesterImpl(ServerContextImpl::shared_pointer const & context, ServerChannel::shared_pointer const & channel, const pvAccessID ioid, Transport::shared_pointer const & transport) :
-    BaseChannelRequester(context, channel, ioid, transport)
+namespace {
 
+// serialize into a growing vector, for SharedUpdate.
+// Only used for types without unions, which need the introspection cache of a connection.
+struct BlobControl : public SerializableControl
 {
+    ByteBuffer buffer;
+    SharedUpdate::bytes_t out;
+
+    explicit BlobControl(int byteOrder) :buffer(16*1024, byteOrder) {}
+    virtual ~BlobControl() {}
+
+    virtual void flushSerializeBuffer() OVERRIDE FINAL {
+        buffer.flip();
+        out.insert(out.end(), buffer.getArray(), buffer.getArray()+buffer.getLimit());
+        buffer.clear();
+    }
+    virtual void ensureBuffer(std::size_t size) OVERRIDE FINAL {
+        if(buffer.getRemaining()<size)
+            flushSerializeBuffer();
+        if(buffer.getRemaining()<size)
+            throw std::logic_error("BlobControl::ensureBuffer() size too large");
+    }
+    virtual void alignBuffer(std::size_t) OVERRIDE FINAL {}
+    virtual bool directSerialize(ByteBuffer*, const char*, std::size_t, std::size_t) OVERRIDE FINAL {
+        return false;
+    }
+    virtual void cachedSerialize(std::tr1::shared_ptr<const Field> const &, ByteBuffer*) OVERRIDE FINAL {
+        throw std::logic_error("BlobControl can't serialize introspection data");
+    }
+};
+
+// copy bytes through the send buffer, or with a gathering write if large
+void putBytes(ByteBuffer* buffer, TransportSendControl* control, const char* bytes, size_t count)
+{
+    if(control->directSerialize(buffer, bytes, count, 1u))
+        return;
+    while(count) {
+        size_t n = std::min(count, buffer->getRemaining());
+        if(n==0) {
+            control->flushSerializeBuffer();
+            continue;
+        }
+        buffer->put(bytes, 0, n);
+        bytes += n;
+        count -= n;
+    }
+}
+
+} // namespace
+
+ServerChannelGetRequesterImpl::ServerChannelGetRequesterImpl(ServerContextImpl::shared_pointer const & context, ServerChannel::shared_pointer const & channel, const pvAccessID ioid, Transport::shared_pointer const & transport) :
+    BaseChannelRequester(context, channel, ioid, transport),
+    _cacheable(false)
+{
+    bytesCounter = &channel->stats().bytesSent;
 }
 
 ChannelGetRequester::shared_pointer ServerChannelGetRequesterImpl::create(ServerContextImpl::shared_pointer const & context, ServerChannel::shared_pointer const & channel, const pvAccessID ioid, Transport::shared_pointer const & transport,
@@ -1141,6 +1761,7 @@ void ServerChannelGetRequesterImpl::channelGetConnect(const Status& status, Chan
         {
             _pvStructure = std::tr1::static_pointer_cast<PVStructure>(reuseOrCreatePVField(structure, _pvStructure));
             _bitSet = createBitSetFor(_pvStructure, _bitSet);
+            _cacheable = !SerializationHelper::hasUnion(*structure);
         }
     }
 
@@ -1154,9 +1775,14 @@ void ServerChannelGetRequesterImpl::channelGetConnect(const Status& status, Chan
     }
 }
 
-void ServerChannelGetRequesterImpl::getDone(const Status& status, ChannelGet::shared_pointer const & /*channelGet*/,
+void ServerChannelGetRequesterImpl::getDone(const Status& status, ChannelGet::shared_pointer const & channelGet,
         PVStructure::shared_pointer const & pvStructure, BitSet::shared_pointer const & bitSet)
 {
+    // an unchanged value is serialized as for an earlier get()
+    SharedUpdate::shared_pointer responses;
+    if (status.isSuccess() && channelGet)
+        responses = _channel->getResponses(channelGet->getGeneration());
+
     {
         Lock guard(_mutex);
         _status = status;
@@ -1165,8 +1791,11 @@ void ServerChannelGetRequesterImpl::getDone(const Status& status, ChannelGet::sh
             *_bitSet = *bitSet;
             _pvStructure->copyUnchecked(*pvStructure, *_bitSet);
         }
+        _responses.swap(responses);
     }
 
+    MB_POINT_ID(pvaRequest, 12, "server getDone()", _ioid);
+
     TransportSender::shared_pointer thisSender = shared_from_this();
     _transport->enqueueSendRequest(thisSender);
 }
@@ -1181,8 +1810,11 @@ void ServerChannelGetRequesterImpl::destroy()
     // hold a reference to channelGet so that _channelGet.reset()
     // does not call ~ChannelGet (external code) while we are holding a lock
     ChannelGet::shared_pointer channelGet = _channelGet;
+    RequestPool::Work::shared_pointer work;
     {
         Lock guard(_mutex);
+        clearQueued();
+        work.swap(_work);
         _channel->unregisterRequest(_ioid);
 
         // asCheck
@@ -1201,6 +1833,40 @@ ChannelGet::shared_pointer ServerChannelGetRequesterImpl::getChannelGet()
     return _channelGet;
 }
 
+void ServerChannelGetRequesterImpl::dispatchQueued()
+{
+    int32 qos;
+    while (startQueued(qos))
+    {
+        const bool lastRequest = (QOS_DESTROY & qos) != 0;
+
+        // asCheck, answered in order
+        Status asStatus = _channel->getChannelSecuritySession()->authorizeGet(_ioid);
+        if (!asStatus.isSuccess())
+        {
+            stopRequest();
+            sendFailureMessage((int8)CMD_GET, _transport, _ioid, (int8)qos, asStatus);
+            if (lastRequest)
+            {
+                destroy();
+                return;
+            }
+            continue;
+        }
+
+        ChannelGet::shared_pointer channelGet = getChannelGet();
+        if (!channelGet)
+            return;
+        if (lastRequest)
+            channelGet->lastRequest();
+        if (RequestPool* pool = blockingPool(_context, _channel))
+            queueWork(*pool, GetWork(channelGet));
+        else
+            channelGet->get();
+        return;
+    }
+}
+
 // TODO get rid of all these mutex-es
 void ServerChannelGetRequesterImpl::send(ByteBuffer* buffer, TransportSendControl* control)
 {
@@ -1215,6 +1881,8 @@ void ServerChannelGetRequesterImpl::send(ByteBuffer* buffer, TransportSendContro
             return;
     }
 
+    traceSend(buffer, control);
+
     control->startMessage((int8)CMD_GET, sizeof(int32)/sizeof(int8) + 1);
     buffer->putInt(_ioid);
     buffer->put((int8)request);
@@ -1228,7 +1896,7 @@ void ServerChannelGetRequesterImpl::send(ByteBuffer* buffer, TransportSendContro
     // since between last serialization data and stopRequest() a buffer can be already flushed
     // (i.e. in case of directSerialize)
     // if we call it here, then a bad client can issue another request just after stopRequest() was called
-    stopRequest();
+    stopRequest((int8)CMD_GET);
 
     if (_status.isSuccess())
     {
@@ -1241,11 +1909,47 @@ void ServerChannelGetRequesterImpl::send(ByteBuffer* buffer, TransportSendContro
         {
             ScopedLock lock(channelGet);
 
-            _bitSet->serialize(buffer, control);
-            _pvStructure->serialize(buffer, control, _bitSet.get());
+            SharedUpdate::shared_pointer responses;
+            {
+                Lock guard(_mutex);
+                if (_cacheable)
+                    responses = _responses;
+            }
+
+            if (responses)
+            {
+                const StructureConstPtr& type(_pvStructure->getStructure());
+                const int byteOrder = buffer->reverse<int32>()
+                        ? (EPICS_BYTE_ORDER==EPICS_ENDIAN_BIG ? EPICS_ENDIAN_LITTLE : EPICS_ENDIAN_BIG)
+                        : EPICS_BYTE_ORDER;
+                const BitSet none;
+
+                std::tr1::shared_ptr<const SharedUpdate::bytes_t> bytes(responses->find(type, byteOrder, *_bitSet, none));
+                if (!bytes) {
+                    BlobControl blob(byteOrder);
+                    _bitSet->serialize(&blob.buffer, &blob);
+                    serializeChanged(&blob.buffer, &blob, *_pvStructure, *_bitSet);
+                    blob.flushSerializeBuffer();
+
+                    std::tr1::shared_ptr<SharedUpdate::bytes_t> temp(new SharedUpdate::bytes_t);
+                    temp->swap(blob.out);
+                    bytes = temp;
+                    responses->store(type, byteOrder, *_bitSet, none, bytes);
+                }
+
+                if (!bytes->empty())
+                    putBytes(buffer, control, &(*bytes)[0], bytes->size());
+            }
+            else
+            {
+                _bitSet->serialize(buffer, control);
+                serializeChanged(buffer, control, *_pvStructure, *_bitSet);
+            }
         }
     }
 
+    MB_POINT_ID(pvaRequest, 13, "server get serialized", _ioid);
+
     //stopRequest();
 
     // lastRequest
@@ -1253,6 +1957,10 @@ void ServerChannelGetRequesterImpl::send(ByteBuffer* buffer, TransportSendContro
     {
         destroy();
     }
+    else
+    {
+        dispatchQueued();
+    }
 }
 /****************************************************************************************/
 void ServerPutHandler::handleResponse(osiSockAddr* responseFrom,
@@ -1294,7 +2002,10 @@ void ServerPutHandler::handleResponse(osiSockAddr* responseFrom,
         }
 
         // create...
-        ServerChannelPutRequesterImpl::create(_context, channel, ioid, transport, pvRequest);
+        if (RequestPool* pool = blockingPool(_context, channel))
+            pool->queue(channel.get(), ioid, RequestPool::Work::shared_pointer(new CreateWork(_context, channel, ioid, transport, pvRequest, CMD_PUT)));
+        else
+            ServerChannelPutRequesterImpl::create(_context, channel, ioid, transport, pvRequest);
     }
     else
     {
@@ -1308,9 +2019,27 @@ void ServerPutHandler::handleResponse(osiSockAddr* responseFrom,
             return;
         }
 
-        if (!request->startRequest(qosCode))
-        {
-            BaseChannelRequester::sendFailureMessage((int8)CMD_PUT, transport, ioid, qosCode, BaseChannelRequester::otherRequestPendingStatus);
+        if (!request->startRequest(qosCode))
+        {
+            if (!request->canQueueRequest())
+            {
+                BaseChannelRequester::sendFailureMessage((int8)CMD_PUT, transport, ioid, qosCode, BaseChannelRequester::otherRequestPendingStatus);
+                return;
+            }
+
+            // pipelined.  Dispatched by send() of the response before it,
+            // while the pending put() may still use the value of the request
+            PVStructure::shared_pointer value;
+            BitSet::shared_pointer changed;
+            if (!get)
+            {
+                request->spareValue(value, changed);
+                DESERIALIZE_EXCEPTION_GUARD(
+                    changed->deserialize(payloadBuffer, transport.get());
+                    value->deserialize(payloadBuffer, transport.get(), changed.get());
+                );
+            }
+            request->queuePut(qosCode, value, changed);
             return;
         }
 
@@ -1331,7 +2060,14 @@ void ServerPutHandler::handleResponse(osiSockAddr* responseFrom,
                 return;
             }
 
-            channelPut->get();
+            TraceContext trace;
+            const bool traced = request->traceDispatch(trace);
+            if (RequestPool* pool = blockingPool(_context, channel))
+                request->queueWork(*pool, PutWork(channelPut));
+            else {
+                TraceScope scope(traced ? &trace : 0);
+                channelPut->get();
+            }
         }
         else
         {
@@ -1359,7 +2095,14 @@ void ServerPutHandler::handleResponse(osiSockAddr* responseFrom,
                     return;
                 }
 
-                channelPut->put(putPVStructure, putBitSet);
+                TraceContext trace;
+                const bool traced = request->traceDispatch(trace);
+                if (RequestPool* pool = blockingPool(_context, channel))
+                    request->queueWork(*pool, PutWork(channelPut, putPVStructure, putBitSet));
+                else {
+                    TraceScope scope(traced ? &trace : 0);
+                    channelPut->put(putPVStructure, putBitSet);
+                }
             }
         }
     }
@@ -1369,6 +2112,7 @@ ServerChannelPutRequesterImpl::ServerChannelPutRequesterImpl(ServerContextImpl::
         const pvAccessID ioid, Transport::shared_pointer const & transport):
     BaseChannelRequester(context, channel, ioid, transport)
 {
+    bytesCounter = &channel->stats().bytesSent;
 }
 
 ChannelPutRequester::shared_pointer ServerChannelPutRequesterImpl::create(ServerContextImpl::shared_pointer const & context, ServerChannel::shared_pointer const & channel,
@@ -1447,8 +2191,12 @@ void ServerChannelPutRequesterImpl::destroy()
     // hold a reference to channelGet so that _channelPut.reset()
     // does not call ~ChannelPut (external code) while we are holding a lock
     ChannelPut::shared_pointer channelPut = _channelPut;
+    RequestPool::Work::shared_pointer work;
     {
         Lock guard(_mutex);
+        clearQueued();
+        _queuedValues.clear();
+        work.swap(_work);
         _channel->unregisterRequest(_ioid);
 
         // asCheck
@@ -1480,6 +2228,83 @@ PVStructure::shared_pointer ServerChannelPutRequesterImpl::getPutPVStructure()
     return _pvStructure;
 }
 
+void ServerChannelPutRequesterImpl::spareValue(PVStructure::shared_pointer& value, BitSet::shared_pointer& changed)
+{
+    Lock guard(_mutex);
+    if (!_spareValues.empty())
+    {
+        value = _spareValues.back().first;
+        changed = _spareValues.back().second;
+        _spareValues.pop_back();
+    }
+    else
+    {
+        value = pvDataCreate->createPVStructure(_pvStructure->getStructure());
+        changed = createBitSetFor(value, BitSet::shared_pointer());
+    }
+}
+
+void ServerChannelPutRequesterImpl::queuePut(int32 qos, PVStructure::shared_pointer const & value,
+                                             BitSet::shared_pointer const & changed)
+{
+    Lock guard(_mutex);
+    queueRequest(qos);
+    _queuedValues.push_back(value_t(value, changed));
+}
+
+void ServerChannelPutRequesterImpl::dispatchQueued()
+{
+    int32 qos;
+    value_t value;
+    while (true)
+    {
+        {
+            Lock guard(_mutex);
+            if (!startQueued(qos))
+                return;
+            value = _activeValue = _queuedValues.front();
+            _queuedValues.pop_front();
+        }
+
+        const bool lastRequest = (QOS_DESTROY & qos) != 0;
+        const bool get = (QOS_GET & qos) != 0;
+
+        // asCheck, answered in order
+        Status asStatus = get ? _channel->getChannelSecuritySession()->authorizeGet(_ioid)
+                              : _channel->getChannelSecuritySession()->authorizePut(_ioid, value.first, value.second);
+        if (!asStatus.isSuccess())
+        {
+            {
+                Lock guard(_mutex);
+                if (_activeValue.first)
+                    _spareValues.push_back(_activeValue);
+                _activeValue = value_t();
+            }
+            stopRequest();
+            sendFailureMessage((int8)CMD_PUT, _transport, _ioid, (int8)qos, asStatus);
+            if (lastRequest)
+            {
+                destroy();
+                return;
+            }
+            continue;
+        }
+
+        ChannelPut::shared_pointer channelPut = getChannelPut();
+        if (!channelPut)
+            return;
+        if (lastRequest)
+            channelPut->lastRequest();
+        if (RequestPool* pool = blockingPool(_context, _channel))
+            queueWork(*pool, PutWork(channelPut, value.first, value.second));
+        else if (get)
+            channelPut->get();
+        else
+            channelPut->put(value.first, value.second);
+        return;
+    }
+}
+
 void ServerChannelPutRequesterImpl::send(ByteBuffer* buffer, TransportSendControl* control)
 {
     const int32 request = getPendingRequest();
@@ -1493,6 +2318,8 @@ void ServerChannelPutRequesterImpl::send(ByteBuffer* buffer, TransportSendContro
             return;
     }
 
+    traceSend(buffer, control);
+
     control->startMessage((int32)CMD_PUT, sizeof(int32)/sizeof(int8) + 1);
     buffer->putInt(_ioid);
     buffer->putByte((int8)request);
@@ -1516,11 +2343,21 @@ void ServerChannelPutRequesterImpl::send(ByteBuffer* buffer, TransportSendContro
         }
     }
 
-    stopRequest();
+    {
+        // before stopRequest() lets the next be dispatched
+        Lock guard(_mutex);
+        if (_activeValue.first)
+            _spareValues.push_back(_activeValue);
+        _activeValue = value_t();
+    }
+
+    stopRequest((int8)CMD_PUT);
 
     // lastRequest
     if ((QOS_DESTROY & request) != 0)
         destroy();
+    else
+        dispatchQueued();
 }
 
 
@@ -1651,6 +2488,7 @@ ServerChannelPutGetRequesterImpl::ServerChannelPutGetRequesterImpl(ServerContext
         const pvAccessID ioid, Transport::shared_pointer const & transport):
     BaseChannelRequester(context, channel, ioid, transport), _channelPutGet(), _pvPutStructure(), _pvGetStructure()
 {
+    bytesCounter = &channel->stats().bytesSent;
 }
 
 ChannelPutGetRequester::shared_pointer ServerChannelPutGetRequesterImpl::create(ServerContextImpl::shared_pointer const & context, ServerChannel::shared_pointer const & channel,
@@ -1840,7 +2678,7 @@ void ServerChannelPutGetRequesterImpl::send(ByteBuffer* buffer, TransportSendCon
         }
     }
 
-    stopRequest();
+    stopRequest((int8)CMD_PUT_GET);
 
     // lastRequest
     if ((QOS_DESTROY & request) != 0)
@@ -1885,17 +2723,29 @@ void ServerMonitorHandler::handleResponse(osiSockAddr* responseFrom,
             return;
         }
 
-        // create...
-        ServerMonitorRequesterImpl::shared_pointer request(ServerMonitorRequesterImpl::create(_context, channel, ioid, transport, pvRequest));
-
         // pipelining monitor (i.e. w/ flow control)
         const bool ack = (QOS_GET_PUT & qosCode) != 0;
+        int32 nfree = 0;
         if (ack)
         {
             transport->ensureData(4);
-            int32 nfree = payloadBuffer->getInt();
+            nfree = payloadBuffer->getInt();
+        }
 
-            request->ack(nfree);
+        if (RequestPool* pool = blockingPool(_context, channel))
+        {
+            std::tr1::shared_ptr<CreateWork> work(new CreateWork(_context, channel, ioid, transport, pvRequest, CMD_MONITOR));
+            work->ack = ack;
+            work->nfree = nfree;
+            pool->queue(channel.get(), ioid, work);
+        }
+        else
+        {
+            // create...
+            ServerMonitorRequesterImpl::shared_pointer request(ServerMonitorRequesterImpl::create(_context, channel, ioid, transport, pvRequest));
+
+            if (ack)
+                request->ack(nfree);
         }
 
     }
@@ -1959,6 +2809,13 @@ void ServerMonitorHandler::handleResponse(osiSockAddr* responseFrom,
     }
 }
 
+namespace {
+
+// seconds between checks of whether a slow client has caught up
+const double slowConsumerRetry = 0.1;
+
+} // namespace
+
 ServerMonitorRequesterImpl::ServerMonitorRequesterImpl(
         ServerContextImpl::shared_pointer const & context,
         ServerChannel::shared_pointer const & channel,
@@ -1967,7 +2824,21 @@ ServerMonitorRequesterImpl::ServerMonitorRequesterImpl(
     ,_window_open(0u)
     ,_unlisten(false)
     ,_pipeline(false)
-{}
+    ,_minPeriod(0.0)
+    ,_conflate(false)
+    ,_squashReady(false)
+    ,_squashCount(0u)
+    ,_holdoff(false)
+    ,_timer(context->getTimer())
+    ,_cacheable(false)
+{
+    bytesCounter = &channel->stats().bytesSent;
+    // monitor updates yield to replies to other requests
+    setQueueLevel(LEVEL_BULK);
+    // first update is not delayed
+    _lastSend.secPastEpoch = 0;
+    _lastSend.nsec = 0;
+}
 
 ServerMonitorRequesterImpl::shared_pointer ServerMonitorRequesterImpl::create(
     ServerContextImpl::shared_pointer const & context, ServerChannel::shared_pointer const & channel,
@@ -1990,20 +2861,122 @@ void ServerMonitorRequesterImpl::activate(PVStructure::shared_pointer const & pv
             message(strm.str(), epics::pvData::errorMessage);
         }
     }
+    // rate limit.  record[rate=5.0] in Hz, or record[dt=0.2] in seconds
+    O = pvRequest->getSubField<epics::pvData::PVScalar>("record._options.rate");
+    if(O) {
+        try{
+            double rate = O->getAs<double>();
+            if(rate>0.0)
+                _minPeriod = 1.0/rate;
+        }catch(std::exception& e){
+            std::ostringstream strm;
+            strm<<"Ignoring invalid rate= : "<<e.what();
+            message(strm.str(), epics::pvData::errorMessage);
+        }
+    }
+    // send changed ranges of arrays.  record[arrayDelta=true]
+    O = pvRequest->getSubField<epics::pvData::PVScalar>("record._options.arrayDelta");
+    if(O) {
+        try{
+            if(O->getAs<epics::pvData::boolean>())
+                _arrayDelta.reset(new ArrayDeltaEncoder);
+        }catch(std::exception& e){
+            std::ostringstream strm;
+            strm<<"Ignoring invalid arrayDelta= : "<<e.what();
+            message(strm.str(), epics::pvData::errorMessage);
+        }
+    }
+    O = pvRequest->getSubField<epics::pvData::PVScalar>("record._options.dt");
+    if(O) {
+        try{
+            double dt = O->getAs<double>();
+            if(dt>0.0)
+                _minPeriod = dt;
+        }catch(std::exception& e){
+            std::ostringstream strm;
+            strm<<"Ignoring invalid dt= : "<<e.what();
+            message(strm.str(), epics::pvData::errorMessage);
+        }
+    }
+    // filters.  eg. field(value[deadband=abs:1.0])
+    PVStructure::const_shared_pointer fields(pvRequest->getSubField<PVStructure>("field"));
+    if(fields)
+        findFilters(*fields, std::string());
+
+    _conflate = _minPeriod>0.0 || !_filterRequests.empty();
+
     startRequest(QOS_INIT);
     shared_pointer thisPointer(shared_from_this());
     _channel->registerRequest(_ioid, thisPointer);
     INIT_EXCEPTION_GUARD(CMD_MONITOR, _channelMonitor, _channel->getChannel()->createMonitor(thisPointer, pvRequest));
 }
 
+void ServerMonitorRequesterImpl::findFilters(const PVStructure& request, const std::string& path)
+{
+    const PVFieldPtrArray& subs(request.getPVFields());
+    for(size_t i=0; i<subs.size(); i++) {
+        const PVStructure* sub(dynamic_cast<const PVStructure*>(subs[i].get()));
+        if(!sub)
+            continue;
+
+        const std::string& name(subs[i]->getFieldName());
+        if(name!="_options") {
+            findFilters(*sub, path.empty() ? name : path+"."+name);
+            continue;
+        }
+
+        const PVFieldPtrArray& opts(sub->getPVFields());
+        for(size_t j=0; j<opts.size(); j++) {
+            const PVScalar* opt(dynamic_cast<const PVScalar*>(opts[j].get()));
+            if(!opt)
+                continue;
+            // others may be for the provider
+            MonitorFilterPlugin::shared_pointer plugin(MonitorFilterRegistry::instance().find(opt->getFieldName()));
+            if(!plugin)
+                continue;
+
+            FilterRequest req;
+            req.path = path;
+            req.plugin = plugin;
+            req.arg = opt->getAs<std::string>();
+            _filterRequests.push_back(req);
+        }
+    }
+}
+
 void ServerMonitorRequesterImpl::monitorConnect(const Status& status, Monitor::shared_pointer const & monitor, epics::pvData::StructureConstPtr const & structure)
 {
+    std::vector<std::string> errors;
     {
         Lock guard(_mutex);
         _status = status;
         _channelMonitor = monitor;
         _structure = structure;
+        _cacheable = structure && !SerializationHelper::hasUnion(*structure);
+
+        if(_conflate && status.isSuccess() && structure && !_squashed) {
+            _squashed.reset(new MonitorElement(getPVDataCreate()->createPVStructure(structure)));
+
+            for(size_t i=0; i<_filterRequests.size(); i++) {
+                const FilterRequest& req(_filterRequests[i]);
+                PVFieldPtr field(req.path.empty() ? PVFieldPtr(_squashed->pvStructurePtr)
+                                                  : _squashed->pvStructurePtr->getSubField(req.path));
+                try {
+                    if(!field)
+                        throw std::runtime_error("no such field");
+                    MonitorFilter::shared_pointer filter(req.plugin->create(req.arg, field));
+                    if(filter)
+                        _filters.push_back(filter);
+                } catch(std::exception& e) {
+                    std::ostringstream strm;
+                    strm<<"Ignoring "<<req.plugin->getId()<<"="<<req.arg<<" for '"<<req.path<<"' : "<<e.what();
+                    errors.push_back(strm.str());
+                }
+            }
+        }
     }
+    for(size_t i=0; i<errors.size(); i++)
+        message(errors[i], epics::pvData::warningMessage);
     TransportSender::shared_pointer thisSender = shared_from_this();
     _transport->enqueueSendRequest(thisSender);
 
@@ -2053,10 +3026,14 @@ void ServerMonitorRequesterImpl::destroy()
     // does not call ~Monitor (external code) while we are holding a lock
     Monitor::shared_pointer monitor;
     window_t window;
+    bool holdoff;
     {
         Lock guard(_mutex);
         _channel->unregisterRequest(_ioid);
 
+        holdoff = _holdoff;
+        _holdoff = false;
+
         // asCheck
         _channel->getChannelSecuritySession()->release(_ioid);
 
@@ -2065,17 +3042,64 @@ void ServerMonitorRequesterImpl::destroy()
         monitor.swap(_channelMonitor);
     }
     window.clear();
+    if(holdoff) {
+        TimerCallback::shared_pointer tc(self);
+        _timer->cancel(tc);
+    }
     if(monitor) {
         monitor->destroy();
     }
 }
 
+bool ServerMonitorRequesterImpl::squash(const MonitorElementPtr& element)
+{
+    if(!element->changedBitSet)
+        return true; // notify only
+
+    if(!_squashed)
+        _squashed.reset(new MonitorElement(getPVDataCreate()->createPVStructure(element->pvStructurePtr->getStructure())));
+
+    // as MonitorFIFO::post() in overflow.  Masks are cleared after sending
+    _squashed->pvStructurePtr->copyUnchecked(*element->pvStructurePtr, *element->changedBitSet);
+    _squashed->overrunBitSet->or_and(*_squashed->changedBitSet, *element->changedBitSet);
+    *_squashed->changedBitSet |= *element->changedBitSet;
+    *_squashed->overrunBitSet |= *element->overrunBitSet;
+
+    // every filter sees every update
+    bool pass = true;
+    for(size_t i=0; i<_filters.size(); i++)
+        pass = _filters[i]->filter(*element->changedBitSet) && pass;
+    return pass;
+}
+
+void ServerMonitorRequesterImpl::callback()
+{
+    {
+        Lock guard(_mutex);
+        _holdoff = false;
+    }
+    TransportSender::shared_pointer thisSender = shared_from_this();
+    _transport->enqueueSendRequest(thisSender);
+}
+
+void ServerMonitorRequesterImpl::timerStopped()
+{
+    // noop
+}
+
 Monitor::shared_pointer ServerMonitorRequesterImpl::getChannelMonitor()
 {
     Lock guard(_mutex);
     return _channelMonitor;
 }
 
+size_t ServerMonitorRequesterImpl::memoryUsage()
+{
+    Monitor::shared_pointer monitor(getChannelMonitor());
+    const MonitorFIFO *fifo = dynamic_cast<const MonitorFIFO*>(monitor.get());
+    return fifo ? fifo->memoryUsage() : 0u;
+}
+
 void ServerMonitorRequesterImpl::send(ByteBuffer* buffer, TransportSendControl* control)
 {
     const int32 request = getPendingRequest();
@@ -2107,19 +3131,193 @@ void ServerMonitorRequesterImpl::send(ByteBuffer* buffer, TransportSendControl*
 
         // TODO asCheck ?
 
-        MonitorElement::Ref element(monitor);
+        // the client is not keeping up.  see AbstractCodec::setSlowConsumerLimits()
+        detail::AbstractCodec* codec = dynamic_cast<detail::AbstractCodec*>(control);
+        const bool congested = codec && codec->sendCongested();
+        const bool hold = congested && codec->getSlowConsumerPolicy()==detail::SLOW_CONSUMER_SQUASH;
+        bool pending;
+        {
+            Lock guard(_mutex);
+            pending = _squashCount>0u;
+        }
+
+        if(_conflate || hold || pending)
+        {
+            // rate limited, filtered, or held for a slow client.  Take everything queued,
+            // and send the latest once per period, when the filters pass it
+            size_t polled = 0u;
+            for(MonitorElementPtr element; (element = monitor->poll()); polled++) {
+                _squashReady |= squash(element);
+                monitor->release(element);
+            }
+
+            if(hold && polled)
+                codec->countSlowConsumer(detail::SLOW_CONSUMER_SQUASH, polled);
+
+            epicsTimeStamp now;
+            epicsTimeGetCurrent(&now);
+
+            size_t squashed;
+            bool holdoff = false, waiting = false;
+            double wait = 0.0;
+            {
+                Lock guard(_mutex);
+                _squashCount += polled;
+                squashed = _squashCount;
+
+                if(squashed==0u || !_squashReady) {
+                    // nothing to send, or held by filters
+                    squashed = 0u;
+                } else if(_pipeline && _window_open==0) {
+                    // ack() re-queues
+                    waiting = true;
+                } else if(hold) {
+                    // check again later, as nothing else may be queued to send
+                    wait = slowConsumerRetry;
+                    if(!_holdoff)
+                        holdoff = _holdoff = true;
+                    waiting = true;
+                } else if((wait = _minPeriod - epicsTimeDiffInSeconds(&now, &_lastSend)) > 0.0) {
+                    if(!_holdoff)
+                        holdoff = _holdoff = true;
+                    waiting = true;
+                } else {
+                    _squashCount = 0u;
+                    _lastSend = now;
+                    if(_pipeline)
+                        _window_open--;
+                }
+            }
+
+            if(holdoff) {
+                TimerCallback::shared_pointer tc(shared_from_this());
+                _timer->scheduleAfterDelay(tc, wait);
+            }
+
+            if(waiting) {
+                return;
+            } else if(squashed>0u) {
+                _squashReady = false;
+                for(size_t i=0; i<_filters.size(); i++)
+                    _filters[i]->sending();
+
+                const bool delta = _squashed && _arrayDelta.get()
+                        && _arrayDelta->prepare(*_squashed->pvStructurePtr, *_squashed->changedBitSet);
+
+                control->startMessage((int8)CMD_MONITOR, sizeof(int32)/sizeof(int8) + 1);
+                buffer->putInt(_ioid);
+                buffer->putByte((int8)(delta ? request|QOS_DELTA : request));
+
+                ServerChannel::Stats& stats = _channel->stats();
+                stats.monitorUpdates++;
+
+                // changedBitSet and data, if not notify only
+                if(_squashed)
+                {
+                    if(!_squashed->overrunBitSet->isEmpty())
+                        stats.monitorOverruns++;
+                    if(_arrayDelta.get()) {
+                        _arrayDelta->serialize(buffer, control, *_squashed->pvStructurePtr,
+                                               *_squashed->changedBitSet, *_squashed->overrunBitSet);
+                    } else {
+                        _squashed->changedBitSet->serialize(buffer, control);
+                        serializeChanged(buffer, control, *_squashed->pvStructurePtr, *_squashed->changedBitSet);
+                        _squashed->overrunBitSet->serialize(buffer, control);
+                    }
+                    _squashed->changedBitSet->clear();
+                    _squashed->overrunBitSet->clear();
+                }
+
+                // the peer will ack one, return flow control credit for the others now
+                if(_pipeline && squashed>1u)
+                    monitor->reportRemoteQueueStatus(squashed-1u);
+
+                // check for unlisten after sending the last update
+                TransportSender::shared_pointer thisSender = shared_from_this();
+                _transport->enqueueSendRequest(thisSender);
+                return;
+            }
+            // nothing queued, fall through to check for unlisten
+        }
+
+        MonitorElement::Ref element;
+        if(!_conflate) {
+            MonitorElement::Ref next(monitor);
+            element.swap(next);
+        }
+        if(element && congested && codec->getSlowConsumerPolicy()==detail::SLOW_CONSUMER_DROP)
+        {
+            // drop the older of those queued, keeping the latest value of each field
+            size_t dropped = 0u;
+            for(MonitorElement::Ref newer(monitor); newer; newer.next(), dropped++) {
+                element->unshare();
+                if(!element->changedBitSet || !newer->changedBitSet)
+                    continue; // notify only
+                element->pvStructurePtr->copyUnchecked(*newer->pvStructurePtr, *newer->changedBitSet);
+                element->overrunBitSet->or_and(*element->changedBitSet, *newer->changedBitSet);
+                *element->changedBitSet |= *newer->changedBitSet;
+                *element->overrunBitSet |= *newer->overrunBitSet;
+            }
+            if(dropped) {
+                codec->countSlowConsumer(detail::SLOW_CONSUMER_DROP, dropped);
+                // the peer will ack one
+                if(_pipeline)
+                    monitor->reportRemoteQueueStatus(dropped);
+            }
+        }
         if (element)
         {
+            // changedBitSet and data, if not notify only (i.e. queueSize == -1)
+            const BitSet::shared_pointer& changedBitSet = element->changedBitSet;
+
+            const bool delta = changedBitSet && _arrayDelta.get()
+                    && _arrayDelta->prepare(*element->pvStructurePtr, *changedBitSet);
+
             control->startMessage((int8)CMD_MONITOR, sizeof(int32)/sizeof(int8) + 1);
             buffer->putInt(_ioid);
-            buffer->putByte((int8)request);
+            buffer->putByte((int8)(delta ? request|QOS_DELTA : request));
 
-            // changedBitSet and data, if not notify only (i.e. queueSize == -1)
-            const BitSet::shared_pointer& changedBitSet = element->changedBitSet;
-            if (changedBitSet)
+            ServerChannel::Stats& stats = _channel->stats();
+            stats.monitorUpdates++;
+            if(changedBitSet && !element->overrunBitSet->isEmpty())
+                stats.monitorOverruns++;
+            if (changedBitSet && _arrayDelta.get())
+            {
+                // relative to what this subscriber was sent, so not shared
+                _arrayDelta->serialize(buffer, control, *element->pvStructurePtr,
+                                       *changedBitSet, *element->overrunBitSet);
+            }
+            else if (changedBitSet && element->shared && _cacheable)
+            {
+                // the same for other subscribers.  Serialize once.
+                const StructureConstPtr& type(element->pvStructurePtr->getStructure());
+                const int byteOrder = buffer->reverse<int32>()
+                        ? (EPICS_BYTE_ORDER==EPICS_ENDIAN_BIG ? EPICS_ENDIAN_LITTLE : EPICS_ENDIAN_BIG)
+                        : EPICS_BYTE_ORDER;
+
+                std::tr1::shared_ptr<const SharedUpdate::bytes_t> bytes(element->shared->find(type, byteOrder,
+                                                                                                *changedBitSet,
+                                                                                                *element->overrunBitSet));
+                if(!bytes) {
+                    BlobControl blob(byteOrder);
+                    changedBitSet->serialize(&blob.buffer, &blob);
+                    serializeChanged(&blob.buffer, &blob, *element->pvStructurePtr, *changedBitSet);
+                    element->overrunBitSet->serialize(&blob.buffer, &blob);
+                    blob.flushSerializeBuffer();
+
+                    std::tr1::shared_ptr<SharedUpdate::bytes_t> temp(new SharedUpdate::bytes_t);
+                    temp->swap(blob.out);
+                    bytes = temp;
+                    element->shared->store(type, byteOrder, *changedBitSet, *element->overrunBitSet, bytes);
+                }
+
+                if(!bytes->empty())
+                    putBytes(buffer, control, &(*bytes)[0], bytes->size());
+            }
+            else if (changedBitSet)
             {
                 changedBitSet->serialize(buffer, control);
-                element->pvStructurePtr->serialize(buffer, control, changedBitSet.get());
+                serializeChanged(buffer, control, *element->pvStructurePtr, *changedBitSet);
 
                 // overrunBitset
                 element->overrunBitSet->serialize(buffer, control);
@@ -2162,8 +3360,8 @@ void ServerMonitorRequesterImpl::send(ByteBuffer* buffer, TransportSendControl*
                 }
             }
 
-            for(window_t::iterator it(window.begin()), end(window.end()); it!=end; ++it) {
-                monitor->release(*it);
+            for(size_t i=0; i<window.size(); i++) {
+                monitor->release(window[i]);
             }
             window.clear();
 
@@ -2184,6 +3382,7 @@ void ServerMonitorRequesterImpl::ack(size_t cnt)
     typedef std::vector<MonitorElementPtr> acking_t;
     acking_t acking;
     Monitor::shared_pointer mon;
+    bool resend;
     {
         Lock guard(_mutex);
 
@@ -2193,20 +3392,22 @@ void ServerMonitorRequesterImpl::ack(size_t cnt)
 
         _window_open += cnt;
 
-        window_t::iterator it, end(_window_closed.begin());
-        std::advance(end, nack);
-
         acking.resize(nack);
 
-        size_t i;
-        for(i=0, it=_window_closed.begin(); i<nack; i++, ++it)
+        for(size_t i=0; i<nack; i++)
         {
-            acking[i].swap(*it);
+            _window_closed.pop_front(acking[i]);
         }
 
-        _window_closed.erase(_window_closed.begin(), end);
-
         mon = _channelMonitor;
+
+        // rate limited updates may be waiting for the window to open
+        resend = _squashCount>0u && !_holdoff;
+    }
+
+    if(resend) {
+        TransportSender::shared_pointer thisSender = shared_from_this();
+        _transport->enqueueSendRequest(thisSender);
     }
 
     for(acking_t::iterator it(acking.begin()), end(acking.end()); it!=end; ++it) {
@@ -2297,7 +3498,7 @@ void ServerArrayHandler::handleResponse(osiSockAddr* responseFrom,
                 return;
             }
 
-            request->getChannelArray()->getArray(offset, count, stride);
+            request->startGet(offset, count, stride);
         }
         else if (setLength)
         {
@@ -2364,7 +3565,15 @@ ServerChannelArrayRequesterImpl::ServerChannelArrayRequesterImpl(
     ServerContextImpl::shared_pointer const & context, ServerChannel::shared_pointer const & channel,
     const pvAccessID ioid, Transport::shared_pointer const & transport):
     BaseChannelRequester(context, channel, ioid, transport)
+    ,_length(0u)
+    ,_chunk(0u)
+    ,_chunkOffset(0u)
+    ,_chunkRemaining(0u)
+    ,_chunkStride(1u)
+    ,_chunkCount(0u)
+    ,_chunkToEnd(false)
 {
+    bytesCounter = &channel->stats().bytesSent;
 }
 
 ChannelArrayRequester::shared_pointer ServerChannelArrayRequesterImpl::create(
@@ -2380,6 +3589,20 @@ ChannelArrayRequester::shared_pointer ServerChannelArrayRequesterImpl::create(
 
 void ServerChannelArrayRequesterImpl::activate(PVStructure::shared_pointer const & pvRequest)
 {
+    // get in parts.  record[chunk=N] elements per response
+    epics::pvData::PVScalar::const_shared_pointer O(pvRequest->getSubField<epics::pvData::PVScalar>("record._options.chunk"));
+    if(O) {
+        try{
+            int32 chunk = O->getAs<int32>();
+            if(chunk>0)
+                _chunk = size_t(chunk);
+        }catch(std::exception& e){
+            std::ostringstream strm;
+            strm<<"Ignoring invalid chunk= : "<<e.what();
+            message(strm.str(), epics::pvData::errorMessage);
+        }
+    }
+
     startRequest(QOS_INIT);
     shared_pointer thisPointer(shared_from_this());
     _channel->registerRequest(_ioid, thisPointer);
@@ -2493,6 +3716,23 @@ ChannelArray::shared_pointer ServerChannelArrayRequesterImpl::getChannelArray()
     return _channelArray;
 }
 
+void ServerChannelArrayRequesterImpl::startGet(size_t offset, size_t count, size_t stride)
+{
+    size_t n = count;
+    {
+        Lock guard(_mutex);
+        _chunkOffset = offset;
+        _chunkRemaining = count;
+        _chunkToEnd = count==0u;
+        _chunkStride = stride ? stride : 1u;
+        if(_chunk && (count==0u || count>_chunk))
+            n = _chunk;
+        // zero when sent in one
+        _chunkCount = n==count ? 0u : n;
+    }
+    getChannelArray()->getArray(offset, n, stride);
+}
+
 PVArray::shared_pointer ServerChannelArrayRequesterImpl::getPVArray()
 {
     //Lock guard(_mutex);
@@ -2512,9 +3752,39 @@ void ServerChannelArrayRequesterImpl::send(ByteBuffer* buffer, TransportSendCont
             return;
     }
 
+    // a part of a get, other than the last.  The request stays pending
+    bool more = false;
+    size_t nextOffset = 0u, nextCount = 0u;
+    if ((QOS_GET & request) != 0)
+    {
+        Lock guard(_mutex);
+        if (_chunkCount && _status.isSuccess())
+        {
+            // a short part is the last
+            const size_t sent = _pvArray->getLength();
+            if (sent==_chunkCount)
+            {
+                if (!_chunkToEnd)
+                    _chunkRemaining -= sent;
+                more = _chunkToEnd || _chunkRemaining>0u;
+            }
+            if (more)
+            {
+                _chunkOffset += sent*_chunkStride;
+                nextOffset = _chunkOffset;
+                nextCount = _chunkToEnd ? _chunk : std::min(_chunk, _chunkRemaining);
+                _chunkCount = nextCount;
+            }
+            else
+            {
+                _chunkCount = 0u;
+            }
+        }
+    }
+
     control->startMessage((int32)CMD_ARRAY, sizeof(int32)/sizeof(int8) + 1);
     buffer->putInt(_ioid);
-    buffer->putByte((int8)request);
+    buffer->putByte((int8)(more ? ((request & ~QOS_DESTROY) | QOS_MORE) : request));
     {
         Lock guard(_mutex);
         _status.serialize(buffer, control);
@@ -2540,7 +3810,15 @@ void ServerChannelArrayRequesterImpl::send(ByteBuffer* buffer, TransportSendCont
         }
     }
 
-    stopRequest();
+    if (more)
+    {
+        // the next part is fetched once this one is in the send buffer,
+        // so a slow client holds back the provider
+        channelArray->getArray(nextOffset, nextCount, _chunkStride);
+        return;
+    }
+
+    stopRequest((int8)CMD_ARRAY);
 
     // lastRequest
     if ((QOS_DESTROY & request) != 0)
@@ -2568,6 +3846,12 @@ void ServerDestroyRequestHandler::handleResponse(osiSockAddr* responseFrom,
         return;
     }
 
+    if (RequestPool* pool = blockingPool(_context, channel))
+    {
+        pool->queue(channel.get(), ioid, RequestPool::Work::shared_pointer(new DestroyWork(channel, ioid, transport)));
+        return;
+    }
+
     Destroyable::shared_pointer request = channel->getRequest(ioid);
     if (!request.get())
     {
@@ -2669,7 +3953,10 @@ void ServerProcessHandler::handleResponse(osiSockAddr* responseFrom,
         }
 
         // create...
-        ServerChannelProcessRequesterImpl::create(_context, channel, ioid, transport, pvRequest);
+        if (RequestPool* pool = blockingPool(_context, channel))
+            pool->queue(channel.get(), ioid, RequestPool::Work::shared_pointer(new CreateWork(_context, channel, ioid, transport, pvRequest, CMD_PROCESS)));
+        else
+            ServerChannelProcessRequesterImpl::create(_context, channel, ioid, transport, pvRequest);
     }
     else
     {
@@ -2701,7 +3988,10 @@ void ServerProcessHandler::handleResponse(osiSockAddr* responseFrom,
             return;
         }
 
-        request->getChannelProcess()->process();
+        if (RequestPool* pool = blockingPool(_context, channel))
+            request->queueWork(*pool, ProcessWork(request->getChannelProcess()));
+        else
+            request->getChannelProcess()->process();
     }
 }
 
@@ -2710,6 +4000,7 @@ ServerChannelProcessRequesterImpl::ServerChannelProcessRequesterImpl(
     const pvAccessID ioid, Transport::shared_pointer const & transport):
     BaseChannelRequester(context, channel, ioid, transport), _channelProcess()
 {
+    bytesCounter = &channel->stats().bytesSent;
 }
 
 ChannelProcessRequester::shared_pointer ServerChannelProcessRequesterImpl::create(
@@ -2765,8 +4056,10 @@ void ServerChannelProcessRequesterImpl::destroy()
     // destroyed prematurely
     shared_pointer self(shared_from_this());
 
+    RequestPool::Work::shared_pointer work;
     {
         Lock guard(_mutex);
+        work.swap(_work);
         _channel->unregisterRequest(_ioid);
 
         // asCheck
@@ -2799,7 +4092,7 @@ void ServerChannelProcessRequesterImpl::send(ByteBuffer* buffer, TransportSendCo
         _status.serialize(buffer, control);
     }
 
-    stopRequest();
+    stopRequest((int8)CMD_PROCESS);
 
     // lastRequest
     if ((QOS_DESTROY & request) != 0)
@@ -2833,11 +4126,7 @@ void ServerGetFieldHandler::handleResponse(osiSockAddr* responseFrom,
     string subField = SerializeHelper::deserializeString(payloadBuffer, transport.get());
 
     // issue request
-    GetFieldRequester::shared_pointer req;
-    {
-        std::tr1::shared_ptr<ServerGetFieldRequesterImpl> tp(new ServerGetFieldRequesterImpl(_context, channel, ioid, transport));
-        req = tp;
-    }
+    std::tr1::shared_ptr<ServerGetFieldRequesterImpl> req(new ServerGetFieldRequesterImpl(_context, channel, ioid, transport, subField));
 
     // asCheck
     Status asStatus = channel->getChannelSecuritySession()->authorizeGetField(ioid, subField);
@@ -2847,6 +4136,13 @@ void ServerGetFieldHandler::handleResponse(osiSockAddr* responseFrom,
         return;
     }
 
+    // answered before, without asking the provider again
+    if (FieldConstPtr field = channel->cachedField(subField))
+    {
+        req->getDone(Status::Ok, field);
+        return;
+    }
+
     channel->installGetField(req);
 
     // TODO exception check
@@ -2861,9 +4157,10 @@ void ServerGetFieldHandler::getFieldFailureResponse(Transport::shared_pointer co
 
 ServerGetFieldRequesterImpl::ServerGetFieldRequesterImpl(
     ServerContextImpl::shared_pointer const & context, ServerChannel::shared_pointer const & channel,
-    const pvAccessID ioid, Transport::shared_pointer const & transport) :
-    BaseChannelRequester(context, channel, ioid, transport), done(false)
+    const pvAccessID ioid, Transport::shared_pointer const & transport, const std::string& subField) :
+    BaseChannelRequester(context, channel, ioid, transport), done(false), _subField(subField)
 {
+    bytesCounter = &channel->stats().bytesSent;
 }
 
 void ServerGetFieldRequesterImpl::getDone(const Status& status, FieldConstPtr const & field)
@@ -2877,6 +4174,8 @@ void ServerGetFieldRequesterImpl::getDone(const Status& status, FieldConstPtr co
         done = true;
     }
     if(!twice) {
+        if(status.isSuccess())
+            _channel->cacheField(_subField, field);
         TransportSender::shared_pointer thisSender = shared_from_this();
         _transport->enqueueSendRequest(thisSender);
     }
@@ -2938,7 +4237,10 @@ void ServerRPCHandler::handleResponse(osiSockAddr* responseFrom,
         }
 
         // create...
-        ServerChannelRPCRequesterImpl::create(_context, channel, ioid, transport, pvRequest);
+        if (RequestPool* pool = blockingPool(_context, channel))
+            pool->queue(channel.get(), ioid, RequestPool::Work::shared_pointer(new CreateWork(_context, channel, ioid, transport, pvRequest, CMD_RPC)));
+        else
+            ServerChannelRPCRequesterImpl::create(_context, channel, ioid, transport, pvRequest);
     }
     else
     {
@@ -2963,7 +4265,7 @@ void ServerRPCHandler::handleResponse(osiSockAddr* responseFrom,
         PVStructure::shared_pointer pvArgument;
 
         DESERIALIZE_EXCEPTION_GUARD(
-            pvArgument = SerializationHelper::deserializeStructureFull(payloadBuffer, transport.get());
+            pvArgument = request->deserializeArgument(payloadBuffer, transport.get());
         );
 
         if (lastRequest)
@@ -2979,7 +4281,14 @@ void ServerRPCHandler::handleResponse(osiSockAddr* responseFrom,
             return;
         }
 
-        channelRPC->request(pvArgument);
+        TraceContext trace;
+        const bool traced = request->traceDispatch(trace);
+        if (RequestPool* pool = blockingPool(_context, channel))
+            request->queueRequest(*pool, pvArgument);
+        else {
+            TraceScope scope(traced ? &trace : 0);
+            channelRPC->request(pvArgument);
+        }
     }
 }
 
@@ -2990,6 +4299,7 @@ ServerChannelRPCRequesterImpl::ServerChannelRPCRequesterImpl(
     _channelRPC(), _pvResponse()
 
 {
+    bytesCounter = &channel->stats().bytesSent;
 }
 
 ChannelRPCRequester::shared_pointer ServerChannelRPCRequesterImpl::create(
@@ -3016,6 +4326,10 @@ void ServerChannelRPCRequesterImpl::channelRPCConnect(const Status& status, Chan
         Lock guard(_mutex);
         _status = status;
         _channelRPC = channelRPC;
+        if (channelRPC)
+            _argumentType = channelRPC->getArgumentType();
+        if (_argumentType)
+            _pvArgument = getPVDataCreate()->createPVStructure(_argumentType);
     }
     TransportSender::shared_pointer thisSender = shared_from_this();
     _transport->enqueueSendRequest(thisSender);
@@ -3045,8 +4359,12 @@ void ServerChannelRPCRequesterImpl::destroy()
     // destroyed prematurely
     shared_pointer self(shared_from_this());
 
+    RequestPool::Work::shared_pointer work;
+    PVStructure::shared_pointer argument;
     {
         Lock guard(_mutex);
+        work.swap(_work);
+        argument.swap(_queuedArgument);
         _channel->unregisterRequest(_ioid);
 
         // asCheck
@@ -3067,10 +4385,59 @@ ChannelRPC::shared_pointer ServerChannelRPCRequesterImpl::getChannelRPC()
     return _channelRPC;
 }
 
+void ServerChannelRPCRequesterImpl::queueRequest(RequestPool& pool, PVStructure::shared_pointer const & argument)
+{
+    ChannelRPC::shared_pointer channelRPC;
+    {
+        Lock guard(_mutex);
+        _queuedArgument = argument;
+        channelRPC = _channelRPC;
+    }
+    queueWork(pool, RPCWork(channelRPC, shared_from_this()));
+}
+
+PVStructure::shared_pointer ServerChannelRPCRequesterImpl::takeArgument()
+{
+    PVStructure::shared_pointer ret;
+    Lock guard(_mutex);
+    ret.swap(_queuedArgument);
+    return ret;
+}
+
+PVStructure::shared_pointer ServerChannelRPCRequesterImpl::deserializeArgument(ByteBuffer* payloadBuffer, DeserializableControl* control)
+{
+    Structure::const_shared_pointer argumentType;
+    PVStructure::shared_pointer existing;
+    {
+        Lock guard(_mutex);
+        argumentType = _argumentType;
+        // otherwise still held by the service, a queued request, or as the response
+        if (_pvArgument.unique())
+            existing.swap(_pvArgument);
+    }
+    if (!argumentType)
+        return SerializationHelper::deserializeStructureFull(payloadBuffer, control);
+
+    PVStructure::shared_pointer pvArgument(SerializationHelper::deserializeStructureAndCreatePVStructure(payloadBuffer, control, existing));
+    if (pvArgument)
+    {
+        pvArgument->deserialize(payloadBuffer, control);
+
+        if (pvArgument == existing || *pvArgument->getStructure() == *argumentType)
+        {
+            Lock guard(_mutex);
+            _pvArgument = pvArgument;
+        }
+    }
+    return pvArgument;
+}
+
 void ServerChannelRPCRequesterImpl::send(ByteBuffer* buffer, TransportSendControl* control)
 {
     const int32 request = getPendingRequest();
 
+    traceSend(buffer, control);
+
     control->startMessage((int32)CMD_RPC, sizeof(int32)/sizeof(int8) + 1);
     buffer->putInt(_ioid);
     buffer->putByte((int8)request);
@@ -3092,7 +4459,7 @@ void ServerChannelRPCRequesterImpl::send(ByteBuffer* buffer, TransportSendContro
         }
     }
 
-    stopRequest();
+    stopRequest((int8)CMD_RPC);
 
     // lastRequest
     if ((QOS_DESTROY & request) != 0)
@@ -18,6 +18,7 @@
 #include "pva/server.h"
 #include "pv/pvAccess.h"
 #include "pv/reftrack.h"
+#include "pv/channelNameIndex.h"
 
 namespace pvd = epics::pvData;
 namespace pva = epics::pvAccess;
@@ -27,7 +28,9 @@ typedef epicsGuardRelease<epicsMutex> UnGuard;
 
 namespace pvas {
 
-struct StaticProvider::Impl : public pva::ChannelProvider
+struct StaticProvider::Impl : public pva::ChannelProvider,
+                              public pva::ChannelNamePublisher,
+                              public pva::ChannelBatchFind
 {
     POINTER_DEFINITIONS(Impl);
 
@@ -42,6 +45,10 @@ struct StaticProvider::Impl : public pva::ChannelProvider
     typedef StaticProvider::builders_t builders_t;
     builders_t builders;
 
+    // kept up to date with builders
+    typedef std::vector<pva::ChannelNameIndex::weak_pointer> indexes_t;
+    indexes_t indexes;
+
     Impl(const std::string& name)
         :name(name)
     {
@@ -67,6 +74,17 @@ struct StaticProvider::Impl : public pva::ChannelProvider
         requester->channelFindResult(pvd::Status(), finder, found);
         return finder;
     }
+    virtual void channelBatchFind(const std::vector<std::string>& names,
+                                  pva::ChannelBatchFindRequester::shared_pointer const & requester) OVERRIDE FINAL
+    {
+        std::vector<bool> found(names.size());
+        {
+            Guard G(mutex);
+            for(size_t i=0; i<names.size(); i++)
+                found[i] = builders.find(names[i])!=builders.end();
+        }
+        requester->channelBatchFindResult(pvd::Status(), finder, found);
+    }
     virtual pva::ChannelFind::shared_pointer channelList(pva::ChannelListRequester::shared_pointer const & requester) OVERRIDE FINAL
     {
         epics::pvData::PVStringArray::svector names;
@@ -87,12 +105,16 @@ struct StaticProvider::Impl : public pva::ChannelProvider
         pva::Channel::shared_pointer ret;
         pvd::Status sts;
 
+        std::tr1::shared_ptr<StaticProvider::ChannelBuilder> builder;
         {
             Guard G(mutex);
             builders_t::const_iterator it(builders.find(name));
             if(it!=builders.end())
-                ret = it->second->connect(Impl::shared_pointer(internal_self), name, requester);
+                builder = it->second;
         }
+        // connect without our lock, so searches aren't held up
+        if(builder)
+            ret = builder->connect(Impl::shared_pointer(internal_self), name, requester);
 
         if(!ret) {
             sts = pvd::Status::error("No such channel");
@@ -102,9 +124,55 @@ struct StaticProvider::Impl : public pva::ChannelProvider
         return ret;
     }
 
+    // names published with the lock held at once.  Between chunks, searches and add() may proceed.
+    static const size_t publishChunk = 1024u;
+
+    virtual bool publishNames(const pva::ChannelNameIndex::shared_pointer& index) OVERRIDE FINAL
+    {
+        Impl::shared_pointer self(internal_self);
+        std::vector<std::string> chunk;
+        chunk.reserve(publishChunk);
+
+        Guard G(mutex);
+        // add() and remove() keep this index up to date from now on
+        indexes.push_back(index);
+
+        builders_t::const_iterator it(builders.begin());
+        while(it!=builders.end()) {
+            chunk.clear();
+            for(; it!=builders.end() && chunk.size()<publishChunk; ++it)
+                chunk.push_back(it->first);
+            index->add(chunk, self);
+
+            if(it==builders.end())
+                break;
+            {
+                UnGuard U(G);
+            }
+            // names may have been added or removed meanwhile
+            it = builders.upper_bound(chunk.back());
+        }
+        return true;
+    }
+    virtual void unpublishNames(const pva::ChannelNameIndex::shared_pointer& index) OVERRIDE FINAL
+    {
+        {
+            Guard G(mutex);
+            for(indexes_t::iterator it(indexes.begin()); it!=indexes.end(); ) {
+                pva::ChannelNameIndex::shared_pointer cur(it->lock());
+                if(!cur || cur==index)
+                    it = indexes.erase(it);
+                else
+                    ++it;
+            }
+        }
+        index->removeAll(this);
+    }
+
 };
 
 size_t StaticProvider::Impl::num_instances;
+const size_t StaticProvider::Impl::publishChunk;
 
 StaticProvider::ChannelBuilder::~ChannelBuilder() {}
 
@@ -144,10 +212,18 @@ std::tr1::shared_ptr<epics::pvAccess::ChannelProvider> StaticProvider::provider(
 void StaticProvider::add(const std::string& name,
          const std::tr1::shared_ptr<ChannelBuilder>& builder)
 {
+    Impl::shared_pointer self(impl->internal_self);
     Guard G(impl->mutex);
     if(impl->builders.find(name)!=impl->builders.end())
         throw std::logic_error("Duplicate PV name");
     impl->builders[name] = builder;
+
+    for(Impl::indexes_t::const_iterator it(impl->indexes.begin()), end(impl->indexes.end()); it!=end; ++it) {
+        pva::ChannelNameIndex::shared_pointer index(it->lock());
+        // if another provider already has this name, it continues to answer searches
+        if(index)
+            index->add(name, self);
+    }
 }
 
 std::tr1::shared_ptr<StaticProvider::ChannelBuilder> StaticProvider::remove(const std::string& name)
@@ -159,6 +235,12 @@ std::tr1::shared_ptr<StaticProvider::ChannelBuilder> StaticProvider::remove(cons
         if(it!=impl->builders.end()) {
             ret = it->second;
             impl->builders.erase(it);
+
+            for(Impl::indexes_t::const_iterator idx(impl->indexes.begin()), end(impl->indexes.end()); idx!=end; ++idx) {
+                pva::ChannelNameIndex::shared_pointer index(idx->lock());
+                if(index)
+                    index->remove(name, impl.get());
+            }
         }
     }
     if(ret)
@@ -166,6 +248,84 @@ std::tr1::shared_ptr<StaticProvider::ChannelBuilder> StaticProvider::remove(cons
     return ret;
 }
 
+void StaticProvider::add(const builders_t& pvs)
+{
+    Impl::shared_pointer self(impl->internal_self);
+    Guard G(impl->mutex);
+    builders_t& builders = impl->builders;
+
+    // both sorted, so check for duplicates in one pass
+    {
+        builders_t::const_iterator cur(builders.begin()), last(builders.end());
+        for(builders_t::const_iterator it(pvs.begin()), end(pvs.end()); it!=end; ++it) {
+            while(cur!=last && cur->first < it->first)
+                ++cur;
+            if(cur!=last && cur->first==it->first)
+                throw std::logic_error("Duplicate PV name "+it->first);
+        }
+    }
+
+    // inserting after the hint is constant time
+    builders_t::iterator hint(builders.begin());
+    for(builders_t::const_iterator it(pvs.begin()), end(pvs.end()); it!=end; ++it) {
+        hint = builders.insert(hint, *it);
+    }
+
+    // publish in chunks, so that searches aren't held up by a large addition
+    std::vector<std::string> chunk;
+    chunk.reserve(Impl::publishChunk);
+    builders_t::const_iterator it(pvs.begin());
+    while(it!=pvs.end()) {
+        chunk.clear();
+        for(; it!=pvs.end() && chunk.size()<Impl::publishChunk; ++it) {
+            // skip any remove()d, or replaced, while unlocked
+            builders_t::const_iterator cur(builders.find(it->first));
+            if(cur!=builders.end() && cur->second==it->second)
+                chunk.push_back(it->first);
+        }
+
+        for(Impl::indexes_t::const_iterator idx(impl->indexes.begin()), iend(impl->indexes.end()); idx!=iend; ++idx) {
+            pva::ChannelNameIndex::shared_pointer index(idx->lock());
+            if(index)
+                index->add(chunk, self);
+        }
+
+        if(it!=pvs.end()) {
+            UnGuard U(G);
+        }
+    }
+}
+
+void StaticProvider::remove(const std::vector<std::string>& names)
+{
+    std::vector<std::tr1::shared_ptr<StaticProvider::ChannelBuilder> > removed;
+    removed.reserve(names.size());
+    {
+        Guard G(impl->mutex);
+
+        std::vector<pva::ChannelNameIndex::shared_pointer> indexes;
+        indexes.reserve(impl->indexes.size());
+        for(Impl::indexes_t::const_iterator idx(impl->indexes.begin()), end(impl->indexes.end()); idx!=end; ++idx) {
+            pva::ChannelNameIndex::shared_pointer index(idx->lock());
+            if(index)
+                indexes.push_back(index);
+        }
+
+        for(size_t i=0, N=names.size(); i<N; i++) {
+            Impl::builders_t::iterator it(impl->builders.find(names[i]));
+            if(it==impl->builders.end())
+                continue;
+            removed.push_back(it->second);
+            impl->builders.erase(it);
+
+            for(size_t j=0; j<indexes.size(); j++)
+                indexes[j]->remove(names[i], impl.get());
+        }
+    }
+    for(size_t i=0; i<removed.size(); i++)
+        removed[i]->close(true);
+}
+
 StaticProvider::builders_t::const_iterator StaticProvider::begin() const {
     Guard G(impl->mutex);
     return impl->builders.begin();
@@ -177,7 +337,8 @@ StaticProvider::builders_t::const_iterator StaticProvider::end() const {
 }
 
 
-struct DynamicProvider::Impl : public pva::ChannelProvider
+struct DynamicProvider::Impl : public pva::ChannelProvider,
+                               public pva::ChannelBatchFind
 {
     POINTER_DEFINITIONS(Impl);
 
@@ -221,6 +382,24 @@ struct DynamicProvider::Impl : public pva::ChannelProvider
         requester->channelFindResult(pvd::Status(), finder, found);
         return finder;
     }
+    virtual void channelBatchFind(const std::vector<std::string>& names,
+                                  pva::ChannelBatchFindRequester::shared_pointer const & requester) OVERRIDE FINAL
+    {
+        std::vector<bool> found(names.size());
+        {
+            // the Handler sees the names of a search request together
+            search_type search;
+            search.reserve(names.size());
+            for(size_t i=0; i<names.size(); i++)
+                search.push_back(DynamicProvider::Search(names[i]));
+
+            handler->hasChannels(search);
+
+            for(size_t i=0; i<names.size() && i<search.size(); i++)
+                found[i] = search[i].name()==names[i] && search[i].claimed();
+        }
+        requester->channelBatchFindResult(pvd::Status(), finder, found);
+    }
     virtual pva::ChannelFind::shared_pointer channelList(pva::ChannelListRequester::shared_pointer const & requester) OVERRIDE FINAL
     {
         epics::pvData::PVStringArray::svector names;
@@ -238,6 +417,10 @@ struct DynamicProvider::Impl : public pva::ChannelProvider
 
         ret = handler->createChannel(ChannelProvider::shared_pointer(internal_self), name, requester);
 
+        if(!ret) {
+            sts = pvd::Status::error("No such channel");
+        }
+
         requester->channelCreated(sts, ret);
         return ret;
     }
@@ -4,10 +4,13 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <vector>
+
 #include <pv/reftrack.h>
 
 #define epicsExportSharedSymbols
 #include <pv/serverChannelImpl.h>
+#include <pv/requestPool.h>
 
 using namespace epics::pvData;
 
@@ -15,6 +18,7 @@ namespace epics {
 namespace pvAccess {
 
 size_t ServerChannel::num_instances;
+const size_t ServerChannel::MAX_CACHED_FIELDS;
 
 ServerChannel::ServerChannel(Channel::shared_pointer const & channel,
                              const ChannelRequester::shared_pointer &requester,
@@ -24,6 +28,7 @@ ServerChannel::ServerChannel(Channel::shared_pointer const & channel,
     _requester(requester),
     _cid(cid),
     _sid(sid),
+    _blocking(false),
     _destroyed(false),
     _channelSecuritySession(css)
 {
@@ -32,6 +37,8 @@ ServerChannel::ServerChannel(Channel::shared_pointer const & channel,
     {
         THROW_BASE_EXCEPTION("non-null channel required");
     }
+    ChannelProvider::shared_pointer provider(channel->getProvider());
+    _blocking = !!dynamic_cast<BlockingChannelProvider*>(provider.get());
 }
 
 void ServerChannel::registerRequest(const pvAccessID id, const std::tr1::shared_ptr<BaseChannelRequester> & request)
@@ -62,6 +69,22 @@ std::tr1::shared_ptr<BaseChannelRequester> ServerChannel::getRequest(const pvAcc
     return BaseChannelRequester::shared_pointer();
 }
 
+size_t ServerChannel::memoryUsage() const
+{
+    std::vector<BaseChannelRequester::shared_pointer> requests;
+    {
+        Lock guard(_mutex);
+        requests.reserve(_requests.size());
+        for(_requests_t::const_iterator it(_requests.begin()), end(_requests.end()); it!=end; ++it)
+            requests.push_back(it->second);
+    }
+
+    size_t ret = 0u;
+    for(size_t i=0; i<requests.size(); i++)
+        ret += requests[i]->memoryUsage();
+    return ret;
+}
+
 void ServerChannel::destroy()
 {
     _requests_t reqs;
@@ -70,6 +93,10 @@ void ServerChannel::destroy()
 
         if (_destroyed) return;
         _destroyed = true;
+        if(_cold.get()) {
+            _cold->fields.clear();
+            _cold->getResponses.reset();
+        }
 
         // destroy all requests
         // take ownership of _requests locally to prevent
@@ -118,8 +145,9 @@ void ServerChannel::installGetField(const GetFieldRequester::shared_pointer& gf)
     GetFieldRequester::shared_pointer prev;
     {
         epicsGuard<epicsMutex> G(_mutex);
-        prev.swap(_active_requester);
-        _active_requester = gf;
+        Cold& C = cold();
+        prev.swap(C.active_requester);
+        C.active_requester = gf;
     }
     if(prev) {
         prev->getDone(Status::error("Aborted"), FieldConstPtr());
@@ -131,9 +159,45 @@ void ServerChannel::completeGetField(GetFieldRequester *req)
     GetFieldRequester::shared_pointer prev;
     {
         epicsGuard<epicsMutex> G(_mutex);
-        if(_active_requester.get()==req)
-            prev.swap(_active_requester);
+        if(_cold.get() && _cold->active_requester.get()==req)
+            prev.swap(_cold->active_requester);
+    }
+}
+
+FieldConstPtr ServerChannel::cachedField(const std::string& subField) const
+{
+    Lock guard(_mutex);
+    if(!_cold.get())
+        return FieldConstPtr();
+    _fields_t::const_iterator it(_cold->fields.find(subField));
+    return it!=_cold->fields.end() ? it->second : FieldConstPtr();
+}
+
+void ServerChannel::cacheField(const std::string& subField, const FieldConstPtr& field)
+{
+    Lock guard(_mutex);
+    // a reply which raced with disconnect may be of the old type
+    if(_destroyed || !field)
+        return;
+    _fields_t& fields(cold().fields);
+    if(fields.size()>=MAX_CACHED_FIELDS && !fields.count(subField))
+        return;
+    fields[subField] = field;
+}
+
+SharedUpdate::shared_pointer ServerChannel::getResponses(epics::pvData::uint64 generation)
+{
+    Lock guard(_mutex);
+    if(_destroyed || generation==0u)
+        return SharedUpdate::shared_pointer();
+    Cold& C = cold();
+    if(generation<C.getGeneration)
+        return SharedUpdate::shared_pointer();
+    if(generation>C.getGeneration || !C.getResponses) {
+        C.getResponses.reset(new SharedUpdate);
+        C.getGeneration = generation;
     }
+    return C.getResponses;
 }
 
 }
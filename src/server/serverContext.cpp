@@ -4,7 +4,12 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <sstream>
+#include <algorithm>
+
 #include <epicsSignal.h>
+#include <epicsTime.h>
+#include <epicsStdlib.h>
 
 #include <pv/lock.h>
 #include <pv/timer.h>
@@ -38,12 +43,25 @@ ServerContextImpl::ServerContextImpl():
     _beaconPeriod(15.0),
     _broadcastPort(PVA_BROADCAST_PORT),
     _serverPort(PVA_SERVER_PORT),
-    _receiveBufferSize(MAX_TCP_RECV),
-    _timer(new Timer("PVAS timers", lowerPriority)),
+    _receiveBufferSize(0),
+    _ioThreads(0),
+    _timer(new TimerWheel("PVAS timers", lowerPriority)),
     _beaconEmitter(),
     _acceptor(),
     _transportRegistry(),
+    _udpShards(1),
     _channelProviders(),
+    _searchNegativeTimeout(2.0),
+    _nameServerPoll(30.0),
+    _requestThreads(0),
+    _requestQueue(1024),
+    _statsPeriod(1.0),
+    _statsTop(20),
+    _statsTune(false),
+    _metricsPort(-1),
+    _authzCache(false),
+    _publishThreads(0),
+    _beaconLoad(false),
     _beaconServerStatusProvider(),
     _startTime()
 {
@@ -135,6 +153,9 @@ void ServerContextImpl::loadConfiguration()
     _beaconAddressList = config->getPropertyAsString("EPICS_PVA_ADDR_LIST", _beaconAddressList);
     _beaconAddressList = config->getPropertyAsString("EPICS_PVAS_BEACON_ADDR_LIST", _beaconAddressList);
 
+    _multicastGroup = config->getPropertyAsString("EPICS_PVA_MCAST_GROUP", _multicastGroup);
+    _multicastGroup = config->getPropertyAsString("EPICS_PVAS_MCAST_GROUP", _multicastGroup);
+
     _autoBeaconAddressList = config->getPropertyAsBoolean("EPICS_PVA_AUTO_ADDR_LIST", _autoBeaconAddressList);
     _autoBeaconAddressList = config->getPropertyAsBoolean("EPICS_PVAS_AUTO_BEACON_ADDR_LIST", _autoBeaconAddressList);
 
@@ -151,6 +172,59 @@ void ServerContextImpl::loadConfiguration()
     _receiveBufferSize = config->getPropertyAsInteger("EPICS_PVA_MAX_ARRAY_BYTES", _receiveBufferSize);
     _receiveBufferSize = config->getPropertyAsInteger("EPICS_PVAS_MAX_ARRAY_BYTES", _receiveBufferSize);
 
+    _ioThreads = config->getPropertyAsInteger("EPICS_PVAS_IO_THREADS", _ioThreads);
+    if(_ioThreads<0)
+        _ioThreads = 0;
+
+    {
+        // process wide, so only applied before the first connection
+        std::string hugePages(config->getPropertyAsString("EPICS_PVA_HUGE_PAGES", ""));
+        hugePages = config->getPropertyAsString("EPICS_PVAS_HUGE_PAGES", hugePages);
+        if(!HugePageAllocator::install(hugePages))
+            LOG(logLevelWarn, "EPICS_PVAS_HUGE_PAGES='%s' not applied", hugePages.c_str());
+    }
+
+    _searchNegativeTimeout = config->getPropertyAsDouble("EPICS_PVAS_SEARCH_NEGATIVE_TIMEOUT", _searchNegativeTimeout);
+
+    _udpShards = config->getPropertyAsInteger("EPICS_PVAS_UDP_SHARDS", _udpShards);
+    if(_udpShards<1)
+        _udpShards = 1;
+    else if(_udpShards>64)
+        _udpShards = 64;
+
+    _nameServerList = config->getPropertyAsString("EPICS_PVAS_NAME_SERVER_LIST", _nameServerList);
+    _nameServerPoll = config->getPropertyAsDouble("EPICS_PVAS_NAME_SERVER_POLL", _nameServerPoll);
+    if(_nameServerPoll<1.0)
+        _nameServerPoll = 1.0;
+
+    _requestThreads = config->getPropertyAsInteger("EPICS_PVAS_REQUEST_THREADS", _requestThreads);
+    if(_requestThreads<0)
+        _requestThreads = 0;
+    _requestQueue = config->getPropertyAsInteger("EPICS_PVAS_REQUEST_QUEUE", _requestQueue);
+    if(_requestQueue<1)
+        _requestQueue = 1;
+
+    _statsPrefix = config->getPropertyAsString("EPICS_PVAS_STATS_PREFIX", _statsPrefix);
+    _statsPeriod = config->getPropertyAsDouble("EPICS_PVAS_STATS_PERIOD", _statsPeriod);
+    if(_statsPeriod<0.1)
+        _statsPeriod = 0.1;
+    _statsTop = config->getPropertyAsInteger("EPICS_PVAS_STATS_TOP", _statsTop);
+    if(_statsTop<0)
+        _statsTop = 0;
+    _statsTune = config->getPropertyAsBoolean("EPICS_PVAS_STATS_TUNE", _statsTune);
+
+    _metricsPort = config->getPropertyAsInteger("EPICS_PVAS_METRICS_PORT", _metricsPort);
+    if(_metricsPort>0xffff)
+        _metricsPort = -1;
+
+    _authzCache = config->getPropertyAsBoolean("EPICS_PVAS_AUTHZ_CACHE", _authzCache);
+
+    _publishThreads = config->getPropertyAsInteger("EPICS_PVAS_PUBLISH_THREADS", _publishThreads);
+    if(_publishThreads<0)
+        _publishThreads = 0;
+
+    _beaconLoad = config->getPropertyAsBoolean("EPICS_PVAS_BEACON_LOAD", _beaconLoad);
+
     if(_channelProviders.empty()) {
         std::string providers = config->getPropertyAsString("EPICS_PVAS_PROVIDER_NAMES", PVACCESS_DEFAULT_PROVIDER);
 
@@ -191,6 +265,12 @@ void ServerContextImpl::loadConfiguration()
     if(_channelProviders.empty())
         LOG(logLevelError, "ServerContext configured with not Providers will do nothing!\n");
 
+    // served alongside the configured providers
+    if(!_statsPrefix.empty() && !_stats) {
+        _stats.reset(new ServerStats(_statsPrefix, _statsPeriod, size_t(_statsTop), _statsTune));
+        _channelProviders.push_back(_stats->getProvider());
+    }
+
     //
     // introspect network interfaces
     //
@@ -202,7 +282,7 @@ void ServerContextImpl::loadConfiguration()
         THROW_BASE_EXCEPTION("Failed to create a socket needed to introspect network interfaces.");
     }
 
-    if (discoverInterfaces(_ifaceList, sock, &_ifaceAddr))
+    if (discoverInterfacesCached(_ifaceList, sock, &_ifaceAddr))
     {
         THROW_BASE_EXCEPTION("Failed to introspect network interfaces.");
     }
@@ -219,8 +299,10 @@ ServerContextImpl::getCurrentConfig()
     ConfigurationBuilder B;
 
     std::ostringstream providerName;
-    for(size_t i=0; i<_channelProviders.size(); i++) {
-        if(i>0)
+    for(size_t i=0, n=0; i<_channelProviders.size(); i++) {
+        if(_stats && _channelProviders[i]==_stats->getProvider())
+            continue;
+        if(n++>0)
             providerName<<" ";
         providerName<<_channelProviders[i]->getProviderName();
     }
@@ -237,6 +319,9 @@ ServerContextImpl::getCurrentConfig()
     SET("EPICS_PVAS_BEACON_ADDR_LIST", getBeaconAddressList());
     SET("EPICS_PVA_ADDR_LIST", getBeaconAddressList());
 
+    SET("EPICS_PVAS_MCAST_GROUP", _multicastGroup);
+    SET("EPICS_PVA_MCAST_GROUP", _multicastGroup);
+
     SET("EPICS_PVAS_AUTO_BEACON_ADDR_LIST",
                          isAutoBeaconAddressList() ? "YES" : "NO");
     SET("EPICS_PVA_AUTO_ADDR_LIST",
@@ -251,11 +336,42 @@ ServerContextImpl::getCurrentConfig()
     SET("EPICS_PVAS_BROADCAST_PORT", getBroadcastPort());
     SET("EPICS_PVA_BROADCAST_PORT", getBroadcastPort());
 
+    if(_acceptor) {
+        SET("EPICS_PVAS_LISTEN_BACKLOG", _acceptor->getListenBacklog());
+        SET("EPICS_PVAS_MAX_CONNECTIONS", unsigned(_acceptor->getMaxConnections()));
+        SET("EPICS_PVAS_MAX_CONNECTIONS_PER_HOST", unsigned(_acceptor->getMaxConnectionsPerHost()));
+    }
+
     SET("EPICS_PVAS_MAX_ARRAY_BYTES", getReceiveBufferSize());
     SET("EPICS_PVA_MAX_ARRAY_BYTES", getReceiveBufferSize());
 
     SET("EPICS_PVAS_PROVIDER_NAMES", providerName.str());
 
+    SET("EPICS_PVAS_IO_THREADS", _ioReactor ? _ioThreads : 0);
+
+    SET("EPICS_PVAS_SEARCH_NEGATIVE_TIMEOUT", _searchNegativeTimeout);
+
+    SET("EPICS_PVAS_UDP_SHARDS", _udpShards);
+
+    SET("EPICS_PVAS_NAME_SERVER_LIST", _nameServerList);
+    SET("EPICS_PVAS_NAME_SERVER_POLL", _nameServerPoll);
+
+    SET("EPICS_PVAS_REQUEST_THREADS", _requestPool ? _requestThreads : 0);
+    SET("EPICS_PVAS_REQUEST_QUEUE", _requestQueue);
+
+    SET("EPICS_PVAS_STATS_PREFIX", _statsPrefix);
+    SET("EPICS_PVAS_STATS_PERIOD", _statsPeriod);
+    SET("EPICS_PVAS_STATS_TOP", _statsTop);
+    SET("EPICS_PVAS_STATS_TUNE", _statsTune ? "YES" : "NO");
+
+    SET("EPICS_PVAS_METRICS_PORT", _metricsServer ? _metricsServer->getPort() : _metricsPort);
+
+    SET("EPICS_PVAS_AUTHZ_CACHE", _authzCache ? "YES" : "NO");
+
+    SET("EPICS_PVAS_PUBLISH_THREADS", _publishThreads);
+
+    SET("EPICS_PVAS_BEACON_LOAD", _beaconLoad ? "YES" : "NO");
+
 #undef SET
 
     return B.push_map().build();
@@ -267,6 +383,185 @@ bool ServerContextImpl::isChannelProviderNamePreconfigured()
     return config->hasProperty("EPICS_PVAS_PROVIDER_NAMES");
 }
 
+struct ServerContextImpl::Tuning : public Configuration
+{
+    mutable epics::pvData::Mutex mutex;
+    std::map<std::string, std::string> values;
+
+    virtual ~Tuning() {}
+
+    void set(const std::string& name, const std::string& value)
+    {
+        Lock guard(mutex);
+        values[name] = value;
+    }
+
+private:
+    virtual bool tryGetPropertyAsString(const std::string& name, std::string* val) const OVERRIDE FINAL
+    {
+        Lock guard(mutex);
+        std::map<std::string, std::string>::const_iterator it(values.find(name));
+        if(it==values.end())
+            return false;
+        if(val)
+            *val = it->second;
+        return true;
+    }
+
+    virtual void addKeys(keys_t& names) const OVERRIDE FINAL
+    {
+        Lock guard(mutex);
+        for(std::map<std::string, std::string>::const_iterator it(values.begin()), end(values.end()); it!=end; ++it)
+            names.insert(it->first);
+    }
+};
+
+namespace {
+enum TuneKind {
+    TuneInteger,
+    TunePolicy,       // EPICS_PVAS_SLOW_CLIENT_POLICY
+    TunePriorityList  // "minPriority:value ..." as EPICS_PVA_PRIORITY_*
+};
+
+// Settings which each connection reads when created.  Those live are read again by reconfigure()
+const struct {
+    const char *name;
+    TuneKind kind;
+    bool live;
+} tunableSettings[] = {
+    {"EPICS_PVA_COALESCE_US", TuneInteger, true},
+    {"EPICS_PVA_COALESCE_BYTES", TuneInteger, true},
+    {"EPICS_PVA_COALESCE_MAX_PRIORITY", TuneInteger, true},
+    {"EPICS_PVA_COMPRESS_THRESHOLD", TuneInteger, true},
+    {"EPICS_PVAS_MAX_SEND_QUEUE", TuneInteger, true},
+    {"EPICS_PVAS_MAX_SEND_BYTES", TuneInteger, true},
+    {"EPICS_PVAS_SLOW_CLIENT_POLICY", TunePolicy, true},
+    {"EPICS_PVA_PRIORITY_DSCP", TunePriorityList, true},
+    {"EPICS_PVA_PRIORITY_SNDBUF", TunePriorityList, true},
+    {"EPICS_PVA_PRIORITY_RCVBUF", TunePriorityList, true},
+    {"EPICS_PVA_PRIORITY_BUSY_POLL", TunePriorityList, true},
+    {"EPICS_PVA_PRIORITY_SEND_SPIN", TunePriorityList, true},
+    // sizes of buffers and windows, fixed once connected
+    {"EPICS_PVA_MAX_TCP_RECV", TuneInteger, false},
+    {"EPICS_PVA_MAX_SEGMENT_SIZE", TuneInteger, false},
+    {"EPICS_PVA_PIPELINE_WINDOW", TuneInteger, false},
+};
+const size_t numTunable = sizeof(tunableSettings)/sizeof(tunableSettings[0]);
+
+bool validTuning(TuneKind kind, const std::string& value)
+{
+    switch(kind) {
+    case TuneInteger: {
+        epicsInt32 ignored;
+        return epicsParseInt32(value.c_str(), &ignored, 0, NULL)==0;
+    }
+    case TunePolicy:
+        return value=="squash" || value=="drop" || value=="disconnect";
+    case TunePriorityList: {
+        std::istringstream strm(value);
+        std::string entry;
+        while(strm>>entry) {
+            std::istringstream parse(entry);
+            int minPriority, val;
+            char sep = 0;
+            if(!(parse>>minPriority>>sep>>val) || sep!=':' || !parse.eof())
+                return false;
+        }
+        return true;
+    }
+    }
+    return false;
+}
+} // namespace
+
+bool ServerContextImpl::tune(const std::string& name, const std::string& value)
+{
+    size_t i;
+    for(i=0; i<numTunable && name!=tunableSettings[i].name; i++) {}
+    if(i==numTunable || !validTuning(tunableSettings[i].kind, value) || !_configCache)
+        return false;
+
+    _tuning->set(name, value);
+    // connections created from now on see the new value
+    _configCache->reload();
+
+    if(tunableSettings[i].live) {
+        TransportRegistry::transportVector_t transports;
+        _transportRegistry.toArray(transports);
+        for(TransportRegistry::transportVector_t::const_iterator it(transports.begin()), end(transports.end());
+            it!=end; ++it)
+        {
+            if(detail::BlockingTCPTransportCodec *codec = dynamic_cast<detail::BlockingTCPTransportCodec*>(it->get()))
+                codec->reconfigure();
+        }
+    }
+
+    LOG(logLevelInfo, "Server setting %s='%s'", name.c_str(), value.c_str());
+    return true;
+}
+
+void ServerContextImpl::tunables(std::vector<Tunable>& out)
+{
+    Configuration::const_shared_pointer config(getConfiguration());
+
+    out.resize(numTunable);
+    for(size_t i=0; i<numTunable; i++) {
+        out[i].name = tunableSettings[i].name;
+        out[i].value = config->getPropertyAsString(tunableSettings[i].name, "");
+        out[i].live = tunableSettings[i].live;
+    }
+}
+
+namespace {
+// publish the names of one provider, then stop searching it
+struct PublishWork : public RequestPool::Work
+{
+    const std::tr1::weak_ptr<ServerContextImpl> context;
+    const ChannelProvider::shared_pointer provider;
+
+    PublishWork(const ServerContextImpl::shared_pointer& context,
+                const ChannelProvider::shared_pointer& provider)
+        :context(context)
+        ,provider(provider)
+    {}
+    virtual ~PublishWork() {}
+
+    virtual void run() OVERRIDE FINAL
+    {
+        ServerContextImpl::shared_pointer ctxt(context.lock());
+        ChannelNamePublisher *pub = dynamic_cast<ChannelNamePublisher*>(provider.get());
+        if(!ctxt || !pub)
+            return;
+
+        epicsTimeStamp start, end;
+        epicsTimeGetCurrent(&start);
+
+        if(pub->publishNames(ctxt->getChannelNameIndex())) {
+            ctxt->providerPublished(provider);
+
+            epicsTimeGetCurrent(&end);
+            LOG(logLevelDebug, "Provider '%s' published its names in %.3f s",
+                provider->getProviderName().c_str(), epicsTimeDiffInSeconds(&end, &start));
+        }
+    }
+};
+} // namespace
+
+ServerContextImpl::searched_providers_t ServerContextImpl::getSearchedProviders() const
+{
+    Lock guard(_searchedMutex);
+    return _searchedProviders;
+}
+
+void ServerContextImpl::providerPublished(const ChannelProvider::shared_pointer& provider)
+{
+    Lock guard(_searchedMutex);
+    std::tr1::shared_ptr<std::vector<ChannelProvider::shared_pointer> > searched(
+                new std::vector<ChannelProvider::shared_pointer>(*_searchedProviders));
+    searched->erase(std::remove(searched->begin(), searched->end(), provider), searched->end());
+    _searchedProviders = searched;
+}
+
 void ServerContextImpl::initialize()
 {
     Lock guard(_mutex);
@@ -278,16 +573,98 @@ void ServerContextImpl::initialize()
     // we create reference cycles here which are broken by our shutdown() method,
     _responseHandler.reset(new ServerResponseHandler(thisServerContext));
 
+    if(_ioThreads>0)
+        _ioReactor = IOReactor::create("PVAS-IO", _ioThreads);
+
+    // providers which know all of their names answer searches through the index.
+    // With EPICS_PVAS_PUBLISH_THREADS, they are searched until published after we are listening.
+    _channelNameIndex.reset(new ChannelNameIndex(_searchNegativeTimeout));
+    std::vector<ChannelProvider::shared_pointer> publishers;
+    {
+        std::tr1::shared_ptr<std::vector<ChannelProvider::shared_pointer> > searched(new std::vector<ChannelProvider::shared_pointer>);
+        for(size_t i=0; i<_channelProviders.size(); i++) {
+            ChannelNamePublisher *pub = dynamic_cast<ChannelNamePublisher*>(_channelProviders[i].get());
+            if(pub && _publishThreads>0) {
+                publishers.push_back(_channelProviders[i]);
+                searched->push_back(_channelProviders[i]);
+            } else if(!pub || !pub->publishNames(_channelNameIndex)) {
+                searched->push_back(_channelProviders[i]);
+            }
+        }
+        Lock G(_searchedMutex);
+        _searchedProviders = searched;
+    }
+
+    // hand out the names of other servers
+    if(!_nameServerList.empty()) {
+        _nameServer.reset(new NameServer(_nameServerPoll));
+
+        std::istringstream strm(_nameServerList);
+        std::string address;
+        while(strm>>address) {
+            if(!_nameServer->addServer(address))
+                LOG(logLevelWarn, "EPICS_PVAS_NAME_SERVER_LIST ignores '%s'", address.c_str());
+        }
+        _nameServer->start();
+    }
+
+    // only needed for providers which may block
+    if(_requestThreads>0) {
+        bool blocking = false;
+        for(size_t i=0; i<_channelProviders.size() && !blocking; i++)
+            blocking = !!dynamic_cast<BlockingChannelProvider*>(_channelProviders[i].get());
+        if(blocking)
+            _requestPool.reset(new RequestPool(_requestThreads, _requestQueue));
+    }
+
     _acceptor.reset(new BlockingTCPAcceptor(thisServerContext, _responseHandler, _ifaceAddr, _receiveBufferSize));
     _serverPort = ntohs(_acceptor->getBindAddress()->ia.sin_port);
 
+    // each shard has its own search handler, and the requesters it replies with
+    for(int32 i=1; i<_udpShards; i++)
+        _shardHandlers.push_back(ResponseHandler::shared_pointer(new ServerResponseHandler(thisServerContext)));
+
     // setup broadcast UDP transport
     initializeUDPTransports(true, _udpTransports, _ifaceList, _responseHandler, _broadcastTransport,
-                            _broadcastPort, _autoBeaconAddressList, _beaconAddressList, _ignoreAddressList);
+                            _broadcastPort, _autoBeaconAddressList, _beaconAddressList, _ignoreAddressList,
+                            _multicastGroup, _shardHandlers);
+
+    // advertise load, so that clients may choose between servers with the same names
+    if(_beaconLoad && !_beaconServerStatusProvider)
+        _beaconServerStatusProvider.reset(new DefaultBeaconServerStatusProvider(thisServerContext));
 
     _beaconEmitter.reset(new BeaconEmitter("tcp", _broadcastTransport, thisServerContext));
 
     _beaconEmitter->start();
+
+    // publish in parallel, while searches are answered by channelFind()
+    if(!publishers.empty()) {
+        _publishPool.reset(new RequestPool(std::min(publishers.size(), size_t(_publishThreads)), publishers.size()));
+        for(size_t i=0; i<publishers.size(); i++) {
+            RequestPool::Work::shared_pointer work(new PublishWork(thisServerContext, publishers[i]));
+            _publishPool->queue(this, pvAccessID(i), work);
+        }
+    }
+
+    if(_stats)
+        _stats->start(thisServerContext);
+
+    MetricsSource::add(std::tr1::weak_ptr<MetricsSource>(thisServerContext));
+
+    if(_metricsPort>=0) {
+        std::string iface;
+        if(_ifaceAddr.ia.sin_addr.s_addr!=htonl(INADDR_ANY)) {
+            char buf[24];
+            ipAddrToDottedIP(&_ifaceAddr.ia, buf, sizeof(buf));
+            iface = buf;
+            iface = iface.substr(0, iface.find(':'));
+        }
+        try {
+            _metricsServer.reset(new MetricsServer(_metricsPort, iface));
+        } catch(std::exception& e) {
+            LOG(logLevelError, "EPICS_PVAS_METRICS_PORT: %s", e.what());
+        }
+    }
 }
 
 void ServerContextImpl::run(uint32 seconds)
@@ -343,7 +720,13 @@ void ServerContextImpl::shutdown()
         _broadcastTransport.reset();
     }
 
-    // stop accepting connections
+    // stop posting metrics
+    if (_stats)
+        _stats->stop();
+    if (_metricsServer)
+        _metricsServer->stop();
+
+    // stop accepting connections, after collectMetrics() which reads its counters
     if (_acceptor)
     {
         _acceptor->destroy();
@@ -351,9 +734,34 @@ void ServerContextImpl::shutdown()
         _acceptor.reset();
     }
 
+    // release any receive thread waiting for queue space, and drop queued requests
+    if (_requestPool)
+        _requestPool->stop();
+
     // this will also destroy all channels
     _transportRegistry.clear();
 
+    // wait for publishing in progress, and skip the rest
+    if (_publishPool)
+        _publishPool->stop();
+
+    if (_channelNameIndex)
+    {
+        for(size_t i=0; i<_channelProviders.size(); i++) {
+            ChannelNamePublisher *pub = dynamic_cast<ChannelNamePublisher*>(_channelProviders[i].get());
+            if(pub)
+                pub->unpublishNames(_channelNameIndex);
+        }
+    }
+
+    // stop polling other servers
+    if (_nameServer)
+        _nameServer->stop();
+
+    // join shared I/O threads
+    if (_ioReactor)
+        _ioReactor->close();
+
     // drop timer queue
     LEAK_CHECK(_timer, "_timer")
     _timer.reset();
@@ -362,6 +770,7 @@ void ServerContextImpl::shutdown()
     // so must break the cycles
     LEAK_CHECK(_responseHandler, "_responseHandler")
     _responseHandler.reset();
+    _shardHandlers.clear();
 
     _runEvent.signal();
 }
@@ -385,10 +794,12 @@ void ServerContextImpl::printInfo(ostream& str, int lvl)
         str << endl
             << "BEACON_ADDR_LIST : " << _beaconAddressList << endl
             << "AUTO_BEACON_ADDR_LIST : " << _autoBeaconAddressList << endl
+            << "MCAST_GROUP : " << _multicastGroup << endl
             << "BEACON_PERIOD : " << _beaconPeriod << endl
             << "BROADCAST_PORT : " << _broadcastPort << endl
             << "SERVER_PORT : " << _serverPort << endl
             << "RCV_BUFFER_SIZE : " << _receiveBufferSize << endl
+            << "IO_THREADS : " << (_ioReactor ? _ioThreads : 0) << endl
             << "IGNORE_ADDR_LIST: " << _ignoreAddressList << endl
             << "INTF_ADDR_LIST : " << inetAddressToString(_ifaceAddr, false) << endl;
 
@@ -398,6 +809,46 @@ void ServerContextImpl::printInfo(ostream& str, int lvl)
         TransportRegistry::transportVector_t transports;
         _transportRegistry.toArray(transports);
 
+        if(_channelNameIndex) {
+            ChannelNameIndex::Stats stats;
+            _channelNameIndex->getStats(stats);
+            str<<"Names: "<<stats.published<<" published, "<<stats.learned<<" learned, "<<stats.negative<<" negative\n"
+               <<"  searches "<<stats.hits<<" published, "<<stats.negativeHits<<" recently missing, "<<stats.misses<<" unknown\n";
+        }
+
+        if(_nameServer) {
+            NameServer::Stats stats;
+            _nameServer->getStats(stats);
+            str<<"Name server: "<<stats.servers<<" servers, "<<stats.reachable<<" reachable, "<<stats.names<<" names\n"
+               <<"  lookups "<<stats.lookups<<", answered "<<stats.hits<<"\n";
+        }
+
+        if(BlockAllocator *alloc = BufferPool::allocator()) {
+            str<<"Buffers: "<<alloc->name()<<", "<<alloc->bytes()<<" bytes mapped, "
+               <<BufferPool::num_used<<" in use, "<<BufferPool::num_free<<" cached\n";
+        }
+
+        if(_requestPool) {
+            RequestPool::Stats stats;
+            _requestPool->getStats(stats);
+            str<<"Request pool: "<<stats.busy<<" of "<<stats.workers<<" workers busy, "
+               <<stats.queued<<" queued (max "<<stats.maxQueued<<" of "<<_requestQueue<<")\n"
+               <<"  completed "<<stats.completed<<", blocked "<<stats.blocked
+               <<", wait avg "<<(stats.completed ? stats.waitTotal/stats.completed : 0.0)<<"s max "<<stats.waitMax<<"s\n";
+        }
+
+        str<<"UDP:\n";
+        for(BlockingUDPTransportVector::const_iterator it(_udpTransports.begin()), end(_udpTransports.end());
+            it!=end; ++it)
+        {
+            BlockingUDPTransport::Statistics stats;
+            (*it)->getStatistics(stats);
+
+            str<<"  "<<inetAddressToString(*(*it)->getBindAddress())
+               <<" rx "<<stats.datagramsReceived<<" in "<<stats.recvCalls<<" calls, dropped "<<stats.datagramsDropped
+               <<", tx "<<stats.datagramsSent<<" in "<<stats.sendCalls<<" calls, coalesced "<<stats.repliesCoalesced<<"\n";
+        }
+
         str<<"Clients:\n";
         for(TransportRegistry::transportVector_t::const_iterator it(transports.begin()), end(transports.end());
             it!=end; ++it)
@@ -411,19 +862,89 @@ void ServerContextImpl::printInfo(ostream& str, int lvl)
             const detail::BlockingServerTCPTransportCodec *casTransport = dynamic_cast<const detail::BlockingServerTCPTransportCodec*>(transport.get());
 
             if(casTransport) {
-              str<<" "<<(casTransport ? casTransport->getChannelCount() : size_t(-1))<<" channels";
+              str<<" "<<(casTransport ? casTransport->getChannelCount() : size_t(-1))<<" channels"
+                 <<" rcvwin="<<casTransport->getReceiveWindow()
+                 <<" segment="<<casTransport->getSegmentSize()
+                 <<(casTransport->isSharedMemory() ? " shm" : "")
+                 <<(casTransport->isRDMA() ? " rdma" : "")
+                 <<(casTransport->isIOUring() ? " io_uring" : "");
+              const TLSSession::shared_pointer& tls = casTransport->getTLSSession();
+              if(tls && !tls->established()) {
+                  str<<" tls=handshake";
+              } else if(tls) {
+                  str<<" tls="<<tls->cipherName()
+                     <<(tls->resumed() ? " resumed" : "")
+                     <<(tls->kernelSend() ? " ktls" : "");
+                  if(!tls->peerName().empty())
+                      str<<" peer="<<tls->peerName();
+              }
             }
 
             str<<"\n";
 
             if(!casTransport || lvl<2)
-                return;
+                continue;
             // lvl >= 2
 
+            detail::TransportStatistics stats;
+            casTransport->getStatistics().snapshot(stats);
+
+            str<<"  tx "<<stats.bytesSent<<" bytes, "<<stats.totalMessagesSent()<<" msgs, "
+               <<stats.sendCalls<<" calls ("<<stats.partialWrites<<" partial), stalled "
+               <<(stats.sendStallUS/1000u)<<" ms, queued "<<casTransport->getSendQueueDepth()<<"\n"
+               <<"  rx "<<stats.bytesReceived<<" bytes, "<<stats.totalMessagesReceived()<<" msgs, "
+               <<stats.recvCalls<<" calls\n";
+
+            double rxCPU, txCPU;
+            casTransport->getCPUTime(rxCPU, txCPU);
+            if(rxCPU>0.0 || txCPU>0.0) {
+                str<<"  cpu rx "<<unsigned(rxCPU*1e3)<<" ms, tx "<<unsigned(txCPU*1e3)<<" ms\n";
+            }
+
+            if(casTransport->getRxStampMode()!=detail::BlockingTCPTransportCodec::RX_STAMP_NONE) {
+                LatencyHistogram toDispatch, toResponse;
+                casTransport->getReceiveLatency(toDispatch, toResponse);
+                str<<"  received to dispatch ";
+                toDispatch.show(str);
+                str<<"\n  dispatch to response ";
+                toResponse.show(str);
+                str<<"\n";
+            }
+
+            if(stats.compressedSegments || stats.inflatedSegments) {
+                str<<"  compressed "<<stats.compressedSegments<<" segments, "
+                   <<stats.compressIn<<" -> "<<stats.compressOut<<" bytes in "
+                   <<(stats.compressUS/1000u)<<" ms, decompressed "<<stats.inflatedSegments
+                   <<" in "<<(stats.inflateUS/1000u)<<" ms\n";
+            }
+
+            if(stats.slowSquashed || stats.slowDropped) {
+                str<<"  slow client, "<<stats.slowSquashed<<" updates held, "
+                   <<stats.slowDropped<<" dropped\n";
+            }
+
+            if(lvl>=3) {
+                for(size_t cmd=0; cmd<=detail::TransportStatistics::maxCommand; cmd++) {
+                    if(!stats.messagesSent[cmd] && !stats.messagesReceived[cmd])
+                        continue;
+                    str<<"  cmd "<<cmd<<(cmd==detail::TransportStatistics::maxCommand ? "+" : "")
+                       <<" tx "<<stats.messagesSent[cmd]<<" rx "<<stats.messagesReceived[cmd]<<"\n";
+                }
+            }
+
             typedef std::vector<ServerChannel::shared_pointer> channels_t;
             channels_t channels;
             casTransport->getChannels(channels);
 
+            std::vector<size_t> channelBytes(channels.size());
+            size_t requestBytes = 0u;
+            for(size_t i=0; i<channels.size(); i++)
+                requestBytes += channelBytes[i] = channels[i]->memoryUsage();
+
+            str<<"  memory "<<casTransport->getBufferBytes()<<" bytes buffers, "
+               <<casTransport->getIntrospectionBytes()<<" introspection, "
+               <<requestBytes<<" monitor queues\n";
+
             for(channels_t::const_iterator it(channels.begin()), end(channels.end()); it!=end; ++it)
             {
                 const ServerChannel *channel(static_cast<const ServerChannel*>(it->get()));
@@ -432,7 +953,8 @@ void ServerContextImpl::printInfo(ostream& str, int lvl)
                     continue;
 
                 str<<"  "<<providerChan->getChannelName()
-                   <<(providerChan->isConnected()?"":" closed");
+                   <<(providerChan->isConnected()?"":" closed")
+                   <<" "<<channelBytes[it-channels.begin()]<<" bytes";
                 if(lvl>=3) {
                     str<<"\t: ";
                     providerChan->printInfo(str);
@@ -507,7 +1029,7 @@ const std::vector<ChannelProvider::shared_pointer>& ServerContextImpl::getChanne
     return _channelProviders;
 }
 
-Timer::shared_pointer ServerContextImpl::getTimer()
+TimerWheel::shared_pointer ServerContextImpl::getTimer()
 {
     return _timer;
 }
@@ -534,11 +1056,100 @@ void ServerContextImpl::newServerDetected()
     // not used
 }
 
+IOReactor::shared_pointer ServerContextImpl::getIOReactor()
+{
+    return _ioReactor;
+}
+
 epicsTimeStamp& ServerContextImpl::getStartTime()
 {
     return _startTime;
 }
 
+void ServerContextImpl::collectMetrics(Metrics& M)
+{
+    M.family("pva_server_transports", Metrics::Gauge, "Client connections open");
+    M.family("pva_server_channels", Metrics::Gauge, "Channels open");
+    M.family("pva_server_bytes_sent_total", Metrics::Counter, "Bytes sent, by client");
+    M.family("pva_server_bytes_received_total", Metrics::Counter, "Bytes received, by client");
+    M.family("pva_server_send_queue_depth", Metrics::Gauge, "Replies waiting to be sent, by client");
+    M.family("pva_server_slow_consumer_total", Metrics::Counter, "Slow consumer actions, by client");
+    M.family("pva_server_messages_received_total", Metrics::Counter, "Messages received, by command");
+    M.family("pva_server_search_names_total", Metrics::Counter, "Names searched for");
+    M.family("pva_server_search_found_total", Metrics::Counter, "Names searched for which were found");
+    M.family("pva_server_beacons_sent_total", Metrics::Counter, "Beacons sent");
+    M.family("pva_server_memory_bytes", Metrics::Gauge, "Approximate bytes held, by client and use");
+    M.family("pva_server_cpu_seconds_total", Metrics::Counter, "CPU time used to receive from and send to each client");
+    M.family("pva_server_received_dispatch_seconds", Metrics::Histogram, "Time from kernel receipt of a message until dispatch, by client.  See EPICS_PVA_RX_TIMESTAMPS");
+    M.family("pva_server_dispatch_response_seconds", Metrics::Histogram, "Time from dispatch of a request until its response is sent, by client.  See EPICS_PVA_RX_TIMESTAMPS");
+    M.family("pva_server_connections_accepted_total", Metrics::Counter, "Client connections admitted");
+    M.family("pva_server_connections_rejected_total", Metrics::Counter, "Client connections closed at once, by limit reached");
+
+    TransportRegistry::transportVector_t transports;
+    _transportRegistry.toArray(transports);
+
+    size_t nchannels = 0u;
+    for(size_t i=0; i<transports.size(); i++) {
+        const detail::BlockingServerTCPTransportCodec *casTransport =
+                dynamic_cast<const detail::BlockingServerTCPTransportCodec*>(transports[i].get());
+        if(!casTransport)
+            continue;
+
+        detail::TransportStatistics stats;
+        casTransport->getStatistics().snapshot(stats);
+        nchannels += casTransport->getChannelCount();
+
+        const std::string remote(Metrics::label("remote", casTransport->getRemoteName()));
+        M.add("pva_server_bytes_sent_total", double(stats.bytesSent), remote);
+        M.add("pva_server_bytes_received_total", double(stats.bytesReceived), remote);
+        M.add("pva_server_send_queue_depth", double(casTransport->getSendQueueDepth()), remote);
+        M.add("pva_server_slow_consumer_total", double(stats.slowSquashed), remote+","+Metrics::label("action", "squash"));
+        M.add("pva_server_slow_consumer_total", double(stats.slowDropped), remote+","+Metrics::label("action", "drop"));
+        M.add("pva_server_slow_consumer_total", double(stats.slowDisconnects), remote+","+Metrics::label("action", "disconnect"));
+
+        double rxCPU, txCPU;
+        casTransport->getCPUTime(rxCPU, txCPU);
+        M.add("pva_server_cpu_seconds_total", rxCPU, remote+","+Metrics::label("thread", "rx"));
+        M.add("pva_server_cpu_seconds_total", txCPU, remote+","+Metrics::label("thread", "tx"));
+
+        if(casTransport->getRxStampMode()!=detail::BlockingTCPTransportCodec::RX_STAMP_NONE) {
+            LatencyHistogram toDispatch, toResponse;
+            casTransport->getReceiveLatency(toDispatch, toResponse);
+            M.add("pva_server_received_dispatch_seconds", toDispatch, Metrics::shortBounds(), remote);
+            M.add("pva_server_dispatch_response_seconds", toResponse, Metrics::defaultBounds(), remote);
+        }
+
+        std::vector<ServerChannel::shared_pointer> channels;
+        casTransport->getChannels(channels);
+        size_t requestBytes = 0u;
+        for(size_t c=0; c<channels.size(); c++)
+            requestBytes += channels[c]->memoryUsage();
+
+        M.add("pva_server_memory_bytes", double(casTransport->getBufferBytes()), remote+","+Metrics::label("use", "buffers"));
+        M.add("pva_server_memory_bytes", double(casTransport->getIntrospectionBytes()), remote+","+Metrics::label("use", "introspection"));
+        M.add("pva_server_memory_bytes", double(requestBytes), remote+","+Metrics::label("use", "monitor_queues"));
+    }
+    M.add("pva_server_transports", double(transports.size()));
+    M.add("pva_server_channels", double(nchannels));
+
+    for(size_t i=0; i<=detail::TransportStatistics::maxCommand; i++) {
+        const size_t count = _counters.received[i].get();
+        if(count)
+            M.add("pva_server_messages_received_total", double(count),
+                  Metrics::label("command", detail::TransportStatistics::commandName(int8(i))));
+    }
+    M.add("pva_server_search_names_total", double(_counters.searchNames.get()));
+    M.add("pva_server_search_found_total", double(_counters.searchFound.get()));
+    M.add("pva_server_beacons_sent_total", double(_counters.beaconsSent.get()));
+
+    if(_acceptor) {
+        const BlockingTCPAcceptor::Statistics& accepts = _acceptor->getStatistics();
+        M.add("pva_server_connections_accepted_total", double(accepts.accepted.get()));
+        M.add("pva_server_connections_rejected_total", double(accepts.rejectedLimit.get()), Metrics::label("limit", "total"));
+        M.add("pva_server_connections_rejected_total", double(accepts.rejectedHost.get()), Metrics::label("limit", "host"));
+    }
+}
+
 
 const Context::securityPlugins_t& ServerContextImpl::getSecurityPlugins()
 {
@@ -597,6 +1208,15 @@ ServerContext::shared_pointer ServerContext::create(const Config &conf)
     if(!ret->configuration) {
         ret->configuration = ConfigurationBuilder().push_env().build();
     }
+    // read by each transport, after any value given to tune()
+    ret->_tuning.reset(new ServerContextImpl::Tuning);
+    {
+        std::tr1::shared_ptr<ConfigurationStack> stack(new ConfigurationStack);
+        stack->push_back(std::tr1::const_pointer_cast<Configuration>(ret->configuration));
+        stack->push_back(ret->_tuning);
+        ret->_configCache.reset(new ConfigurationCache(stack));
+    }
+    ret->configuration = ret->_configCache;
 
     ret->loadConfiguration();
     ret->initialize();
@@ -0,0 +1,456 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <algorithm>
+
+#include <epicsGuard.h>
+
+#include <pv/pvData.h>
+#include <pv/standardField.h>
+
+#define epicsExportSharedSymbols
+#include <pv/serverStats.h>
+#include <pv/serverContextImpl.h>
+#include <pv/serverChannelImpl.h>
+#include <pv/codec.h>
+#include <pv/remote.h>
+#include <pv/logger.h>
+
+namespace pvd = epics::pvData;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+
+const char* opNames[] = {"get", "put", "putget", "array", "process", "rpc"};
+
+int opIndex(pvd::int8 command)
+{
+    switch(command) {
+    case CMD_GET: return 0;
+    case CMD_PUT: return 1;
+    case CMD_PUT_GET: return 2;
+    case CMD_ARRAY: return 3;
+    case CMD_PROCESS: return 4;
+    case CMD_RPC: return 5;
+    default: return -1;
+    }
+}
+
+pvd::FieldBuilderPtr table()
+{
+    return pvd::getFieldCreate()->createFieldBuilder()
+            ->setId("epics:nt/NTTable:1.0")
+            ->addArray("labels", pvd::pvString);
+}
+
+pvd::PVStructure::shared_pointer build(const pvd::FieldBuilderPtr& builder)
+{
+    pvd::PVStructure::shared_pointer ret(pvd::getPVDataCreate()->createPVStructure(
+                                             builder->endNested()
+                                             ->add("timeStamp", pvd::getStandardField()->timeStamp())
+                                             ->createStructure()));
+
+    pvd::PVStringArray::svector labels;
+    const pvd::StringArray& columns = ret->getSubFieldT<pvd::PVStructure>("value")->getStructure()->getFieldNames();
+    labels.assign(columns.begin(), columns.end());
+    ret->getSubFieldT<pvd::PVStringArray>("labels")->replace(pvd::freeze(labels));
+    return ret;
+}
+
+template<typename PVA>
+void column(const pvd::PVStructure::shared_pointer& table, const char *name, typename PVA::svector& values)
+{
+    table->getSubFieldT<pvd::PVStructure>("value")->getSubFieldT<PVA>(name)->replace(pvd::freeze(values));
+}
+
+void stamp(const pvd::PVStructure::shared_pointer& table, const epicsTimeStamp& now)
+{
+    table->getSubFieldT<pvd::PVLong>("timeStamp.secondsPastEpoch")->put(now.secPastEpoch + POSIX_TIME_AT_EPICS_EPOCH);
+    table->getSubFieldT<pvd::PVInt>("timeStamp.nanoseconds")->put(now.nsec);
+}
+
+void post(pvas::SharedPV& pv, const pvd::PVStructure& value)
+{
+    pvd::BitSet changed;
+    changed.set(0);
+    pv.post(value, changed);
+}
+
+struct ChannelRow {
+    std::string name, remote;
+    double rate;
+    ServerChannel::Stats stats;
+};
+
+bool byRate(const ChannelRow& lhs, const ChannelRow& rhs)
+{
+    return lhs.rate > rhs.rate;
+}
+
+// bytes/s since the last update, or since creation for an object not seen before
+template<typename T>
+double rate(const std::map<const void*, T>& last, const std::tr1::shared_ptr<typename T::element_type>& obj,
+            size_t bytes, size_t T::* member, double elapsed)
+{
+    typename std::map<const void*, T>::const_iterator it(last.find(obj.get()));
+    size_t before = 0u;
+    if(it!=last.end() && it->second.ref.lock()==obj)
+        before = it->second.*member;
+    return elapsed>0.0 && bytes>=before ? (bytes-before)/elapsed : 0.0;
+}
+
+} // namespace
+
+// puts of "NAME=VALUE" to <prefix>:tune
+struct ServerStats::TuneHandler : public pvas::SharedPV::Handler
+{
+    epicsMutex mutex;
+    std::tr1::weak_ptr<ServerContextImpl> context;
+
+    virtual ~TuneHandler() {}
+
+    virtual void onPut(const pvas::SharedPV::shared_pointer& pv, pvas::Operation& op) OVERRIDE FINAL
+    {
+        std::tr1::shared_ptr<ServerContextImpl> ctxt;
+        {
+            Guard G(mutex);
+            ctxt = context.lock();
+        }
+        pvd::PVScalar::const_shared_pointer value(op.value().getSubField<pvd::PVScalar>("value"));
+        if(!ctxt || !value || !op.changed().get(value->getFieldOffset())) {
+            op.complete(pvd::Status::error("Expected value NAME=VALUE"));
+            return;
+        }
+
+        const std::string setting(value->getAs<std::string>());
+        const size_t sep = setting.find('=');
+        if(sep==std::string::npos || !ctxt->tune(setting.substr(0, sep), setting.substr(sep+1))) {
+            op.complete(pvd::Status::error("Can not apply "+setting));
+            return;
+        }
+
+        pv->post(op.value(), op.changed());
+        op.complete();
+    }
+};
+
+ServerStats::ServerStats(const std::string& prefix, double period, size_t top, bool tune)
+    :period(period)
+    ,top(top)
+    ,provider("stats")
+    ,channelsPV(pvas::SharedPV::buildReadOnly())
+    ,clientsPV(pvas::SharedPV::buildReadOnly())
+    ,latencyPV(pvas::SharedPV::buildReadOnly())
+    ,tunablesPV(pvas::SharedPV::buildReadOnly())
+    ,running(false)
+    ,worker(*this, "PVAS-stats",
+            epicsThreadGetStackSize(epicsThreadStackSmall),
+            epicsThreadPriorityLow)
+{
+    std::fill(requests, requests+numOps, 0u);
+    epicsTimeGetCurrent(&lastUpdate);
+
+    channelsValue = build(table()->addNestedStructure("value")
+                          ->addArray("channel", pvd::pvString)
+                          ->addArray("remote", pvd::pvString)
+                          ->addArray("bytesSentPerSec", pvd::pvDouble)
+                          ->addArray("bytesSent", pvd::pvULong)
+                          ->addArray("monitorUpdates", pvd::pvULong)
+                          ->addArray("monitorOverruns", pvd::pvULong));
+    clientsValue = build(table()->addNestedStructure("value")
+                         ->addArray("remote", pvd::pvString)
+                         ->addArray("channels", pvd::pvULong)
+                         ->addArray("queueDepth", pvd::pvULong)
+                         ->addArray("bytesSentPerSec", pvd::pvDouble)
+                         ->addArray("bytesReceivedPerSec", pvd::pvDouble)
+                         ->addArray("bytesSent", pvd::pvULong)
+                         ->addArray("bytesReceived", pvd::pvULong)
+                         ->addArray("monitorOverruns", pvd::pvULong)
+                         ->addArray("slowSquashed", pvd::pvULong)
+                         ->addArray("slowDropped", pvd::pvULong)
+                         ->addArray("slowDisconnects", pvd::pvULong));
+    latencyValue = build(table()->addNestedStructure("value")
+                         ->addArray("operation", pvd::pvString)
+                         ->addArray("requests", pvd::pvULong)
+                         ->addArray("recent", pvd::pvULong)
+                         ->addArray("p50US", pvd::pvDouble)
+                         ->addArray("p90US", pvd::pvDouble)
+                         ->addArray("p99US", pvd::pvDouble)
+                         ->addArray("maxUS", pvd::pvDouble));
+
+    tunablesValue = build(table()->addNestedStructure("value")
+                          ->addArray("name", pvd::pvString)
+                          ->addArray("value", pvd::pvString)
+                          ->addArray("live", pvd::pvBoolean));
+
+    channelsPV->open(*channelsValue);
+    clientsPV->open(*clientsValue);
+    latencyPV->open(*latencyValue);
+    tunablesPV->open(*tunablesValue);
+
+    provider.add(prefix+":stats:channels", channelsPV);
+    provider.add(prefix+":stats:clients", clientsPV);
+    provider.add(prefix+":stats:latency", latencyPV);
+    provider.add(prefix+":stats:tunables", tunablesPV);
+
+    if(tune) {
+        tuneHandler.reset(new TuneHandler);
+        tunePV = pvas::SharedPV::build(tuneHandler);
+        tunePV->open(pvd::getStandardField()->scalar(pvd::pvString, ""));
+        provider.add(prefix+":tune", tunePV);
+    }
+}
+
+ServerStats::~ServerStats()
+{
+    stop();
+}
+
+void ServerStats::start(const std::tr1::shared_ptr<ServerContextImpl>& ctxt)
+{
+    {
+        Guard G(mutex);
+        if(running)
+            return;
+        running = true;
+        context = ctxt;
+    }
+    if(tuneHandler) {
+        Guard G(tuneHandler->mutex);
+        tuneHandler->context = ctxt;
+    }
+    worker.start();
+}
+
+void ServerStats::stop()
+{
+    {
+        Guard G(mutex);
+        if(!running)
+            return;
+        running = false;
+    }
+    wakeup.signal();
+    worker.exitWait();
+
+    provider.close(true);
+}
+
+void ServerStats::recordLatency(pvd::int8 command, const epicsTimeStamp& start)
+{
+    const int op = opIndex(command);
+    if(op<0)
+        return;
+
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    const double elapsed = epicsTimeDiffInSeconds(&now, &start);
+
+    Guard G(mutex);
+    latency[op].record(elapsed);
+    requests[op]++;
+}
+
+void ServerStats::run()
+{
+    while(true) {
+        wakeup.wait(period);
+        {
+            Guard G(mutex);
+            if(!running)
+                break;
+        }
+
+        try {
+            update();
+        } catch(std::exception& e) {
+            LOG(logLevelError, "ServerStats update error: %s", e.what());
+        }
+    }
+}
+
+void ServerStats::update()
+{
+    std::tr1::shared_ptr<ServerContextImpl> ctxt;
+    LatencyHistogram recent[numOps];
+    size_t total[numOps];
+    {
+        Guard G(mutex);
+        ctxt = context.lock();
+        for(size_t i=0; i<numOps; i++) {
+            recent[i] = latency[i];
+            latency[i].reset();
+            total[i] = requests[i];
+        }
+    }
+    if(!ctxt)
+        return;
+
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    const double elapsed = epicsTimeDiffInSeconds(&now, &lastUpdate);
+    lastUpdate = now;
+
+    TransportRegistry::transportVector_t transports;
+    ctxt->getTransportRegistry()->toArray(transports);
+
+    std::map<const void*, Last<ServerChannel> > nextChannels;
+    std::map<const void*, Last<Transport> > nextClients;
+    std::vector<ChannelRow> channelRows;
+
+    pvd::PVStringArray::svector remote;
+    pvd::PVULongArray::svector nchannels, queueDepth, bytesSent, bytesReceived, overruns,
+                               slowSquashed, slowDropped, slowDisconnects;
+    pvd::PVDoubleArray::svector sentRate, receivedRate;
+
+    std::vector<ServerChannel::shared_pointer> channels;
+    for(TransportRegistry::transportVector_t::const_iterator it(transports.begin()), end(transports.end());
+        it!=end; ++it)
+    {
+        const detail::BlockingServerTCPTransportCodec *casTransport =
+                dynamic_cast<const detail::BlockingServerTCPTransportCodec*>(it->get());
+        if(!casTransport)
+            continue;
+
+        detail::TransportStatistics stats;
+        casTransport->getStatistics().snapshot(stats);
+
+        channels.clear();
+        casTransport->getChannels(channels);
+
+        size_t transportOverruns = 0u;
+        for(size_t i=0; i<channels.size(); i++) {
+            const ServerChannel::shared_pointer& chan = channels[i];
+
+            ChannelRow row;
+            row.name = chan->getChannel()->getChannelName();
+            row.remote = casTransport->getRemoteName();
+            row.stats = chan->getStats();
+            row.rate = rate(lastChannels, chan, row.stats.bytesSent, &Last<ServerChannel>::bytesSent, elapsed);
+            transportOverruns += row.stats.monitorOverruns;
+
+            Last<ServerChannel>& L = nextChannels[chan.get()];
+            L.ref = chan;
+            L.bytesSent = row.stats.bytesSent;
+            L.bytesReceived = 0u;
+
+            channelRows.push_back(row);
+        }
+
+        remote.push_back(casTransport->getRemoteName());
+        nchannels.push_back(channels.size());
+        queueDepth.push_back(casTransport->getSendQueueDepth());
+        sentRate.push_back(rate(lastClients, *it, stats.bytesSent, &Last<Transport>::bytesSent, elapsed));
+        receivedRate.push_back(rate(lastClients, *it, stats.bytesReceived, &Last<Transport>::bytesReceived, elapsed));
+        bytesSent.push_back(stats.bytesSent);
+        bytesReceived.push_back(stats.bytesReceived);
+        overruns.push_back(transportOverruns);
+        slowSquashed.push_back(stats.slowSquashed);
+        slowDropped.push_back(stats.slowDropped);
+        slowDisconnects.push_back(stats.slowDisconnects);
+
+        Last<Transport>& L = nextClients[it->get()];
+        L.ref = *it;
+        L.bytesSent = stats.bytesSent;
+        L.bytesReceived = stats.bytesReceived;
+    }
+    channels.clear();
+    transports.clear();
+
+    lastChannels.swap(nextChannels);
+    lastClients.swap(nextClients);
+
+    // top channels, by the rate of the last period
+    const size_t ntop = std::min(top, channelRows.size());
+    std::partial_sort(channelRows.begin(), channelRows.begin()+ntop, channelRows.end(), byRate);
+    channelRows.resize(ntop);
+
+    {
+        pvd::PVStringArray::svector name, cremote;
+        pvd::PVDoubleArray::svector crate;
+        pvd::PVULongArray::svector csent, cupdates, coverruns;
+        for(size_t i=0; i<channelRows.size(); i++) {
+            const ChannelRow& R = channelRows[i];
+            name.push_back(R.name);
+            cremote.push_back(R.remote);
+            crate.push_back(R.rate);
+            csent.push_back(R.stats.bytesSent);
+            cupdates.push_back(R.stats.monitorUpdates);
+            coverruns.push_back(R.stats.monitorOverruns);
+        }
+        column<pvd::PVStringArray>(channelsValue, "channel", name);
+        column<pvd::PVStringArray>(channelsValue, "remote", cremote);
+        column<pvd::PVDoubleArray>(channelsValue, "bytesSentPerSec", crate);
+        column<pvd::PVULongArray>(channelsValue, "bytesSent", csent);
+        column<pvd::PVULongArray>(channelsValue, "monitorUpdates", cupdates);
+        column<pvd::PVULongArray>(channelsValue, "monitorOverruns", coverruns);
+        stamp(channelsValue, now);
+    }
+
+    column<pvd::PVStringArray>(clientsValue, "remote", remote);
+    column<pvd::PVULongArray>(clientsValue, "channels", nchannels);
+    column<pvd::PVULongArray>(clientsValue, "queueDepth", queueDepth);
+    column<pvd::PVDoubleArray>(clientsValue, "bytesSentPerSec", sentRate);
+    column<pvd::PVDoubleArray>(clientsValue, "bytesReceivedPerSec", receivedRate);
+    column<pvd::PVULongArray>(clientsValue, "bytesSent", bytesSent);
+    column<pvd::PVULongArray>(clientsValue, "bytesReceived", bytesReceived);
+    column<pvd::PVULongArray>(clientsValue, "monitorOverruns", overruns);
+    column<pvd::PVULongArray>(clientsValue, "slowSquashed", slowSquashed);
+    column<pvd::PVULongArray>(clientsValue, "slowDropped", slowDropped);
+    column<pvd::PVULongArray>(clientsValue, "slowDisconnects", slowDisconnects);
+    stamp(clientsValue, now);
+
+    {
+        pvd::PVStringArray::svector op;
+        pvd::PVULongArray::svector nreq, nrecent;
+        pvd::PVDoubleArray::svector p50, p90, p99, max;
+        for(size_t i=0; i<numOps; i++) {
+            op.push_back(opNames[i]);
+            nreq.push_back(total[i]);
+            nrecent.push_back(recent[i].count());
+            p50.push_back(recent[i].percentile(0.5)*1e6);
+            p90.push_back(recent[i].percentile(0.9)*1e6);
+            p99.push_back(recent[i].percentile(0.99)*1e6);
+            max.push_back(recent[i].max()*1e6);
+        }
+        column<pvd::PVStringArray>(latencyValue, "operation", op);
+        column<pvd::PVULongArray>(latencyValue, "requests", nreq);
+        column<pvd::PVULongArray>(latencyValue, "recent", nrecent);
+        column<pvd::PVDoubleArray>(latencyValue, "p50US", p50);
+        column<pvd::PVDoubleArray>(latencyValue, "p90US", p90);
+        column<pvd::PVDoubleArray>(latencyValue, "p99US", p99);
+        column<pvd::PVDoubleArray>(latencyValue, "maxUS", max);
+        stamp(latencyValue, now);
+    }
+
+    {
+        std::vector<ServerContext::Tunable> tunables;
+        ctxt->tunables(tunables);
+
+        pvd::PVStringArray::svector name, value;
+        pvd::PVBooleanArray::svector live;
+        for(size_t i=0; i<tunables.size(); i++) {
+            name.push_back(tunables[i].name);
+            value.push_back(tunables[i].value);
+            live.push_back(tunables[i].live);
+        }
+        column<pvd::PVStringArray>(tunablesValue, "name", name);
+        column<pvd::PVStringArray>(tunablesValue, "value", value);
+        column<pvd::PVBooleanArray>(tunablesValue, "live", live);
+        stamp(tunablesValue, now);
+    }
+
+    post(*channelsPV, *channelsValue);
+    post(*clientsPV, *clientsValue);
+    post(*latencyPV, *latencyValue);
+    post(*tunablesPV, *tunablesValue);
+}
+
+}} // namespace epics::pvAccess
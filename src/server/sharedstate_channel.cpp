@@ -95,9 +95,14 @@ std::string SharedChannel::getRemoteAddress()
     return getChannelName(); // for lack of anything better to do...
 }
 
+void SharedChannel::printInfo(std::ostream& out)
+{
+    out<<"SharedPV value and history "<<owner->memoryUsage()<<" bytes";
+}
+
 std::string SharedChannel::getChannelName()
 {
-    return channelName;
+    return channelName.str();
 }
 
 std::tr1::shared_ptr<pva::ChannelRequester> SharedChannel::getChannelRequester()
@@ -157,16 +162,29 @@ pva::Monitor::shared_pointer SharedChannel::createMonitor(
         pva::MonitorRequester::shared_pointer const & requester,
         pvd::PVStructure::shared_pointer const & pvRequest)
 {
+    // replay history.  record[history=S] in seconds
+    double window = 0.0;
+    pvd::PVScalar::const_shared_pointer O(pvRequest ? pvRequest->getSubField<pvd::PVScalar>("record._options.history")
+                                                    : pvd::PVScalar::const_shared_pointer());
+    if(O) {
+        try {
+            window = O->getAs<double>();
+        }catch(std::exception& e){
+            requester->message(std::string("Ignoring invalid history= : ")+e.what(), pvd::warningMessage);
+        }
+    }
+
     std::tr1::shared_ptr<SharedMonitorFIFO> ret(new SharedMonitorFIFO(shared_from_this(), requester, pvRequest));
     bool notify;
     {
         Guard G(owner->mutex);
-        owner->monitors.push_back(ret.get());
+        owner->addMonitor(ret.get(), ret);
         notify = !!owner->type;
         if(notify) {
             ret->open(owner->type);
             // post initial update
-            ret->post(*owner->current, owner->valid);
+            if(window<=0.0 || !owner->replayHistory(*ret, window))
+                ret->post(*owner->current, owner->valid);
         }
     }
     if(notify)
@@ -175,17 +193,40 @@ pva::Monitor::shared_pointer SharedChannel::createMonitor(
 }
 
 
+namespace {
+// sends the updates a subscriber skipped when it has room again
+struct SkippedSource : public pva::MonitorFIFO::Source {
+    virtual ~SkippedSource() {}
+    virtual void unsaturated(pva::MonitorFIFO *mon) OVERRIDE FINAL {
+        SharedMonitorFIFO *self = static_cast<SharedMonitorFIFO*>(mon);
+        Guard G(self->channel->owner->mutex);
+        self->postSkipped(pvd::BitSet());
+    }
+};
+} // namespace
+
 SharedMonitorFIFO::SharedMonitorFIFO(const std::tr1::shared_ptr<SharedChannel>& channel,
                                      const requester_type::shared_pointer& requester,
                                      const pvd::PVStructure::const_shared_pointer &pvRequest)
-    :pva::MonitorFIFO(requester, pvRequest)
+    :pva::MonitorFIFO(requester, pvRequest, Source::shared_pointer(new SkippedSource))
     ,channel(channel)
 {}
 
 SharedMonitorFIFO::~SharedMonitorFIFO()
 {
     Guard G(channel->owner->mutex);
-    channel->owner->monitors.remove(this);
+    channel->owner->removeMonitor(this);
+}
+
+void SharedMonitorFIFO::postSkipped(const pvd::BitSet& changed)
+{
+    skipped |= changed;
+    // nothing skipped, or since close()d
+    if(skipped.isEmpty() || !channel->owner->current)
+        return;
+    post(*channel->owner->current, skipped, skippedOverrun);
+    skipped.clear();
+    skippedOverrun.clear();
 }
 
 Operation::Operation(const std::tr1::shared_ptr<Impl> impl)
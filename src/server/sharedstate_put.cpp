@@ -26,7 +26,8 @@
 namespace {
 struct PutOP : public pvas::Operation::Impl
 {
-    const std::tr1::shared_ptr<pvas::SharedPut> op;
+    // NULL while the spare of op
+    std::tr1::shared_ptr<pvas::SharedPut> op;
 
     PutOP(const std::tr1::shared_ptr<pvas::SharedPut>& op,
           const pvd::PVStructure::const_shared_pointer& pvRequest,
@@ -64,6 +65,36 @@ struct PutOP : public pvas::Operation::Impl
         if(req)
             req->putDone(sts, op);
     }
+
+    // As Operation::Impl::Cleanup, but keeps one released PutOP for the next put() of op.
+    // Its BitSet keeps its storage, and the value is the same PVStructure each time
+    // (the server deserializes each put into one), so a steady stream of puts allocates
+    // nothing but a shared_ptr control block.
+    struct Recycle {
+        void operator()(PutOP* impl) {
+            bool err;
+            {
+                Guard G(impl->mutex);
+                err = !impl->done;
+            }
+            if(err)
+                impl->complete(pvd::Status::error("Implicit Cancel"), 0);
+
+            // may be the last reference to the SharedPut, whose dtor deletes the spare.
+            // so release after unlocking.
+            std::tr1::shared_ptr<pvas::SharedPut> owner;
+            owner.swap(impl->op);
+            impl->value.reset();
+            {
+                Guard G(owner->channel->owner->mutex);
+                if(!owner->spare) {
+                    owner->spare = impl;
+                    impl = 0;
+                }
+            }
+            delete impl;
+        }
+    };
 };
 }
 
@@ -78,6 +109,8 @@ SharedPut::SharedPut(const std::tr1::shared_ptr<SharedChannel>& channel,
     :channel(channel)
     ,requester(requester)
     ,pvRequest(pvRequest)
+    ,lastGeneration(0u)
+    ,spare(0)
 {
     REFTRACE_INCREMENT(num_instances);
 }
@@ -86,6 +119,7 @@ SharedPut::~SharedPut()
 {
     Guard G(channel->owner->mutex);
     channel->owner->puts.remove(this);
+    delete spare;
     REFTRACE_DECREMENT(num_instances);
 }
 
@@ -105,13 +139,23 @@ void SharedPut::put(
         pvd::BitSet::shared_pointer const & putBitSet)
 {
     std::tr1::shared_ptr<SharedPV::Handler> handler;
+    PutOP *reuse = 0;
     {
         Guard G(channel->owner->mutex);
         handler = channel->owner->handler;
+        reuse = static_cast<PutOP*>(spare);
+        spare = 0;
     }
 
-    std::tr1::shared_ptr<PutOP> impl(new PutOP(shared_from_this(), pvRequest, pvPutStructure, *putBitSet),
-                                     Operation::Impl::Cleanup());
+    if(reuse) {
+        reuse->op = shared_from_this();
+        reuse->value = pvPutStructure;
+        reuse->changed = *putBitSet;
+        reuse->done = false;
+    } else {
+        reuse = new PutOP(shared_from_this(), pvRequest, pvPutStructure, *putBitSet);
+    }
+    std::tr1::shared_ptr<PutOP> impl(reuse, PutOP::Recycle());
 
     if(handler) {
         Operation op(impl);
@@ -135,15 +179,16 @@ void SharedPut::get()
             current = pvd::getPVDataCreate()->createPVStructure(currentType);
 
             if(currentType!=lastStruct) {
-                selectMask = pvd::extractRequestMask(current, pvRequest->getSubField<pvd::PVStructure>("field"));
-                emptyselect = selectMask.isEmpty();
+                selectMask.reset(current, pvRequest->getSubField<pvd::PVStructure>("field"));
+                emptyselect = selectMask.empty();
                 lastStruct = currentType;
             }
-            changed.reset(new pvd::BitSet(channel->owner->valid));
-            *changed &= selectMask;
+            changed.reset(new pvd::BitSet);
+            selectMask.select(*changed, channel->owner->valid);
 
             // clone
             current->copyUnchecked(*channel->owner->current, *changed);
+            lastGeneration = channel->owner->generation;
         }
     }
 
@@ -159,4 +204,10 @@ void SharedPut::get()
     req->getDone(sts, shared_from_this(), current, changed);
 }
 
+pvd::uint64 SharedPut::getGeneration()
+{
+    Guard G(channel->owner->mutex);
+    return lastGeneration;
+}
+
 } // namespace pvas
@@ -4,6 +4,7 @@
  */
 
 #include <list>
+#include <algorithm>
 
 #include <epicsMutex.h>
 #include <epicsGuard.h>
@@ -21,6 +22,8 @@
 
 #define epicsExportSharedSymbols
 #include "sharedstateimpl.h"
+#include <pv/memoryUsage.h>
+#include <pv/codec.h>
 
 
 namespace {
@@ -68,6 +71,11 @@ SharedPV::shared_pointer SharedPV::buildMailbox()
 
 SharedPV::SharedPV(const std::tr1::shared_ptr<Handler> &handler)
     :handler(handler)
+    ,monitors(new monitors_t)
+    ,generation(0u)
+    ,historyDepth(0u)
+    ,historyNext(0u)
+    ,historyCount(0u)
     ,debugLvl(0)
 {
     REFTRACE_INCREMENT(num_instances);
@@ -100,14 +108,13 @@ void SharedPV::open(const pvd::PVStructure &value, const epics::pvData::BitSet&
 {
     typedef std::vector<std::tr1::shared_ptr<SharedPut> > xputs_t;
     typedef std::vector<std::tr1::shared_ptr<SharedRPC> > xrpcs_t;
-    typedef std::vector<std::tr1::shared_ptr<pva::MonitorFIFO> > xmonitors_t;
     typedef std::vector<std::tr1::shared_ptr<pva::GetFieldRequester> > xgetfields_t;
 
     const pvd::StructureConstPtr newtype(value.getStructure());
 
     xputs_t p_put;
     xrpcs_t p_rpc;
-    xmonitors_t p_monitor;
+    monitors_ptr p_monitor;
     xgetfields_t p_getfield;
     {
         Guard I(mutex);
@@ -117,13 +124,14 @@ void SharedPV::open(const pvd::PVStructure &value, const epics::pvData::BitSet&
 
         p_put.reserve(puts.size());
         p_rpc.reserve(rpcs.size());
-        p_monitor.reserve(monitors.size());
         p_getfield.reserve(getfields.size());
 
         type = value.getStructure();
         current = pvd::getPVDataCreate()->createPVStructure(newtype);
         current->copyUnchecked(value);
         this->valid = valid;
+        generation++;
+        allocHistory();
 
         FOR_EACH(puts_t::const_iterator, it, end, puts) {
             try {
@@ -137,13 +145,13 @@ void SharedPV::open(const pvd::PVStructure &value, const epics::pvData::BitSet&
                 p_rpc.push_back((*it)->shared_from_this());
             }catch(std::tr1::bad_weak_ptr&) {}
         }
-        FOR_EACH(monitors_t::const_iterator, it, end, monitors) {
-            try {
-                (*it)->open(newtype);
-                // post initial update
-                (*it)->post(*current, valid);
-                p_monitor.push_back((*it)->shared_from_this());
-            }catch(std::tr1::bad_weak_ptr&) {}
+        p_monitor = monitors;
+        FOR_EACH(monitors_t::const_iterator, it, end, *p_monitor) {
+            it->fifo->skipped.clear();
+            it->fifo->skippedOverrun.clear();
+            it->fifo->open(newtype);
+            // post initial update
+            it->fifo->post(*current, valid);
         }
         // consume getField
         FOR_EACH(getfields_t::iterator, it, end, getfields) {
@@ -159,9 +167,7 @@ void SharedPV::open(const pvd::PVStructure &value, const epics::pvData::BitSet&
         SharedRPC::requester_type::shared_pointer requester((*it)->requester.lock());
         if(requester) requester->channelRPCConnect(pvd::Status(), *it);
     }
-    FOR_EACH(xmonitors_t::iterator, it, end, p_monitor) {
-        (*it)->notify();
-    }
+    notify(*p_monitor);
     FOR_EACH(xgetfields_t::iterator, it, end, p_getfield) {
         if(*it) (*it)->getDone(pvd::Status(), newtype);
     }
@@ -183,12 +189,11 @@ void SharedPV::close(bool destroy)
 {
     typedef std::vector<std::tr1::shared_ptr<pva::ChannelPutRequester> > xputs_t;
     typedef std::vector<std::tr1::shared_ptr<pva::ChannelRPCRequester> > xrpcs_t;
-    typedef std::vector<std::tr1::shared_ptr<pva::MonitorFIFO> > xmonitors_t;
     typedef std::vector<std::tr1::shared_ptr<SharedChannel> > xchannels_t;
 
     xputs_t p_put;
     xrpcs_t p_rpc;
-    xmonitors_t p_monitor;
+    monitors_ptr p_monitor;
     xchannels_t p_channel;
     {
         Guard I(mutex);
@@ -198,7 +203,6 @@ void SharedPV::close(bool destroy)
 
         p_put.reserve(puts.size());
         p_rpc.reserve(rpcs.size());
-        p_monitor.reserve(monitors.size());
         p_channel.reserve(channels.size());
 
         FOR_EACH(puts_t::const_iterator, it, end, puts) {
@@ -207,9 +211,11 @@ void SharedPV::close(bool destroy)
         FOR_EACH(rpcs_t::const_iterator, it, end, rpcs) {
             p_rpc.push_back((*it)->requester.lock());
         }
-        FOR_EACH(monitors_t::const_iterator, it, end, monitors) {
-            (*it)->close();
-            p_monitor.push_back((*it)->shared_from_this());
+        p_monitor = monitors;
+        FOR_EACH(monitors_t::const_iterator, it, end, *p_monitor) {
+            it->fifo->skipped.clear();
+            it->fifo->skippedOverrun.clear();
+            it->fifo->close();
         }
         FOR_EACH(channels_t::const_iterator, it, end, channels) {
             p_channel.push_back((*it)->shared_from_this());
@@ -217,12 +223,13 @@ void SharedPV::close(bool destroy)
 
         type.reset();
         current.reset();
+        history.clear();
         if(destroy) {
             // forget about all clients, to prevent the possibility of our
             // sending a second destroy notification.
             puts.clear();
             rpcs.clear();
-            monitors.clear();
+            monitors.reset(new monitors_t);
             channels.clear();
         }
     }
@@ -232,9 +239,7 @@ void SharedPV::close(bool destroy)
     FOR_EACH(xrpcs_t::iterator, it, end, p_rpc) {
         if(*it) (*it)->channelDisconnect(destroy);
     }
-    FOR_EACH(xmonitors_t::iterator, it, end, p_monitor) {
-        (*it)->notify();
-    }
+    notify(*p_monitor);
     FOR_EACH(xchannels_t::iterator, it, end, p_channel) {
         pva::ChannelRequester::shared_pointer req((*it)->requester.lock());
         if(!req) continue;
@@ -253,30 +258,125 @@ pvd::PVStructure::shared_pointer SharedPV::build()
 void SharedPV::post(const pvd::PVStructure& value,
                     const pvd::BitSet& changed)
 {
-    typedef std::vector<std::tr1::shared_ptr<pva::MonitorFIFO> > xmonitors_t;
-    xmonitors_t p_monitor;
-    {
-        Guard I(mutex);
+    monitors_ptr p_monitor;
+    post(value, changed, p_monitor);
+    notify(*p_monitor);
+}
 
-        if(!type)
-            throw std::logic_error("Not open()");
-        else if(*type!=*value.getStructure())
-            throw std::logic_error("Type mis-match");
+void SharedPV::post(const pvd::PVStructure& value,
+                    const pvd::BitSet& changed,
+                    monitors_ptr& p_monitor)
+{
+    Guard I(mutex);
 
-        if(current) {
-            current->copyUnchecked(value, changed);
-            valid |= changed;
-        }
+    if(!type)
+        throw std::logic_error("Not open()");
+    else if(*type!=*value.getStructure())
+        throw std::logic_error("Type mis-match");
+
+    if(current) {
+        current->copyUnchecked(value, changed);
+        valid |= changed;
+    }
+    generation++;
+
+    if(!history.empty()) {
+        HistoryEntry& ent = history[historyNext];
+        ent.value->copyUnchecked(*current);
+        ent.changed = changed;
+        ent.valid = valid;
+        epicsTimeGetCurrent(&ent.time);
+        historyNext = (historyNext+1u)%history.size();
+        if(historyCount<history.size())
+            historyCount++;
+    }
 
-        p_monitor.reserve(monitors.size()); // ick, for lack of a list with thread-safe iteration
+    // replaced, not modified, by (un)subscribe.  So may be iterated after unlock
+    p_monitor = monitors;
 
-        FOR_EACH(monitors_t::const_iterator, it, end, monitors) {
-            (*it)->post(value, changed);
-            p_monitor.push_back((*it)->shared_from_this());
+    // A saturated subscriber would only squash this update into the last it has queued,
+    // so it is skipped until it has room again.  cf. SharedMonitorFIFO::postSkipped()
+    size_t nready = 0u;
+    FOR_EACH(monitors_t::const_iterator, it, end, *p_monitor) {
+        if(!it->fifo->saturated())
+            nready++;
+    }
+
+    // subscribers receiving this update unchanged share one copy, and its serialization
+    pva::SharedUpdate::shared_pointer shared;
+    if(nready>1u) {
+        pvd::PVStructurePtr snapshot(pvd::getPVDataCreate()->createPVStructure(type));
+        snapshot->copyUnchecked(value, changed);
+        shared.reset(new pva::SharedUpdate(snapshot));
+    }
+
+    FOR_EACH(monitors_t::const_iterator, it, end, *p_monitor) {
+        SharedMonitorFIFO *fifo = it->fifo;
+        if(fifo->saturated()) {
+            fifo->skippedOverrun.or_and(fifo->skipped, changed);
+            fifo->skipped |= changed;
+        } else if(!fifo->skipped.isEmpty()) {
+            // has room, before its Source was told
+            fifo->postSkipped(changed);
+        } else {
+            fifo->post(value, changed, pvd::BitSet(), shared);
         }
     }
-    FOR_EACH(xmonitors_t::iterator, it, end, p_monitor) {
-        (*it)->notify();
+}
+
+void SharedPV::addMonitor(SharedMonitorFIFO* fifo, const std::tr1::shared_ptr<pva::MonitorFIFO>& ref)
+{
+    // copy on write.  Subscribing is rare compared with post()
+    std::tr1::shared_ptr<monitors_t> temp(new monitors_t(*monitors));
+    MonitorRef M;
+    M.fifo = fifo;
+    M.ref = ref;
+    temp->push_back(M);
+    monitors = temp;
+}
+
+void SharedPV::removeMonitor(SharedMonitorFIFO* fifo)
+{
+    std::tr1::shared_ptr<monitors_t> temp(new monitors_t);
+    temp->reserve(monitors->size());
+    FOR_EACH(monitors_t::const_iterator, it, end, *monitors) {
+        if(it->fifo!=fifo)
+            temp->push_back(*it);
+    }
+    monitors = temp;
+}
+
+void SharedPV::notify(const monitors_t& subscribers)
+{
+    FOR_EACH(monitors_t::const_iterator, it, end, subscribers) {
+        // NULL if racing destruction
+        std::tr1::shared_ptr<pva::MonitorFIFO> fifo(it->ref.lock());
+        if(fifo)
+            fifo->notify();
+    }
+}
+
+void SharedPV::getSubscriberStats(std::vector<SubscriberStats>& stats) const
+{
+    monitors_ptr p_monitor;
+    {
+        Guard I(mutex);
+        p_monitor = monitors;
+    }
+
+    stats.reserve(stats.size()+p_monitor->size());
+    FOR_EACH(monitors_t::const_iterator, it, end, *p_monitor) {
+        std::tr1::shared_ptr<pva::MonitorFIFO> fifo(it->ref.lock());
+        if(!fifo)
+            continue;
+        pva::Monitor::Stats S;
+        fifo->getStats(S);
+        SubscriberStats ent;
+        ent.nfilled = S.nfilled;
+        ent.noutstanding = S.noutstanding;
+        ent.nempty = S.nempty;
+        ent.nbytes = fifo->memoryUsage();
+        stats.push_back(ent);
     }
 }
 
@@ -303,6 +403,53 @@ SharedPV::connect(const std::tr1::shared_ptr<epics::pvAccess::ChannelProvider> &
     return ret;
 }
 
+size_t SharedPV::memoryUsage() const
+{
+    Guard G(mutex);
+    size_t ret = 0u;
+    if(current)
+        ret += pva::memoryUsage(*current);
+    for(size_t i=0; i<history.size(); i++) {
+        if(history[i].value)
+            ret += pva::memoryUsage(*history[i].value);
+    }
+    return ret;
+}
+
+void SharedPV::setHistory(size_t depth)
+{
+    Guard G(mutex);
+    historyDepth = depth;
+    if(type)
+        allocHistory();
+}
+
+void SharedPV::allocHistory()
+{
+    std::vector<HistoryEntry> temp(historyDepth);
+    for(size_t i=0; i<temp.size(); i++)
+        temp[i].value = pvd::getPVDataCreate()->createPVStructure(type);
+    history.swap(temp);
+    historyNext = historyCount = 0u;
+}
+
+bool SharedPV::replayHistory(pva::MonitorFIFO& fifo, double window) const
+{
+    epicsTime oldest(epicsTime::getCurrent());
+    oldest -= window;
+
+    bool first = true;
+    for(size_t n=0; n<historyCount; n++) {
+        const HistoryEntry& ent = history[(historyNext+history.size()-historyCount+n)%history.size()];
+        if(epicsTime(ent.time) < oldest)
+            continue;
+        // the first as a complete value.  force so that none are squashed by a short queue
+        fifo.tryPost(*ent.value, first ? ent.valid : ent.changed, pvd::BitSet(), true);
+        first = false;
+    }
+    return !first;
+}
+
 void SharedPV::setDebug(int lvl)
 {
     Guard G(mutex);
@@ -315,4 +462,46 @@ int SharedPV::isDebug() const
     return debugLvl;
 }
 
+PostBatch::PostBatch() {}
+
+PostBatch::~PostBatch()
+{
+    try {
+        flush();
+    }catch(std::exception& e){
+        errlogPrintf("Unhandled exception from PostBatch::flush() : %s\n", e.what());
+    }
+}
+
+void PostBatch::post(SharedPV& pv,
+                     const pvd::PVStructure& value,
+                     const pvd::BitSet& changed)
+{
+    SharedPV::monitors_ptr subscribers;
+    pv.post(value, changed, subscribers);
+    pending.reserve(pending.size()+subscribers->size());
+    FOR_EACH(SharedPV::monitors_t::const_iterator, it, end, *subscribers) {
+        std::tr1::shared_ptr<pva::MonitorFIFO> fifo(it->ref.lock());
+        if(fifo)
+            pending.push_back(fifo);
+    }
+}
+
+void PostBatch::flush()
+{
+    SharedPV::notify_t temp;
+    temp.swap(pending);
+
+    // a subscription posted to more than once is notified once
+    std::sort(temp.begin(), temp.end());
+    temp.erase(std::unique(temp.begin(), temp.end()), temp.end());
+
+    // wake the transport of each subscriber once, after all are queued
+    pva::detail::SendBatch hold;
+
+    FOR_EACH(SharedPV::notify_t::iterator, it, end, temp) {
+        (*it)->notify();
+    }
+}
+
 } // namespace pvas
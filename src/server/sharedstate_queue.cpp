@@ -0,0 +1,198 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <map>
+#include <vector>
+#include <string.h>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <errlog.h>
+
+#include <shareLib.h>
+#include <pv/sharedPtr.h>
+#include <pv/bitSet.h>
+#include <pv/pvData.h>
+
+#define epicsExportSharedSymbols
+#include "sharedstateimpl.h"
+
+namespace pvas {
+
+struct PostQueue::Impl : public epicsThreadRunable
+{
+    struct Slot {
+        std::tr1::weak_ptr<SharedPV> pv;
+        // filled by post().  Swapped with sending by flush(), so each is reused
+        pvd::PVStructure::shared_pointer value, sending;
+        pvd::BitSet changed, sendChanged;
+        bool queued;
+        Slot() :queued(false) {}
+    };
+    // nodes are not moved, so queued may point to them
+    typedef std::map<const SharedPV*, Slot> slots_t;
+
+    // forget PVs which have gone away, after this many flushes
+    static const size_t pruneInterval = 64u;
+
+    const double period;
+
+    mutable epicsMutex mutex;
+    slots_t slots;
+    std::vector<Slot*> queued;
+    Stats stats;
+    bool running;
+
+    // held by flush(), while Slot::sending is posted without mutex
+    epicsMutex flushLock;
+
+    epicsEvent wakeup;
+    std::tr1::shared_ptr<epicsThread> worker;
+
+    explicit Impl(double period)
+        :period(period)
+        ,running(period>0.0)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+    virtual ~Impl() {}
+
+    void flush();
+
+    virtual void run() OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        while(running) {
+            {
+                UnGuard U(G);
+                wakeup.wait(period);
+                try {
+                    flush();
+                }catch(std::exception& e){
+                    errlogPrintf("Unhandled exception from PostQueue::flush() : %s\n", e.what());
+                }
+            }
+        }
+    }
+};
+
+const size_t PostQueue::Impl::pruneInterval;
+
+void PostQueue::Impl::flush()
+{
+    Guard F(flushLock);
+
+    std::vector<Slot*> sending;
+    bool prune;
+    {
+        Guard G(mutex);
+        sending.swap(queued);
+        for(size_t i=0; i<sending.size(); i++) {
+            Slot& slot = *sending[i];
+            slot.value.swap(slot.sending);
+            slot.changed.swap(slot.sendChanged);
+            slot.changed.clear();
+            slot.queued = false;
+        }
+        prune = ++stats.flushes % pruneInterval == 0u;
+        stats.flushed += sending.size();
+        stats.queued = 0u;
+    }
+
+    {
+        PostBatch batch;
+        for(size_t i=0; i<sending.size(); i++) {
+            Slot& slot = *sending[i];
+            SharedPV::shared_pointer pv(slot.pv.lock());
+            if(pv && pv->isOpen())
+                batch.post(*pv, *slot.sending, slot.sendChanged);
+        }
+        // ~PostBatch notifies subscribers
+    }
+
+    if(prune) {
+        Guard G(mutex);
+        for(slots_t::iterator it(slots.begin()), end(slots.end()); it!=end; ) {
+            if(!it->second.queued && it->second.pv.expired())
+                slots.erase(it++);
+            else
+                ++it;
+        }
+    }
+}
+
+PostQueue::PostQueue(double period)
+    :impl(new Impl(period))
+{
+    if(impl->running) {
+        impl->worker.reset(new epicsThread(*impl, "PVAS-postq",
+                                           epicsThreadGetStackSize(epicsThreadStackSmall),
+                                           epicsThreadPriorityMedium));
+        impl->worker->start();
+    }
+}
+
+PostQueue::~PostQueue()
+{
+    {
+        Guard G(impl->mutex);
+        impl->running = false;
+    }
+    if(impl->worker) {
+        impl->wakeup.signal();
+        impl->worker->exitWait();
+    }
+    try {
+        impl->flush();
+    }catch(std::exception& e){
+        errlogPrintf("Unhandled exception from PostQueue::flush() : %s\n", e.what());
+    }
+}
+
+void PostQueue::post(const SharedPV::shared_pointer& pv,
+                     const pvd::PVStructure& value,
+                     const pvd::BitSet& changed)
+{
+    Guard G(impl->mutex);
+    Impl::Slot& slot = impl->slots[pv.get()];
+
+    if(slot.pv.lock()!=pv) {
+        // new, or a PV which has gone away, and whose address is re-used
+        slot.pv = pv;
+        slot.changed.clear();
+    }
+    if(!slot.value || slot.value->getStructure()!=value.getStructure()) {
+        // first update, or PV re-open()'d with a different type, losing any update queued with the old
+        slot.value = pvd::getPVDataCreate()->createPVStructure(value.getStructure());
+        slot.changed.clear();
+    }
+
+    slot.value->copyUnchecked(value, changed);
+    slot.changed |= changed;
+
+    impl->stats.posted++;
+    if(slot.queued) {
+        impl->stats.merged++;
+    } else {
+        slot.queued = true;
+        impl->queued.push_back(&slot);
+        impl->stats.queued++;
+    }
+}
+
+void PostQueue::flush()
+{
+    impl->flush();
+}
+
+void PostQueue::getStats(Stats& out) const
+{
+    Guard G(impl->mutex);
+    out = impl->stats;
+}
+
+} // namespace pvas
@@ -8,6 +8,8 @@
 #include "pva/sharedstate.h"
 #include <pv/pvAccess.h>
 #include <pv/reftrack.h>
+#include <pv/requestMask.h>
+#include <pv/internedName.h>
 
 #define FOR_EACH(TYPE, IT, END, OBJ) for(TYPE IT((OBJ).begin()), END((OBJ).end()); IT != END; ++IT)
 
@@ -25,7 +27,8 @@ struct SharedChannel : public pva::Channel,
     static size_t num_instances;
 
     const std::tr1::shared_ptr<SharedPV> owner;
-    const std::string channelName;
+    // many clients may open channels to one PV
+    const pva::InternedName channelName;
     const requester_type::weak_pointer requester;
     const pva::ChannelProvider::weak_pointer provider;
 
@@ -41,6 +44,8 @@ struct SharedChannel : public pva::Channel,
     virtual std::string getRemoteAddress() OVERRIDE FINAL;
     virtual std::string getChannelName() OVERRIDE FINAL;
     virtual std::tr1::shared_ptr<pva::ChannelRequester> getChannelRequester() OVERRIDE FINAL;
+    using pva::Channel::printInfo;
+    virtual void printInfo(std::ostream& out) OVERRIDE FINAL;
 
     virtual void getField(pva::GetFieldRequester::shared_pointer const & requester,std::string const & subField) OVERRIDE FINAL;
 
@@ -60,10 +65,15 @@ struct SharedChannel : public pva::Channel,
 struct SharedMonitorFIFO : public pva::MonitorFIFO
 {
     const std::tr1::shared_ptr<SharedChannel> channel;
+    // guarded by PV mutex.  Fields changed, and changed more than once,
+    // by the updates not post()ed while saturated()
+    pvd::BitSet skipped, skippedOverrun;
     SharedMonitorFIFO(const std::tr1::shared_ptr<SharedChannel>& channel,
                       const requester_type::shared_pointer& requester,
                       const pvd::PVStructure::const_shared_pointer &pvRequest);
     virtual ~SharedMonitorFIFO();
+    // call with PV mutex held.  post() the current value with the fields skipped
+    void postSkipped(const pvd::BitSet& changed);
 };
 
 struct SharedPut : public pva::ChannelPut,
@@ -75,7 +85,10 @@ struct SharedPut : public pva::ChannelPut,
 
     // guarded by PV mutex
     pvd::StructureConstPtr lastStruct;
-    pvd::BitSet selectMask;
+    pva::RequestMask selectMask;
+    pvd::uint64 lastGeneration;
+    // a released Operation of an earlier put(), kept for the next.  Owned.
+    Operation::Impl *spare;
 
     static size_t num_instances;
 
@@ -94,6 +107,7 @@ struct SharedPut : public pva::ChannelPut,
         epics::pvData::BitSet::shared_pointer const & putBitSet) OVERRIDE FINAL;
 
     virtual void get() OVERRIDE FINAL;
+    virtual pvd::uint64 getGeneration() OVERRIDE FINAL;
 };
 
 struct SharedRPC : public pva::ChannelRPC,
@@ -124,8 +138,10 @@ struct Operation::Impl
 
     epicsMutex mutex;
 
-    const pvd::PVStructure::const_shared_pointer pvRequest, value;
-    const pvd::BitSet changed;
+    const pvd::PVStructure::const_shared_pointer pvRequest;
+    // replaced only while not referenced by any Operation, when an Impl is reused
+    pvd::PVStructure::const_shared_pointer value;
+    pvd::BitSet changed;
 
     bool done;
     int debugLvl;
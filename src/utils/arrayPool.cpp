@@ -0,0 +1,212 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <algorithm>
+
+#include <epicsGuard.h>
+
+#define epicsExportSharedSymbols
+#include <pv/arrayPool.h>
+
+using namespace epics::pvData;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+bool pooled(const ScalarArray& type)
+{
+    return type.getArraySizeType()==Array::variable && type.getElementType()!=pvString;
+}
+}
+
+// deleter of pooled storage
+struct ArrayPool::Return {
+    std::tr1::weak_ptr<ArrayPool> pool;
+    Block block;
+    size_t bytes;
+
+    Return(const std::tr1::weak_ptr<ArrayPool>& pool, const Block& block, size_t bytes)
+        :pool(pool), block(block), bytes(bytes)
+    {}
+    void operator()(void*)
+    {
+        ArrayPool::shared_pointer P(pool.lock());
+        if(P)
+            P->give(block, bytes);
+        else
+            destroy(block, bytes);
+    }
+};
+
+ArrayPool::ArrayPool(size_t maxBytes)
+    :_maxBytes(maxBytes)
+    ,held(0u)
+    ,nreused(0u)
+    ,nallocated(0u)
+{}
+
+ArrayPool::~ArrayPool()
+{
+    for(blocks_t::iterator it(blocks.begin()), end(blocks.end()); it!=end; ++it)
+        destroy(it->second, it->first);
+}
+
+bool ArrayPool::applies(const Structure& type)
+{
+    const FieldConstPtrArray& fields(type.getFields());
+    for(size_t i=0; i<fields.size(); i++) {
+        const Field& field(*fields[i]);
+        if(field.getType()==scalarArray && pooled(static_cast<const ScalarArray&>(field)))
+            return true;
+        else if(field.getType()==structure && applies(static_cast<const Structure&>(field)))
+            return true;
+    }
+    return false;
+}
+
+void ArrayPool::prepare(PVStructure& value, const BitSet& changed)
+{
+    if(peak.size() < value.getNumberFields())
+        peak.resize(value.getNumberFields(), 0u);
+
+    for(int32 next = changed.nextSetBit(0); next>=0 && size_t(next)<peak.size(); ) {
+        PVField *field = next==0 ? &value : value.getSubField(next).get();
+        if(!field)
+            break;
+        // the whole field, skipping any set bits within it
+        visit(*field);
+        next = changed.nextSetBit(uint32(field->getNextFieldOffset()));
+    }
+}
+
+void ArrayPool::visit(PVField& field)
+{
+    switch(field.getField()->getType()) {
+    case structure: {
+        const PVFieldPtrArray& fields(static_cast<PVStructure&>(field).getPVFields());
+        for(size_t i=0; i<fields.size(); i++)
+            visit(*fields[i]);
+        break;
+    }
+    case scalarArray: {
+        PVScalarArray& arr(static_cast<PVScalarArray&>(field));
+        if(!pooled(*arr.getScalarArray()))
+            break;
+        switch(arr.getScalarArray()->getElementType()) {
+        case pvBoolean: detach(static_cast<PVValueArray<boolean>&>(arr)); break;
+        case pvByte:    detach(static_cast<PVValueArray<int8>&>(arr)); break;
+        case pvShort:   detach(static_cast<PVValueArray<int16>&>(arr)); break;
+        case pvInt:     detach(static_cast<PVValueArray<int32>&>(arr)); break;
+        case pvLong:    detach(static_cast<PVValueArray<int64>&>(arr)); break;
+        case pvUByte:   detach(static_cast<PVValueArray<uint8>&>(arr)); break;
+        case pvUShort:  detach(static_cast<PVValueArray<uint16>&>(arr)); break;
+        case pvUInt:    detach(static_cast<PVValueArray<uint32>&>(arr)); break;
+        case pvULong:   detach(static_cast<PVValueArray<uint64>&>(arr)); break;
+        case pvFloat:   detach(static_cast<PVValueArray<float>&>(arr)); break;
+        case pvDouble:  detach(static_cast<PVValueArray<double>&>(arr)); break;
+        default:
+            break;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+template<typename T>
+void ArrayPool::detach(PVValueArray<T>& arr)
+{
+    typedef typename PVValueArray<T>::const_svector const_svector;
+
+    const const_svector& current(arr.view());
+    size_t& longest = peak[arr.getFieldOffset()];
+    longest = std::max(longest, current.size()*sizeof(T));
+
+    if(current.unique())
+        return; // pvData reuses it while the new length fits
+
+    if(longest==0u) {
+        // nothing to copy, or reuse
+        arr.replace(const_svector());
+        return;
+    }
+
+    size_t bytes = longest;
+    Block block(take(bytes));
+    shared_vector<T> storage(reinterpret_cast<T*>(block.data),
+                             Return(shared_from_this(), block, bytes),
+                             0u, bytes/sizeof(T));
+    // empty, with the capacity of the block
+    storage.resize(0u);
+    arr.replace(freeze(storage));
+}
+
+ArrayPool::Block ArrayPool::take(size_t& bytes)
+{
+    {
+        Guard G(mutex);
+        blocks_t::iterator it(blocks.lower_bound(bytes));
+        if(it!=blocks.end()) {
+            Block block(it->second);
+            bytes = it->first;
+            held -= bytes;
+            blocks.erase(it);
+            nreused++;
+            return block;
+        }
+        nallocated++;
+    }
+    Block block;
+    block.from = BufferPool::allocator();
+    block.data = block.from ? block.from->allocate(bytes) : new char[bytes];
+    return block;
+}
+
+void ArrayPool::give(const Block& block, size_t bytes)
+{
+    {
+        Guard G(mutex);
+        if(held + bytes <= _maxBytes) {
+            blocks.insert(std::make_pair(bytes, block));
+            held += bytes;
+            return;
+        }
+    }
+    destroy(block, bytes);
+}
+
+void ArrayPool::destroy(const Block& block, size_t bytes)
+{
+    if(block.from)
+        block.from->release(block.data, bytes);
+    else
+        delete[] block.data;
+}
+
+size_t ArrayPool::bytes() const
+{
+    Guard G(mutex);
+    return held;
+}
+
+size_t ArrayPool::reused() const
+{
+    Guard G(mutex);
+    return nreused;
+}
+
+size_t ArrayPool::allocated() const
+{
+    Guard G(mutex);
+    return nallocated;
+}
+
+}
+}
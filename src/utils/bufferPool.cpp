@@ -0,0 +1,178 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <stdlib.h>
+#include <map>
+#include <vector>
+#include <new>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsThread.h>
+#include <pv/reftrack.h>
+
+#define epicsExportSharedSymbols
+#include <pv/bufferPool.h>
+
+namespace {
+
+typedef epicsGuard<epicsMutex> Guard;
+
+const size_t granule = 4096u;
+const size_t maxCached = 64u*1024u*1024u;
+
+// map from size class to free blocks
+struct Pool {
+    epicsMutex lock;
+    typedef std::map<size_t, std::vector<char*> > free_t;
+    free_t free;
+    size_t cachedBytes;
+    // blocks allocated and not released.  Unlike num_used, counted without REFTRACE
+    size_t used;
+    // NULL for malloc().  Set once
+    epics::pvAccess::BlockAllocator *alloc;
+    Pool() :cachedBytes(0u), used(0u), alloc(0) {}
+};
+
+// never freed, as codecs may outlive static destructors
+Pool *pool;
+epicsThreadOnceId poolOnce = EPICS_THREAD_ONCE_INIT;
+
+void poolInit(void*)
+{
+    pool = new Pool;
+}
+
+size_t sizeClass(size_t size)
+{
+    return ((size + granule - 1u)/granule)*granule;
+}
+
+// a block counted by allocate() was not allocated after all
+void unused()
+{
+    Guard G(pool->lock);
+    pool->used--;
+    REFTRACE_DECREMENT(epics::pvAccess::BufferPool::num_used);
+}
+
+} // namespace
+
+namespace epics {
+namespace pvAccess {
+
+size_t BufferPool::num_free;
+size_t BufferPool::num_used;
+size_t BufferPool::num_hits;
+size_t BufferPool::num_misses;
+
+char* BufferPool::allocate(std::size_t size)
+{
+    epicsThreadOnce(&poolOnce, &poolInit, 0);
+
+    const size_t cls = sizeClass(size);
+    BlockAllocator *alloc;
+    {
+        Guard G(pool->lock);
+        Pool::free_t::iterator it(pool->free.find(cls));
+        if(it!=pool->free.end() && !it->second.empty()) {
+            char *ret = it->second.back();
+            it->second.pop_back();
+            pool->cachedBytes -= cls;
+            pool->used++;
+            REFTRACE_DECREMENT(num_free);
+            REFTRACE_INCREMENT(num_used);
+            REFTRACE_INCREMENT(num_hits);
+            return ret;
+        }
+        // counted while locked, so the allocator is not changed before the block is released
+        alloc = pool->alloc;
+        pool->used++;
+        REFTRACE_INCREMENT(num_used);
+    }
+
+    char *ret = alloc ? 0 : (char*)malloc(cls);
+    if(alloc) {
+        try {
+            ret = alloc->allocate(cls);
+        } catch(...) {
+            unused();
+            throw;
+        }
+    } else if(!ret) {
+        unused();
+        throw std::bad_alloc();
+    }
+    REFTRACE_INCREMENT(num_misses);
+    return ret;
+}
+
+void BufferPool::release(char* block, std::size_t size)
+{
+    if(!block)
+        return;
+
+    const size_t cls = sizeClass(size);
+    BlockAllocator *alloc;
+    {
+        Guard G(pool->lock);
+        pool->used--;
+        REFTRACE_DECREMENT(num_used);
+        if(pool->cachedBytes + cls <= maxCached) {
+            pool->free[cls].push_back(block);
+            pool->cachedBytes += cls;
+            REFTRACE_INCREMENT(num_free);
+            return;
+        }
+        alloc = pool->alloc;
+    }
+    if(alloc)
+        alloc->release(block, cls);
+    else
+        free(block);
+}
+
+bool BufferPool::setAllocator(BlockAllocator* alloc)
+{
+    epicsThreadOnce(&poolOnce, &poolInit, 0);
+
+    Pool::free_t cached;
+    {
+        Guard G(pool->lock);
+        if(!alloc || pool->alloc || pool->used!=0u)
+            return false;
+        // blocks cached from malloc() are freed, not given to alloc
+        cached.swap(pool->free);
+        pool->cachedBytes = 0u;
+        pool->alloc = alloc;
+    }
+    for(Pool::free_t::iterator it(cached.begin()), end(cached.end()); it!=end; ++it) {
+        for(size_t i=0; i<it->second.size(); i++) {
+            free(it->second[i]);
+            REFTRACE_DECREMENT(num_free);
+        }
+    }
+    return true;
+}
+
+size_t BufferPool::cachedBytes()
+{
+    epicsThreadOnce(&poolOnce, &poolInit, 0);
+
+    Guard G(pool->lock);
+    return pool->cachedBytes;
+}
+
+BlockAllocator* BufferPool::allocator()
+{
+    epicsThreadOnce(&poolOnce, &poolInit, 0);
+
+    Guard G(pool->lock);
+    return pool->alloc;
+}
+
+}
+}
@@ -145,6 +145,95 @@ void ConfigurationStack::addKeys(keys_t& names) const
         (*it)->addKeys(names);
 }
 
+ConfigurationCache::ConfigurationCache(const Configuration::const_shared_pointer& backend)
+    :backend(backend)
+{
+    if(!backend)
+        THROW_EXCEPTION2(std::invalid_argument, "ConfigurationCache requires a Configuration");
+}
+
+ConfigurationCache::~ConfigurationCache() {}
+
+Configuration::shared_pointer ConfigurationCache::wrap(const Configuration::const_shared_pointer& conf)
+{
+    Configuration::shared_pointer ret(std::tr1::const_pointer_cast<Configuration>(conf));
+    if(!std::tr1::dynamic_pointer_cast<ConfigurationCache>(ret))
+        ret.reset(new ConfigurationCache(conf));
+    return ret;
+}
+
+bool ConfigurationCache::tryGetPropertyAsString(const std::string& name, std::string* val) const
+{
+    Lock guard(mutex);
+    cache_t::iterator it(cache.find(name));
+    if(it==cache.end()) {
+        Entry ent;
+        ent.found = backend->tryGetPropertyAsString(name, &ent.value);
+        it = cache.insert(std::make_pair(name, ent)).first;
+    }
+    if(it->second.found && val)
+        *val = it->second.value;
+    return it->second.found;
+}
+
+void ConfigurationCache::addKeys(keys_t& names) const
+{
+    keys_t mine(backend->keys());
+    names.insert(mine.begin(), mine.end());
+}
+
+size_t ConfigurationCache::reload()
+{
+    std::vector<std::string> changed;
+    listeners_t notify;
+    {
+        Lock guard(mutex);
+        for(cache_t::iterator it(cache.begin()), end(cache.end()); it!=end; ++it) {
+            Entry ent;
+            ent.found = backend->tryGetPropertyAsString(it->first, &ent.value);
+            if(ent.found!=it->second.found || ent.value!=it->second.value) {
+                it->second = ent;
+                changed.push_back(it->first);
+            }
+        }
+        notify = listeners;
+    }
+
+    for(size_t i=0; i<changed.size(); i++) {
+        for(size_t l=0; l<notify.size(); l++) {
+            ConfigurationListener::shared_pointer listener(notify[l].lock());
+            if(listener)
+                listener->propertyChanged(changed[i], *this);
+        }
+    }
+    return changed.size();
+}
+
+void ConfigurationCache::addListener(const ConfigurationListener::shared_pointer& listener)
+{
+    Lock guard(mutex);
+    // forget those expired
+    listeners_t::iterator out(listeners.begin());
+    for(listeners_t::iterator it(listeners.begin()), end(listeners.end()); it!=end; ++it) {
+        if(!it->expired())
+            *out++ = *it;
+    }
+    listeners.erase(out, listeners.end());
+    listeners.push_back(listener);
+}
+
+void ConfigurationCache::removeListener(const ConfigurationListener::shared_pointer& listener)
+{
+    Lock guard(mutex);
+    for(listeners_t::iterator it(listeners.begin()); it!=listeners.end(); ) {
+        ConfigurationListener::shared_pointer L(it->lock());
+        if(!L || L==listener)
+            it = listeners.erase(it);
+        else
+            ++it;
+    }
+}
+
 ConfigurationBuilder::ConfigurationBuilder() :stack(new ConfigurationStack) {}
 
 ConfigurationBuilder& ConfigurationBuilder::push_env()
@@ -0,0 +1,213 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#ifdef __linux__
+#  include <pthread.h>
+#  include <sched.h>
+#  include <unistd.h>
+#  include <dirent.h>
+#  include <ifaddrs.h>
+#  include <sys/syscall.h>
+#  include <linux/mempolicy.h>
+#endif
+
+#define epicsExportSharedSymbols
+#include <pv/cpuAffinity.h>
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+// the first line of a sysfs attribute
+bool readLine(const std::string& path, std::string& line)
+{
+    std::ifstream strm(path.c_str());
+    return !!std::getline(strm, line);
+}
+} // namespace
+
+bool CPUAffinity::parse(const std::string& list)
+{
+    std::vector<unsigned> temp;
+    std::string trimmed(list);
+    trimmed.erase(std::remove_if(trimmed.begin(), trimmed.end(), ::isspace), trimmed.end());
+
+    std::istringstream strm(trimmed);
+    std::string range;
+    while(std::getline(strm, range, ',')) {
+        char *end = 0;
+        unsigned long first = strtoul(range.c_str(), &end, 10), last = first;
+        if(end==range.c_str())
+            return false;
+        if(*end=='-') {
+            const char *start = end+1;
+            last = strtoul(start, &end, 10);
+            if(end==start)
+                return false;
+        }
+        if(*end || last<first || last>=4096u)
+            return false;
+        for(unsigned long cpu=first; cpu<=last; cpu++)
+            temp.push_back(unsigned(cpu));
+    }
+
+    cpus.clear();
+    for(size_t i=0; i<temp.size(); i++)
+        add(temp[i]);
+    return true;
+}
+
+void CPUAffinity::add(unsigned cpu)
+{
+    std::vector<unsigned>::iterator it(std::lower_bound(cpus.begin(), cpus.end(), cpu));
+    if(it==cpus.end() || *it!=cpu)
+        cpus.insert(it, cpu);
+}
+
+std::string CPUAffinity::toString() const
+{
+    std::ostringstream strm;
+    for(size_t i=0; i<cpus.size(); ) {
+        size_t j = i;
+        while(j+1u<cpus.size() && cpus[j+1u]==cpus[j]+1u)
+            j++;
+        if(i)
+            strm<<',';
+        strm<<cpus[i];
+        if(j>i)
+            strm<<'-'<<cpus[j];
+        i = j+1u;
+    }
+    return strm.str();
+}
+
+#ifdef __linux__
+
+bool CPUAffinity::pin() const
+{
+    if(cpus.empty())
+        return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(size_t i=0; i<cpus.size(); i++) {
+        if(cpus[i] < unsigned(CPU_SETSIZE))
+            CPU_SET(cpus[i], &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set)==0;
+}
+
+int CPUAffinity::node() const
+{
+    if(cpus.empty())
+        return -1;
+    // eg. /sys/devices/system/cpu/cpu3/node0
+    std::ostringstream path;
+    path<<"/sys/devices/system/cpu/cpu"<<cpus.front();
+    int ret = -1;
+    if(DIR *dir = opendir(path.str().c_str())) {
+        while(struct dirent *ent = readdir(dir)) {
+            if(strncmp(ent->d_name, "node", 4)==0 && ent->d_name[4]>='0' && ent->d_name[4]<='9') {
+                ret = atoi(ent->d_name+4);
+                break;
+            }
+        }
+        closedir(dir);
+    }
+    return ret;
+}
+
+CPUAffinity CPUAffinity::current()
+{
+    CPUAffinity ret;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set)==0) {
+        for(unsigned cpu=0; cpu<unsigned(CPU_SETSIZE); cpu++) {
+            if(CPU_ISSET(cpu, &set))
+                ret.cpus.push_back(cpu);
+        }
+    }
+    return ret;
+}
+
+CPUAffinity CPUAffinity::ofNode(int node)
+{
+    CPUAffinity ret;
+    std::ostringstream path;
+    path<<"/sys/devices/system/node/node"<<node<<"/cpulist";
+    std::string line;
+    if(node<0 || !readLine(path.str(), line) || !ret.parse(line))
+        ret.cpus.clear();
+    return ret;
+}
+
+int CPUAffinity::nodeOfAddress(const osiSockAddr& addr)
+{
+    if(addr.sa.sa_family!=AF_INET)
+        return -1;
+
+    std::string name;
+    struct ifaddrs *list = 0;
+    if(getifaddrs(&list))
+        return -1;
+    for(struct ifaddrs *ifa = list; ifa; ifa = ifa->ifa_next) {
+        if(ifa->ifa_addr && ifa->ifa_addr->sa_family==AF_INET
+                && ((const sockaddr_in*)ifa->ifa_addr)->sin_addr.s_addr==addr.ia.sin_addr.s_addr) {
+            name = ifa->ifa_name;
+            break;
+        }
+    }
+    freeifaddrs(list);
+
+    // virtual interfaces have no device.  -1 where the platform has no NUMA
+    std::string line;
+    if(name.empty() || !readLine("/sys/class/net/"+name+"/device/numa_node", line))
+        return -1;
+    return atoi(line.c_str());
+}
+
+bool CPUAffinity::placeMemory(void *buf, std::size_t len, int node)
+{
+#ifdef SYS_mbind
+    if(node<0)
+        return false;
+    const size_t page = size_t(sysconf(_SC_PAGESIZE));
+    size_t start = (size_t(buf) + page-1u) & ~(page-1u),
+           end = (size_t(buf) + len) & ~(page-1u);
+    if(end<=start)
+        return true;
+
+    const size_t bits = 8u*sizeof(unsigned long);
+    std::vector<unsigned long> mask(size_t(node)/bits + 1u, 0ul);
+    mask[size_t(node)/bits] |= 1ul<<(size_t(node)%bits);
+    return syscall(SYS_mbind, (void*)start, end-start, MPOL_PREFERRED,
+                   &mask[0], mask.size()*bits + 1u, MPOL_MF_MOVE)==0;
+#else
+    return false;
+#endif
+}
+
+#else // !__linux__
+
+bool CPUAffinity::pin() const { return cpus.empty(); }
+int CPUAffinity::node() const { return -1; }
+CPUAffinity CPUAffinity::current() { return CPUAffinity(); }
+CPUAffinity CPUAffinity::ofNode(int) { return CPUAffinity(); }
+int CPUAffinity::nodeOfAddress(const osiSockAddr&) { return -1; }
+bool CPUAffinity::placeMemory(void *, std::size_t, int) { return false; }
+
+#endif // __linux__
+
+}
+}
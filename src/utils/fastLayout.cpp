@@ -0,0 +1,357 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include <pv/standardField.h>
+#include <pv/serializeHelper.h>
+
+#define epicsExportSharedSymbols
+#include <pv/fieldOffsets.h>
+#include <pv/serializationHelper.h>
+
+using namespace epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+
+/* Offsets in a structure of value, alarm and timeStamp, as PVStructure numbers them.
+ * So the set bits of a changed BitSet are taken in the order pvData serializes them.
+ */
+enum {
+    oValue = 1,
+    oAlarm, oSeverity, oStatus, oMessage,
+    oTimeStamp, oSeconds, oNanoseconds, oUserTag,
+    oEnd
+};
+
+// a value field of a scalar type
+template<typename T>
+struct ScalarValue {
+    static const char* name() { return ScalarTypeFunc::name(ScalarTypeID<T>::value); }
+    static void serialize(ByteBuffer *buffer, SerializableControl *control, const PVField& field)
+    {
+        control->ensureBuffer(sizeof(T));
+        buffer->put<T>(static_cast<const PVScalarValue<T>&>(field).get());
+    }
+    static void deserialize(ByteBuffer *buffer, DeserializableControl *control, PVField& field)
+    {
+        control->ensureData(sizeof(T));
+        static_cast<PVScalarValue<T>&>(field).put(buffer->get<T>());
+    }
+};
+
+template<>
+struct ScalarValue<std::string> {
+    static const char* name() { return "string"; }
+    static void serialize(ByteBuffer *buffer, SerializableControl *control, const PVField& field)
+    {
+        SerializeHelper::serializeString(static_cast<const PVString&>(field).get(), buffer, control);
+    }
+    static void deserialize(ByteBuffer *buffer, DeserializableControl *control, PVField& field)
+    {
+        static_cast<PVString&>(field).put(SerializeHelper::deserializeString(buffer, control));
+    }
+};
+
+// eg. an array, which pvData already copies in bulk
+struct AnyValue {
+    static const char* name() { return "any"; }
+    static void serialize(ByteBuffer *buffer, SerializableControl *control, const PVField& field)
+    {
+        field.serialize(buffer, control);
+    }
+    static void deserialize(ByteBuffer *buffer, DeserializableControl *control, PVField& field)
+    {
+        field.deserialize(buffer, control);
+    }
+};
+
+/* a value field of an array of 2, 4 or 8 byte numbers.  pvData sends in bulk, and receives
+ * in bulk when the byte order matches.  When it does not, swap a buffer full at a time,
+ * instead of pvData's element by element.
+ */
+template<typename T>
+struct ArrayValue {
+    static const char* name()
+    {
+        switch(ScalarTypeID<T>::value) {
+        case pvShort:  return "short[]";
+        case pvInt:    return "int[]";
+        case pvLong:   return "long[]";
+        case pvUShort: return "ushort[]";
+        case pvUInt:   return "uint[]";
+        case pvULong:  return "ulong[]";
+        case pvFloat:  return "float[]";
+        default:       return "double[]";
+        }
+    }
+    static void serialize(ByteBuffer *buffer, SerializableControl *control, const PVField& field)
+    {
+        field.serialize(buffer, control);
+    }
+    static void deserialize(ByteBuffer *buffer, DeserializableControl *control, PVField& field)
+    {
+        if(!buffer->reverse<T>()
+                || static_cast<const ScalarArray&>(*field.getField()).getArraySizeType()!=Array::variable) {
+            field.deserialize(buffer, control);
+            return;
+        }
+
+        PVValueArray<T>& array(static_cast<PVValueArray<T>&>(field));
+        const size_t count = SerializeHelper::readSize(buffer, control);
+
+        // re-use the previous value when not shared
+        typename PVValueArray<T>::const_svector prev;
+        array.swap(prev);
+        shared_vector<T> next(thaw(prev));
+        next.resize(count);
+
+        char *cur = (char*)next.data();
+        for(size_t remaining = count; remaining; ) {
+            control->ensureData(sizeof(T));
+            const size_t n = std::min(remaining, buffer->getRemaining()/sizeof(T));
+            SerializationHelper::copySwapped(cur, buffer->getBuffer() + buffer->getPosition(), n, sizeof(T));
+            buffer->setPosition(buffer->getPosition() + n*sizeof(T));
+            cur += n*sizeof(T);
+            remaining -= n;
+        }
+        array.replace(freeze(next));
+    }
+};
+
+inline const PVField& child(const PVField& parent, size_t index)
+{
+    return *static_cast<const PVStructure&>(parent).getPVFields()[index];
+}
+
+inline PVField& child(PVField& parent, size_t index)
+{
+    return *static_cast<PVStructure&>(parent).getPVFields()[index];
+}
+
+template<typename T>
+inline T get(const PVField& field)
+{
+    return static_cast<const PVScalarValue<T>&>(field).get();
+}
+
+template<typename T>
+inline void put(PVField& field, T value)
+{
+    static_cast<PVScalarValue<T>&>(field).put(value);
+}
+
+template<typename Value>
+struct NTScalarLayout
+{
+    static void serializeAlarm(ByteBuffer *buffer, SerializableControl *control, const PVField& alarm)
+    {
+        control->ensureBuffer(8u);
+        buffer->put<int32>(get<int32>(child(alarm, 0)));
+        buffer->put<int32>(get<int32>(child(alarm, 1)));
+        SerializeHelper::serializeString(get<std::string>(child(alarm, 2)), buffer, control);
+    }
+
+    static void serializeTimeStamp(ByteBuffer *buffer, SerializableControl *control, const PVField& stamp)
+    {
+        control->ensureBuffer(16u);
+        buffer->put<int64>(get<int64>(child(stamp, 0)));
+        buffer->put<int32>(get<int32>(child(stamp, 1)));
+        buffer->put<int32>(get<int32>(child(stamp, 2)));
+    }
+
+    static void serialize(ByteBuffer *buffer, SerializableControl *control,
+                          const PVStructure& top, const BitSet& changed)
+    {
+        const PVFieldPtrArray& fields(top.getPVFields());
+        const PVField& alarm(*fields[1]);
+        const PVField& stamp(*fields[2]);
+
+        for(int32 next = changed.nextSetBit(0); next>=0 && next<oEnd; next = changed.nextSetBit(next)) {
+            switch(next) {
+            case 0:
+                Value::serialize(buffer, control, *fields[0]);
+                serializeAlarm(buffer, control, alarm);
+                serializeTimeStamp(buffer, control, stamp);
+                return;
+            case oValue:
+                Value::serialize(buffer, control, *fields[0]);
+                next = oAlarm;
+                break;
+            case oAlarm:
+                serializeAlarm(buffer, control, alarm);
+                next = oTimeStamp;
+                break;
+            case oSeverity:
+            case oStatus:
+                control->ensureBuffer(4u);
+                buffer->put<int32>(get<int32>(child(alarm, next-oSeverity)));
+                next++;
+                break;
+            case oMessage:
+                SerializeHelper::serializeString(get<std::string>(child(alarm, 2)), buffer, control);
+                next++;
+                break;
+            case oTimeStamp:
+                serializeTimeStamp(buffer, control, stamp);
+                next = oEnd;
+                break;
+            case oSeconds:
+                control->ensureBuffer(8u);
+                buffer->put<int64>(get<int64>(child(stamp, 0)));
+                next++;
+                break;
+            default: // nanoseconds or userTag
+                control->ensureBuffer(4u);
+                buffer->put<int32>(get<int32>(child(stamp, next-oSeconds)));
+                next++;
+                break;
+            }
+        }
+    }
+
+    static void deserializeAlarm(ByteBuffer *buffer, DeserializableControl *control, PVField& alarm)
+    {
+        control->ensureData(8u);
+        put<int32>(child(alarm, 0), buffer->get<int32>());
+        put<int32>(child(alarm, 1), buffer->get<int32>());
+        put<std::string>(child(alarm, 2), SerializeHelper::deserializeString(buffer, control));
+    }
+
+    static void deserializeTimeStamp(ByteBuffer *buffer, DeserializableControl *control, PVField& stamp)
+    {
+        control->ensureData(16u);
+        put<int64>(child(stamp, 0), buffer->get<int64>());
+        put<int32>(child(stamp, 1), buffer->get<int32>());
+        put<int32>(child(stamp, 2), buffer->get<int32>());
+    }
+
+    static void deserialize(ByteBuffer *buffer, DeserializableControl *control,
+                            PVStructure& top, const BitSet& changed)
+    {
+        const PVFieldPtrArray& fields(top.getPVFields());
+        PVField& alarm(*fields[1]);
+        PVField& stamp(*fields[2]);
+
+        for(int32 next = changed.nextSetBit(0); next>=0 && next<oEnd; next = changed.nextSetBit(next)) {
+            switch(next) {
+            case 0:
+                Value::deserialize(buffer, control, *fields[0]);
+                deserializeAlarm(buffer, control, alarm);
+                deserializeTimeStamp(buffer, control, stamp);
+                return;
+            case oValue:
+                Value::deserialize(buffer, control, *fields[0]);
+                next = oAlarm;
+                break;
+            case oAlarm:
+                deserializeAlarm(buffer, control, alarm);
+                next = oTimeStamp;
+                break;
+            case oSeverity:
+            case oStatus:
+                control->ensureData(4u);
+                put<int32>(child(alarm, next-oSeverity), buffer->get<int32>());
+                next++;
+                break;
+            case oMessage:
+                put<std::string>(child(alarm, 2), SerializeHelper::deserializeString(buffer, control));
+                next++;
+                break;
+            case oTimeStamp:
+                deserializeTimeStamp(buffer, control, stamp);
+                next = oEnd;
+                break;
+            case oSeconds:
+                control->ensureData(8u);
+                put<int64>(child(stamp, 0), buffer->get<int64>());
+                next++;
+                break;
+            default: // nanoseconds or userTag
+                control->ensureData(4u);
+                put<int32>(child(stamp, next-oSeconds), buffer->get<int32>());
+                next++;
+                break;
+            }
+        }
+    }
+
+    static const FastLayout* instance()
+    {
+        static const FastLayout layout = {&serialize, &deserialize, Value::name()};
+        return &layout;
+    }
+};
+
+const FastLayout* ntScalar(ScalarType type)
+{
+    switch(type) {
+    case pvByte:   return NTScalarLayout<ScalarValue<int8> >::instance();
+    case pvShort:  return NTScalarLayout<ScalarValue<int16> >::instance();
+    case pvInt:    return NTScalarLayout<ScalarValue<int32> >::instance();
+    case pvLong:   return NTScalarLayout<ScalarValue<int64> >::instance();
+    case pvUByte:  return NTScalarLayout<ScalarValue<uint8> >::instance();
+    case pvUShort: return NTScalarLayout<ScalarValue<uint16> >::instance();
+    case pvUInt:   return NTScalarLayout<ScalarValue<uint32> >::instance();
+    case pvULong:  return NTScalarLayout<ScalarValue<uint64> >::instance();
+    case pvFloat:  return NTScalarLayout<ScalarValue<float> >::instance();
+    case pvDouble: return NTScalarLayout<ScalarValue<double> >::instance();
+    case pvString: return NTScalarLayout<ScalarValue<std::string> >::instance();
+    default:       return NTScalarLayout<AnyValue>::instance();
+    }
+}
+
+const FastLayout* ntScalarArray(ScalarType type)
+{
+    switch(type) {
+    case pvShort:  return NTScalarLayout<ArrayValue<int16> >::instance();
+    case pvInt:    return NTScalarLayout<ArrayValue<int32> >::instance();
+    case pvLong:   return NTScalarLayout<ArrayValue<int64> >::instance();
+    case pvUShort: return NTScalarLayout<ArrayValue<uint16> >::instance();
+    case pvUInt:   return NTScalarLayout<ArrayValue<uint32> >::instance();
+    case pvULong:  return NTScalarLayout<ArrayValue<uint64> >::instance();
+    case pvFloat:  return NTScalarLayout<ArrayValue<float> >::instance();
+    case pvDouble: return NTScalarLayout<ArrayValue<double> >::instance();
+    default:       return NTScalarLayout<AnyValue>::instance();
+    }
+}
+
+} // namespace
+
+bool FastLayout::candidate(const Structure& type, size_t nfields)
+{
+    // eg. epics:nt/NTScalar:1.0 and epics:nt/NTScalarArray:1.0
+    return nfields==size_t(oEnd) && strncmp(type.getID().c_str(), "epics:nt/NTScalar", 17)==0;
+}
+
+const FastLayout* FastLayout::select(const Structure& type)
+{
+    const std::string& id(type.getID());
+    if(id!="epics:nt/NTScalar:1.0" && id!="epics:nt/NTScalarArray:1.0")
+        return 0;
+
+    const StringArray& names(type.getFieldNames());
+    const FieldConstPtrArray& fields(type.getFields());
+    if(fields.size()!=3u || names[0]!="value" || names[1]!="alarm" || names[2]!="timeStamp")
+        return 0;
+
+    StandardFieldPtr standard(getStandardField());
+    if(*fields[1]!=*standard->alarm() || *fields[2]!=*standard->timeStamp())
+        return 0;
+
+    if(fields[0]->getType()==scalar)
+        return ntScalar(static_cast<const Scalar&>(*fields[0]).getScalarType());
+    else if(fields[0]->getType()==scalarArray)
+        return ntScalarArray(static_cast<const ScalarArray&>(*fields[0]).getElementType());
+    return 0;
+}
+
+}
+}
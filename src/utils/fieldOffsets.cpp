@@ -0,0 +1,173 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <map>
+#include <algorithm>
+
+#include <epicsThread.h>
+
+#include <pv/lock.h>
+
+#define epicsExportSharedSymbols
+#include <pv/fieldOffsets.h>
+
+using namespace epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+
+/* Tables of the Structures in use, by identity.  Holds no reference to a Structure,
+ * so a table is forgotten after its type is released.
+ */
+struct OffsetsTable {
+    typedef std::pair<std::tr1::weak_ptr<const Field>, FieldOffsets::const_shared_pointer> entry_t;
+    typedef std::map<const Structure*, entry_t> table_t;
+
+    Mutex mutex;
+    table_t table;
+    // at which size expired entries are removed next
+    size_t sweepAt;
+
+    OffsetsTable() :sweepAt(1024u) {}
+
+    FieldOffsets::const_shared_pointer of(const StructureConstPtr& type)
+    {
+        Lock G(mutex);
+        table_t::iterator it(table.find(type.get()));
+        // the same address may have been reused by another type
+        if(it!=table.end() && it->second.first.lock()==type)
+            return it->second.second;
+
+        FieldOffsets::const_shared_pointer offsets(new FieldOffsets(*type));
+        table[type.get()] = entry_t(std::tr1::weak_ptr<const Field>(type), offsets);
+
+        if(table.size() >= sweepAt)
+        {
+            for(table_t::iterator it = table.begin(); it != table.end(); )
+            {
+                if(it->second.first.expired())
+                    table.erase(it++);
+                else
+                    ++it;
+            }
+            sweepAt = std::max(size_t(1024u), 2u*table.size());
+        }
+        return offsets;
+    }
+};
+
+OffsetsTable *offsetsTable;
+epicsThreadOnceId offsetsTableOnce = EPICS_THREAD_ONCE_INIT;
+
+void offsetsTableInit(void *)
+{
+    offsetsTable = new OffsetsTable;
+}
+
+} // namespace
+
+FieldOffsets::FieldOffsets(const Structure& type)
+    :fast(FastLayout::select(type))
+{
+    // the top structure
+    Entry top = {0u, 0u};
+    entries.push_back(top);
+    add(type, 0u);
+}
+
+FieldOffsets::~FieldOffsets() {}
+
+void FieldOffsets::add(const Structure& type, size_t offset)
+{
+    const FieldConstPtrArray& fields(type.getFields());
+    for(size_t i=0; i<fields.size(); i++) {
+        Entry E = {uint32(offset), uint32(i)};
+        const size_t child = entries.size();
+        entries.push_back(E);
+        if(fields[i]->getType()==structure)
+            add(static_cast<const Structure&>(*fields[i]), child);
+    }
+}
+
+FieldOffsets::const_shared_pointer FieldOffsets::of(const StructureConstPtr& type)
+{
+    epicsThreadOnce(&offsetsTableOnce, &offsetsTableInit, 0);
+    return offsetsTable->of(type);
+}
+
+PVField* FieldOffsets::find(const PVStructure& value, size_t offset) const
+{
+    const Entry& E(entries[offset]);
+    const PVStructure *parent = E.parent==0u ? &value : static_cast<const PVStructure*>(find(value, E.parent));
+    return parent->getPVFields()[E.index].get();
+}
+
+void serializeChanged(ByteBuffer *buffer,
+                      SerializableControl *control,
+                      const PVStructure& value,
+                      const BitSet& changed)
+{
+    const size_t nfields = value.getNumberFields();
+    if(value.getFieldOffset()==0u && FastLayout::candidate(*value.getStructure(), nfields)) {
+        FieldOffsets::const_shared_pointer offsets(FieldOffsets::of(value.getStructure()));
+        if(const FastLayout *fast = offsets->layout()) {
+            (*fast->serialize)(buffer, control, value, changed);
+            return;
+        }
+    }
+    if(nfields < FieldOffsets::minFields || value.getFieldOffset()!=0u) {
+        // which does not modify changed
+        value.serialize(buffer, control, const_cast<BitSet*>(&changed));
+        return;
+    }
+
+    FieldOffsets::const_shared_pointer offsets(FieldOffsets::of(value.getStructure()));
+    for(int32 next = changed.nextSetBit(0); next>=0 && size_t(next)<nfields; ) {
+        if(next==0) {
+            value.serialize(buffer, control);
+            return;
+        }
+        // the whole field, skipping any set bits within it
+        const PVField* field = offsets->find(value, next);
+        field->serialize(buffer, control);
+        next = changed.nextSetBit(uint32(field->getNextFieldOffset()));
+    }
+}
+
+void deserializeChanged(ByteBuffer *buffer,
+                        DeserializableControl *control,
+                        PVStructure& value,
+                        const BitSet& changed)
+{
+    const size_t nfields = value.getNumberFields();
+    if(value.getFieldOffset()==0u && FastLayout::candidate(*value.getStructure(), nfields)) {
+        FieldOffsets::const_shared_pointer offsets(FieldOffsets::of(value.getStructure()));
+        if(const FastLayout *fast = offsets->layout()) {
+            (*fast->deserialize)(buffer, control, value, changed);
+            return;
+        }
+    }
+    if(nfields < FieldOffsets::minFields || value.getFieldOffset()!=0u) {
+        value.deserialize(buffer, control, const_cast<BitSet*>(&changed));
+        return;
+    }
+
+    FieldOffsets::const_shared_pointer offsets(FieldOffsets::of(value.getStructure()));
+    for(int32 next = changed.nextSetBit(0); next>=0 && size_t(next)<nfields; ) {
+        if(next==0) {
+            value.deserialize(buffer, control);
+            return;
+        }
+        PVField* field = offsets->find(value, next);
+        field->deserialize(buffer, control);
+        next = changed.nextSetBit(uint32(field->getNextFieldOffset()));
+    }
+}
+
+}
+}
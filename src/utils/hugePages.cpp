@@ -0,0 +1,235 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <map>
+#include <vector>
+#include <new>
+
+#include <stdlib.h>
+#include <epicsString.h>
+
+#ifdef __linux__
+#  include <sys/mman.h>
+#endif
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <pv/reftrack.h>
+
+#define epicsExportSharedSymbols
+#include <pv/bufferPool.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+const size_t smallPage = 2u*1024u*1024u;
+// smaller blocks use malloc()
+const size_t minHuge = 512u*1024u;
+
+#ifdef __linux__
+bool mapReserved(size_t len, size_t page, char*& block)
+{
+#ifdef MAP_HUGETLB
+    int flags = MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB;
+#  ifdef MAP_HUGE_SHIFT
+    // log2 of the page size
+    flags |= (page==smallPage ? 21 : 30) << MAP_HUGE_SHIFT;
+#  endif
+    void *ret = mmap(0, len, PROT_READ|PROT_WRITE, flags, -1, 0);
+    if(ret!=MAP_FAILED) {
+        block = static_cast<char*>(ret);
+        return true;
+    }
+#endif
+    return false;
+}
+
+// normal pages, aligned so that the kernel may back them with transparent huge pages
+char* mapTransparent(size_t len)
+{
+    void *raw = mmap(0, len + smallPage, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(raw==MAP_FAILED)
+        throw std::bad_alloc();
+
+    char *start = static_cast<char*>(raw);
+    char *aligned = reinterpret_cast<char*>((size_t(start) + smallPage - 1u) & ~(smallPage - 1u));
+    if(aligned!=start)
+        munmap(start, aligned-start);
+    if(aligned+len != start+len+smallPage)
+        munmap(aligned+len, (start+len+smallPage) - (aligned+len));
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, len, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+#endif // __linux__
+
+} // namespace
+
+namespace epics {
+namespace pvAccess {
+
+size_t HugePageAllocator::num_reserved;
+size_t HugePageAllocator::num_transparent;
+
+struct HugePageAllocator::Pvt {
+    const size_t pageSize, maxCached;
+
+    mutable epicsMutex lock;
+    // map from size class to free blocks
+    typedef std::map<size_t, std::vector<char*> > free_t;
+    free_t free;
+    size_t cachedBytes;
+    // mapped, including those cached
+    size_t mappedBytes;
+
+    Pvt(size_t pageSize, size_t maxCached)
+        :pageSize(pageSize), maxCached(maxCached), cachedBytes(0u), mappedBytes(0u)
+    {}
+
+    // the page size of a block, or 0 for malloc()
+    size_t pageOf(size_t size) const {
+#ifdef __linux__
+        if(size < minHuge)
+            return 0u;
+        return size >= pageSize/2u ? pageSize : smallPage;
+#else
+        (void)size;
+        return 0u;
+#endif
+    }
+
+    static size_t sizeClass(size_t size, size_t page) {
+        return ((size + page - 1u)/page)*page;
+    }
+};
+
+HugePageAllocator::HugePageAllocator(std::size_t pageSize, std::size_t maxCached)
+    :pvt(new Pvt(pageSize > smallPage ? pageSize : smallPage, maxCached))
+{}
+
+HugePageAllocator::~HugePageAllocator()
+{
+#ifdef __linux__
+    for(Pvt::free_t::iterator it(pvt->free.begin()), end(pvt->free.end()); it!=end; ++it) {
+        for(size_t i=0; i<it->second.size(); i++)
+            munmap(it->second[i], it->first);
+    }
+#endif
+    delete pvt;
+}
+
+char* HugePageAllocator::allocate(std::size_t size)
+{
+    const size_t page = pvt->pageOf(size);
+    if(!page) {
+        char *ret = (char*)malloc(size);
+        if(!ret)
+            throw std::bad_alloc();
+        return ret;
+    }
+
+    const size_t cls = Pvt::sizeClass(size, page);
+    {
+        Guard G(pvt->lock);
+        Pvt::free_t::iterator it(pvt->free.find(cls));
+        if(it!=pvt->free.end() && !it->second.empty()) {
+            char *ret = it->second.back();
+            it->second.pop_back();
+            pvt->cachedBytes -= cls;
+            return ret;
+        }
+    }
+
+    char *ret = 0;
+#ifdef __linux__
+    if(mapReserved(cls, page, ret)) {
+        REFTRACE_INCREMENT(num_reserved);
+    } else {
+        ret = mapTransparent(cls);
+        REFTRACE_INCREMENT(num_transparent);
+    }
+#endif
+    {
+        Guard G(pvt->lock);
+        pvt->mappedBytes += cls;
+    }
+    return ret;
+}
+
+void HugePageAllocator::release(char* block, std::size_t size)
+{
+    if(!block)
+        return;
+
+    const size_t page = pvt->pageOf(size);
+    if(!page) {
+        ::free(block);
+        return;
+    }
+
+    const size_t cls = Pvt::sizeClass(size, page);
+    {
+        Guard G(pvt->lock);
+        if(pvt->cachedBytes + cls <= pvt->maxCached) {
+            pvt->free[cls].push_back(block);
+            pvt->cachedBytes += cls;
+            return;
+        }
+        pvt->mappedBytes -= cls;
+    }
+#ifdef __linux__
+    munmap(block, cls);
+#endif
+}
+
+const char* HugePageAllocator::name() const
+{
+#ifdef __linux__
+    return pvt->pageSize==smallPage ? "huge pages 2MB" : "huge pages 1GB";
+#else
+    return "malloc";
+#endif
+}
+
+std::size_t HugePageAllocator::bytes() const
+{
+    Guard G(pvt->lock);
+    return pvt->mappedBytes;
+}
+
+std::size_t HugePageAllocator::pageSize() const
+{
+    return pvt->pageSize;
+}
+
+bool HugePageAllocator::install(const std::string& setting)
+{
+    size_t page;
+    if(setting.empty() || epicsStrCaseCmp(setting.c_str(), "NO")==0)
+        return true;
+    else if(epicsStrCaseCmp(setting.c_str(), "YES")==0 || epicsStrCaseCmp(setting.c_str(), "2M")==0)
+        page = smallPage;
+    else if(epicsStrCaseCmp(setting.c_str(), "1G")==0)
+        page = 1024u*1024u*1024u;
+    else
+        return false;
+
+    if(!BufferPool::allocator()) {
+        HugePageAllocator *alloc = new HugePageAllocator(page);
+        if(BufferPool::setAllocator(alloc))
+            return true;
+        delete alloc;
+    }
+
+    // eg. installed by another context
+    const HugePageAllocator *current = dynamic_cast<const HugePageAllocator*>(BufferPool::allocator());
+    return current && current->pageSize()==page;
+}
+
+}
+}
@@ -5,6 +5,7 @@
  */
 
 #include <vector>
+#include <map>
 #include <cstring>
 #include <cstdlib>
 #include <sstream>
@@ -12,10 +13,12 @@
 #include <osiSock.h>
 #include <ellLib.h>
 #include <errlog.h>
+#include <epicsTime.h>
 
 #include <pv/pvType.h>
 #include <pv/byteBuffer.h>
 #include <pv/epicsException.h>
+#include <pv/lock.h>
 
 #define epicsExportSharedSymbols
 #include <pv/inetAddressUtil.h>
@@ -72,9 +75,8 @@ bool decodeAsIPv6Address(ByteBuffer* buffer, osiSockAddr* address) {
 }
 
 bool isMulticastAddress(const osiSockAddr* address) {
-    uint32_t ipv4Addr = ntohl(address->ia.sin_addr.s_addr);
-    uint8_t msB = (uint8_t)((ipv4Addr>>24)&0xFF);
-    return msB >= 224 && msB <= 239;
+    // 224.0.0.0/4
+    return (ntohl(address->ia.sin_addr.s_addr)&0xf0000000u) == 0xe0000000u;
 }
 
 void intToIPv4Address(osiSockAddr& ret, int32 addr) {
@@ -500,5 +502,70 @@ int discoverInterfaces(IfaceNodeVector &list, SOCKET socket, const osiSockAddr *
 
 #endif
 
+namespace {
+// results of discoverInterfaces() keyed by match address
+struct IfaceCacheEntry {
+    IfaceNodeVector list;
+    epicsTime fetched;
+};
+typedef std::pair<int, uint32_t> iface_key_t;
+typedef std::map<iface_key_t, IfaceCacheEntry> iface_cache_t;
+
+epics::pvData::Mutex ifaceCacheMutex;
+iface_cache_t ifaceCache;
+double ifaceCacheTimeout = 10.0; // seconds
+
+iface_key_t ifaceKey(const osiSockAddr *pMatchAddr)
+{
+    // NULL, AF_UNSPEC, and INADDR_ANY all select every non-loopback interface
+    if(!pMatchAddr || pMatchAddr->sa.sa_family==AF_UNSPEC
+            || (pMatchAddr->sa.sa_family==AF_INET && pMatchAddr->ia.sin_addr.s_addr==htonl(INADDR_ANY)))
+        return iface_key_t(AF_UNSPEC, 0u);
+    return iface_key_t(pMatchAddr->sa.sa_family,
+                       pMatchAddr->sa.sa_family==AF_INET ? pMatchAddr->ia.sin_addr.s_addr : 0u);
+}
+}
+
+int discoverInterfacesCached(IfaceNodeVector &list, SOCKET socket, const osiSockAddr *pMatchAddr)
+{
+    const iface_key_t key(ifaceKey(pMatchAddr));
+    epicsTime now(epicsTime::getCurrent());
+    {
+        Lock G(ifaceCacheMutex);
+        iface_cache_t::const_iterator it(ifaceCache.find(key));
+        if(it!=ifaceCache.end() && now - it->second.fetched < ifaceCacheTimeout) {
+            list.insert(list.end(), it->second.list.begin(), it->second.list.end());
+            return 0;
+        }
+    }
+
+    // enumerate without holding the lock.  Concurrent misses may each enumerate, last one wins.
+    IfaceCacheEntry ent;
+    int ret = discoverInterfaces(ent.list, socket, pMatchAddr);
+    if(ret)
+        return ret;
+    ent.fetched = now;
+
+    list.insert(list.end(), ent.list.begin(), ent.list.end());
+    {
+        Lock G(ifaceCacheMutex);
+        ifaceCache[key] = ent;
+    }
+    return 0;
+}
+
+void invalidateInterfaceCache()
+{
+    Lock G(ifaceCacheMutex);
+    ifaceCache.clear();
+}
+
+void setInterfaceCacheTimeout(double timeout)
+{
+    Lock G(ifaceCacheMutex);
+    ifaceCacheTimeout = timeout;
+    ifaceCache.clear();
+}
+
 }
 }
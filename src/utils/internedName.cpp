@@ -0,0 +1,140 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <map>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsThread.h>
+#include <epicsString.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_INTERNED_USE_ATOMIC
+#endif
+#endif
+
+#define epicsExportSharedSymbols
+#include <pv/internedName.h>
+
+namespace epics {
+namespace pvAccess {
+
+typedef epicsGuard<epicsMutex> Guard;
+
+// the nodes of names are the Entry
+struct InternedName::Table {
+    epicsMutex lock;
+    std::map<std::string, Info> names;
+};
+
+namespace {
+// never freed, as names may be held by static objects
+void *theTable;
+epicsThreadOnceId tableOnce = EPICS_THREAD_ONCE_INIT;
+}
+
+InternedName::Table& InternedName::table()
+{
+    struct Init {
+        static void init(void*) { theTable = new Table; }
+    };
+    epicsThreadOnce(&tableOnce, &Init::init, 0);
+    return *static_cast<Table*>(theTable);
+}
+
+size_t InternedName::num_names;
+
+InternedName::Entry* InternedName::acquire(const std::string& name)
+{
+    Table& T = table();
+    Guard G(T.lock);
+    std::map<std::string, Info>::iterator it(T.names.find(name));
+    if(it==T.names.end()) {
+        Info info;
+        info.refs = 0u;
+        info.hash = epicsMemHash(name.c_str(), name.size(), 0);
+        it = T.names.insert(std::make_pair(name, info)).first;
+        num_names++;
+    }
+#ifdef PVA_INTERNED_USE_ATOMIC
+    // others may be copying or releasing without the lock
+    epics::atomic::increment(it->second.refs);
+#else
+    it->second.refs++;
+#endif
+    return &*it;
+}
+
+void InternedName::release()
+{
+#ifdef PVA_INTERNED_USE_ATOMIC
+    // other than the last, without locking.  Copies are only made from an InternedName
+    // which exists, so a count greater than one can't fall to zero meanwhile.
+    for(size_t refs = epics::atomic::get(entry->second.refs); refs>1u; ) {
+        size_t prev = epics::atomic::compareAndSwap(entry->second.refs, refs, refs-1u);
+        if(prev==refs)
+            return;
+        refs = prev;
+    }
+
+    // the last, unless acquire() finds it first
+    Table& T = table();
+    Guard G(T.lock);
+    const bool last = epics::atomic::decrement(entry->second.refs)==0u;
+#else
+    Table& T = table();
+    Guard G(T.lock);
+    const bool last = --entry->second.refs==0u;
+#endif
+    if(last) {
+        T.names.erase(T.names.find(entry->first));
+        num_names--;
+    }
+}
+
+InternedName::InternedName()
+    :entry(acquire(std::string()))
+{}
+
+InternedName::InternedName(const std::string& name)
+    :entry(acquire(name))
+{}
+
+InternedName::InternedName(const InternedName& other)
+    :entry(other.entry)
+{
+#ifdef PVA_INTERNED_USE_ATOMIC
+    epics::atomic::increment(entry->second.refs);
+#else
+    Guard G(table().lock);
+    entry->second.refs++;
+#endif
+}
+
+InternedName& InternedName::operator=(const InternedName& other)
+{
+    if(entry!=other.entry) {
+        InternedName temp(other);
+        swap(temp);
+    }
+    return *this;
+}
+
+InternedName::~InternedName()
+{
+    release();
+}
+
+const std::string& InternedName::str() const
+{
+    return entry->first;
+}
+
+}
+}
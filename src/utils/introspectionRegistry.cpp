@@ -4,6 +4,10 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <algorithm>
+
+#include <epicsThread.h>
+
 #define epicsExportSharedSymbols
 #include <pv/introspectionRegistry.h>
 #include <pv/serializationHelper.h>
@@ -18,9 +22,11 @@ namespace pvAccess {
 const int8 IntrospectionRegistry::NULL_TYPE_CODE = (int8)-1;
 const int8 IntrospectionRegistry::ONLY_ID_TYPE_CODE = (int8)-2;
 const int8 IntrospectionRegistry::FULL_WITH_ID_TYPE_CODE = (int8)-3;
+const std::size_t IntrospectionRegistry::MAX_SIZE;
 FieldCreatePtr IntrospectionRegistry::_fieldCreate(getFieldCreate());
 
 IntrospectionRegistry::IntrospectionRegistry()
+    :_maxSize(MAX_SIZE)
 {
     reset();
 }
@@ -34,39 +40,293 @@ void IntrospectionRegistry::reset()
 {
     _pointer = 1;
     _registry.clear();
+    _byHash.clear();
+    _byPointer.clear();
+    _lru.clear();
+    _lruPos.clear();
+}
+
+void IntrospectionRegistry::setMaxSize(std::size_t maxSize)
+{
+    _maxSize = std::min(maxSize, MAX_SIZE);
+}
+
+std::size_t IntrospectionRegistry::memoryUsage() const
+{
+    // a tree node holds 3 pointers and a color, a list node 2 pointers
+    const std::size_t treeNode = 4u*sizeof(void*), listNode = 2u*sizeof(void*);
+    return _registry.size()*(treeNode+sizeof(registryMap_t::value_type))
+         + _byHash.size()*(treeNode+sizeof(registryHashIndex_t::value_type))
+         + _byPointer.size()*(treeNode+sizeof(registryPointerIndex_t::value_type))
+         + _lru.size()*(listNode+sizeof(registryLRU_t::value_type))
+         + _lruPos.size()*(treeNode+sizeof(registryLRUIndex_t::value_type));
+}
+
+namespace {
+
+// FNV-1a
+struct FieldHasher {
+    uint32 hash;
+    FieldHasher() :hash(2166136261u) {}
+
+    void add(uint32 value)
+    {
+        for(unsigned i=0; i<4u; i++) {
+            hash ^= (value>>(8u*i))&0xffu;
+            hash *= 16777619u;
+        }
+    }
+
+    void add(const std::string& value)
+    {
+        for(size_t i=0; i<value.size(); i++) {
+            hash ^= (unsigned char)value[i];
+            hash *= 16777619u;
+        }
+        add(uint32(value.size()));
+    }
+
+    void add(const StringArray& names, const FieldConstPtrArray& fields)
+    {
+        add(uint32(fields.size()));
+        for(size_t i=0; i<fields.size(); i++) {
+            add(names[i]);
+            add(*fields[i]);
+        }
+    }
+
+    // only what operator==(Field, Field) compares, ids and bounds are left out
+    void add(const Field& field)
+    {
+        const Type type = field.getType();
+        add(uint32(type));
+        switch(type) {
+        case scalar:
+            add(uint32(static_cast<const Scalar&>(field).getScalarType()));
+            break;
+        case scalarArray:
+            add(uint32(static_cast<const ScalarArray&>(field).getElementType()));
+            break;
+        case structure: {
+            const Structure& S = static_cast<const Structure&>(field);
+            add(S.getFieldNames(), S.getFields());
+        }
+            break;
+        case union_: {
+            const Union& U = static_cast<const Union&>(field);
+            add(U.getFieldNames(), U.getFields());
+        }
+            break;
+        case structureArray:
+            add(*static_cast<const StructureArray&>(field).getStructure());
+            break;
+        case unionArray:
+            add(*static_cast<const UnionArray&>(field).getUnion());
+            break;
+        }
+    }
+};
+
+// also the same ids, which include the bounds of strings and arrays
+bool identical(const Field& a, const Field& b)
+{
+    if(&a == &b)
+        return true;
+    if(a.getType() != b.getType() || a.getID() != b.getID())
+        return false;
+
+    switch(a.getType()) {
+    case structure:
+    case union_: {
+        const StringArray& anames = a.getType()==structure ? static_cast<const Structure&>(a).getFieldNames()
+                                                           : static_cast<const Union&>(a).getFieldNames();
+        const StringArray& bnames = a.getType()==structure ? static_cast<const Structure&>(b).getFieldNames()
+                                                           : static_cast<const Union&>(b).getFieldNames();
+        const FieldConstPtrArray& afields = a.getType()==structure ? static_cast<const Structure&>(a).getFields()
+                                                                   : static_cast<const Union&>(a).getFields();
+        const FieldConstPtrArray& bfields = a.getType()==structure ? static_cast<const Structure&>(b).getFields()
+                                                                   : static_cast<const Union&>(b).getFields();
+        if(afields.size() != bfields.size())
+            return false;
+        for(size_t i=0; i<afields.size(); i++) {
+            if(anames[i] != bnames[i] || !identical(*afields[i], *bfields[i]))
+                return false;
+        }
+        return true;
+    }
+    case structureArray:
+        return identical(*static_cast<const StructureArray&>(a).getStructure(),
+                         *static_cast<const StructureArray&>(b).getStructure());
+    case unionArray:
+        return identical(*static_cast<const UnionArray&>(a).getUnion(),
+                         *static_cast<const UnionArray&>(b).getUnion());
+    default:
+        return true;
+    }
+}
+
+/* Types received by all connections.  Holds no reference, so a type is
+ * forgotten after its last user releases it.
+ */
+struct InternTable {
+    typedef std::multimap<uint32, std::tr1::weak_ptr<const Field> > table_t;
+
+    Mutex mutex;
+    table_t table;
+    // at which size expired entries are removed next
+    size_t sweepAt;
+
+    InternTable() :sweepAt(1024u) {}
+
+    FieldConstPtr intern(FieldConstPtr const & field)
+    {
+        const uint32 hash = IntrospectionRegistry::hashField(*field);
+
+        Lock G(mutex);
+        std::pair<table_t::iterator, table_t::iterator> range(table.equal_range(hash));
+        for(table_t::iterator it = range.first; it != range.second; )
+        {
+            FieldConstPtr known(it->second.lock());
+            if(!known)
+            {
+                table.erase(it++);
+            }
+            else if(identical(*known, *field))
+            {
+                return known;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        table.insert(std::make_pair(hash, std::tr1::weak_ptr<const Field>(field)));
+
+        if(table.size() >= sweepAt)
+        {
+            for(table_t::iterator it = table.begin(); it != table.end(); )
+            {
+                if(it->second.expired())
+                    table.erase(it++);
+                else
+                    ++it;
+            }
+            sweepAt = std::max(size_t(1024u), 2u*table.size());
+        }
+        return field;
+    }
+};
+
+InternTable *internTable;
+epicsThreadOnceId internTableOnce = EPICS_THREAD_ONCE_INIT;
+
+void internTableInit(void *)
+{
+    internTable = new InternTable;
+}
+
+} // namespace
+
+uint32 IntrospectionRegistry::hashField(Field const & field)
+{
+    FieldHasher hasher;
+    hasher.add(field);
+    return hasher.hash;
+}
+
+FieldConstPtr IntrospectionRegistry::intern(FieldConstPtr const & field)
+{
+    if(!field || field->getType() == scalar || field->getType() == scalarArray)
+        return field;
+    epicsThreadOnce(&internTableOnce, &internTableInit, 0);
+    return internTable->intern(field);
 }
 
 int16 IntrospectionRegistry::registerIntrospectionInterface(FieldConstPtr const & field, bool& existing)
 {
     int16 key;
-    // TODO this is slow
-    if(registryContainsValue(field, key))
+    registryPointerIndex_t::const_iterator it(_byPointer.find(field.get()));
+    if(it != _byPointer.end())
     {
         existing = true;
+        key = it->second;
+        _lru.splice(_lru.begin(), _lru, _lruPos[key]);
+        return key;
+    }
+
+    const uint32 hash = hashField(*field);
+    if(registryContainsValue(field, hash, key))
+    {
+        existing = true;
+        _lru.splice(_lru.begin(), _lru, _lruPos[key]);
     }
     else
     {
         existing = false;
-        key = _pointer++;
+        key = 0;
+        // re-assign the least recently sent ids, also after setMaxSize() lowered the limit
+        while(!_lru.empty() && (_registry.size() >= _maxSize || std::size_t(_pointer) > MAX_SIZE))
+        {
+            key = _lru.back();
+            unindex(key);
+        }
+        if(!key)
+            key = _pointer++;
         _registry[key] = field;
+        _byHash.insert(std::make_pair(hash, key));
+        _byPointer[field.get()] = key;
+        _lru.push_front(key);
+        _lruPos[key] = _lru.begin();
     }
     return key;
 }
 
-// TODO slow !!!!
-bool IntrospectionRegistry::registryContainsValue(FieldConstPtr const & field, int16& key)
+bool IntrospectionRegistry::registryContainsValue(FieldConstPtr const & field, uint32 hash, int16& key)
 {
-    for(registryMap_t::reverse_iterator registryRIter = _registry.rbegin(); registryRIter != _registry.rend(); registryRIter++)
+    std::pair<registryHashIndex_t::const_iterator, registryHashIndex_t::const_iterator> range(_byHash.equal_range(hash));
+    for(registryHashIndex_t::const_iterator it = range.first; it != range.second; ++it)
     {
-        if(*(field.get()) == *(registryRIter->second))
+        registryMap_t::const_iterator registryIter = _registry.find(it->second);
+        if(registryIter != _registry.end() && *(field.get()) == *(registryIter->second))
         {
-            key = registryRIter->first;
+            key = it->second;
             return true;
         }
     }
     return false;
 }
 
+void IntrospectionRegistry::unindex(int16 key)
+{
+    registryMap_t::iterator registryIter = _registry.find(key);
+    if(registryIter == _registry.end())
+        return;
+
+    const Field* field = registryIter->second.get();
+    registryPointerIndex_t::iterator P(_byPointer.find(field));
+    if(P != _byPointer.end() && P->second == key)
+        _byPointer.erase(P);
+
+    std::pair<registryHashIndex_t::iterator, registryHashIndex_t::iterator> range(_byHash.equal_range(hashField(*field)));
+    for(registryHashIndex_t::iterator it = range.first; it != range.second; ++it)
+    {
+        if(it->second == key)
+        {
+            _byHash.erase(it);
+            break;
+        }
+    }
+
+    registryLRUIndex_t::iterator L(_lruPos.find(key));
+    if(L != _lruPos.end())
+    {
+        _lru.erase(L->second);
+        _lruPos.erase(L);
+    }
+    _registry.erase(registryIter);
+}
+
 void IntrospectionRegistry::serialize(FieldConstPtr const & field, ByteBuffer* buffer, SerializableControl* control)
 {
     if (field.get() == NULL)
@@ -79,7 +339,8 @@ void IntrospectionRegistry::serialize(FieldConstPtr const & field, ByteBuffer* b
         // ... and (array of) variant unions - not worth the complex condition,
         // unless bool Field.cache() would exist
         if (field->getType() != scalar &&
-                field->getType() != scalarArray)
+                field->getType() != scalarArray &&
+                _maxSize > 0)
         {
             bool existing;
             const int16 key = registerIntrospectionInterface(field, existing);
@@ -129,7 +390,7 @@ FieldConstPtr IntrospectionRegistry::deserialize(ByteBuffer* buffer, Deserializa
     {
         control->ensureData(sizeof(int16)/sizeof(int8));
         const short key = buffer->getShort();
-        FieldConstPtr field = _fieldCreate->deserialize(buffer, control);
+        FieldConstPtr field = intern(_fieldCreate->deserialize(buffer, control));
         _registry[key] = field;
         return field;
     }
@@ -0,0 +1,116 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string.h>
+
+#define epicsExportSharedSymbols
+#include <pv/latencyHistogram.h>
+
+namespace pvd = epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    memset(buckets, 0, sizeof(buckets));
+    total = sumUS = maxUS = 0u;
+}
+
+// values below subBuckets have a bucket each.  Above, the bucket is the
+// position of the highest bit, and the subBits bits below it.
+size_t LatencyHistogram::bucketOf(pvd::uint64 us)
+{
+    if(us < subBuckets)
+        return size_t(us);
+    unsigned msb = 0u;
+    for(pvd::uint64 v = us; v>1u; v>>=1u)
+        msb++;
+    size_t ret = subBuckets + (msb-subBits)*subBuckets + size_t((us>>(msb-subBits)) & (subBuckets-1u));
+    return ret < size_t(nbuckets) ? ret : size_t(nbuckets)-1u;
+}
+
+pvd::uint64 LatencyHistogram::upperOf(size_t bucket)
+{
+    if(bucket < size_t(subBuckets))
+        return bucket;
+    size_t msb = (bucket - subBuckets)/subBuckets + subBits;
+    pvd::uint64 sub = (bucket - subBuckets)%subBuckets;
+    // largest value with this msb and sub-bucket
+    return ((pvd::uint64(subBuckets) + sub + 1u)<<(msb-subBits)) - 1u;
+}
+
+void LatencyHistogram::record(double seconds)
+{
+    pvd::uint64 us = seconds > 0.0 ? pvd::uint64(seconds*1e6) : 0u;
+    buckets[bucketOf(us)]++;
+    total++;
+    sumUS += us;
+    if(us > maxUS)
+        maxUS = us;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for(size_t i=0; i<size_t(nbuckets); i++)
+        buckets[i] += other.buckets[i];
+    total += other.total;
+    sumUS += other.sumUS;
+    if(other.maxUS > maxUS)
+        maxUS = other.maxUS;
+}
+
+double LatencyHistogram::mean() const
+{
+    return total ? double(sumUS)/total*1e-6 : 0.0;
+}
+
+double LatencyHistogram::percentile(double fraction) const
+{
+    if(!total)
+        return 0.0;
+    pvd::uint64 want = pvd::uint64(fraction*total + 0.5);
+    if(want < 1u)
+        want = 1u;
+    pvd::uint64 seen = 0u;
+    for(size_t i=0; i<size_t(nbuckets); i++) {
+        seen += buckets[i];
+        if(seen >= want) {
+            pvd::uint64 upper = upperOf(i);
+            return (upper < maxUS ? upper : maxUS)*1e-6;
+        }
+    }
+    return max();
+}
+
+pvd::uint64 LatencyHistogram::countAtMost(double seconds) const
+{
+    if(seconds < 0.0)
+        return 0u;
+    const double us = seconds*1e6;
+    pvd::uint64 ret = 0u;
+    for(size_t i=0; i<size_t(nbuckets) && double(upperOf(i)) <= us; i++)
+        ret += buckets[i];
+    return ret;
+}
+
+void LatencyHistogram::show(std::ostream& strm) const
+{
+    strm<<"count "<<total
+        <<" mean "<<mean()*1e6
+        <<" p50 "<<percentile(0.5)*1e6
+        <<" p90 "<<percentile(0.9)*1e6
+        <<" p99 "<<percentile(0.99)*1e6
+        <<" max "<<maxUS<<" us";
+}
+
+}
+}
@@ -9,10 +9,26 @@
 #include <time.h>
 #include <cstring>
 #include <stdio.h>
+#include <stdarg.h>
+
+#include <vector>
 
 #include <epicsExit.h>
 #include <errlog.h>
 #include <epicsTime.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsStdio.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_LOG_USE_ATOMIC
+#endif
+#endif
 
 #include <pv/noDefaultMethods.h>
 #include <pv/lock.h>
@@ -31,39 +47,367 @@ namespace pvAccess {
 
 #define TIMETEXTLEN 32
 
-static pvAccessLogLevel g_pvAccessLogLevel = logLevelInfo;
+#ifndef va_copy
+#  define va_copy(dest, src) ((dest) = (src))
+#endif
+
+namespace detail {
+int pvAccessLogThreshold = logLevelInfo;
+}
+
+namespace {
+
+// lock-free where epicsAtomic exists
+#ifdef PVA_LOG_USE_ATOMIC
+size_t getSize(size_t& val) { return epics::atomic::get(val); }
+void setSize(size_t& val, size_t newval) { epics::atomic::set(val, newval); }
+size_t casSize(size_t& val, size_t oldval, size_t newval) { return epics::atomic::compareAndSwap(val, oldval, newval); }
+#else
+epicsMutex atomicMutex;
+size_t getSize(size_t& val) { epicsGuard<epicsMutex> G(atomicMutex); return val; }
+void setSize(size_t& val, size_t newval) { epicsGuard<epicsMutex> G(atomicMutex); val = newval; }
+size_t casSize(size_t& val, size_t oldval, size_t newval) {
+    epicsGuard<epicsMutex> G(atomicMutex);
+    size_t prev = val;
+    if(prev==oldval)
+        val = newval;
+    return prev;
+}
+#endif
+
+const char *levelName(pvAccessLogLevel level)
+{
+    switch(level) {
+    case logLevelAll: return "all";
+    case logLevelTrace: return "trace";
+    case logLevelDebug: return "debug";
+    case logLevelInfo: return "info";
+    case logLevelWarn: return "warn";
+    case logLevelError: return "error";
+    case logLevelFatal: return "fatal";
+    case logLevelOff: return "off";
+    }
+    return "?";
+}
+
+pvAccessLogFormat g_logFormat = logFormatText;
+
+// write one line to stdout.  Called by one thread at a time
+void writeMessage(pvAccessLogLevel level, const epicsTimeStamp& stamp, const char *message)
+{
+    char timeText[TIMETEXTLEN];
+    epicsTimeToStrftime(timeText, TIMETEXTLEN, "%Y-%m-%dT%H:%M:%S.%03f", &stamp);
+
+    if(g_logFormat == logFormatKeyValue) {
+        std::string line;
+        line.reserve(strlen(message) + 64u);
+        line += "time=";
+        line += timeText;
+        line += " level=";
+        line += levelName(level);
+        line += " msg=\"";
+        for(const char *c = message; *c; c++) {
+            if(*c=='"' || *c=='\\')
+                line += '\\';
+            if(*c=='\n')
+                line += "\\n";
+            else
+                line += *c;
+        }
+        line += "\"\n";
+        fputs(line.c_str(), stdout);
+    } else {
+        printf("%s %s\n", timeText, message);
+    }
+    fflush(stdout);    // needed for WIN32
+}
+
+epicsMutex syncMutex;
+
+void writeSync(pvAccessLogLevel level, const epicsTimeStamp& stamp, const char *message)
+{
+    epicsGuard<epicsMutex> G(syncMutex);
+    writeMessage(level, stamp, message);
+}
+
+/* Call sites, by format string, with the messages of the current second.
+ * A collision replaces the site, so rarely a site is limited less.
+ */
+struct RateLimiter {
+    struct Site {
+        const char *format;
+        epicsUInt32 second;
+        unsigned count, suppressed;
+    };
+    enum { nsites = 256 };
+
+    epicsMutex mutex;
+    Site sites[nsites];
+    unsigned perSecond;
+
+    RateLimiter() :perSecond(0u) {
+        memset(sites, 0, sizeof(sites));
+    }
+
+    /* false to suppress this message.  'suppressed' is set to the number
+     * suppressed of the site in an earlier second, which is reported now.
+     */
+    bool allow(const char *format, const epicsTimeStamp& stamp, unsigned& suppressed)
+    {
+        suppressed = 0u;
+        size_t hash = size_t(format);
+        hash ^= hash>>8;
+        hash ^= hash>>16;
+        Site& S = sites[hash%nsites];
+
+        epicsGuard<epicsMutex> G(mutex);
+        if(perSecond==0u)
+            return true;
+        if(S.format!=format || S.second!=stamp.secPastEpoch) {
+            if(S.format==format)
+                suppressed = S.suppressed;
+            S.format = format;
+            S.second = stamp.secPastEpoch;
+            S.count = S.suppressed = 0u;
+        }
+        if(S.count >= perSecond) {
+            S.suppressed++;
+            return false;
+        }
+        S.count++;
+        return true;
+    }
+} g_rateLimiter;
+
+/* Bounded ring of formatted messages, many producers and one writer.
+ * Each slot has a sequence number: pos when free for the producer of position pos,
+ * pos+1 when filled, pos+size when free again for the next round.
+ */
+struct LogRing : public epicsThreadRunable {
+    enum { maxMessage = 512 };
+    struct Slot {
+        size_t seq;
+        pvAccessLogLevel level;
+        epicsTimeStamp stamp;
+        char message[maxMessage];
+    };
+
+    std::vector<Slot> slots;
+    const size_t mask;
+    size_t enqueuePos, dequeuePos, dropped, sleeping;
+    epicsEvent wakeup;
+    epicsThread worker;
+
+    static size_t roundUp(size_t n) {
+        size_t ret = 16u;
+        while(ret < n)
+            ret <<= 1u;
+        return ret;
+    }
+
+    LogRing(size_t size)
+        :slots(roundUp(size))
+        ,mask(slots.size()-1u)
+        ,enqueuePos(0u)
+        ,dequeuePos(0u)
+        ,dropped(0u)
+        ,sleeping(0u)
+        ,worker(*this, "pvAccessLog", epicsThreadGetStackSize(epicsThreadStackSmall), epicsThreadPriorityLow)
+    {
+        for(size_t i=0; i<slots.size(); i++)
+            slots[i].seq = i;
+        worker.start();
+    }
+    virtual ~LogRing() {}
+
+    bool push(pvAccessLogLevel level, const epicsTimeStamp& stamp, const char *format, va_list args)
+    {
+        size_t pos = getSize(enqueuePos);
+        Slot *S;
+        while(true) {
+            S = &slots[pos & mask];
+            size_t seq = getSize(S->seq);
+            if(seq == pos) {
+                size_t prev = casSize(enqueuePos, pos, pos+1u);
+                if(prev == pos)
+                    break;
+                pos = prev;
+            } else if(seq < pos) {
+                // full
+                size_t n;
+                do {
+                    n = getSize(dropped);
+                } while(casSize(dropped, n, n+1u) != n);
+                return false;
+            } else {
+                pos = getSize(enqueuePos);
+            }
+        }
+
+        S->level = level;
+        S->stamp = stamp;
+        int n = epicsVsnprintf(S->message, maxMessage, format, args);
+        if(n >= int(maxMessage))
+            strcpy(S->message + maxMessage - 4u, "...");
+        else if(n < 0)
+            S->message[0] = '\0';
+        setSize(S->seq, pos+1u);
+
+        if(getSize(sleeping))
+            wakeup.signal();
+        return true;
+    }
+
+    bool pushf(pvAccessLogLevel level, const epicsTimeStamp& stamp, const char *format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        bool ret = push(level, stamp, format, args);
+        va_end(args);
+        return ret;
+    }
+
+    bool empty()
+    {
+        return getSize(enqueuePos) == getSize(dequeuePos);
+    }
+
+    virtual void run()
+    {
+        while(true) {
+            Slot& S = slots[dequeuePos & mask];
+            if(getSize(S.seq) == dequeuePos+1u) {
+                writeSync(S.level, S.stamp, S.message);
+                setSize(S.seq, dequeuePos + mask + 1u);
+                setSize(dequeuePos, dequeuePos+1u);
+                continue;
+            }
+
+            size_t n;
+            do {
+                n = getSize(dropped);
+            } while(n && casSize(dropped, n, 0u) != n);
+            if(n) {
+                char message[64];
+                epicsTimeStamp now;
+                epicsTimeGetCurrent(&now);
+                sprintf(message, "dropped %lu log messages", (unsigned long)n);
+                writeSync(logLevelWarn, now, message);
+            }
+
+            casSize(sleeping, 0u, 1u);
+            if(getSize(S.seq) != dequeuePos+1u)
+                wakeup.wait(1.0);
+            casSize(sleeping, 1u, 0u);
+        }
+    }
+};
+
+// once created, kept until exit, as producers may be using it
+LogRing *g_logRing;
+bool g_logAsync;
+epicsMutex g_logRingMutex;
+
+void logFlushAtExit(void *)
+{
+    pvAccessLogFlush(1.0);
+}
+
+} // namespace
 
 void pvAccessLog(pvAccessLogLevel level, const char* format, ...)
 {
-    // TODO lock
-    if (level >= g_pvAccessLogLevel)
+    if (level >= detail::pvAccessLogThreshold)
     {
-        char timeText[TIMETEXTLEN];
         epicsTimeStamp tsNow;
-
         epicsTimeGetCurrent(&tsNow);
-        epicsTimeToStrftime(timeText, TIMETEXTLEN, "%Y-%m-%dT%H:%M:%S.%03f", &tsNow);
 
-        printf("%s ", timeText);
+        unsigned suppressed;
+        bool allowed = g_rateLimiter.allow(format, tsNow, suppressed);
+
+        LogRing *ring = g_logAsync ? g_logRing : NULL;
+
+        if(suppressed) {
+            char message[256];
+            epicsSnprintf(message, sizeof(message), "suppressed %u similar messages: %s", suppressed, format);
+            if(ring)
+                ring->pushf(level, tsNow, "%s", message);
+            else
+                writeSync(level, tsNow, message);
+        }
+        if(!allowed)
+            return;
 
         va_list arg;
         va_start(arg, format);
-        vprintf(format, arg);
+        if(ring) {
+            ring->push(level, tsNow, format, arg);
+        } else {
+            std::vector<char> message(256u);
+            va_list copy;
+            va_copy(copy, arg);
+            int n = epicsVsnprintf(&message[0], message.size(), format, copy);
+            va_end(copy);
+            if(n >= int(message.size())) {
+                message.resize(size_t(n)+1u);
+                epicsVsnprintf(&message[0], message.size(), format, arg);
+            }
+            writeSync(level, tsNow, n < 0 ? "" : &message[0]);
+        }
         va_end(arg);
-
-        printf("\n");
-        fflush(stdout);    // needed for WIN32
     }
 }
 
 void pvAccessSetLogLevel(pvAccessLogLevel level)
 {
-    g_pvAccessLogLevel = level;
+    detail::pvAccessLogThreshold = level;
 }
 
 bool pvAccessIsLoggable(pvAccessLogLevel level)
 {
-    return level >= g_pvAccessLogLevel;
+    return level >= detail::pvAccessLogThreshold;
+}
+
+void pvAccessSetLogFormat(pvAccessLogFormat format)
+{
+    epicsGuard<epicsMutex> G(syncMutex);
+    g_logFormat = format;
+}
+
+void pvAccessSetLogRateLimit(unsigned perSecond)
+{
+    epicsGuard<epicsMutex> G(g_rateLimiter.mutex);
+    g_rateLimiter.perSecond = perSecond;
+}
+
+void pvAccessSetLogAsync(size_t queueSize)
+{
+    {
+        epicsGuard<epicsMutex> G(g_logRingMutex);
+        if(queueSize && !g_logRing) {
+            g_logRing = new LogRing(queueSize);
+            epicsAtExit(logFlushAtExit, NULL);
+        }
+        g_logAsync = queueSize!=0u;
+    }
+    if(!queueSize)
+        pvAccessLogFlush();
+}
+
+void pvAccessLogFlush(double timeout)
+{
+    LogRing *ring;
+    {
+        epicsGuard<epicsMutex> G(g_logRingMutex);
+        ring = g_logRing;
+    }
+    if(!ring)
+        return;
+    epicsTime end(epicsTime::getCurrent() + timeout);
+    while(!ring->empty() && epicsTime::getCurrent() < end) {
+        ring->wakeup.signal();
+        epicsThreadSleep(0.001);
+    }
 }
 
 namespace {
@@ -0,0 +1,87 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string>
+
+#define epicsExportSharedSymbols
+#include <pv/memoryUsage.h>
+
+namespace pvd = epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+
+// a heap block of a std::string, or 0 if held in the object itself
+size_t stringBytes(const std::string& str)
+{
+    return str.capacity() > sizeof(std::string) ? str.capacity()+1u : 0u;
+}
+
+} // namespace
+
+size_t memoryUsage(const pvd::PVField& field)
+{
+    switch(field.getField()->getType()) {
+    case pvd::scalar:
+        if(const pvd::PVString *str = dynamic_cast<const pvd::PVString*>(&field))
+            return sizeof(pvd::PVString) + stringBytes(str->get());
+        return sizeof(pvd::PVDouble);
+
+    case pvd::scalarArray: {
+        const pvd::PVScalarArray& arr = static_cast<const pvd::PVScalarArray&>(field);
+        size_t ret = sizeof(pvd::PVDoubleArray);
+        if(const pvd::PVStringArray *strs = dynamic_cast<const pvd::PVStringArray*>(&field)) {
+            pvd::PVStringArray::const_svector view(strs->view());
+            ret += view.size()*sizeof(std::string);
+            for(size_t i=0; i<view.size(); i++)
+                ret += stringBytes(view[i]);
+        } else {
+            ret += arr.getLength()*pvd::ScalarTypeFunc::elementSize(arr.getScalarArray()->getElementType());
+        }
+        return ret;
+    }
+
+    case pvd::structure: {
+        const pvd::PVStructure& sub = static_cast<const pvd::PVStructure&>(field);
+        const pvd::PVFieldPtrArray& fields = sub.getPVFields();
+        size_t ret = sizeof(pvd::PVStructure) + fields.size()*sizeof(pvd::PVFieldPtr);
+        for(size_t i=0; i<fields.size(); i++)
+            ret += memoryUsage(*fields[i]);
+        return ret;
+    }
+
+    case pvd::structureArray: {
+        pvd::PVStructureArray::const_svector view(static_cast<const pvd::PVStructureArray&>(field).view());
+        size_t ret = sizeof(pvd::PVStructureArray) + view.size()*sizeof(pvd::PVStructurePtr);
+        for(size_t i=0; i<view.size(); i++) {
+            if(view[i])
+                ret += memoryUsage(*view[i]);
+        }
+        return ret;
+    }
+
+    case pvd::union_: {
+        const pvd::PVField::const_shared_pointer value(static_cast<const pvd::PVUnion&>(field).get());
+        return sizeof(pvd::PVUnion) + (value ? memoryUsage(*value) : 0u);
+    }
+
+    case pvd::unionArray: {
+        pvd::PVUnionArray::const_svector view(static_cast<const pvd::PVUnionArray&>(field).view());
+        size_t ret = sizeof(pvd::PVUnionArray) + view.size()*sizeof(pvd::PVUnionPtr);
+        for(size_t i=0; i<view.size(); i++) {
+            if(view[i])
+                ret += memoryUsage(*view[i]);
+        }
+        return ret;
+    }
+    }
+    return 0u;
+}
+
+}
+}
@@ -0,0 +1,404 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <sstream>
+#include <stdexcept>
+
+#include <string.h>
+#include <stdio.h>
+
+#include <epicsGuard.h>
+#include <epicsStdio.h>
+#include <epicsThread.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_METRICS_USE_ATOMIC
+#endif
+#endif
+
+#define epicsExportSharedSymbols
+#include <pv/metrics.h>
+#include <pv/latencyHistogram.h>
+#include <pv/logger.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+
+const char *typeNames[] = {"counter", "gauge", "histogram"};
+
+// seconds to wait for a request, or between checks for stop()
+const double requestTimeout = 2.0;
+const double acceptPoll = 0.5;
+
+struct Sources {
+    epicsMutex mutex;
+    std::vector<std::tr1::weak_ptr<MetricsSource> > list;
+};
+
+epicsThreadOnceId sourcesOnce = EPICS_THREAD_ONCE_INIT;
+Sources *sources;
+
+void sourcesInit(void*)
+{
+    sources = new Sources;
+}
+
+#ifndef PVA_METRICS_USE_ATOMIC
+epicsThreadOnceId counterOnce = EPICS_THREAD_ONCE_INIT;
+epicsMutex *counterMutex;
+
+void counterInit(void*)
+{
+    counterMutex = new epicsMutex;
+}
+#endif
+
+std::vector<double> makeBounds()
+{
+    std::vector<double> ret;
+    const double bounds[] = {1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+    ret.assign(bounds, bounds+sizeof(bounds)/sizeof(bounds[0]));
+    return ret;
+}
+
+std::vector<double> makeShortBounds()
+{
+    std::vector<double> ret;
+    const double bounds[] = {1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2, 0.1};
+    ret.assign(bounds, bounds+sizeof(bounds)/sizeof(bounds[0]));
+    return ret;
+}
+
+std::string formatValue(double value)
+{
+    char buf[32];
+    // 15 digits so that bounds like 0.1 print as written
+    epicsSnprintf(buf, sizeof(buf), "%.15g", value);
+    return buf;
+}
+
+// wait for sock to be readable
+bool readable(SOCKET sock, double timeout)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    struct timeval tv;
+    tv.tv_sec = long(timeout);
+    tv.tv_usec = long((timeout - tv.tv_sec)*1e6);
+    return select(int(sock)+1, &fds, 0, 0, &tv) > 0;
+}
+
+void sendAll(SOCKET sock, const std::string& data)
+{
+    size_t pos = 0u;
+    while(pos < data.size()) {
+        int n = ::send(sock, data.c_str()+pos, int(data.size()-pos), 0);
+        if(n<=0)
+            break;
+        pos += size_t(n);
+    }
+}
+
+} // namespace
+
+void MetricCounter::increment(size_t n)
+{
+#ifdef PVA_METRICS_USE_ATOMIC
+    epics::atomic::add(value, n);
+#else
+    epicsThreadOnce(&counterOnce, &counterInit, 0);
+    Guard G(*counterMutex);
+    value += n;
+#endif
+}
+
+size_t MetricCounter::get() const
+{
+#ifdef PVA_METRICS_USE_ATOMIC
+    return epics::atomic::get(value);
+#else
+    epicsThreadOnce(&counterOnce, &counterInit, 0);
+    Guard G(*counterMutex);
+    return value;
+#endif
+}
+
+void Metrics::family(const std::string& name, Type type, const std::string& help)
+{
+    families_t::iterator it(families.find(name));
+    if(it!=families.end())
+        return;
+    Family& fam = families[name];
+    fam.type = type;
+    fam.help = help;
+}
+
+void Metrics::add(Family& fam, const std::string& suffix, double value, const std::string& labels)
+{
+    const std::pair<std::string, std::string> key(suffix, labels);
+    std::map<std::pair<std::string, std::string>, size_t>::iterator it(fam.index.find(key));
+    if(it==fam.index.end()) {
+        Sample S;
+        S.suffix = suffix;
+        S.labels = labels;
+        S.value = value;
+        fam.index[key] = fam.samples.size();
+        fam.samples.push_back(S);
+    } else {
+        fam.samples[it->second].value += value;
+    }
+}
+
+void Metrics::add(const std::string& name, double value, const std::string& labels)
+{
+    families_t::iterator it(families.find(name));
+    if(it==families.end()) {
+        family(name, Gauge, std::string());
+        it = families.find(name);
+    }
+    add(it->second, std::string(), value, labels);
+}
+
+void Metrics::add(const std::string& name, const LatencyHistogram& hist,
+                  const std::vector<double>& bounds, const std::string& labels)
+{
+    families_t::iterator it(families.find(name));
+    if(it==families.end()) {
+        family(name, Histogram, std::string());
+        it = families.find(name);
+    }
+    Family& fam = it->second;
+    const std::string sep(labels.empty() ? "" : ",");
+
+    for(size_t i=0; i<bounds.size(); i++)
+        add(fam, "_bucket", double(hist.countAtMost(bounds[i])), labels+sep+label("le", formatValue(bounds[i])));
+    add(fam, "_bucket", double(hist.count()), labels+sep+label("le", "+Inf"));
+    add(fam, "_sum", hist.sum(), labels);
+    add(fam, "_count", double(hist.count()), labels);
+}
+
+const std::vector<double>& Metrics::defaultBounds()
+{
+    static const std::vector<double> bounds(makeBounds());
+    return bounds;
+}
+
+const std::vector<double>& Metrics::shortBounds()
+{
+    static const std::vector<double> bounds(makeShortBounds());
+    return bounds;
+}
+
+std::string Metrics::label(const char *key, const std::string& value)
+{
+    std::string ret(key);
+    ret += "=\"";
+    for(size_t i=0; i<value.size(); i++) {
+        switch(value[i]) {
+        case '\\': ret += "\\\\"; break;
+        case '"': ret += "\\\""; break;
+        case '\n': ret += "\\n"; break;
+        default: ret += value[i];
+        }
+    }
+    ret += '"';
+    return ret;
+}
+
+void Metrics::write(std::ostream& strm) const
+{
+    for(families_t::const_iterator it(families.begin()), end(families.end()); it!=end; ++it) {
+        const Family& fam = it->second;
+        if(!fam.help.empty())
+            strm<<"# HELP "<<it->first<<' '<<fam.help<<'\n';
+        strm<<"# TYPE "<<it->first<<' '<<typeNames[fam.type]<<'\n';
+        for(size_t i=0; i<fam.samples.size(); i++) {
+            const Sample& S = fam.samples[i];
+            strm<<it->first<<S.suffix;
+            if(!S.labels.empty())
+                strm<<'{'<<S.labels<<'}';
+            strm<<' '<<formatValue(S.value)<<'\n';
+        }
+    }
+}
+
+void MetricsSource::add(const std::tr1::weak_ptr<MetricsSource>& source)
+{
+    epicsThreadOnce(&sourcesOnce, &sourcesInit, 0);
+    Guard G(sources->mutex);
+    // prune those destroyed
+    for(size_t i=0; i<sources->list.size(); ) {
+        if(sources->list[i].expired()) {
+            sources->list[i] = sources->list.back();
+            sources->list.pop_back();
+        } else {
+            i++;
+        }
+    }
+    sources->list.push_back(source);
+}
+
+void MetricsSource::collectAll(Metrics& metrics)
+{
+    epicsThreadOnce(&sourcesOnce, &sourcesInit, 0);
+    std::vector<std::tr1::weak_ptr<MetricsSource> > list;
+    {
+        Guard G(sources->mutex);
+        list = sources->list;
+    }
+    for(size_t i=0; i<list.size(); i++) {
+        MetricsSource::shared_pointer source(list[i].lock());
+        if(source)
+            source->collectMetrics(metrics);
+    }
+}
+
+MetricsServer::MetricsServer(unsigned short port, const std::string& iface)
+    :sock(INVALID_SOCKET)
+    ,running(true)
+    ,requests(0u)
+    ,worker(*this, "PVA-metrics",
+            epicsThreadGetStackSize(epicsThreadStackSmall),
+            epicsThreadPriorityLow)
+{
+    osiSockAttach();
+
+    memset(&bound, 0, sizeof(bound));
+    bound.ia.sin_family = AF_INET;
+    bound.ia.sin_addr.s_addr = htonl(INADDR_ANY);
+    if(!iface.empty() && aToIPAddr(iface.c_str(), port, &bound.ia))
+        throw std::runtime_error("MetricsServer invalid interface '"+iface+"'");
+    bound.ia.sin_port = htons(port);
+
+    sock = epicsSocketCreate(AF_INET, SOCK_STREAM, 0);
+    if(sock==INVALID_SOCKET)
+        throw std::runtime_error("MetricsServer unable to create socket");
+
+    epicsSocketEnableAddressReuseDuringTimeWaitState(sock);
+
+    osiSocklen_t len = sizeof(bound);
+    if(bind(sock, &bound.sa, sizeof(bound.ia)) || listen(sock, 4)
+            || getsockname(sock, &bound.sa, &len))
+    {
+        epicsSocketDestroy(sock);
+        std::ostringstream msg;
+        msg<<"MetricsServer unable to listen on port "<<port;
+        throw std::runtime_error(msg.str());
+    }
+
+    worker.start();
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+unsigned short MetricsServer::getPort() const
+{
+    return ntohs(bound.ia.sin_port);
+}
+
+size_t MetricsServer::getRequestCount() const
+{
+    Guard G(mutex);
+    return requests;
+}
+
+void MetricsServer::stop()
+{
+    {
+        Guard G(mutex);
+        if(!running)
+            return;
+        running = false;
+    }
+    worker.exitWait();
+    epicsSocketDestroy(sock);
+}
+
+void MetricsServer::run()
+{
+    while(true) {
+        {
+            Guard G(mutex);
+            if(!running)
+                break;
+        }
+
+        if(!readable(sock, acceptPoll))
+            continue;
+
+        osiSockAddr peer;
+        osiSocklen_t len = sizeof(peer);
+        SOCKET client = epicsSocketAccept(sock, &peer.sa, &len);
+        if(client==INVALID_SOCKET)
+            continue;
+
+        try {
+            serve(client);
+        } catch(std::exception& e) {
+            LOG(logLevelError, "MetricsServer error: %s", e.what());
+        }
+        epicsSocketDestroy(client);
+    }
+}
+
+void MetricsServer::serve(SOCKET client)
+{
+    // only the request line matters.  Read until the end of the headers
+    std::string request;
+    char buf[1024];
+    while(request.find("\r\n\r\n")==std::string::npos && request.size() < 16384u) {
+        if(!readable(client, requestTimeout))
+            return;
+        int n = ::recv(client, buf, sizeof(buf), 0);
+        if(n<=0)
+            return;
+        request.append(buf, size_t(n));
+    }
+
+    std::istringstream line(request.substr(0, request.find("\r\n")));
+    std::string method, path;
+    line>>method>>path;
+
+    std::ostringstream body;
+    std::string status("200 OK");
+    if(method!="GET" && method!="HEAD") {
+        status = "405 Method Not Allowed";
+    } else if(path=="/metrics" || path.compare(0, 9, "/metrics?")==0) {
+        Metrics metrics;
+        MetricsSource::collectAll(metrics);
+        metrics.write(body);
+    } else {
+        status = "404 Not Found";
+        body<<"pvAccess metrics are served at /metrics\n";
+    }
+
+    const std::string content(body.str());
+    std::ostringstream reply;
+    reply<<"HTTP/1.0 "<<status<<"\r\n"
+           "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+           "Content-Length: "<<content.size()<<"\r\n"
+           "Connection: close\r\n"
+           "\r\n";
+    if(method!="HEAD")
+        reply<<content;
+    sendAll(client, reply.str());
+
+    Guard G(mutex);
+    requests++;
+}
+
+}} // namespace epics::pvAccess
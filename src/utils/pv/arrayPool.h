@@ -0,0 +1,110 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef ARRAYPOOL_H
+#define ARRAYPOOL_H
+
+#include <map>
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define arrayPoolEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+
+#include <pv/sharedPtr.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+
+#ifdef arrayPoolEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef arrayPoolEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+#include <pv/bufferPool.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Storage of the arrays of one monitor queue, kept for reuse.
+ *
+ * pvData deserializes a changed array in place when the queue element holds the only
+ * reference to its storage, and the new length fits.  Otherwise, eg. while the application
+ * still holds the array of an earlier update of the element, or the element shares an
+ * unchanged array with the one before, it copies the old contents to new storage only
+ * to overwrite them.
+ *
+ * prepare() gives each such array empty storage from this pool instead, with the capacity of
+ * the longest array seen in its field.  The storage comes back when its last reference is dropped,
+ * wherever that is, while the pool holds less than maxBytes().  So a monitor of variable length
+ * arrays, eg. waveforms or NTNDArray, reuses the same storage however their length varies.
+ *
+ * Only variable length arrays of numbers are pooled.  Arrays of strings are left to pvData.
+ * New storage comes from the BlockAllocator of BufferPool, if one is installed.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass ArrayPool : public std::tr1::enable_shared_from_this<ArrayPool>
+{
+public:
+    POINTER_DEFINITIONS(ArrayPool);
+
+    explicit ArrayPool(size_t maxBytes);
+    ~ArrayPool();
+
+    //! Whether type has an array which would be pooled
+    static bool applies(const epics::pvData::Structure& type);
+
+    //! Before the fields of value marked in changed are deserialized.  value is a top level structure.
+    void prepare(epics::pvData::PVStructure& value, const epics::pvData::BitSet& changed);
+
+    size_t maxBytes() const { return _maxBytes; }
+    //! Bytes held for reuse
+    size_t bytes() const;
+    //! Storage taken from the pool
+    size_t reused() const;
+    //! Storage allocated when none in the pool was large enough
+    size_t allocated() const;
+
+private:
+    struct Return;
+
+    void visit(epics::pvData::PVField& field);
+    template<typename T>
+    void detach(epics::pvData::PVValueArray<T>& arr);
+    struct Block {
+        char *data;
+        // NULL for new[]
+        BlockAllocator *from;
+    };
+    Block take(size_t& bytes);
+    void give(const Block& block, size_t bytes);
+    static void destroy(const Block& block, size_t bytes);
+
+    const size_t _maxBytes;
+
+    mutable epicsMutex mutex;
+    // by size
+    typedef std::multimap<size_t, Block> blocks_t;
+    blocks_t blocks;
+    size_t held;
+    size_t nreused, nallocated;
+
+    // bytes of the longest array seen, by field offset.  Only used by prepare()
+    std::vector<size_t> peak;
+
+    ArrayPool(const ArrayPool&);
+    ArrayPool& operator=(const ArrayPool&);
+};
+
+}
+}
+
+#endif // ARRAYPOOL_H
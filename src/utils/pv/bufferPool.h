@@ -0,0 +1,155 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstddef>
+#include <string>
+
+#include <compilerDependencies.h>
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Source of large blocks, in place of malloc()
+ *
+ * Installed with BufferPool::setAllocator(), it provides the blocks of BufferPool,
+ * and of each ArrayPool.  An allocator is never destroyed once installed.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass BlockAllocator
+{
+public:
+    virtual ~BlockAllocator() {}
+    //! @returns a block of at least size bytes.  Throws std::bad_alloc
+    virtual char* allocate(std::size_t size) =0;
+    //! Return a block from allocate() with the same size.
+    virtual void release(char* block, std::size_t size) =0;
+    //! eg. "malloc"
+    virtual const char* name() const =0;
+    //! Bytes of large blocks taken from the system and not yet returned, including those cached
+    virtual std::size_t bytes() const =0;
+};
+
+/** @brief Blocks of huge pages
+ *
+ * Blocks of at least 512KB are mapped with pages of pageSize(), 2MB or 1GB,
+ * taken from those reserved in /proc/sys/vm/nr_hugepages.  When none are left,
+ * blocks are mapped with normal pages aligned to 2MB, which the kernel may back
+ * with transparent huge pages.  With 1GB pages, blocks of less than 512MB use 2MB pages.
+ *
+ * Each block is rounded up to a multiple of its page size, and released blocks
+ * are kept on a free list for each such size class, up to maxCached bytes.
+ * Smaller blocks, and all blocks on targets other than Linux, use malloc().
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass HugePageAllocator : public BlockAllocator
+{
+    struct Pvt;
+    Pvt * const pvt;
+
+    HugePageAllocator(const HugePageAllocator&);
+    HugePageAllocator& operator=(const HugePageAllocator&);
+public:
+    explicit HugePageAllocator(std::size_t pageSize = 2u*1024u*1024u,
+                               std::size_t maxCached = 256u*1024u*1024u);
+    virtual ~HugePageAllocator();
+
+    virtual char* allocate(std::size_t size) OVERRIDE FINAL;
+    virtual void release(char* block, std::size_t size) OVERRIDE FINAL;
+    virtual const char* name() const OVERRIDE FINAL;
+    virtual std::size_t bytes() const OVERRIDE FINAL;
+
+    std::size_t pageSize() const;
+
+    /** Install for the process, as client and server option EPICS_PVA_HUGE_PAGES,
+     *  "2M" or "YES" for 2MB pages, or "1G".  "NO", or empty, leaves malloc().
+     *
+     *  @returns false if setting is not understood, or BufferPool::setAllocator() fails,
+     *           unless an allocator with the same page size is already installed.
+     */
+    static bool install(const std::string& setting);
+
+    //! Blocks of reserved huge pages
+    static size_t num_reserved;
+    //! Blocks of normal pages, when no reserved pages were left
+    static size_t num_transparent;
+};
+
+/** @brief Process wide cache of large memory blocks
+ *
+ * Used for the send and receive buffers of each TCP connection, which
+ * would otherwise be allocated and freed on every (re)connect.
+ *
+ * Requests are rounded up to a multiple of 4KB, and released blocks are kept
+ * on a free list for each such size class, up to a total of 64MB.
+ * The counters are registered with reftrack.
+ *
+ * A re-used block keeps the pages made resident by its earlier user,
+ * so cached blocks cost memory even when their new user touches little of them.
+ */
+class epicsShareClass BufferPool
+{
+public:
+    //! @returns a block of at least size bytes.  Throws std::bad_alloc
+    static char* allocate(std::size_t size);
+    //! Return a block from allocate() with the same size.
+    static void release(char* block, std::size_t size);
+
+    //! Blocks cached for re-use
+    static size_t num_free;
+    //! Blocks allocated and not yet released
+    static size_t num_used;
+    //! allocate() calls satisfied from the cache
+    static size_t num_hits;
+    //! allocate() calls which called malloc(), or the allocator
+    static size_t num_misses;
+
+    /** Bytes of the blocks cached for re-use, at most 64MB
+     *
+     *  @since 6.1.0
+     */
+    static std::size_t cachedBytes();
+
+    /** Take blocks from alloc instead of malloc().  Only the first call succeeds,
+     *  and only while no block is in use, eg. before the first TCP connection.
+     *
+     *  @since 6.1.0
+     */
+    static bool setAllocator(BlockAllocator* alloc);
+    //! The allocator installed, or NULL for malloc()
+    static BlockAllocator* allocator();
+};
+
+//! A block from BufferPool, released on destruction
+class epicsShareClass PooledBlock
+{
+    char * const _data;
+    const std::size_t _size;
+
+    PooledBlock(const PooledBlock&);
+    PooledBlock& operator=(const PooledBlock&);
+public:
+    explicit PooledBlock(std::size_t size)
+        :_data(BufferPool::allocate(size))
+        ,_size(size)
+    {}
+    ~PooledBlock() {
+        BufferPool::release(_data, _size);
+    }
+
+    char* data() const { return _data; }
+    std::size_t size() const { return _size; }
+};
+
+}
+}
+
+#endif // BUFFERPOOL_H
@@ -13,6 +13,7 @@
 #include <fstream>
 #include <map>
 #include <set>
+#include <vector>
 
 #ifdef epicsExportSharedSymbols
 #   define configurationEpicsExportSharedSymbols
@@ -38,6 +39,7 @@ namespace epics {
 namespace pvAccess {
 
 class ConfigurationStack;
+class ConfigurationCache;
 
 /**
  * Configuration
@@ -128,6 +130,7 @@ public:
 
 protected:
     friend class ConfigurationStack;
+    friend class ConfigurationCache;
     virtual bool tryGetPropertyAsString(const std::string& name, std::string* val) const = 0;
     virtual void addKeys(keys_t&) const {}
 };
@@ -178,6 +181,66 @@ public:
     }
 };
 
+/** Receives the names of properties whose value is changed by ConfigurationCache::reload()
+ * @since 6.1.0
+ */
+class epicsShareClass ConfigurationListener
+{
+public:
+    POINTER_DEFINITIONS(ConfigurationListener);
+    virtual ~ConfigurationListener() {}
+    //! Called once for each changed property, without locks held
+    virtual void propertyChanged(const std::string& name, const ConfigurationCache& conf) = 0;
+};
+
+/** Remembers each lookup of another Configuration, including those of properties not set,
+ * so that later lookups of the same name neither search a ConfigurationStack nor
+ * read the process environment.
+ *
+ * The values seen are those of the first lookup of each name until reload().
+ * Clients and servers each use a ConfigurationCache of the Configuration they are given.
+ * @since 6.1.0
+ */
+class epicsShareClass ConfigurationCache : public Configuration
+{
+public:
+    POINTER_DEFINITIONS(ConfigurationCache);
+
+    explicit ConfigurationCache(const Configuration::const_shared_pointer& backend);
+    virtual ~ConfigurationCache();
+
+    //! Return conf if it is a ConfigurationCache, or a new ConfigurationCache of it
+    static Configuration::shared_pointer wrap(const Configuration::const_shared_pointer& conf);
+
+    /** Look up again each name seen before, and notify listeners of those which changed.
+     * @returns the number of changed properties
+     */
+    size_t reload();
+
+    //! The listener is kept by weak reference
+    void addListener(const ConfigurationListener::shared_pointer& listener);
+    void removeListener(const ConfigurationListener::shared_pointer& listener);
+
+    const Configuration::const_shared_pointer& getBackend() const { return backend; }
+
+private:
+    virtual bool tryGetPropertyAsString(const std::string& name, std::string* val) const;
+    virtual void addKeys(keys_t&) const;
+
+    struct Entry {
+        bool found;
+        std::string value;
+        Entry() :found(false) {}
+    };
+    typedef std::map<std::string, Entry> cache_t;
+    typedef std::vector<std::tr1::weak_ptr<ConfigurationListener> > listeners_t;
+
+    const Configuration::const_shared_pointer backend;
+    mutable epics::pvData::Mutex mutex;
+    mutable cache_t cache;
+    listeners_t listeners;
+};
+
 struct epicsShareClass ConfigurationBuilder
 {
     ConfigurationBuilder();
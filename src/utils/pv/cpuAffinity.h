@@ -0,0 +1,78 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef CPUAFFINITY_H
+#define CPUAFFINITY_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#ifdef epicsExportSharedSymbols
+#   define cpuAffinityEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <osiSock.h>
+
+#ifdef cpuAffinityEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef cpuAffinityEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief A set of CPUs, to pin threads to, and the NUMA node to place their memory on.
+ *
+ * An empty set pins nothing.  Only effective on Linux, where CPU and NUMA topology
+ * is read from sysfs.  Elsewhere, parse() works, current() and ofNode() are empty,
+ * and pin() and placeMemory() do nothing.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass CPUAffinity
+{
+    std::vector<unsigned> cpus;
+public:
+    CPUAffinity() {}
+
+    //! Parse a list of CPUs and ranges, eg. "0-7,16-23".  @returns false if malformed
+    bool parse(const std::string& list);
+    void add(unsigned cpu);
+
+    bool empty() const { return cpus.empty(); }
+    std::size_t size() const { return cpus.size(); }
+    //! eg. "0-7,16-23"
+    std::string toString() const;
+
+    /** Pin the calling thread to these CPUs.  Does nothing if empty.
+     * @returns false on error, or where not supported.
+     */
+    bool pin() const;
+
+    //! The NUMA node of the first CPU, or -1 if unknown
+    int node() const;
+
+    //! The CPUs the calling thread may run on
+    static CPUAffinity current();
+    //! The CPUs of a NUMA node, empty if unknown
+    static CPUAffinity ofNode(int node);
+    //! The NUMA node of the network interface with this local IPv4 address, or -1 if unknown
+    static int nodeOfAddress(const osiSockAddr& addr);
+
+    /** Move those pages wholly within [buf, buf+len) to a NUMA node, and keep them there.
+     * Best effort.  @returns false on error, or where not supported.
+     */
+    static bool placeMemory(void *buf, std::size_t len, int node);
+};
+
+}
+}
+
+#endif // CPUAFFINITY_H
@@ -50,6 +50,12 @@ namespace pvAccess {
  *     this order.
  *     Adding [A, A, B, A, C, C] would give out [A, B, C, A, C, A].
  *
+ * @li Levels.  Each entry has a level, 0 being served first.  Entries of one
+ *     level are returned round robin, ahead of those of any higher level.
+ *     To prevent starvation, a non-empty level which has been passed over
+ *     maxStarve times is served next.  If all entries have the same level
+ *     (the default) this is the plain round robin described above.
+ *
  * @warning Only one thread should call pop_front()
  *   as push_back() does not broadcast (only wakes up one waiter)
  */
@@ -60,6 +66,15 @@ class fair_queue
 public:
     typedef std::tr1::shared_ptr<T> value_type;
 
+    enum {
+        //! Number of levels
+        nlevels = 3,
+        //! Level of a new entry
+        defaultLevel = 1,
+        //! Times a non-empty level may be passed over before it is served
+        maxStarve = 8
+    };
+
     class entry {
         /* In c++, use of ellLib (which implies offsetof()) should be restricted
          * to POD structs.  So enode_t exists as a POD struct for which offsetof()
@@ -73,6 +88,8 @@ public:
         unsigned Qcnt;
         value_type holder;
         fair_queue *owner;
+        unsigned level;  // level for the next push_back() while not queued
+        unsigned qlevel; // level of the list currently containing this entry
 
         friend class fair_queue;
 
@@ -81,6 +98,8 @@ public:
     public:
         entry() :Qcnt(0), holder()
             , owner(NULL)
+            , level(defaultLevel)
+            , qlevel(defaultLevel)
         {
             enode.node.next = enode.node.previous = NULL;
             enode.self = this;
@@ -91,16 +110,26 @@ public:
             assert(Qcnt==0 && !holder);
             assert(!owner);
         }
+
+        //! Takes effect when next added to an empty queue position.  Clipped to [0, nlevels)
+        void setQueueLevel(unsigned lvl) {
+            level = lvl<nlevels ? lvl : unsigned(nlevels-1);
+        }
+        unsigned getQueueLevel() const { return level; }
     };
 
     fair_queue()
     {
-        ellInit(&list);
+        for(unsigned i=0; i<nlevels; i++) {
+            ellInit(&list[i]);
+            starved[i] = 0;
+        }
     }
     ~fair_queue()
     {
         clear();
-        assert(ellCount(&list)==0);
+        for(unsigned i=0; i<nlevels; i++)
+            assert(ellCount(&list[i])==0);
     }
 
     void clear()
@@ -114,55 +143,86 @@ public:
 
     bool empty() const {
         guard_t G(mutex);
-        return ellFirst(&list)==NULL;
+        return emptyLocked();
     }
 
-    void push_back(const value_type& ent)
+    //! Number of distinct entries queued
+    size_t size() const {
+        guard_t G(mutex);
+        size_t ret = 0;
+        for(unsigned i=0; i<nlevels; i++)
+            ret += size_t(ellCount(&list[i]));
+        return ret;
+    }
+
+    //! @param notify If false, a consumer waiting in pop_front() is not woken until wake()
+    void push_back(const value_type& ent, bool notify = true)
     {
         bool wake;
         entry *P = ent.get();
         {
             guard_t G(mutex);
-            wake = ellFirst(&list)==NULL; // empty queue
+            wake = notify && emptyLocked();
 
             if(P->Qcnt++==0) {
                 // not in list
                 assert(P->owner==NULL);
                 P->owner = this;
                 P->holder = ent; // the list will hold a reference
-                ellAdd(&list, &P->enode.node); // push_back
+                P->qlevel = P->level;
+                ellAdd(&list[P->qlevel], &P->enode.node); // push_back
             } else
                 assert(P->owner==this);
         }
         if(wake) wakeup.signal();
     }
 
+    //! Wake a consumer waiting in pop_front(), if anything is queued
+    void wake()
+    {
+        if(!empty())
+            wakeup.signal();
+    }
+
     bool pop_front_try(value_type& ret)
     {
         ret.reset();
         guard_t G(mutex);
-        ELLNODE *cur = ellGet(&list); // pop_front
-
-        if(cur) {
-            typedef typename entry::enode_t enode_t;
-            enode_t *PN = CONTAINER(cur, enode_t, node);
-            entry *P = PN->self;
-            assert(P->owner==this);
-            assert(P->Qcnt>0);
-            if(--P->Qcnt==0) {
-                PN->node.previous = PN->node.next = NULL;
-                P->owner = NULL;
-
-                ret.swap(P->holder);
-            } else {
-                ellAdd(&list, &P->enode.node); // push_back
-
-                ret = P->holder;
+
+        // select the first non-empty level, unless a later one is starving
+        unsigned lvl = nlevels;
+        for(unsigned i=0; i<nlevels; i++) {
+            if(!ellFirst(&list[i])) {
+                starved[i] = 0;
+            } else if(lvl==nlevels) {
+                lvl = i;
+            } else if(++starved[i] > maxStarve) {
+                lvl = i;
             }
-            return true;
-        } else {
+        }
+        if(lvl==nlevels)
             return false;
+        starved[lvl] = 0;
+
+        ELLLIST *L = &list[lvl];
+        ELLNODE *cur = ellGet(L); // pop_front
+
+        typedef typename entry::enode_t enode_t;
+        enode_t *PN = CONTAINER(cur, enode_t, node);
+        entry *P = PN->self;
+        assert(P->owner==this);
+        assert(P->Qcnt>0);
+        if(--P->Qcnt==0) {
+            PN->node.previous = PN->node.next = NULL;
+            P->owner = NULL;
+
+            ret.swap(P->holder);
+        } else {
+            ellAdd(L, &P->enode.node); // push_back
+
+            ret = P->holder;
         }
+        return true;
     }
 
     void pop_front(value_type& ret)
@@ -187,7 +247,15 @@ public:
     }
 
 private:
-    ELLLIST list;
+    bool emptyLocked() const {
+        for(unsigned i=0; i<nlevels; i++)
+            if(ellFirst(&list[i]))
+                return false;
+        return true;
+    }
+
+    ELLLIST list[nlevels];
+    unsigned starved[nlevels];
     mutable epicsMutex mutex;
     mutable epicsEvent wakeup;
 };
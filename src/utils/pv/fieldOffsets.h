@@ -0,0 +1,133 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef FIELDOFFSETS_H
+#define FIELDOFFSETS_H
+
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define fieldOffsetsEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/sharedPtr.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+#ifdef fieldOffsetsEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef fieldOffsetsEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Serialization specialized for a fixed layout, instead of walking the PVField tree.
+ *
+ * Most updates are of NTScalar, and NTScalarArray, with only value, alarm and timeStamp.
+ * For these serializeChanged() and deserializeChanged() call routines instantiated for the
+ * type of value, which write alarm and timeStamp with one ensureBuffer() each, without a
+ * virtual call per field.  The bytes are those of PVStructure::serialize().
+ *
+ * @since 6.1.0
+ */
+struct epicsShareClass FastLayout
+{
+    void (*serialize)(epics::pvData::ByteBuffer *buffer,
+                      epics::pvData::SerializableControl *control,
+                      const epics::pvData::PVStructure& value,
+                      const epics::pvData::BitSet& changed);
+    void (*deserialize)(epics::pvData::ByteBuffer *buffer,
+                        epics::pvData::DeserializableControl *control,
+                        epics::pvData::PVStructure& value,
+                        const epics::pvData::BitSet& changed);
+    //! Type of value, eg. "double" or "double[]", or "any" when left to pvData
+    const char *name;
+
+    //! The layout of type, or NULL if none is specialized for it
+    static const FastLayout* select(const epics::pvData::Structure& type);
+
+    //! Whether select() may find a layout for a top level structure of nfields.  Cheaper than select()
+    static bool candidate(const epics::pvData::Structure& type, size_t nfields);
+};
+
+/** @brief Where each field of a Structure is, by offset.
+ *
+ * The parent and index of each field, so that the field of a PVStructure at an offset
+ * is found by descending from the top, without searching.
+ *
+ * One table is kept per Structure in use, found by identity.  Types received are
+ * interned (see IntrospectionRegistry::intern()), so all connections receiving a type
+ * share its table.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass FieldOffsets
+{
+public:
+    POINTER_DEFINITIONS(FieldOffsets);
+
+    explicit FieldOffsets(const epics::pvData::Structure& type);
+    ~FieldOffsets();
+
+    /** The table of type, made when first needed.
+     * Kept until type is no longer used.
+     */
+    static const_shared_pointer of(const epics::pvData::StructureConstPtr& type);
+
+    //! Number of fields, including the top structure
+    size_t size() const { return entries.size(); }
+
+    //! Chosen when the table is made, see FastLayout
+    const FastLayout* layout() const { return fast; }
+
+    /** The field of value at offset.  value is a top level structure of the type of this table.
+     * @pre 0 < offset < size()
+     */
+    epics::pvData::PVField* find(const epics::pvData::PVStructure& value, size_t offset) const;
+
+    //! Structures of fewer fields are left to pvData by serializeChanged()
+    static const size_t minFields = 64u;
+
+private:
+    struct Entry {
+        epics::pvData::uint32 parent; // offset of
+        epics::pvData::uint32 index; // in the fields of parent
+    };
+    std::vector<Entry> entries;
+    const FastLayout *fast;
+
+    void add(const epics::pvData::Structure& type, size_t offset);
+};
+
+/** As PVStructure::serialize() with the changed BitSet, with the same result.
+ *
+ * pvData looks at each field of every structure with a change inside.  For a structure
+ * with many fields, eg. a wide NTTable, this goes from one set bit to the next instead,
+ * so that the cost is of the fields changed.  Structures of a FastLayout use it.
+ */
+epicsShareFunc
+void serializeChanged(epics::pvData::ByteBuffer *buffer,
+                      epics::pvData::SerializableControl *control,
+                      const epics::pvData::PVStructure& value,
+                      const epics::pvData::BitSet& changed);
+
+//! As PVStructure::deserialize() with the changed BitSet.  See serializeChanged()
+epicsShareFunc
+void deserializeChanged(epics::pvData::ByteBuffer *buffer,
+                        epics::pvData::DeserializableControl *control,
+                        epics::pvData::PVStructure& value,
+                        const epics::pvData::BitSet& changed);
+
+}
+}
+
+#endif // FIELDOFFSETS_H
@@ -0,0 +1,214 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef IDTABLE_H
+#define IDTABLE_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <epicsTypes.h>
+
+#include <pv/pvaDefs.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Table of values keyed by pvAccessID (SID, CID or IOID).
+ *
+ * Open addressed, with linear probing, in one array.  The slot of an ID
+ * is taken from the high bits of its product with 2^32/phi (Fibonacci hashing),
+ * which spreads sequentially allocated IDs evenly, as well as IDs which
+ * differ only in their high bits, so most lookups need one probe.
+ * Entries are removed by shifting back their successors, so no tombstones
+ * accumulate as IDs are allocated and released.
+ *
+ * A subset of the std::map interface, as used for these tables.
+ * Erasing invalidates iterators.
+ *
+ * @warning Not thread safe.  Callers keep their own lock,
+ *          which is now held only for a probe or two.
+ */
+template<typename T>
+class IDTable
+{
+public:
+    typedef pvAccessID key_type;
+    typedef T mapped_type;
+    typedef std::pair<pvAccessID, T> value_type;
+
+private:
+    struct slot_t {
+        value_type kv;
+        bool used;
+        slot_t() :kv(0, T()), used(false) {}
+    };
+    typedef std::vector<slot_t> slots_t;
+    slots_t slots;
+    size_t count;
+    // 32 - log2(slots.size())
+    unsigned shift;
+
+    size_t mask() const { return slots.size()-1u; }
+    size_t home(pvAccessID id) const {
+        return size_t(epicsUInt32(epicsUInt32(id)*2654435769u) >> shift);
+    }
+    void allocate(size_t capacity) {
+        slots_t temp(capacity);
+        temp.swap(slots);
+        for(shift=32u; capacity>1u; capacity>>=1u)
+            shift--;
+    }
+    // storage is allocated on first insert, as many tables stay empty
+    slot_t* base() { return slots.empty() ? 0 : &slots[0]; }
+    const slot_t* base() const { return slots.empty() ? 0 : &slots[0]; }
+
+    // slot of id, or of the empty slot where it would be put.  slots not empty
+    size_t probe(pvAccessID id) const {
+        size_t i = home(id);
+        while(slots[i].used && slots[i].kv.first!=id)
+            i = (i+1u) & mask();
+        return i;
+    }
+
+    void rehash(size_t capacity) {
+        slots_t old;
+        old.swap(slots);
+        allocate(capacity);
+        for(size_t i=0; i<old.size(); i++) {
+            if(!old[i].used)
+                continue;
+            slot_t& S = slots[probe(old[i].kv.first)];
+            S.used = true;
+            S.kv.first = old[i].kv.first;
+            std::swap(S.kv.second, old[i].kv.second);
+        }
+    }
+
+    void erase_slot(size_t i) {
+        // shift back those which probed past i
+        for(size_t j = (i+1u) & mask(); slots[j].used; j = (j+1u) & mask()) {
+            const size_t h = home(slots[j].kv.first);
+            const bool between = i<=j ? (i<h && h<=j) : (i<h || h<=j);
+            if(between)
+                continue;
+            slots[i].kv.first = slots[j].kv.first;
+            std::swap(slots[i].kv.second, slots[j].kv.second);
+            i = j;
+        }
+        slots[i].used = false;
+        slots[i].kv.second = T();
+        count--;
+    }
+
+    template<typename S, typename V>
+    class iter_base {
+        S* base;
+        size_t i, n;
+        void skip() { while(i<n && !base[i].used) i++; }
+    public:
+        iter_base() :base(0), i(0), n(0) {}
+        iter_base(S* base, size_t i, size_t n) :base(base), i(i), n(n) { skip(); }
+        //! iterator to const_iterator
+        template<typename S2, typename V2>
+        iter_base(const iter_base<S2, V2>& o) :base(o.table()), i(o.slot()), n(o.limit()) {}
+        V& operator*() const { return base[i].kv; }
+        V* operator->() const { return &base[i].kv; }
+        iter_base& operator++() { i++; skip(); return *this; }
+        iter_base operator++(int) { iter_base ret(*this); ++(*this); return ret; }
+        bool operator==(const iter_base& o) const { return i==o.i; }
+        bool operator!=(const iter_base& o) const { return i!=o.i; }
+        size_t slot() const { return i; }
+        size_t limit() const { return n; }
+        S* table() const { return base; }
+    };
+
+public:
+    typedef iter_base<slot_t, value_type> iterator;
+    typedef iter_base<const slot_t, const value_type> const_iterator;
+
+    IDTable() :count(0u), shift(32u) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count==0u; }
+    //! number of slots, for diagnostics
+    size_t capacity() const { return slots.size(); }
+    //! total distance of entries from their home slots, for diagnostics
+    size_t displacement() const {
+        size_t total = 0u;
+        for(size_t i=0; i<slots.size(); i++) {
+            if(slots[i].used)
+                total += (i - home(slots[i].kv.first)) & mask();
+        }
+        return total;
+    }
+
+    iterator begin() { return iterator(base(), 0u, slots.size()); }
+    iterator end() { return iterator(base(), slots.size(), slots.size()); }
+    const_iterator begin() const { return const_iterator(base(), 0u, slots.size()); }
+    const_iterator end() const { return const_iterator(base(), slots.size(), slots.size()); }
+
+    iterator find(pvAccessID id) {
+        if(count==0u)
+            return end();
+        const size_t i = probe(id);
+        return slots[i].used ? iterator(base(), i, slots.size()) : end();
+    }
+    const_iterator find(pvAccessID id) const {
+        if(count==0u)
+            return end();
+        const size_t i = probe(id);
+        return slots[i].used ? const_iterator(base(), i, slots.size()) : end();
+    }
+
+    //! Insert a default value if id is not present
+    T& operator[](pvAccessID id) {
+        if(slots.empty())
+            allocate(8u);
+        size_t i = probe(id);
+        if(!slots[i].used) {
+            // keep at most 3/4 full
+            if((count+1u)*4u > slots.size()*3u) {
+                rehash(slots.size()*2u);
+                i = probe(id);
+            }
+            slots[i].used = true;
+            slots[i].kv.first = id;
+            count++;
+        }
+        return slots[i].kv.second;
+    }
+
+    void erase(iterator it) { erase_slot(it.slot()); }
+
+    size_t erase(pvAccessID id) {
+        if(count==0u)
+            return 0u;
+        const size_t i = probe(id);
+        if(!slots[i].used)
+            return 0u;
+        erase_slot(i);
+        return 1u;
+    }
+
+    void clear() {
+        slots_t temp;
+        temp.swap(slots);
+        count = 0u;
+    }
+
+    void swap(IDTable& o) {
+        slots.swap(o.slots);
+        std::swap(count, o.count);
+        std::swap(shift, o.shift);
+    }
+};
+
+}
+}
+
+#endif // IDTABLE_H
@@ -36,6 +36,25 @@ struct ifaceNode {
 typedef std::vector<ifaceNode> IfaceNodeVector;
 epicsShareFunc int discoverInterfaces(IfaceNodeVector &list, SOCKET socket, const osiSockAddr *pMatchAddr = 0);
 
+/**
+ * As discoverInterfaces(), but re-uses the result of an earlier enumeration
+ * with the same pMatchAddr if it is younger than the cache timeout (10 seconds by default).
+ * Results are appended to list.  The cache is shared by all contexts in the process.
+ */
+epicsShareFunc int discoverInterfacesCached(IfaceNodeVector &list, SOCKET socket, const osiSockAddr *pMatchAddr = 0);
+
+/**
+ * Discard all cached interface lists, eg. after a network interface is added or removed.
+ * The next discoverInterfacesCached() will enumerate again.
+ */
+epicsShareFunc void invalidateInterfaceCache();
+
+/**
+ * Set the age (in seconds) after which cached interface lists are enumerated again.
+ * Zero disables caching.  Also discards all cached interface lists.
+ */
+epicsShareFunc void setInterfaceCacheTimeout(double timeout);
+
 /**
  * Returns NIF index for given interface address, or -1 on failure.
  */
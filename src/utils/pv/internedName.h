@@ -0,0 +1,77 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef INTERNEDNAME_H
+#define INTERNEDNAME_H
+
+#include <string>
+#include <utility>
+#include <cstddef>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief A string stored once for all InternedName of the same value.
+ *
+ * For names held by many objects, eg. by each of the channels which many clients
+ * have opened to one PV.  An InternedName is the size of a pointer, and copies
+ * share the one string.
+ *
+ * The strings are kept in a process wide table, guarded by a mutex, which is
+ * searched on construction from a std::string.  Copying, and destroying other than
+ * the last InternedName of a string, only change a reference count atomically
+ * (under the mutex before Base 3.15.1, which lacks epicsAtomic).
+ * A string is removed when its last InternedName is destroyed.
+ *
+ * Equal names compare, and hash(), without looking at their characters.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass InternedName
+{
+    struct Info {
+        //! number of InternedName referring to this string
+        std::size_t refs;
+        //! epicsMemHash() of the string
+        unsigned hash;
+    };
+    // a node of the table
+    typedef std::pair<const std::string, Info> Entry;
+    Entry *entry;
+
+    struct Table;
+    static Table& table();
+    static Entry* acquire(const std::string& name);
+    void release();
+public:
+    //! The empty string
+    InternedName();
+    explicit InternedName(const std::string& name);
+    InternedName(const InternedName& other);
+    InternedName& operator=(const InternedName& other);
+    ~InternedName();
+
+    const std::string& str() const;
+    const char* c_str() const { return str().c_str(); }
+    //! epicsMemHash() of str(), computed when first interned
+    unsigned hash() const { return entry->second.hash; }
+
+    //! Interned strings of equal value are the same, so compare as pointers
+    bool operator==(const InternedName& o) const { return entry==o.entry; }
+    bool operator!=(const InternedName& o) const { return entry!=o.entry; }
+
+    void swap(InternedName& o) { std::swap(entry, o.entry); }
+
+    //! Distinct strings presently interned
+    static size_t num_names;
+};
+
+}
+}
+
+#endif // INTERNEDNAME_H
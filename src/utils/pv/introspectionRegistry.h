@@ -8,6 +8,7 @@
 #define INTROSPECTIONREGISTRY_H
 
 #include <map>
+#include <list>
 #include <iostream>
 
 #ifdef epicsExportSharedSymbols
@@ -29,12 +30,21 @@
 #	undef introspectionRegistryEpicsExportSharedSymbols
 #endif
 
+#include <shareLib.h>
+
 // TODO check for memory leaks
 
 namespace epics {
 namespace pvAccess {
 
 typedef std::map<const short,epics::pvData::FieldConstPtr> registryMap_t;
+// outgoing ids of registered Fields, by structural hash (see hashField())
+typedef std::multimap<epics::pvData::uint32,epics::pvData::int16> registryHashIndex_t;
+// outgoing ids of registered Fields, by identity.  Valid as _registry keeps each Field.
+typedef std::map<const epics::pvData::Field*,epics::pvData::int16> registryPointerIndex_t;
+// outgoing ids, most recently sent first
+typedef std::list<epics::pvData::int16> registryLRU_t;
+typedef std::map<epics::pvData::int16,registryLRU_t::iterator> registryLRUIndex_t;
 
 
 /**
@@ -42,7 +52,7 @@ typedef std::map<const short,epics::pvData::FieldConstPtr> registryMap_t;
  * Registry is used to cache introspection interfaces to minimize network traffic.
  * @author gjansa
  */
-class IntrospectionRegistry : public epics::pvData::NoDefaultMethods {
+class epicsShareClass IntrospectionRegistry : public epics::pvData::NoDefaultMethods {
 public:
     IntrospectionRegistry();
     virtual ~IntrospectionRegistry();
@@ -52,12 +62,36 @@ public:
      */
     void reset();
 
+    /**
+     * Limit the number of outgoing ids, as advertised by the peer during connection validation.
+     * When all are in use, the id of the least recently sent interface is
+     * re-assigned by sending the new interface in full with it.
+     * 0 sends every interface in full, without an id.
+     * At most, and by default, MAX_SIZE.
+     * @since 6.1.0
+     */
+    void setMaxSize(std::size_t maxSize);
+    std::size_t getMaxSize() const { return _maxSize; }
+
+    //! Number of ids registered
+    std::size_t size() const { return _registry.size(); }
+
+    /** Approximate bytes of the entries of the indexes, not including the Fields,
+     *  which are shared.  Read without locking from other threads, so only an estimate.
+     */
+    std::size_t memoryUsage() const;
+
+    //! The largest number of ids.  Ids are positive int16.
+    const static std::size_t MAX_SIZE = 0x7FFF;
+
 private:
     /**
      * Registers introspection interface and get it's ID. Always OUTGOING.
      * If it is already registered only preassigned ID is returned.
      *
-     * TODO !!!!!!this can get very slow in large maps. We need to change this !!!!!!
+     * The same Field instance is found by identity, an equal one by its structural hash,
+     * so the cost does not grow with the number of registered interfaces.
+     * A new interface takes the id of the least recently used one when getMaxSize() ids are in use.
      *
      * @param field introspection interface to register
      *
@@ -101,16 +135,38 @@ public:
      */
     const static epics::pvData::int8 FULL_WITH_ID_TYPE_CODE;
 
+    /**
+     * Hash of the structure of an introspection interface.
+     * Fields which compare equal have the same hash.
+     * @since 6.1.0
+     */
+    static epics::pvData::uint32 hashField(epics::pvData::Field const & field);
+
+    /**
+     * The instance of an identical type received before, by any connection,
+     * while it is still in use, otherwise field itself.
+     * Structures and unions received from the peer are interned, so that equal types
+     * of many connections share one Field, and compare equal by identity.
+     * @since 6.1.0
+     */
+    static epics::pvData::FieldConstPtr intern(epics::pvData::FieldConstPtr const & field);
+
 private:
     registryMap_t _registry;
+    registryHashIndex_t _byHash;
+    registryPointerIndex_t _byPointer;
+    registryLRU_t _lru;
+    registryLRUIndex_t _lruPos;
     epics::pvData::int16 _pointer;
+    std::size_t _maxSize;
 
     /**
      * Field factory.
      */
     static epics::pvData::FieldCreatePtr _fieldCreate;
 
-    bool registryContainsValue(epics::pvData::FieldConstPtr const & field, epics::pvData::int16& key);
+    bool registryContainsValue(epics::pvData::FieldConstPtr const & field, epics::pvData::uint32 hash, epics::pvData::int16& key);
+    void unindex(epics::pvData::int16 key);
 };
 
 }
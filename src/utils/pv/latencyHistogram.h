@@ -0,0 +1,80 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <ostream>
+
+#ifdef epicsExportSharedSymbols
+#   define latencyHistogramEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/pvType.h>
+
+#ifdef latencyHistogramEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef latencyHistogramEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Counts of durations in log-linear buckets, as HDR histograms.
+ *
+ * Durations are counted in microseconds.  Each power of two is divided into
+ * 8 buckets, so a percentile is within 12.5% of the exact value,
+ * from 1 us up to about 12 days, with a fixed amount of memory.
+ *
+ * Not thread safe.
+ * @since 6.1.0
+ */
+class epicsShareClass LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    //! Count one duration, in seconds.  Negative is counted as 0.
+    void record(double seconds);
+    void reset();
+    //! Add the counts of another
+    void merge(const LatencyHistogram& other);
+
+    epics::pvData::uint64 count() const { return total; }
+    //! in seconds.  0 if empty.
+    double mean() const;
+    double max() const { return maxUS*1e-6; }
+    //! Upper bound of the bucket of the duration below which fraction (0.0 to 1.0) of the durations are, in seconds.  0 if empty.
+    double percentile(double fraction) const;
+    //! Sum of the durations, in seconds
+    double sum() const { return sumUS*1e-6; }
+    //! Number of durations in buckets whose upper bound is at most seconds.  Cumulative, as a Prometheus histogram bucket.
+    epics::pvData::uint64 countAtMost(double seconds) const;
+
+    //! "count N mean ... p50 ... p90 ... p99 ... max ..." in microseconds
+    void show(std::ostream& strm) const;
+
+private:
+    enum {
+        subBits = 3,
+        subBuckets = 1<<subBits,
+        // 2^40 us is about 12 days
+        nbuckets = subBuckets + (40-subBits)*subBuckets
+    };
+    static size_t bucketOf(epics::pvData::uint64 us);
+    static epics::pvData::uint64 upperOf(size_t bucket);
+
+    epics::pvData::uint64 buckets[nbuckets];
+    epics::pvData::uint64 total, sumUS, maxUS;
+};
+
+}
+}
+
+#endif // LATENCYHISTOGRAM_H
@@ -42,13 +42,63 @@ epicsShareFunc void pvAccessLog(pvAccessLogLevel level, const char* format, ...)
 epicsShareFunc void pvAccessSetLogLevel(pvAccessLogLevel level);
 epicsShareFunc bool pvAccessIsLoggable(pvAccessLogLevel level);
 
+typedef enum {
+    logFormatText,    //!< "<time> <message>"
+    logFormatKeyValue //!< time=<time> level=<level> msg="<message>"
+} pvAccessLogFormat;
+
+/** Select the output format of pvAccessLog().
+ * @since 6.1.0
+ */
+epicsShareFunc void pvAccessSetLogFormat(pvAccessLogFormat format);
+
+/** Limit the messages of each call site, told apart by the format string, to
+ * perSecond in each second.  The number of messages suppressed is logged
+ * by the next message from that site after the second.  0 (the default) is no limit.
+ * @since 6.1.0
+ */
+epicsShareFunc void pvAccessSetLogRateLimit(unsigned perSecond);
+
+/** Write the messages of pvAccessLog() from a background thread.
+ *
+ * Messages are formatted by the calling thread into a ring of queueSize
+ * entries, without a lock, and written by the background thread.  The message is
+ * dropped when the ring is full, and the number dropped is logged later.
+ * Long messages are truncated.
+ * The ring is allocated by the first call, and its size is kept.
+ * queueSize 0 writes the messages of later calls synchronously again, after those queued.
+ * @since 6.1.0
+ */
+epicsShareFunc void pvAccessSetLogAsync(size_t queueSize);
+
+/** Wait until the messages queued by pvAccessLog() are written, or timeout.
+ * @since 6.1.0
+ */
+epicsShareFunc void pvAccessLogFlush(double timeout = 5.0);
+
+namespace detail {
+//! The level set by pvAccessSetLogLevel(), for the test of LOG() and IS_LOGGABLE()
+epicsShareExtern int pvAccessLogThreshold;
+}
+
+/* LOG() messages below this level are removed when compiling,
+ * see PVA_LOG_MIN_LEVEL in configure/CONFIG_SITE
+ */
+#ifndef PVA_LOG_MIN_LEVEL
+#  define PVA_LOG_MIN_LEVEL 0
+#endif
+
+/* Arguments of LOG() are not evaluated unless the level is logged */
+#define PVA_LOG_ENABLED(level) ((int)(level) >= PVA_LOG_MIN_LEVEL && \
+                                (int)(level) >= ::epics::pvAccess::detail::pvAccessLogThreshold)
+
 #if defined (__GNUC__) && __GNUC__ < 3
-#define LOG(level, format, ARGS...) pvAccessLog(level, format, ##ARGS)
+#define LOG(level, format, ARGS...) (PVA_LOG_ENABLED(level) ? pvAccessLog(level, format, ##ARGS) : (void)0)
 #else
-#define LOG(level, format, ...) pvAccessLog(level, format, ##__VA_ARGS__)
+#define LOG(level, format, ...) (PVA_LOG_ENABLED(level) ? pvAccessLog(level, format, ##__VA_ARGS__) : (void)0)
 #endif
 #define SET_LOG_LEVEL(level) pvAccessSetLogLevel(level)
-#define IS_LOGGABLE(level) pvAccessIsLoggable(level)
+#define IS_LOGGABLE(level) PVA_LOG_ENABLED(level)
 
 // EPICS errlog
 //#define LOG errlogSevPrintf
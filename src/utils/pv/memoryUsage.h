@@ -0,0 +1,45 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <stddef.h>
+
+#ifdef epicsExportSharedSymbols
+#   define memoryUsageEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/pvData.h>
+
+#ifdef memoryUsageEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef memoryUsageEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** Approximate heap bytes held by the value of a PVField and its sub-fields.
+ *
+ * Counts the PVField objects, string storage and array elements, but not the
+ * introspection (Field) which is shared.  Arrays shared between copies
+ * (shared_vector) are counted for each copy which refers to them.
+ *
+ * Memory accounting, as shown by eg. ServerContext::printInfo() level 2,
+ * is a sum of these estimates.
+ *
+ * @since 6.1.0
+ */
+epicsShareFunc size_t memoryUsage(const epics::pvData::PVField& field);
+
+}
+}
+
+#endif // MEMORYUSAGE_H
@@ -0,0 +1,180 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#ifdef epicsExportSharedSymbols
+#   define metricsEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+#include <epicsThread.h>
+#include <osiSock.h>
+
+#include <pv/sharedPtr.h>
+
+#ifdef metricsEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef metricsEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+class LatencyHistogram;
+
+/** @brief A counter incremented from any thread without locking.
+ *
+ * Reads are not synchronized with other counters, so sums over several
+ * may be off by the increments made while they are read.
+ * Before Base 3.15.1, without epicsAtomic, increments and reads lock
+ * one mutex shared by all counters.
+ */
+class epicsShareClass MetricCounter
+{
+    size_t value;
+public:
+    MetricCounter() :value(0u) {}
+    void increment(size_t n = 1u);
+    size_t get() const;
+};
+
+/** @brief Samples of counters, in the Prometheus text exposition format.
+ *
+ * Samples of one name and set of labels added more than once are summed,
+ * so several contexts of one process report their totals.
+ *
+ @code
+   Metrics M;
+   M.family("pva_server_channels", Metrics::Gauge, "Channels open");
+   M.add("pva_server_channels", 42);
+   M.write(std::cout);
+ @endcode
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass Metrics
+{
+public:
+    enum Type { Counter, Gauge, Histogram };
+
+    //! Describe a family.  Later descriptions of the same name are ignored.
+    void family(const std::string& name, Type type, const std::string& help);
+
+    //! Add value to the sample of a family, which starts at zero.  labels as from label()
+    void add(const std::string& name, double value, const std::string& labels = std::string());
+
+    /** Add the counts of a histogram, in seconds, to the buckets with these upper bounds (in
+     * increasing order), and to the _sum and _count of a Histogram family.
+     * Bucket counts are approximate, see LatencyHistogram::countAtMost().
+     */
+    void add(const std::string& name, const LatencyHistogram& hist,
+             const std::vector<double>& bounds, const std::string& labels = std::string());
+
+    //! The bounds used for latencies, from 100 us to 10 s
+    static const std::vector<double>& defaultBounds();
+    //! The bounds used for latencies within a host, eg. of the network stack, from 1 us to 100 ms
+    static const std::vector<double>& shortBounds();
+
+    //! Format key="value", escaping value.  Join several with ','
+    static std::string label(const char *key, const std::string& value);
+
+    void write(std::ostream& strm) const;
+
+private:
+    struct Sample {
+        std::string suffix, labels;
+        double value;
+    };
+    struct Family {
+        Type type;
+        std::string help;
+        std::vector<Sample> samples;
+        std::map<std::pair<std::string, std::string>, size_t> index;
+    };
+    typedef std::map<std::string, Family> families_t;
+    families_t families;
+
+    void add(Family& fam, const std::string& suffix, double value, const std::string& labels);
+};
+
+/** @brief Something with counters to export, eg. a server or client context.
+ *
+ * collectMetrics() is called by the thread scraping, and should only read counters,
+ * taking locks for no longer than a copy.
+ */
+class epicsShareClass MetricsSource
+{
+public:
+    POINTER_DEFINITIONS(MetricsSource);
+    virtual ~MetricsSource() {}
+    virtual void collectMetrics(Metrics& metrics) =0;
+
+    //! Add to the sources of the process.  Removed once source is destroyed.
+    static void add(const std::tr1::weak_ptr<MetricsSource>& source);
+    //! Collect from all sources of the process
+    static void collectAll(Metrics& metrics);
+};
+
+/** @brief An HTTP endpoint answering GET /metrics with the metrics of all MetricsSource of the process.
+ *
+ * Serves one request at a time, from its own thread.
+ * Started in a ServerContext by EPICS_PVAS_METRICS_PORT.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass MetricsServer : public epicsThreadRunable
+{
+public:
+    POINTER_DEFINITIONS(MetricsServer);
+
+    /** Listen on a TCP port of an interface.
+     * @param port 0 for any free port, see getPort()
+     * @param iface interface address, eg. "127.0.0.1".  Empty for all.
+     * @throws std::runtime_error if the port can't be bound.
+     */
+    explicit MetricsServer(unsigned short port, const std::string& iface = std::string());
+    virtual ~MetricsServer();
+
+    //! The port bound
+    unsigned short getPort() const;
+
+    //! Stop serving.  Joins the worker thread.
+    void stop();
+
+    //! Requests answered
+    size_t getRequestCount() const;
+
+private:
+    virtual void run();
+    void serve(SOCKET client);
+
+    SOCKET sock;
+    osiSockAddr bound;
+
+    mutable epicsMutex mutex;
+    bool running;
+    size_t requests;
+
+    epicsThread worker;
+
+    MetricsServer(const MetricsServer&);
+    MetricsServer& operator=(const MetricsServer&);
+};
+
+}
+}
+
+#endif // METRICS_H
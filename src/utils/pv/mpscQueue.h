@@ -0,0 +1,262 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define mpscQueueExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_MPSC_USE_ATOMIC
+#endif
+#endif
+
+#include <pv/sharedPtr.h>
+
+#ifdef mpscQueueExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef mpscQueueExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+
+/** @brief An intrusive, coalescing, unbounded queue of many producers and one consumer
+ *
+ * The parameterized type 'T' must be a sub-class of @class mpsc_queue<T>::entry
+ *
+ * @li Lock-free.  push_back() is a compare and swap onto a stack, which the consumer
+ *     takes all of at once when it has nothing left.  (With EPICS Base older
+ *     than 3.15.1, which has no epicsAtomic, a mutex is used instead.)
+ *
+ * @li Coalescing.  Pushing an entry which is already queued has no effect.
+ *     The entry is given to the consumer once, after all pushes made before.
+ *     fair_queue instead gives out an entry once for each push.
+ *
+ * @li Order.  Entries are given out in the order they were added,
+ *     except that those added while the consumer has some left come after those.
+ *     There are no levels, unlike fair_queue.
+ *
+ * @li Wakeups.  push_back() signals only when it adds to an empty queue while
+ *     the consumer is waiting in pop_front().
+ *
+ * @warning Only one thread may call the pop_*(), empty() and clear() methods.
+ */
+template<typename T>
+class mpsc_queue
+{
+public:
+    typedef std::tr1::shared_ptr<T> value_type;
+
+    class entry {
+        entry *next;
+        int queued;
+        value_type holder;
+
+        friend class mpsc_queue;
+
+        entry(const entry&);
+        entry& operator=(const entry&);
+    public:
+        entry() :next(NULL), queued(0) {}
+        ~entry() {
+            // entries should be popped before deletion
+            assert(queued==0 && !holder);
+        }
+    };
+
+    mpsc_queue() :head(NULL), pending(NULL), sleeping(0) {}
+    ~mpsc_queue()
+    {
+        clear();
+    }
+
+    //! Consumer only.  Drop all queued entries.
+    void clear()
+    {
+        std::vector<value_type> all;
+        pop_all(all);
+    }
+
+    //! Consumer only.
+    bool empty() {
+        return !pending && !getPtr(head);
+    }
+
+    void push_back(const value_type& ent)
+    {
+        entry *P = ent.get();
+        if(casInt(P->queued, 0, 1)!=0)
+            return; // already queued
+
+        // only written while not queued
+        P->holder = ent;
+
+        ptr_t prev;
+        do {
+            prev = getPtr(head);
+            P->next = static_cast<entry*>(prev);
+        } while(casPtr(head, prev, P)!=prev);
+
+        if(!prev && getInt(sleeping))
+            wakeup.signal();
+    }
+
+    bool pop_front_try(value_type& ret)
+    {
+        ret.reset();
+        if(!pending)
+            pending = takeAll();
+        if(!pending)
+            return false;
+
+        entry *P = pending;
+        pending = P->next;
+        release(P, ret);
+        return true;
+    }
+
+    void pop_front(value_type& ret)
+    {
+        while(!pop_front_try(ret))
+            sleep(-1.0);
+    }
+
+    bool pop_front(value_type& ret, double timeout)
+    {
+        while(!pop_front_try(ret)) {
+            if(!sleep(timeout))
+                return pop_front_try(ret);
+        }
+        return true;
+    }
+
+    /** Append all queued entries to 'out', in the order they would be popped.
+     * @returns the number appended
+     */
+    size_t pop_all(std::vector<value_type>& out)
+    {
+        size_t n = 0u;
+        entry *P = pending;
+        pending = NULL;
+        for(unsigned pass=0; pass<2u; pass++) {
+            while(P) {
+                entry *next = P->next;
+                out.push_back(value_type());
+                release(P, out.back());
+                P = next;
+                n++;
+            }
+            if(pass==0u)
+                P = takeAll();
+        }
+        return n;
+    }
+
+private:
+#ifdef PVA_MPSC_USE_ATOMIC
+    typedef EpicsAtomicPtrT ptr_t;
+
+    static ptr_t getPtr(ptr_t& val) { return epics::atomic::get(val); }
+    static ptr_t casPtr(ptr_t& val, ptr_t oldval, ptr_t newval) { return epics::atomic::compareAndSwap(val, oldval, newval); }
+    static int getInt(int& val) { return epics::atomic::get(val); }
+    static int casInt(int& val, int oldval, int newval) { return epics::atomic::compareAndSwap(val, oldval, newval); }
+#else
+    typedef void* ptr_t;
+    typedef epicsGuard<epicsMutex> guard_t;
+
+    template<typename V>
+    V getLocked(V& val) {
+        guard_t G(mutex);
+        return val;
+    }
+    template<typename V>
+    V casLocked(V& val, V oldval, V newval) {
+        guard_t G(mutex);
+        V prev = val;
+        if(prev==oldval)
+            val = newval;
+        return prev;
+    }
+    ptr_t getPtr(ptr_t& val) { return getLocked(val); }
+    ptr_t casPtr(ptr_t& val, ptr_t oldval, ptr_t newval) { return casLocked(val, oldval, newval); }
+    int getInt(int& val) { return getLocked(val); }
+    int casInt(int& val, int oldval, int newval) { return casLocked(val, oldval, newval); }
+
+    epicsMutex mutex;
+#endif
+
+    // everything pushed, oldest first.
+    // As only the consumer removes, and removes all, there is no ABA problem.
+    entry* takeAll()
+    {
+        ptr_t all;
+        do {
+            all = getPtr(head);
+        } while(all && casPtr(head, all, NULL)!=all);
+
+        entry *fifo = NULL, *P = static_cast<entry*>(all);
+        while(P) {
+            entry *next = P->next;
+            P->next = fifo;
+            fifo = P;
+            P = next;
+        }
+        return fifo;
+    }
+
+    void release(entry *P, value_type& ret)
+    {
+        P->next = NULL;
+        // before it may be queued again
+        ret.swap(P->holder);
+        casInt(P->queued, 1, 0);
+    }
+
+    // false on timeout.  timeout < 0 waits forever
+    bool sleep(double timeout)
+    {
+        // producers adding to an empty stack after this see it
+        casInt(sleeping, 0, 1);
+        bool woken = true;
+        if(!getPtr(head)) {
+            if(timeout < 0.0)
+                wakeup.wait();
+            else
+                woken = wakeup.wait(timeout);
+        }
+        casInt(sleeping, 1, 0);
+        return woken;
+    }
+
+    // stack of pushed entries, newest first
+    ptr_t head;
+    // popped from head, not yet given out.  Consumer only
+    entry *pending;
+    // set while the consumer may wait
+    int sleeping;
+    epicsEvent wakeup;
+};
+
+}
+} // namespace
+
+#endif // MPSCQUEUE_H
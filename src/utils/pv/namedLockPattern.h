@@ -7,7 +7,7 @@
 #ifndef NAMEDLOCKPATTERN_H
 #define NAMEDLOCKPATTERN_H
 
-#include <map>
+#include <functional>
 #include <iostream>
 
 #ifdef epicsExportSharedSymbols
@@ -27,14 +27,30 @@
 #endif
 
 #include <pv/referenceCountingLock.h>
+#include <pv/stripedLock.h>
 
 // TODO implement using smart pointers
 
 namespace epics {
 namespace pvAccess {
 
+namespace detail {
+// NamedLockPattern keys need only be ordered, so all share one shard
+struct NamedLockHash {
+    template<typename Key>
+    size_t operator()(const Key&) const { return 0u; }
+};
+template <class Key, class Compare>
+struct NamedLockEqual {
+    Compare less;
+    bool operator()(const Key& a, const Key& b) const { return !less(a, b) && !less(b, a); }
+};
+}
+
 /**
  * NamedLockPattern
+ *
+ * @deprecated Use StripedLock directly.
  */
 template <class Key, class Compare = std::less<Key> >
 class EPICS_DEPRECATED NamedLockPattern
@@ -67,84 +83,20 @@ public:
      */
     void releaseSynchronizationObject(const Key& name);
 private:
-    epics::pvData::Mutex _mutex;
-    std::map<const Key,ReferenceCountingLock::shared_pointer,Compare> _namedLocks;
-    typename std::map<const Key,ReferenceCountingLock::shared_pointer,Compare>::iterator _namedLocksIter;
-
-    /**
-     * Release synchronization lock for named object.
-     * @param	name	name of the object whose lock to release.
-     * @param	release	set to <code>false</code> if there is no need to call release
-     * 					on synchronization lock.
-     */
-    void releaseSynchronizationObject(const Key& name,const bool release);
+    StripedLock<Key, detail::NamedLockHash, detail::NamedLockEqual<Key,Compare>, 1u> _namedLocks;
 };
 
 template <class Key, class Compare>
-bool NamedLockPattern<Key,Compare>::acquireSynchronizationObject(const Key& name, const epics::pvData::int64 msec)
+bool NamedLockPattern<Key,Compare>::acquireSynchronizationObject(const Key& name, const epics::pvData::int64 /*msec*/)
 {
-    ReferenceCountingLock::shared_pointer lock;
-    {   //due to guard
-        epics::pvData::Lock guard(_mutex);
-
-        _namedLocksIter = _namedLocks.find(name);
-        // get synchronization object
-
-        // none is found, create and return new one
-        // increment references
-        if(_namedLocksIter == _namedLocks.end())
-        {
-            lock.reset(new ReferenceCountingLock());
-            _namedLocks[name] = lock;
-        }
-        else
-        {
-            lock = _namedLocksIter->second;
-            lock->increment();
-        }
-    } // end of guarded area
-
-    bool success = lock->acquire(msec);
-
-    if(!success)
-    {
-        releaseSynchronizationObject(name, false);
-    }
-
-    return success;
+    _namedLocks.lock(name);
+    return true;
 }
 
 template <class Key, class Compare>
 void NamedLockPattern<Key,Compare>::releaseSynchronizationObject(const Key& name)
 {
-    releaseSynchronizationObject(name, true);
-}
-
-template <class Key, class Compare>
-void NamedLockPattern<Key,Compare>::releaseSynchronizationObject(const Key& name,const bool release)
-{
-    epics::pvData::Lock guard(_mutex);
-    ReferenceCountingLock::shared_pointer lock;
-    _namedLocksIter = _namedLocks.find(name);
-
-    // release lock
-    if (_namedLocksIter != _namedLocks.end())
-    {
-        lock = _namedLocksIter->second;
-
-        // release the lock
-        if (release)
-        {
-            lock->release();
-        }
-
-        // if there only one current lock exists
-        // remove it from the map
-        if (lock->decrement() <= 0)
-        {
-            _namedLocks.erase(_namedLocksIter);
-        }
-    }
+    _namedLocks.unlock(name);
 }
 
 template <class Key, class Compare>
@@ -0,0 +1,51 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef PVAPROBES_H_
+#define PVAPROBES_H_
+
+/* Static (USDT) trace points of the "pvaccess" provider, for bpftrace, perf or SystemTap.
+ *
+ * When no tracer is attached, each is a single nop, plus the evaluation of its arguments.
+ * Compiled where <sys/sdt.h> is available (eg. systemtap-sdt-dev), unless built with WITH_SDT=NO.
+ *
+ * Probe                 Arguments
+ * transport_connect     transport, is server, const osiSockAddr* peer, const char* peer name
+ * transport_close       transport, is server, const osiSockAddr* peer, const char* peer name
+ * rx_header             transport, command, payload size, flags, const osiSockAddr* peer
+ * tx_message            transport, command, payload capacity ensured
+ * tx_sender             transport, TransportSender*, bytes serialized
+ * server_dispatch       transport, command, payload size, first and second int32 of payload
+ *                       (sid/cid and ioid for channel operations)
+ * monitor_post          MonitorFIFO*, updates queued, squashed into the last (overflow)
+ * monitor_poll          MonitorFIFO*, MonitorElement* or 0, updates left queued
+ * search_round          channels due, channels searched, frames sent
+ *
+ * A transport is identified by its address, so per connection statistics join the
+ * other probes with transport_connect.  eg. server requests by peer:
+ *
+ *   bpftrace -e 'usdt:/path/libpvAccess.so:pvaccess:transport_connect { @peer[arg0] = str(arg3); }
+ *                usdt:/path/libpvAccess.so:pvaccess:server_dispatch { @req[@peer[arg0], arg1] = count(); }'
+ */
+
+#if !defined(PVA_NO_SDT) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define PVA_HAVE_SDT
+#  endif
+#endif
+
+#ifdef PVA_HAVE_SDT
+#  define PVA_PROBE3(NAME, A, B, C) DTRACE_PROBE3(pvaccess, NAME, A, B, C)
+#  define PVA_PROBE4(NAME, A, B, C, D) DTRACE_PROBE4(pvaccess, NAME, A, B, C, D)
+#  define PVA_PROBE5(NAME, A, B, C, D, E) DTRACE_PROBE5(pvaccess, NAME, A, B, C, D, E)
+#else
+#  define PVA_PROBE3(NAME, A, B, C) do {} while(0)
+#  define PVA_PROBE4(NAME, A, B, C, D) do {} while(0)
+#  define PVA_PROBE5(NAME, A, B, C, D, E) do {} while(0)
+#endif
+
+#endif /* PVAPROBES_H_ */
@@ -0,0 +1,92 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef REQUESTMASK_H
+#define REQUESTMASK_H
+
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define requestMaskEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <pv/sharedPtr.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+
+#ifdef requestMaskEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef requestMaskEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Limits changed masks to the fields selected by a pvRequest.
+ *
+ * The mask from pvData::extractRequestMask() also marks each structure which
+ * contains a selected field.  So an update marking such a structure as changed,
+ * eg. bit 0 for a complete value, would copy and send unselected fields too.
+ * select() replaces such a bit with those of the selected fields it contains.
+ *
+ * Copies share what reset() computes.
+ */
+class epicsShareClass RequestMask
+{
+public:
+    RequestMask();
+
+    /** @param selected Fields selected, as from pvData::extractRequestMask()
+     *  @param value Any instance of the type which selected applies to
+     */
+    void reset(const epics::pvData::BitSet& selected,
+               const epics::pvData::PVStructure& value);
+
+    /** As reset(pvData::extractRequestMask(value, fieldRequest), *value), done once for each
+     * type and form of request while that type is in use.  Later calls with the same, eg.
+     * of many clients subscribing alike to PVs of one type, share the result.
+     *
+     * @param value Any instance of the type
+     * @param fieldRequest The "field" sub-structure of a pvRequest, may be NULL
+     * @since 6.1.0
+     */
+    void reset(const epics::pvData::PVStructure::const_shared_pointer& value,
+               const epics::pvData::PVStructure::const_shared_pointer& fieldRequest);
+
+    void clear();
+
+    //! As passed to reset()
+    const epics::pvData::BitSet& mask() const;
+    bool empty() const { return !data || data->selected.isEmpty(); }
+
+    //! out = changed, with only selected fields
+    void select(epics::pvData::BitSet& out, const epics::pvData::BitSet& changed) const;
+
+    //! Number of masks kept by the reset() of a request
+    static size_t num_cached();
+
+private:
+    struct Data {
+        epics::pvData::BitSet selected,
+                              whole; // fields with all sub-fields selected
+        std::vector<epics::pvData::uint32> ends; // getNextFieldOffset() of each field
+        bool partial;
+
+        Data(const epics::pvData::BitSet& selected, const epics::pvData::PVStructure& value);
+        void fillEnds(const epics::pvData::PVField& field);
+    };
+    std::tr1::shared_ptr<const Data> data; // NULL when cleared
+
+    friend struct RequestMaskCache;
+};
+
+}
+}
+
+#endif // REQUESTMASK_H
@@ -0,0 +1,107 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <vector>
+#include <algorithm>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Double ended queue in one array.
+ *
+ * Capacity is set by reserve(), and afterwards only grows, by doubling,
+ * when a push would overflow it.  So once reserve()d, a queue which stays
+ * within capacity does no allocation, unlike std::list which allocates
+ * a node on every push.  Popped slots are reset to T().
+ *
+ * A subset of the std::deque interface.
+ *
+ * @warning Not thread safe.
+ */
+template<typename T>
+class RingBuffer
+{
+    typedef std::vector<T> slots_t;
+    slots_t slots;
+    size_t head, count;
+
+    size_t index(size_t i) const { return (head+i)%slots.size(); }
+    void grow() { reserve(slots.empty() ? 4u : slots.size()*2u); }
+public:
+    typedef T value_type;
+
+    RingBuffer() :head(0u), count(0u) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count==0u; }
+    size_t capacity() const { return slots.size(); }
+
+    //! Ensure capacity for at least n
+    void reserve(size_t n) {
+        if(n<=slots.size())
+            return;
+        slots_t temp(n);
+        for(size_t i=0; i<count; i++)
+            std::swap(temp[i], slots[index(i)]);
+        temp.swap(slots);
+        head = 0u;
+    }
+
+    //! The i-th entry from the front
+    const T& operator[](size_t i) const { return slots[index(i)]; }
+    T& front() { return slots[head]; }
+    const T& front() const { return slots[head]; }
+    T& back() { return slots[index(count-1u)]; }
+    const T& back() const { return slots[index(count-1u)]; }
+
+    void push_back(const T& v) {
+        if(count==slots.size())
+            grow();
+        slots[index(count)] = v;
+        count++;
+    }
+    void push_front(const T& v) {
+        if(count==slots.size())
+            grow();
+        head = (head+slots.size()-1u)%slots.size();
+        slots[head] = v;
+        count++;
+    }
+    void pop_front() {
+        slots[head] = T();
+        head = (head+1u)%slots.size();
+        count--;
+    }
+    //! pop_front() into out, by swap, so a shared_ptr is handed off without touching its count
+    void pop_front(T& out) {
+        T temp;
+        std::swap(temp, slots[head]);
+        std::swap(out, temp);
+        head = (head+1u)%slots.size();
+        count--;
+    }
+
+    void swap(RingBuffer& o) {
+        slots.swap(o.slots);
+        std::swap(head, o.head);
+        std::swap(count, o.count);
+    }
+
+    //! Remove all entries.  Capacity is kept.
+    void clear() {
+        for(size_t i=0; i<count; i++)
+            slots[index(i)] = T();
+        head = count = 0u;
+    }
+};
+
+}
+}
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,117 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef SENDERPOOL_H
+#define SENDERPOOL_H
+
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define senderPoolExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define PVA_SENDERPOOL_USE_ATOMIC
+#endif
+#endif
+
+#include <pv/sharedPtr.h>
+
+#ifdef senderPoolExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef senderPoolExportSharedSymbols
+#endif
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Reuses the senders of one-off replies, and their shared_ptr.
+ *
+ * A reply without state beyond its message, eg. to CMD_ECHO, would otherwise allocate
+ * a sender, and the control block of its shared_ptr, for each message.
+ * The pool keeps the shared_ptr of up to maxSize senders.  get() returns one to which
+ * no other reference remains, ie. which has been sent and released by the send queue,
+ * so reuse allocates nothing.  When all are in use, a new one is made.
+ *
+ * Only the pool hands out references, under its lock, so a sender found unique
+ * stays so until returned.
+ *
+ * S is default constructed, and may have been used before, so the caller sets each
+ * field before queueing it.  eg. EchoTransportSender::create()
+ *
+ * Before Base 3.15.1 there is no epicsAtomic memory barrier to order reuse after the
+ * release by another thread, so each get() makes a new sender.
+ *
+ * @since 6.1.0
+ */
+template<class S>
+class SenderPool
+{
+    typedef epicsGuard<epicsMutex> Guard;
+public:
+    typedef std::tr1::shared_ptr<S> value_type;
+
+    explicit SenderPool(size_t maxSize = 16u)
+        :maxSize(maxSize)
+        ,next(0u)
+        ,allocated(0u)
+    {}
+
+    //! An idle sender, or a new one
+    value_type get()
+    {
+        Guard G(mutex);
+#ifdef PVA_SENDERPOOL_USE_ATOMIC
+        for(size_t n=pool.size(); n; n--) {
+            const value_type& sender(pool[next]);
+            if(++next==pool.size())
+                next = 0u;
+            if(sender.unique()) {
+                // order our use after the release of the last other reference
+                epicsAtomicReadMemoryBarrier();
+                return sender;
+            }
+        }
+        value_type ret(new S);
+        allocated++;
+        if(pool.size()<maxSize)
+            pool.push_back(ret);
+        return ret;
+#else
+        allocated++;
+        return value_type(new S);
+#endif
+    }
+
+    //! Number of senders made by get(), including those not kept
+    size_t num_allocated() const
+    {
+        Guard G(mutex);
+        return allocated;
+    }
+
+private:
+    SenderPool(const SenderPool&);
+    SenderPool& operator=(const SenderPool&);
+
+    mutable epicsMutex mutex;
+    std::vector<value_type> pool;
+    const size_t maxSize;
+    size_t next;
+    size_t allocated;
+};
+
+}
+}
+
+#endif // SENDERPOOL_H
@@ -0,0 +1,147 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef STRIPEDLOCK_H
+#define STRIPEDLOCK_H
+
+#include <vector>
+#include <functional>
+
+#include <pv/lock.h>
+#include <pv/event.h>
+#include <pv/noDefaultMethods.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Serialize activity per key without allocating a lock per key.
+ *
+ * Keys are spread over a fixed array of shards by Hash.  Each shard has a mutex,
+ * held only while the shard's list of busy keys is updated, and a list of
+ * waiters.  So holding one key never blocks another key, even one in the same shard.
+ *
+ * Uncontended lock()/unlock() allocate nothing once a shard's busy list has grown
+ * to the number of keys concurrently held there.  A thread which must wait
+ * creates an Event on its own stack.
+ *
+ * Keys are compared with Equal, so Hash need only be consistent with Equal.
+ * A Hash which returns a constant puts all keys in one shard.
+ *
+ * Not recursive.  Locking a key already held by the calling thread deadlocks.
+ */
+template<typename Key, typename Hash, typename Equal = std::equal_to<Key>, size_t Shards = 16u>
+class StripedLock
+{
+    EPICS_NOT_COPYABLE(StripedLock)
+
+    struct Waiter {
+        const Key& key;
+        epics::pvData::Event wakeup;
+        Waiter *next;
+        explicit Waiter(const Key& key) :key(key), next(0) {}
+    };
+
+    struct Shard {
+        epics::pvData::Mutex mutex;
+        std::vector<Key> busy;
+        Waiter *waiters;
+        Shard() :waiters(0) {}
+    };
+
+    Shard shards[Shards];
+    const Hash hash;
+    const Equal equal;
+
+    Shard& shardOf(const Key& key) { return shards[size_t(hash(key))%Shards]; }
+
+    // call with shard locked
+    bool tryTake(Shard& S, const Key& key) {
+        for(size_t i=0, N=S.busy.size(); i<N; i++) {
+            if(equal(S.busy[i], key))
+                return false;
+        }
+        S.busy.push_back(key);
+        return true;
+    }
+
+public:
+    explicit StripedLock(const Hash& hash = Hash(), const Equal& equal = Equal())
+        :hash(hash), equal(equal)
+    {}
+
+    //! Block until no other thread holds key, then hold it
+    void lock(const Key& key) {
+        Shard& S = shardOf(key);
+        epics::pvData::Lock G(S.mutex);
+        if(tryTake(S, key))
+            return;
+        Waiter W(key);
+        do {
+            W.next = S.waiters;
+            S.waiters = &W;
+            G.unlock();
+            W.wakeup.wait();
+            G.lock();
+            // unlock() has removed W from waiters
+        } while(!tryTake(S, key));
+    }
+
+    //! Hold key if no other thread does.  Never blocks on another holder.
+    bool tryLock(const Key& key) {
+        Shard& S = shardOf(key);
+        epics::pvData::Lock G(S.mutex);
+        return tryTake(S, key);
+    }
+
+    //! Release key held by lock() or a successful tryLock(), and wake its waiters
+    void unlock(const Key& key) {
+        Shard& S = shardOf(key);
+        epics::pvData::Lock G(S.mutex);
+        for(size_t i=0, N=S.busy.size(); i<N; i++) {
+            if(equal(S.busy[i], key)) {
+                if(i+1u!=N)
+                    S.busy[i] = S.busy[N-1u];
+                S.busy.pop_back();
+                break;
+            }
+        }
+        // waiters re-check, and if need be re-queue, after we release the shard mutex.
+        for(Waiter **pnext = &S.waiters; *pnext; ) {
+            Waiter *W = *pnext;
+            if(equal(W->key, key)) {
+                *pnext = W->next;
+                W->next = 0;
+                W->wakeup.signal();
+            } else {
+                pnext = &W->next;
+            }
+        }
+    }
+
+    //! Number of keys currently held.  For diagnostics.
+    size_t size() {
+        size_t ret = 0u;
+        for(size_t i=0; i<Shards; i++) {
+            epics::pvData::Lock G(shards[i].mutex);
+            ret += shards[i].busy.size();
+        }
+        return ret;
+    }
+
+    //! Scoped lock() of one key
+    class Guard {
+        EPICS_NOT_COPYABLE(Guard)
+        StripedLock& table;
+        const Key key;
+    public:
+        Guard(StripedLock& table, const Key& key) :table(table), key(key) { table.lock(key); }
+        ~Guard() { table.unlock(key); }
+    };
+};
+
+}} // namespace epics::pvAccess
+
+#endif // STRIPEDLOCK_H
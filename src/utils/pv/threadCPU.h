@@ -0,0 +1,70 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef THREADCPU_H
+#define THREADCPU_H
+
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <unistd.h>
+#endif
+
+#ifdef epicsExportSharedSymbols
+#   define threadCPUEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+
+#ifdef threadCPUEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef threadCPUEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+#if defined(_POSIX_THREAD_CPUTIME) && _POSIX_THREAD_CPUTIME>=0
+#  define PVA_THREAD_CPUTIME
+#endif
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief The CPU time used by one thread, readable from any other.
+ *
+ * The thread to be measured calls attach() when it starts, and detach() before it exits,
+ * after which seconds() returns the total it used.
+ * Where threads have no CPU clock (isSupported() is false), all times are zero.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass ThreadCPUClock
+{
+    mutable epicsMutex mutex;
+    bool attached;
+    double total;
+#ifdef PVA_THREAD_CPUTIME
+    clockid_t clock;
+#endif
+public:
+    ThreadCPUClock();
+
+    //! Measure the calling thread
+    void attach();
+    //! Called by the attached thread.  Keeps the time it used.
+    void detach();
+    //! Seconds used by the attached thread so far, or in total once detached
+    double seconds() const;
+
+    static bool isSupported();
+    //! Seconds used by the calling thread
+    static double self();
+};
+
+}} // namespace epics::pvAccess
+
+#endif // THREADCPU_H
@@ -0,0 +1,153 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <string>
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define timerWheelEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include <pv/sharedPtr.h>
+#include <pv/pvType.h>
+#include <pv/timer.h>
+
+#ifdef timerWheelEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef timerWheelEpicsExportSharedSymbols
+#endif
+
+#include <pv/pvaDefs.h>
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+/** @brief Hierarchical timing wheel for protocol timers.
+ *
+ * Runs epics::pvData::TimerCallback s, as epics::pvData::Timer, on one thread.
+ * Scheduling and cancelling take constant time however many are scheduled,
+ * instead of inserting into or removing from one sorted queue.
+ *
+ * Time is counted in ticks of a fixed period, and a callback runs in the first tick
+ * at or after its delay.  Four levels of 256 slots each hold the callbacks due within
+ * 256, 256^2, 256^3 and 256^4 ticks, and are moved to a lower level as their time
+ * comes nearer.  All of the callbacks due in a tick are taken from their slot together.
+ *
+ * As Timer, a callback may be scheduled again, or cancelled, from any callback.
+ * After close(), scheduling calls timerStopped() at once.
+ * @since 6.1.0
+ */
+class epicsShareClass TimerWheel : public epicsThreadRunable
+{
+public:
+    POINTER_DEFINITIONS(TimerWheel);
+
+    /**
+     * @param threadName name of the thread which runs callbacks
+     * @param priority epicsThread priority of it
+     * @param tick resolution in seconds
+     */
+    TimerWheel(const std::string& threadName, unsigned int priority, double tick = DEFAULT_TICK);
+    virtual ~TimerWheel();
+
+    //! Stop the thread, and call timerStopped() of those scheduled.  Joins the thread, unless called from a callback.
+    void close();
+
+    /** Run callback() once, after delay seconds.
+     * @throws std::logic_error if already scheduled.
+     */
+    void scheduleAfterDelay(epics::pvData::TimerCallbackPtr const & timerCallback, double delay);
+    /** Run callback() after delay seconds, then every period seconds until cancel()ed.
+     * Once if period is not positive.
+     * @throws std::logic_error if already scheduled.
+     */
+    void schedulePeriodic(epics::pvData::TimerCallbackPtr const & timerCallback, double delay, double period);
+    //! @returns true if was scheduled.  A callback running now is not stopped.
+    bool cancel(epics::pvData::TimerCallbackPtr const & timerCallback);
+    bool isScheduled(epics::pvData::TimerCallbackPtr const & timerCallback) const;
+
+    //! Number of callbacks scheduled
+    size_t size() const;
+
+    static const double DEFAULT_TICK;
+
+private:
+    virtual void run() OVERRIDE FINAL;
+
+    enum {
+        SLOT_BITS = 8,
+        SLOTS = 1<<SLOT_BITS,
+        LEVELS = 4
+    };
+
+    struct Entry {
+        epics::pvData::TimerCallbackPtr callback;
+        // tick to run at, and period in ticks (0 for once)
+        epics::pvData::uint64 expire, period;
+        // in the list of m_slots[level][slot], or of m_due when level<0
+        int level, slot;
+        Entry *prev, *next;
+        // in the list of m_buckets
+        Entry *hnext;
+    };
+
+    void schedule(epics::pvData::TimerCallbackPtr const & timerCallback, double delay, double period);
+
+    // current tick, from the time since construction
+    epics::pvData::uint64 now() const;
+    // put e in the slot for e->expire
+    void place(Entry *e);
+    void unlink(Entry *e);
+    // m_current+1, moving those of the slots of higher levels now due within 256 ticks down, then those of the tick to m_due
+    void advance();
+
+    Entry* find(epics::pvData::TimerCallback *cb) const;
+    void insertHash(Entry *e);
+    void eraseHash(Entry *e);
+
+    // tick of the next slot with something in it, or the next move from a higher level
+    epics::pvData::uint64 nextWake() const;
+
+    const double m_tick;
+    const epicsTime m_start;
+
+    mutable epicsMutex m_mutex;
+    epicsEvent m_wakeup;
+    bool m_running;
+
+    // m_slots[level][slot] is a list of Entry.  Those of ticks up to m_current have run
+    Entry* m_slots[LEVELS][SLOTS];
+    // taken from the slot of m_current, and not yet run
+    Entry* m_due;
+    epics::pvData::uint64 m_current;
+    // tick at which the thread wakes up, when sleeping
+    epics::pvData::uint64 m_wakeAt;
+
+    // scheduled callbacks by address.  size is a power of two
+    std::vector<Entry*> m_buckets;
+    size_t m_count;
+
+    epicsThread m_thread;
+
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+};
+
+}
+}
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,188 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <ostream>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#ifdef epicsExportSharedSymbols
+#   define tracingEpicsExportSharedSymbols
+#   undef epicsExportSharedSymbols
+#endif
+
+#include <epicsTime.h>
+#include <epicsMutex.h>
+
+#include <pv/pvType.h>
+#include <pv/byteBuffer.h>
+#include <pv/sharedPtr.h>
+
+#ifdef tracingEpicsExportSharedSymbols
+#   define epicsExportSharedSymbols
+#   undef tracingEpicsExportSharedSymbols
+#endif
+
+#include <shareLib.h>
+
+namespace epics {
+namespace pvAccess {
+
+class Configuration;
+
+/** @brief The W3C trace context of a request: the trace it belongs to, and the span which caused it.
+ *
+ * Sent ahead of get, put and RPC requests and responses on connections where both
+ * peers enable tracing with EPICS_PVA_TRACE.
+ *
+ * @since 6.1.0
+ */
+struct epicsShareClass TraceContext
+{
+    epics::pvData::uint8 traceId[16];
+    epics::pvData::uint8 spanId[8];
+    //! W3C trace-flags.  1 is sampled
+    epics::pvData::uint8 flags;
+
+    //! Bytes sent on the wire
+    enum { wireSize = 16+8+1 };
+
+    //! All zeros, which is not valid()
+    TraceContext();
+
+    //! Neither ID is all zeros
+    bool valid() const;
+
+    //! The start of a new trace, with random IDs
+    static TraceContext root();
+    //! A span of the same trace, with a random span ID
+    TraceContext child() const;
+
+    //! W3C traceparent header, eg. "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"
+    std::string toString() const;
+    //! Parse a traceparent.  false if malformed.
+    static bool parse(const std::string& traceparent, TraceContext& ctx);
+
+    void serialize(epics::pvData::ByteBuffer* buffer) const;
+    void deserialize(epics::pvData::ByteBuffer* buffer);
+};
+
+/** @brief Makes a trace context current for the calling thread.
+ *
+ * Client get, put and RPC requests issued by a thread with a current context are traced as
+ * its children.  A server makes the context of a traced request current while its provider
+ * is called, so that requests forwarded by a gateway continue the trace.
+ *
+ @code
+   TraceContext ctx;
+   if(TraceContext::parse(traceparent, ctx)) {
+       TraceScope scope(&ctx);
+       channel.put().set("value", 4).exec();
+   }
+ @endcode
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass TraceScope
+{
+    const TraceContext *prev;
+    bool active;
+public:
+    //! NULL leaves the current context unchanged.  ctx must outlive this scope.
+    explicit TraceScope(const TraceContext *ctx);
+    ~TraceScope();
+
+    //! The current context of the calling thread, or NULL
+    static const TraceContext* current();
+private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+};
+
+/** @brief One traced get, put or RPC, as seen by a client or a server.
+ *
+ * Times are those of the stages of the request:
+ *
+ * @li client: issued by the application (start), serialized for sending (dispatch),
+ *     and response received (end).
+ * @li server: received by the codec (start), passed to the provider (dispatch),
+ *     and response serialized (end).
+ */
+struct epicsShareClass Span
+{
+    //! trace ID, and the ID of this span
+    TraceContext context;
+    //! ID of the parent span, or zeros for a root span
+    epics::pvData::uint8 parentId[8];
+    //! eg. "pva.get"
+    std::string name;
+    bool server;
+    std::string channel, peer;
+    epicsTimeStamp start, dispatch, end;
+
+    Span();
+    bool hasParent() const;
+};
+
+/** @brief Receives the spans of traced requests.
+ *
+ * record() is called by the thread completing a request, and should not block.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass TraceSink
+{
+public:
+    POINTER_DEFINITIONS(TraceSink);
+    virtual ~TraceSink() {}
+    virtual void record(const Span& span) =0;
+
+    //! Add to the sinks of the process
+    static void add(const shared_pointer& sink);
+    static void remove(const shared_pointer& sink);
+    //! Pass to all sinks
+    static void recordAll(const Span& span);
+
+    /** Apply the EPICS_PVA_TRACE and EPICS_PVA_TRACE_FILE of a configuration.
+     * Adds one TraceFileSink per file named.
+     * @returns true if tracing is enabled.
+     */
+    static bool configure(const Configuration& config);
+};
+
+/** @brief Appends spans to a file as OpenTelemetry (OTLP) JSON, one export request per line.
+ *
+ * Such files are read by eg. the otlpjsonfile receiver of the OpenTelemetry Collector.
+ *
+ * @since 6.1.0
+ */
+class epicsShareClass TraceFileSink : public TraceSink
+{
+public:
+    POINTER_DEFINITIONS(TraceFileSink);
+    //! @throws std::runtime_error if fname can't be opened for append
+    explicit TraceFileSink(const std::string& fname, const std::string& service = "pvAccess");
+    virtual ~TraceFileSink();
+    virtual void record(const Span& span);
+
+    //! Format one span as an OTLP JSON export request
+    static void format(std::ostream& strm, const Span& span, const std::string& service);
+private:
+    epicsMutex mutex;
+    FILE *fp;
+    const std::string service;
+
+    TraceFileSink(const TraceFileSink&);
+    TraceFileSink& operator=(const TraceFileSink&);
+};
+
+}
+}
+
+#endif // TRACING_H
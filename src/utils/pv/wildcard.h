@@ -12,6 +12,10 @@
 #ifndef WILDCARD_H
 #define WILDCARD_H
 
+#include <string>
+#include <vector>
+#include <map>
+
 #include <shareLib.h>
 
 namespace epics {
@@ -36,6 +40,56 @@ public:
     static int wildcardfit (const char *wildcard, const char *test);
 };
 
+/**
+ * A set of wildcard patterns, with the same syntax as Wildcard::wildcardfit(),
+ * compiled into a trie so that a name is tested against all patterns in one pass.
+ * The cost of match() depends on the length of the name and on how many
+ * pattern prefixes are matched at once, but not on the number of patterns.
+ *
+ * Not thread safe.
+ * @since 6.1.0
+ */
+class epicsShareClass WildcardSet
+{
+public:
+    WildcardSet();
+
+    /** Add a pattern.  Adding a pattern already in the set changes nothing.
+     */
+    void add(const std::string& pattern);
+    //! @returns true if pattern was in the set
+    bool remove(const std::string& pattern);
+    void clear();
+
+    size_t size() const { return m_patterns.size(); }
+    bool empty() const { return m_patterns.empty(); }
+
+    /** Test a name against all patterns.
+     * @param test Value to test.
+     * @param pattern If not NULL, set to the matching pattern which was added first.
+     * @returns true if some pattern matches test
+     */
+    bool match(const std::string& test, std::string* pattern = 0) const;
+
+private:
+    static const size_t none;
+
+    struct Node {
+        std::map<char, size_t> next; // literal characters
+        size_t any;     // '?'
+        size_t star;    // '*'
+        bool isStar;    // reached by '*', so may consume any characters
+        size_t pattern; // index in m_patterns of the first pattern ending here, or none
+        Node() :any(none), star(none), isStar(false), pattern(none) {}
+    };
+
+    void compile(size_t index);
+    void closure(size_t node, std::vector<size_t>& states) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<std::string> m_patterns; // in the order added
+};
+
 }
 }
 
@@ -0,0 +1,206 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <map>
+#include <string>
+#include <algorithm>
+
+#include <epicsThread.h>
+
+#include <pv/lock.h>
+
+#define epicsExportSharedSymbols
+#include <pv/requestMask.h>
+
+namespace pvd = epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+
+const pvd::BitSet noneSelected;
+
+/* The form of a "field" request, which is all of it that extractRequestMask() uses.
+ * Field names, with the fields of sub-structures in braces.
+ */
+void requestKey(std::string& key, const pvd::PVStructure& request)
+{
+    const pvd::PVFieldPtrArray& fields(request.getPVFields());
+    for(size_t i=0; i<fields.size(); i++) {
+        key += fields[i]->getFieldName();
+        if(fields[i]->getField()->getType()==pvd::structure) {
+            key += '{';
+            requestKey(key, static_cast<const pvd::PVStructure&>(*fields[i]));
+            key += '}';
+        }
+        key += ',';
+    }
+}
+
+} // namespace
+
+/* The masks of each type and form of request, by identity of the type.  Holds no
+ * reference to a type, so its masks are forgotten after it is released.
+ */
+struct RequestMaskCache {
+    typedef std::pair<const pvd::Structure*, std::string> key_t;
+    typedef std::pair<std::tr1::weak_ptr<const pvd::Field>, std::tr1::shared_ptr<const RequestMask::Data> > entry_t;
+    typedef std::map<key_t, entry_t> table_t;
+
+    pvd::Mutex mutex;
+    table_t table;
+    // at which size expired entries are removed next
+    size_t sweepAt;
+
+    RequestMaskCache() :sweepAt(1024u) {}
+
+    std::tr1::shared_ptr<const RequestMask::Data> find(const pvd::PVStructure::const_shared_pointer& value,
+                                                       const pvd::PVStructure::const_shared_pointer& fieldRequest)
+    {
+        const pvd::StructureConstPtr& type(value->getStructure());
+        key_t key(type.get(), std::string());
+        if(fieldRequest)
+            requestKey(key.second, *fieldRequest);
+        else
+            key.second = "-";
+
+        {
+            pvd::Lock G(mutex);
+            table_t::const_iterator it(table.find(key));
+            // the same address may have been reused by another type
+            if(it!=table.end() && it->second.first.lock()==type)
+                return it->second.second;
+        }
+
+        // outside the lock.  Another may do the same meanwhile, which is harmless.
+        std::tr1::shared_ptr<const RequestMask::Data> data(new RequestMask::Data(
+                pvd::extractRequestMask(value, fieldRequest), *value));
+
+        pvd::Lock G(mutex);
+        table[key] = entry_t(std::tr1::weak_ptr<const pvd::Field>(type), data);
+
+        if(table.size() >= sweepAt)
+        {
+            for(table_t::iterator it = table.begin(); it != table.end(); )
+            {
+                if(it->second.first.expired())
+                    table.erase(it++);
+                else
+                    ++it;
+            }
+            sweepAt = std::max(size_t(1024u), 2u*table.size());
+        }
+        return data;
+    }
+};
+
+namespace {
+
+RequestMaskCache *theCache;
+epicsThreadOnceId cacheOnce = EPICS_THREAD_ONCE_INIT;
+
+void cacheInit(void *)
+{
+    theCache = new RequestMaskCache;
+}
+
+} // namespace
+
+RequestMask::Data::Data(const pvd::BitSet& selected, const pvd::PVStructure& value)
+    :selected(selected)
+{
+    ends.resize(value.getNextFieldOffset());
+    fillEnds(value);
+
+    // a field is wholly selected if it, and everything after it up to its end, is
+    const size_t N = ends.size();
+    for(size_t i=N; i>0; i--) {
+        const size_t f = i-1u;
+        bool all = selected.get(pvd::uint32(f));
+        for(size_t j=f+1u; all && j<ends[f]; j = ends[j])
+            all = whole.get(pvd::uint32(j));
+        if(all)
+            whole.set(pvd::uint32(f));
+    }
+
+    partial = !whole.get(0);
+}
+
+void RequestMask::Data::fillEnds(const pvd::PVField& field)
+{
+    ends[field.getFieldOffset()] = pvd::uint32(field.getNextFieldOffset());
+    if(field.getField()->getType()!=pvd::structure)
+        return;
+    const pvd::PVFieldPtrArray& fields(static_cast<const pvd::PVStructure&>(field).getPVFields());
+    for(size_t i=0; i<fields.size(); i++)
+        fillEnds(*fields[i]);
+}
+
+RequestMask::RequestMask() {}
+
+void RequestMask::reset(const pvd::BitSet& selected,
+                        const pvd::PVStructure& value)
+{
+    data.reset(new Data(selected, value));
+}
+
+void RequestMask::reset(const pvd::PVStructure::const_shared_pointer& value,
+                        const pvd::PVStructure::const_shared_pointer& fieldRequest)
+{
+    epicsThreadOnce(&cacheOnce, &cacheInit, 0);
+    data = theCache->find(value, fieldRequest);
+}
+
+void RequestMask::clear()
+{
+    data.reset();
+}
+
+const pvd::BitSet& RequestMask::mask() const
+{
+    return data ? data->selected : noneSelected;
+}
+
+void RequestMask::select(pvd::BitSet& out, const pvd::BitSet& changed) const
+{
+    if(!data) {
+        out.clear();
+        return;
+    }
+    const Data& D(*data);
+
+    out = changed;
+    out &= D.selected;
+    if(!D.partial || out.isEmpty())
+        return;
+
+    // replace partly selected structures by their selected fields
+    for(pvd::int32 i = out.nextSetBit(0); i>=0; i = out.nextSetBit(pvd::uint32(i)+1u)) {
+        const pvd::uint32 f = pvd::uint32(i);
+        if(D.whole.get(f) || f>=D.ends.size())
+            continue;
+        out.clear(f);
+        for(pvd::uint32 j=f+1u; j<D.ends[f]; ) {
+            if(D.whole.get(j)) {
+                out.set(j);
+                j = D.ends[j];
+            } else {
+                j++;
+            }
+        }
+    }
+}
+
+size_t RequestMask::num_cached()
+{
+    epicsThreadOnce(&cacheOnce, &cacheInit, 0);
+    pvd::Lock G(theCache->mutex);
+    return theCache->table.size();
+}
+
+}
+}
@@ -0,0 +1,93 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#ifdef __unix__
+#  include <pthread.h>
+#endif
+
+#include <epicsGuard.h>
+
+#define epicsExportSharedSymbols
+#include <pv/threadCPU.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace epics {
+namespace pvAccess {
+
+#ifdef PVA_THREAD_CPUTIME
+namespace {
+// false if clock is no longer valid, eg. its thread has exited
+bool readClock(clockid_t clock, double& secs)
+{
+    struct timespec ts;
+    if(clock_gettime(clock, &ts))
+        return false;
+    secs = ts.tv_sec + ts.tv_nsec*1e-9;
+    return true;
+}
+} // namespace
+#endif
+
+ThreadCPUClock::ThreadCPUClock()
+    :attached(false)
+    ,total(0.0)
+{}
+
+void ThreadCPUClock::attach()
+{
+#ifdef PVA_THREAD_CPUTIME
+    clockid_t temp;
+    if(pthread_getcpuclockid(pthread_self(), &temp))
+        return;
+    Guard G(mutex);
+    clock = temp;
+    attached = true;
+#endif
+}
+
+void ThreadCPUClock::detach()
+{
+    const double used = self();
+    Guard G(mutex);
+    if(!attached)
+        return;
+    attached = false;
+    total = used;
+}
+
+double ThreadCPUClock::seconds() const
+{
+    Guard G(mutex);
+#ifdef PVA_THREAD_CPUTIME
+    // the thread can't exit without detach(), which waits for the mutex
+    double secs;
+    if(attached && readClock(clock, secs))
+        return secs;
+#endif
+    return total;
+}
+
+bool ThreadCPUClock::isSupported()
+{
+#ifdef PVA_THREAD_CPUTIME
+    return true;
+#else
+    return false;
+#endif
+}
+
+double ThreadCPUClock::self()
+{
+#ifdef PVA_THREAD_CPUTIME
+    double secs;
+    if(readClock(CLOCK_THREAD_CPUTIME_ID, secs))
+        return secs;
+#endif
+    return 0.0;
+}
+
+}} // namespace epics::pvAccess
@@ -0,0 +1,359 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <stdexcept>
+#include <string.h>
+#include <math.h>
+
+#include <epicsGuard.h>
+
+#define epicsExportSharedSymbols
+#include <pv/timerWheel.h>
+#include <pv/logger.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+namespace pvd = epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+const pvd::uint64 NEVER = pvd::uint64(-1);
+
+inline pvd::uint64 span(int level)
+{
+    return pvd::uint64(1) << (8*level);
+}
+
+// of an address, which is aligned
+inline size_t hashOf(const void* p)
+{
+    return (size_t(p)>>4) * 2654435761u;
+}
+}
+
+const double TimerWheel::DEFAULT_TICK = 0.01;
+
+TimerWheel::TimerWheel(const std::string& threadName, unsigned int priority, double tick)
+    :m_tick(tick>0.0 ? tick : DEFAULT_TICK)
+    ,m_start(epicsTime::getCurrent())
+    ,m_running(true)
+    ,m_due(0)
+    ,m_current(0u)
+    ,m_wakeAt(0u)
+    ,m_buckets(64u, (Entry*)0)
+    ,m_count(0u)
+    ,m_thread(*this, threadName.c_str(),
+              epicsThreadGetStackSize(epicsThreadStackSmall),
+              priority)
+{
+    memset(m_slots, 0, sizeof(m_slots));
+    m_thread.start();
+}
+
+TimerWheel::~TimerWheel()
+{
+    close();
+}
+
+void TimerWheel::close()
+{
+    {
+        Guard G(m_mutex);
+        if(!m_running)
+            return;
+        m_running = false;
+    }
+    m_wakeup.signal();
+
+    // from a callback, run() returns after it
+    if(!m_thread.isCurrentThread())
+        m_thread.exitWait();
+
+    std::vector<pvd::TimerCallbackPtr> stopped;
+    {
+        Guard G(m_mutex);
+        stopped.reserve(m_count);
+        for(size_t i=0; i<m_buckets.size(); i++) {
+            for(Entry *e = m_buckets[i], *next; e; e = next) {
+                next = e->hnext;
+                stopped.push_back(e->callback);
+                delete e;
+            }
+            m_buckets[i] = 0;
+        }
+        memset(m_slots, 0, sizeof(m_slots));
+        m_due = 0;
+        m_count = 0u;
+    }
+
+    for(size_t i=0; i<stopped.size(); i++)
+        stopped[i]->timerStopped();
+}
+
+void TimerWheel::scheduleAfterDelay(pvd::TimerCallbackPtr const & timerCallback, double delay)
+{
+    schedule(timerCallback, delay, 0.0);
+}
+
+void TimerWheel::schedulePeriodic(pvd::TimerCallbackPtr const & timerCallback, double delay, double period)
+{
+    schedule(timerCallback, delay, period);
+}
+
+void TimerWheel::schedule(pvd::TimerCallbackPtr const & timerCallback, double delay, double period)
+{
+    {
+        Guard G(m_mutex);
+        if(m_running) {
+            if(find(timerCallback.get()))
+                throw std::logic_error("already queued");
+
+            const double elapsed = epicsTime::getCurrent() - m_start;
+            if(m_count==0u) {
+                // nothing to move down from higher levels, so skip the ticks since the thread was last busy
+                pvd::uint64 cur = pvd::uint64(elapsed/m_tick);
+                if(m_current<cur)
+                    m_current = cur;
+            }
+
+            Entry *e = new Entry;
+            e->callback = timerCallback;
+            e->expire = pvd::uint64(ceil((elapsed + (delay>0.0 ? delay : 0.0))/m_tick));
+            if(e->expire<=m_current)
+                e->expire = m_current+1u;
+            e->period = period>0.0 ? pvd::uint64(ceil(period/m_tick)) : 0u;
+            if(period>0.0 && e->period==0u)
+                e->period = 1u;
+
+            insertHash(e);
+            place(e);
+
+            if(e->expire < m_wakeAt) {
+                UnGuard U(G);
+                m_wakeup.signal();
+            }
+            return;
+        }
+    }
+    timerCallback->timerStopped();
+}
+
+bool TimerWheel::cancel(pvd::TimerCallbackPtr const & timerCallback)
+{
+    Guard G(m_mutex);
+    Entry *e = find(timerCallback.get());
+    if(!e)
+        return false;
+    unlink(e);
+    eraseHash(e);
+    delete e;
+    return true;
+}
+
+bool TimerWheel::isScheduled(pvd::TimerCallbackPtr const & timerCallback) const
+{
+    Guard G(m_mutex);
+    return !!find(timerCallback.get());
+}
+
+size_t TimerWheel::size() const
+{
+    Guard G(m_mutex);
+    return m_count;
+}
+
+pvd::uint64 TimerWheel::now() const
+{
+    double elapsed = epicsTime::getCurrent() - m_start;
+    return elapsed>0.0 ? pvd::uint64(elapsed/m_tick) : 0u;
+}
+
+void TimerWheel::place(Entry *e)
+{
+    const pvd::uint64 delta = e->expire>m_current ? e->expire-m_current : 0u;
+    int level = 0;
+    while(level<LEVELS-1 && delta>=span(level+1))
+        level++;
+
+    // beyond the top level, and moved down again when its slot is reached
+    pvd::uint64 when = e->expire;
+    if(delta>=span(LEVELS))
+        when = m_current + span(LEVELS) - 1u;
+
+    e->level = level;
+    e->slot = int((when>>(SLOT_BITS*level)) & (SLOTS-1));
+
+    Entry *& head = m_slots[level][e->slot];
+    e->prev = 0;
+    e->next = head;
+    if(head)
+        head->prev = e;
+    head = e;
+}
+
+void TimerWheel::unlink(Entry *e)
+{
+    Entry *& head = e->level<0 ? m_due : m_slots[e->level][e->slot];
+    if(e->prev)
+        e->prev->next = e->next;
+    else
+        head = e->next;
+    if(e->next)
+        e->next->prev = e->prev;
+    e->prev = e->next = 0;
+}
+
+void TimerWheel::advance()
+{
+    const pvd::uint64 tick = ++m_current;
+
+    // highest level whose slot is reached
+    int top = 0;
+    while(top<LEVELS-1 && (tick & (span(top+1)-1u))==0u)
+        top++;
+
+    // higher first, as they may move to the slot of a lower level reached in this tick
+    for(int level=top; level>0; level--) {
+        Entry *e = m_slots[level][(tick>>(SLOT_BITS*level)) & (SLOTS-1)];
+        m_slots[level][(tick>>(SLOT_BITS*level)) & (SLOTS-1)] = 0;
+        for(Entry *next; e; e = next) {
+            next = e->next;
+            place(e);
+        }
+    }
+
+    Entry *due = m_slots[0][tick & (SLOTS-1)];
+    m_slots[0][tick & (SLOTS-1)] = 0;
+    for(Entry *e = due; e; e = e->next)
+        e->level = -1;
+
+    // after any left from an earlier tick
+    if(!m_due) {
+        m_due = due;
+    } else if(due) {
+        Entry *last = m_due;
+        while(last->next)
+            last = last->next;
+        last->next = due;
+        due->prev = last;
+    }
+}
+
+pvd::uint64 TimerWheel::nextWake() const
+{
+    if(m_due)
+        return m_current;
+    if(m_count==0u)
+        return NEVER;
+
+    // in the slots of level 0 until the next move down from level 1
+    const pvd::uint64 end = (m_current | (SLOTS-1)) + 1u;
+    for(pvd::uint64 tick = m_current+1u; tick<end; tick++) {
+        if(m_slots[0][tick & (SLOTS-1)])
+            return tick;
+    }
+    return end;
+}
+
+TimerWheel::Entry* TimerWheel::find(pvd::TimerCallback *cb) const
+{
+    for(Entry *e = m_buckets[hashOf(cb) & (m_buckets.size()-1u)]; e; e = e->hnext) {
+        if(e->callback.get()==cb)
+            return e;
+    }
+    return 0;
+}
+
+void TimerWheel::insertHash(Entry *e)
+{
+    if(m_count>=m_buckets.size()) {
+        std::vector<Entry*> old(m_buckets.size()*2u, (Entry*)0);
+        old.swap(m_buckets);
+        for(size_t i=0; i<old.size(); i++) {
+            for(Entry *o = old[i], *next; o; o = next) {
+                next = o->hnext;
+                Entry *& head = m_buckets[hashOf(o->callback.get()) & (m_buckets.size()-1u)];
+                o->hnext = head;
+                head = o;
+            }
+        }
+    }
+
+    Entry *& head = m_buckets[hashOf(e->callback.get()) & (m_buckets.size()-1u)];
+    e->hnext = head;
+    head = e;
+    m_count++;
+}
+
+void TimerWheel::eraseHash(Entry *e)
+{
+    Entry **pp = &m_buckets[hashOf(e->callback.get()) & (m_buckets.size()-1u)];
+    while(*pp!=e)
+        pp = &(*pp)->hnext;
+    *pp = e->hnext;
+    m_count--;
+}
+
+void TimerWheel::run()
+{
+    Guard G(m_mutex);
+
+    while(m_running) {
+        // no signal from schedule() while awake
+        m_wakeAt = 0u;
+
+        const pvd::uint64 target = now();
+        while(m_running && (m_due || m_current<target)) {
+            if(!m_due) {
+                advance();
+                continue;
+            }
+
+            Entry *e = m_due;
+            unlink(e);
+            pvd::TimerCallbackPtr cb(e->callback);
+
+            if(e->period) {
+                // rescheduled before running, so that it can cancel() itself
+                e->expire += e->period;
+                if(e->expire<=m_current)
+                    e->expire = m_current+1u; // skip those missed
+                place(e);
+            } else {
+                eraseHash(e);
+                delete e;
+            }
+
+            UnGuard U(G);
+            try {
+                cb->callback();
+            } catch(std::exception& ex) {
+                LOG(logLevelError, "Unhandled exception from timer callback: %s", ex.what());
+            }
+            cb.reset();
+        }
+
+        if(!m_running)
+            break;
+
+        m_wakeAt = nextWake();
+        if(m_wakeAt==NEVER) {
+            UnGuard U(G);
+            m_wakeup.wait();
+        } else if(m_wakeAt>m_current) {
+            double delay = double(m_wakeAt)*m_tick - (epicsTime::getCurrent() - m_start);
+            UnGuard U(G);
+            if(delay>0.0)
+                m_wakeup.wait(delay);
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,396 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <sstream>
+#include <stdexcept>
+#include <map>
+
+#include <string.h>
+#include <stdio.h>
+
+#include <epicsGuard.h>
+#include <epicsThread.h>
+#include <epicsStdio.h>
+
+#define epicsExportSharedSymbols
+#include <pv/tracing.h>
+#include <pv/configuration.h>
+#include <pv/logger.h>
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace pvd = epics::pvData;
+
+namespace epics {
+namespace pvAccess {
+
+namespace {
+
+struct Tracing {
+    epicsMutex mutex;
+    // copied by recordAll(), so replaced rather than modified
+    std::tr1::shared_ptr<const std::vector<TraceSink::shared_pointer> > sinks;
+    // sinks added by configure(), by file name
+    std::map<std::string, TraceSink::shared_pointer> files;
+    // for random IDs
+    epicsUInt64 state;
+    epicsThreadPrivateId current;
+
+    Tracing()
+        :sinks(new std::vector<TraceSink::shared_pointer>())
+        ,current(epicsThreadPrivateCreate())
+    {
+        epicsTimeStamp now;
+        epicsTimeGetCurrent(&now);
+        state = (epicsUInt64(now.secPastEpoch)<<32) ^ now.nsec
+              ^ (epicsUInt64(size_t(this))<<16);
+    }
+};
+
+epicsThreadOnceId tracingOnce = EPICS_THREAD_ONCE_INIT;
+Tracing *tracing;
+
+void tracingInit(void*)
+{
+    tracing = new Tracing;
+}
+
+Tracing& getTracing()
+{
+    epicsThreadOnce(&tracingOnce, &tracingInit, 0);
+    return *tracing;
+}
+
+inline epicsUInt64 u64(epicsUInt32 hi, epicsUInt32 lo)
+{
+    return (epicsUInt64(hi)<<32) | lo;
+}
+
+// splitmix64
+epicsUInt64 nextRandom()
+{
+    Tracing& T = getTracing();
+    epicsUInt64 z;
+    {
+        Guard G(T.mutex);
+        z = (T.state += u64(0x9e3779b9u, 0x7f4a7c15u));
+    }
+    z = (z ^ (z >> 30)) * u64(0xbf58476du, 0x1ce4e5b9u);
+    z = (z ^ (z >> 27)) * u64(0x94d049bbu, 0x133111ebu);
+    return z ^ (z >> 31);
+}
+
+void fillRandom(pvd::uint8 *bytes, size_t n)
+{
+    for(size_t i=0; i<n; i+=8) {
+        epicsUInt64 r = nextRandom();
+        for(size_t j=i; j<n && j<i+8; j++, r>>=8)
+            bytes[j] = pvd::uint8(r);
+    }
+}
+
+bool allZero(const pvd::uint8 *bytes, size_t n)
+{
+    for(size_t i=0; i<n; i++) {
+        if(bytes[i])
+            return false;
+    }
+    return true;
+}
+
+void toHex(std::string& out, const pvd::uint8 *bytes, size_t n)
+{
+    static const char digits[] = "0123456789abcdef";
+    for(size_t i=0; i<n; i++) {
+        out += digits[bytes[i]>>4];
+        out += digits[bytes[i]&0xf];
+    }
+}
+
+bool fromHex(const std::string& in, size_t pos, pvd::uint8 *bytes, size_t n)
+{
+    if(in.size() < pos+2*n)
+        return false;
+    for(size_t i=0; i<2*n; i++) {
+        const char c = in[pos+i];
+        unsigned v;
+        if(c>='0' && c<='9') v = c-'0';
+        else if(c>='a' && c<='f') v = c-'a'+10;
+        else return false; // W3C requires lower case
+        if(i&1)
+            bytes[i/2] |= pvd::uint8(v);
+        else
+            bytes[i/2] = pvd::uint8(v<<4);
+    }
+    return true;
+}
+
+std::string hexString(const pvd::uint8 *bytes, size_t n)
+{
+    std::string ret;
+    toHex(ret, bytes, n);
+    return ret;
+}
+
+std::string unixNanos(const epicsTimeStamp& ts)
+{
+    char buf[32];
+    epicsSnprintf(buf, sizeof(buf), "%llu%09u",
+                  (unsigned long long)(ts.secPastEpoch + POSIX_TIME_AT_EPICS_EPOCH), unsigned(ts.nsec));
+    return buf;
+}
+
+void jsonString(std::ostream& strm, const std::string& value)
+{
+    strm<<'"';
+    for(size_t i=0; i<value.size(); i++) {
+        const char c = value[i];
+        switch(c) {
+        case '"': strm<<"\\\""; break;
+        case '\\': strm<<"\\\\"; break;
+        case '\n': strm<<"\\n"; break;
+        default:
+            if((unsigned char)c < 0x20) {
+                char buf[8];
+                epicsSnprintf(buf, sizeof(buf), "\\u%04x", unsigned(c));
+                strm<<buf;
+            } else {
+                strm<<c;
+            }
+        }
+    }
+    strm<<'"';
+}
+
+void jsonAttribute(std::ostream& strm, const char *key, const std::string& value)
+{
+    strm<<"{\"key\":\""<<key<<"\",\"value\":{\"stringValue\":";
+    jsonString(strm, value);
+    strm<<"}}";
+}
+
+} // namespace
+
+TraceContext::TraceContext()
+    :flags(0u)
+{
+    memset(traceId, 0, sizeof(traceId));
+    memset(spanId, 0, sizeof(spanId));
+}
+
+bool TraceContext::valid() const
+{
+    return !allZero(traceId, sizeof(traceId)) && !allZero(spanId, sizeof(spanId));
+}
+
+TraceContext TraceContext::root()
+{
+    TraceContext ret;
+    fillRandom(ret.traceId, sizeof(ret.traceId));
+    fillRandom(ret.spanId, sizeof(ret.spanId));
+    ret.flags = 1u;
+    return ret;
+}
+
+TraceContext TraceContext::child() const
+{
+    TraceContext ret(*this);
+    fillRandom(ret.spanId, sizeof(ret.spanId));
+    return ret;
+}
+
+std::string TraceContext::toString() const
+{
+    std::string ret("00-");
+    toHex(ret, traceId, sizeof(traceId));
+    ret += '-';
+    toHex(ret, spanId, sizeof(spanId));
+    ret += '-';
+    toHex(ret, &flags, 1u);
+    return ret;
+}
+
+bool TraceContext::parse(const std::string& traceparent, TraceContext& ctx)
+{
+    // 00-<32 hex>-<16 hex>-<2 hex>
+    TraceContext ret;
+    if(traceparent.size()!=55u || traceparent.compare(0, 3, "00-")!=0
+            || traceparent[35]!='-' || traceparent[52]!='-'
+            || !fromHex(traceparent, 3, ret.traceId, sizeof(ret.traceId))
+            || !fromHex(traceparent, 36, ret.spanId, sizeof(ret.spanId))
+            || !fromHex(traceparent, 53, &ret.flags, 1u)
+            || !ret.valid())
+        return false;
+    ctx = ret;
+    return true;
+}
+
+void TraceContext::serialize(pvd::ByteBuffer* buffer) const
+{
+    buffer->put((const char*)traceId, 0, sizeof(traceId));
+    buffer->put((const char*)spanId, 0, sizeof(spanId));
+    buffer->putByte(pvd::int8(flags));
+}
+
+void TraceContext::deserialize(pvd::ByteBuffer* buffer)
+{
+    buffer->get((char*)traceId, 0, sizeof(traceId));
+    buffer->get((char*)spanId, 0, sizeof(spanId));
+    flags = pvd::uint8(buffer->getByte());
+}
+
+TraceScope::TraceScope(const TraceContext *ctx)
+    :prev(0)
+    ,active(ctx!=0)
+{
+    if(!active)
+        return;
+    Tracing& T = getTracing();
+    prev = static_cast<const TraceContext*>(epicsThreadPrivateGet(T.current));
+    epicsThreadPrivateSet(T.current, const_cast<TraceContext*>(ctx));
+}
+
+TraceScope::~TraceScope()
+{
+    if(active)
+        epicsThreadPrivateSet(getTracing().current, const_cast<TraceContext*>(prev));
+}
+
+const TraceContext* TraceScope::current()
+{
+    return static_cast<const TraceContext*>(epicsThreadPrivateGet(getTracing().current));
+}
+
+Span::Span()
+    :server(false)
+{
+    memset(parentId, 0, sizeof(parentId));
+    memset(&start, 0, sizeof(start));
+    dispatch = end = start;
+}
+
+bool Span::hasParent() const
+{
+    return !allZero(parentId, sizeof(parentId));
+}
+
+void TraceSink::add(const shared_pointer& sink)
+{
+    Tracing& T = getTracing();
+    Guard G(T.mutex);
+    std::tr1::shared_ptr<std::vector<shared_pointer> > sinks(new std::vector<shared_pointer>(*T.sinks));
+    sinks->push_back(sink);
+    T.sinks = sinks;
+}
+
+void TraceSink::remove(const shared_pointer& sink)
+{
+    Tracing& T = getTracing();
+    Guard G(T.mutex);
+    std::tr1::shared_ptr<std::vector<shared_pointer> > sinks(new std::vector<shared_pointer>(*T.sinks));
+    for(size_t i=0; i<sinks->size(); i++) {
+        if((*sinks)[i]==sink) {
+            sinks->erase(sinks->begin()+i);
+            break;
+        }
+    }
+    T.sinks = sinks;
+}
+
+void TraceSink::recordAll(const Span& span)
+{
+    Tracing& T = getTracing();
+    std::tr1::shared_ptr<const std::vector<shared_pointer> > sinks;
+    {
+        Guard G(T.mutex);
+        sinks = T.sinks;
+    }
+    for(size_t i=0; i<sinks->size(); i++) {
+        try {
+            (*sinks)[i]->record(span);
+        } catch(std::exception& e) {
+            LOG(logLevelError, "Unhandled exception from TraceSink::record(): %s", e.what());
+        }
+    }
+}
+
+bool TraceSink::configure(const Configuration& config)
+{
+    const std::string fname(config.getPropertyAsString("EPICS_PVA_TRACE_FILE", ""));
+    const bool enable = config.getPropertyAsBoolean("EPICS_PVA_TRACE", !fname.empty());
+    if(!enable || fname.empty())
+        return enable;
+
+    Tracing& T = getTracing();
+    {
+        Guard G(T.mutex);
+        if(T.files.find(fname)!=T.files.end())
+            return true;
+    }
+    try {
+        TraceSink::shared_pointer sink(new TraceFileSink(fname));
+        {
+            Guard G(T.mutex);
+            if(T.files.find(fname)!=T.files.end())
+                return true; // lost a race
+            T.files[fname] = sink;
+        }
+        add(sink);
+    } catch(std::exception& e) {
+        LOG(logLevelError, "EPICS_PVA_TRACE_FILE: %s", e.what());
+    }
+    return true;
+}
+
+TraceFileSink::TraceFileSink(const std::string& fname, const std::string& service)
+    :fp(fopen(fname.c_str(), "a"))
+    ,service(service)
+{
+    if(!fp)
+        throw std::runtime_error("Unable to open trace file '"+fname+"'");
+}
+
+TraceFileSink::~TraceFileSink()
+{
+    fclose(fp);
+}
+
+void TraceFileSink::record(const Span& span)
+{
+    std::ostringstream strm;
+    format(strm, span, service);
+    strm<<'\n';
+    const std::string line(strm.str());
+
+    Guard G(mutex);
+    fwrite(line.c_str(), 1, line.size(), fp);
+    fflush(fp);
+}
+
+void TraceFileSink::format(std::ostream& strm, const Span& span, const std::string& service)
+{
+    strm<<"{\"resourceSpans\":[{\"resource\":{\"attributes\":[";
+    jsonAttribute(strm, "service.name", service);
+    strm<<"]},\"scopeSpans\":[{\"scope\":{\"name\":\"pvAccessCPP\"},\"spans\":[{"
+          "\"traceId\":\""<<hexString(span.context.traceId, sizeof(span.context.traceId))<<"\","
+          "\"spanId\":\""<<hexString(span.context.spanId, sizeof(span.context.spanId))<<"\",";
+    if(span.hasParent())
+        strm<<"\"parentSpanId\":\""<<hexString(span.parentId, sizeof(span.parentId))<<"\",";
+    strm<<"\"name\":";
+    jsonString(strm, span.name);
+    // SPAN_KIND_SERVER or SPAN_KIND_CLIENT
+    strm<<",\"kind\":"<<(span.server ? 2 : 3)
+        <<",\"startTimeUnixNano\":\""<<unixNanos(span.start)<<"\""
+          ",\"endTimeUnixNano\":\""<<unixNanos(span.end)<<"\""
+          ",\"attributes\":[";
+    jsonAttribute(strm, "pva.channel", span.channel);
+    strm<<',';
+    jsonAttribute(strm, "net.peer.name", span.peer);
+    strm<<"],\"events\":[{\"timeUnixNano\":\""<<unixNanos(span.dispatch)<<"\",\"name\":\""
+        <<(span.server ? "dispatch" : "sent")<<"\"}]}]}]}]}";
+}
+
+}} // namespace epics::pvAccess
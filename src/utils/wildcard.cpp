@@ -4,6 +4,8 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <algorithm>
+
 #include <epicsString.h>
 
 #define epicsExportSharedSymbols
@@ -16,3 +18,125 @@ Wildcard::wildcardfit (const char *wildcard, const char *test)
 {
     return epicsStrGlobMatch(test, wildcard);
 }
+
+const size_t WildcardSet::none = size_t(-1);
+
+WildcardSet::WildcardSet()
+    :m_nodes(1u)
+{}
+
+void WildcardSet::add(const std::string& pattern)
+{
+    if(std::find(m_patterns.begin(), m_patterns.end(), pattern)!=m_patterns.end())
+        return;
+    m_patterns.push_back(pattern);
+    compile(m_patterns.size()-1u);
+}
+
+bool WildcardSet::remove(const std::string& pattern)
+{
+    std::vector<std::string>::iterator it(std::find(m_patterns.begin(), m_patterns.end(), pattern));
+    if(it==m_patterns.end())
+        return false;
+    m_patterns.erase(it);
+
+    // indices of the later patterns change, so start over
+    m_nodes.clear();
+    m_nodes.resize(1u);
+    for(size_t i=0; i<m_patterns.size(); i++)
+        compile(i);
+    return true;
+}
+
+void WildcardSet::clear()
+{
+    m_patterns.clear();
+    m_nodes.clear();
+    m_nodes.resize(1u);
+}
+
+void WildcardSet::compile(size_t index)
+{
+    const std::string& pattern = m_patterns[index];
+    size_t cur = 0u;
+
+    for(size_t i=0; i<pattern.size(); i++) {
+        const char c = pattern[i];
+        size_t next;
+
+        if(c=='*') {
+            if(m_nodes[cur].isStar)
+                continue; // "**" is "*"
+            next = m_nodes[cur].star;
+        } else if(c=='?') {
+            next = m_nodes[cur].any;
+        } else {
+            std::map<char, size_t>::const_iterator it(m_nodes[cur].next.find(c));
+            next = it==m_nodes[cur].next.end() ? none : it->second;
+        }
+
+        if(next==none) {
+            next = m_nodes.size();
+            m_nodes.push_back(Node());
+            // m_nodes may have moved
+            if(c=='*') {
+                m_nodes[next].isStar = true;
+                m_nodes[cur].star = next;
+            } else if(c=='?') {
+                m_nodes[cur].any = next;
+            } else {
+                m_nodes[cur].next[c] = next;
+            }
+        }
+        cur = next;
+    }
+
+    if(m_nodes[cur].pattern==none)
+        m_nodes[cur].pattern = index;
+}
+
+// add node, and the nodes reached from it by a '*' matching nothing
+void WildcardSet::closure(size_t node, std::vector<size_t>& states) const
+{
+    while(node!=none) {
+        if(std::find(states.begin(), states.end(), node)!=states.end())
+            return;
+        states.push_back(node);
+        node = m_nodes[node].star;
+    }
+}
+
+bool WildcardSet::match(const std::string& test, std::string* pattern) const
+{
+    if(m_patterns.empty())
+        return false;
+
+    std::vector<size_t> cur, next;
+    closure(0u, cur);
+
+    for(size_t i=0; i<test.size() && !cur.empty(); i++) {
+        const char c = test[i];
+        next.clear();
+        for(size_t s=0; s<cur.size(); s++) {
+            const Node& N = m_nodes[cur[s]];
+            if(N.isStar)
+                closure(cur[s], next);
+            std::map<char, size_t>::const_iterator it(N.next.find(c));
+            if(it!=N.next.end())
+                closure(it->second, next);
+            if(N.any!=none)
+                closure(N.any, next);
+        }
+        cur.swap(next);
+    }
+
+    size_t best = none;
+    for(size_t s=0; s<cur.size(); s++)
+        best = std::min(best, m_nodes[cur[s]].pattern);
+
+    if(best==none)
+        return false;
+    if(pattern)
+        *pattern = m_patterns[best];
+    return true;
+}
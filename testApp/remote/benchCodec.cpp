@@ -0,0 +1,273 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/* Framing cost of AbstractCodec, without sockets.  The TestCodec of testCodec,
+ * with reads and writes which copy with memcpy() instead of byte by byte.
+ *
+ * Receive: a buffer of pre-built messages is processRead() repeatedly.
+ *   header     control messages, header only
+ *   normal     application messages of a payload size, each read through ensureData()
+ *   segmented  one application message of 1MB, in segments of a size
+ *   aligned    application messages of a byte and doubles, read with alignData(8)
+ * Send: processSendQueue() of queued TransportSenders, each writing one message.
+ */
+
+#include <vector>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dbDefs.h>
+#include <epicsTime.h>
+#include <epicsEndian.h>
+
+#include <pv/byteBuffer.h>
+#include <pv/codec.h>
+
+#include "testCodec.h"
+
+using namespace epics::pvAccess;
+
+namespace {
+
+double now()
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + ts.nsec*1e-9;
+}
+
+const int8_t byteOrderFlag = EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG ? 0x80 : 0x00;
+
+// The input of a receive benchmark, as on the wire
+struct Wire
+{
+    std::vector<char> bytes;
+    size_t messages;   // application and control
+    size_t payload;    // bytes to read from each application message, over all its segments
+
+    Wire() :messages(0u), payload(0u) {}
+
+    void header(int8_t flags, int8_t command, int32_t size)
+    {
+        char hdr[PVA_MESSAGE_HEADER_SIZE];
+        hdr[0] = PVA_MAGIC;
+        hdr[1] = PVA_VERSION;
+        hdr[2] = flags | byteOrderFlag;
+        hdr[3] = command;
+        // host byte order, as flagged
+        memcpy(&hdr[4], &size, 4);
+        bytes.insert(bytes.end(), hdr, hdr+sizeof(hdr));
+    }
+
+    void body(size_t size, char fill=0)
+    {
+        bytes.resize(bytes.size()+size, fill);
+    }
+};
+
+class BenchCodec : public TestCodec
+{
+public:
+    enum Mode { Consume, Aligned } mode;
+    size_t appMessages, controlMessages, sent;
+    const Wire *wire;
+    size_t wirePos;
+    double sum;
+
+    explicit BenchCodec(size_t bufferSize)
+        :TestCodec(bufferSize, bufferSize)
+        ,mode(Consume)
+        ,appMessages(0u)
+        ,controlMessages(0u)
+        ,sent(0u)
+        ,wire(0)
+        ,wirePos(0u)
+        ,sum(0.0)
+    {}
+    virtual ~BenchCodec() {}
+
+    void rewind()
+    {
+        wirePos = 0u;
+    }
+
+    bool drained() const
+    {
+        return wirePos==wire->bytes.size() && _socketBuffer.getRemaining()==0u;
+    }
+
+    virtual int read(ByteBuffer *buffer) OVERRIDE FINAL
+    {
+        size_t n = std::min(buffer->getRemaining(), wire->bytes.size()-wirePos);
+        buffer->put(&wire->bytes[0], wirePos, n);
+        wirePos += n;
+        return int(n);
+    }
+
+    virtual int write(ByteBuffer *buffer) OVERRIDE FINAL
+    {
+        size_t n = buffer->getRemaining();
+        buffer->setPosition(buffer->getLimit());
+        sent += n;
+        return int(n);
+    }
+
+    virtual void processControlMessage() OVERRIDE FINAL
+    {
+        controlMessages++;
+    }
+
+    virtual void processApplicationMessage() OVERRIDE FINAL
+    {
+        appMessages++;
+        if(mode==Consume) {
+            size_t toRead = wire->payload;
+            while(toRead) {
+                ensureData(std::min(toRead, MAX_ENSURE_DATA_SIZE));
+                size_t n = std::min(toRead, _socketBuffer.getRemaining());
+                _socketBuffer.setPosition(_socketBuffer.getPosition()+n);
+                toRead -= n;
+            }
+        } else {
+            ensureData(1u);
+            sum += _socketBuffer.getByte();
+            alignData(8u);
+            for(size_t n = (wire->payload-8u)/8u; n; n--) {
+                ensureData(8u);
+                sum += _socketBuffer.getDouble();
+            }
+        }
+    }
+};
+
+struct BenchSender : public TransportSender
+{
+    const std::vector<char>& payload;
+    explicit BenchSender(const std::vector<char>& payload) :payload(payload) {}
+    virtual ~BenchSender() {}
+    virtual void send(ByteBuffer *buffer, TransportSendControl *control) OVERRIDE FINAL
+    {
+        control->startMessage((int8_t)0x0A, 0u);
+        for(size_t pos=0u; pos<payload.size(); ) {
+            size_t n = std::min(payload.size()-pos, size_t(1024u));
+            control->ensureBuffer(n);
+            buffer->put(&payload[0], pos, n);
+            pos += n;
+        }
+    }
+};
+
+void report(const char *name, size_t param, size_t messages, size_t bytes, double elapsed)
+{
+    printf("%-10s %8u %10.1f ns/message %8.3f GB/s\n", name, (unsigned)param,
+           elapsed*1e9/messages, bytes/elapsed/1e9);
+}
+
+// processRead() of wire repeatedly, until at least total bytes are read
+void benchReceive(const char *name, size_t param, const Wire& wire, BenchCodec::Mode mode,
+                  size_t bufferSize, size_t total)
+{
+    BenchCodec codec(bufferSize);
+    codec.mode = mode;
+    codec.wire = &wire;
+
+    const size_t reps = std::max(size_t(1u), total/wire.bytes.size());
+    const double start = now();
+    for(size_t r=0; r<reps; r++) {
+        codec.rewind();
+        while(!codec.drained() && codec.isOpen())
+            codec.processRead();
+    }
+    const double elapsed = now() - start;
+
+    if(!codec.isOpen() || codec._invalidDataStreamCount)
+        printf("%-10s %8u FAILED, invalid stream\n", name, (unsigned)param);
+    else
+        report(name, param, reps*wire.messages, reps*wire.bytes.size(), elapsed);
+}
+
+void benchSend(size_t payloadSize, size_t bufferSize, size_t total)
+{
+    BenchCodec codec(bufferSize);
+    std::vector<char> payload(payloadSize, 'x');
+    TransportSender::shared_pointer sender(new BenchSender(payload));
+
+    const size_t batch = 1000u;
+    const size_t reps = std::max(size_t(1u), total/((payloadSize+PVA_MESSAGE_HEADER_SIZE)*batch));
+    const double start = now();
+    for(size_t r=0; r<reps; r++) {
+        for(size_t i=0; i<batch; i++)
+            codec.enqueueSendRequest(sender);
+        while(!codec.sendQueueEmpty())
+            codec.processSendQueue();
+    }
+    const double elapsed = now() - start;
+
+    report("send", payloadSize, reps*batch, codec.sent, elapsed);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // bytes processed by each benchmark
+    const size_t total = size_t(argc>1 ? atof(argv[1]) : 256.0)<<20u;
+    const size_t bufferSize = argc>2 ? (size_t)atoi(argv[2]) : 16384u;
+
+    printf("%u MB each, %u byte buffers\n", unsigned(total>>20u), unsigned(bufferSize));
+    printf("%-10s %8s\n", "", "bytes");
+
+    {
+        Wire wire;
+        for(size_t i=0; i<4096u; i++, wire.messages++)
+            wire.header(0x01, 0x03, int32_t(i));
+        benchReceive("header", 0u, wire, BenchCodec::Consume, bufferSize, total);
+    }
+
+    const size_t sizes[] = {0u, 64u, 1024u, 16384u, 1u<<20u};
+    for(size_t s=0; s<NELEMENTS(sizes); s++) {
+        Wire wire;
+        wire.payload = sizes[s];
+        for(; wire.bytes.size()<(4u<<20u); wire.messages++) {
+            wire.header(0x00, 0x0A, int32_t(sizes[s]));
+            wire.body(sizes[s]);
+        }
+        benchReceive("normal", sizes[s], wire, BenchCodec::Consume, bufferSize, total);
+    }
+
+    const size_t segments[] = {1024u, 8192u, 65536u};
+    for(size_t s=0; s<NELEMENTS(segments); s++) {
+        Wire wire;
+        const size_t message = 1u<<20u;
+        wire.payload = message;
+        for(size_t m=0; m<4u; m++, wire.messages++) {
+            for(size_t pos=0u; pos<message; pos+=segments[s]) {
+                const bool first = pos==0u, last = pos+segments[s]>=message;
+                wire.header(first ? 0x10 : last ? 0x20 : 0x30, 0x0A, int32_t(segments[s]));
+                wire.body(segments[s]);
+            }
+        }
+        benchReceive("segmented", segments[s], wire, BenchCodec::Consume, bufferSize, total);
+    }
+
+    {
+        Wire wire;
+        // a byte, padding to 8, then doubles
+        wire.payload = 1024u;
+        for(; wire.bytes.size()<(4u<<20u); wire.messages++) {
+            wire.header(0x00, 0x0A, int32_t(wire.payload));
+            wire.body(wire.payload);
+        }
+        benchReceive("aligned", wire.payload, wire, BenchCodec::Aligned, bufferSize, total);
+    }
+
+    for(size_t s=0; s<NELEMENTS(sizes)-1u; s++)
+        benchSend(sizes[s], bufferSize, total);
+
+    return 0;
+}
@@ -0,0 +1,699 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/* Benchmarks of get, put, monitor, rpc and connect, through a SharedPV served
+ * in the same process, either called directly (inproc) or through a ServerContext
+ * on loopback.  Each combination of the parameter lists given is run, and its
+ * result printed as one line of JSON, for comparison with scripts/benchcompare.py
+ *
+ * Global operator new is replaced to count the heap allocations of each run,
+ * in all threads of the process, client and server together.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <new>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <epicsStdio.h>
+#include <epicsStdlib.h>
+#include <epicsGetopt.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsGuard.h>
+#include <epicsTime.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define BENCH_USE_ATOMIC
+#endif
+#endif
+
+#include <pv/pvData.h>
+#include <pv/createRequest.h>
+#include <pv/logger.h>
+#include <pv/pvaVersion.h>
+#include <pv/serverContext.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+size_t num_allocs;
+
+void* countedAlloc(size_t size)
+{
+#ifdef BENCH_USE_ATOMIC
+    epics::atomic::increment(num_allocs);
+#else
+    // approximate.  No mutex, as operator new is called before static constructors run
+    num_allocs++;
+#endif
+    void *ret = malloc(size ? size : 1u);
+    if(!ret)
+        throw std::bad_alloc();
+    return ret;
+}
+} // namespace
+
+#if __cplusplus>=201103L
+#  define NEW_THROWS
+#  define DELETE_THROWS noexcept
+#else
+#  define NEW_THROWS throw(std::bad_alloc)
+#  define DELETE_THROWS throw()
+#endif
+
+void* operator new(size_t size) NEW_THROWS { return countedAlloc(size); }
+void* operator new[](size_t size) NEW_THROWS { return countedAlloc(size); }
+void operator delete(void* ptr) DELETE_THROWS { free(ptr); }
+void operator delete[](void* ptr) DELETE_THROWS { free(ptr); }
+
+namespace {
+
+typedef epicsGuard<epicsMutex> Guard;
+
+#define DEFAULT_BENCHES "get,put,monitor,rpc,connect"
+#define DEFAULT_CHANNELS "1,10"
+#define DEFAULT_ELEMENTS "1,1000,100000"
+#define DEFAULT_QUEUES "4"
+#define DEFAULT_TRANSPORTS "inproc,loopback"
+#define DEFAULT_ITERATIONS 1000u
+#define TIMEOUT 30.0
+
+void usage()
+{
+    fprintf(stderr, "\nUsage: benchPVA [options]\n\n"
+            "Run each combination of the lists given, and print one line of JSON per result.\n"
+            "\noptions:\n"
+            "  -h: Help: Print this message\n"
+            "  -b <list>:  Benchmarks, of get,put,monitor,rpc,connect.  Default '%s'\n"
+            "  -c <list>:  Numbers of channels.  Default '%s'\n"
+            "  -e <list>:  Numbers of array elements (double).  Default '%s'\n"
+            "  -q <list>:  Monitor queue sizes, 0 for the default without pipeline.  Default '%s'\n"
+            "  -t <list>:  Transports, of inproc,loopback.  Default '%s'\n"
+            "  -n <count>: Iterations of each.  Default %u.  connect runs 1 per 100\n"
+            "  -o <file>:  Append results to <file> instead of stdout\n"
+            "\nexample: benchPVA -b get,monitor -c 1,100 -e 1 -o results.json\n\n",
+            DEFAULT_BENCHES, DEFAULT_CHANNELS, DEFAULT_ELEMENTS, DEFAULT_QUEUES,
+            DEFAULT_TRANSPORTS, DEFAULT_ITERATIONS);
+}
+
+std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> ret;
+    std::istringstream strm(list);
+    std::string item;
+    while(std::getline(strm, item, ','))
+        if(!item.empty())
+            ret.push_back(item);
+    return ret;
+}
+
+bool parseList(const char *list, std::vector<epicsUInt32>& out)
+{
+    std::vector<std::string> items(splitList(list));
+    out.clear();
+    for(size_t i=0; i<items.size(); i++) {
+        epicsUInt32 val;
+        if(epicsParseUInt32(items[i].c_str(), &val, 0, NULL))
+            return false;
+        out.push_back(val);
+    }
+    return !out.empty();
+}
+
+pva::Configuration::shared_pointer loopback()
+{
+    return pva::ConfigurationBuilder()
+            .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+            .add("EPICS_PVA_SERVER_PORT", "0")
+            .add("EPICS_PVA_BROADCAST_PORT", "0")
+            .push_map()
+            .build();
+}
+
+// puts are stored and posted, rpc returns its argument
+struct Echo : public pvas::SharedPV::Handler
+{
+    virtual ~Echo() {}
+    virtual void onPut(const pvas::SharedPV::shared_pointer& pv, pvas::Operation& op)
+    {
+        pv->post(op.value(), op.changed());
+        op.complete();
+    }
+    virtual void onRPC(const pvas::SharedPV::shared_pointer& pv, pvas::Operation& op)
+    {
+        op.complete(op.value(), op.changed());
+    }
+};
+
+// Counts completions of a round of operations, one per channel
+struct Completion
+{
+    epicsMutex lock;
+    epicsEvent done;
+    size_t pending, errors;
+    std::string firstError;
+
+    Completion() :pending(0u), errors(0u) {}
+
+    void reset(size_t n)
+    {
+        Guard G(lock);
+        pending = n;
+    }
+    void complete(bool ok, const std::string& msg)
+    {
+        bool last;
+        {
+            Guard G(lock);
+            if(!ok && !errors++)
+                firstError = msg;
+            last = pending && --pending==0u;
+        }
+        if(last)
+            done.signal();
+    }
+    void wait()
+    {
+        {
+            Guard G(lock);
+            if(pending==0u)
+                return;
+        }
+        if(!done.wait(TIMEOUT))
+            throw std::runtime_error("Timeout");
+        Guard G(lock);
+        if(errors)
+            throw std::runtime_error(firstError);
+    }
+};
+
+// one server, and a client of it, for a number of channels of a type
+struct Fixture
+{
+    const std::string transport;
+    pvd::StructureConstPtr type;
+    pvd::PVStructurePtr value;
+    pvd::shared_vector<const double> array;
+    pvd::BitSet changed;
+
+    pvas::StaticProvider provider;
+    std::vector<std::string> names;
+    std::vector<pvas::SharedPV::shared_pointer> pvs;
+    pva::ServerContext::shared_pointer server;
+
+    Fixture(const std::string& transport, size_t nchannels, size_t nelements)
+        :transport(transport)
+        ,provider("bench")
+    {
+        type = pvd::getFieldCreate()->createFieldBuilder()
+                ->addArray("value", pvd::pvDouble)
+                ->add("seq", pvd::pvUInt)
+                ->createStructure();
+        value = pvd::getPVDataCreate()->createPVStructure(type);
+
+        pvd::shared_vector<double> temp(nelements);
+        for(size_t i=0; i<nelements; i++)
+            temp[i] = double(i);
+        array = pvd::freeze(temp);
+        value->getSubFieldT<pvd::PVDoubleArray>("value")->replace(array);
+        changed.set(value->getSubFieldT("value")->getFieldOffset())
+               .set(value->getSubFieldT("seq")->getFieldOffset());
+
+        pvas::SharedPV::Handler::shared_pointer handler(new Echo);
+        for(size_t i=0; i<nchannels; i++) {
+            std::ostringstream name;
+            name<<"bench:"<<i;
+            names.push_back(name.str());
+            pvs.push_back(pvas::SharedPV::build(handler));
+            pvs.back()->open(*value);
+            provider.add(names.back(), pvs.back());
+        }
+
+        if(transport=="loopback")
+            server = pva::ServerContext::create(pva::ServerContext::Config()
+                                                .config(loopback())
+                                                .provider(provider.provider()));
+        else if(transport!="inproc")
+            throw std::runtime_error("Unknown transport "+transport);
+    }
+
+    ~Fixture()
+    {
+        for(size_t i=0; i<pvs.size(); i++)
+            pvs[i]->close(true);
+    }
+
+    pvac::ClientProvider client() const
+    {
+        if(server)
+            return pvac::ClientProvider("pva", server->getCurrentConfig());
+        else
+            return pvac::ClientProvider(provider.provider());
+    }
+
+    // size of value in each operation, less protocol overhead
+    size_t payload() const { return array.size()*sizeof(double) + 4u; }
+};
+
+struct Result
+{
+    size_t ops;
+    double seconds;
+    //! heap allocations while timed
+    size_t allocs;
+    Result() :ops(0u), seconds(0.0), allocs(0u) {}
+};
+
+size_t allocations()
+{
+#ifdef BENCH_USE_ATOMIC
+    return epics::atomic::get(num_allocs);
+#else
+    return num_allocs;
+#endif
+}
+
+struct Connector : public pvac::ClientChannel::ConnectCallback
+{
+    Completion& done;
+    bool connected;
+    explicit Connector(Completion& done) :done(done), connected(false) {}
+    virtual ~Connector() {}
+    virtual void connectEvent(const pvac::ConnectEvent& evt)
+    {
+        // called at once if already connected
+        {
+            Guard G(done.lock);
+            if(!evt.connected || connected)
+                return;
+            connected = true;
+        }
+        done.complete(true, std::string());
+    }
+};
+
+void connectAll(pvac::ClientProvider& client, const Fixture& F, std::vector<pvac::ClientChannel>& chans)
+{
+    Completion done;
+    done.reset(F.names.size());
+    std::vector<std::tr1::shared_ptr<Connector> > connectors;
+    chans.clear();
+    for(size_t i=0; i<F.names.size(); i++) {
+        chans.push_back(client.connect(F.names[i]));
+        connectors.push_back(std::tr1::shared_ptr<Connector>(new Connector(done)));
+        chans.back().addConnectListener(connectors.back().get());
+    }
+    try {
+        done.wait();
+    } catch(...) {
+        for(size_t i=0; i<chans.size(); i++)
+            chans[i].removeConnectListener(connectors[i].get());
+        throw;
+    }
+    for(size_t i=0; i<chans.size(); i++)
+        chans[i].removeConnectListener(connectors[i].get());
+}
+
+struct Getter : public pvac::ClientChannel::GetCallback
+{
+    Completion done;
+    virtual ~Getter() {}
+    virtual void getDone(const pvac::GetEvent& evt)
+    {
+        done.complete(evt.event==pvac::GetEvent::Success, evt.message);
+    }
+};
+
+Result benchGet(Fixture& F, size_t iterations, bool rpc)
+{
+    pvac::ClientProvider client(F.client());
+    std::vector<pvac::ClientChannel> chans;
+    connectAll(client, F, chans);
+
+    pvd::PVStructurePtr args(pvd::getPVDataCreate()->createPVStructure(F.type));
+    args->copyUnchecked(*F.value);
+
+    Getter G;
+    std::vector<pvac::Operation> ops(chans.size());
+
+    Result R;
+    const size_t allocs = allocations();
+    const epicsTime start(epicsTime::getCurrent());
+    for(size_t n=0; n<iterations; n++) {
+        G.done.reset(chans.size());
+        for(size_t i=0; i<chans.size(); i++)
+            ops[i] = rpc ? chans[i].rpc(&G, args) : chans[i].get(&G);
+        G.done.wait();
+        R.ops += chans.size();
+    }
+    R.seconds = epicsTime::getCurrent() - start;
+    R.allocs = allocations() - allocs;
+    return R;
+}
+
+struct Putter : public pvac::ClientChannel::PutCallback
+{
+    Completion done;
+    const Fixture& F;
+    explicit Putter(const Fixture& F) :F(F) {}
+    virtual ~Putter() {}
+    virtual void putBuild(const pvd::StructureConstPtr& build, Args& args)
+    {
+        pvd::PVStructurePtr root(pvd::getPVDataCreate()->createPVStructure(build));
+        pvd::PVDoubleArrayPtr value(root->getSubFieldT<pvd::PVDoubleArray>("value"));
+        value->replace(F.array);
+        args.tosend.set(value->getFieldOffset());
+        args.root = root;
+    }
+    virtual void putDone(const pvac::PutEvent& evt)
+    {
+        done.complete(evt.event==pvac::PutEvent::Success, evt.message);
+    }
+};
+
+Result benchPut(Fixture& F, size_t iterations)
+{
+    pvac::ClientProvider client(F.client());
+    std::vector<pvac::ClientChannel> chans;
+    connectAll(client, F, chans);
+
+    Putter P(F);
+    std::vector<pvac::Operation> ops(chans.size());
+
+    Result R;
+    const size_t allocs = allocations();
+    const epicsTime start(epicsTime::getCurrent());
+    for(size_t n=0; n<iterations; n++) {
+        P.done.reset(chans.size());
+        for(size_t i=0; i<chans.size(); i++)
+            ops[i] = chans[i].put(&P);
+        P.done.wait();
+        R.ops += chans.size();
+    }
+    R.seconds = epicsTime::getCurrent() - start;
+    R.allocs = allocations() - allocs;
+    return R;
+}
+
+// counts updates until the last seq of a round is received
+struct Subscriber : public pvac::ClientChannel::MonitorCallback
+{
+    Completion& done;
+    epicsMutex lock;
+    pvac::Monitor mon;
+    std::vector<pvac::MonitorUpdate> batch;
+    size_t updates;
+    pvd::uint32 waitFor;
+    bool waiting, any;
+
+    explicit Subscriber(Completion& done) :done(done), updates(0u), waitFor(0u), waiting(false), any(false) {}
+    virtual ~Subscriber() { cancel(); }
+
+    //! complete() when seq is received, or any update if any
+    void expect(pvd::uint32 seq, bool any=false)
+    {
+        Guard G(lock);
+        waitFor = seq;
+        waiting = true;
+        this->any = any;
+    }
+
+    void start(pvac::ClientChannel& chan, const pvd::PVStructurePtr& pvRequest)
+    {
+        pvac::Monitor temp(chan.monitor(this, pvRequest));
+        {
+            Guard G(lock);
+            mon = temp;
+        }
+        // a Data event before mon was set is not repeated until the queue is emptied
+        drain();
+    }
+
+    void cancel()
+    {
+        pvac::Monitor temp;
+        {
+            Guard G(lock);
+            temp = mon;
+            mon = pvac::Monitor();
+        }
+        // not while locked, waits for a callback in progress
+        temp.cancel();
+    }
+
+    virtual void monitorEvent(const pvac::MonitorEvent& evt)
+    {
+        if(evt.event==pvac::MonitorEvent::Fail)
+            done.complete(false, evt.message);
+        else if(evt.event==pvac::MonitorEvent::Data)
+            drain();
+    }
+
+    void drain()
+    {
+        Guard G(lock);
+        if(!mon.valid())
+            return;
+        while(mon.pollBatch(batch)) {
+            updates += batch.size();
+            const pvd::uint32 seq = batch.back().root->getSubFieldT<pvd::PVUInt>("seq")->get();
+            if(waiting && (any || seq==waitFor)) {
+                waiting = false;
+                done.complete(true, std::string());
+            }
+        }
+    }
+};
+
+Result benchMonitor(Fixture& F, size_t iterations, unsigned queue)
+{
+    pvac::ClientProvider client(F.client());
+    std::vector<pvac::ClientChannel> chans;
+    connectAll(client, F, chans);
+
+    std::ostringstream req;
+    if(queue)
+        req<<"record[queueSize="<<queue<<",pipeline=true]";
+    req<<"field()";
+    pvd::PVStructurePtr pvRequest(pvd::createRequest(req.str()));
+
+    Completion done;
+    std::vector<std::tr1::shared_ptr<Subscriber> > subs;
+    // initial update
+    done.reset(chans.size());
+    for(size_t i=0; i<chans.size(); i++) {
+        subs.push_back(std::tr1::shared_ptr<Subscriber>(new Subscriber(done)));
+        subs.back()->expect(0u, true);
+        subs.back()->start(chans[i], pvRequest);
+    }
+    done.wait();
+    for(size_t i=0; i<subs.size(); i++) {
+        Guard G(subs[i]->lock);
+        subs[i]->updates = 0u;
+    }
+
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(F.type));
+    value->copyUnchecked(*F.value);
+    pvd::PVUIntPtr seq(value->getSubFieldT<pvd::PVUInt>("seq"));
+
+    done.reset(chans.size());
+    for(size_t i=0; i<subs.size(); i++)
+        subs[i]->expect(pvd::uint32(iterations));
+
+    const size_t allocs = allocations();
+    const epicsTime start(epicsTime::getCurrent());
+    {
+        // each round notifies all subscribers together
+        pvas::PostBatch batch;
+        for(size_t n=1; n<=iterations; n++) {
+            seq->put(pvd::uint32(n));
+            for(size_t i=0; i<F.pvs.size(); i++)
+                batch.post(*F.pvs[i], *value, F.changed);
+            batch.flush();
+        }
+    }
+    done.wait();
+
+    Result R;
+    R.seconds = epicsTime::getCurrent() - start;
+    R.allocs = allocations() - allocs;
+    for(size_t i=0; i<subs.size(); i++) {
+        subs[i]->cancel();
+        Guard G(subs[i]->lock);
+        R.ops += subs[i]->updates;
+    }
+    return R;
+}
+
+Result benchConnect(Fixture& F, size_t iterations)
+{
+    Result R;
+    const size_t allocs = allocations();
+    const epicsTime start(epicsTime::getCurrent());
+    for(size_t n=0; n<iterations; n++) {
+        // a new client each time, so nothing is cached
+        pvac::ClientProvider client(F.client());
+        std::vector<pvac::ClientChannel> chans;
+        connectAll(client, F, chans);
+        R.ops += chans.size();
+    }
+    R.seconds = epicsTime::getCurrent() - start;
+    R.allocs = allocations() - allocs;
+    return R;
+}
+
+void printResult(std::ostream& out, const std::string& bench, const Fixture& F,
+                 size_t channels, size_t elements, unsigned queue, size_t iterations,
+                 const Result& R)
+{
+    const double rate = R.seconds>0.0 ? R.ops/R.seconds : 0.0;
+    const bool carriesValue = bench!="connect";
+    const double allocsPerOp = R.ops ? double(R.allocs)/R.ops : 0.0;
+    char line[512];
+    epicsSnprintf(line, sizeof(line),
+                  "{\"bench\":\"%s\",\"transport\":\"%s\",\"channels\":%lu,\"elements\":%lu,\"queue\":%u,"
+                  "\"iterations\":%lu,\"ops\":%lu,\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"bytes_per_sec\":%.0f,"
+                  "\"allocs_per_op\":%.1f,\"version\":\"%d.%d.%d\"}",
+                  bench.c_str(), F.transport.c_str(), (unsigned long)channels, (unsigned long)elements,
+                  bench=="monitor" ? queue : 0u, (unsigned long)iterations, (unsigned long)R.ops,
+                  R.seconds, rate, carriesValue ? rate*F.payload() : 0.0, allocsPerOp,
+                  EPICS_PVA_MAJOR_VERSION, EPICS_PVA_MINOR_VERSION, EPICS_PVA_MAINTENANCE_VERSION);
+    out<<line<<std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> benches(splitList(DEFAULT_BENCHES)),
+                             transports(splitList(DEFAULT_TRANSPORTS));
+    std::vector<epicsUInt32> channels, elements, queues;
+    parseList(DEFAULT_CHANNELS, channels);
+    parseList(DEFAULT_ELEMENTS, elements);
+    parseList(DEFAULT_QUEUES, queues);
+    epicsUInt32 iterations = DEFAULT_ITERATIONS;
+    std::ofstream outFile;
+    std::ostream *out = &std::cout;
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":hb:c:e:q:t:n:o:")) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'b':
+            benches = splitList(optarg);
+            break;
+        case 't':
+            transports = splitList(optarg);
+            break;
+        case 'c':
+        case 'e':
+        case 'q':
+            if(!parseList(optarg, opt=='c' ? channels : opt=='e' ? elements : queues)) {
+                fprintf(stderr, "'%s' is not a valid list for -%c. ('benchPVA -h' for help.)\n", optarg, opt);
+                return 1;
+            }
+            break;
+        case 'n':
+            if(epicsParseUInt32(optarg, &iterations, 0, NULL) || iterations==0u) {
+                fprintf(stderr, "'%s' is not a valid iteration count. ('benchPVA -h' for help.)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            outFile.open(optarg, std::ios::out | std::ios::app);
+            if(!outFile.is_open()) {
+                fprintf(stderr, "Failed to open file '%s'.\n", optarg);
+                return 1;
+            }
+            out = &outFile;
+            break;
+        case '?':
+            fprintf(stderr, "Unrecognized option: '-%c'. ('benchPVA -h' for help.)\n", optopt);
+            return 1;
+        case ':':
+            fprintf(stderr, "Option '-%c' requires an argument. ('benchPVA -h' for help.)\n", optopt);
+            return 1;
+        default :
+            usage();
+            return 1;
+        }
+    }
+
+    SET_LOG_LEVEL(pva::logLevelError);
+
+    int failures = 0;
+
+    for(size_t t=0; t<transports.size(); t++) {
+        for(size_t c=0; c<channels.size(); c++) {
+            for(size_t e=0; e<elements.size(); e++) {
+                try {
+                    Fixture F(transports[t], channels[c], elements[e]);
+
+                    for(size_t b=0; b<benches.size(); b++) {
+                        const std::string& bench = benches[b];
+                        // connect does not depend on the value
+                        if(bench=="connect" && e!=0u)
+                            continue;
+
+                        const size_t nqueue = bench=="monitor" ? queues.size() : 1u;
+                        for(size_t q=0; q<nqueue; q++) {
+                            fprintf(stderr, "%s %s channels=%u elements=%u",
+                                    bench.c_str(), transports[t].c_str(), unsigned(channels[c]), unsigned(elements[e]));
+                            if(bench=="monitor")
+                                fprintf(stderr, " queue=%u", unsigned(queues[q]));
+                            fprintf(stderr, "\n");
+
+                            try {
+                                Result R;
+                                size_t n = iterations;
+                                if(bench=="get")
+                                    R = benchGet(F, n, false);
+                                else if(bench=="rpc")
+                                    R = benchGet(F, n, true);
+                                else if(bench=="put")
+                                    R = benchPut(F, n);
+                                else if(bench=="monitor")
+                                    R = benchMonitor(F, n, queues[q]);
+                                else if(bench=="connect")
+                                    R = benchConnect(F, n = (iterations+99u)/100u);
+                                else
+                                    throw std::runtime_error("Unknown benchmark "+bench);
+
+                                printResult(*out, bench, F, channels[c], elements[e], queues[q], n, R);
+                            } catch(std::exception& err) {
+                                fprintf(stderr, "  Error: %s\n", err.what());
+                                failures++;
+                            }
+                        }
+                    }
+                } catch(std::exception& err) {
+                    fprintf(stderr, "%s channels=%u elements=%u Error: %s\n",
+                            transports[t].c_str(), unsigned(channels[c]), unsigned(elements[e]), err.what());
+                    failures++;
+                }
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/* Cost of scheduling channel searches, without sockets.
+ *
+ * A number of names (default 1M) are registered with ChannelSearchManager as
+ * not found before, so that none is due for the next 127 timer callbacks.
+ *   register    registerSearchInstance() of each
+ *   tick        callback(), which searches none
+ *   unregister  unregisterSearchInstance() of each
+ *
+ * Usage: benchSearchSchedule [names] [ticks]
+ */
+
+#include <vector>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <epicsTime.h>
+#include <epicsThread.h>
+
+#include <pv/timerWheel.h>
+#include <pv/configuration.h>
+#include <pv/remote.h>
+#include <pv/channelSearchManager.h>
+
+namespace pvd = epics::pvData;
+using namespace epics::pvAccess;
+
+namespace {
+
+double now()
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + ts.nsec*1e-9;
+}
+
+struct BenchContext : public Context
+{
+    TimerWheel::shared_pointer timer;
+    Configuration::const_shared_pointer conf;
+    securityPlugins_t plugins;
+
+    BenchContext()
+        :timer(new TimerWheel("bench", pvd::lowPriority))
+        ,conf(ConfigurationBuilder().push_env().build())
+    {}
+    virtual ~BenchContext() {}
+
+    virtual TimerWheel::shared_pointer getTimer() OVERRIDE FINAL { return timer; }
+    virtual TransportRegistry* getTransportRegistry() OVERRIDE FINAL { return 0; }
+    virtual Configuration::const_shared_pointer getConfiguration() OVERRIDE FINAL { return conf; }
+    virtual const securityPlugins_t& getSecurityPlugins() OVERRIDE FINAL { return plugins; }
+    virtual void newServerDetected() OVERRIDE FINAL {}
+    virtual std::tr1::shared_ptr<Channel> getChannel(pvAccessID) OVERRIDE FINAL { return std::tr1::shared_ptr<Channel>(); }
+    virtual Transport::shared_pointer getSearchTransport() OVERRIDE FINAL { return Transport::shared_pointer(); }
+};
+
+struct BenchInstance : public SearchInstance
+{
+    const pvAccessID id;
+    const std::string name;
+
+    BenchInstance(pvAccessID id, const std::string& name) :id(id), name(name) {}
+    virtual ~BenchInstance() {}
+
+    virtual pvAccessID getSearchInstanceID() OVERRIDE FINAL { return id; }
+    virtual const std::string& getSearchInstanceName() OVERRIDE FINAL { return name; }
+    virtual void searchResponse(const ServerGUID&, int8_t, osiSockAddr*) OVERRIDE FINAL {}
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t nnames = argc>1 ? strtoul(argv[1], 0, 0) : 1000000u;
+    size_t nticks = argc>2 ? strtoul(argv[2], 0, 0) : 20u;
+
+    std::tr1::shared_ptr<BenchContext> context(new BenchContext);
+    ChannelSearchManager::shared_pointer manager(new ChannelSearchManager(context));
+
+    std::vector<SearchInstance::shared_pointer> instances(nnames);
+    for (size_t i = 0; i < nnames; i++)
+    {
+        char name[32];
+        sprintf(name, "bench:pv:%lu", (unsigned long)i);
+        instances[i].reset(new BenchInstance(pvAccessID(i+1), name));
+    }
+
+    double start = now();
+    for (size_t i = 0; i < nnames; i++)
+        manager->registerSearchInstance(instances[i], true);
+    double elapsed = now() - start;
+    printf("register    %lu names  %8.3f us/name\n", (unsigned long)nnames, elapsed*1e6/nnames);
+
+    // callbacks closer together than 100ms are ignored
+    double ticks = 0.0;
+    for (size_t i = 0; i < nticks; i++)
+    {
+        epicsThreadSleep(0.11);
+        start = now();
+        manager->callback();
+        ticks += now() - start;
+    }
+    if (nticks)
+        printf("tick        %lu names  %8.3f us/tick\n", (unsigned long)nnames, ticks*1e6/nticks);
+
+    start = now();
+    for (size_t i = 0; i < nnames; i++)
+        manager->unregisterSearchInstance(instances[i]);
+    elapsed = now() - start;
+    printf("unregister  %lu names  %8.3f us/name\n", (unsigned long)nnames, elapsed*1e6/nnames);
+
+    manager->cancel();
+    return 0;
+}
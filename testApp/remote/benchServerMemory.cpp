@@ -0,0 +1,133 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/* Heap memory of server channels and monitors, without sockets.
+ *
+ * A number of channels (default 100000) are opened through a ServerChannel to
+ * a smaller number of pvas::SharedPV (default 100), as a gateway with many clients
+ * of each PV would, and a monitor is started on each.  The heap in use is read
+ * before and after each step (glibc only), and the sizes of the classes involved
+ * are shown.  The per-request classes which need a connection, eg. the
+ * ServerMonitorRequesterImpl, are counted by sizeof() only.
+ *
+ * Usage: benchServerMemory [channels] [PVs]
+ */
+
+#include <vector>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __GLIBC__
+#  include <malloc.h>
+#endif
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pv/security.h>
+#include <pv/serverChannelImpl.h>
+#include <pv/responseHandlers.h>
+#include <pv/createRequest.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+// bytes of heap in use, or 0 if unknown
+size_t heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__>2 || (__GLIBC__==2 && __GLIBC_MINOR__>=33))
+    struct mallinfo2 info(mallinfo2());
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo info(mallinfo());
+    return size_t(unsigned(info.uordblks)) + size_t(unsigned(info.hblkhd));
+#else
+    return 0u;
+#endif
+}
+
+struct BenchMonitorRequester : public pva::MonitorRequester
+{
+    virtual ~BenchMonitorRequester() {}
+    virtual std::string getRequesterName() OVERRIDE FINAL { return "bench"; }
+    virtual void monitorConnect(pvd::Status const &, pva::MonitorPtr const &, pvd::StructureConstPtr const &) OVERRIDE FINAL {}
+    virtual void monitorEvent(pva::MonitorPtr const &) OVERRIDE FINAL {}
+    virtual void unlisten(pva::MonitorPtr const &) OVERRIDE FINAL {}
+};
+
+void report(const char *what, size_t count, size_t before, size_t after)
+{
+    if(before && after>=before)
+        printf("%-10s %8lu  %8.1f bytes each\n", what, (unsigned long)count, double(after-before)/count);
+    else
+        printf("%-10s %8lu  heap use unknown\n", what, (unsigned long)count);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t nchannels = argc>1 ? strtoul(argv[1], 0, 0) : 100000u;
+    size_t npvs = argc>2 ? strtoul(argv[2], 0, 0) : 100u;
+    if(nchannels==0u || npvs==0u)
+        return 1;
+
+    printf("sizeof ServerChannel              %lu\n", (unsigned long)sizeof(pva::ServerChannel));
+    printf("sizeof ServerChannelRequesterImpl %lu\n", (unsigned long)sizeof(pva::ServerChannelRequesterImpl));
+    printf("sizeof ServerMonitorRequesterImpl %lu\n", (unsigned long)sizeof(pva::ServerMonitorRequesterImpl));
+    printf("sizeof MonitorFIFO                %lu\n", (unsigned long)sizeof(pva::MonitorFIFO));
+
+    pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                ->add("value", pvd::pvDouble)
+                                ->createStructure());
+
+    pvas::StaticProvider prov("bench");
+    std::vector<std::string> names(npvs);
+    for(size_t i=0; i<npvs; i++) {
+        char name[32];
+        sprintf(name, "bench:memory:pv:%lu", (unsigned long)i);
+        names[i] = name;
+        pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+        pv->open(type);
+        prov.add(names[i], pv);
+    }
+    pva::ChannelProvider::shared_pointer provider(prov.provider());
+    pva::ChannelRequester::shared_pointer chanreq(pva::DefaultChannelRequester::build());
+    pva::MonitorRequester::shared_pointer monreq(new BenchMonitorRequester);
+    pvd::PVStructure::shared_pointer pvRequest(pvd::createRequest("field()"));
+
+    std::vector<std::tr1::shared_ptr<pva::ServerChannel> > channels;
+    std::vector<pva::Monitor::shared_pointer> monitors;
+    channels.reserve(nchannels);
+    monitors.reserve(nchannels);
+
+    size_t before = heapInUse();
+    for(size_t i=0; i<nchannels; i++) {
+        pva::Channel::shared_pointer chan(provider->createChannel(names[i%npvs], chanreq));
+        channels.push_back(std::tr1::shared_ptr<pva::ServerChannel>(
+                               new pva::ServerChannel(chan, chanreq, pva::pvAccessID(i), pva::pvAccessID(i),
+                                                      pva::NoSecurityPlugin::INSTANCE)));
+    }
+    size_t after = heapInUse();
+    report("channels", nchannels, before, after);
+
+    before = after;
+    for(size_t i=0; i<nchannels; i++) {
+        pva::Monitor::shared_pointer mon(channels[i]->getChannel()->createMonitor(monreq, pvRequest));
+        mon->start();
+        monitors.push_back(mon);
+    }
+    after = heapInUse();
+    report("monitors", nchannels, before, after);
+
+    for(size_t i=0; i<nchannels; i++) {
+        monitors[i]->destroy();
+        channels[i]->destroy();
+    }
+    return 0;
+}
@@ -4,8 +4,12 @@
  * in file LICENSE that is included with this distribution.
  */
 
+#include <vector>
+#include <sstream>
+
 #include <pv/pvData.h>
 #include <pv/pipelineServer.h>
+#include <pv/rpcService.h>
 
 using namespace epics::pvData;
 using namespace epics::pvAccess;
@@ -50,19 +54,22 @@ public:
         // blocking in this call is not a good thing
         // but generating a simple counter data is fast
         // we will generate as much elements as we can
-        size_t count = control->getFreeElementCount();
-        for (size_t i = 0; i < count; i++) {
-            MonitorElement::shared_pointer element = control->getFreeElement();
-            element->pvStructurePtr->getSubField<PVInt>(1 /*"count"*/)->put(m_counter++);
-            control->putElement(element);
+        // elements are taken and given back in one batch
+        m_elements.clear();
+        control->getFreeElements(control->getFreeElementCount(), m_elements);
+        bool done = false;
+        size_t i = 0;
+        for (; i < m_elements.size() && !done; i++) {
+            m_elements[i]->pvStructurePtr->getSubField<PVInt>(1 /*"count"*/)->put(m_counter++);
 
             // we reached the limit, no more data
-            if (m_max != 0 && m_counter == m_max)
-            {
-                control->done();
-                break;
-            }
+            done = (m_max != 0 && m_counter == m_max);
         }
+        // elements left over after the limit are not needed, the session is done
+        m_elements.resize(i);
+        control->putElements(m_elements);
+        if (done)
+            control->done();
     }
 
     virtual void cancel() {
@@ -73,6 +80,7 @@ private:
     // NOTE: all the request calls will be made from the same thread, so we do not need sync m_counter
     int32 m_counter;
     int32 m_max;
+    std::vector<MonitorElement::shared_pointer> m_elements;
 };
 
 class PipelineServiceImpl :
@@ -86,11 +94,47 @@ class PipelineServiceImpl :
     }
 };
 
+// streams the integers from 0 to args.count-1 (default 100), then ends
+class CounterStreamImpl :
+    public StreamingRPCService
+{
+    PipelineSession::shared_pointer createStream(
+        epics::pvData::PVStructure::shared_pointer const & args,
+        epics::pvData::PVStructure::shared_pointer const & /*pvRequest*/
+    )
+    {
+        int32 count = 100;
+        PVScalar::shared_pointer pvCount = args->getSubField<PVScalar>("count");
+        if (pvCount)
+            count = pvCount->getAs<int32>();
+        if (count <= 0)
+            throw RPCRequestException("count must be positive");
+
+        std::ostringstream limit;
+        limit << count;
+        PVStructure::shared_pointer options(getPVDataCreate()->createPVStructure(
+            getFieldCreate()->createFieldBuilder()->
+                addNestedStructure("record")->
+                    addNestedStructure("_options")->
+                        add("limit", pvString)->
+                    endNested()->
+                endNested()->
+            createStructure()));
+        options->getSubFieldT<PVString>("record._options.limit")->put(limit.str());
+        return PipelineSession::shared_pointer(new PipelineSessionImpl(options));
+    }
+};
+
 int main()
 {
     PipelineServer server;
 
     server.registerService("counterPipe", PipelineService::shared_pointer(new PipelineServiceImpl()));
+    // all clients of this one receive the same counter values, at the pace of the slowest client
+    server.registerService("counterPipeShared", PipelineService::shared_pointer(new PipelineServiceImpl()),
+                           SharedPipelineService::Block);
+    // a stream with arguments, see createStreamRequest()
+    server.registerService("counterStream", PipelineService::shared_pointer(new CounterStreamImpl()));
     // you can register as many services as you want here ...
 
     server.printInfo();
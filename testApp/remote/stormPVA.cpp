@@ -0,0 +1,638 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/* Soak test of the connection paths under storms, with many client contexts in one
+ * process against a ServerContext on loopback.
+ *
+ *  connect - all clients connect all channels, then disconnect, repeatedly.
+ *  restart - all clients connected, the server is restarted on the same ports.
+ *            Reports the time to full reconnect.
+ *  search  - all clients repeatedly search for names which no server has,
+ *            while a new client connects a channel which does exist.
+ *  beacon  - servers start and stop repeatedly, each beaconing as it starts, while
+ *            all clients search for names which no server has, and a new client
+ *            connects a channel which does exist.
+ *
+ * Each is run, and its result printed as one line of JSON, including the peak CPU
+ * use and resident memory of the process while it ran.  Note that each client
+ * context has its own threads, so large numbers of clients may need a raised
+ * limit on threads and open files.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+
+#include <stdio.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <unistd.h>
+#  include <sys/resource.h>
+#  define HAVE_RUSAGE
+#endif
+
+#include <epicsStdio.h>
+#include <epicsStdlib.h>
+#include <epicsGetopt.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsGuard.h>
+#include <epicsTime.h>
+
+#include <pv/pvData.h>
+#include <pv/logger.h>
+#include <pv/pvaVersion.h>
+#include <pv/serverContext.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+typedef epicsGuard<epicsMutex> Guard;
+typedef epicsGuardRelease<epicsMutex> UnGuard;
+
+#define DEFAULT_STORMS "connect,restart,search,beacon"
+#define DEFAULT_CLIENTS 100u
+#define DEFAULT_CHANNELS 10u
+#define DEFAULT_SERVERS 20u
+#define DEFAULT_DURATION 10.0
+#define DEFAULT_ITERATIONS 3u
+#define TIMEOUT 120.0
+// seconds between samples of CPU and memory use
+#define SAMPLE_PERIOD 0.1
+
+void usage()
+{
+    fprintf(stderr, "\nUsage: stormPVA [options]\n\n"
+            "Run each storm given, and print one line of JSON per result.\n"
+            "\noptions:\n"
+            "  -h: Help: Print this message\n"
+            "  -s <list>:  Storms, of connect,restart,search,beacon.  Default '%s'\n"
+            "  -C <count>: Client contexts.  Default %u\n"
+            "  -c <count>: Channels of each client.  Default %u\n"
+            "  -S <count>: Servers started in each round of a beacon storm.  Default %u\n"
+            "  -d <sec>:   Duration of search and beacon storms.  Default %.1f\n"
+            "  -n <count>: Iterations of connect and restart.  Default %u\n"
+            "  -o <file>:  Append results to <file> instead of stdout\n"
+            "\nexample: stormPVA -s restart -C 5000 -c 2 -o results.json\n\n",
+            DEFAULT_STORMS, DEFAULT_CLIENTS, DEFAULT_CHANNELS, DEFAULT_SERVERS,
+            DEFAULT_DURATION, DEFAULT_ITERATIONS);
+}
+
+std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> ret;
+    std::istringstream strm(list);
+    std::string item;
+    while(std::getline(strm, item, ','))
+        if(!item.empty())
+            ret.push_back(item);
+    return ret;
+}
+
+pva::Configuration::shared_pointer loopback()
+{
+    return pva::ConfigurationBuilder()
+            .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+            .add("EPICS_PVA_SERVER_PORT", "0")
+            .add("EPICS_PVA_BROADCAST_PORT", "0")
+            .push_map()
+            .build();
+}
+
+double cpuSeconds()
+{
+#ifdef HAVE_RUSAGE
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage))
+        return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec*1e-6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec*1e-6;
+#else
+    return 0.0;
+#endif
+}
+
+// current resident set, or 0 if unknown
+size_t residentBytes()
+{
+#ifdef __linux__
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if(!fp)
+        return 0u;
+    unsigned long size = 0u, resident = 0u;
+    if(fscanf(fp, "%lu %lu", &size, &resident)!=2)
+        resident = 0u;
+    fclose(fp);
+    return size_t(resident) * size_t(sysconf(_SC_PAGESIZE));
+#else
+    return 0u;
+#endif
+}
+
+// Samples CPU and memory use of the process until destroyed
+struct Sampler : public epicsThreadRunable
+{
+    epicsMutex lock;
+    epicsEvent wakeup;
+    bool running;
+    double peakCPU; // percent of one CPU
+    size_t peakRSS;
+    const double startCPU;
+    const epicsTime start;
+    epicsThread worker;
+
+    Sampler()
+        :running(true)
+        ,peakCPU(0.0)
+        ,peakRSS(residentBytes())
+        ,startCPU(cpuSeconds())
+        ,start(epicsTime::getCurrent())
+        ,worker(*this, "stormSampler",
+                epicsThreadGetStackSize(epicsThreadStackSmall),
+                epicsThreadPriorityHigh)
+    {
+        worker.start();
+    }
+    virtual ~Sampler()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        {
+            Guard G(lock);
+            if(!running)
+                return;
+            running = false;
+        }
+        wakeup.signal();
+        worker.exitWait();
+    }
+
+    double cpu() const { return cpuSeconds() - startCPU; }
+
+    virtual void run()
+    {
+        double prevCPU = startCPU;
+        epicsTime prev(start);
+        while(true) {
+            wakeup.wait(SAMPLE_PERIOD);
+            const double nowCPU = cpuSeconds();
+            const epicsTime now(epicsTime::getCurrent());
+            const size_t rss = residentBytes();
+
+            Guard G(lock);
+            const double interval = now - prev;
+            if(interval>0.0 && nowCPU-prevCPU > peakCPU*interval/100.0)
+                peakCPU = 100.0*(nowCPU-prevCPU)/interval;
+            if(rss>peakRSS)
+                peakRSS = rss;
+            prevCPU = nowCPU;
+            prev = now;
+            if(!running)
+                break;
+        }
+    }
+};
+
+// Counts channels connected, of all clients
+struct Tracker
+{
+    epicsMutex lock;
+    epicsEvent changed;
+    size_t connected;
+
+    Tracker() :connected(0u) {}
+
+    //! Wait until n channels are connected
+    void waitFor(size_t n)
+    {
+        const epicsTime start(epicsTime::getCurrent());
+        Guard G(lock);
+        while(connected!=n) {
+            const double remaining = TIMEOUT - (epicsTime::getCurrent() - start);
+            if(remaining<=0.0) {
+                std::ostringstream msg;
+                msg<<"Timeout with "<<connected<<" of "<<n<<" channels connected";
+                throw std::runtime_error(msg.str());
+            }
+            UnGuard U(G);
+            changed.wait(remaining);
+        }
+    }
+};
+
+struct Link : public pvac::ClientChannel::ConnectCallback
+{
+    Tracker& tracker;
+    pvac::ClientChannel chan;
+    bool connected;
+
+    Link(Tracker& tracker, const pvac::ClientChannel& chan)
+        :tracker(tracker), chan(chan), connected(false)
+    {
+        this->chan.addConnectListener(this);
+    }
+    virtual ~Link()
+    {
+        chan.removeConnectListener(this);
+        Guard G(tracker.lock);
+        if(connected)
+            tracker.connected--;
+    }
+
+    virtual void connectEvent(const pvac::ConnectEvent& evt)
+    {
+        {
+            Guard G(tracker.lock);
+            if(evt.connected==connected)
+                return;
+            connected = evt.connected;
+            if(connected)
+                tracker.connected++;
+            else
+                tracker.connected--;
+        }
+        tracker.changed.signal();
+    }
+};
+
+typedef std::vector<std::tr1::shared_ptr<Link> > links_t;
+
+// the server of the channels, and the clients of it
+struct Fixture
+{
+    const size_t nclients, nchannels;
+    pvas::StaticProvider provider;
+    std::vector<std::string> names;
+    std::vector<pvas::SharedPV::shared_pointer> pvs;
+    pva::ServerContext::shared_pointer server;
+    // fixed ports, so that the server restarts where the clients look for it
+    pva::Configuration::const_shared_pointer config;
+    std::vector<pvac::ClientProvider> clients;
+    Tracker tracker;
+
+    Fixture(size_t nclients, size_t nchannels)
+        :nclients(nclients)
+        ,nchannels(nchannels)
+        ,provider("storm")
+    {
+        pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                    ->add("value", pvd::pvInt)
+                                    ->createStructure());
+        for(size_t i=0; i<nchannels; i++) {
+            std::ostringstream name;
+            name<<"storm:"<<i;
+            names.push_back(name.str());
+            pvs.push_back(pvas::SharedPV::buildReadOnly());
+            pvs.back()->open(type);
+            provider.add(names.back(), pvs.back());
+        }
+
+        start(loopback());
+        config = server->getCurrentConfig();
+    }
+
+    ~Fixture()
+    {
+        clients.clear();
+        server.reset();
+        for(size_t i=0; i<pvs.size(); i++)
+            pvs[i]->close(true);
+    }
+
+    void start(const pva::Configuration::const_shared_pointer& conf)
+    {
+        server = pva::ServerContext::create(pva::ServerContext::Config()
+                                            .config(conf)
+                                            .provider(provider.provider()));
+    }
+
+    void stop()
+    {
+        server->shutdown();
+        server.reset();
+    }
+
+    void createClients()
+    {
+        clients.clear();
+        for(size_t i=0; i<nclients; i++)
+            clients.push_back(pvac::ClientProvider("pva", config));
+    }
+
+    //! all clients connect all channels.
+    void connectAll(links_t& links)
+    {
+        links.clear();
+        for(size_t c=0; c<clients.size(); c++)
+            for(size_t i=0; i<names.size(); i++)
+                links.push_back(std::tr1::shared_ptr<Link>(new Link(tracker, clients[c].connect(names[i]))));
+    }
+
+    //! all clients search for names no server has
+    void searchMissing(std::vector<pvac::ClientChannel>& chans, size_t round)
+    {
+        for(size_t c=0; c<clients.size(); c++) {
+            for(size_t i=0; i<nchannels; i++) {
+                std::ostringstream name;
+                name<<"storm:missing:"<<round<<":"<<c<<":"<<i;
+                chans.push_back(clients[c].connect(name.str()));
+            }
+        }
+    }
+
+    //! seconds for a new client to connect one channel
+    double probe()
+    {
+        Tracker T;
+        const epicsTime start(epicsTime::getCurrent());
+        pvac::ClientProvider client("pva", config);
+        {
+            Link L(T, client.connect(names[0]));
+            T.waitFor(1u);
+        }
+        return epicsTime::getCurrent() - start;
+    }
+};
+
+struct Result
+{
+    size_t iterations;
+    // connections made, or searches sent, or servers started
+    size_t count;
+    double seconds, worst, cpu, peakCPU;
+    size_t peakRSS;
+    Result() :iterations(0u), count(0u), seconds(0.0), worst(0.0), cpu(0.0), peakCPU(0.0), peakRSS(0u) {}
+
+    void sampled(Sampler& S)
+    {
+        S.stop();
+        cpu = S.cpu();
+        peakCPU = S.peakCPU;
+        peakRSS = S.peakRSS;
+    }
+};
+
+// seconds is the mean time for all clients to connect all channels, worst the longest
+Result stormConnect(Fixture& F, size_t iterations)
+{
+    Result R;
+    Sampler S;
+    for(size_t n=0; n<iterations; n++) {
+        const epicsTime start(epicsTime::getCurrent());
+        F.createClients();
+        links_t links;
+        F.connectAll(links);
+        F.tracker.waitFor(links.size());
+        const double elapsed = epicsTime::getCurrent() - start;
+
+        R.seconds += elapsed;
+        if(elapsed>R.worst)
+            R.worst = elapsed;
+        R.count += links.size();
+        R.iterations++;
+
+        links.clear();
+        F.clients.clear();
+    }
+    R.seconds /= R.iterations;
+    R.sampled(S);
+    return R;
+}
+
+// seconds is the mean time from restart until all channels are connected again, worst the longest
+Result stormRestart(Fixture& F, size_t iterations)
+{
+    F.createClients();
+    links_t links;
+    F.connectAll(links);
+    F.tracker.waitFor(links.size());
+
+    Result R;
+    Sampler S;
+    for(size_t n=0; n<iterations; n++) {
+        F.stop();
+        F.tracker.waitFor(0u);
+
+        const epicsTime start(epicsTime::getCurrent());
+        F.start(F.config);
+        F.tracker.waitFor(links.size());
+        const double elapsed = epicsTime::getCurrent() - start;
+
+        R.seconds += elapsed;
+        if(elapsed>R.worst)
+            R.worst = elapsed;
+        R.count += links.size();
+        R.iterations++;
+    }
+    R.seconds /= R.iterations;
+    R.sampled(S);
+
+    links.clear();
+    F.clients.clear();
+    return R;
+}
+
+// seconds is the mean time for a new client to connect during the storm, worst the longest
+Result stormSearch(Fixture& F, double duration)
+{
+    F.createClients();
+
+    Result R;
+    Sampler S;
+    const epicsTime start(epicsTime::getCurrent());
+    while(epicsTime::getCurrent() - start < duration) {
+        // new channels search at once
+        std::vector<pvac::ClientChannel> chans;
+        F.searchMissing(chans, R.iterations);
+        R.count += chans.size();
+
+        const double elapsed = F.probe();
+        R.seconds += elapsed;
+        if(elapsed>R.worst)
+            R.worst = elapsed;
+        R.iterations++;
+    }
+    if(R.iterations)
+        R.seconds /= R.iterations;
+    R.sampled(S);
+
+    F.clients.clear();
+    return R;
+}
+
+// seconds is the mean time for a new client to connect during the storm, worst the longest
+Result stormBeacon(Fixture& F, size_t nservers, double duration)
+{
+    F.createClients();
+    // searching, so that each new server prompts the clients to search again
+    std::vector<pvac::ClientChannel> chans;
+    F.searchMissing(chans, 0u);
+
+    // beacons are sent to the port where the clients search
+    std::ostringstream beaconTo;
+    beaconTo<<"127.0.0.1:"<<F.config->getPropertyAsInteger("EPICS_PVA_BROADCAST_PORT", 0);
+    pva::Configuration::shared_pointer conf(pva::ConfigurationBuilder()
+                                            .push_config(loopback())
+                                            .add("EPICS_PVAS_BEACON_ADDR_LIST", beaconTo.str())
+                                            .add("EPICS_PVAS_AUTO_BEACON_ADDR_LIST", "0")
+                                            .push_map()
+                                            .build());
+    pvas::StaticProvider empty("storm:empty");
+
+    Result R;
+    Sampler S;
+    const epicsTime start(epicsTime::getCurrent());
+    while(epicsTime::getCurrent() - start < duration) {
+        std::vector<pva::ServerContext::shared_pointer> servers;
+        for(size_t i=0; i<nservers; i++)
+            servers.push_back(pva::ServerContext::create(pva::ServerContext::Config()
+                                                         .config(conf)
+                                                         .provider(empty.provider())));
+        R.count += servers.size();
+
+        const double elapsed = F.probe();
+        R.seconds += elapsed;
+        if(elapsed>R.worst)
+            R.worst = elapsed;
+        R.iterations++;
+    }
+    if(R.iterations)
+        R.seconds /= R.iterations;
+    R.sampled(S);
+
+    chans.clear();
+    F.clients.clear();
+    return R;
+}
+
+void printResult(std::ostream& out, const std::string& storm, const Fixture& F, const Result& R)
+{
+    char line[512];
+    epicsSnprintf(line, sizeof(line),
+                  "{\"storm\":\"%s\",\"clients\":%lu,\"channels\":%lu,\"iterations\":%lu,\"count\":%lu,"
+                  "\"seconds\":%.6f,\"worst_seconds\":%.6f,\"cpu_seconds\":%.3f,\"peak_cpu_percent\":%.1f,"
+                  "\"peak_rss_bytes\":%lu,\"version\":\"%d.%d.%d\"}",
+                  storm.c_str(), (unsigned long)F.nclients, (unsigned long)F.nchannels,
+                  (unsigned long)R.iterations, (unsigned long)R.count,
+                  R.seconds, R.worst, R.cpu, R.peakCPU, (unsigned long)R.peakRSS,
+                  EPICS_PVA_MAJOR_VERSION, EPICS_PVA_MINOR_VERSION, EPICS_PVA_MAINTENANCE_VERSION);
+    out<<line<<std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> storms(splitList(DEFAULT_STORMS));
+    epicsUInt32 nclients = DEFAULT_CLIENTS,
+                nchannels = DEFAULT_CHANNELS,
+                nservers = DEFAULT_SERVERS,
+                iterations = DEFAULT_ITERATIONS;
+    double duration = DEFAULT_DURATION;
+    std::ofstream outFile;
+    std::ostream *out = &std::cout;
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":hs:C:c:S:d:n:o:")) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 's':
+            storms = splitList(optarg);
+            break;
+        case 'C':
+        case 'c':
+        case 'S':
+        case 'n':
+        {
+            epicsUInt32& val = opt=='C' ? nclients : opt=='c' ? nchannels : opt=='S' ? nservers : iterations;
+            if(epicsParseUInt32(optarg, &val, 0, NULL) || val==0u) {
+                fprintf(stderr, "'%s' is not a valid count for -%c. ('stormPVA -h' for help.)\n", optarg, opt);
+                return 1;
+            }
+        }
+            break;
+        case 'd':
+            if(epicsParseDouble(optarg, &duration, NULL) || duration<=0.0) {
+                fprintf(stderr, "'%s' is not a valid duration. ('stormPVA -h' for help.)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            outFile.open(optarg, std::ios::out | std::ios::app);
+            if(!outFile.is_open()) {
+                fprintf(stderr, "Failed to open file '%s'.\n", optarg);
+                return 1;
+            }
+            out = &outFile;
+            break;
+        case '?':
+            fprintf(stderr, "Unrecognized option: '-%c'. ('stormPVA -h' for help.)\n", optopt);
+            return 1;
+        case ':':
+            fprintf(stderr, "Option '-%c' requires an argument. ('stormPVA -h' for help.)\n", optopt);
+            return 1;
+        default :
+            usage();
+            return 1;
+        }
+    }
+
+    SET_LOG_LEVEL(pva::logLevelError);
+
+    int failures = 0;
+
+    try {
+        Fixture F(nclients, nchannels);
+
+        for(size_t s=0; s<storms.size(); s++) {
+            const std::string& storm = storms[s];
+            fprintf(stderr, "%s clients=%u channels=%u\n",
+                    storm.c_str(), unsigned(nclients), unsigned(nchannels));
+
+            try {
+                Result R;
+                if(storm=="connect")
+                    R = stormConnect(F, iterations);
+                else if(storm=="restart")
+                    R = stormRestart(F, iterations);
+                else if(storm=="search")
+                    R = stormSearch(F, duration);
+                else if(storm=="beacon")
+                    R = stormBeacon(F, nservers, duration);
+                else
+                    throw std::runtime_error("Unknown storm "+storm);
+
+                printResult(*out, storm, F, R);
+            } catch(std::exception& err) {
+                fprintf(stderr, "  Error: %s\n", err.what());
+                failures++;
+                // start again with no clients, and a server
+                F.clients.clear();
+                if(!F.server)
+                    F.start(F.config);
+            }
+        }
+    } catch(std::exception& err) {
+        fprintf(stderr, "Error: %s\n", err.what());
+        failures++;
+    }
+
+    return failures ? 1 : 0;
+}
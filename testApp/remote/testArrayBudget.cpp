@@ -0,0 +1,274 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <algorithm>
+
+#include <string.h>
+
+#include <osiSock.h>
+#include <epicsStdio.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/remote.h>
+#include <pv/transportRegistry.h>
+#include <pv/codec.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+// largest receive buffer of the server's connections
+size_t serverReceiveBuffer(const pva::ServerContext::shared_pointer& server)
+{
+    pva::Context::shared_pointer ctxt(std::tr1::dynamic_pointer_cast<pva::Context>(server));
+    pva::TransportRegistry::transportVector_t transports;
+    ctxt->getTransportRegistry()->toArray(transports);
+
+    size_t ret = 0u;
+    for(size_t i=0; i<transports.size(); i++)
+        ret = std::max(ret, transports[i]->getReceiveBufferSize());
+    return ret;
+}
+
+void testStream(const char* budget, size_t nelem)
+{
+    testDiag("==== %s MAX_ARRAY_BYTES=%s ====", CURRENT_FUNCTION, budget);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    {
+        pvd::PVStructure::shared_pointer initial(pvd::getPVDataCreate()->createPVStructure(
+                                                     pvd::getFieldCreate()->createFieldBuilder()
+                                                     ->addArray("value", pvd::pvDouble)
+                                                     ->createStructure()));
+        pvd::shared_vector<double> arr(nelem);
+        for(size_t i=0; i<nelem; i++)
+            arr[i] = double(i);
+        initial->getSubFieldT<pvd::PVDoubleArray>("value")->replace(pvd::freeze(arr));
+        pv->open(*initial);
+    }
+
+    pvas::StaticProvider prov("budget:test");
+    prov.add("tst:arr", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVAS_MAX_ARRAY_BYTES", budget)
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", server->getCurrentConfig());
+    pvac::ClientChannel chan(cli.connect("tst:arr"));
+
+    pvd::PVStructure::const_shared_pointer root(chan.get(5.0));
+    pvd::shared_vector<const double> value(root->getSubFieldT<pvd::PVDoubleArray>("value")->view());
+
+    testEqual(value.size(), nelem);
+    bool match = value.size()==nelem;
+    for(size_t i=0; match && i<nelem; i++)
+        match = value[i]==double(i);
+    testOk(match, "values match");
+
+    // a large budget doesn't grow the buffer of each connection
+    size_t bufsize = serverReceiveBuffer(server);
+    testOk(bufsize>0u && bufsize <= size_t(pva::MAX_TCP_RECV_WINDOW) + pva::detail::AbstractCodec::MAX_ENSURE_SIZE,
+           "server receive buffer %u bytes", unsigned(bufsize));
+
+    // send the array back, through a server buffer much smaller than it
+    pvd::shared_vector<double> back(nelem);
+    for(size_t i=0; i<nelem; i++)
+        back[i] = -double(i);
+    chan.put().set("value", pvd::freeze(back)).exec(5.0);
+
+    root = chan.get(5.0);
+    value = root->getSubFieldT<pvd::PVDoubleArray>("value")->view();
+    match = value.size()==nelem;
+    for(size_t i=0; match && i<nelem; i++)
+        match = value[i]==-double(i);
+    testOk(match, "values put match");
+
+    testEqual(server->getCurrentConfig()->getPropertyAsString("EPICS_PVAS_MAX_ARRAY_BYTES", ""),
+              std::string(budget));
+}
+
+// without a budget, the receive window alone bounds the receive buffer
+void testUnset()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider prov("budget:test");
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    // reported as 0, not as MAX_TCP_RECV
+    pva::Configuration::shared_pointer conf(server->getCurrentConfig());
+    testEqual(conf->getPropertyAsString("EPICS_PVAS_MAX_ARRAY_BYTES", ""), std::string("0"));
+    testEqual(conf->getPropertyAsString("EPICS_PVA_MAX_ARRAY_BYTES", ""), std::string("0"));
+}
+
+// the header of a compressed segment, of the given payload size
+void sendCompressedHeader(SOCKET sock, bool fromServer, pvd::uint32 payloadSize, pvd::uint32 inflated)
+{
+    const unsigned char msg[] = {
+        0xca, 2, (unsigned char)(0x80 | 0x08 | (fromServer ? 0x40 : 0)), 1,
+        (unsigned char)(payloadSize>>24), (unsigned char)(payloadSize>>16),
+        (unsigned char)(payloadSize>>8), (unsigned char)payloadSize,
+        (unsigned char)(inflated>>24), (unsigned char)(inflated>>16),
+        (unsigned char)(inflated>>8), (unsigned char)inflated,
+        0, 0, 0, 0,
+    };
+    // all of a short segment, only the start of a long one
+    size_t len = payloadSize<=8u ? 8u+payloadSize : 12u;
+    send(sock, (const char*)msg, int(len), 0);
+}
+
+// wait for the peer to close, discarding what it sends
+bool closedByPeer(SOCKET sock)
+{
+    while(true) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        struct timeval timeout = {5, 0};
+        if(select(int(sock)+1, &fds, 0, 0, &timeout)<=0)
+            return false;
+        char buf[1024];
+        if(recv(sock, buf, sizeof(buf), 0)<=0)
+            return true;
+    }
+}
+
+// a client sending a compressed segment over the budget of the server is disconnected
+void testServerRejects(pvd::uint32 payloadSize, pvd::uint32 inflated)
+{
+    testDiag("==== %s payload=%u inflated=%u ====", CURRENT_FUNCTION, unsigned(payloadSize), unsigned(inflated));
+
+    pvas::StaticProvider prov("budget:test");
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVAS_MAX_ARRAY_BYTES", "16384")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    osiSockAddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.ia.sin_family = AF_INET;
+    addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.ia.sin_port = htons(server->getServerPort());
+
+    SOCKET sock = epicsSocketCreate(AF_INET, SOCK_STREAM, 0);
+    if(sock==INVALID_SOCKET)
+        testAbort("Unable to create socket");
+    if(connect(sock, &addr.sa, sizeof(addr.ia))) {
+        epicsSocketDestroy(sock);
+        testAbort("Unable to connect to server port %u", unsigned(server->getServerPort()));
+    }
+
+    sendCompressedHeader(sock, false, payloadSize, inflated);
+    testOk(closedByPeer(sock), "server closes the connection");
+    epicsSocketDestroy(sock);
+}
+
+// a server sending a compressed segment over the budget of the client is disconnected
+void testClientRejects(pvd::uint32 payloadSize, pvd::uint32 inflated)
+{
+    testDiag("==== %s payload=%u inflated=%u ====", CURRENT_FUNCTION, unsigned(payloadSize), unsigned(inflated));
+
+    SOCKET listener = epicsSocketCreate(AF_INET, SOCK_STREAM, 0);
+    if(listener==INVALID_SOCKET)
+        testAbort("Unable to create socket");
+
+    osiSockAddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.ia.sin_family = AF_INET;
+    addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.ia.sin_port = 0;
+    osiSocklen_t alen = sizeof(addr.ia);
+    if(bind(listener, &addr.sa, sizeof(addr.ia)) || listen(listener, 4)
+            || getsockname(listener, &addr.sa, &alen)) {
+        epicsSocketDestroy(listener);
+        testAbort("Unable to listen");
+    }
+
+    // the client connects to its name server at once
+    char nameServer[32];
+    epicsSnprintf(nameServer, sizeof(nameServer), "127.0.0.1:%u", unsigned(ntohs(addr.ia.sin_port)));
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .add("EPICS_PVA_ADDR_LIST", "")
+                             .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                             .add("EPICS_PVA_BROADCAST_PORT", "0")
+                             .add("EPICS_PVA_NAME_SERVERS", nameServer)
+                             .add("EPICS_PVA_MAX_ARRAY_BYTES", "16384")
+                             .push_map()
+                             .build());
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(listener, &fds);
+    struct timeval timeout = {5, 0};
+    if(select(int(listener)+1, &fds, 0, 0, &timeout)<=0) {
+        epicsSocketDestroy(listener);
+        testAbort("Client did not connect");
+    }
+    SOCKET sock = epicsSocketAccept(listener, 0, 0);
+    epicsSocketDestroy(listener);
+    if(sock==INVALID_SOCKET)
+        testAbort("Unable to accept");
+
+    sendCompressedHeader(sock, true, payloadSize, inflated);
+    testOk(closedByPeer(sock), "client closes the connection");
+    epicsSocketDestroy(sock);
+}
+
+} // namespace
+
+MAIN(testArrayBudget)
+{
+    testPlan(14);
+    try {
+        // 8 MB array, with a budget smaller than it, and one much larger
+        testStream("16384", 1024u*1024u);
+        testStream("500000000", 1024u*1024u);
+        testUnset();
+        // refused before reading the payload, or before inflating it
+        testServerRejects(0x7fffffffu, 1024u*1024u);
+        testServerRejects(8u, 1024u*1024u);
+        testClientRejects(0x7fffffffu, 1024u*1024u);
+        testClientRejects(8u, 1024u*1024u);
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
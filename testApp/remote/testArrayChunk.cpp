@@ -0,0 +1,381 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/* ChannelArray gets sent in parts, with pvRequest record[chunk=N].
+ *
+ * A minimal provider serves one array of doubles through ChannelArray,
+ * logging the parts it is asked for.
+ */
+
+#include <vector>
+#include <utility>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pv/event.h>
+#include <pv/createRequest.h>
+#include <pv/pvAccess.h>
+#include <pv/clientFactory.h>
+#include <pv/serverContext.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+const size_t N = 10u;
+
+// what the provider serves, and what it is asked for
+struct Source {
+    epicsMutex lock;
+    // elements from this offset are sent one short of those asked for
+    size_t shortAt;
+    // parts from this offset fail
+    size_t failAt;
+    std::vector<std::pair<size_t, size_t> > asked;
+
+    Source() :shortAt(size_t(-1)), failAt(size_t(-1)) {}
+
+    void reset() {
+        Guard G(lock);
+        shortAt = failAt = size_t(-1);
+        asked.clear();
+    }
+    size_t calls() {
+        Guard G(lock);
+        return asked.size();
+    }
+};
+
+struct TestArray : public pva::ChannelArray
+{
+    const pva::Channel::weak_pointer channel;
+    const pva::ChannelArrayRequester::weak_pointer requester;
+    Source& source;
+    pva::ChannelArray::weak_pointer self;
+
+    TestArray(const pva::Channel::shared_pointer& channel,
+              const pva::ChannelArrayRequester::shared_pointer& requester,
+              Source& source)
+        :channel(channel), requester(requester), source(source)
+    {}
+    virtual ~TestArray() {}
+
+    virtual void getArray(size_t offset, size_t count, size_t stride) OVERRIDE FINAL
+    {
+        pva::ChannelArrayRequester::shared_pointer req(requester.lock());
+        pva::ChannelArray::shared_pointer op(self.lock());
+        if(!req || !op)
+            return;
+
+        bool fail;
+        size_t n = offset<N ? (N-offset+stride-1u)/stride : 0u;
+        if(count && count<n)
+            n = count;
+        {
+            Guard G(source.lock);
+            source.asked.push_back(std::make_pair(offset, count));
+            fail = offset>=source.failAt;
+            if(offset>=source.shortAt && n>0u)
+                n--;
+        }
+
+        if(fail) {
+            req->getArrayDone(pvd::Status::error("part fails"), op, pvd::PVArray::shared_pointer());
+            return;
+        }
+
+        pvd::PVDoubleArray::svector values(n);
+        for(size_t i=0; i<n; i++)
+            values[i] = double(offset + i*stride);
+        pvd::PVDoubleArrayPtr result(pvd::getPVDataCreate()->createPVScalarArray<pvd::PVDoubleArray>());
+        result->replace(pvd::freeze(values));
+        req->getArrayDone(pvd::Status::Ok, op, result);
+    }
+
+    virtual void putArray(pvd::PVArray::shared_pointer const &, size_t, size_t, size_t) OVERRIDE FINAL
+    {
+        pva::ChannelArrayRequester::shared_pointer req(requester.lock());
+        if(req)
+            req->putArrayDone(pvd::Status::error("read only"), self.lock());
+    }
+
+    virtual void getLength() OVERRIDE FINAL
+    {
+        pva::ChannelArrayRequester::shared_pointer req(requester.lock());
+        if(req)
+            req->getLengthDone(pvd::Status::Ok, self.lock(), N);
+    }
+
+    virtual void setLength(size_t) OVERRIDE FINAL
+    {
+        pva::ChannelArrayRequester::shared_pointer req(requester.lock());
+        if(req)
+            req->setLengthDone(pvd::Status::error("read only"), self.lock());
+    }
+
+    virtual std::tr1::shared_ptr<pva::Channel> getChannel() OVERRIDE FINAL { return channel.lock(); }
+    virtual void cancel() OVERRIDE FINAL {}
+    virtual void lastRequest() OVERRIDE FINAL {}
+    virtual void destroy() OVERRIDE FINAL {}
+};
+
+struct TestChannel : public pva::Channel
+{
+    const pva::ChannelProvider::weak_pointer provider;
+    const pva::ChannelRequester::shared_pointer requester;
+    const std::string name;
+    Source& source;
+    pva::Channel::weak_pointer self;
+
+    TestChannel(const pva::ChannelProvider::shared_pointer& provider,
+                const pva::ChannelRequester::shared_pointer& requester,
+                const std::string& name,
+                Source& source)
+        :provider(provider), requester(requester), name(name), source(source)
+    {}
+    virtual ~TestChannel() {}
+
+    virtual std::tr1::shared_ptr<pva::ChannelProvider> getProvider() OVERRIDE FINAL { return provider.lock(); }
+    virtual std::string getRemoteAddress() OVERRIDE FINAL { return "local"; }
+    virtual std::string getChannelName() OVERRIDE FINAL { return name; }
+    virtual std::tr1::shared_ptr<pva::ChannelRequester> getChannelRequester() OVERRIDE FINAL { return requester; }
+    virtual void destroy() OVERRIDE FINAL {}
+
+    virtual pva::ChannelArray::shared_pointer createChannelArray(
+            pva::ChannelArrayRequester::shared_pointer const & req,
+            pvd::PVStructure::shared_pointer const & /*pvRequest*/) OVERRIDE FINAL
+    {
+        std::tr1::shared_ptr<TestArray> op(new TestArray(self.lock(), req, source));
+        op->self = op;
+        req->channelArrayConnect(pvd::Status::Ok, op, pvd::getFieldCreate()->createScalarArray(pvd::pvDouble));
+        return op;
+    }
+};
+
+struct TestProvider : public pva::ChannelProvider
+{
+    Source source;
+    pva::ChannelProvider::weak_pointer self;
+
+    virtual ~TestProvider() {}
+
+    virtual std::string getProviderName() OVERRIDE FINAL { return "chunk"; }
+
+    virtual pva::ChannelFind::shared_pointer channelFind(std::string const & name,
+            pva::ChannelFindRequester::shared_pointer const & requester) OVERRIDE FINAL
+    {
+        pva::ChannelFind::shared_pointer ret;
+        requester->channelFindResult(pvd::Status::Ok, ret, name=="tst:array");
+        return ret;
+    }
+
+    virtual pva::Channel::shared_pointer createChannel(std::string const & name,
+            pva::ChannelRequester::shared_pointer const & requester,
+            short /*priority*/, std::string const & /*address*/) OVERRIDE FINAL
+    {
+        pva::Channel::shared_pointer ret;
+        if(name!="tst:array") {
+            requester->channelCreated(pvd::Status::error("no such channel"), ret);
+            return ret;
+        }
+        std::tr1::shared_ptr<TestChannel> chan(new TestChannel(self.lock(), requester, name, source));
+        chan->self = chan;
+        ret = chan;
+        requester->channelCreated(pvd::Status::Ok, ret);
+        return ret;
+    }
+
+    virtual void destroy() OVERRIDE FINAL {}
+};
+
+struct ArrayRequester : public pva::ChannelArrayRequester
+{
+    epicsMutex lock;
+    pvd::Event connected, done;
+    pva::ChannelArray::shared_pointer op;
+    // getArrayChunk() returns
+    bool consume;
+    pvd::Status status;
+    // of the last getArrayDone()
+    bool haveResult;
+    pvd::PVDoubleArray::const_svector result;
+    // offset and length of each part
+    std::vector<std::pair<size_t, size_t> > chunks;
+
+    ArrayRequester() :consume(false), haveResult(false) {}
+    virtual ~ArrayRequester() {}
+
+    virtual std::string getRequesterName() OVERRIDE FINAL { return "ArrayRequester"; }
+
+    virtual void channelArrayConnect(const pvd::Status& sts,
+                                     pva::ChannelArray::shared_pointer const & channelArray,
+                                     pvd::Array::const_shared_pointer const &) OVERRIDE FINAL
+    {
+        {
+            Guard G(lock);
+            status = sts;
+            op = channelArray;
+        }
+        connected.signal();
+    }
+
+    virtual void putArrayDone(const pvd::Status&, pva::ChannelArray::shared_pointer const &) OVERRIDE FINAL {}
+
+    virtual void getArrayDone(const pvd::Status& sts,
+                              pva::ChannelArray::shared_pointer const &,
+                              pvd::PVArray::shared_pointer const & pvArray) OVERRIDE FINAL
+    {
+        {
+            Guard G(lock);
+            status = sts;
+            haveResult = !!pvArray;
+            if(pvArray)
+                result = std::tr1::static_pointer_cast<pvd::PVDoubleArray>(pvArray)->view();
+        }
+        done.signal();
+    }
+
+    virtual bool getArrayChunk(pva::ChannelArray::shared_pointer const &,
+                               pvd::PVArray::shared_pointer const & chunk,
+                               size_t offset) OVERRIDE FINAL
+    {
+        Guard G(lock);
+        chunks.push_back(std::make_pair(offset, chunk->getLength()));
+        return consume;
+    }
+
+    virtual void getLengthDone(const pvd::Status&, pva::ChannelArray::shared_pointer const &, size_t) OVERRIDE FINAL {}
+    virtual void setLengthDone(const pvd::Status&, pva::ChannelArray::shared_pointer const &) OVERRIDE FINAL {}
+
+    bool get(size_t offset, size_t count)
+    {
+        pva::ChannelArray::shared_pointer array;
+        {
+            Guard G(lock);
+            array = op;
+            haveResult = false;
+            result.clear();
+            chunks.clear();
+        }
+        if(!array)
+            return false;
+        array->getArray(offset, count, 1u);
+        return done.wait(5.0);
+    }
+
+    // result is first, first+1, ... first+n-1
+    bool resultIs(size_t first, size_t n)
+    {
+        Guard G(lock);
+        bool ok = status.isSuccess() && haveResult && result.size()==n;
+        for(size_t i=0; ok && i<n; i++)
+            ok = result[i]==double(first+i);
+        return ok;
+    }
+};
+
+void testChunks(const std::tr1::shared_ptr<TestProvider>& prov,
+                const pva::ChannelProvider::shared_pointer& client)
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::Channel::shared_pointer chan(client->createChannel("tst:array"));
+    std::tr1::shared_ptr<ArrayRequester> req(new ArrayRequester);
+    pva::ChannelArray::shared_pointer op(chan->createChannelArray(req, pvd::createRequest("record[chunk=4]")));
+
+    testOk(req->connected.wait(5.0) && req->status.isSuccess(), "connected");
+
+    // parts of 4, 4, and the last 2, joined
+    prov->source.reset();
+    testOk1(req->get(0u, 0u));
+    testOk(req->resultIs(0u, N), "joined");
+    testOk(req->chunks.size()==2u && req->chunks[0].first==0u && req->chunks[1].first==4u
+           && prov->source.calls()==3u,
+           "%u parts, %u asked of the provider", unsigned(req->chunks.size()), unsigned(prov->source.calls()));
+
+    // those consumed by getArrayChunk() are not kept
+    prov->source.reset();
+    {
+        Guard G(req->lock);
+        req->consume = true;
+    }
+    testOk(req->get(0u, 0u) && req->chunks.size()==2u && req->resultIs(8u, 2u), "parts consumed");
+    {
+        Guard G(req->lock);
+        req->consume = false;
+    }
+
+    // 6 from offset 1.  4, then the remaining 2
+    prov->source.reset();
+    testOk(req->get(1u, 6u) && req->resultIs(1u, 6u) && prov->source.calls()==2u, "count in parts");
+
+    // a short part ends the get early
+    prov->source.reset();
+    {
+        Guard G(prov->source.lock);
+        prov->source.shortAt = 4u;
+    }
+    testOk(req->get(0u, 0u) && req->resultIs(0u, 7u) && prov->source.calls()==2u, "ended by a short part");
+
+    // a part fails.  Those before it are discarded
+    prov->source.reset();
+    {
+        Guard G(prov->source.lock);
+        prov->source.failAt = 4u;
+    }
+    bool failed = req->get(0u, 0u);
+    {
+        Guard G(req->lock);
+        failed &= !req->status.isSuccess() && !req->haveResult;
+    }
+    testOk(failed, "error in the second part");
+
+    prov->source.reset();
+    testOk(req->get(0u, 0u) && req->resultIs(0u, N), "whole after an error");
+
+    op->destroy();
+    chan->destroy();
+}
+
+} // namespace
+
+MAIN(testArrayChunk)
+{
+    testPlan(9);
+    try {
+        std::tr1::shared_ptr<TestProvider> prov(new TestProvider);
+        prov->self = prov;
+
+        pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                                  .config(pva::ConfigurationBuilder()
+                                                          .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                          .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                          .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                          .add("EPICS_PVA_SERVER_PORT", "0")
+                                                          .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                          .push_map()
+                                                          .build())
+                                                  .provider(prov)));
+
+        pva::ClientFactory::start();
+        pva::ChannelProvider::shared_pointer client(pva::ChannelProviderRegistry::clients()->createProvider("pva",
+                                                                                                            server->getCurrentConfig()));
+        if(!client)
+            testAbort("No pva provider");
+
+        testChunks(prov, client);
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <algorithm>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/createRequest.h>
+#include <pv/arrayDelta.h>
+#include <pv/current_function.h>
+
+#include "testBufferControl.h"
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->addArray("value", pvd::pvDouble)
+                                  ->addNestedStructure("nested")
+                                      ->addArray("wave", pvd::pvInt)
+                                      ->add("count", pvd::pvInt)
+                                  ->endNested()
+                                  ->createStructure());
+
+// send an update, and receive it into received as the client does.  Returns the bytes sent
+size_t transfer(pva::ArrayDeltaEncoder& enc, const pvd::PVStructure& value, const pvd::BitSet& changed,
+                pvd::PVStructure& received, bool& delta)
+{
+    const pvd::BitSet overrun;
+    delta = enc.prepare(value, changed);
+
+    BufferControl ctl;
+    enc.serialize(&ctl.buffer, &ctl, value, changed, overrun);
+    const size_t bytes = ctl.buffer.getPosition();
+    ctl.buffer.flip();
+
+    pvd::BitSet rchanged, deltas, data, roverrun;
+    rchanged.deserialize(&ctl.buffer, &ctl);
+    if(delta) {
+        deltas.deserialize(&ctl.buffer, &ctl);
+        pva::deltaDataBits(received, rchanged, deltas, data);
+        received.deserialize(&ctl.buffer, &ctl, &data);
+        pva::deserializeDeltas(&ctl.buffer, &ctl, deltas, received, received);
+    } else {
+        received.deserialize(&ctl.buffer, &ctl, &rchanged);
+    }
+    roverrun.deserialize(&ctl.buffer, &ctl);
+    testEqual(ctl.buffer.getRemaining(), 0u);
+    return bytes;
+}
+
+void testEncode()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(type)),
+                        received(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::PVDoubleArrayPtr arr(value->getSubFieldT<pvd::PVDoubleArray>("value"));
+    pvd::PVIntArrayPtr wave(value->getSubFieldT<pvd::PVIntArray>("nested.wave"));
+
+    pvd::shared_vector<double> A(1000);
+    for(size_t i=0; i<A.size(); i++)
+        A[i] = double(i);
+    arr->replace(pvd::freeze(A));
+    pvd::shared_vector<pvd::int32> W(100, 7);
+    wave->replace(pvd::freeze(W));
+
+    pva::ArrayDeltaEncoder enc;
+    pvd::BitSet changed;
+    bool delta;
+
+    // the first is sent whole
+    changed.set(0);
+    const size_t full = transfer(enc, *value, changed, *received, delta);
+    testOk1(!delta && *received==*value);
+
+    // one element
+    pvd::shared_vector<double> B(arr->view().size());
+    std::copy(arr->view().begin(), arr->view().end(), B.begin());
+    B[500] = -1.0;
+    arr->replace(pvd::freeze(B));
+    changed.clear();
+    changed.set(arr->getFieldOffset());
+    size_t bytes = transfer(enc, *value, changed, *received, delta);
+    testOk(delta && bytes<64u, "one element in %u of %u bytes", unsigned(bytes), unsigned(full));
+    testOk1(*received==*value);
+
+    // inside a changed structure, with another field, and grown
+    pvd::shared_vector<pvd::int32> X(102, 7);
+    X[3] = 1;
+    X[4] = 2;
+    wave->replace(pvd::freeze(X));
+    value->getSubFieldT<pvd::PVInt>("nested.count")->put(42);
+    changed.clear();
+    changed.set(value->getSubFieldT<pvd::PVStructure>("nested")->getFieldOffset());
+    transfer(enc, *value, changed, *received, delta);
+    testOk1(delta && *received==*value);
+
+    // shrunk
+    pvd::shared_vector<double> C(arr->view().size()-10u);
+    std::copy(arr->view().begin(), arr->view().begin()+C.size(), C.begin());
+    arr->replace(pvd::freeze(C));
+    changed.clear();
+    changed.set(0);
+    transfer(enc, *value, changed, *received, delta);
+    testOk1(delta && *received==*value);
+
+    // all different is sent whole
+    pvd::shared_vector<double> D(990, 3.0);
+    arr->replace(pvd::freeze(D));
+    changed.clear();
+    changed.set(arr->getFieldOffset());
+    transfer(enc, *value, changed, *received, delta);
+    testOk1(!delta && *received==*value);
+}
+
+void testMonitor()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pvas::StaticProvider prov("delta:test");
+    prov.add("tst:delta", pv);
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::PVDoubleArrayPtr arr(inst->getSubFieldT<pvd::PVDoubleArray>("value"));
+    pvd::shared_vector<double> A(4096, 1.0);
+    arr->replace(pvd::freeze(A));
+    pv->open(*inst);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+    pvac::ClientProvider cli("pva", server->getCurrentConfig());
+
+    pvac::ClientChannel chan(cli.connect("tst:delta"));
+    pvac::MonitorSync mon(chan.monitor(pvd::createRequest("record[arrayDelta=true]field()")));
+
+    testOk1(mon.wait(5.0) && mon.poll());
+    testOk1(mon.root && mon.root->getSubFieldT<pvd::PVDoubleArray>("value")->view().size()==4096u);
+    while(mon.poll()) {}
+
+    for(size_t i=0; i<3u; i++) {
+        pvd::shared_vector<double> B(arr->view().size());
+        std::copy(arr->view().begin(), arr->view().end(), B.begin());
+        B[i*1000u] = double(i);
+        arr->replace(pvd::freeze(B));
+        pvd::BitSet changed;
+        changed.set(arr->getFieldOffset());
+        pv->post(*inst, changed);
+    }
+
+    pvd::PVDoubleArray::const_svector got;
+    for(double timeout=5.0; mon.wait(timeout); timeout=0.5) {
+        while(mon.poll())
+            got = mon.root->getSubFieldT<pvd::PVDoubleArray>("value")->view();
+    }
+    testOk1(got.size()==4096u && got[0]==0.0 && got[1000]==1.0 && got[2000]==2.0 && got[3000]==1.0);
+    testOk1(got==arr->view());
+}
+
+} // namespace
+
+MAIN(testArrayDelta)
+{
+    testPlan(15);
+    try {
+        testEncode();
+        testMonitor();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
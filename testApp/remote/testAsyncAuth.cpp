@@ -0,0 +1,148 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/security.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+// Server side.  Holds the authentication of the first client until release()
+struct SlowAuth : public pva::NoSecurityPlugin
+{
+    POINTER_DEFINITIONS(SlowAuth);
+    epicsMutex lock;
+    epicsEvent holding;
+    bool holdNext;
+    pva::SecurityPluginControl::shared_pointer held;
+
+    SlowAuth() :holdNext(true) {}
+    virtual ~SlowAuth() {}
+
+    virtual std::string getId() const { return "slowauth"; }
+
+    virtual pva::SecuritySession::shared_pointer createSession(
+        osiSockAddr const &,
+        pva::SecurityPluginControl::shared_pointer const & control,
+        pvd::PVField::shared_pointer const &)
+    {
+        {
+            Guard G(lock);
+            if(holdNext) {
+                holdNext = false;
+                held = control;
+                holding.signal();
+                return shared_from_this();
+            }
+        }
+        control->authenticationCompleted(pvd::Status::Ok);
+        return shared_from_this();
+    }
+
+    // complete, as a plugin's own thread would
+    void release()
+    {
+        pva::SecurityPluginControl::shared_pointer control;
+        {
+            Guard G(lock);
+            control.swap(held);
+        }
+        if(control)
+            control->authenticationCompleted(pvd::Status::Ok);
+    }
+};
+
+// Client side, so that the server's offer is accepted
+struct ClientAuth : public pva::NoSecurityPlugin
+{
+    virtual ~ClientAuth() {}
+    virtual std::string getId() const { return "slowauth"; }
+};
+
+bool connects(pvac::ClientChannel& chan, double timeout)
+{
+    try {
+        chan.get(timeout);
+        return true;
+    } catch(pvac::Timeout&) {
+        return false;
+    }
+}
+
+void testSlowAuth()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    SlowAuth::shared_pointer auth(new SlowAuth);
+    pva::SecurityPluginRegistry::instance().installServerSecurityPlugin(auth);
+    pva::SecurityPluginRegistry::instance().installClientSecurityPlugin(
+                pva::SecurityPlugin::shared_pointer(new ClientAuth));
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("auth:test");
+    prov.add("tst:pv", pv);
+
+    {
+        pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                                  .config(pva::ConfigurationBuilder()
+                                                          .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                          .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                          .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                          .add("EPICS_PVA_SERVER_PORT", "0")
+                                                          .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                          .push_map()
+                                                          .build())
+                                                  .provider(prov.provider())));
+
+        pvac::ClientProvider first("pva", server->getCurrentConfig()),
+                             second("pva", server->getCurrentConfig());
+
+        pvac::ClientChannel chanFirst(first.connect("tst:pv"));
+        testOk(auth->holding.wait(5.0), "first client held");
+
+        // previously, the acceptor waited up to 5 seconds for the first
+        pvac::ClientChannel chanSecond(second.connect("tst:pv"));
+        testOk(connects(chanSecond, 3.0), "second client connects while the first is held");
+        testOk(!connects(chanFirst, 0.1), "first client waits");
+
+        auth->release();
+        testOk(connects(chanFirst, 5.0), "first client connects once released");
+    }
+
+    pva::SecurityPluginRegistry::instance().getServerSecurityPlugins().erase("slowauth");
+    pva::SecurityPluginRegistry::instance().getClientSecurityPlugins().erase("slowauth");
+}
+
+} // namespace
+
+MAIN(testAsyncAuth)
+{
+    testPlan(4);
+    try {
+        testSlowAuth();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <vector>
+
+#include <string.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/beaconServerStatusProvider.h>
+#include <pv/beaconHandler.h>
+#include <pv/transportRegistry.h>
+#include <pv/timerWheel.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+pva::ServerLoad makeLoad(pvd::int32 connections, double cpu, pvd::int32 queueDepth)
+{
+    pva::ServerLoad load;
+    load.connections = connections;
+    load.cpu = cpu;
+    load.queueDepth = queueDepth;
+    return load;
+}
+
+void testOrder()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    testOk1(makeLoad(100, 0.9, 0) < makeLoad(1, 0.1, 1));
+    testOk1(makeLoad(100, 0.1, 2) < makeLoad(1, 0.9, 2));
+    testOk1(makeLoad(1, 0.5, 2) < makeLoad(2, 0.5, 2));
+    testOk1(!(makeLoad(2, 0.5, 2) < makeLoad(2, 0.5, 2)));
+}
+
+void testDecode()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::ServerLoad load;
+    testOk1(!pva::BeaconHandler::decodeLoad(pvd::PVFieldPtr(), load));
+
+    pvd::PVStructurePtr other(pvd::getPVDataCreate()->createPVStructure(pvd::getFieldCreate()->createFieldBuilder()
+                                                                         ->add("uptime", pvd::pvDouble)
+                                                                         ->createStructure()));
+    testOk1(!pva::BeaconHandler::decodeLoad(other, load));
+
+    // other types, and missing fields, are accepted
+    pvd::PVStructurePtr partial(pvd::getPVDataCreate()->createPVStructure(pvd::getFieldCreate()->createFieldBuilder()
+                                                                           ->add("connections", pvd::pvLong)
+                                                                           ->add("cpu", pvd::pvFloat)
+                                                                           ->createStructure()));
+    partial->getSubFieldT<pvd::PVScalar>("connections")->putFrom<pvd::int32>(7);
+    partial->getSubFieldT<pvd::PVScalar>("cpu")->putFrom<double>(0.5);
+    testOk1(pva::BeaconHandler::decodeLoad(partial, load));
+    testEqual(load.connections, 7);
+    testEqual(load.cpu, 0.5);
+    testEqual(load.queueDepth, 0);
+}
+
+void testAdvertise()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("load:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVAS_BEACON_LOAD", "YES")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    testEqual(server->getCurrentConfig()->getPropertyAsString("EPICS_PVAS_BEACON_LOAD", ""), "YES");
+
+    pva::DefaultBeaconServerStatusProvider status(server);
+
+    pva::ServerLoad load;
+    testOk1(pva::BeaconHandler::decodeLoad(status.getServerStatusData(), load));
+    testEqual(load.connections, 0);
+    testEqual(load.queueDepth, 0);
+    testOk1(load.cpu >= 0.0);
+
+    pvac::ClientProvider client("pva", server->getCurrentConfig());
+    pvac::ClientChannel chan(client.connect("tst:pv"));
+    chan.get(5.0);
+
+    testOk1(pva::BeaconHandler::decodeLoad(status.getServerStatusData(), load));
+    testEqual(load.connections, 1);
+}
+
+struct BeaconContext : public pva::Context
+{
+    pva::TimerWheel::shared_pointer timer;
+    pva::Configuration::const_shared_pointer conf;
+    pva::TransportRegistry registry;
+    securityPlugins_t plugins;
+    unsigned restarted, detected;
+
+    BeaconContext()
+        :timer(new pva::TimerWheel("test", pvd::lowPriority))
+        ,conf(pva::ConfigurationBuilder().build())
+        ,restarted(0u)
+        ,detected(0u)
+    {}
+    virtual ~BeaconContext() {}
+
+    virtual pva::TimerWheel::shared_pointer getTimer() OVERRIDE FINAL { return timer; }
+    virtual pva::TransportRegistry* getTransportRegistry() OVERRIDE FINAL { return &registry; }
+    virtual pva::Configuration::const_shared_pointer getConfiguration() OVERRIDE FINAL { return conf; }
+    virtual const securityPlugins_t& getSecurityPlugins() OVERRIDE FINAL { return plugins; }
+    virtual void newServerDetected() OVERRIDE FINAL { detected++; }
+    virtual void serverRestarted(const osiSockAddr&) OVERRIDE FINAL { restarted++; }
+    virtual std::tr1::shared_ptr<pva::Channel> getChannel(pva::pvAccessID) OVERRIDE FINAL { return std::tr1::shared_ptr<pva::Channel>(); }
+    virtual pva::Transport::shared_pointer getSearchTransport() OVERRIDE FINAL { return pva::Transport::shared_pointer(); }
+};
+
+void testTable()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<BeaconContext> context(new BeaconContext);
+    pva::BeaconHandlerTable table;
+
+    // more than the initial number of buckets
+    std::vector<pva::BeaconHandler::shared_pointer> handlers;
+    for(unsigned i=0; i<200u; i++) {
+        osiSockAddr addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.ia.sin_family = AF_INET;
+        addr.ia.sin_addr.s_addr = htonl(0x7f000001);
+        addr.ia.sin_port = htons(5076+i);
+        handlers.push_back(table.get(context, addr));
+    }
+    testEqual(table.size(), 200u);
+
+    size_t same = 0u;
+    for(unsigned i=0; i<200u; i++) {
+        if(table.get(context, handlers[i]->getAddress())==handlers[i])
+            same++;
+    }
+    testEqual(same, 200u);
+    testEqual(table.size(), 200u);
+
+    pva::ServerGUID guid, other;
+    memset(guid.value, 1, sizeof(guid.value));
+    memset(other.value, 2, sizeof(other.value));
+    pvd::TimeStamp now;
+    pva::BeaconHandler::shared_pointer H(handlers[0]);
+
+    H->beaconNotify(0, 2, &now, guid, 1, 0, pvd::PVFieldPtr());
+    testEqual(context->restarted, 1u);
+    H->beaconNotify(0, 2, &now, guid, 2, 0, pvd::PVFieldPtr());
+    H->beaconNotify(0, 2, &now, guid, 3, 0, pvd::PVFieldPtr());
+    testEqual(table.getStats().unchanged.get(), 2u);
+    testEqual(context->detected, 1u);
+
+    H->beaconNotify(0, 2, &now, guid, 6, 0, pvd::PVFieldPtr());
+    H->beaconNotify(0, 2, &now, guid, 6, 0, pvd::PVFieldPtr());
+    testEqual(table.getStats().gaps.get(), 1u);
+    testEqual(table.getStats().repeats.get(), 1u);
+
+    H->beaconNotify(0, 2, &now, guid, 7, 1, pvd::PVFieldPtr());
+    testEqual(table.getStats().changes.get(), 1u);
+    testEqual(context->detected, 2u);
+
+    H->beaconNotify(0, 2, &now, other, 0, 0, pvd::PVFieldPtr());
+    testEqual(table.getStats().restarts.get(), 2u);
+    testEqual(context->restarted, 2u);
+
+    table.clear();
+    testEqual(table.size(), 0u);
+}
+
+} // namespace
+
+MAIN(testBeaconLoad)
+{
+    testPlan(30);
+    try {
+        testOrder();
+        testDecode();
+        testAdvertise();
+        testTable();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
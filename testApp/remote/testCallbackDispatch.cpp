@@ -0,0 +1,203 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <sstream>
+#include <vector>
+#include <string.h>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/metrics.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("value", pvd::pvInt)
+                                  ->createStructure());
+
+bool onWorker()
+{
+    return strncmp(epicsThreadGetNameSelf(), "pvac-cb", 7)==0;
+}
+
+struct Tester {
+    pvas::SharedPV::shared_pointer pv;
+    pvas::StaticProvider prov;
+    pva::ServerContext::shared_pointer server;
+    pvac::ClientProvider cli;
+    pvac::ClientChannel chan;
+
+    pvd::PVStructurePtr inst;
+    pvd::BitSet changed;
+
+    Tester()
+        :pv(pvas::SharedPV::buildReadOnly())
+        ,prov("dispatch:test")
+        ,inst(pvd::getPVDataCreate()->createPVStructure(type))
+    {
+        pv->open(type);
+        prov.add("tst:pv", pv);
+        server = pva::ServerContext::create(pva::ServerContext::Config()
+                                            .config(pva::ConfigurationBuilder()
+                                                    .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                    .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                    .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                    .add("EPICS_PVA_SERVER_PORT", "0")
+                                                    .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                    .push_map()
+                                                    .build())
+                                            .provider(prov.provider()));
+        cli = pvac::ClientProvider("pva", pva::ConfigurationBuilder()
+                                   .push_config(server->getCurrentConfig())
+                                   .add("EPICS_PVA_CALLBACK_THREADS", "2")
+                                   .push_map()
+                                   .build());
+        chan = cli.connect("tst:pv");
+        changed.set(inst->getSubFieldT<pvd::PVInt>("value")->getFieldOffset());
+    }
+
+    void post(pvd::int32 v)
+    {
+        inst->getSubFieldT<pvd::PVInt>("value")->put(v);
+        pv->post(*inst, changed);
+    }
+};
+
+struct GetCB : public pvac::ClientChannel::GetCallback
+{
+    pvac::ClientChannel& chan;
+    epicsEvent done;
+    bool worker;
+    pvd::int32 value, nested;
+
+    GetCB(pvac::ClientChannel& chan) :chan(chan), worker(false), value(-1), nested(-1) {}
+    virtual ~GetCB() {}
+
+    virtual void getDone(const pvac::GetEvent& evt) OVERRIDE FINAL
+    {
+        worker = onWorker();
+        if(evt.event==pvac::GetEvent::Success) {
+            value = evt.value->getSubFieldT<pvd::PVInt>("value")->get();
+            // blocking from a callback, as its own callback is not queued
+            nested = chan.get(5.0)->getSubFieldT<pvd::PVInt>("value")->get();
+        }
+        done.signal();
+    }
+};
+
+void testGet()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    Tester T;
+    T.post(4);
+
+    GetCB cb(T.chan);
+    pvac::Operation op(T.chan.get(&cb));
+    testOk1(cb.done.wait(5.0));
+    testOk1(cb.worker);
+    testEqual(cb.value, 4);
+    testEqual(cb.nested, 4);
+}
+
+struct MonCB : public pvac::ClientChannel::MonitorCallback
+{
+    epicsMutex mutex;
+    epicsEvent wakeup;
+    pvac::Monitor mon;
+    std::vector<pvd::int32> values;
+    bool allWorker;
+
+    MonCB() :allWorker(true) {}
+    virtual ~MonCB() {}
+
+    virtual void monitorEvent(const pvac::MonitorEvent& evt) OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        allWorker &= onWorker();
+        if(evt.event!=pvac::MonitorEvent::Data)
+            return;
+        while(mon.poll())
+            values.push_back(mon.root->getSubFieldT<pvd::PVInt>("value")->get());
+        wakeup.signal();
+    }
+};
+
+void testMonitor()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    Tester T;
+    T.post(0);
+
+    MonCB cb;
+    {
+        Guard G(cb.mutex);
+        cb.mon = T.chan.monitor(&cb);
+    }
+
+    for(pvd::int32 i=1; i<=10; i++)
+        T.post(i);
+
+    bool last = false, ordered = true;
+    while(!last && cb.wakeup.wait(5.0)) {
+        Guard G(cb.mutex);
+        last = !cb.values.empty() && cb.values.back()==10;
+    }
+    {
+        Guard G(cb.mutex);
+        for(size_t i=1; i<cb.values.size(); i++)
+            ordered &= cb.values[i-1] < cb.values[i];
+    }
+    testOk1(last);
+    testOk1(ordered);
+
+    // no callbacks after cancel() returns
+    pvac::Monitor mon;
+    {
+        Guard G(cb.mutex);
+        mon = cb.mon;
+        cb.mon = pvac::Monitor();
+    }
+    mon.cancel();
+    testOk1(cb.allWorker);
+
+    pva::Metrics M;
+    pva::MetricsSource::collectAll(M);
+    std::ostringstream strm;
+    M.write(strm);
+    testOk1(strm.str().find("pva_client_callbacks_total")!=std::string::npos);
+    testOk1(strm.str().find("pva_client_callback_queue_depth")!=std::string::npos);
+}
+
+} // namespace
+
+MAIN(testCallbackDispatch)
+{
+    testPlan(9);
+    try {
+        testGet();
+        testMonitor();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,405 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <stdio.h>
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include <epicsThread.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/channelNameIndex.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+void testIndex()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider A("a"), B("b");
+    pva::ChannelProvider::shared_pointer pa(A.provider()), pb(B.provider());
+
+    pva::ChannelNameIndex::shared_pointer idx(new pva::ChannelNameIndex(0.0));
+
+    testOk1(idx->add("x", pa));
+    testOk1(!idx->add("x", pb));
+    testOk1(idx->find("x")==pa);
+
+    idx->remove("x", pb.get());
+    testOk1(idx->find("x")==pa);
+    idx->remove("x", pa.get());
+    testOk1(!idx->find("x"));
+
+    idx->learn("y", pb);
+    testOk1(!idx->find("y"));
+    testOk1(idx->find("y", false)==pb);
+    testOk1(idx->add("y", pa));
+    testOk1(idx->find("y", false)==pa);
+
+    idx->addNegative("z");
+    testOk(idx->search("z")==pva::ChannelNameIndex::Unknown, "negative cache disabled");
+    testOk1(idx->search("y")==pva::ChannelNameIndex::Published);
+
+    bool allFound = true;
+    for(unsigned i=0; i<10000u; i++) {
+        char name[16];
+        sprintf(name, "pv:%u", i);
+        idx->add(name, i&1 ? pa : pb);
+    }
+    for(unsigned i=0; i<10000u; i++) {
+        char name[16];
+        sprintf(name, "pv:%u", i);
+        allFound &= idx->find(name)==(i&1 ? pa : pb);
+    }
+    testOk(allFound, "find() after growth");
+
+    pva::ChannelNameIndex::Stats stats;
+    idx->getStats(stats);
+    testEqual(stats.published, 10001u);
+
+    idx->removeAll(pa.get());
+    idx->getStats(stats);
+    testEqual(stats.published, 5000u);
+    testOk1(!idx->find("y"));
+    testOk1(idx->find("pv:0")==pb);
+}
+
+void testNegative()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider A("a");
+    pva::ChannelProvider::shared_pointer pa(A.provider());
+
+    pva::ChannelNameIndex::shared_pointer idx(new pva::ChannelNameIndex(0.1));
+
+    testOk1(idx->search("n")==pva::ChannelNameIndex::Unknown);
+    idx->addNegative("n");
+    testOk1(idx->search("n")==pva::ChannelNameIndex::Missing);
+
+    idx->learn("n", pa);
+    testOk(idx->search("n")==pva::ChannelNameIndex::Unknown, "learn() clears negative");
+
+    idx->addNegative("m");
+    testOk1(idx->add("m", pa));
+    testOk(idx->search("m")==pva::ChannelNameIndex::Published, "add() clears negative");
+    idx->addNegative("m");
+    testOk(idx->search("m")==pva::ChannelNameIndex::Published, "published names are never negative");
+
+    idx->addNegative("o");
+    epicsThreadSleep(0.2);
+    testOk(idx->search("o")==pva::ChannelNameIndex::Unknown, "negative expires");
+
+    pva::ChannelNameIndex::Stats stats;
+    idx->getStats(stats);
+    testEqual(stats.hits, 2u);
+    testEqual(stats.negativeHits, 1u);
+    testEqual(stats.misses, 3u);
+    testEqual(stats.negative, 0u);
+}
+
+void testPublisher()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider A("a");
+    pva::ChannelProvider::shared_pointer pa(A.provider());
+    A.add("one", pvas::SharedPV::buildReadOnly());
+
+    pva::ChannelNamePublisher *pub = dynamic_cast<pva::ChannelNamePublisher*>(pa.get());
+    testOk1(pub!=NULL);
+    if(!pub) {
+        testSkip(6, "Not a publisher");
+        return;
+    }
+
+    pva::ChannelNameIndex::shared_pointer idx(new pva::ChannelNameIndex(0.0));
+    testOk1(pub->publishNames(idx));
+    testOk1(idx->find("one")==pa);
+
+    A.add("two", pvas::SharedPV::buildReadOnly());
+    testOk1(idx->find("two")==pa);
+
+    A.remove("one");
+    testOk1(!idx->find("one"));
+
+    pub->unpublishNames(idx);
+    testOk1(!idx->find("two"));
+
+    A.add("three", pvas::SharedPV::buildReadOnly());
+    testOk1(!idx->find("three"));
+}
+
+void testBulk()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider A("a");
+    pva::ChannelProvider::shared_pointer pa(A.provider());
+    A.add("b", pvas::SharedPV::buildReadOnly());
+
+    pva::ChannelNamePublisher *pub = dynamic_cast<pva::ChannelNamePublisher*>(pa.get());
+    pva::ChannelNameIndex::shared_pointer idx(new pva::ChannelNameIndex(0.0));
+    testOk1(pub && pub->publishNames(idx));
+
+    std::map<std::string, pvas::StaticProvider::ChannelBuilder::shared_pointer> pvs;
+    pvs["a"] = pvas::SharedPV::buildReadOnly();
+    pvs["b"] = pvas::SharedPV::buildReadOnly();
+    pvs["c"] = pvas::SharedPV::buildReadOnly();
+
+    testThrows(std::logic_error, A.add(pvs));
+    testOk(!idx->find("a") && !idx->find("c"), "none added on duplicate");
+
+    pvs.erase("b");
+    A.add(pvs);
+    testOk1(idx->find("a")==pa);
+    testOk1(idx->find("c")==pa);
+
+    size_t n = 0;
+    for(pvas::StaticProvider::const_iterator it(A.begin()), end(A.end()); it!=end; ++it)
+        n++;
+    testEqual(n, 3u);
+
+    std::vector<std::string> names;
+    names.push_back("a");
+    names.push_back("missing");
+    names.push_back("b");
+    A.remove(names);
+    testOk1(!idx->find("a"));
+    testOk1(!idx->find("b"));
+    testOk1(idx->find("c")==pa);
+
+    pub->unpublishNames(idx);
+}
+
+void testBatch()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider A("a"), B("b");
+    pva::ChannelProvider::shared_pointer pa(A.provider()), pb(B.provider());
+
+    pva::ChannelNameIndex::shared_pointer idx(new pva::ChannelNameIndex(0.0));
+    testOk1(idx->add("y", pb));
+
+    std::vector<std::string> names;
+    names.push_back("x");
+    names.push_back("y");
+    names.push_back("z");
+    testEqual(idx->add(names, pa), 2u);
+    testOk1(idx->find("x")==pa);
+    testOk1(idx->find("y")==pb);
+    testOk1(idx->find("z")==pa);
+}
+
+struct Publisher : public epicsThreadRunable
+{
+    pva::ChannelNamePublisher *pub;
+    pva::ChannelNameIndex::shared_pointer idx;
+    Publisher(pva::ChannelNamePublisher *pub, const pva::ChannelNameIndex::shared_pointer& idx) :pub(pub), idx(idx) {}
+    virtual ~Publisher() {}
+    virtual void run() { pub->publishNames(idx); }
+};
+
+std::string pvName(unsigned i)
+{
+    char name[16];
+    sprintf(name, "pv:%05u", i);
+    return name;
+}
+
+void testConcurrentPublish()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider A("a");
+    pva::ChannelProvider::shared_pointer pa(A.provider());
+    pva::ChannelNamePublisher *pub = dynamic_cast<pva::ChannelNamePublisher*>(pa.get());
+
+    std::map<std::string, pvas::StaticProvider::ChannelBuilder::shared_pointer> pvs;
+    for(unsigned i=0; i<20000u; i+=2)
+        pvs[pvName(i)] = pvas::SharedPV::buildReadOnly();
+    A.add(pvs);
+
+    pva::ChannelNameIndex::shared_pointer idx(new pva::ChannelNameIndex(0.0));
+    Publisher publisher(pub, idx);
+    epicsThread worker(publisher, "publisher", epicsThreadGetStackSize(epicsThreadStackSmall));
+    worker.start();
+
+    // while publishing, add the odd names, and remove every fourth
+    pvs.clear();
+    for(unsigned i=1; i<20000u; i+=2)
+        pvs[pvName(i)] = pvas::SharedPV::buildReadOnly();
+    A.add(pvs);
+
+    std::vector<std::string> removed;
+    for(unsigned i=0; i<20000u; i+=4)
+        removed.push_back(pvName(i));
+    A.remove(removed);
+
+    worker.exitWait();
+
+    bool consistent = true;
+    for(unsigned i=0; i<20000u; i++)
+        consistent &= !idx->find(pvName(i))==(i%4==0);
+    testOk(consistent, "index matches names after concurrent add() and remove()");
+
+    pva::ChannelNameIndex::Stats stats;
+    idx->getStats(stats);
+    testEqual(stats.published, 15000u);
+
+    pub->unpublishNames(idx);
+}
+
+struct BatchResult : public pva::ChannelBatchFindRequester
+{
+    POINTER_DEFINITIONS(BatchResult);
+    size_t calls;
+    pva::ChannelProvider::shared_pointer provider;
+    std::vector<bool> found;
+    BatchResult() :calls(0u) {}
+    virtual ~BatchResult() {}
+    virtual void channelBatchFindResult(const pvd::Status& status,
+                                        pva::ChannelFind::shared_pointer const & channelFind,
+                                        const std::vector<bool>& found)
+    {
+        calls++;
+        if(channelFind)
+            provider = channelFind->getChannelProvider();
+        this->found = found;
+    }
+};
+
+// claims names starting with "dyn:", and counts searches
+struct DynHandler : public pvas::DynamicProvider::Handler
+{
+    size_t searches;
+    DynHandler() :searches(0u) {}
+    virtual ~DynHandler() {}
+    virtual void hasChannels(pvas::DynamicProvider::search_type& names)
+    {
+        searches++;
+        for(size_t i=0; i<names.size(); i++) {
+            if(names[i].name().compare(0, 4, "dyn:")==0)
+                names[i].claim();
+        }
+    }
+    virtual std::tr1::shared_ptr<pva::Channel> createChannel(const std::tr1::shared_ptr<pva::ChannelProvider>&,
+                                                             const std::string&,
+                                                             const std::tr1::shared_ptr<pva::ChannelRequester>&)
+    {
+        return std::tr1::shared_ptr<pva::Channel>();
+    }
+};
+
+void testBatchFind()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::vector<std::string> names;
+    names.push_back("one");
+    names.push_back("dyn:two");
+    names.push_back("three");
+
+    pvas::StaticProvider A("a");
+    pva::ChannelProvider::shared_pointer pa(A.provider());
+    A.add("one", pvas::SharedPV::buildReadOnly());
+    A.add("three", pvas::SharedPV::buildReadOnly());
+
+    pva::ChannelBatchFind *batch = dynamic_cast<pva::ChannelBatchFind*>(pa.get());
+    testOk1(batch!=NULL);
+    if(batch) {
+        BatchResult::shared_pointer result(new BatchResult);
+        batch->channelBatchFind(names, result);
+        testEqual(result->calls, 1u);
+        testOk1(result->provider==pa);
+        testOk1(result->found.size()==3u && result->found[0] && !result->found[1] && result->found[2]);
+    } else {
+        testSkip(3, "Not batch");
+    }
+
+    std::tr1::shared_ptr<DynHandler> handler(new DynHandler);
+    pvas::DynamicProvider D("d", handler);
+    pva::ChannelProvider::shared_pointer pd(D.provider());
+
+    batch = dynamic_cast<pva::ChannelBatchFind*>(pd.get());
+    testOk1(batch!=NULL);
+    if(batch) {
+        BatchResult::shared_pointer result(new BatchResult);
+        batch->channelBatchFind(names, result);
+        testEqual(handler->searches, 1u);
+        testOk1(result->found.size()==3u && !result->found[0] && result->found[1] && !result->found[2]);
+    } else {
+        testSkip(2, "Not batch");
+    }
+}
+
+void testBackgroundPublish()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider A("a");
+    std::map<std::string, pvas::StaticProvider::ChannelBuilder::shared_pointer> pvs;
+    pvas::SharedPV::shared_pointer last;
+    for(unsigned i=0; i<20000u; i++) {
+        pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+        pvs[pvName(i)] = pv;
+        last = pv;
+    }
+    last->open(pvd::getFieldCreate()->createFieldBuilder()
+               ->add("value", pvd::pvInt)
+               ->createStructure());
+    A.add(pvs);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVAS_PUBLISH_THREADS", "2")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(A.provider())));
+    testEqual(server->getCurrentConfig()->getPropertyAsInteger("EPICS_PVAS_PUBLISH_THREADS", 0), 2);
+
+    // found whether or not publishing has completed
+    pvac::ClientProvider client("pva", server->getCurrentConfig());
+    pvd::PVStructure::const_shared_pointer value(client.connect(pvName(19999u)).get(5.0));
+    testOk1(!!value);
+}
+
+} // namespace
+
+MAIN(testChannelNameIndex)
+{
+    testPlan(59);
+    try {
+        testIndex();
+        testNegative();
+        testPublisher();
+        testBulk();
+        testBatch();
+        testConcurrentPublish();
+        testBatchFind();
+        testBackgroundPublish();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -2,7 +2,14 @@
 * testCodec.cpp
 */
 
+#include <stdio.h>
+#include <limits>
+
 #include <epicsExit.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsMutex.h>
+#include <epicsGuard.h>
 #include <epicsUnitTest.h>
 #include <testMain.h>
 #include <pv/byteBuffer.h>
@@ -10,6 +17,8 @@
 #include <pv/codec.h>
 #include <pv/current_function.h>
 
+#include "testCodec.h"
+
 using namespace epics::pvData;
 using namespace epics::pvAccess::detail;
 
@@ -17,444 +26,12 @@ namespace epics {
 
 namespace pvAccess {
 
-struct sender_break : public connection_closed_exception
-{
-    sender_break() : connection_closed_exception("break") {}
-};
-
-struct TransportSenderDisconnect: public TransportSender {
-    void send(ByteBuffer *buffer, TransportSendControl *control)
-    {
-        control->flush(true);
-        throw sender_break();
-    }
-};
-
-struct TransportSenderSignal: public TransportSender {
-    Event *evt;
-    TransportSenderSignal(Event& evt) :evt(&evt) {}
-    void send(ByteBuffer *buffer, TransportSendControl *control)
-    {
-        evt->signal();
-    }
-};
-
-
-class PVAMessage {
-
-public:
-
-    PVAMessage(int8_t version,
-               int8_t flags,
-               int8_t command,
-               int32_t payloadSize) {
-        _version = version;
-        _flags = flags;
-        _command = command;
-        _payloadSize = payloadSize;
-    }
-
-    int8_t _version;
-    int8_t _flags;
-    int8_t _command;
-    int32_t _payloadSize;
-    std::tr1::shared_ptr<epics::pvData::ByteBuffer> _payload;
-
-    //memberwise copy constructor/assigment operator
-    //provided by the compiler
-};
-
-
-class ReadPollOneCallback {
-public:
-    virtual ~ReadPollOneCallback() {}
-    virtual void readPollOne() = 0;
-};
-
-
-class WritePollOneCallback {
-public:
-    virtual ~WritePollOneCallback() {}
-    virtual void writePollOne() = 0 ;
-};
-
-
-class TestCodec: public AbstractCodec {
-
-public:
-
-    TestCodec(
-        std::size_t receiveBufferSize,
-        std::size_t sendBufferSize,
-        bool blocking = false):
-        AbstractCodec(
-            false,
-            sendBufferSize,
-            receiveBufferSize,
-            sendBufferSize/10,
-            blocking),
-        _closedCount(0),
-        _invalidDataStreamCount(0),
-        _scheduleSendCount(0),
-        _sendCompletedCount(0),
-        _sendBufferFullCount(0),
-        _readPollOneCount(0),
-        _writePollOneCount(0),
-        _throwExceptionOnSend(false),
-        _readPayload(false),
-        _disconnected(false),
-        _forcePayloadRead(-1),
-        _readBuffer(new ByteBuffer(receiveBufferSize)),
-        _writeBuffer(sendBufferSize),
-        _dummyAddress()
-    {
-        dummyAddr.ia.sin_family = AF_INET;
-        dummyAddr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
-        dummyAddr.ia.sin_port = htons(42);
-    }
-
-
-    void reset()
-    {
-        _closedCount = 0;
-        _invalidDataStreamCount = 0;
-        _scheduleSendCount = 0;
-        _sendCompletedCount = 0;
-        _sendBufferFullCount = 0;
-        _readPollOneCount = 0;
-        _writePollOneCount = 0;
-        _readBuffer->clear();
-        _writeBuffer.clear();
-        _receivedAppMessages.clear();
-        _receivedControlMessages.clear();
-    }
-
-
-    int read(ByteBuffer *buffer) {
-
-        if (_disconnected)
-            return -1;
-
-        std::size_t startPos = _readBuffer->getPosition();
-        //buffer.put(readBuffer);
-        //while (buffer.hasRemaining() && readBuffer.hasRemaining())
-        //	buffer.put(readBuffer.get());
-
-        std::size_t bufferRemaining = buffer->getRemaining();
-        std::size_t readBufferRemaining =
-            _readBuffer->getRemaining();
-
-        if (bufferRemaining >= readBufferRemaining) {
-
-            while(_readBuffer->getRemaining() > 0) {
-                buffer->putByte(_readBuffer->getByte());
-            }
-
-        }
-        else
-        {
-            // TODO this could be optimized
-            for (std::size_t i = 0; i < bufferRemaining; i++) {
-                buffer->putByte(_readBuffer->getByte());
-            }
-        }
-        return _readBuffer->getPosition() - startPos;
-    }
-
-
-    int write(ByteBuffer *buffer) {
-        if (_disconnected)
-            return -1;	// TODO: not by the JavaDoc API spec
-
-        if (_throwExceptionOnSend)
-            throw io_exception("text IO exception");
-
-        size_t nmove = std::min(buffer->getRemaining(), _writeBuffer.getRemaining());
-
-        for(size_t n=0; n<nmove; n++)
-            _writeBuffer.putByte(buffer->getByte());
-        return nmove;
-    }
-
-
-    void transferToReadBuffer()
-    {
-        flushSerializeBuffer();
-        _writeBuffer.flip();
-
-        _readBuffer->clear();
-
-        while(_writeBuffer.getRemaining() > 0) {
-            _readBuffer->putByte(_writeBuffer.getByte());
-        }
-
-        _readBuffer->flip();
-
-        _writeBuffer.clear();
-    }
-
-
-    void addToReadBuffer()
-    {
-        flushSerializeBuffer();
-        _writeBuffer.flip();
-
-        while(_writeBuffer.getRemaining() > 0) {
-            _readBuffer->putByte(_writeBuffer.getByte());
-        }
-
-        _readBuffer->flip();
-
-        _writeBuffer.clear();
-    }
-
-
-    void processControlMessage() {
-        _receivedControlMessages.push_back(
-            PVAMessage(_version, _flags, _command, _payloadSize));
-    }
-
-
-    void processApplicationMessage()  {
-        PVAMessage caMessage(_version, _flags,
-                             _command, _payloadSize);
-
-        if (_readPayload && _payloadSize > 0)
-        {
-            // no fragmentation supported by this implementation
-            std::size_t toRead =
-                _forcePayloadRead >= 0
-                ? _forcePayloadRead : _payloadSize;
-
-            caMessage._payload.reset(new ByteBuffer(toRead));
-            while (toRead > 0)
-            {
-                std::size_t partitalRead =
-                    std::min<std::size_t>(toRead, MAX_ENSURE_DATA_SIZE);
-                ensureData(partitalRead);
-                std::size_t pos = caMessage._payload->getPosition();
-
-
-                while(_socketBuffer.getRemaining() > 0) {
-                    caMessage._payload->putByte(_socketBuffer.getByte());
-                }
-
-                std::size_t read =
-                    caMessage._payload->getPosition() - pos;
-
-                toRead -= read;
-            }
-        }
-        _receivedAppMessages.push_back(caMessage);
-    }
-
-
-    void readPollOne() {
-        _readPollOneCount++;
-        if (_readPollOneCallback.get() != 0)
-            _readPollOneCallback->readPollOne();
-    }
-
-
-    void writePollOne() {
-        _writePollOneCount++;
-        if (_writePollOneCallback.get() != 0)
-            _writePollOneCallback->writePollOne();
-    }
-
-
-    void close()  {
-        _closedCount++;
-    }
-
-    bool isOpen() {
-        return _closedCount == 0;
-    }
-
-    ReadMode getReadMode() {
-        return _readMode;
-    }
-
-    WriteMode getWriteMode() {
-        return _writeMode;
-    }
-
-    ByteBuffer*  getSendBuffer()
-    {
-        return &_sendBuffer;
-    }
-
-    const osiSockAddr* getLastReadBufferSocketAddress()
-    {
-        return &_dummyAddress;
-    }
-
-    void invalidDataStreamHandler() {
-        _invalidDataStreamCount++;
-    }
-
-    void scheduleSend() {
-        _scheduleSendCount++;
-    }
-
-    void sendCompleted() {
-        _sendCompletedCount++;
-    }
-
-    void breakSender() {
-        enqueueSendRequest(std::tr1::shared_ptr<TransportSender>(new TransportSenderDisconnect()));
-    }
-
-    bool terminated() {
-        return false;
-    }
-
-    void cachedSerialize(
-        const std::tr1::shared_ptr<const Field>& field,
-        ByteBuffer* buffer) {
-        field->serialize(buffer, this);
-    }
-
-    bool acquire(
-        std::tr1::shared_ptr<ClientChannelImpl> const & client)
-    {
-        return false;
-    }
-
-    bool directSerialize(
-        ByteBuffer *existingBuffer,
-        const char* toSerialize,
-        std::size_t elementCount,
-        std::size_t elementSize)  {
-        return false;
-    }
-
-    bool directDeserialize(
-        ByteBuffer *existingBuffer,
-        char* deserializeTo,
-        std::size_t elementCount,
-        std::size_t elementSize)  {
-        return false;
-    }
-
-    std::tr1::shared_ptr<const Field>
-    cachedDeserialize(ByteBuffer* buffer)
-    {
-        return std::tr1::shared_ptr<const Field>();
-    }
-
-    void release(pvAccessID clientId) {}
-
-    std::string getType() const
-    {
-        return std::string("TCP");
-    }
-
-    const osiSockAddr& getRemoteAddress() const  {
-        return dummyAddr;
-    }
-    std::string dummyRemoteName;
-    const std::string& getRemoteName() const {
-        return dummyRemoteName;
-    }
-
-    epics::pvData::int8 getRevision() const
-    {
-        return PVA_PROTOCOL_REVISION;
-    }
-
-    std::size_t getReceiveBufferSize() const  {
-        return 16384;
-    }
-
-    epics::pvData::int16 getPriority() const  {
-        return 0;
-    }
-
-    std::size_t getSocketReceiveBufferSize() const
-    {
-        return 16384;
-    }
-
-    void setRemoteRevision(epics::pvData::int8 revision)  {}
-
-    void setRemoteTransportSocketReceiveBufferSize(
-        std::size_t socketReceiveBufferSize)  {}
-
-    void setRemoteTransportReceiveBufferSize(
-        std::size_t remoteTransportReceiveBufferSize)  {}
-
-    void changedTransport() {}
-
-    void flushSendQueue() { };
-
-    bool verify(epics::pvData::int32 timeoutMs) {
-        return true;
-    }
-
-    void verified(epics::pvData::Status const &) {}
-
-    void aliveNotification() {}
-
-    void authNZMessage(epics::pvData::PVField::shared_pointer const & data) {}
-
-    virtual std::tr1::shared_ptr<SecuritySession> getSecuritySession() const
-    {
-        return std::tr1::shared_ptr<SecuritySession>();
-    }
-
-
-
-    bool isClosed() {
-        return false;
-    }
-
-
-    osiSockAddr dummyAddr;
-    std::size_t _closedCount;
-    std::size_t _invalidDataStreamCount;
-    std::size_t _scheduleSendCount;
-    std::size_t _sendCompletedCount;
-    std::size_t _sendBufferFullCount;
-    std::size_t _readPollOneCount;
-    std::size_t _writePollOneCount;
-    bool _throwExceptionOnSend;
-    bool _readPayload;
-    bool _disconnected;
-    int _forcePayloadRead;
-
-    epics::auto_ptr<epics::pvData::ByteBuffer> _readBuffer;
-    epics::pvData::ByteBuffer _writeBuffer;
-
-    std::vector<PVAMessage> _receivedAppMessages;
-    std::vector<PVAMessage> _receivedControlMessages;
-
-    epics::auto_ptr<ReadPollOneCallback> _readPollOneCallback;
-    epics::auto_ptr<WritePollOneCallback> _writePollOneCallback;
-
-    osiSockAddr _dummyAddress;
-
-protected:
-
-    void sendBufferFull(int tries) {
-        testDiag("sendBufferFull tries=%d", tries);
-        if(tries>10) // arbitrary limit
-            testAbort("Stuck");
-        _sendBufferFullCount++;
-        _writeOpReady = false;
-        _writeMode = WAIT_FOR_READY_SIGNAL;
-        this->writePollOne();
-        _writeMode = PROCESS_SEND_QUEUE;
-    }
-};
-
-
 class CodecTest {
 
 public:
 
     int runAllTest() {
-        testPlan(5883);
+        testPlan(5986);
         testHeaderProcess();
         testInvalidHeaderMagic();
         testInvalidHeaderSegmentedInNormal();
@@ -473,16 +50,30 @@ public:
         testStartMessageSegmentedMessageAlignment();
         testReadNormalConnectionLoss();
         testSegmentedSplitConnectionLoss();
+        testDirectDeserialize();
+        testDirectSerialize();
         testSendConnectionLoss();
         testEnqueueSendRequest();
         testEnqueueSendDirectRequest();
         testSendException();
         testSendHugeMessagePartes();
+        testSetAsideUnsent();
+        testCompression();
+        testSlowConsumerQueue();
+        testSlowConsumerBytes();
         testRecipient();
         testInvalidArguments();
         testDefaultModes();
         testEnqueueSendRequestExceptionThrown();
         testBlockingProcessQueueTest();
+        testAdaptiveReceive();
+        testCoalesce();
+        testStatistics();
+        testSegmentSize();
+        testReceiveBatch();
+        testTrafficCapture();
+        testDecodeOffload();
+        testDecodeOffloadUnion();
         return testDone();
     }
 
@@ -1491,85 +1082,451 @@ private:
     }
 
 
-    void testStartMessage()
+    void testStatistics()
     {
         testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
         TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
 
+        codec.startMessage((int8_t)CMD_MONITOR, 0x00000000);
+        codec.endMessage();
         codec.putControlMessage((int8_t)0x23, 0x456789AB);
 
         codec.transferToReadBuffer();
 
         codec.processRead();
 
-        testOk(codec._invalidDataStreamCount == 0,
-               "%s: codec._invalidDataStreamCount == 0",
-               CURRENT_FUNCTION);
-        testOk(codec._closedCount == 0,
-               "%s: codec._closedCount == 0", CURRENT_FUNCTION);
-        testOk(codec._receivedControlMessages.size() == 1,
-               "%s: codec._receivedControlMessages.size() == 1 ",
-               CURRENT_FUNCTION);
-        testOk(codec._receivedAppMessages.size() == 0,
-               "%s: codec._receivedAppMessages.size() == 0",
-               CURRENT_FUNCTION);
-
+        TransportStatistics stats;
+        codec.getStatistics().snapshot(stats);
 
-        PVAMessage header = codec._receivedControlMessages[0];
+        testOk(stats.messagesSent[CMD_MONITOR] == 1 && stats.totalMessagesSent() == 1,
+               "%s: one application message sent", CURRENT_FUNCTION);
+        testOk(stats.messagesReceived[CMD_MONITOR] == 1 && stats.totalMessagesReceived() == 1,
+               "%s: one application message received", CURRENT_FUNCTION);
+        testOk(stats.bytesSent == 2*PVA_MESSAGE_HEADER_SIZE,
+               "%s: stats.bytesSent == %u", CURRENT_FUNCTION, unsigned(stats.bytesSent));
+        testOk(stats.bytesReceived == 2*PVA_MESSAGE_HEADER_SIZE,
+               "%s: stats.bytesReceived == %u", CURRENT_FUNCTION, unsigned(stats.bytesReceived));
+        testOk(stats.sendCalls >= 1 && stats.recvCalls >= 1,
+               "%s: sendCalls=%u recvCalls=%u", CURRENT_FUNCTION,
+               unsigned(stats.sendCalls), unsigned(stats.recvCalls));
+        testOk(stats.partialWrites == 0 && stats.sendStallUS == 0,
+               "%s: no partial writes or stalls", CURRENT_FUNCTION);
+    }
 
-        testOk(header._version == PVA_VERSION,
-               "%s: header._version == PVA_VERSION", CURRENT_FUNCTION);
-        testOk(header._flags == (int8_t)((EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG ? 0x80 : 0x00) | 0x01),
-               "%s: header._flags == 0x(0|8)1", CURRENT_FUNCTION);
-        testOk(header._command == (int8_t)0x23,
-               "%s: header._command == 0x23", CURRENT_FUNCTION);
-        testOk(header._payloadSize == 0x456789AB,
-               "%s: header._payloadSize == 0x456789AB", CURRENT_FUNCTION);
 
-        codec.reset();
+    void testSegmentSize()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+        TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
 
-        // two at the time, app and control
-        codec.setByteOrder(EPICS_ENDIAN_LITTLE);
-        codec.startMessage((int8_t)0x20, 0x00000000);
+        const std::size_t capacity = codec.getSegmentSize();
+        testOk(capacity >= DEFAULT_BUFFER_SIZE,
+               "%s: initial segment size %u", CURRENT_FUNCTION, unsigned(capacity));
+
+        codec.setSegmentSize(capacity*2);
+        codec.flushSerializeBuffer();
+        testOk(codec.getSegmentSize() == capacity,
+               "%s: segment size clipped to buffer capacity", CURRENT_FUNCTION);
+
+        codec.setSegmentSize(4096);
+        testOk(codec.getSegmentSize() == capacity,
+               "%s: not applied until flush", CURRENT_FUNCTION);
+        codec.flushSerializeBuffer();
+        testOk(codec.getSegmentSize() == 4096u,
+               "%s: segment size %u", CURRENT_FUNCTION, unsigned(codec.getSegmentSize()));
+
+        codec.startMessage((int8_t)CMD_MONITOR, 0);
+        for (std::size_t i = 0; i < 6000u; i++) {
+            codec.ensureBuffer(1);
+            codec.getSendBuffer()->put((int8_t)i);
+        }
         codec.endMessage();
+        codec.flushSerializeBuffer();
 
-        codec.setByteOrder(EPICS_ENDIAN_BIG);
-        codec.putControlMessage((int8_t)0xEE, 0xDDCCBBAA);
+        TransportStatistics stats;
+        codec.getStatistics().snapshot(stats);
 
-        codec.transferToReadBuffer();
+        testOk(stats.messagesSent[CMD_MONITOR] == 2,
+               "%s: sent in %u segments", CURRENT_FUNCTION, unsigned(stats.messagesSent[CMD_MONITOR]));
+        testOk(stats.bytesSent == 6000u + 2*PVA_MESSAGE_HEADER_SIZE,
+               "%s: stats.bytesSent == %u", CURRENT_FUNCTION, unsigned(stats.bytesSent));
+    }
 
-        codec.processRead();
 
-        testOk(codec._invalidDataStreamCount == 0,
-               "%s: codec._invalidDataStreamCount == 0",
-               CURRENT_FUNCTION);
-        testOk(codec._closedCount == 0,
-               "%s: codec._closedCount == 0", CURRENT_FUNCTION);
-        testOk(codec._receivedControlMessages.size() == 1,
-               "%s: codec._receivedControlMessages.size() == 1 ",
-               CURRENT_FUNCTION);
-        testOk(codec._receivedAppMessages.size() == 1,
-               "%s: codec._receivedAppMessages.size() == 1",
-               CURRENT_FUNCTION);
+    struct CountReceived : public ReceiveBatch::Deferred
+    {
+        const TestCodec& codec;
+        std::vector<std::size_t> seen;
+        explicit CountReceived(const TestCodec& codec) :codec(codec) {}
+        virtual void runDeferred() { seen.push_back(codec._receivedAppMessages.size()); }
+    };
 
-        // app, no payload
-        header = codec._receivedAppMessages[0];
+    void testReceiveBatch()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+        TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+        std::tr1::shared_ptr<CountReceived> counter(new CountReceived(codec));
+        codec._onReceive = counter;
 
-        testOk(header._version == PVA_VERSION,
-               "%s: header._version == PVA_VERSION", CURRENT_FUNCTION);
-        testOk(header._flags == (int8_t)0x00,
-               "%s: header._flags == 0x00", CURRENT_FUNCTION);
-        testOk(header._command == (int8_t)0x20,
-               "%s: header._command == 0x20", CURRENT_FUNCTION);
-        testOk(header._payloadSize == 0x00000000,
-               "%s: header._payloadSize == 0x00000000", CURRENT_FUNCTION);
+        testOk(!ReceiveBatch::defer(counter),
+               "%s: nothing deferred outside of processRead()", CURRENT_FUNCTION);
 
-        // control
-        header = codec._receivedControlMessages[0];
+        for (int i = 0; i < 3; i++) {
+            codec.startMessage((int8_t)CMD_MONITOR, 0x00000000);
+            codec.endMessage();
+        }
+        codec.transferToReadBuffer();
 
-        testOk(header._version == PVA_VERSION,
-               "%s: header._version == PVA_VERSION", CURRENT_FUNCTION);
-        testOk(header._flags == (int8_t)0x81,
+        codec.processRead();
+
+        testOk(codec._receivedAppMessages.size() == 3,
+               "%s: three messages received", CURRENT_FUNCTION);
+        testOk(counter->seen.size() == 3,
+               "%s: each deferred notification run once", CURRENT_FUNCTION);
+        testOk(counter->seen.size() == 3 && counter->seen[0] == 3 && counter->seen[2] == 3,
+               "%s: run after all messages read together", CURRENT_FUNCTION);
+
+        {
+            // nested, as by a handler which processes more
+            ReceiveBatch outer;
+            testOk(ReceiveBatch::defer(counter),
+                   "%s: deferred within a ReceiveBatch", CURRENT_FUNCTION);
+            {
+                ReceiveBatch inner;
+            }
+            testOk(counter->seen.size() == 3,
+                   "%s: not run by an inner ReceiveBatch", CURRENT_FUNCTION);
+        }
+        testOk(counter->seen.size() == 4,
+               "%s: run by the outermost", CURRENT_FUNCTION);
+    }
+
+
+    void testTrafficCapture()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+
+        testOk(!TrafficCapture::create("no/such/directory", false, "127.0.0.1:5075"),
+               "%s: no capture without a directory", CURRENT_FUNCTION);
+
+        TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+        TrafficCapture::shared_pointer capture(TrafficCapture::create(".", false, "127.0.0.1:5075"));
+        testOk(!!capture, "%s: capture created", CURRENT_FUNCTION);
+        if (!capture) {
+            testSkip(4, "No capture");
+            return;
+        }
+        const std::string path(capture->path());
+        codec.setCapture(capture);
+        capture.reset();
+
+        codec.startMessage((int8_t)CMD_MONITOR, 0x00000000);
+        codec.endMessage();
+        codec.putControlMessage((int8_t)0x23, 0x456789AB);
+        codec.transferToReadBuffer();
+
+        std::vector<char> sent(codec._readBuffer->getArray(),
+                               codec._readBuffer->getArray() + codec._readBuffer->getLimit());
+
+        codec.processRead();
+        // closes the file
+        codec.setCapture(TrafficCapture::shared_pointer());
+
+        std::vector<char> received, data;
+        size_t records = 0u;
+        bool client = false, peer = false;
+        try {
+            TrafficReplay replay(path);
+            client = !replay.server();
+            peer = replay.peer()=="127.0.0.1:5075";
+            epicsTimeStamp when;
+            while (replay.next(when, data)) {
+                received.insert(received.end(), data.begin(), data.end());
+                records++;
+            }
+        } catch (std::exception& e) {
+            testDiag("%s", e.what());
+        }
+        remove(path.c_str());
+
+        testOk(client && peer, "%s: captured by a client from 127.0.0.1:5075", CURRENT_FUNCTION);
+        testOk(records >= 1u, "%s: %u records", CURRENT_FUNCTION, unsigned(records));
+        testOk(sent.size() == 2*PVA_MESSAGE_HEADER_SIZE && received == sent,
+               "%s: bytes received are replayed", CURRENT_FUNCTION);
+        testOk(codec._receivedAppMessages.size() == 1 && codec._receivedControlMessages.size() == 1,
+               "%s: processed as usual", CURRENT_FUNCTION);
+    }
+
+
+    struct OffloadCodec : public TestCodec,
+                          public std::tr1::enable_shared_from_this<OffloadCodec>
+    {
+        epicsMutex mutex;
+        const epicsThreadId receiver;
+        // (ioid, sequence) of the updates processed by workers
+        std::vector<std::pair<int32, int32> > offloaded;
+        // updates of IOID 1 processed when each INIT was
+        std::vector<std::size_t> inits;
+        bool onWorker, ensured;
+
+        explicit OffloadCodec(const DecodePool::shared_pointer& pool)
+            :TestCodec(DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_SIZE)
+            ,receiver(epicsThreadGetIdSelf())
+            ,onWorker(true)
+            ,ensured(true)
+        {
+            _decodePool = pool;
+        }
+        virtual ~OffloadCodec() {}
+
+        virtual std::tr1::shared_ptr<AbstractCodec> sharedCodec() { return shared_from_this(); }
+
+        void putUpdate(int8 command, int32 ioid, int8 qos, int32 seq)
+        {
+            startMessage(command, 9);
+            _sendBuffer.putInt(ioid);
+            _sendBuffer.putByte(qos);
+            _sendBuffer.putInt(seq);
+            endMessage();
+        }
+
+        // an INIT response, with the type of the operation
+        void putInit(int8 command, int32 ioid, int32 seq, const FieldConstPtr& type)
+        {
+            startMessage(command, 9);
+            _sendBuffer.putInt(ioid);
+            _sendBuffer.putByte(0x08);
+            _sendBuffer.putInt(seq);
+            type->serialize(&_sendBuffer, this);
+            endMessage();
+        }
+
+        virtual std::tr1::shared_ptr<const Field> cachedDeserialize(ByteBuffer* buffer)
+        {
+            std::tr1::shared_ptr<const Field> field(getFieldCreate()->deserialize(buffer, this));
+            receivedIntrospection(field);
+            return field;
+        }
+
+        std::size_t count(int32 ioid)
+        {
+            std::size_t n = 0;
+            for (std::size_t i = 0; i < offloaded.size(); i++)
+                n += offloaded[i].first == ioid;
+            return n;
+        }
+
+        virtual void processApplicationMessage()
+        {
+            if (offloadApplicationMessage())
+                return;
+            const std::size_t pos = _socketBuffer.getPosition();
+            if (_socketBuffer.getByte(pos + 4) & 0x08) {
+                {
+                    epicsGuard<epicsMutex> G(mutex);
+                    inits.push_back(count(1));
+                }
+                if (_payloadSize > 9) {
+                    // as the response handler does
+                    _socketBuffer.setPosition(pos + 9);
+                    cachedDeserialize(&_socketBuffer);
+                    _socketBuffer.setPosition(pos);
+                }
+            }
+            TestCodec::processApplicationMessage();
+        }
+
+        virtual void processOffloaded(int8 /*version*/, int8 /*command*/, ByteBuffer* payload)
+        {
+            ensureData(9);
+            int32 ioid = payload->getInt();
+            payload->getByte();
+            int32 seq = payload->getInt();
+            bool truncated = false;
+            try {
+                ensureData(1);
+            } catch (invalid_data_stream_exception&) {
+                truncated = true;
+            }
+            // slower than the receiver
+            if (ioid == 1)
+                epicsThreadSleep(0.01);
+
+            epicsGuard<epicsMutex> G(mutex);
+            offloaded.push_back(std::make_pair(ioid, seq));
+            onWorker &= epicsThreadGetIdSelf() != receiver && DecodePool::current(this) == payload;
+            ensured &= truncated;
+        }
+    };
+
+    void testDecodeOffload()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+        DecodePool::shared_pointer pool(new DecodePool("decode", 2u));
+        std::tr1::shared_ptr<OffloadCodec> codec(new OffloadCodec(pool));
+
+        codec->putUpdate(CMD_MONITOR, 1, 0x08, 0);
+        for (int32 seq = 1; seq <= 5; seq++)
+            codec->putUpdate(CMD_MONITOR, 1, 0x00, seq);
+        for (int32 seq = 1; seq <= 3; seq++)
+            codec->putUpdate(CMD_GET, 2, 0x00, seq);
+        // as after a reconnect
+        codec->putUpdate(CMD_MONITOR, 1, 0x08, 6);
+        codec->transferToReadBuffer();
+
+        codec->processRead();
+        pool->drain(1);
+        pool->drain(2);
+
+        epicsGuard<epicsMutex> G(codec->mutex);
+        testOk(codec->_receivedAppMessages.size() == 2,
+               "%s: INIT processed by the receiver", CURRENT_FUNCTION);
+        testOk(codec->offloaded.size() == 8,
+               "%s: %u updates offloaded", CURRENT_FUNCTION, unsigned(codec->offloaded.size()));
+        bool ordered = true;
+        int32 last[3] = {0, 0, 0};
+        for (std::size_t i = 0; i < codec->offloaded.size(); i++) {
+            int32 ioid = codec->offloaded[i].first;
+            ordered &= ioid >= 1 && ioid <= 2 && codec->offloaded[i].second == last[ioid] + 1;
+            if (ioid >= 1 && ioid <= 2)
+                last[ioid] = codec->offloaded[i].second;
+        }
+        testOk(ordered && last[1] == 5 && last[2] == 3,
+               "%s: updates of each IOID in order", CURRENT_FUNCTION);
+        testOk(codec->inits.size() == 2 && codec->inits[0] == 0 && codec->inits[1] == 5,
+               "%s: INIT waits for the updates before it", CURRENT_FUNCTION);
+        testOk(codec->onWorker, "%s: processed by workers", CURRENT_FUNCTION);
+        testOk(codec->ensured, "%s: ensureData() bounded by the payload", CURRENT_FUNCTION);
+        testOk(pool->processed() == 8, "%s: pool processed %u", CURRENT_FUNCTION, unsigned(pool->processed()));
+
+        pool->close();
+    }
+
+    void testDecodeOffloadUnion()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+        DecodePool::shared_pointer pool(new DecodePool("decode", 2u));
+        std::tr1::shared_ptr<OffloadCodec> codec(new OffloadCodec(pool));
+
+        // as NTNDArray, whose attribute[].value is a variant union
+        FieldConstPtr withUnion(getFieldCreate()->createFieldBuilder()
+                                ->addArray("value", pvInt)
+                                ->addNestedStructureArray("attribute")
+                                    ->add("name", pvString)
+                                    ->add("value", getFieldCreate()->createVariantUnion())
+                                ->endNested()
+                                ->createStructure());
+        FieldConstPtr plain(getFieldCreate()->createFieldBuilder()
+                            ->add("value", pvInt)
+                            ->createStructure());
+
+        codec->putInit(CMD_MONITOR, 1, 0, withUnion);
+        for (int32 seq = 1; seq <= 3; seq++)
+            codec->putUpdate(CMD_MONITOR, 1, 0x00, seq);
+        codec->putInit(CMD_GET, 2, 0, plain);
+        for (int32 seq = 1; seq <= 2; seq++)
+            codec->putUpdate(CMD_GET, 2, 0x00, seq);
+        // the type given again, now without a union
+        codec->putInit(CMD_MONITOR, 1, 3, plain);
+        codec->putUpdate(CMD_MONITOR, 1, 0x00, 4);
+        codec->transferToReadBuffer();
+
+        codec->processRead();
+        pool->drain(1);
+        pool->drain(2);
+
+        epicsGuard<epicsMutex> G(codec->mutex);
+        testOk(codec->_closedCount == 0, "%s: not closed", CURRENT_FUNCTION);
+        testOk(codec->_receivedAppMessages.size() == 6,
+               "%s: %u processed by the receiver", CURRENT_FUNCTION, unsigned(codec->_receivedAppMessages.size()));
+        testOk(codec->count(1) == 1 && codec->count(2) == 2,
+               "%s: only updates without unions offloaded", CURRENT_FUNCTION);
+        testOk(codec->offloaded.size() == 3 && codec->offloaded.back().first == 1 && codec->offloaded.back().second == 4,
+               "%s: offloaded after the type changed", CURRENT_FUNCTION);
+
+        pool->close();
+    }
+
+
+    void testStartMessage()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+        TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+
+        codec.putControlMessage((int8_t)0x23, 0x456789AB);
+
+        codec.transferToReadBuffer();
+
+        codec.processRead();
+
+        testOk(codec._invalidDataStreamCount == 0,
+               "%s: codec._invalidDataStreamCount == 0",
+               CURRENT_FUNCTION);
+        testOk(codec._closedCount == 0,
+               "%s: codec._closedCount == 0", CURRENT_FUNCTION);
+        testOk(codec._receivedControlMessages.size() == 1,
+               "%s: codec._receivedControlMessages.size() == 1 ",
+               CURRENT_FUNCTION);
+        testOk(codec._receivedAppMessages.size() == 0,
+               "%s: codec._receivedAppMessages.size() == 0",
+               CURRENT_FUNCTION);
+
+
+        PVAMessage header = codec._receivedControlMessages[0];
+
+        testOk(header._version == PVA_VERSION,
+               "%s: header._version == PVA_VERSION", CURRENT_FUNCTION);
+        testOk(header._flags == (int8_t)((EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG ? 0x80 : 0x00) | 0x01),
+               "%s: header._flags == 0x(0|8)1", CURRENT_FUNCTION);
+        testOk(header._command == (int8_t)0x23,
+               "%s: header._command == 0x23", CURRENT_FUNCTION);
+        testOk(header._payloadSize == 0x456789AB,
+               "%s: header._payloadSize == 0x456789AB", CURRENT_FUNCTION);
+
+        codec.reset();
+
+        // two at the time, app and control
+        codec.setByteOrder(EPICS_ENDIAN_LITTLE);
+        codec.startMessage((int8_t)0x20, 0x00000000);
+        codec.endMessage();
+
+        codec.setByteOrder(EPICS_ENDIAN_BIG);
+        codec.putControlMessage((int8_t)0xEE, 0xDDCCBBAA);
+
+        codec.transferToReadBuffer();
+
+        codec.processRead();
+
+        testOk(codec._invalidDataStreamCount == 0,
+               "%s: codec._invalidDataStreamCount == 0",
+               CURRENT_FUNCTION);
+        testOk(codec._closedCount == 0,
+               "%s: codec._closedCount == 0", CURRENT_FUNCTION);
+        testOk(codec._receivedControlMessages.size() == 1,
+               "%s: codec._receivedControlMessages.size() == 1 ",
+               CURRENT_FUNCTION);
+        testOk(codec._receivedAppMessages.size() == 1,
+               "%s: codec._receivedAppMessages.size() == 1",
+               CURRENT_FUNCTION);
+
+        // app, no payload
+        header = codec._receivedAppMessages[0];
+
+        testOk(header._version == PVA_VERSION,
+               "%s: header._version == PVA_VERSION", CURRENT_FUNCTION);
+        testOk(header._flags == (int8_t)0x00,
+               "%s: header._flags == 0x00", CURRENT_FUNCTION);
+        testOk(header._command == (int8_t)0x20,
+               "%s: header._command == 0x20", CURRENT_FUNCTION);
+        testOk(header._payloadSize == 0x00000000,
+               "%s: header._payloadSize == 0x00000000", CURRENT_FUNCTION);
+
+        // control
+        header = codec._receivedControlMessages[0];
+
+        testOk(header._version == PVA_VERSION,
+               "%s: header._version == PVA_VERSION", CURRENT_FUNCTION);
+        testOk(header._flags == (int8_t)0x81,
                "%s: header._flags == 0x81", CURRENT_FUNCTION);
         testOk(header._command == (int8_t)0xEE,
                "%s: header._command == 0xEE", CURRENT_FUNCTION);
@@ -2070,6 +2027,271 @@ private:
     }
 
 
+    // header of an application message, command 0x01
+    static void putHeader(ByteBuffer& buffer, int8_t flags, int32_t payloadSize)
+    {
+        buffer.put(PVA_MAGIC);
+        buffer.put(PVA_VERSION);
+        buffer.put(flags);
+        buffer.put((int8_t)0x01);
+        buffer.putInt(payloadSize);
+    }
+
+    static int8_t directPattern(std::size_t i)
+    {
+        return (int8_t)(i*7u + 3u);
+    }
+
+    static bool checkDirectPayload(TestCodec& codec, std::size_t count)
+    {
+        if (codec._receivedAppMessages.size() != 1 || !codec._receivedAppMessages[0]._payload)
+            return false;
+        ByteBuffer& payload = *codec._receivedAppMessages[0]._payload;
+        payload.flip();
+        if (payload.getLimit() != count)
+            return false;
+        for (std::size_t i = 0; i < count; i++)
+            if (payload.getByte() != directPattern(i))
+                return false;
+        return true;
+    }
+
+    // gives the rest of the stream once, then reports EOF
+    class ReadPollOneCallbackForTestDirectDeserialize:
+        public ReadPollOneCallback {
+
+    public:
+
+        ReadPollOneCallbackForTestDirectDeserialize(
+            TestCodec & codec, std::size_t from, std::size_t to): _codec(codec), _from(from), _to(to) {}
+
+        void readPollOne()  {
+            if (_codec._readPollOneCount == 1 && _to > _from)
+            {
+                // all before was read, so the rest can be uncovered
+                _codec._readBuffer->setLimit(_to);
+            }
+            else
+                _codec._disconnected = true;
+        }
+
+    private:
+        TestCodec &_codec;
+        std::size_t _from, _to;
+    };
+
+    void testDirectDeserialize()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+
+        // larger than the 64KB threshold, and than the codec's receive buffer
+        const std::size_t count = 100000u;
+
+        {
+            testDiag("partly buffered, the rest read from the socket");
+            TestCodec codec(DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_SIZE);
+            codec._readBuffer.reset(new ByteBuffer(2*count));
+            codec._readPayload = true;
+            codec._directPayload = count;
+
+            putHeader(*codec._readBuffer, (int8_t)0x80, int32_t(count));
+            for (std::size_t i = 0; i < count; i++)
+                codec._readBuffer->put(directPattern(i));
+            // the stream continues after the payload
+            codec._readBuffer->put(PVA_MAGIC);
+            codec._readBuffer->put(PVA_VERSION);
+            codec._readBuffer->put((int8_t)0x81);
+            codec._readBuffer->put((int8_t)0xEE);
+            codec._readBuffer->putInt(0);
+            codec._readBuffer->flip();
+
+            codec.processRead();
+
+            testOk(codec._invalidDataStreamCount == 0 && codec._closedCount == 0,
+                   "%s: not closed", CURRENT_FUNCTION);
+            testOk(codec._directCount == 1, "%s: read directly", CURRENT_FUNCTION);
+            testOk(checkDirectPayload(codec, count), "%s: payload", CURRENT_FUNCTION);
+            testOk(codec._receivedControlMessages.size() == 1,
+                   "%s: message after the payload", CURRENT_FUNCTION);
+            testOk(codec._readPollOneCount == 0,
+                   "%s: codec._readPollOneCount == 0", CURRENT_FUNCTION);
+        }
+
+        {
+            testDiag("spanning segments, the first ending within the buffer");
+            TestCodec codec(DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_SIZE);
+            codec._readBuffer.reset(new ByteBuffer(2*count));
+            codec._readPayload = true;
+            codec._directPayload = count;
+
+            // the end of the first, at pos != _storedLimit, and the start of the second are buffered.
+            // Most of the second and third are read from the socket.
+            const std::size_t sizes[3] = {5000u, 40000u, count - 45000u};
+            const int8_t flags[3] = {(int8_t)0x90, (int8_t)0xB0, (int8_t)0xA0};
+            std::size_t c = 0u;
+            for (size_t s = 0; s < 3; s++)
+            {
+                putHeader(*codec._readBuffer, flags[s], int32_t(sizes[s]));
+                for (std::size_t i = 0; i < sizes[s]; i++)
+                    codec._readBuffer->put(directPattern(c++));
+            }
+            codec._readBuffer->put(PVA_MAGIC);
+            codec._readBuffer->put(PVA_VERSION);
+            codec._readBuffer->put((int8_t)0x81);
+            codec._readBuffer->put((int8_t)0xEE);
+            codec._readBuffer->putInt(0);
+            codec._readBuffer->flip();
+
+            codec.processRead();
+
+            testOk(codec._invalidDataStreamCount == 0 && codec._closedCount == 0,
+                   "%s: not closed", CURRENT_FUNCTION);
+            testOk(codec._directCount == 1, "%s: read directly", CURRENT_FUNCTION);
+            testOk(checkDirectPayload(codec, count), "%s: payload", CURRENT_FUNCTION);
+            testOk(codec._receivedControlMessages.size() == 1,
+                   "%s: message after the payload", CURRENT_FUNCTION);
+            testOk(codec._readPollOneCount == 0,
+                   "%s: codec._readPollOneCount == 0", CURRENT_FUNCTION);
+        }
+
+        {
+            testDiag("short read partway");
+            TestCodec codec(DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_SIZE);
+            codec._readBuffer.reset(new ByteBuffer(2*count));
+            codec._readPayload = true;
+            codec._directPayload = count;
+
+            putHeader(*codec._readBuffer, (int8_t)0x80, int32_t(count));
+            for (std::size_t i = 0; i < count; i++)
+                codec._readBuffer->put(directPattern(i));
+            codec._readBuffer->flip();
+            // the socket has nothing more to give after 30000 bytes, until polled
+            const std::size_t end = codec._readBuffer->getLimit();
+            codec._readBuffer->setLimit(30000u);
+            codec._readPollOneCallback.reset(new ReadPollOneCallbackForTestDirectDeserialize(codec, 30000u, end));
+
+            codec.processRead();
+
+            testOk(codec._invalidDataStreamCount == 0 && codec._closedCount == 0,
+                   "%s: not closed", CURRENT_FUNCTION);
+            testOk(codec._directCount == 1, "%s: read directly", CURRENT_FUNCTION);
+            testOk(checkDirectPayload(codec, count), "%s: payload", CURRENT_FUNCTION);
+            testOk(codec._readPollOneCount == 1,
+                   "%s: codec._readPollOneCount == 1", CURRENT_FUNCTION);
+        }
+
+        {
+            testDiag("EOF partway");
+            TestCodec codec(DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_SIZE);
+            codec._readBuffer.reset(new ByteBuffer(2*count));
+            codec._readPayload = true;
+            codec._directPayload = count;
+
+            putHeader(*codec._readBuffer, (int8_t)0x80, int32_t(count));
+            for (std::size_t i = 0; i < 30000u; i++)
+                codec._readBuffer->put(directPattern(i));
+            codec._readBuffer->flip();
+            codec._readPollOneCallback.reset(new ReadPollOneCallbackForTestDirectDeserialize(codec, 0u, 0u));
+
+            codec.processRead();
+
+            testOk(codec._closedCount == 1,
+                   "%s: codec._closedCount == 1", CURRENT_FUNCTION);
+            testOk(codec._receivedAppMessages.size() == 0,
+                   "%s: codec._receivedAppMessages.size() == 0", CURRENT_FUNCTION);
+            testOk(codec._readPollOneCount == 1,
+                   "%s: codec._readPollOneCount == 1", CURRENT_FUNCTION);
+        }
+    }
+
+
+    void testDirectSerialize()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+
+        const std::size_t count = 100000u;
+        std::vector<char> data(count);
+        for (std::size_t i = 0; i < count; i++)
+            data[i] = directPattern(i);
+
+        {
+            testDiag("under 64KB, through _sendBuffer");
+            TestCodec codec(DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_SIZE);
+            codec.startMessage((int8_t)CMD_MONITOR, 0);
+
+            testOk(!codec.AbstractCodec::directSerialize(codec.getSendBuffer(), &data[0], 64u*1024u-1u, 1),
+                   "%s: not direct", CURRENT_FUNCTION);
+            testOk(codec._writeBuffer.getPosition() == 0 &&
+                   codec.getSendBuffer()->getPosition() == PVA_MESSAGE_HEADER_SIZE,
+                   "%s: nothing sent", CURRENT_FUNCTION);
+        }
+
+        if (AbstractCodec::compressionSupported()) {
+            testDiag("compressed, through _sendBuffer");
+            TestCodec codec(DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_SIZE);
+            codec.setCompression(256);
+            codec.peerCanInflate();
+            codec.startMessage((int8_t)CMD_MONITOR, 0);
+
+            testOk(!codec.AbstractCodec::directSerialize(codec.getSendBuffer(), &data[0], count, 1),
+                   "%s: not direct", CURRENT_FUNCTION);
+            testOk(codec._writeBuffer.getPosition() == 0 &&
+                   codec.getSendBuffer()->getPosition() == PVA_MESSAGE_HEADER_SIZE,
+                   "%s: nothing sent", CURRENT_FUNCTION);
+        } else {
+            testSkip(2, "built without LZ4");
+        }
+
+        {
+            testDiag("partial writes, across the headers and the array");
+            TestCodec codec(DEFAULT_BUFFER_SIZE, 4*count);
+            codec._readBuffer.reset(new ByteBuffer(4*count));
+            codec._readPayload = true;
+            // each write() stops within a buffer, so writeGather() is called again from there
+            codec._writeLimit = 1000u;
+
+            codec.startMessage((int8_t)CMD_MONITOR, 0);
+            codec.ensureBuffer(3);
+            for (int8_t i = 1; i <= 3; i++)
+                codec.getSendBuffer()->put(i);
+            testOk1(codec.AbstractCodec::directSerialize(codec.getSendBuffer(), &data[0], count, 1));
+            codec.ensureBuffer(3);
+            for (int8_t i = 4; i <= 6; i++)
+                codec.getSendBuffer()->put(i);
+            codec.endMessage();
+
+            codec.transferToReadBuffer();
+
+            TransportStatistics stats;
+            codec.getStatistics().snapshot(stats);
+            testOk(stats.partialWrites > 0 && stats.bytesSent == codec._readBuffer->getLimit(),
+                   "%s: %u partial writes of %u bytes", CURRENT_FUNCTION,
+                   unsigned(stats.partialWrites), unsigned(stats.bytesSent));
+
+            codec._forcePayloadRead = int(count + 6u);
+            codec.processRead();
+
+            testOk(codec._invalidDataStreamCount == 0 && codec._closedCount == 0 &&
+                   codec._receivedAppMessages.size() == 1,
+                   "%s: one message", CURRENT_FUNCTION);
+
+            bool ok = codec._receivedAppMessages.size() == 1 && codec._receivedAppMessages[0]._payload;
+            if (ok) {
+                ByteBuffer& payload = *codec._receivedAppMessages[0]._payload;
+                payload.flip();
+                ok = payload.getLimit() == count + 6u;
+                for (int8_t i = 1; i <= 3 && ok; i++)
+                    ok = payload.getByte() == i;
+                for (std::size_t i = 0; i < count && ok; i++)
+                    ok = payload.getByte() == directPattern(i);
+                for (int8_t i = 4; i <= 6 && ok; i++)
+                    ok = payload.getByte() == i;
+            }
+            testOk(ok, "%s: content", CURRENT_FUNCTION);
+        }
+    }
+
+
     void testSendConnectionLoss()
     {
         testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
@@ -2686,6 +2908,365 @@ private:
     }
 
 
+    void testSetAsideUnsent()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+
+        // the "socket" accepts one send buffer at a time
+        std::size_t bytesToSent = 3*DEFAULT_BUFFER_SIZE+1;
+        TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+        codec.setAsideUnsent();
+
+        codec._readPayload = true;
+        codec._readBuffer.reset(
+            new ByteBuffer(4*DEFAULT_BUFFER_SIZE));
+
+        codec.enqueueSendRequest(std::tr1::shared_ptr<TransportSender>(
+                                     new TransportSenderForTestSendHugeMessagePartes(
+                                         codec, bytesToSent)));
+
+        // returns when the socket is full, rather than wait for it
+        codec.processSendQueue();
+
+        testOk(codec._sendBufferFullCount == 0,
+               "%s: codec._sendBufferFullCount == 0", CURRENT_FUNCTION);
+        testOk(codec._writePollOneCount == 1,
+               "%s: codec._writePollOneCount == 1", CURRENT_FUNCTION);
+
+        // each time the socket is writable, the peer has read everything
+        std::size_t writable = 0;
+        while (codec._writePollOneCount > writable && writable < 10)
+        {
+            writable = codec._writePollOneCount;
+
+            codec._writeBuffer.flip();
+            while(codec._writeBuffer.getRemaining() > 0)
+                codec._readBuffer->putByte(codec._writeBuffer.getByte());
+            codec._writeBuffer.clear();
+
+            codec.processSendQueue();
+        }
+
+        testOk(codec._writePollOneCount == writable,
+               "%s: all sent after %u waits", CURRENT_FUNCTION, (unsigned)writable);
+
+        codec.addToReadBuffer();
+
+        codec._forcePayloadRead = bytesToSent;
+
+        codec.processRead();
+
+        testOk(codec._closedCount == 0,
+               "%s: codec._closedCount == 0", CURRENT_FUNCTION);
+        testOk(codec._receivedAppMessages.size() == 1,
+               "%s: codec._receivedAppMessages.size() == 1",
+               CURRENT_FUNCTION);
+        if (codec._receivedAppMessages.size() != 1) {
+            testSkip(2, "no message");
+            return;
+        }
+
+        PVAMessage header = codec._receivedAppMessages[0];
+        header._payload->flip();
+
+        testOk(bytesToSent == header._payload->getLimit(),
+               "%s: bytesToSent == header._payload->getLimit()",
+               CURRENT_FUNCTION);
+
+        bool ok = true;
+        for (std::size_t i = 0; i < header._payload->getLimit() && ok; i++)
+            ok = (int8_t)i == header._payload->getByte();
+        testOk(ok, "%s: content in order", CURRENT_FUNCTION);
+    }
+
+
+    void testCompression()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+
+        if (!AbstractCodec::compressionSupported()) {
+            testSkip(13, "built without LZ4");
+            return;
+        }
+
+        // normal mode.  A compressed message, followed by an uncompressed one
+        {
+            TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+            codec._readPayload = true;
+            codec.setCompression(256);
+            codec.peerCanInflate();
+
+            const std::size_t count = 2000;
+            codec.startMessage((int8_t)CMD_MONITOR, 0);
+            for (std::size_t i = 0; i < count; i++) {
+                codec.ensureBuffer(1);
+                codec.getSendBuffer()->put((int8_t)(i%16));
+            }
+            codec.endMessage();
+
+            codec.startMessage((int8_t)CMD_GET, 0);
+            codec.ensureBuffer(3);
+            for (int8_t i = 1; i <= 3; i++)
+                codec.getSendBuffer()->put(i);
+            codec.endMessage();
+
+            codec.transferToReadBuffer();
+
+            testOk(codec._readBuffer->getLimit() < count,
+                   "%s: %u bytes sent", CURRENT_FUNCTION, unsigned(codec._readBuffer->getLimit()));
+
+            // the uncompressed message is received along with the compressed one
+            codec.processRead();
+
+            testOk(codec._invalidDataStreamCount == 0,
+                   "%s: codec._invalidDataStreamCount == 0", CURRENT_FUNCTION);
+            testOk(codec._receivedAppMessages.size() == 2,
+                   "%s: codec._receivedAppMessages.size() == 2", CURRENT_FUNCTION);
+            if (codec._receivedAppMessages.size() != 2) {
+                testSkip(3, "no messages");
+            } else {
+                PVAMessage& msg = codec._receivedAppMessages[0];
+                testOk((msg._flags & 0x08) && msg._command == (int8_t)CMD_MONITOR,
+                       "%s: first message compressed", CURRENT_FUNCTION);
+
+                msg._payload->flip();
+                bool ok = msg._payload->getLimit() == count;
+                for (std::size_t i = 0; i < count && ok; i++)
+                    ok = (int8_t)(i%16) == msg._payload->getByte();
+                testOk(ok, "%s: content of %u bytes", CURRENT_FUNCTION, unsigned(msg._payload->getLimit()));
+
+                PVAMessage& next = codec._receivedAppMessages[1];
+                next._payload->flip();
+                ok = !(next._flags & 0x08) && next._payload->getLimit() == 3u;
+                for (int8_t i = 1; i <= 3 && ok; i++)
+                    ok = i == next._payload->getByte();
+                testOk(ok, "%s: following message", CURRENT_FUNCTION);
+            }
+        }
+
+        // segmented mode.  Each segment compressed, and a control message after the last
+        {
+            TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+            codec._readPayload = true;
+            codec.setCompression(256);
+            codec.peerCanInflate();
+            codec.setSegmentSize(4096);
+            codec.flushSerializeBuffer();
+
+            const std::size_t count = 10000;
+            codec.startMessage((int8_t)CMD_MONITOR, 0);
+            for (std::size_t i = 0; i < count; i++) {
+                codec.ensureBuffer(1);
+                codec.getSendBuffer()->put((int8_t)(i%16));
+            }
+            codec.endMessage();
+            codec.flushSerializeBuffer();
+
+            codec._writeBuffer.put(PVA_MAGIC);
+            codec._writeBuffer.put(PVA_VERSION);
+            codec._writeBuffer.put((int8_t)0x81);
+            codec._writeBuffer.put((int8_t)0xEE);
+            codec._writeBuffer.putInt(0);
+
+            codec.transferToReadBuffer();
+
+            codec._forcePayloadRead = count;
+            codec.processRead();
+
+            TransportStatistics stats;
+            codec.getStatistics().snapshot(stats);
+
+            testOk(stats.compressedSegments > 1,
+                   "%s: %u segments compressed", CURRENT_FUNCTION, unsigned(stats.compressedSegments));
+            testOk(stats.inflatedSegments == stats.compressedSegments,
+                   "%s: %u segments inflated", CURRENT_FUNCTION, unsigned(stats.inflatedSegments));
+            testOk(codec._invalidDataStreamCount == 0,
+                   "%s: codec._invalidDataStreamCount == 0", CURRENT_FUNCTION);
+            testOk(codec._receivedAppMessages.size() == 1 && codec._receivedControlMessages.size() == 1,
+                   "%s: one message, then the control message", CURRENT_FUNCTION);
+            if (codec._receivedAppMessages.size() != 1) {
+                testSkip(1, "no message");
+            } else {
+                PVAMessage& msg = codec._receivedAppMessages[0];
+                msg._payload->flip();
+                bool ok = msg._payload->getLimit() == count;
+                for (std::size_t i = 0; i < count && ok; i++)
+                    ok = (int8_t)(i%16) == msg._payload->getByte();
+                testOk(ok, "%s: content of %u bytes", CURRENT_FUNCTION, unsigned(msg._payload->getLimit()));
+            }
+        }
+
+        // a compressed payload larger than any we would decompress
+        {
+            TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+            codec._readBuffer->put(PVA_MAGIC);
+            codec._readBuffer->put(PVA_VERSION);
+            codec._readBuffer->put((int8_t)0x88);
+            codec._readBuffer->put((int8_t)CMD_MONITOR);
+            codec._readBuffer->putInt(0x7fffffff);
+            codec._readBuffer->putInt(16);
+            codec._readBuffer->flip();
+
+            codec.processRead();
+
+            testOk(codec._invalidDataStreamCount == 1,
+                   "%s: codec._invalidDataStreamCount == 1", CURRENT_FUNCTION);
+            testOk(codec._receivedAppMessages.size() == 0,
+                   "%s: codec._receivedAppMessages.size() == 0", CURRENT_FUNCTION);
+        }
+    }
+
+
+    // records whether the transport was congested when it is sent
+    class TransportSenderForTestSlowConsumer:
+        public TransportSender {
+    public:
+
+        TransportSenderForTestSlowConsumer(
+            TestCodec & codec, std::vector<bool> & seen):
+            _codec(codec), _seen(seen) {}
+
+        void send(epics::pvData::ByteBuffer* buffer,
+                  TransportSendControl* control)
+        {
+            _seen.push_back(_codec.sendCongested());
+            _codec.startMessage((int8_t)0x20, 0x00000000);
+            _codec.endMessage();
+        }
+
+    private:
+        TestCodec &_codec;
+        std::vector<bool> &_seen;
+    };
+
+
+    // n distinct senders, as a fair_queue holds each once
+    void enqueueSlowConsumerSenders(TestCodec & codec, std::vector<bool> & seen, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; i++)
+            codec.enqueueSendRequest(std::tr1::shared_ptr<TransportSender>(
+                                         new TransportSenderForTestSlowConsumer(codec, seen)));
+    }
+
+
+    void testSlowConsumerQueue()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+
+        {
+            // no limits
+            TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+            std::vector<bool> seen;
+            enqueueSlowConsumerSenders(codec, seen, 3);
+            codec.processSendQueue();
+            testOk(seen.size() == 3 && !seen[0],
+                   "%s: not congested without limits", CURRENT_FUNCTION);
+        }
+
+        const SlowConsumerPolicy hold[] = {SLOW_CONSUMER_SQUASH, SLOW_CONSUMER_DROP};
+        for (std::size_t p = 0; p < 2; p++)
+        {
+            const char *name = p==0 ? "squash" : "drop";
+            TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+            codec.setSlowConsumerLimits(2, 0, hold[p]);
+
+            // over the limit, the senders are told, and send
+            std::vector<bool> seen;
+            enqueueSlowConsumerSenders(codec, seen, 3);
+            codec.processSendQueue();
+            testOk(seen.size() == 3 && seen[0] && codec._closedCount == 0,
+                   "%s: %s: congested while 3 are queued", CURRENT_FUNCTION, name);
+
+            // cleared once the queue is sent
+            testOk(!codec.sendCongested() && codec._writeBuffer.getPosition() == 3*PVA_MESSAGE_HEADER_SIZE,
+                   "%s: %s: not congested once sent", CURRENT_FUNCTION, name);
+
+            // what the sender holds, or drops, is counted
+            codec.countSlowConsumer(hold[p], 5);
+            TransportStatistics stats;
+            codec.getStatistics().snapshot(stats);
+            testOk(p==0 ? stats.slowSquashed == 5 && stats.slowDropped == 0
+                        : stats.slowDropped == 5 && stats.slowSquashed == 0,
+                   "%s: %s: counted", CURRENT_FUNCTION, name);
+        }
+
+        {
+            TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+            codec.setSlowConsumerLimits(2, 0, SLOW_CONSUMER_DISCONNECT);
+
+            std::vector<bool> seen;
+            enqueueSlowConsumerSenders(codec, seen, 3);
+            try
+            {
+                codec.processSendQueue();
+                testFail("%s: disconnect: slow consumer not disconnected", CURRENT_FUNCTION);
+            }
+            catch (connection_closed_exception & ) {
+                testOk(true, "%s: disconnect: connection closed exception expected", CURRENT_FUNCTION);
+            }
+
+            testOk(codec._closedCount == 1 && seen.empty() && codec._writeBuffer.getPosition() == 0,
+                   "%s: disconnect: closed, nothing sent", CURRENT_FUNCTION);
+
+            TransportStatistics stats;
+            codec.getStatistics().snapshot(stats);
+            testOk(stats.slowDisconnects == 1,
+                   "%s: disconnect: stats.slowDisconnects == %u", CURRENT_FUNCTION,
+                   unsigned(stats.slowDisconnects));
+        }
+    }
+
+
+    void testSlowConsumerBytes()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+
+        {
+            TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+            codec.setSlowConsumerLimits(0, 1000, SLOW_CONSUMER_SQUASH);
+
+            std::vector<bool> seen;
+            codec._unackedBytes = 2000;
+            enqueueSlowConsumerSenders(codec, seen, 1);
+            codec.processSendQueue();
+            testOk(seen.size() == 1 && seen[0] && codec._closedCount == 0,
+                   "%s: squash: congested while 2000 bytes are unacknowledged", CURRENT_FUNCTION);
+
+            // the peer catches up
+            seen.clear();
+            codec._unackedBytes = 0;
+            enqueueSlowConsumerSenders(codec, seen, 1);
+            codec.processSendQueue();
+            testOk(seen.size() == 1 && !seen[0],
+                   "%s: squash: not congested once acknowledged", CURRENT_FUNCTION);
+        }
+
+        {
+            TestCodec codec(DEFAULT_BUFFER_SIZE,DEFAULT_BUFFER_SIZE);
+            codec.setSlowConsumerLimits(0, 1000, SLOW_CONSUMER_DISCONNECT);
+
+            std::vector<bool> seen;
+            codec._unackedBytes = 500;
+            enqueueSlowConsumerSenders(codec, seen, 1);
+            codec.processSendQueue();
+            testOk(seen.size() == 1 && !seen[0] && codec._closedCount == 0,
+                   "%s: disconnect: sent while under the limit", CURRENT_FUNCTION);
+
+            codec._unackedBytes = 2000;
+            enqueueSlowConsumerSenders(codec, seen, 1);
+            try
+            {
+                codec.processSendQueue();
+                testFail("%s: disconnect: slow consumer not disconnected", CURRENT_FUNCTION);
+            }
+            catch (connection_closed_exception & ) {
+                testOk(codec._closedCount == 1 && seen.size() == 1,
+                       "%s: disconnect: closed over the limit", CURRENT_FUNCTION);
+            }
+        }
+    }
+
+
     void testRecipient()
     {
         // nothing to test, depends on implementation
@@ -2936,6 +3517,157 @@ private:
         thr.exitWait();
     }
 
+
+    void testAdaptiveReceive()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+
+        const std::size_t count = 200000u;
+
+        TestCodec codec(DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_SIZE);
+        codec._readBuffer.reset(new ByteBuffer(2*count));
+        codec._readPayload = true;
+
+        // the largest window, as the minimum is clamped to it
+        codec.setAdaptiveReceive(std::numeric_limits<std::size_t>::max());
+        const std::size_t maxWindow = codec.getReceiveWindow();
+        codec.setAdaptiveReceive(0);
+        const std::size_t minWindow = codec.getReceiveWindow();
+        testDiag("window %u to %u", unsigned(minWindow), unsigned(maxWindow));
+
+        testDiag("reads which fill the window");
+        putHeader(*codec._readBuffer, (int8_t)0x80, int32_t(count));
+        for (std::size_t i = 0; i < count; i++)
+            codec._readBuffer->put(directPattern(i));
+        codec._readBuffer->flip();
+
+        codec.processRead();
+
+        std::size_t largest = 0;
+        for (std::size_t i = 0; i < codec._reads.size(); i++)
+            largest = std::max(largest, codec._reads[i].first);
+        testOk(codec._reads.size() > 4 && codec._reads[0].first == minWindow &&
+               codec._reads[3].first == minWindow && codec._reads[4].first == 2*minWindow,
+               "%s: doubled after 4 filled reads", CURRENT_FUNCTION);
+        testOk(largest == maxWindow, "%s: grew to %u", CURRENT_FUNCTION, unsigned(largest));
+
+        testDiag("reads which do not");
+        const std::size_t shortCount = 16384u;
+        codec._readLimit = 16u;
+        codec._readBuffer->clear();
+        putHeader(*codec._readBuffer, (int8_t)0x80, int32_t(shortCount));
+        for (std::size_t i = 0; i < shortCount; i++)
+            codec._readBuffer->put(directPattern(i));
+        codec._readBuffer->flip();
+
+        codec.processRead();
+
+        testOk(codec.getReceiveWindow() == minWindow, "%s: shrank to %u",
+               CURRENT_FUNCTION, unsigned(codec.getReceiveWindow()));
+
+        // each read against the rules, counting on from where the last left off
+        bool ok = true;
+        std::size_t window = minWindow;
+        unsigned filled = 0, notFilled = 0;
+        for (std::size_t i = 0; i < codec._reads.size() && ok; i++) {
+            ok = codec._reads[i].first == window;
+            if (!ok)
+                testDiag("read %u with window %u, expected %u", unsigned(i),
+                         unsigned(codec._reads[i].first), unsigned(window));
+            if (codec._reads[i].second) {
+                notFilled = 0;
+                if (++filled >= 4u) {
+                    filled = 0;
+                    window = std::min(window*2, maxWindow);
+                }
+            } else {
+                filled = 0;
+                if (++notFilled >= 64u) {
+                    notFilled = 0;
+                    window = std::max(window/2, minWindow);
+                }
+            }
+        }
+        testOk(ok, "%s: %u reads, doubling after 4 filled, halving after 64 short",
+               CURRENT_FUNCTION, unsigned(codec._reads.size()));
+
+        testOk(codec._invalidDataStreamCount == 0 && codec._closedCount == 0 &&
+               codec._receivedAppMessages.size() == 2 &&
+               codec._receivedAppMessages[0]._payload->getPosition() == count &&
+               codec._receivedAppMessages[1]._payload->getPosition() == shortCount,
+               "%s: both messages", CURRENT_FUNCTION);
+    }
+
+
+    class TransportSenderForTestCoalesce:
+        public TransportSender {
+    public:
+
+        TransportSenderForTestCoalesce(
+            TestCodec & codec, std::size_t size): _codec(codec), _size(size) {}
+
+        void send(epics::pvData::ByteBuffer* buffer,
+                  TransportSendControl* control)
+        {
+            _codec.startMessage((int8_t)0x20, 0x00000000);
+            _codec.ensureBuffer(_size);
+            for (std::size_t i = 0; i < _size; i++)
+                buffer->putByte(directPattern(i));
+            _codec.endMessage();
+        }
+
+    private:
+        TestCodec &_codec;
+        std::size_t _size;
+    };
+
+
+    void testCoalesce()
+    {
+        testDiag("BEGIN TEST %s:", CURRENT_FUNCTION);
+
+        TestCodec codec(DEFAULT_BUFFER_SIZE,
+                        DEFAULT_BUFFER_SIZE, true);
+        // a window long enough that only the byte limit can end it within the test
+        codec.setCoalescing(10.0, 200u);
+
+        std::tr1::shared_ptr<TransportSender> sender(
+            new TransportSenderForTestCoalesce(codec, 100u));
+
+        ValueHolder valueHolder(codec);
+
+        epics::pvData::Thread thr(epics::pvData::Thread::Config(&valueHolder)
+                                  .name("testCoalesce-processThread"));
+
+        valueHolder.waiter.wait();
+
+        codec.enqueueSendRequest(sender);
+        epicsThreadSleep(0.2);
+
+        testOk(codec._writeBuffer.getPosition() == 0,
+               "%s: held under the limit", CURRENT_FUNCTION);
+
+        codec.enqueueSendRequest(sender);
+
+        epicsTimeStamp start, now;
+        epicsTimeGetCurrent(&start);
+        do {
+            epicsThreadSleep(0.01);
+            epicsTimeGetCurrent(&now);
+        } while (codec._writeBuffer.getPosition() == 0 &&
+                 epicsTimeDiffInSeconds(&now, &start) < 5.0);
+
+        testOk(codec._writeBuffer.getPosition() > 0,
+               "%s: sent at the limit, before the window ends", CURRENT_FUNCTION);
+        testOk(codec._writeBuffer.getPosition() == 2*(PVA_MESSAGE_HEADER_SIZE + 100u),
+               "%s: both messages in one flush (%u)", CURRENT_FUNCTION,
+               (unsigned)codec._writeBuffer.getPosition());
+
+        codec.breakSender();
+
+        thr.exitWait();
+    }
+
 private:
 
     AtomicValue<bool> _processTreadExited;
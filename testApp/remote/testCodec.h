@@ -0,0 +1,515 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+#ifndef TESTCODEC_H
+#define TESTCODEC_H
+
+/* An AbstractCodec reading and writing in-memory buffers, shared by
+ * testCodec and benchCodec.
+ */
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <epicsUnitTest.h>
+#include <pv/byteBuffer.h>
+#include <pv/event.h>
+
+#include <pv/codec.h>
+
+using namespace epics::pvData;
+using namespace epics::pvAccess::detail;
+
+namespace epics {
+
+namespace pvAccess {
+
+struct sender_break : public connection_closed_exception
+{
+    sender_break() : connection_closed_exception("break") {}
+};
+
+struct TransportSenderDisconnect: public TransportSender {
+    void send(ByteBuffer *buffer, TransportSendControl *control)
+    {
+        control->flush(true);
+        throw sender_break();
+    }
+};
+
+struct TransportSenderSignal: public TransportSender {
+    Event *evt;
+    TransportSenderSignal(Event& evt) :evt(&evt) {}
+    void send(ByteBuffer *buffer, TransportSendControl *control)
+    {
+        evt->signal();
+    }
+};
+
+
+class PVAMessage {
+
+public:
+
+    PVAMessage(int8_t version,
+               int8_t flags,
+               int8_t command,
+               int32_t payloadSize) {
+        _version = version;
+        _flags = flags;
+        _command = command;
+        _payloadSize = payloadSize;
+    }
+
+    int8_t _version;
+    int8_t _flags;
+    int8_t _command;
+    int32_t _payloadSize;
+    std::tr1::shared_ptr<epics::pvData::ByteBuffer> _payload;
+
+    //memberwise copy constructor/assigment operator
+    //provided by the compiler
+};
+
+
+class ReadPollOneCallback {
+public:
+    virtual ~ReadPollOneCallback() {}
+    virtual void readPollOne() = 0;
+};
+
+
+class WritePollOneCallback {
+public:
+    virtual ~WritePollOneCallback() {}
+    virtual void writePollOne() = 0 ;
+};
+
+
+class TestCodec: public AbstractCodec {
+
+public:
+
+    TestCodec(
+        std::size_t receiveBufferSize,
+        std::size_t sendBufferSize,
+        bool blocking = false):
+        AbstractCodec(
+            false,
+            sendBufferSize,
+            receiveBufferSize,
+            sendBufferSize/10,
+            blocking),
+        _closedCount(0),
+        _invalidDataStreamCount(0),
+        _scheduleSendCount(0),
+        _sendCompletedCount(0),
+        _sendBufferFullCount(0),
+        _readPollOneCount(0),
+        _writePollOneCount(0),
+        _throwExceptionOnSend(false),
+        _readPayload(false),
+        _disconnected(false),
+        _forcePayloadRead(-1),
+        _unackedBytes(0),
+        _directPayload(0),
+        _directCount(0),
+        _writeLimit(0),
+        _readLimit(0),
+        _readBuffer(new ByteBuffer(receiveBufferSize)),
+        _writeBuffer(sendBufferSize),
+        _dummyAddress()
+    {
+        dummyAddr.ia.sin_family = AF_INET;
+        dummyAddr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        dummyAddr.ia.sin_port = htons(42);
+    }
+
+
+    void reset()
+    {
+        _closedCount = 0;
+        _invalidDataStreamCount = 0;
+        _scheduleSendCount = 0;
+        _sendCompletedCount = 0;
+        _sendBufferFullCount = 0;
+        _readPollOneCount = 0;
+        _writePollOneCount = 0;
+        _readBuffer->clear();
+        _writeBuffer.clear();
+        _receivedAppMessages.clear();
+        _receivedControlMessages.clear();
+    }
+
+
+    int read(ByteBuffer *buffer) {
+
+        if (_disconnected)
+            return -1;
+
+        std::size_t startPos = _readBuffer->getPosition();
+        //buffer.put(readBuffer);
+        //while (buffer.hasRemaining() && readBuffer.hasRemaining())
+        //	buffer.put(readBuffer.get());
+
+        std::size_t requested = buffer->getRemaining();
+        std::size_t bufferRemaining = requested;
+        if (_readLimit)
+            bufferRemaining = std::min(bufferRemaining, _readLimit);
+        std::size_t readBufferRemaining =
+            _readBuffer->getRemaining();
+
+        if (bufferRemaining >= readBufferRemaining) {
+
+            while(_readBuffer->getRemaining() > 0) {
+                buffer->putByte(_readBuffer->getByte());
+            }
+
+        }
+        else
+        {
+            // TODO this could be optimized
+            for (std::size_t i = 0; i < bufferRemaining; i++) {
+                buffer->putByte(_readBuffer->getByte());
+            }
+        }
+        std::size_t n = _readBuffer->getPosition() - startPos;
+        if (n > 0)
+            _reads.push_back(std::make_pair(getReceiveWindow(), n >= requested));
+        return n;
+    }
+
+
+    int write(ByteBuffer *buffer) {
+        if (_disconnected)
+            return -1;	// TODO: not by the JavaDoc API spec
+
+        if (_throwExceptionOnSend)
+            throw io_exception("text IO exception");
+
+        size_t nmove = std::min(buffer->getRemaining(), _writeBuffer.getRemaining());
+        if (_writeLimit)
+            nmove = std::min(nmove, _writeLimit);
+
+        for(size_t n=0; n<nmove; n++)
+            _writeBuffer.putByte(buffer->getByte());
+        return nmove;
+    }
+
+
+    void transferToReadBuffer()
+    {
+        flushSerializeBuffer();
+        _writeBuffer.flip();
+
+        _readBuffer->clear();
+
+        while(_writeBuffer.getRemaining() > 0) {
+            _readBuffer->putByte(_writeBuffer.getByte());
+        }
+
+        _readBuffer->flip();
+
+        _writeBuffer.clear();
+    }
+
+
+    //! As a codec driven by an IOReactor
+    void setAsideUnsent() { _setAsideUnsent = true; }
+
+
+    //! As if the OS reported _unackedBytes sent and not yet acknowledged
+    std::size_t unackedBytes() { return _unackedBytes; }
+
+
+    //! As if the peer, being this codec, announced that it can decompress
+    void peerCanInflate() { setPeerCompression(static_cast<int32>(inflateLimit())); }
+
+
+    void addToReadBuffer()
+    {
+        flushSerializeBuffer();
+        _writeBuffer.flip();
+
+        while(_writeBuffer.getRemaining() > 0) {
+            _readBuffer->putByte(_writeBuffer.getByte());
+        }
+
+        _readBuffer->flip();
+
+        _writeBuffer.clear();
+    }
+
+
+    void processControlMessage() {
+        _receivedControlMessages.push_back(
+            PVAMessage(_version, _flags, _command, _payloadSize));
+    }
+
+
+    void processApplicationMessage()  {
+        PVAMessage caMessage(_version, _flags,
+                             _command, _payloadSize);
+
+        if (_readPayload && _payloadSize > 0 && _directPayload > 0)
+        {
+            // as an array would be, through AbstractCodec
+            std::vector<char> data(_directPayload);
+            caMessage._payload.reset(new ByteBuffer(_directPayload));
+            if (AbstractCodec::directDeserialize(&_socketBuffer, &data[0], _directPayload, 1))
+            {
+                _directCount++;
+                caMessage._payload->put(&data[0], 0, _directPayload);
+            }
+        }
+        else if (_readPayload && _payloadSize > 0)
+        {
+            // no fragmentation supported by this implementation
+            std::size_t toRead =
+                _forcePayloadRead >= 0
+                ? _forcePayloadRead : _payloadSize;
+
+            caMessage._payload.reset(new ByteBuffer(toRead));
+            while (toRead > 0)
+            {
+                std::size_t partitalRead =
+                    std::min<std::size_t>(toRead, MAX_ENSURE_DATA_SIZE);
+                ensureData(partitalRead);
+                std::size_t pos = caMessage._payload->getPosition();
+
+
+                while(_socketBuffer.getRemaining() > 0) {
+                    caMessage._payload->putByte(_socketBuffer.getByte());
+                }
+
+                std::size_t read =
+                    caMessage._payload->getPosition() - pos;
+
+                toRead -= read;
+            }
+        }
+        _receivedAppMessages.push_back(caMessage);
+
+        if (_onReceive && !ReceiveBatch::defer(_onReceive))
+            _onReceive->runDeferred();
+    }
+
+
+    void readPollOne() {
+        _readPollOneCount++;
+        if (_readPollOneCallback.get() != 0)
+            _readPollOneCallback->readPollOne();
+    }
+
+
+    void writePollOne() {
+        _writePollOneCount++;
+        if (_writePollOneCallback.get() != 0)
+            _writePollOneCallback->writePollOne();
+    }
+
+
+    void close()  {
+        _closedCount++;
+    }
+
+    bool isOpen() {
+        return _closedCount == 0;
+    }
+
+    ReadMode getReadMode() {
+        return _readMode;
+    }
+
+    WriteMode getWriteMode() {
+        return _writeMode;
+    }
+
+    ByteBuffer*  getSendBuffer()
+    {
+        return &_sendBuffer;
+    }
+
+    const osiSockAddr* getLastReadBufferSocketAddress()
+    {
+        return &_dummyAddress;
+    }
+
+    void invalidDataStreamHandler() {
+        _invalidDataStreamCount++;
+    }
+
+    void scheduleSend() {
+        _scheduleSendCount++;
+    }
+
+    void sendCompleted() {
+        _sendCompletedCount++;
+    }
+
+    void breakSender() {
+        enqueueSendRequest(std::tr1::shared_ptr<TransportSender>(new TransportSenderDisconnect()));
+    }
+
+    bool terminated() {
+        return false;
+    }
+
+    void cachedSerialize(
+        const std::tr1::shared_ptr<const Field>& field,
+        ByteBuffer* buffer) {
+        field->serialize(buffer, this);
+    }
+
+    bool acquire(
+        std::tr1::shared_ptr<ClientChannelImpl> const & client)
+    {
+        return false;
+    }
+
+    bool directSerialize(
+        ByteBuffer *existingBuffer,
+        const char* toSerialize,
+        std::size_t elementCount,
+        std::size_t elementSize)  {
+        return false;
+    }
+
+    bool directDeserialize(
+        ByteBuffer *existingBuffer,
+        char* deserializeTo,
+        std::size_t elementCount,
+        std::size_t elementSize)  {
+        return false;
+    }
+
+    std::tr1::shared_ptr<const Field>
+    cachedDeserialize(ByteBuffer* buffer)
+    {
+        return std::tr1::shared_ptr<const Field>();
+    }
+
+    void release(pvAccessID clientId) {}
+
+    std::string getType() const
+    {
+        return std::string("TCP");
+    }
+
+    const osiSockAddr& getRemoteAddress() const  {
+        return dummyAddr;
+    }
+    std::string dummyRemoteName;
+    const std::string& getRemoteName() const {
+        return dummyRemoteName;
+    }
+
+    epics::pvData::int8 getRevision() const
+    {
+        return PVA_PROTOCOL_REVISION;
+    }
+
+    std::size_t getReceiveBufferSize() const  {
+        return 16384;
+    }
+
+    epics::pvData::int16 getPriority() const  {
+        return 0;
+    }
+
+    std::size_t getSocketReceiveBufferSize() const
+    {
+        return 16384;
+    }
+
+    void setRemoteRevision(epics::pvData::int8 revision)  {}
+
+    void setRemoteTransportSocketReceiveBufferSize(
+        std::size_t socketReceiveBufferSize)  {}
+
+    void setRemoteTransportReceiveBufferSize(
+        std::size_t remoteTransportReceiveBufferSize)  {}
+
+    void changedTransport() {}
+
+    void flushSendQueue() { };
+
+    bool verify(epics::pvData::int32 timeoutMs) {
+        return true;
+    }
+
+    void verified(epics::pvData::Status const &) {}
+
+    void aliveNotification() {}
+
+    void authNZMessage(epics::pvData::PVField::shared_pointer const & data) {}
+
+    virtual std::tr1::shared_ptr<SecuritySession> getSecuritySession() const
+    {
+        return std::tr1::shared_ptr<SecuritySession>();
+    }
+
+
+
+    bool isClosed() {
+        return false;
+    }
+
+
+    osiSockAddr dummyAddr;
+    std::size_t _closedCount;
+    std::size_t _invalidDataStreamCount;
+    std::size_t _scheduleSendCount;
+    std::size_t _sendCompletedCount;
+    std::size_t _sendBufferFullCount;
+    std::size_t _readPollOneCount;
+    std::size_t _writePollOneCount;
+    bool _throwExceptionOnSend;
+    bool _readPayload;
+    bool _disconnected;
+    int _forcePayloadRead;
+    std::size_t _unackedBytes;
+    // bytes of each payload read by AbstractCodec::directDeserialize(), if non-zero
+    std::size_t _directPayload;
+    std::size_t _directCount;
+    // if non-zero, write() takes at most this many bytes, as a socket with a full buffer
+    std::size_t _writeLimit;
+    // likewise for read(), as a socket with little received
+    std::size_t _readLimit;
+    // of each read() which returned data, the receive window and whether it was filled
+    std::vector<std::pair<std::size_t, bool> > _reads;
+
+    epics::auto_ptr<epics::pvData::ByteBuffer> _readBuffer;
+    epics::pvData::ByteBuffer _writeBuffer;
+
+    std::vector<PVAMessage> _receivedAppMessages;
+    std::vector<PVAMessage> _receivedControlMessages;
+
+    // run, or deferred, after each application message
+    std::tr1::shared_ptr<ReceiveBatch::Deferred> _onReceive;
+
+    epics::auto_ptr<ReadPollOneCallback> _readPollOneCallback;
+    epics::auto_ptr<WritePollOneCallback> _writePollOneCallback;
+
+    osiSockAddr _dummyAddress;
+
+protected:
+
+    void sendBufferFull(int tries) {
+        testDiag("sendBufferFull tries=%d", tries);
+        if(tries>10) // arbitrary limit
+            testAbort("Stuck");
+        _sendBufferFullCount++;
+        _writeOpReady = false;
+        _writeMode = WAIT_FOR_READY_SIGNAL;
+        this->writePollOne();
+        _writeMode = PROCESS_SEND_QUEUE;
+    }
+};
+
+}
+}
+
+#endif // TESTCODEC_H
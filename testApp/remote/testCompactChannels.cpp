@@ -0,0 +1,79 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/reftrack.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("value", pvd::pvInt)
+                                  ->createStructure());
+
+void testCompact()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(type);
+    pvas::StaticProvider prov("compact:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .add("EPICS_PVA_COMPACT_CHANNELS", "YES")
+                             .push_map()
+                             .build());
+
+    const size_t before = epics::readRefCounter("InternalChannelImpl (Bytes)");
+
+    // distinct options, so distinct channels of the same name
+    pvac::ClientChannel::Options other;
+    other.priority = 1;
+    pvac::ClientChannel first(cli.connect("tst:pv")),
+                        second(cli.connect("tst:pv", other));
+
+    testOk1(!!first.get(5.0));
+    testOk1(!!second.get(5.0));
+    testOk1(first.getChannel()!=second.getChannel());
+    testOk1(first.getChannel()->getChannelName()=="tst:pv" && second.getChannel()->getChannelName()=="tst:pv");
+
+    const size_t after = epics::readRefCounter("InternalChannelImpl (Bytes)");
+    testOk(after>before, "%u bytes for 2 channels", unsigned(after-before));
+}
+
+} // namespace
+
+MAIN(testCompactChannels)
+{
+    testPlan(5);
+    try {
+        testCompact();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+// Server side.  Holds the receive thread of the connection in onPut() until released
+struct Stall : public pvas::SharedPV::Handler
+{
+    POINTER_DEFINITIONS(Stall);
+    epicsEvent entered, release;
+    virtual ~Stall() {}
+    virtual void onPut(const pvas::SharedPV::shared_pointer& pv, pvas::Operation& op) OVERRIDE FINAL
+    {
+        entered.signal();
+        release.wait(10.0);
+        op.complete();
+    }
+};
+
+struct Client : public pvac::ClientChannel::ConnectCallback,
+                public pvac::ClientChannel::PutCallback
+{
+    epicsMutex lock;
+    epicsEvent changed, done;
+    bool connected;
+    Client() :connected(false) {}
+    virtual ~Client() {}
+
+    virtual void connectEvent(const pvac::ConnectEvent& evt) OVERRIDE FINAL
+    {
+        {
+            Guard G(lock);
+            connected = evt.connected;
+        }
+        changed.signal();
+    }
+
+    // wait for the connection state to become expect
+    bool waitFor(bool expect, double timeout)
+    {
+        epicsTimeStamp start, now;
+        epicsTimeGetCurrent(&start);
+        while(true) {
+            {
+                Guard G(lock);
+                if(connected==expect)
+                    return true;
+            }
+            epicsTimeGetCurrent(&now);
+            double remaining = timeout - epicsTimeDiffInSeconds(&now, &start);
+            if(remaining<=0.0)
+                return false;
+            changed.wait(remaining);
+        }
+    }
+
+    virtual void putBuild(const pvd::StructureConstPtr& build, pvac::ClientChannel::PutCallback::Args& args) OVERRIDE FINAL
+    {
+        pvd::PVStructurePtr root(pvd::getPVDataCreate()->createPVStructure(build));
+        pvd::PVScalarPtr value(root->getSubFieldT<pvd::PVScalar>("value"));
+        value->putFrom<pvd::int32>(1);
+        args.tosend.set(value->getFieldOffset());
+        args.root = root;
+    }
+
+    virtual void putDone(const pvac::PutEvent& evt) OVERRIDE FINAL
+    {
+        done.signal();
+    }
+};
+
+void testUnresponsive()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    Stall::shared_pointer stall(new Stall);
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::build(stall));
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("echo:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .add("EPICS_PVA_ECHO_PERIOD", "0.2")
+                             .push_map()
+                             .build());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+
+    Client client;
+    chan.addConnectListener(&client);
+
+    chan.get(5.0);
+    testOk(client.waitFor(true, 5.0), "connected");
+
+    // idle, but answering probes
+    epicsThreadSleep(1.0);
+    testOk(client.waitFor(true, 0.0), "still connected while idle");
+
+    pvac::Operation op(chan.put(&client));
+    testOk(stall->entered.wait(5.0), "server stalled");
+
+    testOk(client.waitFor(false, 3.0), "unresponsive, so disconnected");
+
+    stall->release.signal();
+    testOk(client.waitFor(true, 3.0), "responsive again, so connected");
+    testOk(client.done.wait(5.0), "put completes on the same connection");
+
+    chan.removeConnectListener(&client);
+}
+
+} // namespace
+
+MAIN(testEchoProbe)
+{
+    testPlan(6);
+    try {
+        testUnresponsive();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
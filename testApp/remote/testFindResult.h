@@ -0,0 +1,29 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+#ifndef TESTFINDRESULT_H
+#define TESTFINDRESULT_H
+
+/* Result of ChannelProvider::channelFind(), shared by the tests of providers
+ * which answer it synchronously.
+ */
+
+#include <compilerDependencies.h>
+
+#include <pv/pvAccess.h>
+
+struct FindResult : public epics::pvAccess::ChannelFindRequester
+{
+    bool found;
+    FindResult() :found(false) {}
+    virtual ~FindResult() {}
+    virtual void channelFindResult(const epics::pvData::Status& status,
+                                   epics::pvAccess::ChannelFind::shared_pointer const & channelFind,
+                                   bool wasFound) OVERRIDE FINAL
+    {
+        found = status.isSuccess() && wasFound;
+    }
+};
+
+#endif // TESTFINDRESULT_H
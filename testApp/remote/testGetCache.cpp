@@ -0,0 +1,121 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/security.h>
+#include <pv/serverContext.h>
+#include <pv/serverChannelImpl.h>
+#include <pv/current_function.h>
+#include <pv/createRequest.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("value", pvd::pvInt)
+                                  ->add("other", pvd::pvString)
+                                  ->createStructure());
+
+void testResponses()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(type);
+    pvas::StaticProvider prov("cache:test");
+    prov.add("tst:pv", pv);
+
+    pva::Channel::shared_pointer chan(prov.provider()->createChannel("tst:pv"));
+    pva::ServerChannel sc(chan, pva::DefaultChannelRequester::build(), 1, 2,
+                          pva::NoSecurityPlugin::INSTANCE);
+
+    // unknown
+    testOk1(!sc.getResponses(0u));
+
+    pva::SharedUpdate::shared_pointer five(sc.getResponses(5u));
+    testOk1(!!five && sc.getResponses(5u)==five);
+    // late
+    testOk1(!sc.getResponses(4u));
+
+    pva::SharedUpdate::shared_pointer six(sc.getResponses(6u));
+    testOk1(!!six && six!=five && !sc.getResponses(5u));
+
+    sc.destroy();
+    testOk1(!sc.getResponses(7u));
+}
+
+pvd::int32 getValue(pvac::ClientChannel& chan)
+{
+    return chan.get(5.0)->getSubFieldT<pvd::PVInt>("value")->get();
+}
+
+void testRemote()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(type);
+    pvas::StaticProvider prov("cache:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .push_map()
+                             .build());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    pvd::PVIntPtr value(inst->getSubFieldT<pvd::PVInt>("value"));
+    changed.set(value->getFieldOffset());
+
+    value->put(1);
+    pv->post(*inst, changed);
+
+    // unchanged, so all but the first are sent as serialized for the first
+    testEqual(getValue(chan), 1);
+    testEqual(getValue(chan), 1);
+
+    value->put(2);
+    pv->post(*inst, changed);
+    testEqual(getValue(chan), 2);
+
+    // a different form of the same generation
+    pvd::PVStructure::const_shared_pointer partial(chan.get(5.0, pvd::createRequest("field(other)")));
+    testOk1(partial && !partial->getSubField("value") && !!partial->getSubField("other"));
+    testEqual(getValue(chan), 2);
+}
+
+} // namespace
+
+MAIN(testGetCache)
+{
+    testPlan(10);
+    try {
+        testResponses();
+        testRemote();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
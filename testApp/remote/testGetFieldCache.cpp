@@ -0,0 +1,166 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <sstream>
+
+#include <epicsEvent.h>
+#include <epicsThread.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/security.h>
+#include <pv/serverChannelImpl.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+void testCache()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvd::StructureConstPtr typeA(pvd::getFieldCreate()->createFieldBuilder()
+                                 ->add("value", pvd::pvInt)
+                                 ->createStructure()),
+                           typeB(pvd::getFieldCreate()->createFieldBuilder()
+                                 ->add("value", pvd::pvDouble)
+                                 ->createStructure());
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(typeA);
+    pvas::StaticProvider prov("cache:test");
+    prov.add("tst:pv", pv);
+
+    pva::Channel::shared_pointer chan(prov.provider()->createChannel("tst:pv"));
+    pva::ServerChannel sc(chan, pva::DefaultChannelRequester::build(), 1, 2,
+                          pva::NoSecurityPlugin::INSTANCE);
+
+    testOk1(!sc.cachedField(""));
+    sc.cacheField("", typeA);
+    testOk1(sc.cachedField("")==typeA);
+    testOk1(!sc.cachedField("value"));
+
+    // bounded
+    for(size_t i=0; i<pva::ServerChannel::MAX_CACHED_FIELDS; i++) {
+        std::ostringstream name;
+        name<<"f"<<i;
+        sc.cacheField(name.str(), typeA);
+    }
+    testOk1(!!sc.cachedField("f14"));
+    testOk1(!sc.cachedField("f15"));
+    // replacing is still allowed
+    sc.cacheField("", typeB);
+    testOk1(sc.cachedField("")==typeB);
+
+    sc.cacheField("value", pvd::FieldConstPtr());
+    testOk1(!sc.cachedField("value"));
+
+    // as when the provider disconnects the channel, eg. SharedPV::close()
+    sc.destroy();
+    testOk1(!sc.cachedField(""));
+    sc.cacheField("", typeA);
+    testOk1(!sc.cachedField(""));
+}
+
+struct FieldWaiter : public pva::GetFieldRequester
+{
+    epicsEvent done;
+    bool called;
+    pvd::FieldConstPtr field;
+    FieldWaiter() :called(false) {}
+    virtual ~FieldWaiter() {}
+    virtual std::string getRequesterName() OVERRIDE FINAL { return "FieldWaiter"; }
+    virtual void getDone(const pvd::Status& status, pvd::FieldConstPtr const & field) OVERRIDE FINAL
+    {
+        this->field = field;
+        called = true;
+        done.signal();
+    }
+};
+
+void testClientCache()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvd::StructureConstPtr typeA(pvd::getFieldCreate()->createFieldBuilder()
+                                 ->add("value", pvd::pvInt)
+                                 ->createStructure()),
+                           typeB(pvd::getFieldCreate()->createFieldBuilder()
+                                 ->add("value", pvd::pvDouble)
+                                 ->createStructure());
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(typeA);
+    pvas::StaticProvider prov("cache:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .push_map()
+                             .build());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+    testOk1(!!chan.get(5.0));
+    pva::Channel::shared_pointer raw(chan.getChannel());
+
+    std::tr1::shared_ptr<FieldWaiter> first(new FieldWaiter);
+    raw->getField(first, "");
+    testOk1(first->done.wait(5.0) && first->field && first->field->getType()==pvd::structure);
+
+    // from the cache, before getField() returns
+    std::tr1::shared_ptr<FieldWaiter> second(new FieldWaiter);
+    raw->getField(second, "");
+    testOk1(second->called && second->field==first->field);
+
+    // the type changes across a disconnect
+    pv->close();
+    pv->open(typeB);
+
+    pvd::ScalarType vtype = pvd::pvInt;
+    for(unsigned i=0; i<50u && vtype==pvd::pvInt; i++) {
+        try {
+            vtype = chan.get(1.0)->getSubFieldT<pvd::PVScalar>("value")->getScalar()->getScalarType();
+        } catch(std::exception& e) {
+            testDiag("get() fails: %s", e.what());
+            epicsThreadSleep(0.1);
+        }
+    }
+    testOk1(vtype==pvd::pvDouble);
+
+    std::tr1::shared_ptr<FieldWaiter> third(new FieldWaiter);
+    raw->getField(third, "");
+    testOk1(third->done.wait(5.0) && third->field && *third->field==*typeB);
+}
+
+} // namespace
+
+MAIN(testGetFieldCache)
+{
+    testPlan(14);
+    try {
+        testCache();
+        testClientCache();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,374 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <vector>
+
+#include <string.h>
+
+#include <osiSock.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/ioReactor.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+// a connected pair of non-blocking TCP sockets through the loopback interface
+bool socketPair(SOCKET *a, SOCKET *b)
+{
+    osiSockAddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.ia.sin_family = AF_INET;
+    addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.ia.sin_port = 0;
+
+    SOCKET listener = epicsSocketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(listener==INVALID_SOCKET)
+        return false;
+
+    osiSocklen_t len = sizeof(addr);
+    bool ok = ::bind(listener, &addr.sa, sizeof(addr.ia))==0
+            && ::listen(listener, 1)==0
+            && ::getsockname(listener, &addr.sa, &len)==0;
+
+    *a = *b = INVALID_SOCKET;
+    if(ok) {
+        *a = epicsSocketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        ok = *a!=INVALID_SOCKET && ::connect(*a, &addr.sa, sizeof(addr.ia))==0;
+    }
+    if(ok) {
+        osiSockAddr peer;
+        len = sizeof(peer);
+        *b = epicsSocketAccept(listener, &peer.sa, &len);
+        ok = *b!=INVALID_SOCKET;
+    }
+    epicsSocketDestroy(listener);
+
+    osiSockIoctl_t yes = true;
+    if(ok)
+        ok = socket_ioctl(*a, FIONBIO, &yes)==0 && socket_ioctl(*b, FIONBIO, &yes)==0;
+    if(!ok) {
+        if(*a!=INVALID_SOCKET)
+            epicsSocketDestroy(*a);
+        if(*b!=INVALID_SOCKET)
+            epicsSocketDestroy(*b);
+    }
+    return ok;
+}
+
+// discard what is readable.  @returns bytes read
+size_t drain(SOCKET sock)
+{
+    char buf[4096];
+    size_t total = 0;
+    int n;
+    while((n = ::recv(sock, buf, sizeof(buf), 0)) > 0)
+        total += n;
+    return total;
+}
+
+struct Counter : public pva::IOReactor::Handler
+{
+    epicsMutex lock;
+    epicsEvent wakeup;
+    unsigned reads, writes;
+    // readReady() calls scheduleRead() this many more times
+    unsigned rearm;
+    SOCKET sock;
+    pva::IOReactor *reactor;
+    pva::IOReactor::key_type key;
+
+    Counter(SOCKET sock, pva::IOReactor *reactor)
+        :reads(0u), writes(0u), rearm(0u), sock(sock), reactor(reactor), key(0u)
+    {}
+    virtual ~Counter() {}
+
+    virtual void readReady() OVERRIDE FINAL
+    {
+        drain(sock);
+        {
+            Guard G(lock);
+            reads++;
+            if(rearm) {
+                rearm--;
+                reactor->scheduleRead(key);
+            }
+        }
+        wakeup.signal();
+    }
+    virtual void writeReady() OVERRIDE FINAL
+    {
+        {
+            Guard G(lock);
+            writes++;
+        }
+        wakeup.signal();
+    }
+
+    unsigned count(bool write)
+    {
+        Guard G(lock);
+        return write ? writes : reads;
+    }
+    // wait until count(write) reaches n
+    bool waitFor(bool write, unsigned n, double timeout)
+    {
+        epicsTimeStamp start, now;
+        epicsTimeGetCurrent(&start);
+        while(count(write) < n) {
+            epicsTimeGetCurrent(&now);
+            double left = timeout - epicsTimeDiffInSeconds(&now, &start);
+            if(left<=0.0)
+                return false;
+            wakeup.wait(left);
+        }
+        return true;
+    }
+};
+
+void testScheduleRead()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::IOReactor::shared_pointer reactor(pva::IOReactor::create("testIO", 1u));
+    SOCKET a1, b1, a2, b2;
+    if(!socketPair(&a1, &b1) || !socketPair(&a2, &b2)) {
+        testSkip(3, "no loopback sockets");
+        return;
+    }
+
+    std::tr1::shared_ptr<Counter> busy(new Counter(a1, reactor.get())),
+                                  other(new Counter(a2, reactor.get()));
+    reactor->add(a1, busy, &busy->key);
+    reactor->add(a2, other, &other->key);
+
+    // nothing to read
+    reactor->scheduleRead(busy->key);
+    testOk(busy->waitFor(false, 1u, 5.0), "readReady() without input");
+
+    // the socket of another handler isn't starved by one which re-arms itself
+    {
+        Guard G(busy->lock);
+        busy->rearm = 1000000u;
+    }
+    reactor->scheduleRead(busy->key);
+    testOk1(busy->waitFor(false, 10u, 5.0));
+
+    (void)::send(b2, "x", 1, 0);
+    testOk(other->waitFor(false, 1u, 5.0), "readReady() of another socket meanwhile");
+
+    {
+        Guard G(busy->lock);
+        busy->rearm = 0u;
+    }
+    reactor->remove(busy->key);
+    reactor->remove(other->key);
+    reactor->sync(busy->key);
+    reactor->sync(other->key);
+    reactor->close();
+
+    epicsSocketDestroy(a1);
+    epicsSocketDestroy(b1);
+    epicsSocketDestroy(a2);
+    epicsSocketDestroy(b2);
+}
+
+void testWaitWritable()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::IOReactor::shared_pointer reactor(pva::IOReactor::create("testIO", 1u));
+    SOCKET a, b;
+    if(!socketPair(&a, &b)) {
+        testSkip(4, "no loopback sockets");
+        return;
+    }
+
+    std::tr1::shared_ptr<Counter> handler(new Counter(a, reactor.get()));
+    reactor->add(a, handler, &handler->key);
+
+    // fill the socket
+    std::vector<char> junk(4096, 'x');
+    size_t sent = 0;
+    int n;
+    while((n = ::send(a, &junk[0], junk.size(), 0)) > 0)
+        sent += n;
+    testDiag("%zu bytes fill the socket", sent);
+
+    reactor->waitWritable(handler->key);
+    epicsThreadSleep(0.2);
+    testOk(handler->count(true)==0u, "no writeReady() while full");
+
+    // the peer reads everything
+    size_t received = 0;
+    while(received < sent && !handler->count(true)) {
+        received += drain(b);
+        epicsThreadSleep(0.01);
+    }
+    testOk(handler->waitFor(true, 1u, 5.0), "writeReady() once writable");
+
+    epicsThreadSleep(0.2);
+    testOk(handler->count(true)==1u, "only once");
+
+    reactor->waitWritable(handler->key);
+    testOk(handler->waitFor(true, 2u, 5.0), "writeReady() when already writable");
+
+    reactor->remove(handler->key);
+    reactor->sync(handler->key);
+    reactor->close();
+
+    epicsSocketDestroy(a);
+    epicsSocketDestroy(b);
+}
+
+pva::ServerContext::shared_pointer startServer(pvas::StaticProvider& prov)
+{
+    // one I/O thread shared by all connections
+    return pva::ServerContext::create(pva::ServerContext::Config()
+                                      .config(pva::ConfigurationBuilder()
+                                              .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                              .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                              .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                              .add("EPICS_PVA_SERVER_PORT", "0")
+                                              .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                              .add("EPICS_PVAS_IO_THREADS", "1")
+                                              .push_map()
+                                              .build())
+                                      .provider(prov.provider()));
+}
+
+void testStalledPeer()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("reactor:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(startServer(prov));
+
+    // a peer which sends the start of a message, and no more
+    SOCKET stalled = epicsSocketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    osiSockAddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.ia.sin_family = AF_INET;
+    addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.ia.sin_port = htons(server->getServerPort());
+    if(stalled==INVALID_SOCKET || ::connect(stalled, &addr.sa, sizeof(addr.ia))!=0) {
+        testSkip(2, "unable to connect");
+        return;
+    }
+    // big endian header of an application message with a 1000 byte payload, and 10 bytes of it
+    const char partial[18] = {(char)0xca, 2, (char)0x80, 10, 0, 0, 0x03, (char)0xe8};
+    testOk1(::send(stalled, partial, sizeof(partial), 0)==(int)sizeof(partial));
+    epicsThreadSleep(0.5);
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .push_map()
+                             .build());
+
+    bool done;
+    try {
+        cli.connect("tst:pv").get(5.0);
+        done = true;
+    } catch(std::exception& e) {
+        testDiag("get() fails: %s", e.what());
+        done = false;
+    }
+    testOk(done, "get() through the I/O thread shared with a stalled peer");
+
+    epicsSocketDestroy(stalled);
+}
+
+void testLargeArray()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    // many segments, more than the sockets hold
+    const size_t N = 4u*1024u*1024u;
+    pvd::PVStructurePtr initial(pvd::getPVDataCreate()->createPVStructure(
+                                    pvd::getFieldCreate()->createFieldBuilder()
+                                    ->addArray("value", pvd::pvDouble)
+                                    ->createStructure()));
+    {
+        pvd::PVDoubleArray::svector temp(N);
+        for(size_t i=0; i<N; i++)
+            temp[i] = double(i);
+        initial->getSubFieldT<pvd::PVDoubleArray>("value")->replace(pvd::freeze(temp));
+    }
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(*initial);
+
+    pvas::StaticProvider prov("reactor:test");
+    prov.add("tst:array", pv);
+
+    pva::ServerContext::shared_pointer server(startServer(prov));
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .add("EPICS_PVA_IO_THREADS", "1")
+                             .push_map()
+                             .build());
+    pvac::ClientChannel chan(cli.connect("tst:array"));
+
+    for(unsigned i=0; i<2u; i++) {
+        pvd::PVStructure::const_shared_pointer result;
+        try {
+            result = chan.get(10.0);
+        } catch(std::exception& e) {
+            testDiag("get() fails: %s", e.what());
+        }
+        pvd::PVDoubleArray::const_svector value;
+        if(result)
+            value = result->getSubFieldT<pvd::PVDoubleArray>("value")->view();
+
+        bool ok = value.size()==N;
+        for(size_t j=0; j<value.size() && ok; j++)
+            ok = value[j]==double(j);
+        testOk(ok, "get() #%u of %zu elements", i, value.size());
+    }
+}
+
+} // namespace
+
+MAIN(testIOReactor)
+{
+    testPlan(11);
+    if(!pva::IOReactor::isSupported()) {
+        testSkip(11, "No IOReactor on this target");
+        return testDone();
+    }
+    try {
+        testScheduleRead();
+        testWaitWritable();
+        testStalledPeer();
+        testLargeArray();
+    }catch(std::exception& e){
+        testAbort("Unhandled exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,182 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <vector>
+
+#include <string.h>
+
+#include <osiSock.h>
+#include <epicsThread.h>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <pv/ioUring.h>
+
+#ifdef __linux__
+#  include <sys/uio.h>
+#endif
+
+using epics::pvAccess::IOUring;
+
+namespace {
+
+#ifdef __linux__
+
+// receives count bytes through a ring, on its own thread
+struct Receiver : public epicsThreadRunable
+{
+    IOUring& ring;
+    std::vector<char> buf;
+    size_t count, received;
+    int last;
+    epicsThread thread;
+
+    Receiver(IOUring& ring, size_t count)
+        :ring(ring)
+        ,buf(count)
+        ,count(count)
+        ,received(0u)
+        ,last(0)
+        ,thread(*this, "receiver", epicsThreadGetStackSize(epicsThreadStackSmall), epicsThreadPriorityMedium)
+    {
+        thread.start();
+    }
+    virtual ~Receiver() {}
+    virtual void run()
+    {
+        while(received<count) {
+            last = ring.recv(&buf[received], count-received);
+            if(last<=0)
+                break;
+            received += size_t(last);
+        }
+    }
+};
+
+// a connected pair of TCP sockets through loopback
+void socketPair(SOCKET *client, SOCKET *server)
+{
+    osiSockAddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.ia.sin_family = AF_INET;
+    addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    SOCKET listener = epicsSocketCreate(AF_INET, SOCK_STREAM, 0);
+    osiSocklen_t len = sizeof(addr.ia);
+    if(listener==INVALID_SOCKET
+            || bind(listener, &addr.sa, sizeof(addr.ia))
+            || listen(listener, 1)
+            || getsockname(listener, &addr.sa, &len))
+        testAbort("Unable to listen");
+
+    *client = epicsSocketCreate(AF_INET, SOCK_STREAM, 0);
+    if(*client==INVALID_SOCKET || connect(*client, &addr.sa, sizeof(addr.ia)))
+        testAbort("Unable to connect");
+    len = sizeof(addr.ia);
+    *server = epicsSocketAccept(listener, &addr.sa, &len);
+    if(*server==INVALID_SOCKET)
+        testAbort("Unable to accept");
+    epicsSocketDestroy(listener);
+}
+
+void testTransfer()
+{
+    testDiag("testTransfer");
+
+    SOCKET client, server;
+    socketPair(&client, &server);
+
+    IOUring::shared_pointer tx(IOUring::create(client)), rx(IOUring::create(server));
+    testOk(!!tx && !!rx, "create()");
+    if(!tx || !rx) {
+        testSkip(9, "No ring");
+        epicsSocketDestroy(client);
+        epicsSocketDestroy(server);
+        return;
+    }
+
+    // large enough to fill the socket buffers
+    std::vector<char> data(4u<<20);
+    for(size_t i=0; i<data.size(); i++)
+        data[i] = char(i*7 + i/4096);
+
+    // pinned pages count against RLIMIT_MEMLOCK
+    if(tx->registerBuffer(&data[0], data.size()))
+        testPass("registerBuffer()");
+    else
+        testSkip(1, "Unable to register, sending without");
+    tx->setZeroCopyMin(64u*1024u);
+
+    {
+        Receiver R(*rx, 100u);
+        testOk1(tx->send(&data[0], 100u)==100);
+        R.thread.exitWait();
+        testOk1(R.received==100u && memcmp(&R.buf[0], &data[0], 100u)==0);
+    }
+
+    {
+        // from the registered buffer, and from elsewhere
+        std::vector<char> tail(data.begin(), data.begin()+300000);
+        Receiver R(*rx, data.size()+tail.size());
+        size_t sent = 0u;
+        while(sent<data.size()) {
+            int n = tx->send(&data[sent], data.size()-sent);
+            if(n<=0)
+                break;
+            sent += size_t(n);
+        }
+        testOk(sent==data.size(), "sent %u", unsigned(sent));
+
+        struct iovec iov;
+        iov.iov_base = &tail[0];
+        iov.iov_len = tail.size();
+        testOk1(tx->sendv(&iov, 1u)==int(tail.size()));
+
+        R.thread.exitWait();
+        testOk(R.received==data.size()+tail.size()
+               && memcmp(&R.buf[0], &data[0], data.size())==0
+               && memcmp(&R.buf[data.size()], &tail[0], tail.size())==0,
+               "received %u", unsigned(R.received));
+    }
+
+    if(IOUring::zeroCopySupported())
+        testOk(tx->zeroCopySends()>=2u, "zero-copy sends %u", unsigned(tx->zeroCopySends()));
+    else
+        testSkip(1, "No zero-copy send");
+    testOk1(!tx->zeroCopyPending());
+
+    {
+        // as done by close() of a connection
+        Receiver R(*rx, 1u);
+        epicsThreadSleep(0.1);
+        shutdown(server, SHUT_RDWR);
+        R.thread.exitWait();
+        testOk(R.received==0u && R.last==0, "shutdown() ends a recv() %d", R.last);
+    }
+
+    epicsSocketDestroy(client);
+    epicsSocketDestroy(server);
+}
+
+#else
+void testTransfer() {}
+#endif // __linux__
+
+} // namespace
+
+MAIN(testIOUring)
+{
+    testPlan(10);
+    osiSockAttach();
+    if(!IOUring::isSupported()) {
+        testSkip(10, "io_uring not supported");
+    } else {
+        testTransfer();
+    }
+    osiSockRelease();
+    return testDone();
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <vector>
+#include <string>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsThread.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/client.h>
+#include <pva/sharedstate.h>
+#include <pva/lazy.h>
+#include <pv/current_function.h>
+#include <pv/pvAccess.h>
+
+#include "testFindResult.h"
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("value", pvd::pvInt)
+                                  ->createStructure());
+
+struct Maker : public pvas::LazyProvider::Handler
+{
+    epicsMutex mutex;
+    std::vector<std::string> made, evicted;
+
+    virtual ~Maker() {}
+
+    virtual bool hasChannel(const std::string& name) OVERRIDE FINAL
+    {
+        return name.compare(0, 5, "lazy:")==0;
+    }
+
+    virtual pvas::SharedPV::shared_pointer materialize(const std::string& name) OVERRIDE FINAL
+    {
+        pvas::SharedPV::shared_pointer pv;
+        if(!hasChannel(name))
+            return pv;
+        pv = pvas::SharedPV::buildMailbox();
+        pv->open(type);
+        Guard G(mutex);
+        made.push_back(name);
+        return pv;
+    }
+
+    virtual void evict(const std::string& name, const pvas::SharedPV::shared_pointer& pv) OVERRIDE FINAL
+    {
+        Guard G(mutex);
+        evicted.push_back(name);
+    }
+};
+
+bool found(pvas::LazyProvider& lazy, const std::string& name)
+{
+    std::tr1::shared_ptr<FindResult> find(new FindResult);
+    lazy.provider()->channelFind(name, find);
+    return find->found;
+}
+
+// open a channel to name, get, and close it
+void touch(pvas::LazyProvider& lazy, const std::string& name)
+{
+    pvac::ClientProvider cli(lazy.provider());
+    cli.connect(name).get();
+    cli.disconnect();
+}
+
+void testMaterialize()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<Maker> maker(new Maker);
+    pvas::LazyProvider lazy("lazy", maker);
+    pvas::LazyProvider::Stats stats;
+
+    testOk1(found(lazy, "lazy:a"));
+    testOk1(!found(lazy, "other"));
+
+    // searches create nothing
+    lazy.getStats(stats);
+    testEqual(stats.materialized, 0u);
+
+    {
+        pvac::ClientProvider cliA(lazy.provider()),
+                             cliB(lazy.provider());
+        pvac::ClientChannel chanA(cliA.connect("lazy:a")),
+                            chanB(cliB.connect("lazy:a"));
+
+        chanA.put().set<pvd::int32>("value", 42).exec();
+        testEqual(chanB.get()->getSubFieldT<pvd::PVInt>("value")->get(), 42);
+
+        lazy.getStats(stats);
+        testEqual(stats.materialized, 1u);
+        testEqual(stats.inuse, 1u);
+        testEqual(stats.created, 1u);
+
+        cliA.disconnect();
+        cliB.disconnect();
+    }
+
+    lazy.getStats(stats);
+    testEqual(stats.inuse, 0u);
+    testOk(stats.idleBytes>0u, "idleBytes %u", unsigned(stats.idleBytes));
+
+    // within idleHold
+    lazy.sweep();
+    lazy.getStats(stats);
+    testEqual(stats.materialized, 1u);
+
+    {
+        pvac::ClientProvider cli(lazy.provider());
+        testEqual(cli.connect("lazy:a").get()->getSubFieldT<pvd::PVInt>("value")->get(), 42);
+        cli.disconnect();
+    }
+
+    Guard G(maker->mutex);
+    testEqual(maker->made.size(), 1u);
+    testEqual(maker->evicted.size(), 0u);
+}
+
+void testIdle()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<Maker> maker(new Maker);
+    pvas::LazyProvider::Config conf;
+    conf.idleHold = 0.1;
+    conf.warmPool = 1u;
+    pvas::LazyProvider lazy("lazy", maker, conf);
+    pvas::LazyProvider::Stats stats;
+
+    touch(lazy, "lazy:a");
+    touch(lazy, "lazy:b");
+    touch(lazy, "lazy:c");
+
+    lazy.getStats(stats);
+    testEqual(stats.materialized, 3u);
+
+    epicsThreadSleep(conf.idleHold+0.1);
+    lazy.sweep();
+
+    // the most recently used is kept
+    lazy.getStats(stats);
+    testEqual(stats.materialized, 1u);
+    testEqual(stats.evicted, 2u);
+    {
+        Guard G(maker->mutex);
+        testOk(maker->evicted.size()==2u && maker->evicted[0]=="lazy:a" && maker->evicted[1]=="lazy:b",
+               "evicted oldest first");
+    }
+
+    // asked for again
+    touch(lazy, "lazy:a");
+    lazy.getStats(stats);
+    testEqual(stats.created, 4u);
+}
+
+void testBudget()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<Maker> maker(new Maker);
+    pvas::LazyProvider::Config conf;
+    conf.warmPool = 10u;
+    conf.maxBytes = 1u;
+    pvas::LazyProvider lazy("lazy", maker, conf);
+    pvas::LazyProvider::Stats stats;
+
+    pvac::ClientProvider cli(lazy.provider());
+    cli.connect("lazy:busy").get();
+
+    touch(lazy, "lazy:a");
+    touch(lazy, "lazy:b");
+
+    lazy.sweep();
+
+    // idle, however recently, but not those with channels
+    lazy.getStats(stats);
+    testEqual(stats.materialized, 1u);
+    testEqual(stats.inuse, 1u);
+    testEqual(stats.idleBytes, 0u);
+    testEqual(stats.evicted, 2u);
+
+    cli.disconnect();
+}
+
+} // namespace
+
+MAIN(testLazy)
+{
+    testPlan(22);
+    try {
+        testMaterialize();
+        testIdle();
+        testBudget();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
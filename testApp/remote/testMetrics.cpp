@@ -0,0 +1,280 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <sstream>
+
+#include <string.h>
+
+#include <osiSock.h>
+#include <epicsThread.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/latencyHistogram.h>
+#include <pv/metrics.h>
+#include <pv/memoryUsage.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+bool contains(const std::string& text, const std::string& line)
+{
+    return text.find(line)!=std::string::npos;
+}
+
+void testFormat()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::LatencyHistogram hist;
+    hist.record(50e-6);
+    hist.record(2e-3);
+    hist.record(20.0);
+
+    std::vector<double> bounds;
+    bounds.push_back(1e-3);
+    bounds.push_back(1.0);
+
+    pva::Metrics M;
+    M.family("tst_total", pva::Metrics::Counter, "A counter");
+    M.add("tst_total", 2, pva::Metrics::label("peer", "a\"b"));
+    M.add("tst_total", 3, pva::Metrics::label("peer", "a\"b"));
+    M.add("tst_gauge", 1.5);
+    M.add("tst_seconds", hist, bounds);
+
+    std::ostringstream strm;
+    M.write(strm);
+    const std::string text(strm.str());
+    testDiag("%s", text.c_str());
+
+    testOk1(contains(text, "# HELP tst_total A counter\n# TYPE tst_total counter\n"));
+    testOk1(contains(text, "tst_total{peer=\"a\\\"b\"} 5\n"));
+    testOk1(contains(text, "# TYPE tst_gauge gauge\ntst_gauge 1.5\n"));
+    testOk1(contains(text, "tst_seconds_bucket{le=\"0.001\"} 1\n"));
+    testOk1(contains(text, "tst_seconds_bucket{le=\"1\"} 2\n"));
+    testOk1(contains(text, "tst_seconds_bucket{le=\"+Inf\"} 3\n"));
+    testOk1(contains(text, "tst_seconds_count 3\n"));
+}
+
+void testMemoryUsage()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(
+                                  pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("name", pvd::pvString)
+                                  ->addArray("value", pvd::pvDouble)
+                                  ->createStructure()));
+
+    const size_t empty = pva::memoryUsage(*value);
+    testOk(empty>0u, "empty %u bytes", unsigned(empty));
+
+    pvd::PVDoubleArray::svector arr(1000u);
+    value->getSubFieldT<pvd::PVDoubleArray>("value")->replace(pvd::freeze(arr));
+    const size_t full = pva::memoryUsage(*value);
+    testOk(full>=empty+1000u*sizeof(double), "1000 elements %u bytes", unsigned(full));
+}
+
+// fetch a path from the metrics endpoint on localhost
+std::string httpGet(unsigned short port, const char *path)
+{
+    osiSockAddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.ia.sin_family = AF_INET;
+    addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.ia.sin_port = htons(port);
+
+    SOCKET sock = epicsSocketCreate(AF_INET, SOCK_STREAM, 0);
+    if(sock==INVALID_SOCKET)
+        testAbort("Unable to create socket");
+    if(connect(sock, &addr.sa, sizeof(addr.ia))) {
+        epicsSocketDestroy(sock);
+        testAbort("Unable to connect to metrics port %u", port);
+    }
+
+    std::string request("GET ");
+    request += path;
+    request += " HTTP/1.0\r\n\r\n";
+    send(sock, request.c_str(), int(request.size()), 0);
+
+    std::string reply;
+    char buf[1024];
+    int n;
+    while((n = recv(sock, buf, sizeof(buf), 0))>0)
+        reply.append(buf, size_t(n));
+    epicsSocketDestroy(sock);
+    return reply;
+}
+
+void testEndpoint()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("metrics:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVAS_METRICS_PORT", "0")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    const pvd::int32 port = server->getCurrentConfig()->getPropertyAsInteger("EPICS_PVAS_METRICS_PORT", 0);
+    testOk(port>0, "metrics port %d", int(port));
+
+    pvac::ClientProvider cli("pva", server->getCurrentConfig());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+    for(int i=0; i<3; i++)
+        chan.get();
+
+    std::string reply(httpGet(port, "/metrics"));
+    testDiag("%s", reply.c_str());
+
+    testOk1(reply.compare(0, 15, "HTTP/1.0 200 OK")==0);
+    testOk1(contains(reply, "Content-Type: text/plain; version=0.0.4"));
+    testOk1(contains(reply, "# TYPE pva_server_channels gauge\npva_server_channels 1\n"));
+    testOk1(contains(reply, "pva_server_messages_received_total{command=\"get\"} "));
+    testOk1(contains(reply, "pva_server_bytes_sent_total{remote=\"127.0.0.1:"));
+    testOk1(contains(reply, "pva_client_channels "));
+    testOk1(contains(reply, "# TYPE pva_server_search_names_total counter\n"));
+    testOk1(contains(reply, "pva_server_memory_bytes{remote=\"127.0.0.1:"));
+    testOk1(contains(reply, "pva_server_cpu_seconds_total{remote=\"127.0.0.1:"));
+
+    reply = httpGet(port, "/other");
+    testOk1(reply.compare(0, 22, "HTTP/1.0 404 Not Found")==0);
+}
+
+void testAdmission()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("admission:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVAS_METRICS_PORT", "0")
+                                                      .add("EPICS_PVAS_MAX_CONNECTIONS_PER_HOST", "1")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    testEqual(server->getCurrentConfig()->getPropertyAsInteger("EPICS_PVAS_MAX_CONNECTIONS_PER_HOST", 0), 1);
+
+    pvac::ClientProvider cli("pva", server->getCurrentConfig());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+    chan.get();
+
+    // a second connection from this host is closed at once
+    osiSockAddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.ia.sin_family = AF_INET;
+    addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.ia.sin_port = htons(server->getCurrentConfig()->getPropertyAsInteger("EPICS_PVA_SERVER_PORT", 0));
+
+    SOCKET sock = epicsSocketCreate(AF_INET, SOCK_STREAM, 0);
+    if(sock==INVALID_SOCKET)
+        testAbort("Unable to create socket");
+    if(connect(sock, &addr.sa, sizeof(addr.ia))) {
+        epicsSocketDestroy(sock);
+        testAbort("Unable to connect to server");
+    }
+    char buf[64];
+    testOk(recv(sock, buf, sizeof(buf), 0)<=0, "closed without validation");
+    epicsSocketDestroy(sock);
+
+    const pvd::int32 port = server->getCurrentConfig()->getPropertyAsInteger("EPICS_PVAS_METRICS_PORT", 0);
+    std::string reply(httpGet(port, "/metrics"));
+    testOk1(contains(reply, "pva_server_connections_accepted_total 1\n"));
+    testOk1(contains(reply, "pva_server_connections_rejected_total{limit=\"host\"} 1\n"));
+}
+
+void testRxTimestamps()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("stamps:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVAS_METRICS_PORT", "0")
+                                                      .add("EPICS_PVA_RX_TIMESTAMPS", "SOFTWARE")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", server->getCurrentConfig());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+    for(int i=0; i<3; i++)
+        chan.get();
+
+    const pvd::int32 port = server->getCurrentConfig()->getPropertyAsInteger("EPICS_PVAS_METRICS_PORT", 0);
+    std::string reply(httpGet(port, "/metrics"));
+#ifdef __linux__
+    testOk1(contains(reply, "pva_server_received_dispatch_seconds_count{remote=\"127.0.0.1:"));
+    testOk1(contains(reply, "pva_server_dispatch_response_seconds_count{remote=\"127.0.0.1:"));
+#else
+    testSkip(2, "SO_TIMESTAMPING only on Linux");
+#endif
+}
+
+} // namespace
+
+MAIN(testMetrics)
+{
+    testPlan(26);
+    osiSockAttach();
+    try {
+        testFormat();
+        testMemoryUsage();
+        testEndpoint();
+        testAdmission();
+        testRxTimestamps();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    osiSockRelease();
+    return testDone();
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <vector>
+
+#include <epicsThread.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/createRequest.h>
+#include <pv/monitorFilter.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("value", pvd::pvDouble)
+                                  ->addArray("wave", pvd::pvInt)
+                                  ->createStructure());
+
+pva::Configuration::shared_pointer loopback()
+{
+    return pva::ConfigurationBuilder()
+            .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+            .add("EPICS_PVA_SERVER_PORT", "0")
+            .add("EPICS_PVA_BROADCAST_PORT", "0")
+            .push_map()
+            .build();
+}
+
+struct Fixture {
+    pvas::SharedPV::shared_pointer pv;
+    pvas::StaticProvider prov;
+    pva::ServerContext::shared_pointer server;
+    pvac::ClientProvider cli;
+
+    pvd::PVStructurePtr inst;
+    pvd::BitSet changed;
+
+    Fixture()
+        :pv(pvas::SharedPV::buildReadOnly())
+        ,prov("filter")
+    {
+        pv->open(type);
+        prov.add("filter:pv", pv);
+        server = pva::ServerContext::create(pva::ServerContext::Config()
+                                            .config(loopback())
+                                            .provider(prov.provider()));
+        cli = pvac::ClientProvider("pva", server->getCurrentConfig());
+        inst = pvd::getPVDataCreate()->createPVStructure(type);
+    }
+
+    void postValue(double v)
+    {
+        pvd::PVDoublePtr value(inst->getSubFieldT<pvd::PVDouble>("value"));
+        value->put(v);
+        changed.clear();
+        changed.set(value->getFieldOffset());
+        pv->post(*inst, changed);
+    }
+
+    // values received in the following interval
+    std::vector<double> values(pvac::MonitorSync& mon, double wait = 0.5)
+    {
+        std::vector<double> ret;
+        while(mon.wait(wait)) {
+            while(mon.poll())
+                ret.push_back(mon.root->getSubFieldT<pvd::PVDouble>("value")->get());
+        }
+        return ret;
+    }
+};
+
+void testDeadband()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    Fixture F;
+    pvac::ClientChannel chan(F.cli.connect("filter:pv"));
+    pvac::MonitorSync mon(chan.monitor(pvd::createRequest("field(value[deadband=abs:1.0])")));
+
+    std::vector<double> initial(F.values(mon));
+    testEqual(initial.size(), 1u);
+
+    const double steps[] = {0.5, 0.9, 1.5, 1.6, 3.0};
+    for(size_t i=0; i<NELEMENTS(steps); i++) {
+        F.postValue(steps[i]);
+        epicsThreadSleep(0.05);
+    }
+
+    // 1.5 moves more than 1.0 from 0, then 3.0 from 1.5
+    std::vector<double> got(F.values(mon));
+    testEqual(got.size(), 2u);
+    testOk1(got.size()==2u && got[0]==1.5 && got[1]==3.0);
+}
+
+void testDecimate()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    Fixture F;
+    pvac::ClientChannel chan(F.cli.connect("filter:pv"));
+    pvac::MonitorSync mon(chan.monitor(pvd::createRequest("field(value[decimate=3])")));
+
+    // the initial update is the first of three
+    std::vector<double> initial(F.values(mon));
+    testEqual(initial.size(), 1u);
+
+    for(int i=1; i<=6; i++) {
+        F.postValue(i);
+        epicsThreadSleep(0.05);
+    }
+
+    std::vector<double> got(F.values(mon));
+    testEqual(got.size(), 2u);
+    testOk1(got.size()==2u && got[0]==3.0 && got[1]==6.0);
+}
+
+void testSubrange()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    Fixture F;
+
+    pvd::shared_vector<pvd::int32> wave(10);
+    for(size_t i=0; i<wave.size(); i++)
+        wave[i] = pvd::int32(i);
+    pvd::PVIntArrayPtr arr(F.inst->getSubFieldT<pvd::PVIntArray>("wave"));
+    arr->replace(pvd::freeze(wave));
+    F.changed.clear();
+    F.changed.set(arr->getFieldOffset());
+    F.pv->post(*F.inst, F.changed);
+
+    pvac::ClientChannel chan(F.cli.connect("filter:pv"));
+    pvac::MonitorSync mon(chan.monitor(pvd::createRequest("field(wave[subrange=2:-3])")));
+
+    testOk1(mon.wait(5.0) && mon.poll());
+    pvd::PVIntArray::const_svector got;
+    if(mon.root)
+        got = mon.root->getSubFieldT<pvd::PVIntArray>("wave")->view();
+    testEqual(got.size(), 6u);
+    testOk1(got.size()==6u && got[0]==2 && got[5]==7);
+}
+
+void testRegistry()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::MonitorFilterRegistry& reg(pva::MonitorFilterRegistry::instance());
+    testOk1(!!reg.find("deadband"));
+    testOk1(!!reg.find("decimate"));
+    testOk1(!!reg.find("subrange"));
+    testOk1(!reg.find("nosuch"));
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    testThrows(std::runtime_error, reg.find("deadband")->create("abs:1.0", inst->getSubField("wave")));
+    testThrows(std::runtime_error, reg.find("subrange")->create("1", inst->getSubField("wave")));
+}
+
+} // namespace
+
+MAIN(testMonitorFilter)
+{
+    testPlan(15);
+    try {
+        testRegistry();
+        testDeadband();
+        testDecimate();
+        testSubrange();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -15,6 +15,7 @@
 #include <string>
 
 #include <stdlib.h>
+#include <time.h>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -102,6 +103,7 @@ void reset()
 }
 
 epicsTimeStamp startTime;
+clock_t startClock;
 
 void monitor_all()
 {
@@ -175,16 +177,21 @@ public:
                 epicsTimeStamp endTime;
                 epicsTimeGetCurrent(&endTime);
 
+                clock_t endClock = clock();
+
                 double duration = epicsTime(endTime) - epicsTime(startTime);
                 double getPerSec = iterations*channels/duration;
                 double gbit = getPerSec*arraySize*sizeof(double)*8/(1000*1000*1000); // * bits / giga; NO, it's really 1000 and not 1024
+                // CPU time of this client, per update received
+                double cpuPerUpdate = double(endClock - startClock)/CLOCKS_PER_SEC*1e6/(double(iterations)*channels);
                 if (verbose)
-                    printf("%5.6f seconds, %.3f (x %d = %.3f) monitors/s, data throughput %5.3f Gbits/s\n",
-                           duration, iterations/duration, channels, getPerSec, gbit);
+                    printf("%5.6f seconds, %.3f (x %d = %.3f) monitors/s, data throughput %5.3f Gbits/s, %.3f us CPU per update\n",
+                           duration, iterations/duration, channels, getPerSec, gbit, cpuPerUpdate);
                 sum += getPerSec;
 
                 iterationCount = 0;
                 epicsTimeGetCurrent(&startTime);
+                startClock = clock();
 
                 runCount++;
                 if (runs == 0 || runCount < runs)
@@ -362,6 +369,7 @@ void runTest()
         waitLoopEvent.reset(new Event());
     }
     epicsTimeGetCurrent(&startTime);
+    startClock = clock();
     monitor_all();
 
     waitLoopEvent->wait();
@@ -0,0 +1,193 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/createRequest.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("value", pvd::pvInt)
+                                  ->createStructure());
+
+pva::Configuration::shared_pointer loopback()
+{
+    return pva::ConfigurationBuilder()
+            .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+            .add("EPICS_PVA_SERVER_PORT", "0")
+            .add("EPICS_PVA_BROADCAST_PORT", "0")
+            .push_map()
+            .build();
+}
+
+struct Updates {
+    unsigned count;
+    pvd::int32 last;
+    bool overrun;
+    Updates() :count(0), last(-1), overrun(false) {}
+};
+
+void drain(pvac::MonitorSync& mon, Updates& U)
+{
+    while(mon.poll()) {
+        U.count++;
+        pvd::PVIntPtr value(mon.root->getSubFieldT<pvd::PVInt>("value"));
+        U.last = value->get();
+        U.overrun |= mon.overrun.get(value->getFieldOffset());
+    }
+}
+
+void testRate(const char *request)
+{
+    testDiag("==== %s %s ====", CURRENT_FUNCTION, request);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(type);
+
+    pvas::StaticProvider prov("rate");
+    prov.add("rate:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(loopback())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", server->getCurrentConfig());
+    pvac::ClientChannel chan(cli.connect("rate:pv"));
+    pvac::MonitorSync mon(chan.monitor(pvd::createRequest(request)));
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::PVIntPtr value(inst->getSubFieldT<pvd::PVInt>("value"));
+    pvd::BitSet changed;
+    changed.set(value->getFieldOffset());
+
+    Updates U;
+    // wait for the initial update
+    if(mon.wait(5.0))
+        drain(mon, U);
+    testOk(U.count>0u, "connected");
+
+    // 50 Hz for one second, against a limit of 4 Hz
+    for(pvd::int32 i=1; i<=50; i++) {
+        value->put(i);
+        pv->post(*inst, changed);
+        epicsThreadSleep(0.02);
+        drain(mon, U);
+    }
+
+    epicsTime start(epicsTime::getCurrent());
+    while(U.last!=50 && epicsTime::getCurrent()-start < 5.0) {
+        if(mon.wait(0.5))
+            drain(mon, U);
+    }
+
+    testDiag("%u updates", U.count);
+    testEqual(U.last, 50);
+    testOk(U.count>=3u && U.count<=12u, "squashed to %u updates", U.count);
+    testOk1(U.overrun);
+}
+
+void postOne(pvas::SharedPV& pv, const pvd::PVStructure& inst, const pvd::PVIntPtr& field, pvd::int32 val)
+{
+    field->put(val);
+    pvd::BitSet changed;
+    changed.set(field->getFieldOffset());
+    pv.post(inst, changed);
+}
+
+// several updates posted within one holdoff are sent as one, with their masks merged
+void testMerge()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    const pvd::StructureConstPtr abc(pvd::getFieldCreate()->createFieldBuilder()
+                                     ->add("a", pvd::pvInt)
+                                     ->add("b", pvd::pvInt)
+                                     ->add("c", pvd::pvInt)
+                                     ->createStructure());
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(abc);
+
+    pvas::StaticProvider prov("rate");
+    prov.add("rate:abc", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(loopback())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", server->getCurrentConfig());
+    pvac::ClientChannel chan(cli.connect("rate:abc"));
+    pvac::MonitorSync mon(chan.monitor(pvd::createRequest("record[dt=1.0]field()")));
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(abc));
+    pvd::PVIntPtr a(inst->getSubFieldT<pvd::PVInt>("a")),
+                  b(inst->getSubFieldT<pvd::PVInt>("b")),
+                  c(inst->getSubFieldT<pvd::PVInt>("c"));
+
+    unsigned initial = 0u;
+    if(mon.wait(5.0)) {
+        while(mon.poll())
+            initial++;
+    }
+    testOk(initial>0u, "connected");
+
+    // the initial update starts a holdoff, during which these are posted
+    postOne(*pv, *inst, a, 1);
+    postOne(*pv, *inst, b, 2);
+    postOne(*pv, *inst, c, 3);
+    postOne(*pv, *inst, a, 4);
+
+    unsigned count = 0u;
+    pvd::BitSet merged, overrun;
+    epicsTime start(epicsTime::getCurrent());
+    while(count==0u && epicsTime::getCurrent()-start < 5.0) {
+        if(!mon.wait(0.5))
+            continue;
+        while(mon.poll()) {
+            count++;
+            merged |= mon.changed;
+            overrun |= mon.overrun;
+        }
+    }
+
+    testOk(count==1u && mon.root
+           && mon.root->getSubFieldT<pvd::PVInt>("a")->get()==4
+           && mon.root->getSubFieldT<pvd::PVInt>("c")->get()==3,
+           "%u update with the latest values", count);
+    testOk(merged.get(a->getFieldOffset()) && merged.get(b->getFieldOffset()) && merged.get(c->getFieldOffset()),
+           "changed a, b and c");
+    testOk(overrun.get(a->getFieldOffset()) && !overrun.get(b->getFieldOffset()),
+           "overrun a only");
+}
+
+} // namespace
+
+MAIN(testMonitorRate)
+{
+    testPlan(12);
+    try {
+        testRate("record[rate=4.0]field()");
+        testRate("record[dt=0.25,pipeline=true]field()");
+        testMerge();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
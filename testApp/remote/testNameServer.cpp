@@ -0,0 +1,141 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <sstream>
+
+#include <epicsThread.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/nameServer.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+pva::Configuration::shared_pointer loopback(const std::string& nameServers = std::string())
+{
+    return pva::ConfigurationBuilder()
+            .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_ADDR_LIST", "")
+            .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+            .add("EPICS_PVA_SERVER_PORT", "0")
+            .add("EPICS_PVA_BROADCAST_PORT", "0")
+            .add("EPICS_PVA_NAME_SERVERS", nameServers)
+            .push_map()
+            .build();
+}
+
+std::string tcpAddress(const pva::ServerContext::shared_pointer& server)
+{
+    std::ostringstream strm;
+    strm<<"127.0.0.1:"<<server->getServerPort();
+    return strm.str();
+}
+
+void testDirectory(const pva::ServerContext::shared_pointer& hosting)
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::NameServer ns(0.1);
+    testOk1(ns.addServer(tcpAddress(hosting)));
+    testOk(!ns.addServer(tcpAddress(hosting)), "no duplicates");
+    ns.start();
+
+    pva::NameServer::Stats stats;
+    for(unsigned i=0; i<50; i++) {
+        ns.getStats(stats);
+        if(stats.names>=2)
+            break;
+        epicsThreadSleep(0.1);
+    }
+    testEqual(stats.servers, 1u);
+    testEqual(stats.reachable, 1u);
+    testEqual(stats.names, 2u);
+
+    pva::ServerGUID guid;
+    osiSockAddr addr;
+    testOk1(ns.find("ns:one", guid, addr));
+    testEqual(ntohs(addr.ia.sin_port), hosting->getServerPort());
+    testOk1(!ns.find("ns:missing", guid, addr));
+
+    ns.removeServer(tcpAddress(hosting));
+    testOk(!ns.find("ns:one", guid, addr), "names of removed server");
+
+    ns.stop();
+}
+
+void testSearchThrough(const pva::ServerContext::shared_pointer& hosting)
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider none("none");
+
+    pva::ServerContext::shared_pointer directory(pva::ServerContext::create(pva::ServerContext::Config()
+                                                .config(pva::ConfigurationBuilder()
+                                                        .push_config(loopback())
+                                                        .add("EPICS_PVAS_NAME_SERVER_LIST", tcpAddress(hosting))
+                                                        .add("EPICS_PVAS_NAME_SERVER_POLL", "1")
+                                                        .push_map()
+                                                        .build())
+                                                .provider(none.provider())));
+    testDiag("Name server on TCP %u", directory->getServerPort());
+
+    // no UDP search destinations, so only the name server can resolve
+    pvac::ClientProvider cli("pva", loopback(tcpAddress(directory)));
+    pvac::ClientChannel chan(cli.connect("ns:one"));
+
+    pvd::PVStructure::const_shared_pointer value;
+    try {
+        value = chan.get(10.0);
+    } catch(std::exception& e) {
+        testDiag("get() fails: %s", e.what());
+    }
+    testOk(!!value, "connected through name server");
+    if(value)
+        testEqual(value->getSubFieldT<pvd::PVInt>("value")->get(), 42);
+    else
+        testSkip(1, "no value");
+}
+
+} // namespace
+
+MAIN(testNameServer)
+{
+    testPlan(11);
+    try {
+        pvas::SharedPV::shared_pointer one(pvas::SharedPV::buildReadOnly()),
+                                       two(pvas::SharedPV::buildReadOnly());
+        pvd::PVStructure::shared_pointer initial(pvd::getPVDataCreate()->createPVStructure(
+                                                     pvd::getFieldCreate()->createFieldBuilder()
+                                                     ->add("value", pvd::pvInt)
+                                                     ->createStructure()));
+        initial->getSubFieldT<pvd::PVInt>("value")->put(42);
+        one->open(*initial);
+        two->open(*initial);
+
+        pvas::StaticProvider prov("hosting");
+        prov.add("ns:one", one);
+        prov.add("ns:two", two);
+
+        pva::ServerContext::shared_pointer hosting(pva::ServerContext::create(pva::ServerContext::Config()
+                                                  .config(loopback())
+                                                  .provider(prov.provider())));
+        testDiag("Hosting server on TCP %u", hosting->getServerPort());
+
+        testDirectory(hosting);
+        testSearchThrough(hosting);
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <vector>
+
+#include <epicsEvent.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/current_function.h>
+#include <pv/createRequest.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("value", pvd::pvInt)
+                                  ->createStructure());
+
+// records completions, in the order of their callbacks
+struct Completions : public pva::ChannelGetRequester, public pva::ChannelPutRequester
+{
+    pvd::Mutex mutex;
+    epicsEvent connected, event;
+    size_t expect;
+    std::vector<bool> ok;
+    std::vector<pvd::int32> values;
+
+    Completions() :expect(0u) {}
+    virtual ~Completions() {}
+    virtual std::string getRequesterName() OVERRIDE FINAL { return "Completions"; }
+
+    void done(bool success, const pvd::PVStructure::shared_pointer& value = pvd::PVStructure::shared_pointer())
+    {
+        pvd::Lock G(mutex);
+        ok.push_back(success);
+        if(value)
+            values.push_back(value->getSubFieldT<pvd::PVInt>("value")->get());
+        if(ok.size()==expect)
+            event.signal();
+    }
+
+    virtual void channelGetConnect(const pvd::Status& status, pva::ChannelGet::shared_pointer const &,
+                                   pvd::Structure::const_shared_pointer const &) OVERRIDE FINAL
+    {
+        if(status.isSuccess())
+            connected.signal();
+    }
+    virtual void getDone(const pvd::Status& status, pva::ChannelGet::shared_pointer const &,
+                         pvd::PVStructure::shared_pointer const & pvStructure,
+                         pvd::BitSet::shared_pointer const &) OVERRIDE FINAL
+    {
+        done(status.isSuccess(), pvStructure);
+    }
+
+    virtual void channelPutConnect(const pvd::Status& status, pva::ChannelPut::shared_pointer const &,
+                                   pvd::Structure::const_shared_pointer const &) OVERRIDE FINAL
+    {
+        if(status.isSuccess())
+            connected.signal();
+    }
+    virtual void putDone(const pvd::Status& status, pva::ChannelPut::shared_pointer const &) OVERRIDE FINAL
+    {
+        done(status.isSuccess());
+    }
+    virtual void getDone(const pvd::Status& status, pva::ChannelPut::shared_pointer const &,
+                         pvd::PVStructure::shared_pointer const & pvStructure,
+                         pvd::BitSet::shared_pointer const &) OVERRIDE FINAL
+    {
+        done(status.isSuccess(), pvStructure);
+    }
+
+    bool wait(size_t n)
+    {
+        {
+            pvd::Lock G(mutex);
+            expect = n;
+            if(ok.size()>=n)
+                return true;
+        }
+        return event.wait(5.0);
+    }
+};
+
+pva::ServerContext::shared_pointer startServer(pvas::StaticProvider& prov, const char *window)
+{
+    pva::ConfigurationBuilder conf;
+    conf.add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+        .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+        .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+        .add("EPICS_PVA_SERVER_PORT", "0")
+        .add("EPICS_PVA_BROADCAST_PORT", "0");
+    if(window)
+        conf.add("EPICS_PVA_PIPELINE_WINDOW", window);
+    return pva::ServerContext::create(pva::ServerContext::Config()
+                                      .config(conf.push_map().build())
+                                      .provider(prov.provider()));
+}
+
+void testDefault()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    pv->open(type);
+    pvas::StaticProvider prov("pipeline:default");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(startServer(prov, 0));
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .push_map()
+                             .build());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+    testOk1(!!chan.get(5.0));
+    pva::Channel::shared_pointer raw(chan.getChannel());
+
+    std::tr1::shared_ptr<Completions> gets(new Completions);
+    pva::ChannelGet::shared_pointer get(raw->createChannelGet(gets, pvd::createRequest("field(value)")));
+    testOk1(gets->connected.wait(5.0));
+    for(unsigned i=0; i<3u; i++)
+        get->get();
+
+    testOk1(gets->wait(3u));
+    {
+        pvd::Lock G(gets->mutex);
+        size_t nok = 0u;
+        for(size_t i=0; i<gets->ok.size(); i++)
+            nok += gets->ok[i];
+        // off unless configured, so one at a time
+        testOk(gets->ok.size()==3u && nok>=1u && nok<3u, "%u of 3 succeed", unsigned(nok));
+    }
+}
+
+void testPipeline()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    pv->open(type);
+    pvas::StaticProvider prov("pipeline:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(startServer(prov, "4"));
+
+    // opt in on both ends
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .add("EPICS_PVA_PIPELINE_WINDOW", "4")
+                             .push_map()
+                             .build());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+    testOk1(!!chan.get(5.0));
+    pva::Channel::shared_pointer raw(chan.getChannel());
+
+    // puts, then a get, in flight together
+    std::tr1::shared_ptr<Completions> puts(new Completions);
+    pva::ChannelPut::shared_pointer op(raw->createChannelPut(puts, pvd::createRequest("field(value)")));
+    testOk1(puts->connected.wait(5.0));
+
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSetPtr changed(new pvd::BitSet);
+    changed->set(value->getSubFieldT<pvd::PVInt>("value")->getFieldOffset());
+    for(pvd::int32 i=1; i<=3; i++) {
+        value->getSubFieldT<pvd::PVInt>("value")->put(i);
+        op->put(value, changed);
+    }
+    op->get();
+
+    testOk1(puts->wait(4u));
+    {
+        pvd::Lock G(puts->mutex);
+        testOk(puts->ok.size()==4u && puts->ok[0] && puts->ok[1] && puts->ok[2] && puts->ok[3],
+               "4 completions");
+        // in order, so the get follows the last put
+        testOk(puts->values.size()==1u && puts->values[0]==3, "get() after put()s");
+    }
+
+    // beyond the window
+    std::tr1::shared_ptr<Completions> gets(new Completions);
+    pva::ChannelGet::shared_pointer get(raw->createChannelGet(gets, pvd::createRequest("field(value)")));
+    testOk1(gets->connected.wait(5.0));
+    for(unsigned i=0; i<6u; i++)
+        get->get();
+
+    testOk1(gets->wait(6u));
+    {
+        pvd::Lock G(gets->mutex);
+        size_t nok = 0u;
+        for(size_t i=0; i<gets->ok.size(); i++)
+            nok += gets->ok[i];
+        // those beyond it are refused, unless earlier ones were answered meanwhile
+        testOk(gets->ok.size()==6u && nok>=4u, "%u of 6 succeed", unsigned(nok));
+    }
+}
+
+} // namespace
+
+MAIN(testPipeline)
+{
+    testPlan(12);
+    try {
+        testDefault();
+        testPipeline();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
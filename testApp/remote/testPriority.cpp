@@ -0,0 +1,154 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <epicsEvent.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+// holds the thread which receives for its connection until released
+struct SlowGet : public pvac::ClientChannel::GetCallback
+{
+    epicsEvent entered, release;
+    virtual ~SlowGet() {}
+    virtual void getDone(const pvac::GetEvent& evt) OVERRIDE FINAL
+    {
+        entered.signal();
+        release.wait(10.0);
+    }
+};
+
+void testIsolation()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("prio:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    // one I/O thread shared by the connections of the default priority
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .add("EPICS_PVA_IO_THREADS", "1")
+                             .add("EPICS_PVA_PRIORITY_DSCP", "0:8 50:46")
+                             .add("EPICS_PVA_PRIORITY_SNDBUF", "0:1048576 50:65536")
+                             .push_map()
+                             .build());
+
+    pvac::ClientChannel::Options control;
+    control.priority = 50;
+
+    pvac::ClientChannel bulk(cli.connect("tst:pv")),
+                        oper(cli.connect("tst:pv", control));
+
+    testOk1(!!bulk.get(5.0));
+    testOk1(!!oper.get(5.0));
+
+    SlowGet slow;
+    pvac::Operation op(bulk.get(&slow));
+    testOk(slow.entered.wait(5.0), "bulk connection held");
+
+    bool done;
+    try {
+        oper.get(2.0);
+        done = true;
+    } catch(std::exception& e) {
+        testDiag("get() fails: %s", e.what());
+        done = false;
+    }
+    testOk(done, "get() of another priority completes meanwhile");
+
+    slow.release.signal();
+    testOk1(!!bulk.get(5.0));
+}
+
+void testLowLatency()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("prio:test");
+    prov.add("tst:pv", pv);
+
+    // busy-poll, spin and pin both ends of a connection of priority 50
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVA_PRIORITY_BUSY_POLL", "50:50")
+                                                      .add("EPICS_PVA_PRIORITY_SEND_SPIN", "50:20")
+                                                      .add("EPICS_PVA_PRIORITY_RX_CPU", "50:0")
+                                                      .add("EPICS_PVA_PRIORITY_TX_CPU", "50:0")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .push_map()
+                             .build());
+
+    pvac::ClientChannel::Options control;
+    control.priority = 50;
+    pvac::ClientChannel oper(cli.connect("tst:pv", control));
+
+    testOk1(!!oper.get(5.0));
+
+    bool ok = true;
+    for(unsigned i=0; i<100u && ok; i++)
+        ok = !!oper.get(5.0);
+    testOk(ok, "repeated get()");
+
+    // a connection of the default priority is unaffected
+    pvac::ClientChannel bulk(cli.connect("tst:pv"));
+    testOk1(!!bulk.get(5.0));
+}
+
+} // namespace
+
+MAIN(testPriority)
+{
+    testPlan(8);
+    try {
+        testIsolation();
+        testLowLatency();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
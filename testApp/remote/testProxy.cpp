@@ -0,0 +1,177 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <epicsThread.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/client.h>
+#include <pva/sharedstate.h>
+#include <pva/proxy.h>
+#include <pv/current_function.h>
+#include <pv/createRequest.h>
+#include <pv/pvAccess.h>
+
+#include "testFindResult.h"
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("value", pvd::pvInt)
+                                  ->add("extra", pvd::pvString)
+                                  ->createStructure());
+
+void post(pvas::SharedPV& pv, pvd::int32 value)
+{
+    pvd::PVStructurePtr inst(pv.build());
+    pvd::BitSet changed;
+    pvd::PVScalarPtr fld(inst->getSubFieldT<pvd::PVScalar>("value"));
+    fld->putFrom(value);
+    changed.set(fld->getFieldOffset());
+    pv.post(*inst, changed);
+}
+
+pvd::int32 valueOf(const pvd::PVStructure::const_shared_pointer& root)
+{
+    return root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>();
+}
+
+void testProxy()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider upstream("upstream");
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    upstream.add("pv:name", pv);
+    pv->open(type);
+    post(*pv, 42);
+
+    pvas::ProxyProvider::Config conf;
+    conf.idleHold = 0.5;
+    pvas::ProxyProvider proxy("proxy", pvac::ClientProvider(upstream.provider()), conf);
+    pvas::ProxyProvider::Stats stats;
+
+    {
+        // one per client, as each keeps its own channels
+        pvac::ClientProvider cliA(proxy.provider()),
+                             cliB(proxy.provider());
+        pvac::ClientChannel chanA(cliA.connect("pv:name")),
+                            chanB(cliB.connect("pv:name"));
+
+        testEqual(valueOf(chanA.get()), 42);
+
+        pvac::MonitorSync monA(chanA.monitor()),
+                          monB(chanB.monitor(pvd::createRequest("field(value)")));
+        testOk1(monA.wait(5.0) && monA.poll() && valueOf(monA.root)==42);
+        testOk1(monB.wait(5.0) && monB.poll() && valueOf(monB.root)==42 && !monB.root->getSubField("extra"));
+
+        proxy.getStats(stats);
+        testEqual(stats.upstream, 1u);
+        testEqual(stats.connected, 1u);
+        testEqual(stats.inuse, 1u);
+
+        post(*pv, 43);
+        testOk1(monA.wait(5.0) && monA.poll() && valueOf(monA.root)==43);
+        testOk1(monB.wait(5.0) && monB.poll() && valueOf(monB.root)==43);
+
+        // forwarded to the mailbox, which posts it back
+        chanB.put()
+             .set<pvd::int32>("value", 44)
+             .exec();
+        testOk1(monA.wait(5.0) && monA.poll() && valueOf(monA.root)==44);
+
+        {
+            pvd::PVStructurePtr inst(pv->build());
+            pvd::BitSet valid;
+            pv->fetch(*inst, valid);
+            testEqual(inst->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>(), 44);
+        }
+
+        proxy.getStats(stats);
+        testEqual(stats.upstream, 1u);
+        testEqual(stats.forwarded, 1u);
+        testOk(stats.updates>=3u, "updates %u", unsigned(stats.updates));
+
+        std::tr1::shared_ptr<FindResult> find(new FindResult);
+        proxy.provider()->channelFind("pv:name", find);
+        testOk1(find->found);
+
+        proxy.sweep();
+        proxy.getStats(stats);
+        testEqual(stats.upstream, 1u);
+
+        cliA.disconnect();
+        cliB.disconnect();
+    }
+
+    // kept for idleHold after the last downstream channel
+    proxy.getStats(stats);
+    testEqual(stats.inuse, 0u);
+
+    epicsThreadSleep(conf.idleHold+0.1);
+    proxy.sweep();
+    proxy.getStats(stats);
+    testEqual(stats.upstream, 0u);
+}
+
+void testNotFound()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider upstream("upstream");
+    pvas::ProxyProvider proxy("proxy", pvac::ClientProvider(upstream.provider()));
+
+    std::tr1::shared_ptr<FindResult> find(new FindResult);
+    proxy.provider()->channelFind("no:such", find);
+    testOk1(!find->found);
+
+    // refused at once by the upstream provider, so not kept
+    pvas::ProxyProvider::Stats stats;
+    proxy.getStats(stats);
+    testEqual(stats.upstream, 0u);
+    testEqual(stats.connected, 0u);
+}
+
+void testReadOnly()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::StaticProvider upstream("upstream");
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    upstream.add("pv:name", pv);
+    pv->open(type);
+
+    pvas::ProxyProvider::Config conf;
+    conf.readOnly = true;
+    pvas::ProxyProvider proxy("proxy", pvac::ClientProvider(upstream.provider()), conf);
+
+    pvac::ClientProvider cli(proxy.provider());
+    pvac::ClientChannel chan(cli.connect("pv:name"));
+    testEqual(valueOf(chan.get()), 0);
+
+    testThrows(std::runtime_error, chan.put()
+                                       .set<pvd::int32>("value", 5)
+                                       .exec());
+    testEqual(valueOf(chan.get()), 0);
+}
+
+} // namespace
+
+MAIN(testProxy)
+{
+    testPlan(23);
+    try {
+        testProxy();
+        testNotFound();
+        testReadOnly();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -1,4 +1,6 @@
 
+#include <vector>
+
 #include <pv/epicsException.h>
 #include <pv/valueBuilder.h>
 
@@ -6,6 +8,7 @@
 #include <pv/rpcClient.h>
 #include <pv/rpcServer.h>
 #include <pv/rpcService.h>
+#include <pv/rpcCache.h>
 
 #include <epicsUnitTest.h>
 #include <testMain.h>
@@ -21,11 +24,15 @@ pvd::StructureConstPtr reply_type(pvd::getFieldCreate()->createFieldBuilder()
 
 struct SumService : public pva::RPCService
 {
+    size_t count;
+    SumService() :count(0u) {}
+
     virtual epics::pvData::PVStructure::shared_pointer request(
         epics::pvData::PVStructure::shared_pointer const & args
     ) OVERRIDE FINAL
     {
         testDiag("request()");
+        count++;
         pvd::PVScalarPtr lhs(args->getSubField<pvd::PVScalar>("query.lhs")),
                          rhs(args->getSubField<pvd::PVScalar>("query.rhs"));
         if(!lhs || !rhs)
@@ -106,11 +113,160 @@ void testRPCFail(const pva::ChannelProvider::shared_pointer& cli_prov)
     }
 }
 
+void testPipelined(const pva::ChannelProvider::shared_pointer& cli_prov)
+{
+    testDiag("Pipelined");
+
+    pva::RPCClient client("sum", pvd::createRequest("field()"), cli_prov);
+
+    size_t ids[4];
+    for(unsigned i=0; i<4; i++) {
+        pvd::ValueBuilder args("epics:nt/NTURI:1.0");
+        args.add<pvd::pvString>("scheme", "pva")
+            .add<pvd::pvString>("path", "sum");
+        ids[i] = client.issuePipelined(args.addNested("query")
+                                           .add<pvd::pvDouble>("lhs", double(i))
+                                           .add<pvd::pvDouble>("rhs", 10.0)
+                                       .endNested()
+                                       .buildPVStructure());
+    }
+
+    // collect in reverse order of issue
+    for(unsigned i=4; i>0; i--) {
+        pvd::PVStructurePtr reply(client.waitResponse(ids[i-1], 5.0));
+        pvd::int32 value = reply->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>();
+        testOk(value==pvd::int32(i-1+10), "Reply %u value = %d", i-1, (unsigned)value);
+    }
+}
+
+void testRequestMany(const pva::ChannelProvider::shared_pointer& cli_prov)
+{
+    testDiag("requestMany through shared channels");
+
+    std::vector<pvd::PVStructurePtr> args;
+    for(unsigned i=0; i<3; i++) {
+        pvd::ValueBuilder builder("epics:nt/NTURI:1.0");
+        builder.add<pvd::pvString>("scheme", "pva")
+               .add<pvd::pvString>("path", "sum");
+        args.push_back(builder.addNested("query")
+                                  .add<pvd::pvDouble>("lhs", double(i))
+                                  .add<pvd::pvDouble>("rhs", 1.0)
+                              .endNested()
+                              .buildPVStructure());
+    }
+
+    for(unsigned n=0; n<2; n++) {
+        // the second client reuses the connected channel of the first
+        pva::RPCClient::shared_pointer client(pva::RPCClient::createShared("sum", pvd::createRequest("field()"), cli_prov));
+        std::vector<pvd::PVStructurePtr> replies(client->requestMany(args, 5.0));
+
+        bool ok = replies.size()==args.size();
+        for(size_t i=0; ok && i<replies.size(); i++)
+            ok = replies[i] && replies[i]->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>()==pvd::int32(i+1);
+        testOk(ok, "client %u requestMany() replies", n);
+    }
+    pva::RPCClient::clearChannelCache();
+}
+
+pvd::StructureConstPtr fixed_type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("lhs", pvd::pvDouble)
+                                  ->add("rhs", pvd::pvDouble)
+                                  ->createStructure());
+
+// declares its argument type, so the server may re-use argument PVStructures
+struct FixedSumService : public pva::RPCService
+{
+    virtual pvd::StructureConstPtr getArgumentType() OVERRIDE FINAL { return fixed_type; }
+
+    virtual epics::pvData::PVStructure::shared_pointer request(
+        epics::pvData::PVStructure::shared_pointer const & args
+    ) OVERRIDE FINAL
+    {
+        pvd::PVStructure::shared_pointer reply(pvd::getPVDataCreate()->createPVStructure(reply_type));
+        reply->getSubFieldT<pvd::PVDouble>("value")->put(args->getSubFieldT<pvd::PVDouble>("lhs")->get()
+                                                         + args->getSubFieldT<pvd::PVDouble>("rhs")->get());
+        return reply;
+    }
+};
+
+void testFixedArgument(const pva::ChannelProvider::shared_pointer& cli_prov)
+{
+    testDiag("Declared argument type");
+
+    pva::RPCClient client("fixed", pvd::createRequest("field()"), cli_prov);
+
+    bool ok = true;
+    for(unsigned i=0; i<4; i++) {
+        pvd::PVStructurePtr args(pvd::getPVDataCreate()->createPVStructure(fixed_type));
+        args->getSubFieldT<pvd::PVDouble>("lhs")->put(double(i));
+        args->getSubFieldT<pvd::PVDouble>("rhs")->put(10.0);
+        pvd::PVStructurePtr reply(client.request(args));
+        ok &= reply->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>()==pvd::int32(i+10);
+    }
+    testOk(ok, "successive requests with one argument type");
+
+    pvd::ValueBuilder args("epics:nt/NTURI:1.0");
+    args.add<pvd::pvString>("scheme", "pva")
+        .add<pvd::pvString>("path", "fixed");
+    try{
+        (void)client.request(args.addNested("query")
+                             .add<pvd::pvDouble>("lhs", 5.0)
+                             .endNested()
+                             .buildPVStructure());
+        testFail("Missing expected exception");
+    }catch(pva::RPCRequestException& e){
+        testPass("other argument type rejected: %s", e.what());
+    }
+}
+
+void testStats(const pva::ChannelProvider::shared_pointer& cli_prov)
+{
+    testDiag("rpc.stats");
+
+    pva::RPCClient client("rpc.stats", pvd::createRequest("field()"), cli_prov);
+    pvd::PVStructurePtr reply(client.request(pvd::getPVDataCreate()->createPVStructure(pvd::getFieldCreate()->createStructure())));
+
+    pvd::PVStringArray::const_svector names(reply->getSubFieldT<pvd::PVStringArray>("value.service")->view());
+    pvd::PVULongArray::const_svector requests(reply->getSubFieldT<pvd::PVULongArray>("value.requests")->view());
+    pvd::uint64 sumRequests = 0u;
+    for(size_t i=0; i<names.size() && i<requests.size(); i++)
+        if(names[i]=="sum")
+            sumRequests = requests[i];
+    testOk(sumRequests>=5u, "service sum counted %u requests", unsigned(sumRequests));
+}
+
+void testCache(const pva::ChannelProvider::shared_pointer& cli_prov,
+               const std::tr1::shared_ptr<SumService>& backend,
+               const pva::RPCCacheService::shared_pointer& cache)
+{
+    testDiag("Cache");
+
+    pva::RPCClient client("cached", pvd::createRequest("field()"), cli_prov);
+
+    size_t before = backend->count;
+    for(unsigned i=0; i<2; i++) {
+        pvd::ValueBuilder args("epics:nt/NTURI:1.0");
+        args.add<pvd::pvString>("scheme", "pva")
+            .add<pvd::pvString>("path", "cached");
+        pvd::PVStructurePtr reply(client.request(args.addNested("query")
+                                                     .add<pvd::pvDouble>("lhs", 2.0)
+                                                     .add<pvd::pvDouble>("rhs", 4.0)
+                                                 .endNested()
+                                                 .buildPVStructure()));
+        pvd::int32 value = reply->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>();
+        testOk(value==6, "Reply %u value = %d", i, (unsigned)value);
+    }
+
+    pva::RPCCacheService::Stats stats(cache->stats());
+    testOk(backend->count==before+1u, "backend called %u times", unsigned(backend->count-before));
+    testOk(stats.hits==1u && stats.misses==1u, "hits %u misses %u", unsigned(stats.hits), unsigned(stats.misses));
+}
+
 } // namespace
 
 MAIN(testRPC)
 {
-    testPlan(3);
+    testPlan(15);
     try {
         pva::Configuration::shared_pointer conf(pva::ConfigurationBuilder()
                                                 //.push_env()
@@ -120,6 +276,7 @@ MAIN(testRPC)
                                                 .add("EPICS_PVA_AUTO_ADDR_LIST","0")
                                                 .add("EPICS_PVA_SERVER_PORT", "0")
                                                 .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                .add("EPICS_PVA_RPC_THREADS", "2")
                                                 .push_map()
                                                 .build());
 
@@ -137,6 +294,13 @@ MAIN(testRPC)
             std::tr1::shared_ptr<pva::RPCService> service(new FailService);
             serv.registerService("fail", service);
         }
+        {
+            std::tr1::shared_ptr<pva::RPCService> service(new FixedSumService);
+            serv.registerService("fixed", service);
+        }
+        std::tr1::shared_ptr<SumService> cachedBackend(new SumService);
+        pva::RPCCacheService::shared_pointer cache(new pva::RPCCacheService(cachedBackend, 16u, 60.0));
+        serv.registerService("cached", pva::RPCServiceAsync::shared_pointer(cache));
 
         testDiag("Client Setup");
         pva::ClientFactory::start();
@@ -148,6 +312,11 @@ MAIN(testRPC)
 
         testSum(cli_prov);
         testRPCFail(cli_prov);
+        testPipelined(cli_prov);
+        testRequestMany(cli_prov);
+        testFixedArgument(cli_prov);
+        testCache(cli_prov, cachedBackend, cache);
+        testStats(cli_prov);
 
     }catch(std::exception& e){
         PRINT_EXCEPTION(e);
@@ -0,0 +1,262 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+/* Without an RDMA adapter, soft RoCE runs these over any ethernet interface, eg.
+ *
+ *   rdma link add rxe0 type rxe netdev eth0
+ *   EPICS_PVA_RDMA_DEVICE=rxe0 EPICS_PVA_RDMA_GID_INDEX=1 EPICS_PVA_RDMA_TEST_ADDR=<address of eth0> ./testRdmaRing
+ *
+ * with the GID index of its IPv4 address (see ibv_devinfo -v).
+ * testConnection() is skipped unless EPICS_PVA_RDMA_TEST_ADDR is set, as connections
+ * through loopback aren't moved to rings.
+ */
+
+#include <vector>
+#include <string>
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <epicsThread.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/byteBuffer.h>
+#include <pv/rdmaRing.h>
+#include <pv/serverContext.h>
+#include <pv/transportRegistry.h>
+#include <pv/codec.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+using epics::pvAccess::RdmaRing;
+
+namespace {
+
+std::string testEnv(const char* name, const char* def)
+{
+    const char* val = getenv(name);
+    return val && val[0] ? val : def;
+}
+
+void testEndpoint()
+{
+    testDiag("testEndpoint");
+
+    RdmaRing::Endpoint E;
+    testOk1(E.empty());
+
+    for(size_t i=0; i<sizeof(E.gid); i++)
+        E.gid[i] = epics::pvData::uint8(i+1);
+    E.lid = 0x1234;
+    E.qpn = 0x56789a;
+    E.psn = 0xbcdef0;
+    E.rkey = 0x12345678;
+    E.size = 8192;
+    E.addr = 0x123456789abcdef0ull;
+
+    epics::pvData::ByteBuffer buf(RdmaRing::Endpoint::wireSize);
+    E.serialize(&buf);
+    testOk(buf.getPosition()==RdmaRing::Endpoint::wireSize, "wireSize %u", unsigned(buf.getPosition()));
+    buf.flip();
+
+    RdmaRing::Endpoint D;
+    D.deserialize(&buf);
+    testOk1(!D.empty() && memcmp(D.gid, E.gid, sizeof(E.gid))==0 && D.lid==E.lid && D.qpn==E.qpn
+            && D.psn==E.psn && D.rkey==E.rkey && D.size==E.size && D.addr==E.addr);
+}
+
+void testValidReport()
+{
+    testDiag("testValidReport");
+
+    // data written into a ring of 8192 bytes, from head 100 with tail 50
+    testOk1(RdmaRing::validReport(100u, 50u+8192u, 8142u));
+    testOk1(!RdmaRing::validReport(100u, 50u+8192u, 8143u));
+    testOk1(!RdmaRing::validReport(100u, 50u+8192u, 0xffffffffu));
+    // credit for bytes written, from acked 100 with head 300
+    testOk1(RdmaRing::validReport(100u, 300u, 0u));
+    testOk1(RdmaRing::validReport(100u, 300u, 200u));
+    testOk1(!RdmaRing::validReport(100u, 300u, 201u));
+    // the free running indices near their limit
+    const epics::pvData::uint64 big = 0xfffffffffffff000ull;
+    testOk1(RdmaRing::validReport(big, big+0x800u, 0x800u));
+    testOk1(!RdmaRing::validReport(big+0x10u, big, 0u));
+}
+
+void testTransfer()
+{
+    testDiag("testTransfer");
+
+    const std::string device(testEnv("EPICS_PVA_RDMA_DEVICE", ""));
+    const int gidIndex = atoi(testEnv("EPICS_PVA_RDMA_GID_INDEX", "0").c_str());
+
+    // a pair of rings on one device, connected to each other
+    RdmaRing::shared_pointer client(RdmaRing::create(device, gidIndex, 5000)),
+                             server(RdmaRing::create(device, gidIndex, 5000));
+    testOk(client && server && client->ringSize()==8192u, "create(), rounded up to 8192");
+    if(!client || !server) {
+        testSkip(6, "No ring");
+        return;
+    }
+    testOk1(client->connect(server->local()) && server->connect(client->local()));
+
+    char buf[8192];
+    testOk1(server->read(buf, sizeof(buf), 0.01)==0);
+
+    std::vector<char> data(100000);
+    for(size_t i=0; i<data.size(); i++)
+        data[i] = char(i*7 + i/8192);
+
+    testOk1(client->write(&data[0], 3000, 1.0)==3000
+            && server->read(buf, 3000, 1.0)==3000 && memcmp(buf, &data[0], 3000)==0);
+
+    // many times around both rings, limited by credit
+    std::vector<char> received;
+    size_t sent = 0u;
+    while(received.size() < data.size()) {
+        if(sent < data.size()) {
+            int n = client->write(&data[sent], data.size()-sent, 0.01);
+            if(n<0)
+                break;
+            sent += size_t(n);
+        }
+        int n = server->read(buf, sizeof(buf), 0.01);
+        if(n<0)
+            break;
+        received.insert(received.end(), buf, buf+n);
+    }
+    testOk(received.size()==data.size() && memcmp(&received[0], &data[0], data.size())==0,
+           "received %u", unsigned(received.size()));
+
+    server->close();
+    testOk1(server->isClosed() && server->read(buf, 1, 1.0)==-1 && server->write(buf, 1, 1.0)==-1);
+    // the peer no longer responds
+    testOk1(client->write(buf, 1, 1.0)==-1 && client->isClosed());
+}
+
+// the connections of server moved to rings
+size_t rdmaConnections(const pva::ServerContext::shared_pointer& server)
+{
+    pva::Context::shared_pointer ctxt(std::tr1::dynamic_pointer_cast<pva::Context>(server));
+    pva::TransportRegistry::transportVector_t transports;
+    ctxt->getTransportRegistry()->toArray(transports);
+
+    size_t ret = 0u;
+    for(size_t i=0; i<transports.size(); i++) {
+        pva::detail::BlockingTCPTransportCodec *codec =
+                dynamic_cast<pva::detail::BlockingTCPTransportCodec*>(transports[i].get());
+        if(codec && codec->isRDMA())
+            ret++;
+    }
+    return ret;
+}
+
+bool matches(const pvd::PVStructure::const_shared_pointer& root, double sign, size_t nelem)
+{
+    pvd::shared_vector<const double> value(root->getSubFieldT<pvd::PVDoubleArray>("value")->view());
+    bool match = value.size()==nelem;
+    for(size_t i=0; match && i<nelem; i++)
+        match = value[i]==sign*double(i);
+    return match;
+}
+
+// a client and server on one host, through an address of the interface of the device
+void testConnection(const std::string& addr)
+{
+    testDiag("testConnection through %s", addr.c_str());
+
+    // larger than the rings, so wraps around them
+    const size_t nelem = 256u*1024u;
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    {
+        pvd::PVStructure::shared_pointer initial(pvd::getPVDataCreate()->createPVStructure(
+                                                     pvd::getFieldCreate()->createFieldBuilder()
+                                                     ->addArray("value", pvd::pvDouble)
+                                                     ->createStructure()));
+        pvd::shared_vector<double> arr(nelem);
+        for(size_t i=0; i<nelem; i++)
+            arr[i] = double(i);
+        initial->getSubFieldT<pvd::PVDoubleArray>("value")->replace(pvd::freeze(arr));
+        pv->open(*initial);
+    }
+
+    pvas::StaticProvider prov("rdma:test");
+    prov.add("tst:arr", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", addr)
+                                                      .add("EPICS_PVA_ADDR_LIST", addr)
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVA_RDMA_RING_SIZE", "65536")
+                                                      .add("EPICS_PVA_RDMA_DEVICE", testEnv("EPICS_PVA_RDMA_DEVICE", ""))
+                                                      .add("EPICS_PVA_RDMA_GID_INDEX", testEnv("EPICS_PVA_RDMA_GID_INDEX", "0"))
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    // those of the server, which doesn't report its ring options
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(server->getCurrentConfig())
+                             .add("EPICS_PVA_RDMA_RING_SIZE", "65536")
+                             .add("EPICS_PVA_RDMA_DEVICE", testEnv("EPICS_PVA_RDMA_DEVICE", ""))
+                             .add("EPICS_PVA_RDMA_GID_INDEX", testEnv("EPICS_PVA_RDMA_GID_INDEX", "0"))
+                             .push_map()
+                             .build());
+    pvac::ClientChannel chan(cli.connect("tst:arr"));
+
+    testOk1(matches(chan.get(5.0), 1.0, nelem));
+
+    // moved once validated, after the offer and reply
+    size_t rdma = 0u;
+    for(unsigned i=0; i<50u && !rdma; i++) {
+        rdma = rdmaConnections(server);
+        if(!rdma)
+            epicsThreadSleep(0.1);
+    }
+    testOk(rdma==1u, "%u connections through rings", unsigned(rdma));
+
+    testOk1(matches(chan.get(5.0), 1.0, nelem));
+
+    pvd::shared_vector<double> back(nelem);
+    for(size_t i=0; i<nelem; i++)
+        back[i] = -double(i);
+    chan.put().set("value", pvd::freeze(back)).exec(5.0);
+    testOk1(matches(chan.get(5.0), -1.0, nelem));
+}
+
+} // namespace
+
+MAIN(testRdmaRing)
+{
+    testPlan(22);
+    testEndpoint();
+    testValidReport();
+    if(!RdmaRing::isSupported()) {
+        testSkip(11, "RDMA not supported");
+    } else {
+        testTransfer();
+        std::string addr(testEnv("EPICS_PVA_RDMA_TEST_ADDR", ""));
+        if(addr.empty())
+            testSkip(4, "EPICS_PVA_RDMA_TEST_ADDR not set");
+        else {
+            try {
+                testConnection(addr);
+            }catch(std::exception& e){
+                testAbort("Unexpected exception: %s", e.what());
+            }
+        }
+    }
+    return testDone();
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <vector>
+
+#include <epicsTime.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pv/current_function.h>
+#include <pv/reconnectPacer.h>
+
+namespace pva = epics::pvAccess;
+
+namespace {
+
+void testOrder()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::ReconnectPacer pacer(1000.0);
+    const epicsTime start(epicsTime::getCurrent());
+
+    pacer.add(1, 0, 0u);
+    pacer.add(2, 5, 0u);
+    pacer.add(3, 0, 3u);
+    pacer.add(4, 5, 1u);
+    pacer.add(5, 0, 3u);
+
+    // the first at once
+    std::vector<pvAccessID> due;
+    pacer.take(start, due);
+    testOk(due.size()==1u && due[0]==4, "highest priority, most operations, first");
+
+    due.clear();
+    pacer.take(start+1.0, due);
+    testOk(due.size()==4u && due[0]==2 && due[1]==3 && due[2]==5 && due[3]==1,
+           "then by priority, operations, and order added");
+
+    testEqual(pacer.pending(), 0u);
+    testEqual(pacer.outstanding(), 5u);
+}
+
+void testRate()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::ReconnectPacer pacer(100.0);
+    epicsTime now(epicsTime::getCurrent());
+
+    for(pvAccessID cid=0; cid<1000; cid++)
+        pacer.add(cid, 0, 0u);
+
+    // answered at once
+    std::vector<pvAccessID> due;
+    for(unsigned i=0; i<20u; i++, now += 0.05) {
+        due.clear();
+        pacer.take(now, due);
+        for(size_t n=0; n<due.size(); n++)
+            pacer.completed(due[n], now);
+    }
+    const size_t taken = 1000u - pacer.pending();
+    testOk(taken>=25u && taken<=101u, "%u in the first second", unsigned(taken));
+
+    for(unsigned i=0; i<40u; i++, now += 0.05) {
+        due.clear();
+        pacer.take(now, due);
+        for(size_t n=0; n<due.size(); n++)
+            pacer.completed(due[n], now);
+    }
+    testOk(pacer.rate()==100.0, "rate %f reaches the maximum", pacer.rate());
+    testEqual(pacer.outstanding(), 0u);
+}
+
+void testSlow()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::ReconnectPacer pacer(100.0);
+    epicsTime now(epicsTime::getCurrent());
+
+    for(pvAccessID cid=0; cid<10000; cid++)
+        pacer.add(cid, 0, 0u);
+
+    std::vector<pvAccessID> due;
+    for(unsigned i=0; i<60u; i++, now += 0.05) {
+        due.clear();
+        pacer.take(now, due);
+        for(size_t n=0; n<due.size(); n++)
+            pacer.completed(due[n], now);
+    }
+    testOk(pacer.rate()==100.0, "rate %f", pacer.rate());
+
+    // the server now takes a second to answer
+    for(unsigned i=0; i<60u; i++, now += 0.05) {
+        due.clear();
+        pacer.take(now, due);
+        for(size_t n=0; n<due.size(); n++)
+            pacer.completed(due[n], now+1.0);
+    }
+    testOk(pacer.rate()<=50.0 && pacer.rate()>=1.0, "rate %f slowed, response time %f",
+           pacer.rate(), pacer.responseTime());
+}
+
+void testForget()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::ReconnectPacer pacer(10.0);
+
+    pacer.add(1, 0, 0u);
+    std::vector<pvAccessID> due;
+    pacer.take(epicsTime::getCurrent(), due);
+    pacer.forget(1);
+    testEqual(pacer.outstanding(), 0u);
+}
+
+} // namespace
+
+MAIN(testReconnectPacer)
+{
+    testPlan(10);
+    try {
+        testOrder();
+        testRate();
+        testSlow();
+        testForget();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <vector>
+
+#include <epicsThread.h>
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pv/requestPool.h>
+#include <pv/current_function.h>
+
+namespace pva = epics::pvAccess;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+struct Log {
+    epicsMutex mutex;
+    std::vector<int> order;
+    unsigned concurrent, maxConcurrent;
+    Log() :concurrent(0), maxConcurrent(0) {}
+};
+
+struct Step : public pva::RequestPool::Work
+{
+    Log& log;
+    const int value;
+    const double delay;
+    Step(Log& log, int value, double delay) :log(log), value(value), delay(delay) {}
+    virtual void run()
+    {
+        {
+            Guard G(log.mutex);
+            log.concurrent++;
+            if(log.maxConcurrent<log.concurrent)
+                log.maxConcurrent = log.concurrent;
+        }
+        epicsThreadSleep(delay);
+        Guard G(log.mutex);
+        log.concurrent--;
+        log.order.push_back(value);
+    }
+};
+
+void waitCompleted(pva::RequestPool& pool, size_t n)
+{
+    pva::RequestPool::Stats stats;
+    for(unsigned i=0; i<100; i++) {
+        pool.getStats(stats);
+        if(stats.completed>=n)
+            break;
+        epicsThreadSleep(0.05);
+    }
+}
+
+void testOrder()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::RequestPool pool(4, 100);
+    Log log;
+    int owner;
+
+    // one ID, so one at a time and in order, although the first is the slowest
+    for(int i=0; i<10; i++)
+        pool.queue(&owner, 1, pva::RequestPool::Work::shared_pointer(new Step(log, i, i==0 ? 0.2 : 0.0)));
+
+    waitCompleted(pool, 10);
+
+    Guard G(log.mutex);
+    testEqual(log.order.size(), 10u);
+    bool ordered = log.order.size()==10u;
+    for(size_t i=0; ordered && i<log.order.size(); i++)
+        ordered = log.order[i]==int(i);
+    testOk(ordered, "in order for one ID");
+    testEqual(log.maxConcurrent, 1u);
+}
+
+void testParallel()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::RequestPool pool(4, 100);
+    Log log;
+    int owner;
+
+    for(int i=0; i<8; i++)
+        pool.queue(&owner, i, pva::RequestPool::Work::shared_pointer(new Step(log, i, 0.1)));
+
+    waitCompleted(pool, 8);
+
+    pva::RequestPool::Stats stats;
+    pool.getStats(stats);
+    testEqual(stats.workers, 4u);
+    testEqual(stats.completed, 8u);
+    testEqual(stats.queued, 0u);
+    testOk(stats.maxQueued>=4u, "maxQueued %u", (unsigned)stats.maxQueued);
+
+    Guard G(log.mutex);
+    testOk(log.maxConcurrent>1u && log.maxConcurrent<=4u, "maxConcurrent %u", log.maxConcurrent);
+}
+
+void testBounded()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::RequestPool pool(1, 2);
+    Log log;
+    int owner;
+
+    // the third waits for space
+    for(int i=0; i<3; i++)
+        pool.queue(&owner, i, pva::RequestPool::Work::shared_pointer(new Step(log, i, 0.1)));
+
+    pva::RequestPool::Stats stats;
+    pool.getStats(stats);
+    testEqual(stats.blocked, 1u);
+    testOk(stats.maxQueued<=2u, "maxQueued %u", (unsigned)stats.maxQueued);
+
+    pool.stop();
+
+    // runs in the caller after stop()
+    pool.queue(&owner, 0, pva::RequestPool::Work::shared_pointer(new Step(log, 99, 0.0)));
+    Guard G(log.mutex);
+    testOk1(!log.order.empty() && log.order.back()==99);
+}
+
+void testReuse()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::RequestPool pool(2, 1000);
+    Log log;
+    int owner;
+
+    // one Work queued again, as a requester reuses it, while its earlier turn may still wait
+    pva::RequestPool::Work::shared_pointer step(new Step(log, 1, 0.0));
+    for(int i=0; i<5; i++)
+        pool.queue(&owner, 1, step);
+    waitCompleted(pool, 5);
+
+    // more IDs than are kept idle, then each of them again
+    for(int round=0; round<2; round++)
+        for(int i=0; i<200; i++)
+            pool.queue(&owner, 100+i, pva::RequestPool::Work::shared_pointer(new Step(log, 2, 0.0)));
+    waitCompleted(pool, 405);
+
+    pva::RequestPool::Stats stats;
+    pool.getStats(stats);
+    testEqual(stats.completed, 405u);
+    testEqual(stats.queued, 0u);
+
+    Guard G(log.mutex);
+    testEqual(log.order.size(), 405u);
+    testOk(log.maxConcurrent<=2u, "maxConcurrent %u", log.maxConcurrent);
+}
+
+} // namespace
+
+MAIN(testRequestPool)
+{
+    testPlan(15);
+    testOrder();
+    testParallel();
+    testBounded();
+    testReuse();
+    return testDone();
+}
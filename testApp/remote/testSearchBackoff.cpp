@@ -0,0 +1,158 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/* Backoff of unicast search destinations which don't answer.
+ *
+ * The only EPICS_PVA_ADDR_LIST entry is a UDP socket of this test,
+ * which receives search requests and answers only when told to.
+ */
+
+#include <string>
+#include <sstream>
+
+#include <string.h>
+
+#include <osiSock.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/client.h>
+#include <pv/pvaConstants.h>
+#include <pv/remote.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+struct SilentPeer {
+    SOCKET sock;
+    osiSockAddr addr;
+    // source of the last search request
+    osiSockAddr client;
+    bool heard;
+
+    SilentPeer() :sock(INVALID_SOCKET), heard(false)
+    {
+        memset(&addr, 0, sizeof(addr));
+        memset(&client, 0, sizeof(client));
+        addr.ia.sin_family = AF_INET;
+        addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.ia.sin_port = 0;
+
+        sock = epicsSocketCreate(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        osiSocklen_t len = sizeof(addr);
+        osiSockIoctl_t yes = true;
+        if(sock!=INVALID_SOCKET
+                && (::bind(sock, &addr.sa, sizeof(addr.ia))!=0
+                    || ::getsockname(sock, &addr.sa, &len)!=0
+                    || socket_ioctl(sock, FIONBIO, &yes)!=0)) {
+            epicsSocketDestroy(sock);
+            sock = INVALID_SOCKET;
+        }
+    }
+    ~SilentPeer() {
+        if(sock!=INVALID_SOCKET)
+            epicsSocketDestroy(sock);
+    }
+
+    // count the search requests naming this channel, received within timeout
+    unsigned receive(const std::string& name, double timeout, bool untilFirst)
+    {
+        unsigned found = 0u;
+        epicsTime start(epicsTime::getCurrent());
+        while(epicsTime::getCurrent()-start < timeout && !(untilFirst && found)) {
+            char buf[pva::MAX_UDP_RECV];
+            osiSockAddr src;
+            osiSocklen_t len = sizeof(src);
+            int n = ::recvfrom(sock, buf, sizeof(buf), 0, &src.sa, &len);
+            if(n<=0) {
+                epicsThreadSleep(0.01);
+                continue;
+            }
+            if(n<8 || buf[0]!=(char)pva::PVA_MAGIC || buf[3]!=(char)pva::CMD_SEARCH)
+                continue;
+            client = src;
+            heard = true;
+            if(std::string(buf, n).find(name)!=std::string::npos)
+                found++;
+        }
+        return found;
+    }
+
+    // a big endian search response from this address, for a CID no one has
+    bool answer()
+    {
+        if(!heard)
+            return false;
+        const char response[] = {
+            (char)pva::PVA_MAGIC, pva::PVA_VERSION, (char)0xc0, pva::CMD_SEARCH_RESPONSE,
+            0, 0, 0, 12+4+16+2+4+1+2+4,
+            1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, // GUID
+            0, 0, 0, 0, // sequence number
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // address of the sender
+            0, 0, // port
+            3, 't', 'c', 'p',
+            1, // found
+            0, 1, // count
+            (char)0xff, (char)0xff, (char)0xff, (char)0xff, // CID
+        };
+        return ::sendto(sock, response, sizeof(response), 0, &client.sa, sizeof(client.ia))==(int)sizeof(response);
+    }
+};
+
+void testBackoff()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    SilentPeer peer;
+    if(peer.sock==INVALID_SOCKET) {
+        testSkip(5, "no loopback socket");
+        return;
+    }
+
+    std::ostringstream dest;
+    dest<<"127.0.0.1:"<<ntohs(peer.addr.ia.sin_port);
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .add("EPICS_PVA_ADDR_LIST", dest.str())
+                             .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                             .add("EPICS_PVA_BROADCAST_PORT", "0")
+                             .push_map()
+                             .build());
+
+    // searched for after 0, 1, 3, 7 and 15 periods, each unanswered, which
+    // backs off the destination to its highest level.  Then not for another 16
+    pvac::ClientChannel first(cli.connect("backoff:first"));
+    testOk(peer.receive("backoff:first", 4.0, false)>=4u, "searches while backing off");
+
+    // its first search is not held back
+    pvac::ClientChannel second(cli.connect("backoff:second"));
+    testOk(peer.receive("backoff:second", 1.0, true)==1u, "first search of a new channel");
+
+    // the next, after 1 and 3 periods, are
+    testOk(peer.receive("backoff:second", 1.0, false)==0u, "then held back");
+
+    // an answer resets the level.  The next search, 7 periods after the first, is sent
+    testOk1(peer.answer());
+    testOk(peer.receive("backoff:second", 1.2, true)==1u, "sent again after an answer");
+}
+
+} // namespace
+
+MAIN(testSearchBackoff)
+{
+    testPlan(5);
+    try {
+        testBackoff();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pv/security.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+// allows gets, denies puts, and counts the decisions asked of it
+struct Counting : public pva::NoSecurityPlugin
+{
+    POINTER_DEFINITIONS(Counting);
+    size_t gets, puts, creates;
+    Counting() :gets(0u), puts(0u), creates(0u) {}
+    virtual ~Counting() {}
+
+    virtual pvd::Status authorizeCreateChannelGet(pva::pvAccessID, pvd::PVStructure::shared_pointer const &) {
+        creates++;
+        return pvd::Status::Ok;
+    }
+    virtual pvd::Status authorizeGet(pva::pvAccessID) {
+        gets++;
+        return pvd::Status::Ok;
+    }
+    virtual pvd::Status authorizePut(pva::pvAccessID,
+                                     pvd::PVStructure::shared_pointer const &,
+                                     pvd::BitSet::shared_pointer const &) {
+        puts++;
+        return pvd::Status::error("read only");
+    }
+};
+
+void testCache()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    Counting::shared_pointer inner(new Counting);
+    pva::CachingChannelSecuritySession css(inner);
+
+    for(pva::pvAccessID ioid=1; ioid<=3; ioid++) {
+        testOk1(css.authorizeCreateChannelGet(ioid, pvd::PVStructure::shared_pointer()).isSuccess());
+        testOk1(css.authorizeGet(ioid).isSuccess());
+        testOk1(!css.authorizePut(ioid, pvd::PVStructure::shared_pointer(), pvd::BitSet::shared_pointer()).isSuccess());
+    }
+    testEqual(inner->creates, 3u);
+    testEqual(inner->gets, 1u);
+    testEqual(inner->puts, 1u);
+
+    size_t lookups, hits;
+    css.getCounts(lookups, hits);
+    testEqual(lookups, 2u);
+    testEqual(hits, 4u);
+
+    css.rightsChanged();
+    testOk1(css.authorizeGet(4).isSuccess());
+    testOk1(css.authorizeGet(5).isSuccess());
+    testEqual(inner->gets, 2u);
+
+    pva::CachingChannelSecuritySession::rightsChangedAll();
+    testOk1(!css.authorizePut(6, pvd::PVStructure::shared_pointer(), pvd::BitSet::shared_pointer()).isSuccess());
+    testOk1(css.authorizeGet(7).isSuccess());
+    testEqual(inner->puts, 2u);
+    testEqual(inner->gets, 3u);
+}
+
+} // namespace
+
+MAIN(testSecurityCache)
+{
+    testPlan(21);
+    try {
+        testCache();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->add("value", pvd::pvInt)
+                                  ->createStructure());
+
+pva::Configuration::shared_pointer loopback()
+{
+    return pva::ConfigurationBuilder()
+            .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+            .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+            .add("EPICS_PVA_SERVER_PORT", "0")
+            .add("EPICS_PVA_BROADCAST_PORT", "0")
+            .add("EPICS_PVAS_STATS_PREFIX", "tst")
+            .add("EPICS_PVAS_STATS_PERIOD", "0.1")
+            .add("EPICS_PVAS_STATS_TOP", "2")
+            .push_map()
+            .build();
+}
+
+// row of name in a column, or -1
+int rowOf(const pvd::PVStructure::const_shared_pointer& table, const char *column, const std::string& name)
+{
+    pvd::PVStringArray::const_svector names(table->getSubFieldT<pvd::PVStringArray>(std::string("value.")+column)->view());
+    for(size_t i=0; i<names.size(); i++) {
+        if(names[i]==name)
+            return int(i);
+    }
+    return -1;
+}
+
+pvd::uint64 cell(const pvd::PVStructure::const_shared_pointer& table, const char *column, int row)
+{
+    pvd::PVULongArray::const_svector values(table->getSubFieldT<pvd::PVULongArray>(std::string("value.")+column)->view());
+    return row>=0 && size_t(row)<values.size() ? values[row] : 0u;
+}
+
+void testStats()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    pv->open(type);
+
+    pvas::StaticProvider prov("stats:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(loopback())
+                                              .provider(prov.provider())));
+
+    {
+        pva::Configuration::const_shared_pointer conf(server->getCurrentConfig());
+        testEqual(conf->getPropertyAsString("EPICS_PVAS_STATS_PREFIX", ""), "tst");
+        testEqual(conf->getPropertyAsString("EPICS_PVAS_PROVIDER_NAMES", ""), "stats:test");
+    }
+
+    pvac::ClientProvider cli("pva", server->getCurrentConfig());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+
+    for(pvd::int32 i=0; i<10; i++)
+        chan.get();
+    for(pvd::int32 i=0; i<5; i++)
+        chan.put().set("value", i).exec();
+
+    pvac::ClientChannel latency(cli.connect("tst:stats:latency"));
+    pvd::PVStructure::const_shared_pointer table;
+    epicsTime start(epicsTime::getCurrent());
+    do {
+        table = latency.get();
+        if(cell(table, "requests", rowOf(table, "operation", "get"))>=10u
+                && cell(table, "requests", rowOf(table, "operation", "put"))>=5u)
+            break;
+        epicsThreadSleep(0.1);
+    } while(epicsTime::getCurrent()-start < 5.0);
+
+    testOk(cell(table, "requests", rowOf(table, "operation", "get"))>=10u, "get requests %u",
+           unsigned(cell(table, "requests", rowOf(table, "operation", "get"))));
+    testEqual(cell(table, "requests", rowOf(table, "operation", "put")), 5u);
+    testEqual(cell(table, "requests", rowOf(table, "operation", "rpc")), 0u);
+
+    table = cli.connect("tst:stats:clients").get();
+    testEqual(table->getSubFieldT<pvd::PVStringArray>("value.remote")->view().size(), 1u);
+    testOk(cell(table, "channels", 0)>=1u, "client channels %u", unsigned(cell(table, "channels", 0)));
+    testOk(cell(table, "bytesSent", 0)>0u, "client bytesSent %u", unsigned(cell(table, "bytesSent", 0)));
+
+    table = cli.connect("tst:stats:channels").get();
+    testOk(table->getSubFieldT<pvd::PVStringArray>("value.channel")->view().size()<=2u, "top 2 channels");
+    testOk1(table->getSubFieldT<pvd::PVStringArray>("labels")->view().size()==6u);
+}
+
+std::string tunable(const std::tr1::shared_ptr<pva::ServerContext>& server, const std::string& name)
+{
+    std::vector<pva::ServerContext::Tunable> tunables;
+    server->tunables(tunables);
+    for(size_t i=0; i<tunables.size(); i++) {
+        if(tunables[i].name==name)
+            return tunables[i].value;
+    }
+    return "<missing>";
+}
+
+void testTune()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .push_config(loopback())
+                                                      .add("EPICS_PVAS_STATS_TUNE", "YES")
+                                                      .push_map()
+                                                      .build())));
+
+    testOk1(server->tune("EPICS_PVA_COALESCE_US", "100"));
+    testEqual(tunable(server, "EPICS_PVA_COALESCE_US"), "100");
+    testOk1(!server->tune("EPICS_PVA_BOGUS", "1"));
+    testOk1(!server->tune("EPICS_PVA_COALESCE_US", "soon"));
+    testOk1(!server->tune("EPICS_PVAS_SLOW_CLIENT_POLICY", "sometimes"));
+    testOk1(!server->tune("EPICS_PVA_PRIORITY_DSCP", "fast"));
+    testEqual(tunable(server, "EPICS_PVA_COALESCE_US"), "100");
+
+    pvac::ClientProvider cli("pva", server->getCurrentConfig());
+    pvac::ClientChannel tune(cli.connect("tst:tune"));
+
+    tune.put().set("value", "EPICS_PVAS_SLOW_CLIENT_POLICY=drop").exec();
+    testEqual(tunable(server, "EPICS_PVAS_SLOW_CLIENT_POLICY"), "drop");
+    testThrows(std::runtime_error, tune.put().set("value", "EPICS_PVAS_SLOW_CLIENT_POLICY").exec());
+
+    // filled by the first update
+    pvac::ClientChannel tunables(cli.connect("tst:stats:tunables"));
+    pvd::PVStructure::const_shared_pointer table;
+    epicsTime start(epicsTime::getCurrent());
+    do {
+        table = tunables.get();
+        if(rowOf(table, "name", "EPICS_PVA_MAX_TCP_RECV")>=0)
+            break;
+        epicsThreadSleep(0.1);
+    } while(epicsTime::getCurrent()-start < 5.0);
+    testOk1(rowOf(table, "name", "EPICS_PVA_MAX_TCP_RECV")>=0);
+}
+
+} // namespace
+
+MAIN(testServerStats)
+{
+    testPlan(20);
+    try {
+        testStats();
+        testTune();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,136 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <vector>
+
+#include <string.h>
+
+#ifdef __linux__
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include <epicsUnitTest.h>
+#include <epicsStdio.h>
+#include <testMain.h>
+
+#include <pv/shmRing.h>
+
+using epics::pvAccess::ShmRing;
+
+namespace {
+
+void testTransfer()
+{
+    testDiag("testTransfer");
+
+    epics::pvData::uint32 token = 0;
+    ShmRing::shared_pointer client(ShmRing::create(5000, &token));
+    testOk(!!client && token!=0, "create() token=%08x", unsigned(token));
+    testOk(client && client->ringSize()==8192u, "rounded up to 8192");
+
+    ShmRing::shared_pointer server(ShmRing::open(token));
+    testOk(!!server, "open()");
+    testOk(!ShmRing::open(token), "open() again fails");
+
+    if(!client || !server) {
+        testSkip(7, "No ring");
+        return;
+    }
+
+    char buf[8192];
+    testOk1(server->read(buf, sizeof(buf), 0.0)==0);
+
+    // fill, with wrap around
+    std::vector<char> data(12000);
+    for(size_t i=0; i<data.size(); i++)
+        data[i] = char(i*7);
+
+    testOk1(client->write(&data[0], 3000, 0.0)==3000);
+    testOk1(server->read(buf, 3000, 0.0)==3000 && memcmp(buf, &data[0], 3000)==0);
+
+    testOk1(client->write(&data[3000], 9000, 0.01)==8192);
+    testOk1(client->write(&data[11192], 800, 0.01)==0);
+    testOk1(server->read(buf, sizeof(buf), 0.0)==8192 && memcmp(buf, &data[3000], 8192)==0);
+
+    server->close();
+    testOk1(client->read(buf, 1, 1.0)==-1 && client->write(buf, 1, 1.0)==-1);
+}
+
+#ifdef __linux__
+// the first index of the ring written by the creator, as a misbehaving peer would see it
+epics::pvData::uint32* mapIndex(epics::pvData::uint32 token, size_t offset, void **base)
+{
+    char name[32];
+    epicsSnprintf(name, sizeof(name), "/epics-pva-%08x", unsigned(token));
+    int fd = shm_open(name, O_RDWR, 0);
+    if(fd<0)
+        return 0;
+    *base = mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(*base==MAP_FAILED)
+        return 0;
+    // after the 64 byte header, each index on its own cache line
+    return reinterpret_cast<epics::pvData::uint32*>(static_cast<char*>(*base) + 64 + offset);
+}
+
+void testBadIndex()
+{
+    testDiag("testBadIndex");
+
+    epics::pvData::uint32 token = 0;
+    ShmRing::shared_pointer client(ShmRing::create(4096, &token));
+    void *base = MAP_FAILED;
+    // head of client to server, then its tail
+    epics::pvData::uint32 *head = client ? mapIndex(token, 0u, &base) : 0;
+    ShmRing::shared_pointer server(head ? ShmRing::open(token) : ShmRing::shared_pointer());
+    if(!server) {
+        testSkip(5, "No ring");
+        return;
+    }
+
+    char buf[16];
+    testOk1(client->write("hello", 5, 0.0)==5);
+    // claim far more than the ring holds
+    __atomic_store_n(head, 0x10000000u, __ATOMIC_SEQ_CST);
+    testOk1(server->read(buf, sizeof(buf), 0.0)==-1);
+    testOk1(server->isClosed() && client->isClosed());
+
+    // a reader which moves the tail ahead of what was written
+    client = ShmRing::create(4096, &token);
+    munmap(base, 4096);
+    epics::pvData::uint32 *tail = client ? mapIndex(token, 64u, &base) : 0;
+    server = tail ? ShmRing::open(token) : ShmRing::shared_pointer();
+    if(!server) {
+        testSkip(2, "No ring");
+        return;
+    }
+    __atomic_store_n(tail, 0x10000000u, __ATOMIC_SEQ_CST);
+    testOk1(client->write("hello", 5, 0.0)==-1);
+    testOk1(client->isClosed());
+    munmap(base, 4096);
+}
+#else
+void testBadIndex()
+{
+    testSkip(5, "Linux only");
+}
+#endif
+
+} // namespace
+
+MAIN(testShmRing)
+{
+    testPlan(16);
+    if(!ShmRing::isSupported()) {
+        testSkip(16, "ShmRing not supported");
+    } else {
+        testTransfer();
+        testBadIndex();
+    }
+    return testDone();
+}
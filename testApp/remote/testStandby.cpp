@@ -0,0 +1,109 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <sstream>
+
+#include <epicsThread.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+// one of two servers with the same PV, whose value identifies the server
+struct Mirror {
+    pvas::SharedPV::shared_pointer pv;
+    pvas::StaticProvider prov;
+    pva::ServerContext::shared_pointer server;
+
+    explicit Mirror(pvd::int32 id)
+        :pv(pvas::SharedPV::buildReadOnly())
+        ,prov("mirror")
+    {
+        pvd::PVStructure::shared_pointer initial(pvd::getPVDataCreate()->createPVStructure(
+                                                     pvd::getFieldCreate()->createFieldBuilder()
+                                                     ->add("value", pvd::pvInt)
+                                                     ->createStructure()));
+        initial->getSubFieldT<pvd::PVInt>("value")->put(id);
+        pv->open(*initial);
+        prov.add("sb:pv", pv);
+
+        server = pva::ServerContext::create(pva::ServerContext::Config()
+                                            .config(pva::ConfigurationBuilder()
+                                                    .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                    .add("EPICS_PVA_ADDR_LIST", "")
+                                                    .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                    .add("EPICS_PVA_SERVER_PORT", "0")
+                                                    .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                    .push_map()
+                                                    .build())
+                                            .provider(prov.provider()));
+    }
+};
+
+pvd::int32 getId(pvac::ClientChannel& chan, double timeout)
+{
+    try {
+        return chan.get(timeout)->getSubFieldT<pvd::PVInt>("value")->get();
+    } catch(std::exception& e) {
+        testDiag("get() fails: %s", e.what());
+        return 0;
+    }
+}
+
+void testFailover()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    Mirror one(1), two(2);
+
+    std::ostringstream addrs;
+    addrs<<"127.0.0.1:"<<one.server->getBroadcastPort()<<" 127.0.0.1:"<<two.server->getBroadcastPort();
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .add("EPICS_PVA_ADDR_LIST", addrs.str())
+                             .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                             .add("EPICS_PVA_BROADCAST_PORT", "0")
+                             .add("EPICS_PVA_STANDBY", "YES")
+                             .push_map()
+                             .build());
+    pvac::ClientChannel chan(cli.connect("sb:pv"));
+
+    pvd::int32 first = getId(chan, 5.0);
+    testOk(first==1 || first==2, "connected to %d", int(first));
+
+    // give the other server time to answer, and the standby connection to open
+    epicsThreadSleep(1.0);
+
+    if(first==1)
+        one.server->shutdown();
+    else
+        two.server->shutdown();
+
+    pvd::int32 second = getId(chan, 5.0);
+    testOk(second!=0 && second!=first, "failed over to %d", int(second));
+}
+
+} // namespace
+
+MAIN(testStandby)
+{
+    testPlan(2);
+    try {
+        testFailover();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <sstream>
+#include <vector>
+
+#include <string.h>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/tracing.h>
+#include <pv/current_function.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+struct Collector : public pva::TraceSink
+{
+    epicsMutex mutex;
+    std::vector<pva::Span> spans;
+
+    virtual void record(const pva::Span& span)
+    {
+        Guard G(mutex);
+        spans.push_back(span);
+    }
+
+    // first span of a kind, or NULL
+    const pva::Span* find(bool server, const std::string& name)
+    {
+        for(size_t i=0; i<spans.size(); i++) {
+            if(spans[i].server==server && spans[i].name==name)
+                return &spans[i];
+        }
+        return 0;
+    }
+};
+
+void testContext()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    const std::string text("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01");
+    pva::TraceContext ctx;
+    testOk1(!ctx.valid());
+    testOk1(pva::TraceContext::parse(text, ctx));
+    testEqual(ctx.toString(), text);
+    testOk1(!pva::TraceContext::parse("00-00000000000000000000000000000000-00f067aa0ba902b7-01", ctx));
+    testOk1(!pva::TraceContext::parse("00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01", ctx));
+
+    pva::TraceContext child(ctx.child());
+    testOk1(memcmp(child.traceId, ctx.traceId, sizeof(ctx.traceId))==0);
+    testOk1(memcmp(child.spanId, ctx.spanId, sizeof(ctx.spanId))!=0);
+
+    pva::Span span;
+    span.context = child;
+    memcpy(span.parentId, ctx.spanId, sizeof(span.parentId));
+    span.name = "pva.get";
+    span.server = true;
+    span.channel = "tst:\"pv\"";
+
+    std::ostringstream strm;
+    pva::TraceFileSink::format(strm, span, "tst");
+    const std::string json(strm.str());
+    testDiag("%s", json.c_str());
+    testOk1(json.find("\"traceId\":\"4bf92f3577b34da6a3ce929d0e0e4736\"")!=std::string::npos);
+    testOk1(json.find("\"parentSpanId\":\"00f067aa0ba902b7\"")!=std::string::npos);
+    testOk1(json.find("\"kind\":2")!=std::string::npos);
+    testOk1(json.find("{\"stringValue\":\"tst:\\\"pv\\\"\"}")!=std::string::npos);
+}
+
+void testPropagation()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<Collector> collector(new Collector);
+    pva::TraceSink::add(collector);
+
+    pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildMailbox());
+    pv->open(pvd::getFieldCreate()->createFieldBuilder()
+             ->add("value", pvd::pvInt)
+             ->createStructure());
+
+    pvas::StaticProvider prov("tracing:test");
+    prov.add("tst:pv", pv);
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVA_TRACE", "YES")
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    pvac::ClientProvider cli("pva", pva::ConfigurationBuilder()
+                             .push_config(std::tr1::const_pointer_cast<pva::Configuration>(server->getCurrentConfig()))
+                             .add("EPICS_PVA_TRACE", "YES")
+                             .push_map()
+                             .build());
+    pvac::ClientChannel chan(cli.connect("tst:pv"));
+
+    // connect before tracing
+    chan.get();
+    {
+        Guard G(collector->mutex);
+        collector->spans.clear();
+    }
+
+    pva::TraceContext root(pva::TraceContext::root());
+    {
+        pva::TraceScope scope(&root);
+        chan.put().set("value", 42).exec();
+    }
+
+    Guard G(collector->mutex);
+    const pva::Span *client = collector->find(false, "pva.put"),
+                    *srv = collector->find(true, "pva.put");
+    testOk(client!=0, "client span");
+    testOk(srv!=0, "server span");
+    if(client && srv) {
+        testOk1(memcmp(client->context.traceId, root.traceId, sizeof(root.traceId))==0);
+        testOk1(memcmp(client->parentId, root.spanId, sizeof(root.spanId))==0);
+        testOk1(memcmp(srv->context.traceId, root.traceId, sizeof(root.traceId))==0);
+        testOk1(memcmp(srv->parentId, client->context.spanId, sizeof(client->parentId))==0);
+        testEqual(srv->channel, "tst:pv");
+        testOk1(epicsTimeGreaterThanEqual(&srv->end, &srv->start));
+    } else {
+        testSkip(6, "missing spans");
+    }
+
+    pva::TraceSink::remove(collector);
+}
+
+} // namespace
+
+MAIN(testTracing)
+{
+    testPlan(19);
+    try {
+        testContext();
+        testPropagation();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include <osiSock.h>
+#include <epicsEndian.h>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pva/server.h>
+#include <pva/sharedstate.h>
+#include <pva/client.h>
+#include <pv/serverContext.h>
+#include <pv/current_function.h>
+#include <pv/byteBuffer.h>
+#include <pv/pvaConstants.h>
+#include <pv/remote.h>
+#include <pv/inetAddressUtil.h>
+#include <pv/cpuAffinity.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+// datagrams received by each UDP socket bound to addr, from printInfo()
+std::vector<unsigned long> received(pva::ServerContext& server, const std::string& addr)
+{
+    std::ostringstream strm;
+    server.printInfo(strm, 1);
+
+    std::vector<unsigned long> ret;
+    std::istringstream lines(strm.str());
+    std::string line;
+    while(std::getline(lines, line)) {
+        char bound[64];
+        unsigned long rx;
+        if(sscanf(line.c_str(), " %63s rx %lu", bound, &rx)==2 && addr==bound)
+            ret.push_back(rx);
+    }
+    return ret;
+}
+
+// a search for name by cid, requiring a reply to replyPort of the source address
+void sendSearch(SOCKET sock, const osiSockAddr& server, unsigned short replyPort,
+                pvd::int32 seq, bool unicast, const std::string& name)
+{
+    pvd::ByteBuffer buf(1024);
+    buf.putByte(pva::PVA_MAGIC);
+    buf.putByte(pva::PVA_VERSION);
+    buf.putByte(EPICS_BYTE_ORDER==EPICS_ENDIAN_BIG ? 0x80 : 0x00);
+    buf.putByte(pva::CMD_SEARCH);
+    buf.putInt(0);
+    const size_t start = buf.getPosition();
+
+    buf.putInt(seq);
+    // as a client sets 0x80 when sending to one server, which relays it to the others on its host
+    buf.putByte(pvd::int8(pva::QOS_REPLY_REQUIRED | (unicast ? 0x80 : 0x00)));
+    buf.putByte(0);
+    buf.putShort(0);
+    osiSockAddr any;
+    memset(&any, 0, sizeof(any));
+    any.ia.sin_family = AF_INET;
+    pva::encodeAsIPv6Address(&buf, &any);
+    buf.putShort(pvd::int16(replyPort));
+    buf.putByte(1);
+    buf.putByte(3);
+    buf.put("tcp", 0, 3);
+    buf.putShort(1);
+    buf.putInt(seq); // cid
+    buf.putByte(pvd::int8(name.size()));
+    buf.put(name.c_str(), 0, name.size());
+    buf.put(start-4u, pvd::int32(buf.getPosition()-start));
+
+    sendto(sock, buf.getBuffer(), buf.getPosition(), 0, &server.sa, sizeof(server.ia));
+}
+
+pvd::int32 getInt(const unsigned char *b, bool big)
+{
+    return big ? pvd::int32((b[0]<<24) | (b[1]<<16) | (b[2]<<8) | b[3])
+               : pvd::int32((b[3]<<24) | (b[2]<<16) | (b[1]<<8) | b[0]);
+}
+
+// search replies by sequence ID, until none for a while
+std::map<pvd::int32, unsigned> receiveReplies(SOCKET sock)
+{
+    std::map<pvd::int32, unsigned> ret;
+    while(true) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        struct timeval timeout = {1, 0};
+        if(select(int(sock)+1, &fds, 0, 0, &timeout)<=0)
+            break;
+
+        unsigned char data[2048];
+        int n = recv(sock, (char*)data, sizeof(data), 0);
+        if(n<=0)
+            break;
+        // replies may be gathered into one datagram
+        for(size_t pos=0; pos+8u<=size_t(n); ) {
+            const bool big = data[pos+2u]&0x80;
+            const size_t payload = size_t(getInt(&data[pos+4u], big));
+            if(data[pos+3u]==pva::CMD_SEARCH_RESPONSE && payload>=16u && pos+8u+16u<=size_t(n))
+                ret[getInt(&data[pos+8u+12u], big)]++;
+            pos += 8u + payload;
+        }
+    }
+    return ret;
+}
+
+void testShards(const char *shards, const char *expect)
+{
+    testDiag("==== %s %s ====", CURRENT_FUNCTION, shards);
+
+    pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                ->add("value", pvd::pvInt)
+                                ->createStructure());
+
+    pvas::StaticProvider prov("shards:test");
+    std::vector<pvas::SharedPV::shared_pointer> pvs;
+    for(unsigned i=0; i<8u; i++) {
+        pvas::SharedPV::shared_pointer pv(pvas::SharedPV::buildReadOnly());
+        pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(type));
+        value->getSubFieldT<pvd::PVInt>("value")->put(i);
+        pv->open(*value);
+
+        char name[32];
+        sprintf(name, "tst:shard%u", i);
+        prov.add(name, pv);
+        pvs.push_back(pv);
+    }
+
+    pva::ServerContext::shared_pointer server(pva::ServerContext::create(pva::ServerContext::Config()
+                                              .config(pva::ConfigurationBuilder()
+                                                      .add("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_ADDR_LIST", "127.0.0.1")
+                                                      .add("EPICS_PVA_AUTO_ADDR_LIST", "0")
+                                                      .add("EPICS_PVA_SERVER_PORT", "0")
+                                                      .add("EPICS_PVA_BROADCAST_PORT", "0")
+                                                      .add("EPICS_PVAS_UDP_SHARDS", shards)
+                                                      .push_map()
+                                                      .build())
+                                              .provider(prov.provider())));
+
+    testEqual(server->getCurrentConfig()->getPropertyAsString("EPICS_PVAS_UDP_SHARDS", ""), expect);
+
+    unsigned nshards = 1u;
+#ifndef _WIN32
+    sscanf(expect, "%u", &nshards);
+#endif
+
+    osiSockAddr serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.ia.sin_family = AF_INET;
+    serverAddr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    serverAddr.ia.sin_port = htons(server->getCurrentConfig()->getPropertyAsInteger("EPICS_PVA_BROADCAST_PORT", 0));
+    const std::string bound(pva::inetAddressToString(serverAddr));
+
+    testEqual(received(*server, bound).size(), size_t(nshards));
+
+    // each search is answered once, by one of the shards
+    pvac::ClientProvider client("pva", server->getCurrentConfig());
+    for(unsigned i=0; i<8u; i++) {
+        char name[32];
+        sprintf(name, "tst:shard%u", i);
+        pvd::PVStructure::const_shared_pointer value(client.connect(name).get(5.0));
+        testEqual(value->getSubFieldT<pvd::PVInt>("value")->get(), pvd::int32(i));
+    }
+
+    SOCKET sock = epicsSocketCreate(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    osiSockAddr replyAddr;
+    memset(&replyAddr, 0, sizeof(replyAddr));
+    replyAddr.ia.sin_family = AF_INET;
+    replyAddr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    osiSocklen_t slen = sizeof(replyAddr.ia);
+    if(sock==INVALID_SOCKET || bind(sock, &replyAddr.sa, sizeof(replyAddr.ia))
+            || getsockname(sock, &replyAddr.sa, &slen))
+        testAbort("Unable to bind reply socket");
+    const unsigned short replyPort = ntohs(replyAddr.ia.sin_port);
+
+    const std::vector<unsigned long> before(received(*server, bound));
+    pvd::int32 seq = 0;
+
+    // The kernel picks the shard of each unicast datagram by the CPU it is received on,
+    // which for loopback is that of the sender.  So send from each CPU in turn.
+    std::set<unsigned> expected;
+    const pva::CPUAffinity all(pva::CPUAffinity::current());
+    for(unsigned cpu=0; cpu<1024u && nshards>1u; cpu++) {
+        pva::CPUAffinity one;
+        one.add(cpu);
+        if(!one.pin())
+            continue;
+        expected.insert(cpu%nshards);
+        for(unsigned i=0; i<4u; i++, seq++) {
+            char name[32];
+            sprintf(name, "tst:shard%u", unsigned(seq)%8u);
+            sendSearch(sock, serverAddr, replyPort, seq, false, name);
+        }
+    }
+    all.pin();
+
+    // relayed to the local multicast group, where each shard handles its share
+    for(unsigned i=0; i<32u; i++, seq++) {
+        char name[32];
+        sprintf(name, "tst:shard%u", unsigned(seq)%8u);
+        sendSearch(sock, serverAddr, replyPort, seq, true, name);
+    }
+
+    const std::map<pvd::int32, unsigned> replies(receiveReplies(sock));
+    epicsSocketDestroy(sock);
+
+    unsigned once = 0u, more = 0u;
+    for(std::map<pvd::int32, unsigned>::const_iterator it(replies.begin()), end(replies.end()); it!=end; ++it) {
+        if(it->second==1u)
+            once++;
+        else
+            more++;
+    }
+    testOk(once==unsigned(seq) && more==0u, "%u searches, %u answered once, %u more than once",
+           unsigned(seq), once, more);
+
+    const std::vector<unsigned long> after(received(*server, bound));
+    unsigned spread = 0u;
+    for(size_t i=0; i<after.size() && i<before.size(); i++) {
+        if(after[i]>before[i])
+            spread++;
+    }
+    if(expected.size()>1u)
+        testEqual(spread, unsigned(expected.size()));
+    else
+        testSkip(1, "only one shard, or CPU");
+}
+
+} // namespace
+
+MAIN(testUDPShards)
+{
+    testPlan(36);
+    try {
+        testShards("1", "1");
+        testShards("4", "4");
+        testShards("0", "1");
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
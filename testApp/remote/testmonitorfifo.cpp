@@ -87,7 +87,9 @@ struct Tester {
         epicsMutex mutex; // not strictly needed, but a good simulation of usage
 
         std::function<void(pva::MonitorFIFO *mon, size_t)> action;
+        size_t nunsaturated;
 
+        Handler() :nunsaturated(0u) {}
         virtual ~Handler() {}
         virtual void freeHighMark(pva::MonitorFIFO *mon, size_t numEmpty) OVERRIDE FINAL {
             testDiag("In %s", CURRENT_FUNCTION);
@@ -96,6 +98,10 @@ struct Tester {
             if(action)
                 action(mon, numEmpty);
         }
+        virtual void unsaturated(pva::MonitorFIFO *mon) OVERRIDE FINAL {
+            Guard G(mutex);
+            nunsaturated++;
+        }
     };
     Handler::weak_pointer handler;
 
@@ -169,6 +175,18 @@ struct Tester {
         mon->post(*V, changed);
     }
 
+    template<typename T>
+    void postShared(T val, const pva::SharedUpdate::shared_pointer& shared)
+    {
+        assert(!!type);
+        pvd::PVStructurePtr V(pvd::getPVDataCreate()->createPVStructure(type));
+        pvd::PVScalarPtr fld(V->getSubFieldT<pvd::PVScalar>("value"));
+        fld->putFrom(val);
+        pvd::BitSet changed;
+        changed.set(fld->getFieldOffset());
+        mon->post(*V, changed, pvd::BitSet(), shared);
+    }
+
     template<typename T>
     void tryPost(T val, bool expect, bool force = false)
     {
@@ -501,6 +519,43 @@ void checkSaturate()
     tester.testTimeline({Tester::Close});
 }
 
+// saturated() once a post() would squash, until release() makes room
+void checkUnsaturated()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+    pva::MonitorFIFO::Config conf;
+    conf.maxCount=4;
+    conf.defCount=2;
+    Tester tester(pvReqEmpty, &conf);
+    Tester::Handler::shared_pointer H(tester.handler);
+
+    testOk1(!tester.mon->saturated());
+
+    tester.connect(pvd::pvInt);
+    tester.mon->notify();
+    tester.mon->start();
+
+    tester.post(5);
+    tester.post(6);
+    testOk1(!tester.mon->saturated());
+    tester.post(7); // takes the extra element
+    testOk1(tester.mon->saturated());
+    tester.mon->notify();
+
+    testPop(*tester.mon, 5);
+    testOk1(!tester.mon->saturated());
+    testEqual(H->nunsaturated, 1u);
+
+    testPop(*tester.mon, 6);
+    testEqual(H->nunsaturated, 1u);
+
+    tester.mon->stop();
+    tester.close();
+    testOk1(!tester.mon->saturated());
+    tester.mon->notify();
+    tester.reset();
+}
+
 // check handling of pipeline=true
 void checkPipeline()
 {
@@ -763,20 +818,170 @@ void checkCountdown()
     tester.testTimeline({Tester::Close});
 }
 
+// elements posted with a SharedUpdate carry it until released
+void checkShared()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+    Tester tester(pvReqEmpty, 0);
+
+    tester.connect(pvd::pvInt);
+    tester.mon->start();
+    tester.mon->notify();
+    tester.reset();
+
+    pva::SharedUpdate::shared_pointer shared(new pva::SharedUpdate);
+    tester.postShared(5, shared);
+    tester.mon->notify();
+
+    pva::MonitorElementPtr elem(tester.mon->poll());
+    testOk1(elem && elem->shared==shared);
+    if(elem) {
+        tester.mon->release(elem);
+        testOk1(!elem->shared);
+    } else {
+        testSkip(1, "no element");
+    }
+
+    pvd::BitSet changed, overrun;
+    changed.set(1);
+    std::tr1::shared_ptr<pva::SharedUpdate::bytes_t> bytes(new pva::SharedUpdate::bytes_t(4, 'x'));
+    testOk1(!shared->find(tester.type, EPICS_BYTE_ORDER, changed, overrun));
+    shared->store(tester.type, EPICS_BYTE_ORDER, changed, overrun, bytes);
+    testOk1(shared->find(tester.type, EPICS_BYTE_ORDER, changed, overrun)==bytes);
+    overrun.set(1);
+    testOk(!shared->find(tester.type, EPICS_BYTE_ORDER, changed, overrun), "different overrun");
+
+    tester.mon->stop();
+    tester.close();
+    tester.mon->notify();
+    tester.reset();
+}
+
+// with a snapshot, elements of each subscriber refer to it until unshare()d
+void checkSnapshot()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+    Tester A(pvReqEmpty, 0), B(pvReqEmpty, 0);
+
+    A.connect(pvd::pvInt);
+    B.type = A.type;
+    B.mon->open(B.type);
+    A.mon->start();
+    B.mon->start();
+    A.mon->notify();
+    B.mon->notify();
+    A.reset();
+
+    pvd::PVStructurePtr V(pvd::getPVDataCreate()->createPVStructure(A.type));
+    pvd::PVScalarPtr fld(V->getSubFieldT<pvd::PVScalar>("value"));
+    fld->putFrom<pvd::int32>(7);
+    pvd::BitSet changed;
+    changed.set(fld->getFieldOffset());
+
+    pvd::PVStructurePtr snapshot(pvd::getPVDataCreate()->createPVStructure(A.type));
+    snapshot->copyUnchecked(*V, changed);
+    pva::SharedUpdate::shared_pointer shared(new pva::SharedUpdate(snapshot));
+    A.mon->post(*V, changed, pvd::BitSet(), shared);
+    B.mon->post(*V, changed, pvd::BitSet(), shared);
+    A.mon->notify();
+    B.mon->notify();
+
+    pva::MonitorElementPtr a(A.mon->poll()), b(B.mon->poll());
+    testOk1(a && b && a->pvStructurePtr==snapshot && b->pvStructurePtr==snapshot);
+    if(a && b) {
+        a->unshare();
+        testOk1(a->pvStructurePtr!=snapshot && !a->shared);
+        testEqual(a->pvStructurePtr->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>(), 7);
+        testOk1(b->pvStructurePtr==snapshot);
+    } else {
+        testSkip(3, "no element");
+    }
+    if(a)
+        A.mon->release(a);
+    if(b)
+        B.mon->release(b);
+
+    A.mon->stop();
+    B.mon->stop();
+    A.close();
+    B.close();
+    A.mon->notify();
+    B.mon->notify();
+    A.reset();
+}
+
+// steady state post()/poll()/release() re-uses elements
+void checkNoAlloc()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+    pva::MonitorFIFO::Config conf;
+    conf.maxCount=4;
+    conf.defCount=2;
+    Tester tester(pvReqEmpty, &conf);
+
+    tester.connect(pvd::pvInt);
+    tester.mon->notify();
+    tester.mon->start();
+
+    pvd::PVStructurePtr V(pvd::getPVDataCreate()->createPVStructure(tester.type));
+    pvd::PVScalarPtr fld(V->getSubFieldT<pvd::PVScalar>("value"));
+    pvd::BitSet changed;
+    changed.set(fld->getFieldOffset());
+
+    const size_t before = pva::MonitorElement::num_instances;
+
+    for(int i=0; i<100; i++) {
+        fld->putFrom(i);
+        tester.mon->post(*V, changed);
+        if(i%3==0)
+            tester.mon->post(*V, changed); // sometimes two
+        while(true) {
+            pva::MonitorElement::Ref elem(*tester.mon);
+            if(!elem)
+                break;
+        }
+    }
+    testEqual(pva::MonitorElement::num_instances, before);
+
+    // fill, then force
+    for(unsigned n=0; n<2; n++) {
+        tester.mon->post(*V, changed);
+        tester.mon->post(*V, changed);
+        tester.mon->tryPost(*V, changed, pvd::BitSet(), true);
+        if(n==0)
+            testEqual(pva::MonitorElement::num_instances, before+1u);
+        while(true) {
+            pva::MonitorElement::Ref elem(*tester.mon);
+            if(!elem)
+                break;
+        }
+    }
+    testEqual(pva::MonitorElement::num_instances, before+1u)<<" force'd element re-used";
+
+    tester.mon->stop();
+    tester.close();
+    tester.mon->notify();
+    tester.reset();
+}
+
 } // namespace
 
 MAIN(testmonitorfifo)
 {
-    testPlan(184);
+    testPlan(203);
     checkPlain();
     checkAfterClose();
     checkReOpenLost();
     checkTypeChange();
     checkFill();
     checkSaturate();
+    checkUnsaturated();
     checkPipeline();
     checkSpam();
     checkCountdown();
+    checkShared();
+    checkSnapshot();
+    checkNoAlloc();
     return testDone();
 }
 
@@ -3,13 +3,19 @@
  * found in the file LICENSE that is included with the distribution
  */
 
+#include <vector>
+
+#include <epicsThread.h>
+
 #include <pv/pvUnitTest.h>
 #include <testMain.h>
 
 #include <pva/client.h>
 #include <pva/sharedstate.h>
 #include <pv/current_function.h>
-//#include <pv/pvAccess.h>
+#include <pv/createRequest.h>
+#include <pv/standardField.h>
+#include <pv/pvAccess.h>
 
 namespace pvd = epics::pvData;
 namespace pva = epics::pvAccess;
@@ -186,16 +192,979 @@ void testPutRPC()
     testEqual(reply->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 100u);
 }
 
+void testPostBatch()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pvA(pvas::SharedPV::buildReadOnly()),
+                                         pvB(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:a", pvA);
+    prov->add("pv:b", pvB);
+
+    pvA->open(type);
+    pvB->open(type);
+
+    pvac::ClientProvider cli(prov->provider());
+
+    pvac::MonitorSync monA(cli.connect("pv:a").monitor()),
+                      monB(cli.connect("pv:b").monitor());
+
+    // initial updates
+    testOk1(monA.wait(1.0) && monA.poll());
+    testOk1(monB.wait(1.0) && monB.poll());
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    pvd::PVScalarPtr value(inst->getSubFieldT<pvd::PVScalar>("value"));
+    changed.set(value->getFieldOffset());
+
+    {
+        pvas::PostBatch batch;
+
+        value->putFrom<pvd::uint32>(1);
+        batch.post(*pvA, *inst, changed);
+        value->putFrom<pvd::uint32>(2);
+        batch.post(*pvA, *inst, changed);
+        value->putFrom<pvd::uint32>(3);
+        batch.post(*pvB, *inst, changed);
+
+        testEqual(batch.size(), 3u);
+        testOk(!monA.test(), "No event before flush()");
+
+        batch.flush();
+        testEqual(batch.size(), 0u);
+    }
+
+    testOk1(monA.wait(1.0) && monA.poll());
+    testEqual(monA.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 1u);
+    testOk1(monA.poll());
+    testEqual(monA.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 2u);
+
+    testOk1(monB.wait(1.0) && monB.poll());
+    testEqual(monB.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 3u);
+}
+
+void testPostQueue()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pvA(pvas::SharedPV::buildReadOnly()),
+                                         pvB(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:a", pvA);
+    prov->add("pv:b", pvB);
+
+    pvA->open(type);
+    pvB->open(type);
+
+    pvac::ClientProvider cli(prov->provider());
+
+    pvac::MonitorSync monA(cli.connect("pv:a").monitor()),
+                      monB(cli.connect("pv:b").monitor());
+
+    // initial updates
+    testOk1(monA.wait(1.0) && monA.poll());
+    testOk1(monB.wait(1.0) && monB.poll());
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    pvd::PVScalarPtr value(inst->getSubFieldT<pvd::PVScalar>("value"));
+    changed.set(value->getFieldOffset());
+
+    pvas::PostQueue::Stats stats;
+    {
+        pvas::PostQueue queue;
+
+        value->putFrom<pvd::uint32>(1);
+        queue.post(pvA, *inst, changed);
+        value->putFrom<pvd::uint32>(2);
+        queue.post(pvA, *inst, changed);
+        value->putFrom<pvd::uint32>(3);
+        queue.post(pvB, *inst, changed);
+
+        queue.getStats(stats);
+        testEqual(stats.posted, 3u);
+        testEqual(stats.merged, 1u);
+        testEqual(stats.queued, 2u);
+        testOk(!monA.test(), "No event before flush()");
+
+        queue.flush();
+
+        queue.getStats(stats);
+        testEqual(stats.flushes, 1u);
+        testEqual(stats.flushed, 2u);
+        testEqual(stats.queued, 0u);
+    }
+
+    testOk1(monA.wait(1.0) && monA.poll());
+    testEqual(monA.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 2u);
+    testOk(!monA.poll(), "merged into one update");
+
+    testOk1(monB.wait(1.0) && monB.poll());
+    testEqual(monB.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 3u);
+
+    {
+        pvas::PostQueue queue(0.05);
+
+        value->putFrom<pvd::uint32>(4);
+        queue.post(pvA, *inst, changed);
+
+        testOk(monA.wait(1.0) && monA.poll(), "flushed by worker");
+        testEqual(monA.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 4u);
+    }
+}
+
+void testSubscriberStats()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    std::vector<pvas::SharedPV::SubscriberStats> stats;
+    pv->getSubscriberStats(stats);
+    testEqual(stats.size(), 0u);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::MonitorSync mon(cli.connect("pv:name").monitor());
+
+    testOk1(mon.wait(1.0) && mon.poll());
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    pvd::PVScalarPtr value(inst->getSubFieldT<pvd::PVScalar>("value"));
+    changed.set(value->getFieldOffset());
+
+    value->putFrom<pvd::uint32>(1);
+    pv->post(*inst, changed);
+
+    pv->getSubscriberStats(stats);
+    testEqual(stats.size(), 1u);
+    testEqual(stats.at(0).nfilled, 1u);
+
+    testOk1(mon.poll());
+    stats.clear();
+    pv->getSubscriberStats(stats);
+    testEqual(stats.at(0).nfilled, 0u);
+}
+
+// updates to a full subscriber are skipped, then sent as one when it has room
+void testSkipSaturated()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::MonitorSync mon(cli.connect("pv:name").monitor(pvd::createRequest("record[queueSize=2]field()")));
+
+    // holds the initial update until the next poll()
+    testOk1(mon.wait(1.0) && mon.poll());
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    pvd::PVScalarPtr value(inst->getSubFieldT<pvd::PVScalar>("value"));
+    changed.set(value->getFieldOffset());
+
+    // 1 and 2 fill the queue.  3 and 4 are skipped
+    for(pvd::uint32 i=1u; i<=4u; i++) {
+        value->putFrom(i);
+        pv->post(*inst, changed);
+    }
+
+    std::vector<pvas::SharedPV::SubscriberStats> stats;
+    pv->getSubscriberStats(stats);
+    testEqual(stats.at(0).nfilled, 2u);
+
+    // releasing the initial update makes room for the latest
+    testOk1(mon.poll());
+    testEqual(mon.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 1u);
+    testOk1(mon.poll());
+    testEqual(mon.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 2u);
+    testOk1(mon.poll());
+    testEqual(mon.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 4u);
+    testOk1(mon.overrun.get(value->getFieldOffset()));
+    testOk1(!mon.poll());
+}
+
+void testHistory()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+
+    pv->setHistory(4);
+    pv->open(type);
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    pvd::PVScalarPtr value(inst->getSubFieldT<pvd::PVScalar>("value"));
+    changed.set(value->getFieldOffset());
+
+    for(pvd::uint32 i=1; i<=5; i++) {
+        value->putFrom(i);
+        pv->post(*inst, changed);
+    }
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chan(cli.connect("pv:name"));
+
+    {
+        pvac::MonitorSync mon(chan.monitor(pvd::createRequest("record[history=10.0]field()")));
+
+        // one was pushed out of the ring
+        std::vector<pvd::uint32> values;
+        while(mon.wait(1.0)) {
+            while(mon.poll())
+                values.push_back(mon.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>());
+            if(values.size()>=4u)
+                break;
+        }
+        testEqual(values.size(), 4u);
+        for(size_t i=0; i<4u; i++) {
+            testEqual(i<values.size() ? values[i] : 0u, pvd::uint32(i+2u));
+        }
+    }
+
+    {
+        pvac::MonitorSync mon(chan.monitor());
+
+        testOk1(mon.wait(1.0) && mon.poll());
+        testEqual(mon.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 5u);
+        testOk(!mon.poll(), "Only the current value without history=");
+    }
+}
+
+void testMany()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pvA(pvas::SharedPV::buildMailbox()),
+                                         pvB(pvas::SharedPV::buildMailbox());
+
+    prov->add("pv:a", pvA);
+    prov->add("pv:b", pvB);
+
+    pvA->open(type);
+    pvB->open(type);
+
+    pvac::ClientProvider cli(prov->provider());
+
+    std::vector<std::string> names;
+    names.push_back("pv:a");
+    names.push_back("pv:b");
+    names.push_back("pv:nonexistent");
+
+    std::vector<pvd::AnyScalar> values;
+    values.push_back(pvd::AnyScalar(pvd::uint32(4u)));
+    values.push_back(pvd::AnyScalar(pvd::uint32(5u)));
+    values.push_back(pvd::AnyScalar(pvd::uint32(6u)));
+
+    std::vector<pvac::PutEvent> put(cli.putMany(names, values, 0.5));
+    testEqual(put.size(), 3u);
+    testEqual(put[0].event, pvac::PutEvent::Success);
+    testEqual(put[1].event, pvac::PutEvent::Success);
+    testOk(put[2].event!=pvac::PutEvent::Success, "no such PV : %s", put[2].message.c_str());
+
+    names.pop_back();
+
+    std::vector<pvac::GetEvent> got(cli.getMany(names, 1.0));
+    testEqual(got.size(), 2u);
+    for(size_t i=0; i<got.size(); i++) {
+        testEqual(got[i].event, pvac::GetEvent::Success);
+        testEqual(got[i].value ? got[i].value->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>() : 0u,
+                  pvd::uint32(4u+i));
+    }
+
+    std::vector<pvac::PutEvent> processed(cli.processMany(names, 1.0));
+    testEqual(processed.size(), 2u);
+    testEqual(processed[0].event, pvac::PutEvent::Success);
+    testEqual(processed[1].event, pvac::PutEvent::Success);
+
+    got = cli.getMany(names, 1.0);
+    testEqual(got[1].value ? got[1].value->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>() : 0u,
+              pvd::uint32(5u));
+
+    // SharedPV has no putGet
+    values.pop_back();
+    std::vector<pvac::GetEvent> putgot(cli.putGetMany(names, values, 1.0));
+    testEqual(putgot.size(), 2u);
+    testOk(putgot[0].event==pvac::GetEvent::Fail, "putGet fails : %s", putgot[0].message.c_str());
+}
+
+struct GetResult : public pvac::ClientChannel::GetCallback
+{
+    epicsThreadId thread;
+    pvac::GetEvent result;
+    bool done;
+    GetResult() :thread(0), done(false) {}
+    virtual ~GetResult() {}
+    virtual void getDone(const pvac::GetEvent& evt) OVERRIDE FINAL
+    {
+        thread = epicsThreadGetIdSelf();
+        result = evt;
+        done = true;
+    }
+};
+
+void testCompletionQueue()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chan(cli.connect("pv:name"));
+
+    pvac::CompletionQueue Q;
+    GetResult cb;
+    pvac::CompletionQueue::GetCallback adapt(Q, &cb);
+
+    pvac::Operation op(chan.get(&adapt));
+
+    testOk1(Q.wait(1.0));
+    testOk1(!cb.done); // until drain()
+    testEqual(Q.drain(), 1u);
+    testOk1(cb.done && cb.result.event==pvac::GetEvent::Success);
+    testOk(cb.thread==epicsThreadGetIdSelf(), "callback in draining thread");
+    testEqual(Q.drain(), 0u);
+}
+
+void testGetAsync()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chan(cli.connect("pv:name"));
+
+    // many in flight, no thread waiting
+    std::vector<pvac::GetFuture> futures;
+    for(size_t i=0; i<10; i++)
+        futures.push_back(chan.getAsync());
+
+    bool ok = true;
+    for(size_t i=0; i<futures.size(); i++)
+        ok &= futures[i].wait(1.0).event==pvac::GetEvent::Success;
+    testOk(ok, "all complete");
+    testOk1(futures.back().ready());
+
+    GetResult cb;
+    futures.back().then(&cb); // already ready, so now
+    testOk1(cb.done && cb.thread==epicsThreadGetIdSelf());
+    testOk1(!!cb.result.value);
+
+    pvac::GetFuture cancelled(chan.getAsync());
+    cancelled.cancel();
+    testEqual(cancelled.wait(1.0).event, pvac::GetEvent::Cancel);
+}
+
+void testSharedProvider()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("testshared"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pva::ChannelProviderRegistry::clients()->addSingleton(prov->provider());
+
+    {
+        pvac::ClientProvider A(pvac::ClientProvider::shared("testshared")),
+                             B(pvac::ClientProvider::shared("testshared"));
+
+        pvac::ClientChannel chan(A.connect("pv:name"));
+        testOk1(!!chan.get());
+
+        // one channel cache
+        testOk1(B.disconnect("pv:name"));
+        testOk1(!A.disconnect("pv:name"));
+    }
+
+    pva::ChannelProviderRegistry::clients()->remove("testshared");
+}
+
+void testPollBatch()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chan(cli.connect("pv:name"));
+
+    pvac::MonitorSync mon(chan.monitor(pvd::createRequest("record[queueSize=10]field()")));
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    pvd::PVScalarPtr value(inst->getSubFieldT<pvd::PVScalar>("value"));
+    changed.set(value->getFieldOffset());
+
+    for(pvd::uint32 i=1; i<=5; i++) {
+        value->putFrom(i);
+        pv->post(*inst, changed);
+    }
+
+    // initial, and five posted
+    std::vector<pvac::MonitorUpdate> batch;
+    testEqual(mon.waitBatch(batch, 6u, 2.0), 6u);
+    bool ordered = batch.size()==6u;
+    for(size_t i=0; ordered && i<batch.size(); i++)
+        ordered = batch[i].root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>()==i;
+    testOk(ordered, "in order");
+
+    testEqual(mon.waitBatch(batch, 1u, 0.1), 0u);
+    testEqual(mon.pollBatch(batch), 0u);
+}
+
+void testMonitorSet()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pvA(pvas::SharedPV::buildReadOnly()),
+                                         pvB(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:a", pvA);
+    prov->add("pv:b", pvB);
+    pvA->open(type);
+    pvB->open(type);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chanA(cli.connect("pv:a")),
+                        chanB(cli.connect("pv:b"));
+
+    pvac::MonitorSet set;
+    pvac::Monitor monA(set.add(chanA));
+    set.add(chanB);
+    testEqual(set.size(), 2u);
+
+    // both initial updates, maybe in more than one wait()
+    size_t ndata = 0u;
+    std::vector<pvac::MonitorSet::Ready> ready;
+    while(ndata<2u && set.wait(ready, 1.0)) {
+        for(size_t i=0; i<ready.size(); i++) {
+            if(ready[i].event.event==pvac::MonitorEvent::Data && ready[i].mon.poll()) {
+                ndata++;
+                while(ready[i].mon.poll()) {}
+            }
+        }
+    }
+    testEqual(ndata, 2u);
+
+    testOk1(!set.test(ready));
+
+    monA.cancel();
+    testOk1(set.wait(ready, 1.0));
+    testOk1(ready.size()==1u && ready[0].event.event==pvac::MonitorEvent::Cancel);
+    testEqual(set.size(), 1u);
+}
+
+void postAt(pvas::SharedPV& pv, pvd::int32 value, pvd::int64 sec)
+{
+    pvd::PVStructurePtr inst(pv.build());
+    pvd::BitSet changed;
+    pvd::PVScalarPtr fld(inst->getSubFieldT<pvd::PVScalar>("value")),
+                     ts(inst->getSubFieldT<pvd::PVScalar>("timeStamp.secondsPastEpoch"));
+    fld->putFrom(value);
+    ts->putFrom(sec);
+    changed.set(fld->getFieldOffset());
+    changed.set(ts->getFieldOffset());
+    pv.post(*inst, changed);
+}
+
+void testMonitorGroup()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvd::StructureConstPtr ttype(pvd::getFieldCreate()->createFieldBuilder()
+                                 ->add("value", pvd::pvInt)
+                                 ->add("timeStamp", pvd::getStandardField()->timeStamp())
+                                 ->createStructure());
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pvA(pvas::SharedPV::buildReadOnly()),
+                                         pvB(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:a", pvA);
+    prov->add("pv:b", pvB);
+    pvA->open(ttype);
+    pvB->open(ttype);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chanA(cli.connect("pv:a")),
+                        chanB(cli.connect("pv:b"));
+
+    pvac::MonitorGroup::Options opts;
+    opts.timeout = 0.5;
+    pvac::MonitorGroup group(opts);
+    testEqual(group.add(chanA), 0u);
+    testEqual(group.add(chanB), 1u);
+
+    // the initial values, of time 0
+    pvac::MonitorGroup::Snapshot snap;
+    testOk1(group.wait(snap, 2.0) && snap.complete() && snap.secondsPastEpoch==0);
+
+    postAt(*pvA, 1, 10);
+    postAt(*pvB, 2, 10);
+    testOk1(group.wait(snap, 2.0) && snap.complete() && snap.secondsPastEpoch==10);
+    testOk1(snap.values.size()==2u
+            && snap.values[0]->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>()==1
+            && snap.values[1]->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>()==2);
+
+    // B skips 11, so it can not be completed
+    postAt(*pvA, 3, 11);
+    postAt(*pvA, 4, 12);
+    postAt(*pvB, 5, 12);
+    testOk1(group.wait(snap, 2.0) && !snap.complete() && snap.secondsPastEpoch==11
+            && snap.count==1u && snap.values[0] && !snap.values[1]);
+    testOk1(group.wait(snap, 2.0) && snap.complete() && snap.secondsPastEpoch==12);
+
+    // B never sends 13
+    postAt(*pvA, 6, 13);
+    testOk1(!group.test(snap));
+    testOk1(group.wait(snap, 2.0) && !snap.complete() && snap.secondsPastEpoch==13);
+
+    // older than the last snapshot
+    postAt(*pvB, 7, 11);
+    testOk1(!group.wait(snap, 0.1));
+
+    pvac::MonitorGroup::Stats stats;
+    group.getStats(stats);
+    testEqual(stats.complete, 3u);
+    testEqual(stats.partial, 2u);
+    testEqual(stats.dropped, 1u);
+}
+
+void testMonitorMerge()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvd::StructureConstPtr ttype(pvd::getFieldCreate()->createFieldBuilder()
+                                 ->add("value", pvd::pvInt)
+                                 ->add("timeStamp", pvd::getStandardField()->timeStamp())
+                                 ->createStructure());
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pvA(pvas::SharedPV::buildReadOnly()),
+                                         pvB(pvas::SharedPV::buildReadOnly()),
+                                         pvC(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:a", pvA);
+    prov->add("pv:b", pvB);
+    prov->add("pv:c", pvC);
+    pvA->open(ttype);
+    pvB->open(ttype);
+    pvC->open(ttype);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chanA(cli.connect("pv:a")),
+                        chanB(cli.connect("pv:b")),
+                        chanC(cli.connect("pv:c"));
+
+    pvac::MonitorMerge::Options opts;
+    opts.window = 0.2;
+    pvac::MonitorMerge merge(opts);
+    merge.add(chanA);
+    merge.add(chanB);
+    merge.add(chanC);
+    testEqual(merge.size(), 3u);
+
+    // the initial values, of time 0, maybe in more than one wait()
+    std::vector<pvac::MonitorMerge::Event> events;
+    size_t ninitial = 0u;
+    while(ninitial<3u && merge.wait(events, 2.0))
+        ninitial += events.size();
+    testEqual(ninitial, 3u);
+
+    // held until the window passes, then taken oldest first
+    postAt(*pvA, 1, 30);
+    postAt(*pvB, 2, 10);
+    postAt(*pvC, 3, 20);
+    postAt(*pvB, 4, 40);
+    testOk1(!merge.test(events));
+
+    std::vector<size_t> order;
+    while(order.size()<4u && merge.wait(events, 2.0)) {
+        for(size_t i=0; i<events.size(); i++)
+            order.push_back(events[i].index);
+    }
+    testOk(order.size()==4u && order[0]==1u && order[1]==2u && order[2]==0u && order[3]==1u,
+           "order %u %u %u %u", unsigned(order.size()>0u ? order[0] : 9u), unsigned(order.size()>1u ? order[1] : 9u),
+           unsigned(order.size()>2u ? order[2] : 9u), unsigned(order.size()>3u ? order[3] : 9u));
+
+    // older than the last taken
+    postAt(*pvC, 5, 35);
+    testOk1(merge.wait(events, 2.0) && events.size()==1u && events[0].late && events[0].index==2u
+            && events[0].update.root->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>()==5);
+
+    pvac::MonitorMerge::Stats stats;
+    merge.getStats(stats);
+    testEqual(stats.taken, 8u);
+    testEqual(stats.late, 1u);
+    testEqual(stats.held, 0u);
+}
+
+void testFrozenArray()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    pvd::StructureConstPtr atype(pvd::getFieldCreate()->createFieldBuilder()
+                                 ->addArray("value", pvd::pvDouble)
+                                 ->createStructure());
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(atype);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chan(cli.connect("pv:name"));
+    pvac::MonitorSync mon(chan.monitor());
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(atype));
+    pvd::PVDoubleArrayPtr value(inst->getSubFieldT<pvd::PVDoubleArray>("value"));
+    pvd::BitSet changed;
+    changed.set(value->getFieldOffset());
+
+    pvd::shared_vector<double> arr(3, 1.0);
+    value->replace(pvd::freeze(arr));
+    pv->post(*inst, changed);
+
+    // the initial (empty) update, then ours
+    pvd::shared_vector<const double> first;
+    while(mon.wait(1.0)) {
+        while(mon.poll())
+            mon.root->getSubFieldT<pvd::PVDoubleArray>("value")->getAs(first);
+        if(first.size()==3u)
+            break;
+    }
+    testEqual(first.size(), 3u);
+
+    arr = pvd::shared_vector<double>(3, 2.0);
+    value->replace(pvd::freeze(arr));
+    pv->post(*inst, changed);
+
+    pvd::shared_vector<const double> second;
+    testOk1(mon.wait(1.0) && mon.poll());
+    mon.root->getSubFieldT<pvd::PVDoubleArray>("value")->getAs(second);
+
+    testOk1(first.size()==3u && first[0]==1.0 && first[2]==1.0);
+    testOk1(second.size()==3u && second[0]==2.0);
+    testOk(first.data()!=second.data(), "not over-written");
+}
+
+void testGetter()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    pvd::PVScalarPtr value(inst->getSubFieldT<pvd::PVScalar>("value"));
+    changed.set(value->getFieldOffset());
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chan(cli.connect("pv:name"));
+
+    pvac::Getter getter(chan.getter());
+
+    value->putFrom<pvd::uint32>(1u);
+    pv->post(*inst, changed);
+    pvd::PVStructure::const_shared_pointer first(getter.get(1.0));
+
+    value->putFrom<pvd::uint32>(2u);
+    pv->post(*inst, changed);
+    pvd::PVStructure::const_shared_pointer second(getter.get(1.0));
+
+    testEqual(first->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 1u);
+    testEqual(second->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 2u);
+
+    getter.cancel();
+    testThrows(std::logic_error, getter.get(1.0));
+}
+
+void testValueCache()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    pvd::PVScalarPtr value(inst->getSubFieldT<pvd::PVScalar>("value"));
+    changed.set(value->getFieldOffset());
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel::Options opts;
+    opts.cacheAge = 5.0;
+    pvac::ClientChannel chan(cli.connect("pv:name", opts));
+
+    value->putFrom<pvd::uint32>(1u);
+    pv->post(*inst, changed);
+
+    // miss, which subscribes
+    testEqual(chan.get()->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 1u);
+
+    pvac::ClientProvider::CacheStats stats;
+    for(unsigned i=0; i<10 && stats.hits==0u; i++) {
+        epicsThreadSleep(0.05);
+        chan.get();
+        cli.cacheStats(stats);
+    }
+    testOk(stats.hits>=1u, "hits %u", (unsigned)stats.hits);
+
+    value->putFrom<pvd::uint32>(2u);
+    pv->post(*inst, changed);
+
+    testEqual(chan.get()->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>(), 2u);
+
+    cli.cacheStats(stats);
+    testEqual(stats.misses, 1u);
+}
+
+struct GenerationGetter : public pva::ChannelGetRequester
+{
+    pvd::uint64 generation;
+    pvd::int32 value;
+    GenerationGetter() :generation(0u), value(0) {}
+    virtual ~GenerationGetter() {}
+    virtual std::string getRequesterName() OVERRIDE FINAL { return "GenerationGetter"; }
+    virtual void channelGetConnect(const pvd::Status& status,
+                                   pva::ChannelGet::shared_pointer const & channelGet,
+                                   pvd::Structure::const_shared_pointer const & structure) OVERRIDE FINAL {}
+    virtual void getDone(const pvd::Status& status,
+                         pva::ChannelGet::shared_pointer const & channelGet,
+                         pvd::PVStructure::shared_pointer const & pvStructure,
+                         pvd::BitSet::shared_pointer const & bitSet) OVERRIDE FINAL
+    {
+        generation = channelGet->getGeneration();
+        value = pvStructure ? pvStructure->getSubFieldT<pvd::PVInt>("value")->get() : -1;
+    }
+};
+
+void testGeneration()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildReadOnly());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pva::Channel::shared_pointer chan(prov->provider()->createChannel("pv:name"));
+    std::tr1::shared_ptr<GenerationGetter> req(new GenerationGetter);
+    pva::ChannelGet::shared_pointer op(chan->createChannelGet(req, pvd::createRequest("field()")));
+
+    // SharedPV completes get() immediately
+    op->get();
+    const pvd::uint64 first = req->generation;
+    testOk(first!=0u, "generation %llu", (unsigned long long)first);
+    op->get();
+    testEqual(req->generation, first);
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSet changed;
+    inst->getSubFieldT<pvd::PVInt>("value")->put(5);
+    changed.set(inst->getSubFieldT<pvd::PVInt>("value")->getFieldOffset());
+    pv->post(*inst, changed);
+
+    op->get();
+    testOk1(req->generation!=first && req->value==5);
+
+    // and after re-opening
+    const pvd::uint64 posted = req->generation;
+    pv->close();
+    pv->open(type);
+    op = chan->createChannelGet(req, pvd::createRequest("field()"));
+    op->get();
+    testOk1(req->generation!=0u && req->generation!=posted && req->value==0);
+}
+
+struct ReuseHandler : public pvas::SharedPV::Handler
+{
+    std::vector<const pvd::BitSet*> changeds;
+    std::vector<pvd::uint32> values;
+    pvas::Operation held;
+    bool hold;
+    ReuseHandler() :hold(false) {}
+    virtual ~ReuseHandler() {}
+    virtual void onPut(const pvas::SharedPV::shared_pointer& pv, pvas::Operation& op) OVERRIDE FINAL
+    {
+        changeds.push_back(&op.changed());
+        values.push_back(op.value().getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::uint32>());
+        if(hold)
+            held = op;
+        else
+            op.complete();
+    }
+};
+
+struct PutDoneCount : public pva::ChannelPutRequester
+{
+    size_t done;
+    PutDoneCount() :done(0u) {}
+    virtual ~PutDoneCount() {}
+    virtual std::string getRequesterName() OVERRIDE FINAL { return "PutDoneCount"; }
+    virtual void channelPutConnect(const pvd::Status& status,
+                                   pva::ChannelPut::shared_pointer const & channelPut,
+                                   pvd::Structure::const_shared_pointer const & structure) OVERRIDE FINAL {}
+    virtual void putDone(const pvd::Status& status,
+                         pva::ChannelPut::shared_pointer const & channelPut) OVERRIDE FINAL
+    { if(status.isSuccess()) done++; }
+    virtual void getDone(const pvd::Status& status,
+                         pva::ChannelPut::shared_pointer const & channelPut,
+                         pvd::PVStructure::shared_pointer const & pvStructure,
+                         pvd::BitSet::shared_pointer const & bitSet) OVERRIDE FINAL {}
+};
+
+void testPutReuse()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<ReuseHandler> handler(new ReuseHandler);
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::build(handler));
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pva::Channel::shared_pointer chan(prov->provider()->createChannel("pv:name"));
+    std::tr1::shared_ptr<PutDoneCount> req(new PutDoneCount);
+    pva::ChannelPut::shared_pointer op(chan->createChannelPut(req, pvd::createRequest("field()")));
+
+    pvd::PVStructurePtr inst(pvd::getPVDataCreate()->createPVStructure(type));
+    pvd::BitSetPtr changed(new pvd::BitSet);
+    pvd::PVScalarPtr value(inst->getSubFieldT<pvd::PVScalar>("value"));
+    changed->set(value->getFieldOffset());
+
+    for(pvd::uint32 i=1u; i<=3u; i++) {
+        value->putFrom<pvd::uint32>(i);
+        op->put(inst, changed);
+    }
+    testEqual(req->done, 3u);
+    testOk(handler->values.size()==3u && handler->values[0]==1u && handler->values[2]==3u,
+           "values passed to onPut()");
+    // one Operation, reused
+    testOk1(handler->changeds.size()==3u && handler->changeds[0]==handler->changeds[2]);
+
+    // while one is held, another is allocated
+    handler->hold = true;
+    value->putFrom<pvd::uint32>(4u);
+    op->put(inst, changed);
+    handler->hold = false;
+    value->putFrom<pvd::uint32>(5u);
+    op->put(inst, changed);
+    testOk1(handler->changeds.size()==5u && handler->changeds[4]!=handler->changeds[3]
+            && handler->values[3]==4u && handler->values[4]==5u);
+
+    handler->held.complete();
+    handler->held = pvas::Operation();
+    testEqual(req->done, 5u);
+}
+
+void testPreparedPut()
+{
+    testDiag("==== %s ====", CURRENT_FUNCTION);
+
+    std::tr1::shared_ptr<pvas::StaticProvider> prov(new pvas::StaticProvider("test"));
+    std::tr1::shared_ptr<pvas::SharedPV> pv(pvas::SharedPV::buildMailbox());
+
+    prov->add("pv:name", pv);
+    pv->open(type);
+
+    pvac::ClientProvider cli(prov->provider());
+    pvac::ClientChannel chan(cli.connect("pv:name"));
+
+    pvac::PreparedPut put(chan.put().set("value", 1).set("nonesuch", 2, false).prepare());
+    put.exec(1.0);
+    testEqual(chan.get(1.0)->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>(), 1);
+
+    // converted to the type of the field
+    put.set("value", 2.0).exec(1.0);
+    testEqual(chan.get(1.0)->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>(), 2);
+    put.set("value", std::string("3")).exec(1.0);
+    testEqual(chan.get(1.0)->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>(), 3);
+
+    testThrows(std::logic_error, put.set("other", 4));
+
+    pvac::PreparedPut required(chan.put().set("nonesuch", 2).prepare());
+    testThrows(std::runtime_error, required.exec(1.0));
+
+    put.cancel();
+    testThrows(std::logic_error, put.exec(1.0));
+    testEqual(chan.get(1.0)->getSubFieldT<pvd::PVScalar>("value")->getAs<pvd::int32>(), 3);
+}
+
 } // namespace
 
 MAIN(testsharedstate)
 {
-    testPlan(19);
+    testPlan(157);
     try {
         testNoClient();
         testGetMon();
         testPutRPCCancel();
         testPutRPC();
+        testPostBatch();
+        testPostQueue();
+        testSubscriberStats();
+        testSkipSaturated();
+        testHistory();
+        testMany();
+        testCompletionQueue();
+        testGetAsync();
+        testSharedProvider();
+        testPollBatch();
+        testMonitorSet();
+        testMonitorGroup();
+        testMonitorMerge();
+        testFrozenArray();
+        testGetter();
+        testValueCache();
+        testGeneration();
+        testPutReuse();
+        testPreparedPut();
     }catch(std::exception& e){
         testAbort("Unexpected exception: %s", e.what());
     }
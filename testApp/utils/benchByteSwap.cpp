@@ -0,0 +1,81 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+/* Compare byte swapping of numeric arrays by pvData ByteBuffer::getArray(),
+ * element by element, with SerializationHelper::copySwapped()
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <epicsTime.h>
+#include <epicsEndian.h>
+#include <pv/byteBuffer.h>
+#include <pv/pvType.h>
+
+#include <pv/serializationHelper.h>
+
+namespace pvd = epics::pvData;
+using epics::pvAccess::SerializationHelper;
+
+namespace {
+
+const int otherOrder = EPICS_BYTE_ORDER==EPICS_ENDIAN_BIG ? EPICS_ENDIAN_LITTLE : EPICS_ENDIAN_BIG;
+
+double now()
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + ts.nsec*1e-9;
+}
+
+template<typename T>
+void bench(const char *name, size_t count, unsigned iterations)
+{
+    pvd::ByteBuffer buf(count*sizeof(T), otherOrder);
+    std::vector<T> dest(count);
+
+    for(size_t i=0; i<count*sizeof(T); i++)
+        buf.putByte(char(rand()));
+
+    double start = now();
+    for(unsigned n=0; n<iterations; n++) {
+        buf.setPosition(0);
+        buf.getArray(&dest[0], count);
+    }
+    double element = now() - start;
+
+    std::vector<T> check(dest);
+
+    start = now();
+    for(unsigned n=0; n<iterations; n++) {
+        SerializationHelper::copySwapped((char*)&dest[0], buf.getArray(), count, sizeof(T));
+    }
+    double bulk = now() - start;
+
+    double MB = double(count*sizeof(T))*iterations/1e6;
+    printf("%-8s element %8.1f MB/s  bulk %8.1f MB/s  %s\n", name,
+           MB/element, MB/bulk,
+           memcmp(&check[0], &dest[0], count*sizeof(T))==0 ? "" : "MISMATCH");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t count = argc>1 ? (size_t)atol(argv[1]) : 1024u*1024u;
+    unsigned iterations = argc>2 ? (unsigned)atoi(argv[2]) : 100u;
+
+    printf("%u elements, %u iterations\n", (unsigned)count, iterations);
+    bench<pvd::int16>("int16", count, iterations);
+    bench<pvd::int32>("int32", count, iterations);
+    bench<pvd::int64>("int64", count, iterations);
+    bench<float>("float", count, iterations);
+    bench<double>("double", count, iterations);
+    return 0;
+}
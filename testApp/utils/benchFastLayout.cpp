@@ -0,0 +1,148 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+/* Serialize, and deserialize, updates of an NTScalar double, as most monitors send,
+ * with PVStructure::serialize() and with serializeChanged(), which uses a FastLayout.
+ *
+ * Usage: benchFastLayout [updates]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <epicsTime.h>
+
+#include <pv/pvData.h>
+#include <pv/standardField.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+#include <pv/fieldOffsets.h>
+
+namespace pvd = epics::pvData;
+
+namespace {
+
+double now()
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + ts.nsec*1e-9;
+}
+
+// serializes into, and deserializes from, one buffer which is rewound when full
+struct LoopControl : public pvd::SerializableControl, public pvd::DeserializableControl
+{
+    pvd::ByteBuffer buffer;
+
+    LoopControl() :buffer(64*1024) {}
+    virtual ~LoopControl() {}
+
+    virtual void flushSerializeBuffer() OVERRIDE FINAL { buffer.clear(); }
+    virtual void ensureBuffer(std::size_t size) OVERRIDE FINAL {
+        if(buffer.getRemaining()<size)
+            flushSerializeBuffer();
+    }
+    virtual void alignBuffer(std::size_t) OVERRIDE FINAL {}
+    virtual bool directSerialize(pvd::ByteBuffer*, const char*, std::size_t, std::size_t) OVERRIDE FINAL {
+        return false;
+    }
+    virtual void cachedSerialize(std::tr1::shared_ptr<const pvd::Field> const & field, pvd::ByteBuffer* buf) OVERRIDE FINAL {
+        field->serialize(buf, this);
+    }
+
+    virtual void ensureData(std::size_t) OVERRIDE FINAL {}
+    virtual void alignData(std::size_t) OVERRIDE FINAL {}
+    virtual bool directDeserialize(pvd::ByteBuffer*, char*, std::size_t, std::size_t) OVERRIDE FINAL {
+        return false;
+    }
+    virtual std::tr1::shared_ptr<const pvd::Field> cachedDeserialize(pvd::ByteBuffer* buf) OVERRIDE FINAL {
+        return pvd::getFieldCreate()->deserialize(buf, this);
+    }
+};
+
+// updates/s of serialize then deserialize, with pvData or serializeChanged()
+void bench(const char *what, pvd::PVStructure& value, pvd::PVStructure& received,
+           const pvd::BitSet& changed, unsigned nupdates)
+{
+    LoopControl control;
+    pvd::BitSet bits(changed);
+    size_t pvdataBytes, fastBytes;
+
+    double start = now();
+    for(unsigned i=0; i<nupdates; i++) {
+        control.buffer.clear();
+        value.serialize(&control.buffer, &control, &bits);
+    }
+    const double pvdataSer = now() - start;
+    pvdataBytes = control.buffer.getPosition();
+
+    control.buffer.flip();
+    start = now();
+    for(unsigned i=0; i<nupdates; i++) {
+        control.buffer.setPosition(0u);
+        received.deserialize(&control.buffer, &control, &bits);
+    }
+    const double pvdataDes = now() - start;
+
+    start = now();
+    for(unsigned i=0; i<nupdates; i++) {
+        control.buffer.clear();
+        epics::pvAccess::serializeChanged(&control.buffer, &control, value, changed);
+    }
+    const double fastSer = now() - start;
+    fastBytes = control.buffer.getPosition();
+
+    control.buffer.flip();
+    start = now();
+    for(unsigned i=0; i<nupdates; i++) {
+        control.buffer.setPosition(0u);
+        epics::pvAccess::deserializeChanged(&control.buffer, &control, received, changed);
+    }
+    const double fastDes = now() - start;
+
+    printf("%s\n", what);
+    printf("  PVStructure::serialize    %10.0f updates/s  %4.0f ns\n", nupdates/pvdataSer, 1e9*pvdataSer/nupdates);
+    printf("  serializeChanged          %10.0f updates/s  %4.0f ns  %s\n", nupdates/fastSer, 1e9*fastSer/nupdates,
+           pvdataBytes==fastBytes ? "" : "MISMATCH");
+    printf("  PVStructure::deserialize  %10.0f updates/s  %4.0f ns\n", nupdates/pvdataDes, 1e9*pvdataDes/nupdates);
+    printf("  deserializeChanged        %10.0f updates/s  %4.0f ns\n", nupdates/fastDes, 1e9*fastDes/nupdates);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned nupdates = argc>1 ? (unsigned)atoi(argv[1]) : 1000000u;
+    if(nupdates==0u)
+        return 1;
+
+    pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                ->setId("epics:nt/NTScalar:1.0")
+                                ->add("value", pvd::pvDouble)
+                                ->add("alarm", pvd::getStandardField()->alarm())
+                                ->add("timeStamp", pvd::getStandardField()->timeStamp())
+                                ->createStructure());
+    const epics::pvAccess::FastLayout *layout(epics::pvAccess::FieldOffsets::of(type)->layout());
+    printf("NTScalar layout: %s\n", layout ? layout->name : "none");
+
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(type)),
+                        received(pvd::getPVDataCreate()->createPVStructure(type));
+    value->getSubFieldT<pvd::PVDouble>("value")->put(42.5);
+    value->getSubFieldT<pvd::PVLong>("timeStamp.secondsPastEpoch")->put(1234567890);
+    value->getSubFieldT<pvd::PVInt>("timeStamp.nanoseconds")->put(5000);
+
+    pvd::BitSet changed;
+    changed.set(0);
+    bench("complete", *value, *received, changed, nupdates);
+
+    // as a typical monitor update
+    changed.clear();
+    changed.set(value->getSubFieldT<pvd::PVField>("value")->getFieldOffset());
+    changed.set(value->getSubFieldT<pvd::PVField>("timeStamp")->getFieldOffset());
+    bench("value and timeStamp", *value, *received, changed, nupdates);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+/* Serialize updates of a few fields of a very wide structure, as a monitor of an
+ * NTTable with thousands of columns does, with PVStructure::serialize() and with
+ * serializeChanged().
+ *
+ * Usage: benchFieldOffsets [columns] [changed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+
+#include <epicsTime.h>
+
+#include <pv/pvData.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+#include <pv/fieldOffsets.h>
+
+namespace pvd = epics::pvData;
+
+namespace {
+
+double now()
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + ts.nsec*1e-9;
+}
+
+// discards what is serialized
+struct NullControl : public pvd::SerializableControl
+{
+    pvd::ByteBuffer buffer;
+    size_t total;
+
+    NullControl() :buffer(64*1024), total(0u) {}
+    virtual ~NullControl() {}
+
+    virtual void flushSerializeBuffer() OVERRIDE FINAL {
+        total += buffer.getPosition();
+        buffer.clear();
+    }
+    virtual void ensureBuffer(std::size_t size) OVERRIDE FINAL {
+        if(buffer.getRemaining()<size)
+            flushSerializeBuffer();
+    }
+    virtual void alignBuffer(std::size_t) OVERRIDE FINAL {}
+    virtual bool directSerialize(pvd::ByteBuffer*, const char*, std::size_t, std::size_t) OVERRIDE FINAL {
+        return false;
+    }
+    virtual void cachedSerialize(std::tr1::shared_ptr<const pvd::Field> const & field, pvd::ByteBuffer* buf) OVERRIDE FINAL {
+        field->serialize(buf, this);
+    }
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned ncols = argc>1 ? (unsigned)atoi(argv[1]) : 5000u;
+    unsigned nchanged = argc>2 ? (unsigned)atoi(argv[2]) : 3u;
+    if(ncols==0u || nchanged>ncols)
+        return 1;
+
+    pvd::FieldBuilderPtr builder(pvd::getFieldCreate()->createFieldBuilder());
+    builder = builder->setId("epics:nt/NTTable:1.0")
+                     ->addArray("labels", pvd::pvString)
+                     ->addNestedStructure("value");
+    for(unsigned c=0; c<ncols; c++) {
+        std::ostringstream strm;
+        strm<<"col"<<c;
+        builder = builder->add(strm.str(), pvd::pvDouble);
+    }
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(builder->endNested()->createStructure()));
+
+    // spread over the columns
+    pvd::BitSet changed;
+    const pvd::PVFieldPtrArray& cols(value->getSubFieldT<pvd::PVStructure>("value")->getPVFields());
+    for(unsigned i=0; i<nchanged; i++)
+        changed.set(cols[(i*ncols)/nchanged]->getFieldOffset());
+
+    const unsigned nupdates = 100000u;
+    NullControl control;
+
+    double start = now();
+    for(unsigned i=0; i<nupdates; i++)
+        value->serialize(&control.buffer, &control, &changed);
+    double pvdata = now() - start;
+    control.flushSerializeBuffer();
+    size_t pvdataBytes = control.total;
+
+    control.total = 0u;
+    start = now();
+    for(unsigned i=0; i<nupdates; i++)
+        epics::pvAccess::serializeChanged(&control.buffer, &control, *value, changed);
+    double offsets = now() - start;
+    control.flushSerializeBuffer();
+
+    printf("%u columns, %u changed\n", ncols, nchanged);
+    printf("PVStructure::serialize  %10.0f updates/s\n", nupdates/pvdata);
+    printf("serializeChanged        %10.0f updates/s  %s\n", nupdates/offsets,
+           control.total==pvdataBytes ? "" : "MISMATCH");
+    return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+/* Serialize many distinct structure types through an outgoing IntrospectionRegistry,
+ * as a server with an NTTable per device does, and compare with finding each
+ * type by comparing against all registered types in turn, as the registry did.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include <epicsTime.h>
+
+#include <pv/pvData.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+#include <pv/introspectionRegistry.h>
+
+namespace pvd = epics::pvData;
+using epics::pvAccess::IntrospectionRegistry;
+
+namespace {
+
+double now()
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + ts.nsec*1e-9;
+}
+
+// discards what is serialized
+struct NullControl : public pvd::SerializableControl
+{
+    pvd::ByteBuffer buffer;
+    size_t total;
+
+    NullControl() :buffer(64*1024), total(0u) {}
+    virtual ~NullControl() {}
+
+    virtual void flushSerializeBuffer() OVERRIDE FINAL {
+        total += buffer.getPosition();
+        buffer.clear();
+    }
+    virtual void ensureBuffer(std::size_t size) OVERRIDE FINAL {
+        if(buffer.getRemaining()<size)
+            flushSerializeBuffer();
+    }
+    virtual void alignBuffer(std::size_t) OVERRIDE FINAL {}
+    virtual bool directSerialize(pvd::ByteBuffer*, const char*, std::size_t, std::size_t) OVERRIDE FINAL {
+        return false;
+    }
+    virtual void cachedSerialize(std::tr1::shared_ptr<const pvd::Field> const & field, pvd::ByteBuffer* buf) OVERRIDE FINAL {
+        field->serialize(buf, this);
+    }
+};
+
+// an NTTable like type with columns named for device i
+pvd::StructureConstPtr makeType(unsigned i)
+{
+    pvd::FieldBuilderPtr builder(pvd::getFieldCreate()->createFieldBuilder());
+    builder = builder->setId("epics:nt/NTTable:1.0")
+                     ->addArray("labels", pvd::pvString)
+                     ->addNestedStructure("value");
+    for(unsigned c=0; c<4u; c++) {
+        std::ostringstream strm;
+        strm<<"dev"<<i<<"_col"<<c;
+        builder = builder->addArray(strm.str(), c%2u ? pvd::pvDouble : pvd::pvInt);
+    }
+    return builder->endNested()->createStructure();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned ntypes = argc>1 ? (unsigned)atoi(argv[1]) : 10000u;
+    if(ntypes>32000u)
+        ntypes = 32000u; // stay within the range of ids
+
+    std::vector<pvd::StructureConstPtr> types(ntypes), copies(ntypes);
+    for(unsigned i=0; i<ntypes; i++) {
+        types[i] = makeType(i);
+        // equal, but possibly another instance
+        copies[i] = makeType(i);
+    }
+
+    // the lookup which the registry used to make
+    std::vector<pvd::FieldConstPtr> registered;
+    registered.reserve(ntypes);
+    unsigned linearFound = 0u;
+    double start = now();
+    for(unsigned i=0; i<ntypes; i++) {
+        bool found = false;
+        for(size_t r=registered.size(); !found && r>0u; r--)
+            found = *types[i] == *registered[r-1u];
+        if(!found)
+            registered.push_back(types[i]);
+    }
+    for(unsigned i=0; i<ntypes; i++) {
+        for(size_t r=registered.size(); r>0u; r--) {
+            if(*copies[i] == *registered[r-1u]) {
+                linearFound++;
+                break;
+            }
+        }
+    }
+    double linear = now() - start;
+
+    IntrospectionRegistry registry;
+    NullControl control;
+    start = now();
+    for(unsigned i=0; i<ntypes; i++)
+        registry.serialize(types[i], &control.buffer, &control);
+    double first = now() - start;
+    size_t fullBytes = control.total + control.buffer.getPosition();
+
+    control.flushSerializeBuffer();
+    control.total = 0u;
+    start = now();
+    for(unsigned i=0; i<ntypes; i++)
+        registry.serialize(copies[i], &control.buffer, &control);
+    double again = now() - start;
+    size_t idBytes = control.total + control.buffer.getPosition();
+
+    printf("%u distinct types\n", ntypes);
+    printf("linear scan            %10.0f types/s  found %u\n", 2.0*ntypes/linear, linearFound);
+    printf("registry first use     %10.0f types/s  %u bytes\n", ntypes/first, (unsigned)fullBytes);
+    printf("registry repeated use  %10.0f types/s  %u bytes  %s\n", ntypes/again, (unsigned)idBytes,
+           idBytes==3u*ntypes ? "" : "MISMATCH");
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+/* Queue and send one-off replies, as a server does for each CMD_ECHO, through a
+ * fair_queue, with a new sender for each and with a SenderPool.  Prints the senders
+ * allocated per message.
+ *
+ * Usage: benchSenderPool [messages] [depth]
+ *
+ * depth is the number of replies queued before the first is popped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <epicsTime.h>
+
+#include <pv/fairQueue.h>
+#include <pv/senderPool.h>
+
+namespace pva = epics::pvAccess;
+
+namespace {
+
+double now()
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + ts.nsec*1e-9;
+}
+
+struct Reply : public pva::fair_queue<Reply>::entry {
+    unsigned id;
+    Reply() :id(0u) {}
+};
+
+typedef std::tr1::shared_ptr<Reply> reply_t;
+
+struct Allocate {
+    size_t allocated;
+    Allocate() :allocated(0u) {}
+    reply_t get() {
+        allocated++;
+        return reply_t(new Reply);
+    }
+    size_t num_allocated() const { return allocated; }
+};
+
+template<typename Source>
+double run(Source& source, unsigned nmessages, unsigned depth, unsigned& sum)
+{
+    pva::fair_queue<Reply> queue;
+    reply_t out;
+
+    double start = now();
+    for(unsigned i=0; i<nmessages; i++) {
+        {
+            reply_t R(source.get());
+            R->id = i;
+            queue.push_back(R);
+        }
+        if(i>=depth && queue.pop_front_try(out)) {
+            sum += out->id;
+            out.reset();
+        }
+    }
+    while(queue.pop_front_try(out)) {
+        sum += out->id;
+        out.reset();
+    }
+    return now() - start;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned nmessages = argc>1 ? (unsigned)atoi(argv[1]) : 1000000u;
+    unsigned depth = argc>2 ? (unsigned)atoi(argv[2]) : 4u;
+    if(nmessages==0u)
+        return 1;
+
+    unsigned sum = 0u;
+
+    Allocate alloc;
+    double tnew = run(alloc, nmessages, depth, sum);
+
+    pva::SenderPool<Reply> pool;
+    double tpool = run(pool, nmessages, depth, sum);
+
+    printf("%u messages, %u queued\n", nmessages, depth);
+    printf("new        %10.0f messages/s  %.3f allocations/message\n",
+           nmessages/tnew, double(alloc.num_allocated())/nmessages);
+    printf("SenderPool %10.0f messages/s  %.3f allocations/message\n",
+           nmessages/tpool, double(pool.num_allocated())/nmessages);
+    return sum==0u ? 1 : 0;
+}
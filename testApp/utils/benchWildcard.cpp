@@ -0,0 +1,84 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+/* Compare testing names against many wildcard patterns one by one with
+ * Wildcard::wildcardfit(), as service providers did, with one WildcardSet::match()
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include <epicsTime.h>
+
+#include <pv/wildcard.h>
+
+using epics::pvAccess::Wildcard;
+using epics::pvAccess::WildcardSet;
+
+namespace {
+
+double now()
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + ts.nsec*1e-9;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned npatterns = argc>1 ? (unsigned)atoi(argv[1]) : 500u;
+    unsigned nnames = argc>2 ? (unsigned)atoi(argv[2]) : 10000u;
+
+    // patterns like services of many devices, "SR01:BPM*:orbit"
+    std::vector<std::string> patterns(npatterns);
+    WildcardSet set;
+    for(unsigned i=0; i<npatterns; i++) {
+        std::ostringstream strm;
+        strm<<"SR"<<(i/10u)<<":DEV"<<(i%10u)<<"*:service?";
+        patterns[i] = strm.str();
+        set.add(patterns[i]);
+    }
+
+    // half of the names match a pattern
+    std::vector<std::string> names(nnames);
+    for(unsigned i=0; i<nnames; i++) {
+        std::ostringstream strm;
+        unsigned p = (i*7919u)%(2u*npatterns);
+        strm<<"SR"<<(p/10u)<<":DEV"<<(p%10u)<<"x"<<i<<":service"<<char('A'+i%26u);
+        names[i] = strm.str();
+    }
+
+    unsigned linearFound = 0u;
+    double start = now();
+    for(unsigned i=0; i<nnames; i++) {
+        for(unsigned p=0; p<npatterns; p++) {
+            if(Wildcard::wildcardfit(patterns[p].c_str(), names[i].c_str())) {
+                linearFound++;
+                break;
+            }
+        }
+    }
+    double linear = now() - start;
+
+    unsigned setFound = 0u;
+    start = now();
+    for(unsigned i=0; i<nnames; i++) {
+        if(set.match(names[i]))
+            setFound++;
+    }
+    double compiled = now() - start;
+
+    printf("%u patterns, %u names\n", npatterns, nnames);
+    printf("wildcardfit  %10.0f names/s  found %u\n", nnames/linear, linearFound);
+    printf("WildcardSet  %10.0f names/s  found %u  %s\n", nnames/compiled, setFound,
+           linearFound==setFound ? "" : "MISMATCH");
+    return 0;
+}
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include <stdlib.h>
 
@@ -53,6 +54,53 @@ static void testBuilder()
     testOk1(C->getPropertyAsString("OTHERKEY", "X")=="value3");
 }
 
+namespace {
+struct CountChanges : public ConfigurationListener
+{
+    std::vector<std::string> names;
+    virtual void propertyChanged(const std::string& name, const ConfigurationCache& conf)
+    {
+        names.push_back(name);
+    }
+};
+}
+
+static void testCache()
+{
+    testDiag("testCache()");
+    setEnv("CACHEKEY", "1");
+    Configuration::shared_pointer C(ConfigurationCache::wrap(ConfigurationBuilder()
+                                                             .push_env()
+                                                             .add("MAPKEY","value1")
+                                                             .push_map()
+                                                             .build()));
+    testOk1(ConfigurationCache::wrap(C)==C);
+
+    testOk1(C->getPropertyAsInteger("CACHEKEY", 0)==1);
+    testOk1(!C->hasProperty("MISSINGKEY"));
+    testOk1(C->getPropertyAsString("MAPKEY", "X")=="value1");
+
+    setEnv("CACHEKEY", "2");
+    setEnv("MISSINGKEY", "3");
+    // the values of the first lookup are kept
+    testOk1(C->getPropertyAsInteger("CACHEKEY", 0)==1);
+    testOk1(!C->hasProperty("MISSINGKEY"));
+
+    ConfigurationCache::shared_pointer cache(std::tr1::static_pointer_cast<ConfigurationCache>(C));
+    std::tr1::shared_ptr<CountChanges> listener(new CountChanges);
+    cache->addListener(listener);
+
+    testOk1(cache->reload()==2u);
+    testOk1(listener->names.size()==2u);
+    testOk1(C->getPropertyAsInteger("CACHEKEY", 0)==2);
+    testOk1(C->getPropertyAsInteger("MISSINGKEY", 0)==3);
+
+    cache->removeListener(listener);
+    setEnv("CACHEKEY", "4");
+    testOk1(cache->reload()==1u);
+    testOk1(listener->names.size()==2u);
+}
+
 static void showAddr(const osiSockAddr& addr)
 {
     char buf[40];
@@ -140,8 +188,9 @@ void testConfig()
 
 MAIN(configurationTest)
 {
-    testPlan(40);
+    testPlan(52);
     testBuilder();
+    testCache();
     testConfig();
     return testDone();
 }
@@ -0,0 +1,164 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pv/pvData.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+#include <pv/arrayPool.h>
+
+#include "testBufferControl.h"
+
+namespace pvd = epics::pvData;
+using epics::pvAccess::ArrayPool;
+
+namespace {
+
+const pvd::StructureConstPtr waveform(pvd::getFieldCreate()->createFieldBuilder()
+                                      ->addArray("value", pvd::pvDouble)
+                                      ->add("count", pvd::pvInt)
+                                      ->createStructure());
+
+void testApplies()
+{
+    testDiag("testApplies");
+
+    testOk1(ArrayPool::applies(*waveform));
+    testOk1(!ArrayPool::applies(*pvd::getFieldCreate()->createFieldBuilder()
+                                ->add("value", pvd::pvDouble)
+                                ->addArray("labels", pvd::pvString)
+                                ->createStructure()));
+    testOk1(!ArrayPool::applies(*pvd::getFieldCreate()->createFieldBuilder()
+                                ->addFixedArray("value", pvd::pvInt, 4)
+                                ->createStructure()));
+    testOk1(ArrayPool::applies(*pvd::getFieldCreate()->createFieldBuilder()
+                               ->addNestedStructure("image")
+                                   ->addArray("pixels", pvd::pvUShort)
+                               ->endNested()
+                               ->createStructure()));
+}
+
+// a monitor receiving waveforms, as MonitorStrategyQueue does
+struct Receiver {
+    pvd::PVStructurePtr sent, received;
+    pvd::PVDoubleArrayPtr value;
+    pvd::BitSet changed;
+    ArrayPool::shared_pointer pool;
+
+    explicit Receiver(size_t maxBytes)
+        :sent(pvd::getPVDataCreate()->createPVStructure(waveform))
+        ,received(pvd::getPVDataCreate()->createPVStructure(waveform))
+        ,value(received->getSubFieldT<pvd::PVDoubleArray>("value"))
+        ,pool(new ArrayPool(maxBytes))
+    {
+        changed.set(value->getFieldOffset());
+    }
+
+    void update(size_t count, double first)
+    {
+        pvd::PVDoubleArray::svector arr(count);
+        for(size_t i=0; i<count; i++)
+            arr[i] = first + i;
+        sent->getSubFieldT<pvd::PVDoubleArray>("value")->replace(pvd::freeze(arr));
+
+        BufferControl control;
+        sent->serialize(&control.buffer, &control, &changed);
+        control.buffer.flip();
+
+        pool->prepare(*received, changed);
+        received->deserialize(&control.buffer, &control, &changed);
+    }
+};
+
+void testReuse()
+{
+    testDiag("testReuse");
+
+    Receiver R(1024u*1024u);
+
+    R.update(100u, 0.0);
+    testEqual(R.pool->allocated(), 0u); // nothing held, so pvData reuses it
+
+    // the application holds the last update
+    pvd::PVDoubleArray::const_svector held(R.value->view());
+
+    R.pool->prepare(*R.received, R.changed);
+    testEqual(R.pool->allocated(), 1u);
+    testOk1(R.value->view().empty());
+    testOk1(R.value->view().capacity()>=100u);
+
+    R.update(100u, 1000.0);
+    testEqual(R.value->view().size(), 100u);
+    testEqual(R.value->view()[99], 1099.0);
+    testEqual(held[99], 99.0);
+    testOk1(R.value->view().data()!=held.data());
+
+    // pooled storage returns when released
+    held = R.value->view();
+    R.update(100u, 2000.0);
+    testEqual(R.pool->allocated(), 2u);
+    held.clear();
+    testEqual(R.pool->bytes(), 100u*sizeof(double));
+
+    held = R.value->view();
+    R.update(100u, 3000.0);
+    testEqual(R.pool->reused(), 1u);
+    testEqual(R.pool->bytes(), 0u);
+    testEqual(R.value->view()[0], 3000.0);
+    held.clear();
+
+    // a longer array is allocated by pvData, then pooled storage has its length
+    R.update(200u, 4000.0);
+    held = R.value->view();
+    R.pool->prepare(*R.received, R.changed);
+    testEqual(R.pool->allocated(), 3u);
+    testOk1(R.value->view().capacity()>=200u);
+    held.clear();
+}
+
+void testLimit()
+{
+    testDiag("testLimit");
+
+    Receiver R(100u);
+
+    R.update(100u, 0.0);
+    pvd::PVDoubleArray::const_svector held(R.value->view());
+    R.update(100u, 1000.0);
+    held = R.value->view();
+    R.update(100u, 2000.0);
+    held.clear();
+    // larger than the pool may hold
+    testEqual(R.pool->bytes(), 0u);
+
+    // released after the pool is gone
+    held = R.value->view();
+    R.update(100u, 3000.0);
+    R.pool.reset();
+    held = R.value->view();
+    R.received.reset();
+    R.value.reset();
+    held.clear();
+    testPass("released after pool");
+}
+
+} // namespace
+
+MAIN(testArrayPool)
+{
+    testPlan(21);
+    try {
+        testApplies();
+        testReuse();
+        testLimit();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
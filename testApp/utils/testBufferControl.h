@@ -0,0 +1,50 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+#ifndef TESTBUFFERCONTROL_H
+#define TESTBUFFERCONTROL_H
+
+/* (De)serialization into one in-memory buffer, shared by the tests of
+ * serialization helpers which don't need a codec.
+ */
+
+#include <epicsEndian.h>
+#include <compilerDependencies.h>
+
+#include <pv/pvData.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+// everything in one buffer
+struct BufferControl : public epics::pvData::SerializableControl, public epics::pvData::DeserializableControl
+{
+    epics::pvData::ByteBuffer buffer;
+
+    explicit BufferControl(std::size_t size = 64*1024, int byteOrder = EPICS_BYTE_ORDER)
+        :buffer(size, byteOrder)
+    {}
+    virtual ~BufferControl() {}
+
+    virtual void flushSerializeBuffer() OVERRIDE FINAL {}
+    virtual void ensureBuffer(std::size_t) OVERRIDE FINAL {}
+    virtual void alignBuffer(std::size_t) OVERRIDE FINAL {}
+    virtual bool directSerialize(epics::pvData::ByteBuffer*, const char*, std::size_t, std::size_t) OVERRIDE FINAL {
+        return false;
+    }
+    virtual void cachedSerialize(std::tr1::shared_ptr<const epics::pvData::Field> const & field,
+                                 epics::pvData::ByteBuffer* buf) OVERRIDE FINAL {
+        field->serialize(buf, this);
+    }
+
+    virtual void ensureData(std::size_t) OVERRIDE FINAL {}
+    virtual void alignData(std::size_t) OVERRIDE FINAL {}
+    virtual bool directDeserialize(epics::pvData::ByteBuffer*, char*, std::size_t, std::size_t) OVERRIDE FINAL {
+        return false;
+    }
+    virtual std::tr1::shared_ptr<const epics::pvData::Field> cachedDeserialize(epics::pvData::ByteBuffer* buf) OVERRIDE FINAL {
+        return epics::pvData::getFieldCreate()->deserialize(buf, this);
+    }
+};
+
+#endif // TESTBUFFERCONTROL_H
@@ -0,0 +1,152 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string.h>
+#include <vector>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pv/bufferPool.h>
+
+using epics::pvAccess::BufferPool;
+using epics::pvAccess::PooledBlock;
+using epics::pvAccess::HugePageAllocator;
+
+namespace {
+
+const size_t MB = 1024u*1024u;
+
+// before testInstall(), with malloc()
+void testPool()
+{
+    testDiag("testPool");
+
+    testEqual(BufferPool::cachedBytes(), 0u);
+
+    char *block = BufferPool::allocate(10000u);
+    memset(block, 1, 10000u);
+    BufferPool::release(block, 10000u);
+    testEqual(BufferPool::cachedBytes(), 12288u);
+
+    // the same size class of 12KB
+    char *again = BufferPool::allocate(12288u);
+    testOk(again==block, "re-used");
+    testEqual(BufferPool::cachedBytes(), 0u);
+    BufferPool::release(again, 12288u);
+
+    // while that is cached, the next size class is not it
+    char *larger = BufferPool::allocate(12289u);
+    testOk(larger!=block, "16KB class");
+    testEqual(BufferPool::cachedBytes(), 12288u);
+    BufferPool::release(larger, 12289u);
+    testEqual(BufferPool::cachedBytes(), 12288u + 16384u);
+
+    // out of the cache, while the cap is tested
+    block = BufferPool::allocate(12288u);
+    larger = BufferPool::allocate(16384u);
+    testEqual(BufferPool::cachedBytes(), 0u);
+
+    // the 17th block of 4MB exceeds the 64MB cap, and is freed
+    std::vector<char*> big(17u);
+    for(size_t i=0; i<big.size(); i++)
+        big[i] = BufferPool::allocate(4u*MB);
+    for(size_t i=0; i<big.size(); i++)
+        BufferPool::release(big[i], 4u*MB);
+    testEqual(BufferPool::cachedBytes(), 64u*MB);
+
+    // most recently released first
+    bool reused = true;
+    for(size_t i=0; i<16u; i++)
+        reused &= BufferPool::allocate(4u*MB)==big[15u-i];
+    testOk(reused, "16 blocks of 4MB re-used");
+    testEqual(BufferPool::cachedBytes(), 0u);
+    for(size_t i=0; i<16u; i++)
+        BufferPool::release(big[i], 4u*MB);
+
+    BufferPool::release(block, 12288u);
+    BufferPool::release(larger, 16384u);
+    testEqual(BufferPool::cachedBytes(), 64u*MB);
+}
+
+void testAllocator()
+{
+    testDiag("testAllocator");
+
+    HugePageAllocator alloc;
+    testEqual(alloc.pageSize(), 2u*MB);
+
+    // small blocks use malloc()
+    char *small = alloc.allocate(1000u);
+    memset(small, 1, 1000u);
+    alloc.release(small, 1000u);
+    testEqual(alloc.bytes(), 0u);
+
+#ifdef __linux__
+    char *big = alloc.allocate(3u*MB);
+    big[0] = 1;
+    big[3u*MB-1u] = 2;
+    testEqual(alloc.bytes(), 4u*MB);
+    testOk1((size_t(big) & (2u*MB-1u))==0u);
+
+    // cached in the size class of 4MB
+    alloc.release(big, 3u*MB);
+    testEqual(alloc.bytes(), 4u*MB);
+    char *again = alloc.allocate(4u*MB - 4096u);
+    testOk1(again==big);
+    alloc.release(again, 4u*MB - 4096u);
+
+    HugePageAllocator uncached(2u*MB, 0u);
+    big = uncached.allocate(2u*MB);
+    testEqual(uncached.bytes(), 2u*MB);
+    uncached.release(big, 2u*MB);
+    testEqual(uncached.bytes(), 0u);
+#else
+    testSkip(6, "huge pages only on Linux");
+#endif
+}
+
+void testInstall()
+{
+    testDiag("testInstall");
+
+    testOk1(!HugePageAllocator::install("bogus"));
+    testOk1(HugePageAllocator::install("NO"));
+    testOk1(!BufferPool::allocator());
+
+    testOk1(HugePageAllocator::install("2M"));
+    testOk1(!!dynamic_cast<HugePageAllocator*>(BufferPool::allocator()));
+    testOk1(HugePageAllocator::install("YES"));
+    testOk1(!HugePageAllocator::install("1G"));
+
+    {
+        PooledBlock block(MB);
+        block.data()[0] = 1;
+        block.data()[MB-1u] = 2;
+        HugePageAllocator other;
+        testOk1(!BufferPool::setAllocator(&other));
+    }
+#ifdef __linux__
+    testOk1(BufferPool::allocator()->bytes()>=MB);
+#else
+    testSkip(1, "huge pages only on Linux");
+#endif
+}
+
+} // namespace
+
+MAIN(testBufferPool)
+{
+    testPlan(29);
+    try {
+        testPool();
+        testAllocator();
+        testInstall();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
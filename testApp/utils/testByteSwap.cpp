@@ -0,0 +1,112 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string.h>
+#include <stdexcept>
+#include <vector>
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pv/serializationHelper.h>
+
+using epics::pvAccess::SerializationHelper;
+
+namespace {
+
+// enough elements to pass through the 32 and 16 byte blocks, and every tail length
+const size_t maxCount = 80u;
+
+std::vector<char> pattern(size_t n)
+{
+    std::vector<char> ret(n);
+    for(size_t i=0; i<n; i++)
+        ret[i] = char(i*7u + 1u);
+    return ret;
+}
+
+// element by element
+std::vector<char> reversed(const char* src, size_t count, size_t elementSize)
+{
+    std::vector<char> ret(count*elementSize + 1u);
+    for(size_t i=0; i<count; i++)
+        for(size_t b=0; b<elementSize; b++)
+            ret[i*elementSize + b] = src[i*elementSize + elementSize-1u-b];
+    return ret;
+}
+
+void testSize(size_t elementSize)
+{
+    testDiag("testSize(%u)", unsigned(elementSize));
+
+    const std::vector<char> src(pattern(maxCount*elementSize + 1u));
+
+    // each count, and a guard byte after the last element which is not touched
+    bool ok = true;
+    for(size_t count=0; count<=maxCount && ok; count++) {
+        std::vector<char> dst(count*elementSize + 1u, 'x');
+        SerializationHelper::copySwapped(&dst[0], &src[0], count, elementSize);
+        std::vector<char> expect(reversed(&src[0], count, elementSize));
+        ok = memcmp(&dst[0], &expect[0], count*elementSize)==0 && dst[count*elementSize]=='x';
+        if(!ok)
+            testDiag("count %u differs", unsigned(count));
+    }
+    testOk(ok, "%u byte elements", unsigned(elementSize));
+
+    // misaligned src and dst
+    ok = true;
+    for(size_t count=0; count<=maxCount && ok; count++) {
+        std::vector<char> dst(count*elementSize + 2u, 'x');
+        SerializationHelper::copySwapped(&dst[1], &src[1], count, elementSize);
+        std::vector<char> expect(reversed(&src[1], count, elementSize));
+        ok = dst[0]=='x' && memcmp(&dst[1], &expect[0], count*elementSize)==0 && dst[count*elementSize+1u]=='x';
+        if(!ok)
+            testDiag("count %u differs", unsigned(count));
+    }
+    testOk(ok, "%u byte elements, misaligned", unsigned(elementSize));
+
+    // in place
+    ok = true;
+    for(size_t count=0; count<=maxCount && ok; count++) {
+        std::vector<char> buf(src.begin(), src.begin() + count*elementSize + 1u);
+        SerializationHelper::copySwapped(&buf[0], &buf[0], count, elementSize);
+        std::vector<char> expect(reversed(&src[0], count, elementSize));
+        ok = memcmp(&buf[0], &expect[0], count*elementSize)==0 && buf[count*elementSize]==src[count*elementSize];
+        if(!ok)
+            testDiag("count %u differs", unsigned(count));
+    }
+    testOk(ok, "%u byte elements, in place", unsigned(elementSize));
+}
+
+void testBytes()
+{
+    testDiag("testBytes");
+
+    const std::vector<char> src(pattern(maxCount));
+    std::vector<char> dst(maxCount);
+    SerializationHelper::copySwapped(&dst[0], &src[0], maxCount, 1u);
+    testOk(dst==src, "1 byte elements are copied");
+
+    bool threw = false;
+    try {
+        SerializationHelper::copySwapped(&dst[0], &src[0], 2u, 3u);
+    } catch(std::logic_error&) {
+        threw = true;
+    }
+    testOk(threw, "3 byte elements are refused");
+}
+
+} // namespace
+
+MAIN(testByteSwap)
+{
+    testPlan(11);
+    testSize(2u);
+    testSize(4u);
+    testSize(8u);
+    testBytes();
+    return testDone();
+}
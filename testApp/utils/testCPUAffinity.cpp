@@ -0,0 +1,75 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <vector>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <pv/cpuAffinity.h>
+
+using epics::pvAccess::CPUAffinity;
+
+namespace {
+
+void testParse()
+{
+    testDiag("testParse");
+
+    CPUAffinity A;
+    testOk1(A.parse("0-3,8,10-11") && A.size()==7u);
+    testOk(A.toString()=="0-3,8,10-11", "toString() %s", A.toString().c_str());
+
+    testOk1(A.parse(" 5,1,3-4,1\n") && A.toString()=="1,3-5");
+    testOk1(A.parse("") && A.empty());
+
+    testOk1(!A.parse("1-"));
+    testOk1(!A.parse("3-1"));
+    testOk1(!A.parse("a"));
+    testOk1(!A.parse("1,,2"));
+}
+
+void testPin()
+{
+    testDiag("testPin");
+
+#ifdef __linux__
+    const CPUAffinity inherited(CPUAffinity::current());
+    testOk(!inherited.empty(), "current() %s", inherited.toString().c_str());
+
+    CPUAffinity first;
+    first.parse(inherited.toString().substr(0, inherited.toString().find_first_of(",-")));
+    testOk1(first.size()==1u && first.pin());
+    testOk(CPUAffinity::current().toString()==first.toString(),
+           "pinned to %s", CPUAffinity::current().toString().c_str());
+    testOk1(inherited.pin() && CPUAffinity::current().toString()==inherited.toString());
+
+    // absent without NUMA, eg. in some containers
+    const int node = first.node();
+    testDiag("CPU %s on NUMA node %d", first.toString().c_str(), node);
+    if(node>=0) {
+        testOk1(!CPUAffinity::ofNode(node).empty());
+
+        std::vector<char> buf(1u<<20, 1);
+        testOk1(CPUAffinity::placeMemory(&buf[0], buf.size(), node));
+    } else {
+        testSkip(2, "No NUMA node");
+    }
+#else
+    testSkip(6, "Only on Linux");
+#endif
+    testOk1(CPUAffinity::ofNode(-1).empty());
+}
+
+} // namespace
+
+MAIN(testCPUAffinity)
+{
+    testPlan(15);
+    testParse();
+    testPin();
+    return testDone();
+}
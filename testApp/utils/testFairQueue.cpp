@@ -6,7 +6,11 @@
 
 #include <vector>
 
+#include <epicsThread.h>
+#include <epicsTime.h>
+
 #include <pv/fairQueue.h>
+#include <pv/mpscQueue.h>
 
 #include <epicsUnitTest.h>
 #include <testMain.h>
@@ -18,6 +22,67 @@ struct Qnode : public epics::pvAccess::fair_queue<Qnode>::entry {
     Qnode(unsigned i):i(i) {}
 };
 
+struct Mnode : public epics::pvAccess::mpsc_queue<Mnode>::entry {
+    unsigned i;
+    Mnode(unsigned i):i(i) {}
+};
+
+// pushes every nth of the nodes, starting at first
+template<typename Q>
+struct Producer : public epicsThreadRunable
+{
+    Q& queue;
+    const std::vector<typename Q::value_type>& nodes;
+    size_t first, step;
+    epicsThread thread;
+
+    Producer(Q& queue, const std::vector<typename Q::value_type>& nodes, size_t first, size_t step)
+        :queue(queue), nodes(nodes), first(first), step(step)
+        ,thread(*this, "producer", epicsThreadGetStackSize(epicsThreadStackSmall))
+    {}
+    virtual ~Producer() {}
+    virtual void run()
+    {
+        for(size_t i=first; i<nodes.size(); i+=step)
+            queue.push_back(nodes[i]);
+    }
+};
+
+// nproducers threads push distinct nodes, which the caller's thread pops
+template<typename Q, typename Node>
+void benchContention(const char *name, unsigned nproducers, size_t nnodes)
+{
+    Q queue;
+    std::vector<typename Q::value_type> nodes(nnodes);
+    for(size_t i=0; i<nnodes; i++)
+        nodes[i].reset(new Node(unsigned(i)));
+
+    std::vector<Producer<Q>*> producers;
+    for(unsigned p=0; p<nproducers; p++)
+        producers.push_back(new Producer<Q>(queue, nodes, p, nproducers));
+
+    epicsTime start(epicsTime::getCurrent());
+    for(unsigned p=0; p<nproducers; p++)
+        producers[p]->thread.start();
+
+    size_t popped = 0u;
+    while(popped<nnodes) {
+        typename Q::value_type E;
+        if(!queue.pop_front(E, 5.0))
+            break;
+        popped++;
+    }
+    double elapsed = epicsTime::getCurrent() - start;
+
+    for(unsigned p=0; p<nproducers; p++) {
+        producers[p]->thread.exitWait();
+        delete producers[p];
+    }
+
+    testOk(popped==nnodes, "%s %u producers: %u entries, %.0f per second", name, nproducers,
+           unsigned(popped), elapsed>0.0 ? popped/elapsed : 0.0);
+}
+
 } // namespace
 
 static unsigned Ninput[]  = {0,0,0,1,0,2,1,0,1,0,0};
@@ -67,9 +132,84 @@ void testOrder()
     }
 }
 
+static
+void testLevels()
+{
+    typedef epics::pvAccess::fair_queue<Qnode> queue_t;
+    queue_t Q;
+    queue_t::value_type urgent(new Qnode(0)), bulk(new Qnode(2));
+    urgent->setQueueLevel(0);
+    bulk->setQueueLevel(2);
+
+    testDiag("Levels");
+
+    // bulk first in, but served after urgent
+    Q.push_back(bulk);
+    for(unsigned i=0; i<2*queue_t::maxStarve; i++)
+        Q.push_back(urgent);
+
+    testOk1(Q.size()==2);
+
+    std::vector<unsigned> outputs;
+    for(unsigned i=0; i<=2*queue_t::maxStarve+1; i++) {
+        queue_t::value_type E;
+        Q.pop_front_try(E);
+        if(!E) break;
+        outputs.push_back(E->i);
+    }
+
+    testOk(outputs.size()==2*queue_t::maxStarve+1, "dequeued %u", (unsigned)outputs.size());
+    testOk(outputs.size()>1 && outputs[0]==0, "urgent first");
+
+    // bulk is served after being passed over maxStarve times
+    size_t pos = 0;
+    while(pos<outputs.size() && outputs[pos]!=2)
+        pos++;
+    testOk(pos==queue_t::maxStarve, "bulk entry at %u", (unsigned)pos);
+    testOk1(Q.empty());
+}
+
+static
+void testMPSC()
+{
+    typedef epics::pvAccess::mpsc_queue<Mnode> queue_t;
+    queue_t Q;
+    queue_t::value_type A(new Mnode(0)), B(new Mnode(1)), C(new Mnode(2));
+
+    testDiag("MPSC");
+
+    // the second A is coalesced
+    Q.push_back(A);
+    Q.push_back(B);
+    Q.push_back(A);
+
+    queue_t::value_type E;
+    testOk1(Q.pop_front_try(E) && E==A);
+
+    // added while B is left, so after it
+    Q.push_back(C);
+    Q.push_back(A);
+
+    std::vector<queue_t::value_type> all;
+    testOk1(Q.pop_all(all)==3u);
+    testOk(all.size()==3u && all[0]==B && all[1]==C && all[2]==A, "pop_all() order");
+    testOk1(Q.empty());
+    testOk1(!Q.pop_front(E, 0.01) && !E);
+}
+
 MAIN(testFairQueue)
 {
-    testPlan(12);
+    testPlan(28);
     testOrder();
+    testLevels();
+    testMPSC();
+
+    typedef epics::pvAccess::fair_queue<Qnode> fair_t;
+    typedef epics::pvAccess::mpsc_queue<Mnode> mpsc_t;
+    const unsigned nproducers[] = {1u, 4u, 16u};
+    for(unsigned i=0; i<NELEMENTS(nproducers); i++) {
+        benchContention<fair_t, Qnode>("fair_queue", nproducers[i], 100000u);
+        benchContention<mpsc_t, Mnode>("mpsc_queue", nproducers[i], 100000u);
+    }
     return testDone();
 }
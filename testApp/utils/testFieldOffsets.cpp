@@ -0,0 +1,278 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include <string.h>
+
+#include <dbDefs.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <pv/pvData.h>
+#include <pv/standardField.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+#include <pv/fieldOffsets.h>
+
+#include "testBufferControl.h"
+
+namespace pvd = epics::pvData;
+using epics::pvAccess::FieldOffsets;
+
+namespace {
+
+// wider than FieldOffsets::minFields, with structures inside
+pvd::StructureConstPtr makeType()
+{
+    pvd::FieldBuilderPtr builder(pvd::getFieldCreate()->createFieldBuilder());
+    builder = builder->addArray("labels", pvd::pvString)
+                     ->addNestedStructure("value");
+    for(unsigned c=0; c<100u; c++) {
+        std::ostringstream strm;
+        strm<<"col"<<c;
+        builder = builder->addArray(strm.str(), c%2u ? pvd::pvDouble : pvd::pvInt);
+    }
+    return builder->endNested()
+                  ->addNestedStructure("alarm")
+                      ->add("severity", pvd::pvInt)
+                      ->add("message", pvd::pvString)
+                  ->endNested()
+                  ->add("count", pvd::pvInt)
+                  ->createStructure();
+}
+
+void fill(pvd::PVStructure& value)
+{
+    pvd::PVStructurePtr cols(value.getSubFieldT<pvd::PVStructure>("value"));
+    const pvd::PVFieldPtrArray& fields(cols->getPVFields());
+    for(size_t i=0; i<fields.size(); i++) {
+        pvd::PVScalarArray& arr(static_cast<pvd::PVScalarArray&>(*fields[i]));
+        pvd::shared_vector<double> V(3, double(i));
+        arr.putFrom(pvd::freeze(V));
+    }
+    value.getSubFieldT<pvd::PVInt>("alarm.severity")->put(2);
+    value.getSubFieldT<pvd::PVString>("alarm.message")->put("high");
+    value.getSubFieldT<pvd::PVInt>("count")->put(5);
+}
+
+void testFind()
+{
+    testDiag("testFind()");
+    pvd::StructureConstPtr type(makeType());
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(type));
+
+    FieldOffsets::const_shared_pointer offsets(FieldOffsets::of(type));
+    testOk1(offsets==FieldOffsets::of(type));
+    testOk1(offsets->size()==value->getNumberFields());
+
+    size_t bad = 0u;
+    for(size_t i=1u; i<offsets->size(); i++) {
+        if(offsets->find(*value, i)!=value->getSubField(i).get())
+            bad++;
+    }
+    testOk(bad==0u, "%u of %u offsets misplaced", unsigned(bad), unsigned(offsets->size()));
+}
+
+// the same bytes as pvData, and received the same
+void testSame(const char *what, const pvd::BitSet& changed,
+              const pvd::StructureConstPtr& type = makeType(),
+              void (*filler)(pvd::PVStructure&) = &fill)
+{
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(type)),
+                        received(pvd::getPVDataCreate()->createPVStructure(type)),
+                        expected(pvd::getPVDataCreate()->createPVStructure(type));
+    (*filler)(*value);
+
+    pvd::BitSet bits(changed);
+    BufferControl A, B;
+    value->serialize(&A.buffer, &A, &bits);
+    epics::pvAccess::serializeChanged(&B.buffer, &B, *value, changed);
+
+    const bool same = A.buffer.getPosition()==B.buffer.getPosition()
+            && memcmp(A.buffer.getBuffer(), B.buffer.getBuffer(), A.buffer.getPosition())==0;
+    testOk(same, "%s: %u and %u bytes", what, unsigned(A.buffer.getPosition()), unsigned(B.buffer.getPosition()));
+
+    A.buffer.flip();
+    B.buffer.flip();
+    expected->deserialize(&A.buffer, &A, &bits);
+    epics::pvAccess::deserializeChanged(&B.buffer, &B, *received, changed);
+    testOk(*expected==*received && B.buffer.getRemaining()==0u, "%s: received", what);
+}
+
+void testSerialize()
+{
+    testDiag("testSerialize()");
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(makeType()));
+    const size_t col7 = value->getSubFieldT<pvd::PVField>("value.col7")->getFieldOffset(),
+                 col93 = value->getSubFieldT<pvd::PVField>("value.col93")->getFieldOffset(),
+                 alarm = value->getSubFieldT<pvd::PVField>("alarm")->getFieldOffset(),
+                 severity = value->getSubFieldT<pvd::PVField>("alarm.severity")->getFieldOffset(),
+                 count = value->getSubFieldT<pvd::PVField>("count")->getFieldOffset();
+
+    pvd::BitSet changed;
+    testSame("none", changed);
+
+    changed.set(col7);
+    changed.set(col93);
+    testSame("two columns", changed);
+
+    // the bit of a field within a changed structure is redundant
+    changed.set(alarm);
+    changed.set(severity);
+    changed.set(count);
+    testSame("structure", changed);
+
+    changed.clear();
+    changed.set(0);
+    changed.set(col7);
+    testSame("everything", changed);
+}
+
+pvd::StructureConstPtr makeNTScalar(pvd::ScalarType type, bool array = false)
+{
+    pvd::FieldBuilderPtr builder(pvd::getFieldCreate()->createFieldBuilder()
+                                 ->setId(array ? "epics:nt/NTScalarArray:1.0" : "epics:nt/NTScalar:1.0"));
+    if(array)
+        builder = builder->addArray("value", type);
+    else
+        builder = builder->add("value", type);
+    return builder->add("alarm", pvd::getStandardField()->alarm())
+                  ->add("timeStamp", pvd::getStandardField()->timeStamp())
+                  ->createStructure();
+}
+
+void fillNT(pvd::PVStructure& value)
+{
+    pvd::PVFieldPtr field(value.getSubFieldT<pvd::PVField>("value"));
+    if(field->getField()->getType()==pvd::scalar) {
+        static_cast<pvd::PVScalar&>(*field).putFrom<double>(42.5);
+    } else {
+        pvd::shared_vector<double> V(4, 1.5);
+        static_cast<pvd::PVScalarArray&>(*field).putFrom(pvd::freeze(V));
+    }
+    value.getSubFieldT<pvd::PVInt>("alarm.severity")->put(1);
+    value.getSubFieldT<pvd::PVInt>("alarm.status")->put(2);
+    value.getSubFieldT<pvd::PVString>("alarm.message")->put("low");
+    value.getSubFieldT<pvd::PVLong>("timeStamp.secondsPastEpoch")->put(1234567890);
+    value.getSubFieldT<pvd::PVInt>("timeStamp.nanoseconds")->put(5000);
+    value.getSubFieldT<pvd::PVInt>("timeStamp.userTag")->put(-3);
+}
+
+void testLayout()
+{
+    testDiag("testLayout()");
+
+    FieldOffsets::const_shared_pointer offsets(FieldOffsets::of(makeNTScalar(pvd::pvDouble)));
+    testOk(offsets->layout() && strcmp(offsets->layout()->name, "double")==0, "NTScalar double");
+    offsets = FieldOffsets::of(makeNTScalar(pvd::pvString));
+    testOk(offsets->layout() && strcmp(offsets->layout()->name, "string")==0, "NTScalar string");
+    offsets = FieldOffsets::of(makeNTScalar(pvd::pvInt, true));
+    testOk(offsets->layout() && strcmp(offsets->layout()->name, "int[]")==0, "NTScalarArray int");
+    offsets = FieldOffsets::of(makeNTScalar(pvd::pvString, true));
+    testOk(offsets->layout() && strcmp(offsets->layout()->name, "any")==0, "NTScalarArray string");
+
+    // optional fields are left to pvData
+    pvd::StructureConstPtr described(pvd::getFieldCreate()->createFieldBuilder()
+                                     ->setId("epics:nt/NTScalar:1.0")
+                                     ->add("value", pvd::pvDouble)
+                                     ->add("descriptor", pvd::pvString)
+                                     ->add("alarm", pvd::getStandardField()->alarm())
+                                     ->add("timeStamp", pvd::getStandardField()->timeStamp())
+                                     ->createStructure());
+    testOk1(!FieldOffsets::of(described)->layout());
+    testOk1(!FieldOffsets::of(makeType())->layout());
+}
+
+void testNTScalar()
+{
+    testDiag("testNTScalar()");
+
+    pvd::ScalarType types[] = {pvd::pvDouble, pvd::pvInt, pvd::pvString};
+    for(size_t t=0; t<NELEMENTS(types); t++) {
+        testDiag("value of %s", pvd::ScalarTypeFunc::name(types[t]));
+        pvd::StructureConstPtr type(makeNTScalar(types[t]));
+
+        pvd::BitSet changed;
+        changed.set(0);
+        testSame("everything", changed, type, &fillNT);
+
+        changed.clear();
+        changed.set(1); // value
+        changed.set(6); // timeStamp
+        testSame("value and timeStamp", changed, type, &fillNT);
+
+        changed.clear();
+        changed.set(3); // alarm.severity
+        changed.set(5); // alarm.message
+        changed.set(8); // timeStamp.nanoseconds
+        testSame("within structures", changed, type, &fillNT);
+
+        // the bit of a field within a changed structure is redundant
+        changed.set(2);
+        testSame("redundant", changed, type, &fillNT);
+    }
+
+    pvd::BitSet changed;
+    changed.set(1);
+    changed.set(2);
+    testSame("array", changed, makeNTScalar(pvd::pvDouble, true), &fillNT);
+}
+
+void fillArray(pvd::PVStructure& value)
+{
+    pvd::shared_vector<double> V(1000);
+    for(size_t i=0; i<V.size(); i++)
+        V[i] = double(i)*1.25 - 300.0;
+    value.getSubFieldT<pvd::PVScalarArray>("value")->putFrom(pvd::freeze(V));
+}
+
+// from a peer of the other byte order, received as pvData would
+void testSwapped()
+{
+    testDiag("testSwapped()");
+
+    const int otherOrder = EPICS_BYTE_ORDER==EPICS_ENDIAN_BIG ? EPICS_ENDIAN_LITTLE : EPICS_ENDIAN_BIG;
+
+    pvd::ScalarType types[] = {pvd::pvShort, pvd::pvUInt, pvd::pvLong, pvd::pvFloat, pvd::pvDouble};
+    for(size_t t=0; t<NELEMENTS(types); t++) {
+        pvd::StructureConstPtr type(makeNTScalar(types[t], true));
+        pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(type)),
+                            received(pvd::getPVDataCreate()->createPVStructure(type)),
+                            expected(pvd::getPVDataCreate()->createPVStructure(type));
+        fillArray(*value);
+        fillArray(*received); // re-used
+
+        pvd::BitSet changed;
+        changed.set(1);
+        pvd::BitSet bits(changed);
+        BufferControl A(64*1024, otherOrder);
+        value->serialize(&A.buffer, &A, &bits);
+
+        A.buffer.flip();
+        expected->deserialize(&A.buffer, &A, &bits);
+        A.buffer.setPosition(0);
+        epics::pvAccess::deserializeChanged(&A.buffer, &A, *received, changed);
+        testOk(*expected==*received && *value==*received && A.buffer.getRemaining()==0u,
+               "%s[] received", pvd::ScalarTypeFunc::name(types[t]));
+    }
+}
+
+} // namespace
+
+MAIN(testFieldOffsets)
+{
+    testPlan(48);
+    testFind();
+    testSerialize();
+    testLayout();
+    testNTScalar();
+    testSwapped();
+    return testDone();
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <map>
+#include <stdlib.h>
+
+#include <pv/idTable.h>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+namespace {
+
+typedef epics::pvAccess::IDTable<int> table_t;
+
+void testBasic()
+{
+    testDiag("testBasic");
+
+    table_t T;
+    testOk1(T.empty());
+    testOk1(T.find(1)==T.end());
+    testOk1(T.erase(1)==0u);
+    testOk1(T.begin()==T.end());
+
+    T[1] = 10;
+    T[2] = 20;
+    T[9] = 90;
+    testOk1(T.size()==3u);
+    testOk1(T.find(9)!=T.end() && T.find(9)->second==90);
+
+    testOk1(T.erase(1)==1u);
+    // any probed past 1 are shifted back
+    testOk1(T.find(9)!=T.end() && T.find(9)->second==90);
+    testOk1(T.find(2)!=T.end() && T.find(2)->second==20);
+    testOk1(T.find(1)==T.end());
+
+    table_t other;
+    other.swap(T);
+    testOk1(T.empty() && other.size()==2u);
+    other.clear();
+    testOk1(other.empty() && other.begin()==other.end());
+}
+
+// compare with std::map through a random sequence
+void testRandom()
+{
+    testDiag("testRandom");
+
+    table_t T;
+    std::map<int, int> M;
+    bool same = true;
+
+    srand(42);
+    for(int n=0; same && n<100000; n++) {
+        const int id = rand()%1000 - 100;
+        switch(rand()%3) {
+        case 0:
+            T[id] = n;
+            M[id] = n;
+            break;
+        case 1:
+            same = T.erase(id)==M.erase(id);
+            break;
+        default: {
+            table_t::const_iterator it(T.find(id));
+            std::map<int, int>::const_iterator mit(M.find(id));
+            same = (it==T.end())==(mit==M.end()) && (mit==M.end() || it->second==mit->second);
+        }
+        }
+        same &= T.size()==M.size();
+    }
+    testOk(same, "same as std::map");
+
+    size_t n = 0;
+    for(table_t::const_iterator it(T.begin()), end(T.end()); same && it!=end; ++it, n++)
+        same = M[it->first]==it->second;
+    testOk(same && n==M.size(), "iterates %u of %u", unsigned(n), unsigned(M.size()));
+    testOk(T.capacity()*3u >= T.size()*4u, "capacity %u for %u", unsigned(T.capacity()), unsigned(T.size()));
+}
+
+// IDs which differ only in their high bits
+void testCollide()
+{
+    testDiag("testCollide");
+
+    table_t T;
+    const int n = 1000;
+    for(int i=0; i<n; i++)
+        T[i<<20] = i;
+
+    testOk(T.displacement() <= T.size()*2u, "displacement %u of %u",
+           unsigned(T.displacement()), unsigned(T.size()));
+
+    for(int i=0; i<n; i+=2)
+        T.erase(i<<20);
+
+    bool same = T.size()==size_t(n/2);
+    for(int i=0; i<n && same; i++) {
+        table_t::const_iterator it(T.find(i<<20));
+        same = (i%2) ? (it!=T.end() && it->second==i) : it==T.end();
+    }
+    testOk(same, "after erasing half");
+}
+
+} // namespace
+
+MAIN(testIDTable)
+{
+    testPlan(17);
+    testBasic();
+    testRandom();
+    testCollide();
+    return testDone();
+}
@@ -200,6 +200,41 @@ void test_getLoopbackNIF()
     testOk1(htonl(0x0A000001) == addr.ia.sin_addr.s_addr);
 }
 
+void test_discoverInterfacesCached()
+{
+    testDiag("Test discoverInterfacesCached()");
+
+    osiSockAttach();
+
+    SOCKET socket = epicsSocketCreate(AF_INET, SOCK_DGRAM, 0);
+    testOk1(socket != INVALID_SOCKET);
+    if (socket == INVALID_SOCKET)
+        testAbort("Can't allocate socket");
+
+    osiSockAddr loAddr;
+    memset(&loAddr, 0, sizeof(loAddr));
+    loAddr.ia.sin_family = AF_INET;
+    loAddr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    IfaceNodeVector direct, first, second;
+    testOk1(discoverInterfaces(direct, socket, &loAddr)==0);
+    testOk1(discoverInterfacesCached(first, socket, &loAddr)==0);
+    // served from the cache, appended
+    testOk1(discoverInterfacesCached(second, socket, &loAddr)==0);
+    testOk1(discoverInterfacesCached(second, socket, &loAddr)==0);
+
+    testOk1(direct.size()==first.size());
+    testOk1(second.size()==2*first.size());
+    testOk1(first.size()==1 && first[0].loopback);
+
+    invalidateInterfaceCache();
+    IfaceNodeVector third;
+    testOk1(discoverInterfacesCached(third, socket, &loAddr)==0);
+    testOk1(third.size()==first.size());
+
+    epicsSocketDestroy(socket);
+}
+
 #ifdef _WIN32
 // needed for ip_mreq
 #include <ws2tcpip.h>
@@ -348,7 +383,7 @@ void test_multicastLoopback()
 
 MAIN(testInetAddressUtils)
 {
-    testPlan(79);
+    testPlan(89);
     testDiag("Tests for InetAddress utils");
 
     test_getSocketAddressList();
@@ -357,6 +392,7 @@ MAIN(testInetAddressUtils)
     test_encodeAsIPv6Address();
     test_isMulticastAddress();
     test_getLoopbackNIF();
+    test_discoverInterfacesCached();
 
     test_multicastLoopback();
 
@@ -0,0 +1,96 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <vector>
+
+#include <epicsThread.h>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <pv/internedName.h>
+
+using epics::pvAccess::InternedName;
+
+namespace {
+
+void testIntern()
+{
+    testDiag("testIntern");
+
+    const size_t before = InternedName::num_names;
+    {
+        InternedName A(std::string("tst:one")), B(std::string("tst:one")), C(std::string("tst:two"));
+        testOk1(A==B && &A.str()==&B.str());
+        testOk1(A.hash()==B.hash());
+        testOk1(A!=C && C.str()=="tst:two");
+        testOk1(InternedName::num_names==before+2u);
+
+        InternedName D(A);
+        testOk1(D==A && D.str()=="tst:one");
+
+        // last of "tst:two"
+        C = D;
+        testOk1(C==A && InternedName::num_names==before+1u);
+
+        InternedName E;
+        testOk1(E.str().empty());
+    }
+    testOk1(InternedName::num_names==before);
+}
+
+// repeatedly intern, copy and release names shared with other workers
+struct Worker : public epicsThreadRunable
+{
+    const InternedName& held;
+    epicsThread thread;
+
+    explicit Worker(const InternedName& held)
+        :held(held)
+        ,thread(*this, "worker", epicsThreadGetStackSize(epicsThreadStackSmall))
+    {}
+    virtual ~Worker() {}
+    virtual void run()
+    {
+        for(unsigned i=0; i<10000u; i++) {
+            InternedName copy(held), other(std::string("tst:shared"));
+            InternedName again(other);
+            copy = again;
+        }
+    }
+};
+
+void testConcurrent()
+{
+    testDiag("testConcurrent");
+
+    const size_t before = InternedName::num_names;
+    {
+        InternedName held(std::string("tst:held"));
+
+        std::vector<Worker*> workers;
+        for(unsigned i=0; i<4u; i++)
+            workers.push_back(new Worker(held));
+        for(size_t i=0; i<workers.size(); i++)
+            workers[i]->thread.start();
+        for(size_t i=0; i<workers.size(); i++) {
+            workers[i]->thread.exitWait();
+            delete workers[i];
+        }
+        testOk1(held.str()=="tst:held");
+    }
+    testOk(InternedName::num_names==before, "%u names", unsigned(InternedName::num_names));
+}
+
+} // namespace
+
+MAIN(testInternedName)
+{
+    testPlan(10);
+    testIntern();
+    testConcurrent();
+    return testDone();
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <utility>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <pv/pvData.h>
+#include <pv/byteBuffer.h>
+#include <pv/serialize.h>
+
+#include <pv/introspectionRegistry.h>
+
+#include "testBufferControl.h"
+
+namespace pvd = epics::pvData;
+using epics::pvAccess::IntrospectionRegistry;
+
+namespace {
+
+pvd::StructureConstPtr makeType(const char *id, const char *name)
+{
+    return pvd::getFieldCreate()->createFieldBuilder()
+            ->setId(id)
+            ->add("value", pvd::pvDouble)
+            ->addNestedStructure("alarm")
+                ->add(name, pvd::pvInt)
+            ->endNested()
+            ->createStructure();
+}
+
+// as received by a new connection
+pvd::FieldConstPtr receive(const pvd::FieldConstPtr& type)
+{
+    IntrospectionRegistry outgoing, incoming;
+    BufferControl ctl;
+    outgoing.serialize(type, &ctl.buffer, &ctl);
+    ctl.buffer.flip();
+    return incoming.deserialize(&ctl.buffer, &ctl);
+}
+
+void testHash()
+{
+    testDiag("testHash()");
+    pvd::StructureConstPtr A(makeType("a", "severity")), B(makeType("a", "severity")),
+                           C(makeType("a", "status"));
+    testOk1(IntrospectionRegistry::hashField(*A)==IntrospectionRegistry::hashField(*B));
+    testOk1(IntrospectionRegistry::hashField(*A)!=IntrospectionRegistry::hashField(*C));
+}
+
+void testOutgoing()
+{
+    testDiag("testOutgoing()");
+    IntrospectionRegistry registry;
+    BufferControl ctl;
+
+    registry.serialize(makeType("a", "severity"), &ctl.buffer, &ctl);
+    registry.serialize(makeType("a", "status"), &ctl.buffer, &ctl);
+    size_t full = ctl.buffer.getPosition();
+
+    // an equal type, but another instance
+    registry.serialize(makeType("a", "severity"), &ctl.buffer, &ctl);
+    testOk(ctl.buffer.getPosition()-full==3u, "sent again as id, %u bytes", unsigned(ctl.buffer.getPosition()-full));
+}
+
+void testIntern()
+{
+    testDiag("testIntern()");
+    pvd::FieldConstPtr first(receive(makeType("a", "severity"))),
+                       second(receive(makeType("a", "severity"))),
+                       otherId(receive(makeType("b", "severity")));
+
+    testOk1(!!first && *first==*makeType("a", "severity"));
+    testOk(first.get()==second.get(), "connections share one received type");
+    testOk(first.get()!=otherId.get(), "types which differ in id are kept apart");
+
+    pvd::FieldConstPtr plain(receive(pvd::getFieldCreate()->createFieldBuilder()
+                                         ->add("value", pvd::pvString)->createStructure())),
+                       bounded(receive(pvd::getFieldCreate()->createFieldBuilder()
+                                           ->addBoundedString("value", 8)->createStructure()));
+    testOk(plain.get()!=bounded.get(), "bounded and unbounded strings are kept apart");
+}
+
+// type code and id of a serialized interface
+std::pair<int, int> sent(IntrospectionRegistry& registry, const pvd::FieldConstPtr& type)
+{
+    BufferControl ctl;
+    registry.serialize(type, &ctl.buffer, &ctl);
+    ctl.buffer.flip();
+    int code = ctl.buffer.getByte();
+    int id = ctl.buffer.getShort();
+    return std::make_pair(code, id);
+}
+
+void testLRU()
+{
+    testDiag("testLRU()");
+    IntrospectionRegistry registry;
+    registry.setMaxSize(2u);
+    pvd::StructureConstPtr A(makeType("a", "severity")), B(makeType("b", "severity")), C(makeType("c", "severity"));
+
+    sent(registry, A);
+    std::pair<int, int> b(sent(registry, B));
+    std::pair<int, int> a(sent(registry, A));
+    testOk(a.first==IntrospectionRegistry::ONLY_ID_TYPE_CODE && a.second==1, "A sent as id %d", a.second);
+
+    // B is the least recently sent
+    std::pair<int, int> c(sent(registry, C));
+    testOk(c.first==IntrospectionRegistry::FULL_WITH_ID_TYPE_CODE && c.second==b.second,
+           "C takes the id %d of B", c.second);
+
+    a = sent(registry, A);
+    testOk(a.first==IntrospectionRegistry::ONLY_ID_TYPE_CODE && a.second==1, "A still sent as id %d", a.second);
+    b = sent(registry, B);
+    testOk(b.first==IntrospectionRegistry::FULL_WITH_ID_TYPE_CODE && b.second==c.second,
+           "B sent in full again with id %d", b.second);
+
+    registry.setMaxSize(0u);
+    BufferControl ctl;
+    registry.serialize(A, &ctl.buffer, &ctl);
+    ctl.buffer.flip();
+    pvd::int8 code = ctl.buffer.getByte();
+    testOk(code!=IntrospectionRegistry::ONLY_ID_TYPE_CODE && code!=IntrospectionRegistry::FULL_WITH_ID_TYPE_CODE,
+           "no ids with size 0");
+}
+
+} // namespace
+
+MAIN(testIntrospectionRegistry)
+{
+    testPlan(12);
+    testHash();
+    testOutgoing();
+    testIntern();
+    testLRU();
+    return testDone();
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <pv/latencyHistogram.h>
+
+using epics::pvAccess::LatencyHistogram;
+
+namespace {
+
+// within the bucket resolution of 1/8 above the exact value
+bool near(double actual, double expect)
+{
+    return actual >= expect && actual <= expect*1.125 + 1e-6;
+}
+
+void testEmpty()
+{
+    testDiag("testEmpty()");
+    LatencyHistogram H;
+    testOk1(H.count()==0u);
+    testOk1(H.percentile(0.5)==0.0);
+    testOk1(H.mean()==0.0);
+}
+
+void testUniform()
+{
+    testDiag("testUniform()");
+    LatencyHistogram H;
+    // 1 ms to 1 s
+    for(unsigned i=1; i<=1000; i++)
+        H.record(i*1e-3);
+
+    testOk1(H.count()==1000u);
+    testOk(near(H.percentile(0.5), 0.5), "p50 %g", H.percentile(0.5));
+    testOk(near(H.percentile(0.9), 0.9), "p90 %g", H.percentile(0.9));
+    testOk(near(H.percentile(0.99), 0.99), "p99 %g", H.percentile(0.99));
+    testOk(H.percentile(1.0)==H.max(), "p100 %g is max %g", H.percentile(1.0), H.max());
+    testOk(H.mean()>0.49 && H.mean()<0.51, "mean %g", H.mean());
+
+    LatencyHistogram other;
+    other.record(10.0);
+    H.merge(other);
+    testOk1(H.count()==1001u);
+    testOk(H.max()>9.99 && H.max()<10.01, "max %g", H.max());
+
+    H.reset();
+    testOk1(H.count()==0u && H.max()==0.0);
+}
+
+void testRange()
+{
+    testDiag("testRange()");
+    LatencyHistogram H;
+    H.record(-1.0);
+    H.record(0.0);
+    // longer than the largest bucket
+    H.record(1e9);
+    testOk1(H.count()==3u);
+    testOk1(H.percentile(0.5)==0.0);
+    testOk(H.percentile(1.0)>1e6, "p100 %g", H.percentile(1.0));
+}
+
+} // namespace
+
+MAIN(testLatencyHistogram)
+{
+    testPlan(15);
+    testEmpty();
+    testUniform();
+    testRange();
+    return testDone();
+}
@@ -0,0 +1,149 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <epicsThread.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <pv/pvAccessMB.h>
+
+using epics::pvAccess::MB::Trace;
+
+namespace {
+
+struct Worker : public epicsThreadRunable
+{
+    Trace& trace;
+    epicsThread thread;
+    Worker(Trace& trace)
+        :trace(trace)
+        ,thread(*this, "worker", epicsThreadGetStackSize(epicsThreadStackSmall))
+    {}
+    virtual ~Worker() {}
+    virtual void run()
+    {
+        for(unsigned i=0; i<10u; i++) {
+            trace.incAutoId();
+            trace.point(0u, "begin");
+            trace.point(1u, "end");
+        }
+    }
+};
+
+void testPoints()
+{
+    testDiag("testPoints()");
+    Trace T("test", 8u);
+
+    for(unsigned i=0; i<4u; i++) {
+        T.incAutoId();
+        T.point(0u, "begin");
+        T.point(1u, "end");
+    }
+    T.point(5u, "explicit", 1234u);
+
+    std::vector<Trace::Point> points;
+    T.snapshot(points);
+    // rounded up to 16 points, none overwritten
+    testOk(points.size()==9u, "%u points", unsigned(points.size()));
+    bool ordered = true;
+    for(size_t i=1; i<points.size(); i++)
+        ordered &= points[i-1].ticks <= points[i].ticks;
+    testOk1(ordered);
+    testOk1(points.size()==9u && points[0].id==points[1].id && points[1].id!=points[2].id);
+    testOk1(points.size()==9u && points[8].id==1234u && points[8].stage==5u);
+
+    T.snapshot(points, 1);
+    testOk(points.size()==4u, "stage 1 only %u", unsigned(points.size()));
+    T.snapshot(points, 0, 3u);
+    testOk(points.size()==1u, "skip 3 of stage 0 %u", unsigned(points.size()));
+
+    // wraps, keeping the last 16
+    for(unsigned i=0; i<20u; i++)
+        T.point(2u, "more", i);
+    T.snapshot(points, -1);
+    testOk(points.size()==16u, "after wrap %u", unsigned(points.size()));
+    testOk1(points.size()==16u && points.back().id==19u);
+}
+
+void testThreads()
+{
+    testDiag("testThreads()");
+    Trace T("threads", 64u);
+    {
+        Worker A(T), B(T);
+        A.thread.start();
+        B.thread.start();
+        A.thread.exitWait();
+        B.thread.exitWait();
+    }
+
+    std::vector<Trace::Point> points;
+    T.snapshot(points);
+    testOk(points.size()==40u, "%u points", unsigned(points.size()));
+
+    std::vector<unsigned> threads(2u, 0u);
+    bool unique = true;
+    std::vector<epicsUInt64> ids;
+    for(size_t i=0; i<points.size(); i++) {
+        if(points[i].thread<2u)
+            threads[points[i].thread]++;
+        if(points[i].stage==0u)
+            ids.push_back(points[i].id);
+    }
+    for(size_t i=0; i<ids.size(); i++)
+        for(size_t j=i+1; j<ids.size(); j++)
+            unique &= ids[i]!=ids[j];
+    testOk(threads[0]==20u && threads[1]==20u, "per thread %u %u", threads[0], threads[1]);
+    testOk1(unique && ids.size()==20u);
+}
+
+void testExport()
+{
+    testDiag("testExport()");
+    Trace T("export", 16u);
+    for(unsigned i=0; i<3u; i++) {
+        T.incAutoId();
+        T.point(0u, "begin");
+        T.point(1u, "end \"quoted\"");
+    }
+    T.normalize();
+
+    std::ostringstream csv;
+    T.csvExport(csv);
+    testOk(csv.str().compare(0u, 19u, "thread,id,stage,ns\n")==0, "%s", csv.str().c_str());
+
+    Trace I("import", 16u);
+    std::istringstream in(csv.str());
+    I.csvImport(in);
+    std::vector<Trace::Point> points;
+    I.snapshot(points);
+    testOk(points.size()==6u, "imported %u", unsigned(points.size()));
+
+    std::ostringstream stats;
+    T.stats(stats);
+    testOk(stats.str().find("  0 ->   1  count        3")!=std::string::npos, "%s", stats.str().c_str());
+
+    std::ostringstream json;
+    T.jsonExport(json);
+    testOk(json.str().find("\"1\":\"end \\\"quoted\\\"\"")!=std::string::npos, "%s", json.str().c_str());
+}
+
+} // namespace
+
+MAIN(testMB)
+{
+    testPlan(15);
+    testDiag("ticks per second %g", epics::pvAccess::MB::ticksPerSecond());
+    testPoints();
+    testThreads();
+    testExport();
+    return testDone();
+}
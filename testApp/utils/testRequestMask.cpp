@@ -0,0 +1,126 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <pv/pvUnitTest.h>
+#include <testMain.h>
+
+#include <pv/pvData.h>
+#include <pv/createRequest.h>
+#include <pv/requestMask.h>
+
+namespace pvd = epics::pvData;
+namespace pva = epics::pvAccess;
+
+namespace {
+
+const pvd::StructureConstPtr type(pvd::getFieldCreate()->createFieldBuilder()
+                                  ->addArray("value", pvd::pvDouble)      // 1
+                                  ->addNestedStructure("timeStamp")       // 2
+                                      ->add("secondsPastEpoch", pvd::pvLong)
+                                      ->add("nanoseconds", pvd::pvInt)
+                                      ->add("userTag", pvd::pvInt)
+                                  ->endNested()
+                                  ->addNestedStructure("attribute")       // 6
+                                      ->add("a", pvd::pvInt)              // 7
+                                      ->add("b", pvd::pvInt)
+                                  ->endNested()
+                                  ->createStructure());
+
+pvd::BitSet select(const pva::RequestMask& mask, pvd::uint32 bit)
+{
+    pvd::BitSet changed, out;
+    changed.set(bit);
+    mask.select(out, changed);
+    return out;
+}
+
+void testPartial()
+{
+    testDiag("testPartial");
+
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(type));
+
+    pva::RequestMask mask;
+    mask.reset(pvd::extractRequestMask(value, pvd::createRequest("field(timeStamp,attribute.a)")
+                                                  ->getSubField<pvd::PVStructure>("field")),
+               *value);
+    testOk1(!mask.empty());
+
+    testEqual(select(mask, 0), pvd::BitSet().set(2).set(7));
+    testEqual(select(mask, 1), pvd::BitSet());
+    testEqual(select(mask, 2), pvd::BitSet().set(2));
+    testEqual(select(mask, 3), pvd::BitSet().set(3));
+    testEqual(select(mask, 6), pvd::BitSet().set(7));
+    testEqual(select(mask, 8), pvd::BitSet());
+
+    // a complete update copies only the selected fields
+    pvd::PVDoubleArray::svector arr(1000u, 1.0);
+    value->getSubFieldT<pvd::PVDoubleArray>("value")->replace(pvd::freeze(arr));
+    value->getSubFieldT<pvd::PVInt>("attribute.a")->put(5);
+
+    pvd::BitSet changed, out;
+    changed.set(0);
+    mask.select(out, changed);
+
+    pvd::PVStructurePtr copy(pvd::getPVDataCreate()->createPVStructure(type));
+    copy->copyUnchecked(*value, out);
+    testEqual(copy->getSubFieldT<pvd::PVDoubleArray>("value")->getLength(), 0u);
+    testEqual(copy->getSubFieldT<pvd::PVInt>("attribute.a")->get(), 5);
+}
+
+void testAll()
+{
+    testDiag("testAll");
+
+    pvd::PVStructurePtr value(pvd::getPVDataCreate()->createPVStructure(type));
+
+    pva::RequestMask mask;
+    mask.reset(pvd::extractRequestMask(value, pvd::createRequest("field()")
+                                                  ->getSubField<pvd::PVStructure>("field")),
+               *value);
+
+    testEqual(select(mask, 0), pvd::BitSet().set(0));
+    testEqual(select(mask, 6), pvd::BitSet().set(6));
+
+    mask.clear();
+    testOk1(mask.empty());
+    testEqual(select(mask, 0), pvd::BitSet());
+}
+
+void testCached()
+{
+    testDiag("testCached");
+
+    pvd::PVStructurePtr A(pvd::getPVDataCreate()->createPVStructure(type)),
+                        B(pvd::getPVDataCreate()->createPVStructure(type));
+    const size_t before = pva::RequestMask::num_cached();
+
+    // of the same form, as options don't select
+    pva::RequestMask first, second, other, uncached;
+    first.reset(A, pvd::createRequest("field(timeStamp,attribute.a[x=1])")->getSubField<pvd::PVStructure>("field"));
+    second.reset(B, pvd::createRequest("field(timeStamp,attribute.a[x=2])")->getSubField<pvd::PVStructure>("field"));
+    testOk1(&first.mask()==&second.mask());
+    testEqual(pva::RequestMask::num_cached(), before+1u);
+
+    other.reset(A, pvd::createRequest("field(value)")->getSubField<pvd::PVStructure>("field"));
+    testOk1(&other.mask()!=&first.mask() && other.mask()==pvd::BitSet().set(1));
+
+    uncached.reset(pvd::extractRequestMask(A, pvd::createRequest("field(timeStamp,attribute.a)")
+                                                  ->getSubField<pvd::PVStructure>("field")),
+                   *A);
+    testEqual(select(second, 0), select(uncached, 0));
+}
+
+} // namespace
+
+MAIN(testRequestMask)
+{
+    testPlan(17);
+    testPartial();
+    testAll();
+    testCached();
+    return testDone();
+}
@@ -0,0 +1,110 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <pv/fairQueue.h>
+#include <pv/senderPool.h>
+
+using epics::pvAccess::SenderPool;
+
+namespace {
+
+struct Reply : public epics::pvAccess::fair_queue<Reply>::entry {
+    int id;
+    Reply() :id(0) {}
+};
+
+typedef SenderPool<Reply> pool_t;
+
+void testReuse()
+{
+    testDiag("testReuse()");
+    pool_t pool;
+
+    pool_t::value_type A(pool.get()), B(pool.get());
+    testOk1(A && B && A!=B);
+    testOk1(pool.num_allocated()==2u);
+
+    Reply *first = A.get();
+    A.reset();
+    pool_t::value_type C(pool.get());
+    testOk1(C.get()==first);
+    testOk1(pool.num_allocated()==2u);
+
+    // still held elsewhere, so not reused
+    pool_t::value_type D(pool.get());
+    testOk1(D!=B && D!=C);
+    testOk1(pool.num_allocated()==3u);
+}
+
+void testQueued()
+{
+    testDiag("testQueued()");
+    pool_t pool;
+    epics::pvAccess::fair_queue<Reply> queue;
+
+    // the queue holds a reference until popped
+    {
+        pool_t::value_type A(pool.get());
+        A->id = 1;
+        queue.push_back(A);
+    }
+    pool_t::value_type B(pool.get());
+    testOk1(B->id==0);
+    testOk1(pool.num_allocated()==2u);
+    B.reset();
+
+    pool_t::value_type out;
+    testOk1(queue.pop_front_try(out) && out->id==1);
+    out.reset();
+
+    for(unsigned i=0; i<100u; i++) {
+        {
+            pool_t::value_type A(pool.get());
+            queue.push_back(A);
+        }
+        queue.pop_front_try(out);
+        out.reset();
+    }
+    testOk(pool.num_allocated()==2u, "%u allocated", unsigned(pool.num_allocated()));
+}
+
+void testMaxSize()
+{
+    testDiag("testMaxSize()");
+    pool_t pool(1u);
+
+    pool_t::value_type A(pool.get()), B(pool.get());
+    Reply *kept = A.get();
+    A.reset();
+    B.reset();
+
+    // only the first was kept
+    pool_t::value_type C(pool.get()), D(pool.get());
+    testOk1(C.get()==kept);
+    testOk1(pool.num_allocated()==3u);
+}
+
+} // namespace
+
+MAIN(testSenderPool)
+{
+    testPlan(12);
+#ifdef PVA_SENDERPOOL_USE_ATOMIC
+    try {
+        testReuse();
+        testQueued();
+        testMaxSize();
+    }catch(std::exception& e){
+        testAbort("Unexpected exception: %s", e.what());
+    }
+#else
+    testSkip(12, "senders are not reused without epicsAtomic");
+#endif
+    return testDone();
+}
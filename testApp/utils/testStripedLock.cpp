@@ -0,0 +1,127 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <vector>
+
+#include <epicsThread.h>
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsVersion.h>
+
+#ifdef EPICS_VERSION_INT
+#if EPICS_VERSION_INT>=VERSION_INT(3,15,1,0)
+#include <epicsAtomic.h>
+#define TEST_USE_ATOMIC
+#endif
+#endif
+
+#include <pv/stripedLock.h>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+namespace {
+
+struct IntHash {
+    size_t operator()(unsigned k) const { return k; }
+};
+
+// few shards, so that keys share them
+typedef epics::pvAccess::StripedLock<unsigned, IntHash, std::equal_to<unsigned>, 4u> table_t;
+
+static const unsigned nkeys = 8u;
+
+#ifndef TEST_USE_ATOMIC
+epicsMutex countLock;
+#endif
+
+// repeatedly hold a key, and count any other thread seen holding it at the same time
+struct Worker : public epicsThreadRunable
+{
+    table_t& table;
+    int *holders;
+    int& collisions;
+    unsigned first;
+    epicsThread thread;
+
+    Worker(table_t& table, int *holders, int& collisions, unsigned first)
+        :table(table), holders(holders), collisions(collisions), first(first)
+        ,thread(*this, "worker", epicsThreadGetStackSize(epicsThreadStackSmall))
+    {}
+    virtual ~Worker() {}
+    virtual void run()
+    {
+        for(unsigned i=0; i<10000u; i++) {
+            const unsigned key = (first+i)%nkeys;
+            table_t::Guard G(table, key);
+#ifdef TEST_USE_ATOMIC
+            if(epics::atomic::increment(holders[key])!=1)
+                epics::atomic::increment(collisions);
+            epics::atomic::decrement(holders[key]);
+#else
+            {
+                epicsGuard<epicsMutex> C(countLock);
+                if(++holders[key]!=1)
+                    collisions++;
+            }
+            epicsGuard<epicsMutex> C(countLock);
+            holders[key]--;
+#endif
+        }
+    }
+};
+
+} // namespace
+
+static
+void testBasic()
+{
+    testDiag("testBasic()");
+    table_t table;
+
+    testOk1(table.tryLock(1u));
+    testOk1(!table.tryLock(1u));
+    // same shard, different key
+    testOk1(table.tryLock(5u));
+    testOk1(table.size()==2u);
+
+    table.unlock(1u);
+    testOk1(table.tryLock(1u));
+
+    table.unlock(1u);
+    table.unlock(5u);
+    testOk1(table.size()==0u);
+}
+
+static
+void testContention()
+{
+    testDiag("testContention()");
+    table_t table;
+    int holders[nkeys] = {};
+    int collisions = 0;
+
+    std::vector<Worker*> workers;
+    for(unsigned i=0; i<8u; i++)
+        workers.push_back(new Worker(table, holders, collisions, i));
+    for(size_t i=0; i<workers.size(); i++)
+        workers[i]->thread.start();
+    for(size_t i=0; i<workers.size(); i++) {
+        workers[i]->thread.exitWait();
+        delete workers[i];
+    }
+
+    testOk(collisions==0, "%d collisions", collisions);
+    testOk1(table.size()==0u);
+}
+
+MAIN(testStripedLock)
+{
+    testPlan(8);
+    testBasic();
+    testContention();
+    return testDone();
+}
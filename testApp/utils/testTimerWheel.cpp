@@ -0,0 +1,199 @@
+/**
+ * Copyright - See the COPYRIGHT that is included with this distribution.
+ * pvAccessCPP is distributed subject to a Software License Agreement found
+ * in file LICENSE that is included with this distribution.
+ */
+
+#include <vector>
+#include <stdexcept>
+
+#include <epicsMutex.h>
+#include <epicsGuard.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+
+#include <pv/timerWheel.h>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+namespace pvd = epics::pvData;
+using epics::pvAccess::TimerWheel;
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+struct Counter : public pvd::TimerCallback
+{
+    POINTER_DEFINITIONS(Counter);
+    epicsMutex lock;
+    epicsEvent fired;
+    epicsTime scheduled, first;
+    unsigned count, stopped;
+    Counter() :scheduled(epicsTime::getCurrent()), count(0u), stopped(0u) {}
+    virtual ~Counter() {}
+    virtual void callback()
+    {
+        {
+            Guard G(lock);
+            if(count++==0u)
+                first = epicsTime::getCurrent();
+        }
+        fired.signal();
+    }
+    virtual void timerStopped()
+    {
+        Guard G(lock);
+        stopped++;
+    }
+    unsigned getCount() { Guard G(lock); return count; }
+    // seconds from scheduled until the first callback()
+    double latency() { Guard G(lock); return first - scheduled; }
+};
+
+// cancels another, and schedules itself again, from its callback
+struct Chain : public Counter
+{
+    POINTER_DEFINITIONS(Chain);
+    TimerWheel& wheel;
+    pvd::TimerCallbackPtr victim;
+    std::tr1::weak_ptr<Chain> self;
+    explicit Chain(TimerWheel& wheel) :wheel(wheel) {}
+    virtual ~Chain() {}
+    virtual void callback()
+    {
+        if(victim) {
+            wheel.cancel(victim);
+            victim.reset();
+        }
+        Chain::shared_pointer me(self.lock());
+        if(getCount()==0u && me)
+            wheel.scheduleAfterDelay(me, 0.0);
+        Counter::callback();
+    }
+};
+
+void testOnce()
+{
+    testDiag("testOnce");
+    TimerWheel wheel("testWheel", epicsThreadPriorityMedium);
+
+    Counter::shared_pointer A(new Counter), B(new Counter);
+    wheel.scheduleAfterDelay(A, 0.1);
+    wheel.scheduleAfterDelay(B, 0.5);
+    testOk1(wheel.isScheduled(A));
+    testOk1(wheel.size()==2u);
+
+    try {
+        wheel.scheduleAfterDelay(A, 0.1);
+        testFail("scheduled twice");
+    } catch(std::logic_error& e) {
+        testPass("scheduled twice: %s", e.what());
+    }
+
+    testOk1(wheel.cancel(B));
+    testOk1(!wheel.cancel(B));
+
+    testOk(A->fired.wait(5.0), "fires");
+    testOk(A->latency()>=0.1, "not early %f", A->latency());
+    epicsThreadSleep(0.6);
+    testOk1(A->getCount()==1u);
+    testOk1(B->getCount()==0u);
+    testOk1(!wheel.isScheduled(A));
+    testOk1(wheel.size()==0u);
+}
+
+void testPeriodic()
+{
+    testDiag("testPeriodic");
+    TimerWheel wheel("testWheel", epicsThreadPriorityMedium);
+
+    Counter::shared_pointer P(new Counter);
+    wheel.schedulePeriodic(P, 0.05, 0.05);
+    epicsThreadSleep(0.6);
+    testOk1(wheel.isScheduled(P));
+    testOk1(wheel.cancel(P));
+    unsigned count = P->getCount();
+    testOk(count>=5u && count<=12u, "count %u", count);
+    epicsThreadSleep(0.2);
+    testOk1(P->getCount()==count);
+}
+
+void testMany()
+{
+    testDiag("testMany");
+    // a small tick, so that the delays span several levels
+    TimerWheel wheel("testWheel", epicsThreadPriorityMedium, 1e-5);
+
+    const size_t N = 2000u;
+    std::vector<Counter::shared_pointer> cbs(N);
+    for(size_t i=0; i<N; i++) {
+        cbs[i].reset(new Counter);
+        wheel.scheduleAfterDelay(cbs[i], 0.001*(i%1000u));
+    }
+    // cancel every other one
+    for(size_t i=0; i<N; i+=2)
+        wheel.cancel(cbs[i]);
+
+    epicsThreadSleep(2.0);
+
+    size_t wrong = 0u, early = 0u;
+    for(size_t i=0; i<N; i++) {
+        if(cbs[i]->getCount()!=(i%2u ? 1u : 0u))
+            wrong++;
+        else if(i%2u && cbs[i]->latency() < 0.001*(i%1000u))
+            early++;
+    }
+    testOk(wrong==0u, "%u of %u fired wrongly", unsigned(wrong), unsigned(N));
+    testOk(early==0u, "%u fired early", unsigned(early));
+    testOk1(wheel.size()==0u);
+}
+
+void testReentrant()
+{
+    testDiag("testReentrant");
+    TimerWheel wheel("testWheel", epicsThreadPriorityMedium);
+
+    Chain::shared_pointer C(new Chain(wheel));
+    C->self = C;
+    Counter::shared_pointer V(new Counter);
+    C->victim = V;
+
+    wheel.scheduleAfterDelay(C, 0.05);
+    wheel.scheduleAfterDelay(V, 0.3);
+    epicsThreadSleep(0.5);
+
+    testOk(C->getCount()==2u, "rescheduled from callback %u", C->getCount());
+    testOk(V->getCount()==0u, "cancelled from callback %u", V->getCount());
+}
+
+void testClose()
+{
+    testDiag("testClose");
+    TimerWheel wheel("testWheel", epicsThreadPriorityMedium);
+
+    Counter::shared_pointer A(new Counter), B(new Counter);
+    wheel.scheduleAfterDelay(A, 100.0);
+    wheel.close();
+    testOk1(A->stopped==1u);
+    testOk1(!wheel.isScheduled(A));
+
+    wheel.scheduleAfterDelay(B, 0.0);
+    testOk1(B->stopped==1u);
+    testOk1(B->getCount()==0u);
+}
+
+} // namespace
+
+MAIN(testTimerWheel)
+{
+    testPlan(24);
+    testOnce();
+    testPeriodic();
+    testMany();
+    testReentrant();
+    testClose();
+    return testDone();
+}
@@ -9,7 +9,10 @@
 #include <epicsUnitTest.h>
 #include <testMain.h>
 
+#include <string>
+
 using epics::pvAccess::Wildcard;
+using epics::pvAccess::WildcardSet;
 
 static
 void testWildcardCases()
@@ -43,11 +46,64 @@ void testWildcardCases()
     //testOk1(Wildcard::wildcardfit("**?*x*[abh-]*Q", "XYZxabbauuZQ"));
 }
 
+static
+void testWildcardSet()
+{
+    testDiag("Test testWildcardSet()");
+
+    const char *patterns[] = {"*", "?", "*?", "?*", "?*?", "*zz", "*.*", "a**b", "ab?d", "abc*", "x"};
+    const char *tests[] = {"", "a", "test", "zz", "command.com", "/var/etc", "ab", "aXYb", "abcd", "abXd", "abc", "x", "xx"};
+    const size_t npatterns = sizeof(patterns)/sizeof(patterns[0]),
+                 ntests = sizeof(tests)/sizeof(tests[0]);
+
+    // each pattern alone agrees with wildcardfit()
+    bool ok = true;
+    for(size_t p=0; p<npatterns; p++) {
+        WildcardSet set;
+        set.add(patterns[p]);
+        for(size_t t=0; t<ntests; t++) {
+            bool expect = Wildcard::wildcardfit(patterns[p], tests[t]);
+            if(set.match(tests[t])!=expect) {
+                testDiag("pattern \"%s\" on \"%s\" expected %d", patterns[p], tests[t], expect);
+                ok = false;
+            }
+        }
+    }
+    testOk(ok, "WildcardSet of one pattern matches as wildcardfit()");
+
+    // all at once, the first added matching pattern is reported
+    WildcardSet set;
+    for(size_t p=1; p<npatterns; p++)
+        set.add(patterns[p]);
+    ok = true;
+    for(size_t t=0; t<ntests; t++) {
+        std::string expect, actual;
+        for(size_t p=1; p<npatterns && expect.empty(); p++)
+            if(Wildcard::wildcardfit(patterns[p], tests[t]))
+                expect = patterns[p];
+        bool found = set.match(tests[t], &actual);
+        if(found!=!expect.empty() || actual!=expect) {
+            testDiag("\"%s\" matched \"%s\" expected \"%s\"", tests[t], actual.c_str(), expect.c_str());
+            ok = false;
+        }
+    }
+    testOk(ok, "WildcardSet reports the first matching pattern");
+
+    std::string actual;
+    testOk1(set.remove("?"));
+    testOk1(!set.remove("?"));
+    testOk1(set.match("a", &actual) && actual=="*?");
+    testOk1(!set.match(""));
+    set.clear();
+    testOk1(set.empty() && !set.match("abcd"));
+}
+
 MAIN(testWildcard)
 {
-    testPlan(12);
+    testPlan(19);
     testDiag("Tests for Wildcard util");
 
     testWildcardCases();
+    testWildcardSet();
     return testDone();
 }
@@ -0,0 +1,225 @@
+/* benchCaProvider.cpp */
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/* Throughput and latency of the "ca" provider against an embedded soft IOC.
+ *
+ * Each result is printed as one line of JSON, eg.
+ *   {"bench":"get","channels":100,"ops":10000,"seconds":0.5,"ops_per_sec":20000}
+ * so that results of releases can be compared by script.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <epicsVersion.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsGetopt.h>
+
+#ifdef EPICS_VERSION_INT
+  #if EPICS_VERSION_INT >= VERSION_INT(3,16,2,0)
+    #define USE_DBUNITTEST
+    #define USE_TYPED_RSET
+    #include <dbAccess.h>
+    #include <dbUnitTest.h>
+    #include <errlog.h>
+
+    extern "C" int testIoc_registerRecordDeviceDriver(struct dbBase *pbase);
+  #endif
+#endif
+
+#include <pv/pvData.h>
+#include <pv/createRequest.h>
+#include <pv/caProvider.h>
+#include <pva/client.h>
+
+namespace pvd = epics::pvData;
+
+namespace {
+
+double now()
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + ts.nsec*1e-9;
+}
+
+std::string channelName(unsigned i)
+{
+    std::ostringstream strm;
+    strm<<"bench:"<<i;
+    return strm.str();
+}
+
+void report(const char *bench, unsigned channels, size_t ops, double seconds)
+{
+    printf("{\"bench\":\"%s\",\"channels\":%u,\"ops\":%u,\"seconds\":%.6f,\"ops_per_sec\":%.1f}\n",
+           bench, channels, (unsigned)ops, seconds, seconds>0.0 ? ops/seconds : 0.0);
+}
+
+size_t countOk(const std::vector<pvac::GetEvent>& results)
+{
+    size_t n = 0;
+    for(size_t i=0; i<results.size(); i++)
+        if(results[i].event==pvac::GetEvent::Success) n++;
+    return n;
+}
+
+#ifdef USE_DBUNITTEST
+// puts the current time into bench:0 from the IOC side as fast as it can
+struct Putter : public epicsThreadRunable
+{
+    DBADDR addr;
+    unsigned count;
+    epicsThread thread;
+
+    Putter(unsigned count)
+        :count(count)
+        ,thread(*this, "benchPutter", epicsThreadGetStackSize(epicsThreadStackSmall))
+    {
+        if(dbNameToAddr("bench:0", &addr))
+            throw std::runtime_error("no record bench:0");
+    }
+    virtual ~Putter() {}
+    virtual void run()
+    {
+        for(unsigned i=0; i<count; i++) {
+            double value = now();
+            dbPutField(&addr, DBR_DOUBLE, &value, 1);
+        }
+    }
+};
+
+void benchMonitor(pvac::ClientProvider& provider, unsigned events, double timeout)
+{
+    pvac::ClientChannel channel(provider.connect("bench:0"));
+    pvac::MonitorSync mon(channel.monitor(pvd::createRequest("record[queueSize=100]field(value)")));
+    // initial update
+    while(mon.wait(timeout) && !mon.poll()) {}
+    while(mon.poll()) {}
+
+    std::vector<double> latency;
+    latency.reserve(events);
+
+    Putter putter(events);
+    double start = now(), last = start;
+    putter.thread.start();
+    // until no update for a second after the last put
+    while(mon.wait(1.0)) {
+        if(mon.event.event!=pvac::MonitorEvent::Data)
+            break;
+        while(mon.poll()) {
+            double T = now();
+            latency.push_back(T - mon.root->getSubFieldT<pvd::PVDouble>("value")->get());
+            last = T;
+        }
+    }
+    putter.thread.exitWait();
+
+    report("monitor", 1u, latency.size(), last-start);
+    if(latency.empty())
+        return;
+    std::sort(latency.begin(), latency.end());
+    printf("{\"bench\":\"monitor_latency\",\"samples\":%u,\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+           (unsigned)latency.size(),
+           1e6*latency[latency.size()/2],
+           1e6*latency[(latency.size()*9)/10],
+           1e6*latency[(latency.size()*99)/100],
+           1e6*latency.back());
+}
+#endif // USE_DBUNITTEST
+
+void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-n <channels>] [-i <iterations>] [-e <monitor events>] [-w <timeout>]\n", name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned nchannels = 100u, iterations = 100u, events = 10000u;
+    double timeout = 10.0;
+    int opt;
+    while((opt = getopt(argc, argv, "hn:i:e:w:")) != -1) {
+        switch(opt) {
+        case 'n': nchannels = atoi(optarg); break;
+        case 'i': iterations = atoi(optarg); break;
+        case 'e': events = atoi(optarg); break;
+        case 'w': timeout = atof(optarg); break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if(nchannels==0u) nchannels = 1u;
+
+#ifdef USE_DBUNITTEST
+    testdbPrepare();
+    testdbReadDatabase("testIoc.dbd", NULL, NULL);
+    testIoc_registerRecordDeviceDriver(pdbbase);
+    for(unsigned i=0; i<nchannels; i++) {
+        std::ostringstream macros;
+        macros<<"N="<<i;
+        testdbReadDatabase("benchCaProvider.db", NULL, macros.str().c_str());
+    }
+    eltc(0);
+    testIocInitOk();
+    eltc(1);
+#else
+    fprintf(stderr, "Without an embedded IOC, run a softIoc with benchCaProvider.db for N=0..%u\n", nchannels-1u);
+#endif
+
+    try {
+        epics::pvAccess::ca::CAClientFactory::start();
+        pvac::ClientProvider provider("ca");
+
+        std::vector<std::string> names(nchannels);
+        for(unsigned i=0; i<nchannels; i++)
+            names[i] = channelName(i);
+
+        // includes the search and connection of each channel
+        double start = now();
+        size_t ok = countOk(provider.getMany(names, timeout));
+        report("connect", nchannels, ok, now()-start);
+
+        start = now();
+        ok = 0u;
+        for(unsigned n=0; n<iterations; n++)
+            ok += countOk(provider.getMany(names, timeout));
+        report("get", nchannels, ok, now()-start);
+
+        std::vector<pvd::AnyScalar> values(nchannels);
+        start = now();
+        ok = 0u;
+        for(unsigned n=0; n<iterations; n++) {
+            for(unsigned i=0; i<nchannels; i++)
+                values[i] = pvd::AnyScalar(double(n));
+            std::vector<pvac::PutEvent> results(provider.putMany(names, values, timeout));
+            for(size_t i=0; i<results.size(); i++)
+                if(results[i].event==pvac::PutEvent::Success) ok++;
+        }
+        report("put", nchannels, ok, now()-start);
+
+#ifdef USE_DBUNITTEST
+        benchMonitor(provider, events, timeout);
+#endif
+    } catch(std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 2;
+    }
+
+#ifdef USE_DBUNITTEST
+    testIocShutdownOk();
+    testdbCleanup();
+#endif
+    return 0;
+}